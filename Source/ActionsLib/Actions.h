@@ -40,6 +40,8 @@ template <typename ElemType>
 void DoAdapt(const ConfigParameters& config);
 template <typename ElemType>
 void DoEdit(const ConfigParameters& config);
+template <typename ElemType>
+void DoBenchmark(const ConfigParameters& config);
 
 // evaluation (EvalActions.cpp)
 template <typename ElemType>
@@ -48,6 +50,10 @@ template <typename ElemType>
 void DoCrossValidate(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteOutput(const ConfigParameters& config);
+template <typename ElemType>
+void DoCalibrate(const ConfigParameters& config);
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config);
 
 // misc (OtherActions.cpp)
 template <typename ElemType>
@@ -58,6 +64,8 @@ template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
+template <typename ElemType>
+void DoConvertData(const ConfigParameters& config);
 
 // special purpose (SpecialPurposeActions.cpp)
 template <typename ElemType>
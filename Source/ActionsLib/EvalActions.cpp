@@ -21,6 +21,8 @@
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "LinearAlgebraNodes.h"
+#include "ConvolutionalNodes.h"
 
 #include <string>
 #include <chrono>
@@ -235,7 +237,7 @@ void DoWriteOutput(const ConfigParameters& config)
                            config(L"traceNodeNamesCategory", ConfigParameters::Array(stringargvector())),
                            config(L"traceNodeNamesSparse",   ConfigParameters::Array(stringargvector())));
 
-    SimpleOutputWriter<ElemType> writer(net, 1);
+    SimpleOutputWriter<ElemType> writer(net, 1, MPIWrapper::GetInstance());
 
     if (config.Exists("writer"))
     {
@@ -257,3 +259,117 @@ void DoWriteOutput(const ConfigParameters& config)
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoCalibrate() - implements CNTK "calibrate" command
+// Runs the model over the data to record the input ranges of its TimesNodes and ConvolutionNodes, which int8 inference
+// quantizes their inputs to, and saves the model with them.
+// ===========================================================================
+
+template <typename ElemType>
+void DoCalibrate(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("randomize", "None");
+
+    DataReader dataReader(readerConfig);
+
+    ConfigArray minibatchSize = config(L"minibatchSize", "2048");
+    intargvector mbSize = minibatchSize;
+
+    size_t epochSize = config(L"epochSize", "0");
+    if (epochSize == 0)
+    {
+        epochSize = requestDataSize;
+    }
+    wstring outputModelPath = config(L"outputModelPath");
+
+    vector<wstring> outputNodeNamesVector;
+
+    let net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeNames", outputNodeNamesVector);
+
+    // the ranges are those of the float computation, recorded from scratch
+    net->Environment().m_useQuantizedInference = false;
+    net->Environment().m_useInt8Inference = false;
+    for (let& node : net->GetAllNodes())
+    {
+        if (let timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(node))
+            timesNode->SetInt8InputRange(0);
+        else if (let convolutionNode = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node))
+            convolutionNode->SetInt8InputRange(0);
+    }
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+
+    std::vector<ComputationNodeBasePtr> outputNodes = net->OutputNodesByName(outputNodeNamesVector);
+    std::vector<ComputationNodeBasePtr> inputNodes = net->InputNodesForOutputs(outputNodeNamesVector);
+    net->AllocateAllMatrices({}, outputNodes, nullptr);
+    StreamMinibatchInputs inputMatrices = DataReaderHelpers::RetrieveInputMatrices(inputNodes);
+
+    dataReader.StartMinibatchLoop(mbSize[0], 0, epochSize);
+    net->StartEvaluateMinibatchLoop(outputNodes);
+
+    net->Environment().m_isCalibratingInt8 = true;
+    size_t totalSamples = 0;
+    size_t actualMBSize;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, net, nullptr, false, false, inputMatrices, actualMBSize, nullptr))
+    {
+        ComputationNetwork::BumpEvalTimeStamp(inputNodes);
+        for (let& node : outputNodes)
+            net->ForwardProp(node);
+        totalSamples += actualMBSize;
+        dataReader.DataEnd();
+    }
+    net->Environment().m_isCalibratingInt8 = false;
+
+    fprintf(stderr, "Calibrated the int8 input ranges on %d samples.\n", (int) totalSamples);
+    for (let& node : net->GetAllNodes())
+    {
+        if (let timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(node))
+            fprintf(stderr, "\t%ls: %g\n", node->NodeName().c_str(), (double) timesNode->Int8InputRange());
+        else if (let convolutionNode = dynamic_pointer_cast<ConvolutionNode<ElemType>>(node))
+            fprintf(stderr, "\t%ls: %g\n", node->NodeName().c_str(), (double) convolutionNode->Int8InputRange());
+    }
+    net->Save(outputModelPath);
+}
+
+template void DoCalibrate<float>(const ConfigParameters& config);
+template void DoCalibrate<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoOptimizeForInference() - implements CNTK "optimizeForInference" command
+// Saves an inference-only copy of the model: the nodes the outputs do not depend on (criteria, labels, ...) are removed,
+// BatchNormalization is folded into the preceding weights, the subgraphs of parameters are replaced by their values,
+// and the parameters are frozen. The parameters are also saved to a parameter archive next to the model, from which
+// the model is read memory-mapped (parameterArchive=false to skip). With float16Parameters=true, the values of the
+// parameters are stored in fp16 instead, which halves the model file; they are converted back when the model is read,
+// and there is no parameter archive by default, since it holds ElemType values.
+// ===========================================================================
+
+template <typename ElemType>
+void DoOptimizeForInference(const ConfigParameters& config)
+{
+    wstring outputModelPath = config(L"outputModelPath");
+
+    vector<wstring> outputNodeNamesVector;
+
+    let net = GetModelFromConfig<ConfigParameters, ElemType>(config, L"outputNodeNames", outputNodeNamesVector);
+    let numNodes = net->GetTotalNumberOfNodes();
+
+    net->PruneForInference(net->OutputNodesByName(outputNodeNamesVector));
+    if (config(L"foldBatchNormalization", true))
+        net->FoldBatchNormalization();
+    if (config(L"foldConstants", true))
+        net->FoldConstants();
+
+    fprintf(stderr, "Optimized the model for inference: %d nodes, down from %d.\n", (int) net->GetTotalNumberOfNodes(), (int) numNodes);
+    bool float16Parameters = config(L"float16Parameters", false);
+    net->Environment().m_saveParametersAsFloat16 = float16Parameters;
+    net->Save(outputModelPath);
+    net->Environment().m_saveParametersAsFloat16 = false;
+    if (config(L"parameterArchive", !float16Parameters))
+        net->SaveParameterArchive(outputModelPath);
+}
+
+template void DoOptimizeForInference<float>(const ConfigParameters& config);
+template void DoOptimizeForInference<double>(const ConfigParameters& config);
@@ -179,6 +179,12 @@ ComputationNetworkPtr GetModelFromConfig(const ConfigRecordType& config, const w
         net->CompileNetwork();
     }
 
+    // models loaded this way are only used for inference
+    net->Environment().m_useQuantizedInference = config(L"quantizedInference", false);
+    net->Environment().m_useInt8Inference = config(L"int8Inference", false);
+    if (config(L"foldBatchNormalization", false))
+        net->FoldBatchNormalization();
+
     return net;
 }
 
@@ -559,3 +559,26 @@ void DoTopologyPlot(const ConfigParameters& config)
 
 template void DoTopologyPlot<float>(const ConfigParameters& config);
 template void DoTopologyPlot<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertData() - implements CNTK "convertData" command
+// ===========================================================================
+
+// convert the data of the deserializers of a CompositeDataReader config into the binary chunked format, which is then
+// read with   deserializers = [ type = "BinaryChunkDeserializer" ; module = "CompositeDataReader" ; file = outputPath ]
+template <typename ElemType>
+void DoConvertData(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    wstring outputPath = config(L"outputPath");
+    readerConfig.Insert("precision", sizeof(ElemType) == sizeof(double) ? "double" : "float");
+
+    typedef void (*ConvertToBinaryChunksProc)(const ConfigParameters* readerConfig, const std::wstring& outputPath);
+    Plugin plugin;
+    auto convert = (ConvertToBinaryChunksProc)plugin.Load(L"CompositeDataReader", "ConvertToBinaryChunks");
+    convert(&readerConfig, outputPath);
+    fprintf(stderr, "Converted the reader data to '%ls'.\n", outputPath.c_str());
+}
+
+template void DoConvertData<float>(const ConfigParameters& config);
+template void DoConvertData<double>(const ConfigParameters& config);
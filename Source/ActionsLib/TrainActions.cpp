@@ -66,6 +66,18 @@ shared_ptr<C> CreateObject(const ConfigParameters& config, const wchar_t* id)
     return make_shared<C>(readerConfig);                           // old CNTK config specifies a dictionary which then must be explicitly instantiated
 }
 
+// identifies the training data for caching precomputed values, see SGD::SetPreComputeCacheKey()
+// Only the CNTK config syntax can be turned back into text; BrainScript records cannot.
+static wstring PreComputeCacheKey(const ScriptableObjects::IConfigRecord&)
+{
+    return wstring();
+}
+static wstring PreComputeCacheKey(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    return msra::strfun::utf16((string) (ConfigValue) readerConfig);
+}
+
 template <class ConfigRecordType, typename ElemType>
 void DoTrain(const ConfigRecordType& config)
 {
@@ -96,6 +108,7 @@ void DoTrain(const ConfigRecordType& config)
     }
 
     optimizer->InitMPI(MPIWrapper::GetInstance());
+    optimizer->SetPreComputeCacheKey(PreComputeCacheKey(config));
     optimizer->Train(createNetworkFn, deviceId, dataReader.get(), cvDataReader.get(), makeMode);
 }
 
@@ -172,6 +185,35 @@ void DoAdapt(const ConfigParameters& config)
 template void DoAdapt<float>(const ConfigParameters& config);
 template void DoAdapt<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoBenchmark() - implements CNTK "benchmark" command
+// ===========================================================================
+
+// Trains the network of a "train" command for a number of minibatches, and logs the samples per second and the time
+// per phase of a minibatch (read, transfer, forward, backward, aggregate, update); see SGD::Benchmark().
+// Nothing is validated or saved. Like "train", it runs on all MPI ranks.
+template <typename ElemType>
+void DoBenchmark(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    size_t numMinibatches = config(L"numMinibatches", (size_t) 100);
+    size_t numWarmupMinibatches = config(L"numWarmupMinibatches", (size_t) 10);
+    bool syntheticData = config(L"syntheticData", false); // train the first minibatch over and over, leaving out the reader
+
+    auto createNetworkFn = GetNetworkFactory<ConfigParameters, ElemType>(config);
+    auto dataReader = CreateObject<DataReader>(config, L"reader");
+
+    ConfigParameters configSGD(config(L"SGD"));
+    SGD<ElemType> sgd(configSGD);
+
+    sgd.InitMPI(MPIWrapper::GetInstance());
+    sgd.SetPreComputeCacheKey(PreComputeCacheKey(config));
+    sgd.Benchmark(createNetworkFn, deviceId, dataReader.get(), numMinibatches, numWarmupMinibatches, syntheticData);
+}
+
+template void DoBenchmark<float>(const ConfigParameters& config);
+template void DoBenchmark<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoEdit() - implements CNTK "edit" command
 // ===========================================================================
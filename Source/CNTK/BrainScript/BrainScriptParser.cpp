@@ -14,6 +14,9 @@
 #include <stdexcept>
 #include <algorithm>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <functional>
 
 #ifndef let
 #define let const auto
@@ -286,8 +289,15 @@ class Lexer : public CodeSource
     set<wstring> keywords;
     set<wstring> punctuations;
     vector<wstring> includePaths;
+    vector<SourceFile> includedFiles; // content of all files read through 'include', for the parse cache
 
 public:
+    // files read through 'include' so far
+    const vector<SourceFile>& IncludedFiles() const
+    {
+        return includedFiles;
+    }
+
     Lexer(vector<wstring>&& includePaths)
         : CodeSource(), includePaths(includePaths), currentToken(TextLocation())
     {
@@ -483,7 +493,9 @@ private:
                 if (nameTok.kind != stringliteral)
                     Fail(L"'include' must be followed by a quoted string", nameTok);
                 let path = FindSourceFile(nameTok.symbol, includePaths);
-                PushSourceFile(SourceFile(path)); // current cursor is right after the pathname; that's where we will pick up later
+                SourceFile sourceFile(path);
+                includedFiles.push_back(sourceFile);
+                PushSourceFile(move(sourceFile)); // current cursor is right after the pathname; that's where we will pick up later
                 includePaths.insert(includePaths.begin(), File::DirectoryPathOf(path));
                 return NextToken();
             }
@@ -986,14 +998,68 @@ public:
     }
 };
 
-// globally exported functions to execute the parser
-static ExpressionPtr Parse(SourceFile&& sourceFile, vector<wstring>&& includePaths)
+// ---------------------------------------------------------------------------
+// parse cache -- CNTK builds the network of each command from BrainScript that includes the standard library
+// cntk.core.bs, and a config with many commands (e.g. a series of short evaluations) parses the same source again
+// and again. A parse tree only depends on the source text, the include paths, and the content of the included
+// files, and it is never modified after parsing (evaluation is lazy and creates its own objects), so we keep it.
+// An entry is only reused while all files it included are unchanged; re-reading them is much cheaper than parsing.
+// ---------------------------------------------------------------------------
+
+struct ParseCacheEntry
 {
-    return Parser(move(sourceFile), move(includePaths)).ParseRecordMembersToDict();
+    ExpressionPtr expr;
+    vector<SourceFile> includedFiles;
+};
+static map<wstring, ParseCacheEntry> parseCache;
+static mutex parseCacheMutex;
+
+static bool IncludedFilesUnchanged(const vector<SourceFile>& includedFiles)
+{
+    for (let& includedFile : includedFiles)
+    {
+        try
+        {
+            if (SourceFile(includedFile.path).lines != includedFile.lines)
+                return false;
+        }
+        catch (const exception&) // file is gone: parse again, and report the error from there
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 'parse' parses the source file with the given parser, and returns the parse tree
+static ExpressionPtr CachedParse(const wstring& kind, const wstring& location, const wstring& text, vector<wstring>&& includePaths,
+                                 const function<ExpressionPtr(Parser&)>& parse)
+{
+    wstring key = kind + L"\n" + location + L"\n";
+    for (let& includePath : includePaths)
+        key += includePath + L"\n";
+    key += L"\n" + text;
+
+    lock_guard<mutex> lock(parseCacheMutex);
+    let iter = parseCache.find(key);
+    if (iter != parseCache.end() && IncludedFilesUnchanged(iter->second.includedFiles))
+        return iter->second.expr;
+
+    Parser parser(SourceFile(location, text), move(includePaths));
+    ParseCacheEntry entry;
+    entry.expr = parse(parser);
+    entry.includedFiles = parser.IncludedFiles();
+    parseCache[key] = move(entry);
+    return parseCache[key].expr;
 }
+
+// globally exported functions to execute the parser
 ExpressionPtr ParseConfigDictFromString(wstring text, wstring location, vector<wstring>&& includePaths)
 {
-    return Parse(SourceFile(location, text), move(includePaths));
+    return CachedParse(L"dict", location, text, move(includePaths), [](Parser& parser)
+    {
+        return parser.ParseRecordMembersToDict();
+    });
 }
 //ExpressionPtr ParseConfigDictFromFile(wstring path, vector<wstring> includePaths)
 //{
@@ -1003,10 +1069,12 @@ ExpressionPtr ParseConfigDictFromString(wstring text, wstring location, vector<w
 //}
 ExpressionPtr ParseConfigExpression(const wstring& sourceText, vector<wstring>&& includePaths)
 {
-    auto parser = Parser(SourceFile(L"(command line)", sourceText), move(includePaths));
-    auto expr = parser.ParseExpression(0, true /*can end at newline*/);
-    parser.VerifyAtEnd();
-    return expr;
+    return CachedParse(L"expression", L"(command line)", sourceText, move(includePaths), [](Parser& parser)
+    {
+        auto expr = parser.ParseExpression(0, true /*can end at newline*/);
+        parser.VerifyAtEnd();
+        return expr;
+    });
 }
 
 }}}
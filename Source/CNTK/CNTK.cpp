@@ -23,6 +23,9 @@
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "GPUMatrix.h" // used for SyncGuard::EnableSync()
+#include "MatrixOpTracer.h"
+#include "ProfilerRanges.h"
+#include "CuDnnFactories.h"
 #include "CommonMatrix.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
@@ -139,6 +142,19 @@ void CheckSupportForGpu(DEVICEID_TYPE deviceId)
 #endif
 
 // special temporary function to guard against a now invalid usage of "truncated" which exists in some IPG production setups
+// select the GPU memory allocation strategy from the top-level config: gpuMemoryAllocator="direct" (default) or "caching"
+template <class ConfigRecordType>
+static void SetGPUMemoryAllocator(const ConfigRecordType& config)
+{
+    wstring allocatorKind = config(L"gpuMemoryAllocator", L"direct");
+    if (allocatorKind == L"direct")
+        TracingGPUMemoryAllocator::SetAllocatorKind(GPUMemoryAllocatorKind::Direct);
+    else if (allocatorKind == L"caching")
+        TracingGPUMemoryAllocator::SetAllocatorKind(GPUMemoryAllocatorKind::Caching);
+    else
+        InvalidArgument("gpuMemoryAllocator: Invalid value '%ls'. Must be 'direct' or 'caching'.", allocatorKind.c_str());
+}
+
 static void DisableLegacyTruncationSettings(const ConfigParameters& TopLevelConfig, const ConfigParameters& commandConfig)
 {
     if (TopLevelConfig.ExistsCurrent(L"Truncated"))
@@ -173,7 +189,7 @@ static void DisableLegacyUsage(const ConfigParameters& TopLevelConfig, const Con
 
 // When running in parallel with MPI, only commands in 'commandstoRunOnAllRanks' should
 // be run in parallel across multiple ranks. Others should only run on rank 0
-const std::set<std::string> commandstoRunOnAllRanks = { "train", "trainRNN", "adapt", "test", "eval", "cv", "devtest" };
+const std::set<std::string> commandstoRunOnAllRanks = { "train", "trainRNN", "adapt", "benchmark", "test", "eval", "cv", "devtest" };
 
 // process the command
 template <typename ElemType>
@@ -183,6 +199,11 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
 
     int numCPUThreads = config(L"numCPUThreads", "0");
     numCPUThreads = CPUMatrix<ElemType>::SetNumThreads(numCPUThreads);
+    if (config.Exists(L"cpuParallelGrainSize"))
+        CPUMatrix<ElemType>::SetParallelGrainSize(config(L"cpuParallelGrainSize"));
+    int firstCpu = config(L"cpuThreadAffinity", "-1");
+    if (firstCpu >= 0)
+        LOGPRINTF(stderr, "Pinned %d CPU threads, starting at CPU %d.\n", CPUMatrix<ElemType>::SetThreadAffinity(firstCpu), firstCpu);
 
     if (numCPUThreads > 0)
     {
@@ -266,6 +287,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoAdapt<ElemType>(commandParams);
                 }
+                else if (thisAction == "benchmark")
+                {
+                    DoBenchmark<ElemType>(commandParams);
+                }
                 else if (thisAction == "test" || thisAction == "eval")
                 {
                     DoEval<ElemType>(commandParams);
@@ -282,6 +307,14 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoWriteOutput<ElemType>(commandParams);
                 }
+                else if (thisAction == "calibrate")
+                {
+                    DoCalibrate<ElemType>(commandParams);
+                }
+                else if (thisAction == "optimizeForInference")
+                {
+                    DoOptimizeForInference<ElemType>(commandParams);
+                }
                 else if (thisAction == "devtest")
                 {
                     TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -310,6 +343,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoTopologyPlot<ElemType>(commandParams);
                 }
+                else if (thisAction == "convertData")
+                {
+                    DoConvertData<ElemType>(commandParams);
+                }
                 else if (thisAction == "SVD")
                 {
                     DoParameterSVD<ElemType>(commandParams);
@@ -530,16 +567,47 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     auto ensureMPIWrapperCleanup = MakeScopeExit(&MPIWrapper::DeleteInstance);
     bool paralleltrain = config(L"parallelTrain", false);
     if (paralleltrain)
+    {
         mpi = MPIWrapper::GetInstance(true /*create*/);
+        if (config(L"hierarchicalAllReduce", false))
+            mpi->EnableHierarchicalAllReduce();
+    }
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
+    if (config.Exists(L"memorySharingPolicy")) // overrides shareNodeValueMatrices; a BrainScript network may override it in turn
+        ComputationNetwork::SetDefaultMemorySharingPolicy(ParseMemorySharingPolicy(config(L"memorySharingPolicy")));
+    ComputationNetwork::EnableElementwiseFusion(config(L"fuseElementwiseNodes", false));
+    ComputationNetwork::EnableLoopInvariantHoisting(config(L"hoistLoopInvariantProjections", false));
+    ComputationNetwork::EnableLoopGapSkipping(config(L"skipGapsInLoops", false));
+    ComputationNetwork::EnableIncrementalCompilation(config(L"incrementalCompilation", true));
+    ComputationNetwork::EnableDeferredParameterInit(config(L"deferParameterInit", true));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    size_t fileBufferSizeMB = config(L"fileBufferSizeMB", (size_t) 4); // of models and checkpoints
+    File::SetSequentialBufferSize(fileBufferSizeMB << 20);
+    File::EnableDirectIO(config(L"directIO", false));
+    SetGPUMemoryAllocator(config);
 
     bool synchronizeCUDAKernelExecutions = config(L"synchronizeCUDAKernelExecutions", false);
     if (synchronizeCUDAKernelExecutions)
         SyncGuard::EnableSync();
 
+    Float16Gemm::Enable(config(L"float16Gemm", false));
+    GPUStreams::SetNumStreams(config(L"numGPUStreams", (size_t) 1));
+    GPUGraph::Enable(config(L"useCudaGraphs", false));
+    wstring traceMatrixOpsFile = config(L"traceMatrixOpsFile", L"");
+    MatrixOpTracer::Enable(config(L"traceMatrixOps", false), traceMatrixOpsFile);
+    wstring traceRangesFile = config(L"traceRangesFile", L""); // Chrome trace of the training phases, per rank
+    if (!traceRangesFile.empty() && paralleltrain)
+        traceRangesFile += msra::strfun::wstrprintf(L".rank%d", (int) mpi->CurrentNodeRank());
+    ProfilerRanges::Enable(config(L"nvtxRanges", false), traceRangesFile, config(L"traceNodeRanges", false));
+    wstring cudnnAlgoCacheFile = config(L"cudnnAlgoCacheFile", L"");
+    CuDnnConvolutionAlgoCache::Configure(cudnnAlgoCacheFile, config(L"cudnnAlgoCacheBucketBatchSizes", false));
+    wstring tensorOpAutotuneFile = config(L"tensorOpAutotuneFile", L""); // by default next to the cuDNN algorithm cache
+    if (tensorOpAutotuneFile.empty() && !cudnnAlgoCacheFile.empty())
+        tensorOpAutotuneFile = cudnnAlgoCacheFile + L".tensorOps";
+    TensorOpAutotuning::Configure(config(L"autotuneTensorOps", false), tensorOpAutotuneFile);
+
     // logging
     wstring logpath = config(L"stderr", L"");
     if (logpath != L"")
@@ -600,6 +668,10 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    if (MatrixOpTracer::IsEnabled())
+        MatrixOpTracer::Report();
+    ProfilerRanges::Report();
+
     // TODO: change this back to COMPLETED, double underscores don't look good in output
     LOGPRINTF(stderr, "__COMPLETED__\n");
     fflush(stderr);
@@ -645,11 +717,42 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
     auto ensureMPIWrapperCleanup = MakeScopeExit(&MPIWrapper::DeleteInstance);
     bool paralleltrain = config(L"parallelTrain", "false");
     if (paralleltrain)
+    {
         mpi = MPIWrapper::GetInstance(true /*create*/);
+        if (config(L"hierarchicalAllReduce", false))
+            mpi->EnableHierarchicalAllReduce();
+    }
 
     g_shareNodeValueMatrices = config(L"shareNodeValueMatrices", false);
+    if (config.Exists(L"memorySharingPolicy")) // overrides shareNodeValueMatrices; a BrainScript network may override it in turn
+        ComputationNetwork::SetDefaultMemorySharingPolicy(ParseMemorySharingPolicy(config(L"memorySharingPolicy")));
+    ComputationNetwork::EnableElementwiseFusion(config(L"fuseElementwiseNodes", false));
+    ComputationNetwork::EnableLoopInvariantHoisting(config(L"hoistLoopInvariantProjections", false));
+    ComputationNetwork::EnableLoopGapSkipping(config(L"skipGapsInLoops", false));
+    ComputationNetwork::EnableIncrementalCompilation(config(L"incrementalCompilation", true));
+    ComputationNetwork::EnableDeferredParameterInit(config(L"deferParameterInit", true));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    size_t fileBufferSizeMB = config(L"fileBufferSizeMB", (size_t) 4); // of models and checkpoints
+    File::SetSequentialBufferSize(fileBufferSizeMB << 20);
+    File::EnableDirectIO(config(L"directIO", false));
+    SetGPUMemoryAllocator(config);
+
+    Float16Gemm::Enable(config(L"float16Gemm", false));
+    GPUStreams::SetNumStreams(config(L"numGPUStreams", (size_t) 1));
+    GPUGraph::Enable(config(L"useCudaGraphs", false));
+    wstring traceMatrixOpsFile = config(L"traceMatrixOpsFile", L"");
+    MatrixOpTracer::Enable(config(L"traceMatrixOps", false), traceMatrixOpsFile);
+    wstring traceRangesFile = config(L"traceRangesFile", L""); // Chrome trace of the training phases, per rank
+    if (!traceRangesFile.empty() && paralleltrain)
+        traceRangesFile += msra::strfun::wstrprintf(L".rank%d", (int) mpi->CurrentNodeRank());
+    ProfilerRanges::Enable(config(L"nvtxRanges", false), traceRangesFile, config(L"traceNodeRanges", false));
+    wstring cudnnAlgoCacheFile = config(L"cudnnAlgoCacheFile", L"");
+    CuDnnConvolutionAlgoCache::Configure(cudnnAlgoCacheFile, config(L"cudnnAlgoCacheBucketBatchSizes", false));
+    wstring tensorOpAutotuneFile = config(L"tensorOpAutotuneFile", L""); // by default next to the cuDNN algorithm cache
+    if (tensorOpAutotuneFile.empty() && !cudnnAlgoCacheFile.empty())
+        tensorOpAutotuneFile = cudnnAlgoCacheFile + L".tensorOps";
+    TensorOpAutotuning::Configure(config(L"autotuneTensorOps", false), tensorOpAutotuneFile);
 
     if (logpath != L"")
     {
@@ -732,6 +835,10 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    if (MatrixOpTracer::IsEnabled())
+        MatrixOpTracer::Report();
+    ProfilerRanges::Report();
+
     // TODO: Change back to COMPLETED (no underscores)
     LOGPRINTF(stderr, "__COMPLETED__\n");
     fflush(stderr);
@@ -26,6 +26,7 @@
 #include <string>
 #include <sstream>
 #include <iosfwd>
+#include <future>
 #include<algorithm>
 
 namespace CNTK
@@ -137,6 +138,29 @@ namespace CNTK
         DeviceKind m_deviceType;
     };
 
+    ///
+    /// Enumeration type denoting which intermediate values and gradients of a Function's computation may share memory.
+    /// More sharing reduces the memory footprint; less sharing keeps more intermediate results inspectable.
+    ///
+    enum class MemorySharingPolicy
+    {
+        None,         // nothing is shared
+        ForwardOnly,  // intermediate values are shared as soon as they are no longer needed; gradients are not shared
+        Conservative, // values and gradients are shared, but values only after backprop
+        Full,         // values and gradients are shared as soon as they are no longer needed
+        Aggressive,   // like Full, and values computed from Parameters/Constants only are shared too and recomputed for every Forward
+    };
+
+    ///
+    /// Set the memory sharing policy applied to Functions that are evaluated for the first time after this call.
+    ///
+    CNTK_API void SetMemorySharingPolicy(MemorySharingPolicy policy);
+
+    ///
+    /// Returns the memory sharing policy applied to Functions that are evaluated for the first time.
+    ///
+    CNTK_API MemorySharingPolicy GetMemorySharingPolicy();
+
     inline bool operator==(const DeviceDescriptor& left, const DeviceDescriptor& right)
     {
         return ((left.Type() == right.Type()) && (left.Id() == right.Id()));
@@ -299,6 +323,7 @@ namespace CNTK
     {
         friend class CompositeFunction;
         friend class LearnerBase;
+        friend class DataParallelDistributedTrainer;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -469,6 +494,34 @@ namespace CNTK
         ///
         CNTK_API void CopyFrom(const NDArrayView& source);
 
+        ///
+        /// Starts copying the contents of the 'source' NDArrayView to 'this' view, and returns a future that becomes ready once 'this' view holds them.
+        /// A copy from a GPU to the CPU (e.g. the readback of a loss for logging) is performed in the background, after the computations
+        /// already queued on the GPU, so that the caller can queue further work instead of waiting for it; other copies are completed before returning.
+        /// 'this' view must not be accessed, and 'source' must not be modified, until the future is ready.
+        /// The shapes of the 'source' view and 'this' view must be identical.
+        ///
+        CNTK_API std::future<void> CopyFromAsync(const NDArrayView& source);
+
+        ///
+        /// Creates a new NDArrayView over the section of 'this' view's data of shape 'sliceShape' starting at 'startOffset'.
+        /// The slice shares the storage of 'this' view, i.e. no data is copied. 'this' view must have dense storage format.
+        ///
+        CNTK_API NDArrayViewPtr SliceView(const std::vector<size_t>& startOffset, const NDShape& sliceShape, bool readOnly = false) const;
+
+        ///
+        /// Creates a new NDArrayView that reinterprets 'this' view's data in the specified shape, without copying it.
+        /// The total size of 'newShape' must equal that of 'this' view, and the elements of 'this' view must be stored contiguously
+        /// (which is not the case for a slice along any but the last axis of a view, or for a transposed view).
+        ///
+        CNTK_API NDArrayViewPtr AsShape(const NDShape& newShape, bool readOnly = false) const;
+
+        ///
+        /// Creates a new NDArrayView over 'this' view's data with the axes 'axis1' and 'axis2' swapped, without copying the data.
+        /// 'this' view must have dense storage format.
+        ///
+        CNTK_API NDArrayViewPtr TransposedView(size_t axis1, size_t axis2, bool readOnly = false) const;
+
         ///
         /// Static method to construct a new NDArrayView object whose contents are drawn from a normal distribution with the specified mean and standard deviation..
         ///
@@ -491,7 +544,6 @@ namespace CNTK
     private:
         CNTK_API NDArrayView(CNTK::DataType dataType, const DeviceDescriptor& device, CNTK::StorageFormat storageType, const NDShape& viewShape, bool readOnly, void* tensorView);
 
-
         template <typename ElementType>
         static std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>> GetMatrixImpl(const Microsoft::MSR::CNTK::TensorView<ElementType>* tensorView, size_t rowColSplitPoint);
 
@@ -507,6 +559,10 @@ namespace CNTK
         template <typename ElementType>
         Microsoft::MSR::CNTK::TensorView<ElementType>* GetWritableTensorView();
 
+        const Microsoft::MSR::CNTK::TensorShape& GetTensorShape() const;
+
+        NDArrayViewPtr StridedView(const NDShape& viewShape, const Microsoft::MSR::CNTK::TensorShape& tensorShape, bool readOnly) const;
+
     private:
         CNTK::DataType m_dataType;
         DeviceDescriptor m_device;
@@ -1612,6 +1668,26 @@ namespace CNTK
     ///
     CNTK_API FunctionPtr Combine(const std::vector<FunctionPtr>& operands, const std::wstring& name = L"");
 
+    ///
+    /// Set how many compiled networks of destroyed Functions are kept for reuse (0, the default, keeps none). A Function builds and
+    /// compiles a network the first time it is evaluated; a later Function with the same graph structure, evaluated on the same device,
+    /// then takes over a kept network instead, with its own Parameter and Constant values bound to it. The oldest networks are dropped first.
+    ///
+    CNTK_API void SetComputationNetworkCacheCapacity(size_t maxNumNetworks);
+
+    ///
+    /// Start recording a per-node profile of the specified composite Function's subsequent Forward and Backward calls: for each node,
+    /// forward and backward time (wall and, on a GPU, device time), value and gradient sizes, and GPU allocations (with the caching
+    /// GPU allocator only). Each node is waited for after it ran, so profiled calls are slower than normal ones.
+    ///
+    CNTK_API void StartNodeProfiling(const FunctionPtr& function);
+
+    ///
+    /// Stop profiling the specified Function, print the nodes sorted by total time to stderr and, if a path is specified, write
+    /// all profiled calls to it as a trace for chrome://tracing.
+    ///
+    CNTK_API void StopNodeProfiling(const FunctionPtr& function, const std::wstring& chromeTraceFilePath = L"");
+
     ///
     /// Load a legacy CNTK v1 format model
     ///
@@ -2119,6 +2195,27 @@ namespace CNTK
                                          const LearningRatesPerSample& learningRates,
                                          const MomentumsPerSample& momentums);
 
+    ///
+    /// Create an instance of the CNTK built-in Adam learner. 'momentums' and 'varianceMomentums' are the per-sample decay rates
+    /// of the first and second moment estimates. With 'layerwiseScaling', this is the LAMB learner: the step of each
+    /// Parameter is scaled by the ratio of the norms of the Parameter and the step.
+    ///
+    CNTK_API LearnerPtr AdamLearner(const std::unordered_set<Parameter>& parameters,
+                                    const LearningRatesPerSample& learningRates,
+                                    const MomentumsPerSample& momentums,
+                                    const MomentumsPerSample& varianceMomentums,
+                                    double epsilon = 1e-8,
+                                    bool layerwiseScaling = false);
+
+    ///
+    /// Create an instance of the CNTK built-in LARS learner: momentum SGD with the learning rate of each Parameter
+    /// scaled by trustCoefficient * ||w|| / ||g||, for training with large minibatches.
+    ///
+    CNTK_API LearnerPtr LARSLearner(const std::unordered_set<Parameter>& parameters,
+                                    const LearningRatesPerSample& learningRates,
+                                    const MomentumsPerSample& momentums,
+                                    double trustCoefficient = 0.001);
+
     ///
     /// Create an instance of the CNTK built-in RMSProp learner.
     ///
@@ -2131,6 +2228,58 @@ namespace CNTK
                                        double min,
                                        bool needAveMultiplier = true);
 
+    ///
+    /// Set whether learners created after this call update their Parameters together, as one contiguous buffer, instead of
+    /// one Parameter at a time; this speeds up models with many small Parameters. It applies to the Parameters of a learner
+    /// that share the data type and device, and whose gradients are dense, for the SGD, momentum SGD and Nesterov learners
+    /// and the AdaGrad learner without average multiplier. The values of these Parameters are moved into the buffer on the
+    /// learner's first update; their NDArrayView objects stay the same.
+    ///
+    CNTK_API void SetFusedParameterUpdates(bool enabled);
+
+    ///
+    /// Set whether learners check the smoothed gradients and the values of their Parameters for NaNs on every update.
+    /// The checks are enabled by default in debug builds only.
+    ///
+    CNTK_API void SetParameterUpdateNaNChecks(bool enabled);
+
+    ///
+    /// Abstraction for distributing the training of a model across the workers of an MPI job.
+    /// Each worker trains on its own share of the data; a Trainer created with a DistributedTrainer aggregates the gradients
+    /// of each minibatch across the workers before its learners update the parameters, so that the parameters of the model
+    /// stay the same on all workers. The parameters must be initialized identically on all workers, e.g. from the same seed.
+    ///
+    class DistributedTrainer : public std::enable_shared_from_this<DistributedTrainer>
+    {
+    public:
+        ///
+        /// Rank of this worker in the job.
+        ///
+        virtual size_t WorkerRank() const = 0;
+
+        ///
+        /// Number of workers in the job.
+        ///
+        virtual size_t NumWorkers() const = 0;
+
+        ///
+        /// Aggregates the specified gradients of a minibatch of 'numSamples' samples across the workers, in place.
+        /// All workers must call this for the same Parameters in the same order. Returns the number of samples of the minibatch
+        /// across all workers.
+        ///
+        virtual size_t AggregateGradients(const std::vector<std::pair<Parameter, NDArrayViewPtr>>& gradientValues, size_t numSamples) = 0;
+
+        virtual ~DistributedTrainer() {}
+    };
+
+    ///
+    /// Create a DistributedTrainer for synchronous data-parallel training: the gradients of each minibatch are summed across
+    /// all workers. MPI is initialized by the first call; a process can only be part of one MPI job.
+    /// Data is split across the workers by reading it with a composite MinibatchSource configured with "numWorkers" and
+    /// "workerRank"; each worker then reads its share of every minibatch, whose requested size is the size across all workers.
+    ///
+    CNTK_API DistributedTrainerPtr CreateDataParallelDistributedTrainer();
+
     ///
     /// Trainer is the top-level abstraction responsible for the orchestration of the training of a model
     /// using the specified learners and training data either explicitly supplied as Value objects or from
@@ -2145,12 +2294,25 @@ namespace CNTK
         ///
         CNTK_API Trainer(const FunctionPtr& model, const Variable& trainingLoss, const std::unordered_set<LearnerPtr>& parameterLearners);
 
+        ///
+        /// Construct a Trainer as above that trains the 'model' across the workers of the specified 'distributedTrainer'.
+        ///
+        CNTK_API Trainer(const FunctionPtr& model, const Variable& trainingLoss, const std::unordered_set<LearnerPtr>& parameterLearners, const DistributedTrainerPtr& distributedTrainer);
+
         ///
         /// Optimize model parameters using the specified 'arguments' minibatch of training samples.
         /// Returns false if all parameter learners indicate end of learning (through their Update method's return value).
         ///
         CNTK_API bool TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice = DeviceDescriptor::DefaultDevice());
 
+        ///
+        /// Compute the gradients of the model parameters for the specified 'arguments' micro-batch and add them to the gradients
+        /// accumulated since the last parameter update, without updating the parameters. The next TrainMinibatch call adds the gradients
+        /// of its own minibatch and updates the parameters once with the sum, as if all micro-batches had been trained as one minibatch.
+        /// This allows training with minibatches too large to fit into the memory of the device.
+        ///
+        CNTK_API void AccumulateMinibatchGradients(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice = DeviceDescriptor::DefaultDevice());
+
         ///
         /// Model being trained by 'this' Trainer.
         ///
@@ -2172,11 +2334,25 @@ namespace CNTK
         ///
         const std::unordered_set<LearnerPtr>& ParameterLearners() const { return m_parameterLearners; }
 
+        ///
+        /// DistributedTrainer across whose workers 'this' Trainer trains the model; nullptr if training is not distributed.
+        ///
+        DistributedTrainerPtr GetDistributedTrainer() const { return m_distributedTrainer; }
+
     private:
         FunctionPtr m_model;
         Variable m_trainingLossVar;
         ValuePtr m_prevMinibatchTrainingLossValue;
         std::unordered_set<LearnerPtr> m_parameterLearners;
+        DistributedTrainerPtr m_distributedTrainer;
+        std::vector<Parameter> m_distributedParameters; // the model's parameters, in the same order on all workers
+
+        std::unordered_map<Variable, ValuePtr> m_parameterGradients;
+        bool m_hasAccumulatedGradients = false;
+        size_t m_numAccumulatedSamples = 0;
+
+    private:
+        size_t ComputeParameterGradients(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice);
     };
 
     ///
@@ -2253,6 +2429,8 @@ namespace CNTK
 
     ///
     /// Instantiate the CNTK built-in composite minibatch source.
+    /// With "prefetchDepth" set to K > 0 in the 'configuration', the next K minibatches are read and transferred to the device
+    /// of the first GetNextMinibatch call on a background thread; all calls must then use that device.
     ///
     CNTK_API MinibatchSourcePtr CreateCompositeMinibatchSource(const Dictionary& configuration);
 
@@ -46,6 +46,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     template <typename ElemType>
     class TensorView;
 
+    struct TensorShape;
+
     class ComputationNetwork;
 
     template <typename ElemType>
@@ -174,6 +176,9 @@ namespace CNTK
     class Learner;
     typedef std::shared_ptr<Learner> LearnerPtr;
 
+    class DistributedTrainer;
+    typedef std::shared_ptr<DistributedTrainer> DistributedTrainerPtr;
+
     class Dictionary;
 
     class MinibatchSource;
@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "DistributedTrainer.h"
+#include "SimpleDistGradAggregator.h"
+#include "Utils.h"
+#include <mutex>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace CNTK
+{
+    // MPI can only be initialized once per process; all DistributedTrainers share the instance.
+    static MPIWrapperPtr GetMPIWrapper()
+    {
+        static std::once_flag initializeMPI;
+        std::call_once(initializeMPI, []() { MPIWrapper::GetInstance(/*create=*/true); });
+        return MPIWrapper::GetInstance();
+    }
+
+    DistributedTrainerPtr CreateDataParallelDistributedTrainer()
+    {
+        return MakeSharedObject<DataParallelDistributedTrainer>();
+    }
+
+    DataParallelDistributedTrainer::DataParallelDistributedTrainer()
+        : m_mpi(GetMPIWrapper())
+    {
+        m_header.reset(DistGradHeader::Create(/*numEvalNode=*/0), [](DistGradHeader* header) { DistGradHeader::Destroy(header); });
+        m_scratchHeader.reset(DistGradHeader::Create(/*numEvalNode=*/0), [](DistGradHeader* header) { DistGradHeader::Destroy(header); });
+    }
+
+    template <>
+    std::shared_ptr<IDistGradAggregator<float>>& DataParallelDistributedTrainer::Aggregator<float>() { return m_floatAggregator; }
+
+    template <>
+    std::shared_ptr<IDistGradAggregator<double>>& DataParallelDistributedTrainer::Aggregator<double>() { return m_doubleAggregator; }
+
+    /*virtual*/ size_t DataParallelDistributedTrainer::AggregateGradients(const std::vector<std::pair<Parameter, NDArrayViewPtr>>& gradientValues, size_t numSamples) /*override*/
+    {
+        m_header->Clear();
+        m_header->numSamples = numSamples;
+        m_header->numSamplesWithLabel = numSamples;
+
+        // The sample counts are aggregated along with the gradients of the first element type; if the model also has
+        // gradients of the other type, these are aggregated with a header whose result is not used.
+        bool aggregatedHeader = false;
+        for (auto dataType : { DataType::Float, DataType::Double })
+        {
+            std::vector<std::pair<Parameter, NDArrayViewPtr>> gradientValuesOfType;
+            for (const auto& gradientValue : gradientValues)
+            {
+                if (gradientValue.second->GetDataType() == dataType)
+                    gradientValuesOfType.push_back(gradientValue);
+            }
+
+            if (gradientValuesOfType.empty())
+                continue;
+
+            auto header = m_header.get();
+            if (aggregatedHeader)
+            {
+                header = m_scratchHeader.get();
+                header->Clear();
+                header->numSamples = numSamples;
+                header->numSamplesWithLabel = numSamples;
+            }
+
+            if (dataType == DataType::Float)
+                AggregateGradients<float>(gradientValuesOfType, header);
+            else
+                AggregateGradients<double>(gradientValuesOfType, header);
+
+            aggregatedHeader = true;
+        }
+
+        return m_header->numSamples;
+    }
+
+    template <typename ElementType>
+    bool DataParallelDistributedTrainer::AggregateGradients(const std::vector<std::pair<Parameter, NDArrayViewPtr>>& gradientValues, DistGradHeader* header)
+    {
+        auto& aggregator = Aggregator<ElementType>();
+        if (!aggregator)
+            aggregator = std::make_shared<SimpleDistGradAggregator<ElementType>>(m_mpi, /*useAsyncAggregation=*/false, /*syncStatsTrace=*/0);
+
+        // The matrices refer to the storage of the gradient values, which are thus aggregated in place
+        std::vector<std::shared_ptr<Matrix<ElementType>>> gradientMatrices;
+        std::vector<Matrix<ElementType>*> gradients;
+        for (const auto& gradientValue : gradientValues)
+        {
+            gradientMatrices.push_back(gradientValue.second->GetWritableMatrix<ElementType>());
+            gradients.push_back(gradientMatrices.back().get());
+        }
+
+        // All minibatches belong to the same epoch, so that the aggregator sets up its buffers only once
+        return aggregator->AggregateGradients(gradients, header, /*epochNumber=*/0);
+    }
+}
@@ -0,0 +1,41 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Basics.h"
+#include "MPIWrapper.h"
+#include "IDistGradAggregator.h"
+
+namespace CNTK
+{
+    // Synchronous data-parallel training: the gradients of each minibatch are summed across all workers with the
+    // SimpleDistGradAggregator that the V1 SGD uses, one aggregator for the gradients of each element type.
+    class DataParallelDistributedTrainer final : public DistributedTrainer
+    {
+    public:
+        DataParallelDistributedTrainer();
+
+        virtual size_t WorkerRank() const override { return m_mpi->CurrentNodeRank(); }
+        virtual size_t NumWorkers() const override { return m_mpi->NumNodesInUse(); }
+
+        virtual size_t AggregateGradients(const std::vector<std::pair<Parameter, NDArrayViewPtr>>& gradientValues, size_t numSamples) override;
+
+    private:
+        template <typename ElementType>
+        bool AggregateGradients(const std::vector<std::pair<Parameter, NDArrayViewPtr>>& gradientValues, Microsoft::MSR::CNTK::DistGradHeader* header);
+
+        template <typename ElementType>
+        std::shared_ptr<Microsoft::MSR::CNTK::IDistGradAggregator<ElementType>>& Aggregator();
+
+        Microsoft::MSR::CNTK::MPIWrapperPtr m_mpi;
+        std::shared_ptr<Microsoft::MSR::CNTK::IDistGradAggregator<float>> m_floatAggregator;
+        std::shared_ptr<Microsoft::MSR::CNTK::IDistGradAggregator<double>> m_doubleAggregator;
+        std::shared_ptr<Microsoft::MSR::CNTK::DistGradHeader> m_header;
+        std::shared_ptr<Microsoft::MSR::CNTK::DistGradHeader> m_scratchHeader;
+    };
+}
@@ -10,6 +10,9 @@
 #include "Utils.h"
 #include "ComputationNode.h"
 #include "ReshapingNodes.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -17,6 +20,23 @@ bool g_shareNodeValueMatrices = true;
 
 namespace CNTK
 {
+    static_assert((int)MemorySharingPolicy::None         == (int)Microsoft::MSR::CNTK::MemorySharingPolicy::None &&
+                  (int)MemorySharingPolicy::ForwardOnly  == (int)Microsoft::MSR::CNTK::MemorySharingPolicy::ForwardOnly &&
+                  (int)MemorySharingPolicy::Conservative == (int)Microsoft::MSR::CNTK::MemorySharingPolicy::Conservative &&
+                  (int)MemorySharingPolicy::Full         == (int)Microsoft::MSR::CNTK::MemorySharingPolicy::Full &&
+                  (int)MemorySharingPolicy::Aggressive   == (int)Microsoft::MSR::CNTK::MemorySharingPolicy::Aggressive,
+                  "CNTK::MemorySharingPolicy must match the internal Microsoft::MSR::CNTK::MemorySharingPolicy");
+
+    void SetMemorySharingPolicy(MemorySharingPolicy policy)
+    {
+        ComputationNetwork::SetDefaultMemorySharingPolicy((Microsoft::MSR::CNTK::MemorySharingPolicy)policy);
+    }
+
+    MemorySharingPolicy GetMemorySharingPolicy()
+    {
+        return (MemorySharingPolicy)ComputationNetwork::GetDefaultMemorySharingPolicy();
+    }
+
     std::shared_ptr<std::vector<Variable>> Function::InputsImpl() const
     {
         const CompositeFunction* compositeFunction = dynamic_cast<const CompositeFunction*>(this);
@@ -372,6 +392,217 @@ namespace CNTK
         return computationNodePtr;
     }
 
+    // A compiled network of a destroyed Function, kept for a structurally identical Function
+    struct CachedComputationNetwork
+    {
+        std::wstring m_structure;
+        std::vector<Dictionary> m_attributes;
+        ComputationNetworkPtr m_network;
+        std::vector<ComputationNodeBasePtr> m_nodes; // the node of each Variable of the graph description, or nullptr
+        std::vector<bool> m_isVariableRoot;
+    };
+
+    static std::atomic<size_t> s_computationNetworkCacheCapacity(0);
+    static std::mutex s_computationNetworkCacheLock;
+
+    // Oldest first. Not destroyed at exit, when the devices of the networks may be gone already.
+    static std::deque<CachedComputationNetwork>& ComputationNetworkCache()
+    {
+        static auto computationNetworkCache = new std::deque<CachedComputationNetwork>();
+        return *computationNetworkCache;
+    }
+
+    void SetComputationNetworkCacheCapacity(size_t maxNumNetworks)
+    {
+        std::deque<CachedComputationNetwork> droppedNetworks;
+        {
+            std::lock_guard<std::mutex> lock(s_computationNetworkCacheLock);
+            s_computationNetworkCacheCapacity = maxNumNetworks;
+            auto& cache = ComputationNetworkCache();
+            while (cache.size() > maxNumNetworks)
+            {
+                droppedNetworks.push_back(std::move(cache.front()));
+                cache.pop_front();
+            }
+        }
+    }
+
+    void StartNodeProfiling(const FunctionPtr& function)
+    {
+        auto compositeFunction = dynamic_cast<CompositeFunction*>(function.get());
+        if (compositeFunction == nullptr)
+            InvalidArgument("StartNodeProfiling: Only composite Functions can be profiled");
+
+        compositeFunction->m_isNodeProfilingEnabled = true;
+        if (compositeFunction->m_computationNetwork)
+            compositeFunction->m_computationNetwork->EnableNodeProfiling(true);
+    }
+
+    void StopNodeProfiling(const FunctionPtr& function, const std::wstring& chromeTraceFilePath)
+    {
+        auto compositeFunction = dynamic_cast<CompositeFunction*>(function.get());
+        if (compositeFunction == nullptr)
+            InvalidArgument("StopNodeProfiling: Only composite Functions can be profiled");
+
+        compositeFunction->m_isNodeProfilingEnabled = false;
+        auto& computationNetwork = compositeFunction->m_computationNetwork;
+        if (!computationNetwork || !computationNetwork->IsNodeProfilingEnabled())
+            return;
+
+        computationNetwork->GetNodeProfiler()->Print();
+        if (!chromeTraceFilePath.empty())
+            computationNetwork->GetNodeProfiler()->WriteChromeTrace(chromeTraceFilePath);
+        computationNetwork->EnableNodeProfiling(false);
+    }
+
+    CompositeFunction::~CompositeFunction()
+    {
+        if ((m_computationNetwork == nullptr) || m_networkCacheStructure.empty() || (s_computationNetworkCacheCapacity == 0))
+            return;
+
+        try
+        {
+            // Put back the matrices of the input nodes that refer to the storage of an argument of this Function
+            for (auto& ownInputNodeValue : m_ownInputNodeValues)
+            {
+                auto floatNode = std::dynamic_pointer_cast<ComputationNode<float>>(ownInputNodeValue.first);
+                if (floatNode != nullptr)
+                    floatNode->ValuePtrRef() = std::static_pointer_cast<Matrix<float>>(ownInputNodeValue.second);
+                else
+                    ownInputNodeValue.first->As<ComputationNode<double>>()->ValuePtrRef() = std::static_pointer_cast<Matrix<double>>(ownInputNodeValue.second);
+            }
+
+            CachedComputationNetwork cachedNetwork;
+            cachedNetwork.m_structure = std::move(m_networkCacheStructure);
+            cachedNetwork.m_attributes = std::move(m_networkCacheAttributes);
+            cachedNetwork.m_network = m_computationNetwork;
+            for (const auto& variable : m_networkCacheVariables)
+            {
+                auto nodeIter = m_variableToNodeMap.find(variable);
+                cachedNetwork.m_nodes.push_back((nodeIter != m_variableToNodeMap.end()) ? nodeIter->second : nullptr);
+
+                auto rootIter = m_isVariableRootMap.find(variable);
+                cachedNetwork.m_isVariableRoot.push_back((rootIter != m_isVariableRootMap.end()) && rootIter->second);
+            }
+
+            CachedComputationNetwork droppedNetwork;
+            std::lock_guard<std::mutex> lock(s_computationNetworkCacheLock);
+            auto& cache = ComputationNetworkCache();
+            cache.push_back(std::move(cachedNetwork));
+            if (cache.size() > s_computationNetworkCacheCapacity)
+            {
+                droppedNetwork = std::move(cache.front());
+                cache.pop_front();
+            }
+        }
+        catch (...)
+        {
+            // The network is not cached then
+        }
+    }
+
+    bool CompositeFunction::DescribeGraph(std::wstring& structure, std::vector<Dictionary>& attributes, std::vector<Variable>& variables) const
+    {
+        std::wstringstream structureStream;
+        std::unordered_map<Variable, size_t> variableIndices;
+        for (const auto& rootOutput : RootFunction()->Outputs())
+        {
+            if (!DescribeVariable(rootOutput, structureStream, attributes, variables, variableIndices))
+                return false;
+        }
+
+        structure = structureStream.str();
+        return true;
+    }
+
+    /*static*/ bool CompositeFunction::DescribeVariable(const Variable& variable, std::wstringstream& structure, std::vector<Dictionary>& attributes, std::vector<Variable>& variables, std::unordered_map<Variable, size_t>& variableIndices)
+    {
+        if (variableIndices.find(variable) != variableIndices.end())
+            return true;
+
+        // Recurrent graphs refer back to Variables whose description is not complete yet, by their index
+        size_t index = variables.size();
+        variableIndices[variable] = index;
+        variables.push_back(variable);
+
+        std::wstringstream description;
+        description << index << L": " << (int)variable.Kind() << L" " << DataTypeName(variable.GetDataType()) << L" [";
+        auto shape = variable.Shape();
+        for (size_t i = 0; i < shape.NumAxes(); ++i)
+            description << shape[i] << L" ";
+        description << L"] " << variable.NeedsGradient() << L" " << variable.IsSparse();
+        for (const auto& dynamicAxis : variable.DynamicAxes())
+            description << L" " << dynamicAxis.Name();
+
+        if (variable.IsOutput())
+        {
+            auto primitiveFunction = dynamic_cast<const PrimitiveFunction*>(variable.Owner().get());
+            if (primitiveFunction == nullptr)
+                return false;
+
+            description << L" = op " << (int)primitiveFunction->OpType();
+            const auto& outputs = primitiveFunction->Outputs();
+            description << L" output " << (std::find(outputs.begin(), outputs.end(), variable) - outputs.begin()) << L" of";
+            for (const auto& input : primitiveFunction->Inputs())
+            {
+                if (!DescribeVariable(input, structure, attributes, variables, variableIndices))
+                    return false;
+
+                description << L" " << variableIndices.at(input);
+            }
+
+            attributes.push_back(primitiveFunction->FunctionConfig());
+        }
+
+        structure << description.str() << L"\n";
+        return true;
+    }
+
+    template <typename ElementType>
+    bool CompositeFunction::AdoptCachedComputationNetwork(const std::unordered_set<Variable>& backpropRoots)
+    {
+        CachedComputationNetwork cachedNetwork;
+        {
+            std::lock_guard<std::mutex> lock(s_computationNetworkCacheLock);
+            auto& cache = ComputationNetworkCache();
+            auto iter = std::find_if(cache.begin(), cache.end(), [this](const CachedComputationNetwork& entry) {
+                return (entry.m_structure == m_networkCacheStructure) && (entry.m_attributes == m_networkCacheAttributes);
+            });
+
+            if (iter == cache.end())
+                return false;
+
+            cachedNetwork = std::move(*iter);
+            cache.erase(iter);
+        }
+
+        m_computationNetwork = cachedNetwork.m_network;
+        for (size_t i = 0; i < m_networkCacheVariables.size(); ++i)
+        {
+            const auto& variable = m_networkCacheVariables[i];
+            const auto& computationNode = cachedNetwork.m_nodes[i];
+            if (computationNode == nullptr)
+                continue;
+
+            m_variableToNodeMap[variable] = computationNode;
+            m_isVariableRootMap[variable] = cachedNetwork.m_isVariableRoot[i];
+
+            // Bind the values of this Function's Parameters and Constants as GetNode() does
+            if (variable.IsParameter() || variable.IsConstant())
+            {
+                NDArrayViewPtr value = variable.IsConstant() ? Constant(variable).Value() : Parameter(variable).Value();
+                auto matrix = variable.IsConstant() ? value->GetMatrix<ElementType>()->AsReference() : value->GetWritableMatrix<ElementType>()->AsReference();
+                computationNode->As<ComputationNode<ElementType>>()->Value() = std::move(matrix);
+
+                if (variable.IsParameter())
+                    m_parameterValueStorage[variable] = value->m_tensorView.get();
+            }
+        }
+
+        m_currentBackpropRoots = backpropRoots;
+        return true;
+    }
+
     template <typename ElementType>
     ComputationNetworkPtr CompositeFunction::GetComputationNetwork(const DeviceDescriptor& device, const std::unordered_set<Variable>& backpropRoots)
     {
@@ -388,6 +619,26 @@ namespace CNTK
                 LogicError("Changing device across different Forward calls on a CNTK composite Function is currently unsupported");
         }
 
+        if ((m_computationNetwork == nullptr) && (s_computationNetworkCacheCapacity > 0))
+        {
+            if (DescribeGraph(m_networkCacheStructure, m_networkCacheAttributes, m_networkCacheVariables))
+            {
+                std::wstringstream networkDescription;
+                networkDescription << L"device " << AsCNTKImplDeviceId(device) << L" " << DataTypeName(AsDataType<ElementType>()) << L" backprop roots";
+                for (const auto& backpropRoot : backpropRoots)
+                    networkDescription << L" " << (std::find(m_networkCacheVariables.begin(), m_networkCacheVariables.end(), backpropRoot) - m_networkCacheVariables.begin());
+
+                m_networkCacheStructure += networkDescription.str();
+                AdoptCachedComputationNetwork<ElementType>(backpropRoots);
+            }
+            else
+            {
+                m_networkCacheStructure.clear();
+                m_networkCacheAttributes.clear();
+                m_networkCacheVariables.clear();
+            }
+        }
+
         if (m_computationNetwork == nullptr)
         {
             m_computationNetwork = std::make_shared<ComputationNetwork>(AsCNTKImplDeviceId(device));
@@ -462,8 +713,29 @@ namespace CNTK
             }
 
             m_computationNetwork->AllocateAllMatrices(forwardRootNodes, {}, backpropRootNode);
+
+            for (auto varNodePair : m_variableToNodeMap)
+            {
+                if (varNodePair.first.IsParameter())
+                    m_parameterValueStorage[varNodePair.first] = Parameter(varNodePair.first).Value()->m_tensorView.get();
+            }
+        }
+
+        // Point the Parameter nodes whose Parameter's value was moved to another buffer since to the new storage
+        for (auto& parameterValueStorage : m_parameterValueStorage)
+        {
+            auto value = Parameter(parameterValueStorage.first).Value();
+            if (value->m_tensorView.get() != parameterValueStorage.second)
+            {
+                m_variableToNodeMap[parameterValueStorage.first]->As<ComputationNode<ElementType>>()->Value() = value->GetWritableMatrix<ElementType>()->AsReference();
+                parameterValueStorage.second = value->m_tensorView.get();
+            }
         }
 
+        // a network created or taken from the cache after StartNodeProfiling()
+        if (m_computationNetwork->IsNodeProfilingEnabled() != m_isNodeProfilingEnabled)
+            m_computationNetwork->EnableNodeProfiling(m_isNodeProfilingEnabled);
+
         return m_computationNetwork;
     }
 
@@ -589,7 +861,7 @@ namespace CNTK
     }
 
     template <typename ElementType>
-    /*static*/ ValuePtr CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/)
+    /*static*/ ValuePtr CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, const NDArrayViewPtr& unpackedData /*= nullptr*/)
     {
         NDShape valueDataShape = sampleShape;
         if (layout != nullptr)
@@ -618,9 +890,13 @@ namespace CNTK
                 sequenceLengths.push_back(sequenceInfo.GetNumTimeSteps());
         }
 
-        // Reshuffle to data to unpack and uninterleave the CNTK form data
+        // Reshuffle to data to unpack and uninterleave the CNTK form data, straight into 'unpackedData' if specified
         // Now generate the gather indices
-        auto shuffledMatrixData = std::make_shared<Matrix<ElementType>>(matrix.GetNumRows(), maxNumTimeSteps * numSequences, matrix.GetDeviceId());
+        std::shared_ptr<Matrix<ElementType>> shuffledMatrixData;
+        if (unpackedData != nullptr)
+            shuffledMatrixData = unpackedData->GetWritableMatrix<ElementType>(sampleShape.NumAxes());
+        else
+            shuffledMatrixData = std::make_shared<Matrix<ElementType>>(matrix.GetNumRows(), maxNumTimeSteps * numSequences, matrix.GetDeviceId());
 
         std::vector<size_t> sequencesShorterThanLongestSequence;
         for (size_t i = 0; i < numSequences; ++i)
@@ -658,13 +934,16 @@ namespace CNTK
             }
         }
 
+        if (unpackedData != nullptr)
+            return MakeSharedObject<Value>(unpackedData, mask);
+
         auto tensorView = new TensorView<ElementType>(shuffledMatrixData, AsTensorShape(valueDataShape));
         auto data = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), AsDeviceDescriptor(matrix.GetDeviceId()), StorageFormat::Dense, valueDataShape, readOnly, tensorView);
         return MakeSharedObject<Value>(data, mask);
     }
 
     template <typename ElementType>
-    /*static*/ ValuePtr CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout(Variable var, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/)
+    /*static*/ ValuePtr CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout(Variable var, const Matrix<ElementType>& matrix, const MBLayoutPtr& layout, bool readOnly /*= true*/, const NDArrayViewPtr& unpackedData /*= nullptr*/)
     {
         if (var.DynamicAxes().size() > 1)
             LogicError("More than one dynamic axis for a variable is currently unsupported");
@@ -675,7 +954,7 @@ namespace CNTK
         if ((layout != nullptr) && (matrix.GetNumRows() != var.Shape().TotalSize()))
             LogicError("Unexpected matrix layout: The number of rows in the matrix does not match the sample size of the Variable");
 
-        return GetValueObjectFromCNTKImplMatrixAndMBLayout(var.Shape(), matrix, layout, readOnly);
+        return GetValueObjectFromCNTKImplMatrixAndMBLayout(var.Shape(), matrix, layout, readOnly, unpackedData);
     }
 
     template <typename ElementType>
@@ -692,6 +971,40 @@ namespace CNTK
         computationNode->GetMBLayout()->CopyFrom(layout);
     }
 
+    // Like PopulateComputationNodeValue(), but a dense argument on the device of the node is not copied; the node's value
+    // instead refers to the storage of the argument Value (or to the sequences gathered from it), which it keeps alive.
+    // The network does not write to the values of its input nodes, so the argument is not modified; Backward() reads it again,
+    // so the argument must not be modified by the caller in between either.
+    template <typename ElementType>
+    void CompositeFunction::BindComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, ComputationNodeBasePtr& computationNode)
+    {
+        auto CNTKMatrixAndMBLayout = GetCNTKImplMatrixAndMBLayoutFromValueObject<ElementType>(variableValue.first, variableValue.second);
+        auto& argumentMatrix = CNTKMatrixAndMBLayout.first;
+        auto& nodeValuePtr = computationNode->As<ComputationNode<ElementType>>()->ValuePtrRef();
+
+        auto ownValue = m_ownInputNodeValues.find(computationNode);
+        if ((argumentMatrix->GetMatrixType() == MatrixType::DENSE) && (argumentMatrix->GetDeviceId() == nodeValuePtr->GetDeviceId()))
+        {
+            if (ownValue == m_ownInputNodeValues.end())
+                m_ownInputNodeValues[computationNode] = nodeValuePtr;
+
+            nodeValuePtr = std::make_shared<Matrix<ElementType>>(argumentMatrix->AsReference());
+            computationNode->GetMBLayout()->CopyFrom(CNTKMatrixAndMBLayout.second);
+            return;
+        }
+
+        // Copy into the node's own matrix, never into the storage of an earlier argument
+        if (ownValue != m_ownInputNodeValues.end())
+        {
+            nodeValuePtr = std::static_pointer_cast<Matrix<ElementType>>(ownValue->second);
+            m_ownInputNodeValues.erase(ownValue);
+        }
+
+        nodeValuePtr->SwitchToMatrixType(argumentMatrix->GetMatrixType(), argumentMatrix->GetFormat(), false);
+        nodeValuePtr->AssignValuesOf(*argumentMatrix);
+        computationNode->GetMBLayout()->CopyFrom(CNTKMatrixAndMBLayout.second);
+    }
+
     void CompositeFunction::PopulateNetworkInputs(const std::unordered_map<Variable, ValuePtr>& arguments)
     {
         auto functionArguments = this->Arguments();
@@ -711,10 +1024,10 @@ namespace CNTK
             switch (argumentValue->Data()->GetDataType())
             {
             case DataType::Float:
-                PopulateComputationNodeValue<float>({ argument, argumentValue }, argumentComputationNode);
+                BindComputationNodeValue<float>({ argument, argumentValue }, argumentComputationNode);
                 break;
             case DataType::Double:
-                PopulateComputationNodeValue<double>({ argument, argumentValue }, argumentComputationNode);
+                BindComputationNodeValue<double>({ argument, argumentValue }, argumentComputationNode);
                 break;
             default:
                 LogicError("Unsupported DataType %s", DataTypeName(argumentValue->Data()->GetDataType()));
@@ -785,7 +1098,7 @@ namespace CNTK
         return NDShape(outputShapeDims);
     }
 
-    /*static*/ void CompositeFunction::GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient)
+    /*static*/ void CompositeFunction::GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient, bool accumulate/* = false*/)
     {
         auto valueShape = GetValueShape(var, computationNode);
         if (varValue != nullptr)
@@ -795,31 +1108,87 @@ namespace CNTK
                 InvalidArgument("The shape %s of the specified Value object for %s does not match the actual shape %s", AsString(varValue->Data()->Shape()).c_str(), getGradient ? "gradient" : "output", AsString(valueShape).c_str());
         }
 
+        // Sequences that need to be unpacked are unpacked straight into the specified Value if it can take them,
+        // otherwise into a new Value that is handed out as is
+        auto layout = computationNode->GetMBLayout();
+        bool needsUnpacking = (layout != nullptr) && (layout->GetNumTimeSteps() != 1) && (layout->GetNumSequences() != 1);
+        NDArrayViewPtr unpackedData;
+        if (needsUnpacking && !accumulate && (varValue != nullptr) && !varValue->Data()->IsReadOnly() && !varValue->Data()->IsSparse() &&
+            (AsCNTKImplDeviceId(varValue->Data()->Device()) == computationNode->GetDeviceId()))
+        {
+            unpackedData = varValue->Data();
+        }
+
         ValuePtr nodeValue;
         switch (var.GetDataType())
         {
         case DataType::Float:
             nodeValue = GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(var,
                                                                            getGradient ? computationNode->As<ComputationNode<float>>()->Gradient() : computationNode->As<ComputationNode<float>>()->Value(),
-                                                                           computationNode->GetMBLayout());
+                                                                           layout, false, unpackedData);
             break;
         case DataType::Double:
             nodeValue = GetValueObjectFromCNTKImplMatrixAndMBLayout<double>(var,
                                                                             getGradient ? computationNode->As<ComputationNode<double>>()->Gradient() : computationNode->As<ComputationNode<double>>()->Value(),
-                                                                            computationNode->GetMBLayout());
+                                                                            layout, false, unpackedData);
             break;
         default:
             LogicError("Unsupported DataType %s", DataTypeName(var.GetDataType()));
             break;
         }
 
+        // Values are only accumulated into existing storage; the first accumulation is a plain copy
+        if (accumulate && (varValue != nullptr))
+        {
+            if ((nodeValue->Mask() != nullptr) || (varValue->Mask() != nullptr))
+                InvalidArgument("Cannot accumulate the %s of %S, which has sequences of different lengths", getGradient ? "gradient" : "output", var.Name().c_str());
+
+            switch (var.GetDataType())
+            {
+            case DataType::Float:
+                Matrix<float>::ScaleAndAdd(1.0f, *nodeValue->Data()->GetMatrix<float>(), *varValue->Data()->GetWritableMatrix<float>());
+                break;
+            case DataType::Double:
+                Matrix<double>::ScaleAndAdd(1.0, *nodeValue->Data()->GetMatrix<double>(), *varValue->Data()->GetWritableMatrix<double>());
+                break;
+            default:
+                LogicError("Unsupported DataType %s", DataTypeName(var.GetDataType()));
+                break;
+            }
+
+            return;
+        }
+
         if (varValue == nullptr)
         {
+            if (needsUnpacking)
+            {
+                varValue = nodeValue;
+                return;
+            }
+
+            // A view of the node's matrix would be overwritten by the next call
             auto data = MakeSharedObject<NDArrayView>(var.GetDataType(), valueShape, AsDeviceDescriptor(computationNode->ValuePtr()->GetDeviceId()));
             auto mask = (nodeValue->Mask() != nullptr) ? MakeSharedObject<NDMask>(nodeValue->Mask()->Shape(), nodeValue->Mask()->Device()) : nullptr;
             varValue = MakeSharedObject<Value>(data, mask);
         }
-        varValue->CopyFrom(*nodeValue);
+
+        if (unpackedData == nullptr)
+        {
+            varValue->CopyFrom(*nodeValue);
+            return;
+        }
+
+        // The data is in place already; only the mask remains
+        if (nodeValue->Mask() != nullptr)
+        {
+            if (varValue->Mask() == nullptr)
+                InvalidArgument("The specified Value object for %s has no mask, but the actual %s has sequences of different lengths", getGradient ? "gradient" : "output", getGradient ? "gradient" : "output");
+
+            varValue->Mask()->CopyFrom(*nodeValue->Mask());
+        }
+        else if (varValue->Mask() != nullptr)
+            varValue->Mask()->Clear();
     }
 
     void CompositeFunction::GetNetworkOutputs(std::unordered_map<Variable, ValuePtr>& outputs)
@@ -829,7 +1198,7 @@ namespace CNTK
             GetNodeOutputOrGradient(outputVarValuePair.first, outputs[outputVarValuePair.first], m_variableToNodeMap[outputVarValuePair.first], false /*getGradient*/);
     }
 
-    void CompositeFunction::GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients)
+    void CompositeFunction::GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients, bool accumulate/* = false*/)
     {
         auto networkInputs = this->Inputs();
         // Now copy the gradient values of input nodes of the network to gradients' Value objects
@@ -848,7 +1217,7 @@ namespace CNTK
             if (!computationNodePtr->NeedsGradient())
                 LogicError("Backpropagated gradient value cannot be read from a ComputationNode that has NeedsGradient set to false");
 
-            GetNodeOutputOrGradient(gradientVarValuePair.first, gradients[gradientVarValuePair.first], computationNodePtr, true /*getGradient*/);
+            GetNodeOutputOrGradient(gradientVarValuePair.first, gradients[gradientVarValuePair.first], computationNodePtr, true /*getGradient*/, accumulate);
         }
     }
 
@@ -865,9 +1234,7 @@ namespace CNTK
         else
             GetComputationNetwork<double>(computeDevice, outputsToRetainBackwardStateFor);
 
-        // TODO: Avoid copying the data when possible
-
-        // Feed data into the arguments of the network
+        // Feed data into the arguments of the network; dense arguments on the network's device are used in place
         PopulateNetworkInputs(arguments);
 
         std::unordered_set<Variable> functionOutputs(this->Outputs().begin(), this->Outputs().end());
@@ -898,25 +1265,58 @@ namespace CNTK
 
         // TODO: How to deal with the specified 'computeDevice'
 
-        return (outputsToRetainBackwardStateFor.size() > 0) ? MakeSharedObject<CNTKBackPropState>(this->shared_from_this(), std::make_pair(arguments.begin()->first, m_variableToNodeMap[arguments.begin()->first]->GetEvalTimeStamp())) : nullptr;
+        return (outputsToRetainBackwardStateFor.size() > 0) ? MakeSharedObject<CNTKBackPropState>(this->shared_from_this(), std::make_pair(arguments.begin()->first, m_variableToNodeMap[arguments.begin()->first]->GetEvalTimeStamp()), arguments) : nullptr;
+    }
+
+    // The network holds the intermediate values of its most recent Forward call only. Those of an earlier Forward call are
+    // recomputed from the arguments its backprop state keeps, with the current values of the Parameters.
+    void CompositeFunction::RecomputeBackPropState(const CNTKBackPropState& backpropState)
+    {
+        std::vector<ComputationNodeBasePtr> backpropRootNodes;
+        for (auto backpropRoot : m_currentBackpropRoots)
+            backpropRootNodes.push_back(m_variableToNodeMap[backpropRoot]);
+
+        // Nodes that draw random numbers or update running statistics would not reproduce their earlier values
+        for (auto& rootNode : backpropRootNodes)
+        {
+            for (auto& node : m_computationNetwork->GetEvalOrder(rootNode))
+            {
+                if ((node->OperationName() == OperationNameOf(DropoutNode)) || (node->OperationName() == OperationNameOf(BatchNormalizationNode)))
+                    LogicError("The specified backprop state cannot be used for backpropagation as the Function's internal state was modified by subsequent Forward calls to the function, "
+                               "and the %ls node '%ls' cannot be evaluated again for the earlier Forward call", node->OperationName().c_str(), node->NodeName().c_str());
+            }
+        }
+
+        PopulateNetworkInputs(backpropState.Arguments());
+
+        ScopedNetworkOperationMode modeGuard(m_computationNetwork, NetworkOperationMode::training);
+        m_computationNetwork->ForwardProp(backpropRootNodes);
     }
 
     /*virtual*/ void CompositeFunction::Backward(const BackPropStatePtr& state,
                                                  const std::unordered_map<Variable, ValuePtr>& rootGradientValues,
                                                  std::unordered_map<Variable, ValuePtr>& backPropagatedGradientValuesForInputs)
+    {
+        Backward(state, rootGradientValues, backPropagatedGradientValuesForInputs, false /*accumulateGradients*/);
+    }
+
+    void CompositeFunction::Backward(const BackPropStatePtr& state,
+                                     const std::unordered_map<Variable, ValuePtr>& rootGradientValues,
+                                     std::unordered_map<Variable, ValuePtr>& backPropagatedGradientValuesForInputs,
+                                     bool accumulateGradients)
     {
         auto backpropState = dynamic_cast<const CNTKBackPropState*>(state.get());
         if (backpropState == nullptr)
             InvalidArgument("Invalid backprop state specified");
 
-        // TODO: Support multiple concurrent backprop states
-        if (backpropState->EvalTimeStamp().second != m_variableToNodeMap[backpropState->EvalTimeStamp().first]->GetEvalTimeStamp())
-            LogicError("The specified backprop state specified cannot be used for backpropagation as the Function's internal state was modified by subsequent Forward calls to the function."
-                       "This is not a user error but a shortcoming of the current implementation where multiple independent backprop states are not simultaneously supported");
-
         if (rootGradientValues.size() > 1)
             LogicError("Currently gradient backprop from only one of the Function Outputs is supported");
 
+        // Several backprop states may be outstanding, e.g. for micro-batches whose gradients are accumulated;
+        // the network only holds the intermediate values of the most recent one
+        if (backpropState->EvalTimeStamp().second != m_variableToNodeMap[backpropState->EvalTimeStamp().first]->GetEvalTimeStamp())
+            RecomputeBackPropState(*backpropState);
+
         // TODO: Avoid copying the data when possible
 
         // Zero all gradients of nodes below the root nodes
@@ -932,7 +1332,7 @@ namespace CNTK
         auto rootComputationNodePtr = m_variableToNodeMap[rootGradientValues.begin()->first];
         m_computationNetwork->GetNestedNetwork(rootComputationNodePtr)->Backprop(FrameRange(nullptr), true, true);
 
-        GetNetworkGradients(backPropagatedGradientValuesForInputs);
+        GetNetworkGradients(backPropagatedGradientValuesForInputs, accumulateGradients);
 
         // TODO: How to deal with the specified 'computeDevice'
     }
@@ -385,8 +385,8 @@ namespace CNTK
     class CNTKBackPropState final : public BackPropState
     {
     public:
-        CNTKBackPropState(const FunctionPtr& function, const std::pair<Variable, int64_t>& evalTimeStamp)
-            : BackPropState(function), m_evalTimeStamp(evalTimeStamp)
+        CNTKBackPropState(const FunctionPtr& function, const std::pair<Variable, int64_t>& evalTimeStamp, const std::unordered_map<Variable, ValuePtr>& arguments)
+            : BackPropState(function), m_evalTimeStamp(evalTimeStamp), m_arguments(arguments)
         {}
 
         std::pair<Variable, int64_t> EvalTimeStamp() const
@@ -394,8 +394,15 @@ namespace CNTK
             return m_evalTimeStamp;
         }
 
+        // The arguments of the Forward call, to recompute its intermediate values from if the Function was evaluated again since
+        const std::unordered_map<Variable, ValuePtr>& Arguments() const
+        {
+            return m_arguments;
+        }
+
     private:
         std::pair<Variable, int64_t> m_evalTimeStamp;
+        std::unordered_map<Variable, ValuePtr> m_arguments;
     };
     typedef std::shared_ptr<CNTKBackPropState> CNTKBackPropStatePtr;
 
@@ -413,6 +420,9 @@ namespace CNTK
         template <typename ElementType>
         friend void SaveAsLegacyModel(const FunctionPtr& rootFunction, const std::wstring& modelFile);
 
+        friend void StartNodeProfiling(const FunctionPtr& function);
+        friend void StopNodeProfiling(const FunctionPtr& function, const std::wstring& chromeTraceFilePath);
+
         friend void ComputeInputPerDimMeansAndInvStdDevs(const MinibatchSourcePtr& minibatchSource,
                                                          std::unordered_map<StreamInfo, std::pair<NDArrayViewPtr, NDArrayViewPtr>>& computedMeanAndInvStdDevs,
                                                          const DeviceDescriptor& device /*= DeviceDescriptor::CPUDevice()*/);
@@ -437,6 +447,16 @@ namespace CNTK
                               const std::unordered_map<Variable, ValuePtr>& rootGradientValues,
                               std::unordered_map<Variable, ValuePtr>& backPropagatedGradientValuesForInputs) override;
 
+        // As Backward() above, but if 'accumulateGradients' is set, the gradients are added to the specified gradient Values instead of
+        // overwriting them, e.g. to sum the gradients of several micro-batches without copying them
+        void Backward(const BackPropStatePtr& state,
+                      const std::unordered_map<Variable, ValuePtr>& rootGradientValues,
+                      std::unordered_map<Variable, ValuePtr>& backPropagatedGradientValuesForInputs,
+                      bool accumulateGradients);
+
+        // Hands the network to the cache for a structurally identical Function, see SetComputationNetworkCacheCapacity()
+        ~CompositeFunction();
+
     private:
         virtual void ReplacePlaceholders(const std::unordered_map<Placeholder, Variable>& placeholderReplacements,
                                          std::unordered_set<const Function*>& visitedFunctions,
@@ -478,6 +498,16 @@ namespace CNTK
         template <typename ElementType>
         Microsoft::MSR::CNTK::ComputationNetworkPtr GetComputationNetwork(const DeviceDescriptor& device, const std::unordered_set<Variable>& backpropRoots);
 
+        // Describes the structure of the graph underlying 'this' Function: the Variables in the order of a traversal from the root's
+        // outputs, and for each the kind, type and shape, and for outputs the operation of the owner and the indices of its inputs.
+        // The attributes of the owner Functions are returned separately. Returns false for graphs that are not made of primitive Functions.
+        bool DescribeGraph(std::wstring& structure, std::vector<Dictionary>& attributes, std::vector<Variable>& variables) const;
+        static bool DescribeVariable(const Variable& variable, std::wstringstream& structure, std::vector<Dictionary>& attributes, std::vector<Variable>& variables, std::unordered_map<Variable, size_t>& variableIndices);
+
+        // Takes a network built for a structurally identical Function from the cache, binding it to the Variables of 'this' Function
+        template <typename ElementType>
+        bool AdoptCachedComputationNetwork(const std::unordered_set<Variable>& backpropRoots);
+
         template <typename ElementType>
         static Microsoft::MSR::CNTK::ComputationNodeBasePtr GetOutputVariableNode(const Variable& variable, Microsoft::MSR::CNTK::ComputationNetworkPtr& network, Microsoft::MSR::CNTK::ComputationNetworkBuilder<ElementType>& builder, std::unordered_map<Variable, Microsoft::MSR::CNTK::ComputationNodeBasePtr>& variableToNodeMap, std::unordered_map<Variable, bool>& isVariableRootMap);
 
@@ -486,23 +516,27 @@ namespace CNTK
 
         template <typename ElementType>
         static void PopulateComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode);
+        template <typename ElementType>
+        void BindComputationNodeValue(const std::pair<Variable, ValuePtr>& variableValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode);
         void PopulateNetworkInputs(const std::unordered_map<Variable, ValuePtr>& arguments);
 
         template <typename ElementType>
         static void PopulateComputationNodeGradient(const std::pair<Variable, ValuePtr>& variableGradient, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode);
         void PopulateNetworkGradients(const std::unordered_map<Variable, ValuePtr>& gradients);
 
-        static void GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient);
+        static void GetNodeOutputOrGradient(Variable var, ValuePtr& varValue, Microsoft::MSR::CNTK::ComputationNodeBasePtr& computationNode, bool getGradient, bool accumulate = false);
         void GetNetworkOutputs(std::unordered_map<Variable, ValuePtr>& outputs);
-        void GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients);
+        void GetNetworkGradients(std::unordered_map<Variable, ValuePtr>& gradients, bool accumulate = false);
+
+        void RecomputeBackPropState(const CNTKBackPropState& backpropState);
 
         template <typename ElementType>
         static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr> GetCNTKImplMatrixAndMBLayoutFromValueObject(Variable var, const ValuePtr& value);
 
         template <typename ElementType>
-        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true);
+        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(const NDShape& sampleShape, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true, const NDArrayViewPtr& unpackedData = nullptr);
         template <typename ElementType>
-        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(Variable var, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true);
+        static ValuePtr GetValueObjectFromCNTKImplMatrixAndMBLayout(Variable var, const Microsoft::MSR::CNTK::Matrix<ElementType>& matrix, const Microsoft::MSR::CNTK::MBLayoutPtr& layout, bool readOnly = true, const NDArrayViewPtr& unpackedData = nullptr);
 
     private:
 
@@ -518,6 +552,23 @@ namespace CNTK
 
         Microsoft::MSR::CNTK::ComputationNetworkPtr m_computationNetwork;
 
+        // The storage of the Parameter values the Parameter nodes of the network refer to; a learner may move a Parameter's value
+        // into another buffer (see SetFusedParameterUpdates()), after which the node is pointed to the new storage.
+        std::unordered_map<Variable, const void*> m_parameterValueStorage;
+
+        // The matrices the input nodes allocated themselves, for those input nodes whose value currently refers to the storage
+        // of an argument Value; they are put back when an argument cannot be used in place.
+        std::unordered_map<Microsoft::MSR::CNTK::ComputationNodeBasePtr, Microsoft::MSR::CNTK::MatrixBasePtr> m_ownInputNodeValues;
+
+        // The description of the graph the network was built for if it goes to the cache when 'this' Function is destroyed,
+        // see DescribeGraph(); the structure also includes the device, element type and backprop roots of the network.
+        std::wstring m_networkCacheStructure;
+        std::vector<Dictionary> m_networkCacheAttributes;
+        std::vector<Variable> m_networkCacheVariables;
+
+        // Whether the network records a per-node profile, see StartNodeProfiling()
+        bool m_isNodeProfilingEnabled = false;
+
         // The backpropRoots sepecified in the most recent 'Forward' call on 'this' Function.
         // This indicates for which of it's roots has 'this' Function retained required intermediate 
         // states from the previos Forward call to be able to backpropagate gradients backwards from in
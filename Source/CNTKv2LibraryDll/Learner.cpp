@@ -6,6 +6,7 @@
 #include "Learner.h"
 #include "TensorView.h"
 #include "Utils.h"
+#include <atomic>
 
 #define UPDATE_FUNCTION                                                                                       \
     switch (smoothedGradientValue->GetDataType())                                                             \
@@ -25,6 +26,23 @@ using namespace std;
 
 namespace CNTK
 {
+    static std::atomic<bool> s_fuseParameterUpdates(false);
+#ifdef _DEBUG
+    static std::atomic<bool> s_checkParameterUpdatesForNaNs(true);
+#else
+    static std::atomic<bool> s_checkParameterUpdatesForNaNs(false);
+#endif
+
+    void SetFusedParameterUpdates(bool enabled)
+    {
+        s_fuseParameterUpdates = enabled;
+    }
+
+    void SetParameterUpdateNaNChecks(bool enabled)
+    {
+        s_checkParameterUpdatesForNaNs = enabled;
+    }
+
     template <typename ElementType>
     /*static*/ shared_ptr<const Matrix<ElementType>> LearnerBase::GetMatrix(const NDArrayViewPtr& arrayView)
     {
@@ -75,7 +93,7 @@ namespace CNTK
     template <typename ElementType>
     void LearnerBase::ClipGradient(Matrix<ElementType>& gradient, size_t actualMBSize) const
     {
-        if (m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity())
+        if (m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity() && !m_additionalOptions.gradientClippingByGlobalNorm)
         {
             double maxGradientPerMB = m_additionalOptions.gradientClippingThresholdPerSample * actualMBSize;
             if (m_additionalOptions.gradientClippingWithTruncation)
@@ -93,6 +111,24 @@ namespace CNTK
         }
     }
 
+    // The norm is computed and applied on the device, see TensorView::ClipByGlobalNorm().
+    template <typename ElementType>
+    void LearnerBase::ClipGradientsByGlobalNorm(const unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t actualMBSize)
+    {
+        vector<shared_ptr<Matrix<ElementType>>> gradients;
+        for (const auto& parameter : Parameters())
+        {
+            if (parameter.GetDataType() != AsDataType<ElementType>())
+                InvalidArgument("Gradient clipping by global norm requires all parameters of a learner to have the same data type.");
+            gradients.push_back(GetWritableMatrix<ElementType>(gradientValues.at(parameter)));
+        }
+
+        if (!m_globalNormWorkspace)
+            m_globalNormWorkspace = AllocateNDArrayView(*Parameters().begin(), { 1, 1 });
+        auto maxGradientPerMB = ElementType(m_additionalOptions.gradientClippingThresholdPerSample * actualMBSize);
+        TensorView<ElementType>::ClipByGlobalNorm(gradients, maxGradientPerMB, GetWritableMatrix<ElementType>(m_globalNormWorkspace));
+    }
+
     // Performs additional preprocessing before calling the update method 
     // (gradient clipping and L2 regularization depending on the additional learning parameters).
     template <typename ElementType>
@@ -159,7 +195,8 @@ namespace CNTK
         : Learner(parameters),
         m_learningRates(learningRates),
         m_sampleCount(0),
-        m_minibatchCount(0)
+        m_minibatchCount(0),
+        m_fuseUpdates(s_fuseParameterUpdates)
     {
         for (const auto& parameter : parameters)
         {
@@ -204,45 +241,176 @@ namespace CNTK
         // make sure trainingSampleCount is a valid value
         assert(trainingSampleCount > 0);
 
+        // bind the parameters when first used, when the learner's settings and the kind of the gradients are known
+        if (m_fuseUpdates)
+            BindFusedParameters(gradientValues);
+
+        if (m_additionalOptions.gradientClippingByGlobalNorm && (m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity()))
+        {
+            switch (Parameters().begin()->GetDataType())
+            {
+            case DataType::Float:
+                ClipGradientsByGlobalNorm<float>(gradientValues, trainingSampleCount);
+                break;
+            case DataType::Double:
+                ClipGradientsByGlobalNorm<double>(gradientValues, trainingSampleCount);
+                break;
+            default:
+                NOT_IMPLEMENTED;
+            }
+        }
+
+        if (m_fusedParameter)
+        {
+            for (const auto& fusedGradientValue : m_fusedGradientValues)
+            {
+                const auto& gradientValue = gradientValues.at(fusedGradientValue.first);
+                if (gradientValue == fusedGradientValue.second)
+                    continue;
+
+                if (gradientValue->IsSparse())
+                    LogicError("The gradient of parameter %ls has become sparse, but the parameter is updated together with other parameters that have a dense gradient.", fusedGradientValue.first.Name().c_str());
+
+                fusedGradientValue.second->CopyFrom(*gradientValue);
+            }
+
+            UpdateParameter(*m_fusedParameter, m_fusedGradientValue, m_fusedSmoothedGradientValue, trainingSampleCount);
+        }
+
         for (const auto& parameter : Parameters())
         {
-            const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
-            const auto& gradientValue = gradientValues.at(parameter);
+            if (m_fusedGradientValues.find(parameter) != m_fusedGradientValues.end())
+                continue;
+
+            UpdateParameter(parameter, gradientValues.at(parameter), m_smoothedGradientValues.at(parameter), trainingSampleCount);
+        }
+        m_sampleCount += trainingSampleCount;
+        m_minibatchCount++;
+        return false;
+    }
+
+    void LearnerBase::UpdateParameter(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
 // TODO: make this a runtime parameter.
 #if DUMPOUTPUT
-            LOGPRINTF(stderr, "Update_%ls\n", parameter.Name().c_str());
+        LOGPRINTF(stderr, "Update_%ls\n", parameter.Name().c_str());
 #endif
 
-#ifdef _DEBUG
-            if (HasNan(smoothedGradientValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
-                LogicError("%ls has NaNs in smoothedGradient.", parameter.Name().c_str());
-#endif
+        if (s_checkParameterUpdatesForNaNs && HasNan(smoothedGradientValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+            LogicError("%ls has NaNs in smoothedGradient.", parameter.Name().c_str());
 
 #if DUMPOUTPUT
-            auto learningRate = ElementType(m_learningRates[m_sampleCount]);
-            auto momentum = ElementType(MomentumPerMB(m_momentums[m_sampleCount], trainingSampleCount));
-            LOGPRINTF(stderr, "learnRatePerSample=%0.8f, momentum=%0.8f, actualMBSize=%ld\n",
-                        learningRate, momentum, trainingSampleCount);
-            LOGPRINTF(stderr, "GradUpdateType()=%s, GradientUpdateNoiseStd()=%0.8f\n",
-                      LearnerType().c_str(), m_additionalOptions.gaussianNoiseInjectionStdDev);
-            Print(gradientValue, "Gradient Update");
-            Print(smoothedGradientValue, "Smoothed Gradient Input");
+        auto learningRate = ElementType(m_learningRates[m_sampleCount]);
+        auto momentum = ElementType(MomentumPerMB(m_momentums[m_sampleCount], trainingSampleCount));
+        LOGPRINTF(stderr, "learnRatePerSample=%0.8f, momentum=%0.8f, actualMBSize=%ld\n",
+                    learningRate, momentum, trainingSampleCount);
+        LOGPRINTF(stderr, "GradUpdateType()=%s, GradientUpdateNoiseStd()=%0.8f\n",
+                  LearnerType().c_str(), m_additionalOptions.gaussianNoiseInjectionStdDev);
+        Print(gradientValue, "Gradient Update");
+        Print(smoothedGradientValue, "Smoothed Gradient Input");
 #endif
-            UPDATE_FUNCTION;
+        UPDATE_FUNCTION;
 
 #if DUMPOUTPUT
-            Print(parameter.Value(), "Parameter Update");
+        Print(parameter.Value(), "Parameter Update");
 #endif
 
-#ifdef _DEBUG
-            const auto& parameterValue = parameter.Value();
-            if (HasNan(parameterValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
-                LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Name().c_str());
-#endif
+        if (s_checkParameterUpdatesForNaNs && HasNan(parameter.Value(), "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+            LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Name().c_str());
+    }
+
+    // Parameters whose update is elementwise are updated as one: their values, gradients and smoothed gradients become views
+    // into a contiguous buffer each, so that Update() runs each step of the update once instead of once per parameter.
+    // A parameter keeps its value's NDArrayView object, only the storage it views changes; Functions that are evaluated
+    // afterwards pick the new storage up (see CompositeFunction::GetComputationNetwork()).
+    // Only parameters with the data type and device of the first one and with a dense gradient are bound.
+    void LearnerBase::BindFusedParameters(const unordered_map<Parameter, NDArrayViewPtr>& gradientValues)
+    {
+        m_fuseUpdates = false; // bind once
+
+        // gradient clipping by norm is computed over the whole parameter (unless it is done over all of them before the update)
+        if (!m_additionalOptions.gradientClippingWithTruncation && (m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity()) &&
+            !m_additionalOptions.gradientClippingByGlobalNorm)
+            return;
+
+        vector<Parameter> fusedParameters;
+        for (const auto& parameter : Parameters())
+        {
+            const auto& value = parameter.Value();
+            if (!CanFuseUpdate(parameter) || value->IsSparse() || gradientValues.at(parameter)->IsSparse())
+                continue;
+
+            if (!fusedParameters.empty() && ((value->GetDataType() != fusedParameters[0].GetDataType()) || (value->Device() != fusedParameters[0].Value()->Device())))
+                continue;
+
+            fusedParameters.push_back(parameter);
         }
-        m_sampleCount += trainingSampleCount;
-        m_minibatchCount++;
-        return false;
+
+        if (fusedParameters.size() < 2)
+            return;
+
+        switch (fusedParameters[0].GetDataType())
+        {
+        case DataType::Float:
+            BindFusedParameters<float>(fusedParameters);
+            break;
+        case DataType::Double:
+            BindFusedParameters<double>(fusedParameters);
+            break;
+        default:
+            LogicError("Unsupported DataType %s", DataTypeName(fusedParameters[0].GetDataType()));
+        }
+    }
+
+    template <typename ElementType>
+    void LearnerBase::BindFusedParameters(const vector<Parameter>& parameters)
+    {
+        size_t numElements = 0;
+        for (const auto& parameter : parameters)
+            numElements += parameter.Shape().TotalSize();
+
+        auto device = parameters[0].Value()->Device();
+        NDShape fusedShape({ 1, numElements });
+        m_fusedParameter.reset(new Parameter(fusedShape, ElementType(0), device, L"fusedParameters"));
+        m_fusedGradientValue = MakeSharedObject<NDArrayView>(ElementType(0), fusedShape, device);
+        m_fusedSmoothedGradientValue = MakeSharedObject<NDArrayView>(ElementType(0), fusedShape, device);
+
+        auto fusedValues = GetWritableMatrix<ElementType>(m_fusedParameter->Value());
+        auto fusedGradients = GetWritableMatrix<ElementType>(m_fusedGradientValue);
+        auto fusedSmoothedGradients = GetWritableMatrix<ElementType>(m_fusedSmoothedGradientValue);
+
+        size_t offset = 0;
+        for (const auto& parameter : parameters)
+        {
+            const auto& value = parameter.Value();
+            auto valueMatrix = GetMatrix<ElementType>(value);
+            size_t numRows = valueMatrix->GetNumRows();
+            size_t numCols = valueMatrix->GetNumCols();
+            auto tensorShape = AsTensorShape(parameter.Shape());
+            auto viewOf = [&](const shared_ptr<Matrix<ElementType>>& fusedMatrix) {
+                return make_shared<Matrix<ElementType>>(fusedMatrix->ColumnSlice(offset, numRows * numCols).Reshaped(numRows, numCols));
+            };
+
+            auto valueView = viewOf(fusedValues);
+            valueView->SetValue(*valueMatrix);
+            value->m_tensorView = shared_ptr<void>(new TensorView<ElementType>(valueView, tensorShape), [](void* tensorView) { delete static_cast<TensorView<ElementType>*>(tensorView); });
+
+            auto smoothedGradientView = viewOf(fusedSmoothedGradients);
+            smoothedGradientView->SetValue(*GetMatrix<ElementType>(m_smoothedGradientValues.at(parameter)));
+            m_smoothedGradientValues[parameter] = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), device, StorageFormat::Dense, parameter.Shape(), false, new TensorView<ElementType>(smoothedGradientView, tensorShape));
+
+            m_fusedGradientValues[parameter] = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), device, StorageFormat::Dense, parameter.Shape(), false, new TensorView<ElementType>(viewOf(fusedGradients), tensorShape));
+
+            offset += numRows * numCols;
+        }
+
+        fprintf(stderr, "%s: %d parameters with %d elements are updated together.\n", LearnerType().c_str(), (int)parameters.size(), (int)numElements);
+    }
+
+    NDArrayViewPtr LearnerBase::GetGradientBuffer(const Parameter& parameter) const
+    {
+        auto fusedGradientValue = m_fusedGradientValues.find(parameter);
+        return (fusedGradientValue != m_fusedGradientValues.end()) ? fusedGradientValue->second : nullptr;
     }
 
     template <typename ElementType>
@@ -416,6 +584,82 @@ namespace CNTK
         smoothedGradientMatrix->FSAdagrad(trainingSampleCount, *gradientMatrix, *parameterMatrix, learningRate, momentum);
     }
 
+    LearnerAdam::LearnerAdam(const unordered_set<Parameter>& parameters,
+                             const LearningRatesPerSample& learningRates,
+                             const MomentumsPerSample& momentums,
+                             const MomentumsPerSample& varianceMomentums,
+                             double epsilon,
+                             bool layerwiseScaling)
+        : LearnerMomentumSGD(parameters, learningRates, momentums, /*allocateSmoothGradients*/ false),
+        m_varianceMomentums(varianceMomentums),
+        m_epsilon(epsilon),
+        m_layerwiseScaling(layerwiseScaling)
+    {
+        for (const auto& parameter : parameters)
+        {
+            auto shape = GetMatrixShape(parameter);
+            NDArrayViewPtr view = AllocateNDArrayView(parameter, {shape[0], 2 * shape[1]});
+            m_smoothedGradientValues.insert(make_pair(parameter, view));
+        }
+    }
+
+    /*virtual*/ void LearnerAdam::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerAdam::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameterValue);
+
+        auto learningRate = ElementType(m_learningRates[m_sampleCount]);
+        double momentumPerSample = m_momentums[m_sampleCount];
+        double varianceMomentumPerSample = m_varianceMomentums[m_sampleCount];
+
+        // the moment estimates decay per sample, so the bias corrections 1 / (1 - beta^t) count the samples of all updates, including this one
+        double numSamplesSeen = double(m_sampleCount + trainingSampleCount);
+        auto biasCorrection = [numSamplesSeen](double betaPerSample) { return betaPerSample < 1 ? 1.0 / (1.0 - pow(betaPerSample, numSamplesSeen)) : 1.0; };
+
+        // (clipping and L2 regularization are applied by PreProcess())
+        smoothedGradientMatrix->Adam(*gradientMatrix, *parameterMatrix, learningRate,
+                                     ElementType(MomentumPerMB(momentumPerSample, trainingSampleCount)),
+                                     ElementType(MomentumPerMB(varianceMomentumPerSample, trainingSampleCount)),
+                                     ElementType(m_epsilon),
+                                     ElementType(biasCorrection(momentumPerSample)), ElementType(biasCorrection(varianceMomentumPerSample)),
+                                     numeric_limits<ElementType>::infinity(), /*l2RegWeight=*/ElementType(0), m_layerwiseScaling);
+    }
+
+    LearnerLARS::LearnerLARS(const unordered_set<Parameter>& parameters,
+                             const LearningRatesPerSample& learningRates,
+                             const MomentumsPerSample& momentums,
+                             double trustCoefficient)
+        : LearnerMomentumSGD(parameters, learningRates, momentums),
+        m_trustCoefficient(trustCoefficient)
+    {
+    }
+
+    /*virtual*/ void LearnerLARS::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
+    {
+        UPDATE_FUNCTION;
+    }
+
+    template <typename ElementType>
+    void LearnerLARS::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientMatrix = GetWritableMatrix<ElementType>(smoothedGradientValue);
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameterValue);
+
+        auto learningRate = ElementType(m_learningRates[m_sampleCount]);
+        auto momentum = ElementType(MomentumPerMB(m_momentums[m_sampleCount], trainingSampleCount));
+        smoothedGradientMatrix->Lars(*gradientMatrix, *parameterMatrix, learningRate, momentum, m_useNesterovAcceleration, m_trustCoefficient);
+    }
+
     LearnerRMSProp::LearnerRMSProp(const unordered_set<Parameter>& parameters, const LearningRatesPerSample& learningRates,
                                    double gamma, double inc, double dec, double max, double min, bool needAveMultiplier)
                                    : LearnerBase(parameters, learningRates, /*allocateSmoothGradients*/ false),
@@ -492,6 +736,17 @@ namespace CNTK
         return MakeSharedObject<LearnerFSAdaGrad>(parameters, learningRates, momentums);
     }
 
+    LearnerPtr AdamLearner(const unordered_set<Parameter>& parameters, const LearningRatesPerSample& learningRates, const MomentumsPerSample& momentums,
+                           const MomentumsPerSample& varianceMomentums, double epsilon, bool layerwiseScaling)
+    {
+        return MakeSharedObject<LearnerAdam>(parameters, learningRates, momentums, varianceMomentums, epsilon, layerwiseScaling);
+    }
+
+    LearnerPtr LARSLearner(const unordered_set<Parameter>& parameters, const LearningRatesPerSample& learningRates, const MomentumsPerSample& momentums, double trustCoefficient)
+    {
+        return MakeSharedObject<LearnerLARS>(parameters, learningRates, momentums, trustCoefficient);
+    }
+
     LearnerPtr RMSPropLearner(const unordered_set<Parameter>& parameters, const LearningRatesPerSample& learningRates,
                               double gamma, double inc, double dec, double max, double min, 
                               bool needAveMultiplier)
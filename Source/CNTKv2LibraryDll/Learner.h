@@ -19,6 +19,7 @@ namespace CNTK
         double gaussianNoiseInjectionStdDev = 0.0;
         bool gradientClippingWithTruncation = true;
         double gradientClippingThresholdPerSample = std::numeric_limits<double>::infinity();
+        bool gradientClippingByGlobalNorm = false; // clip the norm of all gradients together instead of each one's
     };
 
     // An abstract base class at the root of the standard learners hierarchy
@@ -33,6 +34,10 @@ namespace CNTK
 
         virtual void RestoreFromCheckpoint(const Dictionary& checkpoint) override final;
 
+        // Returns the buffer the gradient of the parameter is expected in if it is updated together with other parameters,
+        // or nullptr. Passing that buffer to Update() saves copying the gradient.
+        NDArrayViewPtr GetGradientBuffer(const Parameter& parameter) const;
+
     protected:
         LearnerBase(const std::unordered_set<Parameter>& parameters, 
                     const LearningRatesPerSample& learningRates,
@@ -40,6 +45,10 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const = 0;
 
+        // Whether the update of the parameter is elementwise, with a smoothed gradient of the parameter's shape,
+        // so that it can be applied to many parameters at once (see SetFusedParameterUpdates()).
+        virtual bool CanFuseUpdate(const Parameter& /*parameter*/) const { return false; }
+
         std::string LearnerType() const;
 
         LearningRatesPerSample m_learningRates;
@@ -91,11 +100,33 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        void UpdateParameter(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // Moves the parameters whose update can be fused into one contiguous buffer, see SetFusedParameterUpdates().
+        void BindFusedParameters(const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues);
+
+        template <typename ElementType>
+        void BindFusedParameters(const std::vector<Parameter>& parameters);
+
+        // Clips the norm of all gradients together, before any of them is used for an update.
+        template <typename ElementType>
+        void ClipGradientsByGlobalNorm(const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t actualMBSize);
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
 
         static const size_t checkpointVersion = 1;
+
+        // Fused update: the values, gradients and smoothed gradients of the fused parameters are views into the
+        // [1 x N] buffers of m_fusedParameter, m_fusedGradientValue and m_fusedSmoothedGradientValue.
+        bool m_fuseUpdates;
+        std::unique_ptr<Parameter> m_fusedParameter;
+        NDArrayViewPtr m_fusedGradientValue;
+        NDArrayViewPtr m_fusedSmoothedGradientValue;
+        std::unordered_map<Parameter, NDArrayViewPtr> m_fusedGradientValues;
+
+        NDArrayViewPtr m_globalNormWorkspace; // [1 x 1], see ClipGradientsByGlobalNorm()
     };
 
     // Vanilla gradient descent optimization algorithm.
@@ -117,6 +148,8 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        virtual bool CanFuseUpdate(const Parameter& /*parameter*/) const override { return true; }
+
         // TODO: Move m_momentums to LearnerMomentumSGD as soon as NormalGrad is refactored.
         MomentumsPerSample m_momentums;
         bool m_useNesterovAcceleration;
@@ -165,6 +198,9 @@ namespace CNTK
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the average multiplier is computed over the whole parameter
+        virtual bool CanFuseUpdate(const Parameter& /*parameter*/) const override { return !m_needAveMultiplier; }
     };
 
     class LearnerFSAdaGrad : public LearnerMomentumSGD
@@ -181,6 +217,57 @@ namespace CNTK
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the smoothed gradient has twice the columns of the parameter
+        virtual bool CanFuseUpdate(const Parameter& /*parameter*/) const override { return false; }
+    };
+
+    // Adam, or LAMB with layerwiseScaling (the step is scaled by ||w|| / ||step|| per parameter).
+    class LearnerAdam : public LearnerMomentumSGD
+    {
+    public:
+
+        LearnerAdam(const std::unordered_set<Parameter>& parameters,
+                    const LearningRatesPerSample& learningRates,
+                    const MomentumsPerSample& momentums,
+                    const MomentumsPerSample& varianceMomentums,
+                    double epsilon,
+                    bool layerwiseScaling);
+
+    protected:
+        MomentumsPerSample m_varianceMomentums;
+        double m_epsilon;
+        bool m_layerwiseScaling;
+
+        virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the smoothed gradient has twice the columns of the parameter
+        virtual bool CanFuseUpdate(const Parameter& /*parameter*/) const override { return false; }
+    };
+
+    // Momentum SGD with the learning rate scaled by trustCoefficient * ||w|| / ||g|| per parameter (LARS).
+    class LearnerLARS : public LearnerMomentumSGD
+    {
+    public:
+
+        LearnerLARS(const std::unordered_set<Parameter>& parameters,
+                    const LearningRatesPerSample& learningRates,
+                    const MomentumsPerSample& momentums,
+                    double trustCoefficient);
+
+    protected:
+        double m_trustCoefficient;
+
+        virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
+
+        template <typename ElementType>
+        void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
+
+        // the norms are computed over the whole parameter
+        virtual bool CanFuseUpdate(const Parameter& /*parameter*/) const override { return false; }
     };
 
     class LearnerRMSProp : public LearnerBase
@@ -24,7 +24,8 @@ namespace CNTK
     }
 
     CompositeMinibatchSource::CompositeMinibatchSource(const Dictionary& configuration)
-        : m_epochEndReached(false), m_prevMinibatchSize(0), m_epochSize(SIZE_MAX)
+        : m_epochEndReached(false), m_prevMinibatchSize(0), m_epochSize(SIZE_MAX), m_numWorkers(1), m_workerRank(0),
+          m_prefetchDepth(0), m_prefetchDevice(DeviceDescriptor::CPUDevice()), m_stopPrefetching(false)
     {
         ConfigParameters config;
         std::wstringstream s;
@@ -40,6 +41,24 @@ namespace CNTK
         if (m_epochSize == 0)
             m_epochSize = Microsoft::MSR::CNTK::requestDataSize;
 
+        // For distributed training, each worker reads its own share of every epoch, see DistributedTrainer
+        const wchar_t* numWorkersConfigurationKey = L"numWorkers";
+        const wchar_t* workerRankConfigurationKey = L"workerRank";
+        if (configuration.Contains(numWorkersConfigurationKey))
+            m_numWorkers = configuration[numWorkersConfigurationKey].GetValue<size_t>();
+
+        if (configuration.Contains(workerRankConfigurationKey))
+            m_workerRank = configuration[workerRankConfigurationKey].GetValue<size_t>();
+
+        if ((m_numWorkers == 0) || (m_workerRank >= m_numWorkers))
+            InvalidArgument("CompositeMinibatchSource: workerRank (%d) must be less than numWorkers (%d)", (int)m_workerRank, (int)m_numWorkers);
+
+        // Number of minibatches that are read and transferred to the device ahead on a background thread; 0 reads them
+        // on the thread that calls GetNextMinibatch
+        const wchar_t* prefetchDepthConfigurationKey = L"prefetchDepth";
+        if (configuration.Contains(prefetchDepthConfigurationKey))
+            m_prefetchDepth = configuration[prefetchDepthConfigurationKey].GetValue<size_t>();
+
         typedef Reader*(*CreateCompositeDataReaderProc)(const ConfigParameters* parameters);
         CreateCompositeDataReaderProc createReaderProc = (CreateCompositeDataReaderProc)Plugin().Load(L"CompositeDataReader", "CreateCompositeDataReader");
         m_compositeDataReader.reset(createReaderProc(&config));
@@ -49,6 +68,19 @@ namespace CNTK
             m_streamInfos.insert({ streamDesc->m_name, streamDesc->m_id, AsStorageFormat(streamDesc->m_storageType), AsDataType(streamDesc->m_elementType), AsNDShape(*(streamDesc->m_sampleLayout)) });
     }
 
+    CompositeMinibatchSource::~CompositeMinibatchSource()
+    {
+        if (m_prefetchThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_prefetchLock);
+                m_stopPrefetching = true;
+            }
+            m_prefetchNotFull.notify_one();
+            m_prefetchThread.join();
+        }
+    }
+
     /*virtual*/ std::unordered_map<StreamInfo, MinibatchData> CompositeMinibatchSource::GetNextMinibatch(const std::unordered_map<StreamInfo, std::pair<size_t, size_t>>& perStreamMBSizeLimits,
                                                                                                          const DeviceDescriptor& device /*= DeviceDescriptor::DefaultDevice()*/) /*override*/
     {
@@ -80,8 +112,7 @@ namespace CNTK
 
             if (m_prevMinibatchSize == 0)
             {
-                // TODO: Add support for distributed reading
-                EpochConfiguration epochConfig = { 1, 0, requestedMinibatchSizeInSamples, m_epochSize, 0, 0 };
+                EpochConfiguration epochConfig = { m_numWorkers, m_workerRank, requestedMinibatchSizeInSamples, m_epochSize, 0, 0 };
                 m_compositeDataReader->StartEpoch(epochConfig);
                 m_prevMinibatchSize = requestedMinibatchSizeInSamples;
             }
@@ -89,49 +120,129 @@ namespace CNTK
             if (requestedMinibatchSizeInSamples != m_prevMinibatchSize)
                 LogicError("GetNextMinibatch: Changing minibatch sizes across calls is currently unsupported");
 
-            auto compositeReaderMinibatchData = m_compositeDataReader->ReadMinibatch();
-            m_epochEndReached = compositeReaderMinibatchData.m_endOfEpoch;
+            if (m_prefetchDepth == 0)
+                return ReadMinibatch(perStreamMBSizeLimits, device, m_epochEndReached);
 
-            auto compositeDataReaderStreamDescs = m_compositeDataReader->GetStreamDescriptions();
-            size_t numStreams = compositeDataReaderStreamDescs.size();
-            for (size_t i = 0; i < numStreams; ++i)
+            if (!m_prefetchThread.joinable())
             {
-                auto currentStreamDesc = compositeDataReaderStreamDescs[i];
-                auto iter = std::find_if(perStreamMBSizeLimits.begin(), perStreamMBSizeLimits.end(), [currentStreamDesc](const std::pair<StreamInfo, std::pair<size_t, size_t>>& entry) {
-                    return entry.first.m_id == currentStreamDesc->m_id;
-                });
+                m_prefetchStreams = perStreamMBSizeLimits;
+                m_prefetchDevice = device;
+                m_prefetchThread = std::thread([this]() { PrefetchMinibatches(); });
+            }
 
-                if (iter == perStreamMBSizeLimits.end())
-                    continue;
+            if (device != m_prefetchDevice)
+                LogicError("GetNextMinibatch: Changing the device across calls is currently unsupported when prefetching");
 
-                auto& currentStreamInfo = iter->first;
-                auto sampleShape = AsNDShape(*(currentStreamDesc->m_sampleLayout));
+            for (const auto& val : perStreamMBSizeLimits)
+            {
+                if (m_prefetchStreams.find(val.first) == m_prefetchStreams.end())
+                    LogicError("GetNextMinibatch: Requesting streams that the first call did not request is currently unsupported when prefetching");
+            }
 
-                ValuePtr minibatchValuePtr;
-                if (compositeReaderMinibatchData.m_data.empty())
-                {
-                    minibatchValuePtr = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(currentStreamInfo.m_elementType, sampleShape.AppendShape({ 0, 0 }), DeviceDescriptor::CPUDevice()));
-                    continue;
-                }
+            PrefetchedMinibatch prefetchedMinibatch;
+            {
+                std::unique_lock<std::mutex> lock(m_prefetchLock);
+                m_prefetchNotEmpty.wait(lock, [this]() { return !m_prefetchQueue.empty(); });
+                prefetchedMinibatch = std::move(m_prefetchQueue.front());
+                m_prefetchQueue.pop_front();
+            }
+            m_prefetchNotFull.notify_one();
 
-                auto currentStreamMinibatchData = compositeReaderMinibatchData.m_data[i];
-                if (currentStreamDesc->m_elementType == ElementType::tfloat)
-                {
-                    auto dataMatrix = std::make_shared<Matrix<float>>(CPUDEVICE);
-                    size_t sampleSize = currentStreamDesc->m_sampleLayout->GetNumElements();
+            if (prefetchedMinibatch.m_error)
+                std::rethrow_exception(prefetchedMinibatch.m_error);
 
-                    // TODO: Eliminate the unnecessary CPU to CPU copy
-                    ReaderShim<float>::FillMatrixFromStream(currentStreamDesc->m_storageType, dataMatrix.get(), sampleSize, currentStreamMinibatchData);
-                    minibatchValuePtr = CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(sampleShape, *dataMatrix, currentStreamMinibatchData->m_layout, false);
+            m_epochEndReached = prefetchedMinibatch.m_endOfEpoch;
+            for (const auto& val : perStreamMBSizeLimits)
+            {
+                auto iter = prefetchedMinibatch.m_data.find(val.first);
+                if (iter != prefetchedMinibatch.m_data.end())
+                    minibatchData.insert(*iter);
+            }
+        }
 
-                    size_t numSamples = currentStreamMinibatchData->m_layout->GetActualNumSamples();
-                    size_t numSequences = currentStreamMinibatchData->m_layout->GetNumSequences();
+        return minibatchData;
+    }
 
-                    minibatchData[currentStreamInfo] = { numSequences, numSamples, minibatchValuePtr };
-                }
-                else
-                    LogicError("Input data of type other than DataType::Float is currently unsupported by the CNTK built-in composite MinibatchSource!");
+    void CompositeMinibatchSource::PrefetchMinibatches()
+    {
+        bool endOfEpoch = false;
+        while (!endOfEpoch)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_prefetchLock);
+                m_prefetchNotFull.wait(lock, [this]() { return m_stopPrefetching || (m_prefetchQueue.size() < m_prefetchDepth); });
+                if (m_stopPrefetching)
+                    return;
             }
+
+            PrefetchedMinibatch prefetchedMinibatch;
+            try
+            {
+                prefetchedMinibatch.m_data = ReadMinibatch(m_prefetchStreams, m_prefetchDevice, endOfEpoch);
+                prefetchedMinibatch.m_endOfEpoch = endOfEpoch;
+            }
+            catch (...)
+            {
+                prefetchedMinibatch.m_error = std::current_exception();
+                endOfEpoch = true;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_prefetchLock);
+                m_prefetchQueue.push_back(std::move(prefetchedMinibatch));
+            }
+            m_prefetchNotEmpty.notify_one();
+        }
+    }
+
+    std::unordered_map<StreamInfo, MinibatchData> CompositeMinibatchSource::ReadMinibatch(const std::unordered_map<StreamInfo, std::pair<size_t, size_t>>& perStreamMBSizeLimits,
+                                                                                          const DeviceDescriptor& device, bool& endOfEpoch)
+    {
+        auto compositeReaderMinibatchData = m_compositeDataReader->ReadMinibatch();
+        endOfEpoch = compositeReaderMinibatchData.m_endOfEpoch;
+
+        std::unordered_map<StreamInfo, MinibatchData> minibatchData;
+
+        auto compositeDataReaderStreamDescs = m_compositeDataReader->GetStreamDescriptions();
+        size_t numStreams = compositeDataReaderStreamDescs.size();
+        for (size_t i = 0; i < numStreams; ++i)
+        {
+            auto currentStreamDesc = compositeDataReaderStreamDescs[i];
+            auto iter = std::find_if(perStreamMBSizeLimits.begin(), perStreamMBSizeLimits.end(), [currentStreamDesc](const std::pair<StreamInfo, std::pair<size_t, size_t>>& entry) {
+                return entry.first.m_id == currentStreamDesc->m_id;
+            });
+
+            if (iter == perStreamMBSizeLimits.end())
+                continue;
+
+            auto& currentStreamInfo = iter->first;
+            auto sampleShape = AsNDShape(*(currentStreamDesc->m_sampleLayout));
+
+            ValuePtr minibatchValuePtr;
+            if (compositeReaderMinibatchData.m_data.empty())
+            {
+                minibatchValuePtr = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(currentStreamInfo.m_elementType, sampleShape.AppendShape({ 0, 0 }), DeviceDescriptor::CPUDevice()));
+                continue;
+            }
+
+            auto currentStreamMinibatchData = compositeReaderMinibatchData.m_data[i];
+            if (currentStreamDesc->m_elementType == ElementType::tfloat)
+            {
+                // The data is transferred to the requested device right away
+                auto dataMatrix = std::make_shared<Matrix<float>>(AsCNTKImplDeviceId(device));
+                size_t sampleSize = currentStreamDesc->m_sampleLayout->GetNumElements();
+
+                // TODO: Eliminate the unnecessary CPU to CPU copy
+                ReaderShim<float>::FillMatrixFromStream(currentStreamDesc->m_storageType, dataMatrix.get(), sampleSize, currentStreamMinibatchData);
+                minibatchValuePtr = CompositeFunction::GetValueObjectFromCNTKImplMatrixAndMBLayout<float>(sampleShape, *dataMatrix, currentStreamMinibatchData->m_layout, false);
+
+                size_t numSamples = currentStreamMinibatchData->m_layout->GetActualNumSamples();
+                size_t numSequences = currentStreamMinibatchData->m_layout->GetNumSequences();
+
+                minibatchData[currentStreamInfo] = { numSequences, numSamples, minibatchValuePtr };
+            }
+            else
+                LogicError("Input data of type other than DataType::Float is currently unsupported by the CNTK built-in composite MinibatchSource!");
         }
 
         return minibatchData;
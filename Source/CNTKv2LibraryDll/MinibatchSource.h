@@ -9,6 +9,11 @@
 #include "CNTKLibrary.h"
 #include "Utils.h"
 #include "Reader.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace CNTK
 {
@@ -16,6 +21,7 @@ namespace CNTK
     {
     public:
         CompositeMinibatchSource(const Dictionary& configuration);
+        ~CompositeMinibatchSource();
 
         virtual const std::unordered_set<StreamInfo>& StreamInfos() override { return m_streamInfos; }
 
@@ -23,10 +29,35 @@ namespace CNTK
                                                                                const DeviceDescriptor& device = DeviceDescriptor::DefaultDevice()) override;
 
     private: 
+        struct PrefetchedMinibatch
+        {
+            std::unordered_map<StreamInfo, MinibatchData> m_data;
+            bool m_endOfEpoch = false;
+            std::exception_ptr m_error;
+        };
+
+        std::unordered_map<StreamInfo, MinibatchData> ReadMinibatch(const std::unordered_map<StreamInfo, std::pair<size_t, size_t>>& perStreamMBSizeLimits,
+                                                                    const DeviceDescriptor& device, bool& endOfEpoch);
+
+        // Body of the prefetch thread: reads the minibatches of the epoch into m_prefetchQueue, at most m_prefetchDepth ahead
+        void PrefetchMinibatches();
+
         std::unordered_set<StreamInfo> m_streamInfos;
         std::shared_ptr<Microsoft::MSR::CNTK::Reader> m_compositeDataReader;
         bool m_epochEndReached;
         size_t m_prevMinibatchSize;
         size_t m_epochSize;
+        size_t m_numWorkers;
+        size_t m_workerRank;
+
+        size_t m_prefetchDepth;
+        std::unordered_map<StreamInfo, std::pair<size_t, size_t>> m_prefetchStreams; // streams and device of the first call
+        DeviceDescriptor m_prefetchDevice;
+        std::thread m_prefetchThread;
+        std::mutex m_prefetchLock;
+        std::condition_variable m_prefetchNotFull;
+        std::condition_variable m_prefetchNotEmpty;
+        std::deque<PrefetchedMinibatch> m_prefetchQueue;
+        bool m_stopPrefetching;
     };
 }
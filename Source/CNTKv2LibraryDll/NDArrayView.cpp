@@ -8,7 +8,12 @@
 #include "Utils.h"
 #include "TensorView.h"
 #include "Matrix.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "MatrixQuantizerImpl.h"
 #include <algorithm>
+#include <future>
+#include <mutex>
 #include "TensorShape.h"
 
 using namespace Microsoft::MSR::CNTK;
@@ -81,6 +86,54 @@ namespace CNTK
         }
     }
 
+    // Whether the elements of a dense tensor are stored contiguously in column-major order; the strides of axes of dimension 1 do not matter
+    static bool IsContiguous(const TensorShape& tensorShape)
+    {
+        ptrdiff_t expectedStride = 1;
+        for (size_t k = 0; k < tensorShape.GetRank(); ++k)
+        {
+            if ((tensorShape[k] != 1) && (tensorShape.GetStrides()[k] != expectedStride))
+                return false;
+
+            expectedStride *= (ptrdiff_t)tensorShape[k];
+        }
+
+        return true;
+    }
+
+    // Whether a view cannot be expressed as a Matrix and has to be accessed element by element through its TensorView
+    template <typename ElementType>
+    static bool IsStrided(const NDArrayView& view, const TensorView<ElementType>& tensorView)
+    {
+        return !view.IsSparse() && !IsContiguous(tensorView.GetShape());
+    }
+
+    // A TensorView of the specified rank over a single element, which broadcasts the element along all axes
+    template <typename ElementType>
+    static TensorView<ElementType> ScalarTensorView(ElementType value, size_t rank, const DeviceDescriptor& device)
+    {
+        auto matrix = std::make_shared<Matrix<ElementType>>(1, 1, AsCNTKImplDeviceId(device));
+        matrix->SetValue(value);
+        return TensorView<ElementType>(matrix, TensorShape(SmallVector<size_t>(rank, 1)));
+    }
+
+    // Creates a TensorView over the storage of 'tensorView' with the specified shape. A contiguous view is given the canonical
+    // column-major layout over a Matrix that references exactly its elements, so that it can always be used as a Matrix.
+    template <typename ElementType>
+    static TensorView<ElementType>* AllocateTensorView(const TensorView<ElementType>& tensorView, const TensorShape& newTensorShape, const NDShape& viewShape)
+    {
+        if (!IsContiguous(newTensorShape))
+            return new TensorView<ElementType>(tensorView, newTensorShape);
+
+        if (newTensorShape.GetOffset() == 0)
+            return new TensorView<ElementType>(tensorView, AsTensorShape(viewShape));
+
+        const auto& sob = tensorView.GetSOB();
+        auto matrixDims = GetMatrixDimensions(viewShape);
+        auto matrix = std::make_shared<Matrix<ElementType>>(sob.Reshaped(1, sob.GetNumElements()).ColumnSlice(newTensorShape.GetOffset(), viewShape.TotalSize()).Reshaped(matrixDims.first, matrixDims.second));
+        return new TensorView<ElementType>(matrix, AsTensorShape(viewShape));
+    }
+
     NDArrayView::NDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const DeviceDescriptor& device, bool readOnly/* = false*/)
         : NDArrayView(dataType, device, StorageFormat::Dense, viewShape, readOnly, AllocateTensorView(dataType, viewShape, device, dataBuffer, bufferSizeInBytes))
     {
@@ -131,7 +184,11 @@ namespace CNTK
         if (IsSparse())
             LogicError("Filling a NDArrayView with a scalar is only allowed for NDArrayView objects with dense storage format");
 
-        GetWritableMatrix<float>()->SetValue(value);
+        auto tensorView = GetWritableTensorView<float>();
+        if (IsStrided(*this, *tensorView))
+            tensorView->AssignCopyOf(ScalarTensorView<float>(value, tensorView->GetShape().GetRank(), m_device));
+        else
+            GetWritableMatrix<float>()->SetValue(value);
     }
 
     void NDArrayView::SetValue(double value)
@@ -139,7 +196,11 @@ namespace CNTK
         if (IsSparse())
             LogicError("Filling a NDArrayView with a scalar is only allowed for NDArrayView objects with dense storage format");
 
-        GetWritableMatrix<double>()->SetValue(value);
+        auto tensorView = GetWritableTensorView<double>();
+        if (IsStrided(*this, *tensorView))
+            tensorView->AssignCopyOf(ScalarTensorView<double>(value, tensorView->GetShape().GetRank(), m_device));
+        else
+            GetWritableMatrix<double>()->SetValue(value);
     }
 
     template <typename ElementType>
@@ -185,13 +246,22 @@ namespace CNTK
     template <typename ElementType>
     std::shared_ptr<const Matrix<ElementType>> NDArrayView::GetMatrix(size_t rowColSplitPoint/* = AutoSelectRowColSplitPoint*/) const
     {
-        return GetMatrixImpl<ElementType>(GetTensorView<ElementType>(), rowColSplitPoint);
+        // A strided view cannot be expressed as a Matrix; it is read through a contiguous copy of its elements instead
+        auto tensorView = GetTensorView<ElementType>();
+        if (IsStrided(*this, *tensorView))
+            return GetMatrixImpl<ElementType>(DeepClone()->GetTensorView<ElementType>(), rowColSplitPoint);
+
+        return GetMatrixImpl<ElementType>(tensorView, rowColSplitPoint);
     }
 
     template <typename ElementType>
     std::shared_ptr<Matrix<ElementType>> NDArrayView::GetWritableMatrix(size_t rowColSplitPoint/* = AutoSelectRowColSplitPoint*/)
     {
-        return GetMatrixImpl<ElementType>(GetWritableTensorView<ElementType>(), rowColSplitPoint);
+        auto tensorView = GetWritableTensorView<ElementType>();
+        if (IsStrided(*this, *tensorView))
+            LogicError("NDArrayView::GetWritableMatrix: A strided NDArrayView of shape %s cannot be written through a Matrix", AsString(Shape()).c_str());
+
+        return GetMatrixImpl<ElementType>(tensorView, rowColSplitPoint);
     }
 
     template <typename ElementType>
@@ -215,27 +285,7 @@ namespace CNTK
     NDArrayViewPtr NDArrayView::DeepClone(bool readOnly/* = false*/) const
     {
         NDArrayViewPtr newView = MakeSharedObject<NDArrayView>(this->GetDataType(), this->GetStorageFormat(), this->Shape(), this->Device());
-        switch (m_dataType)
-        {
-        case DataType::Float:
-        {
-            auto newMatrix = newView->GetWritableMatrix<float>();
-            auto thisMatrix = GetMatrix<float>();
-            newMatrix->AssignValuesOf(*thisMatrix);
-            break;
-        }
-        case DataType::Double:
-        {
-            auto newMatrix = newView->GetWritableMatrix<double>();
-            auto thisMatrix = GetMatrix<double>();
-            newMatrix->AssignValuesOf(*thisMatrix);
-            break;
-        }
-        default:
-            LogicError("Unsupported DataType %s", DataTypeName(m_dataType));
-            break;
-        }
-
+        newView->CopyFrom(*this);
         newView->m_isReadOnly = readOnly;
         return newView;
     }
@@ -248,10 +298,30 @@ namespace CNTK
         if (IsReadOnly())
             RuntimeError("NDArrayView::CopyFrom: Cannot modify contents of a readonly NDArrayView");
 
+        // Strided views are copied element by element through their TensorViews, which cannot copy across devices;
+        // a strided view is therefore copied to or from another device through a contiguous copy
+        bool isSourceStrided = !source.IsSparse() && !IsContiguous(source.GetTensorShape());
+        bool isStrided = !IsSparse() && !IsContiguous(GetTensorShape());
+        if ((isSourceStrided || isStrided) && (source.Device() != Device()))
+        {
+            if (isSourceStrided)
+                return CopyFrom(*source.DeepClone());
+
+            auto sourceOnThisDevice = MakeSharedObject<NDArrayView>(GetDataType(), Shape(), Device());
+            sourceOnThisDevice->CopyFrom(source);
+            return CopyFrom(*sourceOnThisDevice);
+        }
+
         switch (m_dataType)
         {
         case DataType::Float:
         {
+            if (isSourceStrided || isStrided)
+            {
+                GetWritableTensorView<float>()->AssignCopyOf(*source.GetTensorView<float>());
+                break;
+            }
+
             auto sourceMatrix = source.GetMatrix<float>();
             auto destMatrix = GetWritableMatrix<float>();
             destMatrix->AssignValuesOf(*sourceMatrix);
@@ -259,6 +329,12 @@ namespace CNTK
         }
         case DataType::Double:
         {
+            if (isSourceStrided || isStrided)
+            {
+                GetWritableTensorView<double>()->AssignCopyOf(*source.GetTensorView<double>());
+                break;
+            }
+
             auto sourceMatrix = source.GetMatrix<double>();
             auto destMatrix = GetWritableMatrix<double>();
             destMatrix->AssignValuesOf(*sourceMatrix);
@@ -270,6 +346,90 @@ namespace CNTK
         }
     }
 
+    // Page-locked host buffer and transferer of an asynchronous copy from a GPU; kept for reuse by later copies once the copy has completed,
+    // since allocating page-locked memory is expensive
+    template <typename ElementType>
+    struct AsyncGPUToCPUCopyStaging
+    {
+        int m_deviceId;
+        size_t m_numElements;
+        std::shared_ptr<ElementType> m_buffer;
+        std::unique_ptr<GPUDataTransferer<ElementType>> m_transferer;
+    };
+
+    template <typename ElementType>
+    class AsyncGPUToCPUCopyStagingPool
+    {
+    public:
+        static std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>> Acquire(int deviceId, size_t numElements)
+        {
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                auto& freeStagings = FreeStagings();
+                auto staging = std::find_if(freeStagings.begin(), freeStagings.end(), [deviceId, numElements](const std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>>& staging) {
+                    return (staging->m_deviceId == deviceId) && (staging->m_numElements >= numElements);
+                });
+
+                if (staging != freeStagings.end())
+                {
+                    auto result = std::move(*staging);
+                    freeStagings.erase(staging);
+                    return result;
+                }
+            }
+
+            std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>> staging(new AsyncGPUToCPUCopyStaging<ElementType>());
+            staging->m_deviceId = deviceId;
+            staging->m_numElements = numElements;
+            staging->m_buffer = std::shared_ptr<ElementType>((ElementType*)CUDAPageLockedMemAllocator::Malloc(numElements * sizeof(ElementType), deviceId), [deviceId](ElementType* p) {
+                CUDAPageLockedMemAllocator::Free(p, deviceId);
+            });
+            staging->m_transferer.reset(new GPUDataTransferer<ElementType>(deviceId, true /*useConcurrentStreams*/));
+            return staging;
+        }
+
+        static void Release(std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>>&& staging)
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            FreeStagings().push_back(std::move(staging));
+        }
+
+    private:
+        // Deliberately never destroyed, since freeing page-locked memory fails once CUDA has shut down at process exit
+        static std::vector<std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>>>& FreeStagings()
+        {
+            static auto freeStagings = new std::vector<std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>>>();
+            return *freeStagings;
+        }
+
+        static std::mutex s_mutex;
+    };
+
+    template <typename ElementType>
+    std::mutex AsyncGPUToCPUCopyStagingPool<ElementType>::s_mutex;
+
+    // Queues the copy of a GPU matrix into a page-locked buffer on the fetch stream, behind the computations queued on the
+    // compute stream so far, and completes it into the CPU matrix on a separate thread once the data has arrived
+    template <typename ElementType>
+    static std::future<void> CopyGPUToCPUAsync(const std::shared_ptr<const Matrix<ElementType>>& source, const std::shared_ptr<Matrix<ElementType>>& destination)
+    {
+        int deviceId = source->GetDeviceId();
+        size_t numElements = source->GetNumElements();
+        auto staging = AsyncGPUToCPUCopyStagingPool<ElementType>::Acquire(deviceId, numElements);
+
+        std::unique_ptr<MatrixComputeStreamEvent> computeStreamEvent(MatrixComputeStreamEvent::Create(deviceId));
+        computeStreamEvent->SynchronizeDataTransferFetchStreamWithEvent<ElementType>();
+        staging->m_transferer->CopyGPUToCPUAsync(const_cast<ElementType*>(source->Data()), numElements, staging->m_buffer.get());
+
+        auto pendingStaging = std::make_shared<std::unique_ptr<AsyncGPUToCPUCopyStaging<ElementType>>>(std::move(staging));
+        return std::async(std::launch::async, [source, destination, numElements, pendingStaging]() {
+            auto& staging = *pendingStaging;
+            staging->m_transferer->WaitForCopyGPUToCPUAsync();
+            memcpy(destination->Data(), staging->m_buffer.get(), numElements * sizeof(ElementType));
+            AsyncGPUToCPUCopyStagingPool<ElementType>::Release(std::move(staging));
+        });
+    }
+
     NDArrayViewPtr NDArrayView::Alias(bool readOnly/* = false*/) const
     {
         void* tensorView = nullptr;
@@ -289,6 +449,115 @@ namespace CNTK
         return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), Shape(), IsReadOnly() || readOnly, tensorView);
     }
 
+    std::future<void> NDArrayView::CopyFromAsync(const NDArrayView& source)
+    {
+        if (source.Shape() != Shape())
+            InvalidArgument("NDArrayView::CopyFromAsync: The 'source' view's shape must be same as the shape of this NDArrayView");
+
+        if (IsReadOnly())
+            RuntimeError("NDArrayView::CopyFromAsync: Cannot modify contents of a readonly NDArrayView");
+
+        // Only the readback of dense data from a GPU into a plain CPU buffer is overlapped; anything else is copied right away
+        bool isAsync = (source.Device().Type() == DeviceKind::GPU) && (Device().Type() == DeviceKind::CPU) &&
+                       !source.IsSparse() && !IsSparse() && IsContiguous(GetTensorShape()) && (source.GetDataType() == GetDataType());
+        if (!isAsync)
+        {
+            CopyFrom(source);
+            std::promise<void> completed;
+            completed.set_value();
+            return completed.get_future();
+        }
+
+        switch (m_dataType)
+        {
+        case DataType::Float:
+            return CopyGPUToCPUAsync<float>(source.GetMatrix<float>(), GetWritableMatrix<float>());
+        case DataType::Double:
+            return CopyGPUToCPUAsync<double>(source.GetMatrix<double>(), GetWritableMatrix<double>());
+        default:
+            LogicError("Unsupported DataType %s", DataTypeName(m_dataType));
+        }
+    }
+
+    const TensorShape& NDArrayView::GetTensorShape() const
+    {
+        switch (m_dataType)
+        {
+        case DataType::Float:
+            return GetTensorView<float>()->GetShape();
+        case DataType::Double:
+            return GetTensorView<double>()->GetShape();
+        default:
+            LogicError("Unsupported DataType %s", DataTypeName(m_dataType));
+        }
+    }
+
+    NDArrayViewPtr NDArrayView::StridedView(const NDShape& viewShape, const TensorShape& tensorShape, bool readOnly) const
+    {
+        if (IsSparse())
+            InvalidArgument("Slicing, reshaping or transposing a NDArrayView is only supported for NDArrayView objects with dense storage format");
+
+        void* tensorView = nullptr;
+        switch (m_dataType)
+        {
+        case DataType::Float:
+            tensorView = AllocateTensorView<float>(*(GetTensorView<float>()), tensorShape, viewShape);
+            break;
+        case DataType::Double:
+            tensorView = AllocateTensorView<double>(*(GetTensorView<double>()), tensorShape, viewShape);
+            break;
+        default:
+            LogicError("Unsupported DataType %s", DataTypeName(m_dataType));
+            break;
+        }
+
+        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), viewShape, IsReadOnly() || readOnly, tensorView);
+    }
+
+    NDArrayViewPtr NDArrayView::SliceView(const std::vector<size_t>& startOffset, const NDShape& sliceShape, bool readOnly/* = false*/) const
+    {
+        if ((startOffset.size() != Shape().NumAxes()) || (sliceShape.NumAxes() != Shape().NumAxes()))
+            InvalidArgument("NDArrayView::SliceView: The rank of the 'startOffset' and 'sliceShape' must equal the rank (%d) of this NDArrayView", (int)Shape().NumAxes());
+
+        auto tensorShape = GetTensorShape();
+        for (size_t i = 0; i < Shape().NumAxes(); ++i)
+        {
+            if ((sliceShape[i] == 0) || ((startOffset[i] + sliceShape[i]) > Shape()[i]))
+                InvalidArgument("NDArrayView::SliceView: The slice of shape %s at offset %s exceeds the bounds of this NDArrayView's shape %s", AsString(sliceShape).c_str(), AsString(NDShape(startOffset)).c_str(), AsString(Shape()).c_str());
+
+            tensorShape.NarrowTo(i, startOffset[i], startOffset[i] + sliceShape[i]);
+        }
+
+        return StridedView(sliceShape, tensorShape, readOnly);
+    }
+
+    NDArrayViewPtr NDArrayView::AsShape(const NDShape& newShape, bool readOnly/* = false*/) const
+    {
+        if (newShape.TotalSize() != Shape().TotalSize())
+            InvalidArgument("NDArrayView::AsShape: The total size of the new shape %s must equal that of this NDArrayView's shape %s", AsString(newShape).c_str(), AsString(Shape()).c_str());
+
+        // Only a contiguous view can be reinterpreted in a new shape; StridedView() gives it the canonical layout of that shape
+        const auto& tensorShape = GetTensorShape();
+        if (!IsContiguous(tensorShape))
+            InvalidArgument("NDArrayView::AsShape: A NDArrayView whose elements are not stored contiguously cannot be reshaped; DeepClone() it first");
+
+        return StridedView(newShape, tensorShape, readOnly);
+    }
+
+    NDArrayViewPtr NDArrayView::TransposedView(size_t axis1, size_t axis2, bool readOnly/* = false*/) const
+    {
+        if ((axis1 >= Shape().NumAxes()) || (axis2 >= Shape().NumAxes()))
+            InvalidArgument("NDArrayView::TransposedView: The axes to swap (%d, %d) must be less than the rank (%d) of this NDArrayView", (int)axis1, (int)axis2, (int)Shape().NumAxes());
+
+        auto tensorShape = GetTensorShape();
+        tensorShape.SwapDimsInPlace(axis1, axis2);
+
+        auto transposedShape = Shape();
+        std::swap(transposedShape[axis1], transposedShape[axis2]);
+
+        return StridedView(transposedShape, tensorShape, readOnly);
+    }
+
     // TODO: This could actually be strided?
     template <typename ElementType>
     ElementType* NDArrayView::WritableDataBuffer()
@@ -309,6 +578,9 @@ namespace CNTK
         if (IsSparse())
             InvalidArgument("DataBuffer/WritableDataBuffer methods can only be called for NDArrayiew objects with dense storage format");
 
+        if (IsStrided(*this, *GetTensorView<ElementType>()))
+            InvalidArgument("DataBuffer/WritableDataBuffer methods cannot be called for NDArrayView objects whose elements are not stored contiguously; DeepClone() the view first");
+
         // First make sure that the underlying matrix is on the right device
         auto matrix = GetMatrix<ElementType>();
         matrix->TransferToDeviceIfNotThere(AsCNTKImplDeviceId(m_device), true);
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Learner.h"
+#include "Function.h"
 
 namespace CNTK
 {
@@ -29,7 +31,23 @@ namespace CNTK
             InvalidArgument("Trainer::Trainer: Union of the parameters covered by the specified parameterLearnes should match the specified model's parameters");
     }
 
-    bool Trainer::TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::DefaultDevice()*/)
+    Trainer::Trainer(const FunctionPtr& model, const Variable& trainingLoss, const std::unordered_set<LearnerPtr>& parameterLearners, const DistributedTrainerPtr& distributedTrainer)
+        : Trainer(model, trainingLoss, parameterLearners)
+    {
+        m_distributedTrainer = distributedTrainer;
+        if (!m_distributedTrainer)
+            return;
+
+        // The inputs of the model are listed in the order of a traversal of its graph, which is the same on all workers
+        std::unordered_set<Variable> visitedParameters;
+        for (const auto& input : model->Inputs())
+        {
+            if (input.IsParameter() && visitedParameters.insert(input).second)
+                m_distributedParameters.push_back(Parameter(input));
+        }
+    }
+
+    size_t Trainer::ComputeParameterGradients(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice)
     {
         std::unordered_map<Variable, ValuePtr> outputs = { { m_trainingLossVar, nullptr } };
         auto backPropSate = m_model->Forward(arguments, outputs, computeDevice, { m_trainingLossVar });
@@ -41,12 +59,63 @@ namespace CNTK
         else
             rootGradientValue->Data()->SetValue(1.0);
 
-        auto modelParameters = m_model->Parameters();
-        std::unordered_map<Variable, ValuePtr> parameterGradients;
-        for (const auto& parameter : modelParameters)
-            parameterGradients[parameter] = nullptr;
+        if (!m_hasAccumulatedGradients)
+        {
+            // Learners that update several Parameters together take their gradients in place
+            m_parameterGradients.clear();
+            for (const auto& learner : m_parameterLearners)
+            {
+                auto learnerBase = dynamic_cast<const LearnerBase*>(learner.get());
+                for (const auto& parameter : learner->Parameters())
+                {
+                    auto gradientBuffer = (learnerBase != nullptr) ? learnerBase->GetGradientBuffer(parameter) : nullptr;
+                    m_parameterGradients[parameter] = (gradientBuffer != nullptr) ? MakeSharedObject<Value>(gradientBuffer) : nullptr;
+                }
+            }
+
+            m_model->Backward(backPropSate, { { m_trainingLossVar, rootGradientValue } }, m_parameterGradients);
+        }
+        else
+        {
+            // Add to the gradients of the earlier micro-batches in place
+            auto compositeModel = dynamic_cast<CompositeFunction*>(m_model.get());
+            if (compositeModel == nullptr)
+                LogicError("Trainer: Gradients can only be accumulated across minibatches for a model that is a composite Function");
 
-        m_model->Backward(backPropSate, { { m_trainingLossVar, rootGradientValue } }, parameterGradients);
+            compositeModel->Backward(backPropSate, { { m_trainingLossVar, rootGradientValue } }, m_parameterGradients, true /*accumulateGradients*/);
+        }
+
+        auto trainingLossArguments = m_trainingLossVar.Owner()->Arguments();
+        auto labelsVar = *(std::find_if(trainingLossArguments.begin(), trainingLossArguments.end(), [](const Variable& var) {
+            return var.IsInput();
+        }));
+        auto argumentValue = arguments.at(labelsVar);
+        auto argumentData = argumentValue->Data();
+        auto argumentDataShape = argumentData->Shape();
+        auto mask = argumentValue->Mask();
+        return argumentDataShape[argumentDataShape.NumAxes() - 1] - ((mask != nullptr) ? mask->MaskedCount() : 0);
+    }
+
+    void Trainer::AccumulateMinibatchGradients(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::DefaultDevice()*/)
+    {
+        m_numAccumulatedSamples += ComputeParameterGradients(arguments, computeDevice);
+        m_hasAccumulatedGradients = true;
+    }
+
+    bool Trainer::TrainMinibatch(const std::unordered_map<Variable, ValuePtr>& arguments, const DeviceDescriptor& computeDevice /*= DeviceDescriptor::DefaultDevice()*/)
+    {
+        size_t numSamples = m_numAccumulatedSamples + ComputeParameterGradients(arguments, computeDevice);
+        m_hasAccumulatedGradients = false;
+        m_numAccumulatedSamples = 0;
+
+        if (m_distributedTrainer)
+        {
+            std::vector<std::pair<Parameter, NDArrayViewPtr>> gradientValues;
+            for (const auto& parameter : m_distributedParameters)
+                gradientValues.push_back({ parameter, m_parameterGradients[parameter]->Data() });
+
+            numSamples = m_distributedTrainer->AggregateGradients(gradientValues, numSamples);
+        }
 
         bool anyUpdatesPerformed = false;
         for (auto learner : m_parameterLearners)
@@ -55,24 +124,16 @@ namespace CNTK
             const auto& learnerParameters = learner->Parameters();
             for (const auto& parameter : learnerParameters)
             {
-                learnerParameterGradients[parameter] = parameterGradients[parameter]->Data();
+                learnerParameterGradients[parameter] = m_parameterGradients[parameter]->Data();
 
-                if (parameterGradients[parameter]->Mask())
+                if (m_parameterGradients[parameter]->Mask())
                     LogicError("The gradient value for a Parameter cannot have an associated mask!");
             }
 
-            auto trainingLossArguments = m_trainingLossVar.Owner()->Arguments();
-            auto labelsVar = *(std::find_if(trainingLossArguments.begin(), trainingLossArguments.end(), [](const Variable& var) {
-                return var.IsInput();
-            }));
-            auto argumentValue = arguments.at(labelsVar);
-            auto argumentData = argumentValue->Data();
-            auto argumentDataShape = argumentData->Shape();
-            auto mask = argumentValue->Mask();
-            size_t numSamples = argumentDataShape[argumentDataShape.NumAxes() - 1] - ((mask != nullptr) ? mask->MaskedCount() : 0);
             anyUpdatesPerformed |= learner->Update(learnerParameterGradients, numSamples);
         }
 
+        m_parameterGradients.clear();
         return anyUpdatesPerformed;
     }
 }
@@ -48,6 +48,11 @@ int bestGPUDummy = 42; // put something into this CPP, as to avoid a linker warn
 
 #include <memory>
 #include "CrossProcessMutex.h"
+#include "CUDAPageLockedMemAllocator.h"
+#ifdef __unix__
+#include <sched.h>
+#include <unistd.h>
+#endif
 
 // ---------------------------------------------------------------------------
 // BestGpu class
@@ -64,7 +69,8 @@ struct ProcessorData
     size_t cudaFreeMem;
     size_t cudaTotalMem;
     bool cntkFound;
-    int deviceId; // the deviceId (cuda side) for this processor
+    int deviceId;       // the deviceId (cuda side) for this processor
+    double cpuLocality; // fraction of the CPUs this process may run on that are local to the device (same socket/NUMA node)
 };
 
 enum BestGpuFlags
@@ -75,6 +81,7 @@ enum BestGpuFlags
     bestGpuFavorUtilization = 4, // favor low utilization
     bestGpuFavorSpeed = 8,       // favor fastest processor
     bestGpuExclusiveLock = 16,   // obtain mutex for selected GPU
+    bestGpuFavorTopology = 32,   // favor devices local to the CPUs of this process, and peer access among the devices picked
     bestGpuRequery = 256,        // rerun the last query, updating statistics
 };
 
@@ -91,6 +98,7 @@ private:
     BestGpuFlags m_lastFlags; // flag state at last query
     int m_lastCount;          // count of devices (with filtering of allowed Devices)
     std::vector<ProcessorData*> m_procData;
+    std::vector<std::vector<bool>> m_peerAccess; // [i][j]: device i can access the memory of device j directly (P2P)
     int m_allowedDevices; // bitfield of allowed devices
     bool m_disallowCPUDevice;
     void GetCudaProperties();
@@ -128,7 +136,10 @@ private:
 // 'cpu'  - use the CPU
 // 0      - or some other single number, use a single GPU with CUDA ID same as the number
 // This can only be called with the same parameters each time, and 'auto' is determined upon first call.
-static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const intargvector& excludedDevices)
+// With bBindCpus, the process is bound to the CPUs local to the selected GPU ('bindCpusToGpu'), see BindToDeviceCpus(),
+// and with bNumaLocalMemory, pinned host memory is allocated on their NUMA node ('numaLocalHostMemory').
+static void BindToDeviceCpus(DEVICEID_TYPE deviceId);
+static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const intargvector& excludedDevices, bool bBindCpus = false, bool bNumaLocalMemory = false)
 {
     // This can only be called with the same parameter.
     static DEVICEID_TYPE selectedDeviceId = DEVICEID_NOTYETDETERMINED;
@@ -156,13 +167,23 @@ static DEVICEID_TYPE SelectDevice(DEVICEID_TYPE deviceId, bool bLockGPU, const i
                 g_bestGpu->DisallowUnsupportedDevices();
             }
 
-            bestDeviceId = (DEVICEID_TYPE)g_bestGpu->GetDevice(BestGpuFlags(bLockGPU ? (bestGpuAvoidSharing | bestGpuExclusiveLock) : bestGpuAvoidSharing));
+            bestDeviceId = (DEVICEID_TYPE)g_bestGpu->GetDevice(BestGpuFlags(bestGpuAvoidSharing | bestGpuFavorTopology | (bLockGPU ? bestGpuExclusiveLock : 0)));
             // TODO: Do we need to hold this pointer at all? We will only query it once. Or is it used to hold lock to a GPU?
         }
         // already chosen
         deviceId = bestDeviceId;
     }
 
+    if (bNumaLocalMemory && deviceId >= 0)
+        CUDAPageLockedMemAllocator::SetNumaLocal(true);
+
+    static bool cpusBound = false;
+    if (bBindCpus && !cpusBound && deviceId >= 0)
+    {
+        BindToDeviceCpus(deviceId);
+        cpusBound = true;
+    }
+
     return deviceId;
 }
 //#ifdef MATH_EXPORTS
@@ -172,10 +193,12 @@ DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config)
 {
     intargvector excludedDevices = ConfigArray(config(L"excludedDevices", ""), ':', false);
     bool bLockGPU = config(L"lockGPU", true);
+    bool bBindCpus = config(L"bindCpusToGpu", false);
+    bool bNumaLocalMemory = config(L"numaLocalHostMemory", false);
     // we need to deal with the old CNTK config semantics where 'deviceId' can be either a string or an int
     auto valpp = config.Find(L"deviceId");
     if (!valpp)
-        return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices); // not given at all: default
+        return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, bBindCpus, bNumaLocalMemory); // not given at all: default
     auto valp = *valpp;                               // (the type is not determined at this point)
     if (valp.Is<ScriptableObjects::String>())
     {
@@ -183,12 +206,12 @@ DEVICEID_TYPE DeviceFromConfig(const ScriptableObjects::IConfigRecord& config)
         if (val == L"cpu")
             return SelectDevice(CPUDEVICE, false, excludedDevices);
         else if (val == L"auto")
-            return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices);
+            return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, bBindCpus, bNumaLocalMemory);
         else
             InvalidArgument("Invalid value '%ls' for deviceId parameter. Allowed are 'auto' and 'cpu' (case-sensitive).", val.c_str());
     }
     else
-        return SelectDevice(valp, bLockGPU, excludedDevices);
+        return SelectDevice(valp, bLockGPU, excludedDevices, bBindCpus, bNumaLocalMemory);
 }
 // legacy version for old CNTK config
 //#ifdef MATH_EXPORTS
@@ -199,10 +222,60 @@ DEVICEID_TYPE DeviceFromConfig(const ConfigParameters& config)
     intargvector excludedDevices = ConfigArray(config("excludedDevices", ""), ':', false);
     ConfigValue val = config("deviceId", "auto");
     bool bLockGPU = config(L"lockGPU", true);
+    bool bBindCpus = config(L"bindCpusToGpu", false);
+    bool bNumaLocalMemory = config(L"numaLocalHostMemory", false);
 
     if (EqualCI(val, "cpu"))  return SelectDevice(CPUDEVICE, false, excludedDevices);
-    else if (EqualCI(val, "auto")) return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices);
-    else                           return SelectDevice((int)val, bLockGPU, excludedDevices);
+    else if (EqualCI(val, "auto")) return SelectDevice(DEVICEID_AUTO, bLockGPU, excludedDevices, bBindCpus, bNumaLocalMemory);
+    else                           return SelectDevice((int)val, bLockGPU, excludedDevices, bBindCpus, bNumaLocalMemory);
+}
+
+// CPU sets in the format of NVML: a bit per CPU, for up to 1024 CPUs
+static const size_t cpuSetBits = sizeof(unsigned long) * 8;
+static const size_t cpuSetSize = 1024 / cpuSetBits;
+
+// GetProcessCpus - the set of CPUs this process may run on, e.g. as restricted by numactl/taskset or an MPI launcher
+static std::vector<unsigned long> GetProcessCpus()
+{
+    std::vector<unsigned long> cpus(cpuSetSize, 0);
+#ifdef _WIN32
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        for (size_t cpu = 0; cpu < sizeof(DWORD_PTR) * 8; cpu++)
+            if ((processMask >> cpu) & 1)
+                cpus[cpu / cpuSetBits] |= 1ul << (cpu % cpuSetBits);
+    }
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (size_t cpu = 0; cpu < CPU_SETSIZE && cpu < cpuSetSize * cpuSetBits; cpu++)
+            if (CPU_ISSET(cpu, &set))
+                cpus[cpu / cpuSetBits] |= 1ul << (cpu % cpuSetBits);
+    }
+#endif
+    return cpus;
+}
+
+// CpuLocality - fraction of the CPUs of the process that are in the set of CPUs of a device, 1 if unknown
+static double CpuLocality(const std::vector<unsigned long>& processCpus, const std::vector<unsigned long>& deviceCpus)
+{
+    size_t numProcessCpus = 0;
+    size_t numLocalCpus = 0;
+    for (size_t i = 0; i < cpuSetSize; i++)
+    {
+        for (size_t bit = 0; bit < cpuSetBits; bit++)
+        {
+            if ((processCpus[i] >> bit) & 1)
+            {
+                numProcessCpus++;
+                numLocalCpus += (deviceCpus[i] >> bit) & 1;
+            }
+        }
+    }
+    return numProcessCpus > 0 ? numLocalCpus / (double) numProcessCpus : 1.0;
 }
 
 // !!!!This is from helper_cuda.h which comes with CUDA samples!!!! Consider if it is beneficial to just include all helper_cuda.h
@@ -262,9 +335,21 @@ void BestGpu::GetCudaProperties()
         pd->cores = _ConvertSMVer2Cores(pd->deviceProp.major, pd->deviceProp.minor) * pd->deviceProp.multiProcessorCount;
         pd->cudaFreeMem = free;
         pd->cudaTotalMem = total;
+        pd->cpuLocality = 1.0; // until known from NVML
         dev++;
         cudaDeviceReset();
     }
+
+    m_peerAccess.assign(m_procData.size(), std::vector<bool>(m_procData.size(), false));
+    for (int i = 0; i < (int) m_procData.size(); i++)
+    {
+        for (int j = 0; j < (int) m_procData.size(); j++)
+        {
+            int canAccessPeer = 0;
+            if (i != j && cudaDeviceCanAccessPeer(&canAccessPeer, i, j) == cudaSuccess)
+                m_peerAccess[i][j] = canAccessPeer != 0;
+        }
+    }
     m_cudaData = m_procData.size() > 0;
 }
 
@@ -399,14 +484,10 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
         number = m_lastCount;
     }
 
-    // create the initial array, initialized to all CPU
-    std::vector<int> best(m_deviceCount, -1);
-    std::vector<double> scores(m_deviceCount, -1.0);
-
     // if no GPUs were found, we should use the CPU
     if (m_procData.size() == 0)
     {
-        best.clear();
+        std::vector<int> best;
         if (DeviceAllowed(-1))
             best.push_back(-1); // default to CPU
 
@@ -421,6 +502,8 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
     double speedW = 0.2;
     double freeMemW = 0.2;
     double mlAppRunningW = 0.2;
+    double cpuLocalityW = 0.0;
+    double peerAccessW = 0.0;
 
     // if it's a requery, just use the same flags as last time
     if (bestFlags & bestGpuRequery)
@@ -444,7 +527,13 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
     {
         speedW *= 2;
     }
+    if (bestFlags & bestGpuFavorTopology) // favor devices on the socket of our CPUs, and devices that can reach each other directly
+    {
+        cpuLocalityW = 0.15;
+        peerAccessW = 0.15;
+    }
 
+    std::vector<std::pair<double, int>> candidates; // score, deviceId
     for (ProcessorData* pd : m_procData)
     {
         double score = 0.0;
@@ -462,32 +551,36 @@ std::vector<int> BestGpu::GetDevices(int number, BestGpuFlags p_bestFlags)
             mem = pd->cudaFreeMem / (double) pd->cudaTotalMem;
         score += mem * freeMemW;
         score += (pd->cntkFound ? 0 : 1) * mlAppRunningW;
-        for (int i = 0; i < best.size(); i++)
+        // a device on another socket than the CPUs we run on pays for every host transfer crossing the inter-socket link
+        score += pd->cpuLocality * cpuLocalityW;
+        candidates.push_back(std::make_pair(score, pd->deviceId));
+    }
+
+    // order the devices greedily: each next device is the best one, counting the fraction of the devices already
+    // picked it can access directly, so that a multi-GPU job gets devices that can exchange data peer to peer
+    std::vector<int> best;
+    while (!candidates.empty())
+    {
+        size_t bestCandidate = 0;
+        double bestScore = -std::numeric_limits<double>::infinity();
+        for (size_t c = 0; c < candidates.size(); c++)
         {
-            // look for a better score
-            if (score > scores[i])
+            double score = candidates[c].first;
+            if (!best.empty())
             {
-                // make room for this score in the correct location (insertion sort)
-                for (int j = (int) best.size() - 1; j > i; --j)
-                {
-                    scores[j] = scores[j - 1];
-                    best[j] = best[j - 1];
-                }
-                scores[i] = score;
-                best[i] = pd->deviceId;
-                break;
+                size_t numPeers = 0;
+                for (int deviceId : best)
+                    numPeers += m_peerAccess[candidates[c].second][deviceId] && m_peerAccess[deviceId][candidates[c].second] ? 1 : 0;
+                score += numPeers / (double) best.size() * peerAccessW;
+            }
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestCandidate = c;
             }
         }
-    }
-
-    // now get rid of any extra empty slots and disallowed devices
-    for (int j = (int) best.size() - 1; j >= 0; --j)
-    {
-        // if this device is not allowed, or never was set remove it
-        if (best[j] == -1)
-            best.pop_back();
-        else
-            break;
+        best.push_back(candidates[bestCandidate].second);
+        candidates.erase(candidates.begin() + bestCandidate);
     }
 
     // global lock for this process
@@ -604,6 +697,7 @@ void BestGpu::QueryNvmlData()
     if (!m_cudaData)
         return;
 
+    std::vector<unsigned long> processCpus = GetProcessCpus();
     for (int i = 0; i < m_deviceCount; i++)
     {
         nvmlDevice_t device;
@@ -657,6 +751,11 @@ void BestGpu::QueryNvmlData()
         }
         m_queryCount++;
 
+        // the CPUs close to the device (its socket/NUMA node); not available on all platforms, so no need to back out
+        std::vector<unsigned long> deviceCpus(cpuSetSize, 0);
+        if (nvmlDeviceGetCpuAffinity(device, (unsigned int) cpuSetSize, deviceCpus.data()) == NVML_SUCCESS)
+            curPd->cpuLocality = CpuLocality(processCpus, deviceCpus);
+
         unsigned int size = 0;
         result = nvmlDeviceGetComputeRunningProcesses(device, &size, NULL);
         if (size > 0)
@@ -722,6 +821,36 @@ bool BestGpu::LockDevice(int deviceId, bool trial)
     return true;
 }
 
+// BindToDeviceCpus - bind the process to the CPUs local to a GPU (its socket/NUMA node), so that the threads created
+// afterwards, e.g. the prefetch threads of the readers, stage their data in host memory close to the device.
+// NVML only supports this on Linux; elsewhere the binding is left to the launcher.
+static void BindToDeviceCpus(DEVICEID_TYPE deviceId)
+{
+#ifdef __unix__
+    char busId[32];
+    if (cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess)
+    {
+        fprintf(stderr, "BindToDeviceCpus: Failed to get the PCI bus id of GPU %d, the process is not bound.\n", (int) deviceId);
+        return;
+    }
+    nvmlReturn_t result = nvmlInit();
+    if (result == NVML_SUCCESS)
+    {
+        nvmlDevice_t device;
+        result = nvmlDeviceGetHandleByPciBusId(busId, &device);
+        if (result == NVML_SUCCESS)
+            result = nvmlDeviceSetCpuAffinity(device);
+        nvmlShutdown();
+    }
+    if (result == NVML_SUCCESS)
+        fprintf(stderr, "BindToDeviceCpus: Bound to the CPUs local to GPU %d.\n", (int) deviceId);
+    else
+        fprintf(stderr, "BindToDeviceCpus: Failed to bind to the CPUs local to GPU %d: %s.\n", (int) deviceId, nvmlErrorString(result));
+#else
+    fprintf(stderr, "BindToDeviceCpus: Binding to the CPUs of GPU %d is only supported on Linux, ignored.\n", (int) deviceId);
+#endif
+}
+
 #ifdef _WIN32
 
 #if 0
@@ -0,0 +1,186 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "BlockCompression.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace BlockCompression {
+
+// constants of the LZ4 block format
+static const size_t c_minMatch = 4;       // shortest match
+static const size_t c_lastLiterals = 5;   // the last bytes of a block are always literals
+static const size_t c_matchStartLimit = 12; // a match starts at least this many bytes before the end
+static const size_t c_maxOffset = 65535;
+static const int c_hashBits = 16;
+
+static inline uint32_t Read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - c_hashBits);
+}
+
+// a length that does not fit into its 4 bits of the token continues in bytes of 255, ended by a byte < 255
+static inline uint8_t* WriteLength(uint8_t* out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = (uint8_t) length;
+    return out;
+}
+
+static inline uint8_t* WriteLiterals(uint8_t* out, uint8_t* token, const uint8_t* literals, size_t length)
+{
+    *token = (uint8_t) (std::min(length, (size_t) 15) << 4);
+    if (length >= 15)
+        out = WriteLength(out, length - 15);
+    memcpy(out, literals, length);
+    return out + length;
+}
+
+size_t CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t Compress(const char* src, size_t size, char* dst)
+{
+    if (size >= UINT32_MAX)
+        InvalidArgument("BlockCompression::Compress: Blocks must be smaller than 4 GB.");
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+    size_t anchor = 0; // start of the pending literals
+
+    if (size > c_matchStartLimit)
+    {
+        std::vector<uint32_t> table(1 << c_hashBits, UINT32_MAX); // last position of each hashed 4-byte sequence
+        const size_t matchEndLimit = size - c_lastLiterals;
+        const size_t matchStartLimit = size - c_matchStartLimit;
+        size_t i = 0;
+        while (i <= matchStartLimit)
+        {
+            uint32_t sequence = Read32(in + i);
+            uint32_t& entry = table[Hash(sequence)];
+            size_t candidate = entry;
+            entry = (uint32_t) i;
+            if (candidate == UINT32_MAX || i - candidate > c_maxOffset || Read32(in + candidate) != sequence)
+            {
+                i += 1 + ((i - anchor) >> 6); // skip faster through data that does not compress
+                continue;
+            }
+
+            while (i > anchor && candidate > 0 && in[i - 1] == in[candidate - 1])
+            {
+                i--;
+                candidate--;
+            }
+            size_t length = c_minMatch;
+            while (i + length < matchEndLimit && in[i + length] == in[candidate + length])
+                length++;
+
+            uint8_t* token = out++;
+            out = WriteLiterals(out, token, in + anchor, i - anchor);
+            size_t offset = i - candidate;
+            *out++ = (uint8_t) (offset & 0xff);
+            *out++ = (uint8_t) (offset >> 8);
+            size_t matchLength = length - c_minMatch;
+            *token |= (uint8_t) std::min(matchLength, (size_t) 15);
+            if (matchLength >= 15)
+                out = WriteLength(out, matchLength - 15);
+
+            i += length;
+            anchor = i;
+        }
+    }
+
+    uint8_t* token = out++;
+    out = WriteLiterals(out, token, in + anchor, size - anchor);
+    return out - reinterpret_cast<uint8_t*>(dst);
+}
+
+size_t Decompress(const char* src, size_t size, char* dst, size_t dstSize)
+{
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* inEnd = in + size;
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+    uint8_t* outBegin = out;
+    uint8_t* outEnd = out + dstSize;
+
+    auto readLength = [&](size_t length) -> size_t
+    {
+        if (length == 15)
+        {
+            uint8_t byte;
+            do
+            {
+                if (in >= inEnd)
+                    RuntimeError("BlockCompression::Decompress: The data is corrupt (truncated length).");
+                byte = *in++;
+                length += byte;
+            } while (byte == 255);
+        }
+        return length;
+    };
+
+    while (in < inEnd)
+    {
+        uint8_t token = *in++;
+        size_t literalLength = readLength(token >> 4);
+        if (literalLength > (size_t) (inEnd - in) || literalLength > (size_t) (outEnd - out))
+            RuntimeError("BlockCompression::Decompress: The data is corrupt (literals beyond the end).");
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        if (in == inEnd) // the last sequence has no match
+            break;
+
+        if (inEnd - in < 2)
+            RuntimeError("BlockCompression::Decompress: The data is corrupt (truncated offset).");
+        size_t offset = in[0] | ((size_t) in[1] << 8);
+        in += 2;
+        size_t matchLength = readLength(token & 15) + c_minMatch;
+        if (offset == 0 || offset > (size_t) (out - outBegin) || matchLength > (size_t) (outEnd - out))
+            RuntimeError("BlockCompression::Decompress: The data is corrupt (invalid match).");
+        const uint8_t* match = out - offset;
+        if (offset >= matchLength)
+            memcpy(out, match, matchLength);
+        else // the match overlaps the bytes it produces, e.g. a run
+        {
+            for (size_t k = 0; k < matchLength; k++)
+                out[k] = match[k];
+        }
+        out += matchLength;
+    }
+    return out - outBegin;
+}
+
+void ShuffleBytes(const char* src, size_t numElements, size_t elementSize, char* dst)
+{
+    for (size_t i = 0; i < numElements; i++)
+    {
+        for (size_t b = 0; b < elementSize; b++)
+            dst[b * numElements + i] = src[i * elementSize + b];
+    }
+}
+
+void UnshuffleBytes(const char* src, size_t numElements, size_t elementSize, char* dst)
+{
+    for (size_t i = 0; i < numElements; i++)
+    {
+        for (size_t b = 0; b < elementSize; b++)
+            dst[i * elementSize + b] = src[b * numElements + i];
+    }
+}
+
+}}}}
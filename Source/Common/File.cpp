@@ -23,11 +23,19 @@
 #endif
 #ifdef __unix__
 #include <unistd.h>
+#include <fcntl.h>
 #include <linux/limits.h> // for PATH_MAX
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+size_t File::s_sequentialBufferSize = 4 << 20;
+bool File::s_directIO = false;
+
+static const size_t c_directIOAlignment = 4096;       // of file offsets, sizes and memory for O_DIRECT
+static const size_t c_directWriteMinSize = 16 << 20; // smaller blocks are written through stdio
+static const size_t c_directWriteChunkSize = 8 << 20;
+
 // File creation
 // filename - the path
 // fileOptions - options to open the file
@@ -118,6 +126,7 @@ void File::Init(const wchar_t* filename, int fileOptions)
     //  - "cmd|" reads from a pipe
     m_pcloseNeeded = false;
     m_seekable = false;
+    m_directFd = -1;
     if (m_filename == L"-") // stdin/stdout
     {
         if (writing && reading)
@@ -142,6 +151,14 @@ void File::Init(const wchar_t* filename, int fileOptions)
                     m_file = fopenOrDie(filename, options.c_str());
                     m_seekable = true;
                 });
+
+    // many small writes, e.g. of the elements of a matrix, otherwise each become a system call on some file systems
+    if ((fileOptions & fileOptionsSequential) && s_sequentialBufferSize > 0 && m_seekable)
+    {
+        m_buffer.reset(new char[s_sequentialBufferSize]);
+        if (setvbuf(m_file, m_buffer.get(), _IOFBF, s_sequentialBufferSize) != 0)
+            m_buffer.reset();
+    }
 }
 
 // determine the directory for a given pathname
@@ -255,6 +272,18 @@ bool File::IsTextBased()
 // Note: this does not check for errors when the File corresponds to pipe stream. In this case, use Flush() before closing a file you are writing.
 File::~File(void)
 {
+    try
+    {
+        WaitForAsyncWrites();
+    }
+    catch (const exception& e) // Flush() reports it to callers that check
+    {
+        fprintf(stderr, "File: an asynchronous write to %S failed: %s\n", m_filename.c_str(), e.what());
+    }
+#ifdef __unix__
+    if (m_directFd >= 0)
+        close(m_directFd);
+#endif
     if (m_pcloseNeeded)
     {
         // TODO: Check for error code and throw if !std::uncaught_exception()     
@@ -270,6 +299,7 @@ File::~File(void)
 
 void File::Flush()
 {
+    WaitForAsyncWrites();
     fflushOrDie(m_file);
 }
 
@@ -486,6 +516,7 @@ void File::ReadChars(std::wstring& val, size_t cnt, bool reset)
 // size - size of the string to output, if zero null terminated
 void File::WriteString(const char* str, int size)
 {
+    WaitForAsyncWrites();
     if (size > 0)
     {
         fwprintf(m_file, L" %.*hs", size, str);
@@ -499,6 +530,100 @@ void File::WriteString(const char* str, int size)
     }
 }
 
+// WriteBytes - writes a block of binary data as is, e.g. a matrix in a compressed form
+void File::WriteBytes(const void* data, size_t size)
+{
+    WaitForAsyncWrites();
+    WriteBytesNow(data, size);
+}
+
+void File::WriteBytesNow(const void* data, size_t size)
+{
+    if (IsTextBased())
+        LogicError("WriteBytes: Cannot write binary data to the text file '%ls'.", m_filename.c_str());
+    if ((m_options & fileOptionsDirect) && s_directIO && size >= c_directWriteMinSize && TryWriteDirect((const char*) data, size))
+        return;
+    fwriteOrDie(data, 1, size, m_file);
+}
+
+void File::ReadBytes(void* data, size_t size)
+{
+    WaitForAsyncWrites();
+    if (IsTextBased())
+        LogicError("ReadBytes: Cannot read binary data from the text file '%ls'.", m_filename.c_str());
+    freadOrDie(data, 1, size, m_file);
+}
+
+// WriteAsync - writes a block on another thread; each waits for the one before, so that they stay in order
+std::shared_future<void> File::WriteAsync(std::vector<char>&& data)
+{
+    if (IsTextBased())
+        LogicError("WriteAsync: Cannot write binary data to the text file '%ls'.", m_filename.c_str());
+    auto previous = m_asyncWrite;
+    auto block = make_shared<std::vector<char>>(std::move(data));
+    m_asyncWrite = std::async(std::launch::async, [this, previous, block]()
+    {
+        if (previous.valid())
+            previous.get();
+        WriteBytesNow(block->data(), block->size());
+    }).share();
+    return m_asyncWrite;
+}
+
+// TryWriteDirect - writes the aligned middle of a large block through a second descriptor opened with O_DIRECT, so that
+// it does not pass through the page cache, and the unaligned ends through stdio. Returns false, without writing, if
+// direct I/O is not available for the file.
+bool File::TryWriteDirect(const char* data, size_t size)
+{
+#ifdef __unix__
+    if (m_directFd == -2 || !m_seekable || (m_options & fileOptionsRead))
+        return false;
+    if (m_directFd == -1)
+    {
+        m_directFd = open(msra::strfun::utf8(m_filename).c_str(), O_WRONLY | O_DIRECT);
+        if (m_directFd < 0) // e.g. tmpfs
+        {
+            m_directFd = -2;
+            return false;
+        }
+        m_directBuffer.resize(c_directWriteChunkSize + c_directIOAlignment);
+    }
+    char* buffer = m_directBuffer.data() + (c_directIOAlignment - (size_t) m_directBuffer.data() % c_directIOAlignment) % c_directIOAlignment;
+
+    // up to the next aligned position through stdio, and everything written so far to the file
+    uint64_t position = fgetpos(m_file); // not GetPosition(), which waits for the asynchronous write that may be calling this
+    size_t head = min(size, (size_t) ((c_directIOAlignment - position % c_directIOAlignment) % c_directIOAlignment));
+    fwriteOrDie(data, 1, head, m_file);
+    fflushOrDie(m_file);
+    position += head;
+
+    size_t body = (size - head) / c_directIOAlignment * c_directIOAlignment;
+    for (size_t offset = 0; offset < body;)
+    {
+        size_t chunkSize = min(c_directWriteChunkSize, body - offset);
+        memcpy(buffer, data + head + offset, chunkSize);
+        ssize_t written = pwrite(m_directFd, buffer, chunkSize, (off_t) (position + offset));
+        if (written < 0 && errno == EINVAL && offset == 0) // the file system accepted O_DIRECT, but not the write
+        {
+            close(m_directFd);
+            m_directFd = -2;
+            fwriteOrDie(data + head, 1, size - head, m_file);
+            return true;
+        }
+        if (written <= 0 || written % c_directIOAlignment != 0)
+            RuntimeError("File: direct write to %S failed: %s", m_filename.c_str(), strerror(errno));
+        offset += written;
+    }
+
+    fsetpos(m_file, position + body);
+    fwriteOrDie(data + head + body, 1, size - head - body, m_file);
+    return true;
+#else
+    data; size;
+    return false;
+#endif
+}
+
 // ReadString - reads a string into the file
 // str - the string buffer to read the string into
 // size - size of the string buffer incl. zero terminator (we fail if input is too long)
@@ -522,6 +647,7 @@ void File::ReadString(char* str, int size)
 // size - size of the string to output, if zero null terminated
 void File::WriteString(const wchar_t* str, int size)
 {
+    WaitForAsyncWrites();
 #ifdef EMBEDDED_SPACES
     // start of implementation of embedded space support with quoting
     // not complete, not sure if we need it
@@ -814,6 +940,7 @@ bool File::TryGetMarker(FileMarker marker, const std::string& section)
 // GetPosition - Get position in a file
 uint64_t File::GetPosition()
 {
+    WaitForAsyncWrites();
     if (!CanSeek())
         RuntimeError("File: attempted to GetPosition() on non-seekable stream");
     return fgetpos(m_file);
@@ -823,6 +950,7 @@ uint64_t File::GetPosition()
 // pos - position in the file
 void File::SetPosition(uint64_t pos)
 {
+    WaitForAsyncWrites();
     if (!CanSeek())
         RuntimeError("File: attempted to SetPosition() on non-seekable stream");
     fsetpos(m_file, pos);
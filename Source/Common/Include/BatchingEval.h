@@ -0,0 +1,167 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BatchingEval.h -- batches independent ForwardPass requests of a service into minibatches.
+//
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "Eval.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+//
+// Evaluates requests that arrive independently, e.g. on the threads of a web server, in batches.
+// Requests are queued and a single worker thread evaluates them with IEvaluateModelExtended::ForwardPassBatch(),
+// one sequence per request. A batch is evaluated once it has maxBatchSize requests, or once its first request
+// has waited for maxLatency, whichever comes first. Results are returned through futures.
+//
+// The evaluator must have been started with StartForwardEvaluation(), and must not be used by anybody else while
+// the batching evaluator exists; it is not destroyed with it. The outputs of a request are sized for as many samples
+// as the longest of its inputs, i.e. outputs must not be longer than the inputs.
+//
+template <typename ElemType>
+class BatchingEvaluator
+{
+public:
+    BatchingEvaluator(IEvaluateModelExtended<ElemType>* eval, size_t maxBatchSize, std::chrono::microseconds maxLatency)
+        : m_eval(eval), m_maxBatchSize(std::max<size_t>(maxBatchSize, 1)), m_maxLatency(maxLatency), m_stopping(false)
+    {
+        m_inputSchema = m_eval->GetInputSchema();
+        m_outputSchema = m_eval->GetOutputSchema();
+        m_worker = std::thread([this]() { Run(); });
+    }
+
+    // Evaluates the pending requests before returning.
+    ~BatchingEvaluator()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_available.notify_one();
+        m_worker.join();
+    }
+
+    //
+    // ForwardPass - queue a request for evaluation. The inputs are the same as for IEvaluateModelExtended::ForwardPass(),
+    // the future receives the outputs, or the exception thrown while evaluating the batch of the request.
+    //
+    std::future<Values<ElemType>> ForwardPass(Values<ElemType> inputs)
+    {
+        Request request;
+        request.m_inputs = std::move(inputs);
+        request.m_arrival = std::chrono::steady_clock::now();
+        auto result = request.m_outputs.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+                throw std::logic_error("BatchingEvaluator: ForwardPass() called while the evaluator is being destroyed.");
+            m_requests.push_back(std::move(request));
+        }
+        m_available.notify_one();
+        return result;
+    }
+
+private:
+    BatchingEvaluator(const BatchingEvaluator&) = delete;
+    BatchingEvaluator& operator=(const BatchingEvaluator&) = delete;
+
+    struct Request
+    {
+        Values<ElemType> m_inputs;
+        std::promise<Values<ElemType>> m_outputs;
+        std::chrono::steady_clock::time_point m_arrival;
+    };
+
+    void Run()
+    {
+        std::vector<Request> batch;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_available.wait(lock, [this]() { return m_stopping || !m_requests.empty(); });
+                if (m_requests.empty())
+                    return; // stopping
+
+                // Wait for more requests until the batch is full or its first request is due.
+                auto deadline = m_requests.front().m_arrival + m_maxLatency;
+                m_available.wait_until(lock, deadline, [this]() { return m_stopping || m_requests.size() >= m_maxBatchSize; });
+
+                size_t batchSize = std::min(m_requests.size(), m_maxBatchSize);
+                batch.clear();
+                for (size_t r = 0; r < batchSize; ++r)
+                {
+                    batch.push_back(std::move(m_requests.front()));
+                    m_requests.pop_front();
+                }
+            }
+
+            Evaluate(batch);
+        }
+    }
+
+    void Evaluate(std::vector<Request>& batch)
+    {
+        try
+        {
+            std::vector<Values<ElemType>> inputs;
+            std::vector<Values<ElemType>> outputs;
+            inputs.reserve(batch.size());
+            outputs.reserve(batch.size());
+            for (auto& request : batch)
+            {
+                outputs.push_back(m_outputSchema.CreateBuffers<ElemType>(std::vector<size_t>(m_outputSchema.size(), GetNumberOfSamples(request.m_inputs))));
+                inputs.push_back(std::move(request.m_inputs));
+            }
+
+            m_eval->ForwardPassBatch(inputs, outputs);
+
+            for (size_t r = 0; r < batch.size(); ++r)
+                batch[r].m_outputs.set_value(std::move(outputs[r]));
+        }
+        catch (...)
+        {
+            for (auto& request : batch)
+                request.m_outputs.set_exception(std::current_exception());
+        }
+    }
+
+    // Number of samples of the longest input of a request.
+    size_t GetNumberOfSamples(const Values<ElemType>& inputs) const
+    {
+        size_t numberOfSamples = 1;
+        for (size_t i = 0; i < inputs.size() && i < m_inputSchema.size(); ++i)
+        {
+            const auto& layout = m_inputSchema[i];
+            size_t samples = layout.m_storageType == VariableLayout::Sparse ?
+                (inputs[i].m_colIndices.empty() ? 0 : inputs[i].m_colIndices.size() - 1) :
+                inputs[i].m_buffer.size() / std::max<size_t>(layout.m_numElements, 1);
+            numberOfSamples = std::max(numberOfSamples, samples);
+        }
+        return numberOfSamples;
+    }
+
+    IEvaluateModelExtended<ElemType>* m_eval;
+    VariableSchema m_inputSchema;
+    VariableSchema m_outputSchema;
+    size_t m_maxBatchSize;
+    std::chrono::microseconds m_maxLatency;
+
+    std::mutex m_mutex;
+    std::condition_variable m_available;
+    std::deque<Request> m_requests;
+    bool m_stopping;
+    std::thread m_worker; // last, so that it starts after everything else is initialized
+};
+
+} } }
@@ -0,0 +1,35 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstddef>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Fast lossless compression of memory blocks, in the LZ4 block format: a greedy LZ77 match finder with a hash table
+// of 4-byte sequences, and literal runs and matches coded in whole bytes. It trades ratio for speed, and is meant for
+// large files written at run time, such as checkpoints.
+//
+// Floating-point data compresses much better after ShuffleBytes(), which groups the i-th bytes of all elements, so
+// that the sign and exponent bytes, which vary little between neighbors, form long runs.
+namespace BlockCompression
+{
+    // the largest size of the compressed form of 'size' bytes
+    size_t CompressBound(size_t size);
+
+    // Compresses 'size' bytes (less than 4 GB) into 'dst', which must hold CompressBound(size) bytes; returns the compressed size.
+    size_t Compress(const char* src, size_t size, char* dst);
+
+    // Decompresses 'size' bytes into 'dst', which holds 'dstSize' bytes; returns the decompressed size. Throws if the data is corrupt.
+    size_t Decompress(const char* src, size_t size, char* dst, size_t dstSize);
+
+    // dst[b * numElements + i] = src[i * elementSize + b], and the inverse
+    void ShuffleBytes(const char* src, size_t numElements, size_t elementSize, char* dst);
+    void UnshuffleBytes(const char* src, size_t numElements, size_t elementSize, char* dst);
+}
+
+}}}
@@ -5,47 +5,42 @@
 
 #pragma once
 
-#include <stack>
 #include <functional>
-#include <mutex>
+#include "MPMCQueue.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // -----------------------------------------------------------------------
-// conc_stack -- very simple version of thread-safe stack. Add other functions as needed.
+// conc_stack -- thread-safe pool of reusable objects (workspaces, random generators, buffers).
 // Kept in a separate header because it pulls in some large headers that are not super-commonly needed otherwise.
+// Backed by the lock-free ObjectPool, so that many threads taking and returning objects do not serialize on a lock.
+// At most 'capacity' objects are kept, further ones pushed are destroyed.
 // -----------------------------------------------------------------------
 
 template <typename T>
 class conc_stack
 {
 public:
-    typedef typename std::stack<T>::value_type value_type;
+    typedef T value_type;
 
-    conc_stack()
+    conc_stack(size_t capacity = 256)
+        : m_pool(capacity)
     {
     }
 
     value_type pop_or_create(std::function<value_type()> factory)
     {
-        std::lock_guard<std::mutex> g(m_locker);
-        if (m_stack.size() == 0)
-            return factory();
-        auto res = std::move(m_stack.top());
-        m_stack.pop();
-        return res;
+        return m_pool.Get(factory);
     }
 
     void push(const value_type& item)
     {
-        std::lock_guard<std::mutex> g(m_locker);
-        m_stack.push(item);
+        m_pool.Return(item);
     }
 
     void push(value_type&& item)
     {
-        std::lock_guard<std::mutex> g(m_locker);
-        m_stack.push(std::forward<value_type>(item));
+        m_pool.Return(std::move(item));
     }
 
 public:
@@ -55,7 +50,6 @@ public:
     conc_stack& operator=(conc_stack&&) = delete;
 
 private:
-    std::stack<value_type> m_stack;
-    std::mutex m_locker;
+    ObjectPool<value_type> m_pool;
 };
 } } }
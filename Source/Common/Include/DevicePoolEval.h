@@ -0,0 +1,154 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DevicePoolEval.h -- evaluates requests on replicas of a model on several devices.
+//
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Eval.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+//
+// Loads a model onto a set of devices and evaluates each call on the replica with the fewest requests running or
+// waiting, so that a scoring host can use all of its GPUs through a single evaluator. Unlike a single evaluator,
+// the pool may be called from several threads at the same time; each replica evaluates one call at a time.
+//
+// Replicas on different devices load the model each; several replicas on the same device (a device id given more
+// than once) share their parameters, see IEvaluateModelExtended::Clone(). Without device ids, one replica is placed
+// on each GPU GetEvalGpuDevices() reports, or on the CPU if there is none.
+//
+template <typename ElemType>
+class DevicePoolEvaluator
+{
+public:
+    // modelDescription - as for IEvaluateModelBase::CreateNetwork(); its deviceId is replaced by the device of each replica
+    // outputs - as for IEvaluateModelExtended::StartForwardEvaluation()
+    DevicePoolEvaluator(const std::string& modelDescription, const std::vector<std::wstring>& outputs, std::vector<int> deviceIds = std::vector<int>())
+    {
+        if (deviceIds.empty())
+            GetEvalGpuDevices(deviceIds);
+        if (deviceIds.empty())
+            deviceIds.push_back(-1 /*CPU*/);
+
+        try
+        {
+            for (int deviceId : deviceIds)
+            {
+                std::unique_ptr<Replica> replica(new Replica());
+                replica->m_deviceId = deviceId;
+                auto first = std::find_if(m_replicas.begin(), m_replicas.end(), [deviceId](const std::unique_ptr<Replica>& r) { return r->m_deviceId == deviceId; });
+                if (first != m_replicas.end())
+                {
+                    replica->m_eval = (*first)->m_eval->Clone();
+                }
+                else
+                {
+                    GetEvalExtended(&replica->m_eval);
+                    replica->m_eval->CreateNetwork(modelDescription + "\ndeviceId=" + std::to_string(deviceId) + "\n");
+                }
+                replica->m_eval->StartForwardEvaluation(outputs);
+                m_replicas.push_back(std::move(replica));
+            }
+        }
+        catch (...)
+        {
+            m_replicas.clear();
+            throw;
+        }
+
+        m_inputSchema = m_replicas.front()->m_eval->GetInputSchema();
+        m_outputSchema = m_replicas.front()->m_eval->GetOutputSchema();
+    }
+
+    const VariableSchema& GetInputSchema() const { return m_inputSchema; }
+    const VariableSchema& GetOutputSchema() const { return m_outputSchema; }
+
+    // device of each replica, in the order they were given
+    std::vector<int> GetDevices() const
+    {
+        std::vector<int> devices;
+        for (const auto& replica : m_replicas)
+            devices.push_back(replica->m_deviceId);
+        return devices;
+    }
+
+    //
+    // ForwardPass - as IEvaluateModelExtended::ForwardPass(), on the least loaded replica.
+    //
+    void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
+    {
+        Run(1, [&](IEvaluateModelExtended<ElemType>* eval) { eval->ForwardPass(inputs, outputs); });
+    }
+
+    //
+    // ForwardPassBatch - as IEvaluateModelExtended::ForwardPassBatch(), on the least loaded replica; a batch counts as
+    // one request for each of its requests.
+    //
+    void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+    {
+        Run(inputs.size(), [&](IEvaluateModelExtended<ElemType>* eval) { eval->ForwardPassBatch(inputs, outputs); });
+    }
+
+private:
+    DevicePoolEvaluator(const DevicePoolEvaluator&) = delete;
+    DevicePoolEvaluator& operator=(const DevicePoolEvaluator&) = delete;
+
+    struct Replica
+    {
+        IEvaluateModelExtended<ElemType>* m_eval = nullptr;
+        int m_deviceId = -1;
+        size_t m_load = 0;     // requests running or waiting on this replica; guarded by the pool's m_mutex
+        std::mutex m_evalMutex; // a replica evaluates one call at a time
+
+        ~Replica()
+        {
+            if (m_eval)
+                m_eval->Destroy();
+        }
+    };
+
+    static void GetEvalExtended(IEvaluateModelExtended<float>** eval) { GetEvalExtendedF(eval); }
+    static void GetEvalExtended(IEvaluateModelExtended<double>** eval) { GetEvalExtendedD(eval); }
+
+    template <typename Evaluate>
+    void Run(size_t numRequests, const Evaluate& evaluate)
+    {
+        Replica* replica;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            replica = std::min_element(m_replicas.begin(), m_replicas.end(),
+                                       [](const std::unique_ptr<Replica>& a, const std::unique_ptr<Replica>& b) { return a->m_load < b->m_load; })->get();
+            replica->m_load += numRequests;
+        }
+
+        try
+        {
+            std::lock_guard<std::mutex> lock(replica->m_evalMutex);
+            evaluate(replica->m_eval);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            replica->m_load -= numRequests;
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        replica->m_load -= numRequests;
+    }
+
+    std::vector<std::unique_ptr<Replica>> m_replicas;
+    VariableSchema m_inputSchema;
+    VariableSchema m_outputSchema;
+    std::mutex m_mutex;
+};
+
+} } }
@@ -293,6 +293,25 @@ class VariableSchema : public std::vector<VariableLayout>
         }
 };
 
+//
+// Post-processing of an output on the device, before it is copied to the host; see SetOutputPostProcessing()
+//
+struct OutputPostProcessing
+{
+    enum Kind
+    {
+        None,    // the output as is
+        Argmax,  // the index of the largest element of each sample
+        TopK,    // the indices of the m_k largest elements of each sample, largest first, followed by their values
+        Hardmax  // 1 for the largest element of each sample, 0 for the others
+    };
+
+    Kind m_kind;
+    size_t m_k; // for TopK
+
+    OutputPostProcessing(Kind kind = None, size_t k = 1) : m_kind(kind), m_k(k) {}
+};
+
 //
 // Extended interface, allowing for sparse input.
 // Implementation constraints: 
@@ -340,6 +359,67 @@ public:
     // (e.g. when vectors are manages by .net)
     // 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) = 0;
+
+    //
+    // ForwardPassStreams - Evaluate the next pieces of several streams, e.g. audio that arrives while it is recorded,
+    // in a single forward pass. Each request continues the stream with the given id where the last call for it
+    // ended, i.e. recurrent state is carried over between the calls instead of evaluating the stream from its start
+    // again. A stream id that was not seen before, or that was ended, starts a new stream. Otherwise the same as
+    // ForwardPassBatch(); the outputs only hold the steps of the pieces passed in.
+    // Only models whose recurrences look into the past (PastValue with a time step of 1) can be evaluated on streams.
+    // streamIds - for every request, the id of its stream; a stream can only be continued once per call
+    //
+    virtual void ForwardPassStreams(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // EndStream - Release the state of a stream. Its id may be reused for a new stream.
+    //
+    virtual void EndStream(size_t streamId) = 0;
+
+    //
+    // BindBuffers - Bind buffers to the inputs and outputs, so that ForwardPass() without arguments reads the inputs from
+    // and writes the outputs to these buffers in place, without copying them. Only dense inputs can be bound.
+    // The buffers must be in the memory of the device the model is evaluated on: host memory (page-locked or not)
+    // for the CPU, device memory for a GPU. They must stay valid until the binding ends, which is when BindBuffers(),
+    // StartForwardEvaluation(), or another ForwardPass() is called, or the evaluator is destroyed.
+    // The network is evaluated once to determine the size of the outputs, the sizes of the output buffers are set
+    // accordingly and they hold the outputs of the inputs at the time of the call.
+    // inputs - vector of input buffers, one for every input as given by GetInputLayouts()
+    // outputs - vector of output buffers. Must have the capacity to fit output schema.
+    //
+    virtual void BindBuffers(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs) = 0;
+
+    //
+    // ForwardPass - Evaluate the model on the current contents of the buffers bound by BindBuffers().
+    //
+    virtual void ForwardPass() = 0;
+
+    //
+    // ForwardPassBatch - Evaluate several independent requests in a single forward pass. Each request has the inputs
+    // and outputs of a call to ForwardPass() and becomes one sequence of the minibatch, so requests may differ in
+    // length. The outputs of each request must be preallocated as for ForwardPass().
+    // inputs - for every request, a vector of input buffers as given by GetInputLayouts()
+    // outputs - for every request, a vector of output buffers. Must be sized to fit output schema.
+    //
+    virtual void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) = 0;
+
+    //
+    // SetOutputPostProcessing - Reduce an output on the device before it is copied to the host, e.g. a classifier
+    // with many classes to its top k classes and their scores. Indices are returned as values of ElemType. Applies to
+    // ForwardPass(), ForwardPassBatch() and ForwardPassStreams() until the next StartForwardEvaluation(); from now on,
+    // GetOutputSchema() gives the number of elements per sample after post-processing. Buffers cannot be bound to
+    // outputs that are post-processed.
+    //
+    virtual void SetOutputPostProcessing(const std::wstring& output, const OutputPostProcessing& postProcessing) = 0;
+
+    //
+    // Clone - create an evaluator of the same model that shares its parameters (weights) with this one and only
+    // owns the values of the other nodes. Each evaluator may be used on its own thread concurrently with the
+    // others, while a single evaluator remains not reentrant. Call it after the network has been created, and not
+    // concurrently with ForwardPass() on this evaluator. The clone must be started with StartForwardEvaluation(),
+    // and released with Destroy(); it may outlive this evaluator. On the GPU, all evaluators share the device.
+    //
+    virtual IEvaluateModelExtended<ElemType>* Clone() = 0;
 };
 
 template <typename ElemType>
@@ -347,4 +427,10 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+//
+// GetEvalGpuDevices - the ids of the GPUs models can be evaluated on, as found by BestGpu; empty on hosts without
+// a usable GPU and in CPU-only builds.
+//
+void EVAL_API GetEvalGpuDevices(std::vector<int>& deviceIds);
+
 } } }
@@ -19,6 +19,8 @@
 #include "fileutil.h" // for f{ge,pu}t{,Text}()
 #include <fstream>    // for LoadMatrixFromTextFile() --TODO: change to using this File class
 #include <sstream>
+#include <future>
+#include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -33,7 +35,8 @@ enum FileOptions
     fileOptionsType = fileOptionsBinary | fileOptionsText,      // file types
     fileOptionsRead = 8,                                        // open in read mode
     fileOptionsWrite = 16,                                      // open in write mode
-    fileOptionsSequential = 32,                                 // optimize for sequential reads (allocates big buffer)
+    fileOptionsSequential = 32,                                 // optimize for sequential reads and writes (allocates big buffer, see SetSequentialBufferSize())
+    fileOptionsDirect = 64,                                     // write large blocks with direct I/O, bypassing the page cache, if enabled (see EnableDirectIO())
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,  // read/write mode
 };
 
@@ -99,7 +102,17 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    std::unique_ptr<char[]> m_buffer;     // stdio buffer, if fileOptionsSequential
+    int m_directFd;                       // descriptor of the file opened for direct I/O; -1 if not opened yet, -2 if not supported
+    std::vector<char> m_directBuffer;     // staging buffer of direct writes, aligned inside
+    std::shared_future<void> m_asyncWrite; // the last write started by WriteAsync()
+
+    static size_t s_sequentialBufferSize;
+    static bool s_directIO;
+
     void Init(const wchar_t* filename, int fileOptions);
+    void WriteBytesNow(const void* data, size_t size);
+    bool TryWriteDirect(const char* data, size_t size);
 
 public:
     File(const std::wstring& filename, int fileOptions);
@@ -107,7 +120,25 @@ public:
     File(const wchar_t* filename, int fileOptions);
     ~File();
 
-    void Flush();
+    void Flush(); // also waits for asynchronous writes, and rethrows their errors
+
+    // size of the stdio buffer of files opened with fileOptionsSequential (default: 4 MB)
+    static void SetSequentialBufferSize(size_t bytes) { s_sequentialBufferSize = bytes; }
+    // let files opened with fileOptionsDirect write large blocks with direct I/O (Linux only; default: off)
+    static void EnableDirectIO(bool enable) { s_directIO = enable; }
+
+    // Writes a block of binary data on another thread, after the asynchronous writes started before, e.g. while the
+    // caller prepares the next block. The other methods of File wait for them before they access the file, but
+    // writes to the FILE* of the file do not.
+    std::shared_future<void> WriteAsync(std::vector<char>&& data);
+    void WaitForAsyncWrites()
+    {
+        if (m_asyncWrite.valid())
+        {
+            auto asyncWrite = std::move(m_asyncWrite);
+            asyncWrite.get(); // rethrows the first error of the asynchronous writes
+        }
+    }
 
     bool CanSeek() const { return m_seekable; }
     size_t Size();
@@ -156,6 +187,7 @@ public:
     template <typename T>
     File& operator<<(T val)
     {
+        WaitForAsyncWrites();
         {
             if (IsTextBased())
                 fputText(m_file, val);
@@ -201,6 +233,8 @@ public:
     void ReadString(wchar_t* str, int size);                           // read up to size bytes, or a zero terminator (or space in text mode)
     void ReadChars(std::string& val, size_t cnt, bool reset = false);  // read a specified number of characters, and reset read pointer if requested
     void ReadChars(std::wstring& val, size_t cnt, bool reset = false); // read a specified number of characters, and reset read pointer if requested
+    void WriteBytes(const void* data, size_t size);                    // write a block of binary data (binary files only)
+    void ReadBytes(void* data, size_t size);                           // read a block written by WriteBytes()
 
     File& operator>>(std::wstring& val);
     File& operator>>(std::string& val);
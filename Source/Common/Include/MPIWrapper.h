@@ -14,11 +14,16 @@
 #endif
 #pragma comment(lib, "msmpi.lib")
 
+#if defined(OPEN_MPI) && !defined(_MSC_VER)
+#include "mpi-ext.h" // for MPIX_CUDA_AWARE_SUPPORT
+#endif
+
 
 #include <string>
 #include <array>
 #include <vector>
 #include <memory>
+#include <stdexcept>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -30,6 +35,22 @@ struct MpiFail : public std::string
     }
 };
 
+// thrown instead of aborting the job when an MPI operation fails because a node was lost (see MPIWrapper::EnableElasticity())
+struct MpiNodeLost : public std::runtime_error
+{
+    MpiNodeLost(const std::string &what)
+        : std::runtime_error(what)
+    {
+    }
+};
+
+// whether the loss of a node is reported as MpiNodeLost (shared by all translation units)
+inline bool &MpiElasticityEnabled()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
 static int operator||(int rc, const MpiFail &what)
 {
     if (rc == MPI_SUCCESS)
@@ -40,6 +61,16 @@ static int operator||(int rc, const MpiFail &what)
     fprintf(stderr, "%s, MPI error %d\n", what.c_str(), rc);
     fflush(stderr);
 
+#ifdef MPIX_ERR_PROC_FAILED
+    if (MpiElasticityEnabled())
+    {
+        int errorClass = MPI_SUCCESS;
+        MPI_Error_class(rc, &errorClass);
+        if (errorClass == MPIX_ERR_PROC_FAILED || errorClass == MPIX_ERR_REVOKED)
+            throw MpiNodeLost(what);
+    }
+#endif
+
     // (special case: we use that code to indicate a missing msmpi.dll...)
     if (rc != MPI_ERR_INTERN)
     {
@@ -70,6 +101,10 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
     // MPI communicator that reflects the current subset selection
     MPI_Comm m_currentComm;
 
+    // hierarchical all-reduce (see EnableHierarchicalAllReduce())
+    MPI_Comm m_hostComm;   // all nodes on the same host; MPI_COMM_NULL if not enabled
+    MPI_Comm m_leaderComm; // rank 0 of each host; MPI_COMM_NULL on all other nodes
+
     static MPIWrapperPtr s_mpi;
 
     // MPI_Init() with delay-loading the msmpi.dll (possibly causing a failure if missing; we want to catch that)
@@ -119,7 +154,7 @@ class MPIWrapper : public std::enable_shared_from_this<MPIWrapper>
 
 public:
     MPIWrapper()
-        : m_currentComm(MPI_COMM_WORLD)
+        : m_currentComm(MPI_COMM_WORLD), m_hostComm(MPI_COMM_NULL), m_leaderComm(MPI_COMM_NULL)
     {
         static bool initialized = false;
         if (initialized)
@@ -313,6 +348,101 @@ public:
         return sizeof(size_t) == 4 ? MPI_UNSIGNED : MPI_LONG_LONG_INT;
     }
 
+    // switch all-reductions to a topology-aware scheme: first reduce within each host (through shared memory),
+    // then all-reduce across hosts among one leader per host, then broadcast within each host.
+    // This sends each host's contribution through the network once rather than once per process.
+    // Must be called by all nodes. Only applies while all nodes are in use.
+    void EnableHierarchicalAllReduce()
+    {
+        if (UsesHierarchicalAllReduce())
+            return;
+
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, m_myRank, MPI_INFO_NULL, &m_hostComm) || MpiFail("EnableHierarchicalAllReduce: MPI_Comm_split_type");
+        int hostRank, numHostNodes;
+        MPI_Comm_rank(m_hostComm, &hostRank);
+        MPI_Comm_size(m_hostComm, &numHostNodes);
+        MPI_Comm_split(MPI_COMM_WORLD, (hostRank == 0) ? 0 : MPI_UNDEFINED, m_myRank, &m_leaderComm) || MpiFail("EnableHierarchicalAllReduce: MPI_Comm_split");
+
+        fprintf(stderr, "mpihelper: hierarchical all-reduce enabled; we (%d) are %s of %d nodes on this host\n",
+                (int) m_myRank, (hostRank == 0) ? "the leader" : "a member", numHostNodes);
+        fflush(stderr);
+    }
+    bool UsesHierarchicalAllReduce() const
+    {
+        return m_hostComm != MPI_COMM_NULL;
+    }
+
+    // -----------------------------------------------------------------------
+    // elasticity: continuing with the surviving nodes when a node is lost
+    // This needs an MPI library with the ULFM fault-tolerance extensions (MPIX_Comm_revoke(), MPIX_Comm_shrink()).
+    // -----------------------------------------------------------------------
+
+    static bool SupportsElasticity()
+    {
+#ifdef MPIX_ERR_PROC_FAILED
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // report a failure of an MPI operation because of a lost node as MpiNodeLost, rather than aborting the job
+    // Must be called by all nodes, while all of them are in use.
+    void EnableElasticity()
+    {
+        if (!SupportsElasticity())
+            RuntimeError("EnableElasticity: The MPI library does not support the ULFM fault-tolerance extensions.");
+        if (!UsingAllNodes())
+            LogicError("EnableElasticity: Cannot be used with a subset of the nodes.");
+        MPI_Comm_set_errhandler(m_currentComm, MPI_ERRORS_RETURN) || MpiFail("EnableElasticity: MPI_Comm_set_errhandler");
+        MpiElasticityEnabled() = true;
+    }
+
+    // after an MpiNodeLost, continue with the surviving nodes, which are ranked anew
+    // This first revokes the current communicator, so that the survivors that are still waiting in an operation fail out of it
+    // as well. Must then be called by all of them. Hierarchical all-reduce is turned off. Returns the number of nodes lost.
+    size_t ShrinkToSurvivors()
+    {
+#ifdef MPIX_ERR_PROC_FAILED
+        MPIX_Comm_revoke(m_currentComm); // (fails if another node revoked it already)
+        MPI_Comm survivors;
+        MPIX_Comm_shrink(m_currentComm, &survivors) || MpiFail("ShrinkToSurvivors: MPIX_Comm_shrink");
+        MPI_Comm_set_errhandler(survivors, MPI_ERRORS_RETURN) || MpiFail("ShrinkToSurvivors: MPI_Comm_set_errhandler");
+        if (m_currentComm != MPI_COMM_WORLD)
+            MPI_Comm_free(&m_currentComm);
+        m_currentComm = survivors;
+        m_hostComm = MPI_COMM_NULL; // (the host and leader communicators of the lost nodes are abandoned)
+        m_leaderComm = MPI_COMM_NULL;
+
+        int numSurvivors;
+        MPI_Comm_rank(m_currentComm, &m_myRank);
+        MPI_Comm_size(m_currentComm, &numSurvivors);
+        size_t numLost = m_numMPINodes - numSurvivors;
+        m_numMPINodes = numSurvivors;
+        m_numNodesInUse = numSurvivors;
+        s_myRank = m_myRank;
+        fprintf(stderr, "mpihelper: lost %d nodes; we are now cog %d in a gearbox of %d\n", (int) numLost, (int) m_myRank, (int) m_numMPINodes);
+        fflush(stderr);
+        return numLost;
+#else
+        LogicError("ShrinkToSurvivors: The MPI library does not support the ULFM fault-tolerance extensions.");
+#endif
+    }
+
+    // whether the MPI library accepts GPU device pointers
+    // This can only be queried for Open MPI; for other libraries, we must trust the user ('assumed').
+    static bool IsCudaAware(bool assumed)
+    {
+#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+        return MPIX_Query_cuda_support() != 0;
+#elif defined(MPIX_CUDA_AWARE_SUPPORT)
+        assumed;
+        return false; // Open MPI built without CUDA support
+#else
+        return assumed;
+#endif
+    }
+
     // allreduce of a vector
     template <typename VECTORLIKEOBJECT>
     void AllReduce(VECTORLIKEOBJECT &accumulator) const
@@ -323,7 +453,7 @@ public:
         // use MPI to compute the sum over all elements in (dataptr, totalnumelements) and redistribute to all nodes
         if ((NumNodesInUse() > 1) && (Communicator() != MPI_COMM_NULL))
         {
-            MPI_Allreduce(MPI_IN_PLACE, dataptr, (int) totalnumelements, GetDataType(dataptr), MPI_SUM, Communicator()) || MpiFail("allreduce: MPI_Allreduce");
+            AllReduceImpl(dataptr, totalnumelements, "allreduce");
         }
     }
 
@@ -333,10 +463,37 @@ public:
     {
         if ((NumNodesInUse() > 1 && (Communicator() != MPI_COMM_NULL)))
         {
-            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail("Allreduce: MPI_Allreduce");
+            AllReduceImpl(pData, nData, "Allreduce");
         }
     }
 
+    // non-blocking allreduce; complete it with MPI_Wait() on 'request'
+    // In hierarchical mode, the reduction is done right away, and 'request' is set to MPI_REQUEST_NULL.
+    template <class ElemType>
+    void AllReduceAsync(ElemType *pData, size_t nData, MPI_Request *request) const
+    {
+        if (UsesHierarchicalAllReduce() && UsingAllNodes())
+        {
+            AllReduceImpl(pData, nData, "AllReduceAsync");
+            *request = MPI_REQUEST_NULL;
+        }
+        else
+        {
+            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
+            MPI_Iallreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator(), request) || MpiFail("AllReduceAsync: MPI_Iallreduce");
+        }
+    }
+
+    // non-blocking reduction to 'dstRank', in place there; the data of the other ranks is left unchanged
+    template <class ElemType>
+    void ReduceAsync(ElemType *pData, size_t nData, size_t dstRank, MPI_Request *request) const
+    {
+        if (CurrentNodeRank() == dstRank)
+            MPI_Ireduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, (int) dstRank, Communicator(), request) || MpiFail("ReduceAsync: MPI_Ireduce");
+        else
+            MPI_Ireduce(pData, nullptr, (int) nData, GetDataType(pData), MPI_SUM, (int) dstRank, Communicator(), request) || MpiFail("ReduceAsync: MPI_Ireduce");
+    }
+
     template <class ElemType>
     void Bcast(ElemType *pData, size_t nData, size_t srcRank)
     {
@@ -351,6 +508,23 @@ public:
     {
         MPI_Barrier(m_currentComm) || MpiFail("waitall: MPI_Barrier");
     }
+
+private:
+    template <class ElemType>
+    void AllReduceImpl(ElemType *pData, size_t nData, const char *what) const
+    {
+        if (!UsesHierarchicalAllReduce() || !UsingAllNodes())
+        {
+            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, Communicator()) || MpiFail(std::string(what) + ": MPI_Allreduce");
+            return;
+        }
+
+        bool isLeader = (m_leaderComm != MPI_COMM_NULL);
+        MPI_Reduce(isLeader ? MPI_IN_PLACE : pData, pData, (int) nData, GetDataType(pData), MPI_SUM, 0, m_hostComm) || MpiFail(std::string(what) + ": MPI_Reduce");
+        if (isLeader)
+            MPI_Allreduce(MPI_IN_PLACE, pData, (int) nData, GetDataType(pData), MPI_SUM, m_leaderComm) || MpiFail(std::string(what) + ": MPI_Allreduce");
+        MPI_Bcast(pData, (int) nData, GetDataType(pData), 0, m_hostComm) || MpiFail(std::string(what) + ": MPI_Bcast");
+    }
 };
 
 }}}
@@ -0,0 +1,256 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MPMCQueue.h -- bounded lock-free multi-producer multi-consumer queue, and a pool of reusable objects on top of it
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// MPMCQueue -- bounded queue for any number of producer and consumer threads (after D. Vyukov's bounded MPMC queue).
+// Each cell carries a sequence number that tells whether it is free for the position a producer claimed, or filled
+// for the position a consumer claimed, so that a push or pop costs one compare-exchange on the position counter.
+// TryPush()/TryPop() never block. Push()/Pop() spin briefly, then wait on a condition variable; the mutex is only
+// touched by threads that have to wait, and by the threads that wake them.
+// The capacity is rounded up to a power of two.
+// -----------------------------------------------------------------------
+
+template <typename T>
+class MPMCQueue
+{
+public:
+    explicit MPMCQueue(size_t capacity)
+        : m_enqueuePos(0), m_dequeuePos(0), m_numWaiting(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~MPMCQueue()
+    {
+        while (TryConsume([](T&&) {}))
+            ;
+    }
+
+    size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // number of items, only exact while no other thread pushes or pops
+    size_t SizeApprox() const
+    {
+        size_t enqueuePos = m_enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeuePos = m_dequeuePos.load(std::memory_order_relaxed);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    // returns false if the queue is full
+    template <typename U>
+    bool TryPush(U&& item)
+    {
+        return TryPush(std::forward<U>(item), /*wake=*/true);
+    }
+
+    // returns false if the queue is empty
+    bool TryPop(T& item)
+    {
+        return TryConsume([&item](T&& value) { item = std::move(value); });
+    }
+
+    // pops an item into 'consume', for item types that are not default constructible or assignable
+    template <typename F>
+    bool TryConsume(F&& consume)
+    {
+        return TryConsume(std::forward<F>(consume), /*wake=*/true);
+    }
+
+    // waits while the queue is full
+    template <typename U>
+    void Push(U&& item)
+    {
+        Wait([&](bool wake) { return TryPush(std::forward<U>(item), wake); });
+    }
+
+    // waits while the queue is empty
+    T Pop()
+    {
+        T item;
+        Wait([&](bool wake) { return TryConsume([&item](T&& value) { item = std::move(value); }, wake); });
+        return item;
+    }
+
+private:
+    // 'wake' is false when called under m_mutex, the caller wakes the waiting threads once it has released it
+    template <typename U>
+    bool TryPush(U&& item, bool wake)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+            if (diff == 0)
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // the cell still holds the item of the previous round
+            else
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+        new (&cell->storage) T(std::forward<U>(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        if (wake)
+            WakeWaiting();
+        return true;
+    }
+
+    template <typename F>
+    bool TryConsume(F&& consume, bool wake)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+            if (diff == 0)
+            {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false; // the cell has not been filled yet in this round
+            else
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+        T* value = reinterpret_cast<T*>(&cell->storage);
+        consume(std::move(*value));
+        value->~T();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        if (wake)
+            WakeWaiting();
+        return true;
+    }
+
+    // retries 'tryOperation(wake)' until it succeeds; spins for short waits, then sleeps until a push or pop happens
+    template <typename F>
+    void Wait(F tryOperation)
+    {
+        for (int i = 0; i < s_numSpins; i++)
+        {
+            if (tryOperation(true))
+                return;
+            std::this_thread::yield();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_numWaiting.fetch_add(1);
+            // pairs with the fence in WakeWaiting(): either the waker sees us waiting, or we see its push or pop
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_condition.wait(lock, [&]() { return tryOperation(false); });
+            m_numWaiting.fetch_sub(1);
+        }
+        // our push or pop may be what another waiting thread waits for
+        WakeWaiting();
+    }
+
+    void WakeWaiting()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_numWaiting.load(std::memory_order_relaxed) == 0)
+            return;
+        // taking the mutex makes sure a waiter that has not seen the change yet is waiting by now
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_condition.notify_all();
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    };
+
+    static const int s_numSpins = 64;
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    // the positions are written by different threads, keep them on separate cache lines
+    // (padded rather than aligned, objects on the heap do not get extended alignment)
+    char m_padding0[64];
+    std::atomic<size_t> m_enqueuePos;
+    char m_padding1[64];
+    std::atomic<size_t> m_dequeuePos;
+    char m_padding2[64];
+    std::atomic<size_t> m_numWaiting;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+public:
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+};
+
+// -----------------------------------------------------------------------
+// ObjectPool -- recycles objects between threads, e.g. buffers or per-thread workspaces. Get() takes an object that
+// was returned earlier, or creates one; Return() keeps it for a later Get(), unless 'capacity' objects are kept
+// already, in which case it is destroyed.
+// -----------------------------------------------------------------------
+
+template <typename T>
+class ObjectPool
+{
+public:
+    explicit ObjectPool(size_t capacity = 256)
+        : m_objects(capacity)
+    {
+    }
+
+    T Get(const std::function<T()>& factory)
+    {
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+        T* object = nullptr;
+        if (!m_objects.TryConsume([&](T&& value) { object = new (&storage) T(std::move(value)); }))
+            return factory();
+        T result(std::move(*object));
+        object->~T();
+        return result;
+    }
+
+    template <typename U>
+    void Return(U&& object)
+    {
+        m_objects.TryPush(std::forward<U>(object)); // dropped if the pool is full
+    }
+
+private:
+    MPMCQueue<T> m_objects;
+};
+
+}}}
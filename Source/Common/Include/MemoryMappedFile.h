@@ -0,0 +1,52 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A read-only mapping of a whole file into memory.
+// Deserializers can parse chunks directly from the mapping instead of reading them into private buffers,
+// so that the workers on a host that read the same corpus share the pages of the OS file cache.
+// A copy-on-write mapping can also be written to; the pages written to become private copies, and the file is not changed.
+class MemoryMappedFile
+{
+public:
+    // Maps the file; throws if it cannot be opened or mapped.
+    explicit MemoryMappedFile(const std::wstring& filename, bool copyOnWrite = false);
+    ~MemoryMappedFile();
+
+    // Start of the mapping, nullptr for an empty file.
+    const char* Data() const { return m_data; }
+
+    // Start of a copy-on-write mapping, nullptr for a read-only mapping or an empty file.
+    char* WritableData() const { return m_copyOnWrite ? const_cast<char*>(m_data) : nullptr; }
+
+    // Size of the file in bytes.
+    size_t Size() const { return m_size; }
+
+    // Hints that the given range of the file will be read soon, so that the OS can page it in ahead of time.
+    void WillNeed(size_t offset, size_t size) const;
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+
+private:
+    std::wstring m_filename;
+    bool m_copyOnWrite;
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;    // HANDLE
+    void* m_mapping; // HANDLE
+#endif
+};
+
+typedef std::shared_ptr<MemoryMappedFile> MemoryMappedFilePtr;
+
+}}}
@@ -165,6 +165,19 @@ public:
         printf("EVALERR: %.7f%%\n", err);
     }
 
+    // emit a trace message for the device memory used by one category of data, e.g. "activations", in MB
+    static void TraceMemoryUsage(const char* category, double currentMB, double peakMB)
+    {
+        auto& us = GetStaticInstance();
+
+        if (!us.m_enabled)
+        {
+            return;
+        }
+
+        printf("MEMORY: %s %.1f MB (peak %.1f MB)\n", category, currentMB, peakMB);
+    }
+
     // This prints a PROGRESS message with a percentage value of 0 to prevent timeouts on Philly
     // when executing long running non-training operations like PreCompute, CV, Eval, and Write
     static size_t TraceFakeProgress(size_t numIterationsBeforePrintingProgress, size_t numItersSinceLastPrintOfProgress)
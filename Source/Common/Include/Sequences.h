@@ -137,6 +137,7 @@ struct MBLayout
         m_distanceToNearestEnd = other->m_distanceToNearestEnd;
 
         m_timeStepHasGap = other->m_timeStepHasGap;
+        m_activeSequenceRange = other->m_activeSequenceRange;
 
         m_columnsValidityMask.SetValue(other->m_columnsValidityMask);
         m_writable = other->m_writable;
@@ -163,6 +164,7 @@ struct MBLayout
         m_distanceToNearestEnd = std::move(other->m_distanceToNearestEnd);
 
         m_timeStepHasGap = std::move(other->m_timeStepHasGap);
+        m_activeSequenceRange = std::move(other->m_activeSequenceRange);
 
         m_columnsValidityMask = std::move(other->m_columnsValidityMask);
         m_writable = other->m_writable;
@@ -185,6 +187,7 @@ public:
         m_distanceToNearestStart.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
+        m_activeSequenceRange.assign(m_numTimeSteps, make_pair(m_numParallelSequences, (size_t) 0)); // (empty)
         m_columnsValidityMask.Resize(0, 0); // invalidate
         // reset state
         m_numFramesDeclared = 0;
@@ -378,6 +381,10 @@ public:
         else
             for (size_t t = b; t < e; t++)
             {
+                // extend the range of parallel sequences that have content in this time step
+                auto& activeSequenceRange = m_activeSequenceRange[t];
+                activeSequenceRange.first = min(activeSequenceRange.first, s);
+                activeSequenceRange.second = max(activeSequenceRange.second, s + 1);
                 // update the nearest sentence boundaries, minimum over all parallel sequences
                 // If 0, then we are on a boundary. If not 0, we can still test in presence of FrameRange.m_timeOffset.
                 ptrdiff_t distanceToStart = (ptrdiff_t) t - beginTime;
@@ -418,6 +425,7 @@ public:
         m_distanceToEnd.SetValue(0);
         m_distanceToNearestStart[0] = 0;
         m_distanceToNearestEnd[0] = 0;
+        m_activeSequenceRange[0] = make_pair((size_t) 0, numSamples);
 
         Lock();
     }
@@ -467,6 +475,15 @@ public:
         return false;
     }
 
+    // smallest range [first, second) of parallel sequences that contains all non-gap frames of time step t; (0,0) if t has none
+    // Parallel sequences outside of it are gaps in time step t, so a recurrent loop need not compute them (see FrameRange::WithSequenceRange()).
+    std::pair<size_t, size_t> GetActiveSequenceRange(size_t t) const
+    {
+        CheckIsValid();
+        const auto& range = m_activeSequenceRange[t];
+        return range.first < range.second ? range : std::pair<size_t, size_t>(0, 0);
+    }
+
     // -------------------------------------------------------------------
     // indexing
     // -------------------------------------------------------------------
@@ -550,11 +567,14 @@ private:
 
     vector<bool> m_timeStepHasGap; // [t] true if at least one gap in time step t
 
+    vector<std::pair<size_t, size_t>> m_activeSequenceRange; // [t] range of parallel sequences with content, see GetActiveSequenceRange()
+
     // Cached mask indicating the validity of each column in the MBLayout
     // TODO: We actually just need a boolean matrix for this.
     // A value of 1 indicates that the column has valid content
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
     mutable Matrix<char> m_columnsValidityMask;
+    mutable std::vector<char> m_columnsValidityMaskBuffer; // CPU-side staging of m_columnsValidityMask, kept to avoid reallocation
 
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
@@ -610,6 +630,7 @@ public:                       // TODO: make private (currently used from masking
     ptrdiff_t m_timeOffset;   // this is added to timeIdxInSeq wherever it is used
     size_t m_timeRange;       // use this to describe a custom range > 1 frame
     size_t seqIndex;          // parallel-sequence index; SIZE_MAX = all sequences in MB (most common case)  --TODO: Bad name, 'sequence' and 'parallel sequence' are two different things
+    size_t m_seqRange;        // number of consecutive parallel sequences starting at seqIndex; only used if seqIndex != SIZE_MAX
     MBLayoutPtr m_pMBLayout;  // layout associated with this
     bool m_broadcastAllowed;  // frame range may be broadcast from outer layout (e.g. a matrix with NULL layout and 1 column is acceptable to this frame range). Only applies when iterating over time; otherwise broadcasting is always OK.
     const FrameRange *parent; // or NULL: parent range, relative to which this FrameRange is interpreted  --TODO: not used yet
@@ -617,7 +638,7 @@ public:                       // TODO: make private (currently used from masking
 public:
     // can construct from a single size_t -> a single-frame range
     FrameRange(MBLayoutPtr pMBLayout, size_t timeIdxInSeq)
-        : timeIdxInSeq(timeIdxInSeq), m_timeOffset(0), m_timeRange(1), seqIndex(SIZE_MAX), m_pMBLayout(pMBLayout), m_broadcastAllowed(false), parent(nullptr)
+        : timeIdxInSeq(timeIdxInSeq), m_timeOffset(0), m_timeRange(1), seqIndex(SIZE_MAX), m_seqRange(1), m_pMBLayout(pMBLayout), m_broadcastAllowed(false), parent(nullptr)
     {
     }
 
@@ -648,6 +669,19 @@ public:
     {
         FrameRange ret = *this;
         ret.seqIndex = s;
+        ret.m_seqRange = 1;
+        return ret;
+    }
+
+    // create a FrameRange that accesses the consecutive parallel sequences [begin, end) only
+    // This is used by recurrent loops to skip parallel sequences that are gaps in a time step, see MBLayout::GetActiveSequenceRange().
+    FrameRange WithSequenceRange(size_t begin, size_t end) const
+    {
+        if (end <= begin)
+            LogicError("FrameRange::WithSequenceRange: The range of parallel sequences must not be empty.");
+        FrameRange ret = *this;
+        ret.seqIndex = begin;
+        ret.m_seqRange = end - begin;
         return ret;
     }
 
@@ -702,7 +736,7 @@ public:
         else if (seqIndex == SIZE_MAX) return
             make_pair(0, m_pMBLayout->GetNumParallelSequences());
         else return
-            make_pair(seqIndex, seqIndex + 1);
+            make_pair(seqIndex, seqIndex + m_seqRange);
     }
 
     std::pair<size_t, size_t> GetTimeRange() const
@@ -721,7 +755,7 @@ public:
             true; // target has no layout: This would broadcast.
         else return
             (pMBLayout->GetNumTimeSteps()         == 1 || (!IsAllFrames() && m_timeRange == 1)) &&
-            (pMBLayout->GetNumParallelSequences() == 1 || seqIndex != SIZE_MAX);
+            (pMBLayout->GetNumParallelSequences() == 1 || (seqIndex != SIZE_MAX && m_seqRange == 1));
     }
 
     // code that can only handle single-frame ranges will call t() to get the time index, which will throw if numFrames != 1
@@ -766,7 +800,7 @@ inline bool MBLayout::HasGaps(const FrameRange &fr) const
     if (fr.seqIndex == SIZE_MAX)
         return m_timeStepHasGap[fr.timeIdxInSeq]; // test all seq for one time step
     else
-        return IsGap(fr); // test one sequence
+        return IsGap(fr); // test one sequence or a range of them
 }
 
 // test whether a given frame is or contains a gap
@@ -781,6 +815,13 @@ inline bool MBLayout::IsGap(const FrameRange &fr) const
     const auto s = fr.seqIndex;
     if (s == SIZE_MAX) // aggregate requested
         return m_timeStepHasGap[t];
+    if (fr.m_seqRange > 1) // range of parallel sequences: test each
+    {
+        for (size_t s1 = s; s1 < s + fr.m_seqRange; s1++)
+            if (IsGap(fr.Sequence(s1)))
+                return true;
+        return false;
+    }
 
     // determine flags from matrices
     return m_distanceToStart(s, t) < 0; // value is -1 for gaps, non-negative otherwise
@@ -809,6 +850,13 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
             return true;
         return false;
     }
+    if (fr.m_seqRange > 1) // range of parallel sequences: test each
+    {
+        for (size_t s1 = s; s1 < s + fr.m_seqRange; s1++)
+            if (IsBeyondStartOrEnd(fr.Sequence(s1)))
+                return true;
+        return false;
+    }
 
     // determine flags from matrices
     auto distanceToStart = (ptrdiff_t) m_distanceToStart(s, t);
@@ -832,9 +880,9 @@ inline bool MBLayout::IsBeyondStartOrEnd(const FrameRange &fr) const
 inline size_t MBLayout::GetActualNumSamples() const { return m_numFramesDeclared - m_numGapFrames; }
 
 // return m_columnsValidityMask(,), which is lazily created here upon first call
-// only called from MaskMissingColumnsTo()
-// TODO: Can probably be faster by using the sequence array directly.
-// TODO: Or should we just blast m_distanceToStart to GPU, and maks based on that? It is small compared to features.
+// Called from MaskMissingColumnsTo(), and right after reading a minibatch (see DataReaderHelpers::GetMinibatchIntoNetwork()),
+// so that the upload happens together with that of the input data rather than stalling the device in the middle of
+// forward propagation. All nodes with this layout share the mask; its device buffer is reused across minibatches.
 inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE deviceId) const
 {
     CheckIsValid();
@@ -844,33 +892,27 @@ inline const Matrix<char>& MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
         assert(HasGaps()); // must only be called if there are gaps
         Lock();
 
-        // Determine indices of all invalid columns in the minibatch
-        // TODO: This can be done more efficiently by using m_sequences[].
+        // form the mask in a CPU-side buffer first: all columns are valid except for the frames of the gaps
         size_t nT = GetNumTimeSteps();
         size_t nS = GetNumParallelSequences();
-
-        std::vector<char> columnsValidityMask(nT * nS, 1); // form the mask in a CPU-side STL vector first
+        m_columnsValidityMaskBuffer.assign(nT * nS, 1);
         size_t gapsFound = 0;
-        for (size_t t = 0; t < nT; t++)
+        for (const auto& seq : m_sequences)
         {
-            FrameRange fr(nullptr, t);
-            if (IsGap(fr))
-            {
-                for (size_t s = 0; s < nS; s++)
-                {
-                    if (IsGap(fr.Sequence(s)))
-                    {
-                        columnsValidityMask[(t * nS) + s] = 0;
-                        gapsFound++;
-                    }
-                }
-            }
+            if (seq.seqId != GAP_SEQUENCE_ID)
+                continue;
+            size_t b = (size_t) max(seq.tBegin, (ptrdiff_t) 0);
+            size_t e = min(seq.tEnd, nT);
+            for (size_t t = b; t < e; t++)
+                m_columnsValidityMaskBuffer[(t * nS) + seq.s] = 0;
+            gapsFound += e - b;
         }
         assert(gapsFound == m_numGapFrames); // sanity check
+        UNUSED(gapsFound);
 
         if (deviceId != m_columnsValidityMask.GetDeviceId())
             m_columnsValidityMask = Matrix<char>(deviceId);
-        m_columnsValidityMask.SetValue(1, nS * nT, deviceId, columnsValidityMask.data());
+        m_columnsValidityMask.SetValue(1, nS * nT, deviceId, m_columnsValidityMaskBuffer.data());
     }
     return m_columnsValidityMask;
 }
@@ -996,8 +1038,10 @@ static inline std::pair<size_t, size_t> ColumnRangeWithMBLayoutFor(size_t numCol
             return std::pair<size_t, size_t>(startColumn, numParallelSequences * fr.m_timeRange);
         else if (fr.m_timeRange != 1)
             LogicError("DataFor: FrameRange only support per-sequence time ranges with tensor slices, not matrix slices.");
+        else if (fr.seqIndex + fr.m_seqRange > numParallelSequences)
+            LogicError("DataFor: FrameRange specifies a parallel-sequence index that is out of range.");
         else
-            return std::pair<size_t, size_t>(startColumn + fr.seqIndex, 1);
+            return std::pair<size_t, size_t>(startColumn + fr.seqIndex, fr.m_seqRange);
     }
 }
 
@@ -1096,10 +1140,10 @@ static inline std::pair<DimensionVector, DimensionVector> TensorSliceWithMBLayou
             if (result.second[sequenceDim] > 1 /*>1 sequence (not broadcasting)*/)
             {
                 size_t s = fr.seqIndex;
-                if (s >= result.second[sequenceDim])
+                if (s + fr.m_seqRange > result.second[sequenceDim])
                     LogicError("DataFor: FrameRange specifies a parallel-sequence index that is out of range.");
                 result.first[sequenceDim] = (ElemType)s;
-                result.second[sequenceDim] = (ElemType)s + 1;
+                result.second[sequenceDim] = (ElemType)s + fr.m_seqRange;
             }
         }
     }
@@ -17,6 +17,7 @@
 #include "latticestorage.h"
 #include "simple_checked_arrays.h"
 #include "fileutil.h"
+#include "MemoryMappedFile.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -999,19 +1000,7 @@ public:
             }
 #endif
             // This is critical--we have a buggy lattice set that requires no mapping where mapping would fail
-            bool needsmapping = false;
-            foreach_index (k, idmap)
-            {
-                if (idmap[k] != (size_t) k
-#if 1
-                    && (k != (int) idmap.size() - 1 || idmap[k] != spunit) // that HACK that we add one more /sp/ entry at the end...
-#endif
-                    )
-                {
-                    needsmapping = true;
-                    break;
-                }
-            }
+            const bool needsmapping = needsidmapping(idmap, spunit);
             // map align ids to user's symmap  --the lattice gets updated in place here
             if (needsmapping)
             {
@@ -1063,6 +1052,103 @@ public:
             RuntimeError("fread: unsupported lattice format version");
     }
 
+    // test whether the unit ids of an archive differ from the user's, other than by the /sp/ entry appended to 'idmap'
+    template <class IDMAP>
+    static bool needsidmapping(const IDMAP& idmap, size_t spunit)
+    {
+        foreach_index (k, idmap)
+        {
+            if (idmap[k] != (size_t) k
+#if 1
+                && (k != (int) idmap.size() - 1 || idmap[k] != spunit) // that HACK that we add one more /sp/ entry at the end...
+#endif
+                )
+                return true;
+        }
+        return false;
+    }
+
+    // flat format (V3)
+    // A flat lattice holds the arrays that training consumes--nodes, and edges and alignments in the layout that is copied to the GPU--
+    // at 16-byte aligned offsets and without tags, so that it can be taken from a memory-mapped archive with one copy per array and
+    // without rebuildedges(). Records are expected at 16-byte aligned offsets, see fpadflat().
+    static const size_t flatalignment = 16;
+    struct flatheader
+    {
+        char tag[4];           // "LAT "
+        unsigned int version;  // 3
+        header_v1_v2 info;
+        uint64_t numalign;
+    };
+    static_assert(sizeof(flatheader) % flatalignment == 0, "unexpected size of flatheader");
+
+    // write zeroes up to the next flat-format alignment boundary
+    static void fpadflat(FILE* f, size_t bytesused)
+    {
+        static const char zeroes[flatalignment] = { 0 };
+        const size_t padding = (flatalignment - bytesused % flatalignment) % flatalignment;
+        if (padding > 0)
+            fwriteOrDie(zeroes, 1, padding, f);
+    }
+
+    // write in flat format; the V1 data (nodes, edges, align) must be current, e.g. through rebuildedges()
+    void fwriteflat(FILE* f) const
+    {
+        flatheader h;
+        memcpy(h.tag, "LAT ", sizeof(h.tag));
+        h.version = 3;
+        h.info = info;
+        h.numalign = align.size();
+        fwriteOrDie(&h, sizeof(h), 1, f);
+        fwriteOrDie(nodes, f);
+        fpadflat(f, nodes.size() * sizeof(nodeinfo));
+        fwriteOrDie(edges, f);
+        fpadflat(f, edges.size() * sizeof(edgeinfowithscores));
+        fwriteOrDie(align, f);
+        fpadflat(f, align.size() * sizeof(aligninfo));
+    }
+
+    template <class VECTOR>
+    static void readflatvector(const char* data, size_t size, size_t& pos, VECTOR& v, size_t n)
+    {
+        const size_t bytes = n * sizeof(v[0]);
+        if (bytes > size - pos)
+            RuntimeError("fromflat: malformed file, lattice extends beyond the end of the archive");
+        v.resize(n);
+        if (n > 0)
+            memcpy(&v[0], data + pos, bytes);
+        pos += (bytes + flatalignment - 1) / flatalignment * flatalignment;
+        pos = std::min(pos, size);
+    }
+
+    // read a flat lattice from memory, e.g. a memory-mapped archive; 'size' is the number of bytes available at 'data'
+    // Like fread(), this maps the units to the user's symbol table through idmap, and is safe to be used in retry loops.
+    template <class IDMAP>
+    void fromflat(const char* data, size_t size, const IDMAP& idmap, size_t spunit)
+    {
+        flatheader h;
+        if (size < sizeof(h))
+            RuntimeError("fromflat: malformed file, lattice extends beyond the end of the archive");
+        memcpy(&h, data, sizeof(h));
+        if (memcmp(h.tag, "LAT ", sizeof(h.tag)) != 0 || h.version != 3)
+            RuntimeError("fromflat: not a flat (V3) lattice");
+        info = h.info;
+        size_t pos = sizeof(h);
+        readflatvector(data, size, pos, nodes, info.numnodes);
+        if (nodes.empty() || nodes.back().t != info.numframes)
+            RuntimeError("fromflat: mismatch between info.numframes and last node's time");
+        readflatvector(data, size, pos, edges, info.numedges);
+        readflatvector(data, size, pos, align, h.numalign);
+        if (needsidmapping(idmap, spunit))
+        {
+            foreach_index (k, align)
+                align[k].updateunit(idmap);
+        }
+        // the V2 data is only needed for building and converting archives
+        edges2.clear();
+        uniquededgedatatokens.clear();
+    }
+
     // parallel versions (defined in parallelforwardbackward.cpp)
     class parallelstate
     {
@@ -1212,6 +1298,34 @@ class archive
 
     mutable size_t currentarchiveindex;               // which archive is open
     mutable auto_file_ptr f;                          // cached archive file handle of currentarchiveindex
+    // flat archives (see flatten()) are memory-mapped instead of read through 'f'
+    mutable std::vector<Microsoft::MSR::CNTK::MemoryMappedFilePtr> flatmappings; // [archiveindex] -> mapping, or null if not a flat archive
+    mutable std::vector<bool> flatchecked;                                       // [archiveindex] -> flatmappings[] is valid
+    static const char* flatarchivetag()
+    {
+        return "LATF";
+    }
+    // the mapping of an archive if it is a flat archive, else null; the header is read once per archive
+    const Microsoft::MSR::CNTK::MemoryMappedFilePtr& getflatmapping(size_t archiveindex) const
+    {
+        if (!flatchecked[archiveindex])
+        {
+            char tag[4] = { 0 };
+            {
+                auto_file_ptr fheader(fopenOrDie(archivepaths[archiveindex], L"rbS"));
+                if (::fread(tag, sizeof(tag), 1, fheader) != 1) // (an empty archive is not flat)
+                    tag[0] = 0;
+            }
+            if (memcmp(tag, flatarchivetag(), sizeof(tag)) == 0)
+            {
+                flatmappings[archiveindex] = std::make_shared<Microsoft::MSR::CNTK::MemoryMappedFile>(archivepaths[archiveindex]);
+                if (verbosity > 0)
+                    fprintf(stderr, "getflatmapping: memory-mapped flat lattice archive '%S'\n", archivepaths[archiveindex].c_str());
+            }
+            flatchecked[archiveindex] = true;
+        }
+        return flatmappings[archiveindex];
+    }
     std::unordered_map<std::wstring, latticeref> toc; // [key] -> (file, offset)  --table of content (.toc file)
 public:
     // construct = open the archive
@@ -1293,6 +1407,8 @@ public:
 
         // initialize symmaps  --alloc the array, but actually read the symmap on demand
         symmaps.resize(archivepaths.size());
+        flatmappings.resize(archivepaths.size());
+        flatchecked.resize(archivepaths.size(), false);
     }
 
     // check if a lattice for a given key is available  --do this during initial check ideally
@@ -1335,18 +1451,28 @@ public:
         if (spunit2 != spunit)
             LogicError("getlattice: huh? same lookup of /sp/ gives different result?");
 #endif
+        const auto& flatmapping = getflatmapping(archiveindex);
         // open archive file in case it is not the current one
-        if (archiveindex != currentarchiveindex)
+        if (!flatmapping && archiveindex != currentarchiveindex)
         {
             f = fopenOrDie(archivepaths[archiveindex], L"rbS"); // or throw (will close old 'f' iff succeeded)
             currentarchiveindex = archiveindex;
         }
         try // (for read operation)
         {
-            // seek to start
-            fsetpos(f, offset);
-            // get it
-            L.fread(f, idmap, spunit);
+            if (flatmapping) // flat archive: read from the mapping
+            {
+                if (offset >= flatmapping->Size())
+                    RuntimeError("getlattice: TOC offset beyond the end of the archive for '%S'", key.c_str());
+                L.fromflat(flatmapping->Data() + offset, flatmapping->Size() - offset, idmap, spunit);
+            }
+            else
+            {
+                // seek to start
+                fsetpos(f, offset);
+                // get it
+                L.fread(f, idmap, spunit);
+            }
             L.setverbosity(verbosity);
 #ifdef HACK_IN_SILENCE // hack to simulate DEL in the lattice
             const size_t silunit = getid(modelsymmap, "sil");
@@ -1380,6 +1506,10 @@ public:
     //  - merge two lattices (for merging numer into denom lattices)
     static void convert(const std::wstring& intocpath, const std::wstring& intocpath2, const std::wstring& outpath,
                         const msra::asr::simplesenonehmm& hset);
+
+    // static method for converting an archive to the flat format, which getlattice() reads from a memory mapping
+    // Output is the archive 'outpath' and its 'outpath'.toc and 'outpath'.symlist, as for convert().
+    static void flatten(const std::wstring& intocpath, const std::wstring& outpath, const msra::asr::simplesenonehmm& hset);
 };
 };
 };
@@ -0,0 +1,152 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "MemoryMappedFile.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename, bool copyOnWrite)
+    : m_filename(filename), m_copyOnWrite(copyOnWrite), m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+{
+    m_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        RuntimeError("Cannot open the file '%ls' for memory mapping (error %d).", filename.c_str(), (int)GetLastError());
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        CloseHandle(m_file);
+        RuntimeError("Cannot get the size of the file '%ls' (error %d).", filename.c_str(), (int)GetLastError());
+    }
+
+    m_size = (size_t)size.QuadPart;
+    if (m_size == 0)
+    {
+        return;
+    }
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping != nullptr)
+    {
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+    }
+
+    if (m_data == nullptr)
+    {
+        int error = (int)GetLastError();
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+        RuntimeError("Cannot memory map the file '%ls' (error %d).", filename.c_str(), error);
+    }
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+}
+
+void MemoryMappedFile::WillNeed(size_t, size_t) const
+{
+    // PrefetchVirtualMemory() requires Windows 8; the sequential access pattern is usually detected anyway.
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename, bool copyOnWrite)
+    : m_filename(filename), m_copyOnWrite(copyOnWrite), m_data(nullptr), m_size(0)
+{
+    std::string path = msra::strfun::utf8(filename);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        RuntimeError("Cannot open the file '%ls' for memory mapping: %s.", filename.c_str(), strerror(errno));
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        int error = errno;
+        close(fd);
+        RuntimeError("Cannot get the size of the file '%ls': %s.", filename.c_str(), strerror(error));
+    }
+
+    m_size = (size_t)status.st_size;
+    if (m_size > 0)
+    {
+        // Private mappings share the pages of the file cache until they are written to.
+        void* data = copyOnWrite ? mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+                                 : mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            int error = errno;
+            close(fd);
+            RuntimeError("Cannot memory map the file '%ls': %s.", filename.c_str(), strerror(error));
+        }
+        m_data = static_cast<const char*>(data);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+void MemoryMappedFile::WillNeed(size_t offset, size_t size) const
+{
+    if (m_data == nullptr || offset >= m_size)
+    {
+        return;
+    }
+
+    // madvise() requires a page-aligned start.
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset / pageSize * pageSize;
+    size_t end = std::min(offset + size, m_size);
+    madvise(const_cast<char*>(m_data) + start, end - start, MADV_WILLNEED);
+}
+
+#endif
+
+}}}
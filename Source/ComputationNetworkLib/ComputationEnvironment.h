@@ -40,6 +40,21 @@ struct ComputationEnvironment
         m_networkOperationMode = mode;
         return oldMode;
     }
+    // in inference, allow TimesNode to multiply with CPU weights in 16-bit integer arithmetic (see QuantizedMultiplier.h)
+    bool m_useQuantizedInference = false;
+    bool UsesQuantizedInference() const { return IsInferring() && m_useQuantizedInference; }
+
+    // in inference, allow TimesNode and ConvolutionNode to compute in 8-bit integer arithmetic (see Int8Multiplier.h), with the
+    // input ranges recorded by calibration, or with the range of each input column where none was recorded
+    bool m_useInt8Inference = false;
+    bool UsesInt8Inference() const { return IsInferring() && m_useInt8Inference; }
+
+    // while set, TimesNode and ConvolutionNode record the largest absolute value of their data input (see DoCalibrate())
+    bool m_isCalibratingInt8 = false;
+
+    // when saving, store the values of LearnableParameters as fp16 (see Matrix::WriteAsFloat16), e.g. for inference models
+    bool m_saveParametersAsFloat16 = false;
+
     // more properties should be added here as needed
 };
 typedef std::shared_ptr<ComputationEnvironment> ComputationEnvironmentPtr;
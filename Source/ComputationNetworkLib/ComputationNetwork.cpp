@@ -35,17 +35,37 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // -----------------------------------------------------------------------
 
 template <>
-vector<shared_ptr<Matrix<float>>>& MatrixPool::GetReleasedMatrices<float>()
+vector<MatrixPool::ReleasedMatrix<float>>& MatrixPool::GetReleasedMatrices<float>()
 {
     return m_releasedFloatMatrices;
 }
 
 template <>
-vector<shared_ptr<Matrix<double>>>& MatrixPool::GetReleasedMatrices<double>()
+vector<MatrixPool::ReleasedMatrix<double>>& MatrixPool::GetReleasedMatrices<double>()
 {
     return m_releasedDoubleMatrices;
 }
 
+template <>
+std::map<DEVICEID_TYPE, shared_ptr<Matrix<float>>>& MatrixPool::GetWorkspaces<float>()
+{
+    return m_floatWorkspaces;
+}
+
+template <>
+std::map<DEVICEID_TYPE, shared_ptr<Matrix<double>>>& MatrixPool::GetWorkspaces<double>()
+{
+    return m_doubleWorkspaces;
+}
+
+/*static*/ bool ComputationNetwork::s_hasDefaultMemorySharingPolicy = false;
+/*static*/ MemorySharingPolicy ComputationNetwork::s_defaultMemorySharingPolicy = MemorySharingPolicy::Full;
+/*static*/ bool ComputationNetwork::s_isElementwiseFusionEnabled = false;
+/*static*/ bool ComputationNetwork::s_isLoopInvariantHoistingEnabled = false;
+/*static*/ bool ComputationNetwork::s_isLoopGapSkippingEnabled = false;
+/*static*/ bool ComputationNetwork::s_isIncrementalCompilationEnabled = true;
+/*static*/ bool ComputationNetwork::s_isDeferredParameterInitEnabled = true;
+
 // -----------------------------------------------------------------------
 // construction
 // -----------------------------------------------------------------------
@@ -75,6 +95,9 @@ void ComputationNetwork::ClearNetwork()
     }
 
     m_nameToNodeMap.clear();
+    m_validationRecords.clear();
+    m_invalidatedNodes.clear();
+    m_nodesToValidate.clear();
 
     m_pMBLayoutOfNetwork->Init(1, 0);
 }
@@ -99,12 +122,36 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     wstring tmpFileName = fileName + L".tmp";
     SaveToFileImpl(tmpFileName, fileFormat);
     renameOrDie(tmpFileName, fileName);
+
+    // an archive of the previous model no longer matches
+    let archiveFileName = ParameterArchive::GetPath(fileName);
+    if (fexists(archiveFileName))
+    {
+        try
+        {
+            unlinkOrDie(archiveFileName);
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "WARNING: Cannot delete the parameter archive of the previous model '%ls': %s\n", archiveFileName.c_str(), e.what());
+        }
+    }
+}
+
+void ComputationNetwork::SaveParameterArchive(const wstring& fileName) const
+{
+    VerifyIsCompiled("SaveParameterArchive");
+    vector<ComputationNodeBasePtr> parameters;
+    for (let& node : GetAllNodes())
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+            parameters.push_back(node);
+    ParameterArchive::Write(ParameterArchive::GetPath(fileName), parameters);
 }
 
 // TODO: how does the file distinguish float vs double nodes?
 void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
 {
-    File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
+    File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite | FileOptions::fileOptionsSequential | FileOptions::fileOptionsDirect);
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
     // model version
@@ -197,7 +244,7 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
 // This is also used for reloading a model without recreating it, e.g. during training.
 // TODO: Why not just reload it? Because SGD::Train() holds pointers to the parameters directly? That should be fixed.
 template <class ElemType> // ElemType is the default for models prior to CNTK_MODEL_VERSION_7; after that, it is serialized, and ElemType is ignored
-void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
+void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create, const ParameterArchivePtr& parameterArchive)
 {
     fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
@@ -237,6 +284,13 @@ void ComputationNetwork::ReadPersistableParameters(File& fstream, bool create)
         else
             RuntimeError("Read: Unexpected precision tag '%ls'", precision.c_str());
 
+        if (parameterArchive && node->OperationName() == OperationNameOf(LearnableParameter))
+        {
+            if (node->Is<ComputationNode<float>>())
+                node->As<LearnableParameter<float>>()->SetParameterArchive(parameterArchive);
+            else
+                node->As<LearnableParameter<double>>()->SetParameterArchive(parameterArchive);
+        }
         node->Load(fstream, modelVersion);
 
         if (create) // loaded from scratch
@@ -265,9 +319,14 @@ void ComputationNetwork::Read(const wstring& fileName)
 {
     ClearNetwork();
 
-    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | FileOptions::fileOptionsSequential);
 
-    ReadPersistableParameters<ElemType>(fstream, true);
+    let parameterArchive = ParameterArchive::Open(ParameterArchive::GetPath(fileName));
+    if (parameterArchive)
+        fprintf(stderr, "Read: Taking the parameters from '%ls'.\n", ParameterArchive::GetPath(fileName).c_str());
+    ReadPersistableParameters<ElemType>(fstream, true, parameterArchive);
+    if (parameterArchive)
+        parameterArchive->ReleaseDeviceCopies();
 
     size_t numNodes = m_nameToNodeMap.size();
 
@@ -419,6 +478,41 @@ void ComputationNetwork::InitLearnableParameters(const ComputationNodeBasePtr& n
     LogicError("InitLearnableParameters: Input node is not a LearnableParameter<float or double>");
 }
 
+// helpers of InitDeferredParameters()
+template <class ElemType>
+static shared_ptr<LearnableParameter<ElemType>> AsDeferredParameter(const ComputationNodeBasePtr& node)
+{
+    auto learnableParameterNode = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+    return learnableParameterNode && learnableParameterNode->HasDeferredInit() ? learnableParameterNode : nullptr;
+}
+
+static void CompleteDeferredInit(const ComputationNodeBasePtr& node)
+{
+    if (auto floatNode = AsDeferredParameter<float>(node))
+        floatNode->CompleteDeferredInit();
+    else if (auto doubleNode = AsDeferredParameter<double>(node))
+        doubleNode->CompleteDeferredInit();
+}
+
+// complete the random initializations that LearnableParameters have deferred, see EnableDeferredParameterInit()
+// Parameters on the CPU are initialized in parallel, since each draws from its own random generator.
+// The GPU random generator is shared, so parameters on a GPU are initialized one after another, on the GPU.
+void ComputationNetwork::InitDeferredParameters()
+{
+    vector<ComputationNodeBasePtr> onCPU, onGPU;
+    for (const auto& node : GetAllNodes())
+    {
+        if (AsDeferredParameter<float>(node) || AsDeferredParameter<double>(node))
+            (node->GetDeviceId() == CPUDEVICE ? onCPU : onGPU).push_back(node);
+    }
+
+#pragma omp parallel for
+    for (long i = 0; i < (long) onCPU.size(); i++)
+        CompleteDeferredInit(onCPU[i]);
+    for (const auto& node : onGPU)
+        CompleteDeferredInit(node);
+}
+
 // non-static version needed because it accesses m_randomSeedOffset
 // Legacy version that is for random only.
 void ComputationNetwork::RandomInitLearnableParameters(const ComputationNodeBasePtr& node, const bool uniformInit, const unsigned long randomSeed, const double initValueScale, bool initOnCPUOnly) const
@@ -435,6 +529,7 @@ bool ComputationNetwork::IsTypicalCriterionNode(ComputationNodeBasePtr nodePtr)
         nodePtr->OperationName() == OperationNameOf(SequenceWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(CrossEntropyNode) ||
         nodePtr->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+        nodePtr->OperationName() == OperationNameOf(SampledCrossEntropyWithSoftmaxNode) ||
         nodePtr->OperationName() == OperationNameOf(ErrorPredictionNode) ||
 #ifdef COMING_SOON
         nodePtr->OperationName() == OperationNameOf(CRFNode) ||
@@ -1479,7 +1574,7 @@ void ComputationNetwork::SaveToDbnFile(ComputationNetworkPtr net, const std::wst
 }
 
 template void ComputationNetwork::Read<float>(const wstring& fileName);
-template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
+template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create, const ParameterArchivePtr& parameterArchive);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
@@ -1488,7 +1583,7 @@ template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net,
 template void ComputationNetwork::SaveToDbnFile<float>(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
 template void ComputationNetwork::Read<double>(const wstring& fileName);
-template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
+template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create, const ParameterArchivePtr& parameterArchive);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
@@ -13,6 +13,8 @@
 #include "ComputationNode.h"
 #include "ScriptableObjects.h"
 #include "ComputationEnvironment.h"
+#include "ParameterArchive.h"
+#include "NodeProfiler.h"
 
 #include <map>
 #include <string>
@@ -29,6 +31,7 @@
 #include <chrono>
 #include <unordered_map>
 #include <set>
+#include <functional>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -53,9 +56,12 @@ public:
         m_isCompiled(false),
         m_areMatricesAllocated(false),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, L"*")),
-        m_environment(make_shared<ComputationEnvironment>())
+        m_environment(make_shared<ComputationEnvironment>()),
+        m_gradientCheckpointInterval(0),
+        m_isForwardReplayEnabled(false)
     {
         //m_pMBLayoutOfNetwork->SetAxisName(L"T");
+        m_matrixPool.SetPolicy(GetDefaultMemorySharingPolicy());
     }
 
     ComputationNetwork(DEVICEID_TYPE deviceId) :
@@ -89,8 +95,9 @@ public:
     // (de-)serialization
     // -----------------------------------------------------------------------
 
+    // If an archive is given, the values of the LearnableParameters it has are taken from it.
     template <class ElemType>
-    void ReadPersistableParameters(File& fstream, bool create);
+    void ReadPersistableParameters(File& fstream, bool create, const ParameterArchivePtr& parameterArchive = nullptr);
     // reload node content only, e.g. used by SGD::Train() when going back to an older model that had better training objective
     template <class ElemType>
     void RereadPersistableParameters(const std::wstring& fileName)
@@ -119,6 +126,8 @@ public:
 
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
+    // save the values of the LearnableParameters next to a saved model, for loading them memory-mapped, see ParameterArchive
+    void SaveParameterArchive(const std::wstring& fileName) const;
 
 private:
 
@@ -135,6 +144,11 @@ public:
 
     // main entry point for backprop
     void Backprop(const ComputationNodeBasePtr rootNode);
+    // same, but calls onGradientCompleted(node) for each leaf below rootNode that needs a gradient, as soon as that gradient has received all contributions
+    // This allows to start aggregating gradients while backprop is still running on other parts of the network.
+    void Backprop(const ComputationNodeBasePtr rootNode, const std::function<void(const ComputationNodeBasePtr&)>& onGradientCompleted);
+    // leaves below rootNode that need a gradient, in the order in which Backprop() completes their gradients
+    std::vector<ComputationNodeBasePtr> GetGradientCompletionOrder(const ComputationNodeBasePtr& rootNode);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -171,10 +185,28 @@ public:
 
     void CompileNetwork(); // call this after creation, Load(), and any modification
 
+    // incremental compilation: after edits, CompileNetwork() only validates the nodes that are new, whose inputs, dimensions or
+    // MBLayout changed since the previous CompileNetwork(), and the nodes that depend on them; see DetermineNodesToValidate()
+    static void EnableIncrementalCompilation(bool enable) { s_isIncrementalCompilationEnabled = enable; }
+    static bool IsIncrementalCompilationEnabled() { return s_isIncrementalCompilationEnabled; }
+
+    // deferred parameter initialization: random initialization of LearnableParameters happens in CompileNetwork(), for all of them at
+    // once, instead of at construction; values that get loaded or set before are not initialized at all, see InitDeferredParameters()
+    static void EnableDeferredParameterInit(bool enable) { s_isDeferredParameterInitEnabled = enable; }
+    static bool IsDeferredParameterInitEnabled() { return s_isDeferredParameterInitEnabled; }
+
+    // have the next CompileNetwork() validate a node whose attributes were changed in place
+    void InvalidateNodeValidation(const ComputationNodeBasePtr& node) { m_invalidatedNodes.insert(node); }
+
 private:
     void ValidateNetwork();
+    void InitDeferredParameters();
     size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
+    void ValidateNodesUntilStable(const list<ComputationNodeBasePtr>& nodes);
     bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
+    void DetermineNodesToValidate();
+    bool AddNodesToValidate(const std::set<ComputationNodeBasePtr>& nodes, bool resetNodes);
+    void RecordValidation();
     void MarkValueNonSharableNodes();
     void ChangeNodeInputs(ComputationNodeBasePtr fromNode, ComputationNodeBasePtr toNode);
 
@@ -184,14 +216,80 @@ private:
     void CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& node, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters);
     void ResetMBLayouts();
     bool IsCompiled() const { return m_isCompiled; }
-    bool AreMatricesAllocated() const { return m_areMatricesAllocated; }
     void VerifyIsCompiled(const char* where) const;
 public:
+    bool AreMatricesAllocated() const { return m_areMatricesAllocated; }
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
 
+    // memory sharing policy of this network; must be set before AllocateAllMatrices()
+    void SetMemorySharingPolicy(MemorySharingPolicy policy)
+    {
+        if (AreMatricesAllocated())
+            LogicError("SetMemorySharingPolicy: Cannot change the memory sharing policy after matrices have been allocated.");
+        m_matrixPool.SetPolicy(policy);
+    }
+    MemorySharingPolicy GetMemorySharingPolicy() const { return m_matrixPool.GetPolicy(); }
+
+    // policy for networks created subsequently; if never set, it is derived from the legacy g_shareNodeValueMatrices flag
+    static void SetDefaultMemorySharingPolicy(MemorySharingPolicy policy)
+    {
+        s_defaultMemorySharingPolicy = policy;
+        s_hasDefaultMemorySharingPolicy = true;
+    }
+    static MemorySharingPolicy GetDefaultMemorySharingPolicy()
+    {
+        if (s_hasDefaultMemorySharingPolicy)
+            return s_defaultMemorySharingPolicy;
+        return g_shareNodeValueMatrices ? MemorySharingPolicy::Full : MemorySharingPolicy::Conservative;
+    }
+
+    // gradient checkpointing: values of nodes between checkpoints of the training criterion are discarded after ForwardProp()
+    // and recomputed segment by segment during Backprop(), trading compute for activation memory; must be set before AllocateAllMatrices()
+    //  - interval: every interval-th top-level node (in evaluation order) is made a checkpoint; 0 means none
+    //  - checkpointNodes: nodes that are checkpoints in addition
+    void SetGradientCheckpointing(size_t interval, const std::vector<ComputationNodeBasePtr>& checkpointNodes = std::vector<ComputationNodeBasePtr>())
+    {
+        if (AreMatricesAllocated())
+            LogicError("SetGradientCheckpointing: Cannot change gradient checkpointing after matrices have been allocated.");
+        m_gradientCheckpointInterval = interval;
+        m_gradientCheckpointNodes = std::set<ComputationNodeBasePtr>(checkpointNodes.begin(), checkpointNodes.end());
+    }
+    bool IsGradientCheckpointingEnabled() const { return m_gradientCheckpointInterval > 0 || !m_gradientCheckpointNodes.empty(); }
+
+    // elementwise fusion of networks compiled subsequently: a PlusNode whose only consumer is a Sigmoid, Tanh or RectifiedLinear
+    // node is computed by that consumer in a single kernel, forward and backward; see FuseElementwiseNodes()
+    static void EnableElementwiseFusion(bool enable) { s_isElementwiseFusionEnabled = enable; }
+    static bool IsElementwiseFusionEnabled() { return s_isElementwiseFusionEnabled; }
+
+    // hoisting of loop-invariant projections in networks compiled subsequently: W * [x; h] inside a recurrent loop, where x does not
+    // depend on the loop, is split into W_x * x over the whole minibatch plus W_h * h per time step; see HoistLoopInvariantProjections()
+    static void EnableLoopInvariantHoisting(bool enable) { s_isLoopInvariantHoistingEnabled = enable; }
+    static bool IsLoopInvariantHoistingEnabled() { return s_isLoopInvariantHoistingEnabled; }
+
+    // skipping of gaps in recurrent loops: each time step is only computed for the range of parallel sequences that have content in it
+    // (see MBLayout::GetActiveSequenceRange()), which saves most of the work on gaps if sequences of very different lengths are packed
+    // longest first; gaps of loop nodes are then left as they are. Loops with a node that does not SupportsSequenceRange() run in full.
+    static void EnableLoopGapSkipping(bool enable) { s_isLoopGapSkippingEnabled = enable; }
+    static bool IsLoopGapSkippingEnabled() { return s_isLoopGapSkippingEnabled; }
+
+    // replay of ForwardProp() on the CPU for latency-bound evaluation: once the shapes and MB layouts of a pass are the same
+    // as in the previous call, the nodes are run from a flat list without revalidation; requires MemorySharingPolicy::None,
+    // see ReplayForwardPropIfStable()
+    void EnableForwardReplay(bool enable) { m_isForwardReplayEnabled = enable; }
+    bool IsForwardReplayEnabled() const { return m_isForwardReplayEnabled; }
+
+    // per-node profile of ForwardProp() and Backprop(), see NodeProfiler; while enabled, passes run node by node on one
+    // stream, without forward replay or CUDA graphs. Enabling discards an earlier profile.
+    void EnableNodeProfiling(bool enable) { m_nodeProfiler = enable ? make_shared<NodeProfiler>(GetDeviceId()) : nullptr; }
+    bool IsNodeProfilingEnabled() const { return m_nodeProfiler != nullptr; }
+    NodeProfilerPtr GetNodeProfiler() const { return m_nodeProfiler; }
+
 private:
     void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount);
+    void PlanGradientCheckpointing(const ComputationNodeBasePtr& trainRootNode,
+                                   const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                   std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
 public:
@@ -201,6 +299,7 @@ public:
 
     void FormNestedNetwork(const ComputationNodeBasePtr& rootNode);
     ComputationNodeBasePtr GetNestedNetwork(const ComputationNodeBasePtr& rootNode);
+    void FuseElementwiseNodes();
 
     // The methods below determine evaluation order, which is tricky in presence of recurrent loops.
     // TODO: Can this be moved to a separate class?
@@ -211,6 +310,9 @@ private:
     void DetermineSCCsR(ComputationNodeBasePtr cur, std::list<ComputationNodeBasePtr>& sccStack, size_t& index, size_t& loopId);
     void DetermineLoopForwardOrderR(std::unordered_set<ComputationNodeBasePtr>& visited, std::unordered_set<ComputationNodeBasePtr>& recStack, std::list<ComputationNodeBasePtr>& nodesStack, ComputationNodeBasePtr cur);
     void GatherLoopNodesR(const ComputationNodeBasePtr& rootNode, std::unordered_set<ComputationNodeBasePtr>& visited, std::map<int, std::list<ComputationNodeBasePtr>>& recurrentResult, std::list<ComputationNodeBasePtr>& noRecurrentResult);
+    bool HoistLoopInvariantProjections();
+    template <class ElemType>
+    bool HoistLoopInvariantProjection(const ComputationNodeBasePtr& timesNode);
     void ReorderLoops(std::list<ComputationNodeBasePtr>& nodes, const std::map<int, std::list<ComputationNodeBasePtr>>& /*recurrentNodes*/, const std::list<ComputationNodeBasePtr>& /*noRecurrentNodes*/);
 
 public:
@@ -367,6 +469,11 @@ public:
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
     void CopyInputs(const std::wstring fromName, std::wstring toName);
+    // a network that shares the LearnableParameter nodes of this one, and owns copies of all other nodes
+    // Evaluating the clone does not touch the values of this network, so the two may be evaluated on separate threads.
+    ComputationNetworkPtr CloneWithSharedParameters();
+    // a network with its own copies of all nodes, parameters included, placed on another device (local data parallelism)
+    ComputationNetworkPtr CloneOnDevice(DEVICEID_TYPE deviceId);
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
@@ -377,6 +484,23 @@ public:
     void AddFeatureNode(ComputationNodeBasePtr featureNode);
     //ComputationNodeBasePtr RemoveFeatureNode(ComputationNodeBasePtr featureNode);
     void SetLearnableNodesBelowLearningRateMultiplier(const float learningRateMultiplier, const ComputationNodeBasePtr& rootNode = nullptr);
+    void FoldBatchNormalization();
+    // inference-only models: keep only what the given outputs (default: the output nodes) depend on, and freeze the parameters
+    void PruneForInference(const std::vector<ComputationNodeBasePtr>& outputNodes);
+    // replace the subgraphs that only depend on parameters and precomputed values by LearnableParameters holding their value
+    void FoldConstants();
+    // pipeline model parallelism: split the network into consecutive stages of about equal parameter size, one per device,
+    // with DeviceTransfer nodes on the edges between stages
+    void PlaceInPipelineStages(const std::vector<DEVICEID_TYPE>& stageDevices);
+private:
+    template <class ElemType>
+    bool FoldBatchNormalizationNode(const ComputationNodeBasePtr& bn, std::map<ComputationNodeBasePtr, size_t>& numConsumers);
+    template <class ElemType>
+    void ReplaceByConstant(const ComputationNodeBasePtr& node);
+    template <class ElemType>
+    ComputationNodeBasePtr AddDeviceTransferNode(const ComputationNodeBasePtr& input, DEVICEID_TYPE deviceId, const std::wstring& name);
+    ComputationNetworkPtr Clone(DEVICEID_TYPE deviceId, bool shareParameters);
+public:
 
     // -----------------------------------------------------------------------
     // node access
@@ -974,6 +1098,9 @@ protected:
         virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool);
         virtual bool IsOutOfDateWrtInputs() const override;
 
+    private:
+        FrameRange ActiveSequencesOf(const FrameRange& fr) const;
+
     public:
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
@@ -1000,6 +1127,7 @@ protected:
 
     class PARTraversalFlowControlNode : public FlowControlNode
     {
+    public: // m_nestedNodes needed public by ComputationNetwork::PlanGradientCheckpointing()
         typedef FlowControlNode Base;
         using Base::m_nestedNodes;
 
@@ -1036,7 +1164,37 @@ protected:
         // this special constructor constructs the top-level network node
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
+        ~PARTraversalFlowControlNode();
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // like ForwardProp(), but independent branches run concurrently on the GPUStreams of the device
+        void ForwardPropOnStreams(const FrameRange& fr, DEVICEID_TYPE deviceId);
+
+        // gradient checkpointing, planned by ComputationNetwork::PlanGradientCheckpointing()
+        // m_nestedNodes are cut into segments at checkpoint nodes. Values of the segment's recomputed nodes are not kept after ForwardProp();
+        // when Backprop() enters a segment, they are recomputed into m_recomputeBuffers, which are reused by all segments.
+        std::vector<int> m_recomputeSegmentIds;                              // [i] segment of m_nestedNodes[i]; empty if not checkpointing
+        std::vector<std::vector<ComputationNodeBasePtr>> m_recomputedNodes; // [segment] nodes to recompute, in evaluation order
+        std::vector<MatrixBasePtr> m_recomputeBuffers;                       // [j] buffer for the j-th recomputed node of the current segment
+
+        // gradient completion, for overlapping gradient aggregation with backprop
+        std::function<void(const ComputationNodeBasePtr&)> m_onGradientCompleted; // set during ComputationNetwork::Backprop() only
+        std::vector<std::vector<ComputationNodeBasePtr>> m_gradientsCompletedAfter; // [i] leaves whose gradient is complete after Backprop() of m_nestedNodes[i]
+        void DetermineGradientCompletion();
+
+        NodeProfiler* m_profiler = nullptr; // set during ComputationNetwork::ForwardProp() and Backprop() while profiling only
+
+    private:
+        void BeginRecomputeSegment(int segment, const FrameRange& fr);
+        void EndRecomputeSegment(int segment);
+
+        // stream schedule of ForwardPropOnStreams(), planned on first use
+        void PlanStreams(DEVICEID_TYPE deviceId);
+        std::vector<int> m_streamOf;                     // [i] stream of m_nestedNodes[i]; -1 for leaves, which run on the current stream before all others
+        std::vector<std::vector<size_t>> m_streamWaits; // [i] nodes on other streams whose events m_nestedNodes[i] waits for
+        std::vector<void*> m_nodeEvents;                 // [i] event recorded after m_nestedNodes[i], if other streams wait for it
+        std::vector<void*> m_joinEvents;                 // [stream] event recorded after its last node, waited for by the current stream
+        void* m_forkEvent = nullptr;                     // recorded on the current stream after the leaves, waited for by all streams
     };
 
 public:
@@ -1107,6 +1265,49 @@ private:
     // pool for matrices that can be shared across nodes
     // TODO: does this apply to anything else besides temporary node-internal intermediate results? What, for example?
     MatrixPool m_matrixPool;
+
+    // nodes that are purely induced by parameters but share their value under MemorySharingPolicy::Aggressive; see MarkValueNonSharableNodes()
+    std::vector<ComputationNodeBasePtr> m_nodesWithRecomputedValue;
+
+    // gradient checkpointing settings; see SetGradientCheckpointing()
+    size_t m_gradientCheckpointInterval;
+    std::set<ComputationNodeBasePtr> m_gradientCheckpointNodes;
+
+    // CUDA graphs of ForwardProp() and Backprop() per root node, see RunCapturedIfStable()
+    struct CapturedGraph;
+    std::map<std::pair<ComputationNodeBasePtr, bool /*isBackprop*/>, std::shared_ptr<CapturedGraph>> m_capturedGraphs;
+    void RunCapturedIfStable(const ComputationNodeBasePtr& rootNode, bool isBackprop, const std::function<void()>& run);
+
+    // replay plans of ForwardProp() per root node, see ReplayForwardPropIfStable()
+    bool m_isForwardReplayEnabled;
+    struct ReplayPlan;
+    std::map<ComputationNodeBasePtr, std::shared_ptr<ReplayPlan>> m_replayPlans;
+    bool ReplayForwardPropIfStable(const ComputationNodeBasePtr& rootNode);
+
+    // per-node profile, see EnableNodeProfiling()
+    NodeProfilerPtr m_nodeProfiler;
+
+    // state of each node after the previous CompileNetwork(), for incremental compilation; see DetermineNodesToValidate()
+    struct ValidationRecord
+    {
+        std::vector<ComputationNodeBasePtr> inputs;
+        std::vector<std::pair<TensorShape, bool>> inputDims;
+        std::vector<MBLayoutPtr> inputMBLayouts;
+        std::pair<TensorShape, bool> dims;
+        MBLayoutPtr mbLayout;
+    };
+    std::map<ComputationNodeBasePtr, ValidationRecord> m_validationRecords;
+    std::set<ComputationNodeBasePtr> m_invalidatedNodes;  // see InvalidateNodeValidation()
+    bool m_isValidatingAllNodes = true;                   // false if CompileNetwork() is incremental
+    std::set<ComputationNodeBasePtr> m_nodesToValidate;   // if !m_isValidatingAllNodes
+
+    static bool s_hasDefaultMemorySharingPolicy;
+    static MemorySharingPolicy s_defaultMemorySharingPolicy;
+    static bool s_isElementwiseFusionEnabled;
+    static bool s_isLoopInvariantHoistingEnabled;
+    static bool s_isLoopGapSkippingEnabled;
+    static bool s_isIncrementalCompilationEnabled;
+    static bool s_isDeferredParameterInitEnabled;
 };
 typedef ComputationNetwork::ComputationNetworkPtr ComputationNetworkPtr;
 
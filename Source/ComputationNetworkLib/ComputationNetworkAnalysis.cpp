@@ -8,6 +8,9 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
 #include "RecurrentNodes.h"
 #include <string>
 #include <set>
@@ -472,4 +475,94 @@ static int DetermineLoopDirection(const std::vector<ComputationNodeBasePtr>& nes
     return steppingDirection;
 }
 
+// hoist loop-invariant inputs of projections out of recurrent loops
+// A TimesNode inside a loop whose right input is a RowStack of vectors of which some do not depend on the loop, e.g. W * [x_t; h_(t-1)]
+// as in stacked-weight LSTMs, is split along the columns of W into a sum of products, one per stacked input. The products with the
+// loop-invariant inputs, W_x * x, do not depend on the loop either, and are thus computed by one GEMM over the entire minibatch before
+// the loop; only W_h * h_(t-1) remains per time step. The sum takes over the name of the TimesNode.
+// This must be called after ValidateNetwork() since the split depends on the dimensions. Returns true if the network was modified,
+// in which case it must be compiled again.
+bool ComputationNetwork::HoistLoopInvariantProjections()
+{
+    if (!s_isLoopInvariantHoistingEnabled)
+        return false;
+
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (let& node : GetAllNodes())
+        for (let& input : node->GetInputs())
+            numConsumers[input]++;
+
+    size_t numHoisted = 0;
+    for (let& node : GetAllNodes())
+    {
+        if (node->OperationName() != OperationNameOf(TimesNode) || !node->IsPartOfLoop() || node->GetNumInputs() != 2)
+            continue;
+        let stack = node->GetInputs()[1];
+        bool isHoisted = node->Is<ComputationNode<float>>() ? HoistLoopInvariantProjection<float>(node)
+                                                            : HoistLoopInvariantProjection<double>(node);
+        if (!isHoisted)
+            continue;
+        // the RowStack is no longer needed unless used elsewhere; it would otherwise become a root
+        if (--numConsumers[stack] == 0 && std::find(m_allRoots.begin(), m_allRoots.end(), stack) == m_allRoots.end())
+            RemoveNodeFromNet(stack);
+        numHoisted++;
+    }
+    if (numHoisted > 0)
+        fprintf(stderr, "HoistLoopInvariantProjections: %d projections split into a part outside and a part inside their loop.\n", (int) numHoisted);
+    return numHoisted > 0;
+}
+
+template <class ElemType>
+bool ComputationNetwork::HoistLoopInvariantProjection(const ComputationNodeBasePtr& timesNode)
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    // check the pattern: weights outside the loop times a RowStack of vectors, some of them from outside the loop
+    let times = dynamic_pointer_cast<TimesNode<ElemType>>(timesNode);
+    let weights = dynamic_pointer_cast<ComputationNode<ElemType>>(timesNode->GetInputs()[0]);
+    let stack = timesNode->GetInputs()[1];
+    if (!times || !weights || times->OutputRank() != 1 || weights->IsPartOfLoop() || weights->HasMBLayout() || weights->GetSampleLayout().GetRank() != 2 ||
+        stack->OperationName() != OperationNameOf(RowStackNode) || stack->m_loopId != timesNode->m_loopId)
+        return false;
+    size_t numInvariantInputs = 0;
+    size_t numColumns = 0;
+    for (let& input : stack->GetInputs())
+    {
+        if (input->GetSampleLayout().GetRank() != 1)
+            return false;
+        if (input->m_loopId != timesNode->m_loopId)
+            numInvariantInputs++;
+        numColumns += input->GetSampleLayout().GetNumElements();
+    }
+    if (numInvariantInputs == 0 || numInvariantInputs == stack->GetNumInputs() || numColumns != weights->GetSampleLayout()[1])
+        return false;
+
+    // split the weights by columns, and sum up the products separately for the inputs from outside and inside the loop
+    ComputationNetworkBuilder<ElemType> builder(*this);
+    let& name = timesNode->NodeName();
+    ComputationNodePtr invariantSum, recurrentSum;
+    size_t column = 0;
+    for (size_t i = 0; i < stack->GetNumInputs(); i++)
+    {
+        let input = dynamic_pointer_cast<ComputationNode<ElemType>>(stack->GetInputs()[i]);
+        let dim = input->GetSampleLayout().GetNumElements();
+        let weightsSlice = AddNodeToNetAndAttachInputs(New<SliceNode<ElemType>>(GetDeviceId(), name + L".W" + std::to_wstring(i), (int) column, (int) (column + dim), /*axis=*/2), { weights });
+        let product = builder.Times(weightsSlice, input, 1, name + L".times" + std::to_wstring(i));
+        auto& sum = input->m_loopId != timesNode->m_loopId ? invariantSum : recurrentSum;
+        sum = sum ? builder.Plus(sum, product, name + L".sum" + std::to_wstring(i)) : product;
+        column += dim;
+    }
+
+    // replace the TimesNode by the sum
+    let result = New<PlusNode<ElemType>>(GetDeviceId(), name);
+    ChangeNodeInputs(timesNode, result);
+    for (auto group : GetAllNodeGroups())
+        for (auto& node : *group)
+            if (node == timesNode)
+                node = result;
+    RemoveNodeFromNet(timesNode);
+    AddNodeToNetAndAttachInputs(result, { invariantSum, recurrentSum });
+    return true;
+}
+
 }}}
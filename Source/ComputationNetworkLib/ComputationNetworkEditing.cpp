@@ -8,11 +8,17 @@
 #include "Basics.h"
 #include "ComputationNode.h"
 #include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "ConvolutionalNodes.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "ReshapingNodes.h"
 #include "TrainingNodes.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
 
 using namespace std;
 
@@ -58,7 +64,10 @@ ComputationNodeBasePtr ComputationNetwork::CopyNode(const ComputationNetwork& fr
         if (pFromNode == pToNode)
             LogicError("CopyNode: You are copying the node to the same network with same node name.");
         else
+        {
             pFromNode->CopyTo(pToNode, toName, flags); // blast it over the existing node
+            InvalidateNodeValidation(pToNode);
+        }
     }
     return pToNode;
 }
@@ -103,6 +112,64 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// CloneWithSharedParameters - create a network with the same structure that evaluates independently of this one
+// Parameters are shared by putting the very same LearnableParameter nodes into the clone, all other nodes are duplicated
+// with their values, so that the clone owns its activations. Parameter nodes keep the environment of this network,
+// they do not depend on it.
+ComputationNetworkPtr ComputationNetwork::CloneWithSharedParameters()
+{
+    return Clone(GetDeviceId(), /*shareParameters=*/true);
+}
+
+// CloneOnDevice - create a replica of this network on another device
+// All nodes are duplicated with their values, so that the replica can be trained on a different part of the data.
+// Call this before the matrices are allocated, so that the replica does not hold copies of the activations.
+ComputationNetworkPtr ComputationNetwork::CloneOnDevice(DEVICEID_TYPE deviceId)
+{
+    return Clone(deviceId, /*shareParameters=*/false);
+}
+
+ComputationNetworkPtr ComputationNetwork::Clone(DEVICEID_TYPE deviceId, bool shareParameters)
+{
+    auto net = make_shared<ComputationNetwork>(deviceId);
+    *net->m_environment = *m_environment; // e.g. quantized inference
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> clones;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        if (shareParameters && node->OperationName() == OperationNameOf(LearnableParameter))
+        {
+            net->m_nameToNodeMap.insert(make_pair(node->NodeName(), node));
+            clones[node] = node;
+        }
+        else
+        {
+            clones[node] = net->AddNodeToNet(node->Duplicate(node->NodeName(), CopyNodeFlags::copyNodeValue));
+            if (deviceId != GetDeviceId())
+                clones[node]->MoveToDevice(deviceId);
+        }
+    }
+
+    // link the copies to each other, and to the shared parameters
+    for (const auto& clone : clones)
+    {
+        if (clone.first == clone.second)
+            continue;
+        for (size_t i = 0; i < clone.first->GetNumInputs(); i++)
+            clone.second->SetInput(i, clones.at(clone.first->GetInputs()[i]));
+    }
+
+    for (const auto& groupTag : { L"feature", L"label", L"criterion", L"evaluation", L"output" })
+    {
+        for (const auto& node : GetNodeGroup(groupTag))
+            net->AddToNodeGroup(groupTag, clones.at(node));
+    }
+
+    net->CompileNetwork();
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
@@ -367,4 +434,456 @@ void ComputationNetwork::SetLearnableNodesBelowLearningRateMultiplier(const floa
     }
 }
 
+// fold frozen batch normalization into the preceding projection, for inference
+// In inference, BatchNormalization computes y = a * x + c per output channel with a = scale * runInvStdDev and c = bias - a * runMean.
+// If x = W * z or x = W * z + b (TimesNode, or ConvolutionNode in CHW layout) whose weights feed only this projection, W and b are
+// scaled by a and offset by c instead, and the BatchNormalizationNode is removed, saving two passes over its input and output per layer.
+// If there was no b, it is created as a new LearnableParameter. The values of W are changed; only call this for networks used for inference.
+// The network is compiled again if it was modified.
+void ComputationNetwork::FoldBatchNormalization()
+{
+    VerifyIsCompiled("FoldBatchNormalization");
+
+    map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (let& node : GetAllNodes())
+        for (let& input : node->GetInputs())
+            numConsumers[input]++;
+
+    size_t numFolded = 0;
+    for (let& node : GetAllNodes())
+    {
+        if (node->OperationName() != OperationNameOf(BatchNormalizationNode))
+            continue;
+        bool isFolded = node->Is<ComputationNode<float>>() ? FoldBatchNormalizationNode<float>(node, numConsumers)
+                                                           : FoldBatchNormalizationNode<double>(node, numConsumers);
+        if (isFolded)
+            numFolded++;
+    }
+    if (numFolded == 0)
+        return;
+
+    fprintf(stderr, "FoldBatchNormalization: %d BatchNormalization nodes folded into the preceding weights.\n", (int) numFolded);
+    InvalidateCompiledNetwork();
+    CompileNetwork();
+}
+
+template <class ElemType>
+bool ComputationNetwork::FoldBatchNormalizationNode(const ComputationNodeBasePtr& bn, map<ComputationNodeBasePtr, size_t>& numConsumers)
+{
+    let isSpatial = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(bn)->Spatial();
+    let isSoleConsumer = [&](const ComputationNodeBasePtr& node)
+    {
+        return numConsumers[node] == 1 && std::find(m_allRoots.begin(), m_allRoots.end(), node) == m_allRoots.end();
+    };
+    let isParameter = [&](const ComputationNodeBasePtr& node)
+    {
+        return node->OperationName() == OperationNameOf(LearnableParameter) && isSoleConsumer(node);
+    };
+    for (size_t i = 1; i < bn->GetNumInputs(); i++)
+        if (!isParameter(bn->GetInputs()[i]))
+            return false;
+
+    // find the projection, and the bias if any
+    ComputationNodeBasePtr projection = bn->GetInputs()[0];
+    ComputationNodeBasePtr plus, bias;
+    if (projection->OperationName() == OperationNameOf(PlusNode) && isSoleConsumer(projection))
+    {
+        plus = projection;
+        let isProjection = [](const ComputationNodeBasePtr& node)
+        {
+            return node->OperationName() == OperationNameOf(TimesNode) || node->OperationName() == OperationNameOf(ConvolutionNode);
+        };
+        size_t projectionIndex = isProjection(plus->GetInputs()[0]) ? 0 : 1;
+        projection = plus->GetInputs()[projectionIndex];
+        bias = plus->GetInputs()[1 - projectionIndex];
+        if (!isParameter(bias))
+            return false;
+    }
+    if (!isSoleConsumer(projection))
+        return false;
+
+    // the channel of element i of the weights
+    let numChannels = bn->GetInputs()[1]->GetSampleLayout().GetNumElements();
+    let& weights = projection->GetInputs()[0];
+    if (!isParameter(weights) || weights->GetSampleLayout().GetNumElements() % numChannels != 0)
+        return false;
+    let numWeightsPerChannel = weights->GetSampleLayout().GetNumElements() / numChannels;
+    function<size_t(size_t)> channelOf;
+    if (projection->OperationName() == OperationNameOf(TimesNode))
+    {
+        // [numChannels x inputDim] matrix
+        let times = dynamic_pointer_cast<TimesNode<ElemType>>(projection);
+        if (isSpatial || times->OutputRank() != 1 || weights->GetSampleLayout().GetRank() != 2 || weights->GetSampleLayout()[0] != numChannels ||
+            bn->GetSampleLayout().GetNumElements() != numChannels)
+            return false;
+        channelOf = [numChannels](size_t i) { return i % numChannels; };
+    }
+    else if (projection->OperationName() == OperationNameOf(ConvolutionNode))
+    {
+        // the CHW engines store the kernels one after the other
+        let convolution = dynamic_pointer_cast<ConvolutionNode<ElemType>>(projection);
+        let& outputShape = projection->GetSampleLayout();
+        if (!isSpatial || convolution->Transpose() || convolution->ImageLayout() != ImageLayoutKind::CHW ||
+            outputShape.GetRank() == 0 || outputShape.GetDims().back() != numChannels)
+            return false;
+        channelOf = [numWeightsPerChannel](size_t i) { return i / numWeightsPerChannel; };
+    }
+    else
+        return false;
+    if (bias && bias->GetSampleLayout().GetNumElements() != numChannels)
+        return false;
+
+    // compute the folded weights and bias
+    let toVector = [](const ComputationNodeBasePtr& node)
+    {
+        let& value = node->As<ComputationNode<ElemType>>()->Value();
+        vector<ElemType> result(value.GetNumElements());
+        if (!result.empty())
+        {
+            ElemType* data = result.data();
+            size_t size = result.size();
+            value.CopyToArray(data, size);
+        }
+        return result;
+    };
+    let scale = toVector(bn->GetInputs()[1]);
+    let beta = toVector(bn->GetInputs()[2]);
+    let mean = toVector(bn->GetInputs()[3]);
+    let invStdDev = toVector(bn->GetInputs()[4]);
+    auto w = toVector(weights);
+    auto b = bias ? toVector(bias) : vector<ElemType>(numChannels, 0);
+    for (size_t i = 0; i < w.size(); i++)
+        w[i] *= scale[channelOf(i)] * invStdDev[channelOf(i)];
+    for (size_t c = 0; c < numChannels; c++)
+        b[c] = (b[c] - mean[c]) * scale[c] * invStdDev[c] + beta[c];
+
+    auto& weightsValue = weights->As<ComputationNode<ElemType>>()->Value();
+    weightsValue.SetValue(weightsValue.GetNumRows(), weightsValue.GetNumCols(), weightsValue.GetDeviceId(), w.data());
+    if (!bias)
+    {
+        // broadcast over the image
+        let rank = bn->GetSampleLayout().GetRank();
+        SmallVector<size_t> dims(rank, 1);
+        dims[rank - 1] = numChannels;
+        ComputationNetworkBuilder<ElemType> builder(*this);
+        bias = builder.CreateLearnableParameter(bn->NodeName() + L".foldedBias", TensorShape(dims));
+    }
+    auto& biasValue = bias->As<ComputationNode<ElemType>>()->Value();
+    biasValue.SetValue(biasValue.GetNumRows(), biasValue.GetNumCols(), biasValue.GetDeviceId(), b.data());
+
+    // replace the BatchNormalizationNode by the (new) PlusNode
+    for (size_t i = 1; i < bn->GetNumInputs(); i++)
+        RemoveNodeFromNet(bn->GetInputs()[i]);
+    ComputationNodeBasePtr result;
+    RemoveNodeFromNet(bn);
+    if (plus)
+        result = plus;
+    else
+        result = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(GetDeviceId(), bn->NodeName()), { projection, bias });
+    ChangeNodeInputs(bn, result);
+    for (auto group : GetAllNodeGroups())
+        for (auto& node : *group)
+            if (node == bn)
+                node = result;
+    numConsumers[result] = numConsumers[bn];
+    bn->DetachInputs();
+    return true;
+}
+
+
+// -----------------------------------------------------------------------
+// inference-only models
+// -----------------------------------------------------------------------
+
+void ComputationNetwork::PruneForInference(const vector<ComputationNodeBasePtr>& outputNodes)
+{
+    VerifyIsCompiled("PruneForInference");
+
+    let roots = outputNodes.empty() ? m_outputNodes : outputNodes;
+    if (roots.empty())
+        InvalidArgument("PruneForInference: The network has no output nodes.");
+
+    // everything the outputs depend on
+    set<ComputationNodeBasePtr> reachable;
+    vector<ComputationNodeBasePtr> stack(roots.begin(), roots.end());
+    while (!stack.empty())
+    {
+        let node = stack.back();
+        stack.pop_back();
+        if (!reachable.insert(node).second)
+            continue;
+        for (let& input : node->GetInputs())
+            stack.push_back(input);
+    }
+
+    // criteria and evaluation nodes are only used in training
+    for (let& node : m_outputNodes)
+        node->ClearTag(L"output");
+    m_outputNodes.clear();
+    for (let& root : roots)
+        AddToNodeGroup(L"output", root);
+    for (let& node : m_criterionNodes)
+        node->ClearTag(L"criterion");
+    m_criterionNodes.clear();
+    for (let& node : m_evaluationNodes)
+        node->ClearTag(L"evaluation");
+    m_evaluationNodes.clear();
+
+    size_t numRemoved = 0;
+    for (let& node : GetAllNodes())
+    {
+        if (reachable.find(node) != reachable.end())
+            continue;
+        for (auto group : GetAllNodeGroups())
+            group->erase(std::remove(group->begin(), group->end(), node), group->end());
+        RemoveNodeFromNet(node);
+        node->DetachInputs();
+        numRemoved++;
+    }
+    fprintf(stderr, "PruneForInference: %d nodes removed, %d nodes left.\n", (int) numRemoved, (int) m_nameToNodeMap.size());
+
+    InvalidateCompiledNetwork();
+    CompileNetwork();
+    SetLearnableNodesBelowLearningRateMultiplier(0);
+}
+
+void ComputationNetwork::FoldConstants()
+{
+    VerifyIsCompiled("FoldConstants");
+    if (AreMatricesAllocated())
+        LogicError("FoldConstants: Must be called before the matrices of the network are allocated.");
+
+    // A node is constant if it is a parameter, a precomputed value, or a deterministic function of constants
+    // that is not applied to a minibatch.
+    let isPrecomputed = [](const ComputationNodeBasePtr& node)
+    {
+        let precomputeNode = dynamic_pointer_cast<IPreComputeNode>(node);
+        return precomputeNode && precomputeNode->HasComputed();
+    };
+    set<ComputationNodeBasePtr> constants;
+    for (let& node : GetEvalOrder(nullptr))
+    {
+        bool isConstant;
+        if (node->OperationName() == OperationNameOf(LearnableParameter) || isPrecomputed(node))
+            isConstant = true;
+        else if (node->IsLeaf() || node->HasMBLayout() || node->OperationName() == OperationNameOf(DropoutNode) ||
+                 dynamic_pointer_cast<IStatefulNode>(node) || dynamic_pointer_cast<IPreComputeNode>(node))
+            isConstant = false;
+        else
+            isConstant = std::all_of(node->GetInputs().begin(), node->GetInputs().end(),
+                                     [&](const ComputationNodeBasePtr& input) { return constants.find(input) != constants.end(); });
+        if (isConstant)
+            constants.insert(node);
+    }
+
+    // fold the constants that are used by the rest of the network, or by nobody
+    set<ComputationNodeBasePtr> used;
+    for (let& node : GetEvalOrder(nullptr))
+        if (constants.find(node) == constants.end())
+            for (let& input : node->GetInputs())
+                used.insert(input);
+    for (let& root : m_allRoots)
+        used.insert(root);
+    vector<ComputationNodeBasePtr> foldNodes;
+    for (let& node : GetEvalOrder(nullptr))
+        if (constants.find(node) != constants.end() && used.find(node) != used.end() &&
+            node->OperationName() != OperationNameOf(LearnableParameter))
+            foldNodes.push_back(node);
+    if (foldNodes.empty())
+        return;
+
+    // compute the constant subgraphs once, in evaluation order
+    let previousMode = Environment().SetOperationMode(NetworkOperationMode::inferring);
+    for (let& node : GetEvalOrder(nullptr))
+    {
+        if (constants.find(node) == constants.end() || node->IsLeaf() || isPrecomputed(node))
+            continue;
+        if (node->Is<ComputationNode<float>>())
+            node->As<ComputationNode<float>>()->CreateValueMatrixIfNull();
+        else
+            node->As<ComputationNode<double>>()->CreateValueMatrixIfNull();
+        node->BeginForwardProp();
+        node->ForwardProp(FrameRange(nullptr));
+        node->EndForwardProp();
+    }
+    Environment().SetOperationMode(previousMode);
+
+    for (let& node : foldNodes)
+    {
+        if (node->Is<ComputationNode<float>>())
+            ReplaceByConstant<float>(node);
+        else
+            ReplaceByConstant<double>(node);
+    }
+
+    // the subgraphs below the folded nodes are no longer used
+    size_t numRemoved = 0;
+    for (let& node : GetAllNodes())
+    {
+        if (constants.find(node) == constants.end() || used.find(node) != used.end())
+            continue;
+        RemoveNodeFromNet(node);
+        node->DetachInputs();
+        numRemoved++;
+    }
+
+    fprintf(stderr, "FoldConstants: %d constant nodes folded, %d nodes removed.\n", (int) foldNodes.size(), (int) numRemoved);
+    InvalidateCompiledNetwork();
+    CompileNetwork();
+}
+
+// replace a node without minibatch layout by a LearnableParameter with its current value
+template <class ElemType>
+void ComputationNetwork::ReplaceByConstant(const ComputationNodeBasePtr& node)
+{
+    let constant = New<LearnableParameter<ElemType>>(GetDeviceId(), node->NodeName(), node->GetSampleLayout());
+    auto& constantValue = constant->Value();
+    let numRows = constantValue.GetNumRows();
+    let numCols = constantValue.GetNumCols();
+    constantValue.SetValue(node->As<ComputationNode<ElemType>>()->Value());
+    constantValue.Reshape(numRows, numCols);
+    static_pointer_cast<ComputationNodeBase>(constant)->SetLearningRateMultiplier(0);
+
+    RemoveNodeFromNet(node);
+    AddNodeToNet(constant);
+    ChangeNodeInputs(node, constant);
+    for (auto group : GetAllNodeGroups())
+        for (auto& groupNode : *group)
+            if (groupNode == node)
+                groupNode = constant;
+    node->DetachInputs();
+}
+
+// -----------------------------------------------------------------------
+// pipeline model parallelism
+// -----------------------------------------------------------------------
+
+// The nodes are cut in evaluation order into consecutive stages that hold about the same number of parameters; each
+// stage runs on its own device. Leaves go with their first consumer, and the nodes of a recurrent loop stay together.
+// Wherever a node consumes the output of an earlier stage, a DeviceTransfer node copies it over (and its gradient back).
+// The stages run one after the other on each minibatch, so this does not make a single minibatch faster; it allows to
+// train models whose parameters, gradients and activations do not fit into the memory of a single device.
+void ComputationNetwork::PlaceInPipelineStages(const vector<DEVICEID_TYPE>& stageDevices)
+{
+    VerifyIsCompiled("PlaceInPipelineStages");
+    if (AreMatricesAllocated())
+        LogicError("PlaceInPipelineStages: Must be called before the matrices of the network are allocated.");
+    if (stageDevices.empty())
+        InvalidArgument("PlaceInPipelineStages: No devices given.");
+    for (let deviceId : stageDevices)
+        if (deviceId < 0)
+            InvalidArgument("PlaceInPipelineStages: The stages must be placed on GPUs (device %d given).", (int) deviceId);
+    let numStages = stageDevices.size();
+
+    // undo an earlier placement, e.g. of a model that was saved from a pipelined training
+    bool hasTransferNodes = false;
+    for (let& node : GetAllNodes())
+    {
+        if (node->OperationName() != OperationNameOf(DeviceTransferNode))
+            continue;
+        ChangeNodeInputs(node, node->GetInputs()[0]);
+        RemoveNodeFromNet(node);
+        node->DetachInputs();
+        hasTransferNodes = true;
+    }
+    if (hasTransferNodes)
+    {
+        InvalidateCompiledNetwork();
+        CompileNetwork();
+    }
+
+    // the cost of a node is the size of the parameters it uses
+    let isParameter = [](const ComputationNodeBasePtr& node) { return node->OperationName() == OperationNameOf(LearnableParameter); };
+    map<ComputationNodeBasePtr, size_t> costs;
+    size_t totalCost = 0;
+    for (let& node : GetEvalOrder(nullptr))
+    {
+        if (node->IsLeaf())
+            continue;
+        size_t cost = 0;
+        for (let& input : node->GetInputs())
+            if (isParameter(input))
+                cost += input->GetSampleLayout().GetNumElements();
+        costs[node] = cost;
+        totalCost += cost;
+    }
+    if (totalCost == 0) // no parameters: balance the number of nodes
+    {
+        for (auto& cost : costs)
+            cost.second = 1;
+        totalCost = costs.size();
+    }
+
+    map<ComputationNodeBasePtr, size_t> stages;
+    size_t cumulativeCost = 0;
+    size_t stage = 0;
+    shared_ptr<SEQTraversalFlowControlNode> previousLoop;
+    for (let& node : GetEvalOrder(nullptr))
+    {
+        if (node->IsLeaf())
+            continue;
+        let loop = FindInRecurrentLoops(m_allSEQNodes, node);
+        if (!loop || loop != previousLoop)
+            stage = max(stage, min(cumulativeCost * numStages / max(totalCost, (size_t) 1), numStages - 1));
+        previousLoop = loop;
+        stages[node] = stage;
+        cumulativeCost += costs[node];
+    }
+    for (let& node : GetEvalOrder(nullptr))
+        for (let& input : node->GetInputs())
+            if (input->IsLeaf() && stages.find(node) != stages.end() && (stages.find(input) == stages.end() || stages[node] < stages[input]))
+                stages[input] = stages[node];
+    for (let& node : GetEvalOrder(nullptr))
+        if (stages.find(node) == stages.end()) // a leaf that is nobody's input
+            stages[node] = 0;
+
+    // one transfer node per output that is consumed by a later stage, shared by all its consumers on that stage
+    map<pair<ComputationNodeBasePtr, size_t>, ComputationNodeBasePtr> transferNodes;
+    for (let& node : GetEvalOrder(nullptr))
+    {
+        let nodeStage = stages[node];
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            let input = node->GetInputs()[i];
+            let inputStage = stages[input];
+            if (inputStage == nodeStage)
+                continue;
+            if (inputStage > nodeStage)
+                LogicError("PlaceInPipelineStages: %ls %ls operation on stage %d consumes %ls %ls operation of the later stage %d.",
+                           node->NodeName().c_str(), node->OperationName().c_str(), (int) nodeStage,
+                           input->NodeName().c_str(), input->OperationName().c_str(), (int) inputStage);
+            auto& transferNode = transferNodes[make_pair(input, nodeStage)];
+            if (!transferNode)
+            {
+                let name = input->NodeName() + L".toStage" + std::to_wstring(nodeStage);
+                transferNode = input->Is<ComputationNode<float>>() ? AddDeviceTransferNode<float>(input, stageDevices[nodeStage], name)
+                                                                   : AddDeviceTransferNode<double>(input, stageDevices[nodeStage], name);
+            }
+            node->SetInput(i, transferNode);
+        }
+    }
+
+    for (let& stageOfNode : stages)
+        stageOfNode.first->MoveToDevice(stageDevices[stageOfNode.second]);
+    for (let& transferNode : transferNodes)
+        transferNode.second->MoveToDevice(stageDevices[transferNode.first.second]);
+
+    vector<size_t> numNodesPerStage(numStages, 0);
+    for (let& stageOfNode : stages)
+        numNodesPerStage[stageOfNode.second]++;
+    fprintf(stderr, "PlaceInPipelineStages: %d nodes placed on %d stages, %d DeviceTransfer nodes inserted.\n",
+            (int) stages.size(), (int) numStages, (int) transferNodes.size());
+    for (size_t s = 0; s < numStages; s++)
+        fprintf(stderr, "\tstage %d: device %d, %d nodes\n", (int) s, (int) stageDevices[s], (int) numNodesPerStage[s]);
+
+    InvalidateCompiledNetwork();
+    CompileNetwork();
+}
+
+template <class ElemType>
+ComputationNodeBasePtr ComputationNetwork::AddDeviceTransferNode(const ComputationNodeBasePtr& input, DEVICEID_TYPE deviceId, const wstring& name)
+{
+    return AddNodeToNetAndAttachInputs(New<DeviceTransferNode<ElemType>>(deviceId, name), { input });
+}
+
 }}}
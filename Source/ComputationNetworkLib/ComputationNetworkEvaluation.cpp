@@ -10,6 +10,11 @@
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
+#include "LinearAlgebraNodes.h"
+#include "NonlinearityNodes.h"
+#include "TrainingNodes.h"
+#include "GPUMatrix.h" // for GPUStreams
+#include "ProfilerRanges.h"
 #include <string>
 #include <vector>
 #include <list>
@@ -39,8 +44,33 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    // with MemorySharingPolicy::Aggressive, these nodes do not own their value and must be recomputed
+    for (auto& node : m_nodesWithRecomputedValue)
+        node->SetEvalTimeStampOutdatedWrtAll();
+
+    // while profiling, nodes run one by one as in a plain pass, so that each is timed on its own
+    if (m_nodeProfiler)
+    {
+        auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+        nestedNetwork->m_profiler = m_nodeProfiler.get();
+        auto resetProfiler = MakeScopeExit([&]() { nestedNetwork->m_profiler = nullptr; });
+        nestedNetwork->ForwardProp(FrameRange(nullptr));
+        return;
+    }
+
+    if (m_isForwardReplayEnabled && ReplayForwardPropIfStable(rootNode))
+        return;
+
     // traverse all nodes in the pre-determined evaluation order
-    GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    // Independent branches can overlap on multiple GPU streams if no matrices are shared, since the sharing plan is
+    // only valid for sequential execution (as are the fp16 operand buffers of Float16Gemm).
+    RunCapturedIfStable(rootNode, /*isBackprop=*/false, [&]()
+    {
+        if (GPUStreams::GetNumStreams() > 1 && m_deviceId >= 0 && GetMemorySharingPolicy() == MemorySharingPolicy::None && !Float16Gemm::IsEnabled())
+            dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode))->ForwardPropOnStreams(FrameRange(nullptr), m_deviceId);
+        else
+            GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
+    });
 }
 
 // set the gradient matrix of a (root) node 1.0
@@ -68,15 +98,309 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
 
-    // initialize root gradient with a scalar value of 1.0
-    if (!SetRootGradientToScalarOne<float>(rootNode) && !SetRootGradientToScalarOne<double>(rootNode))
-        LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
-
     // reset all gradients below rootNode to zero (actually, internally, this is lazy, but we don't care here)
+    // This only resets flags on the host; a replayed graph restores their state as of the captured Backprop().
     ZeroInputGradients(rootNode);
 
-    // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto backprop = [&]()
+    {
+        // initialize root gradient with a scalar value of 1.0
+        if (!SetRootGradientToScalarOne<float>(rootNode) && !SetRootGradientToScalarOne<double>(rootNode))
+            LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
+
+        // backpropagate through the network
+        GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    };
+
+    // while profiling, without CUDA graphs, see ForwardProp()
+    if (m_nodeProfiler)
+    {
+        auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+        nestedNetwork->m_profiler = m_nodeProfiler.get();
+        auto resetProfiler = MakeScopeExit([&]() { nestedNetwork->m_profiler = nullptr; });
+        backprop();
+        return;
+    }
+
+    RunCapturedIfStable(rootNode, /*isBackprop=*/true, backprop);
+}
+
+// -----------------------------------------------------------------------
+// CUDA graphs (GPUGraph) -- replay ForwardProp() and Backprop() with a single launch while shapes are stable
+//
+// The launches of a pass depend on the shapes, buffers and MB layouts of all nodes below the root, and, for
+// ForwardProp(), on which nodes are out of date. Together these form the signature of a pass. A pass runs normally
+// while its signature changes (which also warms up allocations and algorithm choices); when it is the same as in
+// the previous call, the pass is captured and the graph launched; after that, it is replayed as long as the
+// signature stays the same. Passes that cannot be captured (e.g. because a node reads a value on the host) fall
+// back to normal execution for good, as do networks with sparse matrices or nodes that are not IsReplayable().
+// -----------------------------------------------------------------------
+
+struct ComputationNetwork::CapturedGraph
+{
+    std::vector<size_t> signature;
+    std::vector<MBLayoutPtr> layouts;             // distinct MB layouts below the root
+    std::vector<MBLayoutPtr> layoutsAtSignature; // copies of their content
+    std::vector<ComputationNodeBasePtr> bumpedNodes; // nodes the captured ForwardProp() evaluated, in order
+    void* graph = nullptr;
+    bool isCapturable = true;
+
+    ~CapturedGraph()
+    {
+        if (graph)
+            GPUGraph::Destroy(graph);
+    }
+};
+
+// sets isSparse, since the launches of sparse operations depend on the number of non-zeros, which is not known without reading it from the GPU
+template <class ElemType>
+static bool AppendMatrixSignature(const MatrixBasePtr& matrixBase, std::vector<size_t>& signature, bool& isSparse)
+{
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(matrixBase);
+    if (!matrix)
+        return false;
+    isSparse |= (matrix->GetMatrixType() == SPARSE);
+    signature.push_back((size_t) matrix.get());
+    signature.push_back(matrix->GetNumRows());
+    signature.push_back(matrix->GetNumCols());
+    if (!isSparse)
+        signature.push_back((size_t) matrix->Data());
+    return true;
+}
+
+static MatrixBasePtr GradientPtrOf(const ComputationNodeBasePtr& node)
+{
+    if (let floatNode = dynamic_pointer_cast<ComputationNode<float>>(node))
+        return floatNode->GradientPtr();
+    if (let doubleNode = dynamic_pointer_cast<ComputationNode<double>>(node))
+        return doubleNode->GradientPtr();
+    return nullptr;
+}
+
+static void AppendMatrixSignature(const MatrixBasePtr& matrix, std::vector<size_t>& signature, bool& isSparse)
+{
+    if (!matrix)
+        signature.push_back(0);
+    else if (!AppendMatrixSignature<float>(matrix, signature, isSparse) && !AppendMatrixSignature<double>(matrix, signature, isSparse))
+        LogicError("AppendMatrixSignature: Matrix is neither float nor double.");
+}
+
+void ComputationNetwork::RunCapturedIfStable(const ComputationNodeBasePtr& rootNode, bool isBackprop, const std::function<void()>& run)
+{
+    if (!GPUGraph::IsEnabled() || !GPUGraph::IsSupported() || m_deviceId < 0)
+        return run();
+    auto& capturedGraph = m_capturedGraphs[std::make_pair(rootNode, isBackprop)];
+    if (!capturedGraph)
+        capturedGraph = std::make_shared<CapturedGraph>();
+    auto& g = *capturedGraph;
+    if (!g.isCapturable)
+        return run();
+    if (isBackprop && dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode))->m_onGradientCompleted)
+        return run(); // the callbacks start gradient aggregation, which must not be replayed
+
+    // the signature of this pass; for ForwardProp() the nodes that will be evaluated, see PARTraversalFlowControlNode::ForwardProp()
+    let& evalOrder = GetEvalOrder(rootNode);
+    std::vector<size_t> signature;
+    std::vector<MBLayoutPtr> layouts;
+    std::vector<ComputationNodeBasePtr> bumpedNodes;
+    std::set<ComputationNodeBasePtr> willBeEvaluated;
+    signature.push_back(Environment().IsTraining() ? 1 : 0);
+    for (let& node : evalOrder)
+    {
+        bool isSparse = false;
+        AppendMatrixSignature(node->ValuePtr(), signature, isSparse);
+        if (isBackprop)
+            AppendMatrixSignature(GradientPtrOf(node), signature, isSparse);
+        if (!node->IsReplayable() || isSparse)
+        {
+            fprintf(stderr, "RunCapturedIfStable: %ls %ls operation cannot be replayed; not using CUDA graphs for %ls.\n",
+                    node->NodeName().c_str(), node->OperationName().c_str(), rootNode->NodeName().c_str());
+            g.isCapturable = false;
+            return run();
+        }
+        let& layout = node->GetMBLayout();
+        if (layout && std::find(layouts.begin(), layouts.end(), layout) == layouts.end())
+            layouts.push_back(layout);
+        signature.push_back(std::find(layouts.begin(), layouts.end(), layout) - layouts.begin());
+
+        if (!isBackprop)
+        {
+            bool isEvaluated = node->IsOutOfDateWrtInputs();
+            for (let& input : node->GetInputs())
+                isEvaluated |= willBeEvaluated.find(input) != willBeEvaluated.end();
+            if (isEvaluated)
+            {
+                willBeEvaluated.insert(node);
+                bumpedNodes.push_back(node);
+            }
+            signature.push_back(isEvaluated ? 1 : 0);
+        }
+    }
+
+    bool isStable = (signature == g.signature) && (layouts == g.layouts);
+    for (size_t i = 0; isStable && i < layouts.size(); i++)
+        isStable = (*layouts[i] == *g.layoutsAtSignature[i]);
+    if (!isStable)
+    {
+        if (g.graph)
+            GPUGraph::Destroy(g.graph);
+        g.graph = nullptr;
+        g.signature = std::move(signature);
+        g.layouts = layouts;
+        g.layoutsAtSignature.clear();
+        for (let& layout : layouts)
+        {
+            auto copy = make_shared<MBLayout>();
+            copy->CopyFrom(layout);
+            g.layoutsAtSignature.push_back(copy);
+        }
+        return run();
+    }
+
+    if (!g.graph) // stable for the second time: capture
+    {
+        let fallBack = [&]()
+        {
+            fprintf(stderr, "RunCapturedIfStable: %ls of %ls cannot be captured into a CUDA graph; running it normally from now on.\n",
+                    isBackprop ? L"Backprop" : L"ForwardProp", rootNode->NodeName().c_str());
+            g.isCapturable = false;
+            for (let& node : evalOrder) // nothing was executed
+            {
+                if (!isBackprop && !node->IsLeaf())
+                    node->SetEvalTimeStampOutdatedWrtAll();
+            }
+            run();
+        };
+        GPUGraph::BeginCapture(m_deviceId);
+        try
+        {
+            run();
+        }
+        catch (const std::exception&)
+        {
+            GPUGraph::EndCapture();
+            return fallBack();
+        }
+        g.graph = GPUGraph::EndCapture();
+        if (!g.graph)
+            return fallBack();
+        g.bumpedNodes = bumpedNodes;
+    }
+    else // replay: update the time stamps as the captured pass did
+    {
+        for (let& node : g.bumpedNodes)
+            node->BumpEvalTimeStamp();
+    }
+    GPUGraph::Launch(g.graph);
+}
+
+// -----------------------------------------------------------------------
+// forward replay -- ForwardProp() on the CPU without revalidation while shapes are stable, see EnableForwardReplay()
+//
+// Like a CUDA graph, a replay plan is keyed by the signature of the shapes, buffers and MB layouts of all nodes below
+// the root. Once the signature is the same as in the previous call, the non-leaf nodes are run from a flat list,
+// without the resizing and size checks of BeginForwardProp() and the tracing of EndForwardProp(). This requires that
+// no node shares its value, i.e. MemorySharingPolicy::None, since with shared matrices a node's value may be resized
+// by another node within the same pass. Networks with recurrent loops, sparse values or nodes that are not
+// IsReplayable() are always evaluated normally.
+// -----------------------------------------------------------------------
+
+struct ComputationNetwork::ReplayPlan
+{
+    std::vector<size_t> signature;
+    std::vector<MBLayoutPtr> layouts;             // distinct MB layouts below the root
+    std::vector<MBLayoutPtr> layoutsAtSignature; // copies of their content
+    std::vector<ComputationNodeBasePtr> nodes;    // the non-leaf nodes in evaluation order
+    bool isReplayable = true;
+};
+
+// returns false if the pass must be run normally
+bool ComputationNetwork::ReplayForwardPropIfStable(const ComputationNodeBasePtr& rootNode)
+{
+    if (m_deviceId >= 0 || GetMemorySharingPolicy() != MemorySharingPolicy::None)
+        return false;
+    auto& replayPlan = m_replayPlans[rootNode];
+    if (!replayPlan)
+        replayPlan = std::make_shared<ReplayPlan>();
+    auto& p = *replayPlan;
+    if (!p.isReplayable)
+        return false;
+
+    let& evalOrder = GetEvalOrder(rootNode);
+    std::vector<size_t> signature;
+    std::vector<MBLayoutPtr> layouts;
+    signature.reserve(p.signature.size());
+    signature.push_back((size_t) Environment().m_networkOperationMode);
+    for (let& node : evalOrder)
+    {
+        bool isSparse = false;
+        AppendMatrixSignature(node->ValuePtr(), signature, isSparse);
+        if (!node->IsReplayable() || node->IsPartOfLoop() || isSparse)
+        {
+            fprintf(stderr, "ReplayForwardPropIfStable: %ls %ls operation cannot be replayed; evaluating %ls normally.\n",
+                    node->NodeName().c_str(), node->OperationName().c_str(), rootNode->NodeName().c_str());
+            p.isReplayable = false;
+            return false;
+        }
+        let& layout = node->GetMBLayout();
+        if (layout && std::find(layouts.begin(), layouts.end(), layout) == layouts.end())
+            layouts.push_back(layout);
+        signature.push_back(std::find(layouts.begin(), layouts.end(), layout) - layouts.begin());
+    }
+
+    bool isStable = (signature == p.signature) && (layouts == p.layouts);
+    for (size_t i = 0; isStable && i < layouts.size(); i++)
+        isStable = (*layouts[i] == *p.layoutsAtSignature[i]);
+    if (!isStable)
+    {
+        p.signature = std::move(signature);
+        p.layouts = layouts;
+        p.layoutsAtSignature.clear();
+        for (let& layout : layouts)
+        {
+            auto copy = make_shared<MBLayout>();
+            copy->CopyFrom(layout);
+            p.layoutsAtSignature.push_back(copy);
+        }
+        p.nodes.clear();
+        for (let& node : evalOrder)
+        {
+            if (!node->IsLeaf())
+                p.nodes.push_back(node);
+        }
+        return false;
+    }
+
+    // same as PARTraversalFlowControlNode::ForwardProp(), without Begin/EndForwardProp()
+    for (let& node : p.nodes)
+    {
+        if (node->IsOutOfDateWrtInputs())
+        {
+            if (!node->IsFusedIntoConsumer())
+                node->ForwardProp(FrameRange(node->GetMBLayout()));
+            node->BumpEvalTimeStamp();
+        }
+    }
+    return true;
+}
+
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, const std::function<void(const ComputationNodeBasePtr&)>& onGradientCompleted)
+{
+    auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    nestedNetwork->DetermineGradientCompletion();
+    nestedNetwork->m_onGradientCompleted = onGradientCompleted;
+    auto resetCallback = MakeScopeExit([&]() { nestedNetwork->m_onGradientCompleted = nullptr; });
+    Backprop(rootNode);
+}
+
+std::vector<ComputationNodeBasePtr> ComputationNetwork::GetGradientCompletionOrder(const ComputationNodeBasePtr& rootNode)
+{
+    auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    nestedNetwork->DetermineGradientCompletion();
+    std::vector<ComputationNodeBasePtr> completionOrder;
+    for (auto iter = nestedNetwork->m_gradientsCompletedAfter.rbegin(); iter != nestedNetwork->m_gradientsCompletedAfter.rend(); iter++)
+        completionOrder.insert(completionOrder.end(), iter->begin(), iter->end());
+    return completionOrder;
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -139,11 +463,164 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 #endif
         if (node->IsOutOfDateWrtInputs())
         {
+            if (!node->IsFusedIntoConsumer()) // fused nodes are computed by their consumer; the time stamp still tells it to recompute
+            {
+                ProfilerRange range(node->NodeName().c_str(), /*isNodeRange=*/true);
+                if (m_profiler)
+                    m_profiler->Begin();
+                node->BeginForwardProp();
+                node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+                node->EndForwardProp();
+                if (m_profiler)
+                    m_profiler->End(node, NodeProfiler::Pass::Forward);
+            }
+
+            node->BumpEvalTimeStamp();
+        }
+    }
+}
+
+ComputationNetwork::PARTraversalFlowControlNode::~PARTraversalFlowControlNode()
+{
+    for (auto event : m_nodeEvents)
+    {
+        if (event)
+            GPUStreams::DeleteEvent(event);
+    }
+    for (auto event : m_joinEvents)
+        GPUStreams::DeleteEvent(event);
+    if (m_forkEvent)
+        GPUStreams::DeleteEvent(m_forkEvent);
+}
+
+// assign the top-level nodes to streams, such that chains of nodes stay on one stream and independent branches
+// go to different ones
+// A node continues the stream of the first of its inputs that is the last node on its stream so far; otherwise
+// it starts on the least recently used stream. It waits for the events of its inputs on other streams.
+void ComputationNetwork::PARTraversalFlowControlNode::PlanStreams(DEVICEID_TYPE deviceId)
+{
+    if (!m_streamOf.empty())
+        return;
+    size_t numStreams = GPUStreams::GetNumStreams();
+    std::map<const ComputationNodeBase*, size_t> producers; // node -> index in m_nestedNodes, for non-leaves
+    std::vector<int> lastOnStream(numStreams, -1);
+    m_streamOf.assign(m_nestedNodes.size(), -1);
+    m_streamWaits.assign(m_nestedNodes.size(), std::vector<size_t>());
+    m_nodeEvents.assign(m_nestedNodes.size(), nullptr);
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        if (m_nestedNodes[i]->IsLeaf())
+            continue;
+        let seqNode = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        let& members = seqNode ? seqNode->m_nestedNodes : std::vector<ComputationNodeBasePtr>(1, m_nestedNodes[i]);
+
+        std::vector<size_t> deps;
+        for (let& member : members)
+        {
+            for (let& input : member->GetInputs())
+            {
+                auto producer = producers.find(input.get());
+                if (producer != producers.end() && producer->second != i && std::find(deps.begin(), deps.end(), producer->second) == deps.end())
+                    deps.push_back(producer->second);
+            }
+        }
+
+        int stream = -1;
+        for (size_t j : deps)
+        {
+            if (lastOnStream[m_streamOf[j]] == (int) j)
+            {
+                stream = m_streamOf[j];
+                break;
+            }
+        }
+        if (stream < 0)
+            stream = (int) (std::min_element(lastOnStream.begin(), lastOnStream.end()) - lastOnStream.begin());
+        m_streamOf[i] = stream;
+        lastOnStream[stream] = (int) i;
+        for (size_t j : deps)
+        {
+            if (m_streamOf[j] != stream)
+            {
+                m_streamWaits[i].push_back(j);
+                if (!m_nodeEvents[j])
+                    m_nodeEvents[j] = GPUStreams::NewEvent(deviceId);
+            }
+        }
+        for (let& member : members)
+            producers[member.get()] = i;
+    }
+
+    m_forkEvent = GPUStreams::NewEvent(deviceId);
+    for (size_t s = 0; s < numStreams; s++)
+        m_joinEvents.push_back(GPUStreams::NewEvent(deviceId));
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ForwardPropOnStreams(const FrameRange& fr, DEVICEID_TYPE deviceId)
+{
+    PlanStreams(deviceId);
+
+    let forwardProp = [&](const ComputationNodeBasePtr& node)
+    {
+        if (!node->IsFusedIntoConsumer())
+        {
+            ProfilerRange range(node->NodeName().c_str(), /*isNodeRange=*/true);
             node->BeginForwardProp();
             node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
             node->EndForwardProp();
+        }
+        node->BumpEvalTimeStamp();
+    };
 
-            node->BumpEvalTimeStamp();
+    // leaves have no inputs, so they can go first; then fork all streams from the current one
+    for (auto& node : m_nestedNodes)
+    {
+        if (node->IsLeaf() && node->IsOutOfDateWrtInputs())
+            forwardProp(node);
+    }
+    GPUStreams::Record(m_forkEvent);
+
+    void* currentStream = nullptr;
+    std::vector<bool> isForked(m_joinEvents.size(), false);
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        auto& node = m_nestedNodes[i];
+        if (m_streamOf[i] < 0 || !node->IsOutOfDateWrtInputs())
+            continue;
+
+        void* previousStream = GPUStreams::Select(deviceId, m_streamOf[i]);
+        if (!currentStream)
+            currentStream = previousStream;
+        if (!isForked[m_streamOf[i]])
+        {
+            GPUStreams::Wait(m_forkEvent);
+            isForked[m_streamOf[i]] = true;
+        }
+        for (size_t j : m_streamWaits[i])
+            GPUStreams::Wait(m_nodeEvents[j]);
+
+        forwardProp(node);
+
+        if (m_nodeEvents[i])
+            GPUStreams::Record(m_nodeEvents[i]);
+    }
+
+    // join: the current stream waits for all streams that were used
+    for (size_t s = 0; s < isForked.size(); s++)
+    {
+        if (isForked[s])
+        {
+            GPUStreams::Select(deviceId, s);
+            GPUStreams::Record(m_joinEvents[s]);
+        }
+    }
+    if (currentStream)
+    {
+        GPUStreams::Restore(currentStream);
+        for (size_t s = 0; s < isForked.size(); s++)
+        {
+            if (isForked[s])
+                GPUStreams::Wait(m_joinEvents[s]);
         }
     }
 }
@@ -152,14 +629,92 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
     // process nodes in pre-determined order
-    for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+    int activeSegment = -1;                  // gradient checkpointing: segment whose values are currently recomputed
+    for (size_t i = m_nestedNodes.size(); i-- > 0;) // iterate backwards over evaluation order
     {
-        auto& node = *pnode;
+        auto& node = m_nestedNodes[i];
+
+        if (!m_recomputeSegmentIds.empty() && m_recomputeSegmentIds[i] != activeSegment)
+        {
+            EndRecomputeSegment(activeSegment);
+            activeSegment = m_recomputeSegmentIds[i];
+            BeginRecomputeSegment(activeSegment, fr);
+        }
+
+        // Nodes and loops that need no gradient lie outside the subgraph between the trained parameters and the criterion,
+        // e.g. the frozen layers of a fine-tuned model; as none of their inputs needs a gradient either, they are skipped as a whole.
+        if (!node->IsFusedIntoConsumer() && node->NeedsGradient()) // a fused node's consumer has propagated directly to its inputs
+        {
+            ProfilerRange range(node->NodeName().c_str(), /*isNodeRange=*/true);
+            if (m_profiler)
+                m_profiler->Begin();
+            node->BeginBackprop();
+            node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+            node->EndBackprop();
+            if (m_profiler)
+                m_profiler->End(node, NodeProfiler::Pass::Backward);
+        }
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+        if (m_onGradientCompleted)
+        {
+            for (auto& leaf : m_gradientsCompletedAfter[i])
+                m_onGradientCompleted(leaf);
+        }
     }
+    EndRecomputeSegment(activeSegment);
+}
+
+// determine for each leaf that needs a gradient after which node's Backprop() its gradient is complete
+// Backprop() runs in reverse order, so that is the first top-level node (or loop containing a node) that consumes it.
+void ComputationNetwork::PARTraversalFlowControlNode::DetermineGradientCompletion()
+{
+    if (!m_gradientsCompletedAfter.empty())
+        return;
+    m_gradientsCompletedAfter.resize(m_nestedNodes.size());
+    std::set<ComputationNodeBasePtr> visited;
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        let seqNode = dynamic_pointer_cast<SEQTraversalFlowControlNode>(m_nestedNodes[i]);
+        let& consumers = seqNode ? seqNode->m_nestedNodes : std::vector<ComputationNodeBasePtr>(1, m_nestedNodes[i]);
+        for (let& consumer : consumers)
+        {
+            for (let& input : consumer->GetInputs())
+            {
+                if (input->IsLeaf() && input->NeedsGradient() && visited.insert(input).second)
+                    m_gradientsCompletedAfter[i].push_back(input);
+            }
+        }
+    }
+}
+
+// recompute the values of a segment's discarded nodes into the recompute buffers
+// All inputs from outside the segment were kept from ForwardProp(), see PlanGradientCheckpointing().
+// Time stamps are not bumped, as the values are the same as those computed by ForwardProp().
+void ComputationNetwork::PARTraversalFlowControlNode::BeginRecomputeSegment(int segment, const FrameRange& fr)
+{
+    if (segment < 0 || m_recomputedNodes[segment].empty())
+        return;
+    let& nodes = m_recomputedNodes[segment];
+    if (m_recomputeBuffers.size() < nodes.size())
+        m_recomputeBuffers.resize(nodes.size());
+    for (size_t j = 0; j < nodes.size(); j++)
+    {
+        let& node = nodes[j];
+        node->SwapValueWithRecomputeBuffer(m_recomputeBuffers[j]);
+        node->BeginForwardProp();
+        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
+        node->EndForwardProp();
+    }
+}
+
+// hand the recompute buffers back, restoring the nodes' own (shared) value matrices
+void ComputationNetwork::PARTraversalFlowControlNode::EndRecomputeSegment(int segment)
+{
+    if (segment < 0)
+        return;
+    let& nodes = m_recomputedNodes[segment];
+    for (size_t j = 0; j < nodes.size(); j++)
+        nodes[j]->SwapValueWithRecomputeBuffer(m_recomputeBuffers[j]);
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
@@ -218,14 +773,32 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     FrameRangeIteration range(GetMBLayout(), m_steppingDirection);
     for (auto t = range.begin(); t != range.end(); t++)
     {
+        auto fr = ActiveSequencesOf(t);
         for (auto& node : m_nestedNodes)
         {
-            node->ForwardProp(t);
+            node->ForwardProp(fr);
             node->BumpEvalTimeStamp();
         }
     }
 }
 
+// the frame range of time step 'fr' restricted to the parallel sequences that have content in it, if gap skipping is enabled
+// Outside of that range the time step only has gaps, whose values and gradients are not used; see EnableLoopGapSkipping().
+FrameRange ComputationNetwork::SEQTraversalFlowControlNode::ActiveSequencesOf(const FrameRange& fr) const
+{
+    if (!IsLoopGapSkippingEnabled() || !GetMBLayout()->HasGaps(fr))
+        return fr;
+    for (auto& node : m_nestedNodes)
+    {
+        if (!node->SupportsSequenceRange())
+            return fr;
+    }
+    let sequenceRange = GetMBLayout()->GetActiveSequenceRange(fr.timeIdxInSeq);
+    if (sequenceRange.first == sequenceRange.second || sequenceRange.second - sequenceRange.first == GetMBLayout()->GetNumParallelSequences())
+        return fr; // no content at all (left as is), or content in the first and last parallel sequence
+    return fr.WithSequenceRange(sequenceRange.first, sequenceRange.second);
+}
+
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndForwardProp() /*override*/
 {
     // tell all that loop is done  --e.g. PastValueNode will capture its state for BPTT processing
@@ -248,10 +821,11 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     FrameRangeIteration range(pMBLayout, m_steppingDirection);
     for (auto t = range.rbegin(); t != range.rend(); t++) // note: reverse iteration
     {
+        auto fr = ActiveSequencesOf(t); // (the same as in ForwardProp())
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
-            node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
+            node2->Backprop(fr, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
         }
@@ -385,6 +959,7 @@ void ComputationNetwork::InvalidateCompiledNetwork()
     m_nestedNetworks.clear();
     m_inputValues.clear();
     m_learnableParameters.clear();
+    m_replayPlans.clear();
 }
 
 // verify that network has undergone CompileNetwork()
@@ -425,6 +1000,9 @@ void ComputationNetwork::CompileNetwork()
     // TODO: Move this further down; or decide whether the 'nullptr' version is needed, other than ResetMBLayouts() which could use the global order and filter by itself.
     CollectInputAndLearnableParameters(nullptr);
 
+    // STEP: Determine which nodes have to be validated, all or only those affected by edits since the last compilation.
+    DetermineNodesToValidate();
+
     // STEP: Establish time-axis relationships.
     // This sets all MBLayout pointers of Input nodes according to user spec of time axes.
     // TODO: Don't use m_inputValues, traverse ourselves, to remove dependency on FormEvalOrder().
@@ -449,8 +1027,17 @@ void ComputationNetwork::CompileNetwork()
     // STEP: Infer node dimensions.
     ValidateNetwork();
 
+    // STEP: Initialize the parameters whose random initialization was deferred until their dimensions are final.
+    InitDeferredParameters();
+
     // STEP: Optimize the network.
-    // :)
+    if (HoistLoopInvariantProjections())
+    {
+        // the graph has changed; compile it again
+        CompileNetwork();
+        return;
+    }
+    FuseElementwiseNodes();
 
     // STEP: Some final details.
     ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
@@ -459,6 +1046,41 @@ void ComputationNetwork::CompileNetwork()
     m_isCompiled = true;
 }
 
+// fuse elementwise nodes, to save the kernel launches and the memory traffic of the intermediate results
+// A PlusNode is fused into its consumer if that is its only one, and a SigmoidNode, TanhNode or RectifiedLinearNode. The consumer
+// then computes op(a + b) in one TensorOp from the summands, and propagates its gradient directly to them, since these ops take
+// their gradient from the output. The PlusNode is skipped by forward and backward prop. Roots and loop members are not fused.
+void ComputationNetwork::FuseElementwiseNodes()
+{
+    std::map<ComputationNodeBasePtr, size_t> numConsumers;
+    for (let& node : GetAllNodes())
+    {
+        node->m_isFusedIntoConsumer = false;
+        for (let& input : node->GetInputs())
+            numConsumers[input]++;
+    }
+    if (!s_isElementwiseFusionEnabled)
+        return;
+
+    size_t numFused = 0;
+    for (let& node : GetEvalOrder(nullptr))
+    {
+        if (node->IsPartOfLoop() || node->GetNumInputs() != 1 ||
+            (node->OperationName() != OperationNameOf(SigmoidNode) &&
+             node->OperationName() != OperationNameOf(TanhNode) &&
+             node->OperationName() != OperationNameOf(RectifiedLinearNode)))
+            continue;
+        let& sum = node->GetInputs()[0];
+        if (sum->OperationName() != OperationNameOf(PlusNode) || sum->IsPartOfLoop() || numConsumers[sum] != 1 ||
+            std::find(m_allRoots.begin(), m_allRoots.end(), sum) != m_allRoots.end())
+            continue;
+        sum->m_isFusedIntoConsumer = true;
+        numFused++;
+    }
+    if (numFused > 0)
+        fprintf(stderr, "FuseElementwiseNodes: %d PlusNodes fused into their consumers.\n", (int) numFused);
+}
+
 // determine the set of all root nodes
 // Roots are nodes that ForwardProp() may be called for.
 //  - training criterion, eval criteria
@@ -519,31 +1141,71 @@ void ComputationNetwork::DetermineSetOfAllRoots()
 // initial setup of MBLayout pointers
 //  - link all input nodes to one or more MBLayouts
 //  - reset all others to nullptr, in expectation of a ValidateNetwork() pass
+// In an incremental compilation, only the nodes to validate are reset, see DetermineNodesToValidate().
 void ComputationNetwork::ResetMBLayouts()
 {
     // reset to a well-defined MBLayout (any meaningful layout should do here)
     // Note that Validate is never called during operation. Any actual computation will lead to MBLayout to be set.
     m_pMBLayoutOfNetwork->Init(1, 0);
 
+    // the DynamicAxis node an Input node takes its MBLayout from, or nullptr for the network-wide MBLayout
+    auto getAxisNode = [this](const ComputationNodeBasePtr& node) -> ComputationNodeBasePtr
+    {
+        // TODO: use if (!Is<ITakesDynamicAxis>(node))...
+        auto n = dynamic_pointer_cast<ITakesDynamicAxis>(node);
+        if (!n)
+            LogicError("Expected %ls to implement ITakesDynamicAxis, but it doesn't.", node->NodeDescription().c_str());
+        std::wstring axisName = n->GetRequestedDynamicAxis();
+
+        if (axisName == L"")
+            return nullptr;
+
+        auto axisNode = GetNodeFromName(axisName);
+
+        if (!axisNode)
+            RuntimeError("%ls: Can't find node '%ls' for retrieving dynamic axis.", node->NodeDescription().c_str(), axisName.c_str());
+
+        // For now we require the node to be a DynamicAxisNode, though we could derive the same from other nodes. This would involve
+        // more dependencies on the order in which things are evaluated, though.
+        if (axisNode->OperationName() != L"DynamicAxis")
+            RuntimeError("%ls: dynamicAxis argument must be of type DynamicAxis(), but got %ls.", node->NodeDescription().c_str(), axisNode->NodeDescription().c_str());
+        return axisNode;
+    };
+
+    // Input nodes that will get a different MBLayout than last time must be validated, with everything downstream of them
+    if (!m_isValidatingAllNodes)
+    {
+        set<ComputationNodeBasePtr> changedNodes;
+        for (auto node : InputNodes(nullptr))
+        {
+            auto axisNode = getAxisNode(node);
+            if (axisNode ? (m_nodesToValidate.find(axisNode) != m_nodesToValidate.end() || node->GetMBLayout() != axisNode->GetMBLayout())
+                         : node->GetMBLayout() != m_pMBLayoutOfNetwork)
+                changedNodes.insert(node);
+        }
+        AddNodesToValidate(changedNodes, /*resetNodes=*/false);
+    }
+
     // first reset all
     for (const auto& node : GetAllNodesForRoot(nullptr))
-        node->LinkToMBLayout(nullptr);
+    {
+        if (m_isValidatingAllNodes || m_nodesToValidate.find(node) != m_nodesToValidate.end())
+            node->LinkToMBLayout(nullptr);
+    }
 
     // DynamicAxis nodes are (apart from the soon-to-be-deprecated network-wide MBLayout) the main holders of MBLayouts. Initialize them.
     // The only other instances are nodes that change the MBLayout, like WhereNode. 
     for (auto node : GetNodesWithType(L"DynamicAxis"))
-        node->LinkToMBLayout(make_shared<MBLayout>(1, 0, node->GetName()));
+    {
+        if (m_isValidatingAllNodes || m_nodesToValidate.find(node) != m_nodesToValidate.end())
+            node->LinkToMBLayout(make_shared<MBLayout>(1, 0, node->GetName()));
+    }
 
     // This is now initialized inside of the Input nodes, with the proper connections.
     for (auto node : InputNodes(nullptr))
     {
-        // TODO: use if (!Is<ITakesDynamicAxis>(node))...
-        auto n = dynamic_pointer_cast<ITakesDynamicAxis>(node);
-        if (!n)
-            LogicError("Expected %ls to implement ITakesDynamicAxis, but it doesn't.", node->NodeDescription().c_str());
-        std::wstring axisName = n->GetRequestedDynamicAxis();
-
-        if (axisName == L"")
+        auto axisNode = getAxisNode(node);
+        if (!axisNode)
         {
             // Legacy behavior: One shared MBLayout
             // TODO Remove m_pMBLayoutOfNetwork altogether. See issue 358.
@@ -551,15 +1213,6 @@ void ComputationNetwork::ResetMBLayouts()
         }
         else
         {
-            auto axisNode = GetNodeFromName(axisName);
-
-            if (!axisNode)
-                RuntimeError("%ls: Can't find node '%ls' for retrieving dynamic axis.", axisNode->NodeDescription().c_str(), axisName.c_str());
-
-            // For now we require the node to be a DynamicAxisNode, though we could derive the same from other nodes. This would involve
-            // more dependencies on the order in which things are evaluated, though.
-            if (axisNode->OperationName() != L"DynamicAxis")
-                RuntimeError("%ls: dynamicAxis argument must be of type DynamicAxis(), but got %ls.", node->NodeDescription().c_str(), axisNode->NodeDescription().c_str());
             if (!axisNode->HasMBLayout())
                 LogicError("%ls: Expected %ls to have MBLayout, but it doesn't.", node->NodeDescription().c_str(), axisNode->NodeDescription().c_str());
             node->LinkToMBLayout(axisNode->GetMBLayout());
@@ -571,6 +1224,12 @@ void ComputationNetwork::ResetMBLayouts()
 // validation
 // -----------------------------------------------------------------------
 
+// helper to discover dimension changes
+static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
+{
+    return make_pair(node->GetSampleLayout(), node->HasMBLayout());
+}
+
 // validate sub-network needed to evalute a specific output node
 // This calls Validate() on every node in evaluation order (allowing to propagate things forwards through the net).
 // This is called lazily but once only per node until next ClearCache().
@@ -584,28 +1243,80 @@ void ComputationNetwork::ValidateNetwork()
 
     for (auto& node : nodes)
     {
-        node->m_visited = false;
+        node->m_visited = !m_isValidatingAllNodes && m_nodesToValidate.find(node) == m_nodesToValidate.end(); // unaffected nodes count as validated
         node->m_needsGradient = node->IsParameterUpdateRequired(); // these get propagated upwards in the following
     }
 
-    // loop and validate until we are done
-    // steps:
-    //  - validate (not final)          // not final means no dimension checks
-    //    Keep going through the list until all nodes have been validated and all inputs have been validated as well.
-    //  - validate (final)              // final means consistency checks
-    //    Fail if any change during this stage.
-    size_t pass = 1;
-    size_t toValidate = nodes.size();
-    while (toValidate > 0)
+    // In an incremental compilation, unaffected nodes are not validated, but m_needsGradient may still have changed
+    // for them, e.g. if a parameter was frozen. Propagate it here; the loop is for recurrent loops.
+    if (!m_isValidatingAllNodes)
     {
-        fprintf(stderr, "\nValidating network. %d nodes to process in pass %d.\n\n", (int) toValidate, (int) pass);
-        toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, false /*isFinalValidationPass*/);
-        pass++;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto& node : nodes)
+            {
+                for (auto& child : node->GetInputs())
+                {
+                    if (child->m_needsGradient && !node->m_needsGradient)
+                    {
+                        node->m_needsGradient = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Validating a node may change the dimensions of its inputs (dimension inference of LearnableParameters), in which
+    // case the other consumers of these inputs must be validated as well. In a full validation they already are.
+    for (;;)
+    {
+        list<ComputationNodeBasePtr> nodesToValidate;
+        if (m_isValidatingAllNodes)
+            nodesToValidate = nodes;
+        else
+        {
+            for (auto& node : nodes)
+            {
+                if (m_nodesToValidate.find(node) != m_nodesToValidate.end())
+                    nodesToValidate.push_back(node);
+            }
+            fprintf(stderr, "\nValidating %d of %d nodes, the others are unchanged since the last validation.\n", (int) nodesToValidate.size(), (int) nodes.size());
+        }
+
+        // validate until we are done
+        // steps:
+        //  - validate (not final)          // not final means no dimension checks
+        //    Revisit nodes whose inputs have changed until all nodes have been validated and nothing changes anymore.
+        //  - validate (final)              // final means consistency checks
+        //    Fail if any change during this stage.
+        ValidateNodesUntilStable(nodesToValidate);
+        fprintf(stderr, "\nValidating network, final pass.\n\n");
+        size_t toValidate = ValidateNodes(nodesToValidate, /*isFirstPass=*/false, true /*isFinalValidationPass*/);
+        if (toValidate != 0)
+            LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
+
+        if (m_isValidatingAllNodes)
+            break;
+
+        // find unaffected nodes whose inputs have changed underneath them
+        set<ComputationNodeBasePtr> changedNodes;
+        for (auto& node : nodes)
+        {
+            if (m_nodesToValidate.find(node) != m_nodesToValidate.end())
+                continue;
+            const auto& record = m_validationRecords.at(node);
+            for (size_t i = 0; i < node->GetNumInputs(); i++)
+            {
+                if (record.inputDims[i] != GetDims(node->Input(i)) || record.inputMBLayouts[i] != node->Input(i)->GetMBLayout())
+                    changedNodes.insert(node);
+            }
+        }
+        if (!AddNodesToValidate(changedNodes, /*resetNodes=*/true))
+            break;
     }
-    fprintf(stderr, "\nValidating network, final pass.\n\n");
-    toValidate = ValidateNodes(nodes, /*isFirstPass=*/pass == 1, true /*isFinalValidationPass*/);
-    if (toValidate != 0)
-        LogicError("ValidateSubNetwork: ValidateNodes(true) unexpectedly returned with work left to do.");
 
     // propagate some info to SEQTraversalFlowControlNode
     // TODO: In the future we should validate not on the flat list but the PARTraversalFlowControlNode structure. Then this will be unnecessary.
@@ -638,12 +1349,99 @@ void ComputationNetwork::ValidateNetwork()
         //    fprintf(stderr, "    %ls\n", node->NodeName().c_str());
         // fprintf(stderr, "\n\n");
     }
+
+    RecordValidation();
 }
 
-// helper to discover dimension changes
-static pair<TensorShape, bool> GetDims(const ComputationNodeBasePtr& node)
+// determine the nodes the next ValidateNetwork() must validate, for incremental compilation after edits
+// These are the nodes that are new, have different inputs, or have different dimensions than after the last
+// ValidateNetwork(), or were passed to InvalidateNodeValidation(); and all nodes downstream of them.
+// ResetMBLayouts() and ValidateNetwork() may add further nodes whose MBLayout or input dimensions change.
+// All nodes are validated if there is no previous validation, or incremental compilation is disabled.
+void ComputationNetwork::DetermineNodesToValidate()
 {
-    return make_pair(node->GetSampleLayout(), node->HasMBLayout());
+    m_nodesToValidate.clear();
+    m_isValidatingAllNodes = !s_isIncrementalCompilationEnabled || m_validationRecords.empty();
+    if (!m_isValidatingAllNodes)
+    {
+        set<ComputationNodeBasePtr> changedNodes;
+        for (const auto& node : GetEvalOrder(nullptr))
+        {
+            auto record = m_validationRecords.find(node);
+            if (record == m_validationRecords.end() ||
+                m_invalidatedNodes.find(node) != m_invalidatedNodes.end() ||
+                record->second.inputs != node->GetInputs() ||
+                record->second.dims != GetDims(node))
+                changedNodes.insert(node);
+        }
+        AddNodesToValidate(changedNodes, /*resetNodes=*/false);
+    }
+    m_invalidatedNodes.clear();
+}
+
+// add nodes and everything downstream of them to m_nodesToValidate
+// If 'resetNodes', nodes not yet in it are prepared for validation like ResetMBLayouts() and ValidateNetwork() do.
+// Returns true if any node was added.
+bool ComputationNetwork::AddNodesToValidate(const set<ComputationNodeBasePtr>& nodes, bool resetNodes)
+{
+    const auto& evalOrder = GetEvalOrder(nullptr);
+    vector<ComputationNodeBasePtr> addedNodes;
+    for (const auto& node : nodes)
+    {
+        if (m_nodesToValidate.insert(node).second)
+            addedNodes.push_back(node);
+    }
+    // The eval order is only topologically sorted outside of recurrent loops; hence repeat until nothing changes.
+    size_t numAdded = addedNodes.size();
+    while (numAdded > 0)
+    {
+        numAdded = 0;
+        for (const auto& node : evalOrder)
+        {
+            if (m_nodesToValidate.find(node) != m_nodesToValidate.end())
+                continue;
+            for (const auto& input : node->GetInputs())
+            {
+                if (m_nodesToValidate.find(input) != m_nodesToValidate.end())
+                {
+                    m_nodesToValidate.insert(node);
+                    addedNodes.push_back(node);
+                    numAdded++;
+                    break;
+                }
+            }
+        }
+    }
+    if (resetNodes)
+    {
+        for (const auto& node : addedNodes)
+        {
+            node->m_visited = false;
+            node->LinkToMBLayout(nullptr);
+        }
+    }
+    return !addedNodes.empty();
+}
+
+// remember the inputs, dimensions and MBLayouts of all nodes after ValidateNetwork(), see DetermineNodesToValidate()
+// Note that the records keep deleted nodes alive until the next CompileNetwork().
+void ComputationNetwork::RecordValidation()
+{
+    m_validationRecords.clear();
+    if (!s_isIncrementalCompilationEnabled)
+        return;
+    for (const auto& node : GetEvalOrder(nullptr))
+    {
+        auto& record = m_validationRecords[node];
+        record.inputs = node->GetInputs();
+        for (const auto& input : record.inputs)
+        {
+            record.inputDims.push_back(GetDims(input));
+            record.inputMBLayouts.push_back(input->GetMBLayout());
+        }
+        record.dims = GetDims(node);
+        record.mbLayout = node->GetMBLayout();
+    }
 }
 
 bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const
@@ -676,6 +1474,80 @@ bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalV
     return !unchanged;
 }
 
+// validate (not final) the topologically-sorted node set until nothing changes
+// This is a worklist in eval order: Instead of passes over all nodes, a node is only validated again if it changed
+// (to confirm it is stable) or one of its inputs changed or was validated for the first time. Outside of recurrent
+// loops, this validates each node once, since its inputs come before it.
+void ComputationNetwork::ValidateNodesUntilStable(const list<ComputationNodeBasePtr>& nodes)
+{
+    vector<ComputationNodeBasePtr> nodeVector(nodes.begin(), nodes.end());
+    map<ComputationNodeBasePtr, size_t> indices;
+    for (size_t i = 0; i < nodeVector.size(); i++)
+        indices[nodeVector[i]] = i;
+    vector<vector<size_t>> consumers(nodeVector.size()); // consumers within the node set
+    for (size_t i = 0; i < nodeVector.size(); i++)
+    {
+        for (const auto& input : nodeVector[i]->GetInputs())
+        {
+            auto iter = indices.find(input);
+            if (iter != indices.end())
+                consumers[iter->second].push_back(i);
+        }
+    }
+
+    fprintf(stderr, "\nValidating network. %d nodes to process.\n\n", (int) nodeVector.size());
+    set<size_t> pending; // ordered, so that nodes get validated in eval order
+    for (size_t i = 0; i < nodeVector.size(); i++)
+        pending.insert(i);
+    vector<bool> wasValidated(nodeVector.size(), false);
+    size_t numValidateCalls = 0;
+    while (!pending.empty())
+    {
+        size_t i = *pending.begin();
+        pending.erase(pending.begin());
+        const auto& node = nodeVector[i];
+
+        // only validate a node if it has at least one visited child; otherwise it is queued again once one is
+        bool hasVisitedChild = false;
+        for (const auto& child : node->GetInputs())
+        {
+            hasVisitedChild |= child->m_visited;
+
+            // Make sure we don't use DynamicAxis in places where it was not designed for.
+            // This is a stop-gap. We need a more coherent concept for passing of shapes.
+            if (child->OperationName() == L"DynamicAxis")
+                RuntimeError("%ls: Cannot be used as input to another node. It can only be used on the 'dynamicAxis' property of an Input node.", child->NodeDescription().c_str());
+        }
+        if (!hasVisitedChild && !node->IsLeaf())
+            continue;
+
+        string prevPrototype = node->FormatOperationPrototype("");
+        bool changed;
+        try
+        {
+            changed = ValidateNode(node, false /*isFinalValidationPass*/);
+            numValidateCalls++;
+            string updatedPrototype = node->FormatOperationPrototype("");
+            if (!wasValidated[i] || changed || prevPrototype != updatedPrototype)
+                fprintf(stderr, "Validating --> %s\n", updatedPrototype.c_str());
+        }
+        catch (...) // if validation failed then print the prototype anyway so one can see the input args
+        {
+            fprintf(stderr, "Validating --> %s FAILED\n", prevPrototype.c_str());
+            throw;
+        }
+        node->m_visited = true;
+
+        // a changed node must be validated again to confirm that it is stable, and so must its consumers
+        if (changed && !node->IsLeaf())
+            pending.insert(i);
+        if (changed || !wasValidated[i])
+            pending.insert(consumers[i].begin(), consumers[i].end());
+        wasValidated[i] = true;
+    }
+    fprintf(stderr, "\nValidated %d nodes with %d calls to Validate().\n", (int) nodeVector.size(), (int) numValidateCalls);
+}
+
 // perform one pass of validation over the topologically-sorted node set
 // returns how many nodes either could not yet be validated yet or have changed and thus must be redone
 size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass)
@@ -743,9 +1615,19 @@ size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, boo
 // memory allocation
 // -----------------------------------------------------------------------
 // mark nodes that are purely induced by parameters as non-sharable and create space for value if null
+// Under MemorySharingPolicy::None, all nodes are marked; under MemorySharingPolicy::Aggressive, nodes purely
+// induced by parameters remain sharable, and instead get recomputed in every ForwardProp().
 void ComputationNetwork::MarkValueNonSharableNodes()
 {
     const auto& nodes = GetEvalOrder(nullptr);
+    m_nodesWithRecomputedValue.clear();
+    if (m_matrixPool.GetPolicy() == MemorySharingPolicy::None)
+    {
+        for (auto& node : nodes)
+            node->MarkValueNonSharable();
+        return;
+    }
+
     std::map<wstring, bool> allLeafDescendentsAreParametersOrPreComputeNodes;
     std::list<ComputationNodeBasePtr> allLearnableParameters = GetNodesWithType(OperationNameOf(LearnableParameter));
     // note that: we cannot use m_learnableParameters because we need all parameters node, regardless whether it requires update or not
@@ -797,7 +1679,9 @@ void ComputationNetwork::MarkValueNonSharableNodes()
             }
 
             allLeafDescendentsAreParametersOrPreComputeNodes[myname] = allParametersOrPreComputeNodes;
-            if (allParametersOrPreComputeNodes)
+            if (allParametersOrPreComputeNodes && m_matrixPool.RecomputesParameterOnlyValues() && node->IsValueSharable())
+                m_nodesWithRecomputedValue.push_back(node);
+            else if (allParametersOrPreComputeNodes)
                 node->MarkValueNonSharable();
         }
     }
@@ -913,6 +1797,9 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    if (performingBackPropagation)
+        PlanGradientCheckpointing(trainRootNode, parentsMap, outputValueNeededDuringBackProp);
+
     std::unordered_map<ComputationNodeBasePtr, int> parentCount;
     for (auto& keyValue : parentsMap)
     {
@@ -934,9 +1821,10 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     }
 
     set<ComputationNodeBasePtr> completedEvaluate;
+    ComputationNodeBasePtr fusedSum; // the inputs of a fused PlusNode are read by its consumer, so they are released after that one
     for (auto& nodeIter : compositeForwardPropEvalOrder)
     {
-        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
+        nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter] || !m_matrixPool.SharesValuesDuringForwardProp());
 
         if (nodeIter->IsPartOfLoop())
         {
@@ -956,9 +1844,19 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         else
         {
             nodeIter->RequestMatricesBeforeForwardProp(m_matrixPool);
+            if (nodeIter->IsFusedIntoConsumer())
+            {
+                fusedSum = nodeIter;
+                continue;
+            }
             // we only release matrices for the children since the root node's information will be used and should not be shared
             // with others
             ReleaseMatricesAfterEvalForChildren(nodeIter, parentCount);
+            if (fusedSum && nodeIter->GetNumInputs() == 1 && nodeIter->GetInputs()[0] == fusedSum)
+            {
+                ReleaseMatricesAfterEvalForChildren(fusedSum, parentCount);
+                fusedSum = nullptr;
+            }
         }
     }
 
@@ -968,6 +1866,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
         // now, simulate the gradient computation order to determine how to allocate matrices
         set<ComputationNodeBasePtr> completedGradient;
+        ComputationNodeBasePtr fusedConsumer; // the consumer of a fused PlusNode reads its gradient while writing the summands' gradients
 
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
@@ -993,9 +1892,19 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             {
                 // PAR mode: we can allocate and immediately deallocate one by one
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
+                if (fusedConsumer && fusedConsumer->GetInputs()[0] == n)
+                {
+                    fusedConsumer->ReleaseMatricesAfterBackprop(m_matrixPool);
+                    fusedConsumer = nullptr;
+                }
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
                 if ((n != trainRootNode) && n->NeedsGradient())
-                    n->ReleaseMatricesAfterBackprop(m_matrixPool);
+                {
+                    if (n->GetNumInputs() == 1 && n->GetInputs()[0]->IsFusedIntoConsumer())
+                        fusedConsumer = n;
+                    else
+                        n->ReleaseMatricesAfterBackprop(m_matrixPool);
+                }
             }
         }
     }
@@ -1004,6 +1913,127 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     // print the memory sharing structure
     PrintMemorySharingStructure(GetAllNodes());
+    m_matrixPool.PrintPlanStatistics();
+
+    if (GPUStreams::GetNumStreams() > 1 && m_deviceId >= 0 && (GetMemorySharingPolicy() != MemorySharingPolicy::None || Float16Gemm::IsEnabled()))
+        fprintf(stderr, "WARNING: Forward prop uses a single GPU stream, since multiple streams require memorySharingPolicy=none and no float16Gemm.\n");
+}
+
+// gradient checkpointing: decide which values of the training criterion's top-level nodes get discarded after ForwardProp()
+// and recomputed during Backprop()
+// The evaluation order is cut into segments; a segment ends with a checkpoint node, which is every m_gradientCheckpointInterval-th
+// node, or a node from m_gradientCheckpointNodes. A node inside a segment is recomputed if
+//  - it is a sharable, non-leaf PAR node without state or randomness (recomputing must reproduce the forward value), and
+//  - all of its consumers are in the same segment (so the value is only needed while that segment is backpropagated).
+// The values of recomputed nodes are no longer needed during backprop, while their inputs from outside the set must be kept.
+void ComputationNetwork::PlanGradientCheckpointing(const ComputationNodeBasePtr& trainRootNode,
+                                                   const std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap,
+                                                   std::unordered_map<ComputationNodeBasePtr, bool>& outputValueNeededDuringBackProp)
+{
+    auto nestedNetwork = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(trainRootNode));
+    assert(nestedNetwork);
+    nestedNetwork->m_recomputeSegmentIds.clear();
+    nestedNetwork->m_recomputedNodes.clear();
+    nestedNetwork->m_recomputeBuffers.clear();
+
+    if (!IsGradientCheckpointingEnabled())
+        return;
+    if (!m_matrixPool.SharesValuesDuringForwardProp())
+    {
+        fprintf(stderr, "Gradient checkpointing: Ignored since the memory sharing policy keeps all values after forward prop.\n");
+        return;
+    }
+
+    // cut into segments
+    let& nodes = nestedNetwork->m_nestedNodes;
+    std::unordered_map<ComputationNodeBasePtr, int> segmentOf;
+    int segment = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        let& node = nodes[i];
+        segmentOf[node] = segment;
+        let seqNode = dynamic_pointer_cast<SEQTraversalFlowControlNode>(node);
+        if (seqNode) // loop members are consumed where their loop is
+        {
+            for (let& loopNode : seqNode->m_nestedNodes)
+                segmentOf[loopNode] = segment;
+        }
+        bool isCheckpoint = (m_gradientCheckpointInterval > 0 && (i + 1) % m_gradientCheckpointInterval == 0) ||
+                            m_gradientCheckpointNodes.find(node) != m_gradientCheckpointNodes.end();
+        if (isCheckpoint)
+            segment++;
+    }
+
+    // determine the nodes to recompute
+    let numSegments = segment + 1;
+    nestedNetwork->m_recomputedNodes.resize(numSegments);
+    std::set<ComputationNodeBasePtr> recomputed;
+    for (let& node : nodes)
+    {
+        if (dynamic_pointer_cast<FlowControlNode>(node) || node->IsLeaf() || !node->IsValueSharable() || node->RequiresPreCompute() ||
+            m_gradientCheckpointNodes.find(node) != m_gradientCheckpointNodes.end() ||
+            dynamic_pointer_cast<IRecurrentNode>(node) ||
+            node->OperationName() == OperationNameOf(DropoutNode) ||
+            node->OperationName() == OperationNameOf(BatchNormalizationNode) ||
+            node->IsFusedIntoConsumer() || (node->GetNumInputs() == 1 && node->GetInputs()[0]->IsFusedIntoConsumer())) // the consumer reads the summands
+            continue;
+        let parents = parentsMap.find(node);
+        if (parents == parentsMap.end())
+            continue;
+        bool consumedInSegment = true;
+        for (let& parent : parents->second)
+        {
+            let iter = segmentOf.find(parent);
+            consumedInSegment &= (iter != segmentOf.end() && iter->second == segmentOf[node]);
+        }
+        if (!consumedInSegment)
+            continue;
+        recomputed.insert(node);
+    }
+
+    // only recompute what Backprop() reads: values used by a gradient computation, and the recomputed inputs of those
+    // (e.g. a frozen branch whose values no gradient depends on is neither recomputed nor are its inputs kept for that)
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        let& node = nodes[i];
+        if (recomputed.find(node) == recomputed.end())
+            continue;
+        if (!outputValueNeededDuringBackProp[node])
+        {
+            recomputed.erase(node);
+            continue;
+        }
+        for (let& input : node->GetInputs())
+        {
+            if (recomputed.find(input) != recomputed.end())
+                outputValueNeededDuringBackProp[input] = true;
+        }
+    }
+    for (let& node : nodes)
+    {
+        if (recomputed.find(node) != recomputed.end())
+            nestedNetwork->m_recomputedNodes[segmentOf[node]].push_back(node);
+    }
+
+    // update which values must survive until backprop
+    size_t maxRecomputedPerSegment = 0;
+    for (let& segmentNodes : nestedNetwork->m_recomputedNodes)
+        maxRecomputedPerSegment = max(maxRecomputedPerSegment, segmentNodes.size());
+    for (let& node : recomputed)
+    {
+        outputValueNeededDuringBackProp[node] = false;
+        for (let& input : node->GetInputs())
+        {
+            if (recomputed.find(input) == recomputed.end())
+                outputValueNeededDuringBackProp[input] = true;
+        }
+    }
+
+    for (let& node : nodes)
+        nestedNetwork->m_recomputeSegmentIds.push_back(segmentOf[node]);
+
+    fprintf(stderr, "Gradient checkpointing: %d segments, %d of %d top-level nodes recomputed during backprop, using %d recompute buffers.\n",
+            (int)numSegments, (int)recomputed.size(), (int)nodes.size(), (int)maxRecomputedPerSegment);
 }
 
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, int>& parentCount)
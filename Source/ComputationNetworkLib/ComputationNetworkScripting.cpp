@@ -47,6 +47,10 @@ ComputationNetwork::ComputationNetwork(const IConfigRecordPtr configp) :
 
     DEVICEID_TYPE deviceId = (DEVICEID_TYPE)(int) config[L"deviceId"];
 
+    // optional per-network override of the memory sharing policy
+    if (config.Find(L"memorySharingPolicy"))
+        SetMemorySharingPolicy(ParseMemorySharingPolicy(config[L"memorySharingPolicy"]));
+
     deque<ComputationNodeBasePtr> workList;
 
     // process 'special nodes'
@@ -65,6 +69,7 @@ ComputationNetwork::ComputationNetwork(const IConfigRecordPtr configp) :
             bool isSpecialNode = false;
             for (let& nodeGroupName : nodeGroupNames)
                 isSpecialNode |= id == nodeGroupName + L"Nodes";
+            isSpecialNode |= id == L"gradientCheckpointNodes";
             if (!isSpecialNode)
                 node->SetName(id);
             workList.push_back(node);
@@ -75,6 +80,16 @@ ComputationNetwork::ComputationNetwork(const IConfigRecordPtr configp) :
 
     // construct from roots
     ConstructFromRoots(deviceId, move(workList), map<ComputationNodeBasePtr, ComputationNodeBasePtr>()/*no mapping*/);
+
+    // optional gradient checkpointing
+    if (config.Find(L"gradientCheckpointInterval") || config.Find(L"gradientCheckpointNodes"))
+    {
+        size_t interval = config.Find(L"gradientCheckpointInterval") ? (size_t)(int)config[L"gradientCheckpointInterval"] : 0;
+        vector<ComputationNodeBasePtr> checkpointNodes;
+        if (config.Find(L"gradientCheckpointNodes"))
+            checkpointNodes = ScriptableObjects::ConfigArray::FlattenedVectorFrom<ComputationNodeBasePtr>(config[L"gradientCheckpointNodes"]);
+        SetGradientCheckpointing(interval, checkpointNodes);
+    }
 }
 
 // process the special-nodes parameters
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <functional>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -39,7 +40,10 @@
 #define CNTK_MODEL_VERSION_8 8 // DynamicAxis for inputs
 #define CNTK_MODEL_VERSION_9 9 // Transpose flag in ConvolutionNode to support deconvolution. 
 #define CNTK_MODEL_VERSION_10 10 // Learning rate multiplier for input nodes. 
-#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_10
+#define CNTK_MODEL_VERSION_11 11 // Int8 input range of TimesNode and ConvolutionNode
+#define CNTK_MODEL_VERSION_12 12 // multiple reduction axes in ReduceElementsNode
+#define CNTK_MODEL_VERSION_13 13 // fp16 values of LearnableParameters
+#define CURRENT_CNTK_MODEL_VERSION CNTK_MODEL_VERSION_13
 
 extern bool g_shareNodeValueMatrices;
 
@@ -151,6 +155,7 @@ struct ComputationNetworkOwnedNodeState
     {
         PurgeStateForFormingRecurrentLoops();
         m_isPartOfLoop = false;
+        m_isFusedIntoConsumer = false;
     }
 
     void CopyTo(ComputationNetworkOwnedNodeState& other) const
@@ -167,6 +172,10 @@ struct ComputationNetworkOwnedNodeState
 
     bool IsPartOfLoop() const { return m_isPartOfLoop; }
 
+    // if true, the node's only consumer computes its result directly from this node's inputs, and the node itself is skipped
+    // by forward and backward prop, leaving its value and gradient unset; see ComputationNetwork::FuseElementwiseNodes()
+    bool IsFusedIntoConsumer() const { return m_isFusedIntoConsumer; }
+
     virtual void MarkValueNonSharable() { m_valueSharable = false; }
     virtual void MarkValueSharable() { m_valueSharable = true; }
     bool IsValueSharable() const { return m_valueSharable; }
@@ -189,6 +198,7 @@ protected:                // TODO: should be fully encapsulated here
                           // it will never be released to memory pool
 private:
     bool m_isPartOfLoop; // true if this loop is part of a recurrent loop
+    bool m_isFusedIntoConsumer; // set by FuseElementwiseNodes()
 
 protected:
     // owned by FormRecurrentLoops() and stuff it calls, only used from inside there (FormRecurrentLoops() calls PurgeStateForFormingRecurrentLoops() at its end to make that super-clear)
@@ -607,9 +617,13 @@ public:
 
     DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
 
+    // place the node on another device (pipeline model parallelism); must happen before the matrices are allocated from the pool
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) { m_deviceId = deviceId; }
+
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
     virtual MatrixBasePtr ValuePtr() const = 0; // for use in readers that pass the agnostic object around
+    virtual void SwapValueWithRecomputeBuffer(MatrixBasePtr& buffer) = 0; // for gradient checkpointing: exchange m_value with an external buffer (created if null)
 
     // TODO: two sets of functions, choose one
     const std::wstring& NodeName() const { return m_nodeName; }
@@ -726,6 +740,15 @@ public:
         return false;
     }
 
+    // whether the GPU work of ForwardProp() and BackpropTo() is the same for all minibatches of the same shapes and layout,
+    // so that it can be replayed from a CUDA graph (see ComputationNetwork::RunCapturedIfStable()); false if it depends on
+    // host state that changes, such as random numbers or counters
+    virtual bool IsReplayable() const { return true; }
+
+    // whether ForwardProp() and BackpropTo() of a time step inside a recurrent loop accept a FrameRange that selects a range of the
+    // parallel sequences only (see ComputationNetwork::EnableLoopGapSkipping()); false if they address the parallel sequences by themselves
+    virtual bool SupportsSequenceRange() const { return true; }
+
     // reset gradients of a node's inputs
     // This really only clears the lazy-init flags (LazyZeroGradient() actually clears the values lazily).
     void /*ComputationNodeBase::*/ ZeroGradientsOfInputs()
@@ -759,7 +782,7 @@ public:
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const { return true; }
 
     void SetOutputNeededDuringBackprop(bool f) { m_outputNeededDuringBackprop = f; }
-    bool IsOutputNeededDuringBackprop() const { return !g_shareNodeValueMatrices || m_outputNeededDuringBackprop; }
+    bool IsOutputNeededDuringBackprop() const { return m_outputNeededDuringBackprop; }
 
     // -----------------------------------------------------------------------
     // helpers for network traversal
@@ -1172,14 +1195,39 @@ public:
     Matrix<ElemType>&       Value()       { return *m_value; }
 
     MatrixBasePtr ValuePtr() const override final { return m_value; }    // readers want this as a shared_ptr straight
+
+    // Moves the value (e.g. of a LearnableParameter) and an existing gradient along. Scratch matrices that a node
+    // creates in its constructor follow the first time they meet an operand on the new device.
+    virtual void MoveToDevice(DEVICEID_TYPE deviceId) override
+    {
+        Base::MoveToDevice(deviceId);
+        if (m_value)
+            m_value->TransferToDeviceIfNotThere(deviceId, /*isBeingMoved=*/true);
+        if (m_gradient)
+            m_gradient->TransferToDeviceIfNotThere(deviceId, /*isBeingMoved=*/true);
+    }
     // Note: We cannot return a const& since returning m_value as a MatrixBasePtr is a type cast that generates a temporary. Interesting.
 
+    // gradient checkpointing recomputes a discarded value into a buffer that is private to backprop, so that the pool-shared m_value is left alone
+    virtual void SwapValueWithRecomputeBuffer(MatrixBasePtr& buffer) override final
+    {
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(buffer);
+        if (!matrix)
+            matrix = make_shared<Matrix<ElemType>>(m_deviceId);
+        buffer = m_value;
+        m_value = matrix;
+    }
+
     const Matrix<ElemType>& Gradient() const { return *m_gradient; }
     Matrix<ElemType>&       Gradient()       { return *m_gradient; }
 
     MatrixBasePtr GradientPtr() const { return m_gradient; }
     // TODO: This is only used for testing whether a gradient has been allocated. Maybe reduce to bool HasGradient()?
 
+    // for rebinding the storage, e.g. to views into SGD's contiguous parameter arena
+    shared_ptr<Matrix<ElemType>>& ValuePtrRef() { return m_value; }
+    shared_ptr<Matrix<ElemType>>& GradientPtrRef() { return m_gradient; }
+
 private:
 
     template<class E>
@@ -1513,7 +1561,7 @@ public:
     {
         if (!IsLeaf() && !RequiresPreCompute())
         {
-            if (m_gradient != nullptr && m_gradient->GetMatrixType() != SPARSE) // since we don't have a sparse pool yet
+            if (m_gradient != nullptr && m_gradient->GetMatrixType() != SPARSE && matrixPool.SharesGradients()) // since we don't have a sparse pool yet
                 ReleaseMatrixToPool(m_gradient, matrixPool);
 
             // Release the Value matrix only if the output value is needed during backprop
@@ -1550,11 +1598,13 @@ protected:
             matrixPtr = make_shared<Matrix<ElemType>>(m_deviceId);
     }
 
+    // The pool is told the expected size so it can pick a best-fitting matrix. Node-internal temporaries are
+    // estimated to be as large as the node's output, which holds for most.
     void RequestMatrixFromPool(shared_ptr<Matrix<ElemType>>& matrixPtr, MatrixPool& matrixPool)
     {
         if (matrixPtr == nullptr)
         {
-            matrixPtr = matrixPool.Request<ElemType>(m_deviceId);
+            matrixPtr = matrixPool.Request<ElemType>(m_deviceId, GetSampleLayout().GetNumElements());
         }
     }
 
@@ -1577,6 +1627,12 @@ public:
                                       const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
                                       const std::string& sampleSeparator, std::string valueFormatString,
                                       bool outputGradient = false) const;
+    // the same for a minibatch that was copied out of a node, e.g. to format it on another thread; 'matData' is modified in place
+    static void WriteMinibatchDataWithFormatting(FILE* f, const FrameRange& fr, ElemType* matData, size_t matRows, const TensorShape& sampleLayout, MBLayoutPtr pMBLayout,
+                                                 size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, bool isSparse,
+                                                 const std::vector<std::string>& labelMapping, const std::string& sequenceSeparator,
+                                                 const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
+                                                 const std::string& sampleSeparator, std::string valueFormatString);
 
     // simple helper to log the content of a minibatch
     void DebugLogMinibatch(bool outputGradient = false) const
@@ -1857,6 +1913,7 @@ public:
     virtual ComputationNodeBasePtr Duplicate(const std::wstring& newName, const CopyNodeFlags flags) const override { NOT_IMPLEMENTED; }
     virtual double Get00Element() const override { NOT_IMPLEMENTED; }
     virtual MatrixBasePtr ValuePtr() const override { NOT_IMPLEMENTED; }
+    virtual void SwapValueWithRecomputeBuffer(MatrixBasePtr&) override { NOT_IMPLEMENTED; }
     virtual void UpdateFunctionMBSize() override { NOT_IMPLEMENTED; }
     virtual void AttachInputs(const std::vector<ComputationNodeBasePtr>& inputs) override { NOT_IMPLEMENTED; }
     virtual void PrintSelf(bool) const override { NOT_IMPLEMENTED; }
@@ -1936,6 +1993,9 @@ struct IPreComputeNode
     // call this with 'false' at start and with 'true' at end
     // This is used for resetting and updating from accumulators.
     virtual void MarkComputed(const bool hasComputed) = 0;
+    // combine the accumulators of workers that each saw part of the data; call this before MarkComputed(true)
+    // allReduceSum() sums a buffer in place over all workers.
+    virtual void AggregateAccumulators(const std::function<void(std::vector<double>&)>& allReduceSum) = 0;
 };
 
 // =======================================================================
@@ -146,6 +146,7 @@ public:
     TensorShape LowerPad() const { return m_lowerPad; }
     TensorShape UpperPad() const { return m_upperPad; }
     bool Transpose() const { return m_transpose; }
+    ImageLayoutKind ImageLayout() const { return m_imageLayout; }
     size_t MaxTempMemSizeInSamples() const { return m_maxTempMemSizeInSamples; }
     PoolKind PoolingKind() const { return m_poolKind; }
 
@@ -232,14 +233,14 @@ class ConvolutionNode : public ConvolutionNodeBase<ElemType>, public NumInputs<2
     static const std::wstring TypeName() { return L"Convolution"; }
 public:
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_int8InputRange(0)
     {
     }
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const TensorShape& kernelShape, const TensorShape& mapCount, const TensorShape& strideShape,
                     const std::vector<bool>& sharing, const std::vector<bool>& autoPadding, const TensorShape& lowerPad, const TensorShape& upperPad,
                     bool transpose, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples)
                     : Base(deviceId, name, kernelShape, mapCount, strideShape, sharing, autoPadding, lowerPad, upperPad, PoolKind::None, transpose, imageLayout, maxTempMemSizeInSamples),
-                    m_convolution2D(false)
+                    m_convolution2D(false), m_int8InputRange(0)
     {
     }
     ConvolutionNode(DEVICEID_TYPE deviceId, const wstring& name, const size_t kernelWidth, const size_t kernelHeight, const size_t outputChannels,
@@ -265,6 +266,7 @@ public:
     {
         Base::Save(fstream);
         fstream << m_convolution2D;
+        fstream << m_int8InputRange;
     }
 
     void Load(File& fstream, size_t modelVersion) override
@@ -301,6 +303,10 @@ public:
         {
             fstream >> m_convolution2D;
         }
+        if (modelVersion >= CNTK_MODEL_VERSION_11)
+            fstream >> m_int8InputRange;
+        else
+            m_int8InputRange = 0;
     }
 
     void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -310,6 +316,7 @@ public:
         {
             auto node = dynamic_pointer_cast<ConvolutionNode<ElemType>>(nodeP);
             node->m_convolution2D = m_convolution2D;
+            node->m_int8InputRange = m_int8InputRange;
         }
     }
 
@@ -319,7 +326,13 @@ public:
         const Matrix<ElemType>& input0 = Input(0)->ValueAsMatrix();
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         if (!m_transpose)
+        {
+            // int8 inference, with the range of the input recorded while calibrating (see DoCalibrate())
+            if (Environment().m_isCalibratingInt8 && sliceInput1Value.GetMatrixType() == DENSE && sliceInput1Value.GetNumElements() > 0)
+                m_int8InputRange = max(m_int8InputRange, sliceInput1Value.MatrixNormInf());
+            m_convEng->SetInt8Inference(Environment().UsesInt8Inference() && m_convEng->SupportsInt8(), m_int8InputRange, Input(0)->GetEvalTimeStamp());
             m_convEng->Forward(sliceInput1Value, input0, sliceOutputValue, *m_tempMatrix);
+        }
         else
         {
             // BackwardData adds results to the output so need to zero them out first.
@@ -336,10 +349,12 @@ public:
         {
             auto& grad = Input(0)->GradientAsMatrix();
             auto sliceInput1Value = Input(1)->ValueFor(fr);
+            // the packed input that ForwardProp() left in the workspace is gone if other nodes have used it since
+            bool allowReuse = fr.IsAllFrames() && !m_isWorkspaceShared;
             if (!m_transpose)
-                m_convEng->BackwardKernel(sliceOutputGrad, sliceInput1Value, grad, fr.IsAllFrames(), *m_tempMatrix);
+                m_convEng->BackwardKernel(sliceOutputGrad, sliceInput1Value, grad, allowReuse, *m_tempMatrix);
             else
-                m_convEng->BackwardKernel(sliceInput1Value, sliceOutputGrad, grad, fr.IsAllFrames(), *m_tempMatrix);
+                m_convEng->BackwardKernel(sliceInput1Value, sliceOutputGrad, grad, allowReuse, *m_tempMatrix);
         }
         else if (inputIndex == 1) // derivative with respect to the input feature
         {
@@ -459,16 +474,15 @@ public:
         }
     }
 
+    // The engine's workspace is only needed during a single call, so all convolutions share one.
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_tempMatrix, matrixPool);
-    }
-
-    void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
-    {
-        Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_tempMatrix, matrixPool);
+        if (m_tempMatrix == nullptr)
+        {
+            m_tempMatrix = matrixPool.RequestWorkspace<ElemType>(m_deviceId);
+            m_isWorkspaceShared = matrixPool.GetPolicy() != MemorySharingPolicy::None;
+        }
     }
 
     void SetmMaxTempMemSizeInSamples(const size_t maxTempMemSizeInSamples)
@@ -478,9 +492,16 @@ public:
             m_convEng->SetmMaxTempMemSizeInSamples(maxTempMemSizeInSamples);
     }
 
+    ElemType Int8InputRange() const { return m_int8InputRange; }
+    void SetInt8InputRange(ElemType range) { m_int8InputRange = range; }
+
 protected:
     // Flag that indicates whether the node is created using 2D-syntax.
     bool m_convolution2D;
+    // whether m_tempMatrix is the workspace shared with other nodes
+    bool m_isWorkspaceShared = false;
+    // range of the input for int8 inference, 0 if it has not been calibrated
+    ElemType m_int8InputRange;
 };
 
 // -----------------------------------------------------------------------
@@ -183,24 +183,19 @@ public:
 
         int iNumPos = lbls.GetNumCols();
 
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        int lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, iNumPos - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
-        stt = firstLbl;
-        stp = lastLbl;
+        // only the first and the last column are needed on the host
+        auto firstNonZeroRow = [&lbls](size_t t)
+        {
+            std::vector<ElemType> column(lbls.GetNumRows());
+            lbls.ColumnSlice(t, 1).CopySection(column.size(), 1, column.data(), column.size());
+            for (int ik = 0; ik < (int) column.size(); ik++)
+                if (column[ik] != 0)
+                    return ik;
+            return -1;
+        };
+
+        stt = firstNonZeroRow(0);
+        stp = firstNonZeroRow(iNumPos - 1);
     };
 
     virtual void BackpropToNonLooping(size_t /*inputIndex*/) override // scaled by 2*number of elements in the Matrix<ElemType>
@@ -233,84 +228,9 @@ public:
         // this implementation only supports one sentence per minibatch
 
         // change to other values so can support multiple sentences in each minibatch
-        ForwardCompute(alpha, backtrace, pos_scores, pair_scores, stt);
-        BackwardCompute(functionValues, backtrace, stp);
-    };
-
-    // compute forward backward algorithm
-    static void ForwardCompute(Matrix<ElemType>& alpha,
-                               Matrix<ElemType>& backtrace,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
-                               const size_t stt)
-    {
-        // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = pos_scores.GetNumCols();
-        int iNumLab = pos_scores.GetNumRows();
-        size_t iTmp = 0;
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-        backtrace.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                if (t > 1)
-                {
-                    for (int j = 0; j < iNumLab; j++)
-                    {
-                        ElemType fAlpha = alpha(j, t - 1) + pair_scores(k, j);
-                        if (fAlpha > fTmp)
-                        {
-                            fTmp = fAlpha;
-                            iTmp = j;
-                        }
-                    }
-                    fTmp += pos_scores(k, t); // include position dependent score
-                }
-                else
-                {
-                    // with constrain that the first word is labeled as a given symbol
-                    iTmp = stt;
-                    fTmp = 0;
-                    if (t == 1)
-                    {
-                        fTmp = alpha(iTmp, t - 1);
-                        fTmp += pair_scores(k, iTmp);
-                        fTmp += pos_scores(k, t);
-                    }
-                    else
-                    {
-                        fTmp = (k == stt) ? pos_scores(k, t) : (ElemType) LZERO;
-                    }
-                }
-                alpha(k, t) = fTmp;
-                backtrace(k, t) = (ElemType) iTmp;
-            }
-        }
-    };
-
-    // compute backward algorithm
-    static void BackwardCompute(
-        Matrix<ElemType>& decodedpath,
-        const Matrix<ElemType>& backtrace, const size_t stp)
-    {
-        int iNumPos = backtrace.GetNumCols();
-        int iNumLab = backtrace.GetNumRows();
-
-        decodedpath.Resize(iNumLab, iNumPos);
-        decodedpath.SetValue(0);
-
-        size_t lastlbl = stp;
-        decodedpath(lastlbl, iNumPos - 1) = 1;
-
-        for (int t = iNumPos - 1; t > 0; t--)
-        {
-            lastlbl = (size_t) backtrace(lastlbl, t);
-            decodedpath(lastlbl, t - 1) = 1;
-        }
+        // The Viterbi recursion (with the first word constrained to be labeled 'stt') and the backtrace
+        // from 'stp' run where the scores are, without moving them to the host.
+        Matrix<ElemType>::RCRFViterbiCompute(alpha, backtrace, functionValues, pos_scores, pair_scores, (int) stt, (int) stp);
     };
 
     // need to feed in pseudo label data, which tells the decoder what is the beginning
@@ -5,6 +5,7 @@
 
 #include "Basics.h"
 #include "InputAndParamNodes.h"
+#include "ComputationNetwork.h" // for IsDeferredParameterInitEnabled()
 #include "File.h"        // for LoadMatrixFromTextFile()
 #include "TensorShape.h" // for SmallVector<>
 
@@ -137,7 +138,7 @@ LearnableParameter<ElemType>::LearnableParameter(const ScriptableObjects::IConfi
     // This will be repeated if the matrix gets resized due to dimension inference.
     LazyInitParameters();
 
-    if (!m_initString.empty())
+    if (!m_initString.empty() && !HasDeferredInit())
         fprintf(stderr, "%ls: Initializating Parameter[%s] as %ls later when dimensions are fully known.\n", NodeDescription().c_str(), string(GetSampleLayout()).c_str(), m_initString.c_str());
 }
 
@@ -169,7 +170,7 @@ void LearnableParameter<ElemType>::PostInitParameters(const wstring& initString,
     // This will be repeated if the matrix gets resized due to dimension inference.
     LazyInitParameters();
 
-    if (!m_initString.empty())
+    if (!m_initString.empty() && !HasDeferredInit())
         fprintf(stderr, "%ls: Initializating Parameter[%s] as %ls later when dimensions are fully known.\n", NodeDescription().c_str(), string(GetSampleLayout()).c_str(), m_initString.c_str());
 }
 
@@ -291,6 +292,7 @@ void LearnableParameter<ElemType>::InitFromArray(const std::vector<ElemType>& ar
     Value().SetValue(numRows, numCols, m_deviceId, const_cast<ElemType*>(array.data()), matrixFlagNormal);
     // TODO: Get rid of that const_cast, as soon as after Ryan's Matrix-lib refactoring separated out SetValue() from external vs. from deep copy
     VerifyDataSize(Value());      // sanity check
+    m_initString.clear();         // this overrides a pending initialization
 }
 
 // TODO: Move this error check there, since this is called only from one place.
@@ -310,12 +312,16 @@ void LearnableParameter<ElemType>::ReviseFromFile(const std::wstring& reviseFrom
 template <class ElemType>
 void LearnableParameter<ElemType>::Save(File& fstream) const /*override*/
 {
+    EnsureInitialized();
     if (!m_initString.empty())
         LogicError("LearnableParameter: Cannot Save() before deferred initialization has completed.");
     Base::Save(fstream);
     fstream << m_learningRateMultiplier;
     m_sampleLayout.Save(fstream);
-    fstream << Value();
+    if (this->GetEnvironmentPtr() && this->Environment().m_saveParametersAsFloat16 && (Value().GetMatrixType() == DENSE))
+        Value().WriteAsFloat16(fstream);
+    else
+        fstream << Value();
 }
 
 template <class ElemType>
@@ -348,7 +354,16 @@ void LearnableParameter<ElemType>::Load(File& fstream, size_t modelVersion) /*ov
         }
     }
 
-    LoadValue(fstream);
+    if (m_parameterArchive && m_parameterArchive->LoadValue(fstream, NodeName(), m_deviceId, m_value))
+    {
+        if (m_deviceId != CPUDEVICE) // a copy
+            m_parameterArchive = nullptr;
+    }
+    else
+    {
+        m_parameterArchive = nullptr;
+        LoadValue(fstream);
+    }
     SetDims(sampleLayout, false); // note: call this after LoadValue() since LoadValue() overwrites m_sampleLayout
     VerifyDataSize(Value());      // sanity check
 
@@ -374,6 +389,7 @@ template <class ElemType>
 template <class ElemType>
 /*virtual*/ void LearnableParameter<ElemType>::UpdateFunctionMBSize() /*override*/
 {
+    CompleteDeferredInit();
     if (!m_initString.empty())
         LogicError("LearnableParameter: Deferred initialization has not been completed until first call to UpdateFunctionMBSize().");
 }
@@ -431,7 +447,16 @@ void LearnableParameter<ElemType>::LazyInitParameters()
     // if not all dimensions are known yet, we cannot proceed: keep it pending
     if (GetSampleLayout().GetNumElements() == 0)
         return;
+    // random initialization may be deferred further, see CompleteDeferredInit()
+    if (ComputationNetwork::IsDeferredParameterInitEnabled() && ParseRandomizationType(m_initString).second != 0)
+        return;
     // OK, proceed
+    InitParameters();
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::InitParameters()
+{
     if (m_initString == L"fromValue")
     {
         fprintf(stderr, "%ls: Initializing Parameter[%s] <- %f.\n", NodeDescription().c_str(), string(GetSampleLayout()).c_str(), m_initValue);
@@ -447,6 +472,23 @@ void LearnableParameter<ElemType>::LazyInitParameters()
     m_initString.clear();
 }
 
+// complete a random initialization that LazyInitParameters() has deferred
+// This is called from ComputationNetwork::CompileNetwork(), which does it for all parameters at once. Parameters that
+// have been loaded in the meantime have no pending initialization anymore.
+template <class ElemType>
+void LearnableParameter<ElemType>::CompleteDeferredInit()
+{
+    if (HasDeferredInit())
+        InitParameters();
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::EnsureInitialized() const
+{
+    if (HasDeferredInit())
+        const_cast<LearnableParameter<ElemType>*>(this)->CompleteDeferredInit();
+}
+
 // called from ComputationNode::ValidateInferInputDimsFrom()
 // In case of an error, this function just backs out without updating.
 // The caller must verify the dimensions.
@@ -506,6 +548,7 @@ void LearnableParameter<ElemType>::InferInputDimsFrom(const TensorShape& otherSh
 template <class ElemType>
 /*virtual*/ void LearnableParameter<ElemType>::DumpNodeInfo(const bool printValues, const bool printMetadata, File& fstream) const /*override*/
 {
+    EnsureInitialized();
     if (printMetadata)
     {
         Base::DumpNodeInfo(printValues, printMetadata, fstream);
@@ -6,6 +6,7 @@
 
 #include "Basics.h"
 #include "ComputationNode.h"
+#include "ParameterArchive.h"
 #include "ScriptableObjects.h"
 #include "TensorShape.h"
 #include "Matrix.h"
@@ -69,8 +70,17 @@ private:
 
     // deferred initialization
     void LazyInitParameters();
+    void InitParameters();
+
+    // completes a deferred random initialization in const functions that need the value
+    void EnsureInitialized() const;
 
 public:
+    // Random initialization is deferred to ComputationNetwork::CompileNetwork() if enabled, see ComputationNetwork::EnableDeferredParameterInit(),
+    // so that it is skipped for values that get loaded, and done in parallel for all parameters.
+    bool HasDeferredInit() const { return !m_initString.empty() && GetSampleLayout().GetNumElements() != 0; }
+    void CompleteDeferredInit();
+
     // reload parameters from file
     // This is called from MEL.
     void ReviseFromFile(const std::wstring& reviseFromFilePath);
@@ -78,6 +88,9 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    // take the value from an archive in the next Load() if it has it, see ParameterArchive
+    void SetParameterArchive(const ParameterArchivePtr& archive) { m_parameterArchive = archive; }
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
 
     // computation functions don't do anything for parameter nodes
@@ -105,6 +118,8 @@ private:
     ElemType m_initValueScale;
     bool m_initOnCPUOnly;
     ElemType m_initValue;
+
+    ParameterArchivePtr m_parameterArchive; // keeps the mapping alive while the value refers to it
 };
 
 // -----------------------------------------------------------------------
@@ -508,9 +523,16 @@ public:
         if (inputIndex == 0) // left derivative (embedding matrix)
         {
             // This is a reduction operation, hence we need to mask out gaps.
-            Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(t);
+            // A sparse input is not masked; its gap columns meet zeroes in the masked output gradient.
+            Matrix<ElemType> sliceInput1Value = IsInputSparse() ? Input(1)->ValueFor(t) : Input(1)->MaskedValueFor(t);
             Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(t);
 
+            // The gradient of the embedding matrix of a sparse input only has the columns of the words that occur in
+            // the minibatch, and is kept as sparse block-column matrix, like that of TimesNode.
+            // BUGBUG: Like in TimesNode, this does not accumulate into the Input(0)->Gradient().
+            if (IsInputSparse() && Input(0)->Gradient().GetMatrixType() == DENSE && Gradient().GetMatrixType() == DENSE)
+                Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+
             BackpropToLeft(sliceInput1Value, Input(0)->GradientAsMatrix(), sliceOutputGrad);
         }
         else if (inputIndex == 1) // right derivative (input)
@@ -528,9 +550,11 @@ public:
         size_t rowsp = gradientValues.GetNumRows(), colsp = gradientValues.GetNumCols();
         int wordsInEachSample = rows1 / inputGradientValues.GetNumCols();
 
+        // note: Reshape() is a no-op for a single word per sample, which is the only case supported for a sparse input slice
         inputFunctionValues.Reshape(rows1 / wordsInEachSample, cols1 * wordsInEachSample);
         gradientValues.Reshape(rowsp / wordsInEachSample, colsp * wordsInEachSample);
 
+        // for a sparse input, this touches only the columns of the words in the minibatch
         Matrix<ElemType>::MultiplyAndAdd(gradientValues, false, inputFunctionValues, true, inputGradientValues);
 
         inputFunctionValues.Reshape(rows1, cols1);
@@ -567,12 +591,30 @@ public:
         if (cols0 * wordsInEachSample != rows1)
             LogicError("LookupTableNode: rows of input 1 is not a multiple of cols of input 0. This usually happens when the feature dimension is not specified as that in the network definition of look-up-table dimension size.");
 
-        auto input1Reshaped = input1.Reshaped(rows1 / wordsInEachSample, cols1 * wordsInEachSample); // BUGBUG: Won't work for sparse. Also kills BOTH state that we would like to retain.
+        if (input1.GetMatrixType() == SPARSE && wordsInEachSample != 1)
+            InvalidArgument("%ls %ls operation: A sparse input must have a single word per sample.", NodeName().c_str(), OperationName().c_str());
 
+        auto input1Reshaped = input1.Reshaped(rows1 / wordsInEachSample, cols1 * wordsInEachSample); // BUGBUG: Kills BOTH state that we would like to retain.
+
+        // For a sparse input, the product only reads the embeddings of the words that occur in the minibatch.
         auto functionValuesReshaped = functionValues.Reshaped(input0.GetNumRows(), input1Reshaped.GetNumCols());
         functionValuesReshaped.AssignProductOf(input0, false, input1Reshaped, false);
     }
 
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // the sparse gradient of the embedding matrix is allocated directly instead of from the pool, see BackpropTo()
+        if (Input(0)->NeedsGradient() && IsInputSparse())
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -589,6 +631,11 @@ public:
         SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * wordsInEachSample), true);
     }
 
+private:
+    bool IsInputSparse() const { return Input(1)->Value().GetMatrixType() == SPARSE; }
+
+public:
+
     bool UnitTest()
     {
         try
@@ -8,6 +8,8 @@
 #include "ComputationNode.h"
 #include "Matrix.h"
 #include "TensorView.h"
+#include "QuantizedMultiplier.h"
+#include "Int8Multiplier.h"
 
 #include <unordered_set>
 #include <map>
@@ -239,7 +241,7 @@ class TimesNodeBase : public ComputationNode<ElemType>, public NumInputs<2>
 
 public:
     TimesNodeBase(DEVICEID_TYPE deviceId, const wstring& name, size_t outputRank = 1)
-        : Base(deviceId, name), m_outputRank(outputRank)
+        : Base(deviceId, name), m_outputRank(outputRank), m_quantizedWeightTimeStamp(0), m_int8InputRange(0), m_int8WeightTimeStamp(0)
     {
     }
 
@@ -250,6 +252,7 @@ public:
         {
             auto node = dynamic_pointer_cast<TimesNodeBase<ElemType, m_transpose>>(nodeP);
             node->m_outputRank = m_outputRank;
+            node->m_int8InputRange = m_int8InputRange;
         }
     }
 
@@ -257,6 +260,7 @@ public:
     {
         Base::Save(fstream);
         fstream << m_outputRank;
+        fstream << m_int8InputRange;
     }
 
     virtual void Load(File& fstream, size_t modelVersion) override
@@ -266,6 +270,10 @@ public:
             fstream >> m_outputRank;
         else
             m_outputRank = 1;
+        if (modelVersion >= CNTK_MODEL_VERSION_11)
+            fstream >> m_int8InputRange;
+        else
+            m_int8InputRange = 0;
     }
 
 private:
@@ -284,13 +292,157 @@ private:
         return TensorView<ElemType>(data, tensorShape);
     }
 
+    // In quantized inference, the common case of CPU weights times dense CPU data is done by a QuantizedMultiplier
+    // which holds the quantized weights, and re-quantizes them whenever the weights change.
+    bool TryForwardPropQuantized(const FrameRange& fr)
+    {
+        bool transpose = m_transpose; // (avoids a compiler warning C4127: conditional expression is constant)
+        if (transpose || !Environment().UsesQuantizedInference() || !Input(0)->IsLeaf() || Input(0)->HasMBLayout())
+            return false;
+        auto& weights = Input(0)->Value();
+        auto input1 = Input(1)->ValueFor(fr);
+        auto output = ValueFor(fr);
+        if (weights.GetDeviceId() != CPUDEVICE || weights.GetMatrixType() != DENSE || input1.GetDeviceId() != CPUDEVICE || input1.GetMatrixType() != DENSE)
+            return false;
+        size_t outputDim = output.GetNumRows();
+        if (outputDim * input1.GetNumRows() != weights.GetNumElements() || input1.GetNumCols() != output.GetNumCols())
+            return false;
+        if (!QuantizedMultiplier<ElemType>::IsSupported())
+            return false;
+
+        if (!m_quantizedMultiplier || m_quantizedWeightTimeStamp != Input(0)->GetEvalTimeStamp() ||
+            m_quantizedMultiplier->GetNumRows() != outputDim || m_quantizedMultiplier->GetNumCols() != input1.GetNumRows())
+        {
+            if (!m_quantizedMultiplier)
+                m_quantizedMultiplier = make_shared<QuantizedMultiplier<ElemType>>();
+            m_quantizedMultiplier->SetA(weights.Data(), outputDim, input1.GetNumRows());
+            m_quantizedWeightTimeStamp = Input(0)->GetEvalTimeStamp();
+        }
+        m_quantizedMultiplier->Multiply(input1.Data(), input1.GetNumCols(), output.Data());
+        return true;
+    }
+
+    // In int8 inference, weights times dense data on the same device (CPU or GPU) is done by an Int8Multiplier, which quantizes
+    // the data with the range recorded by calibration, or per column if there is none.
+    bool TryForwardPropInt8(const FrameRange& fr)
+    {
+        bool transpose = m_transpose; // (avoids a compiler warning C4127: conditional expression is constant)
+        if (transpose || !Environment().UsesInt8Inference() || !Input(0)->IsLeaf() || Input(0)->HasMBLayout())
+            return false;
+        auto& weights = Input(0)->Value();
+        auto input1 = Input(1)->ValueFor(fr);
+        auto output = ValueFor(fr);
+        if (weights.GetMatrixType() != DENSE || input1.GetMatrixType() != DENSE || input1.GetDeviceId() != weights.GetDeviceId())
+            return false;
+        size_t outputDim = output.GetNumRows();
+        if (outputDim * input1.GetNumRows() != weights.GetNumElements() || input1.GetNumCols() != output.GetNumCols() || input1.GetNumRows() > (1 << 17))
+            return false;
+
+        if (!m_int8Multiplier || m_int8WeightTimeStamp != Input(0)->GetEvalTimeStamp() || m_int8Multiplier->GetDeviceId() != weights.GetDeviceId() ||
+            m_int8Multiplier->GetNumRows() != outputDim || m_int8Multiplier->GetNumCols() != input1.GetNumRows())
+        {
+            if (!m_int8Multiplier)
+                m_int8Multiplier = make_shared<Int8Multiplier<ElemType>>();
+            m_int8Multiplier->SetA(weights, outputDim, input1.GetNumRows());
+            m_int8WeightTimeStamp = Input(0)->GetEvalTimeStamp();
+        }
+        m_int8Multiplier->Multiply(input1, output, m_int8InputRange);
+        return true;
+    }
+
+    // while calibrating, keep track of the largest absolute value of the data, which is the range TryForwardPropInt8() quantizes it to
+    void RecordInt8InputRange(const FrameRange& fr)
+    {
+        auto input1 = Input(1)->ValueFor(fr);
+        if (input1.GetMatrixType() == DENSE && input1.GetNumElements() > 0)
+            m_int8InputRange = max(m_int8InputRange, input1.MatrixNormInf());
+    }
+
+    // If A is minibatch data, each of its columns is a separate matrix. Instead of one GEMM per time step and sequence,
+    // all columns of the frame range are then multiplied with a single batched GEMM, where B is either minibatch data
+    // with the same layout (one matrix per column as well) or no minibatch data (the same matrix for all columns).
+    // This gets the dimensions of the per-column products [m x k] * [k x n], or returns false if they are not batchable.
+    bool GetBatchedProductDims(const FrameRange& fr, size_t& m, size_t& n, size_t& k)
+    {
+        if ((fr.seqIndex != SIZE_MAX && (fr.IsAllFrames() || fr.m_timeRange != 1)) || // (a range of parallel sequences is contiguous within a time step only)
+            (Input(1)->HasMBLayout() && Input(1)->GetMBLayout() != Input(0)->GetMBLayout()))
+            return false;
+        if (Input(0)->Value().GetMatrixType() != DENSE || Input(1)->Value().GetMatrixType() != DENSE)
+            return false;
+        auto dimsA = Input(0)->GetSampleLayout().GetDims();
+        size_t numElementsA = Input(0)->GetSampleLayout().GetNumElements();
+        bool transpose = m_transpose; // (avoids a compiler warning C4127: conditional expression is constant)
+        if (transpose) // (Validate() has verified that A is a matrix or a column vector)
+        {
+            k = dimsA[0];
+            m = numElementsA / k;
+        }
+        else
+        {
+            m = 1;
+            for (size_t i = 0; i < m_outputRank; i++)
+                m *= dimsA[i];
+            k = numElementsA / m;
+        }
+        n = Input(1)->GetSampleLayout().GetNumElements() / k;
+        return m * k == numElementsA && k * n == Input(1)->GetSampleLayout().GetNumElements() && m * n == GetSampleLayout().GetNumElements();
+    }
+
+    // the value or gradient of input 1 with one column per matrix, or a single column if it is no minibatch data
+    Matrix<ElemType> BatchedInput1For(bool gradient, const FrameRange& fr)
+    {
+        auto input = Input(1);
+        if (input->HasMBLayout())
+            return gradient ? input->GradientFor(fr) : input->ValueFor(fr);
+        auto& data = gradient ? input->Gradient() : input->Value();
+        return data.Reshaped(data.GetNumElements(), 1);
+    }
+
+    bool TryForwardPropBatched(const FrameRange& fr)
+    {
+        size_t m, n, k;
+        if (!GetBatchedProductDims(fr, m, n, k))
+            return false;
+        auto output = ValueFor(fr);
+        Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, Input(0)->ValueFor(fr), m_transpose, BatchedInput1For(/*gradient=*/false, fr), false, 0, output, m, n, k);
+        return true;
+    }
+
+    bool TryBackpropToBatched(const size_t inputIndex, const FrameRange& fr)
+    {
+        size_t m, n, k;
+        if (!GetBatchedProductDims(fr, m, n, k))
+            return false;
+        auto outputGradient = GradientFor(fr);
+        if (inputIndex == 0) // dA_j += dC_j B_j^T, or B_j dC_j^T if A is transposed
+        {
+            auto input0Gradient = Input(0)->GradientFor(fr);
+            bool transpose = m_transpose;
+            if (transpose)
+                Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, BatchedInput1For(/*gradient=*/false, fr), false, outputGradient, true, 1, input0Gradient, k, m, n);
+            else
+                Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, outputGradient, false, BatchedInput1For(/*gradient=*/false, fr), true, 1, input0Gradient, m, k, n);
+        }
+        else // dB_j += op(A_j)^T dC_j
+        {
+            if (!Input(1)->HasMBLayout()) // the gradient of a shared B is a sum over all columns, which a batched GEMM cannot write
+                return false;
+            auto input1Gradient = Input(1)->GradientFor(fr);
+            Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(1, Input(0)->ValueFor(fr), !m_transpose, outputGradient, false, 1, input1Gradient, k, n, m);
+        }
+        return true;
+    }
+
 public:
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         // If argument A is minibatch data, then this must be performed frame-by-frame, sequence-by-sequence, one GEMM call each.
-        // This will be inefficient. We hope this will be the baseline of a future, more efficient TensorView-based implementation.
+        // This is done as one batched GEMM where possible, else one GEMM call per time and sequence, which is inefficient.
         if (!fr.IsOneColumnWrt(Input(0)->GetMBLayout()))
         {
+            if (TryForwardPropBatched(fr))
+                return;
+
             // recursively call ourselves for each individual time and sequence
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
@@ -300,6 +452,11 @@ public:
             return;
         }
 
+        if (Environment().m_isCalibratingInt8)
+            RecordInt8InputRange(fr);
+        if (TryForwardPropInt8(fr) || TryForwardPropQuantized(fr))
+            return;
+
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D, but only allowed if the input sample is 2D anyway.
@@ -314,6 +471,9 @@ public:
         // special treatment if A is minibatch data; see Forward() for comment
         if (!fr.IsOneColumnWrt(Input(0)->GetMBLayout()))
         {
+            if (TryBackpropToBatched(inputIndex, fr))
+                return;
+
             auto timeRange     = fr.GetTimeRange();
             auto sequenceRange = fr.GetSequenceRange();
             for (auto t = timeRange.first; t < timeRange.second; t++) // step left to right to allow to build a sparse matrix
@@ -476,8 +636,21 @@ public:
 
     size_t OutputRank() const { return m_outputRank; }
 
+    // the range of the data input for int8 inference, 0 if it has not been calibrated
+    ElemType Int8InputRange() const { return m_int8InputRange; }
+    void SetInt8InputRange(ElemType range) { m_int8InputRange = range; }
+
 private:
     size_t m_outputRank;
+
+    // quantized inference, see TryForwardPropQuantized()
+    shared_ptr<QuantizedMultiplier<ElemType>> m_quantizedMultiplier;
+    int64_t m_quantizedWeightTimeStamp; // eval time stamp of the weights when they were quantized
+
+    // int8 inference, see TryForwardPropInt8()
+    ElemType m_int8InputRange;
+    shared_ptr<Int8Multiplier<ElemType>> m_int8Multiplier;
+    int64_t m_int8WeightTimeStamp;
 };
 
 // -----------------------------------------------------------------------
@@ -573,16 +746,13 @@ public:
         {
             Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(fr); // use Masked- version since this is reducing over frames
             Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(fr);
-            m_innerproduct->AssignInnerProductOf(sliceOutputGrad, sliceInput1Value, false);
-            Input(0)->GradientAsMatrix() += *m_innerproduct;
+            Input(0)->GradientAsMatrix().AddRowInnerProductOf(sliceOutputGrad, sliceInput1Value);
         }
         else // right derivative
         {
             Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
             Matrix<ElemType> sliceInput1Grad = Input(1)->GradientFor(fr);
-            m_rightGradient->SetValue(sliceOutputGrad);
-            m_rightGradient->ColumnElementMultiplyWith(Input(0)->ValueAsMatrix());
-            sliceInput1Grad += *m_rightGradient;
+            sliceInput1Grad.AddDiagTimesOf(Input(0)->ValueAsMatrix(), sliceOutputGrad);
         }
     }
 
@@ -598,8 +768,7 @@ public:
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
 
-        sliceOutputValue.AssignValuesOf(sliceInput1Value);
-        sliceOutputValue.ColumnElementMultiplyWith(Input(0)->ValueAsMatrix());
+        sliceOutputValue.AssignDiagTimesOf(Input(0)->ValueAsMatrix(), sliceInput1Value);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -638,36 +807,6 @@ public:
 
         SetDims(Input(1));
     }
-
-    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
-    {
-        Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
-        {
-            auto node = dynamic_pointer_cast<DiagTimesNode<ElemType>>(nodeP);
-            node->m_innerproduct->SetValue(*m_innerproduct);
-            node->m_rightGradient->SetValue(*m_rightGradient);
-        }
-    }
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_innerproduct, matrixPool);
-        RequestMatrixFromPool(m_rightGradient, matrixPool);
-    }
-
-    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
-    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
-    {
-        Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_innerproduct, matrixPool);
-        ReleaseMatrixToPool(m_rightGradient, matrixPool);
-    }
-
-private:
-    shared_ptr<Matrix<ElemType>> m_innerproduct;
-    shared_ptr<Matrix<ElemType>> m_rightGradient;
 };
 
 template class DiagTimesNode<float>;
@@ -990,10 +1129,12 @@ class KhatriRaoProductNode : public ComputationNode<ElemType>, public NumInputs<
 public:
     DeclareConstructorFromConfigWithNumInputs(KhatriRaoProductNode);
     KhatriRaoProductNode(DEVICEID_TYPE deviceId, const wstring& name)
-        : Base(deviceId, name)
+        : Base(deviceId, name), m_input1GradientDone(false)
     {
     }
 
+    // When both inputs need a gradient, the left derivative computes the right one as well, in one pass over the output gradient.
+    // Backprop() calls BackpropTo(1) right after BackpropTo(0) when both inputs are in the same loop (or both outside of it).
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
@@ -1003,7 +1144,21 @@ public:
             Matrix<ElemType> sliceInput0Grad = Input(0)->GradientFor(fr);
             Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
 
-            sliceInput0Grad.AddColumnReshapeProductOf(sliceOutputGrad, sliceInput1Value, false);
+            m_input1GradientDone = Input(1)->NeedsGradient() && Input(1)->IsPartOfLoop() == Input(0)->IsPartOfLoop() && Input(1) != Input(0) &&
+                                   sliceInput1Value.GetMatrixType() == DENSE && Input(0)->Value().GetMatrixType() == DENSE;
+            if (m_input1GradientDone)
+            {
+                Input(1)->LazyZeroGradient();
+                Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
+                Matrix<ElemType> sliceInput1Grad = Input(1)->GradientFor(fr);
+                Matrix<ElemType>::AddKhatriRaoProductGradient(sliceOutputGrad, sliceInput0Value, sliceInput1Value, sliceInput0Grad, sliceInput1Grad);
+            }
+            else
+                sliceInput0Grad.AddColumnReshapeProductOf(sliceOutputGrad, sliceInput1Value, false);
+        }
+        else if (m_input1GradientDone) // right derivative, already added above
+        {
+            m_input1GradientDone = false;
         }
         else // right derivative
         {
@@ -1038,6 +1193,9 @@ public:
         // TODO: ^^ Is that correct? Should we use a tensor here, TensorShape(rows0, rows1)?
         SetDims(TensorShape(rows0 * rows1), HasMBLayout());
     }
+
+private:
+    bool m_input1GradientDone; // BackpropTo(0) has already added the gradient of input 1 for this frame range
 };
 
 template class KhatriRaoProductNode<float>;
@@ -1070,149 +1228,34 @@ public:
     {
     }
 
+    // The gradients of inputs 0 and 1 are computed directly from the similarities and the inverse norms of the forward pass,
+    // each column of an input's gradient in one pass over the similarities it takes part in.
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        if (inputIndex > 1)
+            return; // shift and #neg are constants
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         Matrix<ElemType> sliceInputGrad = Input(inputIndex)->GradientFor(fr);
         Matrix<ElemType> sliceThisGrad = GradientFor(fr);
+        size_t shift = (size_t) Input(2)->Get00Element();
 
-        BackpropToS(inputIndex, *m_invNorm0, *m_invNorm1, sliceOutputValue, *m_temp, *m_rightTerm, *m_leftTerm, *m_invNormSquare, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), sliceInputGrad, sliceThisGrad);
-    }
-
-    // functionValues, invNorm0, invNorm1 - output from the EvaluateNode() method
-    // temp, rightTerm, leftTerm - temporary matrices
-    // in0, in1, in2, in3 - input functionValues from other nodes
-    // inputGradientValues(x) - gradients to update, where x matches inputIndex
-    /*TODO: merge with call site*/ void BackpropToS(const size_t inputIndex, const Matrix<ElemType>& invNorm0, const Matrix<ElemType>& invNorm1, const Matrix<ElemType>& functionValues,
-                                                    Matrix<ElemType>& temp, Matrix<ElemType>& rightTerm, Matrix<ElemType>& leftTerm, Matrix<ElemType>& invNormSquare, // the temporary variables
-                                                    const Matrix<ElemType>& in0, const Matrix<ElemType>& in1, const Matrix<ElemType>& in2, const Matrix<ElemType>& in3,
-                                                    Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& thisGradientValues)
-    {
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-        size_t numCols = in0.GetNumCols(); // used in computing right child's graident
-
-        if (inputIndex == 0) // left derivative
-        {
-            invNormSquare.AssignElementProductOf(invNorm0, invNorm0);
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-                temp.ElementMultiplyWith(invNormSquare);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, rightTerm, 0, true);
-
-                if (m == 0)
-                {
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, 0, true);
-                }
-                else
-                {
-                    size_t currshift = m + shift - 1; // for current line, how much should we shift
-
-                    temp.AssignElementProductOfWithShift(invNorm0, invNorm1, currshift); // this is a row vector
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, leftTerm, currshift, true);
-                }
-
-                leftTerm -= rightTerm;
-
-                temp.GetARowByIndex(thisGradientValues, m);
-
-                Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                inputGradientValues += rightTerm;
-            }
-        }
-        else // right part
-        {
-            invNormSquare.AssignElementProductOf(invNorm1, invNorm1); // this matrix should be save and unchanged. It should not be changed
-
-            for (long m = 0; m < negNumber + 1; m++)
-            {
-                temp.GetARowByIndex(functionValues, m); // set this matrx to be the m-th row in functionValues
-
-                if (m == 0) // this is the first line. computation should be symmetric
-                {
-                    // the following is for the right part
-                    temp.ElementMultiplyWith(invNormSquare);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in1, rightTerm, 0, true);
-
-                    // the following is for the left part
-                    temp.AssignElementProductOf(invNorm0, invNorm1);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, 0, true);
-
-                    leftTerm -= rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, 0, true);
-
-                    inputGradientValues += rightTerm;
-                }
-                else // this requires shift
-                {
-                    size_t currshift = (m + shift - 1) % numCols;
-                    size_t reverseshift = numCols - currshift;
-
-                    leftTerm.AssignElementProductOfWithShift(invNormSquare, temp, reverseshift); // use leftTerm as a temp variable here
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(leftTerm, in1, rightTerm, 0, true);
-
-                    temp.AssignElementProductOfWithShift(invNorm1, invNorm0, reverseshift);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, in0, leftTerm, reverseshift, true);
-
-                    leftTerm -= rightTerm;
-
-                    temp.GetARowByIndex(thisGradientValues, m);
-
-                    Matrix<ElemType>::ConductRowElementMultiplyWithShift(temp, leftTerm, rightTerm, reverseshift, false);
-
-                    inputGradientValues += rightTerm;
-                }
-            }
-        }
+        Matrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(inputIndex, sliceInput0Value, sliceInput1Value, *m_invNorm0, *m_invNorm1,
+                                                                    sliceOutputValue, sliceThisGrad, shift, sliceInputGrad);
     }
 
+    // The similarities of each column with its positive and its negative samples are computed in one pass, with the norms
+    // of the columns computed once, rather than with full-size temporaries of the shifted products.
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Value = Input(0)->ValueFor(fr);
         Matrix<ElemType> sliceInput1Value = Input(1)->ValueFor(fr);
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
+        size_t shift = (size_t) Input(2)->Get00Element();
+        size_t negNumber = (size_t) Input(3)->Get00Element();
 
-        ForwardPropS(*m_invNorm0, *m_invNorm1, sliceOutputValue, sliceInput0Value, sliceInput1Value, Input(2)->Value(), Input(3)->Value(), *m_leftTerm, *m_rightTerm);
-    }
-
-    /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& invNorm0, Matrix<ElemType>& invNorm1, Matrix<ElemType>& functionValues, Matrix<ElemType>& in0, Matrix<ElemType>& in1, Matrix<ElemType>& in2, Matrix<ElemType>& in3, Matrix<ElemType>& leftTermTemp, Matrix<ElemType>& rightTermTemp)
-    {
-        invNorm0.AssignVectorNorm2Of(in0, true); // seems to modify input (in0)
-        invNorm0.AssignElementInverseOf(invNorm0);
-
-        invNorm1.AssignVectorNorm2Of(in1, true); // seems to modify the input (in1)
-        invNorm1.AssignElementInverseOf(invNorm1);
-
-        size_t shift = (size_t) in2.Get00Element();
-        size_t negNumber = (size_t) in3.Get00Element();
-
-        // mutiply invNorm0 and invNorm1 with shift and neg.
-        // The result is a matrix of (numberneg+1, invNorm0.Cols)
-        leftTermTemp.AssignElementProductOfWithShiftNeg(invNorm0, invNorm1, shift, negNumber);
-
-        // compute the right values
-        // Again, the output is a matrix of (negNumber+1, invNorm0.cols)
-        rightTermTemp.AssignInnerProductOfWithShiftNeg(in0, in1, true, shift, negNumber);
-
-        // compute the evaluation result matrix by multiply these two matrices, element by element
-        // we get a (negNumber+1, n) matrix
-        functionValues.AssignElementProductOf(leftTermTemp, rightTermTemp);
+        sliceOutputValue.AssignCosDistanceWithNegativeSamplesOf(sliceInput0Value, sliceInput1Value, shift, negNumber, *m_invNorm0, *m_invNorm1);
     }
 
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
@@ -1243,10 +1286,6 @@ public:
             auto node = dynamic_pointer_cast<CosDistanceWithNegativeSamplesNode<ElemType>>(nodeP);
             node->m_invNorm0->SetValue(*m_invNorm0);
             node->m_invNorm1->SetValue(*m_invNorm1);
-            node->m_invNormSquare->SetValue(*m_invNormSquare);
-            node->m_leftTerm->SetValue(*m_leftTerm);
-            node->m_rightTerm->SetValue(*m_rightTerm);
-            node->m_temp->SetValue(*m_temp);
         }
     }
     // request matrices needed to do node function value evaluation
@@ -1255,16 +1294,6 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_invNorm0, matrixPool);
         RequestMatrixFromPool(m_invNorm1, matrixPool);
-        RequestMatrixFromPool(m_leftTerm, matrixPool);
-        RequestMatrixFromPool(m_rightTerm, matrixPool);
-    }
-
-    // request matrices that are needed for gradient computation
-    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeBackprop(matrixPool);
-        RequestMatrixFromPool(m_invNormSquare, matrixPool);
-        RequestMatrixFromPool(m_temp, matrixPool);
     }
 
     // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
@@ -1273,21 +1302,12 @@ public:
         Base::ReleaseMatricesAfterBackprop(matrixPool);
         ReleaseMatrixToPool(m_invNorm0, matrixPool);
         ReleaseMatrixToPool(m_invNorm1, matrixPool);
-        ReleaseMatrixToPool(m_leftTerm, matrixPool);
-        ReleaseMatrixToPool(m_rightTerm, matrixPool);
-        ReleaseMatrixToPool(m_invNormSquare, matrixPool);
-        ReleaseMatrixToPool(m_temp, matrixPool);
     }
 
 private:
     // invNorm nodes tranfer data between ForwardProp and BackpropTo
     shared_ptr<Matrix<ElemType>> m_invNorm0;
     shared_ptr<Matrix<ElemType>> m_invNorm1;
-    shared_ptr<Matrix<ElemType>> m_leftTerm;
-    shared_ptr<Matrix<ElemType>> m_rightTerm;
-    // the rest are temporaries, values don't need to be maintained
-    shared_ptr<Matrix<ElemType>> m_invNormSquare;
-    shared_ptr<Matrix<ElemType>> m_temp;
 };
 
 template class CosDistanceWithNegativeSamplesNode<float>;
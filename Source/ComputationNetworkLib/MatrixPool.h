@@ -9,6 +9,7 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <map>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -17,60 +18,177 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// MemorySharingPolicy -- which matrices of a network may share memory through its MatrixPool
+enum class MemorySharingPolicy
+{
+    None,         // nothing is shared (e.g. for debugging, to be able to inspect all values and gradients)
+    ForwardOnly,  // node values are shared as soon as they are no longer needed; gradients are not shared
+    Conservative, // values and gradients are shared, but a value is returned to the pool only after backprop (shareNodeValueMatrices=false)
+    Full,         // values and gradients are shared as soon as they are no longer needed (shareNodeValueMatrices=true)
+    Aggressive    // like Full, but values of nodes that depend on parameters only are shared as well, and recomputed for every minibatch
+};
+
+static inline MemorySharingPolicy ParseMemorySharingPolicy(const std::wstring& s)
+{
+    if      (s == L"none")         return MemorySharingPolicy::None;
+    else if (s == L"forwardOnly")  return MemorySharingPolicy::ForwardOnly;
+    else if (s == L"conservative") return MemorySharingPolicy::Conservative;
+    else if (s == L"full")         return MemorySharingPolicy::Full;
+    else if (s == L"aggressive")   return MemorySharingPolicy::Aggressive;
+    else InvalidArgument("memorySharingPolicy: Invalid value '%ls'. Must be 'none', 'forwardOnly', 'conservative', 'full', or 'aggressive'.", s.c_str());
+}
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
-// Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
+// What is shared is determined by the MemorySharingPolicy (use MemorySharingPolicy::None to disable memory sharing altogether, for debugging).
+//
+// ComputationNetwork::AllocateAllMatrices() simulates the forward and backward passes, calling Request() when a matrix
+// becomes live and Release() when it dies; so the sequence of calls describes the lifetime interval of every matrix.
+// Each request comes with an estimate of its size (elements per column for minibatch data, total elements otherwise).
+// Free matrices are assigned greedily in execution order by best fit: the smallest released matrix that is large
+// enough; or, if none is, the largest one (which then needs to grow the least). This keeps small matrices (e.g. bias
+// gradients) from being handed buffers that later get grown to the size of the largest activation.
+// The pool also tracks the estimated total size with and without sharing, for PrintPlanStatistics().
 class MatrixPool
 {
-    vector<shared_ptr<Matrix<float>>>  m_releasedFloatMatrices;
-    vector<shared_ptr<Matrix<double>>> m_releasedDoubleMatrices;
+    // a released matrix, together with the largest size estimate of all requests it has been assigned to so far
+    template <class ElemType>
+    struct ReleasedMatrix
+    {
+        shared_ptr<Matrix<ElemType>> matrix;
+        size_t plannedSize;
+    };
+
+    vector<ReleasedMatrix<float>>  m_releasedFloatMatrices;
+    vector<ReleasedMatrix<double>> m_releasedDoubleMatrices;
 
     template <class ElemType>
-    vector<shared_ptr<Matrix<ElemType>>>& GetReleasedMatrices();
+    vector<ReleasedMatrix<ElemType>>& GetReleasedMatrices();
+
+    // workspaces shared by all nodes, per device, see RequestWorkspace()
+    std::map<DEVICEID_TYPE, shared_ptr<Matrix<float>>>  m_floatWorkspaces;
+    std::map<DEVICEID_TYPE, shared_ptr<Matrix<double>>> m_doubleWorkspaces;
+
+    template <class ElemType>
+    std::map<DEVICEID_TYPE, shared_ptr<Matrix<ElemType>>>& GetWorkspaces();
+
+    // planned size of every matrix handed out by this pool
+    std::map<const MatrixBase*, size_t> m_plannedSizes;
+    size_t m_numRequests = 0;
+    size_t m_totalRequestedSize = 0; // sum of all size estimates, i.e. the footprint without any sharing
+
+    MemorySharingPolicy m_policy = MemorySharingPolicy::Full;
 
 public:
+    void SetPolicy(MemorySharingPolicy policy) { m_policy = policy; }
+    MemorySharingPolicy GetPolicy() const { return m_policy; }
+
+    // may a node value be released right after its last use in forward prop (if it is not needed in backprop)?
+    bool SharesValuesDuringForwardProp() const
+    {
+        return m_policy == MemorySharingPolicy::ForwardOnly || m_policy == MemorySharingPolicy::Full || m_policy == MemorySharingPolicy::Aggressive;
+    }
+    bool SharesGradients() const { return m_policy != MemorySharingPolicy::None && m_policy != MemorySharingPolicy::ForwardOnly; }
+    bool RecomputesParameterOnlyValues() const { return m_policy == MemorySharingPolicy::Aggressive; }
+
     // release here means the matrix can be put back and shared by others
     template <class ElemType>
     void Release(shared_ptr<Matrix<ElemType>> freeMatrix)
     {
         if (freeMatrix == nullptr || freeMatrix->GetMatrixType() == SPARSE)
             LogicError("MatrixPool::Release: freeMatrix should not be null or sparse.");
-//#define SUPRESS_MEMSHARING // #define this to disable memory sharing through this structure
-        // TODO: Make this a runtime option.
-#ifndef SUPRESS_MEMSHARING
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        if (m_policy == MemorySharingPolicy::None) // not sharing: the matrix stays owned by its node alone
+            return;
+
+        vector<ReleasedMatrix<ElemType>>& releasedMatrices = GetReleasedMatrices<ElemType>();
 #ifdef _DEBUG
         for (int i = 0; i < releasedMatrices.size(); i++)
         {
-            if (releasedMatrices[i] == freeMatrix)
+            if (releasedMatrices[i].matrix == freeMatrix)
                 RuntimeError("MatrixPool::Release: freeMatrix is already in the released pool.");
         }
 
 #endif
-        releasedMatrices.push_back(freeMatrix);
-#endif
+        auto plannedSize = m_plannedSizes.find(freeMatrix.get());
+        releasedMatrices.push_back(ReleasedMatrix<ElemType>{ freeMatrix, plannedSize != m_plannedSizes.end() ? plannedSize->second : 0 });
     }
 
+    // 'size' is the estimated size of the requested matrix; 0 if unknown, in which case the most recently released matrix is returned
     template <class ElemType>
-    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId)
+    shared_ptr<Matrix<ElemType>> Request(DEVICEID_TYPE deviceId, size_t size = 0)
     {
-        vector<shared_ptr<Matrix<ElemType>>>& releasedMatrices = GetReleasedMatrices<ElemType>();
+        vector<ReleasedMatrix<ElemType>>& releasedMatrices = GetReleasedMatrices<ElemType>();
         shared_ptr<Matrix<ElemType>> matrixPtr;
-        if (releasedMatrices.empty())
+        size_t plannedSize = size;
+        auto bestFit = FindBestFit(releasedMatrices, deviceId, size);
+        if (bestFit == releasedMatrices.end())
         {
             matrixPtr = make_shared<Matrix<ElemType>>(deviceId);
         }
         else
         {
-            matrixPtr = releasedMatrices.back();
-            releasedMatrices.pop_back();
+            matrixPtr = bestFit->matrix;
+            plannedSize = max(plannedSize, bestFit->plannedSize);
+            releasedMatrices.erase(bestFit);
         }
 
         if (!matrixPtr) // this can't really happen
             LogicError("MatrixPool::Request: failed to get a valid matrix.");
 
+        m_plannedSizes[matrixPtr.get()] = plannedSize;
+        m_numRequests++;
+        m_totalRequestedSize += size;
+
         return matrixPtr;
     }
+
+    // Scratch memory whose content is used only within a single ForwardProp() or BackpropTo() call of a node (e.g. the
+    // workspace of a convolution engine). Since nodes execute one after the other on one stream, the same matrix is
+    // handed to all of them; it grows to the size that the most demanding one needs. It is never released.
+    // Returns a new matrix if nothing is shared.
+    template <class ElemType>
+    shared_ptr<Matrix<ElemType>> RequestWorkspace(DEVICEID_TYPE deviceId)
+    {
+        if (m_policy == MemorySharingPolicy::None)
+            return make_shared<Matrix<ElemType>>(deviceId);
+        auto& workspace = GetWorkspaces<ElemType>()[deviceId];
+        if (!workspace)
+            workspace = make_shared<Matrix<ElemType>>(deviceId);
+        return workspace;
+    }
+
+    // log how much sharing saves according to the size estimates passed to Request()
+    void PrintPlanStatistics() const
+    {
+        size_t totalPlannedSize = 0;
+        for (const auto& plannedSize : m_plannedSizes)
+            totalPlannedSize += plannedSize.second;
+        fprintf(stderr, "\nMemory sharing: %d matrices requested from the pool, assigned to %d distinct matrices. Estimated size %.1f%% of unshared (%llu vs. %llu elements, counting columns of minibatch data as one).\n",
+                (int) m_numRequests, (int) m_plannedSizes.size(), m_totalRequestedSize ? 100.0 * totalPlannedSize / m_totalRequestedSize : 100.0,
+                (unsigned long long) totalPlannedSize, (unsigned long long) m_totalRequestedSize);
+    }
+
+private:
+    // Only matrices on 'deviceId' are candidates (the nodes of a network may live on different devices, see
+    // ComputationNetwork::PlaceInPipelineStages()). Returns end() if there is none.
+    template <class ElemType>
+    static typename vector<ReleasedMatrix<ElemType>>::iterator FindBestFit(vector<ReleasedMatrix<ElemType>>& releasedMatrices, DEVICEID_TYPE deviceId, size_t size)
+    {
+        auto bestFit = releasedMatrices.end(); // smallest one with plannedSize >= size
+        auto largest = releasedMatrices.end(); // fallback if none is large enough
+        for (auto iter = releasedMatrices.begin(); iter != releasedMatrices.end(); iter++)
+        {
+            if (iter->matrix->GetDeviceId() != deviceId)
+                continue;
+            if (size == 0) // no size information: LIFO, i.e. the last one on this device
+                bestFit = iter;
+            else if (iter->plannedSize >= size && (bestFit == releasedMatrices.end() || iter->plannedSize < bestFit->plannedSize))
+                bestFit = iter;
+            if (largest == releasedMatrices.end() || iter->plannedSize > largest->plannedSize)
+                largest = iter;
+        }
+        return bestFit != releasedMatrices.end() ? bestFit : largest;
+    }
 };
 
 }}}
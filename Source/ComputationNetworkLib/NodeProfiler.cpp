@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <algorithm>
+#include "NodeProfiler.h"
+#include "CuDnnFactories.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static const double c_bytesPerMB = 1024.0 * 1024.0;
+
+template <class ElemType>
+static bool AddMatrixBytes(const MatrixBasePtr& matrixBase, size_t& bytes)
+{
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(matrixBase);
+    if (!matrix)
+        return false;
+    if (matrix->GetMatrixType() != SPARSE) // the number of non-zeros is not known without reading it from the device
+        bytes += matrix->GetNumElements() * sizeof(ElemType);
+    return true;
+}
+
+// bytes of the dense value and gradient of a node, or of all nodes of a recurrent loop
+static void GetMatrixBytes(const ComputationNodeBasePtr& node, size_t& valueBytes, size_t& gradientBytes)
+{
+    if (auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(node))
+    {
+        for (const auto& nestedNode : flowControlNode->m_nestedNodes)
+            GetMatrixBytes(nestedNode, valueBytes, gradientBytes);
+    }
+    else if (auto floatNode = dynamic_pointer_cast<ComputationNode<float>>(node))
+    {
+        AddMatrixBytes<float>(floatNode->ValuePtr(), valueBytes);
+        AddMatrixBytes<float>(floatNode->GradientPtr(), gradientBytes);
+    }
+    else if (auto doubleNode = dynamic_pointer_cast<ComputationNode<double>>(node))
+    {
+        AddMatrixBytes<double>(doubleNode->ValuePtr(), valueBytes);
+        AddMatrixBytes<double>(doubleNode->GradientPtr(), gradientBytes);
+    }
+}
+
+static string JsonString(const wstring& s)
+{
+    string result = "\"";
+    for (char c : msra::strfun::utf8(s))
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char) c < 0x20)
+            result += ' ';
+        else
+            result += c;
+    }
+    return result + "\"";
+}
+
+NodeProfiler::NodeProfiler(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId), m_numAllocationsAtStart(0), m_bytesInUseAtStart(0)
+{
+    if (m_deviceId >= 0)
+        m_cudaTimer.reset(new CudaTimer());
+    Reset();
+}
+
+NodeProfiler::~NodeProfiler()
+{
+}
+
+void NodeProfiler::Reset()
+{
+    m_nodes.clear();
+    m_nodeIndices.clear();
+    m_trace.clear();
+    m_origin = chrono::high_resolution_clock::now();
+}
+
+void NodeProfiler::Begin()
+{
+    if (m_cudaTimer)
+    {
+        auto statistics = TracingGPUMemoryAllocator::GetStatistics(m_deviceId);
+        m_numAllocationsAtStart = statistics.numAllocations;
+        m_bytesInUseAtStart = statistics.bytesInUse;
+        m_cudaTimer->Start();
+    }
+    m_start = chrono::high_resolution_clock::now();
+}
+
+void NodeProfiler::End(const ComputationNodeBasePtr& node, Pass pass)
+{
+    double deviceMilliseconds = 0;
+    if (m_cudaTimer)
+    {
+        m_cudaTimer->Stop(); // waits for the node's kernels
+        deviceMilliseconds = m_cudaTimer->Elapsed();
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    auto nodeIndex = m_nodeIndices.find(node);
+    if (nodeIndex == m_nodeIndices.end())
+    {
+        nodeIndex = m_nodeIndices.insert(make_pair(node, m_nodes.size())).first;
+        m_nodes.push_back(NodeStatistics());
+        m_nodes.back().m_name = node->NodeName();
+        m_nodes.back().m_operation = node->OperationName();
+    }
+    auto& statistics = m_nodes[nodeIndex->second];
+
+    size_t p = (size_t) pass;
+    statistics.m_numCalls[p]++;
+    statistics.m_wallMilliseconds[p] += chrono::duration<double, milli>(end - m_start).count();
+    statistics.m_deviceMilliseconds[p] += deviceMilliseconds;
+
+    size_t valueBytes = 0, gradientBytes = 0;
+    GetMatrixBytes(node, valueBytes, gradientBytes);
+    statistics.m_valueBytes = max(statistics.m_valueBytes, valueBytes);
+    statistics.m_gradientBytes = max(statistics.m_gradientBytes, gradientBytes);
+
+    if (m_cudaTimer)
+    {
+        auto allocatorStatistics = TracingGPUMemoryAllocator::GetStatistics(m_deviceId);
+        statistics.m_numAllocations += allocatorStatistics.numAllocations - m_numAllocationsAtStart;
+        if (allocatorStatistics.bytesInUse > m_bytesInUseAtStart)
+            statistics.m_allocatedBytes += allocatorStatistics.bytesInUse - m_bytesInUseAtStart;
+    }
+
+    if (m_trace.size() < s_maxTraceEvents)
+    {
+        TraceEvent event;
+        event.m_node = nodeIndex->second;
+        event.m_pass = pass;
+        event.m_startMicroseconds = chrono::duration<double, micro>(m_start - m_origin).count();
+        event.m_durationMicroseconds = chrono::duration<double, micro>(end - m_start).count();
+        m_trace.push_back(event);
+    }
+}
+
+void NodeProfiler::Print(size_t maxNodes) const
+{
+    vector<const NodeStatistics*> nodes;
+    double totalMilliseconds = 0;
+    for (const auto& statistics : m_nodes)
+    {
+        nodes.push_back(&statistics);
+        totalMilliseconds += statistics.TotalMilliseconds();
+    }
+    sort(nodes.begin(), nodes.end(), [](const NodeStatistics* a, const NodeStatistics* b) { return a->TotalMilliseconds() > b->TotalMilliseconds(); });
+    if (maxNodes > 0 && nodes.size() > maxNodes)
+        nodes.resize(maxNodes);
+
+    fprintf(stderr, "\nNode profile: %d nodes, %.3f ms in total (forward and backward wall time, per call; device time on GPU).\n", (int) m_nodes.size(), totalMilliseconds);
+    fprintf(stderr, "%6s %10s %10s %10s %10s %10s %10s %10s %8s %10s  %s\n",
+            "%", "total ms", "fwd calls", "fwd ms", "fwd dev ms", "bwd calls", "bwd ms", "bwd dev ms", "allocs", "value MB", "node");
+    for (const auto* statistics : nodes)
+    {
+        let& s = *statistics;
+        fprintf(stderr, "%6.2f %10.3f %10d %10.4f %10.4f %10d %10.4f %10.4f %8d %10.2f  %ls %ls operation\n",
+                totalMilliseconds > 0 ? 100 * s.TotalMilliseconds() / totalMilliseconds : 0.0, s.TotalMilliseconds(),
+                (int) s.m_numCalls[0], s.m_numCalls[0] ? s.m_wallMilliseconds[0] / s.m_numCalls[0] : 0.0, s.m_numCalls[0] ? s.m_deviceMilliseconds[0] / s.m_numCalls[0] : 0.0,
+                (int) s.m_numCalls[1], s.m_numCalls[1] ? s.m_wallMilliseconds[1] / s.m_numCalls[1] : 0.0, s.m_numCalls[1] ? s.m_deviceMilliseconds[1] / s.m_numCalls[1] : 0.0,
+                (int) s.m_numAllocations, (s.m_valueBytes + s.m_gradientBytes) / c_bytesPerMB, s.m_name.c_str(), s.m_operation.c_str());
+    }
+    fprintf(stderr, "\n");
+}
+
+void NodeProfiler::WriteChromeTrace(const wstring& path) const
+{
+    FILE* f = fopenOrDie(path, L"w");
+    fprintfOrDie(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < m_trace.size(); i++)
+    {
+        let& event = m_trace[i];
+        let& node = m_nodes[event.m_node];
+        fprintfOrDie(f, "%s{\"name\":%s,\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0,"
+                        "\"args\":{\"operation\":%s,\"valueMB\":%.3f,\"gradientMB\":%.3f,\"allocations\":%d,\"allocatedMB\":%.3f}}\n",
+                     i > 0 ? "," : "", JsonString(node.m_name).c_str(), event.m_pass == Pass::Forward ? "forward" : "backward",
+                     event.m_startMicroseconds, event.m_durationMicroseconds, JsonString(node.m_operation).c_str(),
+                     node.m_valueBytes / c_bytesPerMB, node.m_gradientBytes / c_bytesPerMB, (int) node.m_numAllocations, node.m_allocatedBytes / c_bytesPerMB);
+    }
+    fprintfOrDie(f, "]}\n");
+    fcloseOrDie(f);
+    fprintf(stderr, "Node profile: Wrote %d calls as a Chrome trace to '%ls'.\n", (int) m_trace.size(), path.c_str());
+}
+
+}}}
@@ -0,0 +1,95 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// NodeProfiler.h -- per-node time and memory profile of ComputationNetwork::ForwardProp() and Backprop().
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CudaTimer;
+
+class NodeProfiler;
+typedef std::shared_ptr<NodeProfiler> NodeProfilerPtr;
+
+// Records, for each top-level node of the networks' execution plans (a recurrent loop counts as one node), the wall time
+// of its ForwardProp() and Backprop(), on a GPU also the device time between CUDA events around it, the size of its
+// value and gradient, and the device allocations made while it ran (caching GPU allocator only, see
+// TracingGPUMemoryAllocator::GetStatistics()). Each node's device work is waited for after it, so that it is
+// attributed to the right node; a profiled pass is therefore slower than a normal one.
+//
+// Results are a table sorted by total time, see Print(), and a trace for chrome://tracing, see WriteChromeTrace().
+class NodeProfiler
+{
+public:
+    enum class Pass
+    {
+        Forward,
+        Backward
+    };
+
+    explicit NodeProfiler(DEVICEID_TYPE deviceId);
+    ~NodeProfiler();
+
+    // brackets one call of a node
+    void Begin();
+    void End(const ComputationNodeBasePtr& node, Pass pass);
+
+    // prints the nodes with the highest total time (all if maxNodes is 0) to stderr
+    void Print(size_t maxNodes = 0) const;
+
+    // writes all recorded calls as a Chrome trace (JSON trace event format)
+    void WriteChromeTrace(const std::wstring& path) const;
+
+    void Reset();
+
+    DISABLE_COPY_AND_MOVE(NodeProfiler);
+
+private:
+    struct NodeStatistics
+    {
+        std::wstring m_name;
+        std::wstring m_operation;
+        size_t m_numCalls[2] = { 0, 0 };         // [pass]
+        double m_wallMilliseconds[2] = { 0, 0 };  // [pass]
+        double m_deviceMilliseconds[2] = { 0, 0 }; // [pass], GPU only
+        size_t m_valueBytes = 0;                 // largest seen
+        size_t m_gradientBytes = 0;              // largest seen
+        size_t m_numAllocations = 0;
+        size_t m_allocatedBytes = 0;             // growth of the bytes in use, summed over calls
+
+        double TotalMilliseconds() const { return m_wallMilliseconds[0] + m_wallMilliseconds[1]; }
+    };
+
+    struct TraceEvent
+    {
+        size_t m_node;        // index into m_nodes
+        Pass m_pass;
+        double m_startMicroseconds; // since construction or Reset()
+        double m_durationMicroseconds;
+    };
+
+    static const size_t s_maxTraceEvents = 1000000; // later calls are still counted in the table
+
+    DEVICEID_TYPE m_deviceId;
+    std::chrono::high_resolution_clock::time_point m_origin;
+    std::chrono::high_resolution_clock::time_point m_start; // of the current call
+    size_t m_numAllocationsAtStart;
+    size_t m_bytesInUseAtStart;
+    std::unique_ptr<CudaTimer> m_cudaTimer; // GPU only
+
+    std::vector<NodeStatistics> m_nodes;
+    std::map<ComputationNodeBasePtr, size_t> m_nodeIndices;
+    std::vector<TraceEvent> m_trace;
+};
+
+}}}
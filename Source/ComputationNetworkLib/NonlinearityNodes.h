@@ -49,12 +49,22 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (Input(0)->IsFusedIntoConsumer())
+            return ForwardPropOfSum(fr);
+
         size_t rank = DetermineElementwiseTensorRank();
         auto result =           ValueTensorFor(rank, fr);
         auto input  = Input(0)->ValueTensorFor(rank, fr);
         result.DoUnaryOpOf(0, input, 1, opForward, opSum);
     }
 
+    virtual void /*ComputationNode::*/ Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override
+    {
+        if (Input(0)->IsFusedIntoConsumer())
+            return BackpropOfSum(fr);
+        Base::Backprop(fr, childrenInThisLoop, childrenInOuterLoop);
+    }
+
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         assert(inputIndex == 0), inputIndex;
@@ -93,6 +103,66 @@ public:
     {
         return opType == binaryWithOutputGradient;
     }
+
+private:
+    // fused evaluation: our input is a PlusNode that is not evaluated itself, see ComputationNetwork::FuseElementwiseNodes()
+    // We compute op(a + b) directly from its summands, and propagate the gradient directly to them. Only ops whose
+    // gradient is computed from the output qualify, since the sum is never materialized.
+    ElementWiseOperator OpOfSum() const
+    {
+        switch (opForward)
+        {
+        case opSigmoid:         return opSigmoidOfSum;
+        case opTanh:            return opTanhOfSum;
+        case opLinearRectifier: return opLinearRectifierOfSum;
+        default:                LogicError("%ls cannot be fused with its input.", NodeDescription().c_str());
+        }
+    }
+
+    ComputationNodePtr Summand(size_t i) const
+    {
+        return dynamic_pointer_cast<ComputationNode<ElemType>>(Input(0)->GetInputs()[i]);
+    }
+
+    size_t DetermineTensorRankOfSum() const
+    {
+        return max(DetermineElementwiseTensorRank(), max(Summand(0)->GetSampleLayout().GetRank(), Summand(1)->GetSampleLayout().GetRank()));
+    }
+
+    void ForwardPropOfSum(const FrameRange& fr)
+    {
+        size_t rank = DetermineTensorRankOfSum();
+        auto result = ValueTensorFor(rank, fr);
+        auto input0 = Summand(0)->ValueTensorFor(rank, fr.AllowBroadcast());
+        auto input1 = Summand(1)->ValueTensorFor(rank, fr.AllowBroadcast());
+        result.DoBinaryOpOf(0, input0, input1, 1, OpOfSum(), opSum);
+    }
+
+    void BackpropOfSum(const FrameRange& fr)
+    {
+        if (!Base::NeedsGradient())
+            return;
+        Base::LazyZeroGradient();
+        size_t rank = DetermineTensorRankOfSum();
+        for (size_t i = 0; i < 2; i++)
+        {
+            auto summand = Summand(i);
+            if (!summand->NeedsGradient())
+                continue;
+            summand->LazyZeroGradient();
+
+            // like PlusNode::BackpropTo(): if reduction then mask the gaps
+            if (summand->ReducesInTimeWrt(Input(0)))
+                MaskMissingGradientColumnsToZero(fr);
+
+            auto sliceOutputGrad = GradientTensorFor(rank, fr);
+            auto sliceValue      = ValueTensorFor(rank, fr);
+            auto sliceInputGrad  = summand->GradientTensorFor(rank, fr.AllowBroadcast());
+            sliceInputGrad.DoBinaryOpOf(1, sliceOutputGrad, sliceValue, 1, opBackward, opSum);
+        }
+    }
+
+public:
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override
     {
         return opType == binaryWithInputGradient;
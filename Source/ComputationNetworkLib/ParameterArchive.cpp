@@ -0,0 +1,297 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <cstring>
+#include "ParameterArchive.h"
+#include "File.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static const uint32_t c_parameterArchiveMagic = 0x41504e43; // "CNPA"
+static const uint32_t c_parameterArchiveVersion = 1;
+static const size_t c_parameterArchiveAlignment = 4096; // a page, so that writing to one parameter does not copy another
+
+struct ParameterArchiveHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint64_t m_numberOfParameters;
+    uint64_t m_namesOffset; // in bytes, from the start of the file
+    uint64_t m_namesSize;   // in bytes
+};
+
+struct ParameterArchiveEntry
+{
+    uint64_t m_valueOffset; // in bytes, from the start of the file
+    uint64_t m_nameOffset;  // in bytes, from the start of the names
+    uint32_t m_nameLength;  // in bytes, UTF-8
+    uint32_t m_elementSize; // sizeof(ElemType)
+    uint64_t m_numRows;
+    uint64_t m_numCols;
+};
+
+static size_t AlignParameterArchive(size_t size)
+{
+    return (size + c_parameterArchiveAlignment - 1) / c_parameterArchiveAlignment * c_parameterArchiveAlignment;
+}
+
+static void WritePadding(File& file, size_t size)
+{
+    static const char zeros[c_parameterArchiveAlignment] = {};
+    file.WriteBytes(zeros, AlignParameterArchive(size) - size);
+}
+
+template <class ElemType>
+static vector<char> GetValueBytes(const ComputationNodeBasePtr& node)
+{
+    let& value = node->As<ComputationNode<ElemType>>()->Value();
+    vector<char> bytes(value.GetNumElements() * sizeof(ElemType));
+    if (!bytes.empty())
+    {
+        ElemType* data = reinterpret_cast<ElemType*>(bytes.data());
+        size_t size = value.GetNumElements();
+        value.CopyToArray(data, size);
+    }
+    return bytes;
+}
+
+/*static*/ void ParameterArchive::Write(const wstring& path, const vector<ComputationNodeBasePtr>& parameters)
+{
+    // parameters of the same element type are contiguous, so that each type is uploaded to a GPU in one transfer
+    vector<ComputationNodeBasePtr> sorted(parameters);
+    stable_sort(sorted.begin(), sorted.end(), [](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+    {
+        return a->Is<ComputationNode<float>>() && !b->Is<ComputationNode<float>>();
+    });
+
+    ParameterArchiveHeader header = {};
+    header.m_magic = c_parameterArchiveMagic;
+    header.m_version = c_parameterArchiveVersion;
+    header.m_numberOfParameters = sorted.size();
+
+    vector<ParameterArchiveEntry> entries(sorted.size());
+    string names;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        string name = msra::strfun::utf8(sorted[i]->NodeName());
+        entries[i].m_nameOffset = names.size();
+        entries[i].m_nameLength = (uint32_t)name.size();
+        entries[i].m_elementSize = sorted[i]->Is<ComputationNode<float>>() ? sizeof(float) : sizeof(double);
+        entries[i].m_numRows = sorted[i]->GetAsMatrixNumRows();
+        entries[i].m_numCols = sorted[i]->GetAsMatrixNumCols();
+        names += name;
+    }
+
+    header.m_namesOffset = sizeof(header) + entries.size() * sizeof(ParameterArchiveEntry);
+    header.m_namesSize = names.size();
+    size_t offset = AlignParameterArchive(header.m_namesOffset + names.size());
+    for (auto& entry : entries)
+    {
+        entry.m_valueOffset = offset;
+        offset += AlignParameterArchive(entry.m_numRows * entry.m_numCols * entry.m_elementSize);
+    }
+
+    wstring tempFile = path + L".tmp";
+    {
+        File file(tempFile, fileOptionsBinary | fileOptionsWrite | fileOptionsSequential | fileOptionsDirect);
+        file.WriteBytes(&header, sizeof(header));
+        file.WriteBytes(entries.data(), sizeof(ParameterArchiveEntry) * entries.size());
+        file.WriteBytes(names.data(), names.size());
+        WritePadding(file, header.m_namesOffset + names.size());
+
+        // each value is written while the next one is copied from its device
+        for (size_t i = 0; i < sorted.size(); ++i)
+        {
+            auto bytes = sorted[i]->Is<ComputationNode<float>>() ? GetValueBytes<float>(sorted[i]) : GetValueBytes<double>(sorted[i]);
+            if (bytes.size() != entries[i].m_numRows * entries[i].m_numCols * entries[i].m_elementSize)
+                LogicError("ParameterArchive: The value of '%ls' does not match its dimensions.", sorted[i]->NodeName().c_str());
+            bytes.resize(AlignParameterArchive(bytes.size())); // the padding, as zeros
+            file.WriteAsync(move(bytes));
+        }
+        file.Flush();
+    }
+    renameOrDie(tempFile, path);
+
+    fprintf(stderr, "ParameterArchive: Saved %" PRIu64 " parameters (%" PRIu64 " bytes) to '%ls'.\n",
+            (uint64_t)sorted.size(), (uint64_t)offset, path.c_str());
+}
+
+/*static*/ ParameterArchivePtr ParameterArchive::Open(const wstring& path)
+{
+    // All models of the process share a mapping for as long as one of them uses it.
+    static mutex registryLock;
+    static map<wstring, weak_ptr<ParameterArchive>> registry;
+
+    lock_guard<mutex> lock(registryLock);
+    auto archive = registry[path].lock();
+    if (archive)
+        return archive;
+    if (!fexists(path))
+        return nullptr;
+
+    MemoryMappedFilePtr file;
+    try
+    {
+        file = make_shared<MemoryMappedFile>(path, /*copyOnWrite=*/true);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot open the parameter archive '%ls': %s\n", path.c_str(), e.what());
+        return nullptr;
+    }
+
+    archive = ParameterArchivePtr(new ParameterArchive(file));
+    if (!archive->IsValid())
+    {
+        fprintf(stderr, "WARNING: Ignoring the parameter archive '%ls', it is not a valid archive.\n", path.c_str());
+        return nullptr;
+    }
+
+    registry[path] = archive;
+    return archive;
+}
+
+ParameterArchive::ParameterArchive(MemoryMappedFilePtr file)
+    : m_file(file)
+{
+}
+
+bool ParameterArchive::IsValid()
+{
+    size_t size = m_file->Size();
+    if (size < sizeof(ParameterArchiveHeader))
+        return false;
+
+    const auto* header = reinterpret_cast<const ParameterArchiveHeader*>(m_file->Data());
+    if (header->m_magic != c_parameterArchiveMagic || header->m_version != c_parameterArchiveVersion ||
+        header->m_numberOfParameters > (size - sizeof(*header)) / sizeof(ParameterArchiveEntry) ||
+        header->m_namesOffset > size || header->m_namesSize > size - header->m_namesOffset)
+        return false;
+
+    const auto* entries = reinterpret_cast<const ParameterArchiveEntry*>(m_file->Data() + sizeof(ParameterArchiveHeader));
+    const char* names = m_file->Data() + header->m_namesOffset;
+    for (size_t i = 0; i < header->m_numberOfParameters; ++i)
+    {
+        const auto& entry = entries[i];
+        if (entry.m_nameOffset > header->m_namesSize || entry.m_nameLength > header->m_namesSize - entry.m_nameOffset ||
+            (entry.m_elementSize != sizeof(float) && entry.m_elementSize != sizeof(double)) ||
+            entry.m_valueOffset > size || entry.m_valueOffset % c_parameterArchiveAlignment != 0 ||
+            (entry.m_numCols != 0 && entry.m_numRows > (size - entry.m_valueOffset) / entry.m_elementSize / entry.m_numCols))
+            return false;
+        m_entries[msra::strfun::utf16(string(names + entry.m_nameOffset, entry.m_nameLength))] = i;
+    }
+    return true;
+}
+
+const ParameterArchiveEntry* ParameterArchive::Find(const wstring& name) const
+{
+    auto iter = m_entries.find(name);
+    if (iter == m_entries.end())
+        return nullptr;
+    return reinterpret_cast<const ParameterArchiveEntry*>(m_file->Data() + sizeof(ParameterArchiveHeader)) + iter->second;
+}
+
+template <class ElemType>
+bool ParameterArchive::LoadValue(File& fstream, const wstring& name, DEVICEID_TYPE deviceId, shared_ptr<Matrix<ElemType>>& value)
+{
+    const auto* entry = Find(name);
+    if (!entry || entry->m_elementSize != sizeof(ElemType) || fstream.IsTextBased() || !fstream.CanSeek())
+        return false;
+
+    // the header of the value in the model file, see Matrix::Write()
+    let start = fstream.GetPosition();
+    char type;
+    size_t elementSize, numRows, numCols;
+    wstring matrixName;
+    int format;
+    fstream >> type;
+    bool matches = type == 'd';
+    if (matches)
+    {
+        fstream.GetMarker(fileMarkerBeginSection, wstring(L"BMAT"));
+        fstream >> elementSize >> matrixName >> format >> numRows >> numCols;
+        matches = elementSize == sizeof(ElemType) && numRows == entry->m_numRows && numCols == entry->m_numCols && numRows * numCols > 0;
+    }
+
+    // spot-check the values, which also skips them in the model file
+    const ElemType* archiveValue = reinterpret_cast<const ElemType*>(m_file->Data() + entry->m_valueOffset);
+    if (matches)
+    {
+        let numElements = numRows * numCols;
+        let valuePosition = fstream.GetPosition();
+        ElemType first, last;
+        fstream >> first;
+        fstream.SetPosition(valuePosition + (numElements - 1) * sizeof(ElemType));
+        fstream >> last;
+        matches = first == archiveValue[0] && last == archiveValue[numElements - 1];
+    }
+    if (!matches)
+    {
+        fstream.SetPosition(start);
+        return false;
+    }
+    fstream.GetMarker(fileMarkerEndSection, wstring(L"EMAT"));
+
+    if (deviceId == CPUDEVICE)
+    {
+        // used in place; writing to it copies the pages written to
+        ElemType* data = reinterpret_cast<ElemType*>(m_file->WritableData() + entry->m_valueOffset);
+        value = make_shared<Matrix<ElemType>>(numRows, numCols, data, CPUDEVICE, matrixFlagDontOwnBuffer);
+    }
+    else
+    {
+        size_t firstOffset;
+        let deviceCopy = GetDeviceCopy<ElemType>(deviceId, firstOffset);
+        if (!value)
+            value = make_shared<Matrix<ElemType>>(deviceId);
+        value->SetValue(deviceCopy->ColumnSlice((entry->m_valueOffset - firstOffset) / sizeof(ElemType), numRows * numCols));
+        value->Reshape(numRows, numCols);
+    }
+    return true;
+}
+
+// a [1 x n] matrix on the device with the values of all parameters of the element type, copied in one transfer
+template <class ElemType>
+shared_ptr<Matrix<ElemType>> ParameterArchive::GetDeviceCopy(DEVICEID_TYPE deviceId, size_t& firstOffset)
+{
+    const auto* header = reinterpret_cast<const ParameterArchiveHeader*>(m_file->Data());
+    const auto* entries = reinterpret_cast<const ParameterArchiveEntry*>(m_file->Data() + sizeof(ParameterArchiveHeader));
+    firstOffset = SIZE_MAX;
+    size_t endOffset = 0;
+    for (size_t i = 0; i < header->m_numberOfParameters; ++i)
+    {
+        if (entries[i].m_elementSize != sizeof(ElemType))
+            continue;
+        firstOffset = min(firstOffset, (size_t)entries[i].m_valueOffset);
+        endOffset = max(endOffset, (size_t)(entries[i].m_valueOffset + entries[i].m_numRows * entries[i].m_numCols * sizeof(ElemType)));
+    }
+
+    lock_guard<mutex> lock(m_deviceCopiesLock);
+    auto& deviceCopy = m_deviceCopies[make_pair(deviceId, sizeof(ElemType))];
+    if (!deviceCopy)
+    {
+        ElemType* data = reinterpret_cast<ElemType*>(m_file->WritableData() + firstOffset);
+        deviceCopy = make_shared<Matrix<ElemType>>(1, (endOffset - firstOffset) / sizeof(ElemType), data, deviceId, matrixFlagNormal);
+    }
+    return static_pointer_cast<Matrix<ElemType>>(deviceCopy);
+}
+
+void ParameterArchive::ReleaseDeviceCopies()
+{
+    lock_guard<mutex> lock(m_deviceCopiesLock);
+    m_deviceCopies.clear();
+}
+
+template bool ParameterArchive::LoadValue<float>(File& fstream, const wstring& name, DEVICEID_TYPE deviceId, shared_ptr<Matrix<float>>& value);
+template bool ParameterArchive::LoadValue<double>(File& fstream, const wstring& name, DEVICEID_TYPE deviceId, shared_ptr<Matrix<double>>& value);
+
+}}}
@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ParameterArchive.h -- the values of the LearnableParameters of a model, laid out for memory mapping.
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "File.h"
+#include "Matrix.h"
+#include "MemoryMappedFile.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct ParameterArchiveEntry;
+
+class ParameterArchive;
+typedef std::shared_ptr<ParameterArchive> ParameterArchivePtr;
+
+// An archive stores the values of the LearnableParameters of a model next to the model file ("<model>.params"),
+// page-aligned and contiguous. Reading a model picks it up if present: the values are then not parsed from the model file,
+// but on the CPU used in place from a copy-on-write mapping of the archive, and on a GPU uploaded in one transfer.
+// All models read in a process share the mapping of an archive, and all processes on a host the pages of the file cache.
+//
+// The model file stays complete, so that a model can always be read without its archive. An archive no longer matches
+// its model once the model is saved again: ComputationNetwork::Save() deletes it, and values that do not match the
+// model file in size, shape or their first and last element are read from the model file instead.
+class ParameterArchive
+{
+public:
+    static std::wstring GetPath(const std::wstring& modelPath)
+    {
+        return modelPath + L".params";
+    }
+
+    // Writes the values of the given LearnableParameter nodes.
+    static void Write(const std::wstring& path, const std::vector<ComputationNodeBasePtr>& parameters);
+
+    // Maps an archive, or returns the mapping another model already uses; nullptr if there is no valid archive.
+    static ParameterArchivePtr Open(const std::wstring& path);
+
+    // Takes the value of a parameter from the archive instead of the model file, for a matrix as written by Matrix::Write().
+    // The stream is positioned after the matrix then. Returns false, with the stream unchanged, if the archive has no
+    // matching value. On the CPU the value then refers to the mapping, which must outlive it.
+    template <class ElemType>
+    bool LoadValue(File& fstream, const std::wstring& name, DEVICEID_TYPE deviceId, std::shared_ptr<Matrix<ElemType>>& value);
+
+    // Frees the copies of the archive on the GPUs, once all parameters have been read.
+    void ReleaseDeviceCopies();
+
+    DISABLE_COPY_AND_MOVE(ParameterArchive);
+
+private:
+    explicit ParameterArchive(MemoryMappedFilePtr file);
+
+    bool IsValid(); // also indexes the entries
+    const ParameterArchiveEntry* Find(const std::wstring& name) const;
+
+    template <class ElemType>
+    std::shared_ptr<Matrix<ElemType>> GetDeviceCopy(DEVICEID_TYPE deviceId, size_t& firstOffset);
+
+    MemoryMappedFilePtr m_file;
+    std::map<std::wstring, size_t> m_entries; // parameter name -> index of its entry
+
+    std::mutex m_deviceCopiesLock;
+    std::map<std::pair<DEVICEID_TYPE, size_t /*element size*/>, std::shared_ptr<void>> m_deviceCopies;
+};
+
+}}}
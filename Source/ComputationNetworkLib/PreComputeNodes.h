@@ -190,6 +190,28 @@ public:
     }
 
 protected:
+    // Accumulators are averages over the samples seen. For aggregation across workers, they are turned into sums
+    // of per-sample statistics on the host, which are summed over the workers. The buffer starts with the #samples.
+    void AllReduceSums(const std::function<void(std::vector<double>&)>& allReduceSum, std::vector<double>& sums)
+    {
+        sums.insert(sums.begin(), (double) m_numSamples);
+        allReduceSum(sums);
+        m_numSamples = (size_t) sums[0];
+        sums.erase(sums.begin());
+    }
+
+    static void AppendToBuffer(const Matrix<ElemType>& m, std::vector<double>& buffer)
+    {
+        std::unique_ptr<ElemType[]> values(m.CopyToArray());
+        buffer.insert(buffer.end(), values.get(), values.get() + m.GetNumElements());
+    }
+
+    static void SetFromBuffer(Matrix<ElemType>& m, const double* buffer)
+    {
+        std::vector<ElemType> values(buffer, buffer + m.GetNumElements());
+        m.SetValue(m.GetNumRows(), m.GetNumCols(), m.GetDeviceId(), values.data());
+    }
+
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
 };
@@ -198,7 +220,10 @@ protected:
     ComputationNodeBoilerplate;               \
     UsingPreComputedNodeMembers;              \
     using Base::m_numSamples;                 \
-    using Base::IsAccumulating
+    using Base::IsAccumulating;               \
+    using Base::AllReduceSums;                \
+    using Base::AppendToBuffer;               \
+    using Base::SetFromBuffer
 
 // -----------------------------------------------------------------------
 // MeanNode (features)
@@ -232,6 +257,22 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(std::vector<double>&)>& allReduceSum) override
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: AggregateAccumulators() has been called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+
+        // sum of the samples = #samples * mean
+        std::vector<double> sums;
+        AppendToBuffer(Value(), sums);
+        for (auto& sum : sums)
+            sum *= m_numSamples;
+        AllReduceSums(allReduceSum, sums);
+        for (auto& sum : sums)
+            sum /= max(m_numSamples, (size_t) 1);
+        SetFromBuffer(Value(), sums.data());
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -313,6 +354,33 @@ public:
         }
     }
 
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(std::vector<double>&)>& allReduceSum) override
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: AggregateAccumulators() has been called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+
+        // sums of the samples and of their squares, from #samples, mean, and var = mean of squares - squared mean
+        std::vector<double> moments;
+        AppendToBuffer(*m_mean, moments);
+        AppendToBuffer(*m_var, moments);
+        size_t dim = m_mean->GetNumElements();
+        std::vector<double> sums(2 * dim);
+        for (size_t i = 0; i < dim; i++)
+        {
+            sums[i]       = m_numSamples * moments[i];
+            sums[dim + i] = m_numSamples * (moments[dim + i] + moments[i] * moments[i]);
+        }
+        AllReduceSums(allReduceSum, sums);
+        double numSamples = (double) max(m_numSamples, (size_t) 1);
+        for (size_t i = 0; i < dim; i++)
+        {
+            moments[i]       = sums[i] / numSamples;
+            moments[dim + i] = max(sums[dim + i] / numSamples - moments[i] * moments[i], 0.0);
+        }
+        SetFromBuffer(*m_mean, moments.data());
+        SetFromBuffer(*m_var, moments.data() + dim);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
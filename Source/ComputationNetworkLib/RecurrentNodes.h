@@ -9,6 +9,7 @@
 #include "Sequences.h"
 #include "Matrix.h"
 #include "TensorShape.h"
+#include "RNNEngine.h"
 
 #include <unordered_set>
 #include <map>
@@ -37,19 +38,19 @@ public:
           m_isEmpty(true)
     {
     }
+    // The layout is shared, not copied; it must not be modified afterwards.
     void CacheDelayedMBLayout(const MBLayoutPtr& pMBLayout)
     {
-        m_delayedActivationMBLayout = make_shared<MBLayout>();
-        m_delayedActivationMBLayout->CopyFrom(pMBLayout);
+        m_delayedActivationMBLayout = pMBLayout;
     }
     void CacheState(const Matrix<ElemType>& cachedActivity)
     {
         m_cachedActivity.SetValue(cachedActivity);
         m_isEmpty = false;
     }
-    void ExportDelayedMBLayout(MBLayoutPtr& pMBLayout)
+    const MBLayoutPtr& GetDelayedMBLayout() const
     {
-        pMBLayout->CopyFrom(m_delayedActivationMBLayout);
+        return m_delayedActivationMBLayout;
     }
     bool IsEmpty()
     {
@@ -84,7 +85,11 @@ protected:
 //  - full support/efficiency of non-recurrent use (in which case the range can be from negative to positive, e.g. a symmetric rolling window)
 //  - denoting which tensor dimension to loop over (this may not be completed, but I will plant a seed)
 //  - support for Yongqiang's sub-minibatching with truncated BPTT (export/import state)
-//  - more efficient storage of carried-over state (only store the needed frames, not a full copy of the previous MB as currently; which will on the other hand also allow windows that reach back beyond a minibatch)
+//  - windows that reach back beyond a minibatch
+//
+// The state carried over to the next minibatch is a ring of the last m_timeStep frames (or the first ones for
+// FutureValue) in m_delayedValue, allocated once; a minibatch writes its frames over the oldest ones and advances
+// the beginning of the ring, rather than keeping a copy of the entire input and its MBLayout.
 // -----------------------------------------------------------------------
 
 // TODO: 'direction' is really too general. signOfTimeOffset?
@@ -107,13 +112,13 @@ private:
 protected:
     DelayedValueNodeBase(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_delayedValue(deviceId)
+          m_delayedValue(deviceId), m_delayedBegin(0), m_numDelayedFrames(0)
     {
         Init(TensorShape(), (ElemType) DEFAULT_HIDDEN_ACTIVATION);
     }
     DelayedValueNodeBase(DEVICEID_TYPE deviceId, const wstring& name, ElemType initialActivationValue, const TensorShape& sampleLayout, size_t timeStep)
         : Base(deviceId, name),
-          m_delayedValue(deviceId)
+          m_delayedValue(deviceId), m_delayedBegin(0), m_numDelayedFrames(0)
     {
         Init(sampleLayout, initialActivationValue);
         m_timeStep = (int) timeStep; // TODO: pass this to Init() instead as well
@@ -175,7 +180,7 @@ public:
             //         these to 0 and rely on Validate(), but some unknown nodes in the loop don't do that right.
             SetDims(TensorShape(rows), HasMBLayout() /*may be true on reload (roll-back)*/); // tensor shape will be overwritten in Validate()
         }
-        m_delayedValue.Resize(m_sampleLayout.GetNumElements(), 0); // Note: If we try to access history in first minibatch, we shall crash. It would be a consequence of a missing sentence-begin flag
+        ResetDelayedValue(0); // Note: If we try to access history in first minibatch, we shall crash. It would be a consequence of a missing sentence-begin flag
 
         if (modelVersion >= CNTK_MODEL_VERSION_2)
             fstream >> m_initialActivationValue;
@@ -248,17 +253,37 @@ public:
     virtual void EndForwardProp() override // called after last iteration step of ForwardProp()
     {
         // In truncated BPTT, we carry over left-to-right state across minibatches.
-        // It is kept in m_delayedValue, m_delayedActivationMBLayout.
-        // This could be optimized as follows:
-        //  - only keep the required number of frames (m_timeStep)
+        // The frames that the next minibatch can reach are kept in the ring m_delayedValue.
+        // This could be optimized further:
         //  - we don't need to keep anything in full-sequence mode
         //  - we don't need to keep anything if all sequences are closed (sentence end)
         //    This condition includes full-sequence mode.
         // TODO: Can we optimize this and only copy if there is a sequence spanning across the end of the MB? And add a check to BeginForwardProp() to make sure we got one if there is a boundary at the start?
-        m_delayedValue.SetValue(Input(0)->Value());
-        if (!m_delayedActivationMBLayout)
-            m_delayedActivationMBLayout = make_shared<MBLayout>();
-        m_delayedActivationMBLayout->CopyFrom(m_pMBLayout);
+        size_t T = GetNumTimeSteps();
+        size_t numSequences = GetNumParallelSequences();
+        if (m_delayedValue.GetNumRows() != m_sampleLayout.GetNumElements() || m_delayedValue.GetNumCols() != m_timeStep * numSequences)
+            ResetDelayedValue(numSequences);
+
+        // the last frames are the newest ones of the ring (the first ones are kept for FutureValue, which reaches forward)
+        size_t numFrames = min(T, (size_t) m_timeStep);
+        int dir = direction;
+        if (dir > 0)
+            m_delayedBegin = 0;
+        size_t firstFrame = dir < 0 ? T - numFrames : 0;
+        for (size_t i = 0; i < numFrames;) // in up to two pieces, where the ring wraps around
+        {
+            size_t slot = (m_delayedBegin + i) % m_timeStep;
+            size_t n = min(numFrames - i, m_timeStep - slot);
+            m_delayedValue.SetColumnSlice(Input(0)->Value().ColumnSlice((firstFrame + i) * numSequences, n * numSequences), slot * numSequences, n * numSequences);
+            i += n;
+        }
+        if (dir < 0)
+        {
+            m_delayedBegin = (m_delayedBegin + numFrames) % m_timeStep;
+            m_numDelayedFrames = min(m_numDelayedFrames + numFrames, (size_t) m_timeStep);
+        }
+        else
+            m_numDelayedFrames = numFrames;
 
         Base::EndForwardProp();
     }
@@ -285,7 +310,6 @@ public:
         FrameRange frDelayed = fr.WithTimeOffset(direction * m_timeStep);
 
         size_t T = GetNumTimeSteps();
-        size_t T_delayedActivation = m_delayedActivationMBLayout ? m_delayedActivationMBLayout->GetNumTimeSteps() : 0; // (note: should never happen in full-sequence mode)
 
         // compute logical position of delayed value
         assert(m_timeStep > 0);
@@ -313,10 +337,8 @@ public:
                 else                                        // not a boundary: just copy the delayed value
                 {
                     // inside the sequence: access delayed value
-                    if (t_delayed < 0)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
-                    else if (t_delayed >= T)
-                        inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T).Sequence(id), m_delayedActivationMBLayout); // delay reaches in previous minibatch
+                    if (t_delayed < 0 || t_delayed >= T)
+                        inp = DelayedValueFor(t_delayed, id, id + 1); // delay reaches in previous minibatch
                     else
                         inp = Input(0)->ValueFor(frDelayed.Sequence(id));
                     // inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed).Sequence(id));
@@ -329,30 +351,15 @@ public:
         {
             Matrix<ElemType> out = ValueFor(fr);
 
-            if (t_delayed < 0)
+            if (t_delayed < 0 || t_delayed >= T)
             {
-                if (m_delayedValue.IsEmpty()) 
-                {
-                    if (IsPartOfLoop())
-                        InvalidArgument("The delay node tries to access past values that are out of bound, possibly because there is no sentence start marker in the MBLayout.");
-                    else //use first frame
-                        inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, 0));
-                }
+                if (!IsPartOfLoop() && DelayedFrameSlot(t_delayed) < 0) // use first or last frame
+                    inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, t_delayed < 0 ? 0 : T - 1));
                 else
-                    inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed + T_delayedActivation), m_delayedActivationMBLayout);
-            }
-
-            else if (t_delayed >= T)
-            {
-                if (m_delayedValue.IsEmpty())  
                 {
-                    if (IsPartOfLoop())
-                        InvalidArgument("The delay node tries to access future values that are out of bound, possibly because there is no sentence end marker in the MBLayout.");
-                    else //use last frame
-                        inp = Input(0)->ValueFor(FrameRange(m_pMBLayout, T - 1));
+                    auto sequenceRange = fr.GetSequenceRange();
+                    inp = DelayedValueFor(t_delayed, sequenceRange.first, sequenceRange.second);
                 }
-                else
-                    inp = DataWithMBLayoutFor(m_delayedValue, FrameRange(m_delayedActivationMBLayout, t_delayed - T), m_delayedActivationMBLayout);
             }
             else
                 inp = Input(0)->ValueFor(frDelayed);
@@ -381,10 +388,8 @@ public:
             node->m_timeStep = m_timeStep;
             node->m_initialActivationValue = m_initialActivationValue;
             node->m_delayedValue.SetValue(m_delayedValue);
-            if (m_delayedActivationMBLayout)
-                (node->m_delayedActivationMBLayout = make_shared<MBLayout>())->CopyFrom(m_delayedActivationMBLayout);
-            else
-                node->m_delayedActivationMBLayout = nullptr;
+            node->m_delayedBegin = m_delayedBegin;
+            node->m_numDelayedFrames = m_numDelayedFrames;
         }
     }
 
@@ -404,14 +409,14 @@ public:
             if (!m_pMBLayout->HasSequenceBeyondEnd()) // only need to export state if anything crosses the MB boundary
             {
                 auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
-                pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
+                pState->CacheDelayedMBLayout(SnapshotMBLayout());
                 // return an empty one
             }
             else
             {
                 auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
-                pState->CacheState(m_delayedValue.ColumnSlice((nT - 1) * nU, nU));
-                pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
+                pState->CacheState(DelayedValueFor(-1, 0, nU)); // the last frame
+                pState->CacheDelayedMBLayout(SnapshotMBLayout());
                 pExportedState = pState;
             }
         }
@@ -420,14 +425,14 @@ public:
             if (!m_pMBLayout->HasSequenceBeyondBegin()) // only need to export state if anything crosses the MB boundary
             {
                 auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
-                pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
+                pState->CacheDelayedMBLayout(SnapshotMBLayout());
                 pExportedState = pState;
             }
             else
             {
                 auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
-                pState->CacheState(m_delayedValue.ColumnSlice((nT - 1) * nU, nU));
-                pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
+                pState->CacheState(DelayedValueFor((int) nT, 0, nU)); // the first frame
+                pState->CacheDelayedMBLayout(SnapshotMBLayout());
                 pExportedState = pState;
             }
         }
@@ -445,32 +450,79 @@ public:
         if (!pState)
             LogicError("Expecting DelayValueNodeState after downcasting");
 
-        pState->ExportDelayedMBLayout(m_delayedActivationMBLayout); // pstate copy to m_delayedActivationMBLayout
         if (pState->IsEmpty())
         {
             return;
         }
 
+        // the state becomes the only frame of the ring, as if it was the last (first) frame of a previous minibatch
         const Matrix<ElemType>& delayedActivation = pState->ExportCachedActivity();
-        size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps();
-        size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
+        size_t nU = delayedActivation.GetNumCols(); // (1 column per parallel sequence)
+        if (m_delayedValue.GetNumRows() != delayedActivation.GetNumRows() || m_delayedValue.GetNumCols() != m_timeStep * nU)
+            ResetDelayedValue(nU); // the state was not exported from a minibatch of the same shape (e.g. streams of an evaluator)
 
         int dir = direction;
         if (dir == -1) // looking backward
-            m_delayedValue.SetColumnSlice(delayedActivation, (nT - 1) * nU, nU);
+            m_delayedBegin = 1 % m_timeStep; // the newest frame is in slot 0
         else if (dir == 1)
-            m_delayedValue.SetColumnSlice(delayedActivation, 0, nU);
+            m_delayedBegin = 0;
         else
             LogicError("Unrecognized direction in DelayedValueNodeBase");
+        m_delayedValue.SetColumnSlice(delayedActivation, 0, nU);
+        m_numDelayedFrames = 1;
     }
 
     int TimeStep() const { return m_timeStep; }
     ElemType InitialActivationValue() const { return m_initialActivationValue; }
 
+private:
+    // Frame t_delayed of the current minibatch, which lies outside of it, is frame 'i' of the ring, counted from the
+    // oldest one: i = t_delayed + m_timeStep for the past (t_delayed < 0), and t_delayed - T for the future.
+    // Returns the slot of this frame in m_delayedValue, or -1 if it is not kept.
+    int DelayedFrameSlot(int t_delayed) const
+    {
+        int T = (int) GetNumTimeSteps();
+        int i = t_delayed < 0 ? t_delayed + m_timeStep : t_delayed - T;
+        int firstKept = t_delayed < 0 ? m_timeStep - (int) m_numDelayedFrames : 0;
+        if (i < firstKept || i >= firstKept + (int) m_numDelayedFrames)
+            return -1;
+        return (int) ((m_delayedBegin + i) % m_timeStep);
+    }
+
+    // the kept value of frame t_delayed for the parallel sequences [begin, end)
+    Matrix<ElemType> DelayedValueFor(int t_delayed, size_t begin, size_t end) const
+    {
+        int slot = DelayedFrameSlot(t_delayed);
+        if (slot < 0)
+            InvalidArgument("The delay node tries to access %s values that are out of bound, possibly because there is no sentence %s marker in the MBLayout.",
+                            t_delayed < 0 ? "past" : "future", t_delayed < 0 ? "start" : "end");
+        size_t numSequences = m_delayedValue.GetNumCols() / m_timeStep;
+        if (end > numSequences)
+            LogicError("%ls: The minibatch has more parallel sequences than the previous one.", NodeDescription().c_str());
+        return m_delayedValue.ColumnSlice(slot * numSequences + begin, end - begin);
+    }
+
+    // an empty ring for 'numSequences' parallel sequences
+    void ResetDelayedValue(size_t numSequences)
+    {
+        m_delayedValue.Resize(m_sampleLayout.GetNumElements(), m_timeStep * numSequences);
+        m_delayedBegin = 0;
+        m_numDelayedFrames = 0;
+    }
+
+    // a copy of the layout for an exported state, since m_pMBLayout is updated in place by the next minibatch
+    MBLayoutPtr SnapshotMBLayout() const
+    {
+        auto pMBLayout = make_shared<MBLayout>();
+        pMBLayout->CopyFrom(m_pMBLayout);
+        return pMBLayout;
+    }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
-    Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
-    MBLayoutPtr m_delayedActivationMBLayout; // layout for m_delayedValue
+    Matrix<ElemType> m_delayedValue;         // ring of the m_timeStep frames carried over to the next minibatch, nU columns each
+    size_t m_delayedBegin;                   // slot of the oldest frame of the ring (the first one for FutureValue)
+    size_t m_numDelayedFrames;               // frames kept; fewer than m_timeStep after short minibatches
     int m_timeStep;                          // delay in frames (typ. 1)
     function<void()> m_attachInputsFn;       // for late expansion of inputs (scripting)
 };
@@ -555,6 +607,240 @@ public:
 template class FutureValueNode<float>;
 template class FutureValueNode<double>;
 
+// -----------------------------------------------------------------------
+// OptimizedRNNStackNode (weights, input) -- a stack of LSTM, GRU or plain RNN layers, computed by one fused library call
+//
+// All layers and all time steps of the minibatch are computed at once by cuDNN, which is much faster than unrolling the
+// recurrence into PastValue and per-step nodes. The weights of all layers are one column whose layout is defined by cuDNN;
+// its dimension is inferred if given as 0. With bidirectional=true, the output is the concatenation of both directions.
+// The sequences of the minibatch are packed into cuDNN's time-major variable-length format (sorted by decreasing length),
+// and the result is unpacked into the layout of the input. Every sequence starts from a zero state, hence the sequences
+// must begin and end within the minibatch (no truncated BPTT). Only a GPU implementation exists.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class OptimizedRNNStackNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<2>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"OptimizedRNNStack"; }
+
+public:
+    OptimizedRNNStackNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name), m_hasBackwardData(false)
+    {
+        m_attributes.m_mode = RNNMode::LSTM;
+        m_attributes.m_numLayers = 1;
+        m_attributes.m_hiddenSize = 0;
+        m_attributes.m_bidirectional = false;
+    }
+    OptimizedRNNStackNode(DEVICEID_TYPE deviceId, const wstring& name, const RNNAttributes& attributes)
+        : Base(deviceId, name), m_attributes(attributes), m_hasBackwardData(false)
+    {
+    }
+    OptimizedRNNStackNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : OptimizedRNNStackNode(configp->Get(L"deviceId"), L"<placeholder>", AttributesFrom(configp))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << RNNAttributes::NameOf(m_attributes.m_mode);
+        fstream << m_attributes.m_numLayers;
+        fstream << m_attributes.m_hiddenSize;
+        fstream << m_attributes.m_bidirectional;
+    }
+
+    void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        wstring mode;
+        fstream >> mode;
+        m_attributes.m_mode = RNNAttributes::ModeFrom(mode);
+        fstream >> m_attributes.m_numLayers;
+        fstream >> m_attributes.m_hiddenSize;
+        fstream >> m_attributes.m_bidirectional;
+    }
+
+    void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<OptimizedRNNStackNode<ElemType>>(nodeP);
+            assert(node != nullptr);
+            node->m_attributes = m_attributes;
+        }
+    }
+
+    // the packing index is uploaded from the host whenever the layout changes
+    virtual bool IsReplayable() const override { return false; }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        PackSequences();
+
+        m_packedInput->DoGatherColumnsOf(0, *m_packingIndex, Input(1)->Value(), 1);
+        m_packedOutput->Resize(m_attributes.OutputSize(), m_packedInput->GetNumCols());
+        m_engine->Forward(*m_packedInput, Input(0)->Value(), *m_packedOutput, m_numSequencesPerFrame, Environment().IsTraining());
+        m_hasBackwardData = false;
+
+        // unpack; gaps are not written to, hence must be cleared
+        Value().DoScatterColumnsOf(0, *m_packingIndex, *m_packedOutput, 1);
+        MaskMissingValueColumnsToZero(FrameRange(GetMBLayout()));
+    }
+
+    // cuDNN computes the gradients of the weights from intermediate results of the gradient of the data, so the latter
+    // is always computed first, regardless of which of the inputs need a gradient.
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        if (!m_hasBackwardData)
+        {
+            MaskMissingGradientColumnsToZero(FrameRange(GetMBLayout()));
+            m_packedOutputGradient->DoGatherColumnsOf(0, *m_packingIndex, Gradient(), 1);
+            m_packedInputGradient->Resize(m_packedInput->GetNumRows(), m_packedInput->GetNumCols());
+            m_engine->BackwardData(*m_packedOutput, *m_packedOutputGradient, Input(0)->Value(), *m_packedInputGradient, m_numSequencesPerFrame);
+            m_hasBackwardData = true;
+        }
+
+        if (inputIndex == 0) // derivative with respect to the weights; cuDNN adds to it
+            m_engine->BackwardWeights(*m_packedInput, *m_packedOutput, Input(0)->Gradient(), m_numSequencesPerFrame);
+        else if (inputIndex == 1) // derivative with respect to the data
+            Input(1)->Gradient().DoScatterColumnsOf(1, *m_packingIndex, *m_packedInputGradient, 1);
+    }
+
+    // the packed copies of input and output are kept instead
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex == 0; }
+
+    void Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        SetDims(TensorShape(m_attributes.OutputSize()), HasMBLayout());
+
+        // infer the dimension of the weights
+        size_t inputSize = Input(1)->GetSampleLayout().GetNumElements();
+        size_t numParameters = m_attributes.GetNumParameters(inputSize);
+        if (Input(0)->GetSampleLayout().GetNumElements() == 0 && inputSize > 0)
+            Input(0)->ValidateInferInputDimsFrom(TensorShape(numParameters, 1));
+
+        if (isFinalValidationPass)
+        {
+            if (!HasMBLayout())
+                InvalidArgument("%ls: The data input must have a dynamic axis.", NodeDescription().c_str());
+            if (m_attributes.m_hiddenSize == 0 || m_attributes.m_numLayers == 0)
+                InvalidArgument("%ls: hiddenDims and numLayers must be positive.", NodeDescription().c_str());
+            if (Input(0)->HasMBLayout())
+                InvalidArgument("%ls: The weights cannot have a dynamic axis.", NodeDescription().c_str());
+            if (Input(0)->GetSampleLayout().GetNumElements() != numParameters)
+                InvalidArgument("%ls: The weights have %d elements, but %d are needed for input dimension %d.", NodeDescription().c_str(),
+                                (int)Input(0)->GetSampleLayout().GetNumElements(), (int)numParameters, (int)inputSize);
+            if (m_engine == nullptr)
+                m_engine = RNNEngine<ElemType>::Create(m_deviceId, m_attributes, inputSize);
+        }
+    }
+
+    void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_packedInput, matrixPool);
+        RequestMatrixFromPool(m_packedOutput, matrixPool);
+        CreateMatrixIfNull(m_packingIndex);
+    }
+
+    void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_packedOutputGradient, matrixPool);
+        RequestMatrixFromPool(m_packedInputGradient, matrixPool);
+    }
+
+    void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_packedInput, matrixPool);
+        ReleaseMatrixToPool(m_packedOutput, matrixPool);
+        ReleaseMatrixToPool(m_packedOutputGradient, matrixPool);
+        ReleaseMatrixToPool(m_packedInputGradient, matrixPool);
+    }
+
+    const RNNAttributes& Attributes() const { return m_attributes; }
+
+private:
+    static RNNAttributes AttributesFrom(const ScriptableObjects::IConfigRecordPtr configp)
+    {
+        RNNAttributes attributes;
+        attributes.m_mode = RNNAttributes::ModeFrom(configp->Get(L"recurrentOp"));
+        attributes.m_numLayers = configp->Get(L"numLayers");
+        attributes.m_hiddenSize = configp->Get(L"hiddenDims");
+        attributes.m_bidirectional = configp->Get(L"bidirectional");
+        return attributes;
+    }
+
+    // determine the packing index (column of the minibatch for each packed column) and the number of sequences per frame
+    void PackSequences()
+    {
+        let& layout = GetMBLayout();
+        if (m_packedLayout && *m_packedLayout == *layout)
+            return;
+
+        vector<MBLayout::SequenceInfo> sequences;
+        for (let& seq : layout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > layout->GetNumTimeSteps())
+                InvalidArgument("%ls: Sequences must begin and end within the minibatch; truncated BPTT is not supported.", NodeDescription().c_str());
+            sequences.push_back(seq);
+        }
+        stable_sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b)
+        {
+            return a.GetNumTimeSteps() > b.GetNumTimeSteps();
+        });
+
+        let numParallelSequences = layout->GetNumParallelSequences();
+        m_numSequencesPerFrame.clear();
+        m_packingIndexBuffer.clear();
+        for (size_t t = 0; !sequences.empty() && t < sequences.front().GetNumTimeSteps(); t++)
+        {
+            size_t numSequences = 0;
+            while (numSequences < sequences.size() && sequences[numSequences].GetNumTimeSteps() > t)
+            {
+                let& seq = sequences[numSequences++];
+                m_packingIndexBuffer.push_back((ElemType)((seq.tBegin + t) * numParallelSequences + seq.s));
+            }
+            m_numSequencesPerFrame.push_back(numSequences);
+        }
+        m_packingIndex->SetValue(1, m_packingIndexBuffer.size(), m_deviceId, m_packingIndexBuffer.data());
+
+        if (!m_packedLayout)
+            m_packedLayout = make_shared<MBLayout>();
+        m_packedLayout->CopyFrom(layout);
+    }
+
+private:
+    RNNAttributes m_attributes;
+    std::unique_ptr<RNNEngine<ElemType>> m_engine;
+
+    // packing of the current minibatch
+    MBLayoutPtr m_packedLayout;                // layout for which the index below was computed
+    vector<size_t> m_numSequencesPerFrame;     // [t] number of sequences longer than t
+    vector<ElemType> m_packingIndexBuffer;     // host copy of m_packingIndex
+    shared_ptr<Matrix<ElemType>> m_packingIndex; // [1 x numSamples] minibatch column of each packed column
+
+    shared_ptr<Matrix<ElemType>> m_packedInput;
+    shared_ptr<Matrix<ElemType>> m_packedOutput;
+    shared_ptr<Matrix<ElemType>> m_packedOutputGradient;
+    shared_ptr<Matrix<ElemType>> m_packedInputGradient;
+    bool m_hasBackwardData; // m_packedInputGradient is valid for the current minibatch
+};
+
+template class OptimizedRNNStackNode<float>;
+template class OptimizedRNNStackNode<double>;
+
 #ifdef COMING_SOON
 
 // -----------------------------------------------------------------------
@@ -1069,6 +1355,9 @@ public:
         return false;
     }
 
+    // the boundary frames are determined per sequence from the whole time step
+    virtual bool SupportsSequenceRange() const override { return false; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         assert(m_inputs.size() == 2);
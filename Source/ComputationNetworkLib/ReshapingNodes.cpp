@@ -34,7 +34,7 @@ template <class ElemType>
     if (flags & CopyNodeFlags::copyNodeValue)
     {
         auto node = dynamic_pointer_cast<ReduceElementsNode<ElemType>>(nodeP);
-        node->m_axis        = m_axis;
+        node->m_axes        = m_axes;
         node->m_operation   = m_operation;
         node->m_reductionOp = m_reductionOp;
     }
@@ -44,7 +44,19 @@ template <class ElemType>
 /*virtual*/ void ReduceElementsNode<ElemType>::Load(File& fstream, size_t modelVersion) /*override*/
 {
     Base::Load(fstream, modelVersion);
-    fstream >> m_axis >> m_operation;
+    int axis;
+    fstream >> axis >> m_operation;
+    m_axes.assign(1, axis);
+    if (modelVersion >= CNTK_MODEL_VERSION_12)
+    {
+        size_t numAdditionalAxes;
+        fstream >> numAdditionalAxes;
+        for (size_t i = 0; i < numAdditionalAxes; i++)
+        {
+            fstream >> axis;
+            m_axes.push_back(axis);
+        }
+    }
     ValidateOp();
 }
 
@@ -52,7 +64,23 @@ template <class ElemType>
 /*virtual*/ void ReduceElementsNode<ElemType>::Save(File& fstream) const /*override*/
 {
     Base::Save(fstream);
-    fstream << m_axis << m_operation; // note: we serialize the string and not the opcode, since opcodes may change
+    fstream << m_axes.front() << m_operation; // note: we serialize the string and not the opcode, since opcodes may change
+    fstream << m_axes.size() - 1;             // the axes after the first one
+    for (size_t i = 1; i < m_axes.size(); i++)
+        fstream << m_axes[i];
+}
+
+template <class ElemType>
+/*static*/ std::vector<int> ReduceElementsNode<ElemType>::AxesFromConfig(const ScriptableObjects::ConfigValuePtr& axisArg)
+{
+    if (!axisArg.Is<ScriptableObjects::ConfigArray>())
+        return std::vector<int>{ (int)axisArg };
+    std::vector<int> axes;
+    ScriptableObjects::ConfigArrayPtr axesArray = axisArg;
+    const auto range = axesArray->GetIndexBeginEnd();
+    for (int i = range.first; i < range.second; i++)
+        axes.push_back((int)axesArray->At(i, [](const wstring&) { LogicError("ReduceElements: out of bounds index while iterating axes??"); }));
+    return axes;
 }
 
 template <class ElemType>
@@ -93,7 +121,7 @@ template <class ElemType>
             // Let: f(x, y, z) = log(exp x + exp y + exp z)
             // For the derivative we get:
             // df / dx = exp(x)/exp(f)
-            //         = exp(x  f)
+            //         = exp(x � f)
             sliceInputGrad.AddElementwiseProductWithExpOfDiffOf(sliceOutputGrad, input, output);
         }
         break;
@@ -183,12 +211,18 @@ template <class ElemType>
 
     let shape = Input(0)->GetSampleLayout();
     auto dims = shape.GetDims();
-    if (m_axis == 0)
-        dims = { 1 };                       // entire sample is reduced to a scalar
-    else if (m_axis - 1 >= 0 && m_axis - 1 < dims.size())
-        dims[m_axis - 1] = 1;               // one axis is reduced to a scalar
-    else if (isFinalValidationPass)
-        InvalidArgument("The shape of %ls [%s] has no axis %d", NodeDescription().c_str(), string(shape).c_str(), m_axis);
+    for (let axis : m_axes)
+    {
+        if (axis == 0)
+        {
+            dims = { 1 };                   // entire sample is reduced to a scalar
+            break;
+        }
+        else if (axis - 1 >= 0 && axis - 1 < dims.size())
+            dims[axis - 1] = 1;             // each axis is reduced to a scalar; the tensor op reduces over all of them at once
+        else if (isFinalValidationPass)
+            InvalidArgument("The shape of %ls [%s] has no axis %d", NodeDescription().c_str(), string(shape).c_str(), axis);
+    }
 
     SetDims(TensorShape(dims), Input(0)->HasMBLayout());
 }
@@ -230,8 +264,12 @@ template <class ElemType>
 {
     // gather all sequences
     let& inMBLayout = Input(0)->GetMBLayout();
-    let& input = Input(0)->Value();
     let& sequences = inMBLayout->GetAllSequences();
+    // The new MBLayout depends on the values, so they must come to the CPU. We read them with a single copy into
+    // a buffer of our own, which leaves the input where it is (element access would move it into BOTH state).
+    let& input = Input(0)->Value();
+    m_inputBuffer.resize(input.GetNumCols());
+    input.CopySection(1, input.GetNumCols(), m_inputBuffer.data(), 1);
     auto& indexSequences = m_indexSequenceBuffer;
     if (indexSequences.size() < sequences.size())
         indexSequences.resize(sequences.size());
@@ -243,16 +281,15 @@ template <class ElemType>
         auto& indexSequence = indexSequences[i];
         indexSequence.clear();
         for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
-            if (input(0, inMBLayout->GetColumnIndex(seq, t))) // this is the condition check that this node performs; the meat
+            if (m_inputBuffer[inMBLayout->GetColumnIndex(seq, t)]) // this is the condition check that this node performs; the meat
                 indexSequence.push_back(t);
-        // Note: The above accesses m_value directly on the CPU, putting it into BOTH state, possibly for other consumers as well.
     }
-    input.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
     // create a new MBLayout
     let& outMBLayout = GetMBLayout();
     outMBLayout->InitAsPackedSequences(SequenceLengthVector(sequences, indexSequences), /*temp*/m_placementBuffer, /*temp*/m_rowAllocationsBuffer);
     // copy to output
-    vector<ElemType> buf(outMBLayout->GetNumCols(), numeric_limits<ElemType>::quiet_NaN()); // STL cannot easily avoid initializing, so we might as well init with NaN for gaps
+    auto& buf = m_inputBuffer;
+    buf.assign(outMBLayout->GetNumCols(), numeric_limits<ElemType>::quiet_NaN()); // STL cannot easily avoid initializing, so we might as well init with NaN for gaps
     let size = min(sequences.size(), outMBLayout->GetAllSequences().size()); // no non-gap sequence has an index beyond this
     for (size_t i = 0; i < size; i++)
     {
@@ -268,9 +305,8 @@ template <class ElemType>
         assert(sequences[i].seqId == GAP_SEQUENCE_ID);
     for (size_t i = size; i < outMBLayout->GetAllSequences().size(); i++)
         assert(outMBLayout->GetAllSequences()[i].seqId == GAP_SEQUENCE_ID);
-    // the result will be kept in CPUDEVICE, since most likely we will access it again in PackedIndexNode
-    Value().TransferToDeviceIfNotThere(CPUDEVICE, /*isBeingMoved=*/ true, /*emptyTransfer=*/ true, /*updatePreferredDevice=*/ true);
-    Value().SetValue(1, outMBLayout->GetNumCols(), CPUDEVICE, buf.data(), MatrixFormat::matrixFormatColMajor);
+    // upload in one copy; the result stays on our device, where PackedIndexNode and GatherPacked/ScatterPacked read it
+    Value().SetValue(1, outMBLayout->GetNumCols(), GetDeviceId(), buf.data(), MatrixFormat::matrixFormatColMajor);
 }
 
 template <class ElemType>
@@ -310,8 +346,14 @@ template <class ElemType>
 {
     let& sourceMBLayout = Input(SOURCEDATA)->GetMBLayout(); // only used for index conversion
     let& indexMBLayout  = Input(INDEXDATA)->GetMBLayout();
-    let&  index  = Input(INDEXDATA)->Value(); // per-seq index values that are to be mapped
-    auto& result =                   Value(); // packed index values as mapped to sourceData's layout
+    // Like in WhereNode, the index values are mapped on the CPU, in buffers of our own, such that neither the input
+    // nor the result change their device; the result is uploaded in one copy.
+    let& indexMatrix = Input(INDEXDATA)->Value();
+    m_indexBuffer.resize(indexMatrix.GetNumCols());
+    indexMatrix.CopySection(1, indexMatrix.GetNumCols(), m_indexBuffer.data(), 1);
+    let&  index  = m_indexBuffer;  // per-seq index values that are to be mapped
+    auto& result = m_resultBuffer; // packed index values as mapped to sourceData's layout
+    result.assign(indexMatrix.GetNumCols(), numeric_limits<ElemType>::quiet_NaN()); // (gaps are masked by the consumer)
     // loop over sourceSequences
     // Input matrix contains time indices for each sequence that refer to frames inside that sequence.
     // We replace every per-sequence index by the resolved column index w.r.t. the same MBLayout.
@@ -325,13 +367,12 @@ template <class ElemType>
         for (size_t tIndex = 0; tIndex < indexSeq.GetNumTimeSteps(); tIndex++) // map all index values in index sequence
         {
             let jIndex  = indexMBLayout->GetColumnIndex(indexSeq, tIndex);    // map time index to actual location in the matrix storage object
-            let tSource = (size_t)index(0, jIndex);                           // the new time location (relative to source sequence)
+            let tSource = (size_t)index[jIndex];                              // the new time location (relative to source sequence)
             let jSource = sourceMBLayout->GetColumnIndex(sourceSeq, tSource); // map new time index as well. This performs a range check.
-            result(0, jIndex) = (ElemType)jSource;
+            result[jIndex] = (ElemType)jSource;
         }
     }
-    // Note: maybe this is no longer needed, now that we do the same inside UpdateFunctionValueSize() for all nodes.
-    result.CollapseDataLocation(); // BUGBUG: Move back, since BOTH state is broken at present.
+    Value().SetValue(1, result.size(), GetDeviceId(), result.data(), MatrixFormat::matrixFormatColMajor);
 }
 
 template <class ElemType>
@@ -471,4 +512,74 @@ template <class ElemType>
 template class ScatterPackedNode<float>;
 template class ScatterPackedNode<double>;
 
+// -----------------------------------------------------------------------
+// ContextWindowNode (input, leftContext, rightContext) -- splice neighbor frames
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+/*virtual*/ void ContextWindowNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    let& pMBLayout = Input(0)->GetMBLayout();
+    let  numCols = pMBLayout->GetNumCols();
+    let  numParallelSequences = pMBLayout->GetNumParallelSequences();
+    let  numTimeSteps = pMBLayout->GetNumTimeSteps();
+    let  windowSize = m_leftContext + 1 + m_rightContext;
+
+    // Build the packed index on the host. Each output column j is seen as windowSize columns
+    // of the input dimension, column j * windowSize + k is taken from input frame t - leftContext + k,
+    // clamped to the frames of its sequence within this minibatch.
+    // Gap columns refer to themselves, so that their (undefined) values stay within the gaps.
+    m_packedIndexBuffer.resize(numCols * windowSize);
+    for (size_t j = 0; j < numCols; j++)
+        for (size_t k = 0; k < windowSize; k++)
+            m_packedIndexBuffer[j * windowSize + k] = (ElemType)j;
+    for (let& seq : pMBLayout->GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+        let tBegin = (ptrdiff_t)max(seq.tBegin, (ptrdiff_t)0);
+        let tLast  = (ptrdiff_t)min(seq.tEnd, numTimeSteps) - 1;
+        for (ptrdiff_t t = tBegin; t <= tLast; t++)
+        {
+            let j = t * numParallelSequences + seq.s;
+            for (size_t k = 0; k < windowSize; k++)
+            {
+                let tIn = min(max(t + (ptrdiff_t)k - (ptrdiff_t)m_leftContext, tBegin), tLast);
+                m_packedIndexBuffer[j * windowSize + k] = (ElemType)(tIn * numParallelSequences + seq.s);
+            }
+        }
+    }
+    m_packedIndex->SetValue(1, m_packedIndexBuffer.size(), m_packedIndex->GetDeviceId(), m_packedIndexBuffer.data());
+
+    // gather all frames of all windows at once, viewing the output as columns of the input dimension
+    let& input = Input(0)->Value();
+    auto output = Value().Reshaped(input.GetNumRows(), numCols * windowSize);
+    output.DoGatherColumnsOf(/*beta=*/0, *m_packedIndex, input, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void ContextWindowNode<ElemType>::BackpropToNonLooping(size_t /*inputIndex*/) /*override*/
+{
+    // each input frame receives the gradient of every window position it was copied to
+    auto& inputGradient = Input(0)->Gradient();
+    let   outputGradient = Gradient().Reshaped(inputGradient.GetNumRows(), m_packedIndex->GetNumCols());
+    inputGradient.DoScatterColumnsOf(/*beta=*/1, *m_packedIndex, outputGradient, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void ContextWindowNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass && !HasMBLayout())
+        InvalidArgument("%ls %ls operation requires its input to be a sequence (must have an MBLayout).", NodeName().c_str(), OperationName().c_str());
+
+    // the window is stacked into a vector
+    SetDims(TensorShape(Input(0)->GetSampleLayout().GetNumElements() * (m_leftContext + 1 + m_rightContext)), HasMBLayout());
+}
+
+template class ContextWindowNode<float>;
+template class ContextWindowNode<double>;
+
 }}}
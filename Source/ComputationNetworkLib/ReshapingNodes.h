@@ -194,16 +194,24 @@ class ReduceElementsNode : public ComputationNode<ElemType>, public NumInputs<1>
     static const std::wstring TypeName() { return L"ReduceElements"; }
 
     void ValidateOp();
+    static std::vector<int> AxesFromConfig(const ScriptableObjects::ConfigValuePtr& axisArg);
 public:
-    ReduceElementsNode(DEVICEID_TYPE deviceId, const wstring& name, const std::wstring& operation = std::wstring(), int axis = 0) :
-        Base(deviceId, name), m_operation(operation), m_axis(axis), m_reductionOp((ElementWiseOperator)-1/*invalid*/)
+    // 'axes' are 1-based; multiple axes are reduced in a single operation; axis 0 reduces the entire sample
+    ReduceElementsNode(DEVICEID_TYPE deviceId, const wstring& name, const std::wstring& operation, const std::vector<int>& axes) :
+        Base(deviceId, name), m_operation(operation), m_axes(axes.empty() ? std::vector<int>{ 0 } : axes), m_reductionOp((ElementWiseOperator)-1/*invalid*/)
     {
         if (!m_operation.empty()) // verify validity already here out of courtesy (would otherwise be caught in Validate())
             ValidateOp();
     }
 
+    ReduceElementsNode(DEVICEID_TYPE deviceId, const wstring& name, const std::wstring& operation = std::wstring(), int axis = 0) :
+        ReduceElementsNode(deviceId, name, operation, std::vector<int>{ axis })
+    {
+    }
+
+    // 'axis' may be a single axis or an array of axes
     ReduceElementsNode(const ScriptableObjects::IConfigRecordPtr configp) :
-        ReduceElementsNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"reductionOp"), configp->Get(L"axis"))
+        ReduceElementsNode(configp->Get(L"deviceId"), L"<placeholder>", (const std::wstring&)configp->Get(L"reductionOp"), AxesFromConfig(configp->Get(L"axis")))
     {
         AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
     }
@@ -218,7 +226,7 @@ public:
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override;
 
 private:
-    int m_axis;
+    std::vector<int> m_axes;  // the axes to reduce (1-based, 0 means all)
     std::wstring m_operation; // the operation as a string, e.g. "Sum", see ValidateOp()
     ElementWiseOperator m_reductionOp; // the reduction operation mapped to our internal opCode
 };
@@ -284,6 +292,69 @@ public:
 template class ReconcileDynamicAxisNode<float>;
 template class ReconcileDynamicAxisNode<double>;
 
+// -----------------------------------------------------------------------
+// DeviceTransfer (input)
+// Identity whose output lives on the node's own device, which may differ from that of its input. Inserted by
+// ComputationNetwork::PlaceInPipelineStages() where an edge crosses from one pipeline stage (GPU) to the next.
+// The value is copied peer-to-peer in ForwardProp(), the gradient is copied back in BackpropTo().
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class DeviceTransferNode : public ComputationNode<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNode<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"DeviceTransfer"; }
+
+public:
+    DeclareConstructorFromConfigWithNumInputs(DeviceTransferNode);
+    DeviceTransferNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        ValueFor(fr).AssignValuesOf(Input(0)->ValueFor(fr));
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        assert(inputIndex == 0); inputIndex;
+        // bring the gradient over first; adding it directly would move our gradient to the input's device
+        m_gradientOnInputDevice->Resize(Gradient());
+        auto gradient = DataWithMBLayoutFor(*m_gradientOnInputDevice, fr, m_pMBLayout);
+        gradient.AssignValuesOf(GradientFor(fr));
+        Input(0)->GradientFor(fr) += gradient;
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        ValidateUnaryMap(isFinalValidationPass);
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        if (!m_gradientOnInputDevice)
+            m_gradientOnInputDevice = matrixPool.Request<ElemType>(Input(0)->GetDeviceId(), GetSampleLayout().GetNumElements());
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gradientOnInputDevice, matrixPool);
+    }
+
+private:
+    shared_ptr<Matrix<ElemType>> m_gradientOnInputDevice;
+};
+
+template class DeviceTransferNode<float>;
+template class DeviceTransferNode<double>;
+
 // -----------------------------------------------------------------------
 // SliceNode (input)
 // This node extracts a slice of the first tensor dimension (row).
@@ -351,10 +422,43 @@ private:
         return inputSlice;
     }
 
+    // A slice along the last axis of an input without MBLayout is a range of columns of the input's matrix.
+    // If the input is a leaf (e.g. a parameter, whose value persists), our value is then a view on that range
+    // instead of a copy. Such a value must not go to the matrix pool, and must not be resized (which in debug
+    // builds also overwrites it with NaNs).
+    bool IsValueViewOfInput() const
+    {
+        let& inputLayout = Input(0)->GetSampleLayout();
+        return !Input(0)->HasMBLayout() && Input(0)->IsLeaf() &&
+               inputLayout.GetRank() >= 2 && m_axis == inputLayout.GetRank() &&
+               Input(0)->ValuePtr() && Input(0)->Value().GetMatrixType() == DENSE;
+    }
+
+    void AssignValueViewOfInput()
+    {
+        size_t numColsPerIndex = Input(0)->Value().GetNumCols() / Input(0)->GetSampleLayout()[m_axis - 1];
+        Value().AssignColumnSlice(Input(0)->Value(), BeginIndex() * numColsPerIndex, (EndIndex() - BeginIndex()) * numColsPerIndex);
+    }
+
 public:
 
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
+    {
+        if (!IsValueViewOfInput())
+            return Base::BeginForwardProp();
+
+        // as ComputationNode::BeginForwardProp(), but pointing the value to the input instead of resizing it
+        ComputationNodeBase::BeginForwardProp();
+        AssignValueViewOfInput();
+        UpdateFunctionMBSize();
+        VerifyDataSize(Value());
+    }
+
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        if (IsValueViewOfInput())
+            return; // value is a view on the input, see BeginForwardProp()
+
         size_t rank = DetermineElementwiseTensorRank();
         auto output =                                ValueTensorFor(           rank, fr);
         let   input = TensorView<ElemType>(Input(0)->ValuePtr(), GetInputSlice(rank, fr.AllowBroadcast()));
@@ -390,6 +494,10 @@ public:
             sampleLayout.NarrowTo(m_axis - 1, BeginIndex(), EndIndex());
 
         SetDims(TensorShape(sampleLayout.GetDims()), HasMBLayout());
+
+        // a value that is a view on the input's value must be kept out of the matrix pool (and out of recomputation)
+        if (isFinalValidationPass && IsValueViewOfInput())
+            MarkValueNonSharable();
     }
 
 private:
@@ -670,6 +778,7 @@ private:
     std::vector<std::vector<size_t>>   m_indexSequenceBuffer; // [sequenceIndex][t] for creating the result sequences
     std::vector<size_t>               m_rowAllocationsBuffer; // [row] for determining new MBLayout packing
     std::vector<std::pair<size_t, size_t>> m_placementBuffer; // [sequenceIndex] assigned location for a sequence
+    std::vector<ElemType>                        m_inputBuffer; // [column] CPU copy of the condition, then of the result
 };
 
 // -----------------------------------------------------------------------
@@ -705,6 +814,11 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
     virtual void Validate(bool isFinalValidationPass) override;
+
+private:
+    // CPU copies of the index values and of the result (kept as object state to avoid memory allocations)
+    std::vector<ElemType> m_indexBuffer;
+    std::vector<ElemType> m_resultBuffer;
 };
 
 // -----------------------------------------------------------------------
@@ -773,6 +887,90 @@ public:
     virtual void Validate(bool isFinalValidationPass) override;
 };
 
+// -----------------------------------------------------------------------
+// ContextWindowNode (input, leftContext=5, rightContext=5) -- splice neighbor frames
+// Stacks the frames t-leftContext..t+rightContext of each sequence into one column,
+// i.e. the sample dimension grows by a factor of leftContext+1+rightContext.
+// Frames beyond the sequence boundaries replicate the first/last frame, like
+// the context expansion of the HTK readers, so that readers can deliver unspliced
+// frames and the window is built on the device instead.
+// The source column of each output frame is looked up from the MBLayout into a
+// packed index, and the data is copied with a single Gather (Scatter for the gradient).
+// Sequences that extend beyond the minibatch are clamped to the frames within it.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class ContextWindowNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"ContextWindow"; }
+
+public:
+    ContextWindowNode(DEVICEID_TYPE deviceId, const wstring& name, size_t leftContext = 5, size_t rightContext = 5)
+        : Base(deviceId, name), m_leftContext(leftContext), m_rightContext(rightContext)
+    {
+    }
+    ContextWindowNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : ContextWindowNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"leftContext"), configp->Get(L"rightContext"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<ContextWindowNode<ElemType>>(nodeP);
+            node->m_leftContext = m_leftContext;
+            node->m_rightContext = m_rightContext;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_leftContext << m_rightContext;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_leftContext >> m_rightContext;
+    }
+
+    virtual std::string FormatOperationPrototype(const std::string& extraArgs) const override
+    {
+        return Base::FormatOperationPrototype(extraArgs + msra::strfun::strprintf(", leftContext=%lu, rightContext=%lu", m_leftContext, m_rightContext));
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override;
+
+    // the packed index is computed in ForwardProp and reused in BackProp
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_packedIndex, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_packedIndex, matrixPool);
+    }
+
+private:
+    size_t m_leftContext;
+    size_t m_rightContext;
+
+    shared_ptr<Matrix<ElemType>> m_packedIndex; // [0, j * windowSize + k] source column of frame k of the window of column j
+    std::vector<ElemType> m_packedIndexBuffer;  // host copy of m_packedIndex (kept as object state to avoid memory allocations)
+};
+
 // -----------------------------------------------------------------------
 // DiagonalNode -- extract diagonal elements of a square matrix into a row vector
 // -----------------------------------------------------------------------
@@ -259,7 +259,7 @@ public:
         if (colsPrior == 1)
         {
             ForwardPropS(sliceOutputValue, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(), sliceFeature,
-                         *m_prior, *m_stddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
+                         *m_prior, *m_stddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior);
         }
         else if (colsPrior == numSamples)
         {
@@ -271,22 +271,17 @@ public:
             Matrix<ElemType> sliceStddev = DataFor(*m_stddev, fr);
 
             ForwardPropS(sliceOutputValue, sliceUnnormedPrior, sliceMean, sliceLogstddev, sliceFeature,
-                         slicePrior, sliceStddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior, *m_temp);
+                         slicePrior, sliceStddev, sliceNormedDeviationVectors, sliceNormedDeviation, slicePosterior);
         }
         else // should not reach the code since validation should fail already
             RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
     }
 
     // input0=unnormedPrior, input1=mean, input2=logstddev, input3=feature
-    // If we want to speed up we need to replace following code with a several specialized GPU functions
     /*TODO: merge with call site*/ void ForwardPropS(Matrix<ElemType>& functionValues, const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, Matrix<ElemType>& logstddev,
                                                      const Matrix<ElemType>& feature, Matrix<ElemType>& prior, Matrix<ElemType>& stddev, Matrix<ElemType>& normedDeviationVectors,
-                                                     Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
+                                                     Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior)
     {
-        int numComponent = unnormedPrior.GetNumRows();
-        size_t numSamples = feature.GetNumCols();
-        size_t featureDim = feature.GetNumRows();
-
         // compute prior which is softmax of unnormedPrior
         prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior
 
@@ -304,46 +299,11 @@ public:
         stddev.Print("stddev", 0, min(5, stddev.GetNumRows() - 1), 0, min(10, stddev.GetNumCols() - 1));
 #endif
 
-        // compute normedDeviation <-- ||x-u_c||^2/(stddev^2)
-        normedDeviationVectors.AssignRepeatOf(feature, numComponent, 1);
-        normedDeviationVectors -= mean;                                        // each column of the mean has multiple mean components
-        normedDeviationVectors.Reshape(featureDim, numSamples * numComponent); // now each column is feature-mean_i
-
-        normedDeviation.AssignVectorNorm2Of(normedDeviationVectors, true);
-        normedDeviation ^= 2;
-        temp.AssignRepeatOf(stddev, 1, numSamples / stddev.GetNumCols()); // stddev.GetNumCols() is either 1 or =numSamples
-        temp.Reshape(1, temp.GetNumElements());                           // one stddev value for each component for each sample
-        temp ^= 2;
-        normedDeviation.ElementDivideBy(temp); // normedDeviation and temp have same dim (1, numSamples* numComponent)
-
-        // compute  normedDeviationVectors <-- (x-u_c)/(stddev^2)
-        normedDeviationVectors.RowElementDivideBy(temp);                       // divide twice
-        normedDeviationVectors.Reshape(featureDim * numComponent, numSamples); // reshape back
-
-        // compute per-component likelihood
-        posterior.AssignProductOf(-0.5f, normedDeviation); // posterior  <-- -||x-u_c||^2/(stddev^2)/2 and in (1, numSamples* numComponent) dim
-        temp.InplaceLog();
-        temp *= ((ElemType) numComponent / 2.0f);                   // temp <-- stddev^c and in (1, numSamples* numComponent) dim
-        posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^c)
-        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // likelihood for each component and sample is now computed and stored in posterior
-        posterior.InplaceExp();                                     // posterior  <-- exp(-||x-u_c||^2/(stddev^2)/2)
-
-        normedDeviation.Reshape(numComponent, numSamples); // reshape back
-        posterior.Reshape(numComponent, numSamples);       // reshape back
-
-        // compute posterior <-- prior_i * likelihood_i
-        if (unnormedPrior.GetNumCols() == numSamples) // each sample has different prior
-            posterior.ElementMultiplyWith(prior);
-        else // all samples share the same prior
-            posterior.ColumnElementMultiplyWith(prior);
-
-        // compute GMM log-likelihood
-        Matrix<ElemType>::Multiply(ConstOnes(1, numComponent, posterior.GetDeviceId()), false, posterior, false, functionValues); // functionValues <-- total likelihood
-        posterior.RowElementDivideBy(functionValues);                                                                             // posterior <-- per-comp likelihood / total likelihood
-        functionValues.InplaceLog();                                                                                              // log likelihood
+        // compute normedDeviationVectors <-- (x-u_c)/(stddev^2), normedDeviation <-- ||x-u_c||^2/(stddev^2),
+        // the posteriors of the components, and the GMM log-likelihood as the log-sum-exp of the component log-likelihoods in one pass
+        functionValues.AssignGMMLogLikelihoodOf(prior, mean, stddev, feature, normedDeviationVectors, normedDeviation, posterior);
 
 #if DUMPOUTPUT
-        temp.Print("temp", 0, min(5, temp.GetNumRows() - 1), 0, min(10, temp.GetNumCols() - 1));
         normedDeviation.Print("normedDeviation", 0, min(5, normedDeviation.GetNumRows() - 1), 0, min(10, normedDeviation.GetNumCols() - 1));
 
         posterior.Print("posterior", 0, min(5, posterior.GetNumRows() - 1), 0, min(10, posterior.GetNumCols() - 1));
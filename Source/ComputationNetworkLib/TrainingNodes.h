@@ -15,6 +15,9 @@
 #include <stdexcept>
 #include <list>
 #include <memory>
+#include <random>
+#include <set>
+#include <unordered_map>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -103,6 +106,11 @@ template class SquareErrorNode<double>;
 // -----------------------------------------------------------------------
 // CrossEntropyWithSoftmaxNode (labels, prediction)
 // calculates: -sum(left_i * log(softmax_i(right)))
+// With dense labels, the only intermediate kept for the gradient is the log-sum-exp of each column of the
+// prediction; the criterion is computed from it as sum_j (logSumExp_j * sum_i left_ij - sum_i left_ij * right_ij),
+// and the gradient as exp(right - logSumExp) - left, by tensor operations that reduce over or broadcast along the
+// columns, without softmax-sized temporaries. Sparse labels, which the tensor library does not take, go through
+// the explicit (log-)softmax.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -128,6 +136,14 @@ public:
         // left input is scalar
         if (inputIndex == 0) // left derivative
         {
+            if (UseFusedComputation())
+            {
+                // -gradient * logSoftmax = gradient * (logSumExp - right)
+                auto gradient = Tensor2DOf(Input(0)->GradientPtr());
+                gradient.AddElementwiseProductOf(Tensor2DOf(GradientPtr()), Tensor2DOf(Input(1)->ValuePtr()), -1);
+                gradient.AddElementwiseProductOf(Tensor2DOf(GradientPtr()), Tensor2DOf(m_logSumExpOfRight), 1);
+                return;
+            }
 #if DUMPOUTPUT
             m_logSoftmaxOfRight->Print("CrossEntropyWithSoftmax Partial-logSoftmaxOfRight");
             Gradient().Print("CrossEntropyWithSoftmax Partial-gradientValues");
@@ -143,6 +159,17 @@ public:
 
         else if (inputIndex == 1) // right derivative
         {
+            if (UseFusedComputation())
+            {
+                // gradient * (softmax - left) = gradient * exp(right - logSumExp) - gradient * left
+                auto gradient = Tensor2DOf(Input(1)->GradientPtr());
+                gradient.AddElementwiseProductWithExpOfDiffOf(Tensor2DOf(GradientPtr()), Tensor2DOf(Input(1)->ValuePtr()), Tensor2DOf(m_logSumExpOfRight));
+                gradient.AddElementwiseProductOf(Tensor2DOf(GradientPtr()), Tensor2DOf(Input(0)->ValuePtr()), -1);
+#ifdef _DEBUG
+                Input(1)->InvalidateMissingGradientColumns(fr); // TODO: This should not be necessary.
+#endif
+                return;
+            }
 #if DUMPOUTPUT
             m_softmaxOfRight->Print("CrossEntropyWithSoftmax Partial-softmaxOfRight");
             Input(0)->ValueFor(fr).Print("CrossEntropyWithSoftmax Partial-inputFunctionValues");
@@ -168,24 +195,52 @@ public:
 
     virtual void UpdateFunctionMBSize() override
     {
-        m_logSoftmaxOfRight->Resize(Input(1)->Value());
-        m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
+        if (UseFusedComputation())
+        {
+            m_logSumExpOfRight->Resize(1, Input(1)->Value().GetNumCols());
+            m_crossEntropyPerColumn->Resize(*m_logSumExpOfRight);
+        }
+        else
+        {
+            m_logSoftmaxOfRight->Resize(Input(1)->Value());
+            m_softmaxOfRight->Resize(*m_logSoftmaxOfRight);
+        }
     }
 
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        // first compute the softmax (column-wise)
-        // Note that we need both log and non-log for gradient computation.
-        m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
-        // BUGBUG: No need to compute m_softmaxOfRight in ForwardProp, should be moved to BackpropTo().
-        m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-        m_softmaxOfRight->InplaceExp();
-        // flatten all gaps to zero, such that gaps will contribute zero to the sum
-        MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
-        // reduce over all frames
-        Value().AssignInnerProductOfMatrices(Input(0)->MaskedValueFor(fr), *m_logSoftmaxOfRight);
-        Value() *= -1;
+        if (UseFusedComputation())
+        {
+            auto labels = Tensor2DOf(Input(0)->ValuePtr());
+            auto prediction = Tensor2DOf(Input(1)->ValuePtr());
+            auto logSumExp = Tensor2DOf(m_logSumExpOfRight);
+            auto crossEntropyPerColumn = Tensor2DOf(m_crossEntropyPerColumn);
+            // log-sum-exp of each column of the prediction, kept for the gradient
+            logSumExp.DoUnaryOpOf(0, prediction, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opLogSum);
+            // per column: logSumExp * sum(left) - sum(left .* right)
+            crossEntropyPerColumn.AssignCopyOf(labels);
+            crossEntropyPerColumn.AssignElementwiseProductOf(crossEntropyPerColumn, logSumExp);
+            crossEntropyPerColumn.AddElementwiseProductOf(labels, prediction, -1);
+            // flatten all gaps to zero, such that gaps will contribute zero to the sum
+            MaskMissingColumnsToZero(*m_crossEntropyPerColumn, Input(1)->GetMBLayout(), fr);
+            // reduce over all frames
+            Tensor2DOf(ValuePtr()).AssignCopyOf(crossEntropyPerColumn);
+        }
+        else
+        {
+            // first compute the softmax (column-wise)
+            // Note that we need both log and non-log for gradient computation.
+            m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
+            // BUGBUG: No need to compute m_softmaxOfRight in ForwardProp, should be moved to BackpropTo().
+            m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
+            m_softmaxOfRight->InplaceExp();
+            // flatten all gaps to zero, such that gaps will contribute zero to the sum
+            MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
+            // reduce over all frames
+            Value().AssignInnerProductOfMatrices(Input(0)->MaskedValueFor(fr), *m_logSoftmaxOfRight);
+            Value() *= -1;
+        }
 #if NANCHECK
         Value().HasNan("CrossEntropyWithSoftmax");
 #endif
@@ -205,6 +260,7 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = dynamic_pointer_cast<CrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
+            node->m_logSumExpOfRight->SetValue(*m_logSumExpOfRight);
             node->m_logSoftmaxOfRight->SetValue(*m_logSoftmaxOfRight);
             node->m_softmaxOfRight->SetValue(*m_softmaxOfRight);
         }
@@ -214,13 +270,36 @@ public:
     virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
     {
         Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_logSumExpOfRight, matrixPool);
+        RequestMatrixFromPool(m_crossEntropyPerColumn, matrixPool);
         RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
         RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
     }
 
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_crossEntropyPerColumn, matrixPool);
+    }
+
+private:
+    bool UseFusedComputation() const
+    {
+        return Input(0)->Value().GetMatrixType() == DENSE;
+    }
+
+    // [rows x cols] view of a matrix, to broadcast [1 x cols] and [1 x 1] operands along the columns and rows
+    static TensorView<ElemType> Tensor2DOf(const MatrixBasePtr& matrixPtr)
+    {
+        const auto& matrix = dynamic_cast<const Matrix<ElemType>&>(*matrixPtr);
+        return TensorView<ElemType>(matrixPtr, TensorShape(matrix.GetNumRows(), matrix.GetNumCols()));
+    }
+
 protected:
-    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
-    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_logSumExpOfRight;      // [1 x T] (dense labels)
+    shared_ptr<Matrix<ElemType>> m_crossEntropyPerColumn; // [1 x T] (dense labels, forward only)
+    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;     // (sparse labels)
+    shared_ptr<Matrix<ElemType>> m_softmaxOfRight;        // (sparse labels)
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -678,6 +757,362 @@ private:
 template class NoiseContrastiveEstimationNode<float>;
 template class NoiseContrastiveEstimationNode<double>;
 
+// -----------------------------------------------------------------------
+// SampledCrossEntropyWithSoftmaxNode (labels, input, inputWeights, biasWeights)
+// Cross entropy with a softmax over a sample of the classes, for training with large vocabularies.
+//  - labels: one-hot labels in [vocab_size x T], dense or sparse
+//  - input: hidden layer activity in [hdsize x T]
+//  - inputWeights: output weight matrix in [hdsize x vocab_size], one column per class (as for NoiseContrastiveEstimationNode)
+//  - biasWeights: output bias in [vocab_size]
+// In training, the softmax is taken over the candidate classes of the minibatch: the classes of all its labels, and numSamples
+// distinct classes drawn once per minibatch (shared negatives) from a log-uniform (Zipfian, for frequency-sorted vocabularies) or
+// uniform distribution. The logit of each candidate is corrected by the log of its expected count under the sampler. Only the
+// weight columns and biases of the candidates are read, and only they receive a gradient.
+// In evaluation and inference, the full softmax is used, so that the criterion is the regular cross entropy.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SampledCrossEntropyWithSoftmaxNode : public ComputationNodeNonLooping /*ComputationNode*/<ElemType>, public NumInputs<4>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName()
+    {
+        return L"SampledCrossEntropyWithSoftmax";
+    }
+
+public:
+    SampledCrossEntropyWithSoftmaxNode(DEVICEID_TYPE deviceId, const wstring& name, size_t numSamples = 0, const wstring& sampler = L"logUniform")
+        : Base(deviceId, name), m_numSamples(numSamples), m_sampler(sampler), m_isSampled(false), m_needRecomputeGradientOfLogits(false)
+    {
+        VerifySampler();
+        m_randomSeed = (unsigned long) CreateUniqId();
+        m_rng.seed(m_randomSeed);
+    }
+    SampledCrossEntropyWithSoftmaxNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SampledCrossEntropyWithSoftmaxNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"numSamples"),
+                                             configp->Exists(L"sampler") ? (const wstring&) configp->Get(L"sampler") : wstring(L"logUniform"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_numSamples << m_sampler;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_numSamples >> m_sampler;
+        VerifySampler();
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<SampledCrossEntropyWithSoftmaxNode<ElemType>>(nodeP);
+            node->m_numSamples = m_numSamples;
+            node->m_sampler = m_sampler;
+            node->m_randomSeed = m_randomSeed;
+            node->m_rng.seed(m_randomSeed);
+        }
+    }
+
+    void SetRandomSeed(const unsigned long val)
+    {
+        m_randomSeed = val;
+        m_rng.seed(m_randomSeed);
+    }
+
+    virtual void BackpropToNonLooping(size_t inputIndex) override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        if (inputIndex == 0)
+            InvalidArgument("%ls %ls operation cannot compute the gradient for its labels.", NodeName().c_str(), OperationName().c_str());
+
+        // gradient of the criterion w.r.t. the candidate logits: softmax - labels, for all inputs
+        if (m_needRecomputeGradientOfLogits)
+        {
+            m_gradientOfLogits->AssignExpOf(*m_logSoftmaxOfLogits);
+            Matrix<ElemType>::ScaleAndAdd(-1, CandidateLabels(fr), *m_gradientOfLogits);
+            MaskMissingColumnsToZero(*m_gradientOfLogits, Input(0)->GetMBLayout(), fr);
+            Matrix<ElemType>::Scale(Gradient() /*1x1*/, *m_gradientOfLogits);
+            m_needRecomputeGradientOfLogits = false;
+        }
+
+        if (inputIndex == 1) // hidden: candidateWeights * gradientOfLogits
+        {
+            auto gradient = Input(1)->GradientFor(fr);
+            Matrix<ElemType>::MultiplyAndAdd(CandidateWeights(), false, *m_gradientOfLogits, false, gradient);
+        }
+        else if (inputIndex == 2) // weights: hidden * gradientOfLogits^T, into the columns of the candidates
+        {
+            auto hidden = Input(1)->MaskedValueFor(fr);
+            if (m_isSampled)
+            {
+                m_gradientOfCandidateWeights->AssignProductOf(hidden, false, *m_gradientOfLogits, true);
+                Input(2)->GradientAsMatrix().DoScatterColumnsOf(1, *m_candidateIds, *m_gradientOfCandidateWeights, 1);
+            }
+            else
+                Matrix<ElemType>::MultiplyAndAdd(hidden, false, *m_gradientOfLogits, true, Input(2)->GradientAsMatrix());
+        }
+        else if (inputIndex == 3) // bias: row sums of gradientOfLogits, into the candidates
+        {
+            Matrix<ElemType>::VectorSum(*m_gradientOfLogits, *m_gradientOfCandidateOffsets, /*isColWise=*/false);
+            auto gradient = Input(3)->GradientAsMatrix().Reshaped(1, NumClasses());
+            if (m_isSampled)
+                gradient.DoScatterColumnsOf(1, *m_candidateIds, m_gradientOfCandidateOffsets->Reshaped(1, NumCandidates()), 1);
+            else
+                gradient += m_gradientOfCandidateOffsets->Reshaped(1, NumCandidates());
+        }
+    }
+
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t childIndex) const override { return childIndex != 3; }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
+    {
+        FrameRange fr(Input(0)->GetMBLayout());
+        m_isSampled = Environment().IsTraining();
+        if (m_isSampled)
+        {
+            SampleCandidates(fr);
+            m_candidateWeights->DoGatherColumnsOf(0, *m_candidateIds, Input(2)->ValueAsMatrix(), 1);
+            m_candidateOffsets->DoGatherColumnsOf(0, *m_candidateIds, Input(3)->ValueAsMatrix().Reshaped(1, NumClasses()), 1);
+            *m_candidateOffsets -= *m_logExpectedCounts; // correction for the sampling
+        }
+        auto candidateWeights = CandidateWeights();
+        auto candidateOffsets = CandidateOffsets(); // [1 x numCandidates]
+        auto candidateLabels = CandidateLabels(fr);
+        auto hidden = Input(1)->MaskedValueFor(fr);
+
+        // logits of the candidates, and their log softmax
+        m_logits->AssignProductOf(candidateWeights, true, hidden, false);
+        Matrix<ElemType>::ScaleAndAdd(1, candidateOffsets.Reshaped(NumCandidates(), 1), *m_logits);
+        m_logSoftmaxOfLogits->AssignLogSoftmaxOf(*m_logits, true);
+
+        // criterion per column: log sum exp of the logits (= logit - log softmax, of any row) - logit of the label
+        m_criterionPerColumn->AssignRowSliceValuesOf(*m_logits, 0, 1);
+        m_labelLogits->AssignRowSliceValuesOf(*m_logSoftmaxOfLogits, 0, 1);
+        *m_criterionPerColumn -= *m_labelLogits;
+        m_labelWeights->AssignProductOf(candidateWeights, false, candidateLabels, false);
+        m_labelLogits->AssignInnerProductOf(*m_labelWeights, hidden, true);
+        Matrix<ElemType>::MultiplyAndAdd(candidateOffsets, false, candidateLabels, false, *m_labelLogits);
+        *m_criterionPerColumn -= *m_labelLogits;
+        MaskMissingColumnsToZero(*m_criterionPerColumn, Input(0)->GetMBLayout(), fr);
+        Value().AssignSumOfElements(*m_criterionPerColumn);
+        m_needRecomputeGradientOfLogits = true;
+#if NANCHECK
+        Value().HasNan("SampledCrossEntropyWithSoftmax");
+#endif
+    }
+
+    // a replay would repeat the candidates of the captured minibatch
+    virtual bool IsReplayable() const override { return !Environment().IsTraining(); }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        m_pMBLayout = nullptr; // this node does not hold mini-batch data
+
+        if (isFinalValidationPass)
+        {
+            if (!Input(0)->HasMBLayout() || !Input(1)->HasMBLayout() || Input(2)->HasMBLayout() || Input(3)->HasMBLayout())
+                InvalidArgument("%ls: Inputs 0 and 1 must be minibatches, and inputs 2 and 3 must not.", NodeDescription().c_str());
+            if (Input(0)->GetMBLayout() != Input(1)->GetMBLayout())
+                InvalidArgument("%ls: Labels and input must have the same dynamic axes.", NodeDescription().c_str());
+            if (Input(1)->GetSampleMatrixNumRows() != Input(2)->GetAsMatrixNumRows())
+                InvalidArgument("%ls: The input dimension (%d) does not match the number of rows of the weights (%d).",
+                                NodeDescription().c_str(), (int) Input(1)->GetSampleMatrixNumRows(), (int) Input(2)->GetAsMatrixNumRows());
+            if (Input(0)->GetSampleMatrixNumRows() != NumClasses() || Input(3)->GetSampleLayout().GetNumElements() != NumClasses())
+                InvalidArgument("%ls: The label and bias dimensions must match the number of columns of the weights (%d).", NodeDescription().c_str(), (int) NumClasses());
+            if (m_numSamples == 0 || m_numSamples >= NumClasses())
+                InvalidArgument("%ls: numSamples must be greater than 0 and less than the number of classes (%d).", NodeDescription().c_str(), (int) NumClasses());
+        }
+
+        SetDims(TensorShape(1), false);
+    }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_logits, matrixPool);
+        RequestMatrixFromPool(m_logSoftmaxOfLogits, matrixPool);
+        RequestMatrixFromPool(m_candidateWeights, matrixPool);
+        RequestMatrixFromPool(m_labelWeights, matrixPool);
+        RequestMatrixFromPool(m_criterionPerColumn, matrixPool);
+        RequestMatrixFromPool(m_labelLogits, matrixPool);
+        // small and kept across minibatches
+        if (!m_candidateIds)
+        {
+            m_candidateIds = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_candidateOffsets = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_logExpectedCounts = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_candidateLabels = make_shared<Matrix<ElemType>>(0, 0, m_deviceId, SPARSE, matrixFormatSparseCSC);
+            m_classIds = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_labelClassIds = make_shared<Matrix<ElemType>>(m_deviceId);
+        }
+    }
+
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeBackprop(matrixPool);
+        RequestMatrixFromPool(m_gradientOfLogits, matrixPool);
+        RequestMatrixFromPool(m_gradientOfCandidateWeights, matrixPool);
+        RequestMatrixFromPool(m_gradientOfCandidateOffsets, matrixPool);
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_gradientOfLogits, matrixPool);
+        ReleaseMatrixToPool(m_gradientOfCandidateWeights, matrixPool);
+        ReleaseMatrixToPool(m_gradientOfCandidateOffsets, matrixPool);
+    }
+
+    size_t NumSamples() const { return m_numSamples; }
+    const wstring& Sampler() const { return m_sampler; }
+
+private:
+    void VerifySampler() const
+    {
+        if (m_sampler != L"logUniform" && m_sampler != L"uniform")
+            InvalidArgument("SampledCrossEntropyWithSoftmax: sampler must be 'logUniform' or 'uniform', but is '%ls'.", m_sampler.c_str());
+    }
+
+    size_t NumClasses() const { return Input(2)->GetAsMatrixNumCols(); }
+    size_t NumCandidates() const { return m_isSampled ? m_candidateIds->GetNumCols() : NumClasses(); }
+
+    // the weights, biases (less the sampling correction), and labels of the classes the softmax is taken over
+    Matrix<ElemType> CandidateWeights() { return m_isSampled ? m_candidateWeights->AsReference() : Input(2)->ValueAsMatrix().AsReference(); }
+    Matrix<ElemType> CandidateOffsets() { return m_isSampled ? m_candidateOffsets->AsReference() : Input(3)->ValueAsMatrix().Reshaped(1, NumClasses()); }
+    Matrix<ElemType> CandidateLabels(const FrameRange& fr) { return m_isSampled ? m_candidateLabels->AsReference() : Input(0)->MaskedValueFor(fr); }
+
+    // probability of a class under the sampler; the log-uniform distribution assumes classes sorted by decreasing frequency
+    double SamplingProbability(size_t classId) const
+    {
+        if (m_sampler == L"uniform")
+            return 1.0 / NumClasses();
+        return (log(classId + 2.0) - log(classId + 1.0)) / log(NumClasses() + 1.0);
+    }
+
+    size_t DrawSample()
+    {
+        size_t numClasses = NumClasses();
+        double u = std::uniform_real_distribution<double>(0, 1)(m_rng);
+        size_t classId = m_sampler == L"uniform" ? (size_t) (u * numClasses) : (size_t) exp(u * log(numClasses + 1.0)) - 1;
+        return min(classId, numClasses - 1);
+    }
+
+    // determine the candidates of the minibatch: the label classes, and m_numSamples distinct sampled classes
+    // Sets m_candidateIds and m_logExpectedCounts [1 x numCandidates], and m_candidateLabels [numCandidates x T] (one-hot, sparse).
+    void SampleCandidates(const FrameRange& fr)
+    {
+        // the class of each label, +1, and 0 in gaps
+        size_t numClasses = NumClasses();
+        if (m_classIds->GetNumCols() != numClasses)
+        {
+            vector<ElemType> classIds(numClasses);
+            for (size_t i = 0; i < numClasses; i++)
+                classIds[i] = (ElemType) (i + 1);
+            m_classIds->SetValue(1, numClasses, m_deviceId, classIds.data());
+        }
+        m_labelClassIds->AssignProductOf(*m_classIds, false, Input(0)->MaskedValueFor(fr), false);
+        MaskMissingColumnsToZero(*m_labelClassIds, Input(0)->GetMBLayout(), fr);
+        size_t numCols = m_labelClassIds->GetNumCols();
+        m_labelClassIdsOnCPU.resize(numCols);
+        m_labelClassIds->CopySection(1, numCols, m_labelClassIdsOnCPU.data(), 1);
+
+        // the label classes are candidates; one-hot labels w.r.t. the candidates
+        m_candidatesOnCPU.clear();
+        m_candidateIndices.clear();
+        m_candidateLabelColStarts.assign(1, 0);
+        m_candidateLabelRows.clear();
+        for (size_t j = 0; j < numCols; j++)
+        {
+            if (m_labelClassIdsOnCPU[j] > 0.5)
+            {
+                size_t classId = (size_t) (m_labelClassIdsOnCPU[j] + 0.5) - 1;
+                auto iter = m_candidateIndices.insert(make_pair(classId, m_candidatesOnCPU.size())).first;
+                if (iter->second == m_candidatesOnCPU.size())
+                    m_candidatesOnCPU.push_back(classId);
+                m_candidateLabelRows.push_back((CPUSPARSE_INDEX_TYPE) iter->second);
+            }
+            m_candidateLabelColStarts.push_back((CPUSPARSE_INDEX_TYPE) m_candidateLabelRows.size());
+        }
+
+        // shared negatives: draw until there are m_numSamples distinct classes
+        size_t numTries = 0;
+        m_sampledClasses.clear();
+        while (m_sampledClasses.size() < m_numSamples)
+        {
+            size_t classId = DrawSample();
+            numTries++;
+            if (m_sampledClasses.insert(classId).second && m_candidateIndices.insert(make_pair(classId, m_candidatesOnCPU.size())).second)
+                m_candidatesOnCPU.push_back(classId);
+        }
+
+        // expected count of each candidate in numTries draws: 1 - (1 - p)^numTries
+        size_t numCandidates = m_candidatesOnCPU.size();
+        m_candidateIdsOnCPU.resize(numCandidates);
+        m_logExpectedCountsOnCPU.resize(numCandidates);
+        for (size_t i = 0; i < numCandidates; i++)
+        {
+            double p = SamplingProbability(m_candidatesOnCPU[i]);
+            m_candidateIdsOnCPU[i] = (ElemType) m_candidatesOnCPU[i];
+            m_logExpectedCountsOnCPU[i] = (ElemType) log(-expm1(numTries * log1p(-p)));
+        }
+        m_candidateIds->SetValue(1, numCandidates, m_deviceId, m_candidateIdsOnCPU.data());
+        m_logExpectedCounts->SetValue(1, numCandidates, m_deviceId, m_logExpectedCountsOnCPU.data());
+        m_candidateLabelValues.assign(m_candidateLabelRows.size(), 1);
+        m_candidateLabels->SetMatrixFromCSCFormat(m_candidateLabelColStarts.data(), m_candidateLabelRows.data(), m_candidateLabelValues.data(),
+                                                  m_candidateLabelRows.size(), numCandidates, numCols);
+    }
+
+    size_t m_numSamples;
+    wstring m_sampler; // "logUniform" or "uniform"
+    unsigned long m_randomSeed;
+    std::mt19937 m_rng;
+
+    bool m_isSampled; // false: the candidates are all classes
+    bool m_needRecomputeGradientOfLogits;
+
+    shared_ptr<Matrix<ElemType>> m_logits;             // [numCandidates x T]
+    shared_ptr<Matrix<ElemType>> m_logSoftmaxOfLogits; // [numCandidates x T]
+    shared_ptr<Matrix<ElemType>> m_candidateWeights;   // [hdsize x numCandidates]
+    shared_ptr<Matrix<ElemType>> m_labelWeights;       // [hdsize x T], the weights of each label's class
+    shared_ptr<Matrix<ElemType>> m_criterionPerColumn; // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_labelLogits;        // [1 x T]
+    shared_ptr<Matrix<ElemType>> m_gradientOfLogits;
+    shared_ptr<Matrix<ElemType>> m_gradientOfCandidateWeights;
+    shared_ptr<Matrix<ElemType>> m_gradientOfCandidateOffsets;
+
+    shared_ptr<Matrix<ElemType>> m_candidateIds;       // [1 x numCandidates], class of each candidate
+    shared_ptr<Matrix<ElemType>> m_candidateOffsets;   // [1 x numCandidates], bias - log expected count
+    shared_ptr<Matrix<ElemType>> m_logExpectedCounts;  // [1 x numCandidates]
+    shared_ptr<Matrix<ElemType>> m_candidateLabels;    // [numCandidates x T], sparse
+    shared_ptr<Matrix<ElemType>> m_classIds;           // [1 x vocab_size], 1, 2, 3, ...
+    shared_ptr<Matrix<ElemType>> m_labelClassIds;      // [1 x T]
+
+    // CPU buffers of SampleCandidates(), kept across minibatches
+    vector<ElemType> m_labelClassIdsOnCPU;
+    vector<size_t> m_candidatesOnCPU;
+    unordered_map<size_t, size_t> m_candidateIndices;
+    std::set<size_t> m_sampledClasses;
+    vector<ElemType> m_candidateIdsOnCPU;
+    vector<ElemType> m_logExpectedCountsOnCPU;
+    vector<CPUSPARSE_INDEX_TYPE> m_candidateLabelColStarts;
+    vector<CPUSPARSE_INDEX_TYPE> m_candidateLabelRows;
+    vector<ElemType> m_candidateLabelValues;
+};
+
+template class SampledCrossEntropyWithSoftmaxNode<float>;
+template class SampledCrossEntropyWithSoftmaxNode<double>;
+
 // -----------------------------------------------------------------------
 // ClassBasedCrossEntropyWithSoftmaxNode (labeldata(.,t), inputdata(.,t), embeddingMatrix, clsProbBeforeSoftmaxData(.,t))
 //  - Input(0) [4 x T] label in dense matrix in
@@ -712,39 +1147,138 @@ public:
           m_softMax(deviceId),
           m_grdToSoftMaxInput(deviceId),
           m_clsLogSoftmax(deviceId),
-          m_clsSoftmax(deviceId)
+          m_clsSoftmax(deviceId),
+          m_frameColumns(deviceId),
+          m_hiddenByClass(deviceId),
+          m_grdToHiddenByClass(deviceId),
+          m_logPosteriors(deviceId),
+          m_grdToClsInput(deviceId),
+          m_elementIndices(deviceId),
+          m_elementValues(deviceId)
     {
     }
 
 private:
-    // iterate over a large workspace that contains all class-conditioned probs concatenated
-    // 'sz' is the offset into that vector. We will iterate over these vectors at a few places. Always use this same boilerplate code.
-    template<class F>
-    size_t ForColumnsWithClass(const F& op)
+    // The frames of the minibatch are processed grouped by class, such that each class takes one matrix product for all its frames.
+    // The class-conditioned probs of a class are a [nbr_wrd x numFrames] block of a large workspace that concatenates all classes.
+    struct ClassGroup
+    {
+        size_t lft_bnd;    // index of the first word of the class
+        size_t nbr_wrd;    // number of words in the class
+        size_t firstFrame; // index into m_frameColumnsOnCPU
+        size_t numFrames;
+        size_t sz;         // offset of the block into the workspace
+    };
+
+    // read the labels on the CPU, and group the frames (non-gap columns) by class
+    void GroupFramesByClass()
     {
+        const auto& labels = Input(LABELDATA)->Value();
+        const auto& pMBLayout = Input(LABELDATA)->GetMBLayout();
         const size_t nT = Input(LABELDATA)->GetNumTimeSteps();
         const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
-        size_t sz = 0; // iterate over the packed concatenated class-conditioned prob vectors
-        for (size_t s = 0; s < nS; s++)
-            for (size_t t = 0; t < nT; t++)
+
+        m_frameColumnsOnCPU.clear();
+        m_classPositions.clear();
+        for (size_t t = 0; t < nT; t++)
+            for (size_t s = 0; s < nS; s++)
             {
-                FrameRange fr = FrameRange(Input(LABELDATA)->GetMBLayout(), t).Sequence(s);
-                if (Input(LABELDATA)->GetMBLayout()->IsGap(fr)) // skip gaps
+                if (pMBLayout->IsGap(FrameRange(pMBLayout, t).Sequence(s))) // skip gaps
                     continue;
+                size_t j = t * nS + s;
+                size_t y_t = (size_t) labels(0, j);     // current word token index
+                size_t c_t = (size_t) labels(1, j);     // current word token's class index
+                size_t lft_bnd = (size_t) labels(2, j); // index of first word belonging to current word token's class
+                size_t rgt_bnd = (size_t) labels(3, j); // and end of that range
+                if (rgt_bnd <= lft_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Encountered a class of size 0.");
+                if (y_t < lft_bnd || y_t >= rgt_bnd)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Word index out of bounds of class-member index range (word not a class member).");
+                if (c_t >= m_nbrCls)
+                    LogicError("ClassBasedCrossEntropyWithSoftmax: Class index out of bounds.");
+                m_frameColumnsOnCPU.push_back((ElemType) j);
+                m_classPositions.push_back(j * m_nbrCls + c_t); // position of the class log posterior in m_clsLogSoftmax
+            }
 
-                const Matrix<ElemType>& lbl_t = Input(LABELDATA)->ValueFor(fr);
-                size_t y_t = (size_t)lbl_t(0, 0);     // current word token index
-                size_t c_t = (size_t)lbl_t(1, 0);     // current word token's class index
-                size_t lft_bnd = (size_t)lbl_t(2, 0); // index of first word belonging to current word token's class
-                size_t rgt_bnd = (size_t)lbl_t(3, 0); // and end of that range
-                size_t nbr_wrd = (rgt_bnd - lft_bnd); // number of words in the class
+        // sort the frames by class; within a class, by column
+        size_t numFrames = m_frameColumnsOnCPU.size();
+        vector<size_t> order(numFrames);
+        for (size_t i = 0; i < numFrames; i++)
+            order[i] = i;
+        auto classOf = [&](size_t i) { return (size_t) labels(2, (size_t) m_frameColumnsOnCPU[i]); };
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return classOf(a) < classOf(b); });
+
+        m_classGroups.clear();
+        m_wordPositions.resize(numFrames);
+        vector<ElemType> frameColumns(numFrames);
+        size_t sz = 0;
+        for (size_t i = 0; i < numFrames; i++)
+        {
+            size_t j = (size_t) m_frameColumnsOnCPU[order[i]];
+            size_t lft_bnd = (size_t) labels(2, j);
+            size_t nbr_wrd = (size_t) labels(3, j) - lft_bnd;
+            if (m_classGroups.empty() || m_classGroups.back().lft_bnd != lft_bnd)
+                m_classGroups.push_back(ClassGroup{ lft_bnd, nbr_wrd, i, 0, sz });
+            auto& group = m_classGroups.back();
+            if (group.nbr_wrd != nbr_wrd)
+                LogicError("ClassBasedCrossEntropyWithSoftmax: Inconsistent class ranges in the labels.");
+            m_wordPositions[i] = sz + (size_t) labels(0, j) - lft_bnd; // position of the word's class-conditional prob in the workspace
+            frameColumns[i] = (ElemType) j;
+            group.numFrames++;
+            sz += nbr_wrd;
+        }
+        m_frameColumnsOnCPU = move(frameColumns);
+        m_totalNbrWords = sz;
+    }
 
-                // perform the operation
-                op(s, t, fr, y_t, c_t, sz, lft_bnd, nbr_wrd);
+    // views of a class's blocks of the hidden activations [hdSize x numFrames], and of a workspace [nbr_wrd x numFrames]
+    Matrix<ElemType> HiddenForClass(Matrix<ElemType>& hiddenByClass, const ClassGroup& group) const
+    {
+        return hiddenByClass.ColumnSlice(group.firstFrame, group.numFrames);
+    }
+    Matrix<ElemType> WorkspaceForClass(Matrix<ElemType>& workspace, const ClassGroup& group) const
+    {
+        return workspace.ColumnSlice(group.sz, group.nbr_wrd * group.numFrames).Reshaped(group.nbr_wrd, group.numFrames);
+    }
 
-                sz += nbr_wrd;
-            }
-        return sz;
+    // Element positions are passed to the device as ElemType. They are made relative to windows of the row vector in which they are
+    // exactly representable, and op(first, n, window) is called for each window with m_elementIndices holding positions [first, first + n).
+    template <class F>
+    void ForPositionWindows(const Matrix<ElemType>& row, const vector<size_t>& positions, const F& op)
+    {
+        const size_t maxExactPosition = (size_t) 1 << 24;
+        for (size_t first = 0; first < positions.size();)
+        {
+            size_t base = positions[first];
+            size_t len = min(maxExactPosition, row.GetNumCols() - base);
+            m_elementIndicesOnCPU.clear();
+            while (first + m_elementIndicesOnCPU.size() < positions.size() && positions[first + m_elementIndicesOnCPU.size()] - base < len)
+                m_elementIndicesOnCPU.push_back((ElemType) (positions[first + m_elementIndicesOnCPU.size()] - base));
+            size_t n = m_elementIndicesOnCPU.size();
+            m_elementIndices.SetValue(1, n, row.GetDeviceId(), m_elementIndicesOnCPU.data());
+            op(first, n, row.ColumnSlice(base, len));
+            first += n;
+        }
+    }
+
+    // result(0, i) = row(0, positions[i]), for ascending positions
+    void GatherElements(Matrix<ElemType> result, const Matrix<ElemType>& row, const vector<size_t>& positions)
+    {
+        ForPositionWindows(row, positions, [&](size_t first, size_t n, const Matrix<ElemType>& window)
+        {
+            result.ColumnSlice(first, n).DoGatherColumnsOf(0, m_elementIndices, window, 1);
+        });
+    }
+
+    // row(0, positions[i]) += value, for ascending positions
+    void AddToElements(const Matrix<ElemType>& row, const vector<size_t>& positions, ElemType value)
+    {
+        ForPositionWindows(row, positions, [&](size_t /*first*/, size_t n, Matrix<ElemType> window)
+        {
+            m_elementValues.Resize(1, n);
+            m_elementValues.SetValue(value);
+            window.DoScatterColumnsOf(1, m_elementIndices, m_elementValues, 1);
+        });
     }
 
     // compute gradients to input observations, the weights to the observations, and the class log posterior probabilites
@@ -756,65 +1290,56 @@ private:
 
         ComputeSoftMaxPartial(); // Note: Flag m_needRecomputeGradientToSoftmaxInput guards so that this computes only once.
 
-        ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& fr, size_t /*y_t*/, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+        switch (inputIndex)
         {
-            // compute prb - 1 and prb
-            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-            Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-            Matrix<ElemType> grd_to_soft_max_input = m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd);
-
-            switch (inputIndex)
+            case 1:
             {
-                case 1:
-                {
-                    // gradient to input
-                    Matrix<ElemType> grd_t = Input(INPUTDATA)->GradientFor(fr);
-                    Matrix<ElemType>::MultiplyAndAdd(weightForClass, false, grd_to_soft_max_input, true, grd_t);
-                    break;
-                }
-                case 2:
+                // gradient to input, per class, then scattered to the frames' columns
+                m_grdToHiddenByClass.Resize(m_hiddenByClass);
+                for (const auto& group : m_classGroups)
                 {
-                    // gradient to input weight
-                    Matrix<ElemType> grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(lft_bnd, nbr_wrd);
-                    Matrix<ElemType>::MultiplyAndAdd(obs, false, grd_to_soft_max_input, false, grd_to_wgt_t);
-                    break;
+                    Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(group.lft_bnd, group.nbr_wrd);
+                    HiddenForClass(m_grdToHiddenByClass, group).AssignProductOf(weightForClass, false, WorkspaceForClass(m_grdToSoftMaxInput, group), false);
                 }
-                case 3:
+                Matrix<ElemType> grd = Input(INPUTDATA)->GradientFor(FrameRange(Input(INPUTDATA)->GetMBLayout()));
+                grd.DoScatterColumnsOf(1, m_frameColumns, m_grdToHiddenByClass, 1);
+                break;
+            }
+            case 2:
+            {
+                // gradient to input weight, one product per class
+                for (const auto& group : m_classGroups)
                 {
-                    Matrix<ElemType> grd_t = Input(CLASSPROBINDATA)->GradientFor(fr);
-                    grd_t.AssignValuesOf(Input(CLASSPROBINDATA)->DataFor(m_clsSoftmax, fr));
-                    ComputeCEPartialToSoftmaxInputs(grd_t, Gradient(), c_t);
-                    break;
+                    Matrix<ElemType> grd_to_wgt_t = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(group.lft_bnd, group.nbr_wrd);
+                    Matrix<ElemType>::MultiplyAndAdd(HiddenForClass(m_hiddenByClass, group), false, WorkspaceForClass(m_grdToSoftMaxInput, group), true, grd_to_wgt_t);
                 }
+                break;
             }
-        });
+            case 3:
+            {
+                // gradient to the class log posteriors: softmax - 1 at the class of each frame, 0 in gaps
+                FrameRange fr(Input(CLASSPROBINDATA)->GetMBLayout());
+                m_grdToClsInput.SetValue(m_clsSoftmax);
+                AddToElements(m_grdToClsInput.Reshaped(1, m_grdToClsInput.GetNumElements()), m_classPositions, -1);
+                MaskMissingColumnsToZero(m_grdToClsInput, Input(CLASSPROBINDATA)->GetMBLayout(), fr);
+                Matrix<ElemType>::Scale(Gradient(), m_grdToClsInput);
+                Input(CLASSPROBINDATA)->GradientFor(fr) += m_grdToClsInput;
+                break;
+            }
+        }
     }
 
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
 
 private:
-    void ComputeCEPartialToSoftmaxInputs(Matrix<ElemType>& inputGradientValues, Matrix<ElemType>& gradientValues, size_t y_t)
-    {
-        Matrix<ElemType>::MinusOneAt(inputGradientValues, y_t);
-        Matrix<ElemType>::Scale(gradientValues, inputGradientValues);
-    }
-
     // gradient of cross entropy w.r.t. to input to softmax
     void ComputeSoftMaxPartial()
     {
         if (m_needRecomputeGradientToSoftmaxInput)
         {
-            m_grdToSoftMaxInput.Resize(1, m_totalNbrWords); // buffer that contains a concatenation of class-conditional values
-
-            ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& /*fr*/, size_t y_t, size_t /*c_t*/, size_t sz, size_t lft_bnd, size_t nbr_wrd)
-            {
-                Matrix<ElemType> softMax = m_softMax.ColumnSlice(sz, nbr_wrd);
-
-                size_t idx_in_class = y_t - lft_bnd;
-                ComputeCEPartialToSoftmaxInputs(softMax, Gradient(), idx_in_class);
-
-                m_grdToSoftMaxInput.ColumnSlice(sz, nbr_wrd).AssignValuesOf(softMax);
-            });
+            m_grdToSoftMaxInput.SetValue(m_softMax); // buffer that contains a concatenation of class-conditional values
+            AddToElements(m_grdToSoftMaxInput, m_wordPositions, -1);
+            Matrix<ElemType>::Scale(Gradient(), m_grdToSoftMaxInput);
 
             m_needRecomputeGradientToSoftmaxInput = false;
         }
@@ -832,9 +1357,6 @@ public:
         // get the label matrix to CPU, ideally in location=BOTH state
         Input(LABELDATA)->Value().TransferToDeviceIfNotThere(CPUDEVICE, /*ismoved =*/ false/*means: BOTH state OK*/, /*emptyTransfer =*/ false, /*updatePreferredDevice =*/ false);
 
-        auto& functionValues = Value();
-
-        const size_t hdSize = Input(INPUTDATA)->GetSampleMatrixNumRows();
         assert(m_nbrCls == Input(CLASSPROBINDATA)->GetSampleMatrixNumRows());
 
         // compute the class posteriors
@@ -842,61 +1364,42 @@ public:
         m_clsLogSoftmax.InplaceLogSoftmax(true);   // log
         m_clsSoftmax.AssignExpOf(m_clsLogSoftmax); // non-log
 
-        // create a large workspace to contain all class-conditioned probs concatenated
-        m_totalNbrWords = ForColumnsWithClass([](size_t /*s*/, size_t /*t*/, const FrameRange& /*fr*/, size_t y_t, size_t /*c_t*/, size_t /*sz*/, size_t lft_bnd, size_t nbr_wrd)
+        // group the frames by class, and gather their hidden activation vectors in that order
+        GroupFramesByClass();
+        size_t numFrames = m_frameColumnsOnCPU.size();
+        if (numFrames == 0)
         {
-            if (nbr_wrd == 0)
-                LogicError("ClassBasedCrossEntropyWithSoftmax: Encountered a class of size 0.");
-            if (y_t < lft_bnd || y_t >= lft_bnd + nbr_wrd)
-                LogicError("ClassBasedCrossEntropyWithSoftmax: Word index out of bounds of class-member index range (word not a class member).");
-        });
-        // now m_totalNbrWords = total size of concatenated vector
+            Value().SetValue(0);
+            m_needRecomputeGradientToSoftmaxInput = true;
+            return;
+        }
+        m_frameColumns.SetValue(1, numFrames, m_frameColumns.GetDeviceId(), m_frameColumnsOnCPU.data());
+        m_hiddenByClass.DoGatherColumnsOf(0, m_frameColumns, Input(INPUTDATA)->Value(), 1);
 
         // buffer to hold the concatenated class-conditioned prob vectors
         m_softMax.Resize(1, m_totalNbrWords);
         m_logSoftmax.Resize(1, m_totalNbrWords);
 
-        // accumulate objective
-        functionValues.SetValue(0);
-        ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
+        // log softmax(W x_t) for all frames of a class in one product
+        for (const auto& group : m_classGroups)
         {
-            // now get views of various arrays that correspond to the index range of words belonging to this class
-
-            // get hidden vectors for the words in this class
-            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(lft_bnd, nbr_wrd); // [hdSize x nbr_wrd]
-
-            // buffer to hold the class-conditional distribution
-            Matrix<ElemType> softMax_t = m_softMax.ColumnSlice(sz, nbr_wrd); // TODO: declare these outside of the loop to avoid the malloc
-            Matrix<ElemType> logSoftMax_t = m_logSoftmax.ColumnSlice(sz, nbr_wrd);
-
-            Matrix<ElemType> obs = Input(INPUTDATA)->ValueFor(fr); // hidden activation vector for current word token
-
-            // multiply hidden activation with weight matrix (the slice of the weight matrix for the range of class members)
-            // TODO: can we use 'true' here instead? Above transposition hack won't work with row slices. 'obs' not used elsewhere
-            obs.Reshape(1, hdSize);                                                                                // transpose it (make it a column vector)
-            logSoftMax_t.AssignProductOf(obs /*(1 x hdSize)*/, false, weightForClass /*hdSize x nbr_wrd*/, false); // -> 1 x nbr_word
-
-            // log softmax(W x_t)
-            logSoftMax_t.InplaceLogSoftmax(false);
-
-            // and non-log version
-            softMax_t.SetValue(logSoftMax_t);
-            softMax_t.InplaceExp();
-            // we now have a column vector of class-conditional probabilities over the class members
-
-            // add  the word's class-conditional log posterior
-            size_t idx_in_class = y_t - lft_bnd;
-            Matrix<ElemType>::AddElementToElement(logSoftMax_t, 0, idx_in_class, functionValues, 0, 0); // (1x1)
-
-            // add the class log posterior probability (for backprop)
-            auto clsLogSoftmax_t = Input(CLASSPROBINDATA)->DataFor(m_clsLogSoftmax, fr);
-            Matrix<ElemType>::AddElementToElement(clsLogSoftmax_t, c_t, 0, functionValues, 0, 0); // (1x1)
-        });
-
-        functionValues *= (-1);
+            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(group.lft_bnd, group.nbr_wrd); // [hdSize x nbr_wrd]
+            Matrix<ElemType> logSoftMax_c = WorkspaceForClass(m_logSoftmax, group);                                                // [nbr_wrd x numFrames]
+            logSoftMax_c.AssignProductOf(weightForClass, true, HiddenForClass(m_hiddenByClass, group), false);
+            logSoftMax_c.InplaceLogSoftmax(true);
+        }
+        // and non-log version
+        m_softMax.AssignExpOf(m_logSoftmax);
+
+        // objective: the words' class-conditional log posteriors and the class log posteriors
+        m_logPosteriors.Resize(1, 2 * numFrames);
+        GatherElements(m_logPosteriors.ColumnSlice(0, numFrames), m_logSoftmax, m_wordPositions);
+        GatherElements(m_logPosteriors.ColumnSlice(numFrames, numFrames), m_clsLogSoftmax.Reshaped(1, m_clsLogSoftmax.GetNumElements()), m_classPositions);
+        Value().AssignSumOfElements(m_logPosteriors);
+        Value() *= (-1);
 
 #if NANCHECK
-        functionValues.HasNan("ClassBasedCrossEntropyWithSoftmax");
+        Value().HasNan("ClassBasedCrossEntropyWithSoftmax");
 #endif
         m_needRecomputeGradientToSoftmaxInput = true;
     }
@@ -936,6 +1439,22 @@ protected:
 
     size_t m_nbrCls;
     size_t m_totalNbrWords;
+
+    // frames grouped by class, see GroupFramesByClass()
+    vector<ClassGroup> m_classGroups;
+    vector<ElemType> m_frameColumnsOnCPU; // minibatch column of each frame, in class order
+    vector<size_t> m_wordPositions;       // of each frame's word in m_logSoftmax, in class order
+    vector<size_t> m_classPositions;      // of each frame's class in m_clsLogSoftmax, in column order
+    Matrix<ElemType> m_frameColumns;      // m_frameColumnsOnCPU on the device
+    Matrix<ElemType> m_hiddenByClass;     // [hdSize x numFrames] hidden activations of the frames, in class order
+    Matrix<ElemType> m_grdToHiddenByClass;
+    Matrix<ElemType> m_logPosteriors;     // [1 x 2 numFrames] word and class log posteriors of the frames
+    Matrix<ElemType> m_grdToClsInput;
+
+    // buffers of ForPositionWindows()
+    vector<ElemType> m_elementIndicesOnCPU;
+    Matrix<ElemType> m_elementIndices;
+    Matrix<ElemType> m_elementValues;
 };
 
 template class ClassBasedCrossEntropyWithSoftmaxNode<float>;
@@ -1069,97 +1588,53 @@ public:
 
         int nObs = lbls.GetNumCols();
 
+        // only the first and last label are needed on the host; everything else stays on the device
+        firstLbl = ActiveLabelAt(lbls, 0);
+        lastLbl = ActiveLabelAt(lbls, nObs - 1);
+
         // change to other values so can support multiple sentences in each minibatch
         assert(iStep == 1);
-        ForwardCompute(alpha, lbls, pos_scores, pair_scores);
+        ForwardCompute(alpha, pos_scores, pair_scores, firstLbl);
         BackwardCompute(alpha, beta, functionValues, lbls, pos_scores, pair_scores, iStep);
         PostProbCompute(postprob, alpha, beta);
 
-        firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        lastLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, nObs - 1) != 0)
-            {
-                lastLbl = ik;
-                break;
-            }
-
         functionValues.AssignInnerProductOfMatrices(lbls, pos_scores);
 
+        // transition score: sum_t pair_scores(label(t+1), label(t)), as an inner product of the one-hot labels
+        if (nObs > 1)
+        {
+            Matrix<ElemType> pairScoresOfPreviousLabels(lbls.GetDeviceId());
+            Matrix<ElemType>::Multiply(pair_scores, lbls.ColumnSlice(0, nObs - 1), pairScoresOfPreviousLabels);
+            Matrix<ElemType> tscore(lbls.GetDeviceId());
+            tscore.AssignInnerProductOfMatrices(lbls.ColumnSlice(1, nObs - 1), pairScoresOfPreviousLabels);
+            functionValues += tscore; // correct path score
+        }
+
         Matrix<ElemType> a = alpha.ColumnSlice(nObs - 1, 1);
         ElemType fAlpha;
         fAlpha = a.LogSumOfElements();
 
-        // transition score
-        ElemType tscore = 0;
-        for (int t = 0; t < nObs - 1; t++)
-        {
-            int i = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t) != 0)
-                {
-                    i = ik;
-                    break;
-                }
-            int j = -1;
-            for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-                if (lbls(ik, t + 1) != 0)
-                {
-                    j = ik;
-                    break;
-                }
-            tscore += pair_scores(j, i);
-        }
-        tscore += functionValues.Get00Element(); // correct path score
-        tscore -= fAlpha;                        // reduced by the scores from all paths
-        functionValues.SetValue(tscore);
+        functionValues.AssignDifferenceOf(fAlpha, functionValues); // reduced by the scores from all paths, negated
+    }
 
-        functionValues *= (-1);
+    // index of the first non-zero row of column t of a one-hot label matrix, or -1
+    static int ActiveLabelAt(const Matrix<ElemType>& lbls, size_t t)
+    {
+        std::vector<ElemType> column(lbls.GetNumRows());
+        lbls.ColumnSlice(t, 1).CopySection(column.size(), 1, column.data(), column.size());
+        for (int ik = 0; ik < (int) column.size(); ik++)
+            if (column[ik] != 0)
+                return ik;
+        return -1;
     }
 
     // compute forward backward algorithm
     static void ForwardCompute(Matrix<ElemType>& alpha,
-                               const Matrix<ElemType>& lbls,
-                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores)
+                               const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                               int firstLbl)
     {
         // to-do, shift more than 1 to support muliple sentences per minibatch
-        int iNumPos = lbls.GetNumCols();
-        int iNumLab = lbls.GetNumRows();
-
-        int firstLbl = -1;
-        for (int ik = 0; ik < lbls.GetNumRows(); ik++)
-            if (lbls(ik, 0) != 0)
-            {
-                firstLbl = ik;
-                break;
-            }
-
-        // need to have
-        alpha.Resize(iNumLab, iNumPos);
-
-        for (int t = 0; t < iNumPos; t++)
-        {
-            for (int k = 0; k < iNumLab; k++)
-            {
-                ElemType fTmp = (ElemType) LZERO;
-                for (int j = 0; j < iNumLab; j++)
-                {
-                    ElemType fAlpha = (j == firstLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
-                    if (t > 0)
-                        fAlpha = alpha(j, t - 1);
-                    fTmp = alpha.LogAdd(fTmp, fAlpha + pair_scores(k, j));
-                }
-                fTmp += pos_scores(k, t); // include position dependent score
-                alpha(k, t) = fTmp;
-            }
-        }
+        Matrix<ElemType>::RCRFForwardCompute(alpha, pos_scores, pair_scores, firstLbl);
     }
 
     // compute backward algorithm
@@ -1421,18 +1896,22 @@ public:
     DeclareConstructorFromConfigWithNumInputs(DropoutNode);
     DropoutNode(DEVICEID_TYPE deviceId, const wstring& name)
         : Base(deviceId, name),
-          m_dropoutRate(0)
+          m_dropoutRate(0),
+          m_numMasks(0),
+          m_maskSeed(0)
     {
         m_randomSeed = (unsigned long) CreateUniqId();
     }
 
+    // The mask is not stored: it is a function of m_maskSeed and the element's position in the minibatch, and is
+    // regenerated in the same kernel that applies it, in ForwardProp() and again in BackpropTo().
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
         Matrix<ElemType> sliceInput0Grad = Input(0)->GradientFor(fr);
         Matrix<ElemType> sliceOutputGrad = GradientFor(fr);
 
         if (m_dropoutRate > 0)
-            sliceInput0Grad.AddElementProductOf(sliceOutputGrad, DataFor(*m_maskOfDropout, fr));
+            sliceInput0Grad.DoRandomlyMaskedCopyOf(1, sliceOutputGrad, (ElemType) m_dropoutRate, (ElemType) (1.0 / (1.0 - m_dropoutRate)), m_maskSeed, FirstMaskCounterFor(fr));
         else
             sliceInput0Grad += sliceOutputGrad;
     }
@@ -1440,12 +1919,12 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
 
-    virtual void UpdateFunctionMBSize() override
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
     {
-        Base::UpdateFunctionMBSize();
-        // resize temporaries to their proper size
-        if (m_dropoutRate > 0)
-            m_maskOfDropout->Resize(Input(0)->Value());
+        Base::BeginForwardProp();
+        // draw a new mask for this minibatch
+        if (!Environment().IsInferring() && m_dropoutRate > 0)
+            m_maskSeed = ((unsigned long long) m_randomSeed << 32) + m_numMasks++;
     }
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
@@ -1459,14 +1938,14 @@ public:
         }
         else
         {
-            // determine drop-out mask for this minibatch
-            auto sliceMask = DataFor(*m_maskOfDropout, fr);
-            sliceMask.SetUniformRandomMask((ElemType)m_dropoutRate, (ElemType)(1.0 / (1.0 - m_dropoutRate)) /*pre-scaled*/, GetRNGHandle());
-            // apply dropout mask
-            sliceOutputValue.AssignElementProductOf(sliceMask, sliceInput0Value);
+            // apply the drop-out mask of this minibatch (pre-scaled)
+            sliceOutputValue.DoRandomlyMaskedCopyOf(0, sliceInput0Value, (ElemType) m_dropoutRate, (ElemType) (1.0 / (1.0 - m_dropoutRate)), m_maskSeed, FirstMaskCounterFor(fr));
         }
     }
 
+    // a replay would repeat the mask of the captured minibatch
+    virtual bool IsReplayable() const override { return Environment().IsInferring() || m_dropoutRate <= 0; }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         ValidateUnaryMap(isFinalValidationPass);
@@ -1484,17 +1963,8 @@ public:
     {
         m_randomSeed = (unsigned long) val;
 
-        // Upon change of the seed, reset RNGHandle to force the creation of a new RNGHandle
-        // during forward propagation
-        m_RNGHandle = nullptr;
-    }
-
-    RNGHandle& GetRNGHandle()
-    {
-        if (m_RNGHandle == nullptr) 
-            m_RNGHandle = RNGHandle::Create(ValuePtr()->GetDeviceId(), m_randomSeed);
-
-        return *m_RNGHandle;
+        // Upon change of the seed, restart the sequence of masks
+        m_numMasks = 0;
     }
 
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
@@ -1505,29 +1975,22 @@ public:
             auto node = dynamic_pointer_cast<DropoutNode<ElemType>>(nodeP);
             node->m_dropoutRate = m_dropoutRate;
             node->m_randomSeed = m_randomSeed;
-            node->m_maskOfDropout = m_maskOfDropout;
+            node->m_numMasks = m_numMasks;
+            node->m_maskSeed = m_maskSeed;
         }
     }
-    // request matrices needed to do node function value evaluation
-    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool)
-    {
-        Base::RequestMatricesBeforeForwardProp(matrixPool);
-        RequestMatrixFromPool(m_maskOfDropout, matrixPool);
-    }
 
-    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
-    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool)
+private:
+    // the mask element of an output element is selected by its index in the whole minibatch
+    size_t FirstMaskCounterFor(const FrameRange& fr) const
     {
-        Base::ReleaseMatricesAfterBackprop(matrixPool);
-        ReleaseMatrixToPool(m_maskOfDropout, matrixPool);
+        return ColumnRangeWithMBLayoutFor(Value().GetNumCols(), fr, GetMBLayout()).first * Value().GetNumRows();
     }
 
-private:
     double m_dropoutRate;
     unsigned long m_randomSeed;
-    std::shared_ptr<RNGHandle> m_RNGHandle;
-
-    shared_ptr<Matrix<ElemType>> m_maskOfDropout;
+    unsigned long long m_numMasks; // number of minibatches the mask was drawn for so far
+    unsigned long long m_maskSeed; // mask of the current minibatch
 };
 
 template class DropoutNode<float>;
@@ -1688,6 +2151,13 @@ public:
         }
     }
 
+    // in training, the factors of the running statistics change with every minibatch
+    virtual bool IsReplayable() const override { return !Environment().IsTraining(); }
+
+    // the number of training minibatches seen, which weighs corpus-level running statistics (see ComputeExpAvgFactor())
+    size_t GetNumMinibatchesSeen() const { return m_mbCount; }
+    void SetNumMinibatchesSeen(size_t mbCount) { m_mbCount = mbCount; }
+
 private: // time-constant conversions
 
     // map time constants to exp avg factor
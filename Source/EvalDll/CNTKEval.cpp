@@ -27,6 +27,7 @@
 #include "NoRandomizer.h"
 #include "HeapMemoryProvider.h"
 #include "InputAndParamNodes.h"
+#include "RecurrentNodes.h"
 #include "latticearchive.h"
 
 // TODO: Temporary mechanism to enable memory sharing for
@@ -43,7 +44,15 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     m_config.Parse(config);
     size_t nThreads = m_config("numCPUThreads", "1");
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
+    // hosts that evaluate single samples (e.g. a web server) can raise the grain size, or pin the threads to their share of the machine
+    if (m_config.Exists(L"cpuParallelGrainSize"))
+        CPUMatrix<ElemType>::SetParallelGrainSize(m_config(L"cpuParallelGrainSize"));
+    int firstCpu = m_config(L"cpuThreadAffinity", "-1");
+    if (firstCpu >= 0)
+        CPUMatrix<ElemType>::SetThreadAffinity(firstCpu);
     g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
+    if (m_config.Exists(L"memorySharingPolicy"))
+        ComputationNetwork::SetDefaultMemorySharingPolicy(ParseMemorySharingPolicy(m_config(L"memorySharingPolicy")));
 }
 
 
@@ -259,13 +268,26 @@ VariableLayout CNTKEvalExtended<ElemType>::ToVariableLayout(const ComputationNod
 template<typename ElemType>
 void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
 {
+    UnbindBuffers();
+    m_streams.clear();
+    m_pastValueNodes.clear();
     m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
     m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
     m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
+    // latency mode: with no matrices shared, passes whose shapes are the same as in the previous call are replayed
+    // without revalidation, see ComputationNetwork::EnableForwardReplay()
+    if (this->m_config(L"forwardReplay", false))
+    {
+        if (!this->m_net->AreMatricesAllocated())
+            this->m_net->SetMemorySharingPolicy(MemorySharingPolicy::None);
+        this->m_net->EnableForwardReplay(true);
+    }
     // allocate memory for forward computation
     this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
     this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
     m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
+    m_outputPostProcessing.assign(m_outputNodes.size(), OutputPostProcessing());
+    m_postProcessedOutputs.assign(m_outputNodes.size(), nullptr);
 
     for (const auto& node : m_outputNodes)
     {
@@ -286,9 +308,88 @@ VariableSchema CNTKEvalExtended<ElemType>::GetOutputSchema() const
     {
         schema.push_back(ToVariableLayout(n));
     }
+    if (m_started)
+    {
+        for (size_t i = 0; i < schema.size(); ++i)
+            schema[i].m_numElements = GetNumOutputElements(i);
+    }
     return schema;
 }
 
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::SetOutputPostProcessing(const std::wstring& output, const OutputPostProcessing& postProcessing)
+{
+    if (!m_started)
+        RuntimeError("SetOutputPostProcessing() called before StartForwardEvaluation()");
+
+    auto iter = std::find_if(m_outputNodes.begin(), m_outputNodes.end(), [&](const ComputationNodeBasePtr& node) { return node->GetName() == output; });
+    if (iter == m_outputNodes.end())
+        InvalidArgument("SetOutputPostProcessing: '%ls' is not an output of this evaluation.", output.c_str());
+
+    size_t numElements = (*iter)->GetSampleLayout().GetNumElements();
+    if (postProcessing.m_kind == OutputPostProcessing::TopK && (postProcessing.m_k == 0 || postProcessing.m_k > numElements))
+        InvalidArgument("SetOutputPostProcessing: Top %d of output '%ls' requested, which has %d elements.", (int)postProcessing.m_k, output.c_str(), (int)numElements);
+
+    UnbindBuffers();
+    m_outputPostProcessing[iter - m_outputNodes.begin()] = postProcessing;
+}
+
+// number of elements per sample of an output after post-processing
+template<typename ElemType>
+size_t CNTKEvalExtended<ElemType>::GetNumOutputElements(size_t i) const
+{
+    switch (m_outputPostProcessing[i].m_kind)
+    {
+    case OutputPostProcessing::Argmax:
+        return 1;
+    case OutputPostProcessing::TopK:
+        return 2 * m_outputPostProcessing[i].m_k;
+    default:
+        return m_outputNodes[i]->GetSampleLayout().GetNumElements();
+    }
+}
+
+// value of an output after post-processing, on the device of the network; one column per sample
+template<typename ElemType>
+shared_ptr<Matrix<ElemType>> CNTKEvalExtended<ElemType>::GetOutputValue(size_t i)
+{
+    auto value = dynamic_pointer_cast<Matrix<ElemType>>(m_outputNodes[i]->ValuePtr());
+    const auto& postProcessing = m_outputPostProcessing[i];
+    if (postProcessing.m_kind == OutputPostProcessing::None)
+        return value;
+
+    auto& result = m_postProcessedOutputs[i];
+    if (!result)
+        result = make_shared<Matrix<ElemType>>(value->GetDeviceId());
+    if (!m_maxValues)
+    {
+        m_maxIndices = make_shared<Matrix<ElemType>>(value->GetDeviceId());
+        m_maxValues = make_shared<Matrix<ElemType>>(value->GetDeviceId());
+    }
+
+    switch (postProcessing.m_kind)
+    {
+    case OutputPostProcessing::Argmax:
+        value->VectorMax(*result, *m_maxValues, /*isColWise=*/true);
+        break;
+    case OutputPostProcessing::TopK:
+    {
+        size_t k = postProcessing.m_k;
+        value->VectorMax(*m_maxIndices, *m_maxValues, /*isColWise=*/true, (int)k);
+        result->Resize(2 * k, value->GetNumCols());
+        result->AssignToRowSliceValuesOf(*m_maxIndices, 0, k);
+        result->AssignToRowSliceValuesOf(*m_maxValues, k, k);
+        break;
+    }
+    case OutputPostProcessing::Hardmax:
+        result->AssignHardmaxOf(*value, /*isColWise=*/true);
+        break;
+    default:
+        LogicError("GetOutputValue: Unknown post-processing %d.", (int)postProcessing.m_kind);
+    }
+    return result;
+}
+
 template<typename ElemType>
 VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
 {
@@ -307,6 +408,49 @@ VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
     return inputLayouts;
 }
 
+// Makes the layout of an input a single sequence of numCols samples. A layout that already is one is kept as is, since
+// re-initializing it would discard its cached column masks, and make a replayed pass see a changed layout.
+static void SetSingleSequenceLayout(const MBLayoutPtr& pMBLayout, size_t numCols)
+{
+    const auto& sequences = pMBLayout->GetAllSequences();
+    if (pMBLayout->GetNumParallelSequences() == 1 && pMBLayout->GetNumTimeSteps() == numCols && sequences.size() == 1 &&
+        sequences[0].seqId == 0 && sequences[0].s == 0 && sequences[0].tBegin == 0 && sequences[0].tEnd == (ptrdiff_t)numCols)
+        return;
+    pMBLayout->Init(1, numCols);
+    pMBLayout->AddSequence(0, 0, 0, numCols);
+}
+
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::CheckInputBuffer(size_t i, const ValueBuffer<ElemType, ValueContainer>& buffer, MatrixType type, size_t numRows) const
+{
+    if (buffer.m_buffer.data() == nullptr)
+        RuntimeError("Input %ls: Buffer is not allocated.", m_inputNodes[i]->GetName().c_str());
+    if (type == MatrixType::DENSE)
+    {
+        if (buffer.m_buffer.size() % numRows != 0)
+            RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
+                         m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
+        if (buffer.m_buffer.size() == 0)
+            RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
+    }
+    else if (type == MatrixType::SPARSE)
+    {
+        if (buffer.m_colIndices.data() == nullptr)
+            RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_indices.data() == nullptr)
+            RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_colIndices.size() < 2)
+            RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_colIndices[0] != 0)
+            RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
+            RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
+                         m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
+                         buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
+    }
+}
+
 template<typename ElemType>
 template<template<typename> class ValueContainer>
 void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs)
@@ -314,6 +458,8 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
     if (!m_started)
         RuntimeError("ForwardPass() called before StartForwardEvaluation()");
 
+    UnbindBuffers();
+
     if (inputs.size() != (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()))
         RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()), (int)inputs.size());
 
@@ -330,36 +476,11 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         auto type = matrix->GetMatrixType();
         size_t numRows = inputNode->GetSampleLayout().GetNumElements();
 
-        if (buffer.m_buffer.data() == nullptr)
-            RuntimeError("Input %ls: Buffer is not allocated.", m_inputNodes[i]->GetName().c_str());
-        if (type == MatrixType::DENSE)
-        {
-            if (buffer.m_buffer.size() % numRows != 0)
-                RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
-                             m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
-            if (buffer.m_buffer.size() == 0)
-                RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
-        }
-        else if (type == MatrixType::SPARSE)
-        {
-            if (buffer.m_colIndices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_indices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices.size() < 2)
-                RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices[0] != 0)
-                RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
-                RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
-                             m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
-                             buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
-        }
+        CheckInputBuffer(i, buffer, type, numRows);
 
         int numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
         assert(numCols >= 1);
-        inputNode->GetMBLayout()->Init(1, numCols);
-        inputNode->GetMBLayout()->AddSequence(0, 0, 0, numCols);
+        SetSingleSequenceLayout(inputNode->GetMBLayout(), numCols);
 
         if (type == MatrixType::DENSE)
             matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
@@ -380,7 +501,7 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
     {
         auto node = m_outputNodes[i];
         this->m_net->ForwardProp(node);
-        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        shared_ptr<Matrix<ElemType>> outputMatrix = GetOutputValue(i);
         auto pMBLayout = node->GetMBLayout();
         if (!pMBLayout)
         {
@@ -420,6 +541,375 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs);
 }
 
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::CheckRequests(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs, const char* function)
+{
+    if (!m_started)
+        RuntimeError("%s() called before StartForwardEvaluation()", function);
+
+    UnbindBuffers();
+
+    size_t numRequests = inputs.size();
+    if (numRequests == 0)
+        RuntimeError("%s: Expected at least one request.", function);
+    if (outputs.size() != numRequests)
+        RuntimeError("%s: Expected outputs for %d requests, but got %d.", function, (int)numRequests, (int)outputs.size());
+
+    size_t numInputs = (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end());
+    for (size_t r = 0; r < numRequests; ++r)
+    {
+        if (inputs[r].size() != numInputs)
+            RuntimeError("Request %d: Expected %d inputs, but got %d.", (int)r, (int)numInputs, (int)inputs[r].size());
+        if (outputs[r].size() != m_outputNodes.size())
+            RuntimeError("Request %d: Expected %d outputs, but got %d.", (int)r, (int)m_outputNodes.size(), (int)outputs[r].size());
+    }
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::SetRequestInputs(const std::vector<Values<ElemType>>& inputs, const std::vector<size_t>& history)
+{
+    // Each request is one parallel sequence of the minibatch. Column t * numRequests + r holds step t of request r,
+    // the steps past the end of a shorter request are gaps. A request that continues a sequence begins 'history'
+    // steps before the minibatch.
+    size_t numRequests = inputs.size();
+    std::vector<size_t> lengths(numRequests);
+    std::vector<ElemType> values;
+    std::vector<int> indices;
+    std::vector<int> colIndices;
+    for (size_t i = 0; i < m_inputNodes.size(); ++i)
+    {
+        const auto& inputNode = m_inputNodes[i];
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        auto type = matrix->GetMatrixType();
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+
+        size_t maxLength = 0;
+        for (size_t r = 0; r < numRequests; ++r)
+        {
+            const auto& buffer = inputs[r][i];
+            CheckInputBuffer(i, buffer, type, numRows);
+            lengths[r] = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
+            maxLength = std::max(maxLength, lengths[r]);
+        }
+
+        auto pMBLayout = inputNode->GetMBLayout();
+        pMBLayout->Init(numRequests, maxLength);
+        for (size_t r = 0; r < numRequests; ++r)
+        {
+            pMBLayout->AddSequence(r, r, -(ptrdiff_t)history[r], lengths[r]);
+            pMBLayout->AddGap(r, lengths[r], maxLength);
+        }
+
+        size_t numCols = numRequests * maxLength;
+        if (type == MatrixType::DENSE)
+        {
+            values.assign(numRows * numCols, 0);
+            for (size_t r = 0; r < numRequests; ++r)
+            {
+                const auto& buffer = inputs[r][i].m_buffer;
+                for (size_t t = 0; t < lengths[r]; ++t)
+                    std::copy(buffer.begin() + t * numRows, buffer.begin() + (t + 1) * numRows, values.begin() + (t * numRequests + r) * numRows);
+            }
+            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), values.data(), matrixFlagNormal);
+        }
+        else if (type == MatrixType::SPARSE)
+        {
+            values.clear();
+            indices.clear();
+            colIndices.assign(1, 0);
+            for (size_t t = 0; t < maxLength; ++t)
+            {
+                for (size_t r = 0; r < numRequests; ++r)
+                {
+                    if (t < lengths[r])
+                    {
+                        const auto& buffer = inputs[r][i];
+                        values.insert(values.end(), buffer.m_buffer.begin() + buffer.m_colIndices[t], buffer.m_buffer.begin() + buffer.m_colIndices[t + 1]);
+                        indices.insert(indices.end(), buffer.m_indices.begin() + buffer.m_colIndices[t], buffer.m_indices.begin() + buffer.m_colIndices[t + 1]);
+                    }
+                    colIndices.push_back((int)values.size());
+                }
+            }
+            matrix->SetMatrixFromCSCFormat(colIndices.data(), indices.data(), values.data(), values.size(), numRows, numCols);
+        }
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::GetRequestOutputs(std::vector<Values<ElemType>>& outputs)
+{
+    size_t numRequests = outputs.size();
+    std::vector<ElemType> values;
+    for (size_t i = 0; i < m_outputNodes.size(); ++i)
+    {
+        auto node = m_outputNodes[i];
+        this->m_net->ForwardProp(node);
+        shared_ptr<Matrix<ElemType>> outputMatrix = GetOutputValue(i);
+        size_t numRows = outputMatrix->GetNumRows();
+        size_t numElements = outputMatrix->GetNumElements();
+        values.resize(numElements);
+        ElemType* data = values.data();
+        outputMatrix->CopyToArray(data, numElements);
+
+        // Outputs without a dynamic axis do not depend on the requests, every request gets all of it.
+        auto pMBLayout = node->GetMBLayout();
+        if (!pMBLayout)
+        {
+            for (size_t r = 0; r < numRequests; ++r)
+            {
+                auto& vec = outputs[r][i].m_buffer;
+                if (vec.capacity() < values.size())
+                    RuntimeError("Request %d: Not enough space in output buffer for output '%ls'.", (int)r, node->GetName().c_str());
+                vec.assign(values.begin(), values.end());
+            }
+            continue;
+        }
+
+        for (size_t r = 0; r < numRequests; ++r)
+            outputs[r][i].m_buffer.clear();
+
+        // Only the steps of a sequence inside the minibatch are returned.
+        size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.seqId >= numRequests)
+                RuntimeError("Output '%ls' has a sequence that does not belong to any request.", node->GetName().c_str());
+
+            size_t begin = (size_t)std::max<ptrdiff_t>(seq.tBegin, 0);
+            size_t end = std::min(seq.tEnd, pMBLayout->GetNumTimeSteps());
+            auto& vec = outputs[seq.seqId][i].m_buffer;
+            if (vec.capacity() < (end - begin) * numRows)
+            {
+                // Bad luck - we can't reallocate memory of an external object at this point.
+                RuntimeError("Request %d: Not enough space in output buffer for output '%ls'.", (int)seq.seqId, node->GetName().c_str());
+            }
+
+            for (size_t t = begin; t < end; ++t)
+            {
+                auto column = values.begin() + (t * numParallelSequences + seq.s) * numRows;
+                vec.insert(vec.end(), column, column + numRows);
+            }
+        }
+    }
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    CheckRequests(inputs, outputs, "ForwardPassBatch");
+    SetRequestInputs(inputs, std::vector<size_t>(inputs.size(), 0));
+    GetRequestOutputs(outputs);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassStreams(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs)
+{
+    CheckRequests(inputs, outputs, "ForwardPassStreams");
+    if (streamIds.size() != inputs.size())
+        RuntimeError("ForwardPassStreams: Expected a stream id for each of the %d requests, but got %d.", (int)inputs.size(), (int)streamIds.size());
+    if (std::set<size_t>(streamIds.begin(), streamIds.end()).size() != streamIds.size())
+        RuntimeError("ForwardPassStreams: Each stream can only be continued once per call.");
+    if (m_inputNodes.empty())
+        RuntimeError("ForwardPassStreams: The outputs do not depend on any input.");
+
+    // The recurrent state is carried over by the PastValue nodes. Looking into the future needs the whole stream.
+    if (m_pastValueNodes.empty())
+    {
+        for (const auto& output : m_outputNodes)
+        {
+            for (const auto& node : this->m_net->GetAllNodesForRoot(output))
+            {
+                auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+                if (!pastValueNode)
+                {
+                    if (dynamic_pointer_cast<IStatefulNode>(node))
+                        RuntimeError("ForwardPassStreams: %ls %ls operation cannot be evaluated on streams.", node->NodeName().c_str(), node->OperationName().c_str());
+                    continue;
+                }
+                if (pastValueNode->TimeStep() != 1)
+                    RuntimeError("ForwardPassStreams: %ls %ls operation has a time step of %d, only 1 is supported on streams.", node->NodeName().c_str(), node->OperationName().c_str(), pastValueNode->TimeStep());
+                if (std::find(m_pastValueNodes.begin(), m_pastValueNodes.end(), node) == m_pastValueNodes.end())
+                    m_pastValueNodes.push_back(node);
+            }
+        }
+    }
+
+    size_t numRequests = inputs.size();
+    std::vector<StreamState*> states(numRequests);
+    std::vector<size_t> history(numRequests);
+    for (size_t r = 0; r < numRequests; ++r)
+    {
+        states[r] = &m_streams[streamIds[r]];
+        history[r] = states[r]->m_numSteps;
+    }
+
+    SetRequestInputs(inputs, history);
+
+    // The last value of each stream is imported into the PastValue nodes as if it was the last step of a previous minibatch.
+    for (size_t n = 0; n < m_pastValueNodes.size(); ++n)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_pastValueNodes[n]);
+        size_t numRows = node->GetSampleLayout().GetNumElements();
+        auto pMBLayout = make_shared<MBLayout>(numRequests, 1, L"");
+        Matrix<ElemType> lastValues(numRows, numRequests, node->GetDeviceId());
+        lastValues.SetValue(0);
+        for (size_t r = 0; r < numRequests; ++r)
+        {
+            if (history[r] == 0)
+            {
+                pMBLayout->AddGap(r, 0, 1);
+                continue;
+            }
+            pMBLayout->AddSequence(r, r, 1 - (ptrdiff_t)history[r], 1);
+            lastValues.SetColumnSlice(*states[r]->m_lastValues[n], r, 1);
+        }
+
+        auto state = make_shared<DelayedValueNodeState<ElemType>>(node->GetDeviceId());
+        state->CacheDelayedMBLayout(pMBLayout);
+        state->CacheState(lastValues);
+        dynamic_pointer_cast<IStatefulNode>(node)->ImportState(state);
+    }
+
+    try
+    {
+        GetRequestOutputs(outputs);
+    }
+    catch (...)
+    {
+        // The state of the streams is unchanged, a stream that was new is forgotten again.
+        for (size_t r = 0; r < numRequests; ++r)
+        {
+            if (history[r] == 0)
+                m_streams.erase(streamIds[r]);
+        }
+        throw;
+    }
+
+    // Keep the last value of the input of each PastValue node for the next call of each stream.
+    for (size_t n = 0; n < m_pastValueNodes.size(); ++n)
+    {
+        auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(m_pastValueNodes[n]);
+        auto input = dynamic_pointer_cast<ComputationNode<ElemType>>(node->GetInputs()[0]);
+        auto pMBLayout = node->GetMBLayout();
+        for (size_t r = 0; r < numRequests; ++r)
+        {
+            const auto& seq = pMBLayout->FindSequence(r);
+            auto& lastValue = states[r]->m_lastValues;
+            if (lastValue.size() < m_pastValueNodes.size())
+                lastValue.resize(m_pastValueNodes.size());
+            if (!lastValue[n])
+                lastValue[n] = make_shared<Matrix<ElemType>>(node->GetDeviceId());
+            lastValue[n]->SetValue(input->Value().ColumnSlice(pMBLayout->GetColumnIndex(seq, seq.GetNumTimeSteps() - 1), 1));
+        }
+    }
+
+    for (size_t r = 0; r < numRequests; ++r)
+        states[r]->m_numSteps += m_inputNodes[0]->GetMBLayout()->FindSequence(r).tEnd;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::EndStream(size_t streamId)
+{
+    m_streams.erase(streamId);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::BindBuffers(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs)
+{
+    if (!m_started)
+        RuntimeError("BindBuffers() called before StartForwardEvaluation()");
+    if (std::any_of(m_outputPostProcessing.begin(), m_outputPostProcessing.end(), [](const OutputPostProcessing& p) { return p.m_kind != OutputPostProcessing::None; }))
+        RuntimeError("BindBuffers: Buffers cannot be bound to outputs that are post-processed.");
+
+    UnbindBuffers();
+
+    if (inputs.size() != m_inputNodes.size())
+        RuntimeError("Expected %d inputs, but got %d.", (int)m_inputNodes.size(), (int)inputs.size());
+
+    if (outputs.size() != m_outputNodes.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
+
+    // The values of the nodes are replaced by matrices over the buffers, the original matrices are kept for UnbindBuffers().
+    auto bind = [this](const ComputationNodeBasePtr& node, ElemType* data, size_t numRows, size_t numCols)
+    {
+        auto& value = dynamic_pointer_cast<ComputationNode<ElemType>>(node)->ValuePtrRef();
+        m_boundNodes.push_back(make_pair(node, value));
+        value = make_shared<Matrix<ElemType>>(numRows, numCols, data, value->GetDeviceId(), matrixFlagDontOwnBuffer);
+    };
+
+    try
+    {
+        for (size_t i = 0; i < m_inputNodes.size(); ++i)
+        {
+            const auto& inputNode = m_inputNodes[i];
+            const auto& buffer = inputs[i];
+            auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+            if (matrix->GetMatrixType() != MatrixType::DENSE)
+                RuntimeError("Input %ls: Only dense inputs can be bound.", inputNode->GetName().c_str());
+
+            size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+            CheckInputBuffer(i, buffer, MatrixType::DENSE, numRows);
+
+            size_t numCols = buffer.m_buffer.size() / numRows;
+            SetSingleSequenceLayout(inputNode->GetMBLayout(), numCols);
+            bind(inputNode, const_cast<ElemType*>(buffer.m_buffer.data()), numRows, numCols);
+        }
+
+        // The size of the outputs is only known once the network has run, a matrix over a buffer cannot be resized.
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+        for (size_t i = 0; i < m_outputNodes.size(); ++i)
+        {
+            const auto& node = m_outputNodes[i];
+            this->m_net->ForwardProp(node);
+            auto outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+            auto pMBLayout = node->GetMBLayout();
+            if (pMBLayout && pMBLayout->GetAllSequences().size() != 1)
+                RuntimeError("Only 1 output sequence supported by this API");
+
+            auto& vec = outputs[i].m_buffer;
+            size_t numElements = outputMatrix->GetNumElements();
+            if (vec.capacity() < numElements)
+                RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+
+            vec.resize(numElements);
+            ElemType* data = vec.data();
+            outputMatrix->CopyToArray(data, numElements);
+            bind(node, vec.data(), outputMatrix->GetNumRows(), outputMatrix->GetNumCols());
+        }
+    }
+    catch (...)
+    {
+        UnbindBuffers();
+        throw;
+    }
+    m_buffersBound = true;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPass()
+{
+    if (!m_buffersBound)
+        RuntimeError("ForwardPass() called before BindBuffers()");
+
+    // The inputs may have changed in place.
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+    for (const auto& node : m_outputNodes)
+        this->m_net->ForwardProp(node);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::UnbindBuffers()
+{
+    for (auto& bound : m_boundNodes)
+        dynamic_pointer_cast<ComputationNode<ElemType>>(bound.first)->ValuePtrRef() = bound.second;
+    m_boundNodes.clear();
+    m_buffersBound = false;
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
@@ -427,6 +917,18 @@ void CNTKEvalExtended<ElemType>::Destroy()
     delete this;
 }
 
+template <typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalExtended<ElemType>::Clone()
+{
+    if (this->m_net == nullptr)
+        LogicError("Clone: The network must be created before it can be cloned.");
+
+    auto clone = new CNTKEvalExtended<ElemType>();
+    clone->m_config = this->m_config;
+    clone->m_net = this->m_net->CloneWithSharedParameters();
+    return clone;
+}
+
 template <typename ElemType>
 void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval)
 {
@@ -442,6 +944,18 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
     GetEvalExtended(peval);
 }
 
+void EVAL_API GetEvalGpuDevices(std::vector<int>& deviceIds)
+{
+    deviceIds.clear();
+#ifndef CPUONLY
+    for (const auto& gpu : GetAllGpusData())
+    {
+        if (gpu.validity == GpuValidity::Valid)
+            deviceIds.push_back(gpu.deviceId);
+    }
+#endif
+}
+
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
 } } }
@@ -90,7 +90,7 @@ template <typename ElemType>
 class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
 {
 public:
-    CNTKEvalExtended() : CNTKEvalBase<ElemType>(), m_started(false) {}
+    CNTKEvalExtended() : CNTKEvalBase<ElemType>(), m_started(false), m_buffersBound(false) {}
 
     virtual VariableSchema GetOutputSchema() const override;
 
@@ -102,8 +102,22 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) override;
 
+    virtual void ForwardPassBatch(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual void ForwardPassStreams(const std::vector<size_t>& streamIds, const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs) override;
+
+    virtual void EndStream(size_t streamId) override;
+
+    virtual void BindBuffers(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs) override;
+
+    virtual void ForwardPass() override;
+
+    virtual void SetOutputPostProcessing(const std::wstring& output, const OutputPostProcessing& postProcessing) override;
+
     virtual void Destroy() override;
 
+    virtual IEvaluateModelExtended<ElemType>* Clone() override;
+
     virtual void CreateNetwork(const std::string& networkDescription) override
     {
         CNTKEvalBase<ElemType>::CreateNetwork(networkDescription);
@@ -121,6 +135,37 @@ private:
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
 
+    // nodes whose values are matrices over the buffers of BindBuffers(), with their own matrices
+    std::vector<std::pair<ComputationNodeBasePtr, shared_ptr<Matrix<ElemType>>>> m_boundNodes;
+    bool m_buffersBound;
+
+    void UnbindBuffers();
+
+    // post-processing of each output, see SetOutputPostProcessing(), and the matrices it computes on the device
+    std::vector<OutputPostProcessing> m_outputPostProcessing;
+    std::vector<shared_ptr<Matrix<ElemType>>> m_postProcessedOutputs;
+    shared_ptr<Matrix<ElemType>> m_maxIndices;
+    shared_ptr<Matrix<ElemType>> m_maxValues;
+
+    shared_ptr<Matrix<ElemType>> GetOutputValue(size_t i);
+    size_t GetNumOutputElements(size_t i) const;
+
+    // state carried over between the calls of ForwardPassStreams() of a stream
+    struct StreamState
+    {
+        size_t m_numSteps = 0;                                        // steps evaluated so far
+        std::vector<shared_ptr<Matrix<ElemType>>> m_lastValues;      // last input value of each node of m_pastValueNodes
+    };
+    std::map<size_t, StreamState> m_streams;
+    std::vector<ComputationNodeBasePtr> m_pastValueNodes;
+
+    void CheckRequests(const std::vector<Values<ElemType>>& inputs, std::vector<Values<ElemType>>& outputs, const char* function);
+    void SetRequestInputs(const std::vector<Values<ElemType>>& inputs, const std::vector<size_t>& history);
+    void GetRequestOutputs(std::vector<Values<ElemType>>& outputs);
+
+    template<template<typename> class ValueContainer>
+    void CheckInputBuffer(size_t i, const ValueBuffer<ElemType, ValueContainer>& buffer, MatrixType type, size_t numRows) const;
+
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs);
@@ -181,6 +181,8 @@ public:
         {
             pin_ptr <IEvaluateModelExtended<ElemType>*> p_eval = &m_eval;
             GetEvalExtended<ElemType>(p_eval);
+            m_inputRefs = new Native::ValueRefs<ElemType>();
+            m_outputRefs = new Native::ValueRefs<ElemType>();
         }
         catch (const exception& ex)
         {
@@ -317,6 +319,89 @@ public:
         }
     }
 
+    //
+    // ForwardPass - as above, for dense inputs and outputs held in plain arrays, e.g. arrays the caller keeps across calls.
+    // The arrays are pinned for the duration of the call and used in place; no ValueBuffer objects or copies are made.
+    // Each input array holds all samples of its input, i.e. a multiple of its NumElements values.
+    // Each output array receives NumElements values per sample of its output, and must be at least that long; the number
+    // of values written is returned by GetOutputSize().
+    //
+    void ForwardPass(array<array<ElemType>^>^ inputs, array<array<ElemType>^>^ outputs)
+    {
+        if (inputs == nullptr || outputs == nullptr)
+        {
+            throw gcnew ArgumentNullException(inputs == nullptr ? "inputs" : "outputs");
+        }
+
+        PreparePinning(inputs->Length, outputs->Length);
+        int numPinned = 0;
+        try
+        {
+            for (int i = 0; i < inputs->Length; i++)
+            {
+                Pin(inputs[i], 0, inputs[i] == nullptr ? 0 : inputs[i]->Length, (*m_inputRefs)[i], false, numPinned);
+            }
+            for (int i = 0; i < outputs->Length; i++)
+            {
+                Pin(outputs[i], 0, outputs[i] == nullptr ? 0 : outputs[i]->Length, (*m_outputRefs)[i], true, numPinned);
+            }
+            ForwardPassPinned();
+        }
+        finally
+        {
+            Unpin(numPinned);
+        }
+    }
+
+    //
+    // ForwardPass - as above, for views into arrays, e.g. into a single array pooled for the inputs and outputs of
+    // several requests. Each view is used in place with the same rules as a whole array.
+    //
+    void ForwardPass(array<ArraySegment<ElemType>>^ inputs, array<ArraySegment<ElemType>>^ outputs)
+    {
+        if (inputs == nullptr || outputs == nullptr)
+        {
+            throw gcnew ArgumentNullException(inputs == nullptr ? "inputs" : "outputs");
+        }
+
+        PreparePinning(inputs->Length, outputs->Length);
+        int numPinned = 0;
+        try
+        {
+            for (int i = 0; i < inputs->Length; i++)
+            {
+                Pin(inputs[i].Array, inputs[i].Offset, inputs[i].Count, (*m_inputRefs)[i], false, numPinned);
+            }
+            for (int i = 0; i < outputs->Length; i++)
+            {
+                Pin(outputs[i].Array, outputs[i].Offset, outputs[i].Count, (*m_outputRefs)[i], true, numPinned);
+            }
+            ForwardPassPinned();
+        }
+        finally
+        {
+            Unpin(numPinned);
+        }
+    }
+
+    //
+    // GetOutputSize - number of values the last call of a pinned ForwardPass() overload wrote to an output.
+    //
+    int GetOutputSize(int output)
+    {
+        if (m_outputRefs == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        if (output < 0 || output >= (int)m_outputRefs->size())
+        {
+            throw gcnew ArgumentOutOfRangeException("output");
+        }
+
+        return (int)(*m_outputRefs)[output].m_buffer.m_size;
+    }
+
     ~ModelEvaluationExtended()
     {
         if (m_eval == nullptr)
@@ -335,12 +420,72 @@ protected:
             m_eval->Destroy();
             m_eval = nullptr;
         }
+        delete m_inputRefs;
+        m_inputRefs = nullptr;
+        delete m_outputRefs;
+        m_outputRefs = nullptr;
     }
 
 private:
     // Native model evaluation instance
     IEvaluateModelExtended<ElemType> *m_eval;
 
+    // Native views of the arrays of the pinned ForwardPass() overloads, and their pinning handles; kept across calls
+    Native::ValueRefs<ElemType>* m_inputRefs;
+    Native::ValueRefs<ElemType>* m_outputRefs;
+    array<System::Runtime::InteropServices::GCHandle>^ m_pinHandles;
+
+    void PreparePinning(int numInputs, int numOutputs)
+    {
+        if (m_eval == nullptr)
+        {
+            throw gcnew ObjectDisposedException("Object has been disposed.");
+        }
+
+        if (m_pinHandles == nullptr || m_pinHandles->Length < numInputs + numOutputs)
+        {
+            m_pinHandles = gcnew array<System::Runtime::InteropServices::GCHandle>(numInputs + numOutputs);
+        }
+
+        m_inputRefs->resize(numInputs);
+        m_outputRefs->resize(numOutputs);
+    }
+
+    // Pins count elements of buffer from offset on, and points the native value reference at them. Inputs are full,
+    // outputs are empty with room for count elements; the forward pass sets their size.
+    void Pin(array<ElemType>^ buffer, int offset, int count, Native::ValueBuffer<ElemType, Native::VectorRef>& valueRef, bool isOutput, int% numPinned)
+    {
+        if (buffer == nullptr || count == 0)
+        {
+            throw gcnew CNTKRuntimeException("Invalid buffer (empty) for argument into ForwardPass", String::Empty);
+        }
+
+        m_pinHandles[numPinned] = System::Runtime::InteropServices::GCHandle::Alloc(buffer, System::Runtime::InteropServices::GCHandleType::Pinned);
+        ElemType* data = static_cast<ElemType*>(m_pinHandles[numPinned].AddrOfPinnedObject().ToPointer()) + offset;
+        numPinned++;
+        valueRef.m_buffer.InitFrom(data, count, isOutput ? 0 : count);
+    }
+
+    void Unpin(int numPinned)
+    {
+        for (int i = 0; i < numPinned; i++)
+        {
+            m_pinHandles[i].Free();
+        }
+    }
+
+    void ForwardPassPinned()
+    {
+        try
+        {
+            m_eval->ForwardPass(*m_inputRefs, *m_outputRefs);
+        }
+        catch (const exception& ex)
+        {
+            throw GetCustomException(ex);
+        }
+    }
+
     /// <summary> Throws a CLR exception based on a native exception</summary>
     /// <param name="ex">The native exception to throw as a CLR exception</param>
     /// <returns>A CLR exception</returns>
@@ -541,14 +686,20 @@ void EmitExtended()
     f.GetInputSchema();
     f.GetOutputSchema();
     f.StartForwardEvaluation(nullptr);
-    f.ForwardPass(nullptr, nullptr);
+    f.ForwardPass((array<ValueBuffer<float>^>^)nullptr, (array<ValueBuffer<float>^>^)nullptr);
+    f.ForwardPass((array<array<float>^>^)nullptr, (array<array<float>^>^)nullptr);
+    f.ForwardPass((array<ArraySegment<float>>^)nullptr, (array<ArraySegment<float>>^)nullptr);
+    f.GetOutputSize(0);
 
     ModelEvaluationExtendedD d;
     d.CreateNetwork("");
     d.GetInputSchema();
     d.GetOutputSchema();
     d.StartForwardEvaluation(nullptr);
-    d.ForwardPass(nullptr, nullptr);
+    d.ForwardPass((array<ValueBuffer<double>^>^)nullptr, (array<ValueBuffer<double>^>^)nullptr);
+    d.ForwardPass((array<array<double>^>^)nullptr, (array<array<double>^>^)nullptr);
+    d.ForwardPass((array<ArraySegment<double>>^)nullptr, (array<ArraySegment<double>>^)nullptr);
+    d.GetOutputSize(0);
 
     VariableSchema sc;
     sc.CreateBuffers<float>();
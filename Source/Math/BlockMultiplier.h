@@ -560,7 +560,7 @@ template<typename BlockHandlerT> class BlockMultiplier
             m_pPool.reset(new StdThreadPool<HandlerArgs<BlockHandlerT>>(threads));
 #else
 #ifdef OPENMPTHREAD
-            m_oldNumThreads = omp_get_num_threads();
+            m_oldNumThreads = omp_get_max_threads(); // (omp_get_num_threads() is 1 outside of a parallel region)
             omp_set_num_threads(threads);
 #endif
 #endif
@@ -10,6 +10,7 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPUVectorKernels.h"
 #include "TensorOps.h"
 #include <assert.h>
 #include <stdexcept>
@@ -26,6 +27,8 @@
 #include "Windows.h"
 #else
 #include <cfloat>
+#include <pthread.h>
+#include <sched.h>
 #endif
 
 #ifdef LEAKDETECT
@@ -72,6 +75,18 @@ bool TracingGPUMemoryAllocator::IsTraceEnabled()
     return (m_traceLevel > 0);
 }
 
+GPUMemoryAllocatorKind MATH_API TracingGPUMemoryAllocator::m_allocatorKind = GPUMemoryAllocatorKind::Direct;
+
+void TracingGPUMemoryAllocator::SetAllocatorKind(GPUMemoryAllocatorKind kind)
+{
+    m_allocatorKind = kind;
+}
+
+GPUMemoryAllocatorKind TracingGPUMemoryAllocator::GetAllocatorKind()
+{
+    return m_allocatorKind;
+}
+
 #pragma region Helpful Enum Definitions
 enum class MatrixOrder
 {
@@ -101,6 +116,139 @@ enum class MatrixOpSide : char
 };
 #pragma endregion Helpful Enum Definitions
 
+// see CPUMatrix::SetParallelGrainSize()
+static size_t s_parallelGrainSize = 8192;
+
+static inline bool IsWorthParallelizing(size_t numElements)
+{
+    return numElements >= s_parallelGrainSize;
+}
+
+#pragma region Vectorized Kernels
+
+// The contiguous float cases of some hot loops go through CPUVectorKernels, which uses AVX2 or AVX-512 where the CPU has it.
+// The overloads for other element types return false, and the callers fall back to their own loops.
+
+static bool VectorSumWithKernels(const float* x, size_t n, float& sum)
+{
+    sum = CPUVectorKernels::Get().vectorSum(x, n);
+    return true;
+}
+template <class ElemType>
+static bool VectorSumWithKernels(const ElemType*, size_t, ElemType&)
+{
+    return false;
+}
+
+// us = log softmax(a) of one column of n elements; us may be a
+static bool LogSoftmaxWithKernels(const float* a, float* us, size_t n)
+{
+    const auto& kernels = CPUVectorKernels::Get();
+    float maxV = kernels.vectorMax(a, n); // extract max before applying exp to avoid overflow
+    float logSum = log(kernels.sumOfExp(a, maxV, n));
+    kernels.addScalar(a, -(maxV + logSum), us, n);
+    return true;
+}
+template <class ElemType>
+static bool LogSoftmaxWithKernels(const ElemType*, ElemType*, size_t)
+{
+    return false;
+}
+
+// TensorOp whose innermost dimension is contiguous in all operands, with the vectorized kernels; pointers[N - 1] is the output
+// This covers the flattened elementwise case, and two dimensions for broadcasting (e.g. adding a bias to each column).
+template <size_t N>
+static bool ElementwiseTensorOpWithKernels(float beta, const array<float*, N>& pointers, float alpha, ElementWiseOperator op, const array<size_t, N>& offsets,
+                                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides)
+{
+    if ((regularOpDims.size() != 1) && (regularOpDims.size() != 2))
+        return false;
+    for (size_t i = 0; i < N; i++)
+    {
+        if (regularStrides[i][0] != 1)
+            return false;
+    }
+    CPUVectorKernels::ElementwiseFunction kernel = CPUVectorKernels::Get().GetElementwise(op);
+    if (!kernel)
+        return false;
+
+    const size_t n = regularOpDims[0];
+    const size_t numColumns = (regularOpDims.size() == 2) ? regularOpDims[1] : 1;
+    array<ptrdiff_t, N> columnStrides;
+    for (size_t i = 0; i < N; i++)
+        columnStrides[i] = (regularOpDims.size() == 2) ? regularStrides[i][1] : 0;
+
+    // One work item is a chunk of a column, so that both a few long columns and many short ones are spread over the threads.
+    const size_t chunkSize = 16384;
+    const size_t chunksPerColumn = (n + chunkSize - 1) / chunkSize;
+    const long numItems = (long) (chunksPerColumn * numColumns);
+#pragma omp parallel for if (IsWorthParallelizing(n * numColumns))
+    for (long item = 0; item < numItems; item++)
+    {
+        size_t column = item / chunksPerColumn;
+        size_t begin = (item % chunksPerColumn) * chunkSize;
+        const float* a = pointers[0] + offsets[0] + column * columnStrides[0] + begin;
+        const float* b = (N == 3) ? pointers[1] + offsets[1] + column * columnStrides[1] + begin : nullptr;
+        float* c = pointers[N - 1] + offsets[N - 1] + column * columnStrides[N - 1] + begin;
+        kernel(beta, a, b, alpha, c, std::min(chunkSize, n - begin));
+    }
+    return true;
+}
+
+// unary Max or Min reduction over a contiguous innermost dimension, with the vectorized kernels
+// Sum reductions are left to the generic loop, which aggregates in double (see TensorOpWithFn()).
+template <size_t N>
+static bool ReductionTensorOpWithKernels(float beta, const array<float*, N>& pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp, const array<size_t, N>& offsets,
+                                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                         const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    if ((N != 2) || (op != ElementWiseOperator::opCopy) || (reducingOpDims.size() != 1) || (reducingStrides[0][0] != 1) || (regularOpDims.size() > 1))
+        return false;
+    const auto& kernels = CPUVectorKernels::Get();
+    float (*reduce)(const float*, size_t);
+    if (reductionOp == ElementWiseOperator::opMax)
+        reduce = kernels.vectorMax;
+    else if (reductionOp == ElementWiseOperator::opMin)
+        reduce = kernels.vectorMin;
+    else
+        return false;
+
+    const size_t n = reducingOpDims[0];
+    const long numOutputs = regularOpDims.empty() ? 1 : (long) regularOpDims[0];
+    const ptrdiff_t inputStride = regularOpDims.empty() ? 0 : regularStrides[0][0];
+    const ptrdiff_t outputStride = regularOpDims.empty() ? 0 : regularStrides[N - 1][0];
+#pragma omp parallel for if (IsWorthParallelizing(n * numOutputs))
+    for (long j = 0; j < numOutputs; j++)
+    {
+        float val = alpha * reduce(pointers[0] + offsets[0] + j * inputStride, n);
+        float* pout = pointers[N - 1] + offsets[N - 1] + j * outputStride;
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    }
+    return true;
+}
+
+template <size_t N>
+static bool TensorOpWithKernels(float beta, const array<float*, N>& pointers, float alpha, ElementWiseOperator op, ElementWiseOperator reductionOp, const array<size_t, N>& offsets,
+                                const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    if (reducingOpDims.empty())
+        return ElementwiseTensorOpWithKernels(beta, pointers, alpha, op, offsets, regularOpDims, regularStrides);
+    else
+        return ReductionTensorOpWithKernels(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+}
+template <class ElemType, size_t N>
+static bool TensorOpWithKernels(ElemType, const array<ElemType*, N>&, ElemType, ElementWiseOperator, ElementWiseOperator, const array<size_t, N>&,
+                                const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&,
+                                const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&)
+{
+    return false;
+}
+
+#pragma endregion Vectorized Kernels
+
 #pragma region Constructors and Destructor
 
 template <class ElemType>
@@ -260,7 +408,7 @@ void CPUMatrix<ElemType>::CopyColumnsStrided(const CPUMatrix<ElemType>& fromMatr
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -297,7 +445,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignToRowSliceValuesOf(const CPUMatr
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -374,7 +522,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddToRowSliceValuesOf(const CPUMatrix<
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -415,7 +563,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddWithRowSliceValuesOf(const CPUMatri
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -521,7 +669,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddToRowRepeatValuesOf(const CPUMatrix
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -593,7 +741,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTransposeOf(const CPUMatrix<Elem
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -646,7 +794,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const
         Resize(a.GetNumRows(), idx.GetNumCols());
 
     auto& us = *this;
-#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows.
+#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows. if (IsWorthParallelizing(us.GetNumElements()))
     foreach_column(jOut, us)
     {
         auto jInF = idx(0, jOut);         // this is the column we need to get
@@ -678,7 +826,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
     Scale(beta, us); // if beta is 0, then this will be a memset()
 
-#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows.
+#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows. if (IsWorthParallelizing(a.GetNumElements()))
     foreach_column(jIn, a)
     {
         auto jOutF = idx(0, jIn);           // this is the column we copy/add into
@@ -711,7 +859,7 @@ void CPUMatrix<ElemType>::SetValue(const ElemType v)
         // operation of just setting the values of an array.
         const unsigned SETVALUE_NUM_THREADS = 2;
         UNUSED(SETVALUE_NUM_THREADS); // in case OMP is turned off.
-#pragma omp parallel for num_threads(SETVALUE_NUM_THREADS)
+#pragma omp parallel for num_threads(SETVALUE_NUM_THREADS) if (IsWorthParallelizing(m))
         // four-way unrolling
         for (long i = 0; i < (m & ~3); i += 4)
         {
@@ -736,7 +884,7 @@ void CPUMatrix<ElemType>::MaskColumnsValue(const CPUMatrix<char>& columnsMask, E
 
     auto& us = *this;
     long n = (long) GetNumCols(), m = (long) GetNumRows();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         if (columnsMask(0, j) == 1)
@@ -769,7 +917,7 @@ void CPUMatrix<ElemType>::SetColumn(const ElemType* colPointer, size_t j)
 
     auto& us = *this;
     long m = (long) GetNumRows();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     // four-way unrolling
     for (long i = 0; i < (m & ~3); i += 4)
     {
@@ -793,7 +941,7 @@ void CPUMatrix<ElemType>::SetColumn(const ElemType val, size_t j)
 
     auto& us = *this;
     long m = (long) GetNumRows();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     // four-way unrolling
     for (long i = 0; i < (m & ~3); i += 4)
     {
@@ -818,7 +966,7 @@ void CPUMatrix<ElemType>::SetColumn(const CPUMatrix<ElemType>& valMat, size_t j)
 
     auto& us = *this;
     long m = (long) GetNumRows();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     // four-way unrolling
     for (long i = 0; i < (m & ~3); i += 4)
     {
@@ -897,7 +1045,7 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
                 auto& us = *this;
                 if (sizeof(ElemType) == sizeof(double))
                 {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
                     foreach_column (j, us)
                     {
                         cblas_dcopy((int) numRows, reinterpret_cast<double*>(pArray + j), (int) numCols, reinterpret_cast<double*>(bufPtr + LocateColumn(j)), 1);
@@ -905,7 +1053,7 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
                 }
                 else
                 {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
                     foreach_column (j, us)
                     {
                         {
@@ -927,7 +1075,7 @@ void CPUMatrix<ElemType>::SetDiagonalValue(const ElemType v)
 
     auto& us = *this;
     long m = (long) GetNumRows();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     // four-way unrolling
     for (long i = 0; i < (m & ~3); i += 4)
     {
@@ -966,7 +1114,7 @@ void CPUMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vector)
         long m = (long) GetNumRows();
         if (vector.GetNumRows() == 1) // row vector
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
             // four-way unrolling
             for (long i = 0; i < (m & ~3); i += 4)
             {
@@ -983,7 +1131,7 @@ void CPUMatrix<ElemType>::SetDiagonalValue(const CPUMatrix<ElemType>& vector)
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
             // four-way unrolling
             for (long i = 0; i < (m & ~3); i += 4)
             {
@@ -1132,6 +1280,28 @@ void CPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     }
 }
 
+//[this] = beta * [this] + mask .* a, with the mask regenerated from (seed, firstCounter + element index)
+template <class ElemType>
+void CPUMatrix<ElemType>::DoRandomlyMaskedCopyOf(const ElemType beta, const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter)
+{
+    if (a.GetNumRows() != GetNumRows() || a.GetNumCols() != GetNumCols())
+        InvalidArgument("DoRandomlyMaskedCopyOf: The input matrix dimensions do not match [this].");
+
+    auto& us = *this;
+
+    long m = (long) GetNumRows(), n = (long) GetNumCols();
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
+    for (long j = 0; j < n; j++)
+    {
+        size_t counter = firstCounter + (size_t) j * m;
+        for (long i = 0; i < m; i++)
+        {
+            ElemType v = UniformRandomOfCounter<ElemType>(seed, counter + i) <= maskRate ? 0 : scaleValue * a(i, j);
+            us(i, j) = beta == 0 ? v : beta * us(i, j) + v; // (beta == 0 must not read [this], which may hold NaNs)
+        }
+    }
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1196,6 +1366,118 @@ ElemType CPUMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& gradients, const bool
         return 1;
 }
 
+// this = smoothed gradient; per element: g = clip(g) + l2RegWeight * w; v = momentum * v + (1 - momentum) * learnRatePerSample * g; w -= v (or the Nesterov step)
+template <class ElemType>
+void CPUMatrix<ElemType>::FusedNormalGrad(CPUMatrix<ElemType>& gradients,
+                                          CPUMatrix<ElemType>& functionValues,
+                                          ElemType learnRatePerSample,
+                                          ElemType momentum,
+                                          bool useNAG,
+                                          ElemType clipThreshold,
+                                          ElemType l2RegWeight)
+{
+    if (IsEmpty() || gradients.GetNumCols() != GetNumCols() || gradients.GetNumRows() != GetNumRows())
+    {
+        RequireSize(gradients.GetNumRows(), gradients.GetNumCols());
+        SetValue(0.0);
+    }
+
+    assert(GetNumRows() == gradients.GetNumRows() && GetNumCols() == gradients.GetNumCols());
+    assert(functionValues.GetNumElements() == gradients.GetNumElements());
+
+    size_t n = gradients.GetNumElements();
+    const ElemType* grad = gradients.Data();
+    ElemType* smoothMom = Data();
+    ElemType* val = functionValues.Data();
+    const ElemType gradWeight = (1 - momentum) * learnRatePerSample;
+#pragma omp parallel for if (IsWorthParallelizing(n))
+    for (long i = 0; i < n; i++)
+    {
+        ElemType g = std::max(-clipThreshold, std::min(grad[i], clipThreshold)) + l2RegWeight * val[i];
+        ElemType v = momentum * smoothMom[i] + gradWeight * g;
+        smoothMom[i] = v;
+        val[i] -= useNAG ? momentum * v + gradWeight * g : v;
+    }
+}
+
+// this = accumulated squared gradient; per element: g = clip(g) + l2RegWeight * w; a += g^2; w -= learnRatePerSample * g / sqrt(a)
+template <class ElemType>
+void CPUMatrix<ElemType>::FusedAdagrad(CPUMatrix<ElemType>& gradients,
+                                       CPUMatrix<ElemType>& functionValues,
+                                       ElemType learnRatePerSample,
+                                       ElemType clipThreshold,
+                                       ElemType l2RegWeight)
+{
+    if (IsEmpty() || gradients.GetNumCols() != GetNumCols() || gradients.GetNumRows() != GetNumRows())
+    {
+        RequireSize(gradients.GetNumRows(), gradients.GetNumCols());
+        SetValue(0.0);
+    }
+
+    assert(GetNumRows() == gradients.GetNumRows() && GetNumCols() == gradients.GetNumCols());
+    assert(functionValues.GetNumElements() == gradients.GetNumElements());
+
+    size_t n = gradients.GetNumElements();
+    const ElemType* grad = gradients.Data();
+    ElemType* a = Data();
+    ElemType* val = functionValues.Data();
+    const ElemType floor = 1e-16f;
+#pragma omp parallel for if (IsWorthParallelizing(n))
+    for (long i = 0; i < n; i++)
+    {
+        ElemType g = std::max(-clipThreshold, std::min(grad[i], clipThreshold)) + l2RegWeight * val[i];
+        a[i] += g * g;
+        val[i] -= learnRatePerSample * g / sqrt(a[i] + floor);
+    }
+}
+
+// this = [m v]; per element: g = clip(g) + l2RegWeight * w; m = momentum * m + (1 - momentum) * g; v = varianceMomentum * v + (1 - varianceMomentum) * g^2;
+// step = m * momentumCorrection / (sqrt(v * varianceCorrection) + epsilon); w -= learnRatePerSample * step, or g = step if returnStepInGradients
+template <class ElemType>
+void CPUMatrix<ElemType>::Adam(CPUMatrix<ElemType>& gradients,
+                               CPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType momentum,
+                               ElemType varianceMomentum,
+                               ElemType epsilon,
+                               ElemType momentumCorrection,
+                               ElemType varianceCorrection,
+                               ElemType clipThreshold,
+                               ElemType l2RegWeight,
+                               bool returnStepInGradients)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        RequireSize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+    assert(functionValues.GetNumElements() == gradients.GetNumElements());
+
+    size_t n = gradients.GetNumElements();
+    ElemType* grad = gradients.Data();
+    ElemType* smoothMom = Data();
+    ElemType* smoothVar = Data() + n;
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for if (IsWorthParallelizing(n))
+    for (long i = 0; i < n; i++)
+    {
+        ElemType g = std::max(-clipThreshold, std::min(grad[i], clipThreshold)) + l2RegWeight * val[i];
+        ElemType m = momentum * smoothMom[i] + (1 - momentum) * g;
+        ElemType v = varianceMomentum * smoothVar[i] + (1 - varianceMomentum) * g * g;
+        smoothMom[i] = m;
+        smoothVar[i] = v;
+        ElemType step = m * momentumCorrection / (sqrt(v * varianceCorrection) + epsilon);
+        if (returnStepInGradients)
+            grad[i] = step;
+        else
+            val[i] -= learnRatePerSample * step;
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
                                     CPUMatrix<ElemType>& functionValues,
@@ -1219,7 +1501,7 @@ void CPUMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients,
     ElemType* smoothAda = Data();
     ElemType* smoothMom = Data() + n;
     ElemType* val = functionValues.Data();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(n))
     // TODO: Unroll 4-times for better performance leveraging vectorization
     for (long i = 0; i < n; i++)
     {
@@ -1488,7 +1770,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSumOf(const ElemType alpha, cons
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -1588,7 +1870,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignDifferenceOf(const ElemType alph
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -1617,7 +1899,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignDifferenceOf(const CPUMatrix<Ele
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -1807,7 +2089,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOf(const CPUMatrix
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -1844,7 +2126,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddElementProductOf(const CPUMatrix<El
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -1883,7 +2165,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementDivisionOf(const CPUMatri
 
     ElemType smallValue = EPS_IN_INVERSE;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         ElemType v = b(i, j);
@@ -1911,7 +2193,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::ColumnElementMultiplyWith(const CPUMat
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -1945,7 +2227,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::RowElementMultiplyWith(const CPUMatrix
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         ElemType v = a(0, j);
@@ -1980,7 +2262,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::RowElementDivideBy(const CPUMatrix<Ele
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         ElemType v = a(0, j);
@@ -2021,7 +2303,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::ColumnElementDivideBy(const CPUMatrix<
     long m = (long) GetNumRows(), n = (long) GetNumCols();
 
     ElemType smallValue = EPS_IN_INVERSE;
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         for (long i = 0; i < m; i++)
@@ -2058,7 +2340,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementInverseOf(const CPUMatrix
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         if (a(i, j) < 0 && a(i, j) > -smallValue)
@@ -2089,7 +2371,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSigmoidOf(const CPUMatrix<ElemTy
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         if (a(i, j) >= 0)
@@ -2121,7 +2403,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLinearRectifierDerivativeOf(cons
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2159,7 +2441,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSigmoidDerivativeOf(const CPUMat
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2206,7 +2488,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTanhOf(const CPUMatrix<ElemType>
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2246,9 +2528,12 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
 
     if (isColWise)
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_column (j, a)
         {
+            if (LogSoftmaxWithKernels(&a(0, j), &us(0, j), a.GetNumRows()))
+                continue;
+
             // we need to extract max before applying exp to avoid overflow
             ElemType maxV = a(0, j);
             foreach_row (i, a)
@@ -2264,7 +2549,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogSoftmaxOf(const CPUMatrix<Ele
     }
     else
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_row (i, a)
         {
             // we need to extract max before applying exp to avoid overflow
@@ -2304,7 +2589,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignHardmaxOf(const CPUMatrix<ElemTy
 
     if (isColWise)
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_column (j, a)
         {
             // we need to extract max
@@ -2325,7 +2610,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignHardmaxOf(const CPUMatrix<ElemTy
     }
     else
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_row (i, a)
         {
             // we need to extract max
@@ -2368,7 +2653,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSqrtOf(const CPUMatrix<ElemType>
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2407,7 +2692,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignExpOf(const CPUMatrix<ElemType>&
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2446,7 +2731,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignAbsOf(const CPUMatrix<ElemType>&
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2491,7 +2776,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLogOf(const CPUMatrix<ElemType>&
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         const ElemType v = a(i, j);
@@ -2516,7 +2801,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignLog10Of(const CPUMatrix<ElemType
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         const ElemType v = a(i, j);
@@ -2550,7 +2835,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCosineOf(const CPUMatrix<ElemTyp
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         const ElemType v = a(i, j);
@@ -2577,7 +2862,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNegativeSineOf(const CPUMatrix<E
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         const ElemType v = a(i, j);
@@ -2597,7 +2882,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceTruncateBottom(const ElemType t
     auto& us = *this;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2637,7 +2922,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceTruncate(const ElemType thresho
     ElemType locTHresholdNeg = -locThresholdPos;
 
     long m = (long) GetNumRows(), n = (long) GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
     for (long j = 0; j < n; j++)
     {
         // four-way unrolling
@@ -2686,7 +2971,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceSoftThreshold(const ElemType th
     long m = (long) GetNumElements();
 
     ElemType* bufPtr = Data();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4) // four-way unrolling
     {
         if (bufPtr[i] > threshold)
@@ -2742,7 +3027,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTruncateBottomOf(const CPUMatrix
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         if (a(i, j) < threshold)
@@ -2763,7 +3048,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::InplaceTruncateTop(const ElemType thre
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         if (us(i, j) > threshold)
@@ -2784,7 +3069,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTruncateTopOf(const CPUMatrix<El
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         if (a(i, j) > threshold)
@@ -2805,7 +3090,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::SetToZeroIfAbsLessThan(const ElemType
 
     auto& us = *this;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         if (abs(us(i, j)) < threshold)
@@ -2845,7 +3130,7 @@ ElemType CPUMatrix<ElemType>::SumOfElements() const
 
     ElemType* bufPtr = Data();
 //four-way unrolling
-#pragma omp parallel for reduction(+ : sum)
+#pragma omp parallel for reduction(+ : sum) if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4)
     {
         sum += bufPtr[i] + bufPtr[i + 1] + bufPtr[i + 2] + bufPtr[i + 3];
@@ -2893,14 +3178,17 @@ void CPUMatrix<ElemType>::VectorSum(const CPUMatrix<ElemType>& a, CPUMatrix<Elem
     {
         c.RequireSize(1, n);
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_column (j, a)
         {
             ElemType v = 0;
-            foreach_row (i, a)
+            if (!VectorSumWithKernels(&a(0, j), a.GetNumRows(), v))
             {
+                foreach_row (i, a)
+                {
 #pragma omp atomic
-                v += a(i, j);
+                    v += a(i, j);
+                }
             }
             c(0, j) = v;
         }
@@ -2909,7 +3197,7 @@ void CPUMatrix<ElemType>::VectorSum(const CPUMatrix<ElemType>& a, CPUMatrix<Elem
     {
         c.RequireSize(m, 1);
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_row (i, a)
         {
             ElemType v = 0;
@@ -2940,7 +3228,7 @@ void CPUMatrix<ElemType>::VectorNorm1(CPUMatrix<ElemType>& c, const bool isColWi
     {
         c.RequireSize(1, n);
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
         foreach_column (j, us)
         {
             ElemType v = 0;
@@ -2956,7 +3244,7 @@ void CPUMatrix<ElemType>::VectorNorm1(CPUMatrix<ElemType>& c, const bool isColWi
     {
         c.RequireSize(m, 1);
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
         foreach_row (i, us)
         {
             ElemType v = 0;
@@ -2997,7 +3285,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
 
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_column (j, c)
             {
                 c(0, j) = (ElemType) cblas_dnrm2(m, reinterpret_cast<double*>(bufPtr + us.LocateColumn(j)), 1);
@@ -3005,7 +3293,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_column (j, c)
             {
 #pragma warning(suppress : 4244)
@@ -3019,7 +3307,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
 
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
                 c(i, 0) = cblas_dnrm2(n, reinterpret_cast<double*>(bufPtr + i), m);
@@ -3027,7 +3315,7 @@ void CPUMatrix<ElemType>::VectorNorm2(CPUMatrix<ElemType>& c, const bool isColWi
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
@@ -3175,7 +3463,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddColumnReshapeProductOf(const CPUMat
 #ifdef __INTEL_COMPILER // TODO: check this
 #pragma simd statement
 #endif
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_column (t, a)
         {
             size_t k = 0;
@@ -3199,7 +3487,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddColumnReshapeProductOf(const CPUMat
 #ifdef __INTEL_COMPILER // TODO: check this
 #pragma simd statement
 #endif
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
         foreach_column (t, a)
         {
             size_t k = 0;
@@ -3236,7 +3524,7 @@ ElemType CPUMatrix<ElemType>::FrobeniusNorm() const
 
     ElemType* bufPtr = Data();
 //four-way unrolling
-#pragma omp parallel for reduction(+ : v)
+#pragma omp parallel for reduction(+ : v) if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4)
     {
         v += bufPtr[i] * bufPtr[i] + bufPtr[i + 1] * bufPtr[i + 1] + bufPtr[i + 2] * bufPtr[i + 2] + bufPtr[i + 3] * bufPtr[i + 3];
@@ -3272,7 +3560,7 @@ ElemType CPUMatrix<ElemType>::MatrixNormInf() const
     auto& us = *this;
 
     ElemType v = 0;
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
 #pragma omp critical
@@ -3292,7 +3580,7 @@ ElemType CPUMatrix<ElemType>::MatrixNorm0() const
     auto& us = *this;
 
     ElemType v = 0;
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         if (us(i, j) != 0)
@@ -3315,7 +3603,7 @@ ElemType CPUMatrix<ElemType>::MatrixNorm1() const
     auto& us = *this;
 
     ElemType sum = 0;
-#pragma omp parallel for reduction(+ : sum)
+#pragma omp parallel for reduction(+ : sum) if (IsWorthParallelizing(us.GetNumElements()))
     foreach_coord (i, j, us)
     {
         sum += abs(us(i, j));
@@ -3333,7 +3621,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignSignOf(const CPUMatrix<ElemType>
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_column (j, us)
     {
         foreach_row (i, us)
@@ -3359,7 +3647,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddSignOf(const CPUMatrix<ElemType>& a
     if (this != &a)
         RequireSize(a.GetNumRows(), a.GetNumCols());
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(us.GetNumElements()))
     foreach_column (j, us)
     {
         foreach_row (i, us)
@@ -3395,7 +3683,7 @@ void CPUMatrix<ElemType>::VectorMax(CPUMatrix<ElemType>& maxIndexes, CPUMatrix<E
 
         if (topK == 1)
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
             for (int j = 0; j < n; j++)
             {
                 ElemType v = us(0, j);
@@ -3486,7 +3774,7 @@ void CPUMatrix<ElemType>::VectorMin(CPUMatrix<ElemType>& minIndexes, CPUMatrix<E
         minValues.RequireSize(1, n);
         minIndexes.RequireSize(1, n);
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
         for (int j = 0; j < n; j++)
         {
             ElemType v = us(0, j);
@@ -4018,21 +4306,21 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddAveragePoolingGradient(const CPUMat
 }
 #pragma endregion Other Helper Functions
 
-template <class ElemType>
-void CPUMatrix<ElemType>::ConvolutionForward(const CPUMatrix<ElemType>& kernel, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
-                                             const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const
+// The convolution loops, for a RowMap as in the CUDA kernels, see Convolution.cuh.
+template <class ElemType, class RowMap>
+static void ConvolutionForwardLoop(const CPUMatrix<ElemType>& in, const CPUMatrix<ElemType>& kernel, const RowMap& rowMap,
+                                   const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output)
 {
 #pragma omp parallel for
     for (int64_t sample = 0; sample < (int64_t)output.GetNumCols(); sample++)
     {
         for (size_t row = 0; row < output.GetNumRows(); row++)
         {
-            int colBase = mpRowCol(row, 0);
-            int ivBase = mpRowIwht(row, 0);
-            assert(0 <= colBase && colBase < GetNumRows());
+            int colBase, ivBase, i0;
+            rowMap((int)row, colBase, ivBase, i0);
+            assert(0 <= colBase && colBase < in.GetNumRows());
 
             ElemType sum = 0;
-            int i0 = mpRowRun(row, 0);
             int skip = runs(i0++, 0);
             int size = runs(i0++, 0);
             int imask = i0 + size;
@@ -4041,30 +4329,29 @@ void CPUMatrix<ElemType>::ConvolutionForward(const CPUMatrix<ElemType>& kernel,
                 if (runs(imask + i, 0) == 0)
                     continue;
                 int dcol = runs(i0 + i, 0);
-                assert(0 <= colBase + dcol && colBase + dcol < GetNumRows());
-                sum += kernel.Data()[ivBase + skip + i] * (*this)(colBase + dcol, sample);
+                assert(0 <= colBase + dcol && colBase + dcol < in.GetNumRows());
+                sum += kernel.Data()[ivBase + skip + i] * in(colBase + dcol, sample);
             }
             output(row, sample) = sum;
         }
     }
 }
 
-template <class ElemType>
-void CPUMatrix<ElemType>::ConvolutionBackwardData(const CPUMatrix<ElemType>& kernel, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
-                                                  const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& grad) const
+template <class ElemType, class RowMap>
+static void ConvolutionBackwardDataLoop(const CPUMatrix<ElemType>& srcGrad, const CPUMatrix<ElemType>& kernel, const RowMap& rowMap,
+                                        const CPUMatrix<int>& runs, CPUMatrix<ElemType>& grad)
 {
 #pragma omp parallel for
-    for (int64_t sample = 0; sample < (int64_t)GetNumCols(); sample++)
+    for (int64_t sample = 0; sample < (int64_t)srcGrad.GetNumCols(); sample++)
     {
-        for (size_t row = 0; row < GetNumRows(); row++)
+        for (size_t row = 0; row < srcGrad.GetNumRows(); row++)
         {
-            int colBase = mpRowCol(row, 0);
-            int ivBase = mpRowIwht(row, 0);
+            int colBase, ivBase, i0;
+            rowMap((int)row, colBase, ivBase, i0);
             assert(0 <= colBase && colBase < grad.GetNumRows());
 
-            ElemType curGrad = (*this)(row, sample);
+            ElemType curGrad = srcGrad(row, sample);
 
-            int i0 = mpRowRun(row, 0);
             int skip = runs(i0++, 0);
             int size = runs(i0++, 0);
             int imask = i0 + size;
@@ -4080,22 +4367,21 @@ void CPUMatrix<ElemType>::ConvolutionBackwardData(const CPUMatrix<ElemType>& ker
     }
 }
 
-template <class ElemType>
-void CPUMatrix<ElemType>::ConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
-                                                    const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad) const
+template <class ElemType, class RowMap>
+static void ConvolutionBackwardKernelLoop(const CPUMatrix<ElemType>& srcGrad, const CPUMatrix<ElemType>& in, const RowMap& rowMap,
+                                          const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad)
 {
     // Do NOT parallelize these loops!
-    for (size_t sample = 0; sample < GetNumCols(); sample++)
+    for (size_t sample = 0; sample < srcGrad.GetNumCols(); sample++)
     {
-        for (size_t row = 0; row < GetNumRows(); row++)
+        for (size_t row = 0; row < srcGrad.GetNumRows(); row++)
         {
-            int colBase = mpRowCol(row, 0);
-            int ivBase = mpRowIwht(row, 0);
+            int colBase, ivBase, i0;
+            rowMap((int)row, colBase, ivBase, i0);
             assert(0 <= colBase && colBase < in.GetNumRows());
 
-            ElemType curGrad = (*this)(row, sample);
+            ElemType curGrad = srcGrad(row, sample);
 
-            int i0 = mpRowRun(row, 0);
             int skip = runs(i0++, 0);
             int size = runs(i0++, 0);
             int imask = i0 + size;
@@ -4111,6 +4397,54 @@ void CPUMatrix<ElemType>::ConvolutionBackwardKernel(const CPUMatrix<ElemType>& i
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::ConvolutionForward(const CPUMatrix<ElemType>& kernel, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
+                                             const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const
+{
+    TableConvolveRowMap rowMap = { mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data() };
+    ConvolutionForwardLoop(*this, kernel, rowMap, runs, output);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ConvolutionBackwardData(const CPUMatrix<ElemType>& kernel, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
+                                                  const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& grad) const
+{
+    TableConvolveRowMap rowMap = { mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data() };
+    ConvolutionBackwardDataLoop(*this, kernel, rowMap, runs, grad);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
+                                                    const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad) const
+{
+    TableConvolveRowMap rowMap = { mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data() };
+    ConvolutionBackwardKernelLoop(*this, in, rowMap, runs, kernelGrad);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ConvolutionForward(const CPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const CPUMatrix<int>& mpKeyRun,
+                                             const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const
+{
+    CompactConvolveRowMap rowMap = { geometry, mpKeyRun.Data() };
+    ConvolutionForwardLoop(*this, kernel, rowMap, runs, output);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ConvolutionBackwardData(const CPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const CPUMatrix<int>& mpKeyRun,
+                                                  const CPUMatrix<int>& runs, CPUMatrix<ElemType>& grad) const
+{
+    CompactConvolveRowMap rowMap = { geometry, mpKeyRun.Data() };
+    ConvolutionBackwardDataLoop(*this, kernel, rowMap, runs, grad);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::ConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const CompactConvolveGeometry& geometry, const CPUMatrix<int>& mpKeyRun,
+                                                    const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad) const
+{
+    CompactConvolveRowMap rowMap = { geometry, mpKeyRun.Data() };
+    ConvolutionBackwardKernelLoop(*this, in, rowMap, runs, kernelGrad);
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const CPUMatrix<int>& mpRowCol,
                                                  const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const
@@ -4371,57 +4705,289 @@ void CPUMatrix<ElemType>::AveragePoolingBackward(const CPUMatrix<int>& mpRowCol,
     }
 }
 
+// The batch normalization loops. The data [V x N] holds F features (the rows of scale) of S = V / F consecutive
+// elements per column; S is 1 unless spatial. The statistics of a feature are over its S * N elements, and each
+// loop reads the data once:
+//  - spatial: per feature, the block of S elements of each column, with lane-wise partial sums that the
+//    compiler keeps in vector registers;
+//  - per activation: per range of BatchNormRows consecutive features, each column at once, elementwise over the range.
+// The threads share the features, and for the elementwise passes also the columns.
+static const size_t BatchNormRows = 256;
+static const int BatchNormLanes = 8;
+
+// mean and sum of squared deviations of n values
 template <class ElemType>
-void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor,
-                                                    CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runInvStdDev, CPUMatrix<ElemType>& out, double epsilon,
-                                                    CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev) const
+static void BatchNormBlockMoments(const ElemType* x, size_t n, ElemType& mean, ElemType& m2)
 {
-    UNUSED(epsilon);
-
-    assert((GetNumRows() % scale.GetNumRows()) == 0);
-
-    if (expAvgFactor != 0 || blendFactor != 1)
-        RuntimeError("Batch normalization training on CPU is not yet implemented.");
-
-    saveMean.Resize(0, 0); // only doing inference: these two are not produced
-    saveInvStdDev.Resize(0, 0);
+    ElemType sum[BatchNormLanes] = { 0 };
+    size_t i = 0;
+    for (; i + BatchNormLanes <= n; i += BatchNormLanes)
+    {
+        for (int j = 0; j < BatchNormLanes; j++)
+            sum[j] += x[i + j];
+    }
+    for (; i < n; i++)
+        sum[0] += x[i];
+    ElemType total = 0;
+    for (int j = 0; j < BatchNormLanes; j++)
+        total += sum[j];
+    mean = total / n;
 
-    bool spatial = GetNumRows() != scale.GetNumRows();
-    if (spatial)
+    // (the block is still in the cache)
+    ElemType sq[BatchNormLanes] = { 0 };
+    for (i = 0; i + BatchNormLanes <= n; i += BatchNormLanes)
     {
-        size_t spatialSize = GetNumRows() / scale.GetNumRows();
-#pragma omp parallel for
-        for (long icol = 0; icol < out.GetNumCols(); icol++)
+        for (int j = 0; j < BatchNormLanes; j++)
         {
-            for (long irow = 0; irow < out.GetNumRows(); irow++)
-            {
-                size_t imap = irow / spatialSize;
-                out(irow, icol) = scale(imap, 0) * ((*this)(irow, icol) - runMean(imap, 0)) * runInvStdDev(imap, 0) + bias(imap, 0);
-            }
+            ElemType d = x[i + j] - mean;
+            sq[j] += d * d;
         }
     }
-    else
+    for (; i < n; i++)
+        sq[0] += (x[i] - mean) * (x[i] - mean);
+    m2 = 0;
+    for (int j = 0; j < BatchNormLanes; j++)
+        m2 += sq[j];
+}
+
+// sum of dy and of dy * (x - mean) over n values
+template <class ElemType>
+static void BatchNormBlockGradientSums(const ElemType* x, const ElemType* dy, size_t n, ElemType mean, ElemType& sumDy, ElemType& sumDyX)
+{
+    ElemType sumA[BatchNormLanes] = { 0 };
+    ElemType sumB[BatchNormLanes] = { 0 };
+    size_t i = 0;
+    for (; i + BatchNormLanes <= n; i += BatchNormLanes)
+    {
+        for (int j = 0; j < BatchNormLanes; j++)
+        {
+            sumA[j] += dy[i + j];
+            sumB[j] += dy[i + j] * (x[i + j] - mean);
+        }
+    }
+    for (; i < n; i++)
+    {
+        sumA[0] += dy[i];
+        sumB[0] += dy[i] * (x[i] - mean);
+    }
+    sumDy = sumDyX = 0;
+    for (int j = 0; j < BatchNormLanes; j++)
+    {
+        sumDy += sumA[j];
+        sumDyX += sumB[j];
+    }
+}
+
+// mean[f] and invStdDev[f] = 1 / sqrt(variance + epsilon) of each feature, with the biased variance
+template <class ElemType>
+static void BatchNormStatistics(const ElemType* x, size_t featureCount, size_t spatialSize, size_t batchSize, double epsilon,
+                                ElemType* mean, ElemType* invStdDev)
+{
+    size_t vectorSize = featureCount * spatialSize;
+    if (spatialSize > 1)
     {
 #pragma omp parallel for
-        for (long icol = 0; icol < out.GetNumCols(); icol++)
+        for (int64_t f = 0; f < (int64_t)featureCount; f++)
         {
-            for (long irow = 0; irow < out.GetNumRows(); irow++)
+            // combine the moments of the blocks as they come (Chan et al.)
+            double fMean = 0, fM2 = 0;
+            for (size_t n = 0; n < batchSize; n++)
             {
-                out(irow, icol) = scale(irow, 0) * ((*this)(irow, icol) - runMean(irow, 0)) * runInvStdDev(irow, 0) + bias(irow, 0);
+                ElemType blockMean, blockM2;
+                BatchNormBlockMoments(x + n * vectorSize + f * spatialSize, spatialSize, blockMean, blockM2);
+                double count = (double)n * spatialSize;
+                double delta = blockMean - fMean;
+                fMean += delta * spatialSize / (count + spatialSize);
+                fM2 += blockM2 + delta * delta * count * spatialSize / (count + spatialSize);
             }
+            mean[f] = (ElemType)fMean;
+            invStdDev[f] = (ElemType)(1 / sqrt(fM2 / ((double)spatialSize * batchSize) + epsilon));
+        }
+    }
+    else
+    {
+        int64_t rangeCount = (featureCount + BatchNormRows - 1) / BatchNormRows;
+#pragma omp parallel for
+        for (int64_t range = 0; range < rangeCount; range++)
+        {
+            size_t begin = range * BatchNormRows;
+            size_t end = min(featureCount, begin + BatchNormRows);
+            // Welford's update, a column at a time; invStdDev[] holds the sums of squared deviations until the end
+            for (size_t f = begin; f < end; f++)
+                mean[f] = invStdDev[f] = 0;
+            for (size_t n = 0; n < batchSize; n++)
+            {
+                const ElemType* col = x + n * vectorSize;
+                ElemType w = (ElemType)1 / (n + 1);
+                for (size_t f = begin; f < end; f++)
+                {
+                    ElemType delta = col[f] - mean[f];
+                    mean[f] += delta * w;
+                    invStdDev[f] += delta * (col[f] - mean[f]);
+                }
+            }
+            for (size_t f = begin; f < end; f++)
+                invStdDev[f] = (ElemType)(1 / sqrt(invStdDev[f] / (double)batchSize + epsilon));
+        }
+    }
+}
+
+// y = a[f] * (x - mean[f]) + b[f] (+ c[f] * y0 + y if accumulate), elementwise
+template <class ElemType, bool accumulate>
+static void BatchNormAffine(const ElemType* x, const ElemType* y0, ElemType* y, size_t featureCount, size_t spatialSize, size_t batchSize,
+                            const ElemType* mean, const ElemType* a, const ElemType* b, const ElemType* c)
+{
+    size_t vectorSize = featureCount * spatialSize;
+    size_t segmentSize = spatialSize > 1 ? spatialSize : BatchNormRows;
+    int64_t segmentCount = (vectorSize + segmentSize - 1) / segmentSize; // per column: the features, or ranges of them
+    int64_t itemCount = segmentCount * (int64_t)batchSize;
+#pragma omp parallel for if (IsWorthParallelizing(vectorSize * batchSize))
+    for (int64_t item = 0; item < itemCount; item++)
+    {
+        size_t begin = (item % segmentCount) * segmentSize;
+        size_t end = min(vectorSize, begin + segmentSize);
+        size_t offset = (item / segmentCount) * vectorSize;
+        const ElemType* px = x + offset;
+        const ElemType* py0 = accumulate ? y0 + offset : nullptr;
+        ElemType* py = y + offset;
+        if (spatialSize > 1)
+        {
+            size_t f = begin / spatialSize;
+            ElemType meanf = mean[f], af = a[f], bf = b[f], cf = accumulate ? c[f] : 0;
+            for (size_t i = begin; i < end; i++)
+                py[i] = accumulate ? py[i] + af * (px[i] - meanf) + bf + cf * py0[i] : af * (px[i] - meanf) + bf;
+        }
+        else
+        {
+            for (size_t i = begin; i < end; i++)
+                py[i] = accumulate ? py[i] + a[i] * (px[i] - mean[i]) + b[i] + c[i] * py0[i] : a[i] * (px[i] - mean[i]) + b[i];
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchNormalizationForward(const CPUMatrix<ElemType>& scale, const CPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor,
+                                                    CPUMatrix<ElemType>& runMean, CPUMatrix<ElemType>& runInvStdDev, CPUMatrix<ElemType>& out, double epsilon,
+                                                    CPUMatrix<ElemType>& saveMean, CPUMatrix<ElemType>& saveInvStdDev) const
+{
+    assert((GetNumRows() % scale.GetNumRows()) == 0);
+
+    size_t featureCount = scale.GetNumRows();
+    size_t spatialSize = GetNumRows() / featureCount;
+    size_t batchSize = GetNumCols();
+
+    // --- compute data mean/stddev (into saveMean/saveInvStdDev) and update running mean/stddev, as on the GPU
+    if (expAvgFactor > 0 || blendFactor < 1)
+    {
+        saveMean.RequireSize(runMean.GetNumRows(), runMean.GetNumCols());
+        saveInvStdDev.RequireSize(runMean.GetNumRows(), runMean.GetNumCols());
+        BatchNormStatistics(Data(), featureCount, spatialSize, batchSize, epsilon, saveMean.Data(), saveInvStdDev.Data());
+        for (size_t f = 0; f < featureCount; f++)
+        {
+            runMean(f, 0) = expAvgFactor == 1 ? saveMean(f, 0) : (ElemType)(expAvgFactor * saveMean(f, 0) + (1 - expAvgFactor) * runMean(f, 0));
+            runInvStdDev(f, 0) = expAvgFactor == 1 ? saveInvStdDev(f, 0) : (ElemType)(expAvgFactor * saveInvStdDev(f, 0) + (1 - expAvgFactor) * runInvStdDev(f, 0));
         }
     }
+    else // only doing inference: these two are not produced
+    {
+        saveMean.Resize(0, 0);
+        saveInvStdDev.Resize(0, 0);
+    }
+
+    // --- normalize with the mean/stddev of the minibatch, blended with the running ones, or with the running ones only
+    const CPUMatrix<ElemType>& mean = blendFactor < 1 ? saveMean : runMean;
+    const CPUMatrix<ElemType>& invStdDev = blendFactor < 1 ? saveInvStdDev : runInvStdDev;
+    if (blendFactor < 1 && blendFactor > 0)
+    {
+        for (size_t f = 0; f < featureCount; f++)
+        {
+            saveMean(f, 0) = (ElemType)((1 - blendFactor) * saveMean(f, 0) + blendFactor * runMean(f, 0));
+            saveInvStdDev(f, 0) = (ElemType)((1 - blendFactor) * saveInvStdDev(f, 0) + blendFactor * runInvStdDev(f, 0));
+        }
+    }
+    // out = scale * invStdDev * (x - mean) + bias
+    vector<ElemType> a(featureCount);
+    for (size_t f = 0; f < featureCount; f++)
+        a[f] = scale(f, 0) * invStdDev(f, 0);
+    BatchNormAffine<ElemType, false>(Data(), nullptr, out.Data(), featureCount, spatialSize, batchSize, mean.Data(), a.data(), bias.Data(), nullptr);
 }
 
+// saveMean/saveInvStdDev are the mean/stddev used in the forward pass, see GPUMatrix::BatchNormalizationBackward().
 template <class ElemType>
 void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double blendFactor,
                                                      const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
                                                      CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const
 {
-    UNUSED(in); UNUSED(grad); UNUSED(scale); UNUSED(blendFactor), UNUSED(saveMean); UNUSED(saveInvStdDev); UNUSED(scaleGrad); UNUSED(biasGrad);
-    RuntimeError("Batch normalization training on CPU is not yet implemented.");
-}
+    assert((GetNumRows() % scale.GetNumRows()) == 0);
 
+    size_t featureCount = scale.GetNumRows();
+    size_t spatialSize = GetNumRows() / featureCount;
+    size_t batchSize = GetNumCols();
+    size_t vectorSize = GetNumRows();
+    const ElemType* x = in.Data();
+    const ElemType* dy = Data();
+    const ElemType* mean = saveMean.Data();
+
+    // --- biasGrad = sum of dy, scaleGrad = sum of dy * xHat, with xHat = (x - mean) * invStdDev
+    ElemType* dScale = scaleGrad.Data();
+    ElemType* dBias = biasGrad.Data();
+    if (spatialSize > 1)
+    {
+#pragma omp parallel for
+        for (int64_t f = 0; f < (int64_t)featureCount; f++)
+        {
+            double sumDy = 0, sumDyX = 0;
+            for (size_t n = 0; n < batchSize; n++)
+            {
+                size_t offset = n * vectorSize + f * spatialSize;
+                ElemType blockDy, blockDyX;
+                BatchNormBlockGradientSums(x + offset, dy + offset, spatialSize, mean[f], blockDy, blockDyX);
+                sumDy += blockDy;
+                sumDyX += blockDyX;
+            }
+            dBias[f] = (ElemType)sumDy;
+            dScale[f] = (ElemType)(sumDyX * saveInvStdDev(f, 0));
+        }
+    }
+    else
+    {
+        int64_t rangeCount = (featureCount + BatchNormRows - 1) / BatchNormRows;
+#pragma omp parallel for
+        for (int64_t range = 0; range < rangeCount; range++)
+        {
+            size_t begin = range * BatchNormRows;
+            size_t end = min(featureCount, begin + BatchNormRows);
+            for (size_t f = begin; f < end; f++)
+                dBias[f] = dScale[f] = 0;
+            for (size_t n = 0; n < batchSize; n++)
+            {
+                const ElemType* colX = x + n * vectorSize;
+                const ElemType* colDy = dy + n * vectorSize;
+                for (size_t f = begin; f < end; f++)
+                {
+                    dBias[f] += colDy[f];
+                    dScale[f] += colDy[f] * (colX[f] - mean[f]);
+                }
+            }
+            for (size_t f = begin; f < end; f++)
+                dScale[f] *= saveInvStdDev(f, 0);
+        }
+    }
+
+    // --- grad += scale * invStdDev * (dy - mbStatsWeight * (xHat * scaleGrad + biasGrad) / m), m the count of a feature;
+    // that is, grad += a * (x - mean) + b + c * dy
+    ElemType mbStatsWeight = (ElemType)(1 - blendFactor); // weight for contribution from actual MB stats (0 if none, e.g. locked BN node)
+    ElemType m = (ElemType)(spatialSize * batchSize);
+    vector<ElemType> a(featureCount), b(featureCount), c(featureCount);
+    for (size_t f = 0; f < featureCount; f++)
+    {
+        ElemType invStdDev = saveInvStdDev(f, 0);
+        c[f] = scale(f, 0) * invStdDev;
+        a[f] = -c[f] * mbStatsWeight * invStdDev * dScale[f] / m;
+        b[f] = -c[f] * mbStatsWeight * dBias[f] / m;
+    }
+    BatchNormAffine<ElemType, true>(x, dy, grad.Data(), featureCount, spatialSize, batchSize, mean, a.data(), b.data(), c.data());
+}
 
 #pragma region Static BLAS Functions
 
@@ -4498,6 +5064,55 @@ void CPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB,
+                                                        ElemType beta, CPUMatrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+    size_t batchSize = max(a.GetNumCols(), b.GetNumCols());
+    if (a.GetNumRows() != m * k || b.GetNumRows() != k * n || (a.GetNumCols() != batchSize && a.GetNumCols() != 1) || (b.GetNumCols() != batchSize && b.GetNumCols() != 1))
+        InvalidArgument("CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : Operands [%d x %d] and [%d x %d] do not hold [%d x %d] and [%d x %d] matrices.",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) b.GetNumRows(), (int) b.GetNumCols(), (int) m, (int) k, (int) k, (int) n);
+    if (m == 0 || n == 0 || k == 0 || m * k > INT_MAX || k * n > INT_MAX || m * n > INT_MAX)
+        InvalidArgument("CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : Unsupported matrix dimensions [%d x %d] * [%d x %d].", (int) m, (int) k, (int) k, (int) n);
+
+    if (beta == 0)
+        c.RequireSize(m * n, batchSize);
+    else
+        c.VerifySize(m * n, batchSize); // Can't resize if beta != 0
+    if (batchSize == 0)
+        return;
+
+    // a single column is used for all products
+    size_t strideA = a.GetNumCols() == 1 ? 0 : m * k;
+    size_t strideB = b.GetNumCols() == 1 ? 0 : k * n;
+    CBLAS_TRANSPOSE mklTransA = transposeA ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    CBLAS_TRANSPOSE mklTransB = transposeB ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans;
+    int lda = (int) (transposeA ? k : m);
+    int ldb = (int) (transposeB ? n : k);
+    int ldc = (int) m;
+
+    // The products are too small for BLAS to parallelize them, so we run them in parallel instead.
+    // This requires a thread-safe BLAS; BLAS libraries other than MKL are not guaranteed to be.
+#ifdef USE_MKL
+#pragma omp parallel for if (IsWorthParallelizing(batchSize * m * n * k))
+#endif
+    for (long j = 0; j < (long) batchSize; j++)
+    {
+        ElemType* aj = a.Data() + j * strideA;
+        ElemType* bj = b.Data() + j * strideB;
+        ElemType* cj = c.Data() + j * m * n;
+        if (sizeof(ElemType) == sizeof(double))
+        {
+            cblas_dgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, (int) m, (int) n, (int) k, alpha, reinterpret_cast<double*>(aj), lda, reinterpret_cast<double*>(bj), ldb, beta, reinterpret_cast<double*>(cj), ldc);
+        }
+        else
+        {
+#pragma warning(suppress : 4244)
+            cblas_sgemm((CBLAS_ORDER) (int)MatrixOrder::ColMajor, mklTransA, mklTransB, (int) m, (int) n, (int) k, alpha, reinterpret_cast<float*>(aj), lda, reinterpret_cast<float*>(bj), ldb, beta, reinterpret_cast<float*>(cj), ldc);
+        }
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b,
                                                     ElemType beta, CPUMatrix<ElemType>& c)
@@ -4506,11 +5121,11 @@ void CPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const CPUMat
 
     ElemType f = alpha * a.Get00Element();
     if (beta == 0) // don't even read the memory if beta is 0
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
         foreach_coord (i, j, c)
             c(i, j) = b(i, j) * f;
     else
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
         foreach_coord (i, j, c)
             c(i, j) = b(i, j) * f + c(i, j) * beta;
 }
@@ -4600,6 +5215,59 @@ void CPUMatrix<ElemType>::AssignSoftmaxSum(const CPUMatrix<ElemType>& softmax, C
     c(0, 0) = -log_likelihood;
 }
 
+// see Matrix<ElemType>::AssignGMMLogLikelihoodOf()
+// The log-likelihoods of the components are kept in 'posterior' until their log-sum-exp is known.
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const CPUMatrix<ElemType>& prior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& stddev, const CPUMatrix<ElemType>& feature,
+                                                   CPUMatrix<ElemType>& normedDeviationVectors, CPUMatrix<ElemType>& normedDeviation, CPUMatrix<ElemType>& posterior)
+{
+    const long numComponents = (long) prior.GetNumRows();
+    const long featureDim = (long) feature.GetNumRows();
+    const long numSamples = (long) feature.GetNumCols();
+    // (the normalization uses the number of components, as the gradient w.r.t. the log stddev does)
+    const ElemType logNormalizer = (ElemType)(numComponents / 2.0 * log(TWO_PI));
+
+#pragma omp parallel for
+    for (long j = 0; j < numSamples; j++)
+    {
+        const ElemType* x = feature.Data() + j * featureDim;
+        const ElemType* p = prior.Data() + (prior.GetNumCols() == 1 ? 0 : j * numComponents);
+        const ElemType* s = stddev.Data() + (stddev.GetNumCols() == 1 ? 0 : j * numComponents);
+        const ElemType* mu = mean.Data() + (mean.GetNumCols() == 1 ? 0 : j * numComponents * featureDim);
+        ElemType* dev = normedDeviationVectors.Data() + j * numComponents * featureDim;
+        ElemType* nd = normedDeviation.Data() + j * numComponents;
+        ElemType* post = posterior.Data() + j * numComponents;
+
+        ElemType maxLogLikelihood = -std::numeric_limits<ElemType>::infinity();
+        for (long c = 0; c < numComponents; c++)
+        {
+            const ElemType variance = s[c] * s[c];
+            const ElemType* muc = mu + c * featureDim;
+            ElemType* devc = dev + c * featureDim;
+            ElemType sum = 0;
+#pragma omp simd reduction(+ : sum)
+            for (long k = 0; k < featureDim; k++)
+            {
+                ElemType d = x[k] - muc[k];
+                sum += d * d;
+                devc[k] = d / variance;
+            }
+            nd[c] = sum / variance;
+            post[c] = log(p[c]) - nd[c] / 2 - numComponents / (ElemType) 2 * log(variance) - logNormalizer;
+            maxLogLikelihood = max(maxLogLikelihood, post[c]);
+        }
+
+        ElemType sum = 0;
+        for (long c = 0; c < numComponents; c++)
+            sum += exp(post[c] - maxLogLikelihood);
+        const ElemType logLikelihood = maxLogLikelihood + log(sum);
+
+        for (long c = 0; c < numComponents; c++)
+            post[c] = exp(post[c] - logLikelihood);
+        Data()[j] = logLikelihood;
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a,
                                                     const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& bias, CPUMatrix<ElemType>& c)
@@ -4772,7 +5440,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
     {
         ElemType v = alpha * a(0, 0);
         long m = (long) c.GetNumRows(), n = (long) c.GetNumCols();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
         for (long j = 0; j < n; j++)
         {
             // four-way unrolling
@@ -4801,7 +5469,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
         ElemType* cBufPtr = c.Data();
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_column (j, c)
             {
                 cblas_daxpy(m, alpha, reinterpret_cast<double*>(aBufPtr), 1, reinterpret_cast<double*>(cBufPtr + c.LocateColumn(j)), 1);
@@ -4809,7 +5477,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_column (j, c)
             {
 #pragma warning(suppress : 4244)
@@ -4829,7 +5497,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
         ElemType* cBufPtr = c.Data();
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
                 cblas_daxpy(n, alpha, reinterpret_cast<double*>(aBufPtr), 1, reinterpret_cast<double*>(cBufPtr + i), m);
@@ -4837,7 +5505,7 @@ void CPUMatrix<ElemType>::ScaleAndAdd(ElemType alpha, const CPUMatrix<ElemType>&
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
@@ -4871,7 +5539,7 @@ void CPUMatrix<ElemType>::AddScaledDifference(const ElemType alpha, const CPUMat
 	ElemType* bBufPtr = b.Data();
 	ElemType* cBufPtr = c.Data();
     long m = (long) c.GetNumElements();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     // four-way unrolling
     for (long i = 0; i < (m & ~3); i += 4)
     {
@@ -4913,7 +5581,7 @@ void CPUMatrix<ElemType>::AssignScaledDifference(const ElemType alpha, const CPU
 	ElemType* bBufPtr = b.Data();
 	ElemType* cBufPtr = c.Data();
     long m = (long) c.GetNumElements();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     // four-way unrolling
     for (long i = 0; i < (m & ~3); i += 4)
     {
@@ -5024,7 +5692,7 @@ template <class ElemType>
     }
 
     long size = (long) c.GetNumElements();
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(size))
     // four-way unrolling
     for (long i = 0; i < (size & ~3); i += 4)
     {
@@ -5112,7 +5780,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
 		ElemType* bBufPtr = b.Data();
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_column (j, c)
             {
                 c(0, j) = (ElemType) cblas_ddot(m, reinterpret_cast<double*>(aBufPtr + a.LocateColumn(j)), 1, reinterpret_cast<double*>(bBufPtr + b.LocateColumn(j)), 1);
@@ -5120,7 +5788,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_column (j, c)
             {
 #pragma warning(suppress : 4244)
@@ -5136,7 +5804,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
 		ElemType* bBufPtr = b.Data();
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
                 c(i, 0) = cblas_ddot(n, reinterpret_cast<double*>(aBufPtr + i), m, reinterpret_cast<double*>(bBufPtr + i), m);
@@ -5144,7 +5812,7 @@ void CPUMatrix<ElemType>::InnerProduct(const CPUMatrix<ElemType>& a, const CPUMa
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
@@ -5192,7 +5860,7 @@ void CPUMatrix<ElemType>::ElementWisePower(ElemType alpha, const CPUMatrix<ElemT
 
     if (alpha == 2)
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
         foreach_coord (i, j, c)
         {
             c(i, j) = a(i, j) * a(i, j);
@@ -5200,7 +5868,7 @@ void CPUMatrix<ElemType>::ElementWisePower(ElemType alpha, const CPUMatrix<ElemT
     }
     else if (alpha == 3)
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
         foreach_coord (i, j, c)
         {
             c(i, j) = a(i, j) * a(i, j) * a(i, j);
@@ -5208,7 +5876,7 @@ void CPUMatrix<ElemType>::ElementWisePower(ElemType alpha, const CPUMatrix<ElemT
     }
     else
     {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
         foreach_coord (i, j, c)
         {
             c(i, j) = pow(a(i, j), alpha);
@@ -5223,7 +5891,7 @@ bool CPUMatrix<ElemType>::AreEqual(const CPUMatrix<ElemType>& a, const CPUMatrix
         return false;
 
     bool result = true;
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         if (abs(a(i, j) - b(i, j)) > threshold)
@@ -5310,7 +5978,7 @@ bool CPUMatrix<ElemType>::HasElement(const CPUMatrix<ElemType>& mat, const ElemT
     bool bHas = false;
 
     bool isvFinite = std::isfinite(v);
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(mat.GetNumElements()))
     for (long j = 0; j < mat.GetNumElements(); j++)
     {
 #pragma omp flush(bHas)
@@ -5441,7 +6109,7 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
         ElemType* bBufPtr = b.Data();
         if (sizeof(ElemType) == sizeof(double))
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
                 c(i, 0) = (ElemType) cblas_ddot(n, reinterpret_cast<double*>(aBufPtr + i), m, reinterpret_cast<double*>(bBufPtr + i), m);
@@ -5449,7 +6117,7 @@ void CPUMatrix<ElemType>::InnerProductWithShiftNeg(const CPUMatrix<ElemType>& a,
         }
         else
         {
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
             foreach_row (i, c)
             {
 #pragma warning(suppress : 4244)
@@ -5583,7 +6251,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOfWithShift(const
 
     // long m = (long)GetNumRows(), n = (long)GetNumCols();  // a and b are of size (1,n)
     long n = (long) GetNumCols(); // a and b are of size (1,n)
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(n))
     for (long j = 0; j < n; j++)
     {
         us(0, j) = a(0, j) * b(0, (j + shift) % n);
@@ -5591,6 +6259,193 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignElementProductOfWithShift(const
     return *this;
 }
 
+// see Matrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf()
+// The norms are computed once per column, and each similarity is a single dot product.
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                 CPUMatrix<ElemType>& invNormA, CPUMatrix<ElemType>& invNormB)
+{
+    const long dim = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    const long numRows = (long) negNumber + 1;
+    const ElemType* aData = a.Data();
+    const ElemType* bData = b.Data();
+    ElemType* invNormAData = invNormA.Data();
+    ElemType* invNormBData = invNormB.Data();
+    ElemType* us = Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* aj = aData + j * dim;
+        const ElemType* bj = bData + j * dim;
+        ElemType sumA = 0, sumB = 0;
+#pragma omp simd reduction(+ : sumA, sumB)
+        for (long k = 0; k < dim; k++)
+        {
+            sumA += aj[k] * aj[k];
+            sumB += bj[k] * bj[k];
+        }
+        invNormAData[j] = 1 / max(sqrt(sumA), (ElemType) EPS_IN_INVERSE);
+        invNormBData[j] = 1 / max(sqrt(sumB), (ElemType) EPS_IN_INVERSE);
+    }
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* aj = aData + j * dim;
+        for (long i = 0; i < numRows; i++)
+        {
+            long col = (i == 0) ? j : (long) ((j + shift + i - 1) % n);
+            const ElemType* bcol = bData + col * dim;
+            ElemType dot = 0;
+#pragma omp simd reduction(+ : dot)
+            for (long k = 0; k < dim; k++)
+                dot += aj[k] * bcol[k];
+            us[i + j * numRows] = dot * invNormAData[j] * invNormBData[col];
+        }
+    }
+}
+
+// see Matrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient()
+// With c = (a_j . b_k) / (|a_j| |b_k|), dc/da_j = b_k / (|a_j| |b_k|) - c a_j / |a_j|^2, and symmetrically for b_k.
+// Each column of the gradient sums over the similarities it takes part in, so that no two threads write the same column.
+template <class ElemType>
+void CPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB,
+                                                                    const CPUMatrix<ElemType>& value, const CPUMatrix<ElemType>& valueGradient, size_t shift, CPUMatrix<ElemType>& gradient)
+{
+    const long dim = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    const long numRows = (long) value.GetNumRows();
+    // the input whose gradient is computed ('self') and the other one
+    const ElemType* self = (inputIndex == 0 ? a : b).Data();
+    const ElemType* other = (inputIndex == 0 ? b : a).Data();
+    const ElemType* invNormSelf = (inputIndex == 0 ? invNormA : invNormB).Data();
+    const ElemType* invNormOther = (inputIndex == 0 ? invNormB : invNormA).Data();
+    const ElemType* valueData = value.Data();
+    const ElemType* valueGradientData = valueGradient.Data();
+    ElemType* gradientData = gradient.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* selfj = self + j * dim;
+        ElemType* gradj = gradientData + j * dim;
+        for (long i = 0; i < numRows; i++)
+        {
+            // the column of the other input that column j is compared with in row i, and the column of the similarity
+            long rowShift = (i == 0) ? 0 : (long) ((shift + i - 1) % n);
+            long col = (inputIndex == 0) ? (j + rowShift) % n : (j + n - rowShift) % n;
+            long valueCol = (inputIndex == 0) ? j : col;
+            ElemType g = valueGradientData[i + valueCol * numRows];
+            if (g == 0)
+                continue;
+            const ElemType* othercol = other + col * dim;
+            ElemType otherCoef = g * invNormSelf[j] * invNormOther[col];
+            ElemType selfCoef = g * valueData[i + valueCol * numRows] * invNormSelf[j] * invNormSelf[j];
+#pragma omp simd
+            for (long k = 0; k < dim; k++)
+                gradj[k] += otherCoef * othercol[k] - selfCoef * selfj[k];
+        }
+    }
+}
+
+// see Matrix<ElemType>::AddKhatriRaoProductGradient()
+// Column k of the gradient, read as a [rowsA x rowsB] matrix G_k, yields aGradient_k += G_k b_k and bGradient_k += G_k^T a_k;
+// both are accumulated from the same read of each of its columns.
+template <class ElemType>
+void CPUMatrix<ElemType>::AddKhatriRaoProductGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& aGradient, CPUMatrix<ElemType>& bGradient)
+{
+    const long rowsA = (long) a.GetNumRows();
+    const long rowsB = (long) b.GetNumRows();
+    const long cols = (long) a.GetNumCols();
+    const ElemType* gradientData = gradient.Data();
+    const ElemType* aData = a.Data();
+    const ElemType* bData = b.Data();
+    ElemType* aGradientData = aGradient.Data();
+    ElemType* bGradientData = bGradient.Data();
+
+#pragma omp parallel for if (IsWorthParallelizing(gradient.GetNumElements()))
+    for (long k = 0; k < cols; k++)
+    {
+        const ElemType* ak = aData + (size_t) k * rowsA;
+        const ElemType* bk = bData + (size_t) k * rowsB;
+        ElemType* aGradk = aGradientData + (size_t) k * rowsA;
+        ElemType* bGradk = bGradientData + (size_t) k * rowsB;
+        for (long j = 0; j < rowsB; j++)
+        {
+            const ElemType* gkj = gradientData + ((size_t) k * rowsB + j) * rowsA;
+            const ElemType bkj = bk[j];
+            ElemType dot = 0;
+#pragma omp simd reduction(+ : dot)
+            for (long i = 0; i < rowsA; i++)
+            {
+                dot += gkj[i] * ak[i];
+                aGradk[i] += gkj[i] * bkj;
+            }
+            bGradk[j] += dot;
+        }
+    }
+}
+
+// see Matrix<ElemType>::AssignDiagTimesOf() and AddDiagTimesOf()
+template <class ElemType>
+void CPUMatrix<ElemType>::AssignDiagTimesOf(const CPUMatrix<ElemType>& diag, const CPUMatrix<ElemType>& a, bool accumulate)
+{
+    const long m = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    const ElemType* d = diag.Data();
+    const ElemType* aData = a.Data();
+    ElemType* us = Data();
+
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
+    for (long j = 0; j < n; j++)
+    {
+        const ElemType* aj = aData + (size_t) j * m;
+        ElemType* usj = us + (size_t) j * m;
+        if (accumulate)
+        {
+#pragma omp simd
+            for (long i = 0; i < m; i++)
+                usj[i] += d[i] * aj[i];
+        }
+        else
+        {
+#pragma omp simd
+            for (long i = 0; i < m; i++)
+                usj[i] = d[i] * aj[i];
+        }
+    }
+}
+
+// see Matrix<ElemType>::AddRowInnerProductOf()
+// Each thread owns a block of rows and sweeps all columns over it, so the sums need no reduction across threads,
+// and every row is summed in the same order regardless of the number of threads.
+template <class ElemType>
+void CPUMatrix<ElemType>::AddRowInnerProductOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b)
+{
+    const long m = (long) a.GetNumRows();
+    const long n = (long) a.GetNumCols();
+    const long blockSize = 256;
+    const ElemType* aData = a.Data();
+    const ElemType* bData = b.Data();
+    ElemType* us = Data();
+
+#pragma omp parallel for if (IsWorthParallelizing((size_t) m * n))
+    for (long i0 = 0; i0 < m; i0 += blockSize)
+    {
+        const long i1 = std::min(i0 + blockSize, m);
+        for (long j = 0; j < n; j++)
+        {
+            const ElemType* aj = aData + (size_t) j * m;
+            const ElemType* bj = bData + (size_t) j * m;
+#pragma omp simd
+            for (long i = i0; i < i1; i++)
+                us[i] += aj[i] * bj[i];
+        }
+    }
+}
+
 #pragma endregion Static BLAS Functions
 
 // 'double' version of LogAdd
@@ -5609,6 +6464,87 @@ ElemType CPUMatrix<ElemType>::LogSumOfElements() const
     return fAlpha;
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::RCRFForwardCompute(CPUMatrix<ElemType>& alpha,
+                                             const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl)
+{
+    int iNumPos = (int) pos_scores.GetNumCols();
+    int iNumLab = (int) pos_scores.GetNumRows();
+
+    alpha.RequireSize(iNumLab, iNumPos);
+
+    for (int t = 0; t < iNumPos; t++)
+    {
+#pragma omp parallel for
+        for (int k = 0; k < iNumLab; k++)
+        {
+            ElemType fTmp = (ElemType) LZERO;
+            for (int j = 0; j < iNumLab; j++)
+            {
+                ElemType fAlpha = (j == startLbl) ? (ElemType) 0.0 : (ElemType) LZERO;
+                if (t > 0)
+                    fAlpha = alpha(j, t - 1);
+                fTmp = (ElemType) LogAddD(fTmp, fAlpha + pair_scores(k, j));
+            }
+            fTmp += pos_scores(k, t); // include position dependent score
+            alpha(k, t) = fTmp;
+        }
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RCRFViterbiCompute(CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& backtrace, CPUMatrix<ElemType>& decodedPath,
+                                             const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl, const int endLbl)
+{
+    int iNumPos = (int) pos_scores.GetNumCols();
+    int iNumLab = (int) pos_scores.GetNumRows();
+
+    alpha.RequireSize(iNumLab, iNumPos);
+    backtrace.RequireSize(iNumLab, iNumPos);
+
+    for (int t = 0; t < iNumPos; t++)
+    {
+#pragma omp parallel for
+        for (int k = 0; k < iNumLab; k++)
+        {
+            ElemType fTmp = (ElemType) LZERO;
+            int iTmp = startLbl; // with the constraint that the first word is labeled as the given symbol
+            if (t > 1)
+            {
+                for (int j = 0; j < iNumLab; j++)
+                {
+                    ElemType fAlpha = alpha(j, t - 1) + pair_scores(k, j);
+                    if (fAlpha > fTmp)
+                    {
+                        fTmp = fAlpha;
+                        iTmp = j;
+                    }
+                }
+                fTmp += pos_scores(k, t); // include position dependent score
+            }
+            else if (t == 1)
+                fTmp = alpha(startLbl, 0) + pair_scores(k, startLbl) + pos_scores(k, t);
+            else
+                fTmp = (k == startLbl) ? pos_scores(k, t) : (ElemType) LZERO;
+            alpha(k, t) = fTmp;
+            backtrace(k, t) = (ElemType) iTmp;
+        }
+    }
+
+    decodedPath.RequireSize(iNumLab, iNumPos);
+    decodedPath.SetValue(0);
+
+    size_t lastLbl = endLbl;
+    decodedPath(lastLbl, iNumPos - 1) = 1;
+    for (int t = iNumPos - 1; t > 0; t--)
+    {
+        lastLbl = (size_t) backtrace(lastLbl, t);
+        decodedPath(lastLbl, t - 1) = 1;
+    }
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta,
                                               const CPUMatrix<ElemType>& lbls,
@@ -5816,7 +6752,7 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& l
     if (us.GetNumCols() != gamma.GetNumCols() || us.GetNumRows() != gamma.GetNumRows())
         LogicError("DropFrame: target matrix is not in the same size as gamm matrix.");
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(label.GetNumElements()))
     foreach_column (j, label)
     {
 
@@ -5877,6 +6813,46 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     return numThreads;
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::SetParallelGrainSize(size_t numElements)
+{
+    s_parallelGrainSize = numElements;
+}
+
+template <class ElemType>
+size_t CPUMatrix<ElemType>::GetParallelGrainSize()
+{
+    return s_parallelGrainSize;
+}
+
+template <class ElemType>
+int CPUMatrix<ElemType>::SetThreadAffinity(int firstCpu)
+{
+    int numCpus = (int) std::thread::hardware_concurrency();
+    if (firstCpu < 0 || firstCpu >= numCpus)
+        InvalidArgument("SetThreadAffinity: The first CPU must be in [0, %d), but is %d.", numCpus, firstCpu);
+
+    int numPinned = 0;
+#ifdef _OPENMP
+    // The OpenMP runtime keeps its threads across parallel regions, so pinning them once in a region of the default size sticks.
+#pragma omp parallel reduction(+ : numPinned)
+    {
+        int cpu = (firstCpu + omp_get_thread_num()) % numCpus;
+#ifdef _WIN32
+        bool pinned = (cpu < 8 * sizeof(DWORD_PTR)) && (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) != 0);
+#else
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        bool pinned = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#endif
+        if (pinned)
+            numPinned++;
+    }
+#endif
+    return numPinned;
+}
+
 // =======================================================================
 // TensorView support
 // =======================================================================
@@ -5969,15 +6945,15 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/,
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(K))
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(K))
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(K))
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
@@ -5998,15 +6974,15 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/,
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(K))
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(K))
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(K))
             for (int k = 0; k < (int) K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     }
@@ -6155,6 +7131,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 2> pointers = {a.Data(), Data()};
+    if (TensorOpWithKernels(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllUnaryOps(CaseUnaryTensorOp);
@@ -6183,6 +7161,8 @@ void CPUMatrix<ElemType>::TensorOp(ElemType beta, const CPUMatrix<ElemType>& a,
                               reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
     array<ElemType*, 3> pointers = {a.Data(), b.Data(), Data()};
+    if (TensorOpWithKernels(beta, pointers, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+        return;
     switch (op)
     {
         ForAllBinaryOps(CaseBinaryTensorOp);
@@ -93,6 +93,10 @@ public:
     CPUMatrix<ElemType> Diagonal() const;
 
     ElemType Adagrad(CPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
+    void FusedNormalGrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, bool useNAG, ElemType clipThreshold, ElemType l2RegWeight);
+    void FusedAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType clipThreshold, ElemType l2RegWeight);
+    void Adam(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType varianceMomentum, ElemType epsilon,
+              ElemType momentumCorrection, ElemType varianceCorrection, ElemType clipThreshold, ElemType l2RegWeight, bool returnStepInGradients);
     void FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
     ElemType RmsProp(CPUMatrix<ElemType>& gradients,
                      ElemType RMS_GAMMA,
@@ -150,6 +154,9 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // this = beta * this + mask .* a, where mask is 0 with probability maskRate and scaleValue otherwise, regenerated
+    // from 'seed' and each element's index plus 'firstCounter' (same mask for the same arguments, on any device)
+    void DoRandomlyMaskedCopyOf(const ElemType beta, const CPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
 
     CPUMatrix<ElemType> Transpose();
@@ -280,6 +287,9 @@ public:
 
     CPUMatrix<ElemType>& AssignNCEDerivative(const CPUMatrix<ElemType>& tmp, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t inputIndex, CPUMatrix<ElemType>& c);
 
+    void AssignGMMLogLikelihoodOf(const CPUMatrix<ElemType>& prior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& stddev, const CPUMatrix<ElemType>& feature,
+                                  CPUMatrix<ElemType>& normedDeviationVectors, CPUMatrix<ElemType>& normedDeviation, CPUMatrix<ElemType>& posterior);
+
     void VectorNormInf(CPUMatrix<ElemType>& c, const bool isColWise) const;
     CPUMatrix<ElemType>& AssignVectorNormInfOf(CPUMatrix<ElemType>& a, const bool isColWise);
 
@@ -357,6 +367,12 @@ public:
                                  const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& grad) const;
     void ConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const CPUMatrix<int>& mpRowCol, const CPUMatrix<int>& mpRowIwht,
                                    const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad) const;
+    void ConvolutionForward(const CPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const CPUMatrix<int>& mpKeyRun,
+                            const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const;
+    void ConvolutionBackwardData(const CPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const CPUMatrix<int>& mpKeyRun,
+                                 const CPUMatrix<int>& runs, CPUMatrix<ElemType>& grad) const;
+    void ConvolutionBackwardKernel(const CPUMatrix<ElemType>& in, const CompactConvolveGeometry& geometry, const CPUMatrix<int>& mpKeyRun,
+                                   const CPUMatrix<int>& runs, CPUMatrix<ElemType>& kernelGrad) const;
 
     void UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const CPUMatrix<int>& mpRowCol,
                                 const CPUMatrix<int>& mpRowRun, const CPUMatrix<int>& runs, CPUMatrix<ElemType>& output) const;
@@ -383,10 +399,23 @@ public:
 public:
     static int SetNumThreads(int numThreads); // note: this does not depend on <ElemType>, i.e. you can call it on any <ElemType>
 
+    // OpenMP loops over fewer elements than this run on the calling thread, since forking and waking up the
+    // threads costs more than the work for small matrices (e.g. at batch size 1). 0 parallelizes everything.
+    // Like SetNumThreads(), this does not depend on <ElemType>.
+    static void SetParallelGrainSize(size_t numElements);
+    static size_t GetParallelGrainSize();
+
+    // pin the OpenMP threads to consecutive logical CPUs, starting at 'firstCpu', for hosts that partition the
+    // machine between processes; returns the number of threads pinned. Threads created after this call are not pinned.
+    static int SetThreadAffinity(int firstCpu);
+
     // static BLAS functions
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c);
+    // see Matrix::BatchedMultiplyAndWeightedAdd()
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c,
+                                              size_t m, size_t n, size_t k);
     static void MultiplyAndAdd(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const bool transposeA, const CPUMatrix<ElemType>& b, const bool transposeB, CPUMatrix<ElemType>& c);
     static void Multiply(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c);
@@ -443,6 +472,15 @@ public:
     static void ConductRowElementMultiplyWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& c, const size_t shift, bool bFirstmatrixfixed);
     CPUMatrix<ElemType>& AssignElementProductOfWithShift(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const size_t shift);
 
+    void AssignCosDistanceWithNegativeSamplesOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                CPUMatrix<ElemType>& invNormA, CPUMatrix<ElemType>& invNormB);
+    static void AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, const CPUMatrix<ElemType>& invNormA, const CPUMatrix<ElemType>& invNormB,
+                                                          const CPUMatrix<ElemType>& value, const CPUMatrix<ElemType>& valueGradient, size_t shift, CPUMatrix<ElemType>& gradient);
+
+    static void AddKhatriRaoProductGradient(const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& aGradient, CPUMatrix<ElemType>& bGradient);
+    void AssignDiagTimesOf(const CPUMatrix<ElemType>& diag, const CPUMatrix<ElemType>& a, bool accumulate);
+    void AddRowInnerProductOf(const CPUMatrix<ElemType>& a, const CPUMatrix<ElemType>& b);
+
 public:
     friend File& operator>>(File& stream, CPUMatrix<ElemType>& us)
     {
@@ -456,8 +494,13 @@ public:
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (stream.IsTextBased())
+        {
+            for (size_t i = 0; i < numRows * numCols; ++i)
+                stream >> d_array[i];
+        }
+        else // in one read, the same bytes as element by element
+            stream.ReadBytes(d_array, numRows * numCols * sizeof(ElemType));
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
 
@@ -474,8 +517,13 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.Buffer()[i];
+        if (stream.IsTextBased())
+        {
+            for (size_t i = 0; i < us.GetNumElements(); ++i)
+                stream << us.Buffer()[i];
+        }
+        else // in one write, the same bytes as element by element
+            stream.WriteBytes(us.Buffer(), us.GetNumElements() * sizeof(ElemType));
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -485,6 +533,14 @@ public:
 
 public:
     // for RCRF
+    static void RCRFForwardCompute(CPUMatrix<ElemType>& alpha,
+                                   const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                   const int startLbl);
+
+    static void RCRFViterbiCompute(CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& backtrace, CPUMatrix<ElemType>& decodedPath,
+                                   const CPUMatrix<ElemType>& pos_scores, const CPUMatrix<ElemType>& pair_scores,
+                                   const int startLbl, const int endLbl);
+
     static void RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha, CPUMatrix<ElemType>& beta,
                                     const CPUMatrix<ElemType>& lbls,
                                     const CPUMatrix<ElemType>& pair_scores);
@@ -50,6 +50,12 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// see CPUMatrix::SetParallelGrainSize()
+static inline bool IsWorthParallelizing(size_t numElements)
+{
+    return numElements >= CPUMatrix<float>::GetParallelGrainSize();
+}
+
 #pragma region Helpful Enum Definitions
 
 enum class MatrixOrder
@@ -231,8 +237,9 @@ void CPUSparseMatrix<ElemType>::SetValue(const size_t row, const size_t col, con
         SetColIdx((int) c);
     }
 	// Note we don't have m_nz anymore. In order for the change from m_nz to
-    // NzCount to make sense, we need to propogate nz+1 to all col slices.
-    for (size_t max = c + 1; max < m_numCols + 1; max++)
+    // NzCount to make sense, we need to propogate nz+1 to all col slices (rows for CSR).
+    size_t numCompressed = (GetFormat() == matrixFormatSparseCSC) ? m_numCols : m_numRows;
+    for (size_t max = c + 1; max < numCompressed + 1; max++)
     {
         SecondaryIndexLocation()[max] = CPUSPARSE_INDEX_TYPE(nz + 1);
     }
@@ -569,7 +576,38 @@ void CPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     // copy ColLocation before RowLocation and NzValues. That's ugly and error prone.
     memcpy(ColLocation(), h_CSCCol, sizeof(CPUSPARSE_INDEX_TYPE)*(numCols + 1));
     memcpy(RowLocation(), h_Row, sizeof(CPUSPARSE_INDEX_TYPE)*nz);
-    memcpy(NzValues(), h_Val, sizeof(ElemType)*nz);
+    if (h_Val)
+        memcpy(NzValues(), h_Val, sizeof(ElemType)*nz);
+    else // all values are 1
+        std::fill(NzValues(), NzValues() + nz, (ElemType) 1);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+    if (numBlocks > numCols)
+        InvalidArgument("SetMatrixFromSBCFormat: More blocks (%d) than columns (%d).", (int) numBlocks, (int) numCols);
+
+    SetFormat(matrixFormatSparseBlockCol);
+    RequireSizeAndAllocate(numRows, numCols, numBlocks * numRows, true, false);
+    SetBlockSize(numBlocks);
+    SetBlockIdShift(0);
+    memcpy(GetBlockIds(), blockIds, sizeof(size_t) * numBlocks);
+    memcpy(Data(), val, sizeof(ElemType) * numBlocks * numRows);
+}
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("GetMatrixFromSBCFormat: The matrix is not in sparse block-column format.");
+
+    blockIds.resize(GetBlockSize());
+    for (size_t j = 0; j < GetBlockSize(); j++)
+        blockIds[j] = GetBlockIds()[j] - GetBlockIdShift();
+    val.assign(Buffer(), Buffer() + GetBlockSize() * GetNumRows());
 }
 
 template <class ElemType>
@@ -727,8 +765,33 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+// c = beta * c, of size m x n, in preparation of adding a product to it
+template <class ElemType>
+static void ScaleForWeightedAdd(ElemType beta, CPUMatrix<ElemType>& c, size_t m, size_t n)
+{
+    if (beta == 0)
+        c.RequireSize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    if (beta == 0)
+    {
+        memset(c.Data(), 0, sizeof(ElemType) * c.GetNumElements());
+    }
+    else if (beta != 1)
+    {
+#pragma omp parallel for if (IsWorthParallelizing(c.GetNumElements()))
+        foreach_coord (i, j, c)
+        {
+            c(i, j) = beta * c(i, j);
+        }
+    }
+}
+
 // c = alpha*op(lhs) * op(rhs) + beta*c
 // dense x sparse = dense
+// The threads work on disjoint parts of c: on its columns where each column of rhs contributes to one column of c,
+// otherwise on ranges of its rows. The innermost loops run over contiguous memory where possible, for vectorization.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
@@ -748,105 +811,168 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
         InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
     }
 
-    if (beta == 0)
-        c.RequireSize(m, n);
-    else
-        c.VerifySize(m, n); // Can't resize if beta != 0
-
-
-    if (beta == 0)
-    {
-        memset(c.Data(), 0, sizeof(ElemType) * c.GetNumElements());
-    }
-    else if (beta != 1)
-    {
-#pragma omp parallel for
-        foreach_coord (i, j, c)
-        {
-            c(i, j) = beta * c(i, j);
-        }
-    }
+    ScaleForWeightedAdd(beta, c, m, n);
 
     // TODO: Implement CSR as a transposition of b, like we do for GPU.
     if (rhs.GetFormat() != matrixFormatSparseCSC)
         NOT_IMPLEMENTED;
 
     // Do the actual multiplication.
-    ElemType* valueBuffer = rhs.Buffer() + *rhs.SecondaryIndexLocation(); // Points to the value buffer of the current  view (i.e. buffer containing indices of non-zero elements)
-    int* rowIndexBuffer   = rhs.MajorIndexLocation();                     // Points to the index buffer of the current view. (i.e. buffer containing indices of non-zero elements)
-    int iNonzero          = 0;                                            // Number of nonzero elements handled so far for curent slice view.
-    int numPreviosNonzero = rhs.SecondaryIndexLocation()[0];              // Total number of nonzero values handled in previous slices.
-    if (!transposeA && !transposeB)
+    const ElemType* valueBuffer = rhs.Buffer() + *rhs.SecondaryIndexLocation(); // Points to the value buffer of the current  view (i.e. buffer containing indices of non-zero elements)
+    const int* rowIndexBuffer   = rhs.MajorIndexLocation();                     // Points to the index buffer of the current view. (i.e. buffer containing indices of non-zero elements)
+    const int* colStart         = rhs.SecondaryIndexLocation();
+    const int numPreviosNonzero = colStart[0];                                  // Total number of nonzero values handled in previous slices.
+    const long numColsB         = (long) rhs.GetNumCols();
+    const size_t lhsRows        = lhs.GetNumRows();
+    const ElemType* lhsData     = lhs.Data();
+    ElemType* cData             = c.Data();
+    const bool parallelize      = IsWorthParallelizing((size_t) (colStart[numColsB] - numPreviosNonzero) * m);
+    const long numRowRanges     = parallelize ? omp_get_max_threads() : 1; // for the cases that split the rows of c
+
+    if (!transposeA && !transposeB) // c(:, colB) += alpha * lhs(:, rowB) * val
     {
-        for (size_t colB = 0; colB < rhs.GetNumCols(); colB++)
+#pragma omp parallel for if (parallelize)
+        for (long colB = 0; colB < numColsB; colB++)
         {
-            size_t end = rhs.SecondaryIndexLocation()[colB + 1] - numPreviosNonzero;
-            for (; iNonzero < end; iNonzero++)
+            ElemType* cCol = cData + colB * m;
+            for (int iNonzero = colStart[colB] - numPreviosNonzero; iNonzero < colStart[colB + 1] - numPreviosNonzero; iNonzero++)
             {
-                size_t rowB = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType val = valueBuffer[iNonzero];
-
-                for (size_t rowA = 0; rowA < lhs.GetNumRows(); rowA++)
-                {
-                    c(rowA, colB) += alpha * lhs(rowA, rowB) * val;
-                }
+                const ElemType* lhsCol = lhsData + rowIndexBuffer[iNonzero] * lhsRows;
+                ElemType scaledVal = alpha * valueBuffer[iNonzero];
+                for (int rowA = 0; rowA < m; rowA++)
+                    cCol[rowA] += lhsCol[rowA] * scaledVal;
             }
         }
     }
-    else if (!transposeA && transposeB)
+    else if (!transposeA && transposeB) // c(:, rowB) += alpha * lhs(:, colB) * val
     {
-        for (size_t colB = 0; colB < rhs.GetNumCols(); colB++)
+#pragma omp parallel for if (parallelize)
+        for (long rowRange = 0; rowRange < numRowRanges; rowRange++)
         {
-            size_t end = rhs.SecondaryIndexLocation()[colB + 1] - numPreviosNonzero;
-            for (; iNonzero < end; iNonzero++)
+            int rowBegin = (int) (m * rowRange / numRowRanges);
+            int rowEnd = (int) (m * (rowRange + 1) / numRowRanges);
+            for (long colB = 0; colB < numColsB; colB++)
             {
-                size_t rowB = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType val = valueBuffer[iNonzero];
-
-                for (size_t rowA = 0; rowA < lhs.GetNumRows(); rowA++)
+                const ElemType* lhsCol = lhsData + colB * lhsRows;
+                for (int iNonzero = colStart[colB] - numPreviosNonzero; iNonzero < colStart[colB + 1] - numPreviosNonzero; iNonzero++)
                 {
-                    c(rowA, rowB) += alpha * lhs(rowA, colB) * val;
+                    ElemType* cCol = cData + rowIndexBuffer[iNonzero] * (size_t) m;
+                    ElemType scaledVal = alpha * valueBuffer[iNonzero];
+                    for (int rowA = rowBegin; rowA < rowEnd; rowA++)
+                        cCol[rowA] += lhsCol[rowA] * scaledVal;
                 }
             }
         }
     }
     // the transposeA case is copy-paste from above with rows/cols of lhs swapped
-    else if (transposeA && !transposeB)
+    else if (transposeA && !transposeB) // c(:, colB) += alpha * lhs(rowB, :) * val
     {
-        for (size_t colB = 0; colB < rhs.GetNumCols(); colB++)
+#pragma omp parallel for if (parallelize)
+        for (long colB = 0; colB < numColsB; colB++)
         {
-            size_t end = rhs.SecondaryIndexLocation()[colB + 1] - numPreviosNonzero;
-            for (; iNonzero < end; iNonzero++)
+            ElemType* cCol = cData + colB * m;
+            for (int iNonzero = colStart[colB] - numPreviosNonzero; iNonzero < colStart[colB + 1] - numPreviosNonzero; iNonzero++)
             {
-                size_t rowB = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType val = valueBuffer[iNonzero];
-
-                for (size_t colA = 0; colA < lhs.GetNumCols(); colA++)
-                {
-                    c(colA, colB) += alpha * lhs(rowB, colA) * val;
-                }
+                const ElemType* lhsRow = lhsData + rowIndexBuffer[iNonzero];
+                ElemType scaledVal = alpha * valueBuffer[iNonzero];
+                for (int colA = 0; colA < m; colA++)
+                    cCol[colA] += lhsRow[colA * lhsRows] * scaledVal;
             }
         }
     }
-    else if (transposeA && transposeB)
+    else if (transposeA && transposeB) // c(:, rowB) += alpha * lhs(colB, :) * val
     {
-        for (size_t colB = 0; colB < rhs.GetNumCols(); colB++)
+#pragma omp parallel for if (parallelize)
+        for (long rowRange = 0; rowRange < numRowRanges; rowRange++)
         {
-            size_t end = rhs.SecondaryIndexLocation()[colB + 1] - numPreviosNonzero;
-            for (; iNonzero < end; iNonzero++)
+            int rowBegin = (int) (m * rowRange / numRowRanges);
+            int rowEnd = (int) (m * (rowRange + 1) / numRowRanges);
+            for (long colB = 0; colB < numColsB; colB++)
             {
-                size_t rowB = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType val = valueBuffer[iNonzero];
-
-                for (size_t colA = 0; colA < lhs.GetNumCols(); colA++)
+                const ElemType* lhsRow = lhsData + colB;
+                for (int iNonzero = colStart[colB] - numPreviosNonzero; iNonzero < colStart[colB + 1] - numPreviosNonzero; iNonzero++)
                 {
-                    c(colA, rowB) += alpha * lhs(colB, colA) * val;
+                    ElemType* cCol = cData + rowIndexBuffer[iNonzero] * (size_t) m;
+                    ElemType scaledVal = alpha * valueBuffer[iNonzero];
+                    for (int colA = rowBegin; colA < rowEnd; colA++)
+                        cCol[colA] += lhsRow[colA * lhsRows] * scaledVal;
                 }
             }
         }
     }
 }
 
+// c = alpha*op(lhs) * op(rhs) + beta*c
+// sparse x dense = dense
+// A CSR matrix is the CSC matrix of its transpose. Either way, each column of c is computed by one thread, by
+//  - scattering: adding to the rows of c given by the nonzeros' row (CSC) or column (CSR) indices, or
+//  - gathering: summing the products of the nonzeros of a column (CSC) or row (CSR) with the matching elements of rhs.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
+
+    int m = transposeA ? (int) lhs.GetNumCols() : (int) lhs.GetNumRows();
+    int k = transposeA ? (int) lhs.GetNumRows() : (int) lhs.GetNumCols();
+    int l = transposeB ? (int) rhs.GetNumCols() : (int) rhs.GetNumRows();
+    int n = transposeB ? (int) rhs.GetNumRows() : (int) rhs.GetNumCols();
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
+    assert(k == l);
+    if (k != l)
+    {
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+    }
+
+    if (lhs.GetFormat() != matrixFormatSparseCSC && lhs.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
+
+    ScaleForWeightedAdd(beta, c, m, n);
+
+    const bool isCSC = lhs.GetFormat() == matrixFormatSparseCSC;
+    const bool gather = isCSC == transposeA;
+    const ElemType* valueBuffer = lhs.Data();
+    const int* majorIndex       = lhs.MajorIndexLocation();
+    const int* compressedIndex  = lhs.SecondaryIndexLocation();
+    const int numPreviosNonzero = compressedIndex[0];
+    const int numCompressed     = (int) (isCSC ? lhs.GetNumCols() : lhs.GetNumRows());
+    const size_t rhsRows        = rhs.GetNumRows();
+    const ElemType* rhsData     = rhs.Data();
+    ElemType* cData             = c.Data();
+    // rhs(r, j) of op(rhs)
+    const size_t rhsRowStride   = transposeB ? rhsRows : 1;
+    const size_t rhsColStride   = transposeB ? 1 : rhsRows;
+
+#pragma omp parallel for if (IsWorthParallelizing((size_t) (compressedIndex[numCompressed] - numPreviosNonzero) * n))
+    for (long j = 0; j < (long) n; j++)
+    {
+        ElemType* cCol = cData + j * (size_t) m;
+        const ElemType* rhsCol = rhsData + j * rhsColStride;
+        for (int compressed = 0; compressed < numCompressed; compressed++)
+        {
+            int begin = compressedIndex[compressed] - numPreviosNonzero;
+            int end = compressedIndex[compressed + 1] - numPreviosNonzero;
+            if (gather)
+            {
+                ElemType sum = 0;
+                for (int p = begin; p < end; p++)
+                    sum += valueBuffer[p] * rhsCol[majorIndex[p] * rhsRowStride];
+                cCol[compressed] += alpha * sum;
+            }
+            else
+            {
+                ElemType scaledRhs = alpha * rhsCol[compressed * rhsRowStride];
+                if (scaledRhs == 0)
+                    continue;
+                for (int p = begin; p < end; p++)
+                    cCol[majorIndex[p]] += valueBuffer[p] * scaledRhs;
+            }
+        }
+    }
+}
+
 // dense x sparse = sparse
 // c = alpha * op(lhs) * op(rhs)
 template <class ElemType>
@@ -888,48 +1014,53 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         c.SetFormat(matrixFormatSparseBlockCol);
         c.RequireSizeAndAllocate(m, n, m * min(n, rhs.NzCount()), true, false);
 
+        // first pass: assign the blocks, one per word that occurs
+        const ElemType* valueBuffer = rhs.Data();
+        const CPUSPARSE_INDEX_TYPE* rowIndexBuffer = rhs.MajorIndexLocation();
+        const CPUSPARSE_INDEX_TYPE* colStart = rhs.SecondaryIndexLocation();
+        const size_t numPreviosNonzero = colStart[0];
+        const size_t nz = colStart[rhs.GetNumCols()] - numPreviosNonzero;
         map<size_t, size_t> w2Id;
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        { // j ranges over batches
-            size_t start = rhs.SecondaryIndexLocation()[j];
-            size_t end = rhs.SecondaryIndexLocation()[j + 1];
-
-            for (size_t p = start; p < end; p++)
+        vector<size_t> blockOfNonzero(nz);
+        for (size_t p = 0; p < nz; p++)
+        {
+            size_t i = rowIndexBuffer[p]; // i ranges over words
+            auto iter = w2Id.find(i);
+            if (iter == w2Id.end())
             {
-                size_t i = rhs.MajorIndexLocation()[p]; // i ranges over words
-                ElemType val = rhs.Buffer()[p];  // 1 for(i, j)
-
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
-                {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
-                    c.GetBlockIds()[c.GetBlockSize()] = i;
-                    c.SetBlockSize(c.GetBlockSize() + 1);
-                }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.Buffer()[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.Buffer()[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
+                iter = w2Id.insert(make_pair(i, w2Id.size())).first;
+                c.GetBlockIds()[c.GetBlockSize()] = i;
+                c.SetBlockSize(c.GetBlockSize() + 1);
             }
+            blockOfNonzero[p] = iter->second;
         }
         if (c.GetBlockSize() * m > c.GetSizeAllocated())
         {
             LogicError("Sparse matrix is unexpectedly out of range.");
         }
+
+        // second pass: accumulate; the threads split the hidden dimension, which keeps the blocks they write disjoint
+        ElemType* blockBuffer = c.Buffer();
+        memset(blockBuffer, 0, sizeof(ElemType) * c.GetBlockSize() * m);
+        const bool parallelize = IsWorthParallelizing(nz * m);
+        const long numRowRanges = parallelize ? omp_get_max_threads() : 1;
+#pragma omp parallel for if (parallelize)
+        for (long rowRange = 0; rowRange < numRowRanges; rowRange++)
+        {
+            size_t hBegin = m * rowRange / numRowRanges;
+            size_t hEnd = m * (rowRange + 1) / numRowRanges;
+            for (size_t j = 0; j < rhs.GetNumCols(); j++)
+            { // j ranges over batches
+                const ElemType* lhsCol = lhs.Data() + j * lhs.GetNumRows();
+                for (size_t p = colStart[j] - numPreviosNonzero; p < colStart[j + 1] - numPreviosNonzero; p++)
+                {
+                    ElemType scaledVal = alpha * valueBuffer[p]; // 1 for(i, j)
+                    ElemType* block = blockBuffer + blockOfNonzero[p] * m;
+                    for (size_t h = hBegin; h < hEnd; h++) // h range over hidden layer
+                        block[h] += lhsCol[h] * scaledVal;
+                }
+            }
+        }
     }
     else if (transposeA && !transposeB)
     {
@@ -957,8 +1088,10 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
 
     if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC || lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSR)
     {
-        size_t col_num = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? lhs.GetNumCols() : lhs.GetNumRows();
-        for (size_t j = 0; j < col_num; j++)
+        // each j is a different column (CSC) or row (CSR) of rhs
+        long col_num = (long) ((lhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC) ? lhs.GetNumCols() : lhs.GetNumRows());
+#pragma omp parallel for if (IsWorthParallelizing(lhs.SecondaryIndexLocation()[col_num] - lhs.SecondaryIndexLocation()[0]))
+        for (long j = 0; j < col_num; j++)
         {
             size_t start = lhs.SecondaryIndexLocation()[j];
             size_t end = lhs.SecondaryIndexLocation()[j + 1];
@@ -974,10 +1107,13 @@ void CPUSparseMatrix<ElemType>::ScaleAndAdd(const ElemType alpha, const CPUSpars
     }
     else if (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol || lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < lhs.GetBlockSize(); j++)
+        // the blocks are different columns (block-col) or rows (block-row) of rhs
+        long numBlocks = (long) lhs.GetBlockSize();
+        size_t len = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
+#pragma omp parallel for if (IsWorthParallelizing(numBlocks * len))
+        for (long j = 0; j < numBlocks; j++)
         {
             size_t i = lhs.GetBlockIds()[j] - lhs.GetBlockIdShift();
-            size_t len = (lhs.GetFormat() == MatrixFormat::matrixFormatSparseBlockCol) ? lhs.GetNumRows() : lhs.GetNumCols();
             size_t start = j * len;
             for (size_t p = start; p < start + len; p++)
             {
@@ -1006,7 +1142,7 @@ template <class ElemType>
 
     bool result = true;
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(a.GetNumElements()))
     foreach_coord (i, j, a)
     {
         if (abs(a(i, j) - b(i, j)) > threshold)
@@ -1123,6 +1259,57 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// Same as CPUMatrix::FSAdagrad(), but only for the columns present in this sparse block-column gradient.
+// The state of the other columns is not decayed, i.e. it is updated lazily, whenever a column is touched.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+    assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
+
+    size_t n = GetNumElements();
+    long numRows = (long) GetNumRows();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+#pragma omp parallel for if (IsWorthParallelizing(GetBlockSize() * GetNumRows()))
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t col = GetBlockIds()[j] - GetBlockIdShift();
+        const ElemType* grad = Buffer() + j * numRows;
+        for (long r = 0; r < numRows; r++)
+        {
+            size_t i = col * numRows + r;
+            ElemType g = grad[r];
+            ElemType adaSqr = adaWeight * smoothAda[i] + (1.0f - adaWeight) * g * g;
+            smoothAda[i] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType w = adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[i] + (1.0f - momentum) * g;
+                smoothMom[i] = g;
+            }
+
+            val[i] -= g * learnRatePerSample;
+        }
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -1132,7 +1319,7 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const E
     long m = (long) this->NzCount();
     ElemType* nzValues = NzValues();
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4) // four-way unrolling
     {
         if (nzValues[i] > threshold)
@@ -1166,7 +1353,7 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateBottom(cons
     long m = (long) this->NzCount();
     ElemType* nzValues = NzValues();
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4) // four-way unrolling
     {
         if (nzValues[i] < threshold)
@@ -1203,7 +1390,7 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncate(const Elem
     long m = (long) this->NzCount();
     ElemType* nzValues = NzValues();
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4) // four-way unrolling
     {
         if (nzValues[i] > locThresholdPos)
@@ -1247,7 +1434,7 @@ CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceSoftThreshold(const
     long m = (long) this->NzCount();
     ElemType* nzValues = NzValues();
 
-#pragma omp parallel for
+#pragma omp parallel for if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4) // four-way unrolling
     {
         if (nzValues[i] > threshold)
@@ -1303,7 +1490,7 @@ ElemType CPUSparseMatrix<ElemType>::FrobeniusNorm() const
     const ElemType* nzValues = NzValues();
 
 //four-way unrolling
-#pragma omp parallel for reduction(+ : v)
+#pragma omp parallel for reduction(+ : v) if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4)
     {
         v += nzValues[i] * nzValues[i] + nzValues[i + 1] * nzValues[i + 1] + nzValues[i + 2] * nzValues[i + 2] + nzValues[i + 3] * nzValues[i + 3];
@@ -1348,7 +1535,7 @@ ElemType CPUSparseMatrix<ElemType>::SumOfElements() const
     const ElemType* nzValues = NzValues();
 
 //four-way unrolling
-#pragma omp parallel for reduction(+ : sum)
+#pragma omp parallel for reduction(+ : sum) if (IsWorthParallelizing(m))
     for (long i = 0; i < (m & ~3); i += 4)
     {
         sum += nzValues[i] + nzValues[i + 1] + nzValues[i + 2] + nzValues[i + 3];
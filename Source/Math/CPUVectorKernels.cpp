@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.cpp -- runtime selection of the AVX2/AVX-512 versions of the hot CPUMatrix loops
+//
+
+#include "stdafx.h"
+#include "CPUVectorKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+// MSVC allows AVX intrinsics in any function. gcc needs the target option for the functions that use them;
+// it declares all intrinsics regardless of the command-line options from gcc 4.9 on.
+#if defined(_MSC_VER)
+#define CNTK_AVX2_KERNELS
+#elif defined(__GNUC__) && !defined(__clang__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define CNTK_AVX2_KERNELS
+#if __GNUC__ >= 5 // __builtin_cpu_supports("avx512f")
+#define CNTK_AVX512_KERNELS
+#endif
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool CPUSupports(CPUFeature feature)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    if (feature == CPUFeature::SSE41)
+        return (info[2] & (1 << 19)) != 0;
+    // AVX2 and AVX-512 require the OS to save the YMM (XCR0 bits 1 and 2) and ZMM (bits 5 to 7) registers
+    if ((info[2] & (1 << 27)) == 0) // OSXSAVE
+        return false;
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (feature == CPUFeature::AVX2)
+        return ((xcr0 & 0x06) == 0x06) && (info[1] & (1 << 5)) != 0;
+    return ((xcr0 & 0xe6) == 0xe6) && (info[1] & (1 << 16)) != 0;
+#else
+    switch (feature)
+    {
+    case CPUFeature::SSE41:
+        return __builtin_cpu_supports("sse4.1") != 0;
+    case CPUFeature::AVX2:
+        return __builtin_cpu_supports("avx2") != 0;
+    default:
+#ifdef CNTK_AVX512_KERNELS
+        return __builtin_cpu_supports("avx512f") != 0;
+#else
+        return false;
+#endif
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------
+// generic kernels, one element at a time (the compiler may still use SSE)
+// -----------------------------------------------------------------------
+
+namespace GenericKernels {
+
+struct Traits
+{
+    typedef float V;
+    static const size_t width = 1;
+    static const CPUKernelLevel level = CPUKernelLevel::Generic;
+    static const char* const name;
+
+    static V Load(const float* p) { return *p; }
+    static void Store(float* p, V v) { *p = v; }
+    static V Set1(float x) { return x; }
+    static V Zero() { return 0; }
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V Mul(V a, V b) { return a * b; }
+    static V Div(V a, V b) { return a / b; }
+    static V Max(V a, V b) { return a > b ? a : b; }
+    static V Min(V a, V b) { return a < b ? a : b; }
+    static V IfPositive(V b, V a) { return b > 0 ? a : 0; }
+    static V IfLess(V a, V b, V x, V y) { return a < b ? x : y; }
+    static V IfLessEqual(V a, V b, V x, V y) { return a <= b ? x : y; }
+    static V Truncate(V x) { return truncf(x); }
+    static void OrShiftedInt(unsigned int* p, V q, int shift) { *p |= ((unsigned int) (int) q) << shift; }
+    static V LoadBits(const unsigned int* p, int shift, unsigned int mask) { return (float) ((*p >> shift) & mask); }
+    static float ReduceAdd(V v) { return v; }
+    static float ReduceMax(V v) { return v; }
+    static float ReduceMin(V v) { return v; }
+    static V Exp(V x) { return expf(x); }
+    static float ScalarExp(float x) { return expf(x); }
+    static void Finish() { }
+};
+const char* const Traits::name = "generic";
+
+#include "CPUVectorKernelsImpl.h"
+}
+
+#ifdef CNTK_AVX2_KERNELS
+
+// Single-precision exp() after Cephes expf (relative error about 2e-7): exp(x) = 2^n * exp(r) with n = round(x / ln 2),
+// |r| <= ln(2) / 2, and a polynomial for exp(r). The clamping keeps 2^n a normal number; below and above the range
+// of float, the result is set to 0 and infinity. Values between 127 ln(2) and ln(FLT_MAX) saturate at 2^127.
+static const float c_expLowerBound = -87.3365448f;  // ln(FLT_MIN)
+static const float c_expClampHigh = 88.0296919f;    // 127 ln(2)
+static const float c_expUpperBound = 88.7228391f;   // ln(FLT_MAX)
+static const float c_log2e = 1.44269504088896341f;
+static const float c_ln2Hi = 0.693359375f;          // ln(2) in two parts, for an exact n * ln(2)
+static const float c_ln2Lo = -2.12194440e-4f;
+static const float c_expPolynomial[] = { 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f };
+
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace AVX2Kernels {
+
+struct Traits
+{
+    typedef __m256 V;
+    static const size_t width = 8;
+    static const CPUKernelLevel level = CPUKernelLevel::AVX2;
+    static const char* const name;
+
+    static V Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V Set1(float x) { return _mm256_set1_ps(x); }
+    static V Zero() { return _mm256_setzero_ps(); }
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V Max(V a, V b) { return _mm256_max_ps(a, b); } // b if either is NaN
+    static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V IfPositive(V b, V a) { return _mm256_and_ps(_mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_GT_OQ), a); }
+    static V IfLess(V a, V b, V x, V y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+    static V IfLessEqual(V a, V b, V x, V y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+    static V Truncate(V x) { return _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+    // the bit fields of the quantized values: *p |= int(q) << shift, and float((*p >> shift) & mask), for 'width' words
+    static void OrShiftedInt(unsigned int* p, V q, int shift)
+    {
+        __m256i bits = _mm256_sll_epi32(_mm256_cvttps_epi32(q), _mm_cvtsi32_si128(shift));
+        _mm256_storeu_si256((__m256i*) p, _mm256_or_si256(_mm256_loadu_si256((const __m256i*) p), bits));
+    }
+    static V LoadBits(const unsigned int* p, int shift, unsigned int mask)
+    {
+        __m256i bits = _mm256_srl_epi32(_mm256_loadu_si256((const __m256i*) p), _mm_cvtsi32_si128(shift));
+        return _mm256_cvtepi32_ps(_mm256_and_si256(bits, _mm256_set1_epi32((int) mask)));
+    }
+
+    static float ReduceAdd(V v)
+    {
+        __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+        x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+        return _mm_cvtss_f32(x);
+    }
+    static float ReduceMax(V v)
+    {
+        __m128 x = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        x = _mm_max_ps(x, _mm_movehl_ps(x, x));
+        x = _mm_max_ss(x, _mm_shuffle_ps(x, x, 1));
+        return _mm_cvtss_f32(x);
+    }
+    static float ReduceMin(V v)
+    {
+        __m128 x = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        x = _mm_min_ps(x, _mm_movehl_ps(x, x));
+        x = _mm_min_ss(x, _mm_shuffle_ps(x, x, 1));
+        return _mm_cvtss_f32(x);
+    }
+
+    static V Exp(V x)
+    {
+        // NaN is passed through: max/min return their second operand if either is NaN
+        V r = _mm256_min_ps(_mm256_set1_ps(c_expClampHigh), _mm256_max_ps(_mm256_set1_ps(c_expLowerBound), x));
+        V n = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(r, _mm256_set1_ps(c_log2e)), _mm256_set1_ps(0.5f)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(c_ln2Hi)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(c_ln2Lo)));
+        V p = _mm256_set1_ps(c_expPolynomial[0]);
+        for (size_t i = 1; i < _countof(c_expPolynomial); i++)
+            p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(c_expPolynomial[i]));
+        p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p, _mm256_mul_ps(r, r)), r), _mm256_set1_ps(1.0f));
+        __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+        V y = _mm256_mul_ps(p, _mm256_castsi256_ps(pow2n));
+        y = _mm256_andnot_ps(_mm256_cmp_ps(x, _mm256_set1_ps(c_expLowerBound), _CMP_LT_OQ), y);
+        return _mm256_blendv_ps(y, _mm256_set1_ps(std::numeric_limits<float>::infinity()), _mm256_cmp_ps(x, _mm256_set1_ps(c_expUpperBound), _CMP_GT_OQ));
+    }
+    static float ScalarExp(float x) { return expf(x); }
+
+    // avoid the penalty of SSE code after AVX code with dirty upper halves
+    static void Finish() { _mm256_zeroupper(); }
+};
+const char* const Traits::name = "AVX2";
+
+#include "CPUVectorKernelsImpl.h"
+}
+
+#ifdef CNTK_AVX512_KERNELS
+#pragma GCC target("avx512f")
+
+namespace AVX512Kernels {
+
+struct Traits
+{
+    typedef __m512 V;
+    static const size_t width = 16;
+    static const CPUKernelLevel level = CPUKernelLevel::AVX512;
+    static const char* const name;
+
+    static V Load(const float* p) { return _mm512_loadu_ps(p); }
+    static void Store(float* p, V v) { _mm512_storeu_ps(p, v); }
+    static V Set1(float x) { return _mm512_set1_ps(x); }
+    static V Zero() { return _mm512_setzero_ps(); }
+    static V Add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V Div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V Max(V a, V b) { return _mm512_max_ps(a, b); } // b if either is NaN
+    static V Min(V a, V b) { return _mm512_min_ps(a, b); }
+    static V IfPositive(V b, V a) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(b, _mm512_setzero_ps(), _CMP_GT_OQ), a); }
+    static V IfLess(V a, V b, V x, V y) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), y, x); }
+    static V IfLessEqual(V a, V b, V x, V y) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_LE_OQ), y, x); }
+    static V Truncate(V x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+
+    static void OrShiftedInt(unsigned int* p, V q, int shift)
+    {
+        __m512i bits = _mm512_sll_epi32(_mm512_cvttps_epi32(q), _mm_cvtsi32_si128(shift));
+        _mm512_storeu_si512(p, _mm512_or_si512(_mm512_loadu_si512(p), bits));
+    }
+    static V LoadBits(const unsigned int* p, int shift, unsigned int mask)
+    {
+        __m512i bits = _mm512_srl_epi32(_mm512_loadu_si512(p), _mm_cvtsi32_si128(shift));
+        return _mm512_cvtepi32_ps(_mm512_and_si512(bits, _mm512_set1_epi32((int) mask)));
+    }
+
+    static __m256 HighHalf(V v) { return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)); }
+    static float ReduceAdd(V v) { return AVX2Kernels::Traits::ReduceAdd(_mm256_add_ps(_mm512_castps512_ps256(v), HighHalf(v))); }
+    static float ReduceMax(V v) { return AVX2Kernels::Traits::ReduceMax(_mm256_max_ps(_mm512_castps512_ps256(v), HighHalf(v))); }
+    static float ReduceMin(V v) { return AVX2Kernels::Traits::ReduceMin(_mm256_min_ps(_mm512_castps512_ps256(v), HighHalf(v))); }
+
+    // same as AVX2Kernels::Traits::Exp()
+    static V Exp(V x)
+    {
+        V r = _mm512_min_ps(_mm512_set1_ps(c_expClampHigh), _mm512_max_ps(_mm512_set1_ps(c_expLowerBound), x));
+        V n = _mm512_roundscale_ps(_mm512_add_ps(_mm512_mul_ps(r, _mm512_set1_ps(c_log2e)), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF);
+        r = _mm512_sub_ps(r, _mm512_mul_ps(n, _mm512_set1_ps(c_ln2Hi)));
+        r = _mm512_sub_ps(r, _mm512_mul_ps(n, _mm512_set1_ps(c_ln2Lo)));
+        V p = _mm512_set1_ps(c_expPolynomial[0]);
+        for (size_t i = 1; i < _countof(c_expPolynomial); i++)
+            p = _mm512_add_ps(_mm512_mul_ps(p, r), _mm512_set1_ps(c_expPolynomial[i]));
+        p = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(p, _mm512_mul_ps(r, r)), r), _mm512_set1_ps(1.0f));
+        __m512i pow2n = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvttps_epi32(n), _mm512_set1_epi32(127)), 23);
+        V y = _mm512_mul_ps(p, _mm512_castsi512_ps(pow2n));
+        y = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_set1_ps(c_expLowerBound), _CMP_LT_OQ), y, _mm512_setzero_ps());
+        return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_set1_ps(c_expUpperBound), _CMP_GT_OQ), y, _mm512_set1_ps(std::numeric_limits<float>::infinity()));
+    }
+    static float ScalarExp(float x) { return expf(x); }
+
+    static void Finish() { _mm256_zeroupper(); }
+};
+const char* const Traits::name = "AVX-512";
+
+#include "CPUVectorKernelsImpl.h"
+}
+
+#endif // CNTK_AVX512_KERNELS
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
+
+#endif // CNTK_AVX2_KERNELS
+
+// -----------------------------------------------------------------------
+// selection
+// -----------------------------------------------------------------------
+
+CPUVectorKernels::ElementwiseFunction CPUVectorKernels::GetElementwise(ElementWiseOperator op) const
+{
+    switch (op)
+    {
+    case ElementWiseOperator::opCopy:                return copy;
+    case ElementWiseOperator::opLinearRectifier:     return linearRectifier;
+    case ElementWiseOperator::opExp:                 return exp;
+    case ElementWiseOperator::opSigmoid:             return sigmoid;
+    case ElementWiseOperator::opSum:                 return elementwiseSum;
+    case ElementWiseOperator::opDifference:          return difference;
+    case ElementWiseOperator::opElementwiseProduct:  return elementwiseProduct;
+    case ElementWiseOperator::opElementwiseProductWithSigmoidDerivativeFromOutput:          return elementwiseProductWithSigmoidDerivativeFromOutput;
+    case ElementWiseOperator::opElementwiseProductWithTanhDerivativeFromOutput:             return elementwiseProductWithTanhDerivativeFromOutput;
+    case ElementWiseOperator::opElementwiseProductWithLinearRectifierDerivativeFromOutput:  return elementwiseProductWithLinearRectifierDerivativeFromOutput;
+    default:                                         return nullptr;
+    }
+}
+
+/*static*/ const CPUVectorKernels* CPUVectorKernels::Get(CPUKernelLevel level)
+{
+    switch (level)
+    {
+    case CPUKernelLevel::Generic:
+        return &GenericKernels::s_kernels;
+#ifdef CNTK_AVX2_KERNELS
+    case CPUKernelLevel::AVX2:
+        return CPUSupports(CPUFeature::AVX2) ? &AVX2Kernels::s_kernels : nullptr;
+#endif
+#ifdef CNTK_AVX512_KERNELS
+    case CPUKernelLevel::AVX512:
+        return CPUSupports(CPUFeature::AVX512F) ? &AVX512Kernels::s_kernels : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+static const CPUVectorKernels* SelectKernels()
+{
+    const CPUKernelLevel levels[] = { CPUKernelLevel::AVX512, CPUKernelLevel::AVX2 };
+    for (auto level : levels)
+    {
+        const CPUVectorKernels* kernels = CPUVectorKernels::Get(level);
+        if (kernels)
+            return kernels;
+    }
+    return &GenericKernels::s_kernels;
+}
+
+/*static*/ const CPUVectorKernels& CPUVectorKernels::Get()
+{
+    // a race on first use is harmless here, all threads select the same table
+    static const CPUVectorKernels* kernels = SelectKernels();
+    return *kernels;
+}
+
+}}}
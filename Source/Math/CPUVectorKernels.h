@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernels.h -- hot float loops of CPUMatrix, compiled for several instruction sets and selected at runtime
+//
+// The build targets SSE4.1, so that one binary runs everywhere. The kernels here are additionally compiled for
+// AVX2 and (with gcc) AVX-512, and CPUVectorKernels::Get() returns the table for the best set this CPU supports.
+
+#pragma once
+
+#include "CommonMatrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class CPUFeature
+{
+    SSE41,
+    AVX2,
+    AVX512F
+};
+
+// whether both the CPU and the OS (for the register state) support the feature
+MATH_API bool CPUSupports(CPUFeature feature);
+
+enum class CPUKernelLevel
+{
+    Generic,
+    AVX2,
+    AVX512
+};
+
+// the quantization of one column by ColumnQuantizer<float>, see ValueQuantizer
+struct CPUQuantizationParameters
+{
+    size_t numBits;  // 1, 2, 4, 8 or 16
+    float lower;     // values <= lower quantize to 0 (numBits > 1)
+    float upper;     // values >= upper quantize to 2^numBits - 1 (numBits > 1)
+    float qfactor;   // (value - lower) * qfactor, truncated, is the quantized value (numBits > 1)
+    float ufactor;   // (quantized value + 0.5) * ufactor + lower is the unquantized value
+    float threshold; // values >= threshold quantize to 1 (numBits == 1)
+};
+
+struct MATH_API CPUVectorKernels
+{
+    // c = beta * c + alpha * op(a, b) over n contiguous elements; c is not read if beta == 0, and unary ops ignore b
+    typedef void (*ElementwiseFunction)(float beta, const float* a, const float* b, float alpha, float* c, size_t n);
+
+    CPUKernelLevel level;
+    const char* name;
+
+    float (*vectorSum)(const float* x, size_t n);
+    float (*vectorMax)(const float* x, size_t n); // n > 0
+    float (*vectorMin)(const float* x, size_t n); // n > 0
+    float (*sumOfExp)(const float* x, float shift, size_t n); // sum_i exp(x[i] - shift)
+    void (*addScalar)(const float* x, float s, float* y, size_t n); // y = x + s, may be in place
+
+    // gradient quantization, on the sums of a gradient column and its residual
+    float (*sumOfSums)(const float* a, const float* b, size_t n);                                  // sum_i (a[i] + b[i])
+    float (*sumOfSquaredDeviations)(const float* a, const float* b, float mean, size_t n);         // sum_i (a[i] + b[i] - mean)^2
+    void (*levelSums)(const float* a, const float* b, float threshold, size_t n, float* sumBelow, float* sumAbove, size_t* numBelow); // split at threshold, below = '<'
+    // quantizes a[i] + inResidual[i] into the QWords of a column in the interleaved layout of ColumnQuantizer, and stores
+    // the quantization error in outResidual, which may be inResidual; n is the number of rows
+    void (*quantizeColumn)(const float* a, const float* inResidual, float* outResidual, size_t n, const CPUQuantizationParameters& params, unsigned int* qwords);
+    void (*unquantizeColumn)(const unsigned int* qwords, size_t n, const CPUQuantizationParameters& params, bool add, float* out); // out = or += unquantized
+
+    ElementwiseFunction copy;
+    ElementwiseFunction linearRectifier;
+    ElementwiseFunction exp;
+    ElementwiseFunction sigmoid;
+    ElementwiseFunction elementwiseSum;
+    ElementwiseFunction difference;
+    ElementwiseFunction elementwiseProduct;
+    ElementwiseFunction elementwiseProductWithSigmoidDerivativeFromOutput;
+    ElementwiseFunction elementwiseProductWithTanhDerivativeFromOutput;
+    ElementwiseFunction elementwiseProductWithLinearRectifierDerivativeFromOutput;
+
+    // the elementwise kernel for a TensorOp, or nullptr if the op has none
+    ElementwiseFunction GetElementwise(ElementWiseOperator op) const;
+
+    // the kernels for the best instruction set of this CPU, selected on first use
+    static const CPUVectorKernels& Get();
+
+    // the kernels for a specific instruction set, or nullptr if the CPU or the build does not support it (for testing)
+    static const CPUVectorKernels* Get(CPUKernelLevel level);
+};
+
+}}}
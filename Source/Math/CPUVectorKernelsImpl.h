@@ -0,0 +1,334 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUVectorKernelsImpl.h -- the kernels of CPUVectorKernels, written against a 'Traits' vector type
+//
+// This file is included by CPUVectorKernels.cpp once per instruction set, inside a namespace that defines
+// 'Traits' and within the target options for that instruction set, so it deliberately has no include guard.
+// The main loops process Traits::width elements at a time; the tails use the scalar ops.
+
+typedef Traits::V V;
+
+// ops for Elementwise(); Scalar() must compute the same as Vector() for one element
+struct CopyOp
+{
+    static V Vector(V a, V) { return a; }
+    static float Scalar(float a, float) { return a; }
+};
+struct LinearRectifierOp
+{
+    // max(a, 0) yields 0 for NaN, like 'a > 0 ? a : 0'
+    static V Vector(V a, V) { return Traits::Max(a, Traits::Zero()); }
+    static float Scalar(float a, float) { return a > 0 ? a : 0; }
+};
+struct ExpOp
+{
+    static V Vector(V a, V) { return Traits::Exp(a); }
+    static float Scalar(float a, float) { return Traits::ScalarExp(a); }
+};
+struct SigmoidOp
+{
+    // exp(-a) overflows to infinity for very negative a, which yields the correct limit 0
+    static V Vector(V a, V) { return Traits::Div(Traits::Set1(1), Traits::Add(Traits::Set1(1), Traits::Exp(Traits::Sub(Traits::Zero(), a)))); }
+    static float Scalar(float a, float) { return 1 / (1 + Traits::ScalarExp(-a)); }
+};
+struct SumOp
+{
+    static V Vector(V a, V b) { return Traits::Add(a, b); }
+    static float Scalar(float a, float b) { return a + b; }
+};
+struct DifferenceOp
+{
+    static V Vector(V a, V b) { return Traits::Sub(a, b); }
+    static float Scalar(float a, float b) { return a - b; }
+};
+struct ElementwiseProductOp
+{
+    static V Vector(V a, V b) { return Traits::Mul(a, b); }
+    static float Scalar(float a, float b) { return a * b; }
+};
+// the gradients of the LSTM nonlinearities, with b = the output of the nonlinearity
+struct ElementwiseProductWithSigmoidDerivativeFromOutputOp
+{
+    static V Vector(V a, V b) { return Traits::Mul(a, Traits::Mul(b, Traits::Sub(Traits::Set1(1), b))); }
+    static float Scalar(float a, float b) { return a * (b * (1 - b)); }
+};
+struct ElementwiseProductWithTanhDerivativeFromOutputOp
+{
+    static V Vector(V a, V b) { return Traits::Mul(a, Traits::Sub(Traits::Set1(1), Traits::Mul(b, b))); }
+    static float Scalar(float a, float b) { return a * (1 - b * b); }
+};
+struct ElementwiseProductWithLinearRectifierDerivativeFromOutputOp
+{
+    static V Vector(V a, V b) { return Traits::IfPositive(b, a); }
+    static float Scalar(float a, float b) { return b > 0 ? a : 0; }
+};
+
+template <class Op>
+static void Elementwise(float beta, const float* a, const float* b, float alpha, float* c, size_t n)
+{
+    if (!b) // unary op
+        b = a;
+    const V valpha = Traits::Set1(alpha);
+    size_t i = 0;
+    if (beta == 0)
+    {
+        for (; i + Traits::width <= n; i += Traits::width)
+            Traits::Store(c + i, Traits::Mul(valpha, Op::Vector(Traits::Load(a + i), Traits::Load(b + i))));
+        for (; i < n; i++)
+            c[i] = alpha * Op::Scalar(a[i], b[i]);
+    }
+    else
+    {
+        const V vbeta = Traits::Set1(beta);
+        for (; i + Traits::width <= n; i += Traits::width)
+            Traits::Store(c + i, Traits::Add(Traits::Mul(valpha, Op::Vector(Traits::Load(a + i), Traits::Load(b + i))), Traits::Mul(vbeta, Traits::Load(c + i))));
+        for (; i < n; i++)
+            c[i] = alpha * Op::Scalar(a[i], b[i]) + beta * c[i];
+    }
+    Traits::Finish();
+}
+
+static float VectorSum(const float* x, size_t n)
+{
+    // two accumulators to hide the latency of the additions
+    V acc0 = Traits::Zero();
+    V acc1 = Traits::Zero();
+    size_t i = 0;
+    for (; i + 2 * Traits::width <= n; i += 2 * Traits::width)
+    {
+        acc0 = Traits::Add(acc0, Traits::Load(x + i));
+        acc1 = Traits::Add(acc1, Traits::Load(x + i + Traits::width));
+    }
+    float sum = Traits::ReduceAdd(Traits::Add(acc0, acc1));
+    for (; i < n; i++)
+        sum += x[i];
+    Traits::Finish();
+    return sum;
+}
+
+static float VectorMax(const float* x, size_t n)
+{
+    float maxV = x[0];
+    size_t i = 0;
+    if (n >= Traits::width)
+    {
+        V acc = Traits::Load(x);
+        for (i = Traits::width; i + Traits::width <= n; i += Traits::width)
+            acc = Traits::Max(acc, Traits::Load(x + i));
+        maxV = Traits::ReduceMax(acc);
+    }
+    for (; i < n; i++)
+        maxV = std::max(maxV, x[i]);
+    Traits::Finish();
+    return maxV;
+}
+
+static float VectorMin(const float* x, size_t n)
+{
+    float minV = x[0];
+    size_t i = 0;
+    if (n >= Traits::width)
+    {
+        V acc = Traits::Load(x);
+        for (i = Traits::width; i + Traits::width <= n; i += Traits::width)
+            acc = Traits::Min(acc, Traits::Load(x + i));
+        minV = Traits::ReduceMin(acc);
+    }
+    for (; i < n; i++)
+        minV = std::min(minV, x[i]);
+    Traits::Finish();
+    return minV;
+}
+
+static float SumOfExp(const float* x, float shift, size_t n)
+{
+    const V vshift = Traits::Set1(shift);
+    V acc = Traits::Zero();
+    size_t i = 0;
+    for (; i + Traits::width <= n; i += Traits::width)
+        acc = Traits::Add(acc, Traits::Exp(Traits::Sub(Traits::Load(x + i), vshift)));
+    float sum = Traits::ReduceAdd(acc);
+    for (; i < n; i++)
+        sum += Traits::ScalarExp(x[i] - shift);
+    Traits::Finish();
+    return sum;
+}
+
+static void AddScalar(const float* x, float s, float* y, size_t n)
+{
+    const V vs = Traits::Set1(s);
+    size_t i = 0;
+    for (; i + Traits::width <= n; i += Traits::width)
+        Traits::Store(y + i, Traits::Add(Traits::Load(x + i), vs));
+    for (; i < n; i++)
+        y[i] = x[i] + s;
+    Traits::Finish();
+}
+
+// -----------------------------------------------------------------------
+// gradient quantization (ColumnQuantizer<float>)
+// -----------------------------------------------------------------------
+
+static float SumOfSums(const float* a, const float* b, size_t n)
+{
+    V acc = Traits::Zero();
+    size_t i = 0;
+    for (; i + Traits::width <= n; i += Traits::width)
+        acc = Traits::Add(acc, Traits::Add(Traits::Load(a + i), Traits::Load(b + i)));
+    float sum = Traits::ReduceAdd(acc);
+    for (; i < n; i++)
+        sum += a[i] + b[i];
+    Traits::Finish();
+    return sum;
+}
+
+static float SumOfSquaredDeviations(const float* a, const float* b, float mean, size_t n)
+{
+    const V vmean = Traits::Set1(mean);
+    V acc = Traits::Zero();
+    size_t i = 0;
+    for (; i + Traits::width <= n; i += Traits::width)
+    {
+        V d = Traits::Sub(Traits::Add(Traits::Load(a + i), Traits::Load(b + i)), vmean);
+        acc = Traits::Add(acc, Traits::Mul(d, d));
+    }
+    float sum = Traits::ReduceAdd(acc);
+    for (; i < n; i++)
+        sum += (a[i] + b[i] - mean) * (a[i] + b[i] - mean);
+    Traits::Finish();
+    return sum;
+}
+
+static void LevelSums(const float* a, const float* b, float threshold, size_t n, float* sumBelow, float* sumAbove, size_t* numBelow)
+{
+    // NaN counts as above, like 'val < mean' in ColumnQuantizer; the counts are exact up to 2^24 per lane
+    const V vthreshold = Traits::Set1(threshold);
+    const V vzero = Traits::Zero();
+    const V vone = Traits::Set1(1);
+    V accBelow = vzero, accAbove = vzero, accCount = vzero;
+    size_t i = 0;
+    for (; i + Traits::width <= n; i += Traits::width)
+    {
+        V u = Traits::Add(Traits::Load(a + i), Traits::Load(b + i));
+        accBelow = Traits::Add(accBelow, Traits::IfLess(u, vthreshold, u, vzero));
+        accAbove = Traits::Add(accAbove, Traits::IfLess(u, vthreshold, vzero, u));
+        accCount = Traits::Add(accCount, Traits::IfLess(u, vthreshold, vone, vzero));
+    }
+    *sumBelow = Traits::ReduceAdd(accBelow);
+    *sumAbove = Traits::ReduceAdd(accAbove);
+    *numBelow = (size_t) Traits::ReduceAdd(accCount);
+    for (; i < n; i++)
+    {
+        float u = a[i] + b[i];
+        if (u < threshold)
+        {
+            *sumBelow += u;
+            (*numBelow)++;
+        }
+        else
+            *sumAbove += u;
+    }
+    Traits::Finish();
+}
+
+// ValueQuantizer<float>::Quantize() of one value, as a float
+static float QuantizeValue(float u, const CPUQuantizationParameters& params)
+{
+    if (params.numBits == 1)
+        return u >= params.threshold ? 1.0f : 0.0f;
+    if (u <= params.lower)
+        return 0;
+    if (u >= params.upper)
+        return (float) ((1u << params.numBits) - 1);
+    return truncf((u - params.lower) * params.qfactor);
+}
+
+// Row i of the column goes to bit field i / numQWords of QWord i % numQWords. Each band of numQWords consecutive rows
+// thus fills the same bit field of consecutive QWords, which the main loops process 'width' at a time.
+static void QuantizeColumn(const float* a, const float* inResidual, float* outResidual, size_t n, const CPUQuantizationParameters& params, unsigned int* qwords)
+{
+    const size_t numQWords = (n + (32 / params.numBits) - 1) / (32 / params.numBits);
+    memset(qwords, 0, numQWords * sizeof(*qwords));
+
+    const V vlower = Traits::Set1(params.lower);
+    const V vupper = Traits::Set1(params.upper);
+    const V vqfactor = Traits::Set1(params.qfactor);
+    const V vufactor = Traits::Set1(params.ufactor);
+    const V vthreshold = Traits::Set1(params.threshold);
+    const V vmax = Traits::Set1((float) ((1u << params.numBits) - 1));
+    const V vhalf = Traits::Set1(0.5f);
+    const V vone = Traits::Set1(1);
+    const V vzero = Traits::Zero();
+    for (size_t rowBegin = 0, band = 0; rowBegin < n; rowBegin += numQWords, band++)
+    {
+        const size_t bandSize = std::min(numQWords, n - rowBegin);
+        const int shift = (int) (band * params.numBits);
+        const float* ab = a + rowBegin;
+        const float* rb = inResidual + rowBegin;
+        float* ob = outResidual + rowBegin;
+        size_t q = 0;
+        for (; q + Traits::width <= bandSize; q += Traits::width)
+        {
+            V u = Traits::Add(Traits::Load(ab + q), Traits::Load(rb + q));
+            V qv;
+            if (params.numBits == 1)
+                qv = Traits::IfLessEqual(vthreshold, u, vone, vzero);
+            else // the same order of tests as QuantizeValue(), for an empty range
+            {
+                qv = Traits::Truncate(Traits::Mul(Traits::Sub(u, vlower), vqfactor));
+                qv = Traits::IfLessEqual(vupper, u, vmax, qv);
+                qv = Traits::IfLessEqual(u, vlower, vzero, qv);
+            }
+            Traits::OrShiftedInt(qwords + q, qv, shift);
+            Traits::Store(ob + q, Traits::Sub(u, Traits::Add(Traits::Mul(Traits::Add(qv, vhalf), vufactor), vlower)));
+        }
+        for (; q < bandSize; q++)
+        {
+            float u = ab[q] + rb[q];
+            float qv = QuantizeValue(u, params);
+            qwords[q] |= ((unsigned int) (int) qv) << shift;
+            ob[q] = u - (((qv + 0.5f) * params.ufactor) + params.lower);
+        }
+    }
+    Traits::Finish();
+}
+
+static void UnquantizeColumn(const unsigned int* qwords, size_t n, const CPUQuantizationParameters& params, bool add, float* out)
+{
+    const size_t numQWords = (n + (32 / params.numBits) - 1) / (32 / params.numBits);
+    const unsigned int mask = (1u << params.numBits) - 1;
+    const V vlower = Traits::Set1(params.lower);
+    const V vufactor = Traits::Set1(params.ufactor);
+    const V vhalf = Traits::Set1(0.5f);
+    for (size_t rowBegin = 0, band = 0; rowBegin < n; rowBegin += numQWords, band++)
+    {
+        const size_t bandSize = std::min(numQWords, n - rowBegin);
+        const int shift = (int) (band * params.numBits);
+        float* ob = out + rowBegin;
+        size_t q = 0;
+        for (; q + Traits::width <= bandSize; q += Traits::width)
+        {
+            V val = Traits::Add(Traits::Mul(Traits::Add(Traits::LoadBits(qwords + q, shift, mask), vhalf), vufactor), vlower);
+            Traits::Store(ob + q, add ? Traits::Add(val, Traits::Load(ob + q)) : val);
+        }
+        for (; q < bandSize; q++)
+        {
+            float val = ((((qwords[q] >> shift) & mask) + 0.5f) * params.ufactor) + params.lower;
+            ob[q] = add ? val + ob[q] : val;
+        }
+    }
+    Traits::Finish();
+}
+
+static const CPUVectorKernels s_kernels =
+{
+    Traits::level, Traits::name,
+    &VectorSum, &VectorMax, &VectorMin, &SumOfExp, &AddScalar,
+    &SumOfSums, &SumOfSquaredDeviations, &LevelSums, &QuantizeColumn, &UnquantizeColumn,
+    &Elementwise<CopyOp>, &Elementwise<LinearRectifierOp>, &Elementwise<ExpOp>, &Elementwise<SigmoidOp>,
+    &Elementwise<SumOp>, &Elementwise<DifferenceOp>, &Elementwise<ElementwiseProductOp>,
+    &Elementwise<ElementwiseProductWithSigmoidDerivativeFromOutputOp>, &Elementwise<ElementwiseProductWithTanhDerivativeFromOutputOp>,
+    &Elementwise<ElementwiseProductWithLinearRectifierDerivativeFromOutputOp>
+};
@@ -3,6 +3,15 @@
 #include "BestGpu.h" // for CPUONLY
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
+#ifdef __unix__
+#include <nvml.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+#endif
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -15,6 +24,118 @@ inline static void CheckCudaReturnCode(cudaError_t rc, const char* msg)
         RuntimeError("%s: %s (cuda error %d)", msg, cudaGetErrorString(rc), (int)rc);
 }
 
+static bool s_numaLocal = false;
+
+#ifdef __unix__
+// Memory placed on the NUMA node of a device: the pages are mapped, first touched by a thread bound to the CPUs local
+// to the device (the kernel places a page on the node of the CPU that touches it first), then pinned for the GPU.
+class NumaLocalHostMemory
+{
+public:
+    // returns nullptr if the CPUs of the device are unknown, the caller falls back to cudaHostAlloc()
+    static void* Malloc(size_t size, int deviceId)
+    {
+        cpu_set_t deviceCpus;
+        if (size == 0 || !GetDeviceCpus(deviceId, deviceCpus))
+            return nullptr;
+
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+
+        cpu_set_t threadCpus;
+        pthread_getaffinity_np(pthread_self(), sizeof(threadCpus), &threadCpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(deviceCpus), &deviceCpus);
+        size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < size; offset += pageSize)
+            ((volatile char*) p)[offset] = 0;
+        pthread_setaffinity_np(pthread_self(), sizeof(threadCpus), &threadCpus);
+
+        if (cudaHostRegister(p, size, cudaHostRegisterDefault) != cudaSuccess)
+        {
+            cudaGetLastError(); // clear the error, the caller falls back
+            munmap(p, size);
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_sizes[p] = size;
+        return p;
+    }
+
+    // returns false if the memory was not allocated here
+    static bool Free(void* p)
+    {
+        size_t size;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            auto iter = s_sizes.find(p);
+            if (iter == s_sizes.end())
+                return false;
+            size = iter->second;
+            s_sizes.erase(iter);
+        }
+        CheckCudaReturnCode(cudaHostUnregister(p), "Free in CUDAPageLockedMemAllocator failed");
+        munmap(p, size);
+        return true;
+    }
+
+private:
+    // the CPUs local to the device according to NVML, queried once per device
+    static bool GetDeviceCpus(int deviceId, cpu_set_t& cpus)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto iter = s_deviceCpus.find(deviceId);
+        if (iter == s_deviceCpus.end())
+        {
+            std::pair<bool, cpu_set_t> deviceCpus;
+            deviceCpus.first = QueryDeviceCpus(deviceId, deviceCpus.second);
+            iter = s_deviceCpus.insert(std::make_pair(deviceId, deviceCpus)).first;
+        }
+        cpus = iter->second.second;
+        return iter->second.first;
+    }
+
+    static bool QueryDeviceCpus(int deviceId, cpu_set_t& cpus)
+    {
+        char busId[32];
+        if (cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess || nvmlInit() != NVML_SUCCESS)
+            return false;
+
+        const size_t bits = sizeof(unsigned long) * 8;
+        unsigned long cpuSet[CPU_SETSIZE / (sizeof(unsigned long) * 8)] = {0};
+        nvmlDevice_t device;
+        bool found = nvmlDeviceGetHandleByPciBusId(busId, &device) == NVML_SUCCESS &&
+                     nvmlDeviceGetCpuAffinity(device, (unsigned int) (CPU_SETSIZE / bits), cpuSet) == NVML_SUCCESS;
+        nvmlShutdown();
+
+        CPU_ZERO(&cpus);
+        for (size_t cpu = 0; found && cpu < CPU_SETSIZE; cpu++)
+        {
+            if ((cpuSet[cpu / bits] >> (cpu % bits)) & 1)
+                CPU_SET(cpu, &cpus);
+        }
+        if (found && CPU_COUNT(&cpus) == 0)
+            found = false;
+        fprintf(stderr, "CUDAPageLockedMemAllocator: %s\n", found ? "pinned memory is placed on the NUMA node of the GPU" : "the CPUs local to the GPU are unknown, pinned memory is placed by the driver");
+        return found;
+    }
+
+    static std::mutex s_mutex;
+    static std::map<void*, size_t> s_sizes;
+    static std::map<int, std::pair<bool, cpu_set_t>> s_deviceCpus;
+};
+
+std::mutex NumaLocalHostMemory::s_mutex;
+std::map<void*, size_t> NumaLocalHostMemory::s_sizes;
+std::map<int, std::pair<bool, cpu_set_t>> NumaLocalHostMemory::s_deviceCpus;
+#endif
+
+void CUDAPageLockedMemAllocator::SetNumaLocal(bool numaLocal)
+{
+    s_numaLocal = numaLocal;
+}
+
 CUDAPageLockedMemAllocator::CUDAPageLockedMemAllocator(int deviceID)
     : m_deviceID(deviceID)
 {
@@ -25,6 +146,15 @@ void* CUDAPageLockedMemAllocator::Malloc(size_t size, int deviceId)
     void* p = nullptr;
     CheckCudaReturnCode(cudaSetDevice(deviceId), "Cannot set cuda device");
 
+#ifdef __unix__
+    if (s_numaLocal)
+    {
+        p = NumaLocalHostMemory::Malloc(size, deviceId);
+        if (p)
+            return p;
+    }
+#endif
+
     // Note: I ask for cudaHostAllocDefault but cudaHostGetFlags() shows that it is allocated as 'cudaHostAllocMapped'
     CheckCudaReturnCode(cudaHostAlloc(&p, size, cudaHostAllocDefault), "Malloc in CUDAPageLockedMemAllocator failed");
     return p;
@@ -33,6 +163,10 @@ void* CUDAPageLockedMemAllocator::Malloc(size_t size, int deviceId)
 void CUDAPageLockedMemAllocator::Free(void* p, int deviceId)
 {
     CheckCudaReturnCode(cudaSetDevice(deviceId), "Cannot set cuda device");
+#ifdef __unix__
+    if (NumaLocalHostMemory::Free(p))
+        return;
+#endif
     CheckCudaReturnCode(cudaFreeHost(p), "Free in CUDAPageLockedMemAllocator failed");
 }
 
@@ -78,5 +212,9 @@ void CUDAPageLockedMemAllocator::Free(void*)
 void CUDAPageLockedMemAllocator::Free(void*, int)
 {
 }
+
+void CUDAPageLockedMemAllocator::SetNumaLocal(bool)
+{
+}
 #endif
 } } }
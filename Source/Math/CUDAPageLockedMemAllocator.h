@@ -25,6 +25,11 @@ public:
     static void* Malloc(size_t size, int deviceId);
     static void Free(void* p, int deviceId);
 
+    // With numaLocal, the memory is placed on the NUMA node of the CPUs local to the device, so that host-to-device
+    // copies do not cross the inter-socket link (Linux only, elsewhere cudaHostAlloc() places it). Process-wide,
+    // set once at device selection before any allocation.
+    static void SetNumaLocal(bool numaLocal);
+
 private:
     int m_deviceID;
 };
@@ -279,50 +279,12 @@ public:
             allReduceUint(num0);
             allReduceUint(num1);
 
-            ElemType radius;
-            ElemType newmean;
-            if (!ZeroThresholdFor1Bit)
-            {
-                // we minimize the error jointly across positive and negative numbers to make things
-                // symmetrical around the mean (which may be non-zero) tying the two sides
-                ElemType devacc0 = (num0 * mean) - meanacc0;
-                ElemType devacc1 = meanacc1 - (num1 * mean);
-
-                // both deviations tied, to ensure consistent mean
-                ElemType dev = (devacc0 + devacc1) / rows;
-                radius = 2.0f * dev;
-                newmean = mean;
-            }
-            else
-            {
-                // we keep two separate reconstruction values to allow for asymmetries--but we
-                // instead hard-code that the threshold is 0
-
-                // happens for all-zero columns which do exist (mean0 is 0 in that case)
-                if (num0 == 0)
-                    num0 = 1;
-                if (num1 == 0)
-                    num1 = 1;
-                ElemType mean0 = meanacc0 / num0;
-                ElemType mean1 = meanacc1 / num1;
-
-                // approximate by using their average as the threshold between 0 and 1
-                // with these values, bits (0,1) which mean values (0.5,1.5) will reconstruct to mean0/1
-                newmean = 0.5f * (mean0 + mean1);
-                radius = 2.0f * (mean1 - newmean);
-            }
-
             if (subset == 0)
-            {
-                lower = newmean - radius;
-                upper = newmean + radius;
-            }
+                RangeFromLevelSums<ZeroThresholdFor1Bit>(mean, meanacc0, meanacc1, num0, num1, rows, lower, upper);
         }
         else
         {
-            ElemType stddevs = 5.0f;
             // >1 bit:
-            // We linearly quantize between 'stddevs' standard deviations.
             ElemType varacc = 0.0f;
             // (subset: compute subset sum)
             for (size_t i = subset; i < rows; i += subsets)
@@ -333,14 +295,62 @@ public:
             }
             // multi-subset (CUDA): reduce to one thread
             allReduceElem(varacc);
-            ElemType stddev = sqrt(varacc / rows);
             if (subset == 0)
-            {
-                // stddevs = how many stddevs from the mean until outside of quantization range
-                lower = mean - (stddevs * stddev);
-                upper = mean + (stddevs * stddev);
-            }
+                RangeFromVariance(mean, varacc, rows, lower, upper);
+        }
+    }
+
+    // the quantization range of a 1-bit column, from the sums and counts of the values below and above 'mean'
+    // (also used by the vectorized CPU quantization, which computes the sums differently)
+    template <bool ZeroThresholdFor1Bit>
+    static cudasharedcode void RangeFromLevelSums(ElemType mean, ElemType meanacc0, ElemType meanacc1, unsigned int num0, unsigned int num1, size_t rows, ElemType& lower, ElemType& upper)
+    {
+        ElemType radius;
+        ElemType newmean;
+        if (!ZeroThresholdFor1Bit)
+        {
+            // we minimize the error jointly across positive and negative numbers to make things
+            // symmetrical around the mean (which may be non-zero) tying the two sides
+            ElemType devacc0 = (num0 * mean) - meanacc0;
+            ElemType devacc1 = meanacc1 - (num1 * mean);
+
+            // both deviations tied, to ensure consistent mean
+            ElemType dev = (devacc0 + devacc1) / rows;
+            radius = 2.0f * dev;
+            newmean = mean;
         }
+        else
+        {
+            // we keep two separate reconstruction values to allow for asymmetries--but we
+            // instead hard-code that the threshold is 0
+
+            // happens for all-zero columns which do exist (mean0 is 0 in that case)
+            if (num0 == 0)
+                num0 = 1;
+            if (num1 == 0)
+                num1 = 1;
+            ElemType mean0 = meanacc0 / num0;
+            ElemType mean1 = meanacc1 / num1;
+
+            // approximate by using their average as the threshold between 0 and 1
+            // with these values, bits (0,1) which mean values (0.5,1.5) will reconstruct to mean0/1
+            newmean = 0.5f * (mean0 + mean1);
+            radius = 2.0f * (mean1 - newmean);
+        }
+
+        lower = newmean - radius;
+        upper = newmean + radius;
+    }
+
+    // the quantization range of a column of more than 1 bit, from the sum of the squared deviations from 'mean'
+    static cudasharedcode void RangeFromVariance(ElemType mean, ElemType varacc, size_t rows, ElemType& lower, ElemType& upper)
+    {
+        // We linearly quantize between 'stddevs' standard deviations.
+        ElemType stddevs = 5.0f;
+        ElemType stddev = sqrt(varacc / rows);
+        // stddevs = how many stddevs from the mean until outside of quantization range
+        lower = mean - (stddevs * stddev);
+        upper = mean + (stddevs * stddev);
     }
 
 private:
@@ -40,15 +40,56 @@ typedef unsigned char byte;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// -----------------------------------------------------------------------
+// GPUMemoryAllocatorKind -- which strategy TracingGPUMemoryAllocator uses to obtain device memory.
+//  - Direct:  every Allocate()/Free() goes straight to cudaMalloc()/cudaFree().
+//  - Caching: freed buffers are kept in per-device, per-stream free lists bucketed by size class
+//             and handed out again to later requests of a compatible size, so that resizes of
+//             minibatch-shaped matrices do not hit the driver (which serializes the device).
+// -----------------------------------------------------------------------
+
+enum class GPUMemoryAllocatorKind
+{
+    Direct,
+    Caching
+};
+
+// statistics of the caching allocator for one device
+struct GPUMemoryAllocatorStatistics
+{
+    size_t bytesInUse = 0;          // bytes currently handed out to callers (rounded to size class)
+    size_t bytesReserved = 0;       // bytes currently obtained from cudaMalloc() (in use + cached)
+    size_t peakBytesInUse = 0;      // high-water mark of bytesInUse
+    size_t peakBytesReserved = 0;   // high-water mark of bytesReserved
+    size_t numAllocations = 0;      // number of Allocate() calls
+    size_t numCacheHits = 0;        // ...of which were served from a free list
+    size_t numDeviceAllocations = 0; // number of cudaMalloc() calls
+    size_t numDeviceFrees = 0;      // number of cudaFree() calls (cache flushes)
+};
+
 class MATH_API TracingGPUMemoryAllocator
 {
 private:
     static int m_traceLevel;
+    static GPUMemoryAllocatorKind m_allocatorKind;
 
 public:
     static void SetTraceLevel(int traceLevel);
     static bool IsTraceEnabled();
 
+    // select the allocation strategy; must be called before the first GPU allocation
+    static void SetAllocatorKind(GPUMemoryAllocatorKind kind);
+    static GPUMemoryAllocatorKind GetAllocatorKind();
+    static bool IsCachingEnabled() { return GetAllocatorKind() == GPUMemoryAllocatorKind::Caching; }
+
+    // caching allocator only: return all currently unused cached buffers of a device to the driver
+    static void ReleaseCachedMemory(int deviceId);
+    // caching allocator only: statistics and a human-readable summary on stderr
+    static GPUMemoryAllocatorStatistics GetStatistics(int deviceId);
+    static void PrintStatistics(int deviceId);
+    // caching allocator only: restart the high-water marks from the current usage, e.g. to measure the peak of one step
+    static void ResetPeakStatistics(int deviceId);
+
     template <typename AllocatedElemType>
     static AllocatedElemType* Allocate(int deviceId, size_t numRows, size_t numCols);
 
@@ -62,6 +103,10 @@ private:
     template <typename AllocatedElemType>
     static AllocatedElemType* AllocateNoTrace(int deviceId, size_t numElements);
 
+    // raw memory interface; routes through the cache if enabled
+    static void* AllocateBytes(int deviceId, size_t numBytes);
+    static void FreeBytes(int deviceId, void* bufferPtr, bool ignoreCUDARetCode);
+
     static std::pair<size_t, size_t> GetFreeAndTotalMemoryInMBs(int deviceId);
 };
 
@@ -90,6 +135,8 @@ enum ElementWiseOperator
     opElementwiseProductWithCosDerivative, opElementwiseProductWithSinDerivative,
     opElementwiseProductWithAbsDerivative, opElementwiseProductWithSqrtDerivative,
     opElementwiseProductWithReciprocalDerivative, opSqrOfDifference,
+    // binary ops that fuse a sum with the nonlinearity applied to it, see ComputationNetwork::FuseElementwiseNodes()
+    opSigmoidOfSum, opTanhOfSum, opLinearRectifierOfSum,
     // binary ops for indexing
     // opIndex,
     // ternary
@@ -152,6 +199,9 @@ enum ElementWiseOperator
     Macro(ElementwiseProductWithReciprocalDerivative);                \
     Macro(ElementwiseProductWithSqrtDerivative);                      \
     Macro(SqrOfDifference);                                           \
+    Macro(SigmoidOfSum);                                              \
+    Macro(TanhOfSum);                                                 \
+    Macro(LinearRectifierOfSum);                                      \
     //Macro(Index);
 
 #define ForAllTernaryOps(Macro)                         \
@@ -206,6 +256,9 @@ enum MatrixFlags
 // BaseMatrixStorage -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
 
+template <class ElemType>
+class MATH_API BaseMatrix;
+
 template <class ElemType>
 class BaseMatrixStorage : public enable_shared_from_this<BaseMatrixStorage<ElemType>>
 {
@@ -217,11 +270,13 @@ private:
 public:
 
     BaseMatrixStorage() 
+        : m_writeCount(0)
     {
         ZeroInit(matrixFormatDense, CPUDEVICE);
     }
 
     BaseMatrixStorage(MatrixFormat format, DEVICEID_TYPE computeDevice)
+        : m_writeCount(0)
     {
         ZeroInit(format, computeDevice);
     }
@@ -233,8 +288,22 @@ public:
         m_numCols = 0;
     }
 
+    // a copy of (a view of) the content in another format, kept for reuse until the next write, see GetStorageWriteCount()
+    // Used by GPUSparseMatrix::GetConvertedSparseFormat().
+    struct ConvertedCopy
+    {
+        size_t writeCount = 0;
+        size_t sliceViewOffset = 0;
+        size_t numRows = 0;
+        size_t numCols = 0;
+        MatrixFormat format = matrixFormatDense;
+        shared_ptr<BaseMatrix<ElemType>> matrix; // (its buffer is reused by the next conversion)
+    };
+
     void ReleaseMemory()
     {
+        m_convertedCopy.matrix.reset();
+
         if (!m_externalBuffer)
         {
             if (m_computeDevice < 0)
@@ -396,6 +465,12 @@ protected:
     size_t* m_blockIds;    // block ids
     size_t m_blockIdShift; // used to get efficient slice, actual col = blockIds[j] - m_blockIdShift
 
+    // **************************
+    // caches of derived representations (e.g. GPUSparseMatrix::GetConvertedSparseFormat())
+    // **************************
+
+    size_t m_writeCount; // number of announced writes and resizes; never reset, not even by ZeroInit()
+    ConvertedCopy m_convertedCopy;
 };
 
 // -----------------------------------------------------------------------
@@ -422,6 +497,7 @@ public:
             LogicError("%s: Cannot resize the matrix because it is a view.", function);
         else if (m_sob->HasExternalBuffer())
             LogicError("%s: Cannot resize the matrix because it is externally owned.", function);
+        m_sob->m_writeCount++;
     }
 
     // same as VerifyResizable() except for the error message. Could be folded into one.
@@ -434,14 +510,24 @@ public:
     }
 
     // This is needed for Sparse Matrices to ensure they can write to the matrix. Note: writing to slices is not currently supported
+    // Since writers call this first, it also counts the write, which invalidates what is cached about the content.
     void VerifyWritable(const char* function) const 
     {
         if (!(m_sob->GetNumStorageRows() == m_numRows && m_sob->GetNumStorageCols() == m_numCols))
         {
             LogicError("%s: Cannot write to the matrix because it is a slice.", function);
         }
+        m_sob->m_writeCount++;
     }
 
+    // changes with every VerifyWritable() and VerifyResizable() of any matrix on the same storage
+    size_t GetStorageWriteCount() const { return m_sob->m_writeCount; }
+
+protected:
+    typename BaseMatrixStorage<ElemType>::ConvertedCopy& StorageConvertedCopy() const { return m_sob->m_convertedCopy; }
+
+public:
+
     bool IsView() const { return (GetNumRows() != m_sob->GetNumStorageRows() || GetNumCols() != m_sob->GetNumStorageCols() || m_sliceViewOffset != 0); }
 
     void VerifySize(const size_t rows, const size_t cols)
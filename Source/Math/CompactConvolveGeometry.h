@@ -0,0 +1,115 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CompactConvolveGeometry.h -- the per-row maps of ConvolveGeometry, computed instead of looked up
+//
+// For an output cell ("row"), MpRowCol, MpRowIwht and MpRowRun of ConvolveGeometry follow from the coordinates
+// of the row and a few numbers per dimension. CompactConvolveGeometry holds these numbers, and Map() evaluates
+// the maps for a row, on the host or in a CUDA kernel. Instead of MpRowRun it gives the "key" of the row, the
+// position of its kernel relative to the borders of the input, and the run is looked up by the key (see
+// ConvolveGeometry::MpKeyRun()). Thus nothing is stored per row.
+
+#pragma once
+
+#ifdef __CUDACC__
+#define CONVOLVE_DECL __device__ __host__
+#else
+#define CONVOLVE_DECL
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A POD, so that it can be passed by value to a CUDA kernel.
+struct CompactConvolveGeometry
+{
+    static const int MaxRank = 12; // that of TensorShape
+
+    int rank;
+    int kernelSize;         // number of weights of a kernel
+    int outDim[MaxRank];    // output cells per map
+    int mapCount[MaxRank];
+    int sharing[MaxRank];   // 0 or 1
+    int stride[MaxRank];
+    int start[MaxRank];     // input coordinate of the center of the first kernel
+    int inDim[MaxRank];
+    int kernelDim[MaxRank];
+
+    // Computes MpRowCol[row], MpRowIwht[row] and the key of the row.
+    CONVOLVE_DECL void Map(int row, int& col, int& iwht, int& key) const
+    {
+        int kern = 0;
+        int factorKern = 1;
+        int factorCol = 1;
+        int cur = row;
+        col = 0;
+        key = 0;
+        for (int i = 0; i < rank; i++)
+        {
+            int dim = outDim[i];
+            int coord = cur % dim;
+            cur /= dim;
+
+            // Kernel
+            if (!sharing[i])
+            {
+                kern += factorKern * coord;
+                factorKern *= dim;
+            }
+
+            int maps = mapCount[i];
+            if (maps > 1)
+            {
+                kern += factorKern * (cur % maps);
+                cur /= maps;
+                factorKern *= maps;
+            }
+
+            // Transform coord to input index space.
+            coord = coord * stride[i] + start[i];
+            col += factorCol * coord;
+            factorCol *= inDim[i];
+
+            // Key: the excess of the kernel over the lower or upper border, shifted to [0, width).
+            int width = kernelDim[i];
+            int half = (width - 1) / 2;
+            int min = coord - half;
+            int lim = min + width;
+            int dkey = min < 0 ? min : lim > inDim[i] ? lim - inDim[i] : 0;
+            key = key * width + dkey + half;
+        }
+        iwht = kern * kernelSize;
+    }
+};
+
+// The maps for a row, as the convolution loops over the runs need them: the input cell of the kernel center,
+// the first weight of the kernel and the position of the run in 'runs'. Either looked up per row...
+struct TableConvolveRowMap
+{
+    const int* mpRowCol;
+    const int* mpRowIwht;
+    const int* mpRowRun;
+
+    CONVOLVE_DECL void operator()(int row, int& colBase, int& ivBase, int& i0) const
+    {
+        colBase = mpRowCol[row];
+        ivBase = mpRowIwht[row];
+        i0 = mpRowRun[row];
+    }
+};
+
+// ...or computed, with the run looked up by the key of the row.
+struct CompactConvolveRowMap
+{
+    CompactConvolveGeometry geometry;
+    const int* mpKeyRun;
+
+    CONVOLVE_DECL void operator()(int row, int& colBase, int& ivBase, int& i0) const
+    {
+        int key;
+        geometry.Map(row, colBase, ivBase, key);
+        i0 = mpKeyRun[key];
+    }
+};
+
+}}}
@@ -8,6 +8,7 @@
 #include <cuda_runtime.h>
 #include <device_launch_parameters.h>
 #include <math_constants.h>
+#include "CompactConvolveGeometry.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -19,12 +20,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // input. 'mpRowIwht', 'mpRowRun' and 'runs' provide maps that allow
 // to get indices of the active weight when applying the convolution.
 // See ConvolveGeometry.h (MpRowCol, MpRowIwht etc) for more details.
+// The convolution kernels get these maps through a RowMap, either the
+// tables (TableConvolveRowMap) or computed from the geometry, with the
+// runs looked up by key (CompactConvolveRowMap), see
+// CompactConvolveGeometry.h.
 // -----------------------------------------------------------------------
 
-template <typename ElemType>
+template <typename ElemType, typename RowMap>
 __global__ void kConvolutionForward(int batchSize, const ElemType* __restrict__ kernel,
-                                    const int* mpRowCol, const int* mpRowIwht,
-                                    const int* mpRowRun, const int* __restrict__ runs,
+                                    RowMap rowMap, const int* __restrict__ runs,
                                     const ElemType* __restrict__ src, int srcVecSize,
                                     ElemType* dst, int dstVecSize)
 {
@@ -37,12 +41,11 @@ __global__ void kConvolutionForward(int batchSize, const ElemType* __restrict__
 
     for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
     {
-        int colBase = mpRowCol[row];
-        int ivBase = mpRowIwht[row];
+        int colBase, ivBase, i0;
+        rowMap(row, colBase, ivBase, i0);
         assert(0 <= colBase && colBase < srcVecSize);
 
         ElemType sum = 0;
-        int i0 = mpRowRun[row];
         int skip = runs[i0++];
         int size = runs[i0++];
         int imask = i0 + size;
@@ -61,10 +64,9 @@ __global__ void kConvolutionForward(int batchSize, const ElemType* __restrict__
     }
 }
 
-template <typename ElemType>
+template <typename ElemType, typename RowMap>
 __global__ void kConvolutionBackwardData(int batchSize, const ElemType* __restrict__ kernel,
-                                         const int* mpRowCol, const int* mpRowIwht,
-                                         const int* mpRowRun, const int* __restrict__ runs,
+                                         RowMap rowMap, const int* __restrict__ runs,
                                          const ElemType* __restrict__ srcGrad, int srcVecSize,
                                          ElemType* grad, int dstVecSize)
 {
@@ -77,12 +79,11 @@ __global__ void kConvolutionBackwardData(int batchSize, const ElemType* __restri
 
     for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
     {
-        int colBase = mpRowCol[row];
-        int ivBase = mpRowIwht[row];
+        int colBase, ivBase, i0;
+        rowMap(row, colBase, ivBase, i0);
         assert(0 <= colBase && colBase < dstVecSize);
 
         ElemType g = srcGrad[row];
-        int i0 = mpRowRun[row];
         int skip = runs[i0++];
         int size = runs[i0++];
         int imask = i0 + size;
@@ -100,11 +101,10 @@ __global__ void kConvolutionBackwardData(int batchSize, const ElemType* __restri
     }
 }
 
-template <typename ElemType>
+template <typename ElemType, typename RowMap>
 __global__ void kConvolutionBackwardKernel(int batchSize, int inVecSize, int outVecSize,
                                            const ElemType* __restrict__ in,
-                                           const int* mpRowCol, const int* mpRowIwht,
-                                           const int* mpRowRun, const int* __restrict__ runs,
+                                           RowMap rowMap, const int* __restrict__ runs,
                                            const ElemType* __restrict__ srcGrad,
                                            ElemType* kernelGrad)
 {
@@ -117,12 +117,11 @@ __global__ void kConvolutionBackwardKernel(int batchSize, int inVecSize, int out
 
     for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
     {
-        int colBase = mpRowCol[row];
-        int ivBase = mpRowIwht[row];
+        int colBase, ivBase, i0;
+        rowMap(row, colBase, ivBase, i0);
         assert(0 <= colBase && colBase < inVecSize);
 
         ElemType g = srcGrad[row];
-        int i0 = mpRowRun[row];
         int skip = runs[i0++];
         int size = runs[i0++];
         int imask = i0 + size;
@@ -149,16 +148,16 @@ __global__ void kMaxPoolingForward(int batchSize, const int* mpRowCol, const int
     if (row >= dstVecSize)
         return;
 
+    int colBase = mpRowCol[row];
+    assert(0 <= colBase && colBase < srcVecSize);
+    int i0 = mpRowIndices[row];
+    int size = indices[i0++];
+
     src += blockIdx.y * srcVecSize;
     dst += blockIdx.y * dstVecSize;
 
     for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
     {
-        int colBase = mpRowCol[row];
-        assert(0 <= colBase && colBase < srcVecSize);
-
-        int i0 = mpRowIndices[row];
-        int size = indices[i0++];
         ElemType res = src[colBase + indices[i0]];
         for (int i = 1; i < size; i++)
         {
@@ -168,8 +167,8 @@ __global__ void kMaxPoolingForward(int batchSize, const int* mpRowCol, const int
         }
         dst[row] = res;
 
-        src += blockDim.y * srcVecSize;
-        dst += blockDim.y * dstVecSize;
+        src += gridDim.y * srcVecSize;
+        dst += gridDim.y * dstVecSize;
     }
 }
 
@@ -206,10 +205,50 @@ __global__ void kMaxPoolingBackward(int batchSize, const ElemType* out, const El
                 atomicAdd(&grad[colBase + dcol], g);
         }
 
-        in += blockDim.y * dstVecSize;
-        out += blockDim.y * srcVecSize;
-        srcGrad += blockDim.y * srcVecSize;
-        grad += blockDim.y * dstVecSize;
+        in += gridDim.y * dstVecSize;
+        out += gridDim.y * srcVecSize;
+        srcGrad += gridDim.y * srcVecSize;
+        grad += gridDim.y * dstVecSize;
+    }
+}
+
+// The gradients of kMaxPoolingBackward, gathered per row of the pooling input instead of scattered with atomics:
+// inRowSources[inRowStarts[row]] ... inRowSources[inRowStarts[row + 1] - 1] are the output rows whose window includes 'row'.
+template <typename ElemType>
+__global__ void kMaxPoolingBackwardByInput(int batchSize, const ElemType* out, const ElemType* in,
+                                           const int* __restrict__ inRowStarts, const int* __restrict__ inRowSources,
+                                           const ElemType* __restrict__ srcGrad, int srcVecSize,
+                                           ElemType* grad, int dstVecSize)
+{
+    int row = blockIdx.x * blockDim.x + threadIdx.x;
+    if (row >= dstVecSize)
+        return;
+
+    int start = inRowStarts[row];
+    int end = inRowStarts[row + 1];
+
+    in += blockIdx.y * dstVecSize;
+    out += blockIdx.y * srcVecSize;
+    srcGrad += blockIdx.y * srcVecSize;
+    grad += blockIdx.y * dstVecSize;
+
+    for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
+    {
+        ElemType x = in[row];
+        ElemType g = 0;
+        for (int i = start; i < end; i++)
+        {
+            int srcRow = inRowSources[i];
+            assert(0 <= srcRow && srcRow < srcVecSize);
+            if (x >= out[srcRow])
+                g += srcGrad[srcRow];
+        }
+        grad[row] += g;
+
+        in += gridDim.y * dstVecSize;
+        out += gridDim.y * srcVecSize;
+        srcGrad += gridDim.y * srcVecSize;
+        grad += gridDim.y * dstVecSize;
     }
 }
 
@@ -254,9 +293,9 @@ __global__ void kMaxUnpooling(int batchSize, const int* mpRowCol, const int* mpR
 
         dst[colBase + dcol] = src[row];
 
-        src    += blockIdx.y * srcVecSize;
-        poolIn += blockIdx.y * dstVecSize;
-        dst    += blockIdx.y * dstVecSize;
+        src    += gridDim.y * srcVecSize;
+        poolIn += gridDim.y * dstVecSize;
+        dst    += gridDim.y * dstVecSize;
     }
 }
 
@@ -269,16 +308,16 @@ __global__ void kAveragePoolingForward(int batchSize, const int* mpRowCol, const
     if (row >= dstVecSize)
         return;
 
+    int colBase = mpRowCol[row];
+    assert(0 <= colBase && colBase < srcVecSize);
+    int i0 = mpRowIndices[row];
+    int size = indices[i0++];
+
     src += blockIdx.y * srcVecSize;
     dst += blockIdx.y * dstVecSize;
 
     for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
     {
-        int colBase = mpRowCol[row];
-        assert(0 <= colBase && colBase < srcVecSize);
-
-        int i0 = mpRowIndices[row];
-        int size = indices[i0++];
         ElemType sum = 0;
         for (int i = 0; i < size; i++)
         {
@@ -288,8 +327,8 @@ __global__ void kAveragePoolingForward(int batchSize, const int* mpRowCol, const
         }
         dst[row] = sum / size;
 
-        src += blockDim.y * srcVecSize;
-        dst += blockDim.y * dstVecSize;
+        src += gridDim.y * srcVecSize;
+        dst += gridDim.y * dstVecSize;
     }
 }
 
@@ -321,8 +360,41 @@ __global__ void kAveragePoolingBackward(int batchSize, const int* mpRowCol, cons
             atomicAdd(&grad[colBase + dcol], g);
         }
 
-        srcGrad += blockDim.y * srcVecSize;
-        grad += blockDim.y * dstVecSize;
+        srcGrad += gridDim.y * srcVecSize;
+        grad += gridDim.y * dstVecSize;
+    }
+}
+
+// The gradients of kAveragePoolingBackward, gathered per row of the pooling input (see kMaxPoolingBackwardByInput)
+template <typename ElemType>
+__global__ void kAveragePoolingBackwardByInput(int batchSize, const int* __restrict__ mpRowIndices, const int* __restrict__ indices,
+                                               const int* __restrict__ inRowStarts, const int* __restrict__ inRowSources,
+                                               const ElemType* __restrict__ srcGrad, int srcVecSize,
+                                               ElemType* grad, int dstVecSize)
+{
+    int row = blockIdx.x * blockDim.x + threadIdx.x;
+    if (row >= dstVecSize)
+        return;
+
+    int start = inRowStarts[row];
+    int end = inRowStarts[row + 1];
+
+    srcGrad += blockIdx.y * srcVecSize;
+    grad += blockIdx.y * dstVecSize;
+
+    for (int sample = blockIdx.y; sample < batchSize; sample += gridDim.y)
+    {
+        ElemType g = 0;
+        for (int i = start; i < end; i++)
+        {
+            int srcRow = inRowSources[i];
+            assert(0 <= srcRow && srcRow < srcVecSize);
+            g += srcGrad[srcRow] / indices[mpRowIndices[srcRow]];
+        }
+        grad[row] += g;
+
+        srcGrad += gridDim.y * srcVecSize;
+        grad += gridDim.y * dstVecSize;
     }
 }
 
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "DirectConvolution.h"
+#include "Int8Multiplier.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -142,8 +144,7 @@ public:
 
 public:
     ReferenceConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
-        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind), 
-        m_mpRowCol(geometry->MpRowCol().size(), 1, const_cast<int*>(geometry->MpRowCol().data()), deviceId, IsGpu(deviceId) ? matrixFlagNormal : matrixFlagDontOwnBuffer)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind), m_useCompactMaps(false)
     {
     }
 
@@ -160,11 +161,25 @@ protected:
             RuntimeError("Reference convolution engine supports only CHW/cudnn layout.");
     }
 
+    // On the GPU, the maps by row take device memory in proportion to the output, which is prohibitive for large (e.g.
+    // volumetric) inputs. Unless the output is small, the kernels compute them per row instead, and only the runs by key
+    // are uploaded, see CompactConvolveGeometry.
     void EnsureConvolutionInitialized() override
     {
-        if (m_mpRowIwht == nullptr)
+        if (m_mpRowIwht == nullptr && m_mpKeyRun == nullptr)
         {
             auto flags = IsGpu(m_deviceId) ? matrixFlagNormal : matrixFlagDontOwnBuffer;
+            m_useCompactMaps = IsGpu(m_deviceId) && m_geometry->PrefersCompactMaps();
+            if (m_useCompactMaps)
+            {
+                m_mpKeyRun = std::make_unique<Matrix<int>>(m_geometry->MpKeyRun().size(), 1,
+                                                           const_cast<int*>(m_geometry->MpKeyRun().data()), m_deviceId, flags);
+                m_keyRuns = std::make_unique<Matrix<int>>(m_geometry->KeyRuns().size(), 1,
+                                                          const_cast<int*>(m_geometry->KeyRuns().data()), m_deviceId, flags);
+                return;
+            }
+
+            EnsureMpRowCol();
             m_mpRowIwht = std::make_unique<Matrix<int>>(m_geometry->MpRowIwht().size(), 1, 
                                                         const_cast<int*>(m_geometry->MpRowIwht().data()), m_deviceId, flags);
             m_mpRowRun = std::make_unique<Matrix<int>>(m_geometry->MpRowRun().size(), 1,
@@ -176,17 +191,35 @@ protected:
 
     void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& /*workspace*/) override
     {
-        in.ConvolutionForward(kernel, m_mpRowCol, *m_mpRowIwht, *m_mpRowRun, *m_runs, out);
+        if (m_useCompactMaps)
+            in.ConvolutionForward(kernel, m_geometry->Compact(), *m_mpKeyRun, *m_keyRuns, out);
+        else
+            in.ConvolutionForward(kernel, *m_mpRowCol, *m_mpRowIwht, *m_mpRowRun, *m_runs, out);
     }
 
     void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& /*workspace*/) override
     {
-        srcGrad.ConvolutionBackwardData(kernel, m_mpRowCol, *m_mpRowIwht, *m_mpRowRun, *m_runs, grad);
+        if (m_useCompactMaps)
+            srcGrad.ConvolutionBackwardData(kernel, m_geometry->Compact(), *m_mpKeyRun, *m_keyRuns, grad);
+        else
+            srcGrad.ConvolutionBackwardData(kernel, *m_mpRowCol, *m_mpRowIwht, *m_mpRowRun, *m_runs, grad);
     }
 
     void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*allowReuse*/, Mat& /*workspace*/) override
     {
-        srcGrad.ConvolutionBackwardKernel(in, m_mpRowCol, *m_mpRowIwht, *m_mpRowRun, *m_runs, kernelGrad);
+        if (m_useCompactMaps)
+            srcGrad.ConvolutionBackwardKernel(in, m_geometry->Compact(), *m_mpKeyRun, *m_keyRuns, kernelGrad);
+        else
+            srcGrad.ConvolutionBackwardKernel(in, *m_mpRowCol, *m_mpRowIwht, *m_mpRowRun, *m_runs, kernelGrad);
+    }
+
+    void EnsureMpRowCol()
+    {
+        if (m_mpRowCol == nullptr)
+        {
+            m_mpRowCol = std::make_unique<Matrix<int>>(m_geometry->MpRowCol().size(), 1, const_cast<int*>(m_geometry->MpRowCol().data()),
+                                                       m_deviceId, IsGpu(m_deviceId) ? matrixFlagNormal : matrixFlagDontOwnBuffer);
+        }
     }
 
     void EnsurePoolingInitialized() override
@@ -194,22 +227,59 @@ protected:
         if (m_indices == nullptr)
         {
             auto flags = IsGpu(m_deviceId) ? matrixFlagNormal : matrixFlagDontOwnBuffer;
+            EnsureMpRowCol();
             m_mpRowIndices = std::make_unique<Matrix<int>>(m_geometry->MpRowIndices().size(), 1,
                                                            const_cast<int*>(m_geometry->MpRowIndices().data()), m_deviceId, flags);
             m_indices = std::make_unique<Matrix<int>>(m_geometry->Indices().size(), 1,
                                                       const_cast<int*>(m_geometry->Indices().data()), m_deviceId, flags);
+            if (IsGpu(m_deviceId))
+                InitializeInputToOutputMap();
+        }
+    }
+
+    // On the GPU, the backward pooling is gathered per input element, which avoids the atomic adds of a scatter per output
+    // element; the windows of arbitrary strides, padding and rank are inverted once into the output rows that include each input row.
+    void InitializeInputToOutputMap()
+    {
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowIndices = m_geometry->MpRowIndices();
+        const auto& indices = m_geometry->Indices();
+        size_t inSize = m_geometry->InputShape().GetNumElements();
+
+        std::vector<int> inRowStarts(inSize + 1, 0);
+        for (size_t row = 0; row < mpRowCol.size(); row++)
+        {
+            int i0 = mpRowIndices[row];
+            int size = indices[i0++];
+            for (int i = 0; i < size; i++)
+                inRowStarts[mpRowCol[row] + indices[i0 + i] + 1]++;
+        }
+        for (size_t inRow = 0; inRow < inSize; inRow++)
+            inRowStarts[inRow + 1] += inRowStarts[inRow];
+
+        std::vector<int> inRowSources(std::max(inRowStarts[inSize], 1));
+        std::vector<int> next(inRowStarts.begin(), inRowStarts.end() - 1);
+        for (size_t row = 0; row < mpRowCol.size(); row++)
+        {
+            int i0 = mpRowIndices[row];
+            int size = indices[i0++];
+            for (int i = 0; i < size; i++)
+                inRowSources[next[mpRowCol[row] + indices[i0 + i]]++] = (int)row;
         }
+
+        m_inRowStarts = std::make_unique<Matrix<int>>(inRowStarts.size(), 1, inRowStarts.data(), m_deviceId, matrixFlagNormal);
+        m_inRowSources = std::make_unique<Matrix<int>>(inRowSources.size(), 1, inRowSources.data(), m_deviceId, matrixFlagNormal);
     }
 
     void ForwardPoolingCore(const Mat& in, Mat& out) override
     {
         if (m_poolKind == PoolKind::Max)
         {
-            in.MaxPoolingForward(m_mpRowCol, *m_mpRowIndices, *m_indices, out);
+            in.MaxPoolingForward(*m_mpRowCol, *m_mpRowIndices, *m_indices, out);
         }
         else if (m_poolKind == PoolKind::Average)
         {
-            in.AveragePoolingForward(m_mpRowCol, *m_mpRowIndices, *m_indices, out);
+            in.AveragePoolingForward(*m_mpRowCol, *m_mpRowIndices, *m_indices, out);
         }
         else
             InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
@@ -220,11 +290,17 @@ protected:
     {
         if (m_poolKind == PoolKind::Max)
         {
-            srcGrad.MaxPoolingBackward(out, in, m_mpRowCol, *m_mpRowIndices, *m_indices, grad);
+            if (m_inRowStarts)
+                srcGrad.MaxPoolingBackwardByInput(out, in, *m_inRowStarts, *m_inRowSources, grad);
+            else
+                srcGrad.MaxPoolingBackward(out, in, *m_mpRowCol, *m_mpRowIndices, *m_indices, grad);
         }
         else if (m_poolKind == PoolKind::Average)
         {
-            srcGrad.AveragePoolingBackward(m_mpRowCol, *m_mpRowIndices, *m_indices, grad);
+            if (m_inRowStarts)
+                srcGrad.AveragePoolingBackwardByInput(*m_mpRowIndices, *m_indices, *m_inRowStarts, *m_inRowSources, grad);
+            else
+                srcGrad.AveragePoolingBackward(*m_mpRowCol, *m_mpRowIndices, *m_indices, grad);
         }
         else
             InvalidArgument("Pooling type %d is not supported.", (int)m_poolKind);
@@ -232,7 +308,7 @@ protected:
 
     void MaxUnpoolingCore(const Mat& out, const Mat& poolIn, Mat& in) override
     {
-        out.MaxUnpooling(m_mpRowCol, *m_mpRowIndices, *m_indices, poolIn, in);
+        out.MaxUnpooling(*m_mpRowCol, *m_mpRowIndices, *m_indices, poolIn, in);
     }
 
 protected:
@@ -244,14 +320,21 @@ protected:
 protected:
     using IntMatPtr = std::unique_ptr<Matrix<int>>;
 
-    Matrix<int> m_mpRowCol;
+    IntMatPtr m_mpRowCol;
     // Convolution-specific maps.
     IntMatPtr m_mpRowIwht;
     IntMatPtr m_mpRowRun;
     IntMatPtr m_runs;
+    // Or, if m_useCompactMaps, the runs by key (see ConvolveGeometry::MpKeyRun()).
+    bool m_useCompactMaps;
+    IntMatPtr m_mpKeyRun;
+    IntMatPtr m_keyRuns;
     // Pooling-specific maps.
     IntMatPtr m_mpRowIndices;
     IntMatPtr m_indices;
+    // GPU only: the output rows of the pooling windows that include each input row, see InitializeInputToOutputMap().
+    IntMatPtr m_inRowStarts;
+    IntMatPtr m_inRowSources;
 };
 
 //------------------------------------------------------------------
@@ -561,10 +644,12 @@ public:
 
 public:
     GemmConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
-        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind), m_int8Product(deviceId), m_int8QuantizedKernelVersion(0)
     {
     }
 
+    bool SupportsInt8() const override { return true; }
+
 protected:
     using typename Base::IntMatPtr;
 
@@ -574,6 +659,9 @@ protected:
     using Base::m_deviceId;
     using Base::m_imageLayout;
     using Base::m_maxTempMemSizeInSamples;
+    using Base::m_useInt8;
+    using Base::m_int8InputRange;
+    using Base::m_int8KernelVersion;
 
     using Base::m_mpRowCol;
     using Base::m_mpRowIwht;
@@ -621,6 +709,28 @@ protected:
         // Transpose is not required if subBatchSize == 1.
         workspace.Resize(unrollRows, unrollCols + (subBatchSize > 1 ? mapCount : 0));
 
+        // In int8 inference, the GEMM is done by an Int8Multiplier as kern^T * unrolledInput, whose result is transposed.
+        // The kernel weight matrix, row-major [K x XYC], is its fixed left operand.
+        bool useInt8 = m_useInt8 && unrollCols <= (1 << 17);
+        if (useInt8 && (!m_int8Multiplier || m_int8QuantizedKernelVersion != m_int8KernelVersion))
+        {
+            if (!m_int8Multiplier)
+                m_int8Multiplier = std::make_unique<Int8Multiplier<ElemType>>();
+            m_int8Multiplier->SetA(kernel, mapCount, unrollCols, /*isRowMajor=*/true);
+            m_int8QuantizedKernelVersion = m_int8KernelVersion;
+        }
+        auto multiply = [&](const Mat& unrolledInput, const Mat& kern, Mat& result)
+        {
+            if (!useInt8)
+                Mat::Multiply(unrolledInput, true, kern, false, result);
+            else
+            {
+                m_int8Product.Resize(mapCount, unrolledInput.GetNumCols());
+                m_int8Multiplier->Multiply(unrolledInput, m_int8Product, m_int8InputRange);
+                result.AssignTransposeOf(m_int8Product);
+            }
+        };
+
         for (size_t start = 0; start < batchSize; start += subBatchSize)
         {
             size_t curBatchSize = min(subBatchSize, batchSize - start);
@@ -636,7 +746,7 @@ protected:
 
             // Unroll inputs.
             unrolledInput.SetValue(0);
-            inputSlice.UnrollConvolutionInput(unrollCols, mapOutSize, m_mpRowCol, *m_mpRowRun, *m_runs, unrolledInput);
+            inputSlice.UnrollConvolutionInput(unrollCols, mapOutSize, *m_mpRowCol, *m_mpRowRun, *m_runs, unrolledInput);
 
             // cudnn layout uses row-major kernel weight matrix.
             auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
@@ -648,7 +758,7 @@ protected:
             {
                 auto outSlice = out.ColumnSlice(start, 1);
                 outSlice.Reshape(mapOutSize, mapCount);
-                Mat::Multiply(unrolledInput, true, kern, false, outSlice);
+                multiply(unrolledInput, kern, outSlice);
             }
             else
             {
@@ -659,7 +769,7 @@ protected:
                     outTempSlice = outTempSlice.ColumnSlice(0, curBatchSize * mapCount);
                     outTempSlice.Reshape(mapOutSize * curBatchSize, mapCount);
                 }
-                Mat::Multiply(unrolledInput, true, kern, false, outTempSlice);
+                multiply(unrolledInput, kern, outTempSlice);
                 outTempSlice.Reshape(curBatchSize, mapOutSize * mapCount);
                 auto outSlice = out.ColumnSlice(start, curBatchSize);
                 outSlice.AssignTransposeOf(outTempSlice);
@@ -735,7 +845,7 @@ protected:
 
             // Unroll outputs (source gradients).
             unrolledSrcGrad.SetValue(0);
-            srcGradSlice.UnrollConvolutionOutput(unrollCols, mapInCount, mapOutCount, m_mpRowCol, *m_mpRowRun, *m_runs, unrolledSrcGrad);
+            srcGradSlice.UnrollConvolutionOutput(unrollCols, mapInCount, mapOutCount, *m_mpRowCol, *m_mpRowRun, *m_runs, unrolledSrcGrad);
 
             // Perform matrix multiplication of unrolled outputs with weights.
             // If there is just one sample in the sub-batch then compute result directly to the output matrix.
@@ -829,7 +939,7 @@ protected:
             }
             unrolledInputSlice.Reshape(mapOutSize * curBatchSize, unrollRows);
             unrolledInputSlice.SetValue(0);
-            inputSlice.UnrollConvolutionInputForKernelBackprop(mapOutSize, m_mpRowCol, *m_mpRowRun, *m_runs, unrolledInputSlice);
+            inputSlice.UnrollConvolutionInputForKernelBackprop(mapOutSize, *m_mpRowCol, *m_mpRowRun, *m_runs, unrolledInputSlice);
 
             // cudnn layout uses row-major kernel weight matrix.
             auto kernGrad = kernelGrad.ColumnSlice(0, kernelGrad.GetNumCols());
@@ -845,6 +955,73 @@ public:
         return deviceId < 0 &&
                find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing());
     }
+
+private:
+    // int8 inference, see ForwardCore()
+    std::unique_ptr<Int8Multiplier<ElemType>> m_int8Multiplier;
+    Mat m_int8Product;
+    int64_t m_int8QuantizedKernelVersion;
+};
+
+//------------------------------------------------------------------
+// Direct convolution engine (CPU only), see DirectConvolution.h.
+// Forward computes the convolution directly, without unrolling the input and without the maps of ConvolveGeometry,
+// which are built only if a backward pass or int8 inference needs them. These are those of the GEMM engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind)
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_useInt8;
+
+    void EnsureConvolutionInitialized() override
+    {
+        if (m_direct == nullptr)
+            m_direct = std::make_unique<DirectConvolution<ElemType>>(*m_geometry);
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        if (m_useInt8)
+        {
+            Base::EnsureConvolutionInitialized();
+            Base::ForwardCore(in, kernel, out, workspace);
+        }
+        else
+            m_direct->Forward(in, kernel, out);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace) override
+    {
+        Base::EnsureConvolutionInitialized();
+        Base::BackwardDataCore(srcGrad, kernel, grad, workspace);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool allowReuse, Mat& workspace) override
+    {
+        Base::EnsureConvolutionInitialized();
+        Base::BackwardKernelCore(srcGrad, in, kernelGrad, allowReuse, workspace);
+    }
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+    {
+        return deviceId < 0 && poolKind == PoolKind::None && DirectConvolution<ElemType>::IsSupported(*geometry);
+    }
+
+private:
+    std::unique_ptr<DirectConvolution<ElemType>> m_direct;
 };
 
 template <class ElemType>
@@ -878,6 +1055,12 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
     }
 
+    if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry, poolKind))
+    {
+        fprintf(stderr, "\n%lsusing direct convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+        return std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         fprintf(stderr, "\n%lsusing GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
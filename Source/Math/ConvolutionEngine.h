@@ -22,8 +22,9 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Direct    = 1 << 4, // Blocked direct convolution on CPU, see DirectConvolution.h. Works only for 2D convos with full sharing.
 
-    All       = Reference | CuDnn | Legacy | Gemm
+    All       = Reference | CuDnn | Legacy | Gemm | Direct
 };
 
 enum class PoolKind
@@ -72,9 +73,20 @@ public:
         m_maxTempMemSizeInSamples = maxTempMemSizeInSamples;
     }
 
+    // Int8 inference: Forward() quantizes the kernel and the input to int8 (see Int8Multiplier.h), if the engine SupportsInt8().
+    // The kernel is quantized again whenever kernelVersion changes; the input is quantized to inputRange, or per column if that is 0.
+    virtual bool SupportsInt8() const { return false; }
+    void SetInt8Inference(bool enable, ElemType inputRange, int64_t kernelVersion)
+    {
+        m_useInt8 = enable;
+        m_int8InputRange = inputRange;
+        m_int8KernelVersion = kernelVersion;
+    }
+
 protected:
     ConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind)
-        : m_geometry(geometry), m_deviceId(deviceId), m_imageLayout(imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_poolKind(poolKind)
+        : m_geometry(geometry), m_deviceId(deviceId), m_imageLayout(imageLayout), m_maxTempMemSizeInSamples(maxTempMemSizeInSamples), m_poolKind(poolKind),
+          m_useInt8(false), m_int8InputRange(0), m_int8KernelVersion(0)
     {
         assert(m_geometry != nullptr);
     }
@@ -103,6 +115,9 @@ protected:
     ImageLayoutKind m_imageLayout;
     size_t m_maxTempMemSizeInSamples;
     PoolKind m_poolKind;
+    bool m_useInt8;
+    ElemType m_int8InputRange;
+    int64_t m_int8KernelVersion;
 };
 
 #pragma warning(pop)
@@ -6,7 +6,10 @@
 
 #include "Basics.h"
 #include "TensorShape.h"
+#include "CompactConvolveGeometry.h"
 #include <iterator>
+#include <map>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,6 +24,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // arbitrary configurations and dimensions. In such case the generic implementation becomes very simple and invariant
 // wrt convolution configuration and dimensionality. For specific cases like 2D/3D convolutions and full sharing,
 // highly optimized implementations (e.g. cuDNN) are used.
+// * The maps hold a few ints per output cell, which for large outputs is a lot of memory, on the device, too. They
+//   are computed on first use. Engines that can compute them per row instead (see CompactConvolveGeometry) use
+//   Compact() and the maps by key, which have no size per output cell.
 // TODO: rename to ConvolutionGeometry
 class ConvolveGeometry final
 {
@@ -41,11 +47,11 @@ public:
     // Maps from a "row" (index of output cell) to its base "col" (index of input cell). For a given row,
     // the cols that contribute to it are { MpRowCol[row] + Indices[i0 + 1 + i] | 0 <= i < Indices[i0] },
     // where i0 = MpRowIndices[row].
-    const IntVec& MpRowCol() const { return m_mpRowCol; }
+    const IntVec& MpRowCol() const { EnsureMaps(); return m_mpRowCol; }
 
     // Maps from a "row" (index of output cell) to where to start in the weights array. Each run of weights
     // consists of KernelSize weights.
-    const IntVec& MpRowIwht() const { return m_mpRowIwht; }
+    const IntVec& MpRowIwht() const { EnsureMaps(); return m_mpRowIwht; }
 
     // Maps from a "row" (index of output cell) to its starting index in Runs. A run consists of:
     // * skip count (to skip that many weights)
@@ -58,8 +64,8 @@ public:
     // the value).
     // NOTE: The first (zeroth) run is always the "full" kernel run. Also, MpRowRun can be empty,
     // indicating that all values are zero (all outputs use the "full" kernel run).
-    const IntVec& MpRowRun() const { return m_mpRowRun; }
-    const IntVec& Runs() const { return m_runs; }
+    const IntVec& MpRowRun() const { EnsureMaps(); return m_mpRowRun; }
+    const IntVec& Runs() const { EnsureMaps(); return m_runs; }
 
     // Maps from a "row" (index of output cell) to its starting index in Indices. Note that "Runs" is intended
     // for kernels that have weights, while "Indices" is intended for kernels that don't need to access weights.
@@ -70,8 +76,24 @@ public:
     // NOTE: The first run of indices is always the "full" kernel run. Also, MpRowIndices can be empty,
     // indicating that all values are zero (all outputs use the "full" kernel run).
     // In addition, all items in Indices are valid source indices so no masking is required in subsequent computation.
-    const IntVec&  MpRowIndices() const { return m_mpRowIndices; }
-    const IntVec&  Indices() const { return m_indices; }
+    const IntVec&  MpRowIndices() const { EnsureMaps(); return m_mpRowIndices; }
+    const IntVec&  Indices() const { EnsureMaps(); return m_indices; }
+
+    // The numbers from which MpRowCol, MpRowIwht and the key of a row are computed.
+    const CompactConvolveGeometry& Compact() const { return m_compact; }
+
+    // Maps from the key of a row (see CompactConvolveGeometry) to its starting index in KeyRuns, which
+    // has the same format as Runs. Only keys that occur have a run, the others map to -1.
+    const IntVec& MpKeyRun() const { EnsureKeyRuns(); return m_mpKeyRun; }
+    const IntVec& KeyRuns() const { EnsureKeyRuns(); return m_keyRuns; }
+
+    // True if the maps by key are smaller than MpRowCol, MpRowIwht and MpRowRun. They are, unless the output
+    // is not much larger than the kernel.
+    bool PrefersCompactMaps() const
+    {
+        EnsureKeyRuns();
+        return m_mpKeyRun.size() + m_keyRuns.size() < 3 * m_outputShape.GetNumElements();
+    }
 
     // Number of kernels (equal to MapCount if sharing is all true values).
     size_t KernelCount() const { return m_kernelCount; }
@@ -97,6 +119,8 @@ public:
 
         size_t dimCount = inputShape.GetRank();
         size_t kernelSize = kernelShape.GetNumElements();
+        if (dimCount > CompactConvolveGeometry::MaxRank)
+            InvalidArgument("Convolution supports tensors of rank up to %d.", CompactConvolveGeometry::MaxRank);
 
         // Compute the total number of kernels.
         m_kernelCount = 1;
@@ -178,11 +202,11 @@ public:
         
         // Compute support, mapping from the index into the kernel to offset into source.
         // Support consists of the column deltas of the kernels, as offsets from MpRowCol[row].
-        IntVec support(kernelSize);
-        std::vector<IntVec> kernelCoords(kernelSize);
+        m_support.resize(kernelSize);
+        m_kernelCoords.resize(kernelSize);
         for (int idx = 0; idx < kernelSize; idx++)
         {
-            kernelCoords[idx].resize(dimCount);
+            m_kernelCoords[idx].resize(dimCount);
             int ivSrc = 0;
             int factor = 1;
             int cur = idx;
@@ -193,188 +217,26 @@ public:
                 assert(d > 0);
                 int coord = cur % d;
                 cur /= d;
-                kernelCoords[idx][i] = coord;
+                m_kernelCoords[idx][i] = coord;
                 ivSrc += factor * coord;
                 factor *= (int)m_inputShape[i];
             }
             assert(cur == 0);
             assert(ivSrc < m_inputShape.GetNumElements());
-            support[idx] = ivSrc - m_originIndex;
+            m_support[idx] = ivSrc - m_originIndex;
         }
-        
-        size_t outputSize = m_outputShape.GetNumElements();
-        // Compute the mappings (where row = output node index, col = source node index):
-        // * from row to the index of the first weight to use for that row.
-        // * from row to the first input col. The rest are col + _support[i].
-        m_mpRowIwht.resize(outputSize);
-        m_mpRowCol.resize(outputSize);
-        m_mpRowRun.resize(outputSize);
-        m_mpRowIndices.resize(outputSize);
 
-        // A "key" is an equivalence class of run/masks.
-        // Calculate the key for an interior cell (for using all of support - when all masks are 1's).
-        int keyInterior = 0;
+        m_compact.rank = (int)dimCount;
+        m_compact.kernelSize = (int)kernelSize;
         for (size_t i = 0; i < dimCount; i++)
         {
-            int width = (int)m_kernelShape[i];
-            keyInterior = keyInterior * width + (width - 1) / 2;
-        }
-
-        m_runs.resize(2 * kernelSize + 2, -1);
-        m_indices.resize(kernelSize + 1);
-        m_runs[0] = 0; // Skip count
-        m_runs[1] = (int)kernelSize; // Count of entries
-        m_indices[0] = (int)kernelSize;
-        for (size_t i = 0; i < kernelSize; i++)
-        {
-            m_runs[2 + i] = support[i];
-            m_indices[1 + i] = support[i];
-        }
-
-        // Working buffer for masks.
-        IntVec masks(kernelSize);
-
-        // Map from key to pair of starting locations in Runs and Indices.
-        std::map<int, std::pair<int, int>>  mpkeystarts;
-        mpkeystarts[keyInterior] = std::make_pair(0, 0);
-
-        IntVec dkey(dimCount);
-        for (size_t row = 0; row < outputSize; row++)
-        {
-            // Compute the kernel number, column, and key.
-            // REVIEW alexeyk: Seems like there should be a simpler and faster way, without starting
-            // from scratch for each output (row)....
-            int kern = 0;
-            int col = 0;
-            int factorKern = 1;
-            int factorCol = 1;
-            int key = 0;
-            int cur = (int)row;
-            for (size_t i = 0; i < dimCount; i++)
-            {
-                int dim = (int)(m_outputShape[i] / GetMapCount(i));
-                int coord = cur % dim;
-                cur /= dim;
-
-                // Kernel
-                if (!GetSharing(i))
-                {
-                    kern += factorKern * coord;
-                    factorKern *= dim;
-                }
-
-                int maps = (int)GetMapCount(i);
-                if (maps > 1)
-                {
-                    kern += factorKern * (cur % maps);
-                    cur /= maps;
-                    factorKern *= maps;
-                }
-
-                // Transform coord to input index space.
-                coord *= (int)GetStride(i);
-                coord += m_start[i];
-
-                col += factorCol * coord;
-                factorCol *= (int)m_inputShape[i];
-
-                int width = (int)m_kernelShape[i];
-                int half = (width - 1) / 2;
-                int min = coord - half;
-                int lim = min + width;
-                if (min < 0)
-                    dkey[i] = min;
-                else if (lim > m_inputShape[i])
-                    dkey[i] = lim - (int)m_inputShape[i];
-                else
-                    dkey[i] = 0;
-                int dk = dkey[i] + half;
-                assert(0 <= dk);
-                assert(dk < width);
-                key = key * width + dk;
-            }
-            assert(cur == 0);
-            assert(0 <= kern);
-            assert(kern < m_kernelCount);
-            assert(0 <= col);
-            assert(col < m_inputShape.GetNumElements());
-
-            auto startsIter = mpkeystarts.find(key);
-            if (startsIter == mpkeystarts.end())
-            {
-                auto starts = std::make_pair((int)m_runs.size(), (int)m_indices.size());
-                mpkeystarts[key] = starts;
-
-                int indexCount = 0;
-                for (int idx = 0; idx < kernelSize; idx++)
-                {
-                    const auto& coords = kernelCoords[idx];
-                    int mask = 0;
-                    for (int i = (int)dimCount; ; )
-                    {
-                        if (--i < 0)
-                        {
-                            // All OK.
-                            mask = -1;
-                            break;
-                        }
-                        int k = dkey[i] + coords[i];
-                        if (k < 0)
-                            break;
-                        if (k >= m_kernelShape[i])
-                            break;
-                    }
-                    assert(mask == 0 || mask == -1);
-                    indexCount -= mask;
-                    masks[idx] = mask;
-                }
-
-                int skip = 0;
-                while (masks[skip] == 0)
-                    skip++;
-                int count = (int)kernelSize;
-                while (masks[count - 1] == 0)
-                    count--;
-
-                count -= skip;
-                m_runs.push_back(skip); // Skip count
-                m_runs.push_back(count); // Count of entries
-                m_indices.push_back(indexCount);
-                for (int i = 0, iMin = 0; i < count; i++)
-                {
-                    int index = support[skip + i];
-                    int mask = masks[skip + i];
-                    if (mask != 0)
-                    {
-                        // Add "index" to runs for this slot and any immediately preceeding
-                        // slots that have mask == 0.
-                        assert(iMin <= i);
-                        assert(m_runs.size() == starts.first + 2 + iMin);
-                        for (; iMin <= i; iMin++)
-                            m_runs.push_back(index);
-                        assert(iMin == i + 1);
-                        assert(m_runs.size() == starts.first + 2 + iMin);
-
-                        m_indices.push_back(index);
-                    }
-                }
-                for (int i = 0; i < count; i++)
-                    m_runs.push_back(masks[skip + i]);
-                assert(m_runs.size() == std::get<0>(starts) + 2 + 2 * count);
-                assert(m_indices.size() == std::get<1>(starts) + 1 + indexCount);
-
-                m_mpRowRun[row] = starts.first;
-                m_mpRowIndices[row] = starts.second;
-            }
-            else
-            {
-                m_mpRowRun[row] = (*startsIter).second.first;
-                m_mpRowIndices[row] = (*startsIter).second.second;
-            }
-            assert(0 <= kern);
-            assert(kern < m_kernelCount);
-            m_mpRowCol[row] = col;
-            m_mpRowIwht[row] = kern * (int)kernelSize;
+            m_compact.outDim[i] = (int)(m_outputShape[i] / GetMapCount(i));
+            m_compact.mapCount[i] = (int)GetMapCount(i);
+            m_compact.sharing[i] = GetSharing(i) ? 1 : 0;
+            m_compact.stride[i] = (int)GetStride(i);
+            m_compact.start[i] = m_start[i];
+            m_compact.inDim[i] = (int)m_inputShape[i];
+            m_compact.kernelDim[i] = (int)m_kernelShape[i];
         }
     }
 
@@ -580,6 +442,205 @@ public:
     DISABLE_COPY_AND_MOVE(ConvolveGeometry);
 
 private:
+    void EnsureMaps() const
+    {
+        std::call_once(m_mapsComputed, [this] { const_cast<ConvolveGeometry*>(this)->ComputeMaps(); });
+    }
+
+    void EnsureKeyRuns() const
+    {
+        std::call_once(m_keyRunsComputed, [this] { const_cast<ConvolveGeometry*>(this)->ComputeKeyRuns(); });
+    }
+
+    // The offsets of a key from the borders, per dimension (dkey in ComputeMaps()).
+    IntVec DecodeKey(int key) const
+    {
+        size_t dimCount = m_inputShape.GetRank();
+        IntVec dkey(dimCount);
+        for (int i = (int)dimCount - 1; i >= 0; i--)
+        {
+            int width = (int)m_kernelShape[i];
+            dkey[i] = key % width - (width - 1) / 2;
+            key /= width;
+        }
+        return dkey;
+    }
+
+    // Appends the run (to runs, see Runs()) and the indices (to indices, see Indices()) for the rows with the key dkey.
+    void AppendRun(const IntVec& dkey, IntVec& runs, IntVec& indices) const
+    {
+        size_t dimCount = m_inputShape.GetRank();
+        int kernelSize = (int)m_support.size();
+        IntVec masks(kernelSize);
+        int runStart = (int)runs.size();
+        int indexStart = (int)indices.size();
+
+        int indexCount = 0;
+        for (int idx = 0; idx < kernelSize; idx++)
+        {
+            const auto& coords = m_kernelCoords[idx];
+            int mask = 0;
+            for (int i = (int)dimCount; ; )
+            {
+                if (--i < 0)
+                {
+                    // All OK.
+                    mask = -1;
+                    break;
+                }
+                int k = dkey[i] + coords[i];
+                if (k < 0)
+                    break;
+                if (k >= m_kernelShape[i])
+                    break;
+            }
+            assert(mask == 0 || mask == -1);
+            indexCount -= mask;
+            masks[idx] = mask;
+        }
+
+        int skip = 0;
+        while (masks[skip] == 0)
+            skip++;
+        int count = kernelSize;
+        while (masks[count - 1] == 0)
+            count--;
+
+        count -= skip;
+        runs.push_back(skip); // Skip count
+        runs.push_back(count); // Count of entries
+        indices.push_back(indexCount);
+        for (int i = 0, iMin = 0; i < count; i++)
+        {
+            int index = m_support[skip + i];
+            int mask = masks[skip + i];
+            if (mask != 0)
+            {
+                // Add "index" to runs for this slot and any immediately preceeding
+                // slots that have mask == 0.
+                assert(iMin <= i);
+                assert(runs.size() == runStart + 2 + iMin);
+                for (; iMin <= i; iMin++)
+                    runs.push_back(index);
+                assert(iMin == i + 1);
+                assert(runs.size() == runStart + 2 + iMin);
+
+                indices.push_back(index);
+            }
+        }
+        for (int i = 0; i < count; i++)
+            runs.push_back(masks[skip + i]);
+        assert(runs.size() == runStart + 2 + 2 * count);
+        assert(indices.size() == indexStart + 1 + indexCount);
+        UNUSED(runStart);
+        UNUSED(indexStart);
+    }
+
+    void ComputeMaps()
+    {
+        size_t kernelSize = m_support.size();
+        size_t outputSize = m_outputShape.GetNumElements();
+        // Compute the mappings (where row = output node index, col = source node index):
+        // * from row to the index of the first weight to use for that row.
+        // * from row to the first input col. The rest are col + _support[i].
+        m_mpRowIwht.resize(outputSize);
+        m_mpRowCol.resize(outputSize);
+        m_mpRowRun.resize(outputSize);
+        m_mpRowIndices.resize(outputSize);
+
+        // A "key" is an equivalence class of run/masks.
+        // Calculate the key for an interior cell (for using all of support - when all masks are 1's).
+        int keyInterior = 0;
+        for (size_t i = 0; i < m_inputShape.GetRank(); i++)
+        {
+            int width = (int)m_kernelShape[i];
+            keyInterior = keyInterior * width + (width - 1) / 2;
+        }
+
+        m_runs.resize(2 * kernelSize + 2, -1);
+        m_indices.resize(kernelSize + 1);
+        m_runs[0] = 0; // Skip count
+        m_runs[1] = (int)kernelSize; // Count of entries
+        m_indices[0] = (int)kernelSize;
+        for (size_t i = 0; i < kernelSize; i++)
+        {
+            m_runs[2 + i] = m_support[i];
+            m_indices[1 + i] = m_support[i];
+        }
+
+        // Map from key to pair of starting locations in Runs and Indices.
+        std::map<int, std::pair<int, int>>  mpkeystarts;
+        mpkeystarts[keyInterior] = std::make_pair(0, 0);
+
+        for (size_t row = 0; row < outputSize; row++)
+        {
+            // Compute the column, the index of the first weight, and the key.
+            int col, iwht, key;
+            m_compact.Map((int)row, col, iwht, key);
+            assert(0 <= col);
+            assert(col < m_inputShape.GetNumElements());
+            assert(0 <= iwht);
+            assert(iwht < m_kernelCount * kernelSize);
+
+            auto startsIter = mpkeystarts.find(key);
+            if (startsIter == mpkeystarts.end())
+            {
+                auto starts = std::make_pair((int)m_runs.size(), (int)m_indices.size());
+                mpkeystarts[key] = starts;
+                AppendRun(DecodeKey(key), m_runs, m_indices);
+
+                m_mpRowRun[row] = starts.first;
+                m_mpRowIndices[row] = starts.second;
+            }
+            else
+            {
+                m_mpRowRun[row] = (*startsIter).second.first;
+                m_mpRowIndices[row] = (*startsIter).second.second;
+            }
+            m_mpRowCol[row] = col;
+            m_mpRowIwht[row] = iwht;
+        }
+    }
+
+    // The runs of the keys that occur: a key occurs if each of its offsets from the borders
+    // occurs in its dimension, which is checked per dimension.
+    void ComputeKeyRuns()
+    {
+        size_t dimCount = m_inputShape.GetRank();
+        std::vector<std::vector<bool>> occurs(dimCount);
+        size_t keyCount = 1;
+        for (size_t i = 0; i < dimCount; i++)
+        {
+            int width = m_compact.kernelDim[i];
+            int half = (width - 1) / 2;
+            occurs[i].resize(width, false);
+            for (int coord = 0; coord < m_compact.outDim[i]; coord++)
+            {
+                int min = coord * m_compact.stride[i] + m_compact.start[i] - half;
+                int lim = min + width;
+                int dkey = min < 0 ? min : lim > m_compact.inDim[i] ? lim - m_compact.inDim[i] : 0;
+                occurs[i][dkey + half] = true;
+            }
+            keyCount *= width;
+        }
+
+        m_mpKeyRun.assign(keyCount, -1);
+        IntVec indices;
+        for (size_t key = 0; key < keyCount; key++)
+        {
+            IntVec dkey = DecodeKey((int)key);
+            bool keyOccurs = true;
+            for (size_t i = 0; i < dimCount; i++)
+                keyOccurs = keyOccurs && occurs[i][dkey[i] + (m_compact.kernelDim[i] - 1) / 2];
+            if (!keyOccurs)
+                continue;
+
+            m_mpKeyRun[key] = (int)m_keyRuns.size();
+            AppendRun(dkey, m_keyRuns, indices);
+            indices.clear();
+        }
+    }
+
     TensorShape m_inputShape;
     TensorShape m_outputShape;
     TensorShape m_kernelShape;
@@ -602,6 +663,14 @@ private:
     IntVec m_runs;
     IntVec m_mpRowIndices;
     IntVec m_indices;
+    IntVec m_mpKeyRun;
+    IntVec m_keyRuns;
+    mutable std::once_flag m_mapsComputed;
+    mutable std::once_flag m_keyRunsComputed;
+    CompactConvolveGeometry m_compact;
+    // Support, mapping from the index into the kernel to offset into source, and the coordinates of each index.
+    IntVec m_support;
+    std::vector<IntVec> m_kernelCoords;
     // The indices of the first ("top-left-most") "kernel-center" cell in the source.
     IntVec m_start;
     int m_startIndex;
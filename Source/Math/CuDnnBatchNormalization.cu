@@ -45,6 +45,7 @@ protected:
     void ForwardCore(const Mat& in, const Mat& scale, const Mat& bias, double expAvgFactor, double blendFactor, Mat& runMean, Mat& runInvStdDev,
                      Mat& out, double epsilon, Mat& saveMean, Mat& saveInvStdDev) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         // REVIEW alexeyk: there might be a way to do this in cuDNN.
         if (blendFactor != 0 && (blendFactor != 1 || expAvgFactor > 0))
             InvalidArgument("cuDNN batch normalization engine currently supports blendTimeConstant of 0 or 1 only.");
@@ -74,6 +75,7 @@ protected:
     void BackwardCore(const Mat& in, const Mat& srcGrad, Mat& grad, const Mat& scale, double blendFactor, const Mat& saveMean, const Mat& saveInvStdDev,
                       Mat& scaleGrad, Mat& biasGrad) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         UNUSED(blendFactor);  // BUGBUG: It should be used.
         m_inOutCuDnnT.UpdateBatchSize(srcGrad.GetNumCols());
         cudnnBatchNormMode_t mode = m_spatial ? CUDNN_BATCHNORM_SPATIAL : CUDNN_BATCHNORM_PER_ACTIVATION;
@@ -105,4 +105,9 @@ CuDnn::ptr_t CuDnn::Instance()
     return m_instance;
 }
 
+void CuDnn::UseCurrentStream(cudnnHandle_t handle)
+{
+    CUDNN_CALL(cudnnSetStream(handle, GetStream()));
+}
+
 } } }
@@ -36,6 +36,9 @@ struct CuDnn final
     using ptr_t = std::shared_ptr<cudnnHandle_t>;
     static ptr_t Instance();
 
+    // point the handle at the current stream, which may change between calls (see GPUStreams); call before using it
+    static void UseCurrentStream(cudnnHandle_t handle);
+
     DISABLE_COPY_AND_MOVE(CuDnn);
 };
 
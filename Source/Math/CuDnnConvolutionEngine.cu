@@ -8,6 +8,9 @@
 #include "GPUMatrix.h"
 #include <typeinfo>
 #include <typeindex>
+#include <fstream>
+#include <map>
+#include <mutex>
 #include "CuDnnCommon.h"
 
 template <>
@@ -29,6 +32,63 @@ static bool IsGpu(DEVICEID_TYPE deviceId)
     return deviceId >= 0;
 }
 
+// state of CuDnnConvolutionAlgoCache; each entry is the chosen algorithm and the fastest no-workspace algorithm
+static std::mutex s_algoCacheMutex;
+static std::wstring s_algoCacheFile;
+static bool s_isAlgoCacheEnabled = false;
+static bool s_algoCacheBucketsBatchSizes = false;
+static std::map<std::string, std::pair<int, int>> s_algoCache;
+
+/*static*/ void CuDnnConvolutionAlgoCache::Configure(const std::wstring& file, bool bucketBatchSizes)
+{
+    std::lock_guard<std::mutex> lock(s_algoCacheMutex);
+    s_algoCacheFile = file;
+    s_isAlgoCacheEnabled = !file.empty();
+    s_algoCacheBucketsBatchSizes = bucketBatchSizes;
+    s_algoCache.clear();
+    if (!s_isAlgoCacheEnabled)
+        return;
+
+    // one entry per line: key <TAB> algo <TAB> no-workspace algo; later lines override earlier ones
+    std::ifstream in(msra::strfun::utf8(file).c_str());
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t tab1 = line.find('\t');
+        size_t tab2 = (tab1 == std::string::npos) ? tab1 : line.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos)
+            continue;
+        s_algoCache[line.substr(0, tab1)] = std::make_pair(atoi(line.substr(tab1 + 1, tab2 - tab1 - 1).c_str()), atoi(line.substr(tab2 + 1).c_str()));
+    }
+    fprintf(stderr, "Loaded %d cuDNN convolution algorithms from '%ls'.\n", (int) s_algoCache.size(), file.c_str());
+}
+
+static bool LookUpConvolutionAlgo(const std::string& key, int& algo, int& noWorkspaceAlgo)
+{
+    std::lock_guard<std::mutex> lock(s_algoCacheMutex);
+    auto iter = s_algoCache.find(key);
+    if (iter == s_algoCache.end())
+        return false;
+    algo = iter->second.first;
+    noWorkspaceAlgo = iter->second.second;
+    return true;
+}
+
+static void StoreConvolutionAlgo(const std::string& key, int algo, int noWorkspaceAlgo)
+{
+    std::lock_guard<std::mutex> lock(s_algoCacheMutex);
+    s_algoCache[key] = std::make_pair(algo, noWorkspaceAlgo);
+    // appended line by line, so that concurrent processes (e.g. the ranks of a job) do not overwrite each other's entries
+    FILE* f = fopen(msra::strfun::utf8(s_algoCacheFile).c_str(), "a");
+    if (!f)
+    {
+        fprintf(stderr, "WARNING: Cannot append to the cuDNN algorithm cache file '%ls'.\n", s_algoCacheFile.c_str());
+        return;
+    }
+    fprintf(f, "%s\t%d\t%d\n", key.c_str(), algo, noWorkspaceAlgo);
+    fclose(f);
+}
+
 class CuDnnKernel
 {
 public:
@@ -214,6 +274,7 @@ protected:
 
     void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         size_t batchSize = in.GetNumCols();
         // Find best algo and allocate temp buffer, if needed.
         auto finder = [this](int& calgo, cudnnConvolutionFwdAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
@@ -224,7 +285,11 @@ protected:
         {
             return cudnnGetConvolutionForwardAlgorithm(*m_cudnn, m_inT, *m_kernelT, *m_conv, m_outT, CUDNN_CONVOLUTION_FWD_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_fwdAlgo, finder, staticFinder);
+        auto workspaceSizer = [this](cudnnConvolutionFwdAlgo_t algo, size_t& size) -> cudnnStatus_t
+        {
+            return cudnnGetConvolutionForwardWorkspaceSize(*m_cudnn, m_inT, *m_kernelT, *m_conv, m_outT, algo, &size);
+        };
+        FindBestAlgo("forward", batchSize, workspace.BufferSize(), m_fwdAlgo, finder, staticFinder, workspaceSizer);
         if (m_fwdAlgo.Algo.memory > 0)
             workspace.Resize((m_fwdAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Perform forward convolution operation.
@@ -245,6 +310,7 @@ protected:
 
     void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         size_t batchSize = srcGrad.GetNumCols();
         // Find best algo and allocate temp buffer, if needed.
         auto finder = [this](int& calgo, cudnnConvolutionBwdDataAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
@@ -255,7 +321,11 @@ protected:
         {
             return cudnnGetConvolutionBackwardDataAlgorithm(*m_cudnn, *m_kernelT, m_outT, *m_conv, m_inT, CUDNN_CONVOLUTION_BWD_DATA_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_backDataAlgo, finder, staticFinder);
+        auto workspaceSizer = [this](cudnnConvolutionBwdDataAlgo_t algo, size_t& size) -> cudnnStatus_t
+        {
+            return cudnnGetConvolutionBackwardDataWorkspaceSize(*m_cudnn, *m_kernelT, m_outT, *m_conv, m_inT, algo, &size);
+        };
+        FindBestAlgo("backwardData", batchSize, workspace.BufferSize(), m_backDataAlgo, finder, staticFinder, workspaceSizer);
         if (m_backDataAlgo.Algo.memory > 0)
             workspace.Resize((m_backDataAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Compute gradients with respect to the output tensor (data).
@@ -265,6 +335,7 @@ protected:
 
     void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool /*allowReuse*/, Mat& workspace) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         size_t batchSize = in.GetNumCols();
         // Find best algo and allocate temp buffer, if needed.
         auto finder = [this](int& calgo, cudnnConvolutionBwdFilterAlgoPerf_t algoPerf[MaxAlgoCount]) -> cudnnStatus_t
@@ -275,7 +346,11 @@ protected:
         {
             return cudnnGetConvolutionBackwardFilterAlgorithm(*m_cudnn, m_inT, m_outT, *m_conv, *m_kernelT, CUDNN_CONVOLUTION_BWD_FILTER_NO_WORKSPACE, 0, &algo);
         };
-        FindBestAlgo(batchSize, m_backFiltAlgo, finder, staticFinder);
+        auto workspaceSizer = [this](cudnnConvolutionBwdFilterAlgo_t algo, size_t& size) -> cudnnStatus_t
+        {
+            return cudnnGetConvolutionBackwardFilterWorkspaceSize(*m_cudnn, m_inT, m_outT, *m_conv, *m_kernelT, algo, &size);
+        };
+        FindBestAlgo("backwardFilter", batchSize, workspace.BufferSize(), m_backFiltAlgo, finder, staticFinder, workspaceSizer);
         if (m_backFiltAlgo.Algo.memory > 0)
             workspace.Resize((m_backFiltAlgo.Algo.memory + sizeof(ElemType) - 1) / sizeof(ElemType), 1);
         // Compute gradients with respect to the output tensor (data).
@@ -291,6 +366,7 @@ protected:
 
     void ForwardPoolingCore(const Mat& in, Mat& out) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         size_t batchSize = in.GetNumCols();
         m_inT.UpdateBatchSize(batchSize);
         m_outT.UpdateBatchSize(batchSize);
@@ -299,6 +375,7 @@ protected:
 
     void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
     {
+        CuDnn::UseCurrentStream(*m_cudnn);
         size_t batchSize = in.GetNumCols();
         m_inT.UpdateBatchSize(batchSize);
         m_outT.UpdateBatchSize(batchSize);
@@ -320,8 +397,29 @@ private:
 
     static const int MaxAlgoCount = 10;
 
-    template <typename TAlgo, typename TFinder, typename TStaticFinder>
-    void FindBestAlgo(size_t batchSize, TAlgo& algo, TFinder finder, TStaticFinder staticFinder)
+    // the key of an algorithm in CuDnnConvolutionAlgoCache
+    std::string AlgoCacheKey(const char* pass, size_t batchSize) const
+    {
+        if (s_algoCacheBucketsBatchSizes)
+        {
+            size_t bucket = 1;
+            while (bucket < batchSize)
+                bucket *= 2;
+            batchSize = bucket;
+        }
+        cudaDeviceProp props = { 0 };
+        CUDA_CALL(cudaGetDeviceProperties(&props, m_deviceId));
+        std::string key = std::string(props.name) + " cudnn" + std::to_string((unsigned long long) cudnnGetVersion()) +
+                          (m_dataType == CUDNN_DATA_FLOAT ? " float " : " double ") + pass +
+                          " in" + (std::string) m_geometry->InputShape() + " out" + (std::string) m_geometry->OutputShape() +
+                          " kernel" + (std::string) m_geometry->KernelShape() + " maps" + (std::string) m_geometry->MapCount();
+        for (size_t i = 0; i < m_geometry->InputShape().GetRank(); i++)
+            key += " " + std::to_string((unsigned long long) m_geometry->GetStride(i)) + "/" + std::to_string((long long) m_geometry->GetLowerPad(i));
+        return key + " batch" + std::to_string((unsigned long long) batchSize);
+    }
+
+    template <typename TAlgo, typename TFinder, typename TStaticFinder, typename TWorkspaceSizer>
+    void FindBestAlgo(const char* pass, size_t batchSize, size_t workspaceBytes, TAlgo& algo, TFinder finder, TStaticFinder staticFinder, TWorkspaceSizer workspaceSizer)
     {
         m_inT.UpdateBatchSize(batchSize);
         m_outT.UpdateBatchSize(batchSize);
@@ -329,7 +427,32 @@ private:
         if (!algo.NeedAutotuning(batchSize))
             return;
 
+        size_t inputSampleSize = m_geometry->InputShape().GetNumElements();
+        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inputSampleSize * m_maxTempMemSizeInSamples * sizeof(ElemType);
+        // Memory the workspace holds already costs nothing. A workspace shared by all convolutions is as large as the most
+        // demanding one needs, so that the others may pick faster algorithms that use all of it.
+        maxMem = (std::max)(maxMem, workspaceBytes);
+
+        // A cached algorithm was chosen for the same configuration, possibly for a smaller batch size of the same bucket,
+        // so its workspace size is queried for the actual one.
         using CuDnnAlgoT = decltype(TAlgo::Algo);
+        using CuDnnAlgoIdT = decltype(CuDnnAlgoT::algo);
+        std::string cacheKey = s_isAlgoCacheEnabled ? AlgoCacheKey(pass, batchSize) : std::string();
+        int cachedAlgo, cachedNoWorkspaceAlgo;
+        if (s_isAlgoCacheEnabled && LookUpConvolutionAlgo(cacheKey, cachedAlgo, cachedNoWorkspaceAlgo))
+        {
+            size_t memory = 0;
+            if ((workspaceSizer((CuDnnAlgoIdT) cachedAlgo, memory) == CUDNN_STATUS_SUCCESS) && (memory <= maxMem))
+            {
+                algo.MaxAllowedMBSizeForCurrentAlgo = batchSize;
+                algo.Algo.algo = (CuDnnAlgoIdT) cachedAlgo;
+                algo.Algo.memory = memory;
+                algo.Algo.status = CUDNN_STATUS_SUCCESS;
+                algo.NoWorkspaceAlgo = (CuDnnAlgoIdT) cachedNoWorkspaceAlgo;
+                return;
+            }
+        }
+
         CuDnnAlgoT algoPerf[MaxAlgoCount];
         int calgo = 0;
         cudnnStatus_t err = finder(calgo, algoPerf);
@@ -349,8 +472,6 @@ private:
         }
         CUDNN_CALL(err);
         assert(calgo > 0);
-        size_t inputSampleSize = m_geometry->InputShape().GetNumElements();
-        size_t maxMem = m_maxTempMemSizeInSamples == 0 ? (std::numeric_limits<size_t>::max)() : inputSampleSize * m_maxTempMemSizeInSamples * sizeof(ElemType);
         // Find best (fastest) algorithm which satisfies workspace requirements.
         auto res = std::find_if(algoPerf, algoPerf + calgo,
             [=](const CuDnnAlgoT& cur)
@@ -374,6 +495,9 @@ private:
         }
         else
             algo.NoWorkspaceAlgo = (*res).algo;
+
+        if (s_isAlgoCacheEnabled)
+            StoreConvolutionAlgo(cacheKey, (int) algo.Algo.algo, (int) algo.NoWorkspaceAlgo);
     }
 
     static ElemType* ptr(Mat& src)
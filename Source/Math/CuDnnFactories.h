@@ -7,6 +7,7 @@
 
 #include "ConvolutionEngine.h"
 #include "BatchNormalizationEngine.h"
+#include "RNNEngine.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -20,6 +21,17 @@ public:
     static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind);
 };
 
+// Persistent cache of the convolution algorithms chosen by the cuDNN autotuner, keyed by GPU model, cuDNN version,
+// precision, convolution geometry and batch size. Autotuning costs seconds per layer; with the cache, a restarted
+// job only looks up the algorithms and queries their workspace sizes.
+class MATH_API CuDnnConvolutionAlgoCache
+{
+public:
+    // file: loaded now and appended to whenever an algorithm is autotuned; the cache is disabled if empty.
+    // bucketBatchSizes: key on the batch size rounded up to a power of 2, so that varying batch sizes share the entries.
+    static void Configure(const std::wstring& file, bool bucketBatchSizes);
+};
+
 template <class ElemType>
 class CuDnnBatchNormEngineFactory
 {
@@ -28,6 +40,13 @@ public:
                                                              bool spatial, ImageLayoutKind imageLayout);
 };
 
+template <class ElemType>
+class CuDnnRNNEngineFactory
+{
+public:
+    static std::unique_ptr<RNNEngine<ElemType>> Create(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, size_t inputSize);
+};
+
 // REVIEW alexeyk: wrong place? It is currently used only in unit tests but I can't add it there because of the build issues.
 // Timer that can be used to measure CUDA calls. 
 // Uses CUDA event and will synchronize(!) the stream when Stop is called.
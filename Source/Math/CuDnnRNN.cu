@@ -0,0 +1,245 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CuDnnFactories.h"
+#include "RNNEngine.h"
+#include "CuDnnCommon.h"
+#include "GPUMatrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#if CUDNN_MAJOR >= 5
+
+template <class ElemType>
+class CuDnnRNNEngine : public RNNEngine<ElemType>
+{
+public:
+    using Base = RNNEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    CuDnnRNNEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, size_t inputSize)
+        : Base(deviceId, attributes, inputSize),
+        m_cudnn(CuDnn::Instance()),
+        m_dataType(CuDnnTensor::GetDataType<ElemType>()),
+        m_rnnDesc(nullptr), m_dropoutDesc(nullptr), m_wDesc(nullptr), m_hDesc(nullptr),
+        m_dropoutStates(deviceId), m_workspace(deviceId), m_reserve(deviceId),
+        m_workspaceBytes(0), m_reserveBytes(0)
+    {
+        // the dropout descriptor is required, but dropout between the layers is not used
+        size_t dropoutStateBytes;
+        CUDNN_CALL(cudnnCreateDropoutDescriptor(&m_dropoutDesc));
+        CUDNN_CALL(cudnnDropoutGetStatesSize(*m_cudnn, &dropoutStateBytes));
+        m_dropoutStates.Resize(NumElementsFor(dropoutStateBytes), 1);
+        CUDNN_CALL(cudnnSetDropoutDescriptor(m_dropoutDesc, *m_cudnn, 0.0f, m_dropoutStates.Data(), dropoutStateBytes, 0));
+
+        CUDNN_CALL(cudnnCreateRNNDescriptor(&m_rnnDesc));
+        cudnnDirectionMode_t direction = attributes.m_bidirectional ? CUDNN_BIDIRECTIONAL : CUDNN_UNIDIRECTIONAL;
+#if CUDNN_MAJOR >= 6
+        CUDNN_CALL(cudnnSetRNNDescriptor_v5(m_rnnDesc, (int)attributes.m_hiddenSize, (int)attributes.m_numLayers, m_dropoutDesc,
+                                            CUDNN_LINEAR_INPUT, direction, GetMode(attributes.m_mode), m_dataType));
+#else
+        CUDNN_CALL(cudnnSetRNNDescriptor(m_rnnDesc, (int)attributes.m_hiddenSize, (int)attributes.m_numLayers, m_dropoutDesc,
+                                         CUDNN_LINEAR_INPUT, direction, GetMode(attributes.m_mode), m_dataType));
+#endif
+
+        // all weights and biases are one column
+        size_t numParameters = attributes.GetNumParameters(inputSize);
+        int wDims[3] = { (int)numParameters, 1, 1 };
+        CUDNN_CALL(cudnnCreateFilterDescriptor(&m_wDesc));
+        CUDNN_CALL(cudnnSetFilterNdDescriptor(m_wDesc, m_dataType, CUDNN_TENSOR_NCHW, 3, wDims));
+
+        // verify that our parameter count matches cuDNN's
+        cudnnTensorDescriptor_t xDesc;
+        CUDNN_CALL(cudnnCreateTensorDescriptor(&xDesc));
+        SetFrameDescriptor(xDesc, 1, inputSize);
+        size_t paramsBytes;
+        cudnnStatus_t status = cudnnGetRNNParamsSize(*m_cudnn, m_rnnDesc, xDesc, &paramsBytes, m_dataType);
+        cudnnDestroyTensorDescriptor(xDesc);
+        CUDNN_CALL(status);
+        if (paramsBytes != numParameters * sizeof(ElemType))
+            LogicError("CuDnnRNNEngine: cuDNN expects %d parameters, but %d were computed.", (int)(paramsBytes / sizeof(ElemType)), (int)numParameters);
+
+        CUDNN_CALL(cudnnCreateTensorDescriptor(&m_hDesc));
+    }
+
+    ~CuDnnRNNEngine()
+    {
+        for (auto desc : m_xDescs)
+            cudnnDestroyTensorDescriptor(desc);
+        for (auto desc : m_yDescs)
+            cudnnDestroyTensorDescriptor(desc);
+        if (m_hDesc != nullptr)
+            cudnnDestroyTensorDescriptor(m_hDesc);
+        if (m_wDesc != nullptr)
+            cudnnDestroyFilterDescriptor(m_wDesc);
+        if (m_rnnDesc != nullptr)
+            cudnnDestroyRNNDescriptor(m_rnnDesc);
+        if (m_dropoutDesc != nullptr)
+            cudnnDestroyDropoutDescriptor(m_dropoutDesc);
+    }
+
+protected:
+    using Base::m_attributes;
+    using Base::m_inputSize;
+
+    void ForwardCore(const Mat& x, const Mat& w, Mat& y, const std::vector<size_t>& numSequencesPerFrame, bool isTraining) override
+    {
+        CuDnn::UseCurrentStream(*m_cudnn);
+        SetSequenceDescriptors(numSequencesPerFrame);
+        int seqLength = (int)numSequencesPerFrame.size();
+        if (isTraining)
+        {
+            CUDNN_CALL(cudnnRNNForwardTraining(*m_cudnn, m_rnnDesc, seqLength, m_xDescs.data(), ptr(x),
+                                               m_hDesc, nullptr, m_hDesc, nullptr, m_wDesc, ptr(w), m_yDescs.data(), ptr(y),
+                                               m_hDesc, nullptr, m_hDesc, nullptr,
+                                               m_workspace.Data(), m_workspaceBytes, m_reserve.Data(), m_reserveBytes));
+        }
+        else
+        {
+            CUDNN_CALL(cudnnRNNForwardInference(*m_cudnn, m_rnnDesc, seqLength, m_xDescs.data(), ptr(x),
+                                                m_hDesc, nullptr, m_hDesc, nullptr, m_wDesc, ptr(w), m_yDescs.data(), ptr(y),
+                                                m_hDesc, nullptr, m_hDesc, nullptr,
+                                                m_workspace.Data(), m_workspaceBytes));
+        }
+    }
+
+    void BackwardDataCore(const Mat& y, const Mat& dy, const Mat& w, Mat& dx, const std::vector<size_t>& numSequencesPerFrame) override
+    {
+        CuDnn::UseCurrentStream(*m_cudnn);
+        if (numSequencesPerFrame != m_numSequencesPerFrame)
+            LogicError("CuDnnRNNEngine: BackwardData() must follow Forward() of the same sequences.");
+        CUDNN_CALL(cudnnRNNBackwardData(*m_cudnn, m_rnnDesc, (int)numSequencesPerFrame.size(), m_yDescs.data(), ptr(y), m_yDescs.data(), ptr(dy),
+                                        m_hDesc, nullptr, m_hDesc, nullptr, m_wDesc, ptr(w), m_hDesc, nullptr, m_hDesc, nullptr,
+                                        m_xDescs.data(), ptr(dx), m_hDesc, nullptr, m_hDesc, nullptr,
+                                        m_workspace.Data(), m_workspaceBytes, m_reserve.Data(), m_reserveBytes));
+    }
+
+    void BackwardWeightsCore(const Mat& x, const Mat& y, Mat& dw, const std::vector<size_t>& numSequencesPerFrame) override
+    {
+        CuDnn::UseCurrentStream(*m_cudnn);
+        if (numSequencesPerFrame != m_numSequencesPerFrame)
+            LogicError("CuDnnRNNEngine: BackwardWeights() must follow Forward() of the same sequences.");
+        // note: cuDNN adds to dw
+        CUDNN_CALL(cudnnRNNBackwardWeights(*m_cudnn, m_rnnDesc, (int)numSequencesPerFrame.size(), m_xDescs.data(), ptr(x),
+                                           m_hDesc, nullptr, m_yDescs.data(), ptr(y),
+                                           m_workspace.Data(), m_workspaceBytes, m_wDesc, ptr(dw), m_reserve.Data(), m_reserveBytes));
+    }
+
+private:
+    static cudnnRNNMode_t GetMode(RNNMode mode)
+    {
+        switch (mode)
+        {
+        case RNNMode::LSTM:    return CUDNN_LSTM;
+        case RNNMode::GRU:     return CUDNN_GRU;
+        case RNNMode::RNNTanh: return CUDNN_RNN_TANH;
+        case RNNMode::RNNReLU: return CUDNN_RNN_RELU;
+        default:               InvalidArgument("CuDnnRNNEngine: Unsupported RNNMode %d.", (int)mode);
+        }
+    }
+
+    static size_t NumElementsFor(size_t bytes)
+    {
+        return (bytes + sizeof(ElemType) - 1) / sizeof(ElemType);
+    }
+
+    // a frame is [numSequences x dim x 1], fully packed
+    void SetFrameDescriptor(cudnnTensorDescriptor_t desc, size_t numSequences, size_t dim)
+    {
+        int dims[3] = { (int)numSequences, (int)dim, 1 };
+        int strides[3] = { (int)dim, 1, 1 };
+        CUDNN_CALL(cudnnSetTensorNdDescriptor(desc, m_dataType, 3, dims, strides));
+    }
+
+    // (re-)create the per-frame descriptors and the work buffers if the sequence lengths changed
+    void SetSequenceDescriptors(const std::vector<size_t>& numSequencesPerFrame)
+    {
+        if (numSequencesPerFrame == m_numSequencesPerFrame)
+            return;
+        if (numSequencesPerFrame.empty())
+            InvalidArgument("CuDnnRNNEngine: There are no sequences.");
+
+        while (m_xDescs.size() < numSequencesPerFrame.size())
+        {
+            cudnnTensorDescriptor_t xDesc, yDesc;
+            CUDNN_CALL(cudnnCreateTensorDescriptor(&xDesc));
+            m_xDescs.push_back(xDesc);
+            CUDNN_CALL(cudnnCreateTensorDescriptor(&yDesc));
+            m_yDescs.push_back(yDesc);
+        }
+        for (size_t t = 0; t < numSequencesPerFrame.size(); t++)
+        {
+            if (t > 0 && numSequencesPerFrame[t] > numSequencesPerFrame[t - 1])
+                LogicError("CuDnnRNNEngine: Sequences must be ordered by decreasing length.");
+            SetFrameDescriptor(m_xDescs[t], numSequencesPerFrame[t], m_inputSize);
+            SetFrameDescriptor(m_yDescs[t], numSequencesPerFrame[t], m_attributes.OutputSize());
+        }
+
+        // the (zero) initial and the final states: [numLayers * numDirections x numSequences x hiddenSize]
+        int hDims[3] = { (int)(m_attributes.m_numLayers * m_attributes.NumDirections()), (int)numSequencesPerFrame[0], (int)m_attributes.m_hiddenSize };
+        int hStrides[3] = { hDims[1] * hDims[2], hDims[2], 1 };
+        CUDNN_CALL(cudnnSetTensorNdDescriptor(m_hDesc, m_dataType, 3, hDims, hStrides));
+
+        int seqLength = (int)numSequencesPerFrame.size();
+        CUDNN_CALL(cudnnGetRNNWorkspaceSize(*m_cudnn, m_rnnDesc, seqLength, m_xDescs.data(), &m_workspaceBytes));
+        CUDNN_CALL(cudnnGetRNNTrainingReserveSize(*m_cudnn, m_rnnDesc, seqLength, m_xDescs.data(), &m_reserveBytes));
+        m_workspace.Resize(NumElementsFor(m_workspaceBytes), 1);
+        m_reserve.Resize(NumElementsFor(m_reserveBytes), 1);
+
+        m_numSequencesPerFrame = numSequencesPerFrame;
+    }
+
+    static ElemType* ptr(Mat& src)
+    {
+        return src.Data();
+    }
+    static const ElemType* ptr(const Mat& src)
+    {
+        return src.Data();
+    }
+
+private:
+    CuDnn::ptr_t m_cudnn;
+    cudnnDataType_t m_dataType;
+    cudnnRNNDescriptor_t m_rnnDesc;
+    cudnnDropoutDescriptor_t m_dropoutDesc;
+    cudnnFilterDescriptor_t m_wDesc;
+    cudnnTensorDescriptor_t m_hDesc;
+    std::vector<cudnnTensorDescriptor_t> m_xDescs; // [t] frames of the input
+    std::vector<cudnnTensorDescriptor_t> m_yDescs; // [t] frames of the output
+
+    Mat m_dropoutStates;
+    Mat m_workspace;
+    Mat m_reserve; // intermediate results of the training forward pass, for the backward pass
+    size_t m_workspaceBytes;
+    size_t m_reserveBytes;
+    std::vector<size_t> m_numSequencesPerFrame; // of the current descriptors
+};
+
+template class CuDnnRNNEngine<float>;
+template class CuDnnRNNEngine<double>;
+
+template <typename ElemType>
+std::unique_ptr<RNNEngine<ElemType>> CuDnnRNNEngineFactory<ElemType>::Create(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, size_t inputSize)
+{
+    return std::make_unique<CuDnnRNNEngine<ElemType>>(deviceId, attributes, inputSize);
+}
+
+#else // cuDNN RNNs were introduced in cuDNN 5
+
+template <typename ElemType>
+std::unique_ptr<RNNEngine<ElemType>> CuDnnRNNEngineFactory<ElemType>::Create(DEVICEID_TYPE, const RNNAttributes&, size_t)
+{
+    RuntimeError("The recurrent stack requires cuDNN 5 or newer; this build uses cuDNN %d.", (int)CUDNN_MAJOR);
+}
+
+#endif
+
+template class CuDnnRNNEngineFactory<float>;
+template class CuDnnRNNEngineFactory<double>;
+
+} } }
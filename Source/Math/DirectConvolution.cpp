@@ -0,0 +1,166 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "DirectConvolution.h"
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+DirectConvolution<ElemType>::DirectConvolution(const ConvolveGeometry& geometry)
+{
+    if (!IsSupported(geometry))
+        LogicError("DirectConvolution: Unsupported geometry %s.", ((std::string) geometry).c_str());
+
+    const auto& g = geometry.Compact();
+    m_inW = g.inDim[0];
+    m_inH = g.inDim[1];
+    m_channels = g.inDim[2];
+    m_kernelW = g.kernelDim[0];
+    m_kernelH = g.kernelDim[1];
+    m_outW = g.outDim[0];
+    m_outH = g.outDim[1];
+    m_maps = g.mapCount[2];
+    m_blockCount = (m_maps + BlockSize - 1) / BlockSize;
+    m_strideW = g.stride[0];
+    m_strideH = g.stride[1];
+    m_offsetW = g.start[0] - (m_kernelW - 1) / 2;
+    m_offsetH = g.start[1] - (m_kernelH - 1) / 2;
+
+    // Input column of output column x and kernel column kx: x * strideW + offsetW + kx, valid in [0, inW).
+    m_outBeginW.resize(m_kernelW);
+    m_outEndW.resize(m_kernelW);
+    for (int kx = 0; kx < m_kernelW; kx++)
+    {
+        int lo = -(m_offsetW + kx);        // x * strideW >= lo
+        int hi = m_inW - 1 - m_offsetW - kx; // x * strideW <= hi
+        m_outBeginW[kx] = lo <= 0 ? 0 : std::min(m_outW, (lo + m_strideW - 1) / m_strideW);
+        m_outEndW[kx] = hi < 0 ? 0 : std::min(m_outW, hi / m_strideW + 1);
+    }
+    m_interiorBeginW = *std::max_element(m_outBeginW.begin(), m_outBeginW.end());
+    m_interiorEndW = std::max(m_interiorBeginW, *std::min_element(m_outEndW.begin(), m_outEndW.end()));
+}
+
+template <class ElemType>
+void DirectConvolution<ElemType>::PackKernel(const ElemType* kernel)
+{
+    size_t kernelSize = (size_t) m_kernelW * m_kernelH * m_channels;
+    m_packedKernel.assign(m_blockCount * kernelSize * BlockSize, (ElemType) 0); // maps beyond K in the last block stay 0
+    for (int map = 0; map < m_maps; map++)
+    {
+        ElemType* dst = m_packedKernel.data() + (map / BlockSize) * kernelSize * BlockSize + map % BlockSize;
+        const ElemType* src = kernel + map * kernelSize;
+        for (size_t i = 0; i < kernelSize; i++) // (kernel cells in the order [C][Y][X] in both)
+            dst[i * BlockSize] = src[i];
+    }
+}
+
+// Computes the output columns [x0, x0 + Width) of row 'outRow' of the maps of 'block' into acc [outW][BlockSize].
+// The sums stay in registers while all weights of the block pass by. Unless 'checkBounds', all input columns must be
+// within the input; the rows are always checked.
+template <class ElemType>
+template <int Width, bool checkBounds>
+void DirectConvolution<ElemType>::ForwardColumns(const ElemType* in, const ElemType* blockWeights, int outRow, int x0, ElemType* acc) const
+{
+    ElemType sum[Width][BlockSize];
+    for (int t = 0; t < Width; t++)
+    {
+        for (int j = 0; j < BlockSize; j++)
+            sum[t][j] = 0;
+    }
+    int inCol0 = x0 * m_strideW + m_offsetW;
+    for (int c = 0; c < m_channels; c++)
+    {
+        for (int ky = 0; ky < m_kernelH; ky++)
+        {
+            int inRow = outRow * m_strideH + m_offsetH + ky;
+            if (inRow < 0 || inRow >= m_inH) // padding
+                continue;
+            const ElemType* src = in + ((size_t) c * m_inH + inRow) * m_inW;
+            const ElemType* weights = blockWeights + ((size_t) c * m_kernelH + ky) * m_kernelW * BlockSize;
+            for (int kx = 0; kx < m_kernelW; kx++, weights += BlockSize)
+            {
+                if (checkBounds && (x0 < m_outBeginW[kx] || x0 >= m_outEndW[kx])) // (Width is 1)
+                    continue;
+                const ElemType* s = src + inCol0 + kx;
+                ElemType values[Width];
+                for (int t = 0; t < Width; t++)
+                    values[t] = s[t * m_strideW];
+                for (int j = 0; j < BlockSize; j++)
+                {
+                    ElemType weight = weights[j];
+                    for (int t = 0; t < Width; t++)
+                        sum[t][j] += values[t] * weight;
+                }
+            }
+        }
+    }
+    for (int t = 0; t < Width; t++)
+    {
+        for (int j = 0; j < BlockSize; j++)
+            acc[(size_t) (x0 + t) * BlockSize + j] = sum[t][j];
+    }
+}
+
+// Computes the output row 'outRow' of the maps of 'block' into acc [outW][BlockSize]: the columns whose inputs are
+// all within the input in tiles of TileWidth, the others one by one.
+template <class ElemType>
+void DirectConvolution<ElemType>::ForwardRow(const ElemType* in, int block, int outRow, ElemType* acc) const
+{
+    const ElemType* blockWeights = m_packedKernel.data() + (size_t) block * m_channels * m_kernelH * m_kernelW * BlockSize;
+    int x = 0;
+    for (; x < m_interiorBeginW; x++)
+        ForwardColumns<1, true>(in, blockWeights, outRow, x, acc);
+    for (; x + TileWidth <= m_interiorEndW; x += TileWidth)
+        ForwardColumns<TileWidth, false>(in, blockWeights, outRow, x, acc);
+    for (; x < m_interiorEndW; x++)
+        ForwardColumns<1, false>(in, blockWeights, outRow, x, acc);
+    for (; x < m_outW; x++)
+        ForwardColumns<1, true>(in, blockWeights, outRow, x, acc);
+}
+
+template <class ElemType>
+void DirectConvolution<ElemType>::Forward(const Matrix<ElemType>& in, const Matrix<ElemType>& kernel, Matrix<ElemType>& out)
+{
+    if (in.GetDeviceId() >= 0 || kernel.GetDeviceId() >= 0 || out.GetDeviceId() >= 0)
+        LogicError("DirectConvolution: Only CPU matrices are supported.");
+    size_t inSize = (size_t) m_inW * m_inH * m_channels;
+    size_t outSize = (size_t) m_outW * m_outH * m_maps;
+    if (in.GetNumRows() != inSize || out.GetNumRows() != outSize || out.GetNumCols() != in.GetNumCols() ||
+        kernel.GetNumElements() != (size_t) m_maps * m_kernelW * m_kernelH * m_channels)
+        LogicError("DirectConvolution: The dimensions of the operands do not match the geometry.");
+
+    PackKernel(kernel.Data());
+
+    const ElemType* inData = in.Data();
+    ElemType* outData = out.Data();
+    // work items in the order (sample, block, row), so that the threads share the weights of a block
+    int64_t itemCount = (int64_t) in.GetNumCols() * m_blockCount * m_outH;
+#pragma omp parallel
+    {
+        std::vector<ElemType> acc((size_t) m_outW * BlockSize);
+#pragma omp for
+        for (int64_t item = 0; item < itemCount; item++)
+        {
+            int outRow = (int) (item % m_outH);
+            int block = (int) (item / m_outH % m_blockCount);
+            int64_t sample = item / m_outH / m_blockCount;
+            ForwardRow(inData + sample * inSize, block, outRow, acc.data());
+
+            int maps = std::min((int) BlockSize, m_maps - block * BlockSize);
+            ElemType* dst = outData + sample * outSize + ((size_t) block * BlockSize * m_outH + outRow) * m_outW;
+            for (int j = 0; j < maps; j++, dst += (size_t) m_outH * m_outW)
+            {
+                for (int x = 0; x < m_outW; x++)
+                    dst[x] = acc[(size_t) x * BlockSize + j];
+            }
+        }
+    }
+}
+
+template class DirectConvolution<float>;
+template class DirectConvolution<double>;
+
+}}}
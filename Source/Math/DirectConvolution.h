@@ -0,0 +1,70 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// DirectConvolution.h -- 2D convolution on the CPU without unrolling the input, for the Direct convolution engine
+//
+// The GEMM engine unrolls each input into a [XYC x W'H'] matrix, X*Y times its size, before one product per sub-batch,
+// and for small minibatches most cores wait while the input is unrolled. Here the output is computed in place:
+//  - the kernel is repacked, blocked by maps, to [K/BlockSize][C][Y][X][BlockSize], so that an input value is multiplied
+//    with the weights of BlockSize maps in an inner loop that the compiler vectorizes;
+//  - the sums of a tile of TileWidth output columns by BlockSize maps stay in registers, so that each weight serves
+//    TileWidth inputs and each input BlockSize weights;
+//  - the work items (sample, block of maps, output row) are distributed over the OpenMP threads, which keeps them busy
+//    for a single sample, too.
+// The input and the output stay in CHW layout (the layout of the network), the kernel is repacked on each Forward().
+// Supported are inputs [W x H x C] with kernels [X x Y x C] over all channels, K maps, any strides and padding.
+
+#pragma once
+
+#include "Matrix.h"
+#include "ConvolveGeometry.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class DirectConvolution
+{
+public:
+    static const int BlockSize = 16; // maps per block; two 256-bit vectors of floats
+    static const int TileWidth = 6;  // output columns computed together, see ForwardColumns()
+
+    static bool IsSupported(const ConvolveGeometry& geometry)
+    {
+        const auto& g = geometry.Compact();
+        if (g.rank != 3)
+            return false;
+        for (int i = 0; i < g.rank; i++)
+        {
+            if (!g.sharing[i])
+                return false;
+        }
+        // the kernel covers all channels, exactly once, and the maps are the channels of the output
+        return g.mapCount[0] == 1 && g.mapCount[1] == 1 &&
+               g.kernelDim[2] == g.inDim[2] && g.outDim[2] == 1 && g.start[2] == (g.kernelDim[2] - 1) / 2;
+    }
+
+    explicit DirectConvolution(const ConvolveGeometry& geometry);
+
+    // out = convolution of 'in' [WHC x N] with 'kernel' [K x XYC], row-major (the cudnn layout); out [W'H'K x N] is overwritten
+    void Forward(const Matrix<ElemType>& in, const Matrix<ElemType>& kernel, Matrix<ElemType>& out);
+
+private:
+    void PackKernel(const ElemType* kernel);
+    void ForwardRow(const ElemType* in, int block, int outRow, ElemType* acc) const;
+    template <int Width, bool checkBounds>
+    void ForwardColumns(const ElemType* in, const ElemType* blockWeights, int outRow, int x0, ElemType* acc) const;
+
+    int m_inW, m_inH, m_channels;
+    int m_kernelW, m_kernelH;
+    int m_outW, m_outH, m_maps, m_blockCount;
+    int m_strideW, m_strideH;
+    int m_offsetW, m_offsetH;  // input coordinates of the first kernel cell of output cell (0, 0); negative with padding
+    std::vector<int> m_outBeginW; // [kernel column] first output column whose input for this kernel column is not padding
+    std::vector<int> m_outEndW;   // [kernel column] end of these output columns
+    int m_interiorBeginW, m_interiorEndW; // the output columns whose inputs are all within the input
+    std::vector<ElemType> m_packedKernel;
+};
+
+}}}
@@ -0,0 +1,136 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Float16.h -- conversion of float buffers to and from the 16-bit formats fp16 and bf16 on the host
+//
+// Values are stored as uint16_t bit patterns. Conversions to 16 bits round to nearest, ties to even; fp16 conversions
+// produce subnormals, and values beyond the fp16 range become infinite.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class Float16Format
+{
+    none,     // not converted
+    float16,  // IEEE half precision: 5 exponent bits, 10 mantissa bits, |x| <= 65504
+    bfloat16, // 8 exponent bits (the range of float), 7 mantissa bits
+};
+
+inline uint32_t FloatBits(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    return x;
+}
+
+inline float FloatFromBits(uint32_t x)
+{
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+inline uint16_t FloatToFloat16(float f)
+{
+    uint32_t x = FloatBits(f);
+    uint16_t sign = (uint16_t) ((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+    if (x >= 0x7f800000) // Inf or NaN (kept quiet)
+        return sign | 0x7c00 | ((x > 0x7f800000) ? 0x200 : 0);
+    if (x >= 0x477ff000) // 65520 and above round to Inf
+        return sign | 0x7c00;
+    if (x < 0x38800000) // below 2^-14: subnormal; adding 0.5 rounds to a multiple of 2^-24 in the low mantissa bits
+        return sign | (uint16_t) (FloatBits(FloatFromBits(x) + 0.5f) - 0x3f000000);
+    uint32_t isOdd = (x >> 13) & 1;
+    x -= (127 - 15) << 23;
+    x += 0xfff + isOdd; // a carry into the exponent rounds up to the next power of 2
+    return sign | (uint16_t) (x >> 13);
+}
+
+inline float Float16ToFloat(uint16_t h)
+{
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    if (exponent == 0x1f)
+        return FloatFromBits(sign | 0x7f800000 | (mantissa << 13));
+    if (exponent == 0) // subnormal or zero
+        return FloatFromBits(sign | FloatBits(mantissa * (1.0f / (1 << 24))));
+    return FloatFromBits(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+
+inline uint16_t FloatToBFloat16(float f)
+{
+    uint32_t x = FloatBits(f);
+    if ((x & 0x7fffffff) > 0x7f800000) // NaN (kept quiet; rounding could turn it into Inf)
+        return (uint16_t) ((x >> 16) | 0x40);
+    x += 0x7fff + ((x >> 16) & 1);
+    return (uint16_t) (x >> 16);
+}
+
+inline float BFloat16ToFloat(uint16_t h)
+{
+    return FloatFromBits((uint32_t) h << 16);
+}
+
+inline uint16_t ToFloat16(Float16Format format, float f)
+{
+    return (format == Float16Format::bfloat16) ? FloatToBFloat16(f) : FloatToFloat16(f);
+}
+
+inline float FromFloat16(Float16Format format, uint16_t h)
+{
+    return (format == Float16Format::bfloat16) ? BFloat16ToFloat(h) : Float16ToFloat(h);
+}
+
+// false for Inf and NaN
+inline bool IsFloat16Finite(Float16Format format, uint16_t h)
+{
+    uint16_t exponentMask = (format == Float16Format::bfloat16) ? 0x7f80 : 0x7c00;
+    return (h & exponentMask) != exponentMask;
+}
+
+// out[i] = data[i] * scale, in 16 bits
+template <class ElemType>
+void EncodeFloat16(Float16Format format, const ElemType* data, size_t n, float scale, uint16_t* out)
+{
+    long numElements = (long) n;
+#pragma omp parallel for
+    for (long i = 0; i < numElements; i++)
+        out[i] = ToFloat16(format, (float) data[i] * scale);
+}
+
+// data[i] = in[i] / scale
+template <class ElemType>
+void DecodeFloat16(Float16Format format, const uint16_t* in, size_t n, float scale, ElemType* data)
+{
+    long numElements = (long) n;
+    float invScale = 1.0f / scale;
+#pragma omp parallel for
+    for (long i = 0; i < numElements; i++)
+        data[i] = (ElemType) (FromFloat16(format, in[i]) * invScale);
+}
+
+// inout[i] += in[i], computed in float and rounded to 16 bits
+inline void AddFloat16(Float16Format format, const uint16_t* in, uint16_t* inout, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        inout[i] = ToFloat16(format, FromFloat16(format, in[i]) + FromFloat16(format, inout[i]));
+}
+
+inline bool AllFloat16Finite(Float16Format format, const uint16_t* data, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!IsFloat16Finite(format, data[i]))
+            return false;
+    }
+    return true;
+}
+
+}}}
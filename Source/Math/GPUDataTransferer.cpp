@@ -120,6 +120,18 @@ void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUAsync()
     SyncEvent(m_fetchCompleteEvent);
 }
 
+template <class ElemType>
+bool GPUDataTransferer<ElemType>::IsCopyGPUToCPUAsyncComplete() const
+{
+    PrepareDevice(m_deviceId);
+
+    auto rc = cudaEventQuery(m_fetchCompleteEvent);
+    if (rc == cudaErrorNotReady)
+        return false;
+    rc || "cudaEventQuery failed";
+    return true;
+}
+
 template <class ElemType>
 void GPUDataTransferer<ElemType>::CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer)
 {
@@ -33,6 +33,7 @@ public:
 
     void CopyGPUToCPUAsync(ElemType* gpuBuffer, size_t numElements, ElemType* cpuBuffer);
     void WaitForCopyGPUToCPUAsync();
+    bool IsCopyGPUToCPUAsyncComplete() const; // non-blocking test whether the last CopyGPUToCPUAsync() has finished
 
     void CopyCPUToGPUAsync(ElemType* cpuBuffer, size_t numElements, ElemType* gpuBuffer);
     void WaitForCopyCPUToGPUAsync();
@@ -22,8 +22,13 @@
 #include <curand.h>
 #include <curand_kernel.h>
 #include "cublas_v2.h"
+#include <cuda_fp16.h>
 #include <assert.h>
+#include <climits>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include "CntkBatchNormalization.cuh"
 #include "Convolution.cuh"
 
@@ -123,6 +128,253 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     s_isSyncEnabled = true;
 }
 
+/*static*/ bool Float16Gemm::s_isEnabled = false;
+
+/*static*/ void Float16Gemm::Enable(bool enable)
+{
+    s_isEnabled = enable;
+}
+
+/*static*/ bool Float16Gemm::IsEnabled()
+{
+    return s_isEnabled;
+}
+
+static std::mutex s_timingEventPoolMutex;
+static std::vector<std::pair<DEVICEID_TYPE, cudaEvent_t>> s_timingEventPool;
+
+struct GPUTimingEventImpl
+{
+    DEVICEID_TYPE deviceId;
+    cudaEvent_t event;
+};
+
+/*static*/ void* GPUTimingEvent::Record()
+{
+    int deviceId;
+    CUDA_CALL(cudaGetDevice(&deviceId));
+    GPUTimingEventImpl* timingEvent = new GPUTimingEventImpl();
+    timingEvent->deviceId = deviceId;
+    timingEvent->event = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_timingEventPoolMutex);
+        for (size_t i = 0; i < s_timingEventPool.size(); i++)
+        {
+            if (s_timingEventPool[i].first == deviceId)
+            {
+                timingEvent->event = s_timingEventPool[i].second;
+                s_timingEventPool[i] = s_timingEventPool.back();
+                s_timingEventPool.pop_back();
+                break;
+            }
+        }
+    }
+    if (!timingEvent->event)
+        CUDA_CALL(cudaEventCreate(&timingEvent->event));
+    CUDA_CALL(cudaEventRecord(timingEvent->event, t_stream));
+    return timingEvent;
+}
+
+/*static*/ float GPUTimingEvent::ElapsedMilliseconds(void* start, void* stop)
+{
+    GPUTimingEventImpl* startEvent = (GPUTimingEventImpl*) start;
+    GPUTimingEventImpl* stopEvent = (GPUTimingEventImpl*) stop;
+    if (startEvent->deviceId != stopEvent->deviceId)
+        return -1;
+    float ms = 0;
+    CUDA_CALL(cudaEventSynchronize(stopEvent->event));
+    CUDA_CALL(cudaEventElapsedTime(&ms, startEvent->event, stopEvent->event));
+    return ms;
+}
+
+/*static*/ void GPUTimingEvent::Release(void* event)
+{
+    GPUTimingEventImpl* timingEvent = (GPUTimingEventImpl*) event;
+    {
+        std::lock_guard<std::mutex> lock(s_timingEventPoolMutex);
+        s_timingEventPool.push_back(std::make_pair(timingEvent->deviceId, timingEvent->event));
+    }
+    delete timingEvent;
+}
+
+/*static*/ size_t GPUStreams::s_numStreams = 1;
+static std::mutex s_streamsMutex;
+static std::vector<cudaStream_t> s_streams[MAX_GPUS]; // [deviceId][index]
+
+/*static*/ void GPUStreams::SetNumStreams(size_t numStreams)
+{
+    s_numStreams = std::max(numStreams, (size_t) 1);
+}
+
+/*static*/ size_t GPUStreams::GetNumStreams()
+{
+    return s_numStreams;
+}
+
+/*static*/ void* GPUStreams::Select(DEVICEID_TYPE deviceId, size_t index)
+{
+    assert(deviceId >= 0 && deviceId < MAX_GPUS && index < s_numStreams);
+    std::vector<cudaStream_t>& streams = s_streams[deviceId];
+    {
+        std::lock_guard<std::mutex> lock(s_streamsMutex);
+        if (streams.size() < s_numStreams)
+        {
+            PrepareDevice(deviceId);
+            while (streams.size() < s_numStreams)
+            {
+                cudaStream_t stream;
+                CUDA_CALL(cudaStreamCreate(&stream));
+                streams.push_back(stream);
+            }
+        }
+    }
+    void* previous = t_stream;
+    t_stream = streams[index];
+    return previous;
+}
+
+/*static*/ void GPUStreams::Restore(void* stream)
+{
+    t_stream = (cudaStream_t) stream;
+}
+
+/*static*/ void* GPUStreams::NewEvent(DEVICEID_TYPE deviceId)
+{
+    PrepareDevice(deviceId);
+    cudaEvent_t event;
+    CUDA_CALL(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+    return event;
+}
+
+/*static*/ void GPUStreams::DeleteEvent(void* event)
+{
+    cudaEventDestroy((cudaEvent_t) event); // no error check: may be called during shutdown
+}
+
+/*static*/ void GPUStreams::Record(void* event)
+{
+    CUDA_CALL(cudaEventRecord((cudaEvent_t) event, t_stream));
+}
+
+/*static*/ void GPUStreams::Wait(void* event)
+{
+    CUDA_CALL(cudaStreamWaitEvent(t_stream, (cudaEvent_t) event, 0));
+}
+
+/*static*/ bool GPUGraph::s_isEnabled = false;
+
+/*static*/ void GPUGraph::Enable(bool enable)
+{
+    s_isEnabled = enable;
+}
+
+/*static*/ bool GPUGraph::IsEnabled()
+{
+    return s_isEnabled;
+}
+
+/*static*/ bool GPUGraph::IsSupported()
+{
+#if CUDA_VERSION >= 10000
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if CUDA_VERSION >= 10000
+struct GPUGraphImpl
+{
+    DEVICEID_TYPE deviceId;
+    cudaGraphExec_t exec;
+};
+
+static std::mutex s_captureStreamsMutex;
+static cudaStream_t s_captureStreams[MAX_GPUS];
+#ifdef _WIN32
+__declspec(thread)
+#endif
+    static cudaStream_t t_streamBeforeCapture;
+#ifdef _WIN32
+__declspec(thread)
+#endif
+    static DEVICEID_TYPE t_captureDeviceId;
+
+static cudaStream_t CaptureStream(DEVICEID_TYPE deviceId)
+{
+    std::lock_guard<std::mutex> lock(s_captureStreamsMutex);
+    if (!s_captureStreams[deviceId])
+    {
+        PrepareDevice(deviceId);
+        CUDA_CALL(cudaStreamCreate(&s_captureStreams[deviceId]));
+    }
+    return s_captureStreams[deviceId];
+}
+#endif
+
+/*static*/ void GPUGraph::BeginCapture(DEVICEID_TYPE deviceId)
+{
+#if CUDA_VERSION >= 10000
+    cudaStream_t stream = CaptureStream(deviceId);
+#if CUDA_VERSION >= 10010
+    CUDA_CALL(cudaStreamBeginCapture(stream, cudaStreamCaptureModeGlobal)); // unsafe calls such as cudaMalloc() fail instead of breaking the capture silently
+#else
+    CUDA_CALL(cudaStreamBeginCapture(stream));
+#endif
+    t_streamBeforeCapture = t_stream;
+    t_captureDeviceId = deviceId;
+    t_stream = stream;
+#else
+    UNUSED(deviceId);
+    LogicError("GPUGraph: CUDA graphs require CUDA 10 or later.");
+#endif
+}
+
+/*static*/ void* GPUGraph::EndCapture()
+{
+#if CUDA_VERSION >= 10000
+    cudaStream_t stream = t_stream;
+    t_stream = t_streamBeforeCapture;
+    cudaGraph_t graph = nullptr;
+    cudaError_t rc = cudaStreamEndCapture(stream, &graph);
+    cudaGraphExec_t exec = nullptr;
+    if (rc == cudaSuccess && graph)
+        rc = cudaGraphInstantiate(&exec, graph, nullptr, nullptr, 0);
+    if (graph)
+        cudaGraphDestroy(graph);
+    if (rc != cudaSuccess || !exec)
+    {
+        cudaGetLastError(); // clear the error state of the failed capture
+        return nullptr;
+    }
+    return new GPUGraphImpl{ t_captureDeviceId, exec };
+#else
+    return nullptr;
+#endif
+}
+
+/*static*/ void GPUGraph::Launch(void* graph)
+{
+#if CUDA_VERSION >= 10000
+    GPUGraphImpl* impl = (GPUGraphImpl*) graph;
+    CUDA_CALL(cudaGraphLaunch(impl->exec, CaptureStream(impl->deviceId)));
+#else
+    UNUSED(graph);
+    LogicError("GPUGraph: CUDA graphs require CUDA 10 or later.");
+#endif
+}
+
+/*static*/ void GPUGraph::Destroy(void* graph)
+{
+#if CUDA_VERSION >= 10000
+    GPUGraphImpl* impl = (GPUGraphImpl*) graph;
+    cudaGraphExecDestroy(impl->exec); // no error check: may be called during shutdown
+    delete impl;
+#else
+    UNUSED(graph);
+#endif
+}
+
 SyncGuard::SyncGuard(bool forceSync /*= false*/)
     : m_forceSync(forceSync)
 {
@@ -197,11 +449,7 @@ AllocatedElemType* TracingGPUMemoryAllocator::Allocate(int deviceId, size_t numE
 template <typename AllocatedElemType>
 void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr, bool ignoreCUDARetCode /*= false*/)
 {
-    PrepareDevice(deviceId);
-    if (ignoreCUDARetCode)
-        cudaFree((void*) bufferPtr);
-    else
-        CUDA_CALL(cudaFree((void*) bufferPtr));
+    FreeBytes(deviceId, (void*) bufferPtr, ignoreCUDARetCode);
 
     if (IsTraceEnabled())
     {
@@ -214,14 +462,230 @@ void TracingGPUMemoryAllocator::Free(int deviceId, AllocatedElemType* bufferPtr,
 template <typename AllocatedElemType>
 AllocatedElemType* TracingGPUMemoryAllocator::AllocateNoTrace(int deviceId, size_t numElements)
 {
-    AllocatedElemType* deviceBufferPtr;
+    return (AllocatedElemType*) AllocateBytes(deviceId, sizeof(AllocatedElemType) * numElements);
+}
 
-    PrepareDevice(deviceId);
-    CUDA_CALL(cudaMalloc((void**) &deviceBufferPtr, sizeof(AllocatedElemType) * numElements));
+// -----------------------------------------------------------------------
+// GPUMemoryCache -- the caching strategy behind TracingGPUMemoryAllocator.
+// Freed buffers are not returned to the driver but parked in a free list
+// keyed by (device, stream, size class). A buffer is only ever reused on the
+// stream it was allocated on, so no cross-stream synchronization is needed.
+// -----------------------------------------------------------------------
+
+class GPUMemoryCache
+{
+    struct Block
+    {
+        size_t numBytes;     // size class, i.e. the actual size of the cudaMalloc()ed buffer
+        cudaStream_t stream; // stream the buffer was handed out on
+    };
+
+    // free buffers of one stream, bucketed by size class
+    typedef std::map<size_t, std::vector<void*>> FreeList;
+
+    struct DeviceCache
+    {
+        std::map<cudaStream_t, FreeList> freeLists;
+        std::unordered_map<void*, Block> blocks; // all buffers owned by the cache, in use or not
+        GPUMemoryAllocatorStatistics stats;
+    };
+
+    static const size_t minBlockSize = 512;          // all sizes are rounded up to a multiple of this
+    static const size_t smallBlockLimit = 1 << 20;   // above this, size classes grow geometrically
+    static const size_t maxSlackFactor = 2;          // never hand out a cached block more than this much larger than requested
+
+public:
+    static GPUMemoryCache& Instance()
+    {
+        static GPUMemoryCache* s_instance = new GPUMemoryCache(); // intentionally leaked: must survive static destruction at process exit
+        return *s_instance;
+    }
+
+    // round up to the size class: multiples of 512 bytes up to 1 MB, then 8 classes per power of two (<= 12.5% waste)
+    static size_t SizeClass(size_t numBytes)
+    {
+        if (numBytes <= smallBlockLimit)
+            return std::max(minBlockSize, (numBytes + minBlockSize - 1) / minBlockSize * minBlockSize);
+        size_t granularity = smallBlockLimit >> 3;
+        while ((granularity << 4) <= numBytes)
+            granularity <<= 1;
+        return (numBytes + granularity - 1) / granularity * granularity;
+    }
 
+    void* Allocate(int deviceId, size_t numBytes)
+    {
+        size_t blockSize = SizeClass(numBytes);
+        cudaStream_t stream = GetStream();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& cache = m_devices[deviceId];
+        cache.stats.numAllocations++;
+
+        void* bufferPtr = TakeFromFreeList(cache, stream, blockSize);
+        if (bufferPtr)
+            cache.stats.numCacheHits++;
+        else
+        {
+            PrepareDevice(deviceId);
+            cudaError_t rc = cudaMalloc(&bufferPtr, blockSize);
+            if (rc == cudaErrorMemoryAllocation) // out of memory: give back everything we are holding on to and retry once
+            {
+                cudaGetLastError(); // clear the sticky error
+                ReleaseFreeBuffers(deviceId, cache, /*ignoreCUDARetCode=*/false);
+                rc = cudaMalloc(&bufferPtr, blockSize);
+            }
+            CUDA_CALL(rc);
+            cache.stats.numDeviceAllocations++;
+            cache.stats.bytesReserved += blockSize;
+            cache.stats.peakBytesReserved = std::max(cache.stats.peakBytesReserved, cache.stats.bytesReserved);
+        }
+
+        cache.blocks[bufferPtr] = Block{ blockSize, stream };
+        cache.stats.bytesInUse += blockSize;
+        cache.stats.peakBytesInUse = std::max(cache.stats.peakBytesInUse, cache.stats.bytesInUse);
+        return bufferPtr;
+    }
+
+    // returns false if the buffer is not owned by the cache (e.g. allocated before caching was enabled)
+    bool Free(int deviceId, void* bufferPtr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto deviceIter = m_devices.find(deviceId);
+        if (deviceIter == m_devices.end())
+            return false;
+        auto& cache = deviceIter->second;
+        auto blockIter = cache.blocks.find(bufferPtr);
+        if (blockIter == cache.blocks.end())
+            return false;
+
+        const Block& block = blockIter->second;
+        cache.freeLists[block.stream][block.numBytes].push_back(bufferPtr);
+        cache.stats.bytesInUse -= block.numBytes;
+        return true;
+    }
+
+    void ReleaseCachedMemory(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto deviceIter = m_devices.find(deviceId);
+        if (deviceIter != m_devices.end())
+            ReleaseFreeBuffers(deviceId, deviceIter->second, /*ignoreCUDARetCode=*/false);
+    }
+
+    GPUMemoryAllocatorStatistics GetStatistics(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto deviceIter = m_devices.find(deviceId);
+        return deviceIter != m_devices.end() ? deviceIter->second.stats : GPUMemoryAllocatorStatistics();
+    }
+
+    void ResetPeakStatistics(int deviceId)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto deviceIter = m_devices.find(deviceId);
+        if (deviceIter == m_devices.end())
+            return;
+        auto& stats = deviceIter->second.stats;
+        stats.peakBytesInUse = stats.bytesInUse;
+        stats.peakBytesReserved = stats.bytesReserved;
+    }
+
+private:
+    void* TakeFromFreeList(DeviceCache& cache, cudaStream_t stream, size_t blockSize)
+    {
+        auto streamIter = cache.freeLists.find(stream);
+        if (streamIter == cache.freeLists.end())
+            return nullptr;
+        // best fit: smallest size class that is large enough, but not wastefully large
+        auto& freeList = streamIter->second;
+        auto bucketIter = freeList.lower_bound(blockSize);
+        if (bucketIter == freeList.end() || bucketIter->first > maxSlackFactor * blockSize)
+            return nullptr;
+        void* bufferPtr = bucketIter->second.back();
+        bucketIter->second.pop_back();
+        if (bucketIter->second.empty())
+            freeList.erase(bucketIter);
+        return bufferPtr;
+    }
+
+    void ReleaseFreeBuffers(int deviceId, DeviceCache& cache, bool ignoreCUDARetCode)
+    {
+        PrepareDevice(deviceId);
+        for (auto& streamFreeList : cache.freeLists)
+        {
+            for (auto& bucket : streamFreeList.second)
+            {
+                for (void* bufferPtr : bucket.second)
+                {
+                    if (ignoreCUDARetCode)
+                        cudaFree(bufferPtr);
+                    else
+                        CUDA_CALL(cudaFree(bufferPtr));
+                    cache.blocks.erase(bufferPtr);
+                    cache.stats.bytesReserved -= bucket.first;
+                    cache.stats.numDeviceFrees++;
+                }
+            }
+        }
+        cache.freeLists.clear();
+    }
+
+    std::mutex m_mutex;
+    std::map<int, DeviceCache> m_devices;
+};
+
+void* TracingGPUMemoryAllocator::AllocateBytes(int deviceId, size_t numBytes)
+{
+    if (IsCachingEnabled())
+        return GPUMemoryCache::Instance().Allocate(deviceId, numBytes);
+
+    void* deviceBufferPtr;
+    PrepareDevice(deviceId);
+    CUDA_CALL(cudaMalloc(&deviceBufferPtr, numBytes));
     return deviceBufferPtr;
 }
 
+void TracingGPUMemoryAllocator::FreeBytes(int deviceId, void* bufferPtr, bool ignoreCUDARetCode)
+{
+    // Note: the cache is consulted even if caching has been switched off since, as the buffer may have been allocated from it
+    if (!bufferPtr || GPUMemoryCache::Instance().Free(deviceId, bufferPtr))
+        return;
+
+    PrepareDevice(deviceId);
+    if (ignoreCUDARetCode)
+        cudaFree(bufferPtr);
+    else
+        CUDA_CALL(cudaFree(bufferPtr));
+}
+
+void TracingGPUMemoryAllocator::ReleaseCachedMemory(int deviceId)
+{
+    GPUMemoryCache::Instance().ReleaseCachedMemory(deviceId);
+}
+
+GPUMemoryAllocatorStatistics TracingGPUMemoryAllocator::GetStatistics(int deviceId)
+{
+    return GPUMemoryCache::Instance().GetStatistics(deviceId);
+}
+
+void TracingGPUMemoryAllocator::ResetPeakStatistics(int deviceId)
+{
+    GPUMemoryCache::Instance().ResetPeakStatistics(deviceId);
+}
+
+void TracingGPUMemoryAllocator::PrintStatistics(int deviceId)
+{
+    if (!IsCachingEnabled())
+        return;
+    auto stats = GetStatistics(deviceId);
+    size_t numBytesPerMB = 1 << 20;
+    fprintf(stderr, "GPU memory allocator statistics for DeviceId = %d: in use = %d MB (peak %d MB), reserved = %d MB (peak %d MB), %d allocations, %.1f%% served from cache, %d cudaMalloc() and %d cudaFree() calls\n",
+            deviceId, (int) (stats.bytesInUse / numBytesPerMB), (int) (stats.peakBytesInUse / numBytesPerMB),
+            (int) (stats.bytesReserved / numBytesPerMB), (int) (stats.peakBytesReserved / numBytesPerMB),
+            (int) stats.numAllocations, stats.numAllocations ? 100.0 * stats.numCacheHits / stats.numAllocations : 0.0,
+            (int) stats.numDeviceAllocations, (int) stats.numDeviceFrees);
+}
+
 std::pair<size_t, size_t> TracingGPUMemoryAllocator::GetFreeAndTotalMemoryInMBs(int deviceId)
 {
     PrepareDevice(deviceId);
@@ -1158,6 +1622,30 @@ void GPUMatrix<ElemType>::SetValue(const GPUMatrix<ElemType>& deepCopyFrom)
     SetValue(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols(), deepCopyFrom.GetComputeDeviceId(), deepCopyFrom.Data(), matrixFlagSetValueOnDevice);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::SetValueFromOtherDevice(const GPUMatrix<ElemType>& deepCopyFrom)
+{
+    if (deepCopyFrom.GetComputeDeviceId() == GetComputeDeviceId())
+        return SetValue(deepCopyFrom);
+
+    RequireSize(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols());
+    if (IsEmpty())
+        return;
+
+    // direct copy if the devices can access each other, otherwise cudaMemcpyPeer() stages through the host
+    PrepareDevice();
+    int canAccessPeer = false;
+    CUDA_CALL(cudaDeviceCanAccessPeer(&canAccessPeer, GetComputeDeviceId(), deepCopyFrom.GetComputeDeviceId()));
+    if (canAccessPeer)
+    {
+        cudaError_t cudaStatus = cudaDeviceEnablePeerAccess(deepCopyFrom.GetComputeDeviceId(), 0);
+        if (cudaStatus != cudaErrorPeerAccessAlreadyEnabled)
+            CUDA_CALL(cudaStatus);
+    }
+    // note: this is ordered with respect to the pending work on both devices, but does not block the host
+    CUDA_CALL(cudaMemcpyPeer(Data(), GetComputeDeviceId(), deepCopyFrom.Data(), deepCopyFrom.GetComputeDeviceId(), sizeof(ElemType) * GetNumElements()));
+}
+
 #if 0
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const CPUMatrix<ElemType>& /*deepCopyFrom*/)
@@ -1332,6 +1820,21 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
     _setMaskAndScale<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), N, maskRate, scaleValue);
 }
 
+// [this] = beta * [this] + mask .* a; the mask is generated inside the kernel from (seed, firstCounter + element index),
+// so it neither needs a curand pass nor memory of its own
+template <class ElemType>
+void GPUMatrix<ElemType>::DoRandomlyMaskedCopyOf(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter)
+{
+    if (a.GetNumRows() != GetNumRows() || a.GetNumCols() != GetNumCols())
+        InvalidArgument("DoRandomlyMaskedCopyOf: The input matrix dimensions do not match [this].");
+
+    CUDA_LONG N = (CUDA_LONG) GetNumElements();
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    a.PrepareDevice();
+    SyncGuard syncGuard;
+    _randomlyMaskedCopyOf<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), a.Data(), N, beta, maskRate, scaleValue, seed, firstCounter);
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
@@ -1374,6 +1877,83 @@ ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool
     }
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedNormalGrad(GPUMatrix<ElemType>& gradients,
+                                          GPUMatrix<ElemType>& functionValues,
+                                          ElemType learnRatePerSample,
+                                          ElemType momentum,
+                                          bool useNAG,
+                                          ElemType clipThreshold,
+                                          ElemType l2RegWeight)
+{
+    if (IsEmpty() || gradients.GetNumCols() != GetNumCols() || gradients.GetNumRows() != GetNumRows())
+    {
+        RequireSize(gradients.GetNumRows(), gradients.GetNumCols());
+        SetValue(0.0);
+    }
+
+    assert(GetNumRows() == gradients.GetNumRows() && GetNumCols() == gradients.GetNumCols());
+    assert(functionValues.GetNumElements() == gradients.GetNumElements());
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _fusedNormalGrad<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(n, gradients.Data(), Data(), functionValues.Data(),
+                                                                               learnRatePerSample, momentum, useNAG, clipThreshold, l2RegWeight);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedAdagrad(GPUMatrix<ElemType>& gradients,
+                                       GPUMatrix<ElemType>& functionValues,
+                                       ElemType learnRatePerSample,
+                                       ElemType clipThreshold,
+                                       ElemType l2RegWeight)
+{
+    if (IsEmpty() || gradients.GetNumCols() != GetNumCols() || gradients.GetNumRows() != GetNumRows())
+    {
+        RequireSize(gradients.GetNumRows(), gradients.GetNumCols());
+        SetValue(0.0);
+    }
+
+    assert(GetNumRows() == gradients.GetNumRows() && GetNumCols() == gradients.GetNumCols());
+    assert(functionValues.GetNumElements() == gradients.GetNumElements());
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _fusedAdagrad<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(n, gradients.Data(), Data(), functionValues.Data(),
+                                                                            learnRatePerSample, clipThreshold, l2RegWeight);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients,
+                               GPUMatrix<ElemType>& functionValues,
+                               ElemType learnRatePerSample,
+                               ElemType momentum,
+                               ElemType varianceMomentum,
+                               ElemType epsilon,
+                               ElemType momentumCorrection,
+                               ElemType varianceCorrection,
+                               ElemType clipThreshold,
+                               ElemType l2RegWeight,
+                               bool returnStepInGradients)
+{
+    size_t numColsNeeded = 2 * gradients.GetNumCols();
+
+    if (IsEmpty() || (GetNumCols() < numColsNeeded))
+    {
+        RequireSize(gradients.GetNumRows(), numColsNeeded);
+        SetValue(0.0);
+    }
+
+    assert((GetNumRows() == gradients.GetNumRows()) && (GetNumCols() == numColsNeeded));
+    assert(functionValues.GetNumElements() == gradients.GetNumElements());
+
+    size_t n = gradients.GetNumElements();
+    int blocksPerGrid = (n + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    _adam<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(n, gradients.Data(), Data(), Data() + n, functionValues.Data(),
+                                                                    learnRatePerSample, momentum, varianceMomentum, epsilon, momentumCorrection, varianceCorrection,
+                                                                    clipThreshold, l2RegWeight, returnStepInGradients);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients,
                                     GPUMatrix<ElemType>& functionValues,
@@ -1500,11 +2080,11 @@ void GPUMatrix<ElemType>::RequireSize(const size_t numRows, const size_t numCols
 template <class ElemType>
 void GPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, bool growOnly)
 {
-    VerifyResizable(__func__);
-
     if (GetNumRows() == numRows && GetNumCols() == numCols)
         return;
 
+    VerifyResizable(__func__);
+
     size_t numElements = numRows * numCols;
     if (numElements > GetSizeAllocated() ||                 // grow allocation
         (!growOnly && numElements != GetSizeAllocated()))   // shrink allocation if not growOnly
@@ -2018,6 +2598,28 @@ void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatr
         c.Data());
 }
 
+// see Matrix<ElemType>::AssignGMMLogLikelihoodOf()
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& prior, const GPUMatrix<ElemType>& mean, const GPUMatrix<ElemType>& stddev, const GPUMatrix<ElemType>& feature,
+                                                   GPUMatrix<ElemType>& normedDeviationVectors, GPUMatrix<ElemType>& normedDeviation, GPUMatrix<ElemType>& posterior)
+{
+    const CUDA_LONG numComponents = (CUDA_LONG) prior.GetNumRows();
+    const CUDA_LONG featureDim = (CUDA_LONG) feature.GetNumRows();
+    const CUDA_LONG numSamples = (CUDA_LONG) feature.GetNumCols();
+    if (numSamples == 0)
+        return;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(numSamples);
+    _assignGMMLogLikelihood<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(
+        Data(), prior.Data(), prior.GetNumCols() == 1 ? 0 : numComponents,
+        mean.Data(), mean.GetNumCols() == 1 ? 0 : numComponents * featureDim,
+        stddev.Data(), stddev.GetNumCols() == 1 ? 0 : numComponents,
+        feature.Data(), normedDeviationVectors.Data(), normedDeviation.Data(), posterior.Data(),
+        numComponents, featureDim, numSamples);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c)
 {
@@ -3073,7 +3675,8 @@ void GPUMatrix<ElemType>::ConvolutionForward(const GPUMatrix<ElemType>& kernel,
     auto gdim = dim3((output.GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
     PrepareDevice();
     SyncGuard syncGuard;
-    kConvolutionForward<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), kernel.Data(), mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data(),
+    TableConvolveRowMap rowMap = { mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data() };
+    kConvolutionForward<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), kernel.Data(), rowMap,
                                                             runs.Data(), Data(), (int)GetNumRows(), output.Data(), (int)output.GetNumRows());
 }
 
@@ -3085,7 +3688,8 @@ void GPUMatrix<ElemType>::ConvolutionBackwardData(const GPUMatrix<ElemType>& ker
     auto gdim = dim3((GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
     PrepareDevice();
     SyncGuard syncGuard;
-    kConvolutionBackwardData<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), kernel.Data(), mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data(),
+    TableConvolveRowMap rowMap = { mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data() };
+    kConvolutionBackwardData<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), kernel.Data(), rowMap,
                                                                  runs.Data(), Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
 }
 
@@ -3097,9 +3701,48 @@ void GPUMatrix<ElemType>::ConvolutionBackwardKernel(const GPUMatrix<ElemType>& i
     auto gdim = dim3((GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
     PrepareDevice();
     SyncGuard syncGuard;
+    TableConvolveRowMap rowMap = { mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data() };
     kConvolutionBackwardKernel<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), (int)in.GetNumRows(), (int)GetNumRows(),
-                                                                   in.Data(), mpRowCol.Data(), mpRowIwht.Data(), mpRowRun.Data(),
-                                                                   runs.Data(), Data(), kernelGrad.Data());
+                                                                   in.Data(), rowMap, runs.Data(), Data(), kernelGrad.Data());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ConvolutionForward(const GPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                             const GPUMatrix<int>& runs, GPUMatrix<ElemType>& output) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((output.GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    CompactConvolveRowMap rowMap = { geometry, mpKeyRun.Data() };
+    kConvolutionForward<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), kernel.Data(), rowMap,
+                                                            runs.Data(), Data(), (int)GetNumRows(), output.Data(), (int)output.GetNumRows());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ConvolutionBackwardData(const GPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                                  const GPUMatrix<int>& runs, GPUMatrix<ElemType>& grad) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    CompactConvolveRowMap rowMap = { geometry, mpKeyRun.Data() };
+    kConvolutionBackwardData<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), kernel.Data(), rowMap,
+                                                                 runs.Data(), Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                                    const GPUMatrix<int>& runs, GPUMatrix<ElemType>& kernelGrad) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    CompactConvolveRowMap rowMap = { geometry, mpKeyRun.Data() };
+    kConvolutionBackwardKernel<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), (int)in.GetNumRows(), (int)GetNumRows(),
+                                                                   in.Data(), rowMap, runs.Data(), Data(), kernelGrad.Data());
 }
 
 template <class ElemType>
@@ -3160,6 +3803,30 @@ void GPUMatrix<ElemType>::AveragePoolingBackward(const GPUMatrix<int>& mpRowCol,
                                                                 Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MaxPoolingBackwardByInput(const GPUMatrix<ElemType>& out, const GPUMatrix<ElemType>& in, const GPUMatrix<int>& inRowStarts, const GPUMatrix<int>& inRowSources,
+                                                    GPUMatrix<ElemType>& grad) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((grad.GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kMaxPoolingBackwardByInput<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), out.Data(), in.Data(), inRowStarts.Data(), inRowSources.Data(),
+                                                                   Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AveragePoolingBackwardByInput(const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, const GPUMatrix<int>& inRowStarts, const GPUMatrix<int>& inRowSources,
+                                                        GPUMatrix<ElemType>& grad) const
+{
+    const int BlockSize = 128;
+    auto gdim = dim3((grad.GetNumRows() + BlockSize - 1)/ BlockSize, std::min((int)GetNumCols(), 65535));
+    PrepareDevice();
+    SyncGuard syncGuard;
+    kAveragePoolingBackwardByInput<<<gdim, BlockSize, 0, t_stream>>>((int)GetNumCols(), mpRowIndices.Data(), indices.Data(), inRowStarts.Data(), inRowSources.Data(),
+                                                                       Data(), (int)GetNumRows(), grad.Data(), (int)grad.GetNumRows());
+}
+
 // returns saveMean/saveInvStdDev which are the actual values used to perform the normalization, except for blendFactor 1, in which case they are unused and set to empty
 template <class ElemType>
 void GPUMatrix<ElemType>::BatchNormalizationForward(const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor,
@@ -3279,6 +3946,29 @@ static cublasStatus_t cublas_gemm(cublasHandle_t handle, cublasOperation_t trans
 {
     return cublasDgemm(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
 }
+#if CUDA_VERSION >= 8000
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A, int lda, long long strideA,
+                                                const float* B, int ldb, long long strideB, const float* beta, float* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasSgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+static cublasStatus_t cublas_gemmStridedBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double* A, int lda, long long strideA,
+                                                const double* B, int ldb, long long strideB, const double* beta, double* C, int ldc, long long strideC, int batchCount)
+{
+    return cublasDgemmStridedBatched(handle, transa, transb, m, n, k, alpha, A, lda, strideA, B, ldb, strideB, beta, C, ldc, strideC, batchCount);
+}
+#else
+static cublasStatus_t cublas_gemmBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha, const float* A[], int lda,
+                                         const float* B[], int ldb, const float* beta, float* C[], int ldc, int batchCount)
+{
+    return cublasSgemmBatched(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batchCount);
+}
+static cublasStatus_t cublas_gemmBatched(cublasHandle_t handle, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const double* alpha, const double* A[], int lda,
+                                         const double* B[], int ldb, const double* beta, double* C[], int ldc, int batchCount)
+{
+    return cublasDgemmBatched(handle, transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, batchCount);
+}
+#endif
 static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const float* alpha, const float* x, int incx, float* y, int incy)
 {
     return cublasSaxpy(handle, n, alpha, x, incx, y, incy);
@@ -3288,6 +3978,63 @@ static cublasStatus_t cublas_axpy(cublasHandle_t handle, int n, const double* al
     return cublasDaxpy(handle, n, alpha, x, incx, y, incy);
 }
 
+__global__ void _convertFloatToHalf(const float* src, __half* dst, CUDA_LONG N)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    dst[id] = __float2half(src[id]);
+}
+
+// fp16 copies of the Float16Gemm operands, per device and operand; grown as needed and kept for the process lifetime
+// All uses are on t_stream, so a buffer can be reused as soon as the next GEMM is enqueued.
+static __half* ToFloat16(int deviceId, int operand, const float* data, size_t numElements)
+{
+    if (numElements > (size_t) std::numeric_limits<CUDA_LONG>::max())
+        InvalidArgument("Float16Gemm: Operands with more than %d elements are not supported.", (int) std::numeric_limits<CUDA_LONG>::max());
+    static __half* s_buffers[MAX_GPUS][2];
+    static size_t s_capacities[MAX_GPUS][2];
+    __half*& buffer = s_buffers[deviceId][operand];
+    size_t& capacity = s_capacities[deviceId][operand];
+    if (numElements > capacity)
+    {
+        if (buffer)
+            TracingGPUMemoryAllocator::Free<__half>(deviceId, buffer);
+        buffer = TracingGPUMemoryAllocator::Allocate<__half>(deviceId, numElements);
+        capacity = numElements;
+    }
+    CUDA_LONG N = (CUDA_LONG) numElements;
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    SyncGuard syncGuard;
+    _convertFloatToHalf<<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(data, buffer, N);
+    return buffer;
+}
+
+// float GEMM from fp16 copies of A and B with fp32 accumulation, if Float16Gemm is enabled; returns false otherwise
+static bool Float16GemmIfEnabled(cublasHandle_t handle, int deviceId, cublasOperation_t transa, cublasOperation_t transb, int m, int n, int k, const float* alpha,
+                                 const float* A, int lda, size_t numElementsA, const float* B, int ldb, size_t numElementsB, const float* beta, float* C, int ldc)
+{
+#if CUDA_VERSION >= 8000 // cublasSgemmEx() with cudaDataType
+    if (!Float16Gemm::IsEnabled())
+        return false;
+    const __half* A16 = ToFloat16(deviceId, 0, A, numElementsA);
+    const __half* B16 = (B == A) ? A16 : ToFloat16(deviceId, 1, B, numElementsB);
+#if CUDA_VERSION >= 9000
+    CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_TENSOR_OP_MATH));
+#endif
+    CUBLAS_CALL(cublasSgemmEx(handle, transa, transb, m, n, k, alpha, A16, CUDA_R_16F, lda, B16, CUDA_R_16F, ldb, beta, C, CUDA_R_32F, ldc));
+#if CUDA_VERSION >= 9000
+    CUBLAS_CALL(cublasSetMathMode(handle, CUBLAS_DEFAULT_MATH));
+#endif
+    return true;
+#else
+    return false;
+#endif
+}
+static bool Float16GemmIfEnabled(cublasHandle_t, int, cublasOperation_t, cublasOperation_t, int, int, int, const double*,
+                                 const double*, int, size_t, const double*, int, size_t, const double*, double*, int)
+{
+    return false;
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
                                                  ElemType beta, GPUMatrix<ElemType>& c)
@@ -3310,11 +4057,74 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
         RuntimeError("!(m>0 && k>0 && l>0 && n>0)"); // converting from size_t to int may cause overflow
     if (k != l)
         RuntimeError("matrix dim mismatch in MultiplyAndWeightedAdd");
-    CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
+    if (!Float16GemmIfEnabled(cuHandle, b.GetComputeDeviceId(), transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, a.GetNumElements(), b.Data(), (int) b.m_numRows, b.GetNumElements(), &beta, c.Data(), (int) c.m_numRows))
+        CUBLAS_CALL(cublas_gemm(cuHandle, transA, transB, m, n, k, &alpha, a.Data(), (int) a.m_numRows, b.Data(), (int) b.m_numRows, &beta, c.Data(), (int) c.m_numRows));
     c.m_numRows = m;
     c.m_numCols = n;
 }
 
+#if CUDA_VERSION < 8000
+// the pointer arrays for cublas?gemmBatched(): ptrs = [A_0 ... A_{N-1}, B_0 ..., C_0 ...]
+template <class ElemType>
+__global__ void _setBatchedGemmPointers(ElemType** ptrs, ElemType* a, CUDA_LONG strideA, ElemType* b, CUDA_LONG strideB, ElemType* c, CUDA_LONG strideC, CUDA_LONG N)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    ptrs[id] = a + id * strideA;
+    ptrs[N + id] = b + id * strideB;
+    ptrs[2 * N + id] = c + id * strideC;
+}
+#endif
+
+// One cuBLAS call for all products, as the launch overhead dominates for small matrices.
+// Strided batches need CUDA 8; before that, we fill the pointer arrays of cublas?gemmBatched() on the GPU.
+template <class ElemType>
+void GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB,
+                                                        ElemType beta, GPUMatrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+    a.PrepareDevice();
+    if ((a.GetComputeDeviceId() != b.GetComputeDeviceId()) || (b.GetComputeDeviceId() != c.GetComputeDeviceId())) // different GPUs
+        InvalidArgument("All matrices must be on the same GPU");
+
+    size_t batchSize = max(a.GetNumCols(), b.GetNumCols());
+    if (a.GetNumRows() != m * k || b.GetNumRows() != k * n || (a.GetNumCols() != batchSize && a.GetNumCols() != 1) || (b.GetNumCols() != batchSize && b.GetNumCols() != 1))
+        InvalidArgument("GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : Operands [%d x %d] and [%d x %d] do not hold [%d x %d] and [%d x %d] matrices.",
+                        (int) a.GetNumRows(), (int) a.GetNumCols(), (int) b.GetNumRows(), (int) b.GetNumCols(), (int) m, (int) k, (int) k, (int) n);
+    if (m == 0 || n == 0 || k == 0 || m * k > INT_MAX || k * n > INT_MAX || m * n > INT_MAX || batchSize > INT_MAX)
+        InvalidArgument("GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd : Unsupported matrix dimensions [%d x %d] * [%d x %d].", (int) m, (int) k, (int) k, (int) n);
+
+    if (beta == 0)
+        c.RequireSize(m * n, batchSize);
+    else
+        c.VerifySize(m * n, batchSize); // Can't resize if beta != 0
+    if (batchSize == 0)
+        return;
+
+    cublasHandle_t cuHandle = GetCublasHandle(b.GetComputeDeviceId());
+    cublasOperation_t transA = transposeA ? CUBLAS_OP_T : CUBLAS_OP_N;
+    cublasOperation_t transB = transposeB ? CUBLAS_OP_T : CUBLAS_OP_N;
+    int lda = (int) (transposeA ? k : m);
+    int ldb = (int) (transposeB ? n : k);
+    int ldc = (int) m;
+    // a single column is used for all products
+    size_t strideA = a.GetNumCols() == 1 ? 0 : m * k;
+    size_t strideB = b.GetNumCols() == 1 ? 0 : k * n;
+#if CUDA_VERSION >= 8000
+    CUBLAS_CALL(cublas_gemmStridedBatched(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, a.Data(), lda, strideA, b.Data(), ldb, strideB,
+                                          &beta, c.Data(), ldc, m * n, (int) batchSize));
+#else
+    CUDA_LONG N = (CUDA_LONG) batchSize;
+    ElemType** ptrs = TracingGPUMemoryAllocator::Allocate<ElemType*>(c.GetComputeDeviceId(), 3 * batchSize);
+    int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+    {
+        SyncGuard syncGuard;
+        _setBatchedGemmPointers<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(ptrs, a.Data(), (CUDA_LONG) strideA, b.Data(), (CUDA_LONG) strideB, c.Data(), (CUDA_LONG) (m * n), N);
+    }
+    CUBLAS_CALL(cublas_gemmBatched(cuHandle, transA, transB, (int) m, (int) n, (int) k, &alpha, (const ElemType**) ptrs, lda, (const ElemType**) ptrs + batchSize, ldb,
+                                   &beta, ptrs + 2 * batchSize, ldc, (int) batchSize));
+    TracingGPUMemoryAllocator::Free<ElemType*>(c.GetComputeDeviceId(), ptrs);
+#endif
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, ElemType beta, GPUMatrix<ElemType>& c)
 {
@@ -4212,6 +5022,88 @@ GPUMatrix<ElemType>& GPUMatrix<ElemType>::AssignElementProductOfWithShift(const
     return *this;
 }
 
+// see Matrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf()
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                 GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB)
+{
+    const CUDA_LONG dim = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG n = (CUDA_LONG) a.GetNumCols();
+    const CUDA_LONG numRows = (CUDA_LONG) negNumber + 1;
+    if (n == 0)
+        return;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim gridNorms(n);
+    _assignColumnInverseNorms<ElemType><<<gridNorms.m_blocksPerGrid, gridNorms.m_threadsPerBlock, 0, t_stream>>>(invNormA.Data(), invNormB.Data(), a.Data(), b.Data(), dim, n);
+    GridDim grid(numRows * n);
+    _assignCosDistanceWithNegativeSamples<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(
+        Data(), a.Data(), b.Data(), invNormA.Data(), invNormB.Data(), dim, n, (CUDA_LONG) shift, numRows);
+}
+
+// see Matrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient()
+template <class ElemType>
+void GPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                                    const GPUMatrix<ElemType>& value, const GPUMatrix<ElemType>& valueGradient, size_t shift, GPUMatrix<ElemType>& gradient)
+{
+    const CUDA_LONG dim = (CUDA_LONG) a.GetNumRows();
+    const CUDA_LONG n = (CUDA_LONG) a.GetNumCols();
+    bool isRight = inputIndex == 1;
+    if (n == 0)
+        return;
+
+    gradient.PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(dim * n);
+    _addCosDistanceWithNegativeSamplesGradient<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(
+        gradient.Data(), (isRight ? b : a).Data(), (isRight ? a : b).Data(), (isRight ? invNormB : invNormA).Data(), (isRight ? invNormA : invNormB).Data(),
+        value.Data(), valueGradient.Data(), isRight, dim, n, (CUDA_LONG) shift, (CUDA_LONG) value.GetNumRows());
+}
+
+// see Matrix<ElemType>::AddKhatriRaoProductGradient()
+template <class ElemType>
+void GPUMatrix<ElemType>::AddKhatriRaoProductGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& aGradient, GPUMatrix<ElemType>& bGradient)
+{
+    const CUDA_LONG cols = (CUDA_LONG) a.GetNumCols();
+    if (cols == 0 || a.GetNumRows() == 0 || b.GetNumRows() == 0)
+        return;
+
+    aGradient.PrepareDevice();
+    SyncGuard syncGuard;
+    // note: kernel uses hard-coded thread dimension
+    _addKhatriRaoProductGradient256Threads<ElemType><<<cols, 256, 0, t_stream>>>(gradient.Data(), a.Data(), b.Data(), aGradient.Data(), bGradient.Data(),
+                                                                                  (CUDA_LONG) a.GetNumRows(), (CUDA_LONG) b.GetNumRows());
+}
+
+// see Matrix<ElemType>::AssignDiagTimesOf() and AddDiagTimesOf()
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignDiagTimesOf(const GPUMatrix<ElemType>& diag, const GPUMatrix<ElemType>& a, bool accumulate)
+{
+    const CUDA_LONG N = (CUDA_LONG) a.GetNumElements();
+    if (N == 0)
+        return;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    GridDim grid(N);
+    _assignDiagTimesOf<ElemType><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(Data(), diag.Data(), a.Data(), (CUDA_LONG) a.GetNumRows(), N, accumulate);
+}
+
+// see Matrix<ElemType>::AddRowInnerProductOf()
+template <class ElemType>
+void GPUMatrix<ElemType>::AddRowInnerProductOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b)
+{
+    const CUDA_LONG rows = (CUDA_LONG) a.GetNumRows();
+    if (rows == 0 || a.GetNumCols() == 0)
+        return;
+
+    PrepareDevice();
+    SyncGuard syncGuard;
+    // note: kernel uses hard-coded thread dimension
+    _addRowInnerProductOf512Threads<ElemType><<<(rows + 31) / 32, 512, 0, t_stream>>>(Data(), a.Data(), b.Data(), rows, (CUDA_LONG) a.GetNumCols());
+}
+
 //sequence training
 template <class ElemType>
 GPUMatrix<ElemType>& GPUMatrix<ElemType>::DropFrame(const GPUMatrix<ElemType>& label, const GPUMatrix<ElemType>& gamma, const ElemType& threshhold)
@@ -4267,6 +5159,55 @@ ElemType GPUMatrix<ElemType>::LogSumOfElements() const
     return h_sum;
 }
 
+// The recursions over time run inside a single kernel launch (one thread per label, looping over t),
+// so that neither the scores nor alpha leave the device.
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFForwardCompute(GPUMatrix<ElemType>& alpha,
+                                             const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl)
+{
+    if (pos_scores.IsEmpty() || pair_scores.IsEmpty())
+        LogicError("RCRFForwardCompute: one of the input matrices is empty.");
+
+    size_t iNumLab = pos_scores.GetNumRows();
+    size_t iNumPos = pos_scores.GetNumCols();
+    if (iNumLab > 1024)
+        InvalidArgument("RCRFForwardCompute: at most 1024 labels are supported.");
+
+    pos_scores.PrepareDevice();
+    alpha.RequireSize(iNumLab, iNumPos);
+
+    SyncGuard syncGuard;
+    _rcrfForwardComputeMax1024Labels<ElemType><<<1, (unsigned int) iNumLab, sizeof(ElemType) * iNumLab, t_stream>>>(pos_scores.Data(), pair_scores.Data(), alpha.Data(),
+                                                                                                                   iNumPos, iNumLab, startLbl);
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFViterbiCompute(GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace, GPUMatrix<ElemType>& decodedPath,
+                                             const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl, const int endLbl)
+{
+    if (pos_scores.IsEmpty() || pair_scores.IsEmpty())
+        LogicError("RCRFViterbiCompute: one of the input matrices is empty.");
+
+    size_t iNumLab = pos_scores.GetNumRows();
+    size_t iNumPos = pos_scores.GetNumCols();
+    if (iNumLab > 1024)
+        InvalidArgument("RCRFViterbiCompute: at most 1024 labels are supported.");
+
+    pos_scores.PrepareDevice();
+    alpha.RequireSize(iNumLab, iNumPos);
+    backtrace.RequireSize(iNumLab, iNumPos);
+    decodedPath.RequireSize(iNumLab, iNumPos);
+    decodedPath.SetValue(0);
+
+    SyncGuard syncGuard;
+    _rcrfViterbiComputeMax1024Labels<ElemType><<<1, (unsigned int) iNumLab, sizeof(ElemType) * iNumLab, t_stream>>>(pos_scores.Data(), pair_scores.Data(), alpha.Data(), backtrace.Data(),
+                                                                                                                   iNumPos, iNumLab, startLbl);
+    // following the back pointers is inherently sequential, but cheap; a single thread does it without a round trip to the host
+    _rcrfViterbiBacktrace<ElemType><<<1, 1, 0, t_stream>>>(backtrace.Data(), decodedPath.Data(), iNumPos, iNumLab, endLbl);
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::RCRFBackwardCompute(
     const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
@@ -4438,6 +5379,11 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
         return;
     }
 
+    // special case: copy that permutes dimensions (e.g. TransposeDimensions); uses a tiled transpose so that reads and writes are both coalesced
+    else if (op == ElementWiseOperator::opCopy && reducingOpDims.size() == 0 &&
+             LaunchTransposeTensorOp<ElemType>(beta, a.Data() + offsets[0], Data() + offsets[1], alpha, regularOpDims, regularStrides))
+        return;
+
     // TODO: Add a special case for tensor bias reduction. cudnn is ~7% faster on Image/QuickE2E.
 
     // regular case
@@ -4478,6 +5424,156 @@ void GPUMatrix<ElemType>::TensorOp(ElemType beta, const GPUMatrix<ElemType>& a,
     return TensorOpN<ElemType, 4>(beta, array<ElemType*, 4>{a.Data(), b.Data(), c.Data(), Data()}, alpha, op, reductionOp, offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
 }
 
+#pragma region GPUInt8Gemm class
+
+static const int s_int8QuantizeThreads = 256; // per column of b
+static const int s_int8GemmTile = 16;         // c is computed in tiles of 16 x 16 elements, from 16 x 64 int8 of a and b at a time
+
+// quantize column blockIdx.x of x (rows x n) to int8 in q (paddedRows x n), zero-padded; scales[] receives the dequantization factors
+template <class ElemType>
+__global__ void _quantizeColumnsToInt8(const ElemType* x, CUDA_LONG rows, CUDA_LONG paddedRows, ElemType inputRange, int8_t* q, ElemType* scales)
+{
+    __shared__ ElemType partialMax[s_int8QuantizeThreads];
+    const ElemType* column = x + (size_t) blockIdx.x * rows;
+    int8_t* quantizedColumn = q + (size_t) blockIdx.x * paddedRows;
+
+    ElemType range = inputRange;
+    if (range <= 0)
+    {
+        ElemType maxAbs = 0;
+        for (CUDA_LONG i = threadIdx.x; i < rows; i += blockDim.x)
+            maxAbs = max(maxAbs, fabs(column[i]));
+        partialMax[threadIdx.x] = maxAbs;
+        __syncthreads();
+        for (int s = blockDim.x / 2; s > 0; s /= 2)
+        {
+            if (threadIdx.x < s)
+                partialMax[threadIdx.x] = max(partialMax[threadIdx.x], partialMax[threadIdx.x + s]);
+            __syncthreads();
+        }
+        range = partialMax[0];
+    }
+
+    ElemType factor = range > 0 ? 127 / range : 0;
+    for (CUDA_LONG i = threadIdx.x; i < paddedRows; i += blockDim.x)
+    {
+        ElemType value = i < rows ? column[i] * factor : 0;
+        value = value > 127 ? 127 : value < -127 ? -127 : value;
+        quantizedColumn[i] = (int8_t) rint(value);
+    }
+    if (threadIdx.x == 0)
+        scales[blockIdx.x] = range / 127;
+}
+
+// sum of the products of the four int8 in a and b, plus c
+__device__ __forceinline__ int _dot4Int8(int a, int b, int c)
+{
+#if __CUDA_ARCH__ >= 610 && CUDA_VERSION >= 8000
+    return __dp4a(a, b, c);
+#else
+    for (int i = 0; i < 32; i += 8)
+        c += (int) (signed char) (a >> i) * (int) (signed char) (b >> i);
+    return c;
+#endif
+}
+
+// c[i, j] = rowScales[i] * columnScales[j] * sum_l a[i, l] * b[l, j], where the rows of the row-major a (m x 4 k4) and the columns
+// of the column-major b (4 k4 x n) are read as k4 ints of four int8 each
+template <class ElemType>
+__global__ void _int8Gemm(const int* a, const int* b, const ElemType* rowScales, const ElemType* columnScales, CUDA_LONG m, CUDA_LONG n, CUDA_LONG k4, ElemType* c)
+{
+    __shared__ int aTile[s_int8GemmTile][s_int8GemmTile + 1]; // [row of c][l]; +1 avoids bank conflicts
+    __shared__ int bTile[s_int8GemmTile][s_int8GemmTile + 1]; // [column of c][l]
+
+    CUDA_LONG rowBegin = blockIdx.x * s_int8GemmTile;
+    CUDA_LONG columnBegin = blockIdx.y * s_int8GemmTile;
+    CUDA_LONG row = rowBegin + threadIdx.x; // threadIdx.x runs along the columns of c, so that the writes are coalesced
+    CUDA_LONG column = columnBegin + threadIdx.y;
+
+    int sum = 0;
+    for (CUDA_LONG l0 = 0; l0 < k4; l0 += s_int8GemmTile)
+    {
+        CUDA_LONG l = l0 + threadIdx.x;
+        aTile[threadIdx.y][threadIdx.x] = (rowBegin + threadIdx.y < m && l < k4) ? a[(rowBegin + threadIdx.y) * k4 + l] : 0;
+        bTile[threadIdx.y][threadIdx.x] = (column < n && l < k4) ? b[column * k4 + l] : 0;
+        __syncthreads();
+        for (int i = 0; i < s_int8GemmTile; i++)
+            sum = _dot4Int8(aTile[threadIdx.x][i], bTile[threadIdx.y][i], sum);
+        __syncthreads();
+    }
+    if (row < m && column < n)
+        c[column * m + row] = sum * rowScales[row] * columnScales[column];
+}
+
+template <class ElemType>
+GPUInt8Gemm<ElemType>::GPUInt8Gemm(DEVICEID_TYPE deviceId)
+    : m_deviceId(deviceId), m_m(0), m_paddedK(0), m_a(nullptr), m_rowScales(nullptr), m_bCapacity(0), m_b(nullptr), m_columnScales(nullptr)
+{
+}
+
+template <class ElemType>
+GPUInt8Gemm<ElemType>::~GPUInt8Gemm()
+{
+    if (m_a)
+        TracingGPUMemoryAllocator::Free<int8_t>(m_deviceId, m_a, true);
+    if (m_rowScales)
+        TracingGPUMemoryAllocator::Free<ElemType>(m_deviceId, m_rowScales, true);
+    if (m_b)
+        TracingGPUMemoryAllocator::Free<int8_t>(m_deviceId, m_b, true);
+    if (m_columnScales)
+        TracingGPUMemoryAllocator::Free<ElemType>(m_deviceId, m_columnScales, true);
+}
+
+template <class ElemType>
+void GPUInt8Gemm<ElemType>::SetA(const int8_t* a, const ElemType* rowScales, size_t m, size_t paddedK)
+{
+    if (paddedK % 4 != 0 || m * paddedK > (size_t) std::numeric_limits<CUDA_LONG>::max())
+        InvalidArgument("GPUInt8Gemm: Unsupported matrix dimensions [%d x %d].", (int) m, (int) paddedK);
+    PrepareDevice(m_deviceId);
+    if (m != m_m || paddedK != m_paddedK)
+    {
+        if (m_a)
+            TracingGPUMemoryAllocator::Free<int8_t>(m_deviceId, m_a);
+        if (m_rowScales)
+            TracingGPUMemoryAllocator::Free<ElemType>(m_deviceId, m_rowScales);
+        m_a = TracingGPUMemoryAllocator::Allocate<int8_t>(m_deviceId, m * paddedK);
+        m_rowScales = TracingGPUMemoryAllocator::Allocate<ElemType>(m_deviceId, m);
+    }
+    m_m = m;
+    m_paddedK = paddedK;
+    CUDA_CALL(cudaMemcpy(m_a, a, m * paddedK, cudaMemcpyHostToDevice));
+    CUDA_CALL(cudaMemcpy(m_rowScales, rowScales, sizeof(ElemType) * m, cudaMemcpyHostToDevice));
+}
+
+template <class ElemType>
+void GPUInt8Gemm<ElemType>::Multiply(const ElemType* b, size_t k, size_t n, ElemType inputRange, ElemType* c)
+{
+    if (!m_a)
+        LogicError("GPUInt8Gemm: Multiply() called before SetA().");
+    if (k > m_paddedK || n * m_paddedK > (size_t) std::numeric_limits<CUDA_LONG>::max() || n * m_m > (size_t) std::numeric_limits<CUDA_LONG>::max())
+        InvalidArgument("GPUInt8Gemm: Unsupported matrix dimensions [%d x %d].", (int) k, (int) n);
+    PrepareDevice(m_deviceId);
+    if (n > m_bCapacity)
+    {
+        if (m_b)
+            TracingGPUMemoryAllocator::Free<int8_t>(m_deviceId, m_b);
+        if (m_columnScales)
+            TracingGPUMemoryAllocator::Free<ElemType>(m_deviceId, m_columnScales);
+        m_b = TracingGPUMemoryAllocator::Allocate<int8_t>(m_deviceId, n * m_paddedK);
+        m_columnScales = TracingGPUMemoryAllocator::Allocate<ElemType>(m_deviceId, n);
+        m_bCapacity = n;
+    }
+
+    // both kernels are on t_stream, so m_b can be reused by the next call right away
+    SyncGuard syncGuard;
+    _quantizeColumnsToInt8<ElemType><<<(unsigned int) n, s_int8QuantizeThreads, 0, t_stream>>>(b, (CUDA_LONG) k, (CUDA_LONG) m_paddedK, inputRange, m_b, m_columnScales);
+    dim3 blocks((unsigned int) ((m_m + s_int8GemmTile - 1) / s_int8GemmTile), (unsigned int) ((n + s_int8GemmTile - 1) / s_int8GemmTile));
+    dim3 threads(s_int8GemmTile, s_int8GemmTile);
+    _int8Gemm<ElemType><<<blocks, threads, 0, t_stream>>>((const int*) m_a, (const int*) m_b, m_rowScales, m_columnScales, (CUDA_LONG) m_m, (CUDA_LONG) n, (CUDA_LONG) (m_paddedK / 4), c);
+}
+
+#pragma endregion
+
 // =======================================================================
 // explicit instantiations business
 // =======================================================================
@@ -4486,6 +5582,8 @@ template class GPUMatrix<float>;
 template class GPUMatrix<double>;
 template class DeviceBoundNumber<float>;
 template class DeviceBoundNumber<double>;
+template class GPUInt8Gemm<float>;
+template class GPUInt8Gemm<double>;
 
 template <class ElemType>
 cublasHandle_t GPUMatrix<ElemType>::s_cuHandle[GPUMatrix<ElemType>::MaxGpus] = {0};
@@ -12,6 +12,7 @@
 #include "BestGpu.h" // for CPUONLY macro
 #include "ConcStack.h"
 #include "GPURNGHandle.h"
+#include "CompactConvolveGeometry.h"
 #include <string>
 #include <vector>
 #include <array>
@@ -82,6 +83,141 @@ public:
     ~SyncGuard();
 };
 
+// -----------------------------------------------------------------------
+// Float16Gemm -- compute float GEMMs from fp16 copies of the operands
+// -----------------------------------------------------------------------
+
+// The products still accumulate in fp32, and run on the tensor cores of Volta GPUs with CUDA 9. All matrices stay fp32,
+// so models, checkpoints and the SGD updates are unaffected; but the GEMM inputs are rounded to the precision and range
+// of fp16 (|x| <= 65504, and small gradients may flush to zero).
+class Float16Gemm
+{
+private:
+    static bool s_isEnabled;
+
+public:
+    static MATH_API void Enable(bool enable);
+    static MATH_API bool IsEnabled();
+};
+
+// -----------------------------------------------------------------------
+// TensorOpAutotuning -- timed choice of the launch configuration of tensor ops (GPUTensor.cu)
+// -----------------------------------------------------------------------
+
+// By default, the reduction strategy and the block size of a tensor op follow from its shape by fixed heuristics. With
+// autotuning, the candidates are timed at the first use of the signature of the op (GPU model, element type, operation,
+// dimensions rounded up to powers of 2, pattern of the strides), and the fastest is used from then on.
+class TensorOpAutotuning
+{
+public:
+    // file: loaded now and appended to whenever a configuration is autotuned, like CuDnnConvolutionAlgoCache; may be empty
+    static MATH_API void Configure(bool enable, const std::wstring& file);
+    static MATH_API bool IsEnabled();
+};
+
+// -----------------------------------------------------------------------
+// GPUTimingEvent -- CUDA events for timing GPU work without synchronizing the host (used by MatrixOpTracer)
+// -----------------------------------------------------------------------
+
+class GPUTimingEvent
+{
+public:
+    // record an event on the current stream of the current device; events are reused through a pool
+    static MATH_API void* Record();
+    // milliseconds between two recorded events, or a negative value if they were recorded on different devices; waits for 'stop' to complete
+    static MATH_API float ElapsedMilliseconds(void* start, void* stop);
+    static MATH_API void Release(void* event);
+};
+
+// -----------------------------------------------------------------------
+// GPUStreams -- additional compute streams per device, for executing independent nodes concurrently
+// -----------------------------------------------------------------------
+
+// Used by ComputationNetwork::PARTraversalFlowControlNode. The streams are created on first use, as blocking streams,
+// so that they are synchronized with work on the legacy default stream; dependencies between them are expressed by
+// events, which do not block the host.
+class GPUStreams
+{
+private:
+    static size_t s_numStreams;
+
+public:
+    // must be called before the streams are first used; 1 means no concurrency
+    static MATH_API void SetNumStreams(size_t numStreams);
+    static MATH_API size_t GetNumStreams();
+
+    // make stream 'index' (< GetNumStreams()) of the device the current stream of this thread; returns the previous one for Restore()
+    static MATH_API void* Select(DEVICEID_TYPE deviceId, size_t index);
+    static MATH_API void Restore(void* stream);
+
+    // Record() and Wait() apply to the current stream, which must be on the device the event was created for
+    static MATH_API void* NewEvent(DEVICEID_TYPE deviceId);
+    static MATH_API void DeleteEvent(void* event);
+    static MATH_API void Record(void* event);
+    static MATH_API void Wait(void* event);
+};
+
+// -----------------------------------------------------------------------
+// GPUGraph -- capture the GPU work issued by this thread into a CUDA graph, and replay it with a single launch
+// -----------------------------------------------------------------------
+
+// Requires CUDA 10; IsSupported() is false otherwise. Work is captured, not executed, so it must not read results on the
+// host or allocate device memory (other than from the caching allocator). The capture stream is a blocking stream,
+// so replays are synchronized with work on the legacy default stream.
+class GPUGraph
+{
+private:
+    static bool s_isEnabled;
+
+public:
+    static MATH_API void Enable(bool enable);
+    static MATH_API bool IsEnabled();
+    static MATH_API bool IsSupported();
+
+    // make the capture stream of the device the current stream of this thread, and start capturing
+    static MATH_API void BeginCapture(DEVICEID_TYPE deviceId);
+    // stop capturing and restore the current stream; returns the instantiated graph, or nullptr if the work could not be captured
+    static MATH_API void* EndCapture();
+    // execute a graph on the capture stream of its device
+    static MATH_API void Launch(void* graph);
+    static MATH_API void Destroy(void* graph);
+};
+
+// -----------------------------------------------------------------------
+// GPUInt8Gemm -- int8 matrix product with a fixed left operand, int32 accumulation and fp32 rescaling (used by Int8Multiplier)
+// -----------------------------------------------------------------------
+
+// The dot products of four int8 pairs use __dp4a on GPUs of compute capability 6.1 and up (with CUDA 8), and are
+// unpacked into int32 multiplications otherwise.
+template <class ElemType>
+class MATH_API GPUInt8Gemm
+{
+public:
+    GPUInt8Gemm(DEVICEID_TYPE deviceId);
+    ~GPUInt8Gemm();
+
+    // copy the quantized left operand to the GPU: a row-major (m x paddedK) int8 matrix, where paddedK is a multiple of 4
+    // and columns beyond k are zero, and the dequantization factor of each row
+    void SetA(const int8_t* a, const ElemType* rowScales, size_t m, size_t paddedK);
+
+    // c = a * b for column-major b (k x n) and c (m x n) on the GPU; b is quantized to int8 with the range inputRange,
+    // clipping values beyond it, or with the maximum of each column if inputRange is 0
+    void Multiply(const ElemType* b, size_t k, size_t n, ElemType inputRange, ElemType* c);
+
+private:
+    GPUInt8Gemm(const GPUInt8Gemm&) = delete;
+    void operator=(const GPUInt8Gemm&) = delete;
+
+    DEVICEID_TYPE m_deviceId;
+    size_t m_m;
+    size_t m_paddedK;
+    int8_t* m_a;
+    ElemType* m_rowScales;
+    size_t m_bCapacity; // number of columns m_b and m_columnScales have space for
+    int8_t* m_b;
+    ElemType* m_columnScales;
+};
+
 // -----------------------------------------------------------------------
 // DeviceBoundNumber -- This class represents a number which resides on a particular device. Use it to avoid unnecessary transfers between CPU and GPU
 // -----------------------------------------------------------------------
@@ -219,6 +355,10 @@ public:
     }
 
     ElemType Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier);
+    void FusedNormalGrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, bool useNAG, ElemType clipThreshold, ElemType l2RegWeight);
+    void FusedAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType clipThreshold, ElemType l2RegWeight);
+    void Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType varianceMomentum, ElemType epsilon,
+              ElemType momentumCorrection, ElemType varianceCorrection, ElemType clipThreshold, ElemType l2RegWeight, bool returnStepInGradients);
     void FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
     ElemType RmsProp(GPUMatrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
@@ -247,6 +387,8 @@ public:
 
     //void SetValue(const CPUMatrix<ElemType>& deepCopyFrom);
     void SetValue(const GPUMatrix<ElemType>& deepCopyFrom);
+    // unlike SetValue(), this matrix stays on its device if 'deepCopyFrom' lives on another one (peer-to-peer copy)
+    void SetValueFromOtherDevice(const GPUMatrix<ElemType>& deepCopyFrom);
     //void SetValue(const CPUSparseMatrix<ElemType>& deepCopyFrom);
     //void SetValue(const GPUSparseMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
@@ -256,6 +398,9 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // this = beta * this + mask .* a, where mask is 0 with probability maskRate and scaleValue otherwise, regenerated
+    // from 'seed' and each element's index plus 'firstCounter' (same mask for the same arguments, on any device)
+    void DoRandomlyMaskedCopyOf(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter);
 
     GPUMatrix<ElemType> Transpose() const;
     GPUMatrix<ElemType>& AssignTransposeOf(const GPUMatrix<ElemType>& a);
@@ -419,6 +564,9 @@ public:
     void AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
     void AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatrix<ElemType>& softmax);
 
+    void AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& prior, const GPUMatrix<ElemType>& mean, const GPUMatrix<ElemType>& stddev, const GPUMatrix<ElemType>& feature,
+                                  GPUMatrix<ElemType>& normedDeviationVectors, GPUMatrix<ElemType>& normedDeviation, GPUMatrix<ElemType>& posterior);
+
     void Print(const char* matrixName, size_t rowStart, size_t rowEnd, size_t colStart, size_t colEnd) const;
     void Print(const char* matrixName = NULL) const; // print whole matrix. can be expensive
 
@@ -457,6 +605,12 @@ public:
                                  const GPUMatrix<int>& mpRowRun, const GPUMatrix<int>& runs, GPUMatrix<ElemType>& grad) const;
     void ConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIwht,
                                    const GPUMatrix<int>& mpRowRun, const GPUMatrix<int>& runs, GPUMatrix<ElemType>& kernelGrad) const;
+    void ConvolutionForward(const GPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                            const GPUMatrix<int>& runs, GPUMatrix<ElemType>& output) const;
+    void ConvolutionBackwardData(const GPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                 const GPUMatrix<int>& runs, GPUMatrix<ElemType>& grad) const;
+    void ConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                   const GPUMatrix<int>& runs, GPUMatrix<ElemType>& kernelGrad) const;
 
     void MaxPoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const;
     void MaxPoolingBackward(const GPUMatrix<ElemType>& out, const GPUMatrix<ElemType>& in,
@@ -467,6 +621,11 @@ public:
     void AveragePoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const;
     void AveragePoolingBackward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& grad) const;
 
+    void MaxPoolingBackwardByInput(const GPUMatrix<ElemType>& out, const GPUMatrix<ElemType>& in, const GPUMatrix<int>& inRowStarts, const GPUMatrix<int>& inRowSources,
+                                   GPUMatrix<ElemType>& grad) const;
+    void AveragePoolingBackwardByInput(const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, const GPUMatrix<int>& inRowStarts, const GPUMatrix<int>& inRowSources,
+                                       GPUMatrix<ElemType>& grad) const;
+
     void BatchNormalizationForward(const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor,
                                    GPUMatrix<ElemType>& runMean, GPUMatrix<ElemType>& runInvStdDev, GPUMatrix<ElemType>& out, double epsilon,
                                    GPUMatrix<ElemType>& saveMean, GPUMatrix<ElemType>& saveInvStdDev) const;
@@ -477,6 +636,9 @@ public:
 public:
     // static BLAS functions
     static void MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c);
+    // see Matrix::BatchedMultiplyAndWeightedAdd()
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c,
+                                              size_t m, size_t n, size_t k);
     static void MultiplyAndAdd(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const bool transposeA, const GPUMatrix<ElemType>& b, const bool transposeB, GPUMatrix<ElemType>& c);
     static void Multiply(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c);
@@ -540,7 +702,22 @@ public:
 
     GPUMatrix<ElemType>& AssignElementProductOfWithShift(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const size_t shift);
 
+    void AssignCosDistanceWithNegativeSamplesOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB);
+    static void AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                          const GPUMatrix<ElemType>& value, const GPUMatrix<ElemType>& valueGradient, size_t shift, GPUMatrix<ElemType>& gradient);
+
+    static void AddKhatriRaoProductGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& aGradient, GPUMatrix<ElemType>& bGradient);
+    void AssignDiagTimesOf(const GPUMatrix<ElemType>& diag, const GPUMatrix<ElemType>& a, bool accumulate);
+    void AddRowInnerProductOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b);
+
 public:
+    static void RCRFForwardCompute(GPUMatrix<ElemType>& alpha,
+                                   const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                   const int startLbl);
+    static void RCRFViterbiCompute(GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace, GPUMatrix<ElemType>& decodedPath,
+                                   const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                   const int startLbl, const int endLbl);
     static void RCRFBackwardCompute(
         const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
         const GPUMatrix<ElemType>& lbls,
@@ -566,8 +743,13 @@ public:
         int format;
         stream >> matrixNameDummy >> format >> numRows >> numCols;
         ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        if (stream.IsTextBased())
+        {
+            for (size_t i = 0; i < numRows * numCols; ++i)
+                stream >> d_array[i];
+        }
+        else // in one read, the same bytes as element by element
+            stream.ReadBytes(d_array, numRows * numCols * sizeof(ElemType));
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
         delete[] d_array;
@@ -585,8 +767,13 @@ public:
 
         stream << us.m_numRows << us.m_numCols;
         ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
+        if (stream.IsTextBased())
+        {
+            for (size_t i = 0; i < us.GetNumElements(); ++i)
+                stream << pArray[i];
+        }
+        else // in one write, the same bytes as element by element
+            stream.WriteBytes(pArray, us.GetNumElements() * sizeof(ElemType));
         
         delete[] pArray;
 
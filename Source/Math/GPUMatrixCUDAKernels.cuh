@@ -1408,6 +1408,66 @@ __global__ void _adagrad4BlockSparse(
         multipliers[id] = 1 / temp;
 }
 
+// see CPUMatrix<ElemType>::FusedNormalGrad()
+template <class ElemType>
+__global__ void _fusedNormalGrad(CUDA_LONG size, const ElemType* grad, ElemType* smoothMom, ElemType* val,
+                                 ElemType lr, ElemType mom, bool useNAG, ElemType clipThreshold, ElemType l2RegWeight)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    const ElemType gradWeight = (1 - mom) * lr;
+    for (; idx < size; idx += stride)
+    {
+        ElemType w = val[idx];
+        ElemType g = max(-clipThreshold, min(grad[idx], clipThreshold)) + l2RegWeight * w;
+        ElemType v = mom * smoothMom[idx] + gradWeight * g;
+        smoothMom[idx] = v;
+        val[idx] = w - (useNAG ? mom * v + gradWeight * g : v);
+    }
+}
+
+// see CPUMatrix<ElemType>::FusedAdagrad()
+template <class ElemType>
+__global__ void _fusedAdagrad(CUDA_LONG size, const ElemType* grad, ElemType* a, ElemType* val,
+                              ElemType lr, ElemType clipThreshold, ElemType l2RegWeight)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    const ElemType floor = 1e-16f;
+    for (; idx < size; idx += stride)
+    {
+        ElemType w = val[idx];
+        ElemType g = max(-clipThreshold, min(grad[idx], clipThreshold)) + l2RegWeight * w;
+        ElemType adaSqr = a[idx] + g * g;
+        a[idx] = adaSqr;
+        val[idx] = w - lr * g / sqrt(adaSqr + floor);
+    }
+}
+
+// see CPUMatrix<ElemType>::Adam()
+template <class ElemType>
+__global__ void _adam(CUDA_LONG size, ElemType* grad, ElemType* smoothMom, ElemType* smoothVar, ElemType* val,
+                      ElemType lr, ElemType mom, ElemType varMom, ElemType epsilon, ElemType momCorrection, ElemType varCorrection,
+                      ElemType clipThreshold, ElemType l2RegWeight, bool returnStepInGradients)
+{
+    CUDA_LONG idx = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_LONG stride = blockDim.x * gridDim.x;
+    for (; idx < size; idx += stride)
+    {
+        ElemType w = val[idx];
+        ElemType g = max(-clipThreshold, min(grad[idx], clipThreshold)) + l2RegWeight * w;
+        ElemType m = mom * smoothMom[idx] + (1 - mom) * g;
+        ElemType v = varMom * smoothVar[idx] + (1 - varMom) * g * g;
+        smoothMom[idx] = m;
+        smoothVar[idx] = v;
+        ElemType step = m * momCorrection / (sqrt(v * varCorrection) + epsilon);
+        if (returnStepInGradients)
+            grad[idx] = step;
+        else
+            val[idx] = w - lr * step;
+    }
+}
+
 template <class ElemType>
 __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda, ElemType* smoothMom, ElemType* val,
                            ElemType lr, ElemType mom, ElemType adaWeight, ElemType adaMul)
@@ -1447,6 +1507,45 @@ __global__ void _fsadagrad(CUDA_LONG size, ElemType* grad, ElemType* smoothAda,
     }
 }
 
+// _fsadagrad for the nonzero columns of a sparse block-column gradient
+template <class ElemType>
+__global__ void _fsadagrad4BlockSparseCol(CUDA_LONG nz, const size_t numRows, const ElemType* d_v, const GPUSPARSE_INDEX_TYPE* blockId2Col,
+                                          ElemType* smoothAda, ElemType* smoothMom, ElemType* val,
+                                          ElemType lr, ElemType mom, ElemType adaWeight, ElemType adaMul)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= nz)
+        return;
+
+    CUDA_LONG blockid = id / numRows;
+    CUDA_LONG row = id - blockid * numRows;
+    size_t idx = row + blockId2Col[blockid] * numRows;
+
+    ElemType g = d_v[id];
+    ElemType adaSqr = adaWeight * smoothAda[idx] + (1.0f - adaWeight) * g * g;
+    smoothAda[idx] = adaSqr;
+    if (adaSqr != 0.0f)
+    {
+        ElemType w;
+        if (sizeof(ElemType) == sizeof(double))
+            w = adaMul * rsqrt(adaSqr);
+        else
+            w = adaMul * rsqrtf(adaSqr);
+
+        if (w > 10.0f)
+            w = 10.0f;
+        g *= w;
+    }
+
+    if (mom > 0.0f)
+    {
+        g = mom * smoothMom[idx] + (1.0f - mom) * g;
+        smoothMom[idx] = g;
+    }
+
+    val[idx] -= g * lr;
+}
+
 template <class ElemType>
 __global__ void _rmsprop_init(
     ElemType* avars, ElemType* signs, ElemType* steps,
@@ -1542,6 +1641,24 @@ __global__ void _setMaskAndScale(
     a[id] = a[id] <= maskRate ? 0 : scaleValue;
 }
 
+template <class ElemType>
+__global__ void _randomlyMaskedCopyOf(
+    ElemType* us,
+    const ElemType* a,
+    const CUDA_LONG N,
+    const ElemType beta,
+    const ElemType maskRate,
+    const ElemType scaleValue,
+    const unsigned long long seed,
+    const size_t firstCounter)
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= N)
+        return;
+    ElemType v = UniformRandomOfCounter<ElemType>(seed, firstCounter + id) <= maskRate ? 0 : scaleValue * a[id];
+    us[id] = beta == 0 ? v : beta * us[id] + v;
+}
+
 template <class ElemType>
 __global__ void _vectorSum(
     ElemType* c,       // output
@@ -2944,6 +3061,68 @@ __global__ void _dense1DConvMultSparseCSCTransposeAndAddToDense(
     }
 }
 
+// c = alpha * op(a) * b + beta * c for dense a and sparse CSC b, one thread per element of c
+// This is the plain product (no convolution). For one-hot b (word inputs), each column of c gathers one column of op(a).
+template <class ElemType>
+__global__ void _denseMultSparseCSCAndWeightedAddToDense(
+    int m, // rows of op(a) and c
+    int k, // columns of op(a) and rows of b
+    int n, // columns of b and c
+    ElemType alpha,
+    const ElemType* a, // dense
+    bool transposeA,
+    const ElemType* bnzValues, // sparse nz values
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    ElemType beta,
+    ElemType* c // dense target
+    )
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= m * n)
+        return;
+
+    int colInC = id / m;
+    int rowInC = id - colInC * m;
+
+    ElemType s = 0;
+    for (int j = colCSCIndex[colInC]; j < colCSCIndex[colInC + 1]; j++)
+    {
+        int i = rowIndex[j];
+        s += (transposeA ? a[IDX2C(i, rowInC, k)] : a[IDX2C(rowInC, i, m)]) * bnzValues[j];
+    }
+
+    c[id] = alpha * s + (beta == 0 ? 0 : beta * c[id]); // If beta is zero then don't lookup c
+}
+
+// c += alpha * op(a) * b^T for dense a and sparse CSC b, one thread per element of op(a), i.e. all columns of b in one launch
+// Each element of op(a) is added to the columns of c given by the nonzeros of its column of b,
+// which for one-hot b (the gradient of an embedding) is a scatter-add of the columns of op(a).
+template <class ElemType>
+__global__ void _denseMultSparseCSCTransposeAndAddToDense(
+    int m, // rows of op(a) and c
+    int l, // columns of op(a) and of b
+    ElemType alpha,
+    const ElemType* a, // dense
+    bool transposeA,
+    const ElemType* bnzValues, // sparse nz values
+    const GPUSPARSE_INDEX_TYPE* rowIndex,
+    const GPUSPARSE_INDEX_TYPE* colCSCIndex,
+    ElemType* c // dense target
+    )
+{
+    CUDA_LONG id = blockDim.x * blockIdx.x + threadIdx.x;
+    if (id >= m * l)
+        return;
+
+    int colInA = id / m;
+    int rowInA = id - colInA * m;
+
+    ElemType s = alpha * (transposeA ? a[IDX2C(colInA, rowInA, l)] : a[id]);
+    for (int j = colCSCIndex[colInA]; j < colCSCIndex[colInA + 1]; j++)
+        atomicAdd(&c[IDX2C(rowInA, rowIndex[j], m)], s * bnzValues[j]); // columns of b may share rows
+}
+
 template <class ElemType>
 __global__ void _reshape(
     const int oldNumRows,                       // old row count
@@ -3530,6 +3709,66 @@ __global__ void _assignSoftmaxSumMax512Threads(
         c[0] = -partials[0];
 }
 
+// GMM log-likelihood of a column of 'feature', one thread per column, see Matrix<ElemType>::AssignGMMLogLikelihoodOf().
+// The parameter strides are 0 for parameters shared by all columns.
+// The log-likelihoods of the components are kept in 'posterior' until their log-sum-exp is known.
+template <class ElemType>
+__global__ void _assignGMMLogLikelihood(
+    ElemType* logLikelihood,
+    const ElemType* prior,
+    const CUDA_LONG priorStride,
+    const ElemType* mean,
+    const CUDA_LONG meanStride,
+    const ElemType* stddev,
+    const CUDA_LONG stddevStride,
+    const ElemType* feature,
+    ElemType* normedDeviationVectors,
+    ElemType* normedDeviation,
+    ElemType* posterior,
+    const CUDA_LONG numComponents,
+    const CUDA_LONG featureDim,
+    const CUDA_LONG numSamples)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(j, numSamples);
+
+    const ElemType* x = feature + j * featureDim;
+    const ElemType* p = prior + j * priorStride;
+    const ElemType* s = stddev + j * stddevStride;
+    const ElemType* mu = mean + j * meanStride;
+    ElemType* dev = normedDeviationVectors + j * numComponents * featureDim;
+    ElemType* nd = normedDeviation + j * numComponents;
+    ElemType* post = posterior + j * numComponents;
+    // (the normalization uses the number of components, as the gradient w.r.t. the log stddev does)
+    const ElemType logNormalizer = numComponents / (ElemType) 2 * log_((ElemType) TWO_PI);
+
+    ElemType maxLogLikelihood = -FLT_MAX;
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+    {
+        const ElemType variance = s[c] * s[c];
+        const ElemType* muc = mu + c * featureDim;
+        ElemType* devc = dev + c * featureDim;
+        ElemType sum = 0;
+        for (CUDA_LONG k = 0; k < featureDim; k++)
+        {
+            ElemType d = x[k] - muc[k];
+            sum += d * d;
+            devc[k] = d / variance;
+        }
+        nd[c] = sum / variance;
+        post[c] = log_(p[c]) - nd[c] / 2 - numComponents / (ElemType) 2 * log_(variance) - logNormalizer;
+        maxLogLikelihood = max(maxLogLikelihood, post[c]);
+    }
+
+    ElemType sum = 0;
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+        sum += exp_(post[c] - maxLogLikelihood);
+    const ElemType ll = maxLogLikelihood + log_(sum);
+
+    for (CUDA_LONG c = 0; c < numComponents; c++)
+        post[c] = exp_(post[c] - ll);
+    logLikelihood[j] = ll;
+}
+
 template <class ElemType>
 __global__ void _assignNoiseContrastiveEstimationMax512Threads(
     const ElemType* val,
@@ -4560,6 +4799,186 @@ __global__ void _assignElementProductOfWithShift(
     us[id] = a[id] * b[tmpidb];
 }
 
+// inverse norms of the columns of a and b, one thread per column, see Matrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf()
+template <class ElemType>
+__global__ void _assignColumnInverseNorms(
+    ElemType* invNormA,
+    ElemType* invNormB,
+    const ElemType* a,
+    const ElemType* b,
+    const CUDA_LONG dim,
+    const CUDA_LONG n)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(j, n);
+    const ElemType* aj = a + j * dim;
+    const ElemType* bj = b + j * dim;
+    ElemType sumA = 0, sumB = 0;
+    for (CUDA_LONG k = 0; k < dim; k++)
+    {
+        sumA += aj[k] * aj[k];
+        sumB += bj[k] * bj[k];
+    }
+    invNormA[j] = 1 / max(sqrt_(sumA), (ElemType) EPS_IN_INVERSE);
+    invNormB[j] = 1 / max(sqrt_(sumB), (ElemType) EPS_IN_INVERSE);
+}
+
+// one thread per similarity, see Matrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf()
+template <class ElemType>
+__global__ void _assignCosDistanceWithNegativeSamples(
+    ElemType* us,
+    const ElemType* a,
+    const ElemType* b,
+    const ElemType* invNormA,
+    const ElemType* invNormB,
+    const CUDA_LONG dim,
+    const CUDA_LONG n,
+    const CUDA_LONG shift,
+    const CUDA_LONG numRows)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, numRows * n);
+    CUDA_LONG i = id % numRows;
+    CUDA_LONG j = id / numRows;
+    CUDA_LONG col = (i == 0) ? j : (j + shift + i - 1) % n;
+    const ElemType* aj = a + j * dim;
+    const ElemType* bcol = b + col * dim;
+    ElemType dot = 0;
+    for (CUDA_LONG k = 0; k < dim; k++)
+        dot += aj[k] * bcol[k];
+    us[id] = dot * invNormA[j] * invNormB[col];
+}
+
+// one thread per element of the gradient, summing over the similarities of its column,
+// see CPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient()
+template <class ElemType>
+__global__ void _addCosDistanceWithNegativeSamplesGradient(
+    ElemType* gradient,
+    const ElemType* self,
+    const ElemType* other,
+    const ElemType* invNormSelf,
+    const ElemType* invNormOther,
+    const ElemType* value,
+    const ElemType* valueGradient,
+    const bool isRight, // gradient w.r.t. b, whose columns are shifted
+    const CUDA_LONG dim,
+    const CUDA_LONG n,
+    const CUDA_LONG shift,
+    const CUDA_LONG numRows)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, dim * n);
+    CUDA_LONG k = id % dim;
+    CUDA_LONG j = id / dim;
+    ElemType sum = 0;
+    for (CUDA_LONG i = 0; i < numRows; i++)
+    {
+        CUDA_LONG rowShift = (i == 0) ? 0 : (shift + i - 1) % n;
+        CUDA_LONG col = isRight ? (j + n - rowShift) % n : (j + rowShift) % n;
+        CUDA_LONG valueIndex = i + (isRight ? col : j) * numRows;
+        ElemType g = valueGradient[valueIndex];
+        sum += g * invNormSelf[j] * (invNormOther[col] * other[k + col * dim] - value[valueIndex] * invNormSelf[j] * self[id]);
+    }
+    gradient[id] += sum;
+}
+
+// one block per column k, see CPUMatrix<ElemType>::AddKhatriRaoProductGradient()
+// The threads first stride over the rows of aGradient, each summing over the segments of the gradient column,
+// then each warp reduces the inner product of one segment with a_k at a time for bGradient. Both phases read the gradient coalesced.
+// This function assumes 256 threads (8 warps) per block.
+template <class ElemType>
+__global__ void _addKhatriRaoProductGradient256Threads(
+    const ElemType* gradient,
+    const ElemType* a,
+    const ElemType* b,
+    ElemType* aGradient,
+    ElemType* bGradient,
+    const CUDA_LONG rowsA,
+    const CUDA_LONG rowsB)
+{
+    __shared__ ElemType partials[256];
+    const CUDA_LONG k = blockIdx.x;
+    const ElemType* gk = gradient + (size_t) k * rowsA * rowsB;
+    const ElemType* ak = a + (size_t) k * rowsA;
+    const ElemType* bk = b + (size_t) k * rowsB;
+
+    // aGradient_k += G_k b_k
+    for (CUDA_LONG i = threadIdx.x; i < rowsA; i += 256)
+    {
+        ElemType sum = 0;
+        for (CUDA_LONG j = 0; j < rowsB; j++)
+            sum += gk[i + j * rowsA] * bk[j];
+        aGradient[i + (size_t) k * rowsA] += sum;
+    }
+
+    // bGradient_k += G_k^T a_k, one segment per warp
+    const CUDA_LONG lane = threadIdx.x % 32;
+    const CUDA_LONG warp = threadIdx.x / 32;
+    for (CUDA_LONG j0 = 0; j0 < rowsB; j0 += 8) // (all threads run every iteration, for the __syncthreads() inside)
+    {
+        const CUDA_LONG j = j0 + warp;
+        ElemType dot = 0;
+        if (j < rowsB)
+        {
+            for (CUDA_LONG i = lane; i < rowsA; i += 32)
+                dot += gk[i + j * rowsA] * ak[i];
+        }
+        partials[threadIdx.x] = dot;
+        __syncthreads();
+        for (CUDA_LONG s = 16; s > 0; s /= 2)
+        {
+            if (lane < s)
+                partials[threadIdx.x] += partials[threadIdx.x + s];
+            __syncthreads();
+        }
+        if (lane == 0 && j < rowsB)
+            bGradient[j + (size_t) k * rowsB] += partials[threadIdx.x];
+    }
+}
+
+// us = diag(d) * a, or us += diag(d) * a if 'accumulate'
+template <class ElemType>
+__global__ void _assignDiagTimesOf(
+    ElemType* us,
+    const ElemType* diag,
+    const ElemType* a,
+    const CUDA_LONG rows,
+    const CUDA_LONG N,
+    const bool accumulate)
+{
+    CALCULATE_ELEMENTWISE_INDEX_OR_EXIT(id, N);
+    ElemType value = diag[id % rows] * a[id];
+    us[id] = accumulate ? us[id] + value : value;
+}
+
+// us(i, 0) += sum_j a(i, j) * b(i, j), a block of 32 rows per block, see Matrix<ElemType>::AddRowInnerProductOf()
+// Each of the 16 warps of a block sums every 16th column of the rows of the block, then the warps' sums are reduced in shared memory.
+// This function assumes 512 threads per block.
+template <class ElemType>
+__global__ void _addRowInnerProductOf512Threads(
+    ElemType* us,
+    const ElemType* a,
+    const ElemType* b,
+    const CUDA_LONG rows,
+    const CUDA_LONG cols)
+{
+    __shared__ ElemType partials[512];
+    const CUDA_LONG i = blockIdx.x * 32 + threadIdx.x % 32;
+    ElemType sum = 0;
+    if (i < rows)
+    {
+        for (CUDA_LONG j = threadIdx.x / 32; j < cols; j += 16)
+            sum += a[i + (size_t) j * rows] * b[i + (size_t) j * rows];
+    }
+    partials[threadIdx.x] = sum;
+    __syncthreads();
+    for (CUDA_LONG s = 256; s >= 32; s /= 2)
+    {
+        if (threadIdx.x < s)
+            partials[threadIdx.x] += partials[threadIdx.x + s];
+        __syncthreads();
+    }
+    if (threadIdx.x < 32 && i < rows)
+        us[i] += partials[threadIdx.x];
+}
+
 // minus 1 at a specific position
 template <class ElemType>
 __global__ void _minusOneAt(
@@ -4793,6 +5212,110 @@ __global__ void _rcrfTransGrdComputeMax1024Labels(
     }
 };
 
+// $\alpha_t(k) = s_t(k) + \log \sum_j \exp(\alpha_{t-1}(j) + a_{kj})$, with $\alpha_{-1}$ being 0 for the start label and LZERO otherwise.
+// Runs the entire recursion over t; each thread computes one label, alpha_{t-1} is kept in shared memory.
+// This function assumes iNumLab <= 1024 and that it is launched as a single block of iNumLab threads.
+template <class ElemType>
+__global__ void _rcrfForwardComputeMax1024Labels(
+    const ElemType* gpos_scores,
+    const ElemType* gpair_scores,
+    ElemType* galpha,
+    const size_t iNumPos,
+    const size_t iNumLab,
+    const int start_lbl)
+{
+    int id = threadIdx.x;
+
+    extern __shared__ double sh_alpha_and_beta[]; // [id]
+    ElemType* alpha = (ElemType*) (sh_alpha_and_beta);
+
+    for (size_t t = 0; t < iNumPos; t++)
+    {
+        ElemType fTmp = LZERO;
+        for (int j = 0; j < iNumLab; j++)
+        {
+            ElemType fAlpha;
+            if (t > 0)
+                fAlpha = alpha[j];
+            else
+                fAlpha = (j == start_lbl) ? 0 : LZERO;
+            fTmp = logaddk(fTmp, fAlpha + gpair_scores[IDX2C(id, j, iNumLab)]);
+        }
+        fTmp += gpos_scores[IDX2C(id, t, iNumLab)]; // include position dependent score
+
+        __syncthreads(); // all threads are done reading alpha_{t-1}
+        alpha[id] = fTmp;
+        galpha[IDX2C(id, t, iNumLab)] = fTmp;
+        __syncthreads();
+    }
+}
+
+// Viterbi version of the above: max instead of log-sum, plus the back pointers. The first label is constrained to be start_lbl.
+// This function assumes iNumLab <= 1024 and that it is launched as a single block of iNumLab threads.
+template <class ElemType>
+__global__ void _rcrfViterbiComputeMax1024Labels(
+    const ElemType* gpos_scores,
+    const ElemType* gpair_scores,
+    ElemType* galpha,
+    ElemType* gbacktrace,
+    const size_t iNumPos,
+    const size_t iNumLab,
+    const int start_lbl)
+{
+    int id = threadIdx.x;
+
+    extern __shared__ double sh_alpha_and_beta[]; // [id]
+    ElemType* alpha = (ElemType*) (sh_alpha_and_beta);
+
+    for (size_t t = 0; t < iNumPos; t++)
+    {
+        ElemType fTmp = LZERO;
+        int iTmp = start_lbl;
+        if (t > 1)
+        {
+            for (int j = 0; j < iNumLab; j++)
+            {
+                ElemType fAlpha = alpha[j] + gpair_scores[IDX2C(id, j, iNumLab)];
+                if (fAlpha > fTmp)
+                {
+                    fTmp = fAlpha;
+                    iTmp = j;
+                }
+            }
+            fTmp += gpos_scores[IDX2C(id, t, iNumLab)]; // include position dependent score
+        }
+        else if (t == 1)
+            fTmp = alpha[start_lbl] + gpair_scores[IDX2C(id, start_lbl, iNumLab)] + gpos_scores[IDX2C(id, t, iNumLab)];
+        else if (id == start_lbl)
+            fTmp = gpos_scores[IDX2C(id, t, iNumLab)];
+
+        __syncthreads(); // all threads are done reading alpha_{t-1}
+        alpha[id] = fTmp;
+        galpha[IDX2C(id, t, iNumLab)] = fTmp;
+        gbacktrace[IDX2C(id, t, iNumLab)] = (ElemType) iTmp;
+        __syncthreads();
+    }
+}
+
+// follows the Viterbi back pointers from end_lbl at the last position; decodedPath must be zero on entry
+// This function is launched with a single thread.
+template <class ElemType>
+__global__ void _rcrfViterbiBacktrace(
+    const ElemType* gbacktrace,
+    ElemType* gdecodedPath,
+    const size_t iNumPos,
+    const size_t iNumLab,
+    const int end_lbl)
+{
+    size_t lastLbl = end_lbl;
+    gdecodedPath[IDX2C(lastLbl, iNumPos - 1, iNumLab)] = 1;
+    for (size_t t = iNumPos - 1; t > 0; t--)
+    {
+        lastLbl = (size_t) gbacktrace[IDX2C(lastLbl, t, iNumLab)];
+        gdecodedPath[IDX2C(lastLbl, t - 1, iNumLab)] = 1;
+    }
+}
+
 template <class ElemType>
 __global__ void _reductionLogAddSum(
     const ElemType* data,
@@ -10,6 +10,7 @@
 
 #include "GPUSparseMatrix.h"
 #include "GPUMatrix.h"
+#include "CUDAPageLockedMemAllocator.h"
 #include <cuda_runtime.h>
 #include <cusparse_v2.h>
 #include "cublas_v2.h"
@@ -18,6 +19,9 @@
 #include "CommonMatrix.h"
 #include <iostream> // for cout/cerr
 #include <assert.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
 
 typedef unsigned char byte;
 
@@ -41,6 +45,112 @@ const char* CudaErrString<cusparseStatus_t>(cusparseStatus_t)
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Pinned host buffers through which sparse matrices are copied from the CPU to the GPU.
+// A copy from pageable memory blocks the host until the GPU has finished all queued work, whereas the copy from
+// pinned memory is queued on t_stream and returns immediately, so that e.g. the next minibatch is prepared while
+// the GPU is still computing the previous one. The buffers of a device are used round-robin; a buffer is only
+// overwritten after its previous copy has completed. They are allocated on first use and kept for the lifetime of the process.
+class PinnedStaging
+{
+public:
+    struct Piece
+    {
+        void* dst; // device
+        const void* src; // host
+        size_t bytes;
+    };
+
+    // copy the pieces to the GPU asynchronously; the host sources can be reused when this returns
+    static void CopyToDeviceAsync(DEVICEID_TYPE deviceId, const Piece* pieces, size_t numPieces)
+    {
+        size_t totalBytes = 0;
+        for (size_t i = 0; i < numPieces; i++)
+            totalBytes += AlignedSize(pieces[i].bytes);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Slot& slot = AcquireSlot(deviceId, totalBytes);
+        char* staged = slot.buffer;
+        for (size_t i = 0; i < numPieces; i++)
+        {
+            if (pieces[i].bytes == 0)
+                continue;
+            memcpy(staged, pieces[i].src, pieces[i].bytes);
+            CUDA_CALL(cudaMemcpyAsync(pieces[i].dst, staged, pieces[i].bytes, cudaMemcpyHostToDevice, t_stream));
+            staged += AlignedSize(pieces[i].bytes);
+        }
+        CUDA_CALL(cudaEventRecord(slot.copyCompleteEvent, t_stream));
+        slot.isInUse = true;
+    }
+
+    // a pinned buffer for a synchronous round trip through the host
+    static void* Reserve(DEVICEID_TYPE deviceId, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return AcquireSlot(deviceId, bytes).buffer;
+    }
+
+private:
+    static const size_t s_numSlots = 4;
+    struct Slot
+    {
+        char* buffer;
+        size_t size;
+        cudaEvent_t copyCompleteEvent;
+        bool isInUse;
+    };
+    struct DeviceSlots
+    {
+        Slot slots[s_numSlots];
+        size_t next;
+    };
+
+    static size_t AlignedSize(size_t bytes) { return (bytes + 15) & ~(size_t) 15; }
+
+    // the next slot of the device, with at least 'bytes' of space; waits for its previous copy
+    static Slot& AcquireSlot(DEVICEID_TYPE deviceId, size_t bytes)
+    {
+        auto iter = s_deviceSlots.find(deviceId);
+        if (iter == s_deviceSlots.end())
+        {
+            DeviceSlots deviceSlots;
+            for (size_t i = 0; i < s_numSlots; i++)
+            {
+                deviceSlots.slots[i].buffer = nullptr;
+                deviceSlots.slots[i].size = 0;
+                deviceSlots.slots[i].isInUse = false;
+                CUDA_CALL(cudaEventCreateWithFlags(&deviceSlots.slots[i].copyCompleteEvent, cudaEventDisableTiming));
+            }
+            deviceSlots.next = 0;
+            iter = s_deviceSlots.insert(std::make_pair(deviceId, deviceSlots)).first;
+        }
+
+        DeviceSlots& deviceSlots = iter->second;
+        Slot& slot = deviceSlots.slots[deviceSlots.next];
+        deviceSlots.next = (deviceSlots.next + 1) % s_numSlots;
+        if (slot.isInUse)
+        {
+            CUDA_CALL(cudaEventSynchronize(slot.copyCompleteEvent));
+            slot.isInUse = false;
+        }
+        if (slot.size < bytes)
+        {
+            if (slot.buffer)
+                CUDAPageLockedMemAllocator::Free(slot.buffer, deviceId);
+            slot.buffer = nullptr;
+            size_t size = std::max(bytes, 2 * slot.size); // grow geometrically, since minibatches vary in size
+            slot.buffer = (char*) CUDAPageLockedMemAllocator::Malloc(size, deviceId); // on the NUMA node of the device if enabled
+            slot.size = size;
+        }
+        return slot;
+    }
+
+    static std::mutex s_mutex;
+    static std::map<DEVICEID_TYPE, DeviceSlots> s_deviceSlots;
+};
+
+std::mutex PinnedStaging::s_mutex;
+std::map<DEVICEID_TYPE, PinnedStaging::DeviceSlots> PinnedStaging::s_deviceSlots;
+
 #pragma region Constructors and Destructor
 
 template <class ElemType>
@@ -165,6 +275,13 @@ void GPUSparseMatrix<ElemType>::SetValue(const CPUSparseMatrix<ElemType>& deepCo
     {
         SetMatrixFromCSCFormat(deepCopy.ColLocation(), deepCopy.RowLocation(), deepCopy.Data(), deepCopy.GetNumElemAllocated(), deepCopy.GetNumRows(), deepCopy.GetNumCols());
     }
+    else if (deepCopy.GetFormat() == matrixFormatSparseBlockCol)
+    {
+        std::vector<size_t> blockIds;
+        std::vector<ElemType> val;
+        deepCopy.GetMatrixFromSBCFormat(blockIds, val);
+        SetMatrixFromSBCFormat(blockIds.data(), val.data(), blockIds.size(), deepCopy.GetNumRows(), deepCopy.GetNumCols());
+    }
     else
         NOT_IMPLEMENTED;
 }
@@ -324,22 +441,32 @@ void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat, GP
     SyncGuard syncGuard;
     CUSPARSE_CALL(cusparseSetStream(cusparseHandle, t_stream));
 
+    // (the number of elements in use, not GetSizeAllocated(), which may exceed it and thus outMatrix)
+    int nz = NzCount();
     outMatrix.ChangeDeviceTo(GetComputeDeviceId());
-    outMatrix.RequireSizeAndAllocate(GetNumRows(), GetNumCols(), NzCount(), newFormat, true, false);
+    outMatrix.RequireSizeAndAllocate(GetNumRows(), GetNumCols(), nz, newFormat, true, false);
 
     if ((oldFormat == matrixFormatSparseCSR && newFormat == matrixFormatSparseCSC) || (oldFormat == matrixFormatSparseCSC && newFormat == matrixFormatSparseCSR))
     {
+        // csr2csc() also converts CSC to CSR, as the CSC of a matrix is the CSR of its transpose
+        bool isCSR = oldFormat == matrixFormatSparseCSR;
+        int m = (int) (isCSR ? GetNumRows() : GetNumCols());
+        int n = (int) (isCSR ? GetNumCols() : GetNumRows());
+        GPUSPARSE_INDEX_TYPE* secondaryIndex = isCSR ? RowLocation() : ColLocation();
+        GPUSPARSE_INDEX_TYPE* majorIndex = isCSR ? ColLocation() : RowLocation();
+        GPUSPARSE_INDEX_TYPE* outMajorIndex = isCSR ? outMatrix.RowLocation() : outMatrix.ColLocation();
+        GPUSPARSE_INDEX_TYPE* outSecondaryIndex = isCSR ? outMatrix.ColLocation() : outMatrix.RowLocation();
         if (sizeof(ElemType) == sizeof(float))
         {
-            CUSPARSE_CALL(cusparseScsr2csc(cusparseHandle, int(GetNumRows()), int(GetNumCols()), int(GetSizeAllocated()),
-                                           (float*) Data(), RowLocation(), ColLocation(), (float*) outMatrix.Data(),
-                                           outMatrix.RowLocation(), outMatrix.ColLocation(), CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
+            CUSPARSE_CALL(cusparseScsr2csc(cusparseHandle, m, n, nz,
+                                           (float*) Data(), secondaryIndex, majorIndex, (float*) outMatrix.Data(),
+                                           outMajorIndex, outSecondaryIndex, CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
         }
         else
         {
-            CUSPARSE_CALL(cusparseDcsr2csc(cusparseHandle, int(GetNumRows()), int(GetNumCols()), int(GetSizeAllocated()),
-                                           (double*) Data(), RowLocation(), ColLocation(), (double*) outMatrix.Data(),
-                                           outMatrix.RowLocation(), outMatrix.ColLocation(), CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
+            CUSPARSE_CALL(cusparseDcsr2csc(cusparseHandle, m, n, nz,
+                                           (double*) Data(), secondaryIndex, majorIndex, (double*) outMatrix.Data(),
+                                           outMajorIndex, outSecondaryIndex, CUSPARSE_ACTION_NUMERIC, CUSPARSE_INDEX_BASE_ZERO));
         }
     }
     else
@@ -369,6 +496,31 @@ void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat)
     *this = std::move(tempMatrix);
 }
 
+// The conversion is kept with the storage, where other views of the same columns find it too, e.g. the several
+// TimesNodes that consume one sparse input. It is redone after any write to the storage (see VerifyWritable()),
+// into the buffer of the previous conversion.
+template <class ElemType>
+const GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::GetConvertedSparseFormat(MatrixFormat newFormat) const
+{
+    if (GetFormat() == newFormat)
+        return *this;
+
+    auto& cache = Base::StorageConvertedCopy();
+    if (!cache.matrix || cache.format != newFormat || cache.writeCount != Base::GetStorageWriteCount() ||
+        cache.sliceViewOffset != m_sliceViewOffset || cache.numRows != GetNumRows() || cache.numCols != GetNumCols())
+    {
+        if (!cache.matrix)
+            cache.matrix = make_shared<GPUSparseMatrix<ElemType>>(GetComputeDeviceId(), newFormat);
+        ConvertToSparseFormat(newFormat, static_cast<GPUSparseMatrix<ElemType>&>(*cache.matrix)); // (only GPUSparseMatrix uses the cache)
+        cache.format = newFormat;
+        cache.writeCount = Base::GetStorageWriteCount();
+        cache.sliceViewOffset = m_sliceViewOffset;
+        cache.numRows = GetNumRows();
+        cache.numCols = GetNumCols();
+    }
+    return static_cast<const GPUSparseMatrix<ElemType>&>(*cache.matrix);
+}
+
 template <class ElemType>
 GPUMatrix<ElemType> GPUSparseMatrix<ElemType>::CopyToDenseMatrix() const
 {
@@ -409,15 +561,12 @@ void GPUSparseMatrix<ElemType>::ChangeDeviceTo(DEVICEID_TYPE to_id)
         }
         else
         {
-            // peer access didn't work, just copy normal
-            // make this more efficient by keeping some buffers available for each copy
-            ElemType* h_dst = NULL;
+            // peer access didn't work, just copy normal, through a pinned staging buffer
             PrepareDevice();
-            CUDA_CALL(cudaMallocHost((void**) &h_dst, BufferSizeAllocated()));
+            void* h_dst = PinnedStaging::Reserve(GetComputeDeviceId(), BufferSizeAllocated());
             CUDA_CALL(cudaMemcpy(h_dst, Buffer(), BufferSizeAllocated(), cudaMemcpyDeviceToHost));
             PrepareDevice((DEVICEID_TYPE) to_id);
             CUDA_CALL(cudaMemcpy(d_dst, h_dst, BufferSizeAllocated(), cudaMemcpyHostToDevice));
-            CUDA_CALL(cudaFreeHost(h_dst));
         }
 
         TracingGPUMemoryAllocator::Free<ElemType>(GetComputeDeviceId(), Buffer());
@@ -823,6 +972,16 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSRFormat(const GPUSPARSE_INDEX_TYP
     SetFormat(matrixFormatSparseCSR);
     RequireSizeAndAllocate(numRows, numCols, nz, true, false);
 
+    if (!IsOnDevice && (sizeof(CPUSPARSE_INDEX_TYPE) == sizeof(GPUSPARSE_INDEX_TYPE)))
+    {
+        // see ColSize() comment below
+        PinnedStaging::Piece pieces[] = { { Data(), h_Val, nz * sizeof(ElemType) },
+                                          { RowLocation(), h_CSRRow, RowSize() },
+                                          { ColLocation(), h_Col, nz * sizeof(GPUSPARSE_INDEX_TYPE) } };
+        PinnedStaging::CopyToDeviceAsync(GetComputeDeviceId(), pieces, _countof(pieces));
+        return;
+    }
+
     cudaMemcpyKind kind = IsOnDevice ? cudaMemcpyDeviceToDevice : cudaMemcpyHostToDevice;
     CUDA_CALL(cudaMemcpy(Data(), h_Val, nz * sizeof(ElemType), kind));
 
@@ -898,16 +1057,35 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
 {
     VerifyWritable(__func__);
 
-    if (h_CSCCol == nullptr || h_Row == nullptr || h_Val == nullptr)
+    // (h_Val is null for values that are all 1, which are set here instead of being transferred)
+    if (h_CSCCol == nullptr || h_Row == nullptr)
         LogicError("SetMatrixFromCSCFormat: nullptr passed in.");
 
     SetComputeDeviceId(PrepareDevice(devId));
     SetFormat(matrixFormatSparseCSC);
     RequireSizeAndAllocate(numRows, numCols, nz, true, false);
 
+    if (h_Val == nullptr && nz > 0)
+    {
+        CUDA_LONG N = (CUDA_LONG) nz;
+        int blocksPerGrid = (int) ceil(1.0 * N / GridDim::maxThreadsPerBlock);
+        SyncGuard syncGuard;
+        _setValue<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(Data(), (ElemType) 1, N);
+    }
+
+    if (!IsOnDevice && (sizeof(CPUSPARSE_INDEX_TYPE) == sizeof(GPUSPARSE_INDEX_TYPE)))
+    {
+        PinnedStaging::Piece pieces[] = { { RowLocation(), h_Row, sizeof(GPUSPARSE_INDEX_TYPE) * nz },
+                                          { ColLocation(), h_CSCCol, sizeof(GPUSPARSE_INDEX_TYPE) * (numCols + 1) },
+                                          { Data(), h_Val, h_Val ? nz * sizeof(ElemType) : 0 } };
+        PinnedStaging::CopyToDeviceAsync(GetComputeDeviceId(), pieces, _countof(pieces));
+        return;
+    }
+
 	// m_nz doesn't exist anymore. How are we going to deal with the NzSize, RowSize, and ColSize? Do it ourselves of course.
     cudaMemcpyKind kind = IsOnDevice ? cudaMemcpyDeviceToDevice : cudaMemcpyHostToDevice;
-    CUDA_CALL(cudaMemcpy(Data(), h_Val, nz * sizeof(ElemType), kind));
+    if (h_Val)
+        CUDA_CALL(cudaMemcpy(Data(), h_Val, nz * sizeof(ElemType), kind));
 
     if (sizeof(CPUSPARSE_INDEX_TYPE) == sizeof(GPUSPARSE_INDEX_TYPE))
     {
@@ -928,6 +1106,46 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     }
 }
 
+// Note: ColOrRow2BlockId() is not set, as it is only used while computing a block-column product.
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    VerifyWritable(__func__);
+    if (numBlocks > numCols)
+        InvalidArgument("SetMatrixFromSBCFormat: More blocks (%d) than columns (%d).", (int) numBlocks, (int) numCols);
+
+    PrepareDevice();
+    SetFormat(matrixFormatSparseBlockCol);
+    RequireSizeAndAllocate(numRows, numCols, numBlocks * numRows, true, false);
+    SetBlockSize(numBlocks);
+    if (numBlocks == 0)
+        return;
+
+    std::vector<GPUSPARSE_INDEX_TYPE> ids(blockIds, blockIds + numBlocks);
+    PinnedStaging::Piece pieces[] = { { BlockId2ColOrRow(), ids.data(), sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks },
+                                      { Data(), val, sizeof(ElemType) * numBlocks * numRows } };
+    PinnedStaging::CopyToDeviceAsync(GetComputeDeviceId(), pieces, _countof(pieces));
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const
+{
+    if (GetFormat() != matrixFormatSparseBlockCol)
+        LogicError("GetMatrixFromSBCFormat: The matrix is not in sparse block-column format.");
+
+    size_t numBlocks = GetBlockSize();
+    blockIds.resize(numBlocks);
+    val.resize(numBlocks * GetNumRows());
+    if (numBlocks == 0)
+        return;
+
+    PrepareDevice();
+    std::vector<GPUSPARSE_INDEX_TYPE> ids(numBlocks);
+    CUDA_CALL(cudaMemcpy(ids.data(), BlockId2ColOrRow(), sizeof(GPUSPARSE_INDEX_TYPE) * numBlocks, cudaMemcpyDeviceToHost));
+    CUDA_CALL(cudaMemcpy(val.data(), Data(), sizeof(ElemType) * val.size(), cudaMemcpyDeviceToHost));
+    blockIds.assign(ids.begin(), ids.end());
+}
+
 // this function will allocate memory while the caller needs to release it
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::GetMatrixFromCSCFormat(GPUSPARSE_INDEX_TYPE*& h_CSCCol, GPUSPARSE_INDEX_TYPE*& h_Row, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const
@@ -1005,13 +1223,29 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     c.PrepareDevice();
     if (rhs.GetFormat() == MatrixFormat::matrixFormatSparseCSC)
     {
-        ConvolveAndWeightedAdd(alpha, lhs, transposeA, rhs, transposeB, beta, c, 1, 1, false, false);
+        // one launch for all columns; ConvolveAndWeightedAdd() needs one per column if transposeB
+        if (!transposeB)
+        {
+            int blocksPerGrid = (int) ceil(1.0 * m * n / GridDim::maxThreadsPerBlock);
+            SyncGuard syncGuard;
+            _denseMultSparseCSCAndWeightedAddToDense<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                m, k, n, alpha, lhs.Data(), transposeA, rhs.Buffer(), rhs.RowLocation(), rhs.ColLocation(), beta, c.Data());
+        }
+        else
+        {
+            if (beta == 0)
+                c.SetValue(0);
+            else if (beta != 1)
+                GPUMatrix<ElemType>::Scale(beta, c);
+            int blocksPerGrid = (int) ceil(1.0 * m * l / GridDim::maxThreadsPerBlock);
+            SyncGuard syncGuard;
+            _denseMultSparseCSCTransposeAndAddToDense<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>(
+                m, l, alpha, lhs.Data(), transposeA, rhs.Buffer(), rhs.RowLocation(), rhs.ColLocation(), c.Data());
+        }
     }
     else if (rhs.GetFormat() == matrixFormatSparseCSR)
     {
-        GPUSparseMatrix<ElemType> tempMatrix(rhs.GetComputeDeviceId(), matrixFormatSparseCSC);
-        rhs.ConvertToSparseFormat(matrixFormatSparseCSC, tempMatrix);
-        MultiplyAndWeightedAdd(alpha, lhs, transposeA, tempMatrix, transposeB, beta, c);
+        MultiplyAndWeightedAdd(alpha, lhs, transposeA, rhs.GetConvertedSparseFormat(matrixFormatSparseCSC), transposeB, beta, c);
     }
     else
     {
@@ -1457,6 +1691,32 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
     }
 }
 
+// see CPUSparseMatrix::FSAdagrad(); only the columns present in the gradient are updated
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        NOT_IMPLEMENTED;
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+    assert((c.GetNumRows() == GetNumRows()) && (c.GetNumCols() == numColsNeeded));
+
+    let nz = NzCount();
+    if (nz == 0)
+        return;
+    size_t n = GetNumElements();
+    int blocksPerGrid = (nz + GridDim::maxThreadsPerBlock - 1) / GridDim::maxThreadsPerBlock;
+    SyncGuard syncGuard;
+    _fsadagrad4BlockSparseCol<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock, 0, t_stream>>>((CUDA_LONG) nz, GetNumRows(), Data(), BlockId2ColOrRow(),
+                                                                                                   c.Data(), c.Data() + n, functionValues.Data(),
+                                                                                                   learnRatePerSample, momentum, adaWeight, adaMul);
+}
+
 // sparse X dense = dense
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
@@ -1473,6 +1733,10 @@ void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPU
     if (a.GetComputeDeviceId() != b.GetComputeDeviceId() || (b.GetComputeDeviceId() != a.GetComputeDeviceId()))
         RuntimeError("MultiplyAndWeightedAdd: All matrices must be on the same GPU");
 
+    // the reinterpretation would need the transposed csrmm, which is much slower than converting 'a' (once, as it is cached)
+    if (reinterpretAsCSR && !transposeA && !a.IsView())
+        return MultiplyAndWeightedAdd(alpha, a.GetConvertedSparseFormat(matrixFormatSparseCSR), transposeA, b, transposeB, beta, c);
+
     a.PrepareDevice();
     cusparseHandle_t cusparseHandle = 0;
     CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
@@ -1822,44 +2086,17 @@ ElemType GPUSparseMatrix<ElemType>::InnerProductOfMatrices(const GPUSparseMatrix
 
     int m = (int) a.GetNumRows();
     int n = (int) a.GetNumCols();
-    int nnz = (int) a.GetNumNZElements();
 
-    ElemType* cscValA = nullptr;
-    GPUSPARSE_INDEX_TYPE* cscRowIndA = nullptr;
-    GPUSPARSE_INDEX_TYPE* cscColPtrA = nullptr;
-
-    cusparseAction_t cpVals = CUSPARSE_ACTION_NUMERIC;
     cusparseIndexBase_t idxBase = CUSPARSE_INDEX_BASE_ZERO;
     cusparseHandle_t cusparseHandle = 0;
+    CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
 
-    if (a.GetFormat() == matrixFormatSparseCSR) // need to put a in ColumnMajor format
-    {
-        cscValA = TracingGPUMemoryAllocator::Allocate<ElemType>(a.GetComputeDeviceId(), nnz);
-        cscRowIndA = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), nnz);
-        cscColPtrA = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), (n + 1));
-
-        CUSPARSE_CALL(cusparseCreate(&cusparseHandle));
-        SyncGuard syncGuard;
-        if (sizeof(ElemType) == sizeof(float))
-        {
-            CUSPARSE_CALL(cusparseScsr2csc(cusparseHandle, m, n, nnz, reinterpret_cast<const float*>(a.Data()), a.RowLocation(), a.ColLocation(), reinterpret_cast<float*>(cscValA), cscRowIndA, cscColPtrA, cpVals, idxBase));
-        }
-        else
-        {
-            CUSPARSE_CALL(cusparseDcsr2csc(cusparseHandle, m, n, nnz, reinterpret_cast<const double*>(a.Data()), a.RowLocation(), a.ColLocation(), reinterpret_cast<double*>(cscValA), cscRowIndA, cscColPtrA, cpVals, idxBase));
-        }
-    }
-    else if (a.GetFormat() == matrixFormatSparseCSC)
-    {
-        cscValA = (ElemType*) a.Data();
-        cscRowIndA = a.RowLocation();
-        cscColPtrA = a.ColLocation();
-    }
-    else
-    {
-        NOT_IMPLEMENTED;
-    }
-    let a_nz = a.NzCount();
+    // need a in ColumnMajor format
+    const auto& cscA = a.GetConvertedSparseFormat(matrixFormatSparseCSC);
+    ElemType* cscValA = (ElemType*) cscA.Data();
+    GPUSPARSE_INDEX_TYPE* cscRowIndA = cscA.RowLocation();
+    GPUSPARSE_INDEX_TYPE* cscColPtrA = cscA.ColLocation();
+    let a_nz = cscA.NzCount();
     // Given sparse matrix in column major format, calculate indices for corresponding sparse vector
     GPUSPARSE_INDEX_TYPE* vectArray = TracingGPUMemoryAllocator::Allocate<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), a_nz);
     CUDA_LONG M = n;
@@ -1868,8 +2105,6 @@ ElemType GPUSparseMatrix<ElemType>::InnerProductOfMatrices(const GPUSparseMatrix
     int blocksPerGrid = (int) ceil(1.0 * M / GridDim::maxThreadsPerBlock);
     SyncGuard syncGuard;
     _getSparseVectorRepresntationForCSCMatrix<ElemType><<<blocksPerGrid, GridDim::maxThreadsPerBlock>>>(cscColPtrA, cscRowIndA, vectArray, M, N);
-    TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), cscRowIndA);
-    TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), cscColPtrA);
     // CUDA_CALL(cudaMemcpy(h_vectArray,vectArray,sizeof(GPUSPARSE_INDEX_TYPE)*a.m_nz,cudaMemcpyDeviceToHost));
 
     // Actual dot product
@@ -1887,7 +2122,6 @@ ElemType GPUSparseMatrix<ElemType>::InnerProductOfMatrices(const GPUSparseMatrix
                                     reinterpret_cast<double*>(&res), idxBase));
     }
     TracingGPUMemoryAllocator::Free<GPUSPARSE_INDEX_TYPE>(a.GetComputeDeviceId(), vectArray);
-    TracingGPUMemoryAllocator::Free<ElemType>(a.GetComputeDeviceId(), cscValA);
     CUSPARSE_CALL(cusparseDestroy(cusparseHandle));
     return res;
 }
@@ -340,6 +340,10 @@ public:
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols, const bool IsOnDevice = false, const DEVICEID_TYPE devId = -1);
 
+    // sparse block-column format: the ids of the numBlocks nonzero columns, and their values as (numRows x numBlocks) column-major array, on the CPU
+    void SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+    void GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const;
+
     // Gets sparse matrix in CSR format. this acts as deep copy. All passed pointers must be NULL. the function will allocate memory itself.
     void GetMatrixFromCSRFormat(CPUSPARSE_INDEX_TYPE*& h_CSRRow, CPUSPARSE_INDEX_TYPE*& h_Col, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const;
 
@@ -347,6 +351,8 @@ public:
 
     void ConvertToSparseFormat(MatrixFormat newFormat);
     void ConvertToSparseFormat(MatrixFormat newFormat, GPUSparseMatrix<ElemType>& outMatrix) const;
+    // same as converting into a new matrix, but the conversion is cached until the matrix is written to
+    const GPUSparseMatrix<ElemType>& GetConvertedSparseFormat(MatrixFormat newFormat) const;
 
     bool IsValid() const;
 
@@ -410,6 +416,7 @@ public:
 
     void NormalGrad(GPUMatrix<ElemType>& c, const ElemType momentum);
     ElemType Adagrad(GPUMatrix<ElemType>& c, const bool needAveMultiplier);
+    void FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul);
 
     static void Multiply(const GPUSparseMatrix<ElemType>& S, const GPUMatrix<ElemType>& D, GPUMatrix<ElemType>& C);
     static void Multiply(const GPUMatrix<ElemType>& D, const GPUSparseMatrix<ElemType>& S, GPUMatrix<ElemType>& C);
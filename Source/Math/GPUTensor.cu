@@ -20,6 +20,12 @@
 #include "cublas_v2.h"
 #include <assert.h>
 #include<limits.h>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #ifndef let
 #define let const auto
@@ -276,7 +282,7 @@ template<> __device__ float NeutralValue<float>(ElementWiseOperator op)
     case ElementWiseOperator::opSum:    return 0;
     case ElementWiseOperator::opLogSum: return -INFINITY;
     case ElementWiseOperator::opMin:    return FLT_MAX;
-    case ElementWiseOperator::opMax:    return FLT_MIN;
+    case ElementWiseOperator::opMax:    return -FLT_MAX; // (not FLT_MIN, which is the smallest positive value)
     default:                            return 0; // error
     }
 };
@@ -288,7 +294,7 @@ template<> __device__ double NeutralValue<double>(ElementWiseOperator op)
     case ElementWiseOperator::opSum:    return 0;
     case ElementWiseOperator::opLogSum: return -INFINITY;
     case ElementWiseOperator::opMin:    return DBL_MAX;
-    case ElementWiseOperator::opMax:    return DBL_MIN;
+    case ElementWiseOperator::opMax:    return -DBL_MAX; // (not DBL_MIN, which is the smallest positive value)
     default:                            return 0; // error
     }
 };
@@ -551,6 +557,215 @@ struct TensorOpElement<ElemType, N, M, K, /*parallelReduce=*/true, /*k=*/-1>
     }
 };
 
+// -----------------------------------------------------------------------
+// launch configuration, and its autotuning (see TensorOpAutotuning)
+// -----------------------------------------------------------------------
+
+// how a tensor op is launched; chosen by the heuristics of LaunchTensorOp() and LaunchTensorOpWithReduction(), or timed
+enum class TensorOpLaunchKind : int
+{
+    Heuristic = 0,    // to be chosen by the heuristics
+    ThreadPerElement, // one thread per output element, which reduces in an inner loop (_launchTensorOp)
+    WarpPerElement,   // one warp per output element (_launchTensorOpWithWarpReduction)
+    BlockPerElement   // one block per output element, or several if there are fewer than multiprocs (_launchTensorOpWithReduction)
+};
+
+struct TensorOpLaunchConfig
+{
+    TensorOpLaunchKind kind;
+    int threadsPerBlock; // ThreadPerElement: threads per block, BlockPerElement: at most that many; 0 = as the heuristics choose
+};
+
+static const TensorOpLaunchConfig heuristicLaunchConfig = { TensorOpLaunchKind::Heuristic, 0 };
+
+// Smaller ops, in (output elements) x (reduced elements), are not autotuned: they are dominated by the launch overhead.
+// This also keeps the recursive reduction of case (b) of LaunchTensorOpWithReduction() on its heuristic choice.
+static const size_t minAutotunedWork = 1 << 16;
+
+// state of TensorOpAutotuning; the key of an entry is the signature of an op, see TensorOpSignature()
+static std::mutex s_launchCacheMutex;
+static std::wstring s_launchCacheFile;
+static bool s_isAutotuningEnabled = false;
+static std::map<std::string, TensorOpLaunchConfig> s_launchCache;
+
+/*static*/ void TensorOpAutotuning::Configure(bool enable, const std::wstring& file)
+{
+    std::lock_guard<std::mutex> lock(s_launchCacheMutex);
+    s_isAutotuningEnabled = enable;
+    s_launchCacheFile = enable ? file : std::wstring();
+    s_launchCache.clear();
+    if (s_launchCacheFile.empty())
+        return;
+
+    // one entry per line: key <TAB> kind <TAB> threads per block; later lines override earlier ones
+    std::ifstream in(msra::strfun::utf8(file).c_str());
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t tab1 = line.find('\t');
+        size_t tab2 = (tab1 == std::string::npos) ? tab1 : line.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos)
+            continue;
+        int kind = atoi(line.substr(tab1 + 1, tab2 - tab1 - 1).c_str());
+        int threadsPerBlock = atoi(line.substr(tab2 + 1).c_str());
+        if (kind < (int) TensorOpLaunchKind::ThreadPerElement || kind > (int) TensorOpLaunchKind::BlockPerElement ||
+            threadsPerBlock < 0 || threadsPerBlock > GridDim::maxThreadsPerBlock)
+            continue;
+        s_launchCache[line.substr(0, tab1)] = { (TensorOpLaunchKind) kind, threadsPerBlock };
+    }
+    fprintf(stderr, "Loaded %d tensor op launch configurations from '%ls'.\n", (int) s_launchCache.size(), file.c_str());
+}
+
+/*static*/ bool TensorOpAutotuning::IsEnabled()
+{
+    return s_isAutotuningEnabled;
+}
+
+// 'persist': also append it to the file; otherwise it is only remembered for this process
+static void StoreLaunchConfig(const std::string& key, const TensorOpLaunchConfig& config, bool persist)
+{
+    std::lock_guard<std::mutex> lock(s_launchCacheMutex);
+    s_launchCache[key] = config;
+    if (!persist || s_launchCacheFile.empty())
+        return;
+    // appended line by line, so that concurrent processes (e.g. the ranks of a job) do not overwrite each other's entries
+    FILE* f = fopen(msra::strfun::utf8(s_launchCacheFile).c_str(), "a");
+    if (!f)
+    {
+        fprintf(stderr, "WARNING: Cannot append to the tensor op launch configuration file '%ls'.\n", s_launchCacheFile.c_str());
+        return;
+    }
+    fprintf(f, "%s\t%d\t%d\n", key.c_str(), (int) config.kind, config.threadsPerBlock);
+    fclose(f);
+}
+
+// The signature under which the launch configuration of an op is cached. The dimensions are rounded up to powers of 2,
+// so that e.g. varying minibatch sizes share the entries, and of the strides only the pattern is kept: 0 (broadcasting),
+// 1, dense (the stride of the dimension below times its size) or other.
+template <class ElemType, C_size_t N>
+static std::string TensorOpSignature(ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    std::string key = std::string(GridDim::GetDeviceProps().name) + (sizeof(ElemType) == sizeof(float) ? " float" : " double") +
+                      " op" + std::to_string((long long) op) + "/" + std::to_string((long long) reductionOp);
+    for (int reducing = 0; reducing < 2; reducing++)
+    {
+        const auto& dims = reducing ? reducingOpDims : regularOpDims;
+        const auto& strides = reducing ? reducingStrides : regularStrides;
+        key += reducing ? " reduce" : " dims";
+        for (size_t k = 0; k < dims.size(); k++)
+        {
+            size_t bucket = 1;
+            while (bucket < dims[k])
+                bucket *= 2;
+            key += " " + std::to_string((unsigned long long) bucket) + ":";
+            for (size_t i = 0; i < N; i++)
+            {
+                ptrdiff_t stride = strides[i][k];
+                ptrdiff_t dense = k == 0 ? 1 : strides[i][k - 1] * (ptrdiff_t) dims[k - 1];
+                key += stride == 0 ? '0' : stride == 1 ? '1' : stride == dense ? 'd' : 's';
+            }
+        }
+    }
+    return key;
+}
+
+// adds the candidates of a kind: the block size of the heuristics if 'withHeuristicBlockSize', and powers of 2 from 128
+// threads up to what the kernel can be launched with
+static void AddLaunchCandidates(std::vector<TensorOpLaunchConfig>& candidates, TensorOpLaunchKind kind, const void* kernel, bool withHeuristicBlockSize)
+{
+    cudaFuncAttributes attributes;
+    CUDA_CALL(cudaFuncGetAttributes(&attributes, kernel));
+    if (withHeuristicBlockSize)
+        candidates.push_back({ kind, 0 });
+    for (int threads = 128; threads <= attributes.maxThreadsPerBlock && threads <= GridDim::maxThreadsPerBlock; threads *= 2)
+        candidates.push_back({ kind, threads });
+}
+
+// redirects the output of an op to a dense buffer, for timing its launch configurations
+template <class ElemType, C_size_t N>
+static void RedirectOutput(array<ElemType*, N>& pointers, array<SmallVector<ptrdiff_t>, N>& regularStrides, const SmallVector<size_t>& regularOpDims, void* output)
+{
+    pointers[N - 1] = (ElemType*) output;
+    ptrdiff_t stride = 1;
+    for (size_t k = 0; k < regularOpDims.size(); k++)
+    {
+        regularStrides[N - 1][k] = stride;
+        stride *= (ptrdiff_t) regularOpDims[k];
+    }
+}
+
+// Returns the cached launch configuration for 'key', or, at its first use, times the candidates and caches the fastest.
+// 'launch' runs the op with beta = 0 into a scratch output of 'outputBytes', so that neither the output nor inputs that
+// alias it are changed. Returns heuristicLaunchConfig if the candidates cannot be timed now.
+static TensorOpLaunchConfig AutotunedLaunchConfig(const std::string& key, const std::vector<TensorOpLaunchConfig>& candidates, size_t outputBytes,
+                                                  const std::function<void(const TensorOpLaunchConfig& config, void* output)>& launch)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_launchCacheMutex);
+        auto iter = s_launchCache.find(key);
+        if (iter != s_launchCache.end())
+            return iter->second;
+    }
+#if CUDA_VERSION >= 10000
+    // work captured into a CUDA graph (see GPUGraph) is not executed, and must not allocate
+    cudaStreamCaptureStatus captureStatus;
+    CUDA_CALL(cudaStreamIsCapturing(t_stream, &captureStatus));
+    if (captureStatus != cudaStreamCaptureStatusNone)
+        return heuristicLaunchConfig;
+#endif
+    void* output;
+    if (cudaMalloc(&output, outputBytes) != cudaSuccess)
+    {
+        cudaGetLastError(); // (clear the error)
+        StoreLaunchConfig(key, heuristicLaunchConfig, /*persist=*/false);
+        return heuristicLaunchConfig;
+    }
+
+    // each candidate once to warm up, then timed over a few runs; ops are short, so the runs are not synchronized
+    const int numTimedRuns = 3;
+    cudaEvent_t start, stop;
+    CUDA_CALL(cudaEventCreate(&start));
+    CUDA_CALL(cudaEventCreate(&stop));
+    TensorOpLaunchConfig best = heuristicLaunchConfig;
+    float bestMilliseconds = 0;
+    for (const auto& candidate : candidates)
+    {
+        launch(candidate, output);
+        CUDA_CALL(cudaEventRecord(start, t_stream));
+        for (int run = 0; run < numTimedRuns; run++)
+            launch(candidate, output);
+        CUDA_CALL(cudaEventRecord(stop, t_stream));
+        CUDA_CALL(cudaEventSynchronize(stop));
+        float milliseconds;
+        CUDA_CALL(cudaEventElapsedTime(&milliseconds, start, stop));
+        if (best.kind == TensorOpLaunchKind::Heuristic || milliseconds < bestMilliseconds)
+        {
+            best = candidate;
+            bestMilliseconds = milliseconds;
+        }
+    }
+    CUDA_CALL(cudaEventDestroy(start));
+    CUDA_CALL(cudaEventDestroy(stop));
+    CUDA_CALL(cudaFree(output));
+
+    StoreLaunchConfig(key, best, /*persist=*/best.kind != TensorOpLaunchKind::Heuristic);
+    return best;
+}
+
+// the linear grid of GridDim, or one with 'threadsPerBlock' threads per block unless 0
+static GridDim LaunchGrid(CUDA_LONG N, int threadsPerBlock)
+{
+    GridDim grid(N);
+    if (threadsPerBlock > 0)
+    {
+        grid.m_threadsPerBlock = threadsPerBlock;
+        grid.m_blocksPerGrid = CeilDiv(max(N, (CUDA_LONG) 1), (CUDA_LONG) threadsPerBlock);
+    }
+    return grid;
+}
+
 // -----------------------------------------------------------------------
 // kernel and launch  --no reduction
 // -----------------------------------------------------------------------
@@ -568,7 +783,8 @@ __global__ void _launchTensorOp(ElemType beta, FixedArray<ElemType*, N> pointers
 
 template <class ElemType, C_size_t N, C_int K>
 static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op,
-                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors)
+                           const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors,
+                           TensorOpLaunchConfig config = heuristicLaunchConfig)
 {
     // copy all parameters to CUDA-compatible data structures
     FixedArray<ElemType*, N> pointers(pointerVector);
@@ -584,10 +800,26 @@ static void LaunchTensorOp(ElemType beta, array<ElemType*, N> pointerVector, Ele
     FixedArray<C_unsigned_int, /*M=*/0> reducingOpDims; // empty reduction dimensions
     FixedMatrix<C_int, N, /*M=*/0> reducingStrides;
 
+    // the block size: as GridDim chooses, or timed at the first use of the signature of the op
+    if (config.kind == TensorOpLaunchKind::Heuristic && TensorOpAutotuning::IsEnabled() && (size_t) numElements >= minAutotunedWork)
+    {
+        std::vector<TensorOpLaunchConfig> candidates;
+        AddLaunchCandidates(candidates, TensorOpLaunchKind::ThreadPerElement, (const void*) _launchTensorOp<ElemType, N, /*M=*/0, K>, /*withHeuristicBlockSize=*/true);
+        config = AutotunedLaunchConfig(TensorOpSignature<ElemType, N>(op, (ElementWiseOperator)(-1), regularOpDims, regularStrideVectors, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, N>()),
+                                       candidates, numElements * sizeof(ElemType),
+                                       [&](const TensorOpLaunchConfig& candidate, void* output)
+                                       {
+                                           auto pointerVector1 = pointerVector;
+                                           auto regularStrideVectors1 = regularStrideVectors;
+                                           RedirectOutput<ElemType, N>(pointerVector1, regularStrideVectors1, regularOpDims, output);
+                                           LaunchTensorOp<ElemType, N, K>(/*beta=*/0, pointerVector1, alpha, op, regularOpDims, regularStrideVectors1, candidate);
+                                       });
+    }
+
     // launch the kernel
     CUDA_LONG NN = (CUDA_LONG) numElements; // linear space identifying each individual input element
     SyncGuard syncGuard;
-    GridDim grid(NN);
+    GridDim grid = LaunchGrid(NN, config.threadsPerBlock);
     _launchTensorOp<ElemType, N, /*M=*/0, K> <<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream >>>(beta, pointers, alpha, op, (ElementWiseOperator)(-1) /* dummy reductionOp */, regularOpStrides, regularStrides, grid.m_N, reducingOpDims, reducingStrides);
 }
 
@@ -642,10 +874,91 @@ static shared_ptr<ElemType> GetReductionBuffer(size_t N)
 }
 
 // All dimensions (N-ariness, number of input dimensions K and number of reduction dimensions M) are bound to template parameters now.
+// -----------------------------------------------------------------------
+// kernel and launch  --with reduction, one warp per output element
+// -----------------------------------------------------------------------
+
+// map id (index of an output element) to the pointers, like TensorOpElement but without computing anything
+template <class ElemType, C_size_t N, C_int K, C_int k>
+struct TensorOpRegularIndex
+{
+    static __device__ void Apply(CUDA_LONG id, FixedArray<ElemType*, N>& pointers,
+                                 const FixedArray<C_unsigned_int, K>& regularOpStrides, const FixedMatrix<C_int, N, K>& regularStrides)
+    {
+        C_size_t stride = regularOpStrides[(C_size_t) k];
+        C_size_t index = id / stride; // this dimension
+        id = id % stride;             // remaining dimensions inside this
+        for (C_size_t i = 0; i < N; i++)
+            pointers[i] += index * regularStrides(i, (C_size_t) k);
+        TensorOpRegularIndex<ElemType, N, K, k - 1>::Apply(id, pointers, regularOpStrides, regularStrides);
+    }
+};
+
+// this one terminates the template recursion over regular dimensions
+template <class ElemType, C_size_t N, C_int K>
+struct TensorOpRegularIndex<ElemType, N, K, /*k=*/-1>
+{
+    static __device__ void Apply(CUDA_LONG /*id*/, FixedArray<ElemType*, N>& /*pointers*/,
+                                 const FixedArray<C_unsigned_int, K>& /*regularOpStrides*/, const FixedMatrix<C_int, N, K>& /*regularStrides*/)
+    {
+    }
+};
+
+static const CUDA_LONG warpReductionWarpSize = 32;     // the kernel below assumes this; the launch code checks it against the device
+static const CUDA_LONG warpReductionWarpsPerBlock = 8; // output elements per block
+
+// Many outputs, each reducing over a short to medium axis that is contiguous in memory (e.g. layer normalization,
+// softmax over a few hundred classes, ReduceElements over the sample axes): one thread per output would have each
+// thread walk its own memory range, i.e. uncoalesced. Instead, the 32 lanes of a warp stride over the reduction
+// of one output together, and threadIdx.y selects the output within the block.
+template <class ElemType, C_size_t N, C_int M, C_int K>
+__global__ void _launchTensorOpWithWarpReduction(ElemType beta, FixedArray<ElemType*, N> pointers, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
+                                                 FixedArray<C_unsigned_int, K> regularOpStrides, FixedMatrix<C_int, N, K> regularStrides, CUDA_LONG numElements,
+                                                 FixedArray<C_unsigned_int, M> reducingOpDims, FixedMatrix<C_int, N, M> reducingStrides, CUDA_LONG reductionDim)
+{
+    __shared__ ReduceElemType volatile accumulators[warpReductionWarpsPerBlock][warpReductionWarpSize];
+    CUDA_LONG lane = threadIdx.x;
+    CUDA_LONG warp = threadIdx.y;
+    CUDA_LONG id = blockIdx.x * blockDim.y + warp;
+    bool valid = id < numElements; // note: no early return, all threads must reach the __syncthreads() below
+
+    ReduceElemType aggregate = NeutralValue<ReduceElemType>(reductionOp);
+    if (valid)
+    {
+        TensorOpRegularIndex<ElemType, N, K, K - 1>::Apply(id, pointers, regularOpStrides, regularStrides);
+        for (CUDA_LONG redId = lane; redId < reductionDim; redId += warpReductionWarpSize)
+        {
+            auto val = TensorOpParallelReduce<ElemType, N, M, M - 1>::Compute(redId, pointers, op, reducingOpDims, reducingStrides);
+            UpdateAggregate<ReduceElemType, ElemType>(aggregate, val, reductionOp);
+        }
+    }
+
+    // reduce the lanes of each warp
+    accumulators[warp][lane] = aggregate;
+    __syncthreads();
+    for (CUDA_LONG i = warpReductionWarpSize / 2; i; i >>= 1)
+    {
+        if (lane < i)
+            UpdateAggregate<volatile ReduceElemType, volatile ReduceElemType>(accumulators[warp][lane], accumulators[warp][lane + i], reductionOp);
+        __syncthreads();
+    }
+
+    if (valid && lane == 0)
+    {
+        ElemType val = (ElemType) accumulators[warp][0];
+        val *= alpha;
+        auto* pout = pointers[pointers.size() - 1];
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    }
+}
+
 template <class ElemType, C_size_t N, C_int M, C_int K>
 static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> pointerVector, ElemType alpha, ElementWiseOperator op, ElementWiseOperator reductionOp,
                                         const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrideVectors,
-                                        const SmallVector<size_t>& reducingOpDimVector, const array<SmallVector<ptrdiff_t>, N>& reducingStrideVectors)
+                                        const SmallVector<size_t>& reducingOpDimVector, const array<SmallVector<ptrdiff_t>, N>& reducingStrideVectors,
+                                        TensorOpLaunchConfig config = heuristicLaunchConfig)
 {
     // copy all parameters to CUDA-compatible data structures
     FixedArray<ElemType*, N> pointers(pointerVector);
@@ -682,15 +995,68 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
         reductionDim *= (C_size_t) reducingOpDimVector[k];
     GridDim grid(NN);
     let& props = GridDim::GetDeviceProps();
+    let numWarpReductionBlocks = CeilDiv(NN, warpReductionWarpsPerBlock);
+    bool canUseWarpReduction = props.warpSize == warpReductionWarpSize && numWarpReductionBlocks <= props.maxGridSize[0];
+
+    // with autotuning, the candidates of all kinds are timed at the first use of the signature of the op
+    if (config.kind == TensorOpLaunchKind::Heuristic && TensorOpAutotuning::IsEnabled() && (size_t) numElements * reductionDim >= minAutotunedWork)
+    {
+        std::vector<TensorOpLaunchConfig> candidates;
+        AddLaunchCandidates(candidates, TensorOpLaunchKind::ThreadPerElement, (const void*) _launchTensorOp<ElemType, N, M, K>, /*withHeuristicBlockSize=*/true);
+        if (canUseWarpReduction)
+            candidates.push_back({ TensorOpLaunchKind::WarpPerElement, warpReductionWarpSize * warpReductionWarpsPerBlock });
+        AddLaunchCandidates(candidates, TensorOpLaunchKind::BlockPerElement, (const void*) _launchTensorOpWithReduction<ElemType, N, M, K>, /*withHeuristicBlockSize=*/false);
+        config = AutotunedLaunchConfig(TensorOpSignature<ElemType, N>(op, reductionOp, regularOpDims, regularStrideVectors, reducingOpDimVector, reducingStrideVectors),
+                                       candidates, numElements * sizeof(ElemType),
+                                       [&](const TensorOpLaunchConfig& candidate, void* output)
+                                       {
+                                           auto pointerVector1 = pointerVector;
+                                           auto regularStrideVectors1 = regularStrideVectors;
+                                           RedirectOutput<ElemType, N>(pointerVector1, regularStrideVectors1, regularOpDims, output);
+                                           LaunchTensorOpWithReduction<ElemType, N, M, K>(/*beta=*/0, pointerVector1, alpha, op, reductionOp, regularOpDims, regularStrideVectors1,
+                                                                                          reducingOpDimVector, reducingStrideVectors, candidate);
+                                       });
+    }
+
+    // otherwise the heuristics choose
+    if (config.kind == TensorOpLaunchKind::Heuristic)
+    {
+        bool disableWarpReduction = false;     // (for debugging)
+        bool disableParallelReduction = false; // (for debugging)
+        // many output elements, each reducing over an axis that is contiguous for the first input: one warp per output element
+        // If instead the regular dimension is the contiguous one, the simple case below reads coalesced already.
+        if (!disableWarpReduction &&
+            canUseWarpReduction &&
+            reductionDim >= warpReductionWarpSize &&                 // enough to keep the lanes of a warp busy
+            numWarpReductionBlocks >= props.multiProcessorCount &&   // enough output elements to fill all multiprocs
+            reducingStrideVectors[0][0] == 1 &&                      // lanes read consecutive elements
+            (regularOpDims.empty() || regularStrideVectors[0][0] != 1))
+            config.kind = TensorOpLaunchKind::WarpPerElement;
+        // simple case: NN large, one thread per output element
+        else if (reductionDim == 1 ||                                // no reduction
+            grid.m_blocksPerGrid >= props.multiProcessorCount ||     // enough output elements to fill all multiprocs
+            reductionDim * numElements <= 2 * props.warpSize ||      // trivial operation not worth the trouble (2* because the more complex one also needs 2 kernel launches)
+            disableParallelReduction ||                              // (for debugging)
+            reductionDim * numElements <= props.multiProcessorCount) // recursive call from reduction below
+            config.kind = TensorOpLaunchKind::ThreadPerElement;
+        // optimization: simple case would not use all multiprocs
+        else
+            config.kind = TensorOpLaunchKind::BlockPerElement;
+    }
+
+    // === many output elements, each reducing over an axis that is contiguous for the first input: one warp per output element
+    if (config.kind == TensorOpLaunchKind::WarpPerElement)
+    {
+        _launchTensorOpWithWarpReduction<ElemType, N, M, K><<<numWarpReductionBlocks, dim3(warpReductionWarpSize, warpReductionWarpsPerBlock), 0, t_stream>>>(
+            beta, pointers, alpha, op, reductionOp,
+            regularOpStrides, regularStrides, NN,
+            reducingOpDims, reducingStrides, (CUDA_LONG) reductionDim);
+    }
     // === simple case: NN large, one thread per output element
-    bool disableParallelReduction = false;                       // (for debugging)
-    if (reductionDim == 1 ||                                     // no reduction
-        grid.m_blocksPerGrid >= props.multiProcessorCount ||     // enough output elements to fill all multiprocs
-        reductionDim * numElements <= 2 * props.warpSize ||      // trivial operation not worth the trouble (2* because the more complex one also needs 2 kernel launches)
-        disableParallelReduction ||                              // (for debugging)
-        reductionDim * numElements <= props.multiProcessorCount) // recursive call from reduction below
+    else if (config.kind == TensorOpLaunchKind::ThreadPerElement)
     {
         // we got enough elements to generate: do one element per thread, and reduction inside
+        grid = LaunchGrid(NN, config.threadsPerBlock);
         _launchTensorOp<ElemType, N, M, K><<<grid.m_blocksPerGrid, grid.m_threadsPerBlock, 0, t_stream>>>(
             beta, pointers, alpha, op, reductionOp,
             regularOpStrides, regularStrides, grid.m_N,
@@ -702,7 +1068,7 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
         // m_blocksPerGrid can be thought of NN / 512, with appropriate rounding
 
         // we are reducing and are underutilizing the multiprocs we have: get more parallelism by doing reduction in parallel
-        // If we get here, then
+        // If we get here by the heuristics (autotuning may also choose this for more outputs), then
         //  - the total number of outputs to produce is < #multiprocs * warpSize, e.g. < 960
         //  - each output has at least two inputs, but possibly millions
         // Examples:
@@ -738,7 +1104,8 @@ static void LaunchTensorOpWithReduction(ElemType beta, array<ElemType*, N> point
 
         // reduction goes into thread dim X
         let reductionChunkSize = CeilDiv(reductionDim, numReductionChunks);
-        let numThreadsX = min(reductionChunkSize, GridDim::maxThreadsPerBlock); // any that's over will be done by looping inside the kernel
+        let maxThreadsX = config.threadsPerBlock > 0 ? (CUDA_LONG) config.threadsPerBlock : GridDim::maxThreadsPerBlock;
+        let numThreadsX = min(reductionChunkSize, maxThreadsX); // any that's over will be done by looping inside the kernel
 
         // --- cases (a1) and (a2)
         // This involves no reduction across blocks.
@@ -911,6 +1278,121 @@ void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemTy
     }
 }
 
+// -----------------------------------------------------------------------
+// special case of a copy that permutes dimensions (e.g. TransposeDimensions)
+// The generic kernel walks the output linearly, so its reads from the input are strided. Instead, tiles of
+// [dimension that is contiguous in the output] x [dimension that is contiguous in the input] are staged in
+// shared memory, such that both reading and writing are coalesced. All other dimensions are batched over.
+// -----------------------------------------------------------------------
+
+#define TRANSPOSE_TILE_DIM 32
+#define TRANSPOSE_BLOCK_ROWS 8
+#define TRANSPOSE_MAX_BATCH_DIMS 3
+
+struct TransposeBatchDims
+{
+    C_int m_num;
+    C_unsigned_int m_dims[TRANSPOSE_MAX_BATCH_DIMS];
+    C_int m_aStrides[TRANSPOSE_MAX_BATCH_DIMS];
+    C_int m_bStrides[TRANSPOSE_MAX_BATCH_DIMS];
+};
+
+// pb[i * 1 + j * bStrideJ] = beta * pb[...] + alpha * pa[i * aStrideI + j * 1], for one tile (i, j) of one batch index
+template <class ElemType>
+__global__ void _launchTransposeTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha,
+                                         C_unsigned_int dimI, C_unsigned_int dimJ, C_int aStrideI, C_int bStrideJ, TransposeBatchDims batchDims)
+{
+    __shared__ ElemType tile[TRANSPOSE_TILE_DIM][TRANSPOSE_TILE_DIM + 1]; // (+1 so that reading a column does not hit the same bank)
+
+    C_unsigned_int batchIndex = blockIdx.z;
+    for (C_int k = 0; k < batchDims.m_num; k++)
+    {
+        C_unsigned_int index = batchIndex % batchDims.m_dims[k];
+        batchIndex /= batchDims.m_dims[k];
+        pa += (C_int) index * batchDims.m_aStrides[k];
+        pb += (C_int) index * batchDims.m_bStrides[k];
+    }
+
+    C_unsigned_int i0 = blockIdx.x * TRANSPOSE_TILE_DIM;
+    C_unsigned_int j0 = blockIdx.y * TRANSPOSE_TILE_DIM;
+
+    // read with consecutive threads along j, which is contiguous in the input
+    C_unsigned_int j = j0 + threadIdx.x;
+    for (C_unsigned_int r = threadIdx.y; r < TRANSPOSE_TILE_DIM; r += TRANSPOSE_BLOCK_ROWS)
+    {
+        C_unsigned_int i = i0 + r;
+        if (i < dimI && j < dimJ)
+            tile[r][threadIdx.x] = pa[i * aStrideI + j];
+    }
+    __syncthreads();
+
+    // write with consecutive threads along i, which is contiguous in the output
+    C_unsigned_int i = i0 + threadIdx.x;
+    for (C_unsigned_int r = threadIdx.y; r < TRANSPOSE_TILE_DIM; r += TRANSPOSE_BLOCK_ROWS)
+    {
+        C_unsigned_int j = j0 + r;
+        if (i < dimI && j < dimJ)
+        {
+            ElemType* pout = pb + i + j * bStrideJ;
+            ElemType val = alpha * tile[threadIdx.x][r];
+            if (beta != 0)
+                val += beta * *pout;
+            *pout = val;
+        }
+    }
+}
+
+// returns false if the operation is not a permuting copy that this handles; the caller then uses the generic kernel
+template <class ElemType>
+bool LaunchTransposeTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha,
+                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides)
+{
+    // the output must be contiguous along the first dimension, and the input along another one
+    let& aStrides = regularStrides[0];
+    let& bStrides = regularStrides[1];
+    size_t rank = regularOpDims.size();
+    if (rank < 2 || bStrides[0] != 1 || aStrides[0] <= 1)
+        return false;
+    size_t jDim = 0;
+    for (size_t k = 1; k < rank; k++)
+    {
+        if (aStrides[k] == 1)
+            jDim = k;
+    }
+    if (jDim == 0 || rank - 2 > TRANSPOSE_MAX_BATCH_DIMS)
+        return false;
+
+    // tiny tiles are not worth it
+    let dimI = regularOpDims[0];
+    let dimJ = regularOpDims[jDim];
+    if (dimI < TRANSPOSE_TILE_DIM / 2 || dimJ < TRANSPOSE_TILE_DIM / 2)
+        return false;
+
+    TransposeBatchDims batchDims;
+    batchDims.m_num = 0;
+    size_t numBatches = 1;
+    for (size_t k = 1; k < rank; k++)
+    {
+        if (k == jDim)
+            continue;
+        batchDims.m_dims[batchDims.m_num] = (C_unsigned_int) regularOpDims[k];
+        batchDims.m_aStrides[batchDims.m_num] = (C_int) aStrides[k];
+        batchDims.m_bStrides[batchDims.m_num] = (C_int) bStrides[k];
+        batchDims.m_num++;
+        numBatches *= regularOpDims[k];
+    }
+
+    dim3 blocks((unsigned int) CeilDiv(dimI, TRANSPOSE_TILE_DIM), (unsigned int) CeilDiv(dimJ, TRANSPOSE_TILE_DIM), (unsigned int) numBatches);
+    if (blocks.y > 65535 || blocks.z > 65535) // grid limits
+        return false;
+    dim3 threads(TRANSPOSE_TILE_DIM, TRANSPOSE_BLOCK_ROWS);
+
+    SyncGuard syncGuard;
+    _launchTransposeTensorOp<ElemType><<<blocks, threads, 0, t_stream>>>(beta, pa, pb, alpha, (C_unsigned_int) dimI, (C_unsigned_int) dimJ,
+                                                                          (C_int) aStrides[0], (C_int) bStrides[jDim], batchDims);
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -995,6 +1477,9 @@ template void TensorOpN<double, 4>(double beta, array<double*, 4> pointers, doub
 template void LaunchUnaryTensorOp(float beta, const float* pa, float* pb, float alpha, ElementWiseOperator op, size_t regularOpDim);
 template void LaunchUnaryTensorOp(double beta, const double* pa, double* pb, double alpha, ElementWiseOperator op, size_t regularOpDim);
 
+template bool LaunchTransposeTensorOp(float beta, const float* pa, float* pb, float alpha, const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+template bool LaunchTransposeTensorOp(double beta, const double* pa, double* pb, double alpha, const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+
 }}}
 
 #endif // CPUONLY
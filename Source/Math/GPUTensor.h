@@ -26,4 +26,8 @@ void TensorOpN(ElemType beta, array<ElemType*, N> pointers, ElemType alpha, Elem
 template <class ElemType>
 void LaunchUnaryTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha, ElementWiseOperator op, size_t regularOpDim);
 
+template <class ElemType>
+bool LaunchTransposeTensorOp(ElemType beta, const ElemType* pa, ElemType* pb, ElemType alpha,
+                             const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, 2>& regularStrides);
+
 }}}
@@ -53,6 +53,24 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int devId)
         return free;
 }
 
+size_t GPUWatcher::GetTotalMemoryOnCUDADevice(int devId)
+{
+    cudaError_t result = cudaSetDevice(devId);
+    if (result != cudaSuccess)
+    {
+        return 0;
+    }
+    size_t free = 0;
+    size_t total = 0;
+    result = cudaMemGetInfo(&free, &total);
+    if (result != cudaSuccess)
+    {
+        return 0;
+    }
+    else
+        return total;
+}
+
 GPUWatcher::GPUWatcher(void)
 {
 }
@@ -11,6 +11,7 @@ class MATH_API GPUWatcher
 {
 public:
     static size_t GetFreeMemoryOnCUDADevice(int devId);
+    static size_t GetTotalMemoryOnCUDADevice(int devId);
     static int GetGPUIdWithTheMostFreeMemory();
     GPUWatcher(void);
     ~GPUWatcher(void);
@@ -0,0 +1,132 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Int8Multiplier.h"
+#include "GPUMatrix.h"
+#include "Quantizers.h"
+#include <algorithm>
+#include <climits>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// quantize 'values' to [-127, 127] in q, clipping them to [-range, range] first; returns the factor that undoes the scaling
+template <class ElemType>
+static ElemType QuantizeToInt8(std::vector<ElemType>& values, ElemType range, int8_t* q)
+{
+    if (range <= 0) // all zero
+    {
+        std::fill(q, q + values.size(), (int8_t) 0);
+        return 0;
+    }
+    for (auto& value : values)
+        value = std::max(-range, std::min(range, value));
+    SymmetricQuantizer<ElemType, int8_t> quantizer(range, /*extraBits=*/0);
+    ArrayRef<ElemType> input(values.data(), values.size());
+    ArrayRef<int8_t> output(q, values.size());
+    quantizer.Quantize(input, output);
+    return range / std::numeric_limits<int8_t>::max();
+}
+
+template <class ElemType>
+static ElemType AbsMax(const std::vector<ElemType>& values)
+{
+    ElemType absMax = 0;
+    for (auto value : values)
+        absMax = std::max(absMax, (ElemType) fabs(value));
+    return absMax;
+}
+
+template <class ElemType>
+Int8Multiplier<ElemType>::Int8Multiplier()
+    : m_deviceId(CPUDEVICE), m_m(0), m_k(0), m_paddedK(0)
+{
+}
+
+template <class ElemType>
+Int8Multiplier<ElemType>::~Int8Multiplier()
+{
+}
+
+template <class ElemType>
+void Int8Multiplier<ElemType>::SetA(const Matrix<ElemType>& a, size_t m, size_t k, bool isRowMajor)
+{
+    // k products of at most 127^2 each must fit into the int32 accumulators
+    if ((m == 0) || (k == 0) || (m > INT_MAX) || (k > (1 << 17)) || (m * k > INT_MAX) || (m * k != a.GetNumElements()) || (a.GetMatrixType() != DENSE))
+        InvalidArgument("Int8Multiplier: Unsupported matrix dimensions [%d x %d].", (int) m, (int) k);
+
+    // the weights are quantized on the host, also for the GPU; this happens only when they change
+    std::unique_ptr<ElemType[]> values(a.CopyToArray());
+    if (m_deviceId != a.GetDeviceId())
+        m_gpuGemm.reset();
+    m_deviceId = a.GetDeviceId();
+    m_m = m;
+    m_k = k;
+    m_paddedK = (k + 3) / 4 * 4;
+    m_quantizedA.assign(m * m_paddedK, 0);
+    m_rowScales.resize(m);
+    std::vector<ElemType> row(k);
+    for (size_t j = 0; j < m; j++)
+    {
+        for (size_t i = 0; i < k; i++)
+            row[i] = isRowMajor ? values[j * k + i] : values[i * m + j];
+        m_rowScales[j] = QuantizeToInt8(row, AbsMax(row), m_quantizedA.data() + j * m_paddedK);
+    }
+
+    if (m_deviceId != CPUDEVICE)
+    {
+        if (!m_gpuGemm)
+            m_gpuGemm.reset(new GPUInt8Gemm<ElemType>(m_deviceId));
+        m_gpuGemm->SetA(m_quantizedA.data(), m_rowScales.data(), m, m_paddedK);
+    }
+}
+
+template <class ElemType>
+void Int8Multiplier<ElemType>::Multiply(const Matrix<ElemType>& b, Matrix<ElemType>& c, ElemType inputRange)
+{
+    if (m_m == 0)
+        LogicError("Int8Multiplier: Multiply() called before SetA().");
+    size_t n = b.GetNumCols();
+    if ((b.GetNumRows() != m_k) || (c.GetNumRows() != m_m) || (c.GetNumCols() != n) || (n > INT_MAX) || (n * m_paddedK > INT_MAX) || (n * m_m > INT_MAX))
+        InvalidArgument("Int8Multiplier: Unsupported matrix dimensions [%d x %d].", (int) b.GetNumRows(), (int) n);
+    if ((b.GetDeviceId() != m_deviceId) || (c.GetDeviceId() != m_deviceId) || (b.GetMatrixType() != DENSE) || (c.GetMatrixType() != DENSE))
+        InvalidArgument("Int8Multiplier: The operands must be dense and on the device of the weights.");
+
+    if (m_gpuGemm)
+    {
+        m_gpuGemm->Multiply(b.Data(), m_k, n, inputRange, c.Data());
+        return;
+    }
+
+    const ElemType* bData = b.Data();
+    ElemType* cData = c.Data();
+    m_quantizedB.assign(n * m_paddedK, 0);
+    m_columnScales.resize(n);
+    int numCols = (int) n;
+#pragma omp parallel for
+    for (int r = 0; r < numCols; r++)
+    {
+        std::vector<ElemType> column(bData + r * m_k, bData + (r + 1) * m_k);
+        m_columnScales[r] = QuantizeToInt8(column, inputRange > 0 ? inputRange : AbsMax(column), m_quantizedB.data() + r * m_paddedK);
+    }
+
+#pragma omp parallel for
+    for (int r = 0; r < numCols; r++)
+    {
+        const int8_t* bColumn = m_quantizedB.data() + r * m_paddedK;
+        for (size_t j = 0; j < m_m; j++)
+        {
+            const int8_t* aRow = m_quantizedA.data() + j * m_paddedK;
+            int32_t sum = 0;
+            for (size_t i = 0; i < m_k; i++)
+                sum += (int32_t) aRow[i] * (int32_t) bColumn[i];
+            cData[r * m_m + j] = sum * m_rowScales[j] * m_columnScales[r];
+        }
+    }
+}
+
+template class Int8Multiplier<float>;
+template class Int8Multiplier<double>;
+
+}}}
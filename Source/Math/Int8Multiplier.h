@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Int8Multiplier.h -- matrix product with a fixed left operand, in 8-bit integer arithmetic, on the CPU or a GPU
+//
+// Meant for inference, like QuantizedMultiplier: the left operand is a weight matrix that is quantized once, with a
+// SymmetricQuantizer per row, and stored at a quarter of the size of the float weights. Each product quantizes the right
+// operand, either with a calibrated range or per column, accumulates in int32, and rescales the result in fp32.
+
+#pragma once
+
+#include "Matrix.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class GPUInt8Gemm;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+
+template <class ElemType>
+class MATH_API Int8Multiplier
+{
+public:
+    Int8Multiplier();
+    ~Int8Multiplier();
+
+    // quantize and prepare the left operand 'a', a dense (m x k) matrix, which is column-major, or row-major if 'isRowMajor'
+    // (as the kernels of a convolution); the products are computed on the device of 'a'
+    void SetA(const Matrix<ElemType>& a, size_t m, size_t k, bool isRowMajor = false);
+
+    // c = a * b, with dense column-major b (k x n) and c (m x n) on the device of 'a'; c is overwritten
+    // b is quantized to the range [-inputRange, inputRange], clipping values beyond it, or per column if inputRange is 0
+    void Multiply(const Matrix<ElemType>& b, Matrix<ElemType>& c, ElemType inputRange);
+
+    size_t GetNumRows() const { return m_m; }
+    size_t GetNumCols() const { return m_k; }
+    DEVICEID_TYPE GetDeviceId() const { return m_deviceId; }
+
+private:
+    Int8Multiplier(const Int8Multiplier&) = delete;
+    void operator=(const Int8Multiplier&) = delete;
+
+    DEVICEID_TYPE m_deviceId;
+    size_t m_m;
+    size_t m_k;
+    size_t m_paddedK; // rows of a and columns of b are padded with zeros to a multiple of 4, for the GPU kernel
+    std::vector<int8_t> m_quantizedA; // row-major (m x paddedK)
+    std::vector<ElemType> m_rowScales; // [j] dequantization factor of row j of a
+    std::vector<int8_t> m_quantizedB; // CPU only: column-major (paddedK x n)
+    std::vector<ElemType> m_columnScales; // CPU only: [r] dequantization factor of column r of the current b
+    std::unique_ptr<GPUInt8Gemm<ElemType>> m_gpuGemm;
+};
+
+#pragma warning(pop)
+
+}}}
@@ -11,7 +11,9 @@
 #include "CPUSparseMatrix.h"
 #include "GPUMatrix.h"
 #include "GPUSparseMatrix.h"
+#include "MatrixOpTracer.h"
 #include "File.h"
+#include "Float16.h"
 #include <assert.h>
 #include <math.h>
 #include "GPUWatcher.h" // bring in this class as well so that it gets exported from this DLL
@@ -28,6 +30,9 @@
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
+// records the dispatched operation with MatrixOpTracer, if enabled; the bytes are those of the dense matrix of the same size
+#define MATRIX_OP_SCOPE(MatrixPointer, isOnGPU) MatrixOpScope matrixOpScope(__FUNCTION__, isOnGPU, (MatrixPointer)->GetNumElements() * sizeof(ElemType))
+
 // Helper to dispath matrix calls to the 4 underlying matrix libraries (CPU,GPU) x (DENSE,SPARSE)
 // 'MatrixPointerToCheck' determines where the operation takes place.
 // 'MatrixPointerToSetFlag' is the output. If not null and its location is BOTH, we collapse it to one.
@@ -38,12 +43,14 @@
         {                                                                                                               \
             if ((MatrixPointerToCheck)->GetMatrixType() != MatrixType::SPARSE)                                          \
             {                                                                                                           \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, true);                                                            \
                 GPUDense;                                                                                               \
                 if (MatrixPointerToSetFlag != nullptr)                                                                  \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::GPU, MatrixType::DENSE);   \
             }                                                                                                           \
             else                                                                                                        \
             {                                                                                                           \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, true);                                                            \
                 GPUSparse;                                                                                              \
                 if (MatrixPointerToSetFlag != nullptr)                                                                  \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::GPU, MatrixType::SPARSE);  \
@@ -53,12 +60,14 @@
         {                                                                                                               \
             if ((MatrixPointerToCheck)->GetMatrixType() != MatrixType::SPARSE)                                          \
             {                                                                                                           \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, false);                                                           \
                 CPUDense;                                                                                               \
                 if (MatrixPointerToSetFlag != nullptr)                                                                  \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::CPU, MatrixType::DENSE);   \
             }                                                                                                           \
             else                                                                                                        \
             {                                                                                                           \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, false);                                                           \
                 CPUSparse;                                                                                              \
                 if (MatrixPointerToSetFlag != nullptr)                                                                  \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::CPU, MatrixType::SPARSE);  \
@@ -78,12 +87,14 @@
         {                                                                                                                            \
             if ((MatrixPointerToCheck)->GetMatrixType() != MatrixType::SPARSE)                                                       \
             {                                                                                                                        \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, true);                                                                         \
                 GPUDense;                                                                                                            \
                 if (MatrixPointerToSetFlag != nullptr)                                                                               \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::GPU, MatrixType::DENSE);                \
             }                                                                                                                        \
             else                                                                                                                     \
             {                                                                                                                        \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, true);                                                                         \
                 GPUSparse;                                                                                                           \
                 if (MatrixPointerToSetFlag != nullptr)                                                                               \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::GPU, MatrixType::SPARSE);               \
@@ -93,12 +104,14 @@
         {                                                                                                                            \
             if ((MatrixPointerToCheck)->GetMatrixType() != MatrixType::SPARSE)                                                       \
             {                                                                                                                        \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, false);                                                                        \
                 CPUDense;                                                                                                            \
                 if (MatrixPointerToSetFlag != nullptr)                                                                               \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::CPU, MatrixType::DENSE);                \
             }                                                                                                                        \
             else                                                                                                                     \
             {                                                                                                                        \
+                MATRIX_OP_SCOPE(MatrixPointerToCheck, false);                                                                        \
                 CPUSparse;                                                                                                           \
                 if (MatrixPointerToSetFlag != nullptr)                                                                               \
                     ((Matrix*) MatrixPointerToSetFlag)->SetDataLocation(CurrentDataLocation::CPU, MatrixType::SPARSE);               \
@@ -123,10 +136,12 @@
         {                                                                                               \
             if (curMatrixType == MatrixType::DENSE)                                                     \
             {                                                                                           \
+                MATRIX_OP_SCOPE(matrixPointer, true);                                                   \
                 GPUDense;                                                                               \
             }                                                                                           \
             else                                                                                        \
             {                                                                                           \
+                MATRIX_OP_SCOPE(matrixPointer, true);                                                   \
                 GPUSparse;                                                                              \
             }                                                                                           \
         }                                                                                               \
@@ -134,10 +149,12 @@
         {                                                                                               \
             if (curMatrixType == MatrixType::DENSE)                                                     \
             {                                                                                           \
+                MATRIX_OP_SCOPE(matrixPointer, false);                                                  \
                 CPUDense;                                                                               \
             }                                                                                           \
             else                                                                                        \
             {                                                                                           \
+                MATRIX_OP_SCOPE(matrixPointer, false);                                                  \
                 CPUSparse;                                                                              \
             }                                                                                           \
         }                                                                                               \
@@ -627,10 +644,66 @@ void Matrix<ElemType>::Read(File& stream)
             M.SetDataLocation(GPU, SPARSE);
         }
     }
+    else if (type == 'h') // dense, with the values in fp16, see WriteAsFloat16()
+    {
+        stream.GetMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        size_t elsize;
+        stream >> elsize;
+        if (elsize != sizeof(uint16_t))
+            RuntimeError("Read: Input file corrupt (fp16 matrix with an element size of %d).", (int) elsize);
+        std::wstring matrixName;
+        int format;
+        size_t numRows, numCols;
+        stream >> matrixName >> format >> numRows >> numCols;
+        std::vector<uint16_t> stored(numRows * numCols);
+        if (stream.IsTextBased())
+        {
+            for (auto& h : stored)
+                stream >> h;
+        }
+        else
+            stream.ReadBytes(stored.data(), stored.size() * sizeof(uint16_t));
+        std::vector<ElemType> values(stored.size());
+        for (size_t i = 0; i < values.size(); i++)
+            values[i] = (ElemType) Float16ToFloat(stored[i]);
+        stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+        M.SetValue(numRows, numCols, M.GetDeviceId(), values.data());
+    }
     else
         LogicError("Read: Input file corrupt (invalid matrix type field 0x%02d, should be 'f' or 'd').", type);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::WriteAsFloat16(File& stream) const
+{
+    if (GetMatrixType() != MatrixType::DENSE)
+        LogicError("WriteAsFloat16: Only dense matrices can be written in fp16.");
+    std::vector<ElemType> values(GetNumElements());
+    if (!values.empty())
+        CopySection(GetNumRows(), GetNumCols(), values.data(), GetNumRows());
+
+    stream << 'h';
+    stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+    stream << sizeof(uint16_t);
+    stream << std::wstring(L"unnamed") << (int) GetFormat();
+    stream << GetNumRows() << GetNumCols();
+    std::vector<uint16_t> stored(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        stored[i] = FloatToFloat16((float) values[i]);
+        if (!IsFloat16Finite(Float16Format::float16, stored[i]) && std::isfinite((float) values[i]))
+            RuntimeError("WriteAsFloat16: The value %g is out of the range of fp16.", (double) values[i]);
+    }
+    if (stream.IsTextBased())
+    {
+        for (auto h : stored)
+            stream << h;
+    }
+    else
+        stream.WriteBytes(stored.data(), stored.size() * sizeof(uint16_t));
+    stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::Write(File& stream) const
 {
@@ -1238,7 +1311,7 @@ void Matrix<ElemType>::AssignValuesOf(const Matrix<ElemType>& deepCopyFrom)
             // Set GPUMatrix from:
             DISPATCH_MATRIX_ON_FLAG(&deepCopyFrom, nullptr,
                 { m_GPUMatrix->SetValue(deepCopyFrom.GetNumRows(), deepCopyFrom.GetNumCols(), this->GetDeviceId(), deepCopyFrom.m_CPUMatrix->Data()); },
-                { m_GPUMatrix->SetValue(*deepCopyFrom.m_GPUMatrix); },
+                { m_GPUMatrix->SetValueFromOtherDevice(*deepCopyFrom.m_GPUMatrix); }, // (stays on our device if the source is on another GPU)
                 { LogicError("AssignValuesOf: Assigning a CPUSparseMatrix to a GPUMatrix is not yet implemented."); },//{ m_GPUMatrix->SetValue(*deepCopyFrom.m_CPUSparseMatrix); },
                 { LogicError("AssignValuesOf: Assigning a GPUSparseMatrix to a GPUMatrix is not yet implemented."); });//{ m_GPUMatrix->SetValue(*deepCopyFrom.m_GPUSparseMatrix); });
         },
@@ -1308,6 +1381,26 @@ void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCC
         { m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols); });
 }
 
+template <class ElemType>
+void Matrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+    DISPATCH_MATRIX_ON_FLAG(this, this,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->SetMatrixFromSBCFormat(blockIds, val, numBlocks, numRows, numCols); },
+        { m_GPUSparseMatrix->SetMatrixFromSBCFormat(blockIds, val, numBlocks, numRows, numCols); });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const
+{
+    DISPATCH_MATRIX_ON_FLAG(this, nullptr,
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; },
+        { m_CPUSparseMatrix->GetMatrixFromSBCFormat(blockIds, val); },
+        { m_GPUSparseMatrix->GetMatrixFromSBCFormat(blockIds, val); });
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1432,6 +1525,28 @@ void Matrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const ElemT
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::DoRandomlyMaskedCopyOf(const ElemType beta, const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter)
+{
+    if (a.IsEmpty())
+        return;
+
+    if (!(a.GetNumRows() == GetNumRows() && a.GetNumCols() == GetNumCols()))
+        InvalidArgument("DoRandomlyMaskedCopyOf: The input matrix dimensions do not match [this].");
+
+    DecideAndMoveToRightDevice(a, *this);
+
+    if (a.GetMatrixType() != GetMatrixType())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->DoRandomlyMaskedCopyOf(beta, *a.m_CPUMatrix, maskRate, scaleValue, seed, firstCounter),
+                            m_GPUMatrix->DoRandomlyMaskedCopyOf(beta, *a.m_GPUMatrix, maskRate, scaleValue, seed, firstCounter),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::NormalGrad(Matrix<ElemType>& gradients,
                                   Matrix<ElemType>& functionValues,
@@ -1512,6 +1627,86 @@ ElemType Matrix<ElemType>::Adagrad(Matrix<ElemType>& gradients, const bool needA
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+template <class ElemType>
+void Matrix<ElemType>::FusedNormalGrad(Matrix<ElemType>& gradients,
+                                       Matrix<ElemType>& functionValues,
+                                       const ElemType learnRatePerSample,
+                                       const ElemType momentum,
+                                       const bool useNesterovMomentum,
+                                       const ElemType clipThreshold,
+                                       const ElemType l2RegWeight)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { m_CPUMatrix->FusedNormalGrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, useNesterovMomentum, clipThreshold, l2RegWeight); SetDataLocation(CPU); functionValues.SetDataLocation(CPU, DENSE); },
+        { m_GPUMatrix->FusedNormalGrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, useNesterovMomentum, clipThreshold, l2RegWeight); SetDataLocation(GPU); functionValues.SetDataLocation(GPU, DENSE); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::FusedAdagrad(Matrix<ElemType>& gradients,
+                                    Matrix<ElemType>& functionValues,
+                                    const ElemType learnRatePerSample,
+                                    const ElemType clipThreshold,
+                                    const ElemType l2RegWeight)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { m_CPUMatrix->FusedAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, clipThreshold, l2RegWeight); SetDataLocation(CPU); functionValues.SetDataLocation(CPU, DENSE); },
+        { m_GPUMatrix->FusedAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, clipThreshold, l2RegWeight); SetDataLocation(GPU); functionValues.SetDataLocation(GPU, DENSE); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+}
+
+template <class ElemType>
+void Matrix<ElemType>::Adam(Matrix<ElemType>& gradients,
+                            Matrix<ElemType>& functionValues,
+                            const ElemType learnRatePerSample,
+                            const ElemType momentum,
+                            const ElemType varianceMomentum,
+                            const ElemType epsilon,
+                            const ElemType momentumCorrection,
+                            const ElemType varianceCorrection,
+                            const ElemType clipThreshold,
+                            const ElemType l2RegWeight,
+                            const bool layerwiseScaling)
+{
+    DecideAndMoveToRightDevice(*this, gradients, functionValues);
+
+    DISPATCH_MATRIX_ON_FLAG(&gradients, nullptr,
+        { m_CPUMatrix->Adam(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, varianceMomentum, epsilon, momentumCorrection, varianceCorrection, clipThreshold, l2RegWeight, layerwiseScaling); SetDataLocation(CPU); functionValues.SetDataLocation(CPU, DENSE); },
+        { m_GPUMatrix->Adam(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, varianceMomentum, epsilon, momentumCorrection, varianceCorrection, clipThreshold, l2RegWeight, layerwiseScaling); SetDataLocation(GPU); functionValues.SetDataLocation(GPU, DENSE); },
+        { NOT_IMPLEMENTED; },
+        { NOT_IMPLEMENTED; });
+
+    // LAMB: the step is in 'gradients'; scale it by the trust ratio of the whole matrix
+    if (layerwiseScaling)
+    {
+        double weightNorm = functionValues.FrobeniusNorm();
+        double stepNorm = gradients.FrobeniusNorm();
+        double trustRatio = (weightNorm > 0 && stepNorm > 0) ? weightNorm / stepNorm : 1.0;
+        ScaleAndAdd((ElemType)(-learnRatePerSample * trustRatio), gradients, functionValues);
+    }
+}
+
+template <class ElemType>
+void Matrix<ElemType>::Lars(Matrix<ElemType>& gradients,
+                            Matrix<ElemType>& functionValues,
+                            const ElemType learnRatePerSample,
+                            const ElemType momentum,
+                            const bool useNesterovMomentum,
+                            const double trustCoefficient)
+{
+    double weightNorm = functionValues.FrobeniusNorm();
+    double gradientNorm = gradients.FrobeniusNorm();
+    double trustRatio = (weightNorm > 0 && gradientNorm > 0) ? trustCoefficient * weightNorm / gradientNorm : 1.0;
+    FusedNormalGrad(gradients, functionValues, (ElemType)(learnRatePerSample * trustRatio), momentum, useNesterovMomentum,
+                    std::numeric_limits<ElemType>::infinity(), /*l2RegWeight=*/0);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum)
 {
@@ -1528,8 +1723,8 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { m_CPUMatrix->FSAdagrad(*gradients.m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(CPU); },
         { m_GPUMatrix->FSAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
-        { NOT_IMPLEMENTED; });
+        { gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(CPU); },
+        { gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes); SetDataLocation(GPU); });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
@@ -3475,11 +3670,13 @@ int Matrix<ElemType>::GetDeviceId() const
     if (m_currentDataLocation == CurrentDataLocation::NONE)
         return m_preferredDeviceId;
 
-    DISPATCH_MATRIX_ON_FLAG(this, nullptr,
-        { return CPUDEVICE; },
-        { return m_GPUMatrix->GetComputeDeviceId(); },
-        { return CPUDEVICE; },
-        { return m_GPUSparseMatrix->GetComputeDeviceId(); });
+    // not dispatched through DISPATCH_MATRIX_ON_FLAG, which would trace this as an operation
+    if (m_currentDataLocation == CurrentDataLocation::CPU)
+        return CPUDEVICE;
+    else if (m_matrixType != MatrixType::SPARSE)
+        return m_GPUMatrix->GetComputeDeviceId();
+    else
+        return m_GPUSparseMatrix->GetComputeDeviceId();
 }
 
 // TODO: Comment why we need a second ElemType.
@@ -3968,6 +4165,49 @@ Matrix<ElemType>& Matrix<ElemType>::AssignNceUnnormalizedEval(const Matrix<ElemT
     return *this;
 }
 
+// this <-- log sum_c prior_c N(feature; mean_c, stddev_c^2 I), computed in a single pass over the columns, and
+//  - normedDeviationVectors <-- (feature - mean_c) / stddev_c^2, stacked over the components
+//  - normedDeviation <-- ||feature - mean_c||^2 / stddev_c^2
+//  - posterior <-- posterior of component c
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignGMMLogLikelihoodOf(const Matrix<ElemType>& prior, const Matrix<ElemType>& mean, const Matrix<ElemType>& stddev, const Matrix<ElemType>& feature,
+                                                             Matrix<ElemType>& normedDeviationVectors, Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior)
+{
+    if (prior.IsEmpty() || mean.IsEmpty() || stddev.IsEmpty() || feature.IsEmpty())
+        LogicError("AssignGMMLogLikelihoodOf: one of the input matrices is empty.");
+
+    const size_t numComponents = prior.GetNumRows();
+    const size_t numSamples = feature.GetNumCols();
+    if (stddev.GetNumRows() != numComponents || mean.GetNumRows() != numComponents * feature.GetNumRows())
+        InvalidArgument("AssignGMMLogLikelihoodOf: the dimensions of prior, mean, stddev and feature do not match.");
+    for (const auto* m : { &prior, &mean, &stddev })
+    {
+        if (m->GetNumCols() != 1 && m->GetNumCols() != numSamples)
+            InvalidArgument("AssignGMMLogLikelihoodOf: the parameters must have a single column or one per sample.");
+    }
+
+    DecideAndMoveToRightDevice(feature, *this, normedDeviationVectors);
+    DecideAndMoveToRightDevice(feature, normedDeviation, posterior);
+    if (prior.GetDeviceId() != feature.GetDeviceId() || mean.GetDeviceId() != feature.GetDeviceId() || stddev.GetDeviceId() != feature.GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    Resize(1, numSamples);
+    normedDeviationVectors.Resize(mean.GetNumRows(), numSamples);
+    normedDeviation.Resize(numComponents, numSamples);
+    posterior.Resize(numComponents, numSamples);
+
+    DISPATCH_MATRIX_ON_FLAG(&feature,
+                            this,
+                            m_CPUMatrix->AssignGMMLogLikelihoodOf(*prior.m_CPUMatrix, *mean.m_CPUMatrix, *stddev.m_CPUMatrix, *feature.m_CPUMatrix,
+                                                                  *normedDeviationVectors.m_CPUMatrix, *normedDeviation.m_CPUMatrix, *posterior.m_CPUMatrix),
+                            m_GPUMatrix->AssignGMMLogLikelihoodOf(*prior.m_GPUMatrix, *mean.m_GPUMatrix, *stddev.m_GPUMatrix, *feature.m_GPUMatrix,
+                                                                  *normedDeviationVectors.m_GPUMatrix, *normedDeviation.m_GPUMatrix, *posterior.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+
+    return *this;
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp)
 {
@@ -4113,6 +4353,57 @@ void Matrix<ElemType>::ConvolutionBackwardKernel(const Matrix<ElemType>& in, con
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::ConvolutionForward(const Matrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const Matrix<int>& mpKeyRun,
+                                          const Matrix<int>& runs, Matrix<ElemType>& output) const
+{
+    assert(mpKeyRun.GetNumCols() == 1);
+    assert(runs.GetNumCols() == 1);
+
+    DecideAndMoveToRightDevice(*this, output);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ConvolutionForward(*(kernel.m_CPUMatrix), geometry, *(mpKeyRun.m_CPUMatrix), *(runs.m_CPUMatrix), *(output.m_CPUMatrix)),
+                            m_GPUMatrix->ConvolutionForward(*(kernel.m_GPUMatrix), geometry, *(mpKeyRun.m_GPUMatrix), *(runs.m_GPUMatrix), *(output.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ConvolutionBackwardData(const Matrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const Matrix<int>& mpKeyRun,
+                                               const Matrix<int>& runs, Matrix<ElemType>& grad) const
+{
+    assert(mpKeyRun.GetNumCols() == 1);
+    assert(runs.GetNumCols() == 1);
+
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ConvolutionBackwardData(*(kernel.m_CPUMatrix), geometry, *(mpKeyRun.m_CPUMatrix), *(runs.m_CPUMatrix), *(grad.m_CPUMatrix)),
+                            m_GPUMatrix->ConvolutionBackwardData(*(kernel.m_GPUMatrix), geometry, *(mpKeyRun.m_GPUMatrix), *(runs.m_GPUMatrix), *(grad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::ConvolutionBackwardKernel(const Matrix<ElemType>& in, const CompactConvolveGeometry& geometry, const Matrix<int>& mpKeyRun,
+                                                 const Matrix<int>& runs, Matrix<ElemType>& kernelGrad) const
+{
+    assert(mpKeyRun.GetNumCols() == 1);
+    assert(runs.GetNumCols() == 1);
+
+    DecideAndMoveToRightDevice(*this, kernelGrad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->ConvolutionBackwardKernel(*(in.m_CPUMatrix), geometry, *(mpKeyRun.m_CPUMatrix), *(runs.m_CPUMatrix), *(kernelGrad.m_CPUMatrix)),
+                            m_GPUMatrix->ConvolutionBackwardKernel(*(in.m_GPUMatrix), geometry, *(mpKeyRun.m_GPUMatrix), *(runs.m_GPUMatrix), *(kernelGrad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const Matrix<int>& mpRowCol,
                                               const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& output) const
@@ -4273,6 +4564,46 @@ void Matrix<ElemType>::AveragePoolingBackward(const Matrix<int>& mpRowCol, const
                             NOT_IMPLEMENTED);
 }
 
+template <class ElemType>
+void Matrix<ElemType>::MaxPoolingBackwardByInput(const Matrix<ElemType>& out, const Matrix<ElemType>& in, const Matrix<int>& inRowStarts, const Matrix<int>& inRowSources,
+                                                 Matrix<ElemType>& grad) const
+{
+    assert(inRowStarts.GetNumCols() == 1);
+    assert(inRowSources.GetNumCols() == 1);
+    assert(inRowStarts.GetNumRows() == grad.GetNumRows() + 1);
+
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            m_GPUMatrix->MaxPoolingBackwardByInput(*(out.m_GPUMatrix), *(in.m_GPUMatrix), *(inRowStarts.m_GPUMatrix), *(inRowSources.m_GPUMatrix),
+                                                                     *(grad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AveragePoolingBackwardByInput(const Matrix<int>& mpRowIndices, const Matrix<int>& indices, const Matrix<int>& inRowStarts, const Matrix<int>& inRowSources,
+                                                     Matrix<ElemType>& grad) const
+{
+    assert(mpRowIndices.GetNumCols() == 1);
+    assert(indices.GetNumCols() == 1);
+    assert(inRowStarts.GetNumCols() == 1);
+    assert(inRowSources.GetNumCols() == 1);
+    assert(inRowStarts.GetNumRows() == grad.GetNumRows() + 1);
+
+    DecideAndMoveToRightDevice(*this, grad);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            m_GPUMatrix->AveragePoolingBackwardByInput(*(mpRowIndices.m_GPUMatrix), *(indices.m_GPUMatrix), *(inRowStarts.m_GPUMatrix), *(inRowSources.m_GPUMatrix),
+                                                                         *(grad.m_GPUMatrix)),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::BatchNormalizationForward(const Matrix<ElemType>& scale, const Matrix<ElemType>& bias, double expAvgFactor, double blendFactor, 
                                                  Matrix<ElemType>& runMean, Matrix<ElemType>& runInvStdDev, Matrix<ElemType>& out, double epsilon,
@@ -4361,9 +4692,15 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
 
     if (c.GetDeviceId() < 0) // CPU
     {
-        if (a.GetMatrixType() == MatrixType::SPARSE)
-            NOT_IMPLEMENTED;
-        if (b.GetMatrixType() == MatrixType::SPARSE)
+        if (a.GetMatrixType() == MatrixType::SPARSE) // Sparse*Dense+Dense
+        {
+            if (b.GetMatrixType() == MatrixType::SPARSE)
+                NOT_IMPLEMENTED;
+            c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+            CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix);
+            c.SetDataLocation(CPU, DENSE);
+        }
+        else if (b.GetMatrixType() == MatrixType::SPARSE)
         {
             if (c.GetMatrixType() == MatrixType::DENSE)
             {
@@ -4476,6 +4813,23 @@ template <class ElemType>
                             NOT_IMPLEMENTED);
 }
 
+// batched product of many small matrices, one per column; see declaration
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB,
+                                                             ElemType beta, Matrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+    DecideAndMoveToRightDevice(a, b, c);
+    if (a.GetMatrixType() != MatrixType::DENSE || b.GetMatrixType() != MatrixType::DENSE)
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&c,
+                            &c,
+                            CPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *a.m_CPUMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix, m, n, k),
+                            GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(alpha, *a.m_GPUMatrix, transposeA, *b.m_GPUMatrix, transposeB, beta, *c.m_GPUMatrix, m, n, k),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 /// <summary>Matrix-matrix multiply with col-major matrices (a and b may be transposed): c =  op(a) * op(b) + c</summary>
 /// <param name="a">Input matrix</param>
 /// <param name="transposeA">Whether matrix a is transposed</param>
@@ -5240,6 +5594,202 @@ Matrix<ElemType>& Matrix<ElemType>::AssignElementProductOfWithShift(const Matrix
     return *this;
 }
 
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                           Matrix<ElemType>& invNormA, Matrix<ElemType>& invNormB)
+{
+    if (a.IsEmpty() || b.IsEmpty())
+        LogicError("AssignCosDistanceWithNegativeSamplesOf: one of the input matrices is empty.");
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AssignCosDistanceWithNegativeSamplesOf: The input matrix dimensions do not match.");
+    if (a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(a, b, *this, invNormA);
+    DecideAndMoveToRightDevice(a, b, invNormB);
+    SwitchToMatrixType(DENSE, matrixFormatDense, false);
+
+    Resize(negNumber + 1, a.GetNumCols());
+    invNormA.Resize(1, a.GetNumCols());
+    invNormB.Resize(1, a.GetNumCols());
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignCosDistanceWithNegativeSamplesOf(*a.m_CPUMatrix, *b.m_CPUMatrix, shift, negNumber, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix),
+                            m_GPUMatrix->AssignCosDistanceWithNegativeSamplesOf(*a.m_GPUMatrix, *b.m_GPUMatrix, shift, negNumber, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB,
+                                                                 const Matrix<ElemType>& value, const Matrix<ElemType>& valueGradient, size_t shift, Matrix<ElemType>& gradient)
+{
+    if (inputIndex > 1)
+        InvalidArgument("AddCosDistanceWithNegativeSamplesGradient: inputIndex must be 0 or 1.");
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols() || gradient.GetNumRows() != a.GetNumRows() || gradient.GetNumCols() != a.GetNumCols() ||
+        value.GetNumCols() != a.GetNumCols() || valueGradient.GetNumRows() != value.GetNumRows() || valueGradient.GetNumCols() != value.GetNumCols() ||
+        invNormA.GetNumElements() != a.GetNumCols() || invNormB.GetNumElements() != a.GetNumCols())
+        InvalidArgument("AddCosDistanceWithNegativeSamplesGradient: The matrix dimensions do not match.");
+    if (gradient.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    if (a.GetDeviceId() != gradient.GetDeviceId() || b.GetDeviceId() != gradient.GetDeviceId() || invNormA.GetDeviceId() != gradient.GetDeviceId() ||
+        invNormB.GetDeviceId() != gradient.GetDeviceId() || value.GetDeviceId() != gradient.GetDeviceId() || valueGradient.GetDeviceId() != gradient.GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&gradient,
+                            &gradient,
+                            CPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(inputIndex, *a.m_CPUMatrix, *b.m_CPUMatrix, *invNormA.m_CPUMatrix, *invNormB.m_CPUMatrix,
+                                                                                           *value.m_CPUMatrix, *valueGradient.m_CPUMatrix, shift, *gradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(inputIndex, *a.m_GPUMatrix, *b.m_GPUMatrix, *invNormA.m_GPUMatrix, *invNormB.m_GPUMatrix,
+                                                                                           *value.m_GPUMatrix, *valueGradient.m_GPUMatrix, shift, *gradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::AddKhatriRaoProductGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& aGradient, Matrix<ElemType>& bGradient)
+{
+    if (a.GetNumCols() != b.GetNumCols() || gradient.GetNumRows() != a.GetNumRows() * b.GetNumRows() || gradient.GetNumCols() != a.GetNumCols() ||
+        aGradient.GetNumRows() != a.GetNumRows() || aGradient.GetNumCols() != a.GetNumCols() || bGradient.GetNumRows() != b.GetNumRows() || bGradient.GetNumCols() != b.GetNumCols())
+        InvalidArgument("AddKhatriRaoProductGradient: The matrix dimensions do not match.");
+    if (gradient.GetMatrixType() != DENSE || a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE || aGradient.GetMatrixType() != DENSE || bGradient.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+    if (gradient.GetDeviceId() != aGradient.GetDeviceId() || a.GetDeviceId() != aGradient.GetDeviceId() || b.GetDeviceId() != aGradient.GetDeviceId() || bGradient.GetDeviceId() != aGradient.GetDeviceId())
+        NOT_IMPLEMENTED;
+
+    DISPATCH_MATRIX_ON_FLAG(&aGradient,
+                            &aGradient,
+                            CPUMatrix<ElemType>::AddKhatriRaoProductGradient(*gradient.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, *aGradient.m_CPUMatrix, *bGradient.m_CPUMatrix),
+                            GPUMatrix<ElemType>::AddKhatriRaoProductGradient(*gradient.m_GPUMatrix, *a.m_GPUMatrix, *b.m_GPUMatrix, *aGradient.m_GPUMatrix, *bGradient.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AssignDiagTimesOf(const Matrix<ElemType>& diag, const Matrix<ElemType>& a)
+{
+    if (diag.GetNumElements() != a.GetNumRows())
+        InvalidArgument("AssignDiagTimesOf: The diagonal must have as many elements as the matrix has rows.");
+    if (a.GetMatrixType() != DENSE) // a sparse 'a' is densified first
+    {
+        AssignValuesOf(a);
+        return ColumnElementMultiplyWith(diag);
+    }
+
+    DecideAndMoveToRightDevice(a, diag, *this);
+    SwitchToMatrixType(DENSE, matrixFormatDense, false);
+    Resize(a.GetNumRows(), a.GetNumCols());
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignDiagTimesOf(*diag.m_CPUMatrix, *a.m_CPUMatrix, false),
+                            m_GPUMatrix->AssignDiagTimesOf(*diag.m_GPUMatrix, *a.m_GPUMatrix, false),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddDiagTimesOf(const Matrix<ElemType>& diag, const Matrix<ElemType>& a)
+{
+    if (diag.GetNumElements() != a.GetNumRows() || GetNumRows() != a.GetNumRows() || GetNumCols() != a.GetNumCols())
+        InvalidArgument("AddDiagTimesOf: The matrix dimensions do not match.");
+    if (GetMatrixType() != DENSE || diag.GetMatrixType() != DENSE || a.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(*this, diag, a);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AssignDiagTimesOf(*diag.m_CPUMatrix, *a.m_CPUMatrix, true),
+                            m_GPUMatrix->AssignDiagTimesOf(*diag.m_GPUMatrix, *a.m_GPUMatrix, true),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+Matrix<ElemType>& Matrix<ElemType>::AddRowInnerProductOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b)
+{
+    if (a.GetNumRows() != b.GetNumRows() || a.GetNumCols() != b.GetNumCols() || GetNumElements() != a.GetNumRows())
+        InvalidArgument("AddRowInnerProductOf: The matrix dimensions do not match.");
+    if (GetMatrixType() != DENSE || a.GetMatrixType() != DENSE || b.GetMatrixType() != DENSE)
+        NOT_IMPLEMENTED;
+
+    DecideAndMoveToRightDevice(*this, a, b);
+
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            m_CPUMatrix->AddRowInnerProductOf(*a.m_CPUMatrix, *b.m_CPUMatrix),
+                            m_GPUMatrix->AddRowInnerProductOf(*a.m_GPUMatrix, *b.m_GPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+    return *this;
+}
+
+template <class ElemType>
+void Matrix<ElemType>::RCRFForwardCompute(Matrix<ElemType>& alpha,
+                                          const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                          const int startLbl)
+{
+    DecideAndMoveToRightDevice(pos_scores, pair_scores, alpha);
+    alpha.Resize(pos_scores.GetNumRows(), pos_scores.GetNumCols());
+
+    DISPATCH_MATRIX_ON_FLAG(&pos_scores,
+                            &alpha,
+                            CPUMatrix<ElemType>::RCRFForwardCompute(
+                                *alpha.m_CPUMatrix,
+                                *pos_scores.m_CPUMatrix,
+                                *pair_scores.m_CPUMatrix,
+                                startLbl),
+                            GPUMatrix<ElemType>::RCRFForwardCompute(
+                                *alpha.m_GPUMatrix,
+                                *pos_scores.m_GPUMatrix,
+                                *pair_scores.m_GPUMatrix,
+                                startLbl),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::RCRFViterbiCompute(Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& decodedPath,
+                                          const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                          const int startLbl, const int endLbl)
+{
+    DecideAndMoveToRightDevice(pos_scores, pair_scores, alpha, backtrace);
+    decodedPath._transferToDevice(pos_scores.GetDeviceId());
+    alpha.Resize(pos_scores.GetNumRows(), pos_scores.GetNumCols());
+    backtrace.Resize(pos_scores.GetNumRows(), pos_scores.GetNumCols());
+    decodedPath.Resize(pos_scores.GetNumRows(), pos_scores.GetNumCols());
+
+    DISPATCH_MATRIX_ON_FLAG(&pos_scores,
+                            nullptr,
+                            CPUMatrix<ElemType>::RCRFViterbiCompute(
+                                *alpha.m_CPUMatrix,
+                                *backtrace.m_CPUMatrix,
+                                *decodedPath.m_CPUMatrix,
+                                *pos_scores.m_CPUMatrix,
+                                *pair_scores.m_CPUMatrix,
+                                startLbl, endLbl);
+                            alpha.SetDataLocation(CPU, DENSE);
+                            backtrace.SetDataLocation(CPU, DENSE);
+                            decodedPath.SetDataLocation(CPU, DENSE),
+                            GPUMatrix<ElemType>::RCRFViterbiCompute(
+                                *alpha.m_GPUMatrix,
+                                *backtrace.m_GPUMatrix,
+                                *decodedPath.m_GPUMatrix,
+                                *pos_scores.m_GPUMatrix,
+                                *pair_scores.m_GPUMatrix,
+                                startLbl, endLbl);
+                            alpha.SetDataLocation(GPU, DENSE);
+                            backtrace.SetDataLocation(GPU, DENSE);
+                            decodedPath.SetDataLocation(GPU, DENSE),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 void Matrix<ElemType>::RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
                                            Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
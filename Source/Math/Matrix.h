@@ -14,6 +14,7 @@
 #include "CommonMatrix.h"
 #include "TensorShape.h" // only for SmallVector; I was hoping to keep this out
 #include "RNGHandle.h"
+#include "CompactConvolveGeometry.h"
 #include <limits.h>
 #include <memory> // for shared_ptr
 #include <array>
@@ -192,6 +193,15 @@ public:
     // TODO: all these scalars should be passed as doubles and cast down inside
     void NormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG);
     ElemType Adagrad(Matrix<ElemType>& gradients, const bool needAveMultiplier);
+    // single-pass dense versions of gradient truncation to +-clipThreshold, L2 regularization and NormalGrad() resp. Adagrad() with the weight update; 'gradients' is left unchanged
+    void FusedNormalGrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG, const ElemType clipThreshold, const ElemType l2RegWeight);
+    void FusedAdagrad(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType clipThreshold, const ElemType l2RegWeight);
+    // Adam; 'this' holds the first and second moment estimates [m v], 'momentumCorrection' and 'varianceCorrection' are the bias corrections 1 / (1 - beta^t).
+    // With layerwiseScaling (LAMB), the step is scaled by ||w|| / ||step||, and 'gradients' is overwritten with the step.
+    void Adam(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const ElemType varianceMomentum, const ElemType epsilon,
+              const ElemType momentumCorrection, const ElemType varianceCorrection, const ElemType clipThreshold, const ElemType l2RegWeight, const bool layerwiseScaling);
+    // LARS: NormalGrad() with the learning rate scaled by trustCoefficient * ||w|| / ||g||
+    void Lars(Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum, const bool useNAG, const double trustCoefficient);
     void FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Matrix<ElemType>& functionValues, const ElemType learnRatePerSample, const ElemType momentum);
     ElemType RmsProp(Matrix<ElemType>& gradients, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
 
@@ -255,8 +265,13 @@ public:
     {
         SetValue(MakeNan(__LINE__));
     }
+    // h_Val may be null for values that are all 1 (one-hot input), which are then filled in on the device of the matrix
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
+    // sparse block-column format (the gradients of weights multiplied by sparse inputs): the ids of the numBlocks nonzero columns,
+    // and their values as (numRows x numBlocks) column-major array, on the CPU. Set makes this a sparse block-column matrix.
+    void SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols);
+    void GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const;
 
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
@@ -269,6 +284,9 @@ public:
     void SetUniformRandomValue(const ElemType low, const ElemType high, unsigned long seed = USE_TIME_BASED_SEED);
     void SetGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     void SetUniformRandomMask(const ElemType maskRate, const ElemType scaleValue, RNGHandle& rngHandle);
+    // this = beta * this + mask .* a, where mask is 0 with probability maskRate and scaleValue otherwise, regenerated
+    // from 'seed' and each element's index plus 'firstCounter' (same mask for the same arguments, on any device)
+    void DoRandomlyMaskedCopyOf(const ElemType beta, const Matrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter);
     void AddGaussianRandomValue(const ElemType mean, const ElemType sigma, unsigned long seed = USE_TIME_BASED_SEED);
     Matrix<ElemType>& AssignNoiseContrastiveEstimation(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias, Matrix<ElemType>& tmp);
 
@@ -276,6 +294,11 @@ public:
     Matrix<ElemType>& AssignSoftmaxSum(const Matrix<ElemType>& a, const Matrix<ElemType>& softmax);
     Matrix<ElemType>& AssignNceUnnormalizedEval(const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& c, const Matrix<ElemType>& bias);
 
+    // Log-likelihoods of the columns of 'feature' under a Gaussian mixture with a shared diagonal stddev per component,
+    // with the intermediate results the gradients need. prior, mean and stddev have either one column or one per sample.
+    Matrix<ElemType>& AssignGMMLogLikelihoodOf(const Matrix<ElemType>& prior, const Matrix<ElemType>& mean, const Matrix<ElemType>& stddev, const Matrix<ElemType>& feature,
+                                               Matrix<ElemType>& normedDeviationVectors, Matrix<ElemType>& normedDeviation, Matrix<ElemType>& posterior);
+
     Matrix<ElemType> Transpose(); // This method doesn't change state of Matrix. It should be a const function
     Matrix<ElemType>& AssignTransposeOf(const Matrix<ElemType>& a);
 
@@ -483,6 +506,13 @@ public:
                                  const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& grad) const;
     void ConvolutionBackwardKernel(const Matrix<ElemType>& in, const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIwht,
                                    const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& kernelGrad) const;
+    // The same, with the maps by row computed from the geometry and the runs looked up by key, see CompactConvolveGeometry.
+    void ConvolutionForward(const Matrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const Matrix<int>& mpKeyRun,
+                            const Matrix<int>& runs, Matrix<ElemType>& output) const;
+    void ConvolutionBackwardData(const Matrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const Matrix<int>& mpKeyRun,
+                                 const Matrix<int>& runs, Matrix<ElemType>& grad) const;
+    void ConvolutionBackwardKernel(const Matrix<ElemType>& in, const CompactConvolveGeometry& geometry, const Matrix<int>& mpKeyRun,
+                                   const Matrix<int>& runs, Matrix<ElemType>& kernelGrad) const;
 
     void UnrollConvolutionInput(size_t unrollCols, size_t mapOutSize, const Matrix<int>& mpRowCol,
                                 const Matrix<int>& mpRowRun, const Matrix<int>& runs, Matrix<ElemType>& output) const;
@@ -500,6 +530,13 @@ public:
     void AveragePoolingForward(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, Matrix<ElemType>& output) const;
     void AveragePoolingBackward(const Matrix<int>& mpRowCol, const Matrix<int>& mpRowIndices, const Matrix<int>& indices, Matrix<ElemType>& grad) const;
 
+    // Same as MaxPoolingBackward()/AveragePoolingBackward(), but gathered per row of the pooling input instead of scattered (GPU only):
+    // inRowSources[inRowStarts[row]], ..., inRowSources[inRowStarts[row + 1] - 1] are the output rows whose window includes input row 'row'.
+    void MaxPoolingBackwardByInput(const Matrix<ElemType>& out, const Matrix<ElemType>& in, const Matrix<int>& inRowStarts, const Matrix<int>& inRowSources,
+                                   Matrix<ElemType>& grad) const;
+    void AveragePoolingBackwardByInput(const Matrix<int>& mpRowIndices, const Matrix<int>& indices, const Matrix<int>& inRowStarts, const Matrix<int>& inRowSources,
+                                       Matrix<ElemType>& grad) const;
+
     void BatchNormalizationForward(const Matrix<ElemType>& scale, const Matrix<ElemType>& bias, double expAvgFactor, double blendFactor,
                                    Matrix<ElemType>& runMean, Matrix<ElemType>& runInvStdDev, Matrix<ElemType>& out, double epsilon,
                                    Matrix<ElemType>& saveMean, Matrix<ElemType>& saveInvStdDev) const;
@@ -519,6 +556,11 @@ public:
     static void SVD(const Matrix<ElemType>& A, Matrix<ElemType>& SIGMA, Matrix<ElemType>& U, Matrix<ElemType>& VT, Matrix<ElemType>& W);
 
     static void MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c); // SGEMM
+    // batched SGEMM for many small products: column j of a, b and c each holds one column-major matrix A_j, B_j and C_j,
+    // and C_j = alpha * op(A_j) * op(B_j) + beta * C_j, where op(A_j) is [m x k], op(B_j) is [k x n], and C_j is [m x n].
+    // a or b may have a single column, which is then used for all products. Dense only.
+    static void BatchedMultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, ElemType beta, Matrix<ElemType>& c,
+                                              size_t m, size_t n, size_t k);
     static void MultiplyAndAdd(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const bool transposeA, const Matrix<ElemType>& b, const bool transposeB, Matrix<ElemType>& c);
     static void Multiply(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c);
@@ -565,6 +607,8 @@ public:
 public:
     void Read(File& stream);
     void Write(File& stream) const;
+    // writes a dense matrix with its values rounded to fp16, at half the size (of float); Read() converts them back to ElemType
+    void WriteAsFloat16(File& stream) const;
 
     Matrix<ElemType>& Shift(const Matrix<ElemType>& a, int shift);
 
@@ -575,7 +619,37 @@ public:
     static void ConductRowElementMultiplyWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& c, size_t shift, bool bFirstmatrixfixed);
     Matrix<ElemType>& AssignElementProductOfWithShift(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift);
 
+    // Cosine similarities of the columns of 'a' [d x n] with those of 'b' and of negative samples formed by rotating 'b':
+    // this(0, j) = cos(a_j, b_j), this(i, j) = cos(a_j, b_((j + shift + i - 1) % n)) for i = 1..negNumber, in one pass,
+    // with invNormA and invNormB <-- the inverse norms of the columns [1 x n], which the gradient needs.
+    Matrix<ElemType>& AssignCosDistanceWithNegativeSamplesOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                             Matrix<ElemType>& invNormA, Matrix<ElemType>& invNormB);
+    // gradient += the gradient of the above w.r.t. 'a' (inputIndex 0) or 'b' (inputIndex 1), given its result 'value' and the gradient of that
+    static void AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const Matrix<ElemType>& a, const Matrix<ElemType>& b, const Matrix<ElemType>& invNormA, const Matrix<ElemType>& invNormB,
+                                                          const Matrix<ElemType>& value, const Matrix<ElemType>& valueGradient, size_t shift, Matrix<ElemType>& gradient);
+
+    // aGradient += the gradient of the Khatri-Rao product of 'a' and 'b' (see AssignKhatriRaoProductOf()) w.r.t. 'a', and bGradient += that w.r.t. 'b',
+    // given the gradient of the product, both in one pass over it
+    static void AddKhatriRaoProductGradient(const Matrix<ElemType>& gradient, const Matrix<ElemType>& a, const Matrix<ElemType>& b, Matrix<ElemType>& aGradient, Matrix<ElemType>& bGradient);
+
+    // this = diag(d) * a, i.e. the rows of 'a' [m x n] scaled by the elements of the column vector 'diag' [m x 1], without a copy of 'a'
+    Matrix<ElemType>& AssignDiagTimesOf(const Matrix<ElemType>& diag, const Matrix<ElemType>& a);
+    // this += diag(d) * a
+    Matrix<ElemType>& AddDiagTimesOf(const Matrix<ElemType>& diag, const Matrix<ElemType>& a);
+    // this [m x 1] += the inner products of the rows of 'a' and 'b' [m x n], i.e. this(i, 0) += sum_j a(i, j) * b(i, j)
+    Matrix<ElemType>& AddRowInnerProductOf(const Matrix<ElemType>& a, const Matrix<ElemType>& b);
+
 public:
+    // forward recursion of the CRF in log space, alpha(k, t) = pos_scores(k, t) + logsum_j (alpha(j, t-1) + pair_scores(k, j))
+    static void RCRFForwardCompute(Matrix<ElemType>& alpha,
+                                   const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                   const int startLbl); // the time 0 start symbol in the output layer
+
+    // Viterbi decoding: best-path scores and back pointers, and the decoded path as one-hot columns that end in 'endLbl'
+    static void RCRFViterbiCompute(Matrix<ElemType>& alpha, Matrix<ElemType>& backtrace, Matrix<ElemType>& decodedPath,
+                                   const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores,
+                                   const int startLbl, const int endLbl);
+
     static void RCRFBackwardCompute(const Matrix<ElemType>& alpha, Matrix<ElemType>& beta,
                                     Matrix<ElemType>& functionValues, const Matrix<ElemType>& lbls,
                                     const Matrix<ElemType>& pos_scores, const Matrix<ElemType>& pair_scores, const int shift);
@@ -0,0 +1,231 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Basics.h"
+#include "MatrixOpTracer.h"
+#include "GPUMatrix.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// bucket b holds the durations in [2^(b-1), 2^b) microseconds, bucket 0 those below 1 microsecond
+static const size_t s_numHistogramBuckets = 24;
+
+struct MatrixOpStats
+{
+    size_t count;
+    size_t bytes;
+    double totalMicroseconds;
+    double maxMicroseconds;
+    size_t histogram[s_numHistogramBuckets];
+};
+
+struct MatrixOpTraceEvent
+{
+    const char* name;
+    int pid; // 0 for host threads, 1 for the GPU
+    int tid; // host thread index
+    double startMicroseconds;
+    double durationMicroseconds;
+    size_t bytes;
+};
+
+// a GPU operation whose events have not been resolved yet
+struct PendingGPUOp
+{
+    MatrixOpStats* stats;
+    size_t traceEventIndex; // SIZE_MAX if not traced
+    void* startEvent;
+    void* stopEvent;
+};
+
+static bool s_isEnabled = false;
+static std::mutex s_mutex;
+static std::wstring s_chromeTraceFile;
+static size_t s_maxTraceEvents = 0;
+static std::chrono::steady_clock::time_point s_origin = std::chrono::steady_clock::now();
+static std::map<std::string, MatrixOpStats> s_stats;
+static std::vector<MatrixOpTraceEvent> s_traceEvents;
+static std::vector<PendingGPUOp> s_pendingGPUOps;
+static std::map<std::thread::id, int> s_threadIndices;
+
+// GPU events are resolved in batches, when the oldest of them have most likely completed already
+static const size_t s_maxPendingGPUOps = 1024;
+
+static double NowMicroseconds()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s_origin).count();
+}
+
+static void AddSample(MatrixOpStats& stats, double microseconds)
+{
+    stats.totalMicroseconds += microseconds;
+    stats.maxMicroseconds = std::max(stats.maxMicroseconds, microseconds);
+    size_t bucket = 0;
+    while ((bucket + 1 < s_numHistogramBuckets) && (microseconds >= (double) (1ull << bucket)))
+        bucket++;
+    stats.histogram[bucket]++;
+}
+
+static MatrixOpStats& StatsOf(const char* name, bool isOnGPU)
+{
+    std::string key = std::string(name) + (isOnGPU ? " [GPU]" : " [CPU]");
+    auto iter = s_stats.find(key);
+    if (iter == s_stats.end())
+    {
+        MatrixOpStats stats;
+        memset(&stats, 0, sizeof(stats));
+        iter = s_stats.insert(std::make_pair(key, stats)).first;
+    }
+    return iter->second;
+}
+
+// call with s_mutex held
+static void ResolvePendingGPUOps()
+{
+    for (auto& op : s_pendingGPUOps)
+    {
+        double microseconds = 1000.0 * GPUTimingEvent::ElapsedMilliseconds(op.startEvent, op.stopEvent);
+        if (microseconds < 0) // the op switched devices; count it without a duration
+            microseconds = 0;
+        AddSample(*op.stats, microseconds);
+        if (op.traceEventIndex != SIZE_MAX)
+            s_traceEvents[op.traceEventIndex].durationMicroseconds = microseconds;
+        GPUTimingEvent::Release(op.startEvent);
+        GPUTimingEvent::Release(op.stopEvent);
+    }
+    s_pendingGPUOps.clear();
+}
+
+/*static*/ void MatrixOpTracer::Enable(bool enable, const std::wstring& chromeTraceFile, size_t maxTraceEvents)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_isEnabled = enable;
+    s_chromeTraceFile = chromeTraceFile;
+    s_maxTraceEvents = chromeTraceFile.empty() ? 0 : maxTraceEvents;
+}
+
+/*static*/ bool MatrixOpTracer::IsEnabled()
+{
+    return s_isEnabled;
+}
+
+/*static*/ void MatrixOpTracer::Begin(Op& op, const char* name, bool isOnGPU, size_t bytes)
+{
+    op.name = name;
+    op.bytes = bytes;
+    op.gpuStartEvent = isOnGPU ? GPUTimingEvent::Record() : nullptr;
+    op.startMicroseconds = NowMicroseconds();
+}
+
+/*static*/ void MatrixOpTracer::End(Op& op)
+{
+    double endMicroseconds = NowMicroseconds();
+    void* gpuStopEvent = op.gpuStartEvent ? GPUTimingEvent::Record() : nullptr;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    MatrixOpStats& stats = StatsOf(op.name, op.gpuStartEvent != nullptr);
+    stats.count++;
+    stats.bytes += op.bytes;
+
+    size_t traceEventIndex = SIZE_MAX;
+    if (s_traceEvents.size() < s_maxTraceEvents)
+    {
+        MatrixOpTraceEvent event;
+        event.name = op.name;
+        event.pid = op.gpuStartEvent ? 1 : 0; // GPU ops are shown at the host time at which they were issued, with their GPU duration
+        event.tid = s_threadIndices.insert(std::make_pair(std::this_thread::get_id(), (int) s_threadIndices.size())).first->second;
+        event.startMicroseconds = op.startMicroseconds;
+        event.durationMicroseconds = endMicroseconds - op.startMicroseconds;
+        event.bytes = op.bytes;
+        traceEventIndex = s_traceEvents.size();
+        s_traceEvents.push_back(event);
+    }
+
+    if (op.gpuStartEvent)
+    {
+        PendingGPUOp pending = { &stats, traceEventIndex, op.gpuStartEvent, gpuStopEvent };
+        s_pendingGPUOps.push_back(pending);
+        if (s_pendingGPUOps.size() >= s_maxPendingGPUOps)
+            ResolvePendingGPUOps();
+    }
+    else
+        AddSample(stats, endMicroseconds - op.startMicroseconds);
+}
+
+static void WriteChromeTrace(const std::wstring& path)
+{
+    FILE* f = fopen(msra::strfun::utf8(path).c_str(), "w");
+    if (!f)
+        RuntimeError("MatrixOpTracer: Cannot open trace file '%ls' for writing.", path.c_str());
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU (issue time, GPU duration)\"}},\n");
+    for (size_t i = 0; i < s_traceEvents.size(); i++)
+    {
+        const auto& event = s_traceEvents[i];
+        fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}}%s\n",
+                event.name, event.pid, event.tid, event.startMicroseconds, event.durationMicroseconds, (unsigned long long) event.bytes,
+                (i + 1 < s_traceEvents.size()) ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    fclose(f);
+}
+
+/*static*/ void MatrixOpTracer::Report()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    ResolvePendingGPUOps();
+
+    // by total time, descending
+    std::vector<std::pair<double, const std::string*>> order;
+    double totalMicroseconds = 0;
+    for (const auto& stats : s_stats)
+    {
+        order.push_back(std::make_pair(stats.second.totalMicroseconds, &stats.first));
+        totalMicroseconds += stats.second.totalMicroseconds;
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<double, const std::string*>& a, const std::pair<double, const std::string*>& b)
+    {
+        return a.first > b.first;
+    });
+
+    fprintf(stderr, "\nMatrix operations (inclusive time; histogram buckets: <1us, <2us, <4us, ...):\n");
+    fprintf(stderr, "%12s %12s %8s %12s %12s %14s  %s\n", "count", "total ms", "%", "avg us", "max us", "MB", "operation");
+    for (const auto& entry : order)
+    {
+        const MatrixOpStats& stats = s_stats[*entry.second];
+        fprintf(stderr, "%12llu %12.3f %8.2f %12.3f %12.3f %14.3f  %s\n",
+                (unsigned long long) stats.count, stats.totalMicroseconds / 1000, totalMicroseconds > 0 ? 100 * stats.totalMicroseconds / totalMicroseconds : 0,
+                stats.count > 0 ? stats.totalMicroseconds / stats.count : 0, stats.maxMicroseconds, stats.bytes / 1e6, entry.second->c_str());
+        size_t lastBucket = s_numHistogramBuckets;
+        while ((lastBucket > 0) && (stats.histogram[lastBucket - 1] == 0))
+            lastBucket--;
+        fprintf(stderr, "%12s", "");
+        for (size_t b = 0; b < lastBucket; b++)
+            fprintf(stderr, " %llu", (unsigned long long) stats.histogram[b]);
+        fprintf(stderr, "\n");
+    }
+
+    if (!s_chromeTraceFile.empty())
+    {
+        WriteChromeTrace(s_chromeTraceFile);
+        fprintf(stderr, "Matrix operation trace with %d events written to '%ls'.\n", (int) s_traceEvents.size(), s_chromeTraceFile.c_str());
+    }
+}
+
+/*static*/ void MatrixOpTracer::Reset()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    ResolvePendingGPUOps();
+    s_stats.clear();
+    s_traceEvents.clear();
+}
+
+}}}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MatrixOpTracer.h -- opt-in per-operation statistics of the Matrix class
+//
+// When enabled, every Matrix operation that dispatches to a CPU or GPU implementation (see DISPATCH_MATRIX_ON_FLAG
+// in Matrix.cpp) is counted and timed: CPU operations by the wall clock, GPU operations by CUDA events on the
+// compute stream, which are resolved lazily, so that tracing does not synchronize the GPU. Report() prints a
+// histogram of the durations per operation, and optionally writes all operations as a Chrome trace
+// (chrome://tracing) file. Nested operations are included in the time of the outer one.
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API MatrixOpTracer
+{
+public:
+    // chromeTraceFile: if not empty, Report() writes the recorded operations to it; at most maxTraceEvents are kept
+    static void Enable(bool enable, const std::wstring& chromeTraceFile = std::wstring(), size_t maxTraceEvents = 1000000);
+    static bool IsEnabled();
+
+    // print the statistics to stderr and write the trace file, if any
+    static void Report();
+    static void Reset();
+
+    // token of an operation in flight, see MatrixOpScope
+    struct Op
+    {
+        const char* name;
+        size_t bytes;
+        double startMicroseconds; // host time
+        void* gpuStartEvent; // null for CPU operations
+    };
+    static void Begin(Op& op, const char* name, bool isOnGPU, size_t bytes);
+    static void End(Op& op);
+};
+
+// records the enclosing scope as one operation of MatrixOpTracer, if enabled
+class MatrixOpScope
+{
+public:
+    MatrixOpScope(const char* name, bool isOnGPU, size_t bytes)
+        : m_isActive(MatrixOpTracer::IsEnabled())
+    {
+        if (m_isActive)
+            MatrixOpTracer::Begin(m_op, name, isOnGPU, bytes);
+    }
+    ~MatrixOpScope()
+    {
+        if (m_isActive)
+            MatrixOpTracer::End(m_op);
+    }
+
+private:
+    MatrixOpScope(const MatrixOpScope&) = delete;
+    void operator=(const MatrixOpScope&) = delete;
+
+    bool m_isActive;
+    MatrixOpTracer::Op m_op;
+};
+
+}}}
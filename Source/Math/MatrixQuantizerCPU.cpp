@@ -1,8 +1,71 @@
 #include "stdafx.h"
 #include "MatrixQuantizerCPU.h"
+#include "CPUVectorKernels.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Columns of float quantized to 1 to 16 bits go through the AVX2/AVX-512 kernels of CPUVectorKernels; they produce
+// the same bit layout as ColumnQuantizer, which does the rest. These return false if the column is not handled.
+template <class ElemType>
+static bool QuantizeColumnVectorized(const ElemType*, const ElemType*, ElemType*, size_t, size_t, bool, QuantizedColumn<ElemType>&)
+{
+    return false;
+}
+
+template <class ElemType>
+static bool UnquantizeColumnVectorized(const QuantizedColumn<ElemType>&, size_t, size_t, bool, ElemType*)
+{
+    return false;
+}
+
+static CPUQuantizationParameters GetQuantizationParameters(size_t nBits, float lower, float upper, bool zeroThresholdFor1Bit)
+{
+    ValueQuantizer<float> valQ(ValueQuantizer<float>::ld(nBits), lower, upper);
+    CPUQuantizationParameters params;
+    params.numBits = nBits;
+    params.lower = lower;
+    params.upper = upper;
+    params.qfactor = valQ.QFactor();
+    params.ufactor = valQ.UFactor();
+    params.threshold = zeroThresholdFor1Bit ? 0.0f : valQ.QuantiMid();
+    return params;
+}
+
+// the same as ColumnQuantizer<float>::ComputeRangeStatColj() and Quantize(), for column pointers
+static bool QuantizeColumnVectorized(const float* in, const float* inResidual, float* outResidual, size_t nRow, size_t nBits, bool zeroThresholdFor1Bit, QuantizedColumn<float>& qcol)
+{
+    if (nBits >= 32)
+        return false;
+    const auto& kernels = CPUVectorKernels::Get();
+
+    float mean = 0.0f;
+    if (!zeroThresholdFor1Bit || (nBits != 1))
+        mean = kernels.sumOfSums(in, inResidual, nRow) / nRow;
+    if (nBits == 1)
+    {
+        float sum0, sum1;
+        size_t num0;
+        kernels.levelSums(in, inResidual, mean, nRow, &sum0, &sum1, &num0);
+        if (zeroThresholdFor1Bit)
+            ColumnQuantizer<float>::RangeFromLevelSums<true>(mean, sum0, sum1, (unsigned int) num0, (unsigned int) (nRow - num0), nRow, qcol.lower, qcol.upper);
+        else
+            ColumnQuantizer<float>::RangeFromLevelSums<false>(mean, sum0, sum1, (unsigned int) num0, (unsigned int) (nRow - num0), nRow, qcol.lower, qcol.upper);
+    }
+    else
+        ColumnQuantizer<float>::RangeFromVariance(mean, kernels.sumOfSquaredDeviations(in, inResidual, mean, nRow), nRow, qcol.lower, qcol.upper);
+
+    kernels.quantizeColumn(in, inResidual, outResidual, nRow, GetQuantizationParameters(nBits, qcol.lower, qcol.upper, zeroThresholdFor1Bit), qcol.bits);
+    return true;
+}
+
+static bool UnquantizeColumnVectorized(const QuantizedColumn<float>& qcol, size_t nRow, size_t nBits, bool add, float* out)
+{
+    if (nBits >= 32)
+        return false;
+    CPUVectorKernels::Get().unquantizeColumn(qcol.bits, nRow, GetQuantizationParameters(nBits, qcol.lower, qcol.upper, false), add, out);
+    return true;
+}
+
 template <class ElemType>
 MatrixQuantizerCPU<ElemType>::MatrixQuantizerCPU()
     : MatrixQuantizerImpl<ElemType>(CPUDEVICE)
@@ -30,10 +93,14 @@ void MatrixQuantizerCPU<ElemType>::QuantizeAsync(const Matrix<ElemType>& inMatri
 #ifdef QUANTUSEPPL
     Concurrency::parallel_for((size_t) 0, us.cols(), [&](size_t j)
 #else
-    for (size_t j = 0; j < nCol; j++)
+#pragma omp parallel for if (nRow * nCol >= CPUMatrix<ElemType>::GetParallelGrainSize())
+    for (long j = 0; j < (long) nCol; j++)
 #endif
                               {
                                   auto& qcol = *(outQMatrix.GetQuantizedColumn(j));
+                                  if (QuantizeColumnVectorized(inMatrix.Data() + j * nRow, inResidual.Data() + j * nRow, outResidual.Data() + j * nRow, nRow, nBits, zeroThresholdFor1Bit, qcol))
+                                      continue;
+
                                   if (zeroThresholdFor1Bit)
                                   {
                                       // Explicit use of 'template' keyword is needed to compile with GCC
@@ -68,6 +135,12 @@ void MatrixQuantizerCPU<ElemType>::WaitQuantizeAsyncDone()
     // TODO: Currently this is a no-op since the actual quantization is synchronous
 }
 
+template <class ElemType>
+bool MatrixQuantizerCPU<ElemType>::IsQuantizeAsyncDone()
+{
+    return true;
+}
+
 // unquantize an entire matrix, calling unquantize() for each column
 template <class ElemType>
 void MatrixQuantizerCPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add /*= false*/)
@@ -87,10 +160,14 @@ void MatrixQuantizerCPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& in
 #ifdef QUANTUSEPPL
     Concurrency::parallel_for((size_t) 0, us.cols(), [&](size_t j)
 #else
-    for (size_t j = 0; j < nCol; j++)
+#pragma omp parallel for if (nRow * nCol >= CPUMatrix<ElemType>::GetParallelGrainSize())
+    for (long j = 0; j < (long) nCol; j++)
 #endif
                               {
                                   const auto& qcol = *(inQMatrix.GetQuantizedColumn(j));
+                                  if (UnquantizeColumnVectorized(qcol, nRow, nBits, add, outMatrix.Data() + j * nRow))
+                                      continue;
+
                                   ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
                                   q.Unquantize(outMatrix.Data(), (long) nRow, j, qcol.bits, add);
                               }
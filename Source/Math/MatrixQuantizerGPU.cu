@@ -283,6 +283,18 @@ void MatrixQuantizerGPU<ElemType>::WaitQuantizeAsyncDone()
     }
 }
 
+template <class ElemType>
+bool MatrixQuantizerGPU<ElemType>::IsQuantizeAsyncDone()
+{
+    PrepareDevice(this->GetDeviceId());
+
+    auto rc = cudaEventQuery(m_quantizeOpIncludedFetch ? m_fetchCompleteEvent : m_quantizeCompleteEvent);
+    if (rc == cudaErrorNotReady)
+        return false;
+    rc || "cudaEventQuery failed";
+    return true;
+}
+
 template <class ElemType>
 void MatrixQuantizerGPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add /*= false*/)
 {
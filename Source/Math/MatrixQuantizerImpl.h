@@ -29,6 +29,7 @@ public:
 
     virtual void QuantizeAsync(const Matrix<ElemType>& inMatrix, const Matrix<ElemType>& inResidual, QuantizedMatrix<ElemType>& outQMatrix, Matrix<ElemType>& outResidual, bool zeroThresholdFor1Bit) = 0;
     virtual void WaitQuantizeAsyncDone() = 0;
+    virtual bool IsQuantizeAsyncDone() = 0; // non-blocking test whether the last QuantizeAsync(), including its fetch, has finished
 
     virtual void UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add = false) = 0;
     virtual void WaitUnquantizeAsyncDone() = 0;
@@ -248,8 +248,10 @@ ElemType GPUSparseMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& c, const bool n
 {
     return 1;
 }
-//template<class ElemType>
-//void GPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemType>&, ElemType, ElemType, ElemType, ElemType) { }
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& c, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+}
 
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUSparseMatrix<ElemType>& a, const bool transposeA,
@@ -664,6 +666,16 @@ void GPUSparseMatrix<ElemType>::SetMatrixFromCSRFormat(const CPUSPARSE_INDEX_TYP
 {
 }
 
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::SetMatrixFromSBCFormat(const size_t* blockIds, const ElemType* val, const size_t numBlocks, const size_t numRows, const size_t numCols)
+{
+}
+
+template <class ElemType>
+void GPUSparseMatrix<ElemType>::GetMatrixFromSBCFormat(std::vector<size_t>& blockIds, std::vector<ElemType>& val) const
+{
+}
+
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::GetMatrixFromCSRFormat(CPUSPARSE_INDEX_TYPE*& h_CSRRow, CPUSPARSE_INDEX_TYPE*& h_Col, ElemType*& h_Val, size_t& numElemAllocated, size_t& nz, size_t& numRows, size_t& numCols) const
 {
@@ -682,6 +694,11 @@ template <class ElemType>
 void GPUSparseMatrix<ElemType>::ConvertToSparseFormat(MatrixFormat newFormat, GPUSparseMatrix<ElemType>& outMatrix) const
 {
 }
+template <class ElemType>
+const GPUSparseMatrix<ElemType>& GPUSparseMatrix<ElemType>::GetConvertedSparseFormat(MatrixFormat newFormat) const
+{
+    return *this;
+}
 
 template <class ElemType>
 void GPUSparseMatrix<ElemType>::ConvolveAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const bool transposeA, const GPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, GPUMatrix<ElemType>& c, size_t numChannels, size_t horizontalSubsample, bool padding, bool channelwise){};
@@ -731,6 +748,27 @@ MATH_API File& operator<<(File& stream, const GPUSparseMatrix<ElemType>& us)
 template MATH_API File& operator<<(File& stream, const GPUSparseMatrix<float>& us);
 template MATH_API File& operator<<(File& stream, const GPUSparseMatrix<double>& us);
 
+#pragma region TracingGPUMemoryAllocator
+
+void TracingGPUMemoryAllocator::ReleaseCachedMemory(int deviceId)
+{
+}
+
+GPUMemoryAllocatorStatistics TracingGPUMemoryAllocator::GetStatistics(int deviceId)
+{
+    return GPUMemoryAllocatorStatistics();
+}
+
+void TracingGPUMemoryAllocator::PrintStatistics(int deviceId)
+{
+}
+
+void TracingGPUMemoryAllocator::ResetPeakStatistics(int deviceId)
+{
+}
+
+#pragma endregion TracingGPUMemoryAllocator
+
 #pragma region DeviceBoundNumber class
 
 template <class ElemType>
@@ -1013,6 +1051,11 @@ void GPUMatrix<ElemType>::SetValue(GPUSparseMatrix<ElemType> const&)
 }
 #endif
 
+template <class ElemType>
+void GPUMatrix<ElemType>::SetValueFromOtherDevice(const GPUMatrix<ElemType>& /*deepCopyFrom*/)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, size_t matrixFlags)
 {
@@ -1045,12 +1088,30 @@ void GPUMatrix<ElemType>::SetUniformRandomMask(const ElemType maskRate, const El
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::DoRandomlyMaskedCopyOf(const ElemType beta, const GPUMatrix<ElemType>& a, const ElemType maskRate, const ElemType scaleValue, unsigned long long seed, size_t firstCounter)
+{
+}
+
 template <class ElemType>
 ElemType GPUMatrix<ElemType>::Adagrad(GPUMatrix<ElemType>& gradients, const bool needAveMultiplier)
 {
     return 0;
 }
 template <class ElemType>
+void GPUMatrix<ElemType>::FusedNormalGrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, bool useNAG, ElemType clipThreshold, ElemType l2RegWeight)
+{
+}
+template <class ElemType>
+void GPUMatrix<ElemType>::FusedAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType clipThreshold, ElemType l2RegWeight)
+{
+}
+template <class ElemType>
+void GPUMatrix<ElemType>::Adam(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType varianceMomentum, ElemType epsilon,
+                               ElemType momentumCorrection, ElemType varianceCorrection, ElemType clipThreshold, ElemType l2RegWeight, bool returnStepInGradients)
+{
+}
+template <class ElemType>
 void GPUMatrix<ElemType>::FSAdagrad(GPUMatrix<ElemType>& gradients, GPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
 {
 }
@@ -1538,6 +1599,33 @@ void GPUMatrix<ElemType>::ConductRowElementMultiplyWithShift(const GPUMatrix<Ele
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignCosDistanceWithNegativeSamplesOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, size_t shift, size_t negNumber,
+                                                                 GPUMatrix<ElemType>& invNormA, GPUMatrix<ElemType>& invNormB)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddCosDistanceWithNegativeSamplesGradient(size_t inputIndex, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, const GPUMatrix<ElemType>& invNormA, const GPUMatrix<ElemType>& invNormB,
+                                                                    const GPUMatrix<ElemType>& value, const GPUMatrix<ElemType>& valueGradient, size_t shift, GPUMatrix<ElemType>& gradient)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddKhatriRaoProductGradient(const GPUMatrix<ElemType>& gradient, const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& aGradient, GPUMatrix<ElemType>& bGradient)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignDiagTimesOf(const GPUMatrix<ElemType>& diag, const GPUMatrix<ElemType>& a, bool accumulate)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AddRowInnerProductOf(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b)
+{
+}
+
 template <class ElemType>
 DeviceBoundNumber<ElemType> GPUMatrix<ElemType>::Sum_AsDeviceBoundNum() const
 {
@@ -1798,6 +1886,24 @@ void GPUMatrix<ElemType>::ConvolutionBackwardKernel(const GPUMatrix<ElemType>& i
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::ConvolutionForward(const GPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                               const GPUMatrix<int>& runs, GPUMatrix<ElemType>& output) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ConvolutionBackwardData(const GPUMatrix<ElemType>& kernel, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                                    const GPUMatrix<int>& runs, GPUMatrix<ElemType>& grad) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::ConvolutionBackwardKernel(const GPUMatrix<ElemType>& in, const CompactConvolveGeometry& geometry, const GPUMatrix<int>& mpKeyRun,
+                                                      const GPUMatrix<int>& runs, GPUMatrix<ElemType>& kernelGrad) const
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::MaxPoolingForward(const GPUMatrix<int>& mpRowCol, const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, GPUMatrix<ElemType>& output) const
 {
@@ -1825,6 +1931,18 @@ void GPUMatrix<ElemType>::AveragePoolingBackward(const GPUMatrix<int>& mpRowCol,
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::MaxPoolingBackwardByInput(const GPUMatrix<ElemType>& out, const GPUMatrix<ElemType>& in, const GPUMatrix<int>& inRowStarts, const GPUMatrix<int>& inRowSources,
+                                                    GPUMatrix<ElemType>& grad) const
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::AveragePoolingBackwardByInput(const GPUMatrix<int>& mpRowIndices, const GPUMatrix<int>& indices, const GPUMatrix<int>& inRowStarts, const GPUMatrix<int>& inRowSources,
+                                                        GPUMatrix<ElemType>& grad) const
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::BatchNormalizationForward(const GPUMatrix<ElemType>& scale, const GPUMatrix<ElemType>& bias, double expAvgFactor, double blendFactor, 
                                                     GPUMatrix<ElemType>& runMean, GPUMatrix<ElemType>& runInvStdDev, GPUMatrix<ElemType>& out, double epsilon,
@@ -1848,6 +1966,11 @@ void GPUMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix
 {
 }
 template <class ElemType>
+void GPUMatrix<ElemType>::BatchedMultiplyAndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& /*a*/, const bool transposeA, const GPUMatrix<ElemType>& /*b*/, const bool transposeB,
+                                                        ElemType beta, GPUMatrix<ElemType>& c, size_t m, size_t n, size_t k)
+{
+}
+template <class ElemType>
 void GPUMatrix<ElemType>::Multiply1x1AndWeightedAdd(ElemType alpha, const GPUMatrix<ElemType>& lhs, const GPUMatrix<ElemType>& rhs, ElemType beta, GPUMatrix<ElemType>& c)
 {
 }
@@ -2075,6 +2198,20 @@ ElemType GPUMatrix<ElemType>::LogSumOfElements() const
     return ElemType(0);
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFForwardCompute(GPUMatrix<ElemType>& alpha,
+                                             const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl)
+{
+}
+
+template <class ElemType>
+void GPUMatrix<ElemType>::RCRFViterbiCompute(GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& backtrace, GPUMatrix<ElemType>& decodedPath,
+                                             const GPUMatrix<ElemType>& pos_scores, const GPUMatrix<ElemType>& pair_scores,
+                                             const int startLbl, const int endLbl)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::RCRFBackwardCompute(
     const GPUMatrix<ElemType>& alpha, GPUMatrix<ElemType>& beta,
@@ -2111,6 +2248,12 @@ void GPUMatrix<ElemType>::AssignSoftmaxSum(const GPUMatrix<ElemType>& a, GPUMatr
 {
 }
 
+template <class ElemType>
+void GPUMatrix<ElemType>::AssignGMMLogLikelihoodOf(const GPUMatrix<ElemType>& prior, const GPUMatrix<ElemType>& mean, const GPUMatrix<ElemType>& stddev, const GPUMatrix<ElemType>& feature,
+                                                   GPUMatrix<ElemType>& normedDeviationVectors, GPUMatrix<ElemType>& normedDeviation, GPUMatrix<ElemType>& posterior)
+{
+}
+
 template <class ElemType>
 void GPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const GPUMatrix<ElemType>& a, const GPUMatrix<ElemType>& b, GPUMatrix<ElemType>& c)
 {
@@ -2138,6 +2281,12 @@ void MatrixQuantizerGPU<ElemType>::WaitQuantizeAsyncDone()
 {
 }
 
+template <class ElemType>
+bool MatrixQuantizerGPU<ElemType>::IsQuantizeAsyncDone()
+{
+    return true;
+}
+
 template <class ElemType>
 void MatrixQuantizerGPU<ElemType>::UnquantizeAsync(QuantizedMatrix<ElemType>& inQMatrix, Matrix<ElemType>& outMatrix, bool add /*= false*/)
 {
@@ -2192,6 +2341,12 @@ void GPUDataTransferer<ElemType>::WaitForCopyGPUToCPUAsync()
 {
 }
 
+template <class ElemType>
+bool GPUDataTransferer<ElemType>::IsCopyGPUToCPUAsyncComplete() const
+{
+    return true;
+}
+
 template <class ElemType>
 void GPUDataTransferer<ElemType>::CopyCPUToGPUAsync(ElemType*, size_t, ElemType*)
 {
@@ -2254,6 +2409,10 @@ bool CuDnnConvolutionEngineFactory<ElemType>::IsSupported(DEVICEID_TYPE, Convolv
 template class CuDnnConvolutionEngineFactory<float>;
 template class CuDnnConvolutionEngineFactory<double>;
 
+/*static*/ void CuDnnConvolutionAlgoCache::Configure(const std::wstring&, bool)
+{
+}
+
 template <class ElemType>
 std::unique_ptr<BatchNormEngine<ElemType>> CuDnnBatchNormEngineFactory<ElemType>::Create(DEVICEID_TYPE deviceId, const TensorShape& inOutT,
                                                                                          bool spatial, ImageLayoutKind imageLayout)
@@ -2264,6 +2423,15 @@ std::unique_ptr<BatchNormEngine<ElemType>> CuDnnBatchNormEngineFactory<ElemType>
 template class CuDnnBatchNormEngineFactory<float>;
 template class CuDnnBatchNormEngineFactory<double>;
 
+template <class ElemType>
+std::unique_ptr<RNNEngine<ElemType>> CuDnnRNNEngineFactory<ElemType>::Create(DEVICEID_TYPE, const RNNAttributes&, size_t)
+{
+    RuntimeError("The code is compiled with CPUONLY macro.");
+}
+
+template class CuDnnRNNEngineFactory<float>;
+template class CuDnnRNNEngineFactory<double>;
+
 CudaTimer::~CudaTimer()
 {
 }
@@ -2281,6 +2449,109 @@ float CudaTimer::Elapsed()
 /*static*/ void SyncGuard::EnableSync()
 {
 }
+
+/*static*/ void Float16Gemm::Enable(bool)
+{
+}
+/*static*/ bool Float16Gemm::IsEnabled()
+{
+    return false;
+}
+
+/*static*/ void TensorOpAutotuning::Configure(bool, const std::wstring&)
+{
+}
+/*static*/ bool TensorOpAutotuning::IsEnabled()
+{
+    return false;
+}
+
+/*static*/ void* GPUTimingEvent::Record()
+{
+    return nullptr;
+}
+/*static*/ float GPUTimingEvent::ElapsedMilliseconds(void*, void*)
+{
+    return 0;
+}
+/*static*/ void GPUTimingEvent::Release(void*)
+{
+}
+
+template <class ElemType>
+GPUInt8Gemm<ElemType>::GPUInt8Gemm(DEVICEID_TYPE)
+{
+    RuntimeError("The code is compiled with CPUONLY macro.");
+}
+template <class ElemType>
+GPUInt8Gemm<ElemType>::~GPUInt8Gemm()
+{
+}
+template <class ElemType>
+void GPUInt8Gemm<ElemType>::SetA(const int8_t*, const ElemType*, size_t, size_t)
+{
+}
+template <class ElemType>
+void GPUInt8Gemm<ElemType>::Multiply(const ElemType*, size_t, size_t, ElemType, ElemType*)
+{
+}
+template class GPUInt8Gemm<float>;
+template class GPUInt8Gemm<double>;
+
+/*static*/ bool GPUGraph::s_isEnabled = false;
+/*static*/ void GPUGraph::Enable(bool)
+{
+}
+/*static*/ bool GPUGraph::IsEnabled()
+{
+    return false;
+}
+/*static*/ bool GPUGraph::IsSupported()
+{
+    return false;
+}
+/*static*/ void GPUGraph::BeginCapture(DEVICEID_TYPE)
+{
+}
+/*static*/ void* GPUGraph::EndCapture()
+{
+    return nullptr;
+}
+/*static*/ void GPUGraph::Launch(void*)
+{
+}
+/*static*/ void GPUGraph::Destroy(void*)
+{
+}
+
+/*static*/ size_t GPUStreams::s_numStreams = 1;
+/*static*/ void GPUStreams::SetNumStreams(size_t)
+{
+}
+/*static*/ size_t GPUStreams::GetNumStreams()
+{
+    return 1;
+}
+/*static*/ void* GPUStreams::Select(DEVICEID_TYPE, size_t)
+{
+    return nullptr;
+}
+/*static*/ void GPUStreams::Restore(void*)
+{
+}
+/*static*/ void* GPUStreams::NewEvent(DEVICEID_TYPE)
+{
+    return nullptr;
+}
+/*static*/ void GPUStreams::DeleteEvent(void*)
+{
+}
+/*static*/ void GPUStreams::Record(void*)
+{
+}
+/*static*/ void GPUStreams::Wait(void*)
+{
+}
 } } }
 
 // define a dummy GPUWatcher class too
@@ -2296,6 +2567,11 @@ size_t GPUWatcher::GetFreeMemoryOnCUDADevice(int /*devId*/)
     return 0;
 }
 
+size_t GPUWatcher::GetTotalMemoryOnCUDADevice(int /*devId*/)
+{
+    return 0;
+}
+
 GPUWatcher::GPUWatcher(void)
 {
 }
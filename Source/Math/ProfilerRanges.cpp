@@ -0,0 +1,183 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Basics.h"
+#include "ProfilerRanges.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#ifndef CPUONLY
+#include <nvToolsExt.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+struct OpenProfilerRange
+{
+    const wchar_t* name;
+    double startMicroseconds;
+};
+
+struct ProfilerRangeThread
+{
+    int index;
+    std::vector<OpenProfilerRange> openRanges; // innermost last
+};
+
+struct ProfilerRangeTraceEvent
+{
+    const std::wstring* name; // key of s_names
+    int tid;                  // host thread index
+    double startMicroseconds;
+    double durationMicroseconds;
+};
+
+static bool s_isNvtxEnabled = false;
+static bool s_isRecording = false;
+static bool s_areNodeRangesEnabled = false;
+static std::mutex s_mutex;
+static std::wstring s_chromeTraceFile;
+static size_t s_maxTraceEvents = 0;
+static size_t s_numDroppedTraceEvents = 0;
+static std::chrono::steady_clock::time_point s_origin = std::chrono::steady_clock::now();
+static std::map<std::thread::id, ProfilerRangeThread> s_threads;
+static std::set<std::wstring> s_names; // (the names are copied, as node names may not outlive the trace)
+static std::vector<ProfilerRangeTraceEvent> s_traceEvents;
+
+static double NowMicroseconds()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s_origin).count();
+}
+
+// call with s_mutex held
+static ProfilerRangeThread& CurrentThread()
+{
+    auto iter = s_threads.find(std::this_thread::get_id());
+    if (iter == s_threads.end())
+    {
+        ProfilerRangeThread thread;
+        thread.index = (int) s_threads.size();
+        iter = s_threads.insert(std::make_pair(std::this_thread::get_id(), thread)).first;
+    }
+    return iter->second;
+}
+
+/*static*/ void ProfilerRanges::Enable(bool nvtx, const std::wstring& chromeTraceFile, bool nodeRanges, size_t maxTraceEvents)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+#ifdef CPUONLY
+    if (nvtx)
+        fprintf(stderr, "ProfilerRanges: NVTX ranges are not available in a CPU-only build.\n");
+    nvtx = false;
+#endif
+    s_isNvtxEnabled = nvtx;
+    s_isRecording = !chromeTraceFile.empty();
+    s_areNodeRangesEnabled = nodeRanges && (s_isNvtxEnabled || s_isRecording);
+    s_chromeTraceFile = chromeTraceFile;
+    s_maxTraceEvents = s_isRecording ? maxTraceEvents : 0;
+    s_numDroppedTraceEvents = 0;
+    s_threads.clear();
+    s_traceEvents.clear();
+}
+
+/*static*/ bool ProfilerRanges::IsEnabled()
+{
+    return s_isNvtxEnabled || s_isRecording;
+}
+
+/*static*/ bool ProfilerRanges::AreNodeRangesEnabled()
+{
+    return s_areNodeRangesEnabled;
+}
+
+/*static*/ void ProfilerRanges::Push(const wchar_t* name)
+{
+#ifndef CPUONLY
+    if (s_isNvtxEnabled)
+        nvtxRangePushW(name);
+#endif
+    if (s_isRecording)
+    {
+        OpenProfilerRange range = { name, NowMicroseconds() };
+        std::lock_guard<std::mutex> lock(s_mutex);
+        CurrentThread().openRanges.push_back(range);
+    }
+}
+
+/*static*/ void ProfilerRanges::Pop()
+{
+    if (s_isRecording)
+    {
+        double endMicroseconds = NowMicroseconds();
+        std::lock_guard<std::mutex> lock(s_mutex);
+        ProfilerRangeThread& thread = CurrentThread();
+        if (!thread.openRanges.empty()) // (empty if recording was enabled inside the range)
+        {
+            OpenProfilerRange range = thread.openRanges.back();
+            thread.openRanges.pop_back();
+            if (s_traceEvents.size() < s_maxTraceEvents)
+            {
+                ProfilerRangeTraceEvent event;
+                event.name = &*s_names.insert(std::wstring(range.name)).first;
+                event.tid = thread.index;
+                event.startMicroseconds = range.startMicroseconds;
+                event.durationMicroseconds = endMicroseconds - range.startMicroseconds;
+                s_traceEvents.push_back(event);
+            }
+            else
+                s_numDroppedTraceEvents++;
+        }
+    }
+#ifndef CPUONLY
+    if (s_isNvtxEnabled)
+        nvtxRangePop();
+#endif
+}
+
+// a name as the contents of a JSON string
+static std::string JsonEscaped(const std::wstring& name)
+{
+    std::string result;
+    for (char c : msra::strfun::utf8(name))
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char) c >= 0x20)
+            result += c;
+    }
+    return result;
+}
+
+/*static*/ void ProfilerRanges::Report()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_chromeTraceFile.empty())
+        return;
+
+    FILE* f = fopen(msra::strfun::utf8(s_chromeTraceFile).c_str(), "w");
+    if (!f)
+        RuntimeError("ProfilerRanges: Cannot open trace file '%ls' for writing.", s_chromeTraceFile.c_str());
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Host\"}}");
+    for (const auto& thread : s_threads)
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}", thread.second.index, thread.second.index);
+    for (const auto& event : s_traceEvents)
+    {
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                JsonEscaped(*event.name).c_str(), event.tid, event.startMicroseconds, event.durationMicroseconds);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    fprintf(stderr, "Profiler range trace with %d events written to '%ls'", (int) s_traceEvents.size(), s_chromeTraceFile.c_str());
+    if (s_numDroppedTraceEvents > 0)
+        fprintf(stderr, "; %d later events were dropped", (int) s_numDroppedTraceEvents);
+    fprintf(stderr, ".\n");
+}
+
+}}}
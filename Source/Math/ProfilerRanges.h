@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ProfilerRanges.h -- opt-in named ranges of host-side work, for correlating the host and device timelines
+//
+// A range brackets a piece of work that the host does or issues, such as reading a minibatch, the forward pass, or one
+// node of it, under a name. When enabled, each range is
+//  - an NVTX range (GPU builds only), which nvvp and Nsight show on the timeline of the host thread above the kernels
+//    it launched, and/or
+//  - recorded with its host time, for a Chrome trace (chrome://tracing) file that Report() writes.
+// Ranges nest on each thread. Per-node ranges, see ComputationNetwork::ForwardProp() and Backprop(), are separately
+// enabled, as they are many. A disabled range costs the test of a flag.
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MATH_API ProfilerRanges
+{
+public:
+    // nvtx: emit NVTX ranges; chromeTraceFile: if not empty, record the ranges, at most maxTraceEvents, for Report();
+    // nodeRanges: also a range per node of the network passes
+    static void Enable(bool nvtx, const std::wstring& chromeTraceFile = std::wstring(), bool nodeRanges = false, size_t maxTraceEvents = 1000000);
+    static bool IsEnabled();
+    static bool AreNodeRangesEnabled();
+
+    // write the trace file, if any
+    static void Report();
+
+    // the name must remain valid until the matching Pop()
+    static void Push(const wchar_t* name);
+    static void Pop();
+};
+
+// brackets the enclosing scope as a range of ProfilerRanges, if enabled
+class ProfilerRange
+{
+public:
+    explicit ProfilerRange(const wchar_t* name, bool isNodeRange = false)
+        : m_isActive(isNodeRange ? ProfilerRanges::AreNodeRangesEnabled() : ProfilerRanges::IsEnabled())
+    {
+        if (m_isActive)
+            ProfilerRanges::Push(name);
+    }
+    ~ProfilerRange()
+    {
+        if (m_isActive)
+            ProfilerRanges::Pop();
+    }
+
+private:
+    ProfilerRange(const ProfilerRange&) = delete;
+    void operator=(const ProfilerRange&) = delete;
+
+    bool m_isActive;
+};
+
+}}}
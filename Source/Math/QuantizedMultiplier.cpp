@@ -0,0 +1,158 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "QuantizedMultiplier.h"
+#include "BlockMultiplier.h"
+#include "CPUVectorKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <limits>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// The BlockMultiplier computes C = A * B on row-major int16 matrices, with B prepared once.
+// We use it with roles swapped, since a column-major (m x k) matrix is a row-major (k x m) one:
+// c^T = b^T a^T, where the row-major a^T is exactly the memory of our column-major a, and so on.
+class IQuantizedGemm
+{
+public:
+    virtual ~IQuantizedGemm() {}
+    virtual int16_t* CreateA(int m, int k) = 0;
+    virtual int32_t* CreateC(int m, int n) = 0;
+    virtual int16_t* PrepareB(int16_t* b, int k, int n) = 0;
+    virtual void Multiply(int16_t* a, int m, int k, int16_t* preparedB, int n, int32_t* c) = 0;
+    virtual void Free(void* p) = 0;
+};
+
+template <class BlockHandlerT>
+class QuantizedGemm : public IQuantizedGemm
+{
+    BlockMultiplier<BlockHandlerT> m_multiplier;
+
+public:
+    // with CPUMatrix's number of OpenMP threads; BlockMultiplier restores the previous number when destroyed
+    QuantizedGemm()
+        : m_multiplier(omp_get_max_threads())
+    {
+    }
+    int16_t* CreateA(int m, int k) override { return m_multiplier.CreateMatrixA(m, k); }
+    int32_t* CreateC(int m, int n) override { return m_multiplier.CreateMatrixC(m, n); }
+    int16_t* PrepareB(int16_t* b, int k, int n) override { return m_multiplier.PrepareB(b, k, n); }
+    void Multiply(int16_t* a, int m, int k, int16_t* preparedB, int n, int32_t* c) override { m_multiplier.MultiplyMatrices(a, m, k, preparedB, n, c); }
+    void Free(void* p) override { m_multiplier.FreeMatrix(p); }
+};
+
+static IQuantizedGemm* CreateQuantizedGemm()
+{
+#ifdef SUPPORT_AVX2
+    if (CPUSupports(CPUFeature::AVX2))
+        return new QuantizedGemm<BlockHandlerAVX>();
+#endif
+    if (CPUSupports(CPUFeature::SSE41))
+        return new QuantizedGemm<BlockHandlerSSE>();
+    return nullptr;
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::QuantizedMultiplier()
+    : m_gemm(nullptr), m_preparedA(nullptr), m_m(0), m_k(0), m_maxQuantizedValue(0)
+{
+}
+
+template <class ElemType>
+QuantizedMultiplier<ElemType>::~QuantizedMultiplier()
+{
+    Release();
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::Release()
+{
+    if (m_preparedA)
+        m_gemm->Free(m_preparedA);
+    delete m_gemm;
+    m_preparedA = nullptr;
+    m_gemm = nullptr;
+}
+
+template <class ElemType>
+/*static*/ bool QuantizedMultiplier<ElemType>::IsSupported()
+{
+    return CPUSupports(CPUFeature::SSE41);
+}
+
+// Each row of a is quantized with its own scale to [-maxQuantizedValue, maxQuantizedValue], and so is each column of b.
+template <class ElemType>
+static ElemType Quantize(const ElemType* x, size_t n, size_t stride, int maxQuantizedValue, int16_t* q)
+{
+    ElemType maxAbs = 0;
+    for (size_t i = 0; i < n; i++)
+        maxAbs = std::max(maxAbs, (ElemType) fabs(x[i * stride]));
+    ElemType scale = maxAbs > 0 ? maxQuantizedValue / maxAbs : 0;
+    for (size_t i = 0; i < n; i++)
+        q[i * stride] = (int16_t) floor(x[i * stride] * scale + (ElemType) 0.5);
+    return maxAbs / maxQuantizedValue; // the factor to undo the scaling
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::SetA(const ElemType* a, size_t m, size_t k)
+{
+    if ((m == 0) || (k == 0) || (m > INT_MAX) || (k > INT_MAX) || (m * k > INT_MAX))
+        InvalidArgument("QuantizedMultiplier: Unsupported matrix dimensions [%d x %d].", (int) m, (int) k);
+
+    // the prepared matrix is tied to the BlockMultiplier that prepared it
+    Release();
+    m_gemm = CreateQuantizedGemm();
+    if (!m_gemm)
+        RuntimeError("QuantizedMultiplier: This CPU does not support SSE4.1.");
+
+    m_m = m;
+    m_k = k;
+    // k products of at most maxQuantizedValue^2 each must fit into the int32 accumulators
+    m_maxQuantizedValue = std::min(1 << 13 /*BlockMultiplier::MAXRANGE*/, (int) sqrt((double) std::numeric_limits<int32_t>::max() / k));
+
+    // column-major a (m x k) is the row-major right operand (k x m) of the BlockMultiplier
+    int16_t* quantizedA = m_gemm->CreateA((int) k, (int) m);
+    m_rowScales.resize(m);
+    for (size_t j = 0; j < m; j++)
+        m_rowScales[j] = Quantize(a + j, k, m, m_maxQuantizedValue, quantizedA + j);
+    m_preparedA = m_gemm->PrepareB(quantizedA, (int) k, (int) m);
+    m_gemm->Free(quantizedA);
+}
+
+template <class ElemType>
+void QuantizedMultiplier<ElemType>::Multiply(const ElemType* b, size_t n, ElemType* c)
+{
+    if (!m_gemm)
+        LogicError("QuantizedMultiplier: Multiply() called before SetA().");
+    if ((n > INT_MAX) || (n * m_k > INT_MAX) || (n * m_m > INT_MAX))
+        InvalidArgument("QuantizedMultiplier: Too many columns (%d).", (int) n);
+
+    // column-major b (k x n) is the row-major left operand (n x k)
+    int16_t* quantizedB = m_gemm->CreateA((int) n, (int) m_k);
+    int32_t* product = m_gemm->CreateC((int) n, (int) m_m);
+    m_columnScales.resize(n);
+    for (size_t r = 0; r < n; r++)
+        m_columnScales[r] = Quantize(b + r * m_k, m_k, 1, m_maxQuantizedValue, quantizedB + r * m_k);
+    memset(product, 0, sizeof(int32_t) * n * m_m); // the block handlers accumulate into it
+
+    m_gemm->Multiply(quantizedB, (int) n, (int) m_k, m_preparedA, (int) m_m, product);
+
+    // row-major (n x m) result is column-major c (m x n)
+    for (size_t r = 0; r < n; r++)
+    {
+        for (size_t j = 0; j < m_m; j++)
+            c[r * m_m + j] = product[r * m_m + j] * m_rowScales[j] * m_columnScales[r];
+    }
+
+    m_gemm->Free(quantizedB);
+    m_gemm->Free(product);
+}
+
+template class QuantizedMultiplier<float>;
+template class QuantizedMultiplier<double>;
+
+}}}
@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// QuantizedMultiplier.h -- CPU matrix product with a fixed left operand, in 16-bit integer arithmetic
+//
+// Meant for inference, where the left operand is a weight matrix that does not change between calls:
+// it is quantized and rewritten into the block order of the BlockMultiplier once, and each product then
+// only needs to quantize the right operand. The SSE or AVX2 block handler is selected at runtime by CPUID.
+
+#pragma once
+
+#include "CommonMatrix.h"
+#include <cstdint>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class IQuantizedGemm; // BlockMultiplier instantiation, selected at runtime
+
+template <class ElemType>
+class MATH_API QuantizedMultiplier
+{
+public:
+    QuantizedMultiplier();
+    ~QuantizedMultiplier();
+
+    // whether this CPU has the instructions needed by the block handlers
+    static bool IsSupported();
+
+    // quantize and prepare the left operand 'a', a column-major (m x k) matrix
+    void SetA(const ElemType* a, size_t m, size_t k);
+
+    // c = a * b, with column-major b (k x n) and c (m x n); c is overwritten
+    void Multiply(const ElemType* b, size_t n, ElemType* c);
+
+    size_t GetNumRows() const { return m_m; }
+    size_t GetNumCols() const { return m_k; }
+
+private:
+    QuantizedMultiplier(const QuantizedMultiplier&) = delete;
+    void operator=(const QuantizedMultiplier&) = delete;
+
+    void Release();
+
+    IQuantizedGemm* m_gemm;
+    int16_t* m_preparedA;
+    size_t m_m;
+    size_t m_k;
+    int m_maxQuantizedValue; // chosen such that no sum of k products can overflow int32
+    std::vector<ElemType> m_rowScales; // [j] dequantization factor of row j of a
+    std::vector<ElemType> m_columnScales; // [r] dequantization factor of column r of the current b
+};
+
+}}}
@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "RNNEngine.h"
+#include "CuDnnFactories.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+size_t RNNAttributes::GetNumParameters(size_t inputSize) const
+{
+    // per layer and direction: one input and one recurrent matrix, and two bias vectors, per gate
+    size_t numGates = m_mode == RNNMode::LSTM ? 4 : m_mode == RNNMode::GRU ? 3 : 1;
+    size_t numParameters = 0;
+    for (size_t layer = 0; layer < m_numLayers; layer++)
+    {
+        size_t layerInputSize = layer == 0 ? inputSize : OutputSize();
+        numParameters += NumDirections() * numGates * m_hiddenSize * (layerInputSize + m_hiddenSize + 2);
+    }
+    return numParameters;
+}
+
+/*static*/ RNNMode RNNAttributes::ModeFrom(const std::wstring& name)
+{
+    if (name == L"lstm")
+        return RNNMode::LSTM;
+    else if (name == L"gru")
+        return RNNMode::GRU;
+    else if (name == L"rnnTanh")
+        return RNNMode::RNNTanh;
+    else if (name == L"rnnReLU")
+        return RNNMode::RNNReLU;
+    InvalidArgument("Unknown recurrent op '%ls'; must be 'lstm', 'gru', 'rnnTanh' or 'rnnReLU'.", name.c_str());
+}
+
+/*static*/ std::wstring RNNAttributes::NameOf(RNNMode mode)
+{
+    switch (mode)
+    {
+    case RNNMode::LSTM:    return L"lstm";
+    case RNNMode::GRU:     return L"gru";
+    case RNNMode::RNNTanh: return L"rnnTanh";
+    case RNNMode::RNNReLU: return L"rnnReLU";
+    default:               LogicError("Invalid RNNMode %d.", (int)mode);
+    }
+}
+
+template <class ElemType>
+void RNNEngine<ElemType>::Forward(const Mat& x, const Mat& w, Mat& y, const std::vector<size_t>& numSequencesPerFrame, bool isTraining)
+{
+    assert(x.GetNumRows() == m_inputSize);
+    assert(y.GetNumRows() == m_attributes.OutputSize());
+    assert(x.GetNumCols() == y.GetNumCols());
+    assert(w.GetNumElements() == m_attributes.GetNumParameters(m_inputSize));
+    ForwardCore(x, w, y, numSequencesPerFrame, isTraining);
+}
+
+template <class ElemType>
+void RNNEngine<ElemType>::BackwardData(const Mat& y, const Mat& dy, const Mat& w, Mat& dx, const std::vector<size_t>& numSequencesPerFrame)
+{
+    assert(y.GetNumRows() == dy.GetNumRows() && y.GetNumCols() == dy.GetNumCols());
+    assert(dx.GetNumRows() == m_inputSize && dx.GetNumCols() == y.GetNumCols());
+    BackwardDataCore(y, dy, w, dx, numSequencesPerFrame);
+}
+
+template <class ElemType>
+void RNNEngine<ElemType>::BackwardWeights(const Mat& x, const Mat& y, Mat& dw, const std::vector<size_t>& numSequencesPerFrame)
+{
+    assert(x.GetNumCols() == y.GetNumCols());
+    assert(dw.GetNumElements() == m_attributes.GetNumParameters(m_inputSize));
+    BackwardWeightsCore(x, y, dw, numSequencesPerFrame);
+}
+
+template <class ElemType>
+std::unique_ptr<RNNEngine<ElemType>> RNNEngine<ElemType>::Create(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, size_t inputSize)
+{
+    if (deviceId < 0)
+        RuntimeError("The recurrent stack requires a GPU with cuDNN; there is no CPU implementation.");
+    fprintf(stderr, "\nUsing cuDNN RNN engine.\n");
+    return CuDnnRNNEngineFactory<ElemType>::Create(deviceId, attributes, inputSize);
+}
+
+template class RNNEngine<float>;
+template class RNNEngine<double>;
+
+}}}
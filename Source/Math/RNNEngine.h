@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <string>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+//-------------------------------------------------------------
+// Engine for a stack of recurrent layers (LSTM, GRU or plain RNN) that runs all time steps of a minibatch at once.
+//-------------------------------------------------------------
+enum class RNNMode
+{
+    LSTM,
+    GRU,
+    RNNTanh,
+    RNNReLU
+};
+
+struct MATH_API RNNAttributes
+{
+    RNNMode m_mode;
+    size_t m_numLayers;
+    size_t m_hiddenSize;
+    bool m_bidirectional;
+
+    size_t NumDirections() const { return m_bidirectional ? 2 : 1; }
+    size_t OutputSize() const { return m_hiddenSize * NumDirections(); }
+
+    // number of weights and biases of the stack, stored in one column in the layout of cudnnGetRNNLinLayerMatrixParams()
+    size_t GetNumParameters(size_t inputSize) const;
+
+    // 'lstm', 'gru', 'rnnTanh' or 'rnnReLU'
+    static RNNMode ModeFrom(const std::wstring& name);
+    static std::wstring NameOf(RNNMode mode);
+};
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+
+// The sequences are packed time-major: the columns of frame t are the sequences that are longer than t,
+// ordered by decreasing length; numSequencesPerFrame[t] is their number. All sequences start with a zero state.
+template <class ElemType>
+class MATH_API RNNEngine
+{
+public:
+    using Mat = Matrix<ElemType>;
+
+public:
+    virtual ~RNNEngine() = default;
+
+    // y = RNN(x; w); isTraining keeps the intermediate results needed by the backward functions
+    void Forward(const Mat& x, const Mat& w, Mat& y, const std::vector<size_t>& numSequencesPerFrame, bool isTraining);
+
+    // dx = gradient of x, given y and dy; must follow a training Forward() of the same sequences
+    void BackwardData(const Mat& y, const Mat& dy, const Mat& w, Mat& dx, const std::vector<size_t>& numSequencesPerFrame);
+
+    // dw += gradient of w; must follow BackwardData()
+    void BackwardWeights(const Mat& x, const Mat& y, Mat& dw, const std::vector<size_t>& numSequencesPerFrame);
+
+    // only a cuDNN implementation exists
+    static std::unique_ptr<RNNEngine<ElemType>> Create(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, size_t inputSize);
+
+    DISABLE_COPY_AND_MOVE(RNNEngine);
+
+protected:
+    RNNEngine(DEVICEID_TYPE deviceId, const RNNAttributes& attributes, size_t inputSize)
+        : m_deviceId(deviceId), m_attributes(attributes), m_inputSize(inputSize)
+    {
+    }
+
+    virtual void ForwardCore(const Mat& x, const Mat& w, Mat& y, const std::vector<size_t>& numSequencesPerFrame, bool isTraining) = 0;
+    virtual void BackwardDataCore(const Mat& y, const Mat& dy, const Mat& w, Mat& dx, const std::vector<size_t>& numSequencesPerFrame) = 0;
+    virtual void BackwardWeightsCore(const Mat& x, const Mat& y, Mat& dw, const std::vector<size_t>& numSequencesPerFrame) = 0;
+
+protected:
+    DEVICEID_TYPE m_deviceId;
+    RNNAttributes m_attributes;
+    size_t m_inputSize;
+};
+
+#pragma warning(pop)
+
+}}}
@@ -137,6 +137,23 @@ DECL ElemType ClippedQuotient(ElemType a, ElemType b)
     return a / b;
 }
 
+// SplitMix64 finalizer
+DECL unsigned long long MixBits64(unsigned long long z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// counter-based uniform random number in [0,1): a hash of (seed, counter), identical on CPU and GPU,
+// so that e.g. a dropout mask can be regenerated from its seed and element index instead of being stored
+template <class ElemType>
+DECL ElemType UniformRandomOfCounter(unsigned long long seed, unsigned long long counter)
+{
+    unsigned long long z = MixBits64(MixBits64(seed) + (counter + 1) * 0x9E3779B97F4A7C15ull);
+    return (ElemType) (z >> 40) * (ElemType) (1.0 / (1 << 24)); // 24 bits, exact in float
+}
+
 template <typename ElemType>
 DECL ElemType LogAdd(ElemType x, ElemType y)
 {
@@ -245,6 +262,9 @@ DefBinaryOp(ElementwiseProductWithAbsDerivative, a * Sgn(b)); // note: b = input
 DefBinaryOp(ElementwiseProductWithReciprocalDerivative, a * -Sqr(b)); // b = output
 DefBinaryOp(ElementwiseProductWithSqrtDerivative, a / (2 * b)); // b = output; d/dx sqrt(x) = 1/(2 * sqrt(x)) --> note this is the same as ElementwiseQuotient w a constant; if more show up like this we should add more template params
 DefBinaryOp(SqrOfDifference, Sqr(a - b));
+DefBinaryOp(SigmoidOfSum, Sigmoid(a + b));
+DefBinaryOp(TanhOfSum, tanh_(a + b));
+DefBinaryOp(LinearRectifierOfSum, a + b > 0 ? a + b : 0);
 //DefBinaryOp(Index, IndexElement(a, b, i));  // note: this one uses the third argument
 
 #pragma pop_macro("DefBinaryOp")
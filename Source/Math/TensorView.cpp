@@ -388,6 +388,57 @@ void TensorView<ElemType>::DoMatrixProductOf(ElemType beta, bool transC, const T
         Matrix<ElemType>::MultiplyAndWeightedAdd(alpha, *B, !transB, *A, !transA, beta, *C);
 }
 
+// -------------------------------------------------------------------
+// gradient clipping by global norm
+// -------------------------------------------------------------------
+
+template <class ElemType>
+/*static*/ void TensorView<ElemType>::ClipByGlobalNorm(const vector<shared_ptr<Matrix<ElemType>>>& gradients, ElemType maxNorm, const shared_ptr<Matrix<ElemType>>& workspace)
+{
+    // sum of squares of the dense gradients, each reduced into the [1 x 1] workspace
+    workspace->Resize(1, 1);
+    TensorView<ElemType> sumOfSquares(workspace, TensorShape(1, 1));
+    ElemType beta = 0;
+    double sparseSumOfSquares = 0; // sparse gradients have no tensor view, their norm comes from the host
+    bool hasSparseGradients = false;
+    for (const auto& gradient : gradients)
+    {
+        if (gradient->IsEmpty())
+            continue;
+        if (gradient->GetMatrixType() != DENSE)
+        {
+            double norm = gradient->FrobeniusNorm();
+            sparseSumOfSquares += norm * norm;
+            hasSparseGradients = true;
+            continue;
+        }
+        TensorView<ElemType> gradientView(gradient, TensorShape(gradient->GetNumRows(), gradient->GetNumCols()));
+        sumOfSquares.DoSqrOf(beta, gradientView, 1);
+        beta = 1;
+    }
+    if (beta == 0)
+        workspace->SetValue(0);
+    if (sparseSumOfSquares > 0)
+        *workspace += (ElemType) sparseSumOfSquares;
+
+    // scale factor 1 / max(1, norm / maxNorm)
+    workspace->InplaceSqrt();
+    Matrix<ElemType>::Scale(1 / maxNorm, *workspace);
+    workspace->InplaceTruncateBottom(1);
+    workspace->ElementInverse();
+
+    ElemType sparseScale = hasSparseGradients ? workspace->Get00Element() : 1;
+    for (const auto& gradient : gradients)
+    {
+        if (gradient->IsEmpty())
+            continue;
+        if (gradient->GetMatrixType() != DENSE)
+            *gradient *= sparseScale;
+        else
+            Matrix<ElemType>::Scale(*workspace, *gradient);
+    }
+}
+
 template class TensorView<float>;
 template class TensorView<double>;
 
@@ -143,15 +143,24 @@ public:
     void AssignMatrixProductOf(               bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoMatrixProductOf(0,    transC, a, transA, b, transB, alpha); }
     void AddMatrixProductOf   (               bool transC, const TensorView& a, bool transA, const TensorView& b, bool transB, ElemType alpha = 1.0f) { DoMatrixProductOf(1.0f, transC, a, transA, b, transB, alpha); }
 
+    // -------------------------------------------------------------------
+    // gradient clipping by global norm
+    // Scales all 'gradients' by min(1, maxNorm / norm), where 'norm' is the Frobenius norm of all of them together.
+    // The sum of squares is reduced on the device into 'workspace' (a [1 x 1] matrix that the caller keeps across
+    // calls), and the gradients are scaled from there, so that nothing is read back unless a gradient is sparse.
+    // -------------------------------------------------------------------
+
+    static void ClipByGlobalNorm(const std::vector<shared_ptr<Matrix<ElemType>>>& gradients, ElemType maxNorm, const shared_ptr<Matrix<ElemType>>& workspace);
+
     shared_ptr<Matrix<ElemType>> AsMatrix() const;
     const TensorShape& GetShape() const { return m_shape; }
+    const Matrix<ElemType>& GetSOB() const { return *m_sob; } // e.g. for Matrix views of sections of the storage that AsMatrix() cannot express
 
 private:
     // -------------------------------------------------------------------
     // accessors
     // -------------------------------------------------------------------
 
-    const Matrix<ElemType>& GetSOB() const { return *m_sob; }
     Matrix<ElemType>&       GetSOB()       { return *m_sob; }
     friend Test::TensorTest<ElemType>;
 
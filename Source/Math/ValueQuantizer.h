@@ -169,6 +169,20 @@ public:
         return rangeend;
     }
 
+    // the precomputed constants of Quantize() and Unquantize(), for the vectorized CPU kernels
+    cudasharedcode ElemType QFactor() const
+    {
+        return qfactor;
+    }
+    cudasharedcode ElemType UFactor() const
+    {
+        return ufactor;
+    }
+    cudasharedcode ElemType QuantiMid() const
+    {
+        return quantimid;
+    }
+
     // helper: compute the binary log of a power of two (utility function to convert 'Nbits' into 'ldNbits'
     static size_t ld(size_t v)
     {
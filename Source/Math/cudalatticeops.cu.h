@@ -227,6 +227,66 @@ __global__ void backwardlatticej(const size_t batchsize, const size_t startindex
     }
 }
 
+// forward and backward pass of a small lattice in a single launch
+// A lattice of a short utterance has few edges per batch of independent edges, so that forwardbackwardlattice() spends its time
+// launching one kernel per batch. Here a single thread block loops over all batches instead, with a barrier after each, which
+// makes the atomic log-adds of one batch visible to the next. The batch sizes are passed in constant memory.
+static const size_t maxsingleblockbatches = 1024; // per direction
+static const size_t maxsingleblockedges = 16384;  // larger lattices have enough parallelism to fill the device with one launch per batch
+__constant__ size_t singleblockbatchsizes[2 * maxsingleblockbatches]; // [forward batches, backward batches]
+
+__global__ void forwardbackwardlatticesingleblock(const size_t numlaunchforward, const size_t numlaunchbackward, const vectorref<float> edgeacscores,
+                                                  const size_t spalignunitid, const size_t silalignunitid,
+                                                  vectorref<msra::lattices::edgeinfowithscores> edges, vectorref<msra::lattices::nodeinfo> nodes,
+                                                  vectorref<msra::lattices::aligninfo> aligns, vectorref<unsigned short> alignments,
+                                                  vectorref<unsigned int> alignmentoffsets, vectorref<double> logpps,
+                                                  vectorref<double> logalphas, vectorref<double> logbetas,
+                                                  float lmf, float wp, float amf, const float boostingfactor,
+                                                  const vectorref<unsigned short> uids, const vectorref<unsigned short> senone2classmap,
+                                                  const bool returnEframescorrect, vectorref<double> logframescorrectedge,
+                                                  vectorref<double> logaccalphas, vectorref<double> logEframescorrect, vectorref<double> logaccbetas)
+{
+    // initialize log{,acc}(alphas/betas), with the initial tokens at probability 1 (0 in log)
+    for (size_t i = threadIdx.x; i < logalphas.size(); i += blockDim.x)
+    {
+        logalphas[i] = (i == 0) ? 0.0 : LOGZERO;
+        logbetas[i] = (i == nodes.size() - 1) ? 0.0 : LOGZERO;
+        if (returnEframescorrect)
+        {
+            logaccalphas[i] = LOGZERO;
+            logaccbetas[i] = LOGZERO;
+        }
+    }
+    __syncthreads();
+
+    // forward pass
+    size_t startindex = 0;
+    for (size_t i = 0; i < numlaunchforward; i++)
+    {
+        for (size_t j = threadIdx.x; j < singleblockbatchsizes[i]; j += blockDim.x)
+            msra::lattices::latticefunctionskernels::forwardlatticej(j + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignmentoffsets,
+                                                                     logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+        startindex += singleblockbatchsizes[i];
+        __syncthreads();
+    }
+    const double totalfwscore = logalphas[nodes.size() - 1];
+
+    // backward pass
+    startindex = edges.size();
+    for (size_t i = 0; i < numlaunchbackward; i++)
+    {
+        const size_t batchsize = singleblockbatchsizes[maxsingleblockbatches + i];
+        for (size_t j = threadIdx.x; j < batchsize; j += blockDim.x)
+            msra::lattices::latticefunctionskernels::backwardlatticej(j + startindex - batchsize, edgeacscores, spalignunitid, silalignunitid,
+                                                                      edges, nodes, aligns, totalfwscore, logpps, logalphas, logbetas,
+                                                                      lmf, wp, amf, boostingfactor, returnEframescorrect,
+                                                                      logframescorrectedge, logaccalphas,
+                                                                      logEframescorrect, logaccbetas);
+        startindex -= batchsize;
+        __syncthreads();
+    }
+}
+
 void latticefunctionsops::forwardbackwardlattice(const size_t *batchsizeforward, const size_t *batchsizebackward,
                                                  const size_t numlaunchforward, const size_t numlaunchbackward,
                                                  const size_t spalignunitid, const size_t silalignunitid,
@@ -243,6 +303,75 @@ void latticefunctionsops::forwardbackwardlattice(const size_t *batchsizeforward,
                                                  vectorref<double> &logaccbetas, vectorref<double> &logframescorrectedge,
                                                  vectorref<double> &logEframescorrect, vectorref<double> & /*Eframescorrectbuf*/,
                                                  double &logEframescorrecttotal, double &totalfwscore) const
+{
+    if (edges.size() <= maxsingleblockedges && numlaunchforward <= maxsingleblockbatches && numlaunchbackward <= maxsingleblockbatches)
+    {
+        cudaMemcpyToSymbolAsync(singleblockbatchsizes, batchsizeforward, numlaunchforward * sizeof(size_t), 0, cudaMemcpyHostToDevice, GetCurrentStream()) || "cudaMemcpyToSymbolAsync failed";
+        cudaMemcpyToSymbolAsync(singleblockbatchsizes, batchsizebackward, numlaunchbackward * sizeof(size_t), maxsingleblockbatches * sizeof(size_t), cudaMemcpyHostToDevice, GetCurrentStream()) || "cudaMemcpyToSymbolAsync failed";
+        forwardbackwardlatticesingleblock<<<1, 256, 0, GetCurrentStream()>>>(numlaunchforward, numlaunchbackward, edgeacscores,
+                                                                              spalignunitid, silalignunitid, edges, nodes, aligns,
+                                                                              alignments, aligmentoffsets, logpps, logalphas, logbetas,
+                                                                              lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect,
+                                                                              logframescorrectedge, logaccalphas, logEframescorrect, logaccbetas);
+        checklaunch("forwardbackwardlatticesingleblock");
+        memcpy<double>(&totalfwscore, logalphas.get(), nodes.size() - 1, 1);
+    }
+    else
+    {
+        ForwardBackwardLatticePerBatch(batchsizeforward, batchsizebackward, numlaunchforward, numlaunchbackward, spalignunitid, silalignunitid,
+                                       edgeacscores, edges, nodes, aligns, alignments, aligmentoffsets, logpps, logalphas, logbetas,
+                                       lmf, wp, amf, boostingfactor, returnEframescorrect, uids, senone2classmap,
+                                       logaccalphas, logaccbetas, logframescorrectedge, logEframescorrect, totalfwscore);
+    }
+    double totalfwacc = 0;
+    if (returnEframescorrect)
+    {
+        memcpy<double>(&totalfwacc, logaccalphas.get(), nodes.size() - 1, 1);
+        totalfwacc -= totalfwscore;
+    }
+
+    double totalbwscore = 0;
+    memcpy<double>(&totalbwscore, logbetas.get(), 0, 1);
+    double totalbwacc = 0;
+    if (returnEframescorrect)
+    {
+        memcpy<double>(&totalbwacc, logaccbetas.get(), 0, 1);
+        totalbwacc -= totalbwscore;
+        logEframescorrecttotal = totalbwacc;
+    }
+
+    double difffwbwscore = totalfwscore - totalbwscore;
+    double absdifffwbwscore = difffwbwscore > 0 ? difffwbwscore : 0 - difffwbwscore;
+
+    if (absdifffwbwscore / nodes.size() > 1e-4)
+        fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw scores %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwscore, (float) totalbwscore, (int) nodes.size(), (int) edges.size());
+
+    if (returnEframescorrect)
+    {
+        double difffwbwacc = totalfwacc - totalbwacc;
+        double absdifffwbwacc = difffwbwacc > 0 ? difffwbwacc : 0 - difffwbwacc;
+
+        if (absdifffwbwacc / nodes.size() > 1e-4)
+            fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw acc %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwacc, (float) totalbwacc, (int) nodes.size(), (int) edges.size());
+    }
+}
+
+// forward and backward pass of a large lattice, with one launch per batch of independent edges
+void latticefunctionsops::ForwardBackwardLatticePerBatch(const size_t *batchsizeforward, const size_t *batchsizebackward,
+                                                         const size_t numlaunchforward, const size_t numlaunchbackward,
+                                                         const size_t spalignunitid, const size_t silalignunitid,
+                                                         const vectorref<float> &edgeacscores,
+                                                         const vectorref<msra::lattices::edgeinfowithscores> &edges,
+                                                         const vectorref<msra::lattices::nodeinfo> &nodes,
+                                                         const vectorref<msra::lattices::aligninfo> &aligns,
+                                                         const vectorref<unsigned short> &alignments,
+                                                         const vectorref<unsigned int> &aligmentoffsets,
+                                                         vectorref<double> &logpps, vectorref<double> &logalphas, vectorref<double> &logbetas,
+                                                         const float lmf, const float wp, const float amf, const float boostingfactor,
+                                                         const bool returnEframescorrect, const vectorref<unsigned short> &uids,
+                                                         const vectorref<unsigned short> &senone2classmap, vectorref<double> &logaccalphas,
+                                                         vectorref<double> &logaccbetas, vectorref<double> &logframescorrectedge,
+                                                         vectorref<double> &logEframescorrect, double &totalfwscore) const
 {
     // initialize log{,acc}(alhas/betas)
     dim3 t(32, 8);
@@ -280,12 +409,6 @@ void latticefunctionsops::forwardbackwardlattice(const size_t *batchsizeforward,
         startindex += batchsizeforward[i];
     }
     memcpy<double>(&totalfwscore, logalphas.get(), nodes.size() - 1, 1);
-    double totalfwacc = 0;
-    if (returnEframescorrect)
-    {
-        memcpy<double>(&totalfwacc, logaccalphas.get(), nodes.size() - 1, 1);
-        totalfwacc -= totalfwscore;
-    }
 
     // backward pass
     startindex = edges.size();
@@ -300,30 +423,6 @@ void latticefunctionsops::forwardbackwardlattice(const size_t *batchsizeforward,
         checklaunch("edgealignment");
         startindex -= batchsizebackward[i];
     }
-    double totalbwscore = 0;
-    memcpy<double>(&totalbwscore, logbetas.get(), 0, 1);
-    double totalbwacc = 0;
-    if (returnEframescorrect)
-    {
-        memcpy<double>(&totalbwacc, logaccbetas.get(), 0, 1);
-        totalbwacc -= totalbwscore;
-        logEframescorrecttotal = totalbwacc;
-    }
-
-    double difffwbwscore = totalfwscore - totalbwscore;
-    double absdifffwbwscore = difffwbwscore > 0 ? difffwbwscore : 0 - difffwbwscore;
-
-    if (absdifffwbwscore / nodes.size() > 1e-4)
-        fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw scores %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwscore, (float) totalbwscore, (int) nodes.size(), (int) edges.size());
-
-    if (returnEframescorrect)
-    {
-        double difffwbwacc = totalfwacc - totalbwacc;
-        double absdifffwbwacc = difffwbwacc > 0 ? difffwbwacc : 0 - difffwbwacc;
-
-        if (absdifffwbwacc / nodes.size() > 1e-4)
-            fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw acc %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwacc, (float) totalbwacc, (int) nodes.size(), (int) edges.size());
-    }
 }
 
 // -----------------------------------------------------------------------
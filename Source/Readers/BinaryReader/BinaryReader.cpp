@@ -127,6 +127,7 @@ void BinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
     // determine if partial minibatches are desired
     std::string minibatchMode(readerConfig(L"minibatchMode", "Partial"));
     m_partialMinibatch = EqualCI(minibatchMode, "Partial");
+    m_readAhead = readerConfig(L"readAhead", true);
 
     // Initial load is complete
     DisplayProperties();
@@ -170,6 +171,9 @@ void BinaryReader<ElemType>::DisplayProperties()
 template <class ElemType>
 BinaryReader<ElemType>::~BinaryReader()
 {
+    // the read ahead task touches the views that are unmapped below
+    WaitForReadAhead();
+
     // clear the section references, they will be deleted by the sectionFile destructors
     m_sections.clear();
 
@@ -194,6 +198,8 @@ BinaryReader<ElemType>::~BinaryReader()
 template <class ElemType>
 void BinaryReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples)
 {
+    WaitForReadAhead();
+
     m_mbSize = mbSize;
     if (requestedEpochSamples == requestDataSize)
     {
@@ -210,9 +216,10 @@ void BinaryReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, siz
 
 // CheckEndDataset - Check to see if we have arrived at the end of the dataset
 // actualmbsize - [in] the actual size of the dataset we are requesting,
+//               [out] clipped to the end of the epoch and the end of the dataset
 // returns - true if there we hit dataset end, false otherwise
 template <class ElemType>
-bool BinaryReader<ElemType>::CheckEndDataset(size_t actualmbsize)
+bool BinaryReader<ElemType>::CheckEndDataset(size_t& actualmbsize)
 {
     size_t epochEnd = m_epochSize;
     size_t epochSample = m_mbStartSample % m_epochSize;
@@ -261,10 +268,14 @@ bool BinaryReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
     size_t actualmbsize = min(m_totalSamples, m_mbSize); // it may still return less if at end of sweep
     size_t epochStartSample = m_mbStartSample % m_totalSamples;
 
+    // the views may be remapped below, wait until the pages of this minibatch have been touched
+    WaitForReadAhead();
+
     bool endOfDataset = CheckEndDataset(actualmbsize);
     if (endOfDataset)
         return false;
 
+    vector<pair<Section*, size_t>> readSections; // sections read and their bytes per record
     for (auto value : matrices)
     {
         const auto& matrixName = value.first;
@@ -325,16 +336,71 @@ bool BinaryReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
         {
             RuntimeError("GetMinibatch: Section %ls Auxilary section specified, and/or element size %lld mismatch", section->GetName().c_str(), section->GetElementSize());
         }
+        // the matrix copies straight out of the mapped view, no intermediate buffer
         gpuData.SetValue(rows, actualmbsize, gpuData.GetDeviceId(), data);
+        readSections.push_back(make_pair(section, rows * dataSize));
     }
 
     // advance to the next minibatch
     m_mbStartSample += actualmbsize;
 
+    if (m_readAhead)
+        StartReadAhead(readSections);
+
     // we read some records, so process them
     return true;
 }
 
+// StartReadAhead - map the records of the next minibatch and touch their pages on a background task,
+//   so that they are read from the file while the current minibatch is processed
+// sections - [in] sections read for the current minibatch, with their number of bytes per record
+template <class ElemType>
+void BinaryReader<ElemType>::StartReadAhead(const vector<pair<Section*, size_t>>& sections)
+{
+    // nothing more to read in this epoch
+    if (m_mbStartSample / m_epochSize != m_epoch)
+        return;
+
+    size_t epochSample = m_mbStartSample % m_epochSize;
+    size_t fileRecord = m_mbStartSample % m_totalSamples;
+    size_t records = min(m_mbSize, min(m_epochSize - epochSample, m_totalSamples - fileRecord));
+    if (records == 0)
+        return;
+
+    // mapping the ranges may move an element window, which is only done here on the calling thread.
+    // The data of the current minibatch has already been copied into the matrices.
+    vector<pair<const char*, size_t>> ranges;
+    for (auto& sectionSize : sections)
+    {
+        Section* section = sectionSize.first;
+        size_t size = sectionSize.second * records;
+        const char* data = section->EnsureElements(fileRecord * section->GetElementsPerRecord(), size);
+        ranges.push_back(make_pair(data, size));
+    }
+
+    m_readAheadTask = std::async(std::launch::async, [ranges]()
+    {
+        // a read per page faults it in, 4K is the smallest page size of the supported platforms
+        const size_t pageSize = 4096;
+        for (auto& range : ranges)
+        {
+            const volatile char* data = range.first;
+            for (size_t offset = 0; offset < range.second; offset += pageSize)
+                (void) data[offset];
+            if (range.second > 0)
+                (void) data[range.second - 1];
+        }
+    });
+}
+
+// WaitForReadAhead - wait for the read ahead task, must be called before any view is remapped or released
+template <class ElemType>
+void BinaryReader<ElemType>::WaitForReadAhead()
+{
+    if (m_readAheadTask.valid())
+        m_readAheadTask.get();
+}
+
 //SetupEpoch - Setup the proper position in the file, and other variable settings to start a particular epoch
 template <class ElemType>
 void BinaryReader<ElemType>::SetupEpoch()
@@ -411,6 +477,7 @@ bool BinaryReader<ElemType>::GetData(const std::wstring& sectionName, size_t num
         dataBufferSize = sizeData;
         return false;
     }
+    WaitForReadAhead();
     char* copyFrom = section->EnsureElements(section->GetElementsPerRecord() * recordStart, sizeData);
     memcpy_s((char*) data, dataBufferSize, copyFrom, sizeData);
     return true;
@@ -11,6 +11,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -552,6 +553,12 @@ class BinaryReader : public DataReaderBase
     bool m_partialMinibatch;   // a partial minibatch is allowed
     MBLayoutPtr m_pMBLayout;
 
+    // The minibatches are handed to the matrices straight from the mapped views, the pages of the next minibatch
+    // are faulted in on a background task while the current one is processed (config readAhead, default true).
+    // The views are only remapped on the calling thread, after the task has been waited for.
+    bool m_readAhead;
+    std::future<void> m_readAheadTask;
+
     int m_traceLevel;
     vector<SectionFile*> m_secFiles;
     std::map<std::wstring, Section*, nocase_compare> m_sections;
@@ -566,7 +573,9 @@ class BinaryReader : public DataReaderBase
     void SetupEpoch();
     void LoadSections(Section* parentSection, MappingType mapping, size_t windowSize);
     void DisplayProperties();
-    bool CheckEndDataset(size_t actualmbsize);
+    bool CheckEndDataset(size_t& actualmbsize);
+    void StartReadAhead(const vector<pair<Section*, size_t>>& sections);
+    void WaitForReadAhead();
 
 public:
     template <class ConfigRecordType>
@@ -581,7 +590,7 @@ public:
     }
     virtual void Destroy();
     BinaryReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_readAhead(true)
     {
         m_pMBLayout->SetUniqueAxisName(L"BinaryReader");
     }
@@ -6,16 +6,32 @@
 #include "stdafx.h"
 #include "CNTKTextFormatReader.h"
 #include "Config.h"
+#include "DataReader.h"
 #include "TextConfigHelper.h"
 #include "ChunkCache.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
+#include "ShuffleBufferRandomizer.h"
 #include "TextParser.h"
 #include "SequencePacker.h"
 #include "FramePacker.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Size of the shuffle buffer of a streamed input, if the randomization window is not specified.
+static const size_t defaultShuffleBufferSizeInSamples = 1024 * 1024;
+
+template <class ElemType>
+static IDataDeserializerPtr CreateTextParser(const TextConfigHelper& configHelper, IStreamingDataDeserializerPtr& streamingDeserializer)
+{
+    auto parser = make_shared<TextParser<ElemType>>(configHelper);
+    if (configHelper.IsStreaming())
+    {
+        streamingDeserializer = parser;
+    }
+    return parser;
+}
+
 // TODO: This class should go away eventually.
 // TODO: The composition of packer + randomizer + different deserializers in a generic manner is done in the CompositeDataReader.
 // TODO: Currently preserving this for backward compatibility with current configs.
@@ -27,26 +43,34 @@ CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
 
     try
     {
+        IStreamingDataDeserializerPtr streamingDeserializer;
         if (configHelper.GetElementType() == ElementType::tfloat)
         {
-            m_deserializer = shared_ptr<IDataDeserializer>(new TextParser<float>(configHelper));
+            m_deserializer = CreateTextParser<float>(configHelper, streamingDeserializer);
         }
         else
         {
-            m_deserializer = shared_ptr<IDataDeserializer>(new TextParser<double>(configHelper));
+            m_deserializer = CreateTextParser<double>(configHelper, streamingDeserializer);
         }
 
-        if (configHelper.ShouldKeepDataInMemory()) 
+        if (configHelper.ShouldKeepDataInMemory() && !streamingDeserializer)
         {
             m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer));
         }
 
         size_t window = configHelper.GetRandomizationWindow();
-        if (window > 0)
+        if (streamingDeserializer)
+        {
+            // The input is read front to back, the randomization window is the size of the shuffle buffer.
+            size_t bufferSize = window == randomizeAuto ? defaultShuffleBufferSizeInSamples : window;
+            m_randomizer = make_shared<ShuffleBufferRandomizer>(streamingDeserializer, bufferSize);
+        }
+        else if (window > 0)
         {
             // Verbosity is a general config parameter, not specific to the text format reader.
             int verbosity = config(L"verbosity", 0);
-            m_randomizer = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true);
+            size_t maxPrefetchedChunks = config(L"maxPrefetchedChunks", (size_t)1);
+            m_randomizer = make_shared<BlockRandomizer>(verbosity, window, m_deserializer, true, BlockRandomizer::DecimationMode::chunk, false, false, maxPrefetchedChunks);
         }
         else
         {
@@ -95,4 +119,13 @@ Minibatch CNTKTextFormatReader::ReadMinibatch()
     assert(m_packer != nullptr);
     return m_packer->ReadMinibatch();
 }
+
+void CNTKTextFormatReader::SetMemoryProvider(MemoryProviderPtr provider)
+{
+    m_provider = provider;
+    if (m_packer)
+    {
+        m_packer->SetMemoryProvider(provider);
+    }
+}
 } } }
@@ -30,6 +30,9 @@ public:
     // Reads a single minibatch.
     Minibatch ReadMinibatch() override;
 
+    // Sets the memory provider of the minibatch buffers.
+    void SetMemoryProvider(MemoryProviderPtr provider) override;
+
 private:
     IDataDeserializerPtr m_deserializer;
 
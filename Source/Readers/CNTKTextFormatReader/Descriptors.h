@@ -7,18 +7,24 @@
 
 #include <stdint.h>
 #include <vector>
+#include <algorithm>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-    // Stream (input) metadata. This text-reader specific descriptor adds two
-    // additional fields: stream alias (name prefix in each sample) and expected
-    // sample dimension.
+    // Stream (input) metadata. This text-reader specific descriptor adds three
+    // additional fields: stream alias (name prefix in each sample), expected
+    // sample dimension and whether a sparse input is one-hot.
     struct StreamDescriptor : StreamDescription
     {
+        StreamDescriptor() : m_sampleDimension(0), m_isOneHot(false)
+        {
+        }
         std::string m_alias; // sample name prefix used in the input data
         size_t m_sampleDimension; // expected number of elements in a sample
                                   // (can be omitted for sparse input)
+        bool m_isOneHot; // sparse input whose values are all 1 and may be omitted
+                         // ("index" instead of "index:1"); only the indices are kept
     };
 
     // Sequence metadata. This text-reader specific descriptor adds two additional
@@ -39,21 +45,77 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // Chunk metadata, similar to the sequence descriptor above,
     // but used to facilitate indexing and retrieval of blobs of input data of
     // some user-specified size.
+    // The index holds the metadata of all sequences in memory, so a chunk keeps
+    // it compact, in parallel arrays by the sequence index in the chunk (which is
+    // also the sequence id), with the file offsets relative to the chunk. This
+    // takes 20 bytes per sequence, see GetSequence() for the full descriptor.
     struct ChunkDescriptor : ChunkDescription
     {
-        ChunkDescriptor() : ChunkDescription({}), m_byteSize(0) {}
-        // TODO: if we don't want to keep the whole index
-        // (metadata for all sequences in memory), we should not
-        // leave this empty when building a chunk index, and only
-        // fill it out when the chunk needs to be loaded
-        // (the indexer will have to do a second pass for this chunk).
-        std::vector<SequenceDescriptor> m_sequences;
+        ChunkDescriptor() : ChunkDescription({}), m_byteSize(0), m_fileOffsetBytes(0) {}
 
         size_t m_byteSize; // size in bytes
+        int64_t m_fileOffsetBytes; // offset of the first sequence in the input file
+
+        std::vector<uint32_t> m_sequenceOffsets; // relative to m_fileOffsetBytes
+        std::vector<uint32_t> m_sequenceByteSizes;
+        std::vector<uint32_t> m_sequenceNumberOfSamples;
+        std::vector<KeyType> m_sequenceKeys;
+
+        SequenceDescriptor GetSequence(size_t index) const
+        {
+            assert(index < m_numberOfSequences);
+            SequenceDescriptor sd;
+            sd.m_id = index;
+            sd.m_numberOfSamples = m_sequenceNumberOfSamples[index];
+            sd.m_chunkId = m_id;
+            sd.m_key = m_sequenceKeys[index];
+            sd.m_fileOffsetBytes = m_fileOffsetBytes + m_sequenceOffsets[index];
+            sd.m_byteSize = m_sequenceByteSizes[index];
+            return sd;
+        }
+
+        // Checks that a sequence that starts at the given offset and has the given size
+        // can be added to this chunk, without exceeding the 32 bits of the relative offsets.
+        bool CanAddSequence(int64_t fileOffsetBytes, size_t byteSize) const
+        {
+            return m_numberOfSequences == 0 || (uint64_t)(fileOffsetBytes - m_fileOffsetBytes) + byteSize <= UINT32_MAX;
+        }
+
+        void AddSequence(const SequenceDescriptor& sd)
+        {
+            assert(CanAddSequence(sd.m_fileOffsetBytes, sd.m_byteSize));
+            if (m_numberOfSequences == 0)
+            {
+                m_fileOffsetBytes = sd.m_fileOffsetBytes;
+            }
+            m_sequenceOffsets.push_back((uint32_t)(sd.m_fileOffsetBytes - m_fileOffsetBytes));
+            m_sequenceByteSizes.push_back((uint32_t)sd.m_byteSize);
+            m_sequenceNumberOfSamples.push_back(sd.m_numberOfSamples);
+            m_sequenceKeys.push_back(sd.m_key);
+            m_byteSize += sd.m_byteSize;
+            m_numberOfSamples += sd.m_numberOfSamples;
+            m_numberOfSequences++;
+        }
+
+        void ShrinkToFit()
+        {
+            m_sequenceOffsets.shrink_to_fit();
+            m_sequenceByteSizes.shrink_to_fit();
+            m_sequenceNumberOfSamples.shrink_to_fit();
+            m_sequenceKeys.shrink_to_fit();
+        }
     };
 
     typedef shared_ptr<ChunkDescriptor> ChunkDescriptorPtr;
 
+    // Location of a sequence in the index, by its key.
+    struct SequenceLocation
+    {
+        size_t m_key;
+        ChunkIdType m_chunkId;
+        uint32_t m_indexInChunk;
+    };
+
     // A collection of chunk descriptors, each containing
     // a collection of sequence descriptors for the corresponding
     // chunk of the input data.
@@ -61,7 +123,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     struct Index
     {
         std::vector<ChunkDescriptor> m_chunks;                                  // chunks
-        std::map<size_t, std::pair<size_t, size_t>> m_keyToSequenceInChunk;     // sequence key -> sequence location in chunk
+        std::vector<SequenceLocation> m_keyToSequenceInChunk;                   // sequence key -> sequence location in chunk,
+                                                                                // sorted by the key once the index is sealed
         const size_t m_maxChunkSize;                                            // maximum chunk size in bytes
 
         explicit Index(size_t chunkSize) : m_maxChunkSize(chunkSize)
@@ -74,8 +137,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         void AddSequence(SequenceDescriptor& sd)
         {
             assert(!m_chunks.empty());
+            if (sd.m_byteSize > UINT32_MAX)
+            {
+                RuntimeError("Sequence at the offset %lld is larger than 4 GB.", (long long)sd.m_fileOffsetBytes);
+            }
+
             ChunkDescriptor* chunk = &m_chunks.back();
-            if (chunk->m_byteSize > 0 && (chunk->m_byteSize + sd.m_byteSize) > m_maxChunkSize)
+            if ((chunk->m_byteSize > 0 && (chunk->m_byteSize + sd.m_byteSize) > m_maxChunkSize) ||
+                !chunk->CanAddSequence(sd.m_fileOffsetBytes, sd.m_byteSize))
             {
                 // Creating a new chunk if the size is exceeded.
                 m_chunks.push_back({});
@@ -87,15 +156,42 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 }
             }
 
-            chunk->m_byteSize += sd.m_byteSize;
-            chunk->m_numberOfSequences++;
-            chunk->m_numberOfSamples += sd.m_numberOfSamples;
             sd.m_chunkId = chunk->m_id;
-            sd.m_id = chunk->m_sequences.size();
-            auto location = std::make_pair(chunk->m_id, sd.m_id);
-            auto sequenceId = sd.m_key.m_sequence;
-            m_keyToSequenceInChunk.insert(std::make_pair(sequenceId, location));
-            chunk->m_sequences.push_back(sd);
+            sd.m_id = chunk->m_numberOfSequences;
+            SequenceLocation location = { sd.m_key.m_sequence, chunk->m_id, (uint32_t)sd.m_id };
+            m_keyToSequenceInChunk.push_back(location);
+            chunk->AddSequence(sd);
+        }
+
+        // Called when all sequences are added: sorts the keys for FindSequence()
+        // and releases the spare capacity of the arrays.
+        void Seal()
+        {
+            // For a key that occurs more than once, the first sequence is kept.
+            std::stable_sort(m_keyToSequenceInChunk.begin(), m_keyToSequenceInChunk.end(),
+                [](const SequenceLocation& a, const SequenceLocation& b) { return a.m_key < b.m_key; });
+            m_keyToSequenceInChunk.erase(std::unique(m_keyToSequenceInChunk.begin(), m_keyToSequenceInChunk.end(),
+                [](const SequenceLocation& a, const SequenceLocation& b) { return a.m_key == b.m_key; }),
+                m_keyToSequenceInChunk.end());
+            m_keyToSequenceInChunk.shrink_to_fit();
+
+            for (auto& chunk : m_chunks)
+            {
+                chunk.ShrinkToFit();
+            }
+            m_chunks.shrink_to_fit();
+        }
+
+        // Finds the sequence with the given key, returns nullptr if there is none.
+        const SequenceLocation* FindSequence(size_t key) const
+        {
+            auto location = std::lower_bound(m_keyToSequenceInChunk.begin(), m_keyToSequenceInChunk.end(), key,
+                [](const SequenceLocation& l, size_t k) { return l.m_key < k; });
+            if (location == m_keyToSequenceInChunk.end() || location->m_key != key)
+            {
+                return nullptr;
+            }
+            return &*location;
         }
 
         // Reserves inner structures for the specified number of bytes.
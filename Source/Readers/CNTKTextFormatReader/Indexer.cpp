@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
 #include "Indexer.h"
 #include "TextReaderConstants.h"
 
@@ -13,8 +14,37 @@ using std::string;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-Indexer::Indexer(FILE* file, bool skipSequenceIds, size_t chunkSize) :
+// Ranges scanned in parallel are at least this large, smaller files are scanned by fewer threads.
+static const int64_t c_minRangeSize = 16 * 1024 * 1024;
+
+static const uint32_t c_indexCacheMagic = 0x58444943; // "CIDX"
+static const uint32_t c_indexCacheVersion = 1;
+
+// Layout of the index cache file: the header, followed by a record for each sequence.
+struct IndexCacheHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint64_t m_fileSize;
+    uint32_t m_skipSequenceIds;
+    uint32_t m_hasSequenceIds;
+    uint64_t m_numberOfSequences;
+};
+
+struct IndexCacheRecord
+{
+    int64_t m_fileOffsetBytes;
+    uint64_t m_byteSize;
+    uint64_t m_key; // sequence id or line number
+    uint32_t m_numberOfSamples;
+    uint32_t m_reserved;
+};
+
+Indexer::Indexer(FILE* file, const std::wstring& filename, bool skipSequenceIds, size_t chunkSize) :
     m_file(file),
+    m_filename(filename),
+    m_numberOfThreads(1),
+    m_cacheIndex(false),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
     m_buffer(new char[BUFFER_SIZE + 1]),
@@ -99,6 +129,19 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     }
 
     m_index.Reserve(filesize(m_file));
+    BuildSequences(corpus);
+    m_index.Seal();
+}
+
+void Indexer::BuildSequences(CorpusDescriptorPtr corpus)
+{
+    bool skipSequenceIds = !m_hasSequenceIds;
+    std::vector<SequenceDescriptor> sequences;
+    if (m_cacheIndex && TryLoadCache(skipSequenceIds, sequences))
+    {
+        AddSequences(corpus, sequences);
+        return;
+    }
 
     RefillBuffer(); // read the first block of data
     if (m_done)
@@ -115,6 +158,18 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         m_bufferStart += 3;
     }
 
+    if (m_numberOfThreads > 1 || m_cacheIndex)
+    {
+        m_hasSequenceIds = m_hasSequenceIds && m_bufferStart[0] != NAME_PREFIX;
+        BuildRanges(GetFileOffset(), sequences);
+        if (m_cacheIndex)
+        {
+            SaveCache(skipSequenceIds, sequences);
+        }
+        AddSequences(corpus, sequences);
+        return;
+    }
+
     // check the first byte and decide what to do next
     if (!m_hasSequenceIds || m_bufferStart[0] == NAME_PREFIX)
     {
@@ -158,6 +213,282 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     AddSequenceIfIncluded(corpus, currentKey, sd);
 }
 
+void Indexer::BuildRange(int64_t begin, int64_t end, bool isFirstRange, RangeIndex& range)
+{
+    range.m_startsWithContinuation = false;
+    range.m_numberOfLines = 0;
+
+    // Start a byte early and skip to the end of that line, so that a line starting exactly at begin is kept.
+    int64_t position = isFirstRange ? begin : begin - 1;
+    if (_fseeki64(m_file, position, SEEK_SET) != 0)
+    {
+        RuntimeError("Error seeking to position %" PRId64 " in the input file (%ls).", position, m_filename.c_str());
+    }
+    m_fileOffsetEnd = position;
+    RefillBuffer();
+    if (!isFirstRange)
+    {
+        SkipLine();
+    }
+
+    if (m_done || GetFileOffset() >= end)
+    {
+        return; // no line starts in this range
+    }
+
+    if (!m_hasSequenceIds)
+    {
+        while (!m_done && GetFileOffset() < end)
+        {
+            SequenceDescriptor sd = {};
+            sd.m_numberOfSamples = 1;
+            sd.m_fileOffsetBytes = GetFileOffset();
+            SkipLine();
+            sd.m_byteSize = (m_done ? m_fileOffsetEnd : GetFileOffset()) - sd.m_fileOffsetBytes;
+            sd.m_key.m_sequence = range.m_numberOfLines++;
+            range.m_sequences.push_back(sd);
+        }
+        return;
+    }
+
+    size_t id = 0;
+    int64_t offset = GetFileOffset();
+    bool continuation = !TryGetSequenceId(id);
+    if (continuation)
+    {
+        if (isFirstRange)
+        {
+            RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", offset);
+        }
+        // the first lines belong to the last sequence of the previous range
+        range.m_startsWithContinuation = true;
+    }
+
+    SequenceDescriptor sd = {};
+    sd.m_fileOffsetBytes = offset;
+    sd.m_key.m_sequence = id;
+    while (!m_done)
+    {
+        SkipLine(); // ignore whatever is left on this line.
+        sd.m_numberOfSamples++;
+        if (m_done)
+        {
+            break;
+        }
+
+        offset = GetFileOffset(); // a new line starts at this offset;
+        if (offset >= end)
+        {
+            break; // the line belongs to the next range
+        }
+
+        if (TryGetSequenceId(id) && (continuation || id != sd.m_key.m_sequence))
+        {
+            sd.m_byteSize = offset - sd.m_fileOffsetBytes;
+            range.m_sequences.push_back(sd);
+
+            sd = {};
+            sd.m_fileOffsetBytes = offset;
+            sd.m_key.m_sequence = id;
+            continuation = false;
+        }
+    }
+
+    sd.m_byteSize = (m_done ? m_fileOffsetEnd : offset) - sd.m_fileOffsetBytes;
+    range.m_sequences.push_back(sd);
+}
+
+void Indexer::BuildRanges(int64_t dataStart, std::vector<SequenceDescriptor>& sequences)
+{
+    int64_t fileSize = filesize(m_file);
+    size_t numberOfRanges = (size_t)std::max<int64_t>(1, std::min<int64_t>(m_numberOfThreads, (fileSize - dataStart) / c_minRangeSize));
+    int64_t rangeSize = (fileSize - dataStart + numberOfRanges - 1) / numberOfRanges;
+
+    std::vector<RangeIndex> ranges(numberOfRanges);
+    std::vector<std::exception_ptr> errors(numberOfRanges);
+    std::vector<std::thread> threads;
+    threads.reserve(numberOfRanges);
+    for (size_t i = 0; i < numberOfRanges; ++i)
+    {
+        int64_t begin = dataStart + i * rangeSize;
+        int64_t end = std::min(fileSize, begin + rangeSize);
+        threads.push_back(std::thread([this, i, begin, end, &ranges, &errors]()
+        {
+            try
+            {
+                // Each range is read through its own file handle.
+                FILE* file = fopenOrDie(m_filename, L"rbS");
+                try
+                {
+                    Indexer rangeIndexer(file, m_filename, !m_hasSequenceIds, m_index.m_maxChunkSize);
+                    rangeIndexer.BuildRange(begin, end, i == 0, ranges[i]);
+                }
+                catch (...)
+                {
+                    fclose(file);
+                    throw;
+                }
+                fclose(file);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }));
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Stitch the ranges together: sequences continuing from the previous range are merged,
+    // line numbers are made absolute.
+    size_t firstLine = 0;
+    for (auto& range : ranges)
+    {
+        for (size_t i = 0; i < range.m_sequences.size(); ++i)
+        {
+            auto& sd = range.m_sequences[i];
+            if (!m_hasSequenceIds)
+            {
+                sd.m_key.m_sequence += firstLine;
+            }
+            else if (!sequences.empty() &&
+                     ((i == 0 && range.m_startsWithContinuation) || sd.m_key.m_sequence == sequences.back().m_key.m_sequence))
+            {
+                sequences.back().m_byteSize += sd.m_byteSize;
+                sequences.back().m_numberOfSamples += sd.m_numberOfSamples;
+                continue;
+            }
+            sequences.push_back(sd);
+        }
+        firstLine += range.m_numberOfLines;
+        range.m_sequences.clear();
+        range.m_sequences.shrink_to_fit();
+    }
+}
+
+void Indexer::AddSequences(CorpusDescriptorPtr corpus, std::vector<SequenceDescriptor>& sequences)
+{
+    for (auto& sd : sequences)
+    {
+        AddSequenceIfIncluded(corpus, sd.m_key.m_sequence, sd);
+    }
+}
+
+bool Indexer::TryLoadCache(bool skipSequenceIds, std::vector<SequenceDescriptor>& sequences)
+{
+    auto cacheFile = GetCacheFilePath();
+    if (!msra::files::fuptodate(cacheFile, m_filename))
+    {
+        return false;
+    }
+
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(cacheFile, L"rbS");
+        IndexCacheHeader header;
+        freadOrDie(&header, sizeof(header), 1, f);
+        if (header.m_magic != c_indexCacheMagic || header.m_version != c_indexCacheVersion ||
+            header.m_fileSize != filesize(m_file) || header.m_skipSequenceIds != (uint32_t)skipSequenceIds)
+        {
+            fclose(f);
+            return false;
+        }
+
+        sequences.reserve(header.m_numberOfSequences);
+        std::vector<IndexCacheRecord> records;
+        for (uint64_t remaining = header.m_numberOfSequences; remaining > 0; remaining -= records.size())
+        {
+            records.resize((size_t)std::min<uint64_t>(remaining, 64 * 1024));
+            freadOrDie(records.data(), sizeof(IndexCacheRecord), records.size(), f);
+            for (const auto& record : records)
+            {
+                SequenceDescriptor sd = {};
+                sd.m_fileOffsetBytes = record.m_fileOffsetBytes;
+                sd.m_byteSize = record.m_byteSize;
+                sd.m_numberOfSamples = record.m_numberOfSamples;
+                sd.m_key.m_sequence = record.m_key;
+                sequences.push_back(sd);
+            }
+        }
+        fclose(f);
+
+        m_hasSequenceIds = header.m_hasSequenceIds != 0;
+        fprintf(stderr, "Loaded the index of %" PRIu64 " sequences from '%ls'.\n", header.m_numberOfSequences, cacheFile.c_str());
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        if (f)
+        {
+            fclose(f);
+        }
+        fprintf(stderr, "WARNING: Ignoring the index cache '%ls': %s\n", cacheFile.c_str(), e.what());
+        sequences.clear();
+        return false;
+    }
+}
+
+void Indexer::SaveCache(bool skipSequenceIds, const std::vector<SequenceDescriptor>& sequences)
+{
+    // Written under a temporary name first, so that an interrupted write is never mistaken for a valid cache.
+    auto cacheFile = GetCacheFilePath();
+    auto tempFile = cacheFile + L".tmp";
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(tempFile, L"wbS");
+        IndexCacheHeader header = {};
+        header.m_magic = c_indexCacheMagic;
+        header.m_version = c_indexCacheVersion;
+        header.m_fileSize = filesize(m_file);
+        header.m_skipSequenceIds = skipSequenceIds;
+        header.m_hasSequenceIds = m_hasSequenceIds;
+        header.m_numberOfSequences = sequences.size();
+        fwriteOrDie(&header, sizeof(header), 1, f);
+
+        std::vector<IndexCacheRecord> records;
+        records.reserve(64 * 1024);
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            const auto& sd = sequences[i];
+            IndexCacheRecord record = {};
+            record.m_fileOffsetBytes = sd.m_fileOffsetBytes;
+            record.m_byteSize = sd.m_byteSize;
+            record.m_numberOfSamples = sd.m_numberOfSamples;
+            record.m_key = sd.m_key.m_sequence;
+            records.push_back(record);
+            if (records.size() == records.capacity() || i + 1 == sequences.size())
+            {
+                fwriteOrDie(records.data(), sizeof(IndexCacheRecord), records.size(), f);
+                records.clear();
+            }
+        }
+        fcloseOrDie(f);
+        f = nullptr;
+        renameOrDie(tempFile, cacheFile);
+    }
+    catch (const std::exception& e)
+    {
+        if (f)
+        {
+            fclose(f);
+        }
+        fprintf(stderr, "WARNING: Could not save the index cache '%ls': %s\n", cacheFile.c_str(), e.what());
+    }
+}
+
 void Indexer::AddSequenceIfIncluded(CorpusDescriptorPtr corpus, size_t sequenceKey, SequenceDescriptor& sd)
 {
     auto& stringRegistry = corpus->GetStringRegistry();
@@ -20,12 +20,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class Indexer 
 {
 public:
-    Indexer(FILE* file, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
+    Indexer(FILE* file, const std::wstring& filename, bool skipSequenceIds = false, size_t chunkSize = 32 * 1024 * 1024);
 
     // Reads the input file, building and index of chunks and corresponding
-    // sequences.
+    // sequences. If enabled, the index is loaded from (or saved to) the
+    // index cache file instead, and the file is scanned in parallel.
     void Build(CorpusDescriptorPtr corpus);
 
+    // Sets the number of threads that scan disjoint ranges of the input file.
+    void SetNumberOfThreads(size_t numberOfThreads) { m_numberOfThreads = numberOfThreads; }
+
+    // If set, the index is kept in a file next to the input (see GetCacheFilePath),
+    // which is used as long as the input has the same size and is not newer.
+    void SetCacheIndex(bool cacheIndex) { m_cacheIndex = cacheIndex; }
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -35,7 +43,20 @@ public:
     bool HasSequenceIds() const { return m_hasSequenceIds; }
 
 private:
+    // Sequences found in a range of the input file, with the sequence ids (or line numbers
+    // relative to the range) as keys. Sequences are only added to the index when all ranges
+    // are done, since the corpus is not thread-safe.
+    struct RangeIndex
+    {
+        std::vector<SequenceDescriptor> m_sequences;
+        bool m_startsWithContinuation; // true, if the first lines of the range have no sequence id
+        size_t m_numberOfLines;
+    };
+
     FILE* m_file;
+    std::wstring m_filename;
+    size_t m_numberOfThreads;
+    bool m_cacheIndex;
 
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
@@ -70,6 +91,27 @@ private:
     // Otherwise, writes sequence id value to the provided reference, returns true.
     bool TryGetSequenceId(size_t& id);
 
+    // Scans the lines starting in [begin, end) of the file. Unless begin is the start of the data,
+    // the scan starts from the first line boundary after begin.
+    void BuildRange(int64_t begin, int64_t end, bool isFirstRange, RangeIndex& range);
+
+    // Scans the input in parallel (or with a single range, if caching only) and returns
+    // the sequences with their sequence ids (or line numbers) as keys.
+    void BuildRanges(int64_t dataStart, std::vector<SequenceDescriptor>& sequences);
+
+    // Adds the sequences of the input file (or the index cache) to the index.
+    void BuildSequences(CorpusDescriptorPtr corpus);
+
+    // Adds the sequences found by BuildRanges (or loaded from the cache) to the index.
+    void AddSequences(CorpusDescriptorPtr corpus, std::vector<SequenceDescriptor>& sequences);
+
+    std::wstring GetCacheFilePath() const { return m_filename + L".index"; }
+
+    // Loads the sequences from the index cache file, if it is valid for the input file.
+    bool TryLoadCache(bool skipSequenceIds, std::vector<SequenceDescriptor>& sequences);
+
+    void SaveCache(bool skipSequenceIds, const std::vector<SequenceDescriptor>& sequences);
+
     // Build a chunk/sequence index, treating each line as an individual sequence.
     // Does not do any sequence parsing, instead uses line number as 
     // the corresponding sequence id.
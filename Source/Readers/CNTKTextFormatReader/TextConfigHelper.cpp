@@ -87,6 +87,13 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
             RuntimeError("'format' parameter must be set either to 'dense' or 'sparse'.");
         }
 
+        // oneHot is optional, sparse inputs whose values are all 1 are also detected while reading
+        stream.m_isOneHot = input(L"oneHot", false);
+        if (stream.m_isOneHot && stream.m_storageType != StorageType::sparse_csc)
+        {
+            RuntimeError("Input '%ls' is declared 'oneHot', which requires 'format' to be 'sparse'.", name.c_str());
+        }
+
         // alias is optional
         if (input.ExistsCurrent(L"alias"))
         {
@@ -148,7 +155,11 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_traceLevel = config(L"traceLevel", 1);
     m_chunkSizeBytes = config(L"chunkSizeInBytes", 32 * 1024 * 1024); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
+    m_memoryMapFile = config(L"memoryMapFile", false);
+    m_numIndexingThreads = config(L"numIndexingThreads", (size_t)1);
+    m_cacheIndex = config(L"cacheIndex", false);
     m_frameMode = config(L"frameMode", false);
+    m_streaming = config(L"streaming", false);
 }
 
 }}}
@@ -37,8 +37,16 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    bool ShouldMapFile() const { return m_memoryMapFile; }
+
+    size_t GetNumIndexingThreads() const { return m_numIndexingThreads; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
     bool IsInFrameMode() const { return m_frameMode; }
 
+    bool IsStreaming() const { return m_streaming; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
@@ -53,7 +61,11 @@ private:
     unsigned int m_traceLevel;
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    bool m_memoryMapFile; // if true the input file is parsed from a memory mapping instead of being read into a buffer
+    size_t m_numIndexingThreads; // number of threads scanning disjoint ranges of the input file when building the index
+    bool m_cacheIndex; // if true the index is kept in a file next to the input and reused while the input is unchanged
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    bool m_streaming; // if true the input is read front to back without an index, randomizing in a shuffle buffer
 };
 
 } } }
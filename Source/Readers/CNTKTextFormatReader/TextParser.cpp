@@ -7,6 +7,15 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#include <limits>
+#include <algorithm>
+#if defined(_M_X64) || defined(__SSE2__)
+#define CNTK_TEXT_PARSER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
@@ -21,6 +30,50 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+// Returns the number of decimal digits at the beginning of [begin, end).
+static inline size_t CountDigits(const char* begin, const char* end)
+{
+    const char* p = begin;
+#ifdef CNTK_TEXT_PARSER_SSE2
+    // 16 characters at a time, as long as they are all within range. Bytes over 0x7f compare as negative.
+    const __m128i beforeZero = _mm_set1_epi8('0' - 1);
+    const __m128i afterNine = _mm_set1_epi8('9' + 1);
+    while (end - p >= 16)
+    {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(chars, beforeZero), _mm_cmplt_epi8(chars, afterNine));
+        unsigned int nonDigits = ~(unsigned int)_mm_movemask_epi8(digits) & 0xFFFF;
+        if (nonDigits)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, nonDigits);
+#else
+            unsigned int index = __builtin_ctz(nonDigits);
+#endif
+            return (p - begin) + index;
+        }
+        p += 16;
+    }
+#endif
+    while (p != end && IsDigit(*p))
+    {
+        ++p;
+    }
+    return p - begin;
+}
+
+// Accumulates the value of the digits the same way as the character-wise parser, so that both produce identical results.
+static inline double ParseDigits(const char* p, size_t count)
+{
+    double number = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        number = number * 10 + (p[i] - '0');
+    }
+    return number;
+}
+
 enum State
 {
     Init = 0,
@@ -58,6 +111,7 @@ struct TextParser<ElemType>::StreamInfo
 {
     StorageType m_type;
     size_t m_sampleDimension;
+    bool m_isOneHot;
 };
 
 template <class ElemType>
@@ -72,8 +126,19 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams())
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetUseMemoryMapping(helper.ShouldMapFile());
+    SetNumIndexingThreads(helper.GetNumIndexingThreads());
+    SetCacheIndex(helper.ShouldCacheIndex());
+    SetStreaming(helper.IsStreaming());
 
-    Initialize();
+    if (m_streaming)
+    {
+        InitializeStreaming();
+    }
+    else
+    {
+        Initialize();
+    }
 }
 
 
@@ -85,6 +150,13 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_indexer(nullptr),
     m_fileOffsetStart(0),
     m_fileOffsetEnd(0),
+    m_streaming(false),
+    m_streamHasSequenceIds(false),
+    m_streamStarted(false),
+    m_nextRowSequenceId(0),
+    m_hasNextRowSequenceId(false),
+    m_numberOfStreamedSequences(0),
+    m_useMemoryMapping(false),
     m_buffer(new char[BUFFER_SIZE + 1]),
     m_bufferStart(nullptr),
     m_bufferEnd(nullptr),
@@ -94,6 +166,8 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_hadWarnings(false),
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
+    m_numIndexingThreads(1),
+    m_cacheIndex(false),
     m_numRetries(5),
     m_corpus(corpus)
 {
@@ -112,6 +186,7 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
         m_aliasToIdMap[alias] = i;
         m_streamInfos[i].m_type = stream.m_storageType;
         m_streamInfos[i].m_sampleDimension = stream.m_sampleDimension;
+        m_streamInfos[i].m_isOneHot = stream.m_isOneHot;
 
         auto streamDescription = std::make_shared<StreamDescription>(stream);
         streamDescription->m_sampleLayout = std::make_shared<TensorShape>(stream.m_sampleDimension);
@@ -171,7 +246,9 @@ void TextParser<ElemType>::Initialize()
                 "UTF-16 encoding is currently not supported.", m_filename.c_str());
         }
 
-        m_indexer = make_unique<Indexer>(m_file, m_skipSequenceIds, m_chunkSizeBytes);
+        m_indexer = make_unique<Indexer>(m_file, m_filename, m_skipSequenceIds, m_chunkSizeBytes);
+        m_indexer->SetNumberOfThreads(m_numIndexingThreads);
+        m_indexer->SetCacheIndex(m_cacheIndex);
 
         m_indexer->Build(m_corpus);
     });
@@ -186,11 +263,35 @@ void TextParser<ElemType>::Initialize()
 
     m_fileOffsetStart = position;
     m_fileOffsetEnd = position;
+
+    if (m_useMemoryMapping)
+    {
+        m_mappedFile = make_shared<MemoryMappedFile>(m_filename);
+        m_fileOffsetStart = 0;
+        m_fileOffsetEnd = m_mappedFile->Size();
+        m_bufferStart = m_mappedFile->Data();
+        m_bufferEnd = m_bufferStart + m_mappedFile->Size();
+        m_pos = m_bufferStart;
+    }
+}
+
+template <class ElemType>
+void TextParser<ElemType>::InitializeStreaming()
+{
+    // The input may be a pipe, so it is neither indexed, nor memory mapped, nor checked for a BOM, which would need a seek.
+    m_file = fopenOrDie(m_filename, L"rbS");
+    m_fileOffsetStart = 0;
+    m_fileOffsetEnd = 0;
 }
 
 template <class ElemType>
 ChunkDescriptions TextParser<ElemType>::GetChunkDescriptions()
 {
+    if (m_streaming)
+    {
+        LogicError("The streamed input (%ls) has no chunks, it can only be read through GetNextSequence.", m_filename.c_str());
+    }
+
     assert(m_indexer != nullptr);
 
     const auto& index = m_indexer->GetIndex();
@@ -215,16 +316,16 @@ void TextParser<ElemType>::GetSequencesForChunk(ChunkIdType chunkId, std::vector
 {
     const auto& index = m_indexer->GetIndex();
     const auto& chunk = index.m_chunks[chunkId];
-    result.reserve(chunk.m_sequences.size());
+    result.reserve(chunk.m_numberOfSequences);
 
-    for (auto const& s : chunk.m_sequences)
+    for (size_t i = 0; i < chunk.m_numberOfSequences; ++i)
     {
         result.push_back(
         {
-            s.m_id,
-            s.m_numberOfSamples,
-            s.m_chunkId,
-            s.m_key
+            i,
+            chunk.m_sequenceNumberOfSamples[i],
+            chunk.m_id,
+            chunk.m_sequenceKeys[i]
         });
     }
 }
@@ -268,10 +369,15 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor)
 {
-    chunk->m_sequenceMap.resize(descriptor.m_sequences.size());
-    for (const auto& sequenceDescriptor : descriptor.m_sequences)
+    chunk->m_sequenceMap.resize(descriptor.m_numberOfSequences);
+    if (m_mappedFile && descriptor.m_numberOfSequences > 0)
     {
-        chunk->m_sequenceMap[sequenceDescriptor.m_id] = LoadSequence(sequenceDescriptor);
+        m_mappedFile->WillNeed(descriptor.m_fileOffsetBytes, descriptor.m_byteSize);
+    }
+
+    for (size_t i = 0; i < descriptor.m_numberOfSequences; ++i)
+    {
+        chunk->m_sequenceMap[i] = LoadSequence(descriptor.GetSequence(i));
     }
 }
 
@@ -291,6 +397,12 @@ void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 template <class ElemType>
 bool TextParser<ElemType>::TryRefillBuffer()
 {
+    if (m_mappedFile)
+    {
+        // The buffer already spans the whole file.
+        return false;
+    }
+
     size_t bytesRead = fread(m_buffer.get(), 1, BUFFER_SIZE, m_file);
 
     if (bytesRead == (size_t)-1)
@@ -315,6 +427,13 @@ bool TextParser<ElemType>::TryRefillBuffer()
 template <class ElemType>
 void TextParser<ElemType>::SetFileOffset(int64_t offset)
 {
+    if (m_mappedFile)
+    {
+        PrintWarningNotification();
+        RuntimeError("Position %" PRId64 " is beyond the end of the input file (%ls).",
+            offset, m_filename.c_str());
+    }
+
     int rc = _fseeki64(m_file, offset, SEEK_SET);
     if (rc)
     {
@@ -330,19 +449,8 @@ void TextParser<ElemType>::SetFileOffset(int64_t offset)
 }
 
 template <class ElemType>
-typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(const SequenceDescriptor& sequenceDsc)
+typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::CreateSequenceBuffer(size_t expectedNumberOfSamples)
 {
-    auto fileOffset = sequenceDsc.m_fileOffsetBytes;
-
-    if (fileOffset < m_fileOffsetStart || fileOffset > m_fileOffsetEnd)
-    {
-        SetFileOffset(fileOffset);
-    }
-
-    size_t bufferOffset = fileOffset - m_fileOffsetStart;
-    m_pos = m_bufferStart + bufferOffset;
-    size_t bytesToRead = sequenceDsc.m_byteSize;
-
     SequenceBuffer sequence;
 
     // TODO: reuse loaded sequences instead of creating new ones!
@@ -351,7 +459,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         if (stream.m_type == StorageType::dense)
         {
             sequence.push_back(make_unique<DenseInputStreamBuffer>(
-                stream.m_sampleDimension * sequenceDsc.m_numberOfSamples));
+                stream.m_sampleDimension * expectedNumberOfSamples));
         }
         else
         {
@@ -359,6 +467,25 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         }
     }
 
+    return sequence;
+}
+
+template <class ElemType>
+typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(const SequenceDescriptor& sequenceDsc)
+{
+    auto fileOffset = sequenceDsc.m_fileOffsetBytes;
+
+    if (fileOffset < m_fileOffsetStart || fileOffset > m_fileOffsetEnd)
+    {
+        SetFileOffset(fileOffset);
+    }
+
+    size_t bufferOffset = fileOffset - m_fileOffsetStart;
+    m_pos = m_bufferStart + bufferOffset;
+    size_t bytesToRead = sequenceDsc.m_byteSize;
+
+    SequenceBuffer sequence = CreateSequenceBuffer(sequenceDsc.m_numberOfSamples);
+
     size_t numRowsRead = 0, expectedRowCount = sequenceDsc.m_numberOfSamples;
     for (size_t i = 0; i < expectedRowCount; i++)
     {
@@ -459,6 +586,109 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     return sequence;
 }
 
+template <class ElemType>
+bool TextParser<ElemType>::TryReadRowSequenceId(size_t& id)
+{
+    bool found = false;
+    id = 0;
+    while (CanRead() && IsDigit(*m_pos))
+    {
+        found = true;
+        id = id * 10 + (*m_pos - '0');
+        ++m_pos;
+    }
+    return found;
+}
+
+// As in the Indexer, consecutive rows with the same sequence id (or without one) form a sequence,
+// unless the input has no sequence ids, then each row is a sequence.
+template <class ElemType>
+bool TextParser<ElemType>::GetNextSequence(std::vector<SequenceDataPtr>& result)
+{
+    if (!m_streaming)
+    {
+        LogicError("The input (%ls) is not streamed, its sequences have to be read by chunks.", m_filename.c_str());
+    }
+
+    if (!m_streamStarted)
+    {
+        if (!CanRead())
+        {
+            return false;
+        }
+        m_streamStarted = true;
+        m_streamHasSequenceIds = !m_skipSequenceIds && *m_pos != NAME_PREFIX;
+    }
+
+    for (;;)
+    {
+        if (!m_hasNextRowSequenceId && !CanRead())
+        {
+            PrintWarningNotification();
+            return false;
+        }
+
+        size_t id = 0;
+        if (m_hasNextRowSequenceId)
+        {
+            id = m_nextRowSequenceId;
+            m_hasNextRowSequenceId = false;
+        }
+        else if (m_streamHasSequenceIds)
+        {
+            TryReadRowSequenceId(id);
+        }
+
+        SequenceBuffer sequence = CreateSequenceBuffer(1);
+        for (;;)
+        {
+            size_t bytesToRead = numeric_limits<size_t>::max();
+            if (!TryReadRow(sequence, bytesToRead))
+            {
+                IncrementNumberOfErrorsOrDie();
+            }
+
+            if (!m_streamHasSequenceIds || !CanRead())
+            {
+                break;
+            }
+
+            size_t nextId;
+            if (TryReadRowSequenceId(nextId) && nextId != id)
+            {
+                m_nextRowSequenceId = nextId;
+                m_hasNextRowSequenceId = true;
+                break;
+            }
+        }
+
+        bool hasEmptyInputs = false;
+        for (size_t i = 0; i < sequence.size(); ++i)
+        {
+            if (sequence[i]->m_numberOfSamples == 0)
+            {
+                if (ShouldWarn())
+                {
+                    fprintf(stderr,
+                        "WARNING: Input ('%ls') is empty in sequence (id = %" PRIu64 ") %ls, skipping the sequence.\n",
+                        m_streams[i]->m_name.c_str(), id, GetFileInfo().c_str());
+                }
+                hasEmptyInputs = true;
+            }
+        }
+
+        if (hasEmptyInputs)
+        {
+            IncrementNumberOfErrorsOrDie();
+            continue;
+        }
+
+        FillSequenceMetadata(sequence, m_numberOfStreamedSequences++);
+        result.assign(sequence.begin(), sequence.end());
+        return true;
+    }
+}
+
 template<class ElemType>
 void TextParser<ElemType>::FillSequenceMetadata(SequenceBuffer& sequenceData, size_t sequenceId)
 {
@@ -477,7 +707,14 @@ void TextParser<ElemType>::FillSequenceMetadata(SequenceBuffer& sequenceData, si
             auto sparseData = static_cast<SparseInputStreamBuffer*>(data);
             sparseData->m_indices = sparseData->m_indicesBuffer.data();
             assert(data->m_numberOfSamples == sparseData->m_nnzCounts.size());
-            data->m_data = sparseData->m_buffer.data();
+            // Values that are all 1 are dropped (one-hot input has none to begin with), the sequence is then
+            // given by its indices only, which halves its memory and what is transferred to the device.
+            auto& values = sparseData->m_buffer;
+            if (!values.empty() && std::all_of(values.begin(), values.end(), [](ElemType value) { return value == 1; }))
+            {
+                std::vector<ElemType>().swap(values);
+            }
+            data->m_data = values.empty() ? nullptr : values.data();
         }
 
         data->m_id = sequenceId;
@@ -618,12 +855,13 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         SparseInputStreamBuffer* data = reinterpret_cast<SparseInputStreamBuffer*>(sequence[id].get());
         vector<ElemType>& values = data->m_buffer;
         vector<IndexType>& indices = data->m_indicesBuffer;
-        assert(values.size() == indices.size());
-        size_t size = values.size();
-        if (!TryReadSparseSample(values, indices, stream.m_sampleDimension, bytesToRead))
+        // (one-hot input has no values)
+        assert(stream.m_isOneHot ? values.empty() : values.size() == indices.size());
+        size_t size = indices.size();
+        if (!TryReadSparseSample(values, indices, stream.m_sampleDimension, stream.m_isOneHot, bytesToRead))
         {
             // expected a sparse sample, but something went south, ignore it.
-            if (values.size() != size)
+            if (!stream.m_isOneHot && values.size() != size)
             {
                 //clean up the buffer
                 values.resize(size);
@@ -637,9 +875,9 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
             IncrementNumberOfErrorsOrDie();
             return false;
         }
-        assert(values.size() == indices.size());
+        assert(stream.m_isOneHot ? values.empty() : values.size() == indices.size());
         ++data->m_numberOfSamples;
-        IndexType count = static_cast<IndexType>(values.size() - size);
+        IndexType count = static_cast<IndexType>(indices.size() - size);
         data->m_nnzCounts.push_back(count);
         data->m_totalNnzCount += count;
     }
@@ -795,7 +1033,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
 
 template <class ElemType>
 bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
-    size_t sampleSize, size_t& bytesToRead)
+    size_t sampleSize, bool isOneHot, size_t& bytesToRead)
 {
     size_t index = 0;
     ElemType value;
@@ -839,6 +1077,13 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
             return false;
         }
 
+        // in one-hot input, an index may stand alone
+        if (isOneHot && (!CanRead() || *m_pos != INDEX_DELIMITER))
+        {
+            indices.push_back(static_cast<IndexType>(index));
+            continue;
+        }
+
         // an index must be followed by a delimiter
         c = *m_pos;
         if (c != INDEX_DELIMITER)
@@ -865,7 +1110,21 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
             return false;
         }
 
-        values.push_back(value);
+        if (!isOneHot)
+        {
+            values.push_back(value);
+        }
+        else if (value != 1)
+        {
+            if (ShouldWarn())
+            {
+                fprintf(stderr,
+                    "WARNING: Sparse value (%g) of one-hot input %ls is not 1.\n",
+                    (double)value, GetFileInfo().c_str());
+            }
+            // bail out.
+            return false;
+        }
         indices.push_back(static_cast<IndexType>(index));
     }
 
@@ -911,9 +1170,37 @@ void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
     }
 }
 
+template <class ElemType>
+bool TextParser<ElemType>::TryReadUint64Fast(size_t& value, size_t& bytesToRead)
+{
+    const char* end = m_pos + std::min<size_t>(bytesToRead, m_bufferEnd - m_pos);
+    size_t numDigits = CountDigits(m_pos, end);
+    // The token must be followed by a character within the buffer, and be short enough not to overflow.
+    if (numDigits == 0 || m_pos + numDigits == end || numDigits > std::numeric_limits<size_t>::digits10)
+    {
+        return false;
+    }
+
+    size_t result = 0;
+    for (size_t i = 0; i < numDigits; ++i)
+    {
+        result = result * 10 + (m_pos[i] - '0');
+    }
+
+    value = result;
+    m_pos += numDigits;
+    bytesToRead -= numDigits;
+    return true;
+}
+
 template <class ElemType>
 bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 {
+    if (TryReadUint64Fast(value, bytesToRead))
+    {
+        return true;
+    }
+
     value = 0;
     bool found = false;
     while (bytesToRead && CanRead())
@@ -963,9 +1250,113 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 // Post condition: m_pos points to the first character that 
 // cannot be parsed as part of a floating point number.
 // Returns true if parsing was successful.
+template <class ElemType>
+bool TextParser<ElemType>::TryReadRealNumberFast(ElemType& value, size_t& bytesToRead)
+{
+    // Follows the states of TryReadRealNumber (and its arithmetic), but scans the digits in runs.
+    // Returns false whenever the token is malformed or reaches the end of the buffer.
+    const char* p = m_pos;
+    const char* end = m_pos + std::min<size_t>(bytesToRead, m_bufferEnd - m_pos);
+
+    bool negative = false;
+    if (p != end && isSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    size_t numDigits = CountDigits(p, end);
+    if (numDigits == 0 || p + numDigits == end)
+    {
+        return false;
+    }
+    double number = ParseDigits(p, numDigits);
+    p += numDigits;
+
+    double coefficient;
+    if (*p == '.')
+    {
+        ++p;
+        numDigits = CountDigits(p, end);
+        if (p + numDigits == end)
+        {
+            return false;
+        }
+
+        if (numDigits == 0)
+        {
+            // a period that is not followed by digits ends the number
+            value = static_cast<ElemType>((negative) ? -number : number);
+            bytesToRead -= p - m_pos;
+            m_pos = p;
+            return true;
+        }
+
+        double fraction = 0, divider = 1;
+        for (size_t i = 0; i < numDigits; ++i)
+        {
+            fraction = fraction * 10 + (p[i] - '0');
+            divider *= 10;
+        }
+        p += numDigits;
+        coefficient = number + fraction / divider;
+
+        if (!isE(*p))
+        {
+            value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
+            bytesToRead -= p - m_pos;
+            m_pos = p;
+            return true;
+        }
+
+        if (negative)
+        {
+            coefficient = -coefficient;
+        }
+    }
+    else if (isE(*p))
+    {
+        coefficient = (negative) ? -number : number;
+    }
+    else
+    {
+        value = static_cast<ElemType>((negative) ? -number : number);
+        bytesToRead -= p - m_pos;
+        m_pos = p;
+        return true;
+    }
+
+    // skip the exponent symbol, an exponent must follow
+    ++p;
+    bool negativeExponent = false;
+    if (p != end && isSign(*p))
+    {
+        negativeExponent = (*p == '-');
+        ++p;
+    }
+
+    numDigits = CountDigits(p, end);
+    if (numDigits == 0 || p + numDigits == end)
+    {
+        return false;
+    }
+    double exponent = ParseDigits(p, numDigits);
+    p += numDigits;
+
+    value = static_cast<ElemType>(coefficient * pow(10.0, (negativeExponent) ? -exponent : exponent));
+    bytesToRead -= p - m_pos;
+    m_pos = p;
+    return true;
+}
+
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
+    if (TryReadRealNumberFast(value, bytesToRead))
+    {
+        return true;
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
@@ -1185,6 +1576,30 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
     m_numRetries = numRetries;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetUseMemoryMapping(bool useMemoryMapping)
+{
+    m_useMemoryMapping = useMemoryMapping;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumIndexingThreads(size_t numThreads)
+{
+    m_numIndexingThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetStreaming(bool streaming)
+{
+    m_streaming = streaming;
+}
+
 template <class ElemType>
 std::wstring TextParser<ElemType>::GetFileInfo()
 {
@@ -1196,19 +1611,19 @@ std::wstring TextParser<ElemType>::GetFileInfo()
 template <class ElemType>
 bool TextParser<ElemType>::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
 {
-    const auto& keys = m_indexer->GetIndex().m_keyToSequenceInChunk;
-    auto sequenceLocation = keys.find(key.m_sequence);
-    if (sequenceLocation == keys.end())
+    const auto& index = m_indexer->GetIndex();
+    auto sequenceLocation = index.FindSequence(key.m_sequence);
+    if (!sequenceLocation)
     {
         return false;
     }
 
-    result = m_indexer->GetIndex().m_chunks[sequenceLocation->second.first].m_sequences[sequenceLocation->second.second];
+    result = index.m_chunks[sequenceLocation->m_chunkId].GetSequence(sequenceLocation->m_indexInChunk);
     return true;
 }
 
 template <class ElemType>
-const string& TextParser<ElemType>::GetSequenceKey(const SequenceDescriptor& s) const
+string TextParser<ElemType>::GetSequenceKey(const SequenceDescriptor& s) const
 {
     return m_corpus->GetStringRegistry()[s.m_key.m_sequence];
 }
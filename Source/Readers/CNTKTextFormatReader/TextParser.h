@@ -10,6 +10,7 @@
 #include "TextConfigHelper.h"
 #include "Indexer.h"
 #include "CorpusDescriptor.h"
+#include "MemoryMappedFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -18,8 +19,10 @@ class CNTKTextFormatReaderTestRunner;
 
 // TODO: more details when tracing warnings
 // (e.g., buffer content around the char that triggered the warning)
+// With the 'streaming' option, the input is not indexed: it is read front to back through IStreamingDataDeserializer,
+// so that it can be a pipe (or '-' for stdin) or a log of unknown size, and the chunk based interface is not available.
 template <class ElemType>
-class TextParser : public DataDeserializerBase {
+class TextParser : public DataDeserializerBase, public IStreamingDataDeserializer {
 public:
     explicit TextParser(const TextConfigHelper& helper);
 
@@ -38,10 +41,21 @@ public:
 
     bool GetSequenceDescriptionByKey(const KeyType&, SequenceDescription&) override;
 
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return DataDeserializerBase::GetStreamDescriptions();
+    }
+
+    // Reads the next sequence of the input, in streaming mode.
+    bool GetNextSequence(std::vector<SequenceDataPtr>& result) override;
+
 private:
     // Builds an index of the input data.
     void Initialize();
 
+    // Opens the input for reading it front to back, without an index.
+    void InitializeStreaming();
+
     struct DenseInputStreamBuffer : DenseSequenceData
     {
         // capacity = expected number of samples * sample size
@@ -98,6 +112,21 @@ private:
     int64_t m_fileOffsetStart;
     int64_t m_fileOffsetEnd;
 
+    // Whether the input is read front to back instead of by chunks (see GetNextSequence).
+    bool m_streaming;
+    // Whether the rows of the streamed input start with sequence ids, known once the first row has been seen.
+    bool m_streamHasSequenceIds;
+    bool m_streamStarted;
+    // The sequence id of the next row, if it has already been read while looking for the end of a sequence.
+    size_t m_nextRowSequenceId;
+    bool m_hasNextRowSequenceId;
+    // Number of sequences read from the streamed input so far, used as their ids.
+    size_t m_numberOfStreamedSequences;
+
+    // If set, the whole file is the buffer, and chunks are parsed directly from the OS file cache.
+    MemoryMappedFilePtr m_mappedFile;
+    bool m_useMemoryMapping;
+
     // TODO: not DRY (same in the Indexer), needs refactoring
     unique_ptr<char[]> m_buffer;
     const char* m_bufferStart;
@@ -111,6 +140,8 @@ private:
     bool m_hadWarnings;
     unsigned int m_numAllowedErrors;
     bool m_skipSequenceIds;
+    size_t m_numIndexingThreads; // number of threads scanning the input file when building the index
+    bool m_cacheIndex; // if true, the index is saved to and loaded from a file next to the input
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
     // file operation should be repeated (default value is 5).
 
@@ -145,12 +176,23 @@ private:
 
     bool TryReadUint64(size_t& value, size_t& bytesToRead);
 
+    // Reads the sequence id at the start of a row of the streamed input, returns false if the row has none.
+    bool TryReadRowSequenceId(size_t& id);
+
+    // Fast paths of the two functions above for a well-formed token that ends inside the buffer.
+    // Nothing is consumed if they return false, the caller then falls back to the character-wise
+    // parser, which handles buffer refills and reports errors.
+    bool TryReadRealNumberFast(ElemType& value, size_t& bytesToRead);
+
+    bool TryReadUint64Fast(size_t& value, size_t& bytesToRead);
+
     // Reads dense sample values into the provided vector.
     bool TryReadDenseSample(std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
 
     // Reads sparse sample values and corresponding indices into the provided vectors.
+    // For one-hot input, only the indices are read, with or without the value 1.
     bool TryReadSparseSample(std::vector<ElemType>& values, std::vector<IndexType>& indices,
-        size_t sampleSize, size_t& bytesToRead);
+        size_t sampleSize, bool isOneHot, size_t& bytesToRead);
 
     // Reads one sample (an input identifier followed by a list of values)
     bool TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead);
@@ -164,6 +206,9 @@ private:
     // Returns true if the trace level is greater or equal to 'Warning'
     bool inline ShouldWarn() { m_hadWarnings = true; return m_traceLevel >= Warning; }
 
+    // Creates empty per-stream buffers for a sequence of the expected number of samples.
+    SequenceBuffer CreateSequenceBuffer(size_t expectedNumberOfSamples);
+
     // Given a descriptor, retrieves the data for the corresponding sequence from the file.
     SequenceBuffer LoadSequence(const SequenceDescriptor& descriptor);
 
@@ -185,9 +230,17 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetUseMemoryMapping(bool useMemoryMapping);
+
+    void SetNumIndexingThreads(size_t numThreads);
+
+    void SetCacheIndex(bool cacheIndex);
+
+    void SetStreaming(bool streaming);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
-    const std::string& GetSequenceKey(const SequenceDescriptor& s) const;
+    std::string GetSequenceKey(const SequenceDescriptor& s) const;
 
     DISABLE_COPY_AND_MOVE(TextParser);
 };
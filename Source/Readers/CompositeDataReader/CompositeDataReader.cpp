@@ -30,7 +30,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // This method composes together packers + randomizer + a set of transformers and deserializers.
 CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryProviderPtr provider) : m_layout(make_shared<MBLayout>()),
     m_corpus(std::make_shared<CorpusDescriptor>()),
-    m_provider(provider)
+    m_provider(provider),
+    m_lengthBucketSize(0)
 {
     wstring action = config(L"action", L"");
     bool isActionWrite = AreEqualIgnoreCase(action, L"write");
@@ -84,6 +85,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         bool cleanse = config(L"checkData", true);
         deserializer = std::make_shared<Bundler>(config, deserializer, m_deserializers, cleanse);
     }
+    m_deserializer = deserializer;
 
     int verbosity = config(L"verbosity", 0);
 
@@ -100,11 +102,21 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config, MemoryP
         size_t randomizationWindow = config(L"randomizationWindow", requestDataSize);
         // By default using STL random number generator.
         bool useLegacyRandomization = config(L"useLegacyRandomization", false);
-        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, useLegacyRandomization, multiThreadedDeserialization);
+        // Number of chunks read ahead in the background, to hide the latency of slow storage at chunk boundaries.
+        size_t maxPrefetchedChunks = config(L"maxPrefetchedChunks", (size_t)1);
+        // Groups sequences of similar length into buckets of this many samples (about the minibatch size),
+        // to reduce the padding of minibatches in sequence mode.
+        m_lengthBucketSize = config(L"lengthBucketSize", (size_t)0);
+        // Balances the samples of each minibatch across data-parallel workers, at the cost of every worker loading all chunks.
+        bool balanceWorkerLoad = config(L"balanceWorkerLoad", false);
+        auto decimationMode = balanceWorkerLoad ? BlockRandomizer::DecimationMode::balanced : BlockRandomizer::DecimationMode::chunk;
+        m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, true /* should Prefetch */, decimationMode, useLegacyRandomization, multiThreadedDeserialization, maxPrefetchedChunks, m_lengthBucketSize);
     }
     else
     {
-        m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization);
+        // In distributed reading, each worker only reads its own chunks instead of its part of all chunks.
+        bool shardChunks = config(L"shardChunks", false);
+        m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization, shardChunks);
     }
 
     // In case when there are transforms, applying them to the data.
@@ -138,6 +150,15 @@ Minibatch CompositeDataReader::ReadMinibatch()
     return m_packer->ReadMinibatch();
 }
 
+void CompositeDataReader::SetMemoryProvider(MemoryProviderPtr provider)
+{
+    m_provider = provider;
+    if (m_packer)
+    {
+        m_packer->SetMemoryProvider(provider);
+    }
+}
+
 // Create deserializers based on the specified configuration. 
 // deserializers = [
 //        [ type = "ImageDataDeserializer" module = "ImageReader" ...]
@@ -273,7 +294,8 @@ void CompositeDataReader::StartEpoch(const EpochConfiguration& cfg)
         m_packer = std::make_shared<SequencePacker>(
             m_provider,
             m_sequenceEnumerator,
-            m_streams);
+            m_streams,
+            m_lengthBucketSize > 0 /* packLongestFirst */);
         break;
     case PackingMode::truncated:
     {
@@ -66,6 +66,12 @@ public:
     // Reads a minibatch that contains data across all streams.
     Minibatch ReadMinibatch() override;
 
+    // Sets the memory provider of the minibatch buffers.
+    void SetMemoryProvider(MemoryProviderPtr provider) override;
+
+    // The bundle of all deserializers, without randomization and transforms.
+    IDataDeserializerPtr GetDeserializer() const { return m_deserializer; }
+
 private:
     void CreateDeserializers(const ConfigParameters& readerConfig);
     void CreateTransforms(const ConfigParameters& deserializerConfig);
@@ -106,6 +112,9 @@ private:
     // A list of deserializers.
     std::vector<IDataDeserializerPtr> m_deserializers;
 
+    // The deserializers, bundled if there are several.
+    IDataDeserializerPtr m_deserializer;
+
     // A list of transformers.
     std::vector<Transformation> m_transforms;
 
@@ -127,6 +136,9 @@ private:
 
     // Truncation length for BPTT mode.
     size_t m_truncationLength;
+
+    // Size of the length buckets of the randomizer in samples, 0 if sequences are not bucketed.
+    size_t m_lengthBucketSize;
 };
 
 }}}
@@ -13,6 +13,8 @@
 #include "CompositeDataReader.h"
 #include "ReaderShim.h"
 #include "HeapMemoryProvider.h"
+#include "BinaryChunkDeserializer.h"
+#include "BinaryChunkWriter.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -50,4 +52,24 @@ extern "C" DATAREADER_API Reader* CreateCompositeDataReader(const ConfigParamete
     return new CompositeDataReader(*parameters, std::make_shared<HeapMemoryProvider>());
 }
 
+// A factory method for creating deserializers of the binary chunked format.
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr, bool)
+{
+    if (type == L"BinaryChunkDeserializer")
+        *deserializer = new BinaryChunkDeserializer(deserializerConfig);
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
+// Converts the data of the deserializers of a reader config, without randomization and transforms, into the binary
+// chunked format, which is read by 'BinaryChunkDeserializer' of this module.
+extern "C" DATAREADER_API void ConvertToBinaryChunks(const ConfigParameters* readerConfig, const std::wstring& outputPath)
+{
+    CompositeDataReader reader(*readerConfig, std::make_shared<HeapMemoryProvider>());
+    BinaryChunkWriter::Write(reader.GetDeserializer(), outputPath);
+}
+
 }}}
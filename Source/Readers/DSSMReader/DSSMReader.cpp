@@ -251,6 +251,7 @@ void DSSMReader<ElemType>::ReleaseMemory()
     if (m_labelsBuffer != NULL)
         delete[] m_labelsBuffer;
     m_labelsBuffer = NULL;
+    m_labelsBufferCols = 0;
     if (m_labelsIdBuffer != NULL)
         delete[] m_labelsIdBuffer;
     m_labelsIdBuffer = NULL;
@@ -389,10 +390,13 @@ bool DSSMReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
     exit(1);
     */
 
-    if (actualMBSize > m_mbSize || m_labelsBuffer == NULL)
+    // The labels are constant (the first row is the positive document), so they are only uploaded when the number of columns changes.
+    size_t rows = labels.GetNumRows();
+    if (actualMBSize > m_labelsBufferCols)
     {
-        size_t rows = labels.GetNumRows();
+        delete[] m_labelsBuffer;
         m_labelsBuffer = new ElemType[rows * actualMBSize];
+        m_labelsBufferCols = actualMBSize;
         memset(m_labelsBuffer, 0, sizeof(ElemType) * rows * actualMBSize);
         for (int i = 0; i < actualMBSize; i++)
         {
@@ -401,9 +405,6 @@ bool DSSMReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
     }
     if (actualMBSize != labels.GetNumCols())
     {
-        size_t rows = labels.GetNumRows();
-        labels.Resize(rows, actualMBSize);
-        labels.SetValue(0.0);
         labels.SetValue(rows, actualMBSize, labels.GetDeviceId(), m_labelsBuffer, 0);
     }
     /*
@@ -450,6 +451,7 @@ bool DSSMReader<ElemType>::DataEnd() { return true; }
 
 template <class ElemType>
 DSSM_BinaryInput<ElemType>::DSSM_BinaryInput()
+    : offsets_orig(NULL), data_orig(NULL), mbSize(0), m_maxNNz(0), values(NULL), offsets(NULL), colIndices(NULL), rowIndices(NULL)
 {
 }
 template <class ElemType>
@@ -541,9 +543,10 @@ bool DSSM_BinaryInput<ElemType>::SetupEpoch(size_t minibatchSize)
             free(rowIndices);
         }
 
-        values = (ElemType*) malloc(sizeof(ElemType) * MAX_BUFFER * minibatchSize);
+        m_maxNNz = MAX_BUFFER * minibatchSize;
+        values = (ElemType*) malloc(sizeof(ElemType) * m_maxNNz);
         colIndices = (int32_t*) malloc(sizeof(int32_t) * (minibatchSize + 1));
-        rowIndices = (int32_t*) malloc(sizeof(int32_t) * MAX_BUFFER * minibatchSize);
+        rowIndices = (int32_t*) malloc(sizeof(int32_t) * m_maxNNz);
         // fprintf(stderr, "values  size: %d",sizeof(ElemType)*MAX_BUFFER*minibatchSize);
         // fprintf(stderr, "colindi size: %d",sizeof(int32_t)*MAX_BUFFER*(1+minibatchSize));
         // fprintf(stderr, "rowindi size: %d",sizeof(int32_t)*MAX_BUFFER*minibatchSize);
@@ -573,6 +576,15 @@ bool DSSM_BinaryInput<ElemType>::Next_Batch(Matrix<ElemType>& matrices, size_t c
         // int32_t nnz;
         colIndices[c] = cur_index;
         int32_t nnz = *(int32_t*) ((char*) data_buffer + cur_offset);
+        if ((size_t) (cur_index + nnz) > m_maxNNz)
+        {
+            // the CSC arrays are filled straight from the mapped file, so they grow in place when a minibatch is denser than expected
+            m_maxNNz = max((size_t) (cur_index + nnz), 2 * m_maxNNz);
+            values = (ElemType*) realloc(values, sizeof(ElemType) * m_maxNNz);
+            rowIndices = (int32_t*) realloc(rowIndices, sizeof(int32_t) * m_maxNNz);
+            if (values == NULL || rowIndices == NULL)
+                RuntimeError("DSSM_BinaryInput: out of memory for %d non-zero values.", (int) m_maxNNz);
+        }
         // memcpy(&nnz, (char*)data_buffer + cur_offset, sizeof(int32_t));
         memcpy(values + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t), sizeof(ElemType) * nnz);
         memcpy(rowIndices + cur_index, (char*) data_buffer + cur_offset + sizeof(int32_t) + sizeof(ElemType) * nnz, sizeof(int32_t) * nnz);
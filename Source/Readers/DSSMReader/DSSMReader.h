@@ -44,6 +44,7 @@ private:
     size_t m_dim;
     size_t mbSize;
     size_t MAX_BUFFER = 300;
+    size_t m_maxNNz; // capacity of values and rowIndices, grown when a minibatch has more non-zeros
 
     ElemType* values;    // = (ElemType*)malloc(sizeof(float)* 230 * 1024);
     int64_t* offsets;    // = (int*)malloc(sizeof(int)* 230 * 1024);
@@ -102,6 +103,7 @@ private:
     ElemType* m_qfeaturesBuffer;
     ElemType* m_dfeaturesBuffer;
     ElemType* m_labelsBuffer;
+    size_t m_labelsBufferCols; // number of columns m_labelsBuffer has been allocated for
     LabelIdType* m_labelsIdBuffer;
     std::wstring m_labelFileToWrite; // set to the path if we need to write out the label file
 
@@ -156,6 +158,7 @@ public:
         m_qfeaturesBuffer = NULL;
         m_dfeaturesBuffer = NULL;
         m_labelsBuffer = NULL;
+        m_labelsBufferCols = 0;
     }
     virtual ~DSSMReader();
     virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples = requestDataSize);
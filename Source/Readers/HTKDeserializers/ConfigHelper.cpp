@@ -217,9 +217,19 @@ wstring ConfigHelper::GetRandomizer()
     return randomizer;
 }
 
+wstring ConfigHelper::GetScpFilePath() const
+{
+    return m_config(L"scpFile");
+}
+
+wstring ConfigHelper::GetFeatureArchivePath() const
+{
+    return m_config(L"featureArchive", L"");
+}
+
 vector<wstring> ConfigHelper::GetSequencePaths()
 {
-    wstring scriptPath = m_config(L"scpFile");
+    wstring scriptPath = GetScpFilePath();
     wstring rootPath = m_config(L"prefixPathInSCP", L"");
 
     vector<wstring> filelist;
@@ -52,6 +52,12 @@ public:
     // Gets utterance paths from the configuration.
     std::vector<std::wstring> GetSequencePaths();
 
+    // Gets the path of the script file.
+    std::wstring GetScpFilePath() const;
+
+    // Gets the path of the feature archive of the script file, empty if features are read from the HTK files.
+    std::wstring GetFeatureArchivePath() const;
+
     // Gets randomization window.
     size_t GetRandomizationWindow();
 
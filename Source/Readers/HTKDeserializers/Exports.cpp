@@ -16,6 +16,7 @@
 #include "HeapMemoryProvider.h"
 #include "HTKDataDeserializer.h"
 #include "MLFDataDeserializer.h"
+#include "LatticeDeserializer.h"
 #include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -48,6 +49,10 @@ extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializ
     {
         *deserializer = new MLFDataDeserializer(corpus, deserializerConfig, primary);
     }
+    else if (type == L"LatticeDeserializer")
+    {
+        *deserializer = new LatticeDeserializer(corpus, deserializerConfig, primary);
+    }
     else
     {
         // Unknown type.
@@ -124,9 +124,18 @@ void HTKDataDeserializer::InitializeChunkDescriptions(ConfigHelper& config)
     auto& stringRegistry = m_corpus->GetStringRegistry();
     size_t allUtterances = 0, allFrames = 0;
 
+    vector<UtteranceDescription> descriptions;
+    descriptions.reserve(paths.size());
     for (const auto& u : paths)
     {
-        UtteranceDescription description(move(msra::asr::htkfeatreader::parsedpath(u)));
+        descriptions.push_back(UtteranceDescription(move(msra::asr::htkfeatreader::parsedpath(u))));
+    }
+    paths.clear();
+
+    InitializeFeatureArchive(config, descriptions);
+
+    for (auto& description : descriptions)
+    {
         size_t numberOfFrames = description.GetNumberOfFrames();
 
         if (m_expandToPrimary && numberOfFrames != 1)
@@ -151,7 +160,7 @@ void HTKDataDeserializer::InitializeChunkDescriptions(ConfigHelper& config)
 
         size_t id = stringRegistry[key];
         description.SetId(id);
-        utterances.push_back(description);
+        utterances.push_back(move(description));
         m_totalNumberOfFrames += numberOfFrames;
     }
 
@@ -208,6 +217,56 @@ void HTKDataDeserializer::InitializeChunkDescriptions(ConfigHelper& config)
     }
 }
 
+// Maps the feature archive, writing it first if it cannot be used for the utterances of the script file.
+// Utterances are stored in the archive in the order of the script file.
+void HTKDataDeserializer::InitializeFeatureArchive(ConfigHelper& config, vector<UtteranceDescription>& utterances)
+{
+    wstring archivePath = config.GetFeatureArchivePath();
+    if (archivePath.empty())
+    {
+        return;
+    }
+
+    if (msra::files::fuptodate(archivePath, config.GetScpFilePath()))
+    {
+        m_archive = HTKFeatureArchive::Open(archivePath);
+    }
+
+    if (m_archive)
+    {
+        bool matches = m_archive->GetNumberOfUtterances() == utterances.size();
+        for (size_t i = 0; matches && i < utterances.size(); ++i)
+        {
+            matches = m_archive->Matches(i, utterances[i].GetKey(), utterances[i].GetNumberOfFrames());
+        }
+
+        if (!matches)
+        {
+            fprintf(stderr, "WARNING: The feature archive '%ls' does not match the script file, writing it again.\n", archivePath.c_str());
+            m_archive = nullptr;
+        }
+    }
+
+    if (!m_archive)
+    {
+        msra::util::attempt(5, [&]()
+        {
+            HTKFeatureArchive::Write(archivePath, utterances);
+        });
+
+        m_archive = HTKFeatureArchive::Open(archivePath);
+        if (!m_archive)
+        {
+            RuntimeError("HTKDataDeserializer: Cannot open the feature archive '%ls' that has just been written.", archivePath.c_str());
+        }
+    }
+
+    for (size_t i = 0; i < utterances.size(); ++i)
+    {
+        utterances[i].SetArchiveIndex(i);
+    }
+}
+
 // Describes exposed stream - a single stream of htk features.
 void HTKDataDeserializer::InitializeStreams(const wstring& featureName)
 {
@@ -224,6 +283,16 @@ void HTKDataDeserializer::InitializeStreams(const wstring& featureName)
 // This information is used later to check that all features among all files have the same properties.
 void HTKDataDeserializer::InitializeFeatureInformation()
 {
+    if (m_archive)
+    {
+        m_featureKind = m_archive->GetFeatureKind();
+        m_ioFeatureDimension = m_archive->GetDimension();
+        m_samplePeriod = m_archive->GetSamplePeriod();
+        fprintf(stderr, "HTKDataDeserializer::HTKDataDeserializer: feature archive contains %d-dimensional '%s' with frame shift %.1f ms\n",
+            (int)m_ioFeatureDimension, m_featureKind.c_str(), m_samplePeriod / 1e4);
+        return;
+    }
+
     msra::util::attempt(5, [&]()
     {
         msra::asr::htkfeatreader reader;
@@ -298,29 +367,37 @@ void HTKDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, vector<Seque
     }
 }
 
-// A wrapper around a matrix that views it as a vector of column vectors.
+// A wrapper around a matrix, or around frames stored one after another, that views it as a vector of column vectors.
 // Does not have any memory associated.
 class MatrixAsVectorOfVectors
 {
 public:
-    MatrixAsVectorOfVectors(msra::dbn::matrixbase& m)
-        : m_matrix(m)
+    MatrixAsVectorOfVectors(const msra::dbn::matrixbase& m)
+        : m_data(m.empty() ? nullptr : &m(0, 0)), m_rows(m.rows()), m_columns(m.cols()), m_stride(m.getcolstride())
+    {
+    }
+
+    MatrixAsVectorOfVectors(const float* data, size_t rows, size_t columns)
+        : m_data(data), m_rows(rows), m_columns(columns), m_stride(rows)
     {
     }
 
     size_t size() const
     {
-        return m_matrix.cols();
+        return m_columns;
     }
 
     const_array_ref<float> operator[](size_t j) const
     {
-        return array_ref<float>(&m_matrix(0, j), m_matrix.rows());
+        assert(j < m_columns);
+        return const_array_ref<float>(m_data + j * m_stride, m_rows);
     }
 
 private:
-    DISABLE_COPY_AND_MOVE(MatrixAsVectorOfVectors);
-    msra::dbn::matrixbase& m_matrix;
+    const float* m_data;
+    size_t m_rows;
+    size_t m_columns;
+    size_t m_stride;
 };
 
 
@@ -332,6 +409,14 @@ public:
     HTKChunk(HTKDataDeserializer* parent, ChunkIdType chunkId) : m_parent(parent), m_chunkId(chunkId)
     {
         auto& chunkDescription = m_parent->m_chunks[chunkId];
+        if (m_parent->m_archive)
+        {
+            // The chunk is a view of the archive, the utterances of a chunk are consecutive in it.
+            m_parent->m_archive->WillNeed(
+                chunkDescription.GetUtterance(0)->GetArchiveIndex(),
+                chunkDescription.GetUtterance(chunkDescription.GetNumberOfUtterances() - 1)->GetArchiveIndex());
+            return;
+        }
 
         // possibly distributed read
         // making several attempts
@@ -350,6 +435,11 @@ public:
     // Unloads the data from memory.
     ~HTKChunk()
     {
+        if (m_parent->m_archive)
+        {
+            return;
+        }
+
         auto& chunkDescription = m_parent->m_chunks[m_chunkId];
         chunkDescription.ReleaseData(m_parent->m_verbosity);
     }
@@ -444,6 +534,24 @@ private:
     std::vector<double> m_buffer;
 };
 
+// This class references frames of a feature archive, without a copy.
+struct HTKArchiveSequenceData : DenseSequenceData
+{
+    HTKArchiveSequenceData(HTKFeatureArchivePtr archive, const float* frames, size_t numberOfFrames) : m_archive(archive)
+    {
+        m_numberOfSamples = (uint32_t)numberOfFrames;
+        if (m_numberOfSamples != numberOfFrames)
+        {
+            RuntimeError("Maximum number of samples per sequence exceeded.");
+        }
+        m_data = const_cast<float*>(frames);
+    }
+
+private:
+    // Keeps the mapping alive.
+    HTKFeatureArchivePtr m_archive;
+};
+
 // Copies a source into a destination with the specified destination offset.
 static void CopyToOffset(const const_array_ref<float>& source, array_ref<float>& destination, size_t offset)
 {
@@ -484,10 +592,29 @@ void HTKDataDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector
     const auto& chunkDescription = m_chunks[chunkId];
     size_t utteranceIndex = m_frameMode ? chunkDescription.GetUtteranceForChunkFrameIndex(id) : id;
     const UtteranceDescription* utterance = chunkDescription.GetUtterance(utteranceIndex);
-    auto utteranceFrames = chunkDescription.GetUtteranceFrames(utteranceIndex);
+
+    if (m_archive && m_elementType == ElementType::tfloat && !m_expandToPrimary &&
+        m_augmentationWindow.first == 0 && m_augmentationWindow.second == 0)
+    {
+        // The frames are passed on as they are stored in the archive.
+        assert(m_dimension == m_archive->GetDimension());
+        const float* frames = m_archive->GetFrames(utterance->GetArchiveIndex());
+        if (m_frameMode)
+        {
+            size_t frameIndex = id - chunkDescription.GetStartFrameIndexInsideChunk(utteranceIndex);
+            r.push_back(make_shared<HTKArchiveSequenceData>(m_archive, frames + frameIndex * m_dimension, 1));
+        }
+        else
+        {
+            r.push_back(make_shared<HTKArchiveSequenceData>(m_archive, frames, utterance->GetNumberOfFrames()));
+        }
+        return;
+    }
 
     // wrapper that allows m[j].size() and m[j][i] as required by augmentneighbors()
-    MatrixAsVectorOfVectors utteranceFramesWrapper(utteranceFrames);
+    MatrixAsVectorOfVectors utteranceFramesWrapper = m_archive ?
+        MatrixAsVectorOfVectors(m_archive->GetFrames(utterance->GetArchiveIndex()), m_ioFeatureDimension, utterance->GetNumberOfFrames()) :
+        MatrixAsVectorOfVectors(chunkDescription.GetUtteranceFrames(utteranceIndex));
     size_t utteranceLength = m_frameMode ? 1  : (m_expandToPrimary ? utterance->GetExpansionLength() : utterance->GetNumberOfFrames());
     FeatureMatrix features(m_dimension, utteranceLength);
 
@@ -10,12 +10,15 @@
 #include "CorpusDescriptor.h"
 #include "UtteranceDescription.h"
 #include "HTKChunkDescription.h"
+#include "HTKFeatureArchive.h"
 #include "ConfigHelper.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // Class represents an HTK deserializer.
 // Provides a set of chunks/sequences to the upper layers.
+// With the 'featureArchive' option of the input, the features are read from an HTKFeatureArchive of the script file,
+// which is written if it is missing, older than the script file, or does not match it.
 class HTKDataDeserializer : public DataDeserializerBase
 {
 public:
@@ -46,6 +49,7 @@ private:
     void InitializeStreams(const std::wstring& featureName);
     void InitializeFeatureInformation();
     void InitializeAugmentationWindow(ConfigHelper& config);
+    void InitializeFeatureArchive(ConfigHelper& config, std::vector<UtteranceDescription>& utterances);
 
     // Gets sequence by its chunk id and id inside the chunk.
     void GetSequenceById(ChunkIdType chunkId, size_t id, std::vector<SequenceDataPtr>&);
@@ -59,6 +63,9 @@ private:
     // Chunk descriptions.
     std::vector<HTKChunkDescription> m_chunks;
 
+    // Feature archive all frames are read from, if configured; chunks then are views of the archive.
+    HTKFeatureArchivePtr m_archive;
+
     // Augmentation window.
     std::pair<size_t, size_t> m_augmentationWindow;
 
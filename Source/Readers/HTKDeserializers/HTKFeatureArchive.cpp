@@ -0,0 +1,251 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include "HTKFeatureArchive.h"
+#include "fileutil.h"
+#include "ssematrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static const uint32_t c_featureArchiveMagic = 0x41464843; // "CHFA"
+static const uint32_t c_featureArchiveVersion = 1;
+static const size_t c_featureArchiveAlignment = 64;
+
+struct HTKFeatureArchiveHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_dimension;
+    uint32_t m_samplePeriod;
+    char m_featureKind[16]; // zero terminated
+    uint64_t m_numberOfUtterances;
+    uint64_t m_namesOffset; // in bytes, from the start of the file
+    uint64_t m_namesSize;   // in bytes
+};
+
+struct HTKFeatureArchiveEntry
+{
+    uint64_t m_framesOffset; // in bytes, from the start of the file
+    uint64_t m_nameOffset;   // in bytes, from the start of the names
+    uint32_t m_nameLength;   // in bytes
+    uint32_t m_numberOfFrames;
+};
+
+static size_t AlignFeatureArchive(size_t size)
+{
+    return (size + c_featureArchiveAlignment - 1) / c_featureArchiveAlignment * c_featureArchiveAlignment;
+}
+
+static void WritePadding(FILE* f, size_t size)
+{
+    static const char zeros[c_featureArchiveAlignment] = {};
+    fwriteOrDie(zeros, 1, AlignFeatureArchive(size) - size, f);
+}
+
+HTKFeatureArchivePtr HTKFeatureArchive::Open(const wstring& path)
+{
+    // All deserializers of the process share a mapping for as long as one of them uses it.
+    static mutex registryLock;
+    static map<wstring, weak_ptr<HTKFeatureArchive>> registry;
+
+    lock_guard<mutex> lock(registryLock);
+    auto archive = registry[path].lock();
+    if (archive)
+    {
+        return archive;
+    }
+
+    MemoryMappedFilePtr file;
+    try
+    {
+        file = make_shared<MemoryMappedFile>(path);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot open the feature archive '%ls': %s\n", path.c_str(), e.what());
+        return nullptr;
+    }
+
+    archive = HTKFeatureArchivePtr(new HTKFeatureArchive(file));
+    if (!archive->IsValid())
+    {
+        fprintf(stderr, "WARNING: Ignoring the feature archive '%ls', it is not a valid archive.\n", path.c_str());
+        return nullptr;
+    }
+
+    registry[path] = archive;
+    return archive;
+}
+
+HTKFeatureArchive::HTKFeatureArchive(MemoryMappedFilePtr file)
+    : m_file(file), m_numberOfUtterances(0), m_dimension(0), m_samplePeriod(0), m_names(nullptr)
+{
+    if (m_file->Size() < sizeof(HTKFeatureArchiveHeader))
+    {
+        return;
+    }
+
+    const auto* header = reinterpret_cast<const HTKFeatureArchiveHeader*>(m_file->Data());
+    m_numberOfUtterances = header->m_numberOfUtterances;
+    m_dimension = header->m_dimension;
+    m_featureKind.assign(header->m_featureKind, strnlen(header->m_featureKind, sizeof(header->m_featureKind)));
+    m_samplePeriod = header->m_samplePeriod;
+    m_names = m_file->Data() + header->m_namesOffset;
+}
+
+bool HTKFeatureArchive::IsValid() const
+{
+    size_t size = m_file->Size();
+    if (size < sizeof(HTKFeatureArchiveHeader))
+    {
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const HTKFeatureArchiveHeader*>(m_file->Data());
+    if (header->m_magic != c_featureArchiveMagic || header->m_version != c_featureArchiveVersion || header->m_dimension == 0 ||
+        header->m_numberOfUtterances > (size - sizeof(*header)) / sizeof(HTKFeatureArchiveEntry) ||
+        header->m_namesOffset > size || header->m_namesSize > size - header->m_namesOffset)
+    {
+        return false;
+    }
+
+    size_t frameSize = m_dimension * sizeof(float);
+    for (size_t i = 0; i < m_numberOfUtterances; ++i)
+    {
+        const auto* entry = GetEntry(i);
+        if (entry->m_nameOffset > header->m_namesSize || entry->m_nameLength > header->m_namesSize - entry->m_nameOffset ||
+            entry->m_framesOffset > size || entry->m_numberOfFrames > (size - entry->m_framesOffset) / frameSize ||
+            entry->m_framesOffset % c_featureArchiveAlignment != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const HTKFeatureArchiveEntry* HTKFeatureArchive::GetEntry(size_t utterance) const
+{
+    assert(utterance < m_numberOfUtterances);
+    return reinterpret_cast<const HTKFeatureArchiveEntry*>(m_file->Data() + sizeof(HTKFeatureArchiveHeader)) + utterance;
+}
+
+bool HTKFeatureArchive::Matches(size_t utterance, const string& name, size_t numberOfFrames) const
+{
+    const auto* entry = GetEntry(utterance);
+    return entry->m_numberOfFrames == numberOfFrames && entry->m_nameLength == name.size() &&
+           memcmp(m_names + entry->m_nameOffset, name.data(), name.size()) == 0;
+}
+
+size_t HTKFeatureArchive::GetNumberOfFrames(size_t utterance) const
+{
+    return GetEntry(utterance)->m_numberOfFrames;
+}
+
+const float* HTKFeatureArchive::GetFrames(size_t utterance) const
+{
+    return reinterpret_cast<const float*>(m_file->Data() + GetEntry(utterance)->m_framesOffset);
+}
+
+void HTKFeatureArchive::WillNeed(size_t first, size_t last) const
+{
+    size_t begin = GetEntry(first)->m_framesOffset;
+    const auto* entry = GetEntry(last);
+    size_t end = entry->m_framesOffset + entry->m_numberOfFrames * m_dimension * sizeof(float);
+    if (begin < end)
+    {
+        m_file->WillNeed(begin, end - begin);
+    }
+}
+
+void HTKFeatureArchive::Write(const wstring& path, const vector<UtteranceDescription>& utterances)
+{
+    if (utterances.empty())
+    {
+        RuntimeError("HTKFeatureArchive: No utterances to write to '%ls'.", path.c_str());
+    }
+
+    msra::asr::htkfeatreader reader;
+    HTKFeatureArchiveHeader header = {};
+    string featureKind;
+    size_t dimension;
+    reader.getinfo(utterances.front().GetPath(), featureKind, dimension, header.m_samplePeriod);
+    if (featureKind.size() >= sizeof(header.m_featureKind))
+    {
+        RuntimeError("HTKFeatureArchive: Feature kind '%s' is too long.", featureKind.c_str());
+    }
+
+    header.m_magic = c_featureArchiveMagic;
+    header.m_version = c_featureArchiveVersion;
+    header.m_dimension = (uint32_t)dimension;
+    memcpy(header.m_featureKind, featureKind.data(), featureKind.size());
+    header.m_numberOfUtterances = utterances.size();
+
+    // All offsets are known up front from the frame ranges of the script file.
+    vector<HTKFeatureArchiveEntry> entries(utterances.size());
+    string names;
+    for (size_t i = 0; i < utterances.size(); ++i)
+    {
+        string name = utterances[i].GetKey();
+        entries[i].m_nameOffset = names.size();
+        entries[i].m_nameLength = (uint32_t)name.size();
+        entries[i].m_numberOfFrames = (uint32_t)utterances[i].GetNumberOfFrames();
+        names += name;
+    }
+
+    header.m_namesOffset = sizeof(header) + entries.size() * sizeof(HTKFeatureArchiveEntry);
+    header.m_namesSize = names.size();
+    size_t offset = AlignFeatureArchive(header.m_namesOffset + names.size());
+    for (auto& entry : entries)
+    {
+        entry.m_framesOffset = offset;
+        offset += AlignFeatureArchive(entry.m_numberOfFrames * dimension * sizeof(float));
+    }
+
+    wstring tempFile = path + L".tmp";
+    FILE* f = fopenOrDie(tempFile, L"wbS");
+    try
+    {
+        fwriteOrDie(&header, sizeof(header), 1, f);
+        fwriteOrDie(entries.data(), sizeof(HTKFeatureArchiveEntry), entries.size(), f);
+        fwriteOrDie(names.data(), 1, names.size(), f);
+        WritePadding(f, header.m_namesOffset + names.size());
+
+        // Utterances in the same archive file are read without reopening it.
+        const string& kind = featureKind;
+        msra::dbn::matrix frames;
+        for (const auto& utterance : utterances)
+        {
+            size_t numberOfFrames = utterance.GetNumberOfFrames();
+            frames.resize(dimension, numberOfFrames);
+            reader.read(utterance.GetPath(), kind, (unsigned int)header.m_samplePeriod, frames);
+            for (size_t j = 0; j < numberOfFrames; ++j)
+            {
+                fwriteOrDie(&frames(0, j), sizeof(float), dimension, f);
+            }
+            WritePadding(f, numberOfFrames * dimension * sizeof(float));
+        }
+
+        fcloseOrDie(f);
+    }
+    catch (...)
+    {
+        fclose(f);
+        throw;
+    }
+    renameOrDie(tempFile, path);
+
+    fprintf(stderr, "HTKFeatureArchive: Saved %" PRIu64 " utterances (%" PRIu64 " bytes) to '%ls'.\n",
+            utterances.size(), offset, path.c_str());
+}
+
+}}}
@@ -0,0 +1,80 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HTKFeatureArchive.h -- the features of all utterances of a script file packed into a single file.
+//
+// The archive is memory mapped once per process and shared by all deserializers that use it, the workers
+// on a host share the pages of the OS file cache. Frames are read straight from the mapping, so loading
+// a chunk does not open or seek the feature files of its utterances.
+//
+//  archive: HTKFeatureArchiveHeader
+//           HTKFeatureArchiveEntry -- for each utterance, in the order of the script file
+//           UTF-8 names of the utterances (padded)
+//           frames of each utterance, 'dimension' floats per frame, each utterance aligned to 64 bytes
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MemoryMappedFile.h"
+#include "UtteranceDescription.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class HTKFeatureArchive;
+struct HTKFeatureArchiveEntry;
+typedef std::shared_ptr<HTKFeatureArchive> HTKFeatureArchivePtr;
+
+class HTKFeatureArchive
+{
+public:
+    // Maps the archive, or returns the mapping another deserializer of the process already has.
+    // Returns nullptr if the file is not a valid archive.
+    static HTKFeatureArchivePtr Open(const std::wstring& path);
+
+    // Writes the features of the utterances to the archive, reading them with htkfeatreader.
+    // The archive is written under a temporary name first, so that an interrupted write is never mistaken for a valid archive.
+    static void Write(const std::wstring& path, const std::vector<UtteranceDescription>& utterances);
+
+    size_t GetNumberOfUtterances() const
+    {
+        return m_numberOfUtterances;
+    }
+
+    // Whether the utterance of the archive has the given name and number of frames.
+    bool Matches(size_t utterance, const std::string& name, size_t numberOfFrames) const;
+
+    size_t GetNumberOfFrames(size_t utterance) const;
+
+    // Frames of the utterance, GetDimension() floats per frame.
+    const float* GetFrames(size_t utterance) const;
+
+    size_t GetDimension() const { return m_dimension; }
+    const std::string& GetFeatureKind() const { return m_featureKind; }
+    unsigned int GetSamplePeriod() const { return m_samplePeriod; }
+
+    // Hints that the frames of the utterances [first, last] will be read soon.
+    void WillNeed(size_t first, size_t last) const;
+
+    DISABLE_COPY_AND_MOVE(HTKFeatureArchive);
+
+private:
+    HTKFeatureArchive(MemoryMappedFilePtr file);
+
+    // Checks the header and the table against the size of the file.
+    bool IsValid() const;
+
+    const HTKFeatureArchiveEntry* GetEntry(size_t utterance) const;
+
+    MemoryMappedFilePtr m_file;
+    size_t m_numberOfUtterances;
+    size_t m_dimension;
+    std::string m_featureKind;
+    unsigned int m_samplePeriod;
+    const char* m_names;
+};
+
+}}}
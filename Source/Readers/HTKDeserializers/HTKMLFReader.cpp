@@ -109,11 +109,17 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
     auto bundler = std::make_shared<Bundler>(readerConfig, deserializers[0], deserializers, cleanse);
     int verbosity = readerConfig(L"verbosity", 0);
     std::wstring readMethod = config.GetRandomizer();
+    size_t lengthBucketSize = 0;
 
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
-        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */);
+        // Number of chunks read ahead in the background, to hide the latency of slow storage at chunk boundaries.
+        size_t maxPrefetchedChunks = readerConfig(L"maxPrefetchedChunks", (size_t)1);
+        // Groups utterances of similar length into buckets of this many frames, to reduce padding in sequence mode.
+        lengthBucketSize = readerConfig(L"lengthBucketSize", (size_t)0);
+        m_randomizer = std::make_shared<BlockRandomizer>(verbosity, window, bundler, true  /* should Prefetch */, BlockRandomizer::DecimationMode::chunk, true /* useLegacyRandomization */,
+                                                         false /* multithreadedGetNextSequences */, maxPrefetchedChunks, lengthBucketSize);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -155,7 +161,7 @@ HTKMLFReader::HTKMLFReader(MemoryProviderPtr provider,
         m_packer = std::make_shared<FramePacker>(m_provider, m_randomizer, m_streams);
         break;
     case PackingMode::sequence:
-        m_packer = std::make_shared<SequencePacker>(m_provider, m_randomizer, m_streams);
+        m_packer = std::make_shared<SequencePacker>(m_provider, m_randomizer, m_streams, lengthBucketSize > 0 /* packLongestFirst */);
         break;
     case PackingMode::truncated:
         m_packer = std::make_shared<TruncatedBPTTPacker>(m_provider, m_randomizer, m_streams);
@@ -219,4 +225,13 @@ Minibatch HTKMLFReader::ReadMinibatch()
     return m_packer->ReadMinibatch();
 }
 
+void HTKMLFReader::SetMemoryProvider(MemoryProviderPtr provider)
+{
+    m_provider = provider;
+    if (m_packer)
+    {
+        m_packer->SetMemoryProvider(provider);
+    }
+}
+
 }}}
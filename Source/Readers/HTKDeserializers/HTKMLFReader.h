@@ -32,6 +32,9 @@ public:
     // Reads a single minibatch.
     Minibatch ReadMinibatch() override;
 
+    // Sets the memory provider of the minibatch buffers.
+    void SetMemoryProvider(MemoryProviderPtr provider) override;
+
 private:
     enum class PackingMode
     {
@@ -0,0 +1,190 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "LatticeDeserializer.h"
+#include "ConfigHelper.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// Sequence of a single lattice pair.
+struct LatticeSequenceData : ObjectSequenceData
+{
+    LatticeSequenceData(shared_ptr<const msra::dbn::latticepair> lattice, const TensorShapePtr& layout)
+    {
+        m_object = lattice;
+        m_numberOfSamples = (uint32_t)lattice->getnumframes();
+        m_sampleLayout = layout;
+    }
+};
+
+// The lattices of a chunk, read when the chunk is created.
+class LatticeDeserializer::LatticeChunk : public Chunk
+{
+    size_t m_firstLattice;
+    vector<shared_ptr<const msra::dbn::latticepair>> m_lattices;
+    TensorShapePtr m_layout;
+
+public:
+    LatticeChunk(LatticeDeserializer& parent, ChunkIdType chunkId)
+        : m_layout(parent.m_streams.front()->m_sampleLayout)
+    {
+        m_firstLattice = chunkId * parent.m_latticesPerChunk;
+        size_t end = min(m_firstLattice + parent.m_latticesPerChunk, parent.m_keys.size());
+
+        lock_guard<mutex> lock(parent.m_lock);
+        m_lattices.resize(end - m_firstLattice);
+        for (size_t i = m_firstLattice; i < end; ++i)
+        {
+            if (parent.m_numberOfFrames[i] == SIZE_MAX)
+            {
+                continue; // not used by the primary deserializer
+            }
+
+            parent.m_lattices->getlattices(parent.m_keys[i], m_lattices[i - m_firstLattice], parent.m_numberOfFrames[i]);
+        }
+    }
+
+    virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId >= m_firstLattice && sequenceId - m_firstLattice < m_lattices.size());
+        const auto& lattice = m_lattices[sequenceId - m_firstLattice];
+        if (!lattice)
+        {
+            LogicError("LatticeDeserializer: lattice %" PRIu64 " has not been requested by the primary deserializer.", sequenceId);
+        }
+
+        result.push_back(make_shared<LatticeSequenceData>(lattice, m_layout));
+    }
+};
+
+LatticeDeserializer::LatticeDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
+{
+    // The number of frames of the lattices is not known up front.
+    if (primary)
+    {
+        LogicError("Lattice deserializer does not support primary mode - it cannot control chunking.");
+    }
+
+    if ((bool)(ConfigValue)cfg("frameMode", "true"))
+    {
+        InvalidArgument("Lattice deserializer requires sequences, please set 'frameMode' to false.");
+    }
+
+    argvector<ConfigValue> inputs = cfg("input");
+    if (inputs.size() != 1)
+    {
+        LogicError("LatticeDeserializer supports a single input stream only.");
+    }
+
+    ConfigParameters input = inputs.front();
+    auto inputName = input.GetMemberIds().front();
+    ConfigParameters streamConfig = input(inputName);
+
+    m_latticesPerChunk = streamConfig(L"latticesPerChunk", (size_t)256);
+    if (m_latticesPerChunk == 0)
+    {
+        InvalidArgument("LatticeDeserializer: 'latticesPerChunk' must be positive.");
+    }
+
+    m_hset.loadfromfile(streamConfig(L"phoneFile"), streamConfig(L"labelMappingFile"), streamConfig(L"transPFile", L""));
+
+    vector<wstring> tocPaths;
+    expand_wildcards(streamConfig(L"denLatTocFile"), tocPaths);
+    wstring prefixPathInToc = streamConfig(L"prefixPathInToc", L"");
+    m_lattices.reset(new msra::dbn::latticesource(make_pair(vector<wstring>(), tocPaths), m_hset.getsymmap(), prefixPathInToc));
+    m_lattices->setverbosity(cfg(L"verbosity", 0));
+
+    ReadKeys(corpus, tocPaths);
+    m_numberOfFrames.resize(m_keys.size(), SIZE_MAX);
+
+    fprintf(stderr, "LatticeDeserializer::LatticeDeserializer: %" PRIu64 " lattices in %" PRIu64 " chunks\n",
+            m_keys.size(), (m_keys.size() + m_latticesPerChunk - 1) / m_latticesPerChunk);
+
+    // The stream carries one lattice pair per sequence, the sample layout is a placeholder.
+    StreamDescriptionPtr stream = make_shared<StreamDescription>();
+    stream->m_id = 0;
+    stream->m_name = inputName;
+    stream->m_sampleLayout = make_shared<TensorShape>(1);
+    stream->m_storageType = StorageType::dense;
+    stream->m_elementType = ElementType::tatom;
+    m_streams.push_back(stream);
+}
+
+// Reads the keys of the lattices in the order of the TOC files, i.e. in the order they were written to the archives,
+// so that a chunk is read from consecutive offsets.
+void LatticeDeserializer::ReadKeys(CorpusDescriptorPtr corpus, const vector<wstring>& tocPaths)
+{
+    auto& registry = corpus->GetStringRegistry();
+    for (const auto& tocPath : tocPaths)
+    {
+        vector<char> buffer;
+        auto lines = msra::files::fgetfilelines(tocPath, buffer, 3);
+        for (const char* line : lines)
+        {
+            const char* p = strchr(line, '=');
+            if (p == nullptr)
+            {
+                RuntimeError("LatticeDeserializer: invalid TOC line (no = sign): %s", line);
+            }
+
+            string key(line, p - line);
+            m_keyToLattice[registry[key]] = m_keys.size();
+            m_keys.push_back(msra::strfun::utf16(key));
+        }
+    }
+}
+
+bool LatticeDeserializer::GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& result)
+{
+    auto lattice = m_keyToLattice.find(primary.m_key.m_sequence);
+    if (lattice == m_keyToLattice.end())
+    {
+        return false;
+    }
+
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_numberOfFrames[lattice->second] = primary.m_numberOfSamples;
+    }
+
+    result.m_id = lattice->second;
+    result.m_chunkId = (ChunkIdType)(lattice->second / m_latticesPerChunk);
+    result.m_numberOfSamples = primary.m_numberOfSamples;
+    result.m_key = primary.m_key;
+    return true;
+}
+
+ChunkDescriptions LatticeDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    for (size_t begin = 0; begin < m_keys.size(); begin += m_latticesPerChunk)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = (ChunkIdType)result.size();
+        cd->m_numberOfSequences = min(m_latticesPerChunk, m_keys.size() - begin);
+        cd->m_numberOfSamples = 0; // frames are only known from the primary deserializer
+        result.push_back(cd);
+    }
+    return result;
+}
+
+void LatticeDeserializer::GetSequencesForChunk(ChunkIdType, vector<SequenceDescription>& result)
+{
+    UNUSED(result);
+    LogicError("Lattice deserializer does not support primary mode - it cannot control chunking.");
+}
+
+ChunkPtr LatticeDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    return make_shared<LatticeChunk>(*this, chunkId);
+}
+
+}}}
@@ -0,0 +1,71 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include "Config.h"
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "simplesenonehmm.h"
+#include "latticesource.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Provides the denominator lattices of utterances for sequence training, as a single stream of element type tatom.
+// Each sequence carries the lattice pair of an utterance (msra::dbn::latticepair) and spans the frames of the utterance,
+// so that the lattices are randomized together with the features and labels they belong to.
+// The lattices of consecutive utterances of the TOC files are grouped into chunks, which are loaded when the randomizer needs them.
+// Cannot be used in primary mode, the number of frames of a lattice is only known from the TOC after it has been read.
+// Config:
+//     input = [ lattices = [
+//         denLatTocFile = TOC files of the archives, wildcards are expanded
+//         prefixPathInToc = prefix of the archive paths in the TOC files (optional)
+//         latticesPerChunk = number of lattices of a chunk (default 256)
+//         phoneFile, labelMappingFile, transPFile = the HMM the lattices are mapped to
+//         labels = the stream whose classes are the senone ids of the frames (default "labels"), used by the reader
+//     ] ]
+class LatticeDeserializer : public DataDeserializerBase
+{
+public:
+    LatticeDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary);
+
+    // Takes the number of frames of the lattice from the primary sequence, it is checked when the lattice is read.
+    virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& result) override;
+
+    // Gets description of all chunks.
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    // Get sequence descriptions of a particular chunk.
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& s) override;
+
+    // Reads the lattices of a chunk.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+private:
+    class LatticeChunk;
+    DISABLE_COPY_AND_MOVE(LatticeDeserializer);
+
+    void ReadKeys(CorpusDescriptorPtr corpus, const std::vector<std::wstring>& tocPaths);
+
+    // The HMM whose symbol map the lattices are mapped to.
+    msra::asr::simplesenonehmm m_hset;
+    std::unique_ptr<msra::dbn::latticesource> m_lattices;
+
+    // Keys of the lattices in the order of the TOC files, and the index of a lattice by its key id in the string registry.
+    std::vector<std::wstring> m_keys;
+    std::map<size_t, size_t> m_keyToLattice;
+
+    // Number of frames of each lattice, SIZE_MAX until its utterance has been seen in the primary deserializer.
+    std::vector<size_t> m_numberOfFrames;
+
+    size_t m_latticesPerChunk;
+
+    // The archive reads through a shared file handle.
+    std::mutex m_lock;
+};
+
+}}}
@@ -9,9 +9,6 @@
 #include <limits>
 #include "MLFDataDeserializer.h"
 #include "ConfigHelper.h"
-#include "../HTKMLFReader/htkfeatio.h"
-#include "../HTKMLFReader/msra_mgram.h"
-#include "latticearchive.h"
 
 #undef max // max is defined in minwindef.h
 
@@ -37,12 +34,6 @@ public:
     }
 };
 
-// Inner class for an utterance.
-struct MLFUtterance : SequenceDescription
-{
-    size_t m_sequenceStart;
-};
-
 MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& cfg, bool primary)
 {
     // TODO: This should be read in one place, potentially given by SGD.
@@ -69,7 +60,8 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     size_t dimension = config.GetLabelDimension();
 
     wstring labelMappingFile = streamConfig(L"labelMappingFile", L"");
-    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension);
+    wstring mlfCache = streamConfig(L"mlfCache", L"");
+    InitializeChunkDescriptions(corpus, config, labelMappingFile, mlfCache, dimension);
     InitializeStream(inputName, dimension);
 }
 
@@ -92,109 +84,29 @@ MLFDataDeserializer::MLFDataDeserializer(CorpusDescriptorPtr corpus, const Confi
     }
 
     wstring labelMappingFile = labelConfig(L"labelMappingFile", L"");
-    InitializeChunkDescriptions(corpus, config, labelMappingFile, dimension);
+    wstring mlfCache = labelConfig(L"mlfCache", L"");
+    InitializeChunkDescriptions(corpus, config, labelMappingFile, mlfCache, dimension);
     InitializeStream(name, dimension);
 }
 
 // Currently we create a single chunk only.
-void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath, size_t dimension)
+void MLFDataDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const wstring& stateListPath,
+                                                      const wstring& cacheFile, size_t dimension)
 {
     // TODO: Similarly to the old reader, currently we assume all Mlfs will have same root name (key)
     // restrict MLF reader to these files--will make stuff much faster without having to use shortened input files
-
-    // TODO: currently we do not use symbol and word tables.
-    const msra::lm::CSymbolSet* wordTable = nullptr;
-    unordered_map<const char*, int>* symbolTable = nullptr;
     vector<wstring> mlfPaths = config.GetMlfPaths();
 
-    // TODO: Currently we still use the old IO module. This will be refactored later.
-    const double htkTimeToFrame = 100000.0; // default is 10ms
-    msra::asr::htkmlfreader<msra::asr::htkmlfentry, msra::lattices::lattice::htkmlfwordsequence> labels(mlfPaths, set<wstring>(), stateListPath, wordTable, symbolTable, htkTimeToFrame);
-
-    // Make sure 'msra::asr::htkmlfreader' type has a move constructor
-    static_assert(
-        is_move_constructible<
-        msra::asr::htkmlfreader<msra::asr::htkmlfentry,
-        msra::lattices::lattice::htkmlfwordsequence >> ::value,
-        "Type 'msra::asr::htkmlfreader' should be move constructible!");
-
     m_elementType = config.GetElementType();
 
-    MLFUtterance description;
-    size_t numClasses = 0;
-    size_t totalFrames = 0;
-
-    const auto& stringRegistry = corpus->GetStringRegistry();
-
-    // TODO resize m_keyToSequence with number of IDs from string registry
-
-    for (const auto& l : labels)
-    {
-        // Currently the string registry contains only utterances described in scp.
-        // So here we skip all others.
-        size_t id = 0;
-        if (!stringRegistry.TryGet(msra::strfun::utf8(l.first), id))
-            continue;
-
-        description.m_key.m_sequence = id;
-
-        const auto& utterance = l.second;
-        description.m_sequenceStart = m_classIds.size();
-        uint32_t numberOfFrames = 0;
-
-        foreach_index(i, utterance)
-        {
-            const auto& timespan = utterance[i];
-            if ((i == 0 && timespan.firstframe != 0) ||
-                (i > 0 && utterance[i - 1].firstframe + utterance[i - 1].numframes != timespan.firstframe))
-            {
-                RuntimeError("Labels are not in the consecutive order MLF in label set: %ls", l.first.c_str());
-            }
-
-            if (timespan.classid >= dimension)
-            {
-                RuntimeError("Class id %d exceeds the model output dimension %d.", (int)timespan.classid, (int)dimension);
-            }
-
-            if (timespan.classid != static_cast<msra::dbn::CLASSIDTYPE>(timespan.classid))
-            {
-                RuntimeError("CLASSIDTYPE has too few bits");
-            }
-
-            if (SEQUENCELEN_MAX < timespan.firstframe + timespan.numframes)
-            {
-                RuntimeError("Maximum number of sample per sequence exceeded.");
-            }
-
-            numClasses = max(numClasses, (size_t)(1u + timespan.classid));
-
-            for (size_t t = timespan.firstframe; t < timespan.firstframe + timespan.numframes; t++)
-            {
-                m_classIds.push_back(timespan.classid);
-                numberOfFrames++;
-            }
-        }
-
-        description.m_numberOfSamples = numberOfFrames;
-        m_utteranceIndex.push_back(totalFrames);
-        totalFrames += numberOfFrames;
-
-        if (m_keyToSequence.size() <= description.m_key.m_sequence)
-        {
-            m_keyToSequence.resize(description.m_key.m_sequence + 1, SIZE_MAX);
-        }
-        assert(m_keyToSequence[description.m_key.m_sequence] == SIZE_MAX);
-        m_keyToSequence[description.m_key.m_sequence] = m_utteranceIndex.size() - 1;
-        m_numberOfSequences++;
-    }
-    m_utteranceIndex.push_back(totalFrames);
-
-    m_totalNumberOfFrames = totalFrames;
+    const double htkTimeToFrame = 100000.0; // default is 10ms
+    m_labels.reset(new MLFLabelStore(corpus->GetStringRegistry(), dimension));
+    m_labels->Read(mlfPaths, stateListPath, htkTimeToFrame, cacheFile);
 
     fprintf(stderr, "MLFDataDeserializer::MLFDataDeserializer: %" PRIu64 " utterances with %" PRIu64 " frames in %" PRIu64 " classes\n",
-            m_numberOfSequences,
-            m_totalNumberOfFrames,
-            numClasses);
+            m_labels->GetNumberOfUtterances(),
+            m_labels->GetTotalNumberOfFrames(),
+            m_labels->GetNumberOfClasses());
 
     // Initializing array of labels.
     m_categories.reserve(dimension);
@@ -242,8 +154,8 @@ ChunkDescriptions MLFDataDeserializer::GetChunkDescriptions()
 {
     auto cd = make_shared<ChunkDescription>();
     cd->m_id = 0;
-    cd->m_numberOfSequences = m_frameMode ? m_totalNumberOfFrames : m_numberOfSequences;
-    cd->m_numberOfSamples = m_totalNumberOfFrames;
+    cd->m_numberOfSequences = m_frameMode ? m_labels->GetTotalNumberOfFrames() : m_labels->GetNumberOfUtterances();
+    cd->m_numberOfSamples = m_labels->GetTotalNumberOfFrames();
     return ChunkDescriptions{cd};
 }
 
@@ -291,15 +203,14 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
 {
     if (m_frameMode)
     {
-        size_t label = m_classIds[sequenceId];
+        size_t label = m_labels->GetClassIdOfRun(sequenceId);
         assert(label < m_categories.size());
         result.push_back(m_categories[label]);
     }
     else
     {
         // Packing labels for the utterance into sparse sequence.
-        size_t startFrameIndex = m_utteranceIndex[sequenceId];
-        size_t numberOfSamples = m_utteranceIndex[sequenceId + 1] - startFrameIndex;
+        size_t numberOfSamples = m_labels->GetNumberOfFrames(sequenceId);
         SparseSequenceDataPtr s;
         if (m_elementType == ElementType::tfloat)
         {
@@ -311,22 +222,15 @@ void MLFDataDeserializer::GetSequenceById(size_t sequenceId, vector<SequenceData
             s = make_shared<MLFSequenceData<double>>(numberOfSamples);
         }
 
-        for (size_t i = 0; i < numberOfSamples; i++)
-        {
-            size_t frameIndex = startFrameIndex + i;
-            size_t label = m_classIds[frameIndex];
-            s->m_indices[i] = static_cast<IndexType>(label);
-        }
+        m_labels->GetClassIds(sequenceId, s->m_indices);
         result.push_back(s);
     }
 }
 
 bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
 {
-
-    auto sequenceId = key.m_sequence < m_keyToSequence.size() ? m_keyToSequence[key.m_sequence] : SIZE_MAX;
-
-    if (sequenceId == SIZE_MAX)
+    size_t sequenceId = 0;
+    if (!m_labels->TryGetUtterance(key.m_sequence, sequenceId))
     {
         return false;
     }
@@ -336,15 +240,14 @@ bool MLFDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, Sequen
 
     if (m_frameMode)
     {
-        size_t index = m_utteranceIndex[sequenceId] + key.m_sample;
-        result.m_id = index;
+        result.m_id = m_labels->GetRunIndex(sequenceId, key.m_sample);
         result.m_numberOfSamples = 1;
     }
     else
     {
         assert(result.m_key.m_sample == 0);
         result.m_id = sequenceId;
-        result.m_numberOfSamples = (uint32_t) (m_utteranceIndex[sequenceId + 1] - m_utteranceIndex[sequenceId]);
+        result.m_numberOfSamples = (uint32_t)m_labels->GetNumberOfFrames(sequenceId);
     }
     return true;
 }
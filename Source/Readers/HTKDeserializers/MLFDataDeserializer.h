@@ -7,13 +7,15 @@
 
 #include "DataDeserializer.h"
 #include "HTKDataDeserializer.h"
-#include "../HTKMLFReader/biggrowablevectors.h"
 #include "CorpusDescriptor.h"
+#include "MLFLabelStore.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // Class represents an MLF deserializer.
 // Provides a set of chunks/sequences to the upper layers.
+// Config:
+//     mlfCache = path of a binary copy of the parsed labels, written if it is missing or older than the MLF files
 class MLFDataDeserializer : public DataDeserializerBase
 {
 public:
@@ -41,31 +43,19 @@ private:
     class MLFChunk;
     DISABLE_COPY_AND_MOVE(MLFDataDeserializer);
 
-    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath, size_t dimension);
+    void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath,
+                                     const std::wstring& cacheFile, size_t dimension);
     void InitializeStream(const std::wstring& name, size_t dimension);
 
     void GetSequenceById(size_t sequenceId, std::vector<SequenceDataPtr>& result);
 
-    // Vector that maps KeyType.m_sequence into an utterance ID (or SIZE_MAX if the key is not assigned).
-    // This assumes that IDs introduced by the corpus are dense (which they right now, depending on the number of invalid / filtered sequences).
-    // TODO compare perf to map we had before.
-    std::vector<size_t> m_keyToSequence;
-
-    // Number of sequences
-    size_t m_numberOfSequences = 0;
-
-    // Array of all labels.
-    msra::dbn::biggrowablevector<msra::dbn::CLASSIDTYPE> m_classIds;
-
-    // Index of utterances in the m_classIds.
-    msra::dbn::biggrowablevector<size_t> m_utteranceIndex;
+    // Labels of all utterances, as runs of frames of the same class.
+    // In frame mode, the id of a sequence is the index of the run of its frame.
+    std::unique_ptr<MLFLabelStore> m_labels;
 
     // Type of the data this serializer provides.
     ElementType m_elementType;
 
-    // Total number of frames.
-    size_t m_totalNumberOfFrames;
-
     // Array of available categories.
     // We do no allocate data for all input sequences, only returning a pointer to existing category.
     std::vector<SparseSequenceDataPtr> m_categories;
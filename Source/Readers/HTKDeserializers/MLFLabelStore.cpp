@@ -0,0 +1,518 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <cstring>
+#include "MLFLabelStore.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+static const uint32_t c_mlfCacheMagic = 0x464C4D43; // "CMLF"
+static const uint32_t c_mlfCacheVersion = 1;
+static const size_t c_mlfCacheAlignment = 8;
+
+struct MLFCacheHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    double m_htkTimeToFrame;
+    uint64_t m_numberOfUtterances;
+    uint64_t m_sourcesLength; // in bytes
+};
+
+struct MLFCacheRecord
+{
+    uint32_t m_nameLength; // in bytes
+    uint32_t m_numberOfRuns;
+    uint32_t m_numberOfFrames;
+    uint32_t m_reserved;
+};
+
+static size_t AlignMLFCache(size_t size)
+{
+    return (size + c_mlfCacheAlignment - 1) / c_mlfCacheAlignment * c_mlfCacheAlignment;
+}
+
+// Reads the non-empty lines of a file through a large buffer. A line is valid until the next one is read.
+class MLFLineReader
+{
+public:
+    MLFLineReader(const wstring& path)
+        : m_file(fopenOrDie(path, L"rbS")), m_buffer(1024 * 1024), m_begin(0), m_end(0), m_endOfFile(false)
+    {
+    }
+
+    ~MLFLineReader()
+    {
+        fclose(m_file);
+    }
+
+    // Returns the next line without the line break, or nullptr at the end of the file.
+    char* Next()
+    {
+        for (;;)
+        {
+            char* data = m_buffer.data();
+            char* lineEnd = static_cast<char*>(memchr(data + m_begin, '\n', m_end - m_begin));
+            if (!lineEnd)
+            {
+                if (!m_endOfFile)
+                {
+                    Fill();
+                    continue;
+                }
+                if (m_begin == m_end)
+                {
+                    return nullptr;
+                }
+                lineEnd = data + m_end; // the last line has no line break, there is always a spare byte
+            }
+
+            char* line = data + m_begin;
+            size_t length = lineEnd - line;
+            m_begin = min(m_begin + length + 1, m_end);
+            while (length > 0 && line[length - 1] == '\r')
+            {
+                length--;
+            }
+            line[length] = 0;
+            if (length > 0)
+            {
+                return line;
+            }
+        }
+    }
+
+private:
+    void Fill()
+    {
+        // Keeping the partial line at the start of the buffer, the buffer grows for lines longer than it.
+        size_t remaining = m_end - m_begin;
+        memmove(m_buffer.data(), m_buffer.data() + m_begin, remaining);
+        m_begin = 0;
+        m_end = remaining;
+        if (m_end + 1 >= m_buffer.size())
+        {
+            m_buffer.resize(m_buffer.size() * 2);
+        }
+
+        size_t requested = m_buffer.size() - 1 - m_end;
+        size_t read = fread(m_buffer.data() + m_end, 1, requested, m_file);
+        if (ferror(m_file))
+        {
+            RuntimeError("Error reading from file: %s", strerror(errno));
+        }
+        m_end += read;
+        m_endOfFile = read < requested;
+    }
+
+    FILE* m_file;
+    vector<char> m_buffer;
+    size_t m_begin;
+    size_t m_end;
+    bool m_endOfFile;
+};
+
+// Splits a line into tokens separated by blanks or tabs, the line is modified.
+static void Tokenize(char* line, vector<char*>& tokens)
+{
+    tokens.clear();
+    char* context = nullptr;
+    for (char* token = strtok_s(line, " \t", &context); token; token = strtok_s(nullptr, " \t", &context))
+    {
+        tokens.push_back(token);
+    }
+}
+
+static unordered_map<string, uint32_t> ReadStateList(const wstring& path)
+{
+    unordered_map<string, uint32_t> result;
+    if (path.empty())
+    {
+        return result;
+    }
+
+    MLFLineReader reader(path);
+    uint32_t index = 0;
+    for (char* line = reader.Next(); line; line = reader.Next(), index++)
+    {
+        if (!result.insert(make_pair(string(line), index)).second)
+        {
+            RuntimeError("MLFLabelStore: Duplicate state '%s' in the state list '%ls'.", line, path.c_str());
+        }
+    }
+    fprintf(stderr, "MLFLabelStore: %" PRIu64 " state names in state list '%ls'.\n", result.size(), path.c_str());
+    return result;
+}
+
+// Gets the utterance name of an entry line as "*/name.ext", returns false if the line is not a quoted name.
+static bool TryParseName(const char* line, string& name)
+{
+    size_t length = strlen(line);
+    if (length < 3 || line[0] != '"' || line[length - 1] != '"')
+    {
+        return false;
+    }
+
+    name.assign(line + 1, length - 2);
+    if (name.compare(0, 2, "*/") == 0)
+    {
+        name.erase(0, 2);
+    }
+
+    // Deleting the extension, if there is one.
+    size_t separator = name.find_last_of(".\\/:");
+    if (separator != string::npos && name[separator] == '.')
+    {
+        name.erase(separator);
+    }
+    return true;
+}
+
+static void WriteCache(FILE*& cache, const wstring& cacheFile, const void* data, size_t size)
+{
+    static const char zeros[c_mlfCacheAlignment] = {};
+    if (!cache)
+    {
+        return;
+    }
+
+    try
+    {
+        if (size > 0)
+        {
+            fwriteOrDie(data, 1, size, cache);
+        }
+        fwriteOrDie(zeros, 1, AlignMLFCache(size) - size, cache);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not save the label cache '%ls': %s\n", cacheFile.c_str(), e.what());
+        fclose(cache);
+        cache = nullptr;
+    }
+}
+
+MLFLabelStore::MLFLabelStore(const StringToIdMap& keys, size_t dimension)
+    : m_registry(keys), m_dimension(dimension), m_numberOfClasses(0)
+{
+    m_runBegin.push_back(0);
+    m_frameBegin.push_back(0);
+}
+
+void MLFLabelStore::AddUtterance(const string& name, const vector<Run>& runs, size_t numberOfFrames)
+{
+    // Currently the string registry contains only utterances described in scp, all others are skipped.
+    size_t key = 0;
+    if (!m_registry.TryGet(name, key))
+    {
+        return;
+    }
+
+    if (m_keyToUtterance.size() <= key)
+    {
+        m_keyToUtterance.resize(key + 1, SIZE_MAX);
+    }
+    if (m_keyToUtterance[key] != SIZE_MAX)
+    {
+        RuntimeError("MLFLabelStore: Duplicate entry '%s'.", name.c_str());
+    }
+    m_keyToUtterance[key] = GetNumberOfUtterances();
+
+    for (const auto& run : runs)
+    {
+        if (run.m_classId >= m_dimension)
+        {
+            RuntimeError("Class id %d exceeds the model output dimension %d.", (int)run.m_classId, (int)m_dimension);
+        }
+        m_numberOfClasses = max(m_numberOfClasses, (size_t)run.m_classId + 1);
+    }
+
+    m_runs.insert(m_runs.end(), runs.begin(), runs.end());
+    m_runBegin.push_back(m_runs.size());
+    m_frameBegin.push_back(m_frameBegin.back() + numberOfFrames);
+}
+
+void MLFLabelStore::Read(const vector<wstring>& mlfPaths, const wstring& stateListPath, double htkTimeToFrame, const wstring& cacheFile)
+{
+    // The cache is valid for the same sources only.
+    string sources;
+    for (const auto& path : mlfPaths)
+    {
+        sources += msra::strfun::utf8(path) + "\n";
+    }
+    sources += msra::strfun::utf8(stateListPath);
+
+    bool upToDate = !cacheFile.empty() && msra::files::fuptodate(cacheFile, stateListPath, false);
+    for (const auto& path : mlfPaths)
+    {
+        upToDate = upToDate && msra::files::fuptodate(cacheFile, path);
+    }
+    if (upToDate && TryReadCache(cacheFile, sources, htkTimeToFrame))
+    {
+        return;
+    }
+
+    auto stateList = ReadStateList(stateListPath);
+
+    // Written under a temporary name first, so that an interrupted write is never mistaken for a valid cache.
+    wstring tempFile = cacheFile + L".tmp";
+    FILE* cache = nullptr;
+    MLFCacheHeader header = {};
+    header.m_magic = c_mlfCacheMagic;
+    header.m_version = c_mlfCacheVersion;
+    header.m_htkTimeToFrame = htkTimeToFrame;
+    header.m_sourcesLength = sources.size();
+    if (!cacheFile.empty())
+    {
+        try
+        {
+            cache = fopenOrDie(tempFile, L"wbS");
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "WARNING: Could not save the label cache '%ls': %s\n", cacheFile.c_str(), e.what());
+        }
+        WriteCache(cache, cacheFile, &header, sizeof(header));
+        WriteCache(cache, cacheFile, sources.data(), sources.size());
+    }
+
+    for (const auto& path : mlfPaths)
+    {
+        ReadMLF(path, stateList, htkTimeToFrame, cacheFile, cache, header.m_numberOfUtterances);
+    }
+
+    if (cache)
+    {
+        try
+        {
+            fsetpos(cache, (uint64_t)0);
+            fwriteOrDie(&header, sizeof(header), 1, cache);
+            fcloseOrDie(cache);
+            renameOrDie(tempFile, cacheFile);
+            fprintf(stderr, "MLFLabelStore: Saved the labels of %" PRIu64 " utterances to '%ls'.\n", header.m_numberOfUtterances, cacheFile.c_str());
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "WARNING: Could not save the label cache '%ls': %s\n", cacheFile.c_str(), e.what());
+        }
+    }
+}
+
+void MLFLabelStore::ReadMLF(const wstring& path, const unordered_map<string, uint32_t>& stateList, double htkTimeToFrame,
+                            const wstring& cacheFile, FILE*& cache, uint64_t& cachedUtterances)
+{
+    fprintf(stderr, "MLFLabelStore: reading MLF file '%ls'\n", path.c_str());
+
+    MLFLineReader reader(path);
+    char* line = reader.Next();
+    if (!line || strcmp(line, "#!MLF!#") != 0)
+    {
+        RuntimeError("MLFLabelStore: Header missing in '%ls'.", path.c_str());
+    }
+
+    // If the frame number is greater than this, it is a time instead of a frame.
+    const double maxFrameNumber = htkTimeToFrame / 2.0;
+    string name;
+    vector<Run> runs;
+    vector<char*> tokens;
+    size_t entries = 0;
+    while ((line = reader.Next()) != nullptr)
+    {
+        // Embedded duplicate MLF headers are skipped, so that MLF files can be concatenated.
+        if (strcmp(line, "#!MLF!#") == 0)
+        {
+            continue;
+        }
+
+        // Some MLF files have write errors, malformed entries are skipped.
+        bool valid = TryParseName(line, name);
+        if (!valid)
+        {
+            fprintf(stderr, "WARNING: MLFLabelStore: Skipping the entry with malformed name '%s' in '%ls'.\n", line, path.c_str());
+        }
+
+        runs.clear();
+        size_t numberOfFrames = 0;
+        for (;;)
+        {
+            line = reader.Next();
+            if (!line)
+            {
+                RuntimeError("MLFLabelStore: Unexpected end in mid-utterance in '%ls'.", path.c_str());
+            }
+            if (line[0] == '.' && line[1] == 0)
+            {
+                break;
+            }
+            if (!valid)
+            {
+                continue;
+            }
+
+            // The format is "start end state ..." with the state list, or "start end state id" without it.
+            Tokenize(line, tokens);
+            size_t classId = 0;
+            if (!stateList.empty())
+            {
+                if (tokens.size() < 3)
+                {
+                    RuntimeError("MLFLabelStore: Malformed label of '%s' in '%ls'.", name.c_str(), path.c_str());
+                }
+                auto state = stateList.find(tokens[2]);
+                if (state == stateList.end())
+                {
+                    RuntimeError("MLFLabelStore: State %s not found in the state list.", tokens[2]);
+                }
+                classId = state->second;
+            }
+            else
+            {
+                if (tokens.size() != 4)
+                {
+                    RuntimeError("MLFLabelStore: Currently only the 4-column format is supported, in '%s' in '%ls'.", name.c_str(), path.c_str());
+                }
+                classId = msra::strfun::toint(tokens[3]);
+            }
+
+            double start = msra::strfun::todouble(tokens[0]);
+            double end = msra::strfun::todouble(tokens[1]);
+            size_t firstFrame, endFrame;
+            if (end > maxFrameNumber)
+            {
+                firstFrame = (size_t)(start / htkTimeToFrame + 0.5);
+                endFrame = (size_t)(end / htkTimeToFrame + 0.5);
+            }
+            else
+            {
+                firstFrame = (size_t)start;
+                endFrame = (size_t)end;
+            }
+
+            if (firstFrame != numberOfFrames || endFrame < firstFrame)
+            {
+                RuntimeError("Labels are not in the consecutive order MLF in label set: %s", name.c_str());
+            }
+            if (SEQUENCELEN_MAX < endFrame)
+            {
+                RuntimeError("Maximum number of sample per sequence exceeded.");
+            }
+
+            // Consecutive labels of the same class are joined.
+            if (endFrame > firstFrame && (runs.empty() || runs.back().m_classId != classId))
+            {
+                runs.push_back(Run{ (uint32_t)firstFrame, (uint32_t)classId });
+            }
+            numberOfFrames = endFrame;
+        }
+
+        if (!valid)
+        {
+            continue;
+        }
+
+        AddUtterance(name, runs, numberOfFrames);
+        entries++;
+        if (cache)
+        {
+            MLFCacheRecord record = {};
+            record.m_nameLength = (uint32_t)name.size();
+            record.m_numberOfRuns = (uint32_t)runs.size();
+            record.m_numberOfFrames = (uint32_t)numberOfFrames;
+            WriteCache(cache, cacheFile, &record, sizeof(record));
+            WriteCache(cache, cacheFile, name.data(), name.size());
+            WriteCache(cache, cacheFile, runs.data(), runs.size() * sizeof(Run));
+            cachedUtterances++;
+        }
+    }
+
+    fprintf(stderr, "MLFLabelStore: %" PRIu64 " entries in '%ls'\n", entries, path.c_str());
+}
+
+bool MLFLabelStore::TryReadCache(const wstring& cacheFile, const string& sources, double htkTimeToFrame)
+{
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(cacheFile, L"rbS");
+        MLFCacheHeader header;
+        freadOrDie(&header, sizeof(header), 1, f);
+        string cachedSources(AlignMLFCache(header.m_sourcesLength), '\0');
+        if (header.m_magic == c_mlfCacheMagic && header.m_version == c_mlfCacheVersion &&
+            header.m_htkTimeToFrame == htkTimeToFrame && header.m_sourcesLength == sources.size())
+        {
+            freadOrDie(&cachedSources[0], 1, cachedSources.size(), f);
+            cachedSources.resize(sources.size());
+        }
+        if (cachedSources != sources)
+        {
+            fclose(f);
+            return false;
+        }
+
+        string name;
+        vector<Run> runs;
+        for (uint64_t i = 0; i < header.m_numberOfUtterances; ++i)
+        {
+            MLFCacheRecord record;
+            freadOrDie(&record, sizeof(record), 1, f);
+            name.resize(AlignMLFCache(record.m_nameLength));
+            runs.resize(record.m_numberOfRuns);
+            freadOrDie(&name[0], 1, name.size(), f);
+            name.resize(record.m_nameLength);
+            if (!runs.empty())
+            {
+                freadOrDie(runs.data(), sizeof(Run), runs.size(), f);
+            }
+            AddUtterance(name, runs, record.m_numberOfFrames);
+        }
+        fclose(f);
+
+        fprintf(stderr, "MLFLabelStore: Loaded the labels of %" PRIu64 " utterances from '%ls'.\n", GetNumberOfUtterances(), cacheFile.c_str());
+        return true;
+    }
+    catch (const exception& e)
+    {
+        if (f)
+        {
+            fclose(f);
+        }
+        fprintf(stderr, "WARNING: Ignoring the label cache '%ls': %s\n", cacheFile.c_str(), e.what());
+
+        m_runs.clear();
+        m_runBegin.resize(1);
+        m_frameBegin.resize(1);
+        m_keyToUtterance.clear();
+        m_numberOfClasses = 0;
+        return false;
+    }
+}
+
+size_t MLFLabelStore::GetRunIndex(size_t utterance, size_t frame) const
+{
+    assert(frame < GetNumberOfFrames(utterance));
+    auto begin = m_runs.begin() + m_runBegin[utterance];
+    auto end = m_runs.begin() + m_runBegin[utterance + 1];
+    auto run = upper_bound(begin, end, frame, [](size_t f, const Run& r) { return f < r.m_firstFrame; });
+    return run - 1 - m_runs.begin();
+}
+
+void MLFLabelStore::GetClassIds(size_t utterance, IndexType* classIds) const
+{
+    size_t numberOfFrames = GetNumberOfFrames(utterance);
+    for (size_t i = m_runBegin[utterance]; i < m_runBegin[utterance + 1]; ++i)
+    {
+        size_t end = i + 1 < m_runBegin[utterance + 1] ? m_runs[i + 1].m_firstFrame : numberOfFrames;
+        fill(classIds + m_runs[i].m_firstFrame, classIds + end, static_cast<IndexType>(m_runs[i].m_classId));
+    }
+}
+
+}}}
@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MLFLabelStore.h -- labels of the utterances of MLF files, kept as runs of frames with the same class id.
+//
+// The MLF files are parsed a line at a time straight into the runs, and only utterances with a name in the
+// string registry of the corpus are kept. All utterances can also be written to a cache file while parsing,
+// and the cache is read instead of the MLF files as long as it is newer than them.
+//
+//  cache:   MLFCacheHeader
+//           names of the MLF files and the state list (UTF-8, '\n' separated, padded)
+//           MLFCacheRecord, UTF-8 name of the utterance (padded), its runs -- for each utterance
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DataDeserializer.h"
+#include "StringToIdMap.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class MLFLabelStore
+{
+public:
+    // A run of frames with the same class id. The runs of an utterance are consecutive and cover all its frames.
+    struct Run
+    {
+        uint32_t m_firstFrame; // offset inside the utterance
+        uint32_t m_classId;
+    };
+
+    // Utterances are identified by their id in 'keys'; class ids have to be below 'dimension'.
+    MLFLabelStore(const StringToIdMap& keys, size_t dimension);
+
+    // Reads the labels from the MLF files, or from the cache file if it is up to date.
+    // The class ids are taken from the state list if it is given, otherwise from the 4th column of the MLF.
+    // If 'cacheFile' is not empty and cannot be used, it is written from the MLF files.
+    void Read(const std::vector<std::wstring>& mlfPaths, const std::wstring& stateListPath, double htkTimeToFrame, const std::wstring& cacheFile);
+
+    size_t GetNumberOfUtterances() const
+    {
+        return m_frameBegin.size() - 1;
+    }
+
+    size_t GetTotalNumberOfFrames() const
+    {
+        return m_frameBegin.back();
+    }
+
+    size_t GetNumberOfClasses() const
+    {
+        return m_numberOfClasses;
+    }
+
+    // Gets the utterance of a key of the string registry, returns false if the MLF has no labels for the key.
+    bool TryGetUtterance(size_t key, size_t& utterance) const
+    {
+        utterance = key < m_keyToUtterance.size() ? m_keyToUtterance[key] : SIZE_MAX;
+        return utterance != SIZE_MAX;
+    }
+
+    // Gets the number of frames of the utterance.
+    size_t GetNumberOfFrames(size_t utterance) const
+    {
+        return m_frameBegin[utterance + 1] - m_frameBegin[utterance];
+    }
+
+    // Gets the global index of the run that contains the frame of the utterance.
+    size_t GetRunIndex(size_t utterance, size_t frame) const;
+
+    // Gets the class id of a run by its global index.
+    size_t GetClassIdOfRun(size_t run) const
+    {
+        return m_runs[run].m_classId;
+    }
+
+    // Writes the class ids of all frames of the utterance to 'classIds', which has to hold GetNumberOfFrames of them.
+    void GetClassIds(size_t utterance, IndexType* classIds) const;
+
+private:
+    DISABLE_COPY_AND_MOVE(MLFLabelStore);
+
+    // Parses an MLF file, and appends all its utterances to the cache if it is open.
+    void ReadMLF(const std::wstring& path, const std::unordered_map<std::string, uint32_t>& stateList, double htkTimeToFrame,
+                 const std::wstring& cacheFile, FILE*& cache, uint64_t& cachedUtterances);
+
+    // Reads the labels from a cache written for the same sources, returns false if it cannot be used.
+    bool TryReadCache(const std::wstring& cacheFile, const std::string& sources, double htkTimeToFrame);
+
+    // Keeps the utterance if its name is registered.
+    void AddUtterance(const std::string& name, const std::vector<Run>& runs, size_t numberOfFrames);
+
+    const StringToIdMap& m_registry;
+    size_t m_dimension;
+    size_t m_numberOfClasses;
+
+    std::vector<Run> m_runs;
+    std::vector<size_t> m_runBegin;   // [utterance] index of the first run, followed by the number of runs
+    std::vector<size_t> m_frameBegin; // [utterance] number of frames before the utterance, followed by the total
+
+    // Maps the id of the string registry to the utterance, SIZE_MAX for keys without labels.
+    std::vector<size_t> m_keyToUtterance;
+};
+
+}}}
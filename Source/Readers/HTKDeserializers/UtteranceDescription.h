@@ -23,9 +23,12 @@ class UtteranceDescription
     // Expansion length in case if utterance should be expanded.
     size_t m_expansionLength;
 
+    // Index of the utterance in the feature archive, if the features are read from one.
+    size_t m_archiveIndex;
+
 public:
     UtteranceDescription(msra::asr::htkfeatreader::parsedpath&& path)
-        : m_path(std::move(path)), m_expansionLength(0)
+        : m_path(std::move(path)), m_expansionLength(0), m_archiveIndex(SIZE_MAX)
     {
     }
 
@@ -54,6 +57,9 @@ public:
 
     size_t GetExpansionLength() const { return m_expansionLength; }
     void SetExpansionLength(size_t length) { m_expansionLength = length; }
+
+    size_t GetArchiveIndex() const { return m_archiveIndex; }
+    void SetArchiveIndex(size_t index) { m_archiveIndex = index; }
 };
 
 }}}
@@ -24,6 +24,97 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Appends the utterances of an output to a single HTK file, in the order of their index, so that the archive and its
+// script file are the same for any number of writer threads. The archive is written under a temporary name and renamed
+// by Close(), with the number of frames in its header, so that an incomplete archive is not mistaken for a complete one.
+template <class ElemType>
+class HTKMLFWriter<ElemType>::OutputArchive
+{
+public:
+    OutputArchive(const wstring& path, const wstring& scpPath, size_t dim, unsigned int sampPeriod)
+        : m_path(path), m_dim(dim), m_numFrames(0), m_nextIndex(0)
+    {
+        msra::files::make_intermediate_dirs(path);
+        msra::files::make_intermediate_dirs(scpPath);
+        unlinkOrDie(path);
+        m_writer.reset(new msra::asr::htkfeatwriter(path + L"$$", "USER", dim, sampPeriod));
+        m_scp = fopenOrDie(scpPath, L"wb");
+    }
+
+    ~OutputArchive()
+    {
+        if (m_scp)
+            fcloseOrDie(m_scp);
+    }
+
+    // append the frames of the utterance 'index' (columns of 'frames'), after the utterances before it;
+    // a null 'frames' skips the index, so that a failed utterance does not block the ones after it
+    void Append(size_t index, const wstring& logicalPath, const msra::dbn::matrix* frames)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_appended.wait(lock, [&]() { return m_nextIndex == index; });
+        try
+        {
+            if (frames && frames->cols() > 0)
+            {
+                vector<float> frame(m_dim);
+                for (size_t j = 0; j < frames->cols(); j++)
+                {
+                    for (size_t i = 0; i < m_dim; i++)
+                        frame[i] = (*frames)(i, j);
+                    m_writer->write(frame);
+                }
+                fprintfOrDie(m_scp, "%ls=%ls[%d,%d]\n", logicalPath.c_str(), m_path.c_str(), (int) m_numFrames, (int) (m_numFrames + frames->cols() - 1));
+                m_numFrames += frames->cols();
+            }
+        }
+        catch (...)
+        {
+            Advance();
+            throw;
+        }
+        Advance();
+    }
+
+    // write the header and move the archive to its final name
+    void Close()
+    {
+        m_writer->close(m_numFrames);
+        m_writer.reset();
+        fcloseOrDie(m_scp);
+        m_scp = nullptr;
+        renameOrDie(m_path + L"$$", m_path);
+    }
+
+private:
+    // (caller must hold m_mutex)
+    void Advance()
+    {
+        m_nextIndex++;
+        m_appended.notify_all();
+    }
+
+    wstring m_path;
+    size_t m_dim;
+    unique_ptr<msra::asr::htkfeatwriter> m_writer;
+    FILE* m_scp;
+    size_t m_numFrames;
+    size_t m_nextIndex;
+    std::mutex m_mutex;
+    std::condition_variable m_appended;
+};
+
+template <class ElemType>
+HTKMLFWriter<ElemType>::HTKMLFWriter()
+    : m_tempArray(nullptr), m_tempArraySize(0)
+{
+}
+
+template <class ElemType>
+HTKMLFWriter<ElemType>::~HTKMLFWriter()
+{
+}
+
 // Create a Data Writer
 //DATAWRITER_API IDataWriter* DataWriterFactory(void)
 
@@ -38,6 +129,7 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
     vector<wstring> filelist;
     size_t numFiles;
     size_t firstfilesonly = SIZE_MAX; // set to a lower value for testing
+    vector<pair<wstring, wstring>> archives; // archive and its script file per output, empty if none
 
     vector<wstring> outputNames = writerConfig(L"outputNodeNames", ConfigRecordType::Array(stringargvector()));
     if (outputNames.size() < 1)
@@ -58,6 +150,15 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
         else
             RuntimeError("HTKMLFWriter::Init: writer needs to specify scpFile for output");
 
+        if (thisOutput.Exists("archiveFile"))
+        {
+            wstring archivePath = thisOutput(L"archiveFile");
+            wstring archiveScpPath = thisOutput(L"archiveScpFile", archivePath + L".scp");
+            archives.push_back(make_pair(archivePath, archiveScpPath));
+        }
+        else
+            archives.push_back(make_pair(wstring(), wstring()));
+
         outputNameToIdMap[outputNames[i]] = i;
         outputNameToDimMap[outputNames[i]] = udims[i];
         wstring type = thisOutput(L"type", "Real");
@@ -95,11 +196,57 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
     }
     outputFileIndex = 0;
     sampPeriod = 100000;
+
+    m_archives.clear();
+    foreach_index (i, archives)
+    {
+        if (archives[i].first.empty())
+            m_archives.push_back(nullptr);
+        else
+        {
+            fprintf(stderr, "HTKMLFWriter::Init: writing output %ls to archive %ls, listed in %ls\n", outputNames[i].c_str(), archives[i].first.c_str(), archives[i].second.c_str());
+            m_archives.push_back(unique_ptr<OutputArchive>(new OutputArchive(archives[i].first, archives[i].second, udims[i], sampPeriod)));
+        }
+    }
+
+    size_t numWriterThreads = writerConfig(L"numWriterThreads", (size_t) 0);
+    if (numWriterThreads > 0)
+    {
+        // a few utterances per thread are queued, to keep the threads busy while bounding the copies held in memory
+        size_t maxPendingWrites = writerConfig(L"maxPendingWrites", 4 * numWriterThreads);
+        m_writerThreads.reset(new WriterThreadPool(numWriterThreads, maxPendingWrites));
+    }
+}
+
+// Flush - wait for the pending writes and complete the archives
+template <class ElemType>
+void HTKMLFWriter<ElemType>::Flush()
+{
+    if (m_writerThreads)
+        m_writerThreads->WaitAll();
+    for (auto& archive : m_archives)
+    {
+        if (archive)
+            archive->Close();
+    }
+    m_archives.clear();
 }
 
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Destroy()
 {
+    // called from the DataWriter destructor, so an error of the last writes is reported rather than thrown
+    try
+    {
+        Flush();
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "HTKMLFWriter: failed to write the output: %s\n", e.what());
+    }
+    m_writerThreads.reset();
+    m_archives.clear();
+
     delete[] m_tempArray;
     m_tempArray = nullptr;
     m_tempArraySize = 0;
@@ -129,7 +276,38 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
         assert(outputData.GetNumRows() == dim);
         dim;
 
-        Save(outFile, outputData);
+        if (!m_writerThreads)
+        {
+            outputData.CopyToArray(m_tempArray, m_tempArraySize);
+            Save(outFile, id, outputFileIndex, m_tempArray, outputData.GetNumRows(), outputData.GetNumCols());
+            continue;
+        }
+
+        // the matrix is reused for the next utterance, so its values are copied before the write is queued
+        size_t rows = outputData.GetNumRows();
+        size_t cols = outputData.GetNumCols();
+        auto data = make_shared<vector<ElemType>>(rows * cols);
+        if (!data->empty())
+            outputData.CopySection(rows, cols, data->data(), rows);
+        size_t index = outputFileIndex;
+        m_writerThreads->Enqueue([this, outFile, id, index, data, rows, cols]()
+        {
+            Save(outFile, id, index, data->data(), rows, cols);
+        });
+    }
+
+    // an archive whose output is not saved for this utterance skips it, the next utterance is appended after the previous one
+    for (auto& output : outputNameToIdMap)
+    {
+        size_t id = output.second;
+        if (m_archives.empty() || !m_archives[id] || matrices.find(output.first) != matrices.end())
+            continue;
+        OutputArchive* archive = m_archives[id].get();
+        size_t index = outputFileIndex;
+        if (m_writerThreads)
+            m_writerThreads->Enqueue([archive, index]() { archive->Append(index, wstring(), nullptr); });
+        else
+            archive->Append(index, wstring(), nullptr);
     }
 
     outputFileIndex++;
@@ -137,31 +315,50 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
     return true;
 }
 
+// Save - write an utterance of an output, to its own file or appended to the archive of the output
+// outputFile - file of the utterance, its logical path in the archive
+// outputId - index of the output
+// index - index of the utterance, orders the utterances in the archive
+// data - values of the utterance, column major, a column per frame
 template <class ElemType>
-void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& outputData)
+void HTKMLFWriter<ElemType>::Save(const std::wstring& outputFile, size_t outputId, size_t index, const ElemType* data, size_t rows, size_t cols)
 {
+    OutputArchive* archive = m_archives.empty() ? nullptr : m_archives[outputId].get();
     msra::dbn::matrix output;
-    output.resize(outputData.GetNumRows(), outputData.GetNumCols());
-    outputData.CopyToArray(m_tempArray, m_tempArraySize);
-    ElemType* pValue = m_tempArray;
-
-    for (int j = 0; j < outputData.GetNumCols(); j++)
+    try
     {
-        for (int i = 0; i < outputData.GetNumRows(); i++)
+        output.resize(rows, cols);
+        const ElemType* pValue = data;
+
+        for (int j = 0; j < cols; j++)
         {
-            output(i, j) = (float) *pValue++;
+            for (int i = 0; i < rows; i++)
+            {
+                output(i, j) = (float) *pValue++;
+            }
         }
     }
+    catch (...)
+    {
+        if (archive)
+            archive->Append(index, outputFile, nullptr);
+        throw;
+    }
 
     const size_t nansinf = output.countnaninf();
     if (nansinf > 0)
         fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
     // save it
-    msra::files::make_intermediate_dirs(outputFile);
-    msra::util::attempt(5, [&]()
-                        {
-                            msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
-                        });
+    if (archive)
+        archive->Append(index, outputFile, &output);
+    else
+    {
+        msra::files::make_intermediate_dirs(outputFile);
+        msra::util::attempt(5, [&]()
+                            {
+                                msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
+                            });
+    }
 
     fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
 }
@@ -7,11 +7,123 @@
 #pragma once
 #include "DataWriter.h"
 #include "ScriptableObjects.h"
+#include <algorithm>
 #include <map>
 #include <vector>
+#include <memory>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// runs the write tasks of the writer on 'numThreads' threads, in the order they were queued, with at most
+// 'maxPendingTasks' of them queued; after an error the remaining tasks are dropped and the error is rethrown to the caller
+class WriterThreadPool
+{
+public:
+    WriterThreadPool(size_t numThreads, size_t maxPendingTasks)
+        : m_maxPendingTasks(std::max(maxPendingTasks, (size_t) 1)), m_numRunningTasks(0), m_isTerminating(false)
+    {
+        for (size_t i = 0; i < numThreads; i++)
+            m_threads.push_back(std::thread([this]() { Run(); }));
+    }
+
+    ~WriterThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isTerminating = true;
+        }
+        m_condition.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    // queue a task; waits while the queue is full, and rethrows an error of an earlier task
+    void Enqueue(const std::function<void()>& task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_tasks.size() < m_maxPendingTasks || m_error; });
+            RethrowError();
+            m_tasks.push_back(task);
+        }
+        m_condition.notify_all();
+    }
+
+    // wait until all tasks have run; rethrows an error of one of them
+    void WaitAll()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_tasks.empty() && m_numRunningTasks == 0; });
+        RethrowError();
+    }
+
+private:
+    void Run()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_tasks.empty() || m_isTerminating; });
+                if (m_tasks.empty())
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                m_numRunningTasks++;
+            }
+            m_condition.notify_all(); // a slot of the queue is free
+
+            std::exception_ptr error;
+            if (!m_error)
+            {
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_numRunningTasks--;
+                if (error && !m_error)
+                    m_error = error;
+            }
+            m_condition.notify_all();
+        }
+    }
+
+    // (caller must hold m_mutex)
+    void RethrowError()
+    {
+        if (m_error)
+        {
+            auto error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t m_maxPendingTasks;
+    std::deque<std::function<void()>> m_tasks;
+    size_t m_numRunningTasks;
+    std::exception_ptr m_error;
+    bool m_isTerminating;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<std::thread> m_threads;
+};
+
 template <class ElemType>
 class HTKMLFWriter : public IDataWriter
 {
@@ -25,10 +137,21 @@ private:
     std::map<std::wstring, size_t> outputNameToTypeMap;
     unsigned int sampPeriod;
     size_t outputFileIndex;
-    void Save(std::wstring& outputFile, Matrix<ElemType>& outputData);
+    void Save(const std::wstring& outputFile, size_t outputId, size_t index, const ElemType* data, size_t rows, size_t cols);
+    void Flush();
     ElemType* m_tempArray;
     size_t m_tempArraySize;
 
+    // With numWriterThreads > 0, the outputs of an utterance are copied out of the matrices in SaveData(), and converted
+    // and written by a pool of threads while the next utterances are computed.
+    std::unique_ptr<WriterThreadPool> m_writerThreads;
+
+    // With archiveFile specified for an output, its utterances are appended to a single HTK file instead of a file each,
+    // and listed as logicalPath=archiveFile[firstFrame,lastFrame] in archiveScpFile (default archiveFile.scp),
+    // which is the archive syntax of the HTK readers. Null for outputs written to a file per utterance.
+    class OutputArchive;
+    std::vector<std::unique_ptr<OutputArchive>> m_archives;
+
     enum OutputTypes
     {
         outputReal,
@@ -46,6 +169,8 @@ public:
     {
         InitFromConfig(config);
     }
+    HTKMLFWriter();
+    ~HTKMLFWriter();
     virtual void Destroy();
     virtual void GetSections(std::map<std::wstring, SectionType, nocase_compare>& sections);
     virtual bool SaveData(size_t recordStart, const std::map<std::wstring, void*, nocase_compare>& matrices, size_t numRecords, size_t datasetSize, size_t byteVariableSized);
@@ -524,6 +524,55 @@ void lattice::dedup()
     fprintf(stderr, "converted %d lattices\n", toclines.size());
 }
 
+// convert an archive to the flat format
+// The output archive starts with a 16-byte header (tag "LATF" and format version), followed by the lattices in
+// lattice::fwriteflat() format, each at a 16-byte aligned offset. getlattice() detects this header and memory-maps the archive.
+/*static*/ void archive::flatten(const std::wstring &intocpath, const std::wstring &outpath, const msra::asr::simplesenonehmm &hset)
+{
+    const auto &modelsymmap = hset.getsymmap();
+
+    std::vector<std::wstring> intocpaths(1, intocpath);
+    msra::lattices::archive archive(intocpaths, modelsymmap);
+
+    // read the intocpath file once again to get the keys in original order
+    std::vector<char> textbuffer;
+    auto toclines = msra::files::fgetfilelines(intocpath, textbuffer);
+
+    msra::files::make_intermediate_dirs(outpath);
+    auto_file_ptr f(fopenOrDie(outpath, L"wb"));
+    auto_file_ptr ftoc(fopenOrDie(outpath + L".toc", L"wb"));
+
+    fputTag(f, flatarchivetag());
+    fputint(f, 1); // archive format version
+    lattice::fpadflat(f, 8);
+
+    foreach_index (i, toclines)
+    {
+        const char *line = toclines[i];
+        const char *p = strchr(line, '=');
+        if (p == NULL)
+            RuntimeError("flatten: invalid TOC line (no = sign): %s", line);
+        const std::wstring key = msra::strfun::utf16(std::string(line, p - line));
+
+        // fetch lattice  --this performs any necessary format conversions already, and leaves the V1 data (edges, align) current
+        lattice L;
+        archive.getlattice(key, L);
+
+        uint64_t offset = fgetpos(f);
+        if (offset % lattice::flatalignment != 0)
+            LogicError("flatten: misaligned lattice offset %llu", offset);
+        L.fwriteflat(f);
+
+        fprintfOrDie(ftoc, "%s=%s[%llu]\n", msra::strfun::utf8(key).c_str(), (i == 0) ? msra::strfun::utf8(outpath).c_str() : "", offset);
+    }
+    fflushOrDie(f);
+    fflushOrDie(ftoc);
+
+    writeunitmap(outpath + L".symlist", modelsymmap);
+
+    fprintf(stderr, "flattened %d lattices\n", (int) toclines.size());
+}
+
 // ---------------------------------------------------------------------------
 // reading lattices from external formats (HTK lat, MLF)
 // ---------------------------------------------------------------------------
@@ -8,7 +8,9 @@
 #pragma once
 
 #include "Basics.h"
+#include "simple_checked_arrays.h" // for const_array_ref
 #include <stdio.h>
+#include <string.h>
 #include <vector>
 #include <algorithm>
 #ifndef __unix__
@@ -34,6 +36,16 @@ static void copytosubvector(const INV& inv, size_t subvecindex, OUTV& outv)
         outv[k + k0] = inv[k];
 }
 
+// same for contiguous vectors, i.e. the columns of the feature matrices
+template <class T>
+static void copytosubvector(const const_array_ref<T>& inv, size_t subvecindex, array_ref<T>& outv)
+{
+    size_t subdim = inv.size();
+    assert(outv.size() % subdim == 0);
+    if (subdim > 0)
+        memcpy(&outv[subvecindex * subdim], &inv[0], subdim * sizeof(T));
+}
+
 // compute the augmentation extent (how many frames added on each side)
 static size_t augmentationextent(size_t featdim /*augment from*/, size_t modeldim /*to*/)
 {
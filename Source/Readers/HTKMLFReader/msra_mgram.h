@@ -379,7 +379,7 @@ class mgram_map
 
     // get index for 'id' in level m+1, as a child of index i in level m.
     // Returns -1 if not found.
-    // This is a relatively generic binary search.
+    // This is a relatively generic binary search, which ends in a linear scan once the range fits a few cache lines.
     inline index_t find_child(int m, index_t i, int id) const
     {
         // unigram level is a special case where we can avoid searching
@@ -402,7 +402,7 @@ class mgram_map
         index_t beg = firsts[m][i];
         index_t end = firsts[m][i + 1];
         const int24_vector &ids_m1 = ids[m + 1];
-        while (beg < end)
+        while (end - beg > 32)
         {
             index_t i = (beg + end) / 2;
             int v = ids_m1[i];
@@ -413,6 +413,14 @@ class mgram_map
             else
                 beg = i + 1; // id is right of i
         }
+        for (index_t i = beg; i < end; i++) // 32 ids are 96 bytes
+        {
+            int v = ids_m1[i];
+            if (id == v)
+                return i;
+            else if (id < v)
+                break; // ids are sorted
+        }
         return nindex; // not found
     }
 
@@ -671,27 +679,40 @@ public:
         if (k.m == 0)
             return foundcoord(1); // zerogram -> root
 
+        const coord h = find_history(k.pop_w());
+        if (!h.valid())            // unknown history: fall back
+            return foundcoord(-1); // indicates failure
+        return find_w(h, k.back());
+    }
+
+    // search for a history, i.e. an m-gram that is used as the history of a longer one.
+    // Returns an invalid coord if not found. The empty key is the root.
+    inline coord find_history(const key &h) const
+    {
         // We traverse history one by one.
         index_t i = 0;
-        for (int n = 1; n < k.m; n++)
+        for (int n = 1; n <= h.m; n++)
         {
-            int w = k[n - 1]; // may be -1 for unknown word
+            int w = h[n - 1]; // may be -1 for unknown word
             int id = map(w);  // may still be -1
-            // const char * sym = idToSymbol (id); sym;   // (debugging)
             i = find_child(n - 1, i, id);
-            if (i == nindex)           // unknown history: fall back
-                return foundcoord(-1); // indicates failure
+            if (i == nindex) // unknown history
+                return coord(false);
             // found it: advance search by one history token
         }
+        return coord(h.m, i);
+    }
 
-        // Found history. Do we also find the prediced word?
-        int w = k[k.m - 1]; // may be -1 for unknown word
-        int id = map(w);    // may still be -1
-        index_t i_m = find_child(k.m - 1, i, id);
+    // search for the predicted word 'w' under a history found by find_history().
+    // Same result as operator[] for the m-gram (history, w).
+    inline foundcoord find_w(const coord &h, int w) const
+    {
+        int id = map(w); // may be -1
+        index_t i_m = find_child(h.m, h.i, id);
         if (i_m == nindex) // not found
-            return foundcoord(0, k.m - 1, i);
+            return foundcoord(0, h.m, h.i);
         else // found
-            return foundcoord(1, k.m, i_m);
+            return foundcoord(1, h.m + 1, i_m);
     }
 
     // truncate a key to the m-gram length supported by this
@@ -1171,12 +1192,49 @@ protected:
     mutable int longestMGramFound;   // longest m-gram (incl. predicted token) found
     mutable int longestHistoryFound; // longest history (excl. predicted token) found
 
+    // history of the previous score() call and the coords of it and its back-off histories
+    // Consecutive queries mostly share their history (e.g. all words following a lattice node),
+    // and then only the predicted word needs to be looked up on each back-off level.
+    // Like the diagnostics above, this makes score() not thread-safe.
+    mutable std::vector<int> cachedHistory;
+    mutable std::vector<mgram_map::coord> cachedHistoryCoords; // [n] coord of history without its first n tokens, [last] = root
+
+    void invalidateHistoryCache()
+    {
+        cachedHistory.clear();
+        cachedHistoryCoords.clear();
+    }
+
+    // look up a history and its back-off histories, unless it is the one of the previous call
+    const std::vector<mgram_map::coord> &lookupHistory(const mgram_map::key &history) const
+    {
+        bool same = !cachedHistoryCoords.empty() && (int) cachedHistory.size() == history.order();
+        for (int n = 0; same && n < history.order(); n++)
+            same = cachedHistory[n] == history[n];
+        if (same)
+            return cachedHistoryCoords;
+
+        cachedHistory.resize(history.order());
+        cachedHistoryCoords.resize(history.order() + 1);
+        mgram_map::key h = history;
+        for (int n = 0; n <= history.order(); n++)
+        {
+            if (n < history.order())
+                cachedHistory[n] = history[n];
+            cachedHistoryCoords[n] = map.find_history(h);
+            if (h.order() > 0)
+                h = h.pop_h();
+        }
+        return cachedHistoryCoords;
+    }
+
     // this function is for reducing M after the fact, e.g. during estimation
     // ... TODO: rethink the resize business. It is for shrinking only.
     void resize(int newM)
     {
         M = newM;
         map.resize(M);
+        invalidateHistoryCache();
     }
 
 public:
@@ -1203,29 +1261,45 @@ public:
     {
         longestHistoryFound = 0; // (diagnostics)
 
+        const mgram_map::key key = map.truncate(mgram_map::key(mgram, m));
+        if (key.order() == 0) // zerogram
+        {
+            longestMGramFound = 0;
+            return logP[mgram_map::coord()];
+        }
+
+        const auto &histories = lookupHistory(key.pop_w());
+        const int w = key.back();
+
         double totalLogB = 0.0; // accumulated back-off
 
-        for (mgram_map::key key = map.truncate(mgram_map::key(mgram, m));; key = key.pop_h())
+        for (const auto &h : histories) // from the full history down to the root
         {
-            // look up the m-gram
-            const mgram_map::foundcoord c = map[key];
+            // history not found -> fall back
+            if (!h.valid())
+                continue;
 
             // (diagnostics -- can be removed if not used)
-            if (c.valid() && key.order() - 1 > longestHistoryFound)
-                longestHistoryFound = key.order() - 1;
-            if (c.valid_w())
-                longestMGramFound = key.order();
+            if (h.m > longestHistoryFound)
+                longestHistoryFound = h.m;
 
-            // full m-gram found -> return it (zerogram always considered found)
+            // look up the m-gram
+            const mgram_map::foundcoord c = map.find_w(h, w);
+
+            // full m-gram found -> return it
             if (c.valid_w())
+            {
+                longestMGramFound = c.m;
                 return totalLogB + logP[c];
+            }
 
             // history found but predicted word not -> back-off
-            if (c.valid_h())          // c is coordinate of parent instead
-                totalLogB += logB[c]; // and continue like fall back
-
-            // history not found -> fall back
+            totalLogB += logB[h]; // and continue like fall back
         } // and go again with the shortened history
+
+        // not even the unigram found -> zerogram (always considered found)
+        longestMGramFound = 0;
+        return totalLogB + logP[mgram_map::coord()];
     }
 
     // same as score() but without optimizations (for reference)
@@ -1484,6 +1558,7 @@ public:
             M = maxM;
 
         // allocate main storage
+        invalidateHistoryCache();
         map.init(M);
         logP.init(M);
         logB.init(M - 1);
@@ -1694,6 +1769,7 @@ protected:
         map.swap(sortedMap);
         logP.swap(sortedLogP);
         logB.swap(sortedLogB);
+        invalidateHistoryCache();
     }
 
 public:
@@ -1784,11 +1784,12 @@ public:
                 }
             }
 
-            // return randomized frames for the time range of those utterances
-            size_t currmpinodeframecount = 0;
+            // determine the frames of this MPI node in the order they are returned
+            std::vector<frameref> framerefs;
+            framerefs.reserve(feat[0].cols());
             for (size_t j = 0; j < mbframes; j++)
             {
-                if (currmpinodeframecount >= feat[0].cols()) // MPI/data-parallel mode: all nodes return the same #frames, which is how feat(,) is allocated
+                if (framerefs.size() >= feat[0].cols()) // MPI/data-parallel mode: all nodes return the same #frames, which is how feat(,) is allocated
                     break;
 
                 // map to time index inside arrays
@@ -1800,43 +1801,62 @@ public:
 
                 // random utterance
                 readfromdisk |= requirerandomizedchunk(frameref.chunkindex, windowbegin, windowend); // (this is just a check; should not actually page in anything)
+                framerefs.push_back(frameref);
+            }
 
-                foreach_index (i, randomizedchunks)
+            // return randomized frames for the time range of those utterances
+            // All chunks are paged in at this point, so the frames are assembled in parallel, each into its own column.
+            std::exception_ptr error;
+#pragma omp parallel for schedule(static)
+            for (int j = 0; j < (int) framerefs.size(); j++)
+            {
+                try
                 {
-                    const auto &chunk = randomizedchunks[i][frameref.chunkindex];
-                    const auto &chunkdata = chunk.getchunkdata();
-                    auto uttframes = chunkdata.getutteranceframes(frameref.utteranceindex());
-                    matrixasvectorofvectors uttframevectors(uttframes); // (wrapper that allows m[.].size() and m[.][.] as required by augmentneighbors())
-                    const size_t n = uttframevectors.size();
-                    assert(n == uttframes.cols() && chunkdata.numframes(frameref.utteranceindex()) == n);
-                    n;
-
-                    // copy frame and class labels
-                    const size_t t = frameref.frameindex();
-
-                    size_t leftextent, rightextent;
-                    // page in the needed range of frames
-                    if (leftcontext[i] == 0 && rightcontext[i] == 0)
+                    const frameref &frameref = framerefs[j];
+                    foreach_index (i, randomizedchunks)
                     {
-                        leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
-                    }
-                    else
-                    {
-                        leftextent = leftcontext[i];
-                        rightextent = rightcontext[i];
-                    }
-                    augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat[i], currmpinodeframecount);
+                        const auto &chunk = randomizedchunks[i][frameref.chunkindex];
+                        const auto &chunkdata = chunk.getchunkdata();
+                        auto uttframes = chunkdata.getutteranceframes(frameref.utteranceindex());
+                        matrixasvectorofvectors uttframevectors(uttframes); // (wrapper that allows m[.].size() and m[.][.] as required by augmentneighbors())
+                        const size_t n = uttframevectors.size();
+                        assert(n == uttframes.cols() && chunkdata.numframes(frameref.utteranceindex()) == n);
+                        n;
 
-                    if (issupervised() && i == 0)
-                    {
-                        auto frameclassids = getclassids(frameref);
-                        foreach_index (k, uids)
-                            uids[k][currmpinodeframecount] = frameclassids[k][t];
+                        // copy frame and class labels
+                        const size_t t = frameref.frameindex();
+
+                        size_t leftextent, rightextent;
+                        // page in the needed range of frames
+                        if (leftcontext[i] == 0 && rightcontext[i] == 0)
+                        {
+                            leftextent = rightextent = augmentationextent(uttframevectors[t].size(), vdim[i]);
+                        }
+                        else
+                        {
+                            leftextent = leftcontext[i];
+                            rightextent = rightcontext[i];
+                        }
+                        augmentneighbors(uttframevectors, noboundaryflags, t, leftextent, rightextent, feat[i], j);
+
+                        if (issupervised() && i == 0)
+                        {
+                            // (same as getclassids(), without building the sub-vectors for every frame)
+                            const size_t classidsbegin = chunkdata.getclassidsbegin(frameref.utteranceindex());
+                            foreach_index (k, uids)
+                                uids[k][j] = (*classids[k])[classidsbegin + t];
+                        }
                     }
                 }
-
-                currmpinodeframecount++;
+                catch (...)
+                {
+#pragma omp critical
+                    if (!error)
+                        error = std::current_exception();
+                }
             }
+            if (error)
+                std::rethrow_exception(error);
         }
         timegetbatch = timergetbatch;
 
@@ -5,16 +5,23 @@
 
 #pragma once
 #include <opencv2/core/mat.hpp>
+#include <vector>
 #include "Config.h"
+#include "ConcStack.h"
 #ifdef USE_ZIP
 #include <zip.h>
 #include <unordered_map>
 #include <memory>
-#include "ConcStack.h"
+#include "MemoryMappedFile.h"
 #endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Decodes an image from memory. If decodeMinSide is not 0, a JPEG image is decoded at the largest reduction
+// (1/2, 1/4 or 1/8, which the JPEG decoder does at a fraction of the cost of a full decode) that keeps
+// its shorter side at least decodeMinSide pixels long.
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t decodeMinSide);
+
 class ByteReader
 {
 public:
@@ -22,7 +29,7 @@ public:
     virtual ~ByteReader() = default;
 
     virtual void Register(size_t seqId, const std::string& path) = 0;
-    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
+    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
 };
@@ -31,25 +38,56 @@ class FileByteReader : public ByteReader
 {
 public:
     void Register(size_t, const std::string&) override {}
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide) override;
+
+private:
+    conc_stack<std::vector<unsigned char>> m_workspace;
 };
 
 #ifdef USE_ZIP
+// Reads images from a .zip file. The file is memory mapped, so that stored (uncompressed) entries, which is how
+// images are usually packed, are decoded straight from the mapping by any number of threads; only compressed
+// entries are read through a pool of libzip handles. Entries are found in an index of the central directory, which
+// is parsed once and, if cacheIndex is set, saved next to the archive (<zipPath>.index) for the following runs.
 class ZipByteReader : public ByteReader
 {
 public:
-    ZipByteReader(const std::string& zipPath);
+    ZipByteReader(const std::string& zipPath, bool cacheIndex = false);
 
     void Register(size_t seqId, const std::string& path) override;
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide) override;
 
 private:
+    // An entry of the central directory. Written as is into the index cache.
+    struct Entry
+    {
+        uint64_t m_localHeaderOffset;
+        uint64_t m_compressedSize;
+        uint64_t m_size;
+        uint64_t m_index;  // index of the entry in libzip
+        uint32_t m_method; // compression method, c_unknownMethod if the entry was found by libzip only
+        uint32_t m_flags;  // general purpose bit flags
+    };
+
     using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
     ZipPtr OpenZip();
 
+    void BuildIndex();
+    bool ParseCentralDirectory();
+    bool TryLoadIndex();
+    void SaveIndex();
+    std::wstring GetIndexFilePath() const;
+
+    // Gets the start of the data of a stored entry in the mapping.
+    const unsigned char* GetStoredData(const Entry& entry, const std::string& path) const;
+
     std::string m_zipPath;
+    bool m_cacheIndex;
+    MemoryMappedFilePtr m_file;
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, size_t> m_nameToEntry;
     conc_stack<ZipPtr> m_zips;
-    std::unordered_map<size_t, std::pair<zip_uint64_t, zip_uint64_t>> m_seqIdToIndex;
+    std::unordered_map<size_t, size_t> m_seqIdToEntry;
     conc_stack<std::vector<unsigned char>> m_workspace;
 };
 #endif
@@ -0,0 +1,253 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include "ImageCache.h"
+#include "ExceptionCapture.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+const uint32_t c_imageCacheMagic = 0x43494D43; // "CMIC"
+const uint32_t c_imageCacheVersion = 1;
+const uint32_t c_imageCacheAlignment = 8;
+
+const uint32_t c_imageCacheGrayscale = 1;
+const uint32_t c_imageCacheCompressed = 2;
+
+struct ImageCacheHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_maxShorterSide;
+    uint32_t m_flags; // c_imageCacheGrayscale | c_imageCacheCompressed
+    uint64_t m_numberOfImages;
+    uint64_t m_indexOffset;
+};
+
+struct ImageCacheRecord
+{
+    uint64_t m_offset;
+    uint64_t m_size;
+    uint32_t m_rows;
+    uint32_t m_cols;
+    uint32_t m_channels;
+    uint32_t m_pathLength; // in bytes
+};
+
+static size_t AlignImageCache(size_t size)
+{
+    return (size + c_imageCacheAlignment - 1) / c_imageCacheAlignment * c_imageCacheAlignment;
+}
+
+static uint32_t GetFlags(const ImageCache::Options& options)
+{
+    return (options.m_grayscale ? c_imageCacheGrayscale : 0) | (options.m_compressed ? c_imageCacheCompressed : 0);
+}
+
+static void WritePadded(FILE* f, const void* data, size_t size)
+{
+    static const char zeros[c_imageCacheAlignment] = {};
+    if (size > 0)
+    {
+        fwriteOrDie(data, 1, size, f);
+    }
+    fwriteOrDie(zeros, 1, AlignImageCache(size) - size, f);
+}
+
+// Scales the image down so that its shorter side is at most maxShorterSide, and converts it to 8-bit continuous pixels.
+static cv::Mat PrepareImage(cv::Mat image, size_t maxShorterSide)
+{
+    size_t shorterSide = std::min(image.rows, image.cols);
+    if (maxShorterSide > 0 && shorterSide > maxShorterSide)
+    {
+        double scale = (double)maxShorterSide / shorterSide;
+        cv::Size size((int)std::round(image.cols * scale), (int)std::round(image.rows * scale));
+        cv::Mat scaled;
+        cv::resize(image, scaled, size, 0, 0, cv::INTER_AREA);
+        image = scaled;
+    }
+
+    if (image.depth() != CV_8U)
+    {
+        image.convertTo(image, CV_8U);
+    }
+
+    if (!image.isContinuous())
+    {
+        image = image.clone();
+    }
+    return image;
+}
+
+/*static*/ void ImageCache::Build(const std::wstring& filename, const std::vector<std::string>& paths, const ImageSource& source, const Options& options)
+{
+    std::wstring tempFilename = filename + L".tmp";
+    FILE* f = fopenOrDie(tempFilename, L"wb");
+
+    ImageCacheHeader header = {};
+    header.m_magic = c_imageCacheMagic;
+    header.m_version = c_imageCacheVersion;
+    header.m_maxShorterSide = (uint32_t)options.m_maxShorterSide;
+    header.m_flags = GetFlags(options);
+    header.m_numberOfImages = paths.size();
+    fwriteOrDie(&header, sizeof(header), 1, f);
+
+    // Images are prepared in parallel a batch at a time, and written in order.
+    const size_t batchSize = 256;
+    std::vector<ImageCacheRecord> records(paths.size());
+    std::vector<cv::Mat> images(batchSize);
+    std::vector<std::vector<unsigned char>> encoded(options.m_compressed ? batchSize : 0);
+    for (size_t begin = 0; begin < paths.size(); begin += batchSize)
+    {
+        size_t end = std::min(begin + batchSize, paths.size());
+        auto prepare = [&](int i)
+        {
+            cv::Mat image = source(i);
+            if (!image.data)
+            {
+                RuntimeError("Cannot open file '%s'", paths[i].c_str());
+            }
+
+            image = PrepareImage(image, options.m_maxShorterSide);
+            if (options.m_compressed)
+            {
+                // The fastest compression level, decoding speed hardly depends on the level.
+                std::vector<int> parameters = { cv::IMWRITE_PNG_COMPRESSION, 1 };
+                if (!cv::imencode(".png", image, encoded[i - begin], parameters))
+                {
+                    RuntimeError("Cannot encode image '%s'", paths[i].c_str());
+                }
+            }
+            images[i - begin] = image;
+        };
+
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic)
+        for (int i = (int)begin; i < (int)end; ++i)
+            capture.SafeRun(prepare, i);
+        capture.RethrowIfHappened();
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const cv::Mat& image = images[i - begin];
+            auto& record = records[i];
+            record.m_offset = fgetpos(f);
+            record.m_rows = image.rows;
+            record.m_cols = image.cols;
+            record.m_channels = image.channels();
+            record.m_pathLength = (uint32_t)paths[i].size();
+            if (options.m_compressed)
+            {
+                record.m_size = encoded[i - begin].size();
+                WritePadded(f, encoded[i - begin].data(), record.m_size);
+            }
+            else
+            {
+                record.m_size = image.total() * image.elemSize();
+                WritePadded(f, image.data, record.m_size);
+            }
+        }
+    }
+
+    header.m_indexOffset = fgetpos(f);
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        fwriteOrDie(&records[i], sizeof(ImageCacheRecord), 1, f);
+        WritePadded(f, paths[i].data(), paths[i].size());
+    }
+
+    fsetpos(f, (uint64_t)0);
+    fwriteOrDie(&header, sizeof(header), 1, f);
+    fflushOrDie(f);
+    fcloseOrDie(f);
+    renameOrDie(tempFilename, filename);
+
+    fprintf(stderr, "ImageCache: Wrote %" PRIu64 " images to '%ls'.\n", paths.size(), filename.c_str());
+}
+
+/*static*/ ImageCachePtr ImageCache::TryOpen(const std::wstring& filename, const Options& options)
+{
+    auto file = std::make_shared<MemoryMappedFile>(filename);
+    if (file->Size() < sizeof(ImageCacheHeader))
+    {
+        return nullptr;
+    }
+
+    const ImageCacheHeader& header = *reinterpret_cast<const ImageCacheHeader*>(file->Data());
+    if (header.m_magic != c_imageCacheMagic || header.m_version != c_imageCacheVersion ||
+        header.m_maxShorterSide != options.m_maxShorterSide || header.m_flags != GetFlags(options) ||
+        header.m_indexOffset > file->Size())
+    {
+        return nullptr;
+    }
+
+    std::vector<Entry> entries;
+    entries.reserve(header.m_numberOfImages);
+    std::unordered_map<std::string, size_t> indices;
+    size_t offset = header.m_indexOffset;
+    for (uint64_t i = 0; i < header.m_numberOfImages; ++i)
+    {
+        if (offset + sizeof(ImageCacheRecord) > file->Size())
+        {
+            return nullptr;
+        }
+
+        const ImageCacheRecord& record = *reinterpret_cast<const ImageCacheRecord*>(file->Data() + offset);
+        offset += sizeof(ImageCacheRecord);
+        if (offset + record.m_pathLength > file->Size() || record.m_offset + record.m_size > header.m_indexOffset)
+        {
+            return nullptr;
+        }
+
+        indices[std::string(file->Data() + offset, record.m_pathLength)] = entries.size();
+        offset += AlignImageCache(record.m_pathLength);
+
+        Entry entry;
+        entry.m_offset = record.m_offset;
+        entry.m_size = record.m_size;
+        entry.m_rows = (int)record.m_rows;
+        entry.m_cols = (int)record.m_cols;
+        entry.m_channels = (int)record.m_channels;
+        entries.push_back(entry);
+    }
+
+    return ImageCachePtr(new ImageCache(file, options.m_compressed, std::move(entries), std::move(indices)));
+}
+
+ImageCache::ImageCache(MemoryMappedFilePtr file, bool compressed, std::vector<Entry>&& entries, std::unordered_map<std::string, size_t>&& indices)
+    : m_file(file), m_compressed(compressed), m_entries(std::move(entries)), m_indices(std::move(indices))
+{
+}
+
+bool ImageCache::TryGetIndex(const std::string& path, size_t& index) const
+{
+    auto found = m_indices.find(path);
+    if (found == m_indices.end())
+    {
+        return false;
+    }
+    index = found->second;
+    return true;
+}
+
+cv::Mat ImageCache::Read(size_t index) const
+{
+    const Entry& entry = m_entries[index];
+    unsigned char* data = reinterpret_cast<unsigned char*>(const_cast<char*>(m_file->Data() + entry.m_offset));
+    if (m_compressed)
+    {
+        return cv::imdecode(cv::Mat(1, (int)entry.m_size, CV_8UC1, data), cv::IMREAD_UNCHANGED);
+    }
+    return cv::Mat(entry.m_rows, entry.m_cols, CV_8UC(entry.m_channels), data);
+}
+
+}}}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ImageCache.h -- a file of decoded images, so that the images of a map file are decoded and scaled only once
+// instead of in every epoch.
+//
+// The images are stored as 8-bit HWC pixels, either raw or compressed with the lossless PNG encoding, after scaling
+// them down so that their shorter side is at most a given length. All integers are little-endian, and every record
+// starts at a multiple of 8 bytes.
+//
+//  file:    ImageCacheHeader
+//           images, in the order in which they were written
+//           ImageCacheRecord, UTF-8 path of the image (padded) -- for each image, at ImageCacheHeader::m_indexOffset
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+#include "MemoryMappedFile.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ImageCache;
+typedef std::shared_ptr<ImageCache> ImageCachePtr;
+
+class ImageCache
+{
+public:
+    struct Options
+    {
+        size_t m_maxShorterSide; // images are scaled down to this length of their shorter side, 0 - not scaled
+        bool m_grayscale;        // whether the images were decoded in grayscale
+        bool m_compressed;       // whether the images are PNG encoded
+    };
+
+    // Returns the decoded image of the given index, or an empty image if it cannot be read.
+    typedef std::function<cv::Mat(size_t index)> ImageSource;
+
+    // Writes the images of 'paths' into a new cache file. The images are taken from 'source' and scaled in parallel.
+    // The file is written under a temporary name first, so a file of that name is either complete or missing.
+    static void Build(const std::wstring& filename, const std::vector<std::string>& paths, const ImageSource& source, const Options& options);
+
+    // Opens an existing cache, returns nullptr if it is not a cache file or was written with different options.
+    static ImageCachePtr TryOpen(const std::wstring& filename, const Options& options);
+
+    // Gets the index of the image of the given path, returns false if the image is not in the cache.
+    bool TryGetIndex(const std::string& path, size_t& index) const;
+
+    // Gets the 8-bit image of the given index. An uncompressed image refers to the memory of the cache.
+    cv::Mat Read(size_t index) const;
+
+private:
+    struct Entry
+    {
+        uint64_t m_offset;
+        uint64_t m_size;
+        int m_rows;
+        int m_cols;
+        int m_channels;
+    };
+
+    ImageCache(MemoryMappedFilePtr file, bool compressed, std::vector<Entry>&& entries, std::unordered_map<std::string, size_t>&& indices);
+
+    MemoryMappedFilePtr m_file;
+    bool m_compressed;
+    std::vector<Entry> m_entries;
+    std::unordered_map<std::string, size_t> m_indices;
+};
+
+}}}
@@ -60,6 +60,11 @@ ImageConfigHelper::ImageConfigHelper(const ConfigParameters& config)
     m_mapPath = config(L"file");
 
     m_grayscale = config(L"grayscale", c == 1);
+    m_decodeMinSide = config(L"decodeMinSide", (size_t)0);
+    m_imageCache = msra::strfun::utf16(config(L"imageCache", ""));
+    m_imageCacheSide = config(L"imageCacheSide", (size_t)256);
+    m_imageCacheCompressed = config(L"imageCacheCompressed", false);
+    m_cacheZipIndex = config(L"cacheZipIndex", false);
     std::string rand = config(L"randomize", "auto");
 
     if (AreEqualIgnoreCase(rand, "auto"))
@@ -58,6 +58,31 @@ public:
         return m_grayscale;
     }
 
+    size_t GetDecodeMinSide() const
+    {
+        return m_decodeMinSide;
+    }
+
+    const std::wstring& GetImageCache() const
+    {
+        return m_imageCache;
+    }
+
+    size_t GetImageCacheSide() const
+    {
+        return m_imageCacheSide;
+    }
+
+    bool IsImageCacheCompressed() const
+    {
+        return m_imageCacheCompressed;
+    }
+
+    bool ShouldCacheZipIndex() const
+    {
+        return m_cacheZipIndex;
+    }
+
     CropType GetCropType() const
     {
         return m_cropType;
@@ -80,6 +105,11 @@ private:
     int m_cpuThreadCount;
     bool m_randomize;
     bool m_grayscale;
+    size_t m_decodeMinSide;
+    std::wstring m_imageCache;
+    size_t m_imageCacheSide;
+    bool m_imageCacheCompressed;
+    bool m_cacheZipIndex;
     CropType m_cropType;
 };
 
@@ -9,10 +9,18 @@
 #include <opencv2/opencv.hpp>
 #include <numeric>
 #include <limits>
+#include <unordered_set>
+#include <mutex>
 #include "ImageDataDeserializer.h"
 #include "ImageConfigHelper.h"
 #include "StringUtil.h"
 #include "ConfigUtil.h"
+#include "fileutil.h"
+
+// Decoding JPEG images at a reduced size is supported from OpenCV 3.1 on.
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1)
+#define CNTK_REDUCED_IMAGE_DECODING
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -62,25 +70,57 @@ struct DeserializedImage : DenseSequenceData
     cv::Mat m_image;
 };
 
-// For image, chunks correspond to a single image.
+// For image, chunks correspond to a single image, with a sequence for each of its views (see multiViewCrop).
+// The image is decoded once for all views.
 class ImageDataDeserializer::ImageChunk : public Chunk, public std::enable_shared_from_this<ImageChunk>
 {
-    ImageSequenceDescription m_description;
+    std::vector<ImageSequenceDescription> m_descriptions;
     ImageDataDeserializer& m_parent;
 
+    // The decoded image, kept until all views have been read.
+    std::mutex m_decodedImageLock;
+    cv::Mat m_decodedImage;
+    size_t m_numberOfViewsToRead;
+
+    cv::Mat ReadImage(const ImageSequenceDescription& imageSequence)
+    {
+        if (m_parent.m_imageCache)
+        {
+            return m_parent.m_imageCache->Read(imageSequence.m_cacheIndex);
+        }
+        return m_parent.ReadImage(imageSequence.m_id, imageSequence.m_path, m_parent.m_grayscale, m_parent.m_decodeMinSide);
+    }
+
 public:
-    ImageChunk(ImageSequenceDescription& description, ImageDataDeserializer& parent)
-        : m_description(description), m_parent(parent)
+    ImageChunk(std::vector<ImageSequenceDescription>&& descriptions, ImageDataDeserializer& parent)
+        : m_descriptions(std::move(descriptions)), m_parent(parent), m_numberOfViewsToRead(m_descriptions.size())
     {
     }
 
     virtual void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
     {
-        assert(sequenceId == m_description.m_id);
-        const auto& imageSequence = m_description;
+        assert(m_descriptions.front().m_id <= sequenceId && sequenceId - m_descriptions.front().m_id < m_descriptions.size());
+        const auto& imageSequence = m_descriptions[sequenceId - m_descriptions.front().m_id];
 
         auto image = std::make_shared<DeserializedImage>();
-        image->m_image = std::move(m_parent.ReadImage(m_description.m_id, imageSequence.m_path, m_parent.m_grayscale));
+        if (m_descriptions.size() == 1)
+        {
+            image->m_image = ReadImage(imageSequence);
+        }
+        else
+        {
+            // The first view decodes the image, the others wait for it.
+            std::lock_guard<std::mutex> lock(m_decodedImageLock);
+            if (!m_decodedImage.data)
+            {
+                m_decodedImage = ReadImage(imageSequence);
+            }
+            image->m_image = m_decodedImage;
+            if (m_numberOfViewsToRead > 0 && --m_numberOfViewsToRead == 0)
+            {
+                m_decodedImage.release();
+            }
+        }
         auto& cvImage = image->m_image;
 
         if (!cvImage.data)
@@ -94,6 +134,11 @@ public:
         {
             cvImage.convertTo(cvImage, dataType);
         }
+        else if (m_descriptions.size() > 1)
+        {
+            // Each view needs an image of its own, because transformations may change it in place.
+            cvImage = cvImage.clone();
+        }
 
         if (!cvImage.isContinuous())
         {
@@ -162,11 +207,24 @@ ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const C
         std::make_shared<TypedLabelGenerator<double>>(labelDimension);
 
     m_grayscale = config(L"grayscale", false);
+    m_decodeMinSide = config(L"decodeMinSide", (size_t)0);
+    m_cacheZipIndex = config(L"cacheZipIndex", false);
 
     // TODO: multiview should be done on the level of randomizer/transformers - it is responsiblity of the
     // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
     bool multiViewCrop = config(L"multiViewCrop", false);
-    CreateSequenceDescriptions(corpus, config(L"file"), labelDimension, multiViewCrop);
+    std::string mapPath = config(L"file");
+    CreateSequenceDescriptions(corpus, mapPath, labelDimension, multiViewCrop);
+
+    std::wstring imageCache = config(L"imageCache", L"");
+    if (!imageCache.empty())
+    {
+        ImageCache::Options options;
+        options.m_maxShorterSide = config(L"imageCacheSide", (size_t)256);
+        options.m_grayscale = m_grayscale;
+        options.m_compressed = config(L"imageCacheCompressed", false);
+        InitializeImageCache(mapPath, imageCache, options);
+    }
 }
 
 // TODO: Should be removed at some point.
@@ -177,6 +235,8 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     m_streams = configHelper.GetStreams();
     assert(m_streams.size() == 2);
     m_grayscale = configHelper.UseGrayscale();
+    m_decodeMinSide = configHelper.GetDecodeMinSide();
+    m_cacheZipIndex = configHelper.ShouldCacheZipIndex();
     const auto& label = m_streams[configHelper.GetLabelStreamId()];
     const auto& feature = m_streams[configHelper.GetFeatureStreamId()];
 
@@ -204,19 +264,28 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     }
 
     CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(), configHelper.GetMapPath(), labelDimension, configHelper.IsMultiViewCrop());
+
+    if (!configHelper.GetImageCache().empty())
+    {
+        ImageCache::Options options;
+        options.m_maxShorterSide = configHelper.GetImageCacheSide();
+        options.m_grayscale = m_grayscale;
+        options.m_compressed = configHelper.IsImageCacheCompressed();
+        InitializeImageCache(configHelper.GetMapPath(), configHelper.GetImageCache(), options);
+    }
 }
 
 // Descriptions of chunks exposed by the image reader.
 ChunkDescriptions ImageDataDeserializer::GetChunkDescriptions()
 {
     ChunkDescriptions result;
-    result.reserve(m_imageSequences.size());
-    for (auto const& s : m_imageSequences)
+    result.reserve(m_imageSequences.size() / m_viewsPerImage);
+    for (size_t i = 0; i < m_imageSequences.size(); i += m_viewsPerImage)
     {
         auto chunk = std::make_shared<ChunkDescription>();
-        chunk->m_id = s.m_chunkId;
-        chunk->m_numberOfSamples = 1;
-        chunk->m_numberOfSequences = 1;
+        chunk->m_id = m_imageSequences[i].m_chunkId;
+        chunk->m_numberOfSamples = m_viewsPerImage;
+        chunk->m_numberOfSequences = m_viewsPerImage;
         result.push_back(chunk);
     }
 
@@ -225,8 +294,11 @@ ChunkDescriptions ImageDataDeserializer::GetChunkDescriptions()
 
 void ImageDataDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
 {
-    // Currently a single sequence per chunk.
-    result.push_back(m_imageSequences[chunkId]);
+    // A sequence per view of the image.
+    for (size_t i = chunkId * m_viewsPerImage; i < (chunkId + 1) * m_viewsPerImage; i++)
+    {
+        result.push_back(m_imageSequences[i]);
+    }
 }
 
 void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpus, std::string mapPath, size_t labelDimension, bool isMultiCrop)
@@ -238,11 +310,13 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
     }
 
     size_t itemsPerLine = isMultiCrop ? 10 : 1;
+    m_viewsPerImage = itemsPerLine;
     size_t curId = 0;
     std::string line;
     PathReaderMap knownReaders;
     ImageSequenceDescription description;
     description.m_numberOfSamples = 1;
+    description.m_cacheIndex = SIZE_MAX;
 
     auto& stringRegistry = corpus->GetStringRegistry();
     for (size_t lineIndex = 0; std::getline(mapFile, line); ++lineIndex)
@@ -281,7 +355,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
                 imagePath.c_str(), cid, labelDimension, lineIndex, mapPath.c_str());
         }
 
-        if (CHUNKID_MAX < curId + itemsPerLine)
+        if (CHUNKID_MAX <= curId / itemsPerLine)
         {
             RuntimeError("Maximum number of chunks exceeded.");
         }
@@ -289,7 +363,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
         for (size_t start = curId; curId < start + itemsPerLine; curId++)
         {
             description.m_id = curId;
-            description.m_chunkId = (ChunkIdType)curId;
+            description.m_chunkId = (ChunkIdType)(start / itemsPerLine);
             description.m_path = imagePath;
             description.m_classId = cid;
             description.m_key.m_sequence = stringRegistry[sequenceKey];
@@ -302,10 +376,66 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
     }
 }
 
+void ImageDataDeserializer::InitializeImageCache(const std::string& mapPath, const std::wstring& cacheFile, const ImageCache::Options& options)
+{
+    // The cache can be used if it is newer than the map file and has all images of the selected sequences.
+    auto tryOpen = [&]() -> bool
+    {
+        if (!msra::files::fuptodate(cacheFile, msra::strfun::utf16(mapPath), false) ||
+            !(m_imageCache = ImageCache::TryOpen(cacheFile, options)))
+        {
+            return false;
+        }
+
+        for (auto& sequence : m_imageSequences)
+        {
+            if (!m_imageCache->TryGetIndex(sequence.m_path, sequence.m_cacheIndex))
+            {
+                m_imageCache.reset();
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (tryOpen())
+    {
+        return;
+    }
+
+    // Each image is decoded once, also if there are several views of it.
+    std::vector<std::string> paths;
+    std::vector<size_t> sequenceIds;
+    std::unordered_set<std::string> knownPaths;
+    for (const auto& sequence : m_imageSequences)
+    {
+        if (knownPaths.insert(sequence.m_path).second)
+        {
+            paths.push_back(sequence.m_path);
+            sequenceIds.push_back(sequence.m_id);
+        }
+    }
+
+    fprintf(stderr, "ImageDataDeserializer: Building the image cache '%ls' for %" PRIu64 " images.\n", cacheFile.c_str(), paths.size());
+
+    // Images that are scaled down anyway can be decoded at a reduced size.
+    size_t decodeMinSide = std::max(m_decodeMinSide, options.m_maxShorterSide);
+    ImageCache::Build(cacheFile, paths, [&](size_t i)
+    {
+        return ReadImage(sequenceIds[i], paths[i], m_grayscale, decodeMinSide);
+    }, options);
+
+    if (!tryOpen())
+    {
+        RuntimeError("Cannot use the image cache '%ls'.", cacheFile.c_str());
+    }
+}
+
 ChunkPtr ImageDataDeserializer::GetChunk(ChunkIdType chunkId)
 {
-    auto sequenceDescription = m_imageSequences[chunkId];
-    return std::make_shared<ImageChunk>(sequenceDescription, *this);
+    auto first = m_imageSequences.begin() + chunkId * m_viewsPerImage;
+    std::vector<ImageSequenceDescription> descriptions(first, first + m_viewsPerImage);
+    return std::make_shared<ImageChunk>(std::move(descriptions), *this);
 }
 
 void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders)
@@ -329,7 +459,7 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
     auto r = knownReaders.find(containerPath);
     if (r == knownReaders.end())
     {
-        reader = std::make_shared<ZipByteReader>(containerPath);
+        reader = std::make_shared<ZipByteReader>(containerPath, m_cacheZipIndex);
         knownReaders[containerPath] = reader;
     }
     else
@@ -345,21 +475,128 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
 #endif
 }
 
-cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale)
+cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide)
 {
     assert(!path.empty());
 
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader.Read(seqId, path, grayscale);
-    return (*r).second->Read(seqId, path, grayscale);
+        return m_defaultReader.Read(seqId, path, grayscale, decodeMinSide);
+    return (*r).second->Read(seqId, path, grayscale, decodeMinSide);
 }
 
-cv::Mat FileByteReader::Read(size_t, const std::string& path, bool grayscale)
+cv::Mat FileByteReader::Read(size_t, const std::string& path, bool grayscale, size_t decodeMinSide)
 {
     assert(!path.empty());
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (decodeMinSide == 0)
+    {
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    }
+
+    // The encoded bytes are needed to find out the size of the image before decoding.
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+    {
+        return cv::Mat(); // reported by the caller
+    }
+
+    auto contents = m_workspace.pop_or_create([]() { return std::vector<unsigned char>(); });
+    size_t size = filesize(f);
+    contents.resize(size);
+    size_t bytesRead = size > 0 ? fread(contents.data(), 1, size, f) : 0;
+    fclose(f);
+
+    cv::Mat image;
+    if (bytesRead == size && size > 0)
+    {
+        image = DecodeImage(contents.data(), size, grayscale, decodeMinSide);
+    }
+    m_workspace.push(std::move(contents));
+    return image;
+}
+
+#ifdef CNTK_REDUCED_IMAGE_DECODING
+// Gets the dimensions of a JPEG image from its frame header, returns false if the data is not a JPEG image.
+static bool TryGetJpegSize(const unsigned char* data, size_t size, size_t& width, size_t& height)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+    {
+        return false;
+    }
+
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+        {
+            return false;
+        }
+
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF || marker == 0x01 || (0xD0 <= marker && marker <= 0xD8))
+        {
+            // fill byte or a marker without a segment
+            pos += (marker == 0xFF) ? 1 : 2;
+            continue;
+        }
+
+        if (marker == 0xD9 || marker == 0xDA)
+        {
+            return false; // end of image or start of scan before any frame header
+        }
+
+        // Frame headers are 0xC0 - 0xCF, except for DHT (0xC4), JPG (0xC8) and DAC (0xCC).
+        if (0xC0 <= marker && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (pos + 9 > size)
+            {
+                return false;
+            }
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+        pos += 2 + length;
+    }
+    return false;
+}
+#endif
+
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t decodeMinSide)
+{
+    int flags = grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+#ifdef CNTK_REDUCED_IMAGE_DECODING
+    size_t width, height;
+    if (decodeMinSide > 0 && TryGetJpegSize(data, size, width, height))
+    {
+        size_t shorterSide = std::min(width, height);
+        size_t reduction = 1;
+        while (reduction < 8 && shorterSide / (reduction * 2) >= decodeMinSide)
+        {
+            reduction *= 2;
+        }
+
+        switch (reduction)
+        {
+        case 2:
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+            break;
+        case 4:
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+            break;
+        case 8:
+            flags = grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+            break;
+        }
+    }
+#else
+    UNUSED(decodeMinSide);
+#endif
+
+    return cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, const_cast<unsigned char*>(data)), flags);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
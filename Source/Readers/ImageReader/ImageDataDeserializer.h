@@ -8,6 +8,7 @@
 #include "DataDeserializerBase.h"
 #include "Config.h"
 #include "ByteReader.h"
+#include "ImageCache.h"
 #include <unordered_map>
 #include "CorpusDescriptor.h"
 
@@ -18,6 +19,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // All sequences consist only of a single sample (image/label).
 // For features it uses dense storage format with different layout (dimensions) per sequence.
 // For labels it uses the csc sparse storage format.
+// With multiViewCrop=true, there are 10 sequences (views) per image, which form a chunk; the image is decoded once for them.
+// With imageCache=<file>, the images are decoded and scaled (by imageCacheSide=256, the length of their shorter side)
+// only once into the given image cache, which is rebuilt when it is older than the map file; with
+// imageCacheCompressed=true the cached images are PNG compressed. Distributed jobs should build the cache beforehand.
+// With cacheZipIndex=true, the index of the entries of zip containers is saved next to them for the following runs.
 class ImageDataDeserializer : public DataDeserializerBase
 {
 public:
@@ -44,11 +50,15 @@ private:
     // Creates a set of sequence descriptions.
     void CreateSequenceDescriptions(CorpusDescriptorPtr corpus, std::string mapPath, size_t labelDimension, bool isMultiCrop);
 
+    // Opens the image cache, building it first if needed, and finds the cached image of each sequence.
+    void InitializeImageCache(const std::string& mapPath, const std::wstring& cacheFile, const ImageCache::Options& options);
+
     // Image sequence descriptions. Currently, a sequence contains a single sample only.
     struct ImageSequenceDescription : public SequenceDescription
     {
         std::string m_path;
         size_t m_classId;
+        size_t m_cacheIndex; // index of the image in m_imageCache
     };
 
     class ImageChunk;
@@ -58,9 +68,12 @@ private:
     typedef std::shared_ptr<LabelGenerator> LabelGeneratorPtr;
     LabelGeneratorPtr m_labelGenerator;
 
-    // Sequence descriptions for all input data.
+    // Sequence descriptions for all input data, the views of each image one after the other.
     std::vector<ImageSequenceDescription> m_imageSequences;
 
+    // Number of views of each image, 10 with multiViewCrop, otherwise 1. The views of an image form a chunk.
+    size_t m_viewsPerImage;
+
     // Mapping of logical sequence key into sequence description.
     std::map<size_t, size_t> m_keyToSequence;
 
@@ -70,16 +83,25 @@ private:
     // whether images shall be loaded in grayscale 
     bool m_grayscale;
 
+    // if not 0, JPEG images are decoded at a reduced size whose shorter side is at least that long (see DecodeImage)
+    size_t m_decodeMinSide;
+
+    // whether the central directory index of zip containers is cached next to them (see ZipByteReader)
+    bool m_cacheZipIndex;
+
     // Not using nocase_compare here as it's not correct on Linux.
     using PathReaderMap = std::unordered_map<std::string, std::shared_ptr<ByteReader>>;
     void RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders);
-    cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale);
+    cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide);
 
     // REVIEW alexeyk: can potentially use vector instead of map. Need to handle default reader and resizing though.
     using SeqReaderMap = std::unordered_map<size_t, std::shared_ptr<ByteReader>>;
     SeqReaderMap m_readers;
 
     FileByteReader m_defaultReader;
+
+    // Decoded images, if the deserializer is configured with an image cache.
+    ImageCachePtr m_imageCache;
 };
 
 }}}
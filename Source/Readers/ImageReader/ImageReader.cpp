@@ -62,15 +62,24 @@ ImageReader::ImageReader(MemoryProviderPtr provider,
     ConfigParameters featureStream = config(featureName);
 
     std::vector<Transformation> transformations;
-    transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
-    transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
-
-    if (configHelper.GetDataFormat() == CHW)
+    // Without color and intensity jittering, the remaining transformations are done in one pass per image.
+    bool fuseTransforms = config(L"fuseTransforms", true);
+    if (fuseTransforms && configHelper.GetDataFormat() == CHW && CropScaleMeanTransposeTransformer::CanReplaceTransforms(featureStream))
     {
-        transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<CropScaleMeanTransposeTransformer>(featureStream), featureName });
+    }
+    else
+    {
+        transformations.push_back(Transformation{ std::make_shared<CropTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ScaleTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<ColorTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<IntensityTransformer>(featureStream), featureName });
+        transformations.push_back(Transformation{ std::make_shared<MeanTransformer>(featureStream), featureName });
+
+        if (configHelper.GetDataFormat() == CHW)
+        {
+            transformations.push_back(Transformation{ std::make_shared<TransposeTransformer>(featureStream), featureName });
+        }
     }
 
     m_sequenceEnumerator = std::make_shared<TransformController>(transformations, randomizer);
@@ -103,4 +112,13 @@ Minibatch ImageReader::ReadMinibatch()
     assert(m_packer != nullptr);
     return m_packer->ReadMinibatch();
 }
+
+void ImageReader::SetMemoryProvider(MemoryProviderPtr provider)
+{
+    m_provider = provider;
+    if (m_packer)
+    {
+        m_packer->SetMemoryProvider(provider);
+    }
+}
 } } }
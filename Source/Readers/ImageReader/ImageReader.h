@@ -29,6 +29,9 @@ public:
     // Reads a single minibatch.
     Minibatch ReadMinibatch() override;
 
+    // Sets the memory provider of the minibatch buffers.
+    void SetMemoryProvider(MemoryProviderPtr provider) override;
+
 private:
     // All streams this reader provides.
     std::vector<StreamDescriptionPtr> m_streams;
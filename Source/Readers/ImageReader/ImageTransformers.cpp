@@ -128,6 +128,16 @@ void CropTransformer::StartEpoch(const EpochConfiguration &config)
 }
 
 void CropTransformer::Apply(size_t id, cv::Mat &mat)
+{
+    bool flip;
+    mat = mat(GetCropRect(id, mat.rows, mat.cols, flip));
+    if (flip)
+    {
+        cv::flip(mat, mat, 1);
+    }
+}
+
+cv::Rect CropTransformer::GetCropRect(size_t id, int rows, int cols, bool& flip)
 {
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
@@ -155,14 +165,11 @@ void CropTransformer::Apply(size_t id, cv::Mat &mat)
 
     int viewIndex = m_cropType == CropType::MultiView10 ? (int)(id % 10) : 0;
 
-    mat = mat(GetCropRect(m_cropType, viewIndex, mat.rows, mat.cols, ratio, *rng));
-    if ((m_hFlip && std::bernoulli_distribution()(*rng)) ||
-        viewIndex >= 5)
-    {
-        cv::flip(mat, mat, 1);
-    }
+    cv::Rect rect = GetCropRect(m_cropType, viewIndex, rows, cols, ratio, *rng);
+    flip = (m_hFlip && std::bernoulli_distribution()(*rng)) || viewIndex >= 5;
 
     m_rngs.push(std::move(rng));
+    return rect;
 }
 
 CropTransformer::RatioJitterType
@@ -334,14 +341,19 @@ void ScaleTransformer::Apply(size_t id, cv::Mat &mat)
         mat.convertTo(mat, m_imageElementType);
     }
 
+    cv::resize(mat, mat, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, GetInterpolation());
+}
+
+int ScaleTransformer::GetInterpolation()
+{
     auto seed = GetSeed();
     auto rng = m_rngs.pop_or_create([seed]() { return std::make_unique<std::mt19937>(seed); });
 
     auto index = UniIntT(0, static_cast<int>(m_interp.size()) - 1)(*rng);
     assert(m_interp.size() > 0);
-    cv::resize(mat, mat, cv::Size((int)m_imgWidth, (int)m_imgHeight), 0, 0, m_interp[index]);
 
     m_rngs.push(std::move(rng));
+    return m_interp[index];
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -384,7 +396,8 @@ void MeanTransformer::Apply(size_t id, cv::Mat &mat)
     // REVIEW alexeyk: check type conversion (float/double).
     if (m_meanImg.size() == mat.size())
     {
-        mat = mat - m_meanImg;
+        // in place, to avoid allocating another image
+        cv::subtract(mat, m_meanImg, mat);
     }
 }
 
@@ -425,7 +438,7 @@ SequenceDataPtr TransposeTransformer::Transform(SequenceDataPtr sequence)
 }
 
 // The class represents a sequence that owns an internal data buffer.
-// Passed from the TransposeTransformer.
+// Passed from the TransposeTransformer and the CropScaleMeanTransposeTransformer.
 // TODO: Transposition potentially could be done in place (alexeyk: performance might be much worse than of out-of-place transpose).
 struct DenseSequenceWithBuffer : DenseSequenceData
 {
@@ -480,6 +493,147 @@ SequenceDataPtr TransposeTransformer::TypedTransform(SequenceDataPtr sequence)
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+CropScaleMeanTransposeTransformer::CropScaleMeanTransposeTransformer(const ConfigParameters& config)
+    : m_crop(config), m_scale(config), m_mean(config)
+{
+}
+
+bool CropScaleMeanTransposeTransformer::CanReplaceTransforms(const ConfigParameters& config)
+{
+    // The defaults are those of the color and intensity transformations.
+    auto isZero = [&config](const wchar_t* name) -> bool
+    {
+        doubleargvector values = config(name, ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            if (values[i] != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::wstring intensityFile = config(L"intensityFile", L"");
+    return isZero(L"brightnessRadius") && isZero(L"contrastRadius") && isZero(L"saturationRadius") &&
+           (intensityFile.empty() || isZero(L"intensityStdDev"));
+}
+
+void CropScaleMeanTransposeTransformer::StartEpoch(const EpochConfiguration& config)
+{
+    m_crop.StartEpoch(config);
+}
+
+StreamDescription CropScaleMeanTransposeTransformer::Transform(const StreamDescription& inputStream)
+{
+    m_inputStream = inputStream;
+    if (m_inputStream.m_storageType != StorageType::dense)
+    {
+        LogicError("CropScaleMeanTranspose transformer supports only dense streams.");
+    }
+
+    // The scale transformation gives the HWC layout, and checks the element type.
+    StreamDescription scaled = m_scale.Transform(inputStream);
+    m_outputStream = scaled;
+    ImageDimensions dimensions(*scaled.m_sampleLayout, HWC);
+    m_outputStream.m_sampleLayout = std::make_shared<TensorShape>(dimensions.AsTensorShape(CHW));
+
+    m_meanImage.release();
+    if (!m_mean.GetMeanImage().empty())
+    {
+        m_mean.GetMeanImage().convertTo(m_meanImage, m_inputStream.m_elementType == ElementType::tdouble ? CV_64F : CV_32F);
+    }
+    return m_outputStream;
+}
+
+SequenceDataPtr CropScaleMeanTransposeTransformer::Transform(SequenceDataPtr sequence)
+{
+    if (m_inputStream.m_elementType == ElementType::tdouble)
+    {
+        return TypedTransform<double>(sequence);
+    }
+
+    if (m_inputStream.m_elementType == ElementType::tfloat)
+    {
+        return TypedTransform<float>(sequence);
+    }
+
+    RuntimeError("Unsupported type");
+}
+
+template <class TElemType>
+SequenceDataPtr CropScaleMeanTransposeTransformer::TypedTransform(SequenceDataPtr sequence)
+{
+    auto& inputSequence = static_cast<DenseSequenceData&>(*sequence);
+    assert(inputSequence.m_numberOfSamples == 1);
+
+    ImageDimensions inputDimensions(*inputSequence.m_sampleLayout, HWC);
+    int channels = static_cast<int>(inputDimensions.m_numChannels);
+    int type = CV_MAKETYPE(cv::DataType<TElemType>::depth, channels);
+    cv::Mat image((int)inputDimensions.m_height, (int)inputDimensions.m_width, type, inputSequence.m_data);
+
+    // The same random choices, in the same order, as the crop and the scale transformations.
+    bool flip;
+    cv::Mat source = image(m_crop.GetCropRect(sequence->m_id, image.rows, image.cols, flip));
+    int interpolation = m_scale.GetInterpolation();
+
+    std::unique_ptr<cv::Mat> flipped = m_flipped.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
+    std::unique_ptr<cv::Mat> resized = m_resized.pop_or_create([]() { return std::make_unique<cv::Mat>(); });
+
+    // Flipping the region before resizing it, as the crop transformation does, keeps the results bit exact.
+    if (flip)
+    {
+        cv::flip(source, *flipped, 1);
+        source = *flipped;
+    }
+    cv::resize(source, *resized, cv::Size((int)m_scale.GetWidth(), (int)m_scale.GetHeight()), 0, 0, interpolation);
+    assert(resized->isContinuous());
+
+    size_t planeSize = resized->total();
+    size_t channelCount = resized->channels();
+    auto result = std::make_shared<DenseSequenceWithBuffer>();
+    result->m_buffer.resize(planeSize * channelCount * sizeof(TElemType));
+
+    auto src = resized->ptr<TElemType>();
+    auto dst = reinterpret_cast<TElemType*>(result->m_buffer.data());
+    bool subtractMean = m_meanImage.size() == resized->size() && m_meanImage.channels() == resized->channels();
+    assert(m_meanImage.empty() || subtractMean);
+    if (subtractMean)
+    {
+        auto mean = m_meanImage.ptr<TElemType>();
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            for (size_t c = 0; c < channelCount; c++)
+            {
+                dst[c * planeSize + i] = src[i * channelCount + c] - mean[i * channelCount + c];
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < planeSize; i++)
+        {
+            for (size_t c = 0; c < channelCount; c++)
+            {
+                dst[c * planeSize + i] = src[i * channelCount + c];
+            }
+        }
+    }
+
+    m_flipped.push(std::move(flipped));
+    m_resized.push(std::move(resized));
+
+    ImageDimensions outputDimensions(m_scale.GetWidth(), m_scale.GetHeight(), channelCount);
+    result->m_sampleLayout = ImageDimensions(*m_outputStream.m_sampleLayout, CHW).m_numChannels == channelCount ?
+        m_outputStream.m_sampleLayout :
+        std::make_shared<TensorShape>(outputDimensions.AsTensorShape(CHW));
+    result->m_data = result->m_buffer.data();
+    result->m_numberOfSamples = inputSequence.m_numberOfSamples;
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 IntensityTransformer::IntensityTransformer(const ConfigParameters &config) : ImageTransformerBase(config)
 {
     m_stdDev = config(L"intensityStdDev", ConfigParameters::Array(doubleargvector(vector<double>{0.0})));
@@ -62,6 +62,11 @@ class CropTransformer : public ImageTransformerBase
 public:
     explicit CropTransformer(const ConfigParameters& config);
 
+    void StartEpoch(const EpochConfiguration &config) override;
+
+    // Takes the random choices of the crop of an image: returns its region, and whether it is to be flipped horizontally.
+    cv::Rect GetCropRect(size_t id, int rows, int cols, bool& flip);
+
 private:
     void Apply(size_t id, cv::Mat &mat) override;
 
@@ -74,8 +79,6 @@ private:
         UniArea = 3
     };
 
-    void StartEpoch(const EpochConfiguration &config) override;
-
     RatioJitterType ParseJitterType(const std::string &src);
     cv::Rect GetCropRect(CropType type, int viewIndex, int crow, int ccol, double cropRatio, std::mt19937 &rng);
 
@@ -98,6 +101,12 @@ public:
 
     StreamDescription Transform(const StreamDescription& inputStream) override;
 
+    // Takes the random choice of the interpolation.
+    int GetInterpolation();
+
+    size_t GetWidth() const { return m_imgWidth; }
+    size_t GetHeight() const { return m_imgHeight; }
+
 private:
     void Apply(size_t id, cv::Mat &mat) override;
 
@@ -117,6 +126,9 @@ class MeanTransformer : public ImageTransformerBase
 public:
     explicit MeanTransformer(const ConfigParameters& config);
 
+    // empty if there is no mean file
+    const cv::Mat& GetMeanImage() const { return m_meanImg; }
+
 private:
     void Apply(size_t id, cv::Mat &mat) override;
 
@@ -145,6 +157,43 @@ private:
     StreamDescription m_outputStream;
 };
 
+// Crop, scale, mean and transpose transformations in one pass per image: the crop is resized directly from its region
+// of the input image, and the mean is subtracted while the result is written out in CHW layout, which saves the
+// intermediate images of the separate transformations. The random choices and the values are the same as theirs.
+// ImageReader uses it in their place, if the color and intensity transformations between them do nothing.
+class CropScaleMeanTransposeTransformer : public Transformer
+{
+public:
+    explicit CropScaleMeanTransposeTransformer(const ConfigParameters& config);
+
+    // whether the transformation can replace the separate ones for the given stream configuration
+    static bool CanReplaceTransforms(const ConfigParameters& config);
+
+    void StartEpoch(const EpochConfiguration& config) override;
+
+    // Transformation of the stream.
+    StreamDescription Transform(const StreamDescription& inputStream) override;
+
+    // Transformation of the sequence.
+    SequenceDataPtr Transform(SequenceDataPtr sequence) override;
+
+private:
+    template <class TElement>
+    SequenceDataPtr TypedTransform(SequenceDataPtr inputSequence);
+
+    CropTransformer m_crop;
+    ScaleTransformer m_scale;
+    MeanTransformer m_mean;
+    cv::Mat m_meanImage; // of the element type of the stream
+
+    StreamDescription m_inputStream;
+    StreamDescription m_outputStream;
+
+    // reused per thread
+    conc_stack<std::unique_ptr<cv::Mat>> m_flipped;
+    conc_stack<std::unique_ptr<cv::Mat>> m_resized;
+};
+
 // Intensity jittering based on PCA transform as described in original AlexNet paper
 // (http://papers.nips.cc/paper/4824-imagenet-classification-with-deep-convolutional-neural-networks.pdf)
 // Currently uses precomputed values from 
@@ -4,8 +4,12 @@
 //
 
 #include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include <opencv2/opencv.hpp>
 #include "ByteReader.h"
+#include "StringUtil.h"
+#include "fileutil.h"
 
 #ifdef USE_ZIP
 
@@ -20,8 +24,49 @@ std::string GetZipError(int err)
     return errS;
 }
 
-ZipByteReader::ZipByteReader(const std::string& zipPath)
-    : m_zipPath(zipPath)
+// The records of the zip format that are needed to find the entries (all integers are little-endian).
+const uint32_t c_endOfCentralDirectorySignature = 0x06054b50;
+const uint32_t c_zip64EndOfCentralDirectorySignature = 0x06064b50;
+const uint32_t c_zip64LocatorSignature = 0x07064b50;
+const uint32_t c_centralDirectoryEntrySignature = 0x02014b50;
+const uint32_t c_localHeaderSignature = 0x04034b50;
+const size_t c_endOfCentralDirectorySize = 22;
+const size_t c_zip64EndOfCentralDirectorySize = 56;
+const size_t c_zip64LocatorSize = 20;
+const size_t c_centralDirectoryEntrySize = 46;
+const size_t c_localHeaderSize = 30;
+const uint16_t c_zip64ExtraFieldId = 1;
+const uint32_t c_encryptedFlag = 1;
+const uint32_t c_unknownMethod = 0xFFFFFFFF;
+
+const uint32_t c_zipIndexMagic = 0x58495A43; // "CZIX"
+const uint32_t c_zipIndexVersion = 1;
+
+struct ZipIndexHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint64_t m_zipSize;
+    uint64_t m_numberOfEntries;
+};
+
+static uint16_t Get16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t Get32(const unsigned char* p)
+{
+    return (uint32_t)Get16(p) | ((uint32_t)Get16(p + 2) << 16);
+}
+
+static uint64_t Get64(const unsigned char* p)
+{
+    return (uint64_t)Get32(p) | ((uint64_t)Get32(p + 4) << 32);
+}
+
+ZipByteReader::ZipByteReader(const std::string& zipPath, bool cacheIndex)
+    : m_zipPath(zipPath), m_cacheIndex(cacheIndex)
 {
     assert(!m_zipPath.empty());
 }
@@ -44,27 +89,310 @@ ZipByteReader::ZipPtr ZipByteReader::OpenZip()
     });
 }
 
+void ZipByteReader::BuildIndex()
+{
+    m_file = std::make_shared<MemoryMappedFile>(msra::strfun::utf16(m_zipPath));
+    if (m_cacheIndex && TryLoadIndex())
+    {
+        return;
+    }
+
+    if (!ParseCentralDirectory())
+    {
+        // All entries are looked up with libzip then.
+        fprintf(stderr, "WARNING: Cannot parse the central directory of %s, using the zip library only.\n", m_zipPath.c_str());
+        m_entries.clear();
+        m_nameToEntry.clear();
+        return;
+    }
+
+    if (m_cacheIndex)
+    {
+        SaveIndex();
+    }
+}
+
+bool ZipByteReader::ParseCentralDirectory()
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(m_file->Data());
+    size_t size = m_file->Size();
+    if (size < c_endOfCentralDirectorySize)
+    {
+        return false;
+    }
+
+    // The end of central directory record is at the end of the file, followed only by a comment of at most 64K.
+    size_t eocd = size - c_endOfCentralDirectorySize;
+    size_t lowest = eocd > 0xFFFF ? eocd - 0xFFFF : 0;
+    while (Get32(data + eocd) != c_endOfCentralDirectorySignature)
+    {
+        if (eocd == lowest)
+        {
+            return false;
+        }
+        eocd--;
+    }
+
+    uint64_t numberOfEntries = Get16(data + eocd + 10);
+    uint64_t directorySize = Get32(data + eocd + 12);
+    uint64_t directoryOffset = Get32(data + eocd + 16);
+    if (numberOfEntries == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF)
+    {
+        // ZIP64, the locator of its end of central directory record precedes the one above.
+        if (eocd < c_zip64LocatorSize || Get32(data + eocd - c_zip64LocatorSize) != c_zip64LocatorSignature)
+        {
+            return false;
+        }
+
+        uint64_t zip64Eocd = Get64(data + eocd - c_zip64LocatorSize + 8);
+        if (zip64Eocd + c_zip64EndOfCentralDirectorySize > size || Get32(data + zip64Eocd) != c_zip64EndOfCentralDirectorySignature)
+        {
+            return false;
+        }
+
+        numberOfEntries = Get64(data + zip64Eocd + 32);
+        directorySize = Get64(data + zip64Eocd + 40);
+        directoryOffset = Get64(data + zip64Eocd + 48);
+    }
+
+    if (directoryOffset + directorySize > size)
+    {
+        return false;
+    }
+
+    m_entries.reserve(numberOfEntries);
+    m_nameToEntry.reserve(numberOfEntries);
+    const unsigned char* p = data + directoryOffset;
+    const unsigned char* end = p + directorySize;
+    for (uint64_t i = 0; i < numberOfEntries; ++i)
+    {
+        if (p + c_centralDirectoryEntrySize > end || Get32(p) != c_centralDirectoryEntrySignature)
+        {
+            return false;
+        }
+
+        size_t nameLength = Get16(p + 28);
+        size_t extraLength = Get16(p + 30);
+        size_t commentLength = Get16(p + 32);
+        const unsigned char* next = p + c_centralDirectoryEntrySize + nameLength + extraLength + commentLength;
+        if (next > end)
+        {
+            return false;
+        }
+
+        Entry entry;
+        entry.m_flags = Get16(p + 8);
+        entry.m_method = Get16(p + 10);
+        entry.m_compressedSize = Get32(p + 20);
+        entry.m_size = Get32(p + 24);
+        entry.m_localHeaderOffset = Get32(p + 42);
+        entry.m_index = i;
+
+        // Values that do not fit 32 bits are in the ZIP64 extra field, in this order.
+        const unsigned char* extra = p + c_centralDirectoryEntrySize + nameLength;
+        const unsigned char* extraEnd = extra + extraLength;
+        while (extra + 4 <= extraEnd)
+        {
+            const unsigned char* field = extra + 4;
+            const unsigned char* fieldEnd = field + Get16(extra + 2);
+            if (fieldEnd > extraEnd)
+            {
+                break;
+            }
+
+            if (Get16(extra) == c_zip64ExtraFieldId)
+            {
+                for (uint64_t* value : { &entry.m_size, &entry.m_compressedSize, &entry.m_localHeaderOffset })
+                {
+                    if (*value == 0xFFFFFFFF && field + 8 <= fieldEnd)
+                    {
+                        *value = Get64(field);
+                        field += 8;
+                    }
+                }
+            }
+            extra = fieldEnd;
+        }
+
+        m_nameToEntry[std::string(reinterpret_cast<const char*>(p + c_centralDirectoryEntrySize), nameLength)] = m_entries.size();
+        m_entries.push_back(entry);
+        p = next;
+    }
+    return true;
+}
+
+std::wstring ZipByteReader::GetIndexFilePath() const
+{
+    return msra::strfun::utf16(m_zipPath) + L".index";
+}
+
+bool ZipByteReader::TryLoadIndex()
+{
+    auto indexFile = GetIndexFilePath();
+    if (!msra::files::fuptodate(indexFile, msra::strfun::utf16(m_zipPath)))
+    {
+        return false;
+    }
+
+    FILE* f = nullptr;
+    try
+    {
+        f = fopenOrDie(indexFile, L"rbS");
+        ZipIndexHeader header;
+        freadOrDie(&header, sizeof(header), 1, f);
+        if (header.m_magic != c_zipIndexMagic || header.m_version != c_zipIndexVersion || header.m_zipSize != m_file->Size())
+        {
+            fclose(f);
+            return false;
+        }
+
+        m_entries.resize(header.m_numberOfEntries);
+        m_nameToEntry.reserve(header.m_numberOfEntries);
+        std::string name;
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            uint32_t nameLength;
+            freadOrDie(&m_entries[i], sizeof(Entry), 1, f);
+            freadOrDie(&nameLength, sizeof(nameLength), 1, f);
+            name.resize(nameLength);
+            if (nameLength > 0)
+            {
+                freadOrDie(&name[0], 1, nameLength, f);
+            }
+            m_nameToEntry[name] = i;
+        }
+        fclose(f);
+
+        fprintf(stderr, "Loaded the index of %" PRIu64 " entries of %s from '%ls'.\n", m_entries.size(), m_zipPath.c_str(), indexFile.c_str());
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        if (f)
+        {
+            fclose(f);
+        }
+        fprintf(stderr, "WARNING: Ignoring the index cache '%ls': %s\n", indexFile.c_str(), e.what());
+        m_entries.clear();
+        m_nameToEntry.clear();
+        return false;
+    }
+}
+
+void ZipByteReader::SaveIndex()
+{
+    // Written under a temporary name first, so that an interrupted write is never mistaken for a valid cache.
+    auto indexFile = GetIndexFilePath();
+    auto tempFile = indexFile + L".tmp";
+    FILE* f = nullptr;
+    try
+    {
+        std::vector<const std::string*> names(m_entries.size());
+        for (const auto& e : m_nameToEntry)
+        {
+            names[e.second] = &e.first;
+        }
+
+        f = fopenOrDie(tempFile, L"wbS");
+        ZipIndexHeader header = {};
+        header.m_magic = c_zipIndexMagic;
+        header.m_version = c_zipIndexVersion;
+        header.m_zipSize = m_file->Size();
+        header.m_numberOfEntries = m_entries.size();
+        fwriteOrDie(&header, sizeof(header), 1, f);
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            // An entry whose name is repeated later in the directory is never looked up.
+            static const std::string noName;
+            const std::string& name = names[i] ? *names[i] : noName;
+            uint32_t nameLength = (uint32_t)name.size();
+            fwriteOrDie(&m_entries[i], sizeof(Entry), 1, f);
+            fwriteOrDie(&nameLength, sizeof(nameLength), 1, f);
+            if (nameLength > 0)
+            {
+                fwriteOrDie(name.data(), 1, nameLength, f);
+            }
+        }
+        fcloseOrDie(f);
+        f = nullptr;
+        renameOrDie(tempFile, indexFile);
+    }
+    catch (const std::exception& e)
+    {
+        if (f)
+        {
+            fclose(f);
+        }
+        fprintf(stderr, "WARNING: Could not save the index cache '%ls': %s\n", indexFile.c_str(), e.what());
+    }
+}
+
 void ZipByteReader::Register(size_t seqId, const std::string& path)
 {
+    if (!m_file)
+    {
+        BuildIndex();
+    }
+
+    auto known = m_nameToEntry.find(path);
+    if (known != m_nameToEntry.end())
+    {
+        m_seqIdToEntry[seqId] = known->second;
+        return;
+    }
+
+    // Not in the central directory as parsed above, libzip may still know the entry.
     auto zipFile = m_zips.pop_or_create([this]() { return OpenZip(); });
     zip_stat_t stat;
     zip_stat_init(&stat);
     int err = zip_stat(zipFile.get(), path.c_str(), 0, &stat);
     if (ZIP_ER_OK != err)
         RuntimeError("Failed to get file info of %s, zip library error: %s", path.c_str(), GetZipError(err).c_str());
-    m_seqIdToIndex[seqId] = std::make_pair(stat.index, stat.size);
     m_zips.push(std::move(zipFile));
+
+    Entry entry = {};
+    entry.m_index = stat.index;
+    entry.m_size = stat.size;
+    entry.m_method = c_unknownMethod;
+    m_nameToEntry[path] = m_entries.size();
+    m_seqIdToEntry[seqId] = m_entries.size();
+    m_entries.push_back(entry);
+}
+
+const unsigned char* ZipByteReader::GetStoredData(const Entry& entry, const std::string& path) const
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(m_file->Data());
+    size_t size = m_file->Size();
+    uint64_t header = entry.m_localHeaderOffset;
+    if (header + c_localHeaderSize > size || Get32(data + header) != c_localHeaderSignature)
+    {
+        RuntimeError("Invalid local header of file %s in the zip file %s", path.c_str(), m_zipPath.c_str());
+    }
+
+    uint64_t offset = header + c_localHeaderSize + Get16(data + header + 26) + Get16(data + header + 28);
+    if (offset + entry.m_size > size)
+    {
+        RuntimeError("File %s exceeds the end of the zip file %s", path.c_str(), m_zipPath.c_str());
+    }
+    return data + offset;
 }
 
-cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale)
+cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide)
 {
     // Find index of the file in .zip file.
-    auto r = m_seqIdToIndex.find(seqId);
-    if (r == m_seqIdToIndex.end())
+    auto r = m_seqIdToEntry.find(seqId);
+    if (r == m_seqIdToEntry.end())
         RuntimeError("Could not find file %s in the zip file, sequence id = %lu", path.c_str(), (long)seqId);
 
-    zip_uint64_t index = std::get<0>((*r).second);
-    zip_uint64_t size = std::get<1>((*r).second);
+    const Entry& entry = m_entries[r->second];
+    if (entry.m_method == ZIP_CM_STORE && (entry.m_flags & c_encryptedFlag) == 0)
+    {
+        // No lock and no copy: the image is decoded from the mapping.
+        return DecodeImage(GetStoredData(entry, path), entry.m_size, grayscale, decodeMinSide);
+    }
+
+    zip_uint64_t index = entry.m_index;
+    zip_uint64_t size = entry.m_size;
 
     auto contents = m_workspace.pop_or_create([size]() { return vector<unsigned char>(size); });
     if (contents.size() < size)
@@ -99,8 +427,7 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
     }
     m_zips.push(std::move(zipFile));
 
-    cv::Mat img; 
-    img = cv::imdecode(cv::Mat(1, (int)size, CV_8UC1, contents.data()), grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    cv::Mat img = DecodeImage(contents.data(), size, grayscale, decodeMinSide);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
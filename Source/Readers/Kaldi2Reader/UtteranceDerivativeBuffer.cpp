@@ -138,11 +138,7 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
                 m_uttPool[uttID].progress += numFrames;
                 if (m_uttPool[uttID].progress == m_uttPool[uttID].uttLength)
                 {
-                    m_derivativeInterface->ComputeDerivative(
-                        uttID,
-                        m_uttPool[uttID].logLikelihood,
-                        &m_uttPool[uttID].derivative,
-                        &m_uttPool[uttID].objective);
+                    ComputeDerivativeAsync(uttID, m_uttPool[uttID]);
                     m_uttPool[uttID].hasDerivative = true;
                     m_uttPool[uttID].progress = 0;
                     m_uttReady[m_uttPool[uttID].streamID] = true;
@@ -161,6 +157,35 @@ bool UtteranceDerivativeBuffer<ElemType>::SetLikelihood(
             break;
         }
     }
+    return true;
+}
+
+// The derivative is computed into the unit itself. This is safe while the unit
+// is in <m_uttPool>, because references to the elements of an unordered_map stay
+// valid when other elements are inserted, and the unit is only erased after its
+// derivative has been waited for.
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::ComputeDerivativeAsync(
+    const wstring& uttID, UtteranceDerivativeUnit& uttUnit)
+{
+    uttUnit.pendingDerivative = std::async(std::launch::async, [this, uttID, &uttUnit]()
+    {
+        std::lock_guard<std::mutex> lock(m_derivativeLock);
+        m_derivativeInterface->ComputeDerivative(
+            uttID, uttUnit.logLikelihood, &uttUnit.derivative, &uttUnit.objective);
+    });
+}
+
+template <class ElemType>
+void UtteranceDerivativeBuffer<ElemType>::WaitForDerivatives()
+{
+    for (auto& utt : m_uttPool)
+    {
+        if (utt.second.pendingDerivative.valid())
+        {
+            utt.second.pendingDerivative.wait();
+        }
+    }
 }
 
 // Suppose we have a, b, c 3 streams, the <derivativesOut> should be in the
@@ -198,6 +223,12 @@ bool UtteranceDerivativeBuffer<ElemType>::GetDerivative(
                              uttID.c_str());
             }
 
+            // Waits for the computation to finish, this rethrows its errors.
+            if (m_uttPool[uttID].pendingDerivative.valid())
+            {
+                m_uttPool[uttID].pendingDerivative.get();
+            }
+
             // Assign the derivatives.
             assert(uttID == uttInfoInMinibatch[i][j].first);
             size_t startFrame = uttInfoInMinibatch[i][j].second.first;
@@ -270,6 +301,7 @@ template <class ElemType>
 bool UtteranceDerivativeBuffer<ElemType>::HasResourceForDerivative(
     const wstring& uttID) const
 {
+    std::lock_guard<std::mutex> lock(m_derivativeLock);
     return m_derivativeInterface->HasResourceForDerivative(uttID);
 }
 
@@ -309,6 +341,7 @@ bool UtteranceDerivativeBuffer<ElemType>::CompareUttInfo(
 template <class ElemType>
 void UtteranceDerivativeBuffer<ElemType>::ResetEpoch()
 {
+    WaitForDerivatives();
     m_needLikelihood = true;
     m_currentObj = 0;
     m_epochEnd = false;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <future>
+#include <mutex>
 #include "Matrix.h"
 #include "basetypes.h"
 #include "Sequences.h"
@@ -10,6 +12,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // This class "gules" together the log-likelihood from different minibatches,
 // and then calls <UtteranceDerivativeComputationInterface> class to compute
 // the derivative for given utterance.
+// The derivative of an utterance is computed in the background as soon as its
+// log-likelihood is complete, so that it overlaps with the forward pass of the
+// following minibatches. The computations run one at a time, since the
+// derivative interface is not thread-safe, and are waited for in GetDerivative().
 template <class ElemType>
 class UtteranceDerivativeBuffer
 {
@@ -24,6 +30,11 @@ private:
         Matrix<ElemType> derivative;
         ElemType objective;
 
+        // Computation of <derivative> and <objective>, valid once hasDerivative
+        // is set. Declared last so that it is waited for before the matrices
+        // it writes are destroyed.
+        std::future<void> pendingDerivative;
+
         UtteranceDerivativeUnit()
             : logLikelihood(CPUDEVICE), derivative(CPUDEVICE)
         {
@@ -45,6 +56,15 @@ private:
     unordered_map<wstring, UtteranceDerivativeUnit> m_uttPool;
     UtteranceDerivativeComputationInterface<ElemType>* m_derivativeInterface;
 
+    // Serializes the calls into <m_derivativeInterface>.
+    mutable std::mutex m_derivativeLock;
+
+    // Starts computing the derivative of <uttUnit> in the background.
+    void ComputeDerivativeAsync(const wstring& uttID, UtteranceDerivativeUnit& uttUnit);
+
+    // Waits for all derivatives that are being computed.
+    void WaitForDerivatives();
+
     // <uttInfoInMinibatch> is a vector of vector of the following:
     //     uttID startFrameIndexInMinibatch numFrames
     void ProcessUttInfo(
@@ -67,6 +87,7 @@ public:
     // Destructor.
     ~UtteranceDerivativeBuffer()
     {
+        WaitForDerivatives();
     }
 
     bool NeedLikelihoodToComputeDerivative() const
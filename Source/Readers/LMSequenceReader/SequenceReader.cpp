@@ -1585,11 +1585,101 @@ void BatchSequenceReader<ElemType>::Reset()
     mLastPosInSentence = 0;
     mNumRead = 0;
 
-    if (m_labelTemp.size() > 0)
-        m_labelTemp.clear();
-    if (m_featureTemp.size() > 0)
-        m_featureTemp.clear();
+    m_block = CacheBlock();
+}
+
+// read the next cache block from the parser and map its words to their ids
+// This runs on the prefetch thread, so it only uses the parser, the block and the vocabularies.
+template <class ElemType>
+void BatchSequenceReader<ElemType>::ReadCacheBlock(CacheBlock& block, bool fromStart)
+{
+    if (fromStart)
+        m_parser.ParseReset();
+
+    std::vector<LabelType> labels;
+    std::vector<ElemType> features;
+    std::vector<SequencePosition> seqPos;
     m_parser.mSentenceIndex2SentenceInfo.clear();
+    block = CacheBlock();
+    block.m_numRead = m_parser.Parse(m_cacheBlockSize, &labels, &features, &seqPos);
+    block.m_sentences.swap(m_parser.mSentenceIndex2SentenceInfo);
+    block.m_fromStart = fromStart;
+    if (block.m_numRead == 0)
+        return;
+
+    const LabelInfo& labelIn = m_labelInfo[labelInfoIn];
+    const LabelInfo& labelOut = m_labelInfo[labelInfoOut];
+    if (labelIn.type != labelCategory)
+        RuntimeError("Input labels are expected to be category labels.");
+
+    // map all words through a hash of the vocabulary, words that are not in it map to <unk>
+    auto mapWords = [&](const LabelInfo& labelInfo, bool nextWord, std::vector<LabelIdType>& ids)
+    {
+        std::unordered_map<LabelType, LabelIdType> vocabulary(labelInfo.mapLabelToId.begin(), labelInfo.mapLabelToId.end());
+        auto unk = vocabulary.find(mUnk);
+        ids.resize(labels.size());
+        for (size_t pos = 0; pos < labels.size(); pos++)
+        {
+            // the end symbol of a next-word label may differ between input and output
+            const LabelType& word = nextWord && EqualCI(labels[pos], labelInfo.endSequence) ? labelInfo.endSequence : labels[pos];
+            auto found = vocabulary.find(word);
+            if (found == vocabulary.end())
+                found = unk;
+            if (found == vocabulary.end())
+            {
+                ids[pos] = unknownWordId;
+                block.m_unknownWords[pos] = word;
+            }
+            else
+                ids[pos] = found->second;
+        }
+    };
+
+    mapWords(labelIn, false, block.m_inputIds);
+    if (labelOut.type == labelCategory)
+        mapWords(labelOut, false, block.m_outputIds);
+    else if (labelOut.type == labelNextWord)
+        mapWords(labelIn, true, block.m_outputIds);
+}
+
+// start reading the next cache block in the background
+// At the end of the data, the block is the first one of the next epoch.
+template <class ElemType>
+void BatchSequenceReader<ElemType>::StartPrefetch(bool fromStart)
+{
+    assert(!m_prefetch.valid() && !m_nextBlockReady);
+    m_prefetch = std::async(std::launch::async, [this, fromStart]()
+    {
+        ReadCacheBlock(m_nextBlock, fromStart);
+    });
+}
+
+// make the next cache block the current one, reading it now if it has not been read ahead
+template <class ElemType>
+void BatchSequenceReader<ElemType>::TakeCacheBlock()
+{
+    if (m_prefetch.valid())
+    {
+        m_prefetch.get(); // rethrows errors of the prefetch thread
+        m_nextBlockReady = true;
+    }
+
+    if (m_nextBlockReady)
+    {
+        std::swap(m_block, m_nextBlock);
+        m_nextBlockReady = false;
+    }
+    else
+        ReadCacheBlock(m_block, false);
+}
+
+template <class ElemType>
+typename BatchSequenceReader<ElemType>::LabelIdType BatchSequenceReader<ElemType>::GetWordId(const std::vector<LabelIdType>& ids, size_t pos) const
+{
+    LabelIdType id = ids[pos];
+    if (id == unknownWordId)
+        RuntimeError("%s not in vocabulary", m_block.m_unknownWords.at(pos).c_str());
+    return id;
 }
 
 template <class ElemType>
@@ -1672,7 +1762,17 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     m_clsinfoRead = false;
     m_idx2clsRead = false;
 
-    m_parser.ParseReset();
+    // Each epoch starts over at the beginning of the file. A block that was read ahead is only kept if it is the first one.
+    if (m_prefetch.valid())
+    {
+        m_prefetch.get();
+        m_nextBlockReady = true;
+    }
+    if (!m_nextBlockReady || !m_nextBlock.m_fromStart)
+    {
+        m_nextBlockReady = false;
+        m_parser.ParseReset();
+    }
 
     Reset();
 }
@@ -1717,7 +1817,7 @@ size_t BatchSequenceReader<ElemType>::DetermineSequencesToProcess()
     if (mToProcess.size() > 0)
     {
         // They are all the same length, so we can just get the value from the first entry.
-        return m_parser.mSentenceIndex2SentenceInfo[mToProcess[0]].sLen;
+        return m_block.m_sentences[mToProcess[0]].sLen;
     }
 
     // mToProcess[] is empty: fill it up with at most mRequestedNumParallelSequences entries of the same length
@@ -1736,8 +1836,8 @@ size_t BatchSequenceReader<ElemType>::DetermineSequencesToProcess()
 
         // first unprocessed sequence determines the length if this minibatch
         if (sln == 0)
-            sln = m_parser.mSentenceIndex2SentenceInfo[seq].sLen;
-        else if (sln != m_parser.mSentenceIndex2SentenceInfo[seq].sLen)
+            sln = m_block.m_sentences[seq].sLen;
+        else if (sln != m_block.m_sentences[seq].sLen)
             continue;
 
         // check max tokens
@@ -1748,7 +1848,7 @@ size_t BatchSequenceReader<ElemType>::DetermineSequencesToProcess()
         mToProcess.push_back(seq);
 
         // and count tokens
-        numTokens += m_parser.mSentenceIndex2SentenceInfo[seq].sLen;
+        numTokens += m_block.m_sentences[seq].sLen;
     }
     // if all were already done, we will get here with sln=0 and return that
 
@@ -1783,11 +1883,14 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
     {
         Reset();
 
-        std::vector<SequencePosition> seqPos;
         fprintf(stderr, "LMSequenceReader: Reading epoch data..."), fflush(stderr);
-        mNumRead = m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
+        TakeCacheBlock();
+        mNumRead = m_block.m_numRead;
         fprintf(stderr, " %d sequences read.\n", (int) mNumRead);
         firstPosInSentence = mLastPosInSentence;
+
+        // read the next block while this one is being returned; after the end of the data, that is the first block of the next epoch
+        StartPrefetch(mNumRead == 0);
         if (mNumRead == 0)
             return false; // end
 
@@ -1795,14 +1898,14 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
         if (m_cacheBlockSize == 50000)
         {
             srand(++m_randomSeed); // TODO: older code did not have that; so no idea what random seed was used
-            std::random_shuffle(m_parser.mSentenceIndex2SentenceInfo.begin(), m_parser.mSentenceIndex2SentenceInfo.end());
+            std::random_shuffle(m_block.m_sentences.begin(), m_block.m_sentences.end());
             // Note: random_shuffle is deprecated since C++14.
         }
         else // new configs use a wider randomization
 #endif
         {
             std::mt19937 g(++m_randomSeed); // random seed is initialized to epoch, but gets incremented for intermediate reshuffles
-            std::shuffle(m_parser.mSentenceIndex2SentenceInfo.begin(), m_parser.mSentenceIndex2SentenceInfo.end(), g);
+            std::shuffle(m_block.m_sentences.begin(), m_block.m_sentences.end(), g);
         }
 
         m_readNextSampleLine += mNumRead;
@@ -1828,46 +1931,24 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
         for (int k = 0; k < mToProcess.size(); k++)
         {
             size_t seq = mToProcess[k];
-            size_t pos = m_parser.mSentenceIndex2SentenceInfo[seq].sBegin + i;
+            size_t pos = m_block.m_sentences[seq].sBegin + i;
 
-            // labelIn should be a category label
-            const auto& labelValue = m_labelTemp[pos];
+            // generate the feature token (labelIn is a category label, checked when the block was read)
+            LabelIdType labelId = GetWordId(m_block.m_inputIds, pos);
             pos++; // consume it
 
-            // generate the feature token
-            if (labelIn.type == labelCategory)
-            {
-                LabelIdType labelId = GetIdFromLabel(labelValue, labelIn);
-
-                // use the found value, and set the appropriate location to a 1.0
-                assert(labelIn.dim > labelId); // if this goes off labelOut dimension is too small
-                m_featureData.push_back((float) labelId);
-            }
-            else
-                RuntimeError("Input labels are expected to be category labels.");
+            // use the found value, and set the appropriate location to a 1.0
+            assert(labelIn.dim > labelId); // if this goes off labelOut dimension is too small
+            m_featureData.push_back((float) labelId);
 
             // generate the output label token
             if (labelOut.type != labelNone)
             {
-                const auto& labelValue = m_labelTemp[pos];
-                LabelIdType labelId;
-                if (labelOut.type == labelCategory)
-                {
-                    pos++; // consume it   --TODO: value is not used after this
-                    labelId = GetIdFromLabel(labelValue, labelOut);
-                }
-                else if (nextWord)
-                {
-                    // this is the next word (pos was already incremented above when reading out labelValue)
-                    if (EqualCI(labelValue, labelIn.endSequence)) // end symbol may differ between input and output
-                        labelId = GetIdFromLabel(labelIn.endSequence, labelIn);
-                    else
-                        labelId = GetIdFromLabel(labelValue, labelIn);
-                }
-                else
+                // for labelCategory this is the output label of the word, for nextWord the next word (pos was already incremented above)
+                if (labelOut.type != labelCategory && !nextWord)
                     LogicError("Unexpected output label type."); // should never get here
 
-                m_labelIdData.push_back(labelId);
+                m_labelIdData.push_back(GetWordId(m_block.m_outputIds, pos));
             }
 
             m_totalSamples++;
@@ -1929,7 +2010,7 @@ bool BatchSequenceReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matri
     {
         size_t seq = mToProcess[s];
         const LabelInfo& labelOut = m_labelInfo[labelInfoOut];
-        size_t len = m_parser.mSentenceIndex2SentenceInfo[seq].sLen - (labelOut.type != labelNone); // -1 because last one is label
+        size_t len = m_block.m_sentences[seq].sLen - (labelOut.type != labelNone); // -1 because last one is label
         // ############### BREAKING CHANGE ################
         // We use sLen, not sLen -1, if labelOut.type is labelNode, assuming there is no output label, and all labels are inputs.
         // ############### BREAKING CHANGE ################
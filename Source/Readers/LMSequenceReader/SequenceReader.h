@@ -14,8 +14,10 @@
 #include "RandomOrdering.h"
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <random>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -368,8 +370,23 @@ private:
     size_t mLastPosInSentence;
     size_t m_truncationLength;     // sequences longer than this get chopped up
 
-    std::vector<ElemType> m_featureTemp;
-    std::vector<LabelType> m_labelTemp;
+    // A cache block of sentences, with its words already mapped to their ids, so that only integers are touched per minibatch.
+    // The next block is read and mapped on a background thread while the current one is returned.
+    struct CacheBlock
+    {
+        std::vector<SentenceInfo> m_sentences;       // [sentence] position and length of the sentence in the id arrays
+        std::vector<LabelIdType> m_inputIds;         // [word] id of the word in the input vocabulary
+        std::vector<LabelIdType> m_outputIds;        // [word] id of the word as an output label (empty for labelNone)
+        std::map<size_t, LabelType> m_unknownWords;  // [word] words without an id, reported only if they are used
+        size_t m_numRead = 0;                        // number of sentences, 0 at the end of the data
+        bool m_fromStart = false;                    // read from the beginning of the file, i.e. it is the first block of an epoch
+    };
+    static const LabelIdType unknownWordId = (LabelIdType) -1;
+
+    CacheBlock m_block;            // block that is currently returned
+    CacheBlock m_nextBlock;        // block read ahead
+    bool m_nextBlockReady = false; // m_nextBlock holds a complete block
+    std::future<void> m_prefetch;  // reads m_nextBlock, the parser must not be used while it is pending
 
     bool mSentenceEnd;
     //bool mSentenceBegin;
@@ -388,6 +405,11 @@ public:
         mNumRead = 0;
         mSentenceEnd = false;
     }
+    ~BatchSequenceReader()
+    {
+        if (m_prefetch.valid())
+            m_prefetch.wait();
+    }
 
     template <class ConfigRecordType>
     void InitFromConfig(const ConfigRecordType&);
@@ -401,6 +423,10 @@ public:
     }
 private:
     void Reset();
+    void ReadCacheBlock(CacheBlock& block, bool fromStart);
+    void StartPrefetch(bool fromStart);
+    void TakeCacheBlock();
+    LabelIdType GetWordId(const std::vector<LabelIdType>& ids, size_t pos) const;
     size_t DetermineSequencesToProcess();
     bool GetMinibatchData(size_t& firstPosInSentence);
     void GetLabelOutput(StreamMinibatchInputs& matrices, size_t m_mbStartSample, size_t actualmbsize);
@@ -208,7 +208,8 @@ void SparseBinaryMatrix<ElemType>::Fill(Matrix<ElemType>* matrix)
 
 template <class ElemType>
 SparseBinaryInput<ElemType>::SparseBinaryInput(std::wstring fileName)
-    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0)
+    : m_fileName(fileName), m_readOrder(nullptr), m_readOrderLength(0), m_randomize(false), m_tempValues(nullptr), m_tempValuesSize(0), m_offsets(nullptr), m_offsetsStart(0), m_startMB(0), m_endMB(0),
+      m_numReaderThreads(1), m_keepDataOrder(true), m_stopReading(false), m_nextToRead(0)
 {
     std::string name = msra::strfun::utf8(m_fileName);
     m_inFile.open(name, ifstream::binary | ifstream::in);
@@ -217,6 +218,7 @@ SparseBinaryInput<ElemType>::SparseBinaryInput(std::wstring fileName)
 template <class ElemType>
 SparseBinaryInput<ElemType>::~SparseBinaryInput()
 {
+    StopReaders();
 }
 
 template <class ElemType>
@@ -386,6 +388,8 @@ void SparseBinaryInput<ElemType>::Shuffle()
 template <class ElemType>
 void SparseBinaryInput<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, size_t subsetNum, size_t numSubsets)
 {
+    // the readers of the previous epoch may still be running if it has not been read to the end
+    StopReaders();
 
     m_nextMB = 0;
 
@@ -429,26 +433,52 @@ void SparseBinaryInput<ElemType>::StartDistributedMinibatchLoop(size_t mbSize, s
     if (maxMBSize > m_maxMBSize)
     {
         m_maxMBSize = maxMBSize;
-        while (m_dataToProduce.size() > 0)
+        void* freeBuffer;
+        while (m_dataToProduce && m_dataToProduce->TryPop(freeBuffer))
         {
-            free(m_dataToProduce.pop());
+            free(freeBuffer);
         }
         // fprintf(stderr, "max mb size: %ld\n", m_maxMBSize);
 
         size_t maxMem = 1024 * 1024 * 1024; // 1GB
         size_t maxPointers = maxMem / m_maxMBSize;
+        m_dataToProduce.reset(new MPMCQueue<void*>(maxPointers));
         for (size_t c = 0; c < maxPointers; c++)
         {
             void* dataBuffer = malloc(m_maxMBSize);
-            m_dataToProduce.push(dataBuffer);
+            m_dataToProduce->Push(dataBuffer);
         }
     }
 
-    std::thread readData([this]
-                         {
-                             this->ReadMinibatches(m_readOrder, m_readOrderLength);
-                         });
-    readData.detach();
+    m_nextToRead = 0;
+    for (size_t c = 0; c < m_numReaderThreads; c++)
+    {
+        m_readers.push_back(std::thread([this]
+                                        {
+                                            this->ReadMinibatches(m_readOrderLength);
+                                        }));
+    }
+}
+
+// stop the reader threads and return the buffers they have read to the free ones
+template <class ElemType>
+void SparseBinaryInput<ElemType>::StopReaders()
+{
+    m_stopReading = true;
+
+    // a reader may be waiting for a free buffer, it returns it right away
+    {
+        std::lock_guard<std::mutex> lock(m_readLock);
+        for (auto& buffer : m_readBuffers)
+            m_dataToProduce->Push(buffer.second);
+        m_readBuffers.clear();
+    }
+
+    for (auto& reader : m_readers)
+        reader.join();
+    m_readers.clear();
+
+    m_stopReading = false;
 }
 template <class ElemType>
 void* SparseBinaryInput<ElemType>::GetTempDataPointer(size_t numBytes)
@@ -485,51 +515,68 @@ shared_ptr<BinaryMatrix<ElemType>> SparseBinaryInput<ElemType>::CreateMatrix(std
 }
 
 template <class ElemType>
-void SparseBinaryInput<ElemType>::ReadMinibatches(size_t* read_order, size_t numToRead)
+void SparseBinaryInput<ElemType>::ReadMinibatches(size_t numToRead)
 {
 #if DEBUG
     marker_series series(L"Read Minibatches");
-    // diagnostic::span span(series, L"Reading Data");
-    span* read_span;
 #endif
-    for (size_t c = 0; c < numToRead; c++)
+    std::string name = msra::strfun::utf8(m_fileName);
+    ifstream inFile(name, ifstream::binary | ifstream::in);
+    for (;;)
     {
+        size_t c;
+        void* data_buffer;
+        {
+            std::lock_guard<std::mutex> lock(m_assignLock);
+            if (m_nextToRead >= numToRead || m_stopReading)
+                break;
 #if DEBUG
-        read_span = new span(series, 1, L"Getting Buffer %ld\n", c);
-#endif
-        // fprintf(stderr, "start reading data %ld\n", c);
-        size_t readSize = m_offsets[read_order[c] + 1] - m_offsets[read_order[c]];
-//void* data_buffer = GetTempDataPointer(readSize);
-#if DEBUG
-        series.write_flag(_T("Getting buffer."));
-#endif
-        void* data_buffer = m_dataToProduce.pop();
-#if DEBUG
-        delete read_span;
-        series.write_flag(_T("Got buffer."));
-        read_span = new span(series, 2, L"Reading Data %ld\n", c);
+            series.write_flag(_T("Getting buffer."));
 #endif
+            data_buffer = m_dataToProduce->Pop();
+            if (m_stopReading)
+            {
+                m_dataToProduce->Push(data_buffer);
+                break;
+            }
+            c = m_nextToRead++;
+        }
 
-        m_inFile.clear();
-#if DEBUG
-        series.write_flag(_T("seeking."));
-#endif
-        m_inFile.seekg(m_dataStart + m_offsets[c], ios::beg);
-#if DEBUG
-        series.write_flag(_T("reading."));
-#endif
-        m_inFile.read((char*) data_buffer, readSize);
-        m_dataToConsume.push(data_buffer);
-//fprintf(stderr, "done reading data %ld\n", c);
+        size_t mb = m_readOrder[c];
+        size_t readSize = m_offsets[mb + 1] - m_offsets[mb];
+        inFile.seekg(m_dataStart + m_offsets[mb], ios::beg);
+        inFile.read((char*) data_buffer, readSize);
 #if DEBUG
         series.write_flag(_T("Done read, pushed buffer."));
-        delete read_span;
 #endif
+
+        if (m_stopReading)
+        {
+            m_dataToProduce->Push(data_buffer);
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_readLock);
+            m_readBuffers[c] = data_buffer;
+        }
+        m_bufferRead.notify_all();
     }
-//m_dataToConsume.push(nullptr);
-#if DEBUG
-    series.write_flag(_T("Done reading."));
-#endif
+}
+
+// wait for the next minibatch that has been read
+template <class ElemType>
+void* SparseBinaryInput<ElemType>::TakeReadBuffer()
+{
+    std::unique_lock<std::mutex> lock(m_readLock);
+    auto next = m_readBuffers.end();
+    m_bufferRead.wait(lock, [&]
+                      {
+                          next = m_keepDataOrder ? m_readBuffers.find(m_nextMB) : m_readBuffers.begin();
+                          return next != m_readBuffers.end();
+                      });
+    void* data_buffer = next->second;
+    m_readBuffers.erase(next);
+    return data_buffer;
 }
 
 template <class ElemType>
@@ -624,7 +671,7 @@ size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_p
     // while (curSize + m_microBatchSize <= m_mbSize && (data_buffer = m_dataToConsume.pop()) != nullptr) {
     while (curSize + m_microBatchSize <= m_mbSize && m_nextMB < m_epochSize)
     {
-        data_buffer = m_dataToConsume.pop();
+        data_buffer = TakeReadBuffer();
         // clock_t in_w = clock();
         // start_w = in_w - start_w;
         // fprintf(stderr, "start read mb\tIt took me %d clicks (%f seconds).\n", start_w, ((float)start_w) / CLOCKS_PER_SEC);
@@ -633,7 +680,7 @@ size_t SparseBinaryInput<ElemType>::FillMatrices(std::map<std::wstring, shared_p
         curSize += ReadMinibatch(data_buffer, matrices);
         // fprintf(stderr, "end read mb\n");
         m_nextMB++;
-        m_dataToProduce.push(data_buffer);
+        m_dataToProduce->Push(data_buffer);
     }
     // fprintf(stderr, "end fill matrices\n");
     return curSize;
@@ -680,6 +727,7 @@ void LibSVMBinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& reader
 
     m_dataInput = make_shared<SparseBinaryInput<ElemType>>(file);
     m_dataInput->Init(rename);
+    m_dataInput->SetReaderThreads(readerConfig(L"numReaderThreads", (size_t) 1), readerConfig(L"keepDataOrder", true));
 
     m_mbSize = (size_t) readerConfig(L"minibatch", 0);
     if (m_mbSize > 0)
@@ -720,6 +768,11 @@ void LibSVMBinaryReader<ElemType>::StartDistributedMinibatchLoop(size_t mbSize,
 {
     m_epoch = epoch;
     m_mbSize = mbSize;
+
+    // a minibatch that was read ahead belongs to the previous epoch
+    if (m_pendingAsyncGetMinibatch.valid())
+        m_pendingAsyncGetMinibatch.wait();
+    m_pendingAsyncGetMinibatch = std::future<size_t>();
 #if DEBUG
     if (reader_series != NULL)
     {
@@ -9,6 +9,7 @@
 #include "DataReader.h"
 #include "DataWriter.h"
 #include "RandomOrdering.h"
+#include "MPMCQueue.h"
 #include <string>
 #include <map>
 #include <vector>
@@ -18,6 +19,7 @@
 #include <condition_variable>
 #include <deque>
 #include <thread>
+#include <atomic>
 #if DEBUG
 #include <cvmarkersobj.h>
 using namespace Concurrency::diagnostic;
@@ -25,45 +27,6 @@ using namespace Concurrency::diagnostic;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-template <typename T>
-class BlockingQueue
-{
-private:
-    std::mutex d_mutex;
-    std::condition_variable d_condition;
-    std::deque<T> d_queue;
-
-public:
-    void release()
-    {
-        while (!d_queue.empty())
-            free(d_queue.pop_front());
-    }
-    size_t size()
-    {
-        return d_queue.size();
-    }
-    void push(T const& value)
-    {
-        {
-            std::unique_lock<std::mutex> lock(this->d_mutex);
-            d_queue.push_front(value);
-        }
-        this->d_condition.notify_one();
-    }
-    T pop()
-    {
-        std::unique_lock<std::mutex> lock(this->d_mutex);
-        this->d_condition.wait(lock, [=]
-                               {
-                                   return !this->d_queue.empty();
-                               });
-        T rc(std::move(this->d_queue.back()));
-        this->d_queue.pop_back();
-        return rc;
-    }
-};
-
 template <class ElemType>
 class BinaryMatrix
 {
@@ -161,8 +124,15 @@ public:
     SparseBinaryInput(std::wstring fileName);
     ~SparseBinaryInput();
     void Init(std::map<std::wstring, std::wstring> rename);
+    // numThreads reader threads read the minibatches of an epoch, each through its own file handle.
+    // With keepDataOrder they are returned in the read order, otherwise in the order they have been read.
+    void SetReaderThreads(size_t numThreads, bool keepDataOrder)
+    {
+        m_numReaderThreads = max(numThreads, (size_t) 1);
+        m_keepDataOrder = keepDataOrder;
+    }
     void StartDistributedMinibatchLoop(size_t mbSize, size_t subsetNum, size_t numSubsets);
-    void ReadMinibatches(size_t* read_order, size_t numToRead);
+    void ReadMinibatches(size_t numToRead);
     size_t ReadMinibatch(void* data_buffer, std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
     size_t FillMatrices(std::map<std::wstring, shared_ptr<BinaryMatrix<ElemType>>>& matrices);
     size_t GetMBSize()
@@ -183,6 +153,8 @@ private:
     void FillReadOrder(size_t windowSize);
     void* GetTempDataPointer(size_t numVals);
     bool Randomize();
+    void* TakeReadBuffer();
+    void StopReaders();
 
     ifstream m_inFile;
     std::wstring m_fileName;
@@ -230,8 +202,22 @@ private:
 #else
     int32_t sysGran;
 #endif
-    BlockingQueue<void*> m_dataToProduce;
-    BlockingQueue<void*> m_dataToConsume;
+    std::unique_ptr<MPMCQueue<void*>> m_dataToProduce; // free buffers, sized for all of them
+
+    size_t m_numReaderThreads;
+    bool m_keepDataOrder;
+    std::vector<std::thread> m_readers;
+    std::atomic<bool> m_stopReading;
+
+    // A reader thread takes the next position of the read order together with a free buffer, so that the
+    // minibatches are assigned buffers in the read order and the one the consumer waits for always has one.
+    std::mutex m_assignLock;
+    size_t m_nextToRead; // position in the read order of the next minibatch to be read
+
+    // Buffers that have been read, by their position in the read order.
+    std::mutex m_readLock;
+    std::condition_variable m_bufferRead;
+    std::map<size_t, void*> m_readBuffers;
 };
 
 template <class ElemType>
@@ -0,0 +1,243 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "BinaryChunkDeserializer.h"
+#include "ElementTypeUtils.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace BinaryChunkFormat;
+
+// A chunk in memory: the sequences are views of its blocks.
+class BinaryChunkDeserializer::BinaryChunk : public Chunk, public std::enable_shared_from_this<BinaryChunk>
+{
+public:
+    BinaryChunk(const std::vector<StreamDescriptionPtr>& streams, uint32_t numberOfSequences,
+                std::vector<char>&& buffer, const char* mappedData, size_t size, MemoryMappedFilePtr mappedFile)
+        : m_streams(streams), m_buffer(std::move(buffer)), m_mappedFile(mappedFile)
+    {
+        m_data = m_mappedFile ? mappedData : m_buffer.data();
+
+        // Finding the blocks is all that is needed to load the chunk.
+        m_blockOffsets.reserve(numberOfSequences * m_streams.size());
+        size_t offset = 0;
+        for (uint32_t i = 0; i < numberOfSequences; ++i)
+        {
+            for (const auto& stream : m_streams)
+            {
+                if (offset + 2 * sizeof(uint32_t) > size)
+                {
+                    RuntimeError("BinaryChunkDeserializer: Chunk data is truncated.");
+                }
+                m_blockOffsets.push_back(offset);
+                const uint32_t* blockHeader = reinterpret_cast<const uint32_t*>(m_data + offset);
+                size_t numberOfSamples = blockHeader[0];
+                size_t elementSize = GetSizeByType(stream->m_elementType);
+                if (stream->m_storageType == StorageType::dense)
+                {
+                    offset += Align(2 * sizeof(uint32_t) + numberOfSamples * stream->m_sampleLayout->GetNumElements() * elementSize);
+                }
+                else
+                {
+                    size_t nnzCount = blockHeader[1];
+                    offset += Align(2 * sizeof(uint32_t) + (numberOfSamples + nnzCount) * sizeof(IndexType)) + Align(nnzCount * elementSize);
+                }
+            }
+        }
+        if (offset != size)
+        {
+            RuntimeError("BinaryChunkDeserializer: Chunk data does not match the chunk size.");
+        }
+    }
+
+    virtual void GetSequence(size_t sequenceId, std::vector<SequenceDataPtr>& result) override
+    {
+        result.reserve(result.size() + m_streams.size());
+        for (size_t i = 0; i < m_streams.size(); ++i)
+        {
+            const auto& stream = m_streams[i];
+            char* block = const_cast<char*>(m_data + m_blockOffsets[sequenceId * m_streams.size() + i]);
+            const uint32_t* blockHeader = reinterpret_cast<const uint32_t*>(block);
+            char* payload = block + 2 * sizeof(uint32_t);
+
+            SequenceDataPtr sequence;
+            if (stream->m_storageType == StorageType::dense)
+            {
+                auto dense = std::make_shared<DenseSequenceData>();
+                dense->m_data = payload;
+                sequence = dense;
+            }
+            else
+            {
+                auto sparse = std::make_shared<SparseSequenceData>();
+                IndexType* nnzCounts = reinterpret_cast<IndexType*>(payload);
+                sparse->m_nnzCounts.assign(nnzCounts, nnzCounts + blockHeader[0]);
+                sparse->m_totalNnzCount = (IndexType)blockHeader[1];
+                sparse->m_indices = nnzCounts + blockHeader[0];
+                sparse->m_data = block + Align(2 * sizeof(uint32_t) + (blockHeader[0] + blockHeader[1]) * sizeof(IndexType));
+                sequence = sparse;
+            }
+
+            sequence->m_id = sequenceId;
+            sequence->m_numberOfSamples = blockHeader[0];
+            sequence->m_sampleLayout = stream->m_sampleLayout;
+            sequence->m_chunk = shared_from_this();
+            result.push_back(sequence);
+        }
+    }
+
+private:
+    std::vector<StreamDescriptionPtr> m_streams;
+    std::vector<char> m_buffer;
+    MemoryMappedFilePtr m_mappedFile;
+    const char* m_data;
+    std::vector<size_t> m_blockOffsets; // [sequence * number of streams + stream]
+};
+
+BinaryChunkDeserializer::BinaryChunkDeserializer(const ConfigParameters& config)
+    : m_file(nullptr)
+{
+    m_filename = msra::strfun::utf16(config(L"file"));
+    std::string precision = config("precision", "float");
+    bool memoryMapFile = config(L"memoryMapFile", false);
+
+    m_file = fopenOrDie(m_filename, L"rbS");
+    ReadIndex(precision);
+
+    if (memoryMapFile)
+    {
+        m_mappedFile = std::make_shared<MemoryMappedFile>(m_filename);
+    }
+}
+
+BinaryChunkDeserializer::~BinaryChunkDeserializer()
+{
+    if (m_file)
+    {
+        fclose(m_file);
+    }
+}
+
+void BinaryChunkDeserializer::ReadIndex(const std::string& precision)
+{
+    FileHeader header;
+    freadOrDie(&header, sizeof(header), 1, m_file);
+    if (header.m_magic != c_magic)
+    {
+        RuntimeError("BinaryChunkDeserializer: '%ls' is not a binary chunked file.", m_filename.c_str());
+    }
+    if (header.m_version != c_version || header.m_flags != 0)
+    {
+        RuntimeError("BinaryChunkDeserializer: '%ls' has unsupported version %d or flags %d.",
+                     m_filename.c_str(), (int)header.m_version, (int)header.m_flags);
+    }
+
+    ElementType expectedType = AreEqualIgnoreCase(precision, "double") ? ElementType::tdouble : ElementType::tfloat;
+    for (uint32_t i = 0; i < header.m_numberOfStreams; ++i)
+    {
+        StreamHeader streamHeader;
+        freadOrDie(&streamHeader, sizeof(streamHeader), 1, m_file);
+
+        SmallVector<size_t> dims;
+        for (uint32_t k = 0; k < streamHeader.m_rank; ++k)
+        {
+            uint64_t dim;
+            freadOrDie(&dim, sizeof(dim), 1, m_file);
+            dims.push_back((size_t)dim);
+        }
+
+        std::string name(Align(streamHeader.m_nameLength), '\0');
+        if (!name.empty())
+        {
+            freadOrDie(&name[0], 1, name.size(), m_file);
+        }
+        name.resize(streamHeader.m_nameLength);
+
+        auto stream = std::make_shared<StreamDescription>();
+        stream->m_id = i;
+        stream->m_name = msra::strfun::utf16(name);
+        stream->m_storageType = (StorageType)streamHeader.m_storageType;
+        stream->m_elementType = (ElementType)streamHeader.m_elementType;
+        stream->m_sampleLayout = std::make_shared<TensorShape>(dims);
+        if (stream->m_elementType != expectedType)
+        {
+            RuntimeError("BinaryChunkDeserializer: Stream '%ls' in '%ls' was written with a different precision than '%s'.",
+                         stream->m_name.c_str(), m_filename.c_str(), precision.c_str());
+        }
+        m_streams.push_back(stream);
+    }
+
+    fsetpos(m_file, header.m_indexOffset);
+    m_chunks.resize(header.m_numberOfChunks);
+    freadOrDie(m_chunks.data(), sizeof(ChunkHeader), m_chunks.size(), m_file);
+
+    size_t numberOfSequences = 0;
+    m_firstSequence.reserve(m_chunks.size());
+    for (const auto& chunk : m_chunks)
+    {
+        m_firstSequence.push_back(numberOfSequences);
+        numberOfSequences += chunk.m_numberOfSequences;
+    }
+    m_sequenceLengths.resize(numberOfSequences);
+    freadOrDie(m_sequenceLengths.data(), sizeof(uint32_t), m_sequenceLengths.size(), m_file);
+}
+
+ChunkDescriptions BinaryChunkDeserializer::GetChunkDescriptions()
+{
+    ChunkDescriptions result;
+    result.reserve(m_chunks.size());
+    for (ChunkIdType i = 0; i < m_chunks.size(); ++i)
+    {
+        auto chunk = std::make_shared<ChunkDescription>();
+        chunk->m_id = i;
+        chunk->m_numberOfSamples = m_chunks[i].m_numberOfSamples;
+        chunk->m_numberOfSequences = m_chunks[i].m_numberOfSequences;
+        result.push_back(chunk);
+    }
+    return result;
+}
+
+void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_chunks[chunkId];
+    result.reserve(result.size() + chunk.m_numberOfSequences);
+    for (uint32_t i = 0; i < chunk.m_numberOfSequences; ++i)
+    {
+        size_t globalIndex = m_firstSequence[chunkId] + i;
+        SequenceDescription sequence;
+        sequence.m_id = i;
+        sequence.m_numberOfSamples = m_sequenceLengths[globalIndex];
+        sequence.m_chunkId = chunkId;
+        sequence.m_key.m_sequence = globalIndex;
+        sequence.m_key.m_sample = 0;
+        result.push_back(sequence);
+    }
+}
+
+ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
+{
+    const auto& chunk = m_chunks[chunkId];
+    if (m_mappedFile)
+    {
+        if (chunk.m_offset + chunk.m_size > m_mappedFile->Size())
+        {
+            RuntimeError("BinaryChunkDeserializer: Chunk %d is beyond the end of '%ls'.", (int)chunkId, m_filename.c_str());
+        }
+        m_mappedFile->WillNeed(chunk.m_offset, chunk.m_size);
+        return std::make_shared<BinaryChunk>(m_streams, chunk.m_numberOfSequences, std::vector<char>(),
+                                             m_mappedFile->Data() + chunk.m_offset, chunk.m_size, m_mappedFile);
+    }
+
+    std::vector<char> buffer(chunk.m_size);
+    fsetpos(m_file, chunk.m_offset);
+    freadOrDie(buffer.data(), 1, buffer.size(), m_file);
+    return std::make_shared<BinaryChunk>(m_streams, chunk.m_numberOfSequences, std::move(buffer), nullptr, chunk.m_size, nullptr);
+}
+
+}}}
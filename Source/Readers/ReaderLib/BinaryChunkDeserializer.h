@@ -0,0 +1,49 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstdio>
+#include "DataDeserializerBase.h"
+#include "BinaryChunkFormat.h"
+#include "MemoryMappedFile.h"
+#include "Config.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer of the binary chunked format (see BinaryChunkFormat.h). A chunk is loaded with a single read, or
+// taken from a memory mapping of the file, and its sequences point into it without any parsing or conversion.
+// Config:
+//     file = path of the file written by BinaryChunkWriter
+//     memoryMapFile = false -- if true, chunks are not read but used from a mapping of the file
+class BinaryChunkDeserializer : public DataDeserializerBase
+{
+public:
+    BinaryChunkDeserializer(const ConfigParameters& config);
+    ~BinaryChunkDeserializer();
+
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+private:
+    class BinaryChunk;
+
+    void ReadIndex(const std::string& precision);
+
+    std::wstring m_filename;
+    FILE* m_file;
+    MemoryMappedFilePtr m_mappedFile;
+
+    std::vector<BinaryChunkFormat::ChunkHeader> m_chunks;
+    std::vector<size_t> m_firstSequence; // global index of the first sequence of each chunk
+    std::vector<uint32_t> m_sequenceLengths;
+
+    DISABLE_COPY_AND_MOVE(BinaryChunkDeserializer);
+};
+
+}}}
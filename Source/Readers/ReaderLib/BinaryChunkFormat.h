@@ -0,0 +1,64 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BinaryChunkFormat.h -- layout of the binary chunked container format, written by BinaryChunkWriter and read by
+// BinaryChunkDeserializer.
+//
+// The file stores the streams of a deserializer chunk by chunk, in the form in which they are handed out as sequence data,
+// so that loading a chunk is a single read without any parsing. All integers are little-endian, and every block starts
+// at a multiple of 8 bytes, so that the values of a chunk that is read into memory (or mapped) are properly aligned.
+//
+//  file:            FileHeader
+//                   StreamHeader, dims (uint64 x rank), UTF-8 name (padded) -- for each stream
+//                   chunks
+//                   ChunkHeader -- for each chunk, at FileHeader::m_indexOffset
+//                   number of samples of each sequence (uint32) -- for all chunks, in order
+//  chunk:           for each sequence, for each stream, a dense or a sparse block
+//  dense block:     uint32 number of samples, uint32 0, values (number of samples x sample size)
+//  sparse block:    uint32 number of samples, uint32 nnz count, nnz count of each sample (IndexType),
+//                   row index of each value (IndexType), values (nnz count) -- values start at a multiple of 8 bytes
+
+#pragma once
+
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace BinaryChunkFormat
+{
+    const uint32_t c_magic = 0x46434243; // "CBCF"
+    const uint32_t c_version = 1;
+    const uint32_t c_alignment = 8;
+
+    inline size_t Align(size_t size) { return (size + c_alignment - 1) / c_alignment * c_alignment; }
+
+    struct FileHeader
+    {
+        uint32_t m_magic;
+        uint32_t m_version;
+        uint32_t m_numberOfStreams;
+        uint32_t m_numberOfChunks;
+        uint64_t m_indexOffset; // offset of the chunk headers
+        uint64_t m_flags;       // reserved for compression, must be 0
+    };
+
+    struct StreamHeader
+    {
+        uint32_t m_storageType; // StorageType
+        uint32_t m_elementType; // ElementType
+        uint32_t m_rank;        // number of dimensions of a sample
+        uint32_t m_nameLength;  // in bytes
+    };
+
+    struct ChunkHeader
+    {
+        uint64_t m_offset;
+        uint64_t m_size;
+        uint64_t m_numberOfSamples;
+        uint32_t m_numberOfSequences;
+        uint32_t m_reserved;
+    };
+}
+
+}}}
@@ -0,0 +1,167 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "BinaryChunkWriter.h"
+#include "BinaryChunkFormat.h"
+#include "ElementTypeUtils.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace BinaryChunkFormat;
+
+static void Append(std::vector<char>& buffer, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+static void Pad(std::vector<char>& buffer)
+{
+    buffer.resize(Align(buffer.size()), 0);
+}
+
+static void WritePadded(FILE* f, const void* data, size_t size)
+{
+    static const char zeros[c_alignment] = {};
+    fwriteOrDie(data, 1, size, f);
+    fwriteOrDie(zeros, 1, Align(size) - size, f);
+}
+
+static void AppendSequence(std::vector<char>& buffer, const StreamDescription& stream, const SequenceDataBase& sequence)
+{
+    size_t elementSize = GetSizeByType(stream.m_elementType);
+    uint32_t numberOfSamples = sequence.m_numberOfSamples;
+    Append(buffer, &numberOfSamples, sizeof(numberOfSamples));
+    if (stream.m_storageType == StorageType::dense)
+    {
+        uint32_t zero = 0;
+        Append(buffer, &zero, sizeof(zero));
+        Append(buffer, sequence.m_data, numberOfSamples * stream.m_sampleLayout->GetNumElements() * elementSize);
+    }
+    else
+    {
+        const auto& sparse = static_cast<const SparseSequenceData&>(sequence);
+        if (sparse.m_nnzCounts.size() != numberOfSamples)
+        {
+            RuntimeError("BinaryChunkWriter: Sparse sequence of stream '%ls' has %d nnz counts for %d samples.",
+                         stream.m_name.c_str(), (int)sparse.m_nnzCounts.size(), (int)numberOfSamples);
+        }
+
+        uint32_t nnzCount = sparse.m_totalNnzCount;
+        Append(buffer, &nnzCount, sizeof(nnzCount));
+        Append(buffer, sparse.m_nnzCounts.data(), numberOfSamples * sizeof(IndexType));
+        Append(buffer, sparse.m_indices, nnzCount * sizeof(IndexType));
+        Pad(buffer);
+        if (sparse.m_data)
+        {
+            Append(buffer, sparse.m_data, nnzCount * elementSize);
+        }
+        else // (implicit ones)
+        {
+            for (uint32_t i = 0; i < nnzCount; ++i)
+            {
+                Append(buffer, GetOneByType(stream.m_elementType), elementSize);
+            }
+        }
+    }
+    Pad(buffer);
+}
+
+/*static*/ void BinaryChunkWriter::Write(IDataDeserializerPtr deserializer, const std::wstring& filename)
+{
+    auto streams = deserializer->GetStreamDescriptions();
+    for (const auto& stream : streams)
+    {
+        if (!stream->m_sampleLayout)
+        {
+            RuntimeError("BinaryChunkWriter: Stream '%ls' has no fixed sample layout.", stream->m_name.c_str());
+        }
+        if (stream->m_elementType != ElementType::tfloat && stream->m_elementType != ElementType::tdouble)
+        {
+            RuntimeError("BinaryChunkWriter: Stream '%ls' has an unsupported element type.", stream->m_name.c_str());
+        }
+    }
+
+    FILE* f = fopenOrDie(filename, L"wb");
+
+    FileHeader header = {};
+    header.m_magic = c_magic;
+    header.m_version = c_version;
+    header.m_numberOfStreams = (uint32_t)streams.size();
+    fwriteOrDie(&header, sizeof(header), 1, f);
+
+    for (const auto& stream : streams)
+    {
+        std::string name = msra::strfun::utf8(stream->m_name);
+        const auto& dims = stream->m_sampleLayout->GetDims();
+        StreamHeader streamHeader = {};
+        streamHeader.m_storageType = (uint32_t)stream->m_storageType;
+        streamHeader.m_elementType = (uint32_t)stream->m_elementType;
+        streamHeader.m_rank = (uint32_t)dims.size();
+        streamHeader.m_nameLength = (uint32_t)name.size();
+        fwriteOrDie(&streamHeader, sizeof(streamHeader), 1, f);
+        for (size_t dim : dims)
+        {
+            uint64_t dim64 = dim;
+            fwriteOrDie(&dim64, sizeof(dim64), 1, f);
+        }
+        WritePadded(f, name.data(), name.size());
+    }
+
+    auto chunks = deserializer->GetChunkDescriptions();
+    std::vector<ChunkHeader> chunkHeaders;
+    chunkHeaders.reserve(chunks.size());
+    std::vector<uint32_t> sequenceLengths;
+    std::vector<SequenceDescription> sequences;
+    std::vector<SequenceDataPtr> data;
+    std::vector<char> buffer;
+    for (const auto& chunk : chunks)
+    {
+        sequences.clear();
+        deserializer->GetSequencesForChunk(chunk->m_id, sequences);
+        ChunkPtr chunkData = deserializer->GetChunk(chunk->m_id);
+
+        ChunkHeader chunkHeader = {};
+        chunkHeader.m_offset = fgetpos(f);
+        chunkHeader.m_numberOfSequences = (uint32_t)sequences.size();
+
+        buffer.clear();
+        for (const auto& sequence : sequences)
+        {
+            data.clear();
+            chunkData->GetSequence(sequence.m_id, data);
+            for (size_t i = 0; i < streams.size(); ++i)
+            {
+                AppendSequence(buffer, *streams[i], *data[i]);
+            }
+            sequenceLengths.push_back(sequence.m_numberOfSamples);
+            chunkHeader.m_numberOfSamples += sequence.m_numberOfSamples;
+        }
+
+        fwriteOrDie(buffer.data(), 1, buffer.size(), f);
+        chunkHeader.m_size = buffer.size();
+        chunkHeaders.push_back(chunkHeader);
+    }
+
+    header.m_numberOfChunks = (uint32_t)chunkHeaders.size();
+    header.m_indexOffset = fgetpos(f);
+    fwriteOrDie(chunkHeaders.data(), sizeof(ChunkHeader), chunkHeaders.size(), f);
+    fwriteOrDie(sequenceLengths.data(), sizeof(uint32_t), sequenceLengths.size(), f);
+
+    fsetpos(f, (uint64_t)0);
+    fwriteOrDie(&header, sizeof(header), 1, f);
+    fflushOrDie(f);
+    fcloseOrDie(f);
+
+    fprintf(stderr, "BinaryChunkWriter: Wrote %" PRIu64 " sequences in %" PRIu64 " chunks to '%ls'.\n",
+            sequenceLengths.size(), chunkHeaders.size(), filename.c_str());
+}
+
+}}}
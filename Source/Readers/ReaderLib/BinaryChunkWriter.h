@@ -0,0 +1,21 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <string>
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Converts all data of a deserializer into the binary chunked format (see BinaryChunkFormat.h), keeping its chunking.
+// The streams must have a fixed sample layout; the result is read by BinaryChunkDeserializer.
+class BinaryChunkWriter
+{
+public:
+    static void Write(IDataDeserializerPtr deserializer, const std::wstring& filename);
+};
+
+}}}
@@ -14,6 +14,7 @@
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "ReaderStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -24,7 +25,9 @@ BlockRandomizer::BlockRandomizer(
     bool shouldPrefetch,
     DecimationMode decimationMode,
     bool useLegacyRandomization,
-    bool multithreadedGetNextSequence)
+    bool multithreadedGetNextSequence,
+    size_t maxNumberOfPrefetchedChunks,
+    size_t lengthBucketSize)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_decimationMode(decimationMode),
@@ -36,14 +39,14 @@ BlockRandomizer::BlockRandomizer(
       m_lastSeenChunkId(CHUNKID_MAX),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRangeInSamples, useLegacyRandomization)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(CHUNKID_MAX)
+      m_maxNumberOfPrefetchedChunks(maxNumberOfPrefetchedChunks)
 {
     assert(deserializer != nullptr);
 
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
     m_streams = m_deserializer->GetStreamDescriptions();
-    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
+    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer, lengthBucketSize);
 
     // Calculate total number of samples.
     m_sweepTotalNumberOfSamples = 0;
@@ -132,7 +135,7 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     }
 
     // Retrieve new data chunks if required.
-    ChunkIdType chunkToPrefetchNext = LoadDataChunks();
+    std::vector<ChunkIdType> chunksToPrefetchNext = LoadDataChunks();
 
     if (m_verbosity >= Debug)
         fprintf(stderr, "BlockRandomizer::GetNextSequences(): getting %" PRIu64 " out of %" PRIu64 " sequences for %" PRIu64 " requested samples in sweep %" PRIu64 "\n",
@@ -152,7 +155,14 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
             LogicError("Invalid chunk requested.");
         }
 
-        it->second->GetSequence(description.m_id, sequence);
+        {
+            ReaderStageTimer timer(ReaderStage::deserialize);
+            it->second->GetSequence(description.m_id, sequence);
+        }
+        if (m_sequenceTransform)
+        {
+            m_sequenceTransform(sequence);
+        }
         for (int j = 0; j < m_streams.size(); ++j)
         {
             result.m_data[j][i] = sequence[j];
@@ -177,7 +187,10 @@ Sequences BlockRandomizer::GetNextSequences(size_t sampleCount)
     m_sequenceRandomizer->ReleaseChunks();
 
     // Now it is safe to start the new chunk prefetch.
-    Prefetch(chunkToPrefetchNext);
+    if (!chunksToPrefetchNext.empty())
+    {
+        Prefetch(chunksToPrefetchNext);
+    }
 
     return result;
 }
@@ -236,6 +249,29 @@ void BlockRandomizer::Decimate(const std::vector<RandomizedSequenceDescription>&
         size_t strideEnd = all.size() * (m_config.m_workerRank + 1) / m_config.m_numberOfWorkers;
         decimated.assign(all.begin() + strideBegin, all.begin() + strideEnd);
     }
+    else if (m_decimationMode == DecimationMode::balanced)
+    {
+        // Longest sequences first, each to the worker with the fewest samples so far. All workers see the same
+        // sequence descriptions, so they compute the same assignment. The sequences keep their randomized order.
+        std::vector<size_t> order(all.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&all](size_t a, size_t b) { return all[a].m_numberOfSamples > all[b].m_numberOfSamples; });
+
+        std::vector<size_t> workerNumSamples(m_config.m_numberOfWorkers, 0);
+        std::vector<bool> isOwn(all.size(), false);
+        for (auto i : order)
+        {
+            size_t worker = std::min_element(workerNumSamples.begin(), workerNumSamples.end()) - workerNumSamples.begin();
+            workerNumSamples[worker] += all[i].m_numberOfSamples;
+            isOwn[i] = worker == m_config.m_workerRank;
+        }
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            if (isOwn[i])
+                decimated.push_back(all[i]);
+        }
+    }
     else
     {
         LogicError("Not supported mode.");
@@ -243,15 +279,15 @@ void BlockRandomizer::Decimate(const std::vector<RandomizedSequenceDescription>&
 }
 
 // Retrieves chunk data based on the window information provided by SequenceRandomizer
-// Returns the next chunk id to prefetch.
-ChunkIdType BlockRandomizer::LoadDataChunks()
+// Returns the next chunk ids to prefetch.
+std::vector<ChunkIdType> BlockRandomizer::LoadDataChunks()
 {
     size_t randomizedEnd = 0;
     const auto& window = m_sequenceRandomizer->GetChunkWindow(randomizedEnd);
     if (window[randomizedEnd - 1].m_chunkId == m_lastSeenChunkId)
     {
         // nothing to prefetch.
-        return CHUNKID_MAX;
+        return std::vector<ChunkIdType>();
     }
 
     m_lastSeenChunkId = window[randomizedEnd - 1].m_chunkId;
@@ -299,10 +335,12 @@ ChunkIdType BlockRandomizer::LoadDataChunks()
         }
 
         auto const& chunk = window[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+        auto prefetched = m_prefetchedChunks.find(chunk.m_original->m_id);
+        if (prefetched != m_prefetchedChunks.end())
         {
             // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
+            m_chunks[chunk.m_original->m_id] = prefetched->second.get();
+            m_prefetchedChunks.erase(prefetched);
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
@@ -312,11 +350,12 @@ ChunkIdType BlockRandomizer::LoadDataChunks()
         else
         {
             // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
+            if (m_lastPrefetch.valid())
             {
-                m_prefetch.wait();
+                m_lastPrefetch.wait();
             }
 
+            ReaderStageTimer timer(ReaderStage::load);
             m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
@@ -332,44 +371,86 @@ ChunkIdType BlockRandomizer::LoadDataChunks()
                 window.front().m_chunkId,
                 window.back().m_chunkId);
 
-    return GetChunkToPrefetch(window.begin() + randomizedEnd, window.end());
+    return GetChunksToPrefetch(window.begin() + randomizedEnd, window.end());
 }
 
-// Identifies chunk id that should be prefetched.
+// Identifies chunk ids that should be prefetched.
 // TODO: DecimationMode::sequence is not supported because it should eventually go away.
 template<class Iter>
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const Iter& begin, const Iter& end)
+std::vector<ChunkIdType> BlockRandomizer::GetChunksToPrefetch(const Iter& begin, const Iter& end)
 {
-    auto current = begin;
-    ChunkIdType toBePrefetched = CHUNKID_MAX;
-    while (current != end)
+    std::vector<ChunkIdType> toBePrefetched;
+    if (m_decimationMode != DecimationMode::chunk)
+    {
+        return toBePrefetched;
+    }
+
+    auto isCandidate = [this](ChunkIdType randomizedChunkId, ChunkIdType originalChunkId)
+    {
+        return m_chunks.find(originalChunkId) == m_chunks.end() &&
+            randomizedChunkId % m_config.m_numberOfWorkers == m_config.m_workerRank;
+    };
+
+    for (auto current = begin; current != end && toBePrefetched.size() < m_maxNumberOfPrefetchedChunks; ++current)
     {
-        if (m_chunks.find(current->m_original->m_id) == m_chunks.end() &&
-            m_decimationMode == DecimationMode::chunk && 
-            current->m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank)
+        if (isCandidate(current->m_chunkId, current->m_original->m_id))
         {
-            toBePrefetched = current->m_original->m_id;
-            break;
+            toBePrefetched.push_back(current->m_original->m_id);
+        }
+    }
+
+    // The chunks that enter the window next follow in randomized order, up to the end of the sweep.
+    const auto& randomizedChunks = m_chunkRandomizer->GetRandomizedChunks();
+    for (size_t i = (end - 1)->m_chunkId + 1; i < randomizedChunks.size() && toBePrefetched.size() < m_maxNumberOfPrefetchedChunks; ++i)
+    {
+        if (isCandidate(randomizedChunks[i].m_chunkId, randomizedChunks[i].m_original->m_id))
+        {
+            toBePrefetched.push_back(randomizedChunks[i].m_original->m_id);
         }
-        ++current;
     }
     return toBePrefetched;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+// Performs io prefetch of the specified chunks if needed.
+void BlockRandomizer::Prefetch(const std::vector<ChunkIdType>& chunkIds)
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != CHUNKID_MAX)
+    // Dropping prefetched chunks that are not coming up anymore frees their memory; a load in flight
+    // is still completed by its background task.
+    for (auto it = m_prefetchedChunks.begin(); it != m_prefetchedChunks.end();)
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
+        if (std::find(chunkIds.begin(), chunkIds.end(), it->first) == chunkIds.end())
         {
-            m_prefetch.wait();
+            if (m_verbosity >= Debug)
+                fprintf(stderr, "BlockRandomizer::Prefetch: dropping prefetched original chunk: %u\n", it->first);
+            it = m_prefetchedChunks.erase(it);
         }
+        else
+        {
+            ++it;
+        }
+    }
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+    // Start new prefetches if necessary.
+    for (auto chunkId : chunkIds)
+    {
+        if (m_prefetchedChunks.find(chunkId) != m_prefetchedChunks.end())
+        {
+            continue;
+        }
+
+        // Each load waits for the previous one, so that the deserializer is never called concurrently.
+        auto previous = m_lastPrefetch;
+        m_lastPrefetch = std::async(m_launchType, [this, chunkId, previous]() mutable
+        {
+            if (previous.valid())
+            {
+                previous.wait();
+                previous = std::shared_future<ChunkPtr>(); // do not hold on to the previous chunk
+            }
+            ReaderStageTimer timer(ReaderStage::load);
+            return m_deserializer->GetChunk(chunkId);
+        }).share();
+        m_prefetchedChunks[chunkId] = m_lastPrefetch;
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
@@ -36,10 +36,13 @@ class BlockRandomizer : public SequenceEnumerator
 {
 public:
     // Currently, decimation based on sequences or chunks is supported.
+    // 'balanced' decimates sequences so that each worker gets about the same number of samples, for a minibatch of
+    // sequences of different lengths; like 'sequence', it loads all chunks on every worker.
     enum class DecimationMode
     {
         chunk,
-        sequence
+        sequence,
+        balanced
     };
 
     BlockRandomizer(
@@ -49,7 +52,9 @@ public:
         bool shouldPrefetch,
         DecimationMode decimationMode = DecimationMode::chunk,
         bool useLegacyRandomization = false,
-        bool multithreadedGetNextSequences = false);
+        bool multithreadedGetNextSequences = false,
+        size_t maxNumberOfPrefetchedChunks = 1,
+        size_t lengthBucketSize = 0);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -63,18 +68,30 @@ public:
         return m_deserializer->GetStreamDescriptions();
     }
 
+    // Transforms are only taken over when sequences are deserialized in parallel,
+    // otherwise the caller parallelizes them better itself.
+    virtual bool SetSequenceTransform(const SequenceTransform& transform) override
+    {
+        if (!m_multithreadedGetNextSequences)
+        {
+            return false;
+        }
+        m_sequenceTransform = transform;
+        return true;
+    }
+
     ~BlockRandomizer()
     {
-        if (m_prefetch.valid())
+        if (m_lastPrefetch.valid())
         {
-            m_prefetch.wait();
+            m_lastPrefetch.wait();
         }
     }
 
 private:
     // Load data for chunks if needed.
-    // Returns the next chunk id to prefetch.
-    ChunkIdType LoadDataChunks();
+    // Returns the next chunk ids to prefetch, empty if the chunk window has not moved.
+    std::vector<ChunkIdType> LoadDataChunks();
 
     // Get next sequence descriptions that do not exceed sample count.
     // Returns true if epoch end is reached.
@@ -86,12 +103,13 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Performs io prefetch of the specified chunks if needed, and drops prefetched chunks that are not among them.
+    void Prefetch(const std::vector<ChunkIdType>& chunkIds);
 
-    // Returns next candidate for the prefetch in the given range.
+    // Returns the next candidates for the prefetch: chunks of this worker that are not loaded yet, from the given
+    // range of the chunk window on, continuing with the randomized chunks beyond the window.
     template<class Iter>
-    ChunkIdType GetChunkToPrefetch(const Iter& begin, const Iter& end);
+    std::vector<ChunkIdType> GetChunksToPrefetch(const Iter& begin, const Iter& end);
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -138,6 +156,9 @@ private:
     // TODO temporary; should go away when transformers are moved closer to the deserializer
     bool m_multithreadedGetNextSequences;
 
+    // Applied to each sequence by the thread that deserializes it (see SetSequenceTransform).
+    SequenceTransform m_sequenceTransform;
+
     // General configuration
     // TODO generalize those for ReaderLib / Reader / CNTK
     enum VerbosityLevel
@@ -150,12 +171,15 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
+    // Prefetched chunks by original chunk id. The loads run one after the other, because deserializers
+    // are not safe to call concurrently, but several chunks can be read ahead to hide the I/O latency.
+    std::map<ChunkIdType, std::shared_future<ChunkPtr>> m_prefetchedChunks;
+    // The last requested prefetch, which completes after all others.
+    std::shared_future<ChunkPtr> m_lastPrefetch;
+    // Maximum number of chunks that are prefetched on top of the ones of the chunk window.
+    size_t m_maxNumberOfPrefetchedChunks;
     // Whether to have async or deferred prefetch.
     launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
 };
 
 }}}
@@ -8,6 +8,7 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <set>
+#include "ExceptionCapture.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -18,6 +19,9 @@ struct Bundler::BundlerChunkDescription : public ChunkDescription
 
     // Sequences that are invalid in at least one deserializer.
     std::set<size_t> m_invalid;
+
+    // Sequences in the non driving deserializers, see GetSecondarySequences.
+    std::vector<SecondarySequence> m_secondary;
 };
 
 Bundler::Bundler(
@@ -28,6 +32,7 @@ Bundler::Bundler(
     : m_deserializers(deserializers), m_driver(driver)
 {
     m_verbosity = readerConfig(L"verbosity", 0);
+    m_loadChunksInParallel = readerConfig(L"parallelChunkLoading", true);
 
     // Combines streams of underlying deserializers.
     for (auto d : deserializers)
@@ -95,6 +100,7 @@ void Bundler::CreateChunkDescriptions()
     std::vector<SequenceDescription> sequenceDescriptions;
     sequenceDescriptions.reserve(chunks.front()->m_numberOfSequences);
     SequenceDescription s;
+    const size_t numberOfSecondary = m_deserializers.size() - 1;
     for (ChunkIdType chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex)
     {
         size_t numberOfSamples = 0;
@@ -102,8 +108,10 @@ void Bundler::CreateChunkDescriptions()
         sequenceDescriptions.clear();
 
         // Iterating thru all sequences and identifying whether they are valid among all deserializers.
+        // The found sequences are kept, so that loading the chunk does not need to look them up again.
         m_driver->GetSequencesForChunk(chunks[chunkIndex]->m_id, sequenceDescriptions);
         std::set<size_t> invalid;
+        std::vector<SecondarySequence> secondary(sequenceDescriptions.size() * numberOfSecondary, SecondarySequence{ 0, 0, CHUNKID_MAX });
         for (size_t sequenceIndex = 0; sequenceIndex < sequenceDescriptions.size(); ++sequenceIndex)
         {
             auto sequence = sequenceDescriptions[sequenceIndex];
@@ -118,6 +126,7 @@ void Bundler::CreateChunkDescriptions()
                     break;
                 }
 
+                secondary[sequenceIndex * numberOfSecondary + deserializerIndex - 1] = SecondarySequence{ s.m_id, s.m_numberOfSamples, s.m_chunkId };
                 sequenceSamples = std::max<size_t>(sequenceSamples, s.m_numberOfSamples);
             }
 
@@ -142,6 +151,7 @@ void Bundler::CreateChunkDescriptions()
             cd->m_original = chunks[chunkIndex];
             m_chunks.push_back(cd);
             cd->m_invalid = std::move(invalid);
+            cd->m_secondary = std::move(secondary);
         }
     }
 
@@ -149,6 +159,35 @@ void Bundler::CreateChunkDescriptions()
         fprintf(stderr, "Bundler::CreateChunkDescriptions(): finished cleaning of %" PRIu64 " chunks\n", m_chunks.size());
 }
 
+const std::vector<Bundler::SecondarySequence>& Bundler::GetSecondarySequences(const BundlerChunkDescriptionPtr& chunk, const std::vector<SequenceDescription>& sequences)
+{
+    // Once filled, the lookups of a chunk do not change.
+    std::lock_guard<std::mutex> lock(m_lookupLock);
+    const size_t numberOfSecondary = m_deserializers.size() - 1;
+    if (chunk->m_secondary.size() != sequences.size() * numberOfSecondary)
+    {
+        std::vector<SecondarySequence> secondary(sequences.size() * numberOfSecondary, SecondarySequence{ 0, 0, CHUNKID_MAX });
+        SequenceDescription s;
+        for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
+        {
+            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
+            {
+                continue;
+            }
+
+            for (size_t deserializerIndex = 1; deserializerIndex < m_deserializers.size(); ++deserializerIndex)
+            {
+                if (m_deserializers[deserializerIndex]->GetSequenceDescription(sequences[sequenceIndex], s))
+                {
+                    secondary[sequenceIndex * numberOfSecondary + deserializerIndex - 1] = SecondarySequence{ s.m_id, s.m_numberOfSamples, s.m_chunkId };
+                }
+            }
+        }
+        chunk->m_secondary = std::move(secondary);
+    }
+    return chunk->m_secondary;
+}
+
 // Gets chunk descriptions.
 ChunkDescriptions Bundler::GetChunkDescriptions()
 {
@@ -182,7 +221,8 @@ void Bundler::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDesc
          // TODO: This will change when the sequence length will be exposed per stream.
     {
         result.reserve(sequences.size());
-        SequenceDescription s;
+        const auto& secondary = GetSecondarySequences(chunk, sequences);
+        const size_t numberOfSecondary = m_deserializers.size() - 1;
         for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
         {
             if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
@@ -192,10 +232,9 @@ void Bundler::GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDesc
 
             auto sequence = sequences[sequenceIndex];
             uint32_t sequenceSamples = sequence.m_numberOfSamples;
-            for (size_t deserializerIndex = 1; deserializerIndex < m_deserializers.size(); ++deserializerIndex)
+            for (size_t i = 0; i < numberOfSecondary; ++i)
             {
-                m_deserializers[deserializerIndex]->GetSequenceDescription(sequence, s);
-                sequenceSamples = std::max(sequenceSamples, s.m_numberOfSamples);
+                sequenceSamples = std::max(sequenceSamples, secondary[sequenceIndex * numberOfSecondary + i].m_numberOfSamples);
             }
             sequence.m_numberOfSamples = sequenceSamples;
             sequence.m_id = sequenceIndex;
@@ -236,25 +275,32 @@ public:
 
         // Creating chunk mapping.
         m_parent->m_driver->GetSequencesForChunk(original->m_id, sequences);
-        ChunkPtr drivingChunk = m_parent->m_driver->GetChunk(original->m_id);
+        const auto& secondary = m_parent->GetSecondarySequences(chunk, sequences);
+        const size_t numberOfSecondary = deserializers.size() - 1;
         m_sequenceToSequence.resize(deserializers.size() * sequences.size());
         m_innerChunks.resize(deserializers.size() * sequences.size());
-        for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
+
+        // Creating sequence mapping and requiring underlying chunks of a deserializer.
+        // Only its own column of the mappings and its own chunk table are touched, so deserializers can be processed in parallel.
+        auto load = [&](int deserializerIndex)
         {
-            if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
+            if (deserializerIndex == 0)
             {
-                continue;
+                ChunkPtr drivingChunk = m_parent->m_driver->GetChunk(original->m_id);
+                for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
+                {
+                    if (chunk->m_invalid.find(sequenceIndex) != chunk->m_invalid.end())
+                    {
+                        continue;
+                    }
+
+                    size_t currentIndex = sequenceIndex * deserializers.size();
+                    m_sequenceToSequence[currentIndex] = sequences[sequenceIndex].m_id;
+                    m_innerChunks[currentIndex] = drivingChunk;
+                }
+                return;
             }
 
-            size_t currentIndex = sequenceIndex * deserializers.size();
-            m_sequenceToSequence[currentIndex] = sequences[sequenceIndex].m_id;
-            m_innerChunks[currentIndex] = drivingChunk;
-        }
-
-        // Creating sequence mapping and requiring underlying chunks.
-        SequenceDescription s;
-        for (size_t deserializerIndex = 1; deserializerIndex < deserializers.size(); ++deserializerIndex)
-        {
             auto& chunkTable = m_parent->m_weakChunkTable[deserializerIndex];
             for (size_t sequenceIndex = 0; sequenceIndex < sequences.size(); ++sequenceIndex)
             {
@@ -263,8 +309,14 @@ public:
                     continue;
                 }
 
+                const auto& s = secondary[sequenceIndex * numberOfSecondary + deserializerIndex - 1];
+                if (s.m_chunkId == CHUNKID_MAX)
+                {
+                    RuntimeError("Bundler: Sequence %" PRIu64 " of the driving deserializer is missing in deserializer %d, please set 'checkData' to true.",
+                                 sequences[sequenceIndex].m_key.m_sequence, deserializerIndex);
+                }
+
                 size_t currentIndex = sequenceIndex * deserializers.size() + deserializerIndex;
-                deserializers[deserializerIndex]->GetSequenceDescription(sequences[sequenceIndex], s);
                 m_sequenceToSequence[currentIndex] = s.m_id;
 
                 ChunkPtr secondaryChunk = chunkTable[s.m_chunkId].lock();
@@ -276,6 +328,21 @@ public:
 
                 m_innerChunks[currentIndex] = secondaryChunk;
             }
+        };
+
+        // Chunks of different deserializers are loaded concurrently, while each deserializer loads its chunks in order.
+        if (m_parent->m_loadChunksInParallel && deserializers.size() > 1)
+        {
+            ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < (int)deserializers.size(); ++i)
+                capture.SafeRun(load, i);
+            capture.RethrowIfHappened();
+        }
+        else
+        {
+            for (int i = 0; i < (int)deserializers.size(); ++i)
+                load(i);
         }
     }
 
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <mutex>
 #include "DataDeserializer.h"
 #include "DataDeserializerBase.h"
 #include "Config.h"
@@ -35,9 +36,21 @@ private:
     struct BundlerChunkDescription;
     typedef std::shared_ptr<BundlerChunkDescription> BundlerChunkDescriptionPtr;
 
+    // A sequence of the driving deserializer as found in one of the other deserializers.
+    struct SecondarySequence
+    {
+        size_t m_id;
+        uint32_t m_numberOfSamples;
+        ChunkIdType m_chunkId; // CHUNKID_MAX if the deserializer does not have the sequence
+    };
+
     // Creates chunk descriptions based on chunks of underlying deserializers.
     void CreateChunkDescriptions();
 
+    // Gets the sequences of the chunk in the non driving deserializers, they are looked up only once per chunk.
+    // Index i refers to sequence (i / (number of deserializers - 1)) of deserializer (i % (number of deserializers - 1) + 1).
+    const std::vector<SecondarySequence>& GetSecondarySequences(const BundlerChunkDescriptionPtr& chunk, const std::vector<SequenceDescription>& sequences);
+
     // Underlying deserializers.
     std::vector<IDataDeserializerPtr> m_deserializers;
 
@@ -63,6 +76,12 @@ private:
     // Inner vector is the table of chunk id into weak pointer, the outer vector has an element per deserializer.
     std::vector<std::vector<std::weak_ptr<Chunk>>> m_weakChunkTable;
 
+    // Whether the chunks of different deserializers are loaded in parallel.
+    bool m_loadChunksInParallel;
+
+    // Guards the sequence lookups of the chunk descriptions, chunks can be loaded while sequences are requested.
+    std::mutex m_lookupLock;
+
     // General configuration
     int m_verbosity;
 };
@@ -6,7 +6,7 @@
 #pragma once
 
 #include "StringToIdMap.h"
-#include <set>
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -16,7 +16,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class CorpusDescriptor
 {
     bool m_includeAll;
-    std::set<size_t> m_sequenceIds;
+    std::vector<size_t> m_sequenceIds; // sorted
 
 public:
     CorpusDescriptor(const std::wstring& file) : m_includeAll(false)
@@ -24,8 +24,12 @@ public:
         // Add all sequence ids.
         for (msra::files::textreader r(file); r;)
         {
-            m_sequenceIds.insert(m_stringRegistry[r.getline()]);
+            m_sequenceIds.push_back(m_stringRegistry[r.getline()]);
         }
+
+        std::sort(m_sequenceIds.begin(), m_sequenceIds.end());
+        m_sequenceIds.erase(std::unique(m_sequenceIds.begin(), m_sequenceIds.end()), m_sequenceIds.end());
+        m_sequenceIds.shrink_to_fit();
     }
 
     // By default include all sequences.
@@ -46,7 +50,7 @@ public:
             return false;
         }
 
-        return m_sequenceIds.find(id) != m_sequenceIds.end();
+        return std::binary_search(m_sequenceIds.begin(), m_sequenceIds.end(), id);
     }
 
     // Gets the string registry
@@ -87,6 +87,8 @@ typedef std::shared_ptr<DenseSequenceData> DenseSequenceDataPtr;
 // All non zero values are store in the 'data' member as a contiguous array.
 // The corresponding row indices are stored in 'indices' per sample.
 // All samples in the sequence should have the same layout.
+// If all values are 1, e.g. for one-hot word ids, 'data' may be null: the sequence is then given by its indices only,
+// and the packers keep it that way where they can (see StreamMinibatch::m_hasImplicitOnes).
 struct SparseSequenceData : SequenceDataBase
 {
     IndexType* m_indices; // an index for every value in the m_data array
@@ -97,6 +99,16 @@ struct SparseSequenceData : SequenceDataBase
 };
 typedef std::shared_ptr<SparseSequenceData> SparseSequenceDataPtr;
 
+// Sequence of an object that is not a tensor, i.e. the lattice of an utterance. Should be returned by the deserializer
+// for streams with element type ElementType::tatom. m_numberOfSamples is the number of samples the object covers in the
+// other streams of the bundle, so that all streams get the same layout.
+// The packers do not copy these sequences, but pass them on in StreamMinibatch::m_sequences.
+struct ObjectSequenceData : SequenceDataBase
+{
+    std::shared_ptr<const void> m_object;
+};
+typedef std::shared_ptr<ObjectSequenceData> ObjectSequenceDataPtr;
+
 // A chunk represents a set of sequences.
 // In order to enable efficient IO, the deserializer is asked to load a complete chunk in memory.
 // Which chunks to load are controlled by the randomizer. The randomizer guarantees that at any point in time
@@ -176,4 +188,24 @@ public:
 
 typedef std::shared_ptr<IDataDeserializer> IDataDeserializerPtr;
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Interface of data deserializers that read their input front to back, for inputs that cannot be indexed up front:
+// pipes, or append-only logs of unknown total size. There are no chunks, the sequences are returned in input order
+// and each is read only once. Used by the ShuffleBufferRandomizer.
+//////////////////////////////////////////////////////////////////////////////////////////////////
+class IStreamingDataDeserializer
+{
+public:
+    // Gets stream descriptions for all streams this deserializer exposes.
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const = 0;
+
+    // Reads the next sequence of the input, one entry per stream.
+    // Returns false if the end of the input has been reached.
+    virtual bool GetNextSequence(std::vector<SequenceDataPtr>& result) = 0;
+
+    virtual ~IStreamingDataDeserializer() {};
+};
+
+typedef std::shared_ptr<IStreamingDataDeserializer> IStreamingDataDeserializerPtr;
+
 }}}
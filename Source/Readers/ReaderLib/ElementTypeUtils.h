@@ -26,4 +26,20 @@ inline size_t GetSizeByType(ElementType type)
         RuntimeError("Unsupported type '%d'", type);
     }
 }
+
+// The value 1 of the type, to materialize the implicit values of sparse sequences without values.
+inline const void* GetOneByType(ElementType type)
+{
+    static const float oneFloat = 1;
+    static const double oneDouble = 1;
+    switch (type)
+    {
+    case ElementType::tfloat:
+        return &oneFloat;
+    case ElementType::tdouble:
+        return &oneDouble;
+    default:
+        RuntimeError("Unsupported type '%d'", type);
+    }
+}
 } } }
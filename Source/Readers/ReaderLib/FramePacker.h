@@ -18,7 +18,16 @@ public:
         SequenceEnumeratorPtr sequenceEnumerator,
         const std::vector<StreamDescriptionPtr>& streams) :
         SequencePacker(memoryProvider, sequenceEnumerator, streams)
-    {}
+    {
+        for (const auto& stream : streams)
+        {
+            if (stream->m_elementType == ElementType::tatom)
+            {
+                RuntimeError("Stream '%ls' holds whole sequences, i.e. lattices, which cannot be split into frames. Please switch off frame mode.",
+                    stream->m_name.c_str());
+            }
+        }
+    }
 
 private:
 
@@ -0,0 +1,263 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "MinibatchPrefetchQueue.h"
+#include "ElementTypeUtils.h"
+#include "HeapMemoryProvider.h"
+#include "CudaMemoryProvider.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+MinibatchPrefetchQueue::MinibatchPrefetchQueue(ReaderPtr reader, const std::vector<StreamDescriptionPtr>& streams, size_t depth, size_t maxBytes)
+    : m_reader(reader),
+      m_streams(streams),
+      m_depth(std::max<size_t>(depth, 1)),
+      m_maxBytes(maxBytes == 0 ? std::numeric_limits<size_t>::max() : maxBytes),
+      m_numQueuedBytes(0),
+      m_stopRequested(false),
+      m_isReading(false),
+      m_deviceId(CPUDEVICE),
+      m_memoryProvider(std::make_shared<HeapMemoryProvider>())
+{
+}
+
+MinibatchPrefetchQueue::~MinibatchPrefetchQueue()
+{
+    Stop();
+}
+
+void MinibatchPrefetchQueue::Start()
+{
+    Stop();
+    m_isReading = true;
+    m_thread = std::thread([this]() { ReadAhead(); });
+}
+
+void MinibatchPrefetchQueue::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_stopRequested = true;
+    }
+    m_notFull.notify_all();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (auto& entry : m_queue)
+    {
+        Recycle(entry);
+    }
+    m_queue.clear();
+    m_numQueuedBytes = 0;
+    Recycle(m_current);
+    m_stopRequested = false;
+    m_isReading = false;
+}
+
+Minibatch MinibatchPrefetchQueue::Pop()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    // The caller is done with the previous minibatch.
+    Recycle(m_current);
+    m_notEmpty.wait(lock, [this]() { return !m_queue.empty() || !m_isReading; });
+    if (m_queue.empty())
+    {
+        LogicError("MinibatchPrefetchQueue: No minibatch is left to read in this epoch.");
+    }
+
+    m_current = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_numQueuedBytes -= m_current.m_numBytes;
+    lock.unlock();
+    m_notFull.notify_one();
+
+    if (m_current.m_error)
+    {
+        std::rethrow_exception(m_current.m_error);
+    }
+    return m_current.m_minibatch;
+}
+
+void MinibatchPrefetchQueue::SetDeviceId(int deviceId)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (deviceId == m_deviceId)
+    {
+        return;
+    }
+
+    // Buffers in flight keep their memory provider alive; only new ones come from the new provider.
+    m_deviceId = deviceId;
+    if (deviceId >= 0)
+    {
+        m_memoryProvider = std::make_shared<CudaMemoryProvider>(deviceId);
+    }
+    else
+    {
+        m_memoryProvider = std::make_shared<HeapMemoryProvider>();
+    }
+    m_freeBuffers.clear();
+}
+
+void MinibatchPrefetchQueue::ReadAhead()
+{
+    for (;;)
+    {
+        {
+            // Back-pressure: at least one minibatch may always be queued, even if it exceeds the byte budget by itself.
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_notFull.wait(lock, [this]()
+            {
+                return m_stopRequested || (m_queue.size() < m_depth && (m_queue.empty() || m_numQueuedBytes < m_maxBytes));
+            });
+            if (m_stopRequested)
+            {
+                m_isReading = false;
+                break;
+            }
+        }
+
+        Entry entry;
+        try
+        {
+            entry = CopyMinibatch(m_reader->ReadMinibatch());
+        }
+        catch (...)
+        {
+            entry.m_error = std::current_exception();
+        }
+
+        bool isLast = entry.m_error || entry.m_minibatch.m_endOfEpoch;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_numQueuedBytes += entry.m_numBytes;
+            m_queue.push_back(std::move(entry));
+            if (isLast)
+            {
+                m_isReading = false;
+            }
+        }
+        m_notEmpty.notify_one();
+
+        if (isLast)
+        {
+            break;
+        }
+    }
+    m_notEmpty.notify_all();
+}
+
+MinibatchPrefetchQueue::Entry MinibatchPrefetchQueue::CopyMinibatch(const Minibatch& minibatch)
+{
+    Entry entry;
+    entry.m_minibatch.m_endOfEpoch = minibatch.m_endOfEpoch;
+    for (size_t i = 0; i < minibatch.m_data.size(); ++i)
+    {
+        const auto& source = minibatch.m_data[i];
+        if (m_streams[i]->m_elementType == ElementType::tatom)
+        {
+            // Object streams only hold references to their sequences.
+            auto stream = std::make_shared<StreamMinibatch>();
+            stream->m_data = nullptr;
+            stream->m_layout = std::make_shared<MBLayout>();
+            stream->m_layout->CopyFrom(source->m_layout);
+            stream->m_sequences = source->m_sequences;
+            entry.m_minibatch.m_data.push_back(stream);
+            continue;
+        }
+
+        size_t size = GetDataSize(*m_streams[i], *source);
+
+        Buffer buffer;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            buffer = GetBuffer(size);
+        }
+        memcpy(buffer.m_data.get(), source->m_data, size);
+
+        auto stream = std::make_shared<StreamMinibatch>();
+        stream->m_data = buffer.m_data.get();
+        stream->m_hasImplicitOnes = source->m_hasImplicitOnes;
+        stream->m_layout = std::make_shared<MBLayout>();
+        stream->m_layout->CopyFrom(source->m_layout);
+
+        entry.m_minibatch.m_data.push_back(stream);
+        entry.m_buffers.push_back(buffer);
+        entry.m_numBytes += buffer.m_size;
+    }
+    return entry;
+}
+
+size_t MinibatchPrefetchQueue::GetDataSize(const StreamDescription& stream, const StreamMinibatch& data) const
+{
+    size_t elementSize = GetSizeByType(stream.m_elementType);
+    size_t numCols = data.m_layout->GetNumCols();
+    if (stream.m_storageType == StorageType::dense)
+    {
+        return stream.m_sampleLayout->GetNumElements() * elementSize * numCols;
+    }
+    else if (stream.m_storageType == StorageType::sparse_csc)
+    {
+        // The layout of the packers: nnz count, values (unless implicit), row indices and column offsets.
+        size_t nnzCount = *reinterpret_cast<const size_t*>(data.m_data);
+        size_t valueSize = data.m_hasImplicitOnes ? 0 : elementSize;
+        return sizeof(nnzCount) + nnzCount * (valueSize + sizeof(IndexType)) + (numCols + 1) * sizeof(IndexType);
+    }
+    RuntimeError("Storage type %d is not supported.", (int)stream.m_storageType);
+}
+
+MinibatchPrefetchQueue::Buffer MinibatchPrefetchQueue::GetBuffer(size_t size)
+{
+    // Take the smallest free buffer that fits.
+    auto best = m_freeBuffers.end();
+    for (auto it = m_freeBuffers.begin(); it != m_freeBuffers.end(); ++it)
+    {
+        if (it->m_size >= size && (best == m_freeBuffers.end() || it->m_size < best->m_size))
+        {
+            best = it;
+        }
+    }
+
+    if (best != m_freeBuffers.end())
+    {
+        Buffer buffer = *best;
+        m_freeBuffers.erase(best);
+        return buffer;
+    }
+
+    // Page-locked allocations are expensive, so the buffers are sized generously and recycled.
+    Buffer buffer;
+    buffer.m_size = std::max<size_t>(size + size / 4, 1);
+    buffer.m_memoryProvider = m_memoryProvider;
+    auto memoryProvider = m_memoryProvider;
+    buffer.m_data.reset(reinterpret_cast<char*>(memoryProvider->Alloc(1, buffer.m_size)), [memoryProvider](char* p)
+    {
+        memoryProvider->Free(p);
+    });
+    return buffer;
+}
+
+void MinibatchPrefetchQueue::Recycle(Entry& entry)
+{
+    for (auto& buffer : entry.m_buffers)
+    {
+        // Buffers allocated for a previous device are released instead.
+        if (buffer.m_memoryProvider == m_memoryProvider)
+        {
+            m_freeBuffers.push_back(buffer);
+        }
+    }
+    entry = Entry();
+}
+
+}}}
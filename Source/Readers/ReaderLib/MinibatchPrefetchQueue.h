@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Reader.h"
+#include "MemoryProvider.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Reads minibatches of the current epoch ahead on a dedicated thread into a bounded queue.
+// The thread waits while the queue holds 'depth' minibatches, or more than 'maxBytes' of data.
+// Packers reuse their buffers for the next minibatch, so the data and layouts of each queued minibatch are copied
+// into buffers owned by the queue. The buffers are recycled, and page-locked once the device of the input
+// matrices is known to be a GPU, so that filling the matrices is a direct transfer.
+class MinibatchPrefetchQueue
+{
+public:
+    // 'streams' are the stream descriptions of 'reader'; maxBytes 0 means no limit besides the depth
+    MinibatchPrefetchQueue(ReaderPtr reader, const std::vector<StreamDescriptionPtr>& streams, size_t depth, size_t maxBytes);
+    ~MinibatchPrefetchQueue();
+
+    // Starts reading the epoch the reader has been started on. The reader must not be used otherwise until Stop().
+    void Start();
+
+    // Stops reading, waits for the read in flight and drops the queued minibatches.
+    void Stop();
+
+    // Returns the next minibatch, waiting for it if needed, or rethrows the error of the read.
+    // The returned data stays valid until the next call of Pop() or Stop().
+    Minibatch Pop();
+
+    // Allocates the buffers in page-locked memory for transfers to this device from now on (CPUDEVICE for the heap).
+    void SetDeviceId(int deviceId);
+
+    DISABLE_COPY_AND_MOVE(MinibatchPrefetchQueue);
+
+private:
+    struct Buffer
+    {
+        std::shared_ptr<char> m_data;
+        size_t m_size;
+        MemoryProviderPtr m_memoryProvider;
+    };
+
+    struct Entry
+    {
+        Minibatch m_minibatch;
+        std::vector<Buffer> m_buffers;
+        size_t m_numBytes = 0;
+        std::exception_ptr m_error;
+    };
+
+    void ReadAhead();
+    Entry CopyMinibatch(const Minibatch& minibatch);
+    size_t GetDataSize(const StreamDescription& stream, const StreamMinibatch& data) const;
+
+    // The following require m_lock to be held.
+    Buffer GetBuffer(size_t size);
+    void Recycle(Entry& entry);
+
+    ReaderPtr m_reader;
+    std::vector<StreamDescriptionPtr> m_streams;
+    size_t m_depth;
+    size_t m_maxBytes;
+
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<Entry> m_queue;
+    size_t m_numQueuedBytes;
+    bool m_stopRequested;
+    bool m_isReading;
+
+    Entry m_current; // the minibatch returned by the last Pop()
+    std::vector<Buffer> m_freeBuffers;
+    int m_deviceId;
+    MemoryProviderPtr m_memoryProvider;
+};
+
+}}}
@@ -4,22 +4,28 @@
 //
 
 #define _CRT_SECURE_NO_WARNINGS
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include <algorithm>
 
 #include "NoRandomizer.h"
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "ReaderStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences)
+NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences, bool shardChunks)
     : m_deserializer(deserializer),
       m_samplePositionInEpoch(0),
       m_currentChunkPosition(CHUNKID_MAX),
       m_globalSamplePosition(0),
       m_totalNumberOfSamples(0),
       m_currentSequencePositionInChunk(0),
-      m_multithreadedGetNextSequences(multithreadedGetNextSequences)
+      m_multithreadedGetNextSequences(multithreadedGetNextSequences),
+      m_shardChunks(shardChunks),
+      m_shardedEpoch(false),
+      m_sweep(0)
 {
     assert(deserializer != nullptr);
     m_streams = m_deserializer->GetStreamDescriptions();
@@ -49,10 +55,36 @@ ChunkIdType NoRandomizer::GetChunkIndexOf(size_t samplePosition)
     return (ChunkIdType) (result - 1 - m_chunkSampleOffset.begin());
 }
 
+size_t NoRandomizer::GetWorkerSweepSize(size_t sweep) const
+{
+    size_t result = 0;
+    for (ChunkIdType i = 0; i < m_chunkDescriptions.size(); ++i)
+    {
+        if (IsWorkerChunk(i, sweep))
+        {
+            result += m_chunkDescriptions[i]->m_numberOfSamples;
+        }
+    }
+    return result;
+}
+
 void NoRandomizer::StartEpoch(const EpochConfiguration& config)
 {
     m_config = config;
 
+    m_shardedEpoch = false;
+    if (m_shardChunks && m_config.m_numberOfWorkers > 1)
+    {
+        if (m_chunkDescriptions.size() >= m_config.m_numberOfWorkers)
+        {
+            StartShardedEpoch();
+            return;
+        }
+
+        fprintf(stderr, "WARNING: NoRandomizer: Cannot shard %" PRIu64 " chunks between %" PRIu64 " workers, "
+                "each worker reads all chunks.\n", m_chunkDescriptions.size(), m_config.m_numberOfWorkers);
+    }
+
     if (m_config.m_totalEpochSizeInSamples == requestDataSize)
     {
         m_config.m_totalEpochSizeInSamples = m_totalNumberOfSamples;
@@ -63,6 +95,62 @@ void NoRandomizer::StartEpoch(const EpochConfiguration& config)
     size_t sweepSamplePosition = m_globalSamplePosition % m_totalNumberOfSamples;
 
     ChunkIdType chunkIndex = GetChunkIndexOf(sweepSamplePosition);
+    MoveToChunk(chunkIndex, sweepSamplePosition - m_chunkSampleOffset[chunkIndex]);
+};
+
+// Each worker has its own timeline over its chunks, an epoch is the worker's share of the epoch samples.
+void NoRandomizer::StartShardedEpoch()
+{
+    m_shardedEpoch = true;
+    m_samplePositionInEpoch = 0;
+
+    size_t epochStart = 0;
+    if (m_config.m_totalEpochSizeInSamples == requestDataSize)
+    {
+        // An epoch is the worker's part of a sweep.
+        for (size_t sweep = 0; sweep < m_config.m_epochIndex; ++sweep)
+        {
+            epochStart += GetWorkerSweepSize(sweep);
+        }
+        m_config.m_totalEpochSizeInSamples = GetWorkerSweepSize(m_config.m_epochIndex);
+    }
+    else
+    {
+        size_t epochSize = m_config.m_totalEpochSizeInSamples;
+        size_t workers = m_config.m_numberOfWorkers;
+        size_t rank = m_config.m_workerRank;
+        m_config.m_totalEpochSizeInSamples = epochSize * (rank + 1) / workers - epochSize * rank / workers;
+        epochStart = m_config.m_totalEpochSizeInSamples * m_config.m_epochIndex;
+    }
+    m_globalSamplePosition = epochStart;
+
+    // Finding the sweep and the chunk of the epoch start on the worker's timeline.
+    m_sweep = 0;
+    for (size_t sweepSize = GetWorkerSweepSize(m_sweep); epochStart >= sweepSize; sweepSize = GetWorkerSweepSize(m_sweep))
+    {
+        epochStart -= sweepSize;
+        m_sweep++;
+    }
+
+    ChunkIdType chunkIndex = 0;
+    for (;; ++chunkIndex)
+    {
+        if (!IsWorkerChunk(chunkIndex, m_sweep))
+        {
+            continue;
+        }
+        if (epochStart < m_chunkDescriptions[chunkIndex]->m_numberOfSamples)
+        {
+            break;
+        }
+        epochStart -= m_chunkDescriptions[chunkIndex]->m_numberOfSamples;
+    }
+
+    MoveToChunk(chunkIndex, epochStart);
+}
+
+void NoRandomizer::MoveToChunk(ChunkIdType chunkIndex, size_t sampleOffsetInsideChunk)
+{
     if (chunkIndex != m_currentChunkPosition)
     {
         // unloading everything.
@@ -77,7 +165,6 @@ void NoRandomizer::StartEpoch(const EpochConfiguration& config)
     }
 
     // Moving current sequence inside the chunk to match the sample offset.
-    size_t sampleOffsetInsideChunk = sweepSamplePosition - m_chunkSampleOffset[m_currentChunkPosition];
     size_t numberOfSamples = 0;
     size_t sequenceId = 0;
 
@@ -97,7 +184,7 @@ void NoRandomizer::StartEpoch(const EpochConfiguration& config)
 
     m_currentSequencePositionInChunk = sequenceId;
     assert(m_chunkDescriptions[m_currentChunkPosition]->m_numberOfSequences > m_currentSequencePositionInChunk);
-};
+}
 
 // Moving the cursor to the next sequence. Possibly updating the chunk information if needed.
 void NoRandomizer::MoveToNextSequence()
@@ -108,8 +195,15 @@ void NoRandomizer::MoveToNextSequence()
 
     if (m_currentSequencePositionInChunk + 1 >= m_chunkDescriptions[m_currentChunkPosition]->m_numberOfSequences)
     {
-        // Moving to the next chunk.
-        m_currentChunkPosition = (m_currentChunkPosition + 1) % m_chunkDescriptions.size();
+        // Moving to the next chunk, or to the next chunk of this worker when chunks are sharded.
+        do
+        {
+            m_currentChunkPosition = (m_currentChunkPosition + 1) % m_chunkDescriptions.size();
+            if (m_currentChunkPosition == 0)
+            {
+                m_sweep++;
+            }
+        } while (m_shardedEpoch && !IsWorkerChunk(m_currentChunkPosition, m_sweep));
         m_currentSequencePositionInChunk = 0;
         m_sequenceWindow.clear();
         m_deserializer->GetSequencesForChunk(m_currentChunkPosition, m_sequenceWindow);
@@ -152,18 +246,30 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
         return result;
     }
 
-    // Check that we do not go over the sweep.
-    // TODO: This preserves the old behavior. Could be done differently in the future.
-    size_t sweepPosition = m_globalSamplePosition % m_totalNumberOfSamples;
-    sampleCount = std::min(sampleCount, m_totalNumberOfSamples - sweepPosition);
-    assert(sampleCount != 0);
-
-    std::vector<SequenceDescription> descriptions = GetNextSequenceDescriptions(sampleCount);
-
-    // Retrieve only sequences that are required by this worker.
-    size_t start = descriptions.size() * m_config.m_workerRank / m_config.m_numberOfWorkers;
-    size_t end = descriptions.size() * (m_config.m_workerRank + 1) / m_config.m_numberOfWorkers;
-    size_t subsetSize = end - start;
+    std::vector<SequenceDescription> descriptions;
+    size_t start = 0;
+    size_t subsetSize = 0;
+    if (m_shardedEpoch)
+    {
+        // All sequences come from the chunks of this worker, it takes its share of the minibatch.
+        descriptions = GetNextSequenceDescriptions(std::max<size_t>(sampleCount / m_config.m_numberOfWorkers, 1));
+        subsetSize = descriptions.size();
+    }
+    else
+    {
+        // Check that we do not go over the sweep.
+        // TODO: This preserves the old behavior. Could be done differently in the future.
+        size_t sweepPosition = m_globalSamplePosition % m_totalNumberOfSamples;
+        sampleCount = std::min(sampleCount, m_totalNumberOfSamples - sweepPosition);
+        assert(sampleCount != 0);
+
+        descriptions = GetNextSequenceDescriptions(sampleCount);
+
+        // Retrieve only sequences that are required by this worker.
+        start = descriptions.size() * m_config.m_workerRank / m_config.m_numberOfWorkers;
+        size_t end = descriptions.size() * (m_config.m_workerRank + 1) / m_config.m_numberOfWorkers;
+        subsetSize = end - start;
+    }
     if (subsetSize == 0)
     {
         return result;
@@ -185,6 +291,7 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
         auto it = chunks.find(sequenceDescription.m_chunkId);
         if (it == chunks.end())
         {
+            ReaderStageTimer timer(ReaderStage::load);
             chunks[sequenceDescription.m_chunkId] = m_deserializer->GetChunk(sequenceDescription.m_chunkId);
         }
     }
@@ -199,7 +306,14 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
             LogicError("Invalid chunk requested.");
         }
 
-        it->second->GetSequence(sequenceDescription.m_id, sequence);
+        {
+            ReaderStageTimer timer(ReaderStage::deserialize);
+            it->second->GetSequence(sequenceDescription.m_id, sequence);
+        }
+        if (m_sequenceTransform)
+        {
+            m_sequenceTransform(sequence);
+        }
         for (int j = 0; j < m_streams.size(); ++j)
         {
             result.m_data[j][i] = sequence[j];
@@ -207,6 +321,7 @@ Sequences NoRandomizer::GetNextSequences(size_t sampleCount)
     };
 
     // TODO: This will be changed, when we move transformers under the (no-) randomizer, should not deal with multithreading here.
+    // Transforms set by SetSequenceTransform are applied within the same loop.
     if (m_multithreadedGetNextSequences)
     {
         ExceptionCapture capture;
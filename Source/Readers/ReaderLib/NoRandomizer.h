@@ -13,12 +13,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // The class represents a randomizer that does not randomize input (identity function over the original timeline).
 // Used training where the training data has already been pre - randomized.
+// By default each worker takes its stride of every minibatch, and so reads all chunks. With shardChunks, a worker
+// only reads its own chunks: the chunk at position c belongs to the worker (c + sweep) % numberOfWorkers, so the
+// assignment rotates from sweep to sweep, and each worker returns its share of the minibatch from its own chunks.
 // TODO: currently this code moved from the old block randomizer.
 // TODO: The class will be further refactored and common based will be extracted with BlockRandomizer.
 class NoRandomizer : public SequenceEnumerator
 {
 public:
-    NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences = false);
+    NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences = false, bool shardChunks = false);
 
     virtual void StartEpoch(const EpochConfiguration& config) override;
     virtual Sequences GetNextSequences(size_t sampleCount) override;
@@ -27,6 +30,17 @@ public:
         return m_deserializer->GetStreamDescriptions();
     }
 
+    // See BlockRandomizer::SetSequenceTransform.
+    virtual bool SetSequenceTransform(const SequenceTransform& transform) override
+    {
+        if (!m_multithreadedGetNextSequences)
+        {
+            return false;
+        }
+        m_sequenceTransform = transform;
+        return true;
+    }
+
 private:
     // Gets next sequence descriptions with total size less than sampleCount.
     std::vector<SequenceDescription> GetNextSequenceDescriptions(size_t sampleCount);
@@ -37,12 +51,30 @@ private:
     // Moves the cursor to the sequence possibly updating the chunk.
     void MoveToNextSequence();
 
+    // Moves the cursor to the sequence at the sample offset inside the chunk, loading the chunk descriptions if needed.
+    void MoveToChunk(ChunkIdType chunkIndex, size_t sampleOffsetInsideChunk);
+
+    // Sets up the epoch over the chunks of this worker, see shardChunks.
+    void StartShardedEpoch();
+
+    // Whether the chunk belongs to this worker in the given sweep, when chunks are sharded.
+    bool IsWorkerChunk(ChunkIdType chunkIndex, size_t sweep) const
+    {
+        return (chunkIndex + sweep) % m_config.m_numberOfWorkers == m_config.m_workerRank;
+    }
+
+    // Number of samples in the chunks of this worker in the given sweep.
+    size_t GetWorkerSweepSize(size_t sweep) const;
+
     IDataDeserializerPtr m_deserializer;
 
     // Whether to get sequences using multiple thread.
     // TODO temporary; should go away when transformers are moved closer to the deserializer
     bool m_multithreadedGetNextSequences;
 
+    // Applied to each sequence by the thread that deserializes it (see SetSequenceTransform).
+    SequenceTransform m_sequenceTransform;
+
     // Stream descriptions
     std::vector<StreamDescriptionPtr> m_streams;
 
@@ -80,6 +112,14 @@ private:
 
     // Total number of samples in the sweep.
     size_t m_totalNumberOfSamples;
+
+    // Whether each worker reads only its own chunks, and whether the current epoch does so.
+    // Sharding needs more than one worker and at least as many chunks as workers.
+    bool m_shardChunks;
+    bool m_shardedEpoch;
+
+    // Sweep of the current chunk of this worker, when chunks are sharded.
+    size_t m_sweep;
 };
 
 }}}
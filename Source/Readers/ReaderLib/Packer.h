@@ -19,6 +19,10 @@ public:
     virtual void StartEpoch(const EpochConfiguration& config) = 0;
 
     virtual Minibatch ReadMinibatch() = 0;
+
+    // Sets the memory provider of the packed minibatches. The data of the previous minibatch is released.
+    virtual void SetMemoryProvider(MemoryProviderPtr memoryProvider) = 0;
+
     virtual ~Packer() {}
 };
 
@@ -16,14 +16,29 @@ using namespace std;
 // TODO: this should be handled by the memory provider
 void PackerBase::StreamBuffer::Resize(size_t newSize)
 {
+    // The buffer is freed by the provider that allocated it, even if the provider is changed in between.
+    MemoryProviderPtr memoryProvider = m_memoryProvider;
     m_size = newSize;
-    m_data.reset(reinterpret_cast<char*>(m_memoryProvider->Alloc(1, newSize)),
-        [this](char* p)
+    m_data.reset(reinterpret_cast<char*>(memoryProvider->Alloc(1, newSize)),
+        [memoryProvider](char* p)
     {
-        m_memoryProvider->Free(p);
+        memoryProvider->Free(p);
     });
 }
 
+void PackerBase::SetMemoryProvider(MemoryProviderPtr memoryProvider)
+{
+    // Every minibatch is packed anew, so the buffers are only reallocated without copying their contents.
+    for (auto& buffer : m_streamBuffers)
+    {
+        buffer.m_memoryProvider = memoryProvider;
+        if (buffer.m_size > 0)
+        {
+            buffer.Resize(buffer.m_size);
+        }
+    }
+}
+
 void PackerBase::StartEpoch(const EpochConfiguration& config)
 {
     m_minibatchSize = config.m_minibatchSizeInSamples;
@@ -54,7 +69,7 @@ PackerBase::PackerBase(MemoryProviderPtr memoryProvider,
         UNUSED(stream);
 
         // Input and output should match in everything except for sparse/dense storage type.
-        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble);
+        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble || stream->m_elementType == ElementType::tatom);
         assert(stream->m_name == m_inputStreamDescriptions[i]->m_name);
         assert(stream->m_id == m_inputStreamDescriptions[i]->m_id);
 
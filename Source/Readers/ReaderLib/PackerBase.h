@@ -46,9 +46,10 @@ protected:
     // portion of the source sequence to the destination block of memory, where each value is placed
     // at the offset equal to value index * elementSize. sampleOffset specifies the offset of the
     // first value from the given sample in the sequence data/indices array (sampleOffset is equal
-    // to the sum of non-zero value counts of all preceding samples).
+    // to the sum of non-zero value counts of all preceding samples). 'one' points to the value 1 of the
+    // element type, which is copied instead for sequences without values (see SparseSequenceData).
     void PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
-        size_t sampleIndex, size_t sampleOffset, size_t sampleSize, size_t elementSize);
+        size_t sampleIndex, size_t sampleOffset, size_t sampleSize, size_t elementSize, const void* one);
 
     // Packs a dense sample as dense. Copies sampleSize bytes staring at the sampleOffset from 
     // the data portion of the source sequence to the destination block of memory. sampleOffset 
@@ -76,10 +77,13 @@ protected:
 public:
     // Sets current epoch configuration.
     virtual void StartEpoch(const EpochConfiguration& config) override;
+
+    // Reallocates the buffers with the new memory provider.
+    virtual void SetMemoryProvider(MemoryProviderPtr memoryProvider) override;
 };
 
 inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
-    size_t sampleIndex, size_t sampleOffset, size_t sampleSize, size_t elementSize)
+    size_t sampleIndex, size_t sampleOffset, size_t sampleSize, size_t elementSize, const void* one)
 {
     //The sample is sparse, first, need to zero out the buffer.
     memset(destination, 0, sampleSize);
@@ -95,7 +99,7 @@ inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenc
         auto elementIndex = sequence->m_indices[sourceOffset];
         auto destinationOffset = elementIndex * elementSize;
         assert(destinationOffset < sampleSize);
-        const auto* source = (const char*)(sequence->m_data) + (sourceOffset)* elementSize;
+        const auto* source = sequence->m_data ? (const char*)(sequence->m_data) + (sourceOffset)* elementSize : one;
         memcpy(destination + destinationOffset, source, elementSize);
     }
 }
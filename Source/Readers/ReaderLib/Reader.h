@@ -9,6 +9,11 @@
 #include <memory>
 #include "Sequences.h"
 #include "TensorShape.h"
+#include "MemoryProvider.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+struct SequenceDataBase;
+}}}
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -64,11 +69,20 @@ typedef std::shared_ptr<StreamDescription> StreamDescriptionPtr;
 // Represent a minibatch date for a single stream formatted in according to the minibatch layout.
 // This data is returned per stream as a part of Minibatch from the ReadMinibatch function.
 // All raw non owned pointers are valid till the next call to the ReadMinibatch function.
+// A sparse stream is packed as the nnz count (size_t), the nnz values, the nnz row indices and the (number of columns + 1)
+// column offsets (CSC), where the values are left out if they are all 1 (m_hasImplicitOnes).
 struct StreamMinibatch
 {
     void* m_data;         // Contiguous array of data. Can be encoded in dense or sparse formats depending on the stream description.
                           // The size is (the number of rows * number of columns in the layout) * by the element size of the stream (float/double/etc.).
     MBLayoutPtr m_layout; // Layout of the data
+
+    // For sparse streams only: the values are all 1 and not in m_data.
+    bool m_hasImplicitOnes = false;
+
+    // For streams of element type ElementType::tatom only: the sequences, indexed by the sequence ids of m_layout.
+    // m_data is not used for these streams.
+    std::vector<std::shared_ptr<SequenceDataBase>> m_sequences;
 };
 typedef std::shared_ptr<StreamMinibatch> StreamMinibatchPtr;
 
@@ -108,6 +122,10 @@ public:
     // Reads a minibatch that contains data across all streams.
     virtual Minibatch ReadMinibatch() = 0;
 
+    // Sets the memory provider of the buffers the minibatches are packed into, i.e. page-locked memory
+    // when the minibatches are copied to the GPU. Must not be called while a minibatch is being read.
+    virtual void SetMemoryProvider(MemoryProviderPtr provider) = 0;
+
     virtual ~Reader() {};
 };
 
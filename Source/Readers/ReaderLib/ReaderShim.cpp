@@ -17,12 +17,18 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "ReaderShim.h"
+#include "HeapMemoryProvider.h"
+#include "CudaMemoryProvider.h"
+#include "ReaderStatistics.h"
+#include "DataDeserializer.h"
+#include "ElementTypeUtils.h"
+#include "simplesenonehmm.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim(ReaderFactory factory)
-    : m_factory(factory)
+    : m_factory(factory), m_printStageTimes(false), m_latticeStreamId(SIZE_MAX), m_latticeLabelStreamId(SIZE_MAX)
 {
 }
 
@@ -37,14 +43,81 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     // otherwise deferring - synchronous execution during .get() call
     m_launchType = prefetch ? launch::async : launch::deferred;
 
+    // Number of minibatches that are read ahead. With more than one, a dedicated thread keeps a queue of copies of them,
+    // which smooths out minibatches that are slow to read, at the cost of memory (optionally bounded by prefetchMaxMB).
+    size_t prefetchDepth = config(L"prefetchDepth", (size_t)1);
+    size_t prefetchMaxBytes = config(L"prefetchMaxMB", (size_t)0) * 1024 * 1024;
+
+    // Measuring the stages of reading costs two clock reads per stage and sequence, so it is off by default.
+    m_printStageTimes = config(L"stageTimes", false);
+    if (m_printStageTimes)
+    {
+        ReaderStatistics::Enable();
+    }
+
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
+    // Minibatches are packed into heap memory until the device of the input matrices is known.
+    m_deviceId = CPUDEVICE;
+
     m_reader = m_factory(config);
     m_streams = m_reader->GetStreamDescriptions();
     for (auto i : m_streams)
     {
         m_nameToStreamId.insert(std::make_pair(i->m_name, i->m_id));
     }
+    InitLatticeStreams(config);
+
+    if (prefetch && prefetchDepth > 1)
+    {
+        m_prefetchQueue = std::make_unique<MinibatchPrefetchQueue>(m_reader, m_streams, prefetchDepth, prefetchMaxBytes);
+    }
+}
+
+// Finds the lattice stream of a LatticeDeserializer, i.e.
+// deserializers = (
+//     [ type = "HTKFeatureDeserializer" ... ]
+//     [ type = "HTKMLFDeserializer" ... input = [ labels = [ ... ] ] ]
+//     [ type = "LatticeDeserializer" module = "HTKDeserializers"
+//       input = [ lattices = [ denLatTocFile = ... ; phoneFile = ... ; labelMappingFile = ... ; transPFile = ... ; labels = "labels" ] ] ]
+// )
+// 'labels' names the stream the uids of the frames are taken from.
+template <class ElemType>
+void ReaderShim<ElemType>::InitLatticeStreams(const ConfigParameters& config)
+{
+    argvector<ConfigValue> deserializerConfigs =
+        config(L"deserializers", ConfigParameters::Array(argvector<ConfigValue>(vector<ConfigValue> {})));
+    for (size_t i = 0; i < deserializerConfigs.size(); ++i)
+    {
+        ConfigParameters deserializerConfig = deserializerConfigs[i];
+        if ((std::wstring)deserializerConfig(L"type", L"") != L"LatticeDeserializer")
+        {
+            continue;
+        }
+
+        if (m_latticeStreamId != SIZE_MAX)
+        {
+            InvalidArgument("Only a single LatticeDeserializer is supported.");
+        }
+
+        argvector<ConfigValue> inputs = deserializerConfig("input");
+        ConfigParameters input = inputs.front();
+        std::wstring name = input.GetMemberIds().front();
+        ConfigParameters streamConfig = input(name);
+
+        auto lattices = m_nameToStreamId.find(name);
+        auto labels = m_nameToStreamId.find((std::wstring)streamConfig(L"labels", L"labels"));
+        if (lattices == m_nameToStreamId.end() || labels == m_nameToStreamId.end())
+        {
+            InvalidArgument("The lattice stream '%ls' or its label stream is not provided by the reader.", name.c_str());
+        }
+        m_latticeStreamId = lattices->second;
+        m_latticeLabelStreamId = labels->second;
+
+        m_phoneFile = (std::wstring)streamConfig(L"phoneFile");
+        m_stateListFile = (std::wstring)streamConfig(L"labelMappingFile");
+        m_transPFile = (std::wstring)streamConfig(L"transPFile", L"");
+    }
 }
 
 template <class ElemType>
@@ -62,11 +135,21 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
     size_t requestedEpochSamples /*= requestDataSize*/)
 {
     // For adaptive minibatch, make sure there are no outstanding reads.
+    if (m_prefetchQueue)
+    {
+        m_prefetchQueue->Stop();
+    }
     if (m_prefetchTask.valid())
     {
         m_prefetchTask.wait();
     }
 
+    if (m_printStageTimes)
+    {
+        ReaderStatistics::Reset();
+        m_epochStart = std::chrono::steady_clock::now();
+    }
+
     EpochConfiguration config;
     config.m_workerRank = subsetNum;
     config.m_numberOfWorkers = numSubsets;
@@ -77,6 +160,12 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
     m_reader->StartEpoch(config);
     m_endOfEpoch = false;
 
+    if (m_prefetchQueue)
+    {
+        m_prefetchQueue->Start();
+        return;
+    }
+
     // Starting the prefetch task. There is always a single async read in flight.
     // When the network requests a new minibatch, we wait for the current async to finish,
     // return the result and kick off a new one.
@@ -119,16 +208,31 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // If not we should inject the IMemoryProvider per stream.
     int deviceId = matrices.begin()->second.matrix->GetDeviceId();
     for (auto mx : matrices)
-        assert(mx.second.matrix->GetDeviceId() == deviceId), UNUSED(deviceId);
-
-    assert(m_prefetchTask.valid());
+        assert(mx.second.matrix->GetDeviceId() == deviceId);
 
-    Minibatch minibatch = m_prefetchTask.get();
+    Minibatch minibatch;
+    {
+        ReaderStageTimer timer(ReaderStage::wait);
+        if (m_prefetchQueue)
+        {
+            m_prefetchQueue->SetDeviceId(deviceId);
+            minibatch = m_prefetchQueue->Pop();
+        }
+        else
+        {
+            assert(m_prefetchTask.valid());
+            minibatch = m_prefetchTask.get();
+        }
+    }
     if (minibatch.m_endOfEpoch)
     {
         m_endOfEpoch = true;
         if (minibatch.m_data.empty())
         {
+            if (m_printStageTimes)
+            {
+                PrintStageTimes();
+            }
             return false;
         }
     }
@@ -144,8 +248,10 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     map<wstring, wstring> layoutToInputMap;
     if (!minibatch.m_data.empty())
     {
-        // TODO: Use alternating pinned buffer in the packer, do not copy anything, but pack into the pinned memory.
-        // Copy returned minibatch to the matrices.
+        // Copy returned minibatch to the matrices. For GPU matrices the packer writes into page-locked memory,
+        // so that the copies are done directly by DMA without staging the data.
+        // TODO: Upload asynchronously into double-buffered device matrices.
+        ReaderStageTimer timer(ReaderStage::transfer);
         for (const auto& mx : matrices)
         {
             if (m_nameToStreamId.find(mx.first) == m_nameToStreamId.end())
@@ -187,7 +293,27 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
-    if (!m_endOfEpoch)
+    // The label stream is only valid until the next read is started.
+    if (m_latticeStreamId != SIZE_MAX)
+    {
+        FillLatticeInput(minibatch);
+    }
+
+    // The packer switches its buffers while no read is in flight, the data of this minibatch has been copied already.
+    if (deviceId != m_deviceId && !m_prefetchQueue)
+    {
+        m_deviceId = deviceId;
+        if (deviceId >= 0)
+        {
+            m_reader->SetMemoryProvider(std::make_shared<CudaMemoryProvider>(deviceId));
+        }
+        else
+        {
+            m_reader->SetMemoryProvider(std::make_shared<HeapMemoryProvider>());
+        }
+    }
+
+    if (!m_endOfEpoch && !m_prefetchQueue)
     {
         // Starting the prefetch task. There is always a single async read in flight.
         // When the network requests a new minibatch, we wait for the current async to finish,
@@ -198,9 +324,131 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         });
     }
 
+    if (m_endOfEpoch && m_printStageTimes)
+    {
+        PrintStageTimes();
+    }
+
     return !minibatch.m_data.empty();
 }
 
+// Takes the lattices of a minibatch with the uids of their frames from the label stream.
+// The lattices of each parallel sequence are returned in the order of time, as the sequence training expects them.
+template <class ElemType>
+void ReaderShim<ElemType>::FillLatticeInput(const Minibatch& minibatch)
+{
+    m_latticeInput.clear();
+    m_uids.clear();
+    m_extraUttMap.clear();
+    if (minibatch.m_data.empty())
+    {
+        return;
+    }
+
+    const auto& lattices = minibatch.m_data[m_latticeStreamId];
+    const auto& labels = minibatch.m_data[m_latticeLabelStreamId];
+    const auto& labelStream = *m_streams[m_latticeLabelStreamId];
+    if (*lattices->m_layout != *labels->m_layout)
+    {
+        RuntimeError("The layout of the lattices differs from the one of their labels '%ls'. Do lattices and labels have the same number of frames?",
+            labelStream.m_name.c_str());
+    }
+
+    std::vector<MBLayout::SequenceInfo> sequences;
+    for (const auto& sequence : lattices->m_layout->GetAllSequences())
+    {
+        if (sequence.seqId != GAP_SEQUENCE_ID)
+        {
+            sequences.push_back(sequence);
+        }
+    }
+    std::sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b)
+    {
+        return a.s < b.s || (a.s == b.s && a.tBegin < b.tBegin);
+    });
+
+    const size_t elementSize = GetSizeByType(labelStream.m_elementType);
+    const size_t numRows = labelStream.m_sampleLayout->GetNumElements();
+    const size_t numCols = labels->m_layout->GetNumCols();
+    for (const auto& sequence : sequences)
+    {
+        auto lattice = std::static_pointer_cast<ObjectSequenceData>(lattices->m_sequences[sequence.seqId]);
+        m_latticeInput.push_back(std::static_pointer_cast<const msra::dbn::latticepair>(lattice->m_object));
+        m_extraUttMap.push_back(sequence.s);
+
+        for (size_t t = 0; t < sequence.GetNumTimeSteps(); ++t)
+        {
+            size_t column = labels->m_layout->GetColumnIndex(sequence, t);
+            size_t uid = SIZE_MAX;
+            if (labelStream.m_storageType == StorageType::sparse_csc)
+            {
+                // (the layout of the packers: nnz count, values unless implicit, row indices and column offsets)
+                const size_t* data = reinterpret_cast<const size_t*>(labels->m_data);
+                const size_t nnzCount = *data;
+                const size_t valueSize = labels->m_hasImplicitOnes ? 0 : elementSize;
+                const IndexType* rows = reinterpret_cast<const IndexType*>(reinterpret_cast<const char*>(data + 1) + nnzCount * valueSize);
+                const IndexType* columns = rows + nnzCount;
+                if (columns[column + 1] > columns[column])
+                {
+                    uid = rows[columns[column]];
+                }
+            }
+            else
+            {
+                // the row of the 1 of a one-hot column
+                const char* sample = reinterpret_cast<const char*>(labels->m_data) + column * numRows * elementSize;
+                for (size_t r = 0; r < numRows && uid == SIZE_MAX; ++r)
+                {
+                    bool isOne = labelStream.m_elementType == ElementType::tfloat ? reinterpret_cast<const float*>(sample)[r] != 0 : reinterpret_cast<const double*>(sample)[r] != 0;
+                    if (isOne)
+                    {
+                        uid = r;
+                    }
+                }
+            }
+            if (uid == SIZE_MAX || column >= numCols)
+            {
+                RuntimeError("Frame %d of a lattice has no label in stream '%ls'.", (int)t, labelStream.m_name.c_str());
+            }
+            m_uids.push_back(uid);
+        }
+    }
+}
+
+template <class ElemType>
+bool ReaderShim<ElemType>::GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, vector<size_t>& extrauttmap)
+{
+    if (m_latticeStreamId == SIZE_MAX)
+    {
+        RuntimeError("Sequence training requires lattices; please add a LatticeDeserializer to the reader.");
+    }
+
+    latticeinput = m_latticeInput;
+    uids = m_uids;
+    boundaries.assign(m_uids.size(), 0); // phone boundaries are not read; they are only used for reference alignment
+    extrauttmap = m_extraUttMap;
+    return true;
+}
+
+template <class ElemType>
+bool ReaderShim<ElemType>::GetHmmData(msra::asr::simplesenonehmm* hmm)
+{
+    if (m_latticeStreamId == SIZE_MAX)
+    {
+        RuntimeError("Sequence training requires lattices; please add a LatticeDeserializer to the reader.");
+    }
+
+    hmm->loadfromfile(m_phoneFile, m_stateListFile, m_transPFile);
+    return true;
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::PrintStageTimes()
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_epochStart;
+    ReaderStatistics::Print("ReaderShim: Stage times of the epoch", elapsed.count());
+}
+
 template <class ElemType>
 /*static*/ void ReaderShim<ElemType>::FillMatrixFromStream(StorageType type, Matrix<ElemType>* matrix, size_t numRows, const StreamMinibatchPtr& stream)
 {
@@ -210,17 +458,26 @@ template <class ElemType>
     {
         auto data = reinterpret_cast<const ElemType*>(stream->m_data);
         matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal);
+        if (ReaderStatistics::IsEnabled())
+        {
+            ReaderStatistics::AddTransferredBytes(numRows * numCols * sizeof(ElemType));
+        }
     }
     else if (type == StorageType::sparse_csc)
     {
         // In the sparse case the m_data layout is identical to CUDA's CSC layout
         // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
+        // Implicit ones are not transferred, the matrix fills them in on its device.
         size_t* data = reinterpret_cast<size_t*>(stream->m_data);
         size_t nnzCount = *data;
-        ElemType* values = reinterpret_cast<ElemType*>(data + 1);
-        IndexType* rows = reinterpret_cast<IndexType*>(values + nnzCount);
+        ElemType* values = stream->m_hasImplicitOnes ? nullptr : reinterpret_cast<ElemType*>(data + 1);
+        IndexType* rows = reinterpret_cast<IndexType*>(reinterpret_cast<ElemType*>(data + 1) + (values ? nnzCount : 0));
         IndexType* columns = reinterpret_cast<IndexType*>(rows + nnzCount);
         matrix->SetMatrixFromCSCFormat(columns, rows, values, nnzCount, numRows, numCols);
+        if (ReaderStatistics::IsEnabled())
+        {
+            ReaderStatistics::AddTransferredBytes(nnzCount * ((values ? sizeof(ElemType) : 0) + sizeof(IndexType)) + (numCols + 1) * sizeof(IndexType));
+        }
     }
     else 
     {
@@ -12,7 +12,9 @@
 #include <string>
 #include "DataReader.h"
 #include <future>
+#include <chrono>
 #include "Reader.h"
+#include "MinibatchPrefetchQueue.h"
 
 namespace CNTK
 {
@@ -40,6 +42,10 @@ public:
     virtual void Destroy() override
     {
         // Make sure there are no outstanding reads.
+        if (m_prefetchQueue)
+        {
+            m_prefetchQueue->Stop();
+        }
         if (m_prefetchTask.valid())
         {
             // If there are some, give them time to finish.
@@ -59,6 +65,10 @@ public:
 
     virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override;
 
+    // Lattices of the last minibatch for sequence training, from the stream of a LatticeDeserializer.
+    virtual bool GetMinibatch4SE(std::vector<shared_ptr<const msra::dbn::latticepair>>& latticeinput, vector<size_t>& uids, vector<size_t>& boundaries, vector<size_t>& extrauttmap) override;
+    virtual bool GetHmmData(msra::asr::simplesenonehmm* hmm) override;
+
     virtual bool DataEnd() override;
 
     void CopyMBLayoutTo(MBLayoutPtr) override;
@@ -67,16 +77,43 @@ public:
 
 private:
     std::future<Minibatch> m_prefetchTask;
+    // Set if more than one minibatch is read ahead; replaces m_prefetchTask then.
+    std::unique_ptr<MinibatchPrefetchQueue> m_prefetchQueue;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
 
     size_t m_numParallelSequences;
 
+    // Device of the input matrices the reader currently packs for.
+    int m_deviceId;
+
     std::map<std::wstring, size_t> m_nameToStreamId;
     std::vector<StreamDescriptionPtr> m_streams;
     launch m_launchType;
 
+    // Whether to print the time spent in each stage of reading at the end of each epoch, and when the epoch started.
+    bool m_printStageTimes;
+    std::chrono::steady_clock::time_point m_epochStart;
+
+    void PrintStageTimes();
+
+    // Sequence training: the lattice stream (element type tatom) and the label stream the uids are taken from,
+    // with the HMM files, all from the configuration of the LatticeDeserializer.
+    size_t m_latticeStreamId;
+    size_t m_latticeLabelStreamId;
+    std::wstring m_phoneFile;
+    std::wstring m_stateListFile;
+    std::wstring m_transPFile;
+
+    // Lattices of the last minibatch and their uids, in the order that GetMinibatch4SE() returns them.
+    std::vector<shared_ptr<const msra::dbn::latticepair>> m_latticeInput;
+    std::vector<size_t> m_uids;
+    std::vector<size_t> m_extraUttMap;
+
+    void InitLatticeStreams(const ConfigParameters& config);
+    void FillLatticeInput(const Minibatch& minibatch);
+
     static void FillMatrixFromStream(StorageType type, Matrix<ElemType>* matrix, size_t numRows, const StreamMinibatchPtr& stream);
 };
 
@@ -0,0 +1,42 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include "ReaderStatistics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+std::atomic<bool> ReaderStatistics::s_enabled(false);
+std::atomic<long long> ReaderStatistics::s_time[(size_t)ReaderStage::count];
+std::atomic<size_t> ReaderStatistics::s_transferredBytes(0);
+
+void ReaderStatistics::Reset()
+{
+    for (auto& t : s_time)
+    {
+        t = 0;
+    }
+    s_transferredBytes = 0;
+}
+
+void ReaderStatistics::Print(const char* prefix, double elapsedSeconds)
+{
+    static const char* names[] = { "load", "deserialize", "transform", "pack", "transfer", "wait" };
+    static_assert(sizeof(names) / sizeof(names[0]) == (size_t)ReaderStage::count, "A name is required for each reader stage.");
+
+    fprintf(stderr, "%s: %.3fs elapsed", prefix, elapsedSeconds);
+    for (size_t i = 0; i < (size_t)ReaderStage::count; ++i)
+    {
+        double seconds = s_time[i] * 1e-9;
+        fprintf(stderr, ", %s %.3fs (%.2f threads)", names[i], seconds, elapsedSeconds > 0 ? seconds / elapsedSeconds : 0.0);
+    }
+
+    double megabytes = s_transferredBytes / (1024.0 * 1024.0);
+    fprintf(stderr, ", transferred %.1fMB (%.1fMB/s)\n", megabytes, elapsedSeconds > 0 ? megabytes / elapsedSeconds : 0.0);
+}
+
+}}}
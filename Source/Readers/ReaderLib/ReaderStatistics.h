@@ -0,0 +1,97 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReaderStatistics.h -- time the reader spends in each stage of producing a minibatch.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Stages of producing a minibatch, in the order the data flows through them.
+enum class ReaderStage
+{
+    load,        // loading chunks: I/O, and parsing for deserializers that parse whole chunks
+    deserialize, // getting sequences out of the loaded chunks, i.e. decoding
+    transform,   // applying the transforms to the sequences
+    pack,        // packing the sequences into the minibatch buffers
+    transfer,    // copying the minibatch into the input matrices of the network
+    wait,        // the network waiting for the minibatch
+    count
+};
+
+// Accumulates the time spent in each stage and the number of bytes transferred to the network.
+// Stages that run on several threads at once accumulate the time of each thread, so that the time of
+// a stage divided by the elapsed time is the average number of threads busy with it.
+//
+// The counters are shared by all readers of the module. They are only updated once enabled, readers
+// that are not measured only pay a check per stage.
+class ReaderStatistics
+{
+public:
+    static void Enable()
+    {
+        s_enabled = true;
+    }
+
+    static bool IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static void Add(ReaderStage stage, std::chrono::steady_clock::duration time)
+    {
+        s_time[(size_t)stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+    }
+
+    static void AddTransferredBytes(size_t bytes)
+    {
+        s_transferredBytes += bytes;
+    }
+
+    static void Reset();
+
+    // Prints the time of each stage, and the busy threads over the elapsed time, to stderr.
+    static void Print(const char* prefix, double elapsedSeconds);
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<long long> s_time[(size_t)ReaderStage::count]; // in nanoseconds
+    static std::atomic<size_t> s_transferredBytes;
+};
+
+// Adds the time from its construction to its destruction to a stage.
+class ReaderStageTimer
+{
+public:
+    explicit ReaderStageTimer(ReaderStage stage)
+        : m_stage(stage), m_enabled(ReaderStatistics::IsEnabled())
+    {
+        if (m_enabled)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ReaderStageTimer()
+    {
+        if (m_enabled)
+        {
+            ReaderStatistics::Add(m_stage, std::chrono::steady_clock::now() - m_start);
+        }
+    }
+
+private:
+    ReaderStageTimer(const ReaderStageTimer&) = delete;
+    ReaderStageTimer& operator=(const ReaderStageTimer&) = delete;
+
+    ReaderStage m_stage;
+    bool m_enabled;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+}}}
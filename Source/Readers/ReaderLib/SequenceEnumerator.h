@@ -6,6 +6,7 @@
 #pragma once
 
 #include <vector>
+#include <functional>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -27,6 +28,9 @@ struct Sequences
 class SequenceEnumerator;
 typedef std::shared_ptr<SequenceEnumerator> SequenceEnumeratorPtr;
 
+// A function applied to the data of a single sequence (one entry per stream).
+typedef std::function<void(std::vector<SequenceDataPtr>&)> SequenceTransform;
+
 // Sequence enumerator is internal interface used by the packer to get a set of new sequences.
 // It is implemented either by different randomizers or by TransformController that can wrap the randomizer
 // and apply different transforms on top of data.
@@ -44,6 +48,14 @@ public:
     // Gets next sequences up to a maximum count of samples.
     virtual Sequences GetNextSequences(size_t sampleCount) = 0;
 
+    // Asks the enumerator to apply the transform to each sequence right after it has been deserialized,
+    // on the same worker thread. Returns false if the enumerator does not support this, in which case
+    // the caller has to transform the sequences itself.
+    virtual bool SetSequenceTransform(const SequenceTransform&)
+    {
+        return false;
+    }
+
     virtual ~SequenceEnumerator()
     {
     }
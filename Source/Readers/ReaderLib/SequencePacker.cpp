@@ -7,10 +7,12 @@
 #define _SCL_SECURE_NO_WARNINGS
 
 #include <numeric>
+#include <algorithm>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include "SequencePacker.h"
 #include "ElementTypeUtils.h"
+#include "ReaderStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -27,6 +29,13 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
         infos.push_back(info);
     }
 
+    if (m_packLongestFirst)
+    {
+        // Sequences of the same length keep their order.
+        stable_sort(infos.begin(), infos.end(),
+            [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b) { return a.GetNumTimeSteps() > b.GetNumTimeSteps(); });
+    }
+
     vector<pair<size_t, size_t>> placement;
     vector<size_t> rowAllocations;
 
@@ -49,6 +58,7 @@ Minibatch SequencePacker::ReadMinibatch()
 
     assert(m_outputStreamDescriptions.size() == batch.size());
 
+    ReaderStageTimer timer(ReaderStage::pack);
     for (int streamIndex = 0; streamIndex < batch.size(); ++streamIndex)
     {
         const auto& streamBatch = batch[streamIndex];
@@ -58,15 +68,28 @@ Minibatch SequencePacker::ReadMinibatch()
             CheckSampleShape(streamBatch, m_outputStreamDescriptions[streamIndex]);
         }
 
+        // Object streams, i.e. lattices, are passed on as sequences.
+        if (m_outputStreamDescriptions[streamIndex]->m_elementType == ElementType::tatom)
+        {
+            auto streamMinibatch = std::make_shared<StreamMinibatch>();
+            streamMinibatch->m_data = nullptr;
+            streamMinibatch->m_layout = CreateMBLayout(streamBatch);
+            streamMinibatch->m_sequences = streamBatch;
+            minibatch.m_data.push_back(streamMinibatch);
+            continue;
+        }
+
         const auto& type = m_outputStreamDescriptions[streamIndex]->m_storageType;
+        bool hasImplicitOnes = false;
         auto pMBLayout = (type == StorageType::dense) ?
-            PackDenseStream(streamBatch, streamIndex) : PackSparseStream(streamBatch, streamIndex);
+            PackDenseStream(streamBatch, streamIndex) : PackSparseStream(streamBatch, streamIndex, hasImplicitOnes);
 
         auto& buffer = m_streamBuffers[streamIndex];
 
         auto streamMinibatch = std::make_shared<StreamMinibatch>();
         streamMinibatch->m_data = buffer.m_data.get();
         streamMinibatch->m_layout = pMBLayout;
+        streamMinibatch->m_hasImplicitOnes = hasImplicitOnes;
         minibatch.m_data.push_back(streamMinibatch);
     }
 
@@ -116,6 +139,7 @@ MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t str
     }
 
     auto elementSize = GetSizeByType(stream->m_elementType);
+    const void* one = stream->m_storageType == StorageType::sparse_csc ? GetOneByType(stream->m_elementType) : nullptr;
 
     const auto& sequenceInfos = pMBLayout->GetAllSequences();
 
@@ -157,7 +181,7 @@ MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t str
                 SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
                 // make sure that the sequence meta-data is correct.
                 assert(numSamples == sparseSequence->m_nnzCounts.size());
-                PackSparseSampleAsDense(destination, sparseSequence, sampleIndex, sampleOffset, sampleSize, elementSize);
+                PackSparseSampleAsDense(destination, sparseSequence, sampleIndex, sampleOffset, sampleSize, elementSize, one);
                 // move the offset by nnz count of the sample.
                 sampleOffset += sparseSequence->m_nnzCounts[sampleIndex];
                 // verify that the offset is within the bounds (less or equal 
@@ -174,16 +198,22 @@ MBLayoutPtr SequencePacker::PackDenseStream(const StreamBatch& batch, size_t str
     return pMBLayout;
 }
 
-MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t streamIndex)
+MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t streamIndex, bool& hasImplicitOnes)
 {
     assert(m_outputStreamDescriptions[streamIndex]->m_storageType == StorageType::sparse_csc);
 
-    // compute the aggregate nnz count of all the sequence in the batch.
+    // compute the aggregate nnz count of all the sequence in the batch,
+    // and whether the values can be left out as they are all 1.
     size_t nnzCount = 0;
+    hasImplicitOnes = true;
     for (const auto& sequence : batch)
     {
         SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
         nnzCount += sparseSequence->m_totalNnzCount;
+        if (sparseSequence->m_data != nullptr)
+        {
+            hasImplicitOnes = false;
+        }
     }
 
     if (nnzCount > numeric_limits<IndexType>::max())
@@ -194,12 +224,13 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
 
     const auto& stream = m_inputStreamDescriptions[streamIndex];
     assert(stream->m_storageType == StorageType::sparse_csc);
-    auto elementSize = GetSizeByType(stream->m_elementType);
+    auto elementSize = hasImplicitOnes ? 0 : GetSizeByType(stream->m_elementType);
+    const void* one = GetOneByType(stream->m_elementType);
     auto indexSize = sizeof(IndexType);
     auto pMBLayout = CreateMBLayout(batch);
 
     // Compute the required buffer size:
-    // size of nnz type + nnz * (size of the element type) + nnz * (size of the row index type) + 
+    // size of nnz type + nnz * (size of the element type, 0 without values) + nnz * (size of the row index type) + 
     // (number of columns + 1) * (size of the column index type). 
     size_t requiredSize =
         sizeof(nnzCount) +
@@ -224,11 +255,24 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
     IndexType columnOffset = 0;
     // a vector to store column index for each sample in the resulting (packed) matrix.
     vector<IndexType> sparseColumnIndices;
+    sparseColumnIndices.reserve(pMBLayout->GetNumCols() + 1);
     // a vector to keep track of the offsets into each input sequence,
     // there an offset is the number of nnz values packed so far. Current sample
     // values/indices start of the offset position in the sequence data/index array
     vector<IndexType>  sequenceOffsets(batch.size(), 0); 
 
+    // The samples to copy, found in the first pass. They do not overlap in the buffer,
+    // so that the second pass can copy them in parallel.
+    struct SampleCopy
+    {
+        const SparseSequenceData* m_sequence;
+        IndexType m_sourceOffset;      // number of nnz values before the sample in the sequence
+        IndexType m_destinationOffset; // number of nnz values before the sample in the minibatch
+        IndexType m_nnzCount;
+    };
+    vector<SampleCopy> copies;
+    copies.reserve(pMBLayout->GetNumCols());
+
     vector<MBLayout::SequenceInfo> sequenceInfos(pMBLayout->GetAllSequences());
 
     // sort the vector in ascending order of the parallel sequence index.
@@ -266,26 +310,45 @@ MBLayoutPtr SequencePacker::PackSparseStream(const StreamBatch& batch, size_t st
             assert(sampleIndex < sequence->m_numberOfSamples);
 
             auto& sequenceOffset = sequenceOffsets[seqId];
-            SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(sequence);
+            const SparseSequenceData* sparseSequence = static_cast<const SparseSequenceData*>(sequence.get());
             IndexType nnz = sparseSequence->m_nnzCounts[sampleIndex];
-
-            // compute the sample offset in bytes.
-            size_t sampleOffset = sequenceOffset * elementSize;
-            // copy all nzz values from source sequence into the buffer.
-            const auto* dataSrc = reinterpret_cast<const char*>(sequence->m_data) + sampleOffset;
-            memcpy(dataDst, dataSrc, nnz * elementSize);
-            dataDst += nnz * elementSize; // advance the destination pointer
-
-            // copy all nzz value indices from source sequence into the buffer.
-            const auto* indicesSrc = sparseSequence->m_indices + sequenceOffset;
-            memcpy(indicesDst, indicesSrc, nnz * indexSize);
-            indicesDst += nnz * indexSize; // advance the destination pointer
+            if (nnz > 0)
+            {
+                copies.push_back(SampleCopy{ sparseSequence, sequenceOffset, columnOffset, nnz });
+            }
 
             sequenceOffset += nnz;
             columnOffset += nnz;
         }
     }
 
+    // Copy all nnz values and their indices from the source sequences into the buffer.
+    // With many nonzero values per minibatch, the copies are spread over the threads.
+    const size_t minNnzCountForParallelCopy = 1 << 16;
+#pragma omp parallel for schedule(static) if (nnzCount >= minNnzCountForParallelCopy)
+    for (int i = 0; i < (int)copies.size(); ++i)
+    {
+        const auto& copy = copies[i];
+        if (copy.m_sequence->m_data != nullptr)
+        {
+            const auto* dataSrc = reinterpret_cast<const char*>(copy.m_sequence->m_data) + copy.m_sourceOffset * elementSize;
+            memcpy(dataDst + copy.m_destinationOffset * elementSize, dataSrc, copy.m_nnzCount * elementSize);
+        }
+        else if (!hasImplicitOnes)
+        {
+            // materialize the ones of a sequence without values
+            for (IndexType j = 0; j < copy.m_nnzCount; ++j)
+            {
+                memcpy(dataDst + (copy.m_destinationOffset + j) * elementSize, one, elementSize);
+            }
+        }
+
+        const auto* indicesSrc = copy.m_sequence->m_indices + copy.m_sourceOffset;
+        memcpy(indicesDst + copy.m_destinationOffset * indexSize, indicesSrc, copy.m_nnzCount * indexSize);
+    }
+    dataDst += nnzCount * elementSize;
+    indicesDst += nnzCount * indexSize;
+
     // at this point each element in sequenceOffsets should be equal to the total
     // nnz count of the respective sequence and the sum of all elements - to the 
     // overall nnz count.
@@ -11,14 +11,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This packer generates minibatches containing full sequences packed for 
 // efficient (concurrent) consumption on a GPU.
+// If packLongestFirst is set, the sequences are placed into the parallel sequences of the layout longest first
+// (first-fit decreasing), which needs fewer and fuller parallel sequences than placing them in the given order.
 class SequencePacker : public PackerBase
 {
 public:
     SequencePacker(
         MemoryProviderPtr memoryProvider,
         SequenceEnumeratorPtr sequenceEnumerator,
-        const std::vector<StreamDescriptionPtr>& streams) :
-        PackerBase(memoryProvider, sequenceEnumerator, streams)
+        const std::vector<StreamDescriptionPtr>& streams,
+        bool packLongestFirst = false) :
+        PackerBase(memoryProvider, sequenceEnumerator, streams),
+        m_packLongestFirst(packLongestFirst)
     {
 
     }
@@ -28,7 +32,8 @@ public:
 protected:
     virtual MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex);
 
-    virtual MBLayoutPtr PackSparseStream(const StreamBatch& batch, size_t streamIndex);
+    // Leaves out the values if no sequence of the batch has any, i.e. all are 1 (hasImplicitOnes).
+    virtual MBLayoutPtr PackSparseStream(const StreamBatch& batch, size_t streamIndex, bool& hasImplicitOnes);
 
     // Given a number of sequences, creates an MB layout that is used to guide
     // the actual packing.
@@ -36,6 +41,8 @@ protected:
 
     // Helper function to check the sample shape of input samples.
     void CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream);
+
+    bool m_packLongestFirst;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -18,8 +18,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     SequenceRandomizer::SequenceRandomizer(
         int verbosity,
         IDataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer)
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t lengthBucketSize)
         : m_verbosity(verbosity),
+        m_lengthBucketSize(lengthBucketSize),
         m_randomizedChunks(chunkRandomizer->GetRandomizedChunks()),
         m_chunkWindowBegin(0),
         m_randomizedWindowEnd(0),
@@ -228,9 +230,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
         }
 
+        // Sequences of the chunk are at their final positions now.
+        size_t randomizedChunk = m_randomizedWindowEnd - m_chunkWindowBegin;
+        if (m_lengthBucketSize > 0)
+        {
+            BucketByLength(m_sequenceWindow[randomizedChunk]);
+        }
+
         // Let's recalculate number of samples in the randomized chunks for efficient indexing in seek.
         size_t sampleCount = 0;
-        size_t randomizedChunk = m_randomizedWindowEnd - m_chunkWindowBegin;
         for (size_t index = 0; index < m_sequenceWindow[randomizedChunk].size(); index++)
         {
             sampleCount += m_sequenceWindow[randomizedChunk][index].m_numberOfSamples;
@@ -258,6 +266,46 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_randomizationCursor);
     }
 
+    void SequenceRandomizer::BucketByLength(std::vector<RandomizedSequenceDescription>& sequences)
+    {
+        // Sequences of the same length keep their randomized order.
+        std::stable_sort(sequences.begin(), sequences.end(),
+            [](const RandomizedSequenceDescription& a, const RandomizedSequenceDescription& b) { return a.m_numberOfSamples < b.m_numberOfSamples; });
+
+        // Bucket boundaries.
+        std::vector<size_t> bucketStarts;
+        size_t bucketSamples = m_lengthBucketSize;
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            if (bucketSamples >= m_lengthBucketSize)
+            {
+                bucketStarts.push_back(i);
+                bucketSamples = 0;
+            }
+            bucketSamples += sequences[i].m_numberOfSamples;
+        }
+
+        // Shuffling the buckets with the random generator of the sweep keeps the order reproducible.
+        std::vector<size_t> order(bucketStarts.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        for (size_t i = order.size(); i > 1; --i)
+        {
+            std::swap(order[i - 1], order[rand(0, i)]);
+        }
+
+        std::vector<RandomizedSequenceDescription> bucketed;
+        bucketed.reserve(sequences.size());
+        for (size_t bucket : order)
+        {
+            size_t end = bucket + 1 < bucketStarts.size() ? bucketStarts[bucket + 1] : sequences.size();
+            bucketed.insert(bucketed.end(), sequences.begin() + bucketStarts[bucket], sequences.begin() + end);
+        }
+        sequences.swap(bucketed);
+    }
+
     // Sets current cursor to the given sample offset.
     // If offset is in the middle of the sequence, the next sequence is picked up.
     // If there is no sequence, an offset outside the sweep is returned.
@@ -311,13 +359,31 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             // (unless we need to go past the randomized chunk window)
         }
 
-        // Advance sequence by sequence until the desire offset is reached.
         if (m_verbosity)
             fprintf(stderr, "SequenceRandomizer::Seek(): advancing cursor from %" PRIu64 " to %" PRIu64 "\n",
                 m_currentSampleCursor,
                 sweepSampleOffset);
 
-        // TODO perhaps optimize this
+        // Skip the chunks that end before the offset as a whole. The chunks still have to be randomized in order,
+        // to get the same sequence positions on restart, but their sequences are not visited.
+        while (m_currentChunkCursor < m_randomizedChunks.size())
+        {
+            const auto& info = m_randomizedChunkInfo[m_currentChunkCursor - m_chunkWindowBegin];
+            if (info.start + info.numberOfSamples > sweepSampleOffset)
+            {
+                break;
+            }
+
+            m_currentSequenceCursor = m_randomizedChunks[m_currentChunkCursor].SequenceEndPosition();
+            m_currentSampleCursor = info.start + info.numberOfSamples;
+            MoveChunkCursor();
+            if (m_chunkWindowBegin < m_currentChunkCursor)
+            {
+                ReleaseChunks();
+            }
+        }
+
+        // Advance sequence by sequence until the desire offset is reached.
         while (m_currentSampleCursor < sweepSampleOffset)
         {
             GetNextSequenceDescriptions(1);
@@ -34,7 +34,8 @@ public:
     SequenceRandomizer(
         int verbosity,
         IDataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer);
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t lengthBucketSize = 0);
 
     // Resets the current sweep according to the randomization seed provided.
     void Reset(size_t seed);
@@ -79,7 +80,14 @@ private:
     // Move the chunk cursor to the next chunk, randomizing more sequences if necessary.
     void MoveChunkCursor();
 
+    // Reorders the randomized sequences of a chunk into buckets of similar length (see m_lengthBucketSize).
+    void BucketByLength(std::vector<RandomizedSequenceDescription>& sequences);
+
 private:
+    // If not 0, the sequences of each randomized chunk are sorted by length, cut into buckets of about this
+    // many samples, and the buckets are shuffled. A minibatch then mostly holds sequences of similar length,
+    // which can be packed with little padding. Sequences stay in their chunk, so the randomization windows hold.
+    size_t m_lengthBucketSize;
 
     IDataDeserializerPtr m_deserializer;
 
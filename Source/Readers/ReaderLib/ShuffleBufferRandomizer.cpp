@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+
+#include "ShuffleBufferRandomizer.h"
+#include "DataReader.h"
+#include "ReaderStatistics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ShuffleBufferRandomizer::ShuffleBufferRandomizer(IStreamingDataDeserializerPtr deserializer, size_t bufferSizeInSamples, unsigned int seed)
+    : m_deserializer(deserializer),
+      m_bufferSizeInSamples(bufferSizeInSamples),
+      m_bufferedSamples(0),
+      m_nextSequence(0),
+      m_nextSequenceChosen(false),
+      m_endOfInput(false),
+      m_rng(seed),
+      m_samplePositionInEpoch(0)
+{
+    assert(deserializer != nullptr);
+    m_streams = m_deserializer->GetStreamDescriptions();
+}
+
+void ShuffleBufferRandomizer::StartEpoch(const EpochConfiguration& config)
+{
+    m_config = config;
+    m_samplePositionInEpoch = 0;
+}
+
+void ShuffleBufferRandomizer::FillBuffer()
+{
+    while (!m_endOfInput && (m_buffer.empty() || m_bufferedSamples < m_bufferSizeInSamples))
+    {
+        BufferedSequence sequence;
+        ReaderStageTimer timer(ReaderStage::load);
+        if (!m_deserializer->GetNextSequence(sequence.m_data))
+        {
+            m_endOfInput = true;
+            break;
+        }
+
+        assert(sequence.m_data.size() == m_streams.size());
+        sequence.m_numberOfSamples = 0;
+        for (const auto& s : sequence.m_data)
+        {
+            sequence.m_numberOfSamples = std::max<size_t>(sequence.m_numberOfSamples, s->m_numberOfSamples);
+        }
+
+        m_bufferedSamples += sequence.m_numberOfSamples;
+        m_buffer.push_back(std::move(sequence));
+    }
+}
+
+Sequences ShuffleBufferRandomizer::GetNextSequences(size_t sampleCount)
+{
+    Sequences result;
+    if (m_config.m_totalEpochSizeInSamples <= m_samplePositionInEpoch)
+    {
+        result.m_endOfEpoch = true;
+        return result;
+    }
+
+    // Drawing sequences for the whole minibatch, all workers draw the same ones.
+    std::vector<BufferedSequence> sequences;
+    size_t numberOfSamples = 0;
+    for (;;)
+    {
+        FillBuffer();
+        if (m_buffer.empty())
+        {
+            break;
+        }
+
+        if (!m_nextSequenceChosen)
+        {
+            m_nextSequence = std::uniform_int_distribution<size_t>(0, m_buffer.size() - 1)(m_rng);
+            m_nextSequenceChosen = true;
+        }
+
+        size_t sequenceSize = m_buffer[m_nextSequence].m_numberOfSamples;
+        if (!sequences.empty() && numberOfSamples + sequenceSize > sampleCount)
+        {
+            break;
+        }
+
+        std::swap(m_buffer[m_nextSequence], m_buffer.back());
+        sequences.push_back(std::move(m_buffer.back()));
+        m_buffer.pop_back();
+        m_bufferedSamples -= sequenceSize;
+        m_nextSequenceChosen = false;
+        numberOfSamples += sequenceSize;
+    }
+
+    if (sequences.empty())
+    {
+        // The input is exhausted, this ends the epoch whatever its configured size.
+        result.m_endOfEpoch = true;
+        return result;
+    }
+
+    m_samplePositionInEpoch += numberOfSamples;
+
+    // Retrieve only sequences that are required by this worker.
+    size_t start = sequences.size() * m_config.m_workerRank / m_config.m_numberOfWorkers;
+    size_t end = sequences.size() * (m_config.m_workerRank + 1) / m_config.m_numberOfWorkers;
+    if (start == end)
+    {
+        return result;
+    }
+
+    result.m_data.resize(m_streams.size(), std::vector<SequenceDataPtr>(end - start));
+    for (size_t i = start; i < end; ++i)
+    {
+        for (size_t j = 0; j < m_streams.size(); ++j)
+        {
+            result.m_data[j][i - start] = sequences[i].m_data[j];
+        }
+    }
+
+    return result;
+}
+
+}}}
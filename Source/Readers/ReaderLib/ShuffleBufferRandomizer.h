@@ -0,0 +1,77 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <vector>
+#include <random>
+#include "SequenceEnumerator.h"
+#include "DataDeserializer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A randomizer over a streaming deserializer, for inputs of unknown size that cannot be indexed up front.
+// Sequences are read in input order into a shuffle buffer of at least bufferSizeInSamples samples, and each
+// sequence of a minibatch is drawn uniformly at random from the buffer, which is then topped up from the input.
+// With bufferSizeInSamples == 0 the sequences are returned in input order.
+//
+// There are no sweeps: an epoch is the next m_totalEpochSizeInSamples samples of the input, or, if the epoch size
+// is not specified, the rest of the input. The input cannot be rewound, so the epoch index is not used to seek,
+// the epochs simply follow each other. As in the NoRandomizer, each worker takes its stride of every minibatch,
+// so all workers have to read the same input and use the same seed.
+class ShuffleBufferRandomizer : public SequenceEnumerator
+{
+public:
+    ShuffleBufferRandomizer(IStreamingDataDeserializerPtr deserializer, size_t bufferSizeInSamples, unsigned int seed = 0);
+
+    virtual void StartEpoch(const EpochConfiguration& config) override;
+    virtual Sequences GetNextSequences(size_t sampleCount) override;
+    virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+private:
+    // A sequence in the buffer, one entry per stream.
+    struct BufferedSequence
+    {
+        std::vector<SequenceDataPtr> m_data;
+        size_t m_numberOfSamples;
+    };
+
+    // Reads sequences from the input until the buffer holds at least m_bufferSizeInSamples samples
+    // and at least one sequence, or the input is exhausted.
+    void FillBuffer();
+
+    IStreamingDataDeserializerPtr m_deserializer;
+
+    // Stream descriptions
+    std::vector<StreamDescriptionPtr> m_streams;
+
+    // Epoch configuration
+    EpochConfiguration m_config;
+
+    // Minimal number of samples kept in the buffer while the input lasts.
+    size_t m_bufferSizeInSamples;
+
+    // Sequences read from the input and not yet returned.
+    std::vector<BufferedSequence> m_buffer;
+    size_t m_bufferedSamples;
+
+    // The sequence drawn from the buffer that did not fit into the previous minibatch, it is returned next.
+    // Drawing again instead would favor short sequences.
+    size_t m_nextSequence;
+    bool m_nextSequenceChosen;
+
+    // Whether the end of the input has been reached.
+    bool m_endOfInput;
+
+    std::mt19937_64 m_rng;
+
+    // Current sample position in the epoch.
+    size_t m_samplePositionInEpoch;
+};
+
+}}}
@@ -8,83 +8,153 @@
 #include <string>
 #include <memory>
 #include <vector>
-#include <map>
+#include <algorithm>
+#include <stdint.h>
 #include "Basics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This class represents a string registry pattern to share strings between different deserializers if needed.
 // It associates a unique key for a given string.
+// Ids are assigned consecutively from 0, in the order the strings are added.
 // Currently it is implemented in-memory, but can be unloaded to external disk if needed.
+// The registry holds the keys of all sequences of a corpus, so it is kept compact: the strings are
+// concatenated in a single buffer, and found through an open-addressing hash table of their ids,
+// which takes about the size of the strings plus 16 to 32 bytes per string.
 // TODO: Move this class to Basics.h when it is required by more than one reader.
 template<class TString>
 class TStringToIdMap
 {
+    typedef typename TString::value_type CharType;
+
 public:
-    TStringToIdMap()
+    TStringToIdMap() : m_offsets(1, 0)
     {}
 
-    // Adds string value to the registry.
+    // Adds string value to the registry, returns its id.
     size_t AddValue(const TString& value)
     {
-        auto iter = m_values.insert(std::make_pair(value, m_indexedValues.size()));
-        m_indexedValues.push_back(&((iter.first)->first));
-        return m_indexedValues.size() - 1;
+        size_t id;
+        if (TryGet(value, id))
+        {
+            return id;
+        }
+
+        // Keeping the load factor at most 1/2 keeps the probe sequences short.
+        if (2 * (Size() + 1) > m_slots.size())
+        {
+            Rehash(std::max<size_t>(1024, 2 * m_slots.size()));
+        }
+
+        id = Size();
+        m_characters.insert(m_characters.end(), value.begin(), value.end());
+        m_offsets.push_back(m_characters.size());
+        m_slots[FindSlot(value.data(), value.size())] = id + 1;
+        return id;
     }
 
     // Tries to get a value by id.
     bool TryGet(const TString& value, size_t& id) const
     {
-        const auto& it = m_values.find(value);
-        if (it == m_values.end())
+        if (m_slots.empty())
         {
             return false;
         }
-        else
+
+        size_t slot = m_slots[FindSlot(value.data(), value.size())];
+        if (slot == 0)
         {
-            id = it->second;
-            return true;
+            return false;
         }
+
+        id = slot - 1;
+        return true;
     }
 
     // Get integer id for the string value, adding if not exists.
     size_t operator[](const TString& value)
     {
-        const auto& it = m_values.find(value);
-        if (it == m_values.end())
-        {
-            return AddValue(value);
-        }
-        return it->second;
+        return AddValue(value);
     }
 
     // Get integer id for the string value.
     size_t operator[](const TString& value) const
     {
-        const auto& it = m_values.find(value);
-        assert(it != m_values.end());
-        return it->second;
+        size_t id = SIZE_MAX;
+        bool found = TryGet(value, id);
+        assert(found);
+        UNUSED(found);
+        return id;
     }
 
     // Get string value by its integer id.
-    const TString& operator[](size_t id) const
+    TString operator[](size_t id) const
     {
-        assert(id < m_indexedValues.size());
-        return *m_indexedValues[id];
+        assert(id < Size());
+        return TString(m_characters.data() + m_offsets[id], m_characters.data() + m_offsets[id + 1]);
     }
 
     // Checks whether the value exists.
     bool Contains(const TString& value) const
     {
-        return m_values.find(value) != m_values.end();
+        size_t id;
+        return TryGet(value, id);
+    }
+
+    // Number of strings in the registry.
+    size_t Size() const
+    {
+        return m_offsets.size() - 1;
     }
 
 private:
     // TODO: Move NonCopyable as a separate class to Basics.h
     DISABLE_COPY_AND_MOVE(TStringToIdMap);
 
-    std::map<TString, size_t> m_values;
-    std::vector<const TString*> m_indexedValues;
+    // FNV-1a; unlike std::hash, the same on all platforms.
+    static uint64_t Hash(const CharType* value, size_t length)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash ^= (uint64_t)value[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    bool Equals(size_t id, const CharType* value, size_t length) const
+    {
+        return m_offsets[id + 1] - m_offsets[id] == length &&
+               std::equal(value, value + length, m_characters.begin() + m_offsets[id]);
+    }
+
+    // Returns the slot that holds the value, or else the empty slot where it would go.
+    size_t FindSlot(const CharType* value, size_t length) const
+    {
+        size_t mask = m_slots.size() - 1;
+        size_t slot = (size_t)Hash(value, length) & mask;
+        while (m_slots[slot] != 0 && !Equals(m_slots[slot] - 1, value, length))
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    // numberOfSlots must be a power of 2.
+    void Rehash(size_t numberOfSlots)
+    {
+        m_slots.assign(numberOfSlots, 0);
+        for (size_t id = 0; id < Size(); ++id)
+        {
+            const CharType* value = m_characters.data() + m_offsets[id];
+            m_slots[FindSlot(value, m_offsets[id + 1] - m_offsets[id])] = id + 1;
+        }
+    }
+
+    std::vector<CharType> m_characters; // all strings, concatenated in the order of their ids
+    std::vector<size_t> m_offsets;      // start of each string in m_characters, followed by the end of the last
+    std::vector<size_t> m_slots;        // hash table of id + 1, 0 for an empty slot
 };
 
 typedef TStringToIdMap<std::wstring> WStringToIdMap;
@@ -10,6 +10,7 @@
 #include "Transformer.h"
 #include "SequenceEnumerator.h"
 #include "ExceptionCapture.h"
+#include "ReaderStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -23,11 +24,14 @@ struct Transformation
 // A class responsible for applying a list of transformers to sequences and stream descriptions.
 // Delegates retrieving of sequences to another sequence provider(such as randomizer) and applies transformations after retrieving.
 // Usually used by the packer to get next set of sequences.
+// If the sequence provider supports it, the transformations are handed over to it and applied to each sequence
+// by the worker thread that deserializes it, so that an image, for example, is decoded and transformed in one go
+// while it is still in the cache, without a second parallel pass over the minibatch.
 class TransformController : public SequenceEnumerator
 {
 public:
     TransformController(const std::vector<Transformation>& transformations, SequenceEnumeratorPtr sequenceProvider)
-        : m_sequenceProvider(sequenceProvider)
+        : m_sequenceProvider(sequenceProvider), m_transformsAppliedByProvider(false)
     {
         // Applying transformations to stream descriptions,
         // i.e. a transformation can change a stream from dense to sparse.
@@ -39,6 +43,9 @@ public:
             transformedStreams[streamId] = std::make_shared<StreamDescription>(t.m_transformer->Transform(*transformedStreams[streamId]));
         }
         m_outputStreams = transformedStreams;
+
+        m_transformsAppliedByProvider = m_sequenceProvider->SetSequenceTransform(
+            [this](std::vector<SequenceDataPtr>& sequence) { Apply(sequence); });
     }
 
     // Sets configuration for the current epoch.
@@ -66,7 +73,7 @@ public:
     {
         assert(m_sequenceProvider != nullptr);
         Sequences sequences = m_sequenceProvider->GetNextSequences(sampleCount);
-        if (sequences.m_data.empty())
+        if (sequences.m_data.empty() || m_transformsAppliedByProvider)
         {
             return sequences;
         }
@@ -77,6 +84,7 @@ public:
         {
             capture.SafeRun([this, &sequences](int sequenceId)
             {
+                ReaderStageTimer timer(ReaderStage::transform);
                 for (auto& t : m_transformations)
                 {
                     sequences.m_data[t.second][sequenceId] = t.first.m_transformer->Transform(sequences.m_data[t.second][sequenceId]);
@@ -89,6 +97,16 @@ public:
     }
 
 private:
+    // Applies all transformations to the streams of a single sequence.
+    void Apply(std::vector<SequenceDataPtr>& sequence)
+    {
+        ReaderStageTimer timer(ReaderStage::transform);
+        for (auto& t : m_transformations)
+        {
+            sequence[t.second] = t.first.m_transformer->Transform(sequence[t.second]);
+        }
+    }
+
     size_t GetStreamId(const std::wstring streamName, const std::vector<StreamDescriptionPtr>& streams) const
     {
         for (const auto& s : streams)
@@ -106,6 +124,7 @@ private:
     SequenceEnumeratorPtr m_sequenceProvider;
     std::vector<StreamDescriptionPtr> m_outputStreams;
     std::vector<std::pair<Transformation, size_t>> m_transformations;
+    bool m_transformsAppliedByProvider;
 };
 
 }}}
@@ -9,6 +9,7 @@
 #include <deque>
 #include "TruncatedBpttPacker.h"
 #include "ElementTypeUtils.h"
+#include "ReaderStatistics.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -119,6 +120,12 @@ TruncatedBPTTPacker::TruncatedBPTTPacker(
         RuntimeError("Sparse output is not supported in BPTT mode.");
     }
 
+    auto objectOutput = find_if(m_outputStreamDescriptions.begin(), m_outputStreamDescriptions.end(), [](const StreamDescriptionPtr& s){ return s->m_elementType == ElementType::tatom; });
+    if (objectOutput != m_outputStreamDescriptions.end())
+    {
+        RuntimeError("Stream '%ls' holds whole sequences, i.e. lattices, which cannot be truncated in BPTT mode.", (*objectOutput)->m_name.c_str());
+    }
+
     // Preparing layouts.
     for (int i = 0; i < m_outputStreamDescriptions.size(); ++i)
     {
@@ -215,6 +222,8 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
     // Fill free space in the slot.
     ReadSequencesToSlot(slotIndex);
 
+    ReaderStageTimer timer(ReaderStage::pack);
+
     // Let's see how much samples we need to read.
     size_t numberOfSamples = min(m_truncationSize, slot.AvailableNumberOfSamples());
     if (numberOfSamples == 0)
@@ -280,7 +289,7 @@ void TruncatedBPTTPacker::PackSlot(size_t streamIndex, size_t slotIndex, size_t&
             SparseSequenceDataPtr sparseSequence = static_pointer_cast<SparseSequenceData>(data);
             assert(slot.m_sampleCursor < sparseSequence->m_nnzCounts.size());
             PackSparseSampleAsDense(destination, sparseSequence, slot.m_sampleCursor, 
-                slot.m_sampleOffset, sampleSize, elementSize);
+                slot.m_sampleOffset, sampleSize, elementSize, GetOneByType(m_inputStreamDescriptions[streamIndex]->m_elementType));
             slot.m_sampleOffset += sparseSequence->m_nnzCounts[slot.m_sampleCursor];
             assert(slot.m_sampleOffset <= sparseSequence->m_totalNnzCount);
         }
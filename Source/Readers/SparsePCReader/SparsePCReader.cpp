@@ -49,28 +49,6 @@ SparsePCReader<ElemType>::~SparsePCReader()
     munmap(m_dataBuffer, m_filePositionMax); 
     close(m_hndl);
 #endif
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        if (m_values[i] != NULL)
-        {
-            free(m_values[i]);
-        }
-
-        if (m_rowIndices[i] != NULL)
-        {
-            free(m_rowIndices[i]);
-        }
-
-        if (m_colIndices[i] != NULL)
-        {
-            free(m_colIndices[i]);
-        }
-    }
-
-    if (m_labelsBuffer != NULL)
-    {
-        free(m_labelsBuffer);
-    }
 }
 
 template <class ElemType>
@@ -119,9 +97,10 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 
     m_featureNames = std::vector<std::wstring>(m_featureCount);
     m_dims = std::vector<size_t>(m_featureCount);
-    m_values = std::vector<ElemType*>(m_featureCount);
-    m_rowIndices = std::vector<int32_t*>(m_featureCount);
-    m_colIndices = std::vector<int32_t*>(m_featureCount);
+    m_values.resize(m_featureCount);
+    m_rowIndices.resize(m_featureCount);
+    m_colIndices.resize(m_featureCount);
+    m_nnz.resize(m_featureCount);
 
     for (int i = 0; i < m_featureCount; i++)
     {
@@ -177,25 +156,17 @@ void SparsePCReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConf
 template <class ElemType>
 void SparsePCReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t /*epoch*/, size_t /*requestedEpochSamples*/)
 {
-    if (m_values[0] == NULL || m_miniBatchSize != mbSize)
-    {
-        m_miniBatchSize = mbSize;
+    m_miniBatchSize = mbSize;
 
+    if (m_labelsBuffer.size() < m_miniBatchSize)
+    {
         for (int i = 0; i < m_featureCount; i++)
         {
-            if (m_values[i] != NULL)
-            {
-                free(m_values[i]);
-                free(m_colIndices[i]);
-                free(m_rowIndices[i]);
-                free(m_labelsBuffer);
-            }
-
-            m_values[i] = (ElemType*) malloc(sizeof(ElemType) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_rowIndices[i] = (int32_t*) malloc(sizeof(int32_t) * m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
-            m_colIndices[i] = (int32_t*) malloc(sizeof(int32_t) * (m_miniBatchSize + 1));
-            m_labelsBuffer = (ElemType*) malloc(sizeof(ElemType) * m_miniBatchSize);
+            m_values[i].resize(m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
+            m_rowIndices[i].resize(m_dims[i] * m_miniBatchSize / m_sparsenessFactor);
+            m_colIndices[i].resize(m_miniBatchSize + 1);
         }
+        m_labelsBuffer.resize(m_miniBatchSize);
     }
 
     // reset the next read sample
@@ -228,11 +199,8 @@ bool SparsePCReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
             RuntimeError("SparsePCReader only supports single label value per column but the network expected %d.", (int) labels->GetNumRows());
     }
 
-    std::vector<int32_t> currIndex = std::vector<int32_t>(m_featureCount);
-    for (int i = 0; i < m_featureCount; i++)
-    {
-        currIndex[i] = 0;
-    }
+    std::vector<int32_t>& currIndex = m_nnz;
+    std::fill(currIndex.begin(), currIndex.end(), 0);
 
     size_t j = 0;
 
@@ -250,10 +218,10 @@ bool SparsePCReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
                 RuntimeError("Input data is too dense - not enough memory allocated");
             }
 
-            memcpy(m_values[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(ElemType) * nnz);
+            memcpy(m_values[i].data() + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(ElemType) * nnz);
             m_currOffset += (sizeof(ElemType) * nnz);
 
-            memcpy(m_rowIndices[i] + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(int32_t) * nnz);
+            memcpy(m_rowIndices[i].data() + currIndex[i], (char*) m_dataBuffer + m_currOffset, sizeof(int32_t) * nnz);
             m_currOffset += (sizeof(int32_t) * nnz);
 
             currIndex[i] += nnz;
@@ -285,7 +253,7 @@ bool SparsePCReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
         if (features.GetFormat() != MatrixFormat::matrixFormatSparseCSC)
             features.SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
 
-        features.SetMatrixFromCSCFormat(m_colIndices[i], m_rowIndices[i], m_values[i], currIndex[i], m_dims[i], j);
+        features.SetMatrixFromCSCFormat(m_colIndices[i].data(), m_rowIndices[i].data(), m_values[i].data(), currIndex[i], m_dims[i], j);
     }
 
     if (m_returnDense || m_doGradientCheck)
@@ -296,9 +264,7 @@ bool SparsePCReader<ElemType>::TryGetMinibatch(StreamMinibatchInputs& matrices)
 
     if (labels)
     {
-        labels->Resize(1, j);
-        labels->SetValue((ElemType) 0);
-        labels->SetValue(1, j, labels->GetDeviceId(), m_labelsBuffer, 0);
+        labels->SetValue(1, j, labels->GetDeviceId(), m_labelsBuffer.data(), 0);
     }
 
     // create the MBLayout
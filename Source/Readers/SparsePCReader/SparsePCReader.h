@@ -36,10 +36,12 @@ class SparsePCReader : public DataReaderBase
     bool m_returnDense;
     size_t m_sparsenessFactor;
     int32_t m_verificationCode;
-    std::vector<ElemType*> m_values;
-    std::vector<int32_t*> m_rowIndices;
-    std::vector<int32_t*> m_colIndices;
-    ElemType* m_labelsBuffer;
+    // CSC buffers of each feature and the labels of a minibatch, they only grow so that they are reused across minibatches and epochs
+    std::vector<std::vector<ElemType>> m_values;
+    std::vector<std::vector<int32_t>> m_rowIndices;
+    std::vector<std::vector<int32_t>> m_colIndices;
+    std::vector<int32_t> m_nnz;
+    std::vector<ElemType> m_labelsBuffer;
     MBLayoutPtr m_pMBLayout;
 
 #ifdef SPARSE_PCREADER_USE_WINDOWS_API
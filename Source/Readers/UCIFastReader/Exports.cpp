@@ -9,6 +9,8 @@
 #define DATAREADER_EXPORTS
 #include "DataReader.h"
 #include "UCIFastReader.h"
+#include "UCIDeserializer.h"
+#include "StringUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -21,4 +23,27 @@ extern "C" DATAREADER_API void GetReaderD(IDataReader** preader)
     *preader = new UCIFastReader<double>();
 }
 
+// A factory method for creating the UCI deserializer, used by CompositeDataReader with module = "UCIFastReader".
+extern "C" DATAREADER_API bool CreateDeserializer(IDataDeserializer** deserializer, const std::wstring& type, const ConfigParameters& deserializerConfig, CorpusDescriptorPtr corpus, bool)
+{
+    string precision = deserializerConfig.Find("precision", "float");
+    if (!AreEqualIgnoreCase(precision, "float") && !AreEqualIgnoreCase(precision, "double"))
+    {
+        InvalidArgument("Unsupported precision '%s'", precision.c_str());
+    }
+
+    if (type == L"UCIDeserializer")
+    {
+        if (AreEqualIgnoreCase(precision, "float"))
+            *deserializer = new UCIDeserializer<float>(corpus, deserializerConfig);
+        else // double
+            *deserializer = new UCIDeserializer<double>(corpus, deserializerConfig);
+    }
+    else
+        InvalidArgument("Unknown deserializer type '%ls'", type.c_str());
+
+    // Deserializer created.
+    return true;
+}
+
 }}}
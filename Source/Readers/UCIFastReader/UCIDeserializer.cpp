@@ -0,0 +1,356 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include "UCIDeserializer.h"
+#include "fileutil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using namespace std;
+
+// The samples of all lines of a chunk, parsed when the chunk is created, one contiguous buffer per stream.
+template <class ElemType>
+class UCIDeserializer<ElemType>::UCIChunk : public Chunk, public std::enable_shared_from_this<Chunk>
+{
+    vector<StreamDescriptionPtr> m_streams;
+    size_t m_numberOfSequences;
+    vector<vector<ElemType>> m_values;   // dense: values of the samples; category: a single one
+    vector<vector<IndexType>> m_classes; // category: class of each sample
+
+public:
+    UCIChunk(UCIDeserializer& parent, const ChunkDescriptor& descriptor)
+        : m_streams(parent.m_streams), m_numberOfSequences(descriptor.m_numberOfSequences)
+    {
+        m_values.resize(m_streams.size());
+        m_classes.resize(m_streams.size());
+        for (size_t i = 0; i < m_streams.size(); ++i)
+        {
+            if (parent.m_columns[i].m_category)
+            {
+                m_values[i].assign(1, (ElemType)1);
+                m_classes[i].resize(m_numberOfSequences);
+            }
+            else
+            {
+                m_values[i].resize(m_numberOfSequences * parent.m_columns[i].m_dim);
+            }
+        }
+
+        if (m_numberOfSequences == 0)
+        {
+            return;
+        }
+
+        // The lines of a chunk are consecutive, so the chunk is read at once.
+        int64_t chunkOffset = descriptor.m_fileOffsetBytes;
+        vector<char> buffer(descriptor.m_byteSize);
+        {
+            lock_guard<mutex> lock(parent.m_fileLock);
+            if (_fseeki64(parent.m_file, chunkOffset, SEEK_SET) != 0)
+            {
+                RuntimeError("UCIDeserializer: cannot seek to offset %" PRId64 " of the input file (%ls).", chunkOffset, parent.m_filename.c_str());
+            }
+
+            freadOrDie(buffer.data(), 1, buffer.size(), parent.m_file);
+        }
+
+        vector<pair<const char*, const char*>> columns;
+        for (size_t s = 0; s < m_numberOfSequences; ++s)
+        {
+            SequenceDescriptor sequence = descriptor.GetSequence(s);
+            const char* line = buffer.data() + (sequence.m_fileOffsetBytes - chunkOffset);
+            parent.SplitColumns(line, line + sequence.m_byteSize, columns);
+            if (columns.size() < parent.m_minColumns)
+            {
+                RuntimeError("UCIDeserializer: line at offset %" PRId64 " of the input file (%ls) has %" PRIu64 " columns, expected at least %" PRIu64 ".",
+                             sequence.m_fileOffsetBytes, parent.m_filename.c_str(), columns.size(), parent.m_minColumns);
+            }
+
+            for (size_t i = 0; i < m_streams.size(); ++i)
+            {
+                const auto& range = parent.m_columns[i];
+                if (range.m_category)
+                {
+                    const auto& column = columns[range.m_start];
+                    string label(column.first, column.second);
+                    auto id = parent.m_labelToId.find(label);
+                    if (id == parent.m_labelToId.end())
+                    {
+                        RuntimeError("UCIDeserializer: label found in data not specified in label mapping file: %s", label.c_str());
+                    }
+
+                    m_classes[i][sequence.m_id] = id->second;
+                }
+                else
+                {
+                    ElemType* values = m_values[i].data() + sequence.m_id * range.m_dim;
+                    for (size_t j = 0; j < range.m_dim; ++j)
+                    {
+                        const auto& column = columns[range.m_start + j];
+                        values[j] = parent.ParseNumber(column.first, column.second);
+                    }
+                }
+            }
+        }
+    }
+
+    virtual void GetSequence(size_t sequenceId, vector<SequenceDataPtr>& result) override
+    {
+        assert(sequenceId < m_numberOfSequences);
+        result.reserve(result.size() + m_streams.size());
+        for (size_t i = 0; i < m_streams.size(); ++i)
+        {
+            SequenceDataPtr sequence;
+            if (m_streams[i]->m_storageType == StorageType::sparse_csc)
+            {
+                auto sparse = make_shared<SparseSequenceData>();
+                sparse->m_data = m_values[i].data();
+                sparse->m_indices = &m_classes[i][sequenceId];
+                sparse->m_nnzCounts.assign(1, (IndexType)1);
+                sparse->m_totalNnzCount = 1;
+                sequence = sparse;
+            }
+            else
+            {
+                auto dense = make_shared<DenseSequenceData>();
+                dense->m_data = m_values[i].data() + sequenceId * m_streams[i]->m_sampleLayout->GetNumElements();
+                sequence = dense;
+            }
+
+            sequence->m_id = sequenceId;
+            sequence->m_numberOfSamples = 1;
+            sequence->m_sampleLayout = m_streams[i]->m_sampleLayout;
+            sequence->m_chunk = shared_from_this();
+            result.push_back(sequence);
+        }
+    }
+};
+
+template <class ElemType>
+UCIDeserializer<ElemType>::UCIDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config)
+    : m_file(nullptr), m_minColumns(0)
+{
+    string customDelimiter = config(L"customDelimiter", "");
+    m_customDelimiter = customDelimiter.empty() ? char(0) : customDelimiter[0];
+    string customDecimalPoint = config(L"customDecimalPoint", "");
+    m_customDecimalPoint = customDecimalPoint.empty() ? char(0) : customDecimalPoint[0];
+    if (m_customDelimiter != 0 && m_customDelimiter == m_customDecimalPoint)
+    {
+        InvalidArgument("UCIDeserializer: 'customDelimiter' and 'customDecimalPoint' must differ.");
+    }
+
+    if (!config.ExistsCurrent(L"input"))
+    {
+        InvalidArgument("UCIDeserializer: the configuration does not contain an 'input' section.");
+    }
+
+    ElementType elementType = is_same<ElemType, double>::value ? ElementType::tdouble : ElementType::tfloat;
+    const ConfigParameters& input = config(L"input");
+    for (const pair<string, ConfigParameters>& section : input)
+    {
+        const ConfigParameters& streamConfig = section.second;
+        ColumnRange range;
+        range.m_start = streamConfig(L"start", (size_t)0);
+        range.m_category = false;
+
+        auto stream = make_shared<StreamDescription>();
+        stream->m_id = m_streams.size();
+        stream->m_name = msra::strfun::utf16(section.first);
+        stream->m_elementType = elementType;
+        stream->m_storageType = StorageType::dense;
+
+        size_t sampleDimension;
+        wstring labelType = streamConfig(L"labelType", L"");
+        if (EqualCI(labelType, L"category"))
+        {
+            ReadLabelMapping(streamConfig(L"labelMappingFile"));
+            range.m_category = true;
+            range.m_dim = 1;
+            sampleDimension = max((size_t)streamConfig(L"labelDim", (size_t)0), m_labelToId.size());
+            stream->m_storageType = StorageType::sparse_csc;
+        }
+        else if (labelType.empty() || EqualCI(labelType, L"regression"))
+        {
+            range.m_dim = streamConfig(L"dim");
+            sampleDimension = range.m_dim;
+        }
+        else
+        {
+            InvalidArgument("UCIDeserializer: unsupported labelType '%ls' of input '%s', expected 'category' or 'regression'.",
+                            labelType.c_str(), section.first.c_str());
+        }
+
+        stream->m_sampleLayout = make_shared<TensorShape>(sampleDimension);
+        m_streams.push_back(stream);
+        m_columns.push_back(range);
+        m_minColumns = max(m_minColumns, range.m_start + range.m_dim);
+    }
+
+    if (m_streams.empty())
+    {
+        InvalidArgument("UCIDeserializer: the 'input' section is empty.");
+    }
+
+    m_filename = msra::strfun::utf16(config(L"file"));
+    m_file = fopenOrDie(m_filename, L"rbS");
+
+    // Every line is a sequence, there are no sequence ids in the UCI format.
+    m_indexer = make_unique<Indexer>(m_file, m_filename, true, config(L"chunkSizeInBytes", (size_t)32 * 1024 * 1024));
+    m_indexer->SetNumberOfThreads(config(L"numIndexingThreads", (size_t)1));
+    m_indexer->SetCacheIndex(config(L"cacheIndex", false));
+    m_indexer->Build(corpus);
+
+    fprintf(stderr, "UCIDeserializer: %" PRIu64 " chunks in %ls\n", m_indexer->GetIndex().m_chunks.size(), m_filename.c_str());
+}
+
+template <class ElemType>
+UCIDeserializer<ElemType>::~UCIDeserializer()
+{
+    if (m_file)
+    {
+        fclose(m_file);
+    }
+}
+
+// The label mapping file has a class name per line, the line number is the class id.
+template <class ElemType>
+void UCIDeserializer<ElemType>::ReadLabelMapping(const wstring& path)
+{
+    if (!m_labelToId.empty())
+    {
+        InvalidArgument("UCIDeserializer: only a single input can have labelType=category.");
+    }
+
+    if (!fexists(path))
+    {
+        RuntimeError("UCIDeserializer: label mapping file %ls not found, can be created with a 'createLabelMap' command/action.", path.c_str());
+    }
+
+    vector<char> buffer;
+    auto lines = msra::files::fgetfilelines(path, buffer);
+    for (const char* line : lines)
+    {
+        string label(line);
+        size_t begin = label.find_first_not_of(" \t\r");
+        if (begin != string::npos)
+        {
+            label = label.substr(begin, label.find_last_not_of(" \t\r") + 1 - begin);
+            m_labelToId.insert(make_pair(label, (IndexType)m_labelToId.size()));
+        }
+    }
+}
+
+template <class ElemType>
+void UCIDeserializer<ElemType>::SplitColumns(const char* begin, const char* end, vector<pair<const char*, const char*>>& columns) const
+{
+    columns.clear();
+    auto isDelimiter = [this](char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || (m_customDelimiter != 0 && c == m_customDelimiter);
+    };
+
+    const char* p = begin;
+    while (p != end)
+    {
+        while (p != end && isDelimiter(*p))
+        {
+            ++p;
+        }
+
+        const char* column = p;
+        while (p != end && !isDelimiter(*p))
+        {
+            ++p;
+        }
+
+        if (column != p)
+        {
+            columns.push_back(make_pair(column, p));
+        }
+    }
+}
+
+template <class ElemType>
+ElemType UCIDeserializer<ElemType>::ParseNumber(const char* begin, const char* end) const
+{
+    char number[64];
+    size_t length = end - begin;
+    if (length >= sizeof(number))
+    {
+        RuntimeError("UCIDeserializer: invalid number '%s' in the input file (%ls).", string(begin, end).c_str(), m_filename.c_str());
+    }
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        number[i] = (m_customDecimalPoint != 0 && begin[i] == m_customDecimalPoint) ? '.' : begin[i];
+    }
+    number[length] = '\0';
+
+    char* parsedEnd;
+    double value = strtod(number, &parsedEnd);
+    if (parsedEnd != number + length)
+    {
+        RuntimeError("UCIDeserializer: invalid number '%s' in the input file (%ls).", number, m_filename.c_str());
+    }
+
+    return (ElemType)value;
+}
+
+template <class ElemType>
+ChunkDescriptions UCIDeserializer<ElemType>::GetChunkDescriptions()
+{
+    const auto& index = m_indexer->GetIndex();
+
+    ChunkDescriptions result;
+    result.reserve(index.m_chunks.size());
+    for (const auto& chunk : index.m_chunks)
+    {
+        auto cd = make_shared<ChunkDescription>();
+        cd->m_id = chunk.m_id;
+        cd->m_numberOfSamples = chunk.m_numberOfSamples;
+        cd->m_numberOfSequences = chunk.m_numberOfSequences;
+        result.push_back(cd);
+    }
+    return result;
+}
+
+template <class ElemType>
+void UCIDeserializer<ElemType>::GetSequencesForChunk(ChunkIdType chunkId, vector<SequenceDescription>& result)
+{
+    const auto& chunk = m_indexer->GetIndex().m_chunks[chunkId];
+    result.reserve(result.size() + chunk.m_numberOfSequences);
+    for (size_t i = 0; i < chunk.m_numberOfSequences; ++i)
+    {
+        result.push_back(chunk.GetSequence(i));
+    }
+}
+
+template <class ElemType>
+ChunkPtr UCIDeserializer<ElemType>::GetChunk(ChunkIdType chunkId)
+{
+    return make_shared<UCIChunk>(*this, m_indexer->GetIndex().m_chunks[chunkId]);
+}
+
+template <class ElemType>
+bool UCIDeserializer<ElemType>::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
+{
+    const auto& index = m_indexer->GetIndex();
+    auto location = index.FindSequence(key.m_sequence);
+    if (!location)
+    {
+        return false;
+    }
+
+    result = index.m_chunks[location->m_chunkId].GetSequence(location->m_indexInChunk);
+    return true;
+}
+
+template class UCIDeserializer<float>;
+template class UCIDeserializer<double>;
+
+}}}
@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include "DataDeserializerBase.h"
+#include "CorpusDescriptor.h"
+#include "Config.h"
+#include "../CNTKTextFormatReader/Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Deserializer of the UCI format read by UCIFastReader: every line is a sample, its columns are separated by whitespace
+// (or 'customDelimiter'), the features are a range of numeric columns and the label is a column of a class name
+// (mapped to a one-hot vector through 'labelMappingFile') or a range of numeric columns (labelType=regression).
+// Each line is a sequence of a single sample, keyed by its line number. The file is indexed by the line indexer of
+// CNTKTextFormatReader, in parallel with 'numIndexingThreads', and the lines are grouped into chunks of 'chunkSizeInBytes',
+// so that the data is randomized, prefetched and distributed across workers by the ReaderLib pipeline.
+// Config (the stream names are free, a stream with 'labelType' is the label stream):
+//     file = path of the UCI file
+//     customDelimiter, customDecimalPoint = as for UCIFastReader (optional)
+//     chunkSizeInBytes = 32MB, numIndexingThreads = 1, cacheIndex = false
+//     input = [
+//         features = [ start = first column ; dim = number of columns ]
+//         labels = [ start = column ; labelDim = number of classes ; labelMappingFile = class names, one per line ;
+//                    labelType = category | regression (with dim = number of columns) ]
+//     ]
+template <class ElemType>
+class UCIDeserializer : public DataDeserializerBase
+{
+public:
+    UCIDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config);
+    ~UCIDeserializer();
+
+    virtual ChunkDescriptions GetChunkDescriptions() override;
+
+    virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& result) override;
+
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    virtual bool GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result) override;
+
+private:
+    class UCIChunk;
+
+    // Columns of the line a stream is taken from.
+    struct ColumnRange
+    {
+        size_t m_start;
+        size_t m_dim;
+        bool m_category; // a single column of class names
+    };
+
+    void ReadLabelMapping(const std::wstring& path);
+
+    // Splits a line into its columns, the result points into the line.
+    void SplitColumns(const char* begin, const char* end, std::vector<std::pair<const char*, const char*>>& columns) const;
+
+    ElemType ParseNumber(const char* begin, const char* end) const;
+
+    std::wstring m_filename;
+    FILE* m_file;
+    std::unique_ptr<Indexer> m_indexer;
+
+    std::vector<ColumnRange> m_columns; // per stream
+    size_t m_minColumns;                // number of columns a line needs
+    char m_customDelimiter;
+    char m_customDecimalPoint;
+    std::map<std::string, IndexType> m_labelToId;
+
+    // Chunks may be loaded from the prefetch thread.
+    std::mutex m_fileLock;
+
+    DISABLE_COPY_AND_MOVE(UCIDeserializer);
+};
+
+}}}
@@ -0,0 +1,137 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CheckpointCompression.h -- writes and reads the matrices of a checkpoint compressed, see BlockCompression.h
+//
+// Each matrix is cut into chunks of c_checkpointChunkSize bytes, whose bytes are shuffled by their position in the
+// element and then compressed independently; a chunk that does not get smaller is stored as it is. All matrices are
+// first copied to host memory, then all chunks are compressed in parallel, and finally written in order, so that the
+// parallelism does not depend on the sizes of the matrices. Reading decompresses in parallel in the same way.
+
+#pragma once
+
+#include "Basics.h"
+#include "BlockCompression.h"
+#include "File.h"
+#include "Matrix.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+static const size_t c_checkpointChunkSize = 4 << 20; // bytes, a multiple of any element size
+
+// a chunk of a matrix in host memory, and its stored form
+struct CheckpointChunk
+{
+    char* data;
+    size_t size;
+    std::vector<char> stored; // compressed; or equal to 'size' bytes, if stored as they are
+};
+
+template <class ElemType>
+static std::vector<CheckpointChunk> GetCheckpointChunks(std::vector<std::vector<ElemType>>& values)
+{
+    std::vector<CheckpointChunk> chunks;
+    for (auto& matrixValues : values)
+    {
+        char* data = reinterpret_cast<char*>(matrixValues.data());
+        size_t size = matrixValues.size() * sizeof(ElemType);
+        for (size_t offset = 0; offset < size; offset += c_checkpointChunkSize)
+            chunks.push_back(CheckpointChunk{ data + offset, min(c_checkpointChunkSize, size - offset), {} });
+    }
+    return chunks;
+}
+
+template <class ElemType>
+void WriteCompressedMatrices(File& fstream, const std::vector<const Matrix<ElemType>*>& matrices)
+{
+    std::vector<std::vector<ElemType>> values(matrices.size());
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+        const auto& matrix = *matrices[i];
+        if (matrix.GetMatrixType() != MatrixType::DENSE)
+            LogicError("WriteCompressedMatrices: Only dense matrices can be written compressed.");
+        values[i].resize(matrix.GetNumElements());
+        if (!values[i].empty())
+            matrix.CopySection(matrix.GetNumRows(), matrix.GetNumCols(), values[i].data(), matrix.GetNumRows());
+    }
+
+    auto chunks = GetCheckpointChunks(values);
+    long numChunks = (long) chunks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (long k = 0; k < numChunks; k++)
+    {
+        auto& chunk = chunks[k];
+        std::vector<char> shuffled(chunk.size);
+        BlockCompression::ShuffleBytes(chunk.data, chunk.size / sizeof(ElemType), sizeof(ElemType), shuffled.data());
+        chunk.stored.resize(BlockCompression::CompressBound(chunk.size));
+        size_t compressedSize = BlockCompression::Compress(shuffled.data(), chunk.size, chunk.stored.data());
+        if (compressedSize < chunk.size)
+            chunk.stored.resize(compressedSize);
+        else
+            chunk.stored.assign(chunk.data, chunk.data + chunk.size);
+    }
+
+    size_t k = 0;
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCMAT");
+        fstream << sizeof(ElemType) << matrices[i]->GetNumRows() << matrices[i]->GetNumCols();
+        for (size_t offset = 0; offset < values[i].size() * sizeof(ElemType); offset += c_checkpointChunkSize, k++)
+        {
+            fstream << chunks[k].stored.size();
+            fstream.WriteBytes(chunks[k].stored.data(), chunks[k].stored.size());
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECMAT");
+    }
+}
+
+// the matrices keep their devices, and take the dimensions that were written
+template <class ElemType>
+void ReadCompressedMatrices(File& fstream, const std::vector<Matrix<ElemType>*>& matrices)
+{
+    std::vector<std::vector<ElemType>> values(matrices.size());
+    std::vector<std::pair<size_t, size_t>> dims(matrices.size());
+    std::vector<std::vector<char>> stored;
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BCMAT");
+        size_t elementSize;
+        fstream >> elementSize >> dims[i].first >> dims[i].second;
+        if (elementSize != sizeof(ElemType))
+            RuntimeError("ReadCompressedMatrices: The checkpoint was written with another element size (%d bytes).", (int) elementSize);
+        values[i].resize(dims[i].first * dims[i].second);
+        for (size_t offset = 0; offset < values[i].size() * sizeof(ElemType); offset += c_checkpointChunkSize)
+        {
+            size_t storedSize;
+            fstream >> storedSize;
+            stored.push_back(std::vector<char>(storedSize));
+            fstream.ReadBytes(stored.back().data(), storedSize);
+        }
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECMAT");
+    }
+
+    auto chunks = GetCheckpointChunks(values);
+    long numChunks = (long) chunks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (long k = 0; k < numChunks; k++)
+    {
+        auto& chunk = chunks[k];
+        const auto& data = stored[k];
+        if (data.size() == chunk.size)
+        {
+            memcpy(chunk.data, data.data(), chunk.size);
+            continue;
+        }
+        std::vector<char> shuffled(chunk.size);
+        if (BlockCompression::Decompress(data.data(), data.size(), shuffled.data(), chunk.size) != chunk.size)
+            RuntimeError("ReadCompressedMatrices: A compressed matrix is corrupt.");
+        BlockCompression::UnshuffleBytes(shuffled.data(), chunk.size / sizeof(ElemType), sizeof(ElemType), chunk.data);
+    }
+
+    for (size_t i = 0; i < matrices.size(); i++)
+        matrices[i]->SetValue(dims[i].first, dims[i].second, matrices[i]->GetDeviceId(), values[i].data());
+}
+
+}}}
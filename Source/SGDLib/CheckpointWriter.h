@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CheckpointWriter.h -- writes checkpoint files (models and checkpoint info) to their destination in the background
+//
+// A file is first written synchronously to a local staging directory, which is fast since it mostly goes to the page cache.
+// A background thread then copies it to its destination under a temp name and renames it, so that the destination file is
+// either the previous one or complete. Training continues while the copy is in flight.
+// Deletions of checkpoint files are queued behind the copies, so that they cannot be overtaken by an earlier write.
+
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CheckpointWriter
+{
+public:
+    // 'maxPendingFiles' is the number of files that may be in flight; Write() waits for a slot.
+    CheckpointWriter(const std::wstring& stagingDir, size_t maxPendingFiles)
+        : m_stagingDir(stagingDir), m_maxPendingFiles(max(maxPendingFiles, (size_t) 1)), m_numPendingFiles(0), m_numStagedFiles(0), m_isTerminating(false)
+    {
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    ~CheckpointWriter()
+    {
+        try
+        {
+            WaitAll();
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "CheckpointWriter: %s\n", e.what());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isTerminating = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+
+    // write the file 'path' through 'write', which writes a file to the path it is given, and return before it has reached 'path'
+    void Write(const std::wstring& path, const std::function<void(const std::wstring&)>& write)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_numPendingFiles < m_maxPendingFiles || m_error; });
+            RethrowError();
+        }
+
+        std::wstring stagedPath = m_stagingDir + L"/" + std::to_wstring(m_numStagedFiles++) + L"." + FileNameOf(path);
+        write(stagedPath);
+
+        Enqueue([stagedPath, path]()
+        {
+            CopyFile(stagedPath, path + L".tmp");
+            unlinkOrDie(stagedPath);
+            _wunlink(path.c_str());
+            renameOrDie(path + L".tmp", path);
+        }, /*isFile=*/true);
+    }
+
+    // delete a file after all earlier writes; a missing file is not an error
+    void Delete(const std::wstring& path)
+    {
+        Enqueue([path]() { _wunlink(path.c_str()); }, /*isFile=*/false);
+    }
+
+    // wait until all files have reached their destination, e.g. before they are read; rethrows an error of the background thread
+    void WaitAll()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_tasks.empty() && m_numPendingFiles == 0; });
+        RethrowError();
+    }
+
+private:
+    struct Task
+    {
+        std::function<void()> run;
+        bool isFile;
+    };
+
+    void Enqueue(const std::function<void()>& run, bool isFile)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            RethrowError();
+            m_tasks.push_back(Task{ run, isFile });
+            if (isFile)
+                m_numPendingFiles++;
+        }
+        m_condition.notify_all();
+    }
+
+    void Run()
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_tasks.empty() || m_isTerminating; });
+                if (m_tasks.empty())
+                    return;
+                task = m_tasks.front();
+            }
+
+            std::exception_ptr error;
+            try
+            {
+                task.run();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.pop_front();
+                if (task.isFile)
+                    m_numPendingFiles--;
+                if (error && !m_error)
+                    m_error = error;
+            }
+            m_condition.notify_all();
+        }
+    }
+
+    // (caller must hold m_mutex)
+    void RethrowError()
+    {
+        if (m_error)
+        {
+            auto error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    static std::wstring FileNameOf(const std::wstring& path)
+    {
+        auto pos = path.find_last_of(L"/\\");
+        return pos == std::wstring::npos ? path : path.substr(pos + 1);
+    }
+
+    static void CopyFile(const std::wstring& from, const std::wstring& to)
+    {
+        FILE* in = fopenOrDie(from, L"rb");
+        FILE* out = fopenOrDie(to, L"wb");
+        std::vector<char> buffer(64 * 1024 * 1024);
+        for (;;)
+        {
+            size_t n = fread(buffer.data(), 1, buffer.size(), in);
+            if (n == 0)
+                break;
+            fwriteOrDie(buffer.data(), 1, n, out);
+        }
+        if (ferror(in))
+            RuntimeError("CheckpointWriter: Error reading staged file '%ls'.", from.c_str());
+        fcloseOrDie(in);
+        fflushOrDie(out);
+        fcloseOrDie(out);
+    }
+
+    std::wstring m_stagingDir;
+    size_t m_maxPendingFiles;
+    size_t m_numPendingFiles; // files written to the staging directory but not yet at their destination
+    size_t m_numStagedFiles;  // for unique staged file names
+    std::deque<Task> m_tasks; // the front one is running
+    std::exception_ptr m_error;
+    bool m_isTerminating;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_thread;
+};
+
+}}}
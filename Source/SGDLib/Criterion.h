@@ -83,6 +83,8 @@ struct CriterionAccumulator
     {
         m_aggregateCriterionValues->SetValue(0);
         m_aggregateSampleCounts.assign(numCriteria, 0);
+        m_hostCriterionValues.assign(numCriteria, 0);
+        m_hostCriterionValuesValid = true;
     }
     // 'i' is the index of the element we add into (multiple eval criteria share the same matrix object)
     // Use 'reset=true' to not accumulate but overwrite.
@@ -102,10 +104,23 @@ struct CriterionAccumulator
         if (m_aggregateSampleCounts[i] == 0)
             return EpochCriterion(0, 0); // avoid unnecessary GPU access
         else
-            return EpochCriterion(m_aggregateCriterionValues->GetValue(0, i), m_aggregateSampleCounts[i]);
+            return EpochCriterion(GetHostCriterionValues()[i], m_aggregateSampleCounts[i]);
     }
 
 private:
+    // The accumulators stay on the device while minibatches are added; reading one synchronizes with the device.
+    // We read all of them in one transfer, and only once after they have changed, so that reading out a criterion
+    // and all eval errors at a logging point costs a single synchronization.
+    const std::vector<ElemType>& GetHostCriterionValues() const
+    {
+        if (!m_hostCriterionValuesValid)
+        {
+            m_aggregateCriterionValues->CopySection(1, m_hostCriterionValues.size(), m_hostCriterionValues.data(), 1);
+            m_hostCriterionValuesValid = true;
+        }
+        return m_hostCriterionValues;
+    }
+
     // shared part of Add() and Assign()
     // This code assumes that if number of samples is 0, the criterion value is also 0 and does not need to be fetched from the GPU.
     template<bool reset>
@@ -134,6 +149,7 @@ private:
             // Note: If criterion is > [1 x 1] then inverse broadcasting will kick in and aggregate.
             // If count is zero, we lazily consider the numerator as zero as well.
             criterionAccumulator.DoCopyOf(m_aggregateSampleCounts[i] ? (float)beta : 0, criterionValue, 1);
+            m_hostCriterionValuesValid = false;
         }
         m_aggregateSampleCounts[i] = m_aggregateSampleCounts[i] * beta + numSamples;
         return *this;
@@ -152,6 +168,8 @@ public:
 private:
     shared_ptr<Matrix<ElemType>> m_aggregateCriterionValues; // [1 x N]
     vector<size_t> m_aggregateSampleCounts;                  // [N]
+    mutable vector<ElemType> m_hostCriterionValues;          // [N] copy of m_aggregateCriterionValues
+    mutable bool m_hostCriterionValuesValid;                 // false after the device values changed
 };
 
 }}}
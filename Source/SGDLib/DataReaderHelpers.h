@@ -93,6 +93,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             DecimateMinibatchInPlace<ElemType>(inputMatrices, mpi->NumNodesInUse(), mpi->CurrentNodeRank(), pMBLayout);
         }
 
+        // create the validity masks of the input layouts now, while the input data is uploaded, rather than when the first node needs one
+        for (const auto& input : inputMatrices)
+        {
+            const auto& pMBLayout = input.second.pMBLayout;
+            if (pMBLayout && pMBLayout->HasGaps())
+                pMBLayout->GetColumnsValidityMask(input.second.matrix->GetDeviceId());
+        }
+
         NotifyChangedNodes<ElemType>(net, inputMatrices);
 
         // get MB size and tell Network to update its nodes' buffers based on what's in the input matrices
@@ -0,0 +1,182 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Float16GradientExchange.h -- sums gradient buffers across nodes as fp16 or bf16 values, with dynamic loss scaling
+//
+// Each host buffer is converted to 16 bits and summed by MPI with a user-defined reduction, which halves the
+// communication volume; the sum is converted back into the buffer. With fp16, the gradients are multiplied by a loss
+// scale before the conversion, so that small gradients do not flush to zero, and divided by it afterwards. If a sum
+// overflows, all nodes learn so through a one-element all-reduce, halve the scale, and repeat the exchange from their
+// unchanged buffers, so no minibatch is lost; after s_lossScaleGrowthInterval exchanges without an overflow the scale
+// is doubled again. bf16 has the range of float and is not scaled.
+
+#pragma once
+
+#include "Basics.h"
+#include "MPIWrapper.h"
+#include "Float16.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class Float16GradientExchange
+{
+    struct Entry
+    {
+        ElemType* data; // in host memory; receives the sum
+        size_t numElements;
+        int root;       // the node that receives the sum, or -1 if all do
+        float lossScale; // that 'values' are encoded with
+        std::vector<uint16_t> values;
+        MPI_Request request;
+        bool isActive;
+    };
+
+public:
+    Float16GradientExchange(const MPIWrapperPtr& mpi, Float16Format format, float initialLossScale)
+        : m_mpi(mpi), m_format(format), m_lossScale((format == Float16Format::float16) ? initialLossScale : 1.0f), m_numSinceOverflow(0)
+    {
+        if (format == Float16Format::none)
+            LogicError("Float16GradientExchange: No 16-bit format given.");
+        if (!(initialLossScale > 0))
+            InvalidArgument("Float16GradientExchange: The loss scale must be positive.");
+        MPI_Op_create(format == Float16Format::bfloat16 ? &SumBFloat16 : &SumFloat16, 1 /*commute*/, &m_sumOp) || MpiFail("Float16GradientExchange: MPI_Op_create");
+    }
+
+    ~Float16GradientExchange()
+    {
+        for (auto& entry : m_entries)
+        {
+            if (entry.isActive)
+                MPI_Wait(&entry.request, MPI_STATUS_IGNORE);
+        }
+        MPI_Op_free(&m_sumOp);
+    }
+
+    // Starts summing 'data' into node 'root', or into all nodes if root < 0. 'index' is a slot per buffer, whose
+    // conversion buffer is kept across minibatches; all nodes must start the same slots in the same order.
+    void Start(size_t index, ElemType* data, size_t numElements, int root = -1)
+    {
+        if (m_entries.size() <= index)
+            m_entries.resize(index + 1);
+        auto& entry = m_entries[index];
+        if (entry.isActive)
+            LogicError("Float16GradientExchange: Slot %d is started twice.", (int) index);
+        entry.data = data;
+        entry.numElements = numElements;
+        entry.root = root;
+        entry.values.resize(numElements);
+        entry.isActive = true;
+        StartReduction(entry);
+    }
+
+    // gives MPI a chance to make progress on the reductions in flight
+    void Test()
+    {
+        for (auto& entry : m_entries)
+        {
+            int flag;
+            if (entry.isActive)
+                MPI_Test(&entry.request, &flag, MPI_STATUS_IGNORE) || MpiFail("Float16GradientExchange: MPI_Test");
+        }
+    }
+
+    // Waits for the reductions started since the last call, repeats them with a lower loss scale as long as a sum
+    // overflows, and writes the sums into the buffers of the nodes that receive them. Must be called on all nodes.
+    void Finish()
+    {
+        for (;;)
+        {
+            int isOverflow = 0;
+            for (auto& entry : m_entries)
+            {
+                if (!entry.isActive)
+                    continue;
+                MPI_Wait(&entry.request, MPI_STATUS_IGNORE) || MpiFail("Float16GradientExchange: MPI_Wait");
+                if (ReceivesSum(entry) && !isOverflow)
+                    isOverflow = !AllFloat16Finite(m_format, entry.values.data(), entry.numElements);
+            }
+            if (m_format == Float16Format::bfloat16) // overflows only where float would
+                break;
+
+            MPI_Allreduce(MPI_IN_PLACE, &isOverflow, 1, MPI_INT, MPI_MAX, m_mpi->Communicator()) || MpiFail("Float16GradientExchange: MPI_Allreduce");
+            if (!isOverflow)
+            {
+                if ((++m_numSinceOverflow >= s_lossScaleGrowthInterval) && (m_lossScale < s_maxLossScale))
+                {
+                    m_lossScale *= 2;
+                    m_numSinceOverflow = 0;
+                }
+                break;
+            }
+
+            m_numSinceOverflow = 0;
+            if (m_lossScale <= s_minLossScale) // the gradients themselves are not finite
+            {
+                fprintf(stderr, "WARNING: Float16GradientExchange: The summed gradients are not finite at the minimum loss scale %g.\n", m_lossScale);
+                break;
+            }
+            m_lossScale /= 2;
+            for (auto& entry : m_entries)
+            {
+                if (entry.isActive)
+                    StartReduction(entry);
+            }
+        }
+
+        for (auto& entry : m_entries)
+        {
+            if (entry.isActive && ReceivesSum(entry))
+                DecodeFloat16(m_format, entry.values.data(), entry.numElements, entry.lossScale, entry.data);
+            entry.isActive = false;
+        }
+    }
+
+    float LossScale() const
+    {
+        return m_lossScale;
+    }
+
+private:
+    void StartReduction(Entry& entry)
+    {
+        entry.lossScale = m_lossScale;
+        EncodeFloat16(m_format, entry.data, entry.numElements, entry.lossScale, entry.values.data());
+        if (entry.root < 0)
+            MPI_Iallreduce(MPI_IN_PLACE, entry.values.data(), (int) entry.numElements, MPI_UNSIGNED_SHORT, m_sumOp, m_mpi->Communicator(), &entry.request) || MpiFail("Float16GradientExchange: MPI_Iallreduce");
+        else if (ReceivesSum(entry))
+            MPI_Ireduce(MPI_IN_PLACE, entry.values.data(), (int) entry.numElements, MPI_UNSIGNED_SHORT, m_sumOp, entry.root, m_mpi->Communicator(), &entry.request) || MpiFail("Float16GradientExchange: MPI_Ireduce");
+        else
+            MPI_Ireduce(entry.values.data(), nullptr, (int) entry.numElements, MPI_UNSIGNED_SHORT, m_sumOp, entry.root, m_mpi->Communicator(), &entry.request) || MpiFail("Float16GradientExchange: MPI_Ireduce");
+    }
+
+    bool ReceivesSum(const Entry& entry) const
+    {
+        return (entry.root < 0) || (entry.root == (int) m_mpi->CurrentNodeRank());
+    }
+
+    static void SumFloat16(void* in, void* inout, int* len, MPI_Datatype*)
+    {
+        AddFloat16(Float16Format::float16, (const uint16_t*) in, (uint16_t*) inout, (size_t) *len);
+    }
+
+    static void SumBFloat16(void* in, void* inout, int* len, MPI_Datatype*)
+    {
+        AddFloat16(Float16Format::bfloat16, (const uint16_t*) in, (uint16_t*) inout, (size_t) *len);
+    }
+
+    static constexpr float s_minLossScale = 1.0f / (1 << 24);
+    static constexpr float s_maxLossScale = (float) (1 << 24);
+    static const size_t s_lossScaleGrowthInterval = 2000;
+
+    MPIWrapperPtr m_mpi;
+    Float16Format m_format;
+    MPI_Op m_sumOp;
+    std::vector<Entry> m_entries;
+    float m_lossScale;
+    size_t m_numSinceOverflow; // exchanges since the last overflow
+};
+
+}}}
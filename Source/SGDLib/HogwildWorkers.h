@@ -0,0 +1,258 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// HogwildWorkers.h -- lock-free multi-threaded training on the CPU ("Hogwild!", Niu et al. 2011)
+//
+// Each worker is a copy of the network with its own activations and gradients, whose learnable parameters are views of
+// the values of the network's. The minibatch that was read into the network is split by parallel sequences, as for
+// LocalReplicas: the network keeps the first part, and each worker computes the gradients of another part on its own
+// thread and immediately applies them to the shared values, with its own smoothed gradients and no locks. The sparse
+// gradients of sparse inputs thus update only the rows or columns they touch, and few updates collide. The network's
+// part is updated by SGD as usual. The OpenMP loops of the workers run single-threaded.
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "ComputationNode.h"
+#include "Criterion.h"
+#include "DataReaderHelpers.h"
+#include "Matrix.h"
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class HogwildWorkers
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    // update of a parameter node with its gradient, for the given number of samples
+    typedef std::function<void(const ComputationNodeBasePtr& node, Matrix<ElemType>& smoothedGradient, size_t numSamples)> UpdateFunction;
+
+private:
+    struct Worker
+    {
+        ComputationNetworkPtr net;
+        std::vector<ComputationNodeBasePtr> criterionNodes;
+        std::vector<ComputationNodeBasePtr> evaluationNodes;
+        std::vector<ComputationNodePtr> learnableNodes; // parallel to HogwildWorkers::m_learnableNodes
+        std::vector<shared_ptr<Matrix<ElemType>>> smoothedGradients;
+        StreamMinibatchInputs inputMatrices;
+        size_t actualMBSize;
+        std::exception_ptr error;
+    };
+
+public:
+    // Must be called before the matrices of 'net' are allocated, so that the workers do not copy its activations.
+    HogwildWorkers(const ComputationNetworkPtr& net, size_t numThreads,
+                   const std::vector<ComputationNodeBasePtr>& criterionNodes, const std::vector<ComputationNodeBasePtr>& evaluationNodes)
+        : m_net(net), m_fullLayout(make_shared<MBLayout>()), m_numActiveWorkers(0), m_numSamplesOfNetwork(0)
+    {
+        if (net->AreMatricesAllocated())
+            LogicError("HogwildWorkers: Must be created before the matrices of the network are allocated.");
+        if (net->GetDeviceId() != CPUDEVICE)
+            InvalidArgument("HogwildWorkers: hogwildThreads requires training on the CPU (deviceId=-1).");
+
+        // the criteria of the parts are added up, which requires them to be reduced to a scalar
+        m_criterionNode = dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0]);
+        for (const auto& node : evaluationNodes)
+            m_evaluationNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node));
+        for (const auto& node : m_evaluationNodes)
+            if (node->HasMBLayout())
+                InvalidArgument("HogwildWorkers: The evaluation node %ls must be reduced to a scalar.", node->NodeName().c_str());
+        if (m_criterionNode->HasMBLayout())
+            InvalidArgument("HogwildWorkers: The criterion node %ls must be reduced to a scalar.", m_criterionNode->NodeName().c_str());
+
+        for (const auto& node : net->LearnableParameterNodes(criterionNodes[0]))
+            m_learnableNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node));
+
+        for (size_t i = 1; i < numThreads; i++)
+        {
+            Worker worker;
+            worker.net = net->CloneOnDevice(CPUDEVICE);
+            for (const auto& node : criterionNodes)
+                worker.criterionNodes.push_back(worker.net->GetNodeFromName(node->NodeName()));
+            for (const auto& node : evaluationNodes)
+                worker.evaluationNodes.push_back(worker.net->GetNodeFromName(node->NodeName()));
+            for (const auto& node : m_learnableNodes)
+                worker.learnableNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(worker.net->GetNodeFromName(node->NodeName())));
+            worker.smoothedGradients.resize(m_learnableNodes.size());
+            worker.net->AllocateAllMatrices(worker.evaluationNodes, {}, worker.criterionNodes[0]);
+            for (const auto& nodes : { worker.net->FeatureNodes(), worker.net->LabelNodes() })
+                for (const auto& node : nodes)
+                    worker.inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+            worker.actualMBSize = 0;
+            m_workers.push_back(std::move(worker));
+        }
+        fprintf(stderr, "HogwildWorkers: Training on %d threads.\n", (int) m_workers.size() + 1);
+    }
+
+    ~HogwildWorkers()
+    {
+        for (auto& thread : m_threads)
+            if (thread.joinable())
+                thread.join();
+    }
+
+    void StartEpoch()
+    {
+        for (auto& worker : m_workers)
+            worker.net->StartEvaluateMinibatchLoop(worker.evaluationNodes, worker.criterionNodes);
+    }
+
+    // Splits the minibatch in the network's input matrices among the network and the workers.
+    // There are fewer parts than threads if the minibatch has fewer parallel sequences.
+    void SplitMinibatch(StreamMinibatchInputs& inputMatrices)
+    {
+        auto& layout = m_net->GetMBLayoutPtrOfNetwork();
+        m_fullLayout->CopyFrom(layout);
+        size_t numParts = max((size_t) 1, min(m_workers.size() + 1, layout->GetNumParallelSequences()));
+        m_numActiveWorkers = numParts - 1;
+
+        for (size_t i = 0; i < m_numActiveWorkers; i++)
+        {
+            auto& worker = m_workers[i];
+            StreamMinibatchInputs part;
+            MBLayoutPtr partLayout;
+            DataReaderHelpers::DecimateMinibatch<ElemType>(inputMatrices, part, layout, partLayout, numParts, i + 1);
+            for (const auto& input : part)
+                worker.inputMatrices.template GetInputMatrix<ElemType>(input.first).AssignValuesOf(part.GetInputMatrix<ElemType>(input.first));
+            worker.net->GetMBLayoutPtrOfNetwork()->CopyFrom(partLayout);
+            DataReaderHelpers::NotifyChangedNodes<ElemType>(worker.net, worker.inputMatrices);
+            worker.actualMBSize = worker.net->DetermineActualMBSizeFromFeatures();
+        }
+
+        DataReaderHelpers::DecimateMinibatchInPlace<ElemType>(inputMatrices, numParts, 0, layout);
+        DataReaderHelpers::NotifyChangedNodes<ElemType>(m_net, inputMatrices);
+        size_t actualMBSize = m_net->DetermineActualMBSizeFromFeatures();
+        m_numSamplesOfNetwork = CriterionAccumulator<ElemType>::GetNumSamples(m_criterionNode, m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize));
+    }
+
+    // Starts ForwardProp(), Backprop() and the update of the workers on their parts, each on its own thread.
+    // Meanwhile the caller computes the network's part.
+    void StartComputation(bool computeGradients, const UpdateFunction& update)
+    {
+        BindValues();
+        for (size_t i = 0; i < m_numActiveWorkers; i++)
+        {
+            auto& worker = m_workers[i];
+            worker.net->Environment() = m_net->Environment(); // e.g. training vs. inferring
+            worker.error = nullptr;
+
+            m_threads.push_back(std::thread([this, &worker, computeGradients, update]()
+            {
+                try
+                {
+#ifdef _OPENMP
+                    omp_set_num_threads(1); // (of this thread only)
+#endif
+                    ComputationNetwork::BumpEvalTimeStamp(worker.net->FeatureNodes());
+                    ComputationNetwork::BumpEvalTimeStamp(worker.net->LabelNodes());
+                    worker.net->ForwardProp(worker.evaluationNodes);
+                    worker.net->ForwardProp(worker.criterionNodes[0]);
+                    if (computeGradients)
+                    {
+                        worker.net->Backprop(worker.criterionNodes[0]);
+                        Update(worker, update);
+                    }
+                }
+                catch (...)
+                {
+                    worker.error = std::current_exception();
+                }
+            }));
+        }
+    }
+
+    // Waits for the workers and adds their criterion and evaluation values to those of the network.
+    // The network's MBLayout is reverted to that of the whole minibatch, so that all samples are counted.
+    void FinishComputation()
+    {
+        for (auto& thread : m_threads)
+            thread.join();
+        m_threads.clear();
+        for (size_t i = 0; i < m_numActiveWorkers; i++)
+            if (m_workers[i].error)
+                std::rethrow_exception(m_workers[i].error);
+
+        for (size_t i = 0; i < m_numActiveWorkers; i++)
+        {
+            const auto& worker = m_workers[i];
+            AddScalar(worker.criterionNodes[0], m_criterionNode);
+            for (size_t k = 0; k < m_evaluationNodes.size(); k++)
+                AddScalar(worker.evaluationNodes[k], m_evaluationNodes[k]);
+        }
+
+        m_net->GetMBLayoutPtrOfNetwork()->CopyFrom(m_fullLayout);
+    }
+
+    // the samples of the network's own part of the last minibatch, by which SGD updates the parameters with its gradients
+    size_t GetNumSamplesOfNetwork() const { return m_numSamplesOfNetwork; }
+
+private:
+    // Makes the values of the workers' parameters views of those of the network, again if the network's were
+    // reallocated (e.g. by reloading a model, or by the ParameterArena).
+    void BindValues()
+    {
+        for (size_t k = 0; k < m_learnableNodes.size(); k++)
+        {
+            auto& value = m_learnableNodes[k]->Value();
+            if (value.GetMatrixType() != MatrixType::DENSE)
+                RuntimeError("HogwildWorkers: The parameter %ls is sparse, which is not supported.", m_learnableNodes[k]->NodeName().c_str());
+            for (auto& worker : m_workers)
+            {
+                auto& workerValue = worker.learnableNodes[k]->ValuePtrRef();
+                if (workerValue->Data() != value.Data() || workerValue->GetNumRows() != value.GetNumRows() || workerValue->GetNumCols() != value.GetNumCols())
+                    workerValue = make_shared<Matrix<ElemType>>(value.ColumnSlice(0, value.GetNumCols()));
+            }
+        }
+    }
+
+    // applies the gradients of a worker to the shared values, without synchronization
+    void Update(Worker& worker, const UpdateFunction& update)
+    {
+        size_t numSamples = CriterionAccumulator<ElemType>::GetNumSamples(worker.criterionNodes[0], worker.net->GetNumSamplesWithLabelOfNetwork(worker.actualMBSize));
+        if (numSamples == 0)
+            return;
+        for (size_t k = 0; k < m_learnableNodes.size(); k++)
+        {
+            const auto& node = worker.learnableNodes[k];
+            if (!node->IsParameterUpdateRequired())
+                continue;
+            auto& smoothedGradient = worker.smoothedGradients[k];
+            if (!smoothedGradient)
+            {
+                smoothedGradient = make_shared<Matrix<ElemType>>(node->Value().GetNumRows(), node->Value().GetNumCols(), CPUDEVICE);
+                smoothedGradient->SetValue(0);
+            }
+            update(node, *smoothedGradient, numSamples);
+        }
+    }
+
+    void AddScalar(const ComputationNodeBasePtr& workerNode, const ComputationNodePtr& node)
+    {
+        Matrix<ElemType>::AddElementToElement(dynamic_pointer_cast<ComputationNode<ElemType>>(workerNode)->Value(), 0, 0, node->Value(), 0, 0);
+    }
+
+    ComputationNetworkPtr m_net;
+    ComputationNodePtr m_criterionNode;
+    std::vector<ComputationNodePtr> m_evaluationNodes;
+    std::vector<ComputationNodePtr> m_learnableNodes;
+    std::vector<Worker> m_workers;
+    std::vector<std::thread> m_threads;
+    MBLayoutPtr m_fullLayout;     // layout of the whole minibatch, restored by FinishComputation()
+    size_t m_numActiveWorkers;    // workers that got a part of the current minibatch
+    size_t m_numSamplesOfNetwork; // see GetNumSamplesOfNetwork()
+};
+
+}}}
@@ -21,6 +21,33 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) = 0;
 
+    // Optional overlapping of the aggregation with backprop. If supported, BeginOverlappedAggregation() is called for every
+    // minibatch before backprop, with the gradients in the order in which backprop completes them, then OnGradientCompleted()
+    // as each of them is complete, and then AggregateGradients() finishes the aggregation.
+    virtual bool SupportsOverlappedAggregation() const
+    {
+        return false;
+    }
+    virtual void BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& /*gradientsInCompletionOrder*/)
+    {
+        NOT_IMPLEMENTED;
+    }
+    virtual void OnGradientCompleted(Matrix<ElemType>* /*gradient*/)
+    {
+        NOT_IMPLEMENTED;
+    }
+
+    // Optional sharding of the update: gradient i is then only needed on rank owners[i] (or on all ranks if owners[i] is
+    // negative), so it can be reduced to that rank instead of being all-reduced. Set before the first AggregateGradients().
+    virtual bool SupportsGradientOwners() const
+    {
+        return false;
+    }
+    virtual void SetGradientOwners(const std::vector<int>& /*owners*/)
+    {
+        NOT_IMPLEMENTED;
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
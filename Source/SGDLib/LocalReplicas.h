@@ -0,0 +1,219 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// LocalReplicas.h -- data-parallel training on several GPUs of a single process, without MPI
+//
+// Each replica is a copy of the network on another GPU. The minibatch that was read into the network is split by
+// parallel sequences, as DecimateMinibatch() does for MPI workers: the network keeps the first part, and each replica
+// computes the gradients of another part on its own thread. The replica gradients are then added to those of the
+// network through peer-to-peer copies, and only the network is updated. One reader feeds all GPUs.
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "ComputationNode.h"
+#include "DataReaderHelpers.h"
+#include "Matrix.h"
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class LocalReplicas
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    struct Replica
+    {
+        ComputationNetworkPtr net;
+        std::vector<ComputationNodeBasePtr> criterionNodes;
+        std::vector<ComputationNodeBasePtr> evaluationNodes;
+        std::vector<ComputationNodePtr> learnableNodes; // parallel to LocalReplicas::m_learnableNodes
+        StreamMinibatchInputs inputMatrices;
+        std::exception_ptr error;
+    };
+
+public:
+    // Must be called before the matrices of 'net' are allocated, so that the replicas do not copy its activations.
+    LocalReplicas(const ComputationNetworkPtr& net, const std::vector<DEVICEID_TYPE>& devices,
+                  const std::vector<ComputationNodeBasePtr>& criterionNodes, const std::vector<ComputationNodeBasePtr>& evaluationNodes)
+        : m_net(net), m_fullLayout(make_shared<MBLayout>()), m_numActiveReplicas(0)
+    {
+        if (net->AreMatricesAllocated())
+            LogicError("LocalReplicas: Must be created before the matrices of the network are allocated.");
+
+        // the criteria of the parts are added up, which requires them to be reduced to a scalar
+        m_criterionNode = dynamic_pointer_cast<ComputationNode<ElemType>>(criterionNodes[0]);
+        for (const auto& node : evaluationNodes)
+            m_evaluationNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node));
+        for (const auto& node : m_evaluationNodes)
+            if (node->HasMBLayout())
+                InvalidArgument("LocalReplicas: The evaluation node %ls must be reduced to a scalar.", node->NodeName().c_str());
+        if (m_criterionNode->HasMBLayout())
+            InvalidArgument("LocalReplicas: The criterion node %ls must be reduced to a scalar.", m_criterionNode->NodeName().c_str());
+
+        for (const auto& node : net->LearnableParameterNodes(criterionNodes[0]))
+            m_learnableNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node));
+
+        for (const auto deviceId : devices)
+        {
+            if (deviceId < 0 || deviceId == net->GetDeviceId())
+                InvalidArgument("LocalReplicas: The replicas must be placed on GPUs other than that of the network (device %d given).", (int) deviceId);
+
+            Replica replica;
+            replica.net = net->CloneOnDevice(deviceId);
+            for (const auto& node : criterionNodes)
+                replica.criterionNodes.push_back(replica.net->GetNodeFromName(node->NodeName()));
+            for (const auto& node : evaluationNodes)
+                replica.evaluationNodes.push_back(replica.net->GetNodeFromName(node->NodeName()));
+            for (const auto& node : m_learnableNodes)
+                replica.learnableNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(replica.net->GetNodeFromName(node->NodeName())));
+            replica.net->AllocateAllMatrices(replica.evaluationNodes, {}, replica.criterionNodes[0]);
+            for (const auto& nodes : { replica.net->FeatureNodes(), replica.net->LabelNodes() })
+                for (const auto& node : nodes)
+                    replica.inputMatrices.AddInput(node->NodeName(), node->ValuePtr(), node->GetMBLayout(), node->GetSampleLayout());
+            m_replicas.push_back(std::move(replica));
+        }
+        fprintf(stderr, "LocalReplicas: Training on %d GPUs.\n", (int) m_replicas.size() + 1);
+    }
+
+    ~LocalReplicas()
+    {
+        for (auto& thread : m_threads)
+            if (thread.joinable())
+                thread.join();
+    }
+
+    void StartEpoch()
+    {
+        for (auto& replica : m_replicas)
+            replica.net->StartEvaluateMinibatchLoop(replica.evaluationNodes, replica.criterionNodes);
+    }
+
+    // Splits the minibatch in the network's input matrices among the network and the replicas.
+    // There are fewer parts than devices if the minibatch has fewer parallel sequences.
+    void SplitMinibatch(StreamMinibatchInputs& inputMatrices)
+    {
+        auto& layout = m_net->GetMBLayoutPtrOfNetwork();
+        m_fullLayout->CopyFrom(layout);
+        size_t numParts = max((size_t) 1, min(m_replicas.size() + 1, layout->GetNumParallelSequences()));
+        m_numActiveReplicas = numParts - 1;
+
+        for (size_t i = 0; i < m_numActiveReplicas; i++)
+        {
+            auto& replica = m_replicas[i];
+            StreamMinibatchInputs part;
+            MBLayoutPtr partLayout;
+            DataReaderHelpers::DecimateMinibatch<ElemType>(inputMatrices, part, layout, partLayout, numParts, i + 1);
+            for (const auto& input : part)
+                replica.inputMatrices.template GetInputMatrix<ElemType>(input.first).AssignValuesOf(part.GetInputMatrix<ElemType>(input.first));
+            replica.net->GetMBLayoutPtrOfNetwork()->CopyFrom(partLayout);
+            DataReaderHelpers::NotifyChangedNodes<ElemType>(replica.net, replica.inputMatrices);
+            replica.net->DetermineActualMBSizeFromFeatures();
+        }
+
+        DataReaderHelpers::DecimateMinibatchInPlace<ElemType>(inputMatrices, numParts, 0, layout);
+        DataReaderHelpers::NotifyChangedNodes<ElemType>(m_net, inputMatrices);
+        m_net->DetermineActualMBSizeFromFeatures();
+    }
+
+    // Starts ForwardProp() and Backprop() of the replicas on their parts, each on its own thread, with the current
+    // parameters of the network. Meanwhile the caller computes the network's part.
+    void StartComputation(bool computeGradients)
+    {
+        for (size_t i = 0; i < m_numActiveReplicas; i++)
+        {
+            auto& replica = m_replicas[i];
+            for (size_t k = 0; k < m_learnableNodes.size(); k++)
+                replica.learnableNodes[k]->Value().AssignValuesOf(m_learnableNodes[k]->Value());
+            replica.net->Environment() = m_net->Environment(); // e.g. training vs. inferring
+            replica.error = nullptr;
+
+            m_threads.push_back(std::thread([&replica, computeGradients]()
+            {
+                try
+                {
+                    ComputationNetwork::BumpEvalTimeStamp(replica.net->FeatureNodes());
+                    ComputationNetwork::BumpEvalTimeStamp(replica.net->LabelNodes());
+                    replica.net->ForwardProp(replica.evaluationNodes);
+                    replica.net->ForwardProp(replica.criterionNodes[0]);
+                    if (computeGradients)
+                        replica.net->Backprop(replica.criterionNodes[0]);
+                }
+                catch (...)
+                {
+                    replica.error = std::current_exception();
+                }
+            }));
+        }
+    }
+
+    // Waits for the replicas and adds their gradients, criterion and evaluation values to those of the network.
+    // The network's MBLayout is reverted to that of the whole minibatch, so that all samples are counted.
+    void FinishComputation(bool computeGradients)
+    {
+        for (auto& thread : m_threads)
+            thread.join();
+        m_threads.clear();
+        for (size_t i = 0; i < m_numActiveReplicas; i++)
+            if (m_replicas[i].error)
+                std::rethrow_exception(m_replicas[i].error);
+
+        if (!m_scalar)
+            m_scalar = make_shared<Matrix<ElemType>>(1, 1, m_net->GetDeviceId());
+        if (m_gradients.empty())
+            m_gradients.resize(m_learnableNodes.size());
+
+        for (size_t i = 0; i < m_numActiveReplicas; i++)
+        {
+            const auto& replica = m_replicas[i];
+            AddScalar(replica.criterionNodes[0], m_criterionNode);
+            for (size_t k = 0; k < m_evaluationNodes.size(); k++)
+                AddScalar(replica.evaluationNodes[k], m_evaluationNodes[k]);
+
+            if (!computeGradients)
+                continue;
+            for (size_t k = 0; k < m_learnableNodes.size(); k++)
+            {
+                if (!m_learnableNodes[k]->IsParameterUpdateRequired())
+                    continue;
+                const auto& gradient = replica.learnableNodes[k]->Gradient();
+                if (gradient.GetMatrixType() != MatrixType::DENSE)
+                    RuntimeError("LocalReplicas: The gradient of %ls is sparse, which is not supported.", m_learnableNodes[k]->NodeName().c_str());
+                if (!m_gradients[k])
+                    m_gradients[k] = make_shared<Matrix<ElemType>>(m_net->GetDeviceId());
+                m_gradients[k]->AssignValuesOf(gradient); // peer-to-peer copy to the network's device
+                m_learnableNodes[k]->Gradient() += *m_gradients[k];
+            }
+        }
+
+        m_net->GetMBLayoutPtrOfNetwork()->CopyFrom(m_fullLayout);
+    }
+
+private:
+    void AddScalar(const ComputationNodeBasePtr& replicaNode, const ComputationNodePtr& node)
+    {
+        m_scalar->AssignValuesOf(dynamic_pointer_cast<ComputationNode<ElemType>>(replicaNode)->Value());
+        Matrix<ElemType>::AddElementToElement(*m_scalar, 0, 0, node->Value(), 0, 0);
+    }
+
+    ComputationNetworkPtr m_net;
+    ComputationNodePtr m_criterionNode;
+    std::vector<ComputationNodePtr> m_evaluationNodes;
+    std::vector<ComputationNodePtr> m_learnableNodes;
+    std::vector<Replica> m_replicas;
+    std::vector<std::thread> m_threads;
+    MBLayoutPtr m_fullLayout;  // layout of the whole minibatch, restored by FinishComputation()
+    size_t m_numActiveReplicas; // replicas that got a part of the current minibatch
+
+    // on the network's device: copies of the replicas' gradients and criteria
+    std::vector<shared_ptr<Matrix<ElemType>>> m_gradients;
+    shared_ptr<Matrix<ElemType>> m_scalar;
+};
+
+}}}
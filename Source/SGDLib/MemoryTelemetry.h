@@ -0,0 +1,210 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// MemoryTelemetry.h -- device memory in use by training, by category, for sizing jobs and diagnosing out-of-memory failures
+//
+// A census walks the matrices that training holds on the device and attributes each once, in this order, to
+//  - parameters:      the values of the learnable parameters
+//  - gradients:       their gradients
+//  - optimizer state: the smoothed gradients (momentum etc.) kept by SGD
+//  - reader buffers:  the input matrices the reader fills
+//  - activations:     all other matrices of the network nodes, mostly from the MatrixPool
+// The matrices are counted at their current size. Whatever else the allocator has handed out, such as convolution
+// workspaces, temporaries and capacity beyond the current size, is reported as 'workspaces and other'.
+// Peaks are the largest values seen by the censuses of an epoch, except that of the total, which is the allocator's
+// own high-water mark and thus also covers the transient use between censuses.
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "DataReader.h"
+#include "GPUWatcher.h"
+#include "Matrix.h"
+#include "ProgressTracing.h"
+#include <algorithm>
+#include <list>
+#include <set>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class MemoryCategory
+{
+    Parameters,
+    Gradients,
+    OptimizerState,
+    ReaderBuffers,
+    Activations,
+    Workspaces,
+    NumCategories
+};
+
+static inline const char* MemoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Parameters:     return "parameters";
+    case MemoryCategory::Gradients:      return "gradients";
+    case MemoryCategory::OptimizerState: return "optimizer state";
+    case MemoryCategory::ReaderBuffers:  return "reader buffers";
+    case MemoryCategory::Activations:    return "activations";
+    case MemoryCategory::Workspaces:     return "workspaces and other";
+    default:                             LogicError("MemoryCategoryName: Invalid category.");
+    }
+}
+
+struct MemoryCensus
+{
+    static const size_t numCategories = (size_t) MemoryCategory::NumCategories;
+
+    size_t bytes[numCategories];
+    size_t bytesInUse;    // by the allocator; if it is not the caching one, the device memory used by this process and others
+    size_t bytesReserved; // by the caching allocator, including its cached free buffers
+    size_t deviceBytesFree;
+    size_t deviceBytesTotal;
+
+    MemoryCensus()
+        : bytesInUse(0), bytesReserved(0), deviceBytesFree(0), deviceBytesTotal(0)
+    {
+        std::fill(bytes, bytes + numCategories, (size_t) 0);
+    }
+
+    size_t& operator[](MemoryCategory category) { return bytes[(size_t) category]; }
+    size_t operator[](MemoryCategory category) const { return bytes[(size_t) category]; }
+
+    // elementwise maximum
+    void Accumulate(const MemoryCensus& other)
+    {
+        for (size_t i = 0; i < numCategories; i++)
+            bytes[i] = std::max(bytes[i], other.bytes[i]);
+        bytesInUse = std::max(bytesInUse, other.bytesInUse);
+        bytesReserved = std::max(bytesReserved, other.bytesReserved);
+        deviceBytesFree = other.deviceBytesFree; // (the latest)
+        deviceBytesTotal = other.deviceBytesTotal;
+    }
+};
+
+class MemoryTelemetry
+{
+public:
+    // one per epoch; the allocator's high-water marks restart here (and are left alone at the end, for the MemoryProbe)
+    MemoryTelemetry(int deviceId)
+        : m_deviceId(deviceId), m_numCensuses(0)
+    {
+        if (TracingGPUMemoryAllocator::IsCachingEnabled())
+            TracingGPUMemoryAllocator::ResetPeakStatistics(m_deviceId);
+    }
+
+    // take a census and fold it into the peaks of the epoch
+    template <class ElemType>
+    MemoryCensus Sample(const ComputationNetworkPtr& net, const std::list<ComputationNodeBasePtr>& learnableNodes,
+                        const std::list<Matrix<ElemType>>& smoothedGradients, const StreamMinibatchInputs& inputMatrices)
+    {
+        MemoryCensus census;
+        std::set<const MatrixBase*> counted;
+        auto count = [&](const MatrixBase* matrix, MemoryCategory category)
+        {
+            if (matrix && matrix->GetDeviceId() == m_deviceId && counted.insert(matrix).second)
+                census[category] += NumBytesOf(matrix);
+        };
+
+        for (const auto& node : learnableNodes)
+        {
+            auto typedNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+            count(typedNode->ValuePtr().get(), MemoryCategory::Parameters);
+            count(typedNode->GradientPtr().get(), MemoryCategory::Gradients);
+        }
+        for (const auto& smoothedGradient : smoothedGradients)
+            count(&smoothedGradient, MemoryCategory::OptimizerState);
+        for (const auto& input : inputMatrices)
+            count(input.second.matrix.get(), MemoryCategory::ReaderBuffers);
+        for (const auto& node : net->GetAllNodes())
+        {
+            for (const auto& matrixInfo : node->GetMatrixInfo())
+                count(matrixInfo.first, MemoryCategory::Activations);
+        }
+
+        size_t bytesCounted = 0;
+        for (size_t i = 0; i < MemoryCensus::numCategories; i++)
+            bytesCounted += census.bytes[i];
+        census.deviceBytesFree = GPUWatcher::GetFreeMemoryOnCUDADevice(m_deviceId);
+        census.deviceBytesTotal = GPUWatcher::GetTotalMemoryOnCUDADevice(m_deviceId);
+        if (TracingGPUMemoryAllocator::IsCachingEnabled())
+        {
+            auto stats = TracingGPUMemoryAllocator::GetStatistics(m_deviceId);
+            census.bytesInUse = stats.bytesInUse;
+            census.bytesReserved = stats.bytesReserved;
+        }
+        else
+            census.bytesInUse = census.bytesReserved = census.deviceBytesTotal - census.deviceBytesFree;
+        census[MemoryCategory::Workspaces] = census.bytesInUse > bytesCounted ? census.bytesInUse - bytesCounted : 0;
+
+        m_peaks.Accumulate(census);
+        m_last = census;
+        m_numCensuses++;
+        return census;
+    }
+
+    // one line per census on stderr
+    void Log(const MemoryCensus& census) const
+    {
+        LOGPRINTF(stderr, "Device memory (MB):");
+        for (size_t i = 0; i < MemoryCensus::numCategories; i++)
+            fprintf(stderr, " %s = %.1f;", MemoryCategoryName((MemoryCategory) i), ToMB(census.bytes[i]));
+        fprintf(stderr, " in use = %.1f, reserved = %.1f, free on device = %.1f of %.1f\n",
+                ToMB(census.bytesInUse), ToMB(census.bytesReserved), ToMB(census.deviceBytesFree), ToMB(census.deviceBytesTotal));
+    }
+
+    // the peaks of the epoch, on stderr and as MEMORY: lines for the cluster tools
+    void LogEpochPeaks(int epochNumber)
+    {
+        if (m_numCensuses == 0)
+            return;
+        size_t peakBytesInUse = m_peaks.bytesInUse;
+        size_t peakBytesReserved = m_peaks.bytesReserved;
+        if (TracingGPUMemoryAllocator::IsCachingEnabled())
+        {
+            auto stats = TracingGPUMemoryAllocator::GetStatistics(m_deviceId);
+            peakBytesInUse = std::max(peakBytesInUse, stats.peakBytesInUse);
+            peakBytesReserved = std::max(peakBytesReserved, stats.peakBytesReserved);
+        }
+
+        LOGPRINTF(stderr, "Epoch[%2d]: Peak device memory (MB):", epochNumber + 1);
+        for (size_t i = 0; i < MemoryCensus::numCategories; i++)
+        {
+            fprintf(stderr, " %s = %.1f;", MemoryCategoryName((MemoryCategory) i), ToMB(m_peaks.bytes[i]));
+            ProgressTracing::TraceMemoryUsage(MemoryCategoryName((MemoryCategory) i), ToMB(m_last.bytes[i]), ToMB(m_peaks.bytes[i]));
+        }
+        fprintf(stderr, " in use = %.1f, reserved = %.1f, device total = %.1f\n",
+                ToMB(peakBytesInUse), ToMB(peakBytesReserved), ToMB(m_peaks.deviceBytesTotal));
+        ProgressTracing::TraceMemoryUsage("in use", ToMB(m_last.bytesInUse), ToMB(peakBytesInUse));
+        ProgressTracing::TraceMemoryUsage("reserved", ToMB(m_last.bytesReserved), ToMB(peakBytesReserved));
+    }
+
+private:
+    static double ToMB(size_t bytes) { return bytes / (double) (1 << 20); }
+
+    // the current size; views, e.g. into the parameter arena, thus count for their part only
+    template <class ElemType>
+    static size_t NumBytesOf(const Matrix<ElemType>& matrix)
+    {
+        return matrix.GetMatrixType() == MatrixType::SPARSE ? matrix.BufferSize() : matrix.GetNumElements() * sizeof(ElemType);
+    }
+    static size_t NumBytesOf(const MatrixBase* matrix)
+    {
+        if (auto floatMatrix = dynamic_cast<const Matrix<float>*>(matrix))
+            return NumBytesOf(*floatMatrix);
+        else if (auto doubleMatrix = dynamic_cast<const Matrix<double>*>(matrix))
+            return NumBytesOf(*doubleMatrix);
+        else
+            return 0;
+    }
+
+    int m_deviceId;
+    MemoryCensus m_peaks;
+    MemoryCensus m_last;
+    size_t m_numCensuses;
+};
+
+}}}
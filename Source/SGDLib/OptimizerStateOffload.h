@@ -0,0 +1,244 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// OptimizerStateOffload.h -- keeps the optimizer state of parameters on a GPU in host memory, and updates them there
+//
+// The smoothed gradients (up to three times the size of the parameter, e.g. with Adam or FSAdaGrad) stay in host memory.
+// For each update, the gradients and values of all dense parameters are copied into pinned host buffers on the fetch
+// stream of GPUDataTransferer, each parameter is updated on the CPU as soon as its copy has arrived, and its value is
+// copied back while the next one is updated. For a gradient in sparse block-column format, e.g. of an embedding with
+// sparse input, only the columns that have a gradient are transferred and updated, so that the update is lazy: the
+// optimizer state of the other columns is not decayed.
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "Matrix.h"
+#include "GPUDataTransferer.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "MatrixQuantizerImpl.h"
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class OptimizerStateOffload
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    struct Entry
+    {
+        ComputationNodePtr node;
+        Matrix<ElemType>* smoothedGradient; // in host memory
+        std::unique_ptr<GPUDataTransferer<ElemType>> gpuDataTransferer;
+        std::shared_ptr<ElemType> buffer;   // pinned: the gradient, followed by the value
+        size_t bufferSize;                  // in elements
+        bool isUploading;
+        // sparse gradients: the indices of the columns with a gradient, and the values of these columns, on the device
+        std::shared_ptr<Matrix<ElemType>> columnMap;
+        std::shared_ptr<Matrix<ElemType>> columns;
+        std::shared_ptr<Matrix<ElemType>> updatedColumns;
+    };
+
+public:
+    // called with the node, and its value, gradient and smoothed gradient in host memory
+    typedef std::function<void(const ComputationNodeBasePtr&, Matrix<ElemType>&, Matrix<ElemType>&, Matrix<ElemType>&)> UpdateFunction;
+
+    // Takes the parameters that are updated, have a dense value on a GPU, and a smoothed gradient in host memory.
+    // (With a sharded optimizer state, the smoothed gradient is empty if another worker updates the parameter.)
+    OptimizerStateOffload(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradients)
+    {
+        auto smoothedGradientIter = smoothedGradients.begin();
+        for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+        {
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+            if (!node || !node->IsParameterUpdateRequired() || (node->GetDeviceId() == CPUDEVICE) || (node->Value().GetMatrixType() != DENSE) ||
+                (smoothedGradientIter->GetDeviceId() != CPUDEVICE) || smoothedGradientIter->IsEmpty())
+                continue;
+
+            Entry entry;
+            entry.node = node;
+            entry.smoothedGradient = &*smoothedGradientIter;
+            entry.bufferSize = 0;
+            entry.isUploading = false;
+            m_entries.push_back(std::move(entry));
+            m_nodes.insert(node);
+        }
+        fprintf(stderr, "OptimizerStateOffload: Updating %d parameter tensors in host memory.\n", (int) m_entries.size());
+    }
+
+    bool Contains(const ComputationNodeBasePtr& node) const
+    {
+        return m_nodes.find(node) != m_nodes.end();
+    }
+
+    void Update(const UpdateFunction& update)
+    {
+        // the copies must not start before backprop has computed the gradients on the compute stream
+        std::set<int> syncedDevices;
+        for (auto& entry : m_entries)
+        {
+            if (entry.node->Gradient().GetMatrixType() != DENSE)
+                continue;
+            int deviceId = entry.node->GetDeviceId();
+            if (syncedDevices.insert(deviceId).second)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+                mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            }
+            StartDownload(entry);
+        }
+
+        for (auto& entry : m_entries)
+        {
+            if (entry.node->Gradient().GetMatrixType() == DENSE)
+                UpdateDense(entry, update);
+            else
+                UpdateColumns(entry, update);
+            entry.node->BumpEvalTimeStamp();
+        }
+
+        // the next minibatch must see the new values
+        for (auto& entry : m_entries)
+        {
+            if (entry.isUploading)
+                entry.gpuDataTransferer->WaitForCopyCPUToGPUAsync();
+            entry.isUploading = false;
+        }
+    }
+
+private:
+    void StartDownload(Entry& entry)
+    {
+        auto& value = entry.node->Value();
+        auto& gradient = entry.node->Gradient();
+        size_t n = value.GetNumElements();
+        if (gradient.GetNumElements() != n)
+            LogicError("OptimizerStateOffload: The gradient of %ls does not have the size of its value.", entry.node->NodeName().c_str());
+
+        int deviceId = value.GetDeviceId();
+        if (entry.bufferSize < 2 * n)
+        {
+            auto& allocator = m_allocators[deviceId];
+            if (!allocator)
+                allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
+            CUDAPageLockedMemAllocator* pAllocator = allocator.get();
+            entry.buffer = std::shared_ptr<ElemType>((ElemType*) pAllocator->Malloc(2 * n * sizeof(ElemType)), [pAllocator](ElemType* p) { pAllocator->Free(p); });
+            entry.bufferSize = 2 * n;
+        }
+        if (!entry.gpuDataTransferer)
+            entry.gpuDataTransferer.reset(new GPUDataTransferer<ElemType>(deviceId, true /*useConcurrentStreams*/));
+
+        // both on the fetch stream, so waiting for the second copy waits for both
+        entry.gpuDataTransferer->CopyGPUToCPUAsync(gradient.Data(), n, entry.buffer.get());
+        entry.gpuDataTransferer->CopyGPUToCPUAsync(value.Data(), n, entry.buffer.get() + n);
+    }
+
+    void UpdateDense(Entry& entry, const UpdateFunction& update)
+    {
+        auto& deviceValue = entry.node->Value();
+        size_t numRows = deviceValue.GetNumRows();
+        size_t numCols = deviceValue.GetNumCols();
+        size_t n = numRows * numCols;
+
+        entry.gpuDataTransferer->WaitForCopyGPUToCPUAsync();
+        Matrix<ElemType> gradient(numRows, numCols, entry.buffer.get(), CPUDEVICE, matrixFlagDontOwnBuffer);
+        Matrix<ElemType> value(numRows, numCols, entry.buffer.get() + n, CPUDEVICE, matrixFlagDontOwnBuffer);
+        update(entry.node, value, gradient, *entry.smoothedGradient);
+
+        entry.gpuDataTransferer->CopyCPUToGPUAsync(entry.buffer.get() + n, n, deviceValue.Data());
+        entry.isUploading = true;
+    }
+
+    // updates the columns that have a gradient, as a dense [numRows x k] update on the host
+    void UpdateColumns(Entry& entry, const UpdateFunction& update)
+    {
+        auto& gradient = entry.node->Gradient();
+        if (gradient.GetFormat() != matrixFormatSparseBlockCol)
+            RuntimeError("OptimizerStateOffload: The gradient of %ls is sparse, but not in block-column format.", entry.node->NodeName().c_str());
+        gradient.GetMatrixFromSBCFormat(m_columnIds, m_gradientValues);
+        size_t k = m_columnIds.size();
+        if (k == 0)
+            return;
+
+        auto& deviceValue = entry.node->Value();
+        size_t numRows = deviceValue.GetNumRows();
+        size_t numCols = deviceValue.GetNumCols();
+        DEVICEID_TYPE deviceId = deviceValue.GetDeviceId();
+        if (!entry.columnMap)
+        {
+            entry.columnMap = make_shared<Matrix<ElemType>>(deviceId);
+            entry.columns = make_shared<Matrix<ElemType>>(deviceId);
+            entry.updatedColumns = make_shared<Matrix<ElemType>>(deviceId);
+        }
+
+        // gather the columns of the value on the device, and copy them to the host
+        m_columnMap.assign(m_columnIds.begin(), m_columnIds.end());
+        entry.columnMap->SetValue(1, k, deviceId, m_columnMap.data());
+        entry.columns->DoGatherColumnsOf(0, *entry.columnMap, deviceValue, 1);
+        Matrix<ElemType> value(numRows, k, CPUDEVICE);
+        entry.columns->CopySection(numRows, k, value.Data(), numRows);
+
+        // the smoothed gradient consists of one or more slots of numCols columns each, e.g. the first and second moments of Adam
+        Matrix<ElemType>& smoothedGradient = *entry.smoothedGradient;
+        size_t numSlots = smoothedGradient.GetNumCols() / numCols;
+        Matrix<ElemType> smoothedColumns(numRows, numSlots * k, CPUDEVICE);
+        CopySlotColumns(smoothedGradient, numCols, smoothedColumns, /*toColumns=*/true);
+
+        Matrix<ElemType> gradientColumns(numRows, k, m_gradientValues.data(), CPUDEVICE, matrixFlagDontOwnBuffer);
+        update(entry.node, value, gradientColumns, smoothedColumns);
+
+        // the optimizer allocates its slots in the first update, initialized to zero
+        size_t newNumSlots = smoothedColumns.GetNumCols() / k;
+        if (newNumSlots != numSlots)
+        {
+            smoothedGradient.Resize(numRows, newNumSlots * numCols);
+            smoothedGradient.SetValue(0);
+        }
+        CopySlotColumns(smoothedGradient, numCols, smoothedColumns, /*toColumns=*/false);
+
+        // add the change of the columns to the value on the device; scattering adds, it cannot overwrite
+        entry.updatedColumns->SetValue(numRows, k, deviceId, value.Data());
+        *entry.updatedColumns -= *entry.columns;
+        deviceValue.DoScatterColumnsOf(1, *entry.columnMap, *entry.updatedColumns, 1);
+    }
+
+    // copies the columns m_columnIds of each slot of 'slots' (numCols columns per slot) to or from 'columns' (k columns per slot)
+    void CopySlotColumns(Matrix<ElemType>& slots, size_t numCols, Matrix<ElemType>& columns, bool toColumns) const
+    {
+        size_t numRows = slots.GetNumRows();
+        size_t k = m_columnIds.size();
+        ElemType* slotData = slots.Data();
+        ElemType* columnData = columns.Data();
+        long numColumns = (long) columns.GetNumCols();
+#pragma omp parallel for
+        for (long j = 0; j < numColumns; j++)
+        {
+            ElemType* slotColumn = slotData + ((j / k) * numCols + m_columnIds[j % k]) * numRows;
+            ElemType* column = columnData + j * numRows;
+            if (toColumns)
+                memcpy(column, slotColumn, numRows * sizeof(ElemType));
+            else
+                memcpy(slotColumn, column, numRows * sizeof(ElemType));
+        }
+    }
+
+    std::map<int, std::unique_ptr<CUDAPageLockedMemAllocator>> m_allocators; // per device; outlives the buffers of m_entries
+    std::vector<Entry> m_entries;
+    std::set<ComputationNodeBasePtr> m_nodes;
+
+    // buffers of UpdateColumns(), kept across calls
+    std::vector<size_t> m_columnIds;
+    std::vector<ElemType> m_columnMap; // m_columnIds as ElemType, for DoGatherColumnsOf()
+    std::vector<ElemType> m_gradientValues;
+};
+
+}}}
@@ -0,0 +1,143 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// OverlappedModelAveragingSGD.h -- model averaging with the communication overlapped with training (delayed averaging)
+//
+// At a sync point, BasicModelAveragingSGD stops training until the models of all workers are averaged. Here a worker
+// instead takes a snapshot of its model, starts a non-blocking all-reduce of it, and continues training. At the next
+// sync point, the all-reduce has had a whole sync period to complete, and the worker adds the difference between the
+// average and its snapshot to its model: the local progress since the snapshot is kept, and the part of the model
+// that the snapshot covered is replaced by the average. At the end of an epoch the models are averaged synchronously,
+// so that all workers continue with the same model. Whether the all-reduce progresses while no MPI calls are made
+// depends on the asynchronous progress of the MPI library.
+
+#pragma once
+
+#include "MASGD.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <typename ElemType>
+class OverlappedModelAveragingSGD : public IMASGD<ElemType>
+{
+    typedef IMASGD<ElemType> Base;
+    using Base::m_pMPI;
+    using Base::m_numWorkers;
+    using Base::DownCast;
+
+public:
+    OverlappedModelAveragingSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID)
+        : Base(pMPI, reportFreq, devID), m_numElements(0), m_request(MPI_REQUEST_NULL), m_isPending(false), m_isEpochEnd(false)
+    {
+        fprintf(stderr, "Parallel training (%d workers) using ModelAveraging with overlapped communication\n", (int) m_numWorkers);
+    }
+
+    ~OverlappedModelAveragingSGD()
+    {
+        // the buffer must outlive the all-reduce, e.g. if training was aborted by an exception
+        if (m_isPending)
+            MPI_Wait(&m_request, MPI_STATUS_IGNORE);
+    }
+
+    void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradient, size_t samplesSinceLastSync) override
+    {
+        m_isEpochEnd = true;
+        Base::OnEpochEnd(learnableNodes, smoothedGradient, samplesSinceLastSync);
+        m_isEpochEnd = false;
+    }
+
+    void ModelAggregationProcessing(
+        size_t samplesSinceLastSync,                            /* in */
+        const std::list<ComputationNodeBasePtr>& learnableNodes, /* in/out */
+        std::list<Matrix<ElemType>>& /*smoothedGradient*/,       /* in/out: kept local, as in model averaging */
+        size_t& totalSamplesProcessed,                          /* out */
+        float& secondsOnCommunication                           /* out */) override
+    {
+        Timer commTimer;
+        commTimer.Start();
+        totalSamplesProcessed = 0;
+        if (m_isPending)
+            totalSamplesProcessed += FinishAveraging(learnableNodes);
+
+        StartAveraging(learnableNodes, samplesSinceLastSync);
+        if (m_isEpochEnd) // the workers leave the epoch with the same model
+            totalSamplesProcessed += FinishAveraging(learnableNodes);
+        commTimer.Stop();
+
+        // nothing was averaged at the first sync point of an epoch; estimate as BasicModelAveragingSGD does
+        if (totalSamplesProcessed == 0)
+            totalSamplesProcessed = samplesSinceLastSync * m_numWorkers;
+        secondsOnCommunication = (float) commTimer.ElapsedSeconds();
+    }
+
+private:
+    // takes the snapshot, and starts the all-reduce of the models weighted by the number of samples, followed by the weight
+    // and the number of samples
+    void StartAveraging(const std::list<ComputationNodeBasePtr>& learnableNodes, size_t samplesSinceLastSync)
+    {
+        if (m_numElements == 0)
+        {
+            for (auto& pBaseNode : learnableNodes)
+            {
+                if (pBaseNode->IsParameterUpdateRequired())
+                    m_numElements += DownCast(pBaseNode)->Value().GetNumElements();
+            }
+            m_snapshot.resize(m_numElements);
+            m_buffer.resize(m_numElements + 2);
+        }
+
+        size_t offset = 0;
+        for (auto& pBaseNode : learnableNodes)
+        {
+            if (!pBaseNode->IsParameterUpdateRequired())
+                continue;
+            auto& value = DownCast(pBaseNode)->Value();
+            value.CopySection(value.GetNumRows(), value.GetNumCols(), m_snapshot.data() + offset, value.GetNumRows());
+            offset += value.GetNumElements();
+        }
+
+        // a worker without samples since the last sync point still counts a little, so that the average is always defined
+        ElemType weight = (ElemType) max(samplesSinceLastSync, (size_t) 1);
+        for (size_t j = 0; j < m_numElements; j++)
+            m_buffer[j] = weight * m_snapshot[j];
+        m_buffer[m_numElements] = weight;
+        m_buffer[m_numElements + 1] = (ElemType) samplesSinceLastSync;
+
+        m_pMPI->AllReduceAsync(m_buffer.data(), m_buffer.size(), &m_request);
+        m_isPending = true;
+    }
+
+    // waits for the all-reduce and adds (average - snapshot) to the models; returns the number of samples averaged
+    size_t FinishAveraging(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        MPI_Wait(&m_request, MPI_STATUS_IGNORE) || MpiFail("OverlappedModelAveragingSGD: MPI_Wait");
+        m_isPending = false;
+
+        ElemType totalWeight = m_buffer[m_numElements];
+        for (size_t j = 0; j < m_numElements; j++)
+            m_buffer[j] = m_buffer[j] / totalWeight - m_snapshot[j];
+
+        size_t offset = 0;
+        for (auto& pBaseNode : learnableNodes)
+        {
+            if (!pBaseNode->IsParameterUpdateRequired())
+                continue;
+            auto& value = DownCast(pBaseNode)->Value();
+            Matrix<ElemType> correction(value.GetNumRows(), value.GetNumCols(), m_buffer.data() + offset, value.GetDeviceId());
+            value += correction;
+            offset += value.GetNumElements();
+        }
+        return (size_t) m_buffer[m_numElements + 1];
+    }
+
+    size_t m_numElements;              // of all parameters that are updated
+    std::vector<ElemType> m_snapshot;  // the local model when the pending all-reduce was started
+    std::vector<ElemType> m_buffer;    // the weighted model, the weight, and the number of samples, all-reduced in place
+    MPI_Request m_request;
+    bool m_isPending;
+    bool m_isEpochEnd;
+};
+
+}}}
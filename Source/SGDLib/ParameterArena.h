@@ -0,0 +1,176 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ParameterArena.h -- contiguous storage for the values, gradients and smoothed gradients of many learnable parameters
+//
+// Each parameter's matrices are rebound to views into three flat 1 x N arena matrices, so that gradient aggregation
+// can all-reduce the whole gradient arena at once, and an elementwise update can run once over the whole arena
+// instead of launching several small kernels per parameter.
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "Matrix.h"
+#include <functional>
+#include <list>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class ParameterArena
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+    struct Entry
+    {
+        ComputationNodePtr node;
+        Matrix<ElemType>* smoothedGradient;
+        size_t offset; // in elements
+        size_t numRows;
+        size_t numCols;
+    };
+
+public:
+    ParameterArena()
+        : m_numElements(0)
+    {
+    }
+
+    // bind the parameters for which canFuse() returns true
+    // 'nodes' and 'smoothedGradients' are parallel lists, as used by SGD.
+    void Bind(const std::list<ComputationNodeBasePtr>& nodes, std::list<Matrix<ElemType>>& smoothedGradients,
+              const std::function<bool(const ComputationNodeBasePtr&)>& canFuse)
+    {
+        if (!m_entries.empty())
+            LogicError("ParameterArena: Bind() can only be called once.");
+
+        auto smoothedGradientIter = smoothedGradients.begin();
+        for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++, smoothedGradientIter++)
+        {
+            if (!canFuse(*nodeIter))
+                continue;
+            auto node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+            Entry entry = { node, &*smoothedGradientIter, m_numElements, node->Value().GetNumRows(), node->Value().GetNumCols() };
+            m_entries.push_back(entry);
+            m_nodes.insert(node);
+            m_numElements += entry.numRows * entry.numCols;
+        }
+        if (m_entries.empty())
+            return;
+
+        DEVICEID_TYPE deviceId = m_entries.front().node->Value().GetDeviceId();
+        m_values            = make_shared<Matrix<ElemType>>(1, m_numElements, deviceId);
+        m_gradients         = make_shared<Matrix<ElemType>>(1, m_numElements, deviceId);
+        m_smoothedGradients = make_shared<Matrix<ElemType>>(1, m_numElements, deviceId);
+        m_gradients->SetValue(0);
+        for (auto& entry : m_entries)
+            BindEntry(entry);
+
+        fprintf(stderr, "ParameterArena: %d parameters with %d elements share one contiguous buffer.\n", (int) m_entries.size(), (int) m_numElements);
+    }
+
+    // re-establish the views of parameters whose matrices were replaced in the meantime (e.g. by reloading a model or checkpoint),
+    // and release parameters whose gradient has become sparse. Returns true if the set of fused parameters changed.
+    bool EnsureBound()
+    {
+        size_t numEntries = m_entries.size();
+        for (size_t i = 0; i < m_entries.size();)
+        {
+            auto& entry = m_entries[i];
+            if (entry.node->Gradient().GetMatrixType() != DENSE)
+            {
+                Release(entry);
+                m_entries.erase(m_entries.begin() + i);
+                continue;
+            }
+            BindEntry(entry);
+            i++;
+        }
+        return m_entries.size() != numEntries;
+    }
+
+    bool IsEmpty() const { return m_entries.empty(); }
+    bool Contains(const ComputationNodeBasePtr& node) const { return m_nodes.find(node) != m_nodes.end(); }
+
+    Matrix<ElemType>& Values() { return *m_values; }
+    Matrix<ElemType>& Gradients() { return *m_gradients; }
+    Matrix<ElemType>& SmoothedGradients() { return *m_smoothedGradients; }
+
+    void BumpEvalTimeStamps()
+    {
+        for (auto& entry : m_entries)
+            entry.node->BumpEvalTimeStamp();
+    }
+
+private:
+    Matrix<ElemType> ViewOf(Matrix<ElemType>& arena, const Entry& entry) const
+    {
+        return arena.ColumnSlice(entry.offset, entry.numRows * entry.numCols).Reshaped(entry.numRows, entry.numCols);
+    }
+
+    static bool IsBoundTo(Matrix<ElemType>& matrix, Matrix<ElemType>& arena, const Entry& entry)
+    {
+        return (matrix.GetMatrixType() == DENSE) && (matrix.GetNumElements() == entry.numRows * entry.numCols) && (matrix.Data() == arena.Data() + entry.offset);
+    }
+
+    // rebind the node's matrices to views into the arena, keeping their content
+    void BindEntry(Entry& entry)
+    {
+        auto& value = entry.node->ValuePtrRef();
+        if (!IsBoundTo(*value, *m_values, entry))
+        {
+            auto view = make_shared<Matrix<ElemType>>(ViewOf(*m_values, entry));
+            view->SetValue(*value);
+            value = view;
+        }
+
+        auto& gradient = entry.node->GradientPtrRef();
+        if (!gradient || !IsBoundTo(*gradient, *m_gradients, entry))
+        {
+            auto view = make_shared<Matrix<ElemType>>(ViewOf(*m_gradients, entry));
+            if (gradient && (gradient->GetNumElements() == view->GetNumElements()))
+                view->SetValue(*gradient);
+            gradient = view;
+        }
+
+        if (!IsBoundTo(*entry.smoothedGradient, *m_smoothedGradients, entry))
+        {
+            Matrix<ElemType> view = ViewOf(*m_smoothedGradients, entry);
+            view.SetValue(*entry.smoothedGradient);
+            *entry.smoothedGradient = std::move(view);
+        }
+    }
+
+    // give the node its own value and smoothed gradient again; the arena region goes unused
+    void Release(Entry& entry)
+    {
+        DEVICEID_TYPE deviceId = m_values->GetDeviceId();
+
+        auto& value = entry.node->ValuePtrRef();
+        auto ownValue = make_shared<Matrix<ElemType>>(entry.numRows, entry.numCols, deviceId);
+        ownValue->SetValue(*value);
+        value = ownValue;
+
+        Matrix<ElemType> ownSmoothedGradient(entry.numRows, entry.numCols, deviceId);
+        ownSmoothedGradient.SetValue(*entry.smoothedGradient);
+        *entry.smoothedGradient = std::move(ownSmoothedGradient);
+
+        ViewOf(*m_gradients, entry).SetValue(0);
+        m_nodes.erase(entry.node);
+        fprintf(stderr, "ParameterArena: %ls %ls operation has a sparse gradient and is updated separately.\n", entry.node->NodeName().c_str(), entry.node->OperationName().c_str());
+    }
+
+    std::vector<Entry> m_entries;
+    std::set<ComputationNodeBasePtr> m_nodes;
+    size_t m_numElements;
+    shared_ptr<Matrix<ElemType>> m_values;
+    shared_ptr<Matrix<ElemType>> m_gradients;
+    shared_ptr<Matrix<ElemType>> m_smoothedGradients;
+};
+
+}}}
@@ -0,0 +1,262 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ParameterServerSGD.h -- asynchronous training against a sharded parameter server, with bounded staleness
+//
+// The global model is split into one shard per rank, exposed as MPI-3 RMA windows, so every rank is both a worker
+// and the server for its shard, without a server thread. At each sync point a worker pushes the change of its local
+// model since its last pull into all shards and pulls the current global model back in the same atomic operation
+// (MPI_Get_accumulate). There is no global barrier within an epoch; a worker only waits when it is more than
+// 'maxStaleness' sync points ahead of the slowest worker that is still processing data.
+
+#pragma once
+
+#include "MASGD.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <thread>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <typename ElemType>
+class AsyncParameterServerSGD : public IMASGD<ElemType>
+{
+    typedef IMASGD<ElemType> Base;
+    using Base::m_pMPI;
+    using Base::m_numWorkers;
+    using Base::m_myRank;
+    using Base::m_numSyncPerformed;
+    using Base::m_perfReporter;
+    using Base::DownCast;
+
+    // layout of the clock window on the main node: one sync-point counter per worker, then the global sample counter
+    typedef long long Counter;
+
+public:
+    AsyncParameterServerSGD(const MPIWrapperPtr& pMPI, size_t reportFreq, DEVICEID_TYPE devID, size_t maxStaleness)
+        : Base(pMPI, reportFreq, devID), m_maxStaleness(maxStaleness), m_numElements(0), m_shard(nullptr), m_shardWindow(MPI_WIN_NULL),
+          m_clocks(nullptr), m_clockWindow(MPI_WIN_NULL), m_myClock(0), m_globalSamplesAtLastSync(0)
+    {
+        fprintf(stderr, "Parallel training (%d workers) using asynchronous ParameterServerSGD with maxStaleness = %d\n", (int) m_numWorkers, (int) m_maxStaleness);
+    }
+
+    ~AsyncParameterServerSGD()
+    {
+        // collective, like the creation; all ranks destroy their SGD object at the end of training
+        if (m_shardWindow != MPI_WIN_NULL)
+            MPI_Win_free(&m_shardWindow);
+        if (m_clockWindow != MPI_WIN_NULL)
+            MPI_Win_free(&m_clockWindow);
+    }
+
+    // all workers start an epoch with the same model, which becomes the content of the shards
+    void OnEpochStart(const std::list<ComputationNodeBasePtr>& learnableNodes) override
+    {
+        Base::OnEpochStart(learnableNodes);
+        if (m_shardWindow == MPI_WIN_NULL)
+            CreateWindows(learnableNodes);
+
+        CopyModelToHost(learnableNodes, m_lastPulled);
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, (int) m_myRank, 0, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock");
+        std::copy(m_lastPulled.begin() + m_shardBegin[m_myRank], m_lastPulled.begin() + m_shardBegin[m_myRank + 1], m_shard);
+        MPI_Win_unlock((int) m_myRank, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_unlock");
+
+        if (m_pMPI->IsMainNode())
+        {
+            MPI_Win_lock(MPI_LOCK_EXCLUSIVE, (int) m_myRank, 0, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock");
+            std::fill(m_clocks, m_clocks + m_numWorkers + 1, (Counter) 0);
+            MPI_Win_unlock((int) m_myRank, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_unlock");
+        }
+        m_myClock = 0;
+        m_globalSamplesAtLastSync = 0;
+
+        // no pushes before all shards and clocks are initialized
+        m_pMPI->WaitAll();
+    }
+
+    // push and pull without waiting for the other workers, except to enforce the staleness bound
+    bool OnArrivingAtSyncPoint(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradient, size_t samplesSinceLastSync) override
+    {
+        size_t totalSamplesProcessed = 0;
+        float secondsOnCommunication = 0.0f;
+        m_numSyncPerformed++;
+        ModelAggregationProcessing(samplesSinceLastSync, learnableNodes, smoothedGradient, totalSamplesProcessed, secondsOnCommunication);
+        m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+
+        Timer syncPointTimer;
+        syncPointTimer.Start();
+        bool waited = WaitForStalenessBound();
+        syncPointTimer.Stop();
+        m_perfReporter.OnArriveAtSyncPoint(syncPointTimer.ElapsedSeconds(), waited);
+        return true;
+    }
+
+    // push the remaining change, then let all workers continue with the final global model
+    void OnEpochEnd(const std::list<ComputationNodeBasePtr>& learnableNodes, std::list<Matrix<ElemType>>& smoothedGradient, size_t samplesSinceLastSync) override
+    {
+        size_t totalSamplesProcessed = 0;
+        float secondsOnCommunication = 0.0f;
+        m_numSyncPerformed++;
+        ModelAggregationProcessing(samplesSinceLastSync, learnableNodes, smoothedGradient, totalSamplesProcessed, secondsOnCommunication);
+        m_perfReporter.OnMAPerformed(samplesSinceLastSync, totalSamplesProcessed, secondsOnCommunication);
+
+        // nobody may wait for us any longer
+        Counter done = std::numeric_limits<Counter>::max();
+        MPI_Win_lock(MPI_LOCK_SHARED, (int) m_pMPI->MainNodeRank(), 0, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock");
+        MPI_Accumulate(&done, 1, MPI_LONG_LONG, (int) m_pMPI->MainNodeRank(), m_myRank, 1, MPI_LONG_LONG, MPI_REPLACE, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Accumulate");
+        MPI_Win_unlock((int) m_pMPI->MainNodeRank(), m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_unlock");
+
+        m_pMPI->WaitAll();
+        PushAndPull(learnableNodes, /*pushChanges=*/false);
+        m_pMPI->WaitAll();
+        m_perfReporter.OnEpochEnd();
+    }
+
+    void ModelAggregationProcessing(
+        size_t samplesSinceLastSync,                            /* in */
+        const std::list<ComputationNodeBasePtr>& learnableNodes, /* in/out */
+        std::list<Matrix<ElemType>>& /*smoothedGradient*/,       /* in/out: kept local, as in model averaging */
+        size_t& totalSamplesProcessed,                          /* out */
+        float& secondsOnCommunication                           /* out */) override
+    {
+        Timer commTimer;
+        commTimer.Start();
+        PushAndPull(learnableNodes, /*pushChanges=*/true);
+
+        // advance my clock and the global sample count
+        Counter one = 1;
+        Counter samples = (Counter) samplesSinceLastSync;
+        Counter previousClock, previousSamples;
+        int mainNode = (int) m_pMPI->MainNodeRank();
+        MPI_Win_lock(MPI_LOCK_SHARED, mainNode, 0, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock");
+        MPI_Fetch_and_op(&one, &previousClock, MPI_LONG_LONG, mainNode, m_myRank, MPI_SUM, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Fetch_and_op");
+        MPI_Fetch_and_op(&samples, &previousSamples, MPI_LONG_LONG, mainNode, m_numWorkers, MPI_SUM, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Fetch_and_op");
+        MPI_Win_unlock(mainNode, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_unlock");
+        commTimer.Stop();
+
+        m_myClock = previousClock + 1;
+        Counter globalSamples = previousSamples + samples;
+        totalSamplesProcessed = (size_t) (globalSamples - m_globalSamplesAtLastSync);
+        m_globalSamplesAtLastSync = globalSamples;
+        secondsOnCommunication = (float) commTimer.ElapsedSeconds();
+    }
+
+private:
+    void CreateWindows(const std::list<ComputationNodeBasePtr>& learnableNodes)
+    {
+        for (auto& pBaseNode : learnableNodes)
+        {
+            if (pBaseNode->IsParameterUpdateRequired())
+                m_numElements += DownCast(pBaseNode)->Value().GetNumElements();
+        }
+
+        // contiguous shards of about equal size over the parameters in the order of learnableNodes
+        m_shardBegin.resize(m_numWorkers + 1);
+        for (size_t p = 0; p <= m_numWorkers; p++)
+            m_shardBegin[p] = m_numElements * p / m_numWorkers;
+        if (m_shardBegin[1] > (size_t) INT_MAX)
+            RuntimeError("ParameterServerSGD: Shards of more than %d elements are not supported; use more workers.", INT_MAX);
+
+        MPI_Win_allocate(ShardSize(m_myRank) * sizeof(ElemType), (int) sizeof(ElemType), MPI_INFO_NULL, m_pMPI->Communicator(), &m_shard, &m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_allocate");
+        size_t numCounters = m_pMPI->IsMainNode() ? (m_numWorkers + 1) : 0;
+        MPI_Win_allocate(numCounters * sizeof(Counter), (int) sizeof(Counter), MPI_INFO_NULL, m_pMPI->Communicator(), &m_clocks, &m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_allocate");
+
+        m_lastPulled.resize(m_numElements);
+        m_delta.resize(m_numElements);
+    }
+
+    size_t ShardSize(size_t rank) const
+    {
+        return m_shardBegin[rank + 1] - m_shardBegin[rank];
+    }
+
+    // all learnable parameters, concatenated on the host
+    void CopyModelToHost(const std::list<ComputationNodeBasePtr>& learnableNodes, std::vector<ElemType>& buffer)
+    {
+        size_t offset = 0;
+        for (auto& pBaseNode : learnableNodes)
+        {
+            if (!pBaseNode->IsParameterUpdateRequired())
+                continue;
+            auto& value = DownCast(pBaseNode)->Value();
+            value.CopySection(value.GetNumRows(), value.GetNumCols(), buffer.data() + offset, value.GetNumRows());
+            offset += value.GetNumElements();
+        }
+    }
+
+    // Add (local model - last pulled model) to the global model, and make the result the local model.
+    // With MPI_Get_accumulate, the pull returns the global model right before our push was added, atomically per element.
+    void PushAndPull(const std::list<ComputationNodeBasePtr>& learnableNodes, bool pushChanges)
+    {
+        CopyModelToHost(learnableNodes, m_delta);
+        for (size_t j = 0; j < m_numElements; j++)
+            m_delta[j] = pushChanges ? (m_delta[j] - m_lastPulled[j]) : 0;
+
+        MPI_Datatype dataType = MPIWrapper::GetDataType(m_delta.data());
+        for (size_t p = 0; p < m_numWorkers; p++)
+        {
+            int count = (int) ShardSize(p);
+            if (count == 0)
+                continue;
+            ElemType* delta = m_delta.data() + m_shardBegin[p];
+            ElemType* pulled = m_lastPulled.data() + m_shardBegin[p];
+            MPI_Win_lock(MPI_LOCK_SHARED, (int) p, 0, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock");
+            MPI_Get_accumulate(delta, count, dataType, pulled, count, dataType, (int) p, 0, count, dataType, MPI_SUM, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Get_accumulate");
+            MPI_Win_unlock((int) p, m_shardWindow) || MpiFail("ParameterServerSGD: MPI_Win_unlock");
+        }
+        for (size_t j = 0; j < m_numElements; j++)
+            m_lastPulled[j] += m_delta[j];
+
+        size_t offset = 0;
+        for (auto& pBaseNode : learnableNodes)
+        {
+            if (!pBaseNode->IsParameterUpdateRequired())
+                continue;
+            auto pNode = DownCast(pBaseNode);
+            auto& value = pNode->Value();
+            value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), m_lastPulled.data() + offset);
+            offset += value.GetNumElements();
+        }
+    }
+
+    // Wait while we are more than m_maxStaleness sync points ahead of the slowest worker that has not finished the epoch.
+    // Returns whether we had to wait.
+    bool WaitForStalenessBound()
+    {
+        int mainNode = (int) m_pMPI->MainNodeRank();
+        std::vector<Counter> clocks(m_numWorkers);
+        for (bool waited = false;; waited = true)
+        {
+            // MPI_NO_OP makes this an atomic read with respect to the concurrent MPI_Fetch_and_op of the others
+            MPI_Win_lock(MPI_LOCK_SHARED, mainNode, 0, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_lock");
+            MPI_Get_accumulate(nullptr, 0, MPI_LONG_LONG, clocks.data(), (int) m_numWorkers, MPI_LONG_LONG, mainNode, 0, (int) m_numWorkers, MPI_LONG_LONG, MPI_NO_OP, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Get_accumulate");
+            MPI_Win_unlock(mainNode, m_clockWindow) || MpiFail("ParameterServerSGD: MPI_Win_unlock");
+
+            Counter slowest = *std::min_element(clocks.begin(), clocks.end());
+            if (m_myClock - slowest <= (Counter) m_maxStaleness)
+                return waited;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    size_t m_maxStaleness;
+
+    size_t m_numElements;
+    std::vector<size_t> m_shardBegin; // [p] first element of the shard served by rank p; [m_numWorkers] = m_numElements
+
+    ElemType* m_shard; // my shard of the global model
+    MPI_Win m_shardWindow;
+    Counter* m_clocks; // on the main node only
+    MPI_Win m_clockWindow;
+
+    std::vector<ElemType> m_lastPulled; // the global model as of our last pull
+    std::vector<ElemType> m_delta;      // scratch
+
+    Counter m_myClock;
+    Counter m_globalSamplesAtLastSync;
+};
+
+} } }
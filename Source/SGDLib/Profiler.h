@@ -4,6 +4,7 @@
 //
 #pragma once
 
+// Brackets a window of minibatches for the CUDA profiler. The named ranges within a minibatch come from ProfilerRanges.h.
 class Profiler
 {
 public:
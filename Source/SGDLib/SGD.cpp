@@ -6,6 +6,8 @@
 #include "SGD.h"
 #include "NonlinearityNodes.h"          // for DropoutNode
 #include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
+#include "InputAndParamNodes.h"         // for LearnableParameter
+#include "PreComputeNodes.h"            // for PreComputedNodeBase
 #include "DataReaderHelpers.h"
 #include "MatrixQuantizerImpl.h"
 
@@ -17,7 +19,14 @@
 #endif
 
 #include "SimpleDistGradAggregator.h"
+#include "SparseDistGradAggregator.h"
+#include "ParameterServerSGD.h"
+#include "OverlappedModelAveragingSGD.h"
 #include "ProgressTracing.h"
+#include "ParameterArchive.h"
+#include "CheckpointCompression.h"
+#include "GPUWatcher.h"
+#include "ProfilerRanges.h"
 
 #include <map>
 #include <set>
@@ -26,6 +35,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 using namespace std;
 
+template <class ElemType>
+class TrialSnapshot; // (defined with TrainOneMiniEpochAndReloadModel() below)
+
 // =======================================================================
 // class SGD
 // =======================================================================
@@ -55,24 +67,35 @@ void SGD<ElemType>::Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createN
 
     wstring modelFileName = GetModelNameForEpoch(int(startEpoch) - 1);
     bool loadNetworkFromCheckpoint = startEpoch >= 0;
+    // in distributed training, only the main worker reads the checkpoint; the others create the network and receive its values
+    bool isDistributed = (m_mpi != nullptr) && (m_mpi->NumNodesInUse() > 1) && (GetParallelizationMethod() != ParallelizationMethod::none);
+    bool receiveCheckpoint = loadNetworkFromCheckpoint && isDistributed && m_broadcastInitialModel && !m_mpi->IsMainNode();
     fprintf(stderr, "\n");
-    if (loadNetworkFromCheckpoint)
+    if (loadNetworkFromCheckpoint && !receiveCheckpoint)
         LOGPRINTF(stderr, "Starting from checkpoint. Loading network from '%ls'.\n", modelFileName.c_str());
+    else if (receiveCheckpoint)
+        LOGPRINTF(stderr, "Starting from checkpoint. Creating network to receive '%ls' from the main worker.\n", modelFileName.c_str());
     else
         LOGPRINTF(stderr, "Creating virgin network.\n");
 
     // create or load from checkpoint
-    shared_ptr<ComputationNetwork> net = !loadNetworkFromCheckpoint ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+    shared_ptr<ComputationNetwork> net = !loadNetworkFromCheckpoint || receiveCheckpoint ? createNetworkFn(deviceId) : ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
 
     // log the device we are computing on
-    LOGPRINTF(stderr, "%s model with %d nodes", loadNetworkFromCheckpoint ? "Loaded" : "Created", (int)net->GetTotalNumberOfNodes());
+    LOGPRINTF(stderr, "%s model with %d nodes", loadNetworkFromCheckpoint && !receiveCheckpoint ? "Loaded" : "Created", (int)net->GetTotalNumberOfNodes());
     if (net->GetDeviceId() < 0)
         fprintf(stderr, " on CPU.\n");
     else
         fprintf(stderr, " on GPU %d.\n", (int) net->GetDeviceId());
 
-    // TODO: BUGBUG: if not starting from checkpoint, need to synchronize initial model
-    // strategy should be to run the initializer above on mpiRank==0, and then broadcast parameters.
+    // all workers start from the main worker's model, rather than from the same random initialization or their own reads of the file
+    if (isDistributed)
+    {
+        bool wasBroadcast = m_broadcastInitialModel && BroadcastInitialModel(net);
+        if (receiveCheckpoint && !wasBroadcast) // (the network in the checkpoint differs from the configured one)
+            net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelFileName);
+        VerifyInitialModel(net, wasBroadcast);
+    }
 
     startEpoch = max(startEpoch, 0);
     m_needAdaptRegularization = false;
@@ -137,6 +160,31 @@ void SGD<ElemType>::Adapt(wstring origModelFileName, wstring refNodeName,
     TrainOrAdaptModel(startEpoch, net, networkLoadedFromCheckpoint, refNet, refNode, trainSetDataReader, validationSetDataReader);
 }
 
+// -----------------------------------------------------------------------
+// Benchmark() -- train a few minibatches of a new network, for the time they take
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void SGD<ElemType>::Benchmark(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                              IDataReader* trainSetDataReader,
+                              size_t numMinibatches, size_t numWarmupMinibatches, bool syntheticData)
+{
+    if (numMinibatches == 0)
+        InvalidArgument("Benchmark: numMinibatches must be greater than 0.");
+
+    LOGPRINTF(stderr, "Benchmark: Timing %d minibatches after %d warm-up minibatches, with %s data.\n",
+              (int) numMinibatches, (int) numWarmupMinibatches, syntheticData ? "synthetic" : "real");
+    m_benchmarkMinibatches = numMinibatches;
+    m_benchmarkWarmupMinibatches = numWarmupMinibatches;
+    m_benchmarkSyntheticData = syntheticData;
+    m_checkpointEverySamples = 0; // nothing is saved
+    m_checkpointEveryMinutes = 0;
+
+    // (TrainOrAdaptModel() stops after the first epoch, which ends after the timed minibatches)
+    Train(createNetworkFn, deviceId, trainSetDataReader, /*validationSetDataReader=*/nullptr, /*makeMode=*/false);
+    m_benchmarkMinibatches = 0;
+}
+
 // -----------------------------------------------------------------------
 // TrainOrAdaptModel() -- main training end-to-end, given a start model
 // -----------------------------------------------------------------------
@@ -195,6 +243,30 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     auto preComputeNodesList = net->GetNodesRequiringPreComputation();
     additionalNodesToEvaluate.insert(additionalNodesToEvaluate.end(), preComputeNodesList.cbegin(), preComputeNodesList.cend());
 
+    // pipeline model parallelism: distribute the nodes over the devices before their matrices get allocated
+    if (UseModelParallelSGD())
+        net->PlaceInPipelineStages(m_pipelineStageDevices);
+
+    // single-process multi-GPU data parallelism: the replicas copy the network before its matrices are allocated
+    if (!m_localReplicaDevices.empty())
+    {
+        if (m_doGradientCheck || m_needAdaptRegularization || UseModelParallelSGD() || criterionNodes[0]->OperationName() == L"SequenceWithSoftmax" ||
+            m_bufferedAsyncGradientAggregation || m_overlappedGradientAggregationBucketSize > 0)
+            InvalidArgument("localDataParallelDevices cannot be combined with gradientcheck, adaptation regularization, ModelParallelSGD, sequence training, "
+                            "useBufferedAsyncGradientAggregation, or overlapGradientAggregation.");
+        m_localReplicas = make_shared<LocalReplicas<ElemType>>(net, m_localReplicaDevices, criterionNodes, evaluationNodes);
+    }
+
+    // lock-free multi-threaded CPU training: the workers, too, copy the network before its matrices are allocated
+    if (m_hogwildThreads > 1)
+    {
+        if (!m_localReplicaDevices.empty() || m_doGradientCheck || m_needAdaptRegularization || GetParallelizationMethod() != ParallelizationMethod::none ||
+            criterionNodes[0]->OperationName() == L"SequenceWithSoftmax" || m_useGradientArena || m_offloadOptimizerState || m_gradientClippingByGlobalNorm)
+            InvalidArgument("hogwildThreads cannot be combined with localDataParallelDevices, gradientcheck, adaptation regularization, parallelTrain, "
+                            "sequence training, useGradientArena, offloadOptimizerState, or gradient clipping by the global norm.");
+        m_hogwildWorkers = make_shared<HogwildWorkers<ElemType>>(net, m_hogwildThreads, criterionNodes, evaluationNodes);
+    }
+
     // allocate memory for forward and backward computation
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]); // TODO: use criterionNodes.front() throughout
 
@@ -253,6 +325,14 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     list<Matrix<ElemType>> smoothedGradients;
     size_t numParameters = 0;
 
+    // sharded optimizer state: the workers divide the parameters among them
+    if (m_shardOptimizerState && (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD) && (m_mpi->NumNodesInUse() > 1))
+    {
+        if (m_checkpointEverySamples > 0 || m_checkpointEveryMinutes > 0)
+            InvalidArgument("shardOptimizerState cannot be combined with mid-epoch checkpoints, which only the main node writes.");
+        AssignParameterOwners(learnableNodes);
+    }
+
     vector<wstring> nodesToUpdateDescriptions; // for logging only
     for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
     {
@@ -260,9 +340,12 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // Note: We don't actually need the smoothedGradients if !IsParameterUpdateRequired().
         // However, this is hard to fix since lots of code assumes smoothedGradients to be in the same order as learnableNodes.
         // V2 API fixes this.
-        smoothedGradients.push_back(Matrix<ElemType>(node->Value().GetNumRows(),
-                                                     node->Value().GetNumCols(),
-                                                     net->GetDeviceId()));
+        // With a sharded optimizer state, those of the parameters that other workers update are left empty.
+        bool ownsParameter = OwnsParameter(smoothedGradients.size());
+        bool offloadSmoothedGradient = m_offloadOptimizerState && node->IsParameterUpdateRequired() && (node->Value().GetMatrixType() == DENSE);
+        smoothedGradients.push_back(Matrix<ElemType>(ownsParameter ? node->Value().GetNumRows() : 0,
+                                                     ownsParameter ? node->Value().GetNumCols() : 0,
+                                                     offloadSmoothedGradient ? CPUDEVICE : node->GetDeviceId())); // (differs from the network's with ModelParallelSGD)
         if (node->IsParameterUpdateRequired())
         {
             nodesToUpdateDescriptions.push_back(node->NodeDescription() + L" : [" + msra::strfun::utf16(string(node->GetSampleLayout())) + L"]");
@@ -302,18 +385,28 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
     if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD)
     {
+        if (m_elasticTraining)
+            m_mpi->EnableElasticity();
         InitDistGradAgg(evaluationNodes.size(), m_traceLevel);
     }
     else if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD || 
-             GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD)
+             GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD ||
+             GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD)
     {
         InitModelAggregationHandler(m_syncStatsTrace, net->GetDeviceId());
     }
+
+    if (!m_checkpointStagingDir.empty() && ((m_mpi == nullptr) || m_mpi->IsMainNode()))
+    {
+        msra::files::make_intermediate_dirs(m_checkpointStagingDir + L"/dummy");
+        m_checkpointWriter.reset(new CheckpointWriter(m_checkpointStagingDir, m_maxPendingCheckpointFiles));
+        LOGPRINTF(stderr, "SGD: Writing epoch checkpoints through '%ls' in the background.\n", m_checkpointStagingDir.c_str());
+    }
     
     // precompute mean and invStdDev nodes and save initial model
     // When no precompute, only save if we did not load the model from a 
-    // checkpoint but instead built it from a network description
-    if (PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices) || !networkLoadedFromCheckpoint)
+    // checkpoint but instead built it from a network description, and never in Benchmark()
+    if ((PreCompute(net, trainSetDataReader, featureNodes, labelNodes, inputMatrices) || !networkLoadedFromCheckpoint) && m_benchmarkMinibatches == 0)
     {
         // Synchronize all ranks before writing the model to ensure that
         // everyone is done loading the model
@@ -352,6 +445,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             "or an explicit learning rate must be specified in config for the starting epoch.");
     }
 
+    // an interrupted start epoch is resumed from its mid-epoch checkpoint, if any
+    bool resumeMidEpoch = HasMidEpochCheckPoint(startEpoch);
+
     double prevDropoutRate = 0;
     double prevNormalizationTimeConstant = 0;
     double prevNormalizationBlendTimeConstant = 0;
@@ -393,14 +489,33 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         ComputationNetwork::SetBatchNormalizationTimeConstants<ElemType>(net, criterionNodes[0], 
                                                                          m_batchNormalizationTimeConstant[i], prevNormalizationTimeConstant,
                                                                          m_batchNormalizationBlendTimeConstant[i], prevNormalizationBlendTimeConstant);
-        
+
+        // size the minibatches for the device memory, once the first epoch's dropout and batch normalization settings are in place
+        if (i == startEpoch && m_memoryProbe != MemoryProbeTarget::None)
+        {
+            size_t probedSize = ProbeMinibatchSizeForMemory(net, refNet, refNode, i, trainSetDataReader, learnRatePerSample,
+                                                            featureNodes, labelNodes, criterionNodes, evaluationNodes,
+                                                            inputMatrices, learnableNodes, smoothedGradients);
+            if (probedSize > 0 && m_memoryProbe == MemoryProbeTarget::MinibatchSize)
+            {
+                m_probedMinibatchSize = probedSize;
+                LOGPRINTF(stderr, "MemoryProbe: Using minibatchSize = %d.\n", (int) m_probedMinibatchSize);
+            }
+            else if (probedSize > 0)
+            {
+                m_maxSamplesInRAM = probedSize;
+                m_numSubminiBatches = 1;
+                LOGPRINTF(stderr, "MemoryProbe: Using maxSamplesInRAM = %d.\n", (int) m_maxSamplesInRAM);
+            }
+        }
+
         // learning rate adjustment
         if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::None || i < m_learningRatesParam.size())
         {
             // BUGBUG: GetNumParallelSequences() returns 1 under certain situations; it seems when restarting from checkpoint
             learnRatePerSample = GetLearningRatePerSample(i /*BUGBUG workaround:*/, trainSetDataReader->GetNumParallelSequencesForFixingBPTTMode());
         }
-        else if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch)
+        else if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch && !resumeMidEpoch) // (a resumed epoch keeps its learning rate)
         {
             double largestPrevLearnRatePerSample = prevLearnRates[0];
             for (int j = 1; j < m_numPrevLearnRates; j++)
@@ -444,7 +559,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // basis for a set number of epochs.  For epochs after that point, m_mbSize.size(), either
         // we just keep using
         // the last minibatch size, or we use tuning to try and find a better one.
-        if (m_autoAdjustMinibatch && i >= m_mbSize.size())
+        if (m_autoAdjustMinibatch && i >= m_mbSize.size() && !resumeMidEpoch)
         {
             size_t numFramesToUseInSearch = m_numMiniBatch4LRSearch[i] * m_mbSize[i];
             if (m_epochSize != requestDataSize)
@@ -465,8 +580,38 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         }
         else
         {
-            // use the explicitly set minibatch size
-            chosenMinibatchSize = m_mbSize[i];
+            // use the explicitly set minibatch size, or the one that fits into device memory
+            chosenMinibatchSize = m_probedMinibatchSize > 0 ? m_probedMinibatchSize : m_mbSize[i];
+        }
+
+        // continue the epoch where its mid-epoch checkpoint left off
+        MidEpochPosition resumePosition;
+        if (resumeMidEpoch)
+        {
+            auto midEpochModelName = GetMidEpochModelName(i);
+            LOGPRINTF(stderr, "Resuming epoch %d from mid-epoch checkpoint '%ls'.\n", i + 1, midEpochModelName.c_str());
+            net->RereadPersistableParameters<ElemType>(midEpochModelName);
+            LoadCheckPointInfo(i,
+                               /*out*/ totalTrainingSamplesSeen,
+                               /*out*/ learnRatePerSample,
+                               smoothedGradients,
+                               /*out*/ prevCriterion,
+                               /*out*/ chosenMinibatchSize,
+                               /*out*/ &resumePosition);
+            if (m_autoLearnRateSearchType == LearningRateSearchAlgorithm::SearchBeforeEpoch)
+                prevLearnRates[i % m_numPrevLearnRates] = learnRatePerSample;
+            if (m_autoAdjustMinibatch && i >= m_mbSize.size())
+                m_prevChosenMinibatchSize = chosenMinibatchSize;
+        }
+
+        // mid-epoch checkpoints are written by the main node
+        std::function<void(const MidEpochPosition&)> saveMidEpochCheckPoint;
+        if ((m_checkpointEverySamples > 0 || m_checkpointEveryMinutes > 0) && ((m_mpi == nullptr) || m_mpi->IsMainNode()))
+        {
+            saveMidEpochCheckPoint = [&](const MidEpochPosition& position)
+            {
+                SaveMidEpochCheckPoint(net, i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize, position);
+            };
         }
 
         actualMinibatchSize = FixUpEffectiveMBSize(chosenMinibatchSize /*BUGBUG workaround:*/, trainSetDataReader->GetNumParallelSequencesForFixingBPTTMode());
@@ -480,23 +625,67 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         LOGPRINTF(stderr, "Starting Epoch %d: learning rate per sample = %f  effective momentum = %f  momentum as time constant = %.1f samples\n",
                   i + 1, learnRatePerSample, MomentumPerMB(momentumPerSample, actualMinibatchSize), momentumAsTimeConstant);
 
+        // samples seen for the Adam bias correction; set here so that the trials of the learning-rate and minibatch-size searches do not count
+        m_numSamplesSeenByUpdates = totalTrainingSamplesSeen + (resumeMidEpoch ? resumePosition.numSamples : 0);
+
+        // in elastic training, an epoch in which a worker is lost is restarted by the surviving workers from a copy of its starting state
+        unique_ptr<TrialSnapshot<ElemType>> epochStartSnapshot;
+        if (m_elasticTraining)
+            epochStartSnapshot.reset(new TrialSnapshot<ElemType>(net, smoothedGradients));
+
         EpochCriterion epochCriterion; // criterion values are returned in this
         std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size());
-        TrainOneEpoch(net,
-                      refNet,
-                      refNode,
-                      i,
-                      m_epochSize,
-                      trainSetDataReader,
-                      learnRatePerSample,
-                      chosenMinibatchSize,
-                      featureNodes,
-                      labelNodes,
-                      criterionNodes,
-                      evaluationNodes,
-                      inputMatrices,
-                      learnableNodes, smoothedGradients,
-                      epochCriterion, epochEvalErrors);
+        for (;;)
+        {
+            try
+            {
+                TrainOneEpoch(net,
+                              refNet,
+                              refNode,
+                              i,
+                              m_epochSize,
+                              trainSetDataReader,
+                              learnRatePerSample,
+                              chosenMinibatchSize,
+                              featureNodes,
+                              labelNodes,
+                              criterionNodes,
+                              evaluationNodes,
+                              inputMatrices,
+                              learnableNodes, smoothedGradients,
+                              epochCriterion, epochEvalErrors,
+                              /*prefixMsg=*/"",
+                              resumeMidEpoch ? &resumePosition : nullptr,
+                              saveMidEpochCheckPoint);
+                break;
+            }
+            catch (const MpiNodeLost& e)
+            {
+                if (!m_elasticTraining)
+                    throw;
+                size_t numLost = m_mpi->ShrinkToSurvivors();
+                LOGPRINTF(stderr, "Lost %d worker(s) during epoch %d (%s); restarting the epoch with the remaining %d workers.\n",
+                          (int) numLost, i + 1, e.what(), (int) m_mpi->NumNodesInUse());
+
+                // the reader redistributes the data over the new set of workers when the epoch starts again
+                epochStartSnapshot->Restore(smoothedGradients);
+                m_distGradAgg.reset();
+                InitDistGradAgg(evaluationNodes.size(), m_traceLevel);
+                m_numSamplesSeenByUpdates = totalTrainingSamplesSeen + (resumeMidEpoch ? resumePosition.numSamples : 0);
+                epochCriterion = EpochCriterion();
+                epochEvalErrors.assign(evaluationNodes.size(), EpochCriterion());
+
+                // the lost worker may have been the main node, which writes the mid-epoch checkpoints
+                if ((m_checkpointEverySamples > 0 || m_checkpointEveryMinutes > 0) && m_mpi->IsMainNode() && !saveMidEpochCheckPoint)
+                {
+                    saveMidEpochCheckPoint = [&](const MidEpochPosition& position)
+                    {
+                        SaveMidEpochCheckPoint(net, i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize, position);
+                    };
+                }
+            }
+        }
+        resumeMidEpoch = false;
         totalTrainingSamplesSeen += epochCriterion.second; // aggregate #training samples, for logging purposes only
 
         timer.Stop();
@@ -514,6 +703,12 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %d; learningRatePerSample = %.8g; epochTime=%.6gs\n", (int)totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+        if (net->GetDeviceId() >= 0)
+            TracingGPUMemoryAllocator::PrintStatistics(net->GetDeviceId()); // no-op unless gpuMemoryAllocator="caching"
+
+        // Benchmark() is done; it neither validates nor saves the model
+        if (m_benchmarkMinibatches > 0)
+            break;
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -528,7 +723,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
         if (validationSetDataReader != trainSetDataReader && validationSetDataReader != nullptr)
         {
-            SimpleEvaluator<ElemType> evalforvalidation(net, m_mpi, m_enableDistributedMBReading);
+            // each worker reads only its share of the validation data, whether or not training uses distributed reading,
+            // since the order in which samples are evaluated does not matter
+            SimpleEvaluator<ElemType> evalforvalidation(net, m_mpi, /*enableDistributedMBReading=*/true);
             vector<wstring> cvSetTrainAndEvalNodes;
             if (criterionNodes.size() > 0)
             {
@@ -559,7 +756,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         // broadcast epochCriterion to make sure each processor will have the same learning rate schedule
         if ((GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD 
             ||
-            GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD) 
+            GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD ||
+            GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD) 
             && (m_mpi->NumNodesInUse() > 1))
         {
             m_mpi->Bcast(&epochCriterion.first,  1, m_mpi->MainNodeRank());
@@ -591,6 +789,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     // roll back
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     LOGPRINTF(stderr, "Loading (rolling back to) previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    WaitForCheckPoints();
+                    if (m_mpi != nullptr && !m_checkpointStagingDir.empty())
+                        m_mpi->WaitAll(); // the other ranks wait for the main node's background writes
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalTrainingSamplesSeen,
@@ -669,9 +870,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             m_mpi->WaitAll();
         }
 
+        // with a sharded optimizer state, the main node collects the smoothed gradients of the other workers for the checkpoint
+        if (!m_parameterOwners.empty())
+            ReceiveShardedSmoothedGradients(smoothedGradients);
+
         // Persist model and check-point info
         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
         {
+            // the epoch is complete (or rolled back), so its mid-epoch checkpoint is no longer needed
+            DeleteMidEpochCheckPoint(i);
+
             if (loadedPrevModel)
             {
                 // If previous best model is loaded, we will first remove epochs that lead to worse results
@@ -679,8 +887,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 {
                     int epochToDelete = i - j;
                     LOGPRINTF(stderr, "SGD: removing model and checkpoint files for epoch %d after rollback to epoch %lu\n", epochToDelete + 1, (size_t)(i - m_learnRateAdjustInterval) + 1);  // report 1 based epoch number
-                    _wunlink(GetModelNameForEpoch(epochToDelete).c_str());
-                    _wunlink(GetCheckPointFileNameForEpoch(epochToDelete).c_str());
+                    DeleteCheckPointFile(GetModelNameForEpoch(epochToDelete));
+                    DeleteCheckPointFile(GetCheckPointFileNameForEpoch(epochToDelete));
                 }
 
                 // Set i back to the loaded model
@@ -693,7 +901,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, chosenMinibatchSize);
                 auto modelName = GetModelNameForEpoch(i);
                 LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                SaveCheckPointModel(net, modelName);
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -701,16 +909,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            DeleteCheckPointFile(GetCheckPointFileNameForEpoch(i - 1));
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            DeleteCheckPointFile(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        DeleteCheckPointFile(GetCheckPointFileNameForEpoch(i - 1));
                     }
                 }
             }
@@ -723,6 +931,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 i -= m_learnRateAdjustInterval;
             }
         }
+        m_receivedSmoothedGradients.clear();
 
         if (learnRatePerSample < 1e-12)
         {
@@ -732,6 +941,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     }
     // --- END OF MAIN EPOCH LOOP
 
+    WaitForCheckPoints();
+
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
     if (m_mpi != nullptr)
@@ -778,7 +989,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     std::list<Matrix<ElemType>>& smoothedGradients,
                                     /*out*/ EpochCriterion& epochCriterion,
                                     /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
-                                    const std::string& prefixMsg)
+                                    const std::string& prefixMsg,
+                                    const MidEpochPosition* resumePosition,
+                                    const std::function<void(const MidEpochPosition&)>& saveMidEpochCheckPoint)
 {
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
 
@@ -797,6 +1010,14 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     bool useModelAggregation = UsingModelAggregation(epochNumber);
     bool useParallelTrain = UsingParallelTrain(epochNumber);
 
+    // With model aggregation, the workers' models differ between syncs, so there is no single model to checkpoint mid-epoch.
+    if (useModelAggregation && (resumePosition || saveMidEpochCheckPoint))
+    {
+        LOGPRINTF(stderr, "Mid-epoch checkpoints are not supported with model aggregation; %s.\n", resumePosition ? "restarting the epoch" : "none are written");
+        resumePosition = nullptr;
+    }
+    bool useMidEpochCheckPoints = saveMidEpochCheckPoint && !useModelAggregation;
+
     // MA-related variables
     size_t nSamplesSinceLastModelSync = 0;
     size_t blockSizePerWorker = 0;
@@ -807,11 +1028,44 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    std::vector<Matrix<ElemType>*> gradientsInCompletionOrder; // for overlapped gradient aggregation
+
+    // bind the parameters to the arena when first used; afterwards, re-establish the binding in case a model or checkpoint was reloaded
+    if (m_useGradientArena && !m_parameterArena)
+    {
+        m_parameterArena = make_shared<ParameterArena<ElemType>>();
+        m_parameterArena->Bind(learnableNodes, smoothedGradients, [this](const ComputationNodeBasePtr& node) { return CanFuseParameterUpdate(node); });
+    }
+    else if (m_parameterArena)
+        m_parameterArena->EnsureBound();
+    bool useParameterArena = m_parameterArena && !m_parameterArena->IsEmpty();
+    if (m_offloadOptimizerState && !m_optimizerStateOffload)
+        m_optimizerStateOffload = make_shared<OptimizerStateOffload<ElemType>>(learnableNodes, smoothedGradients);
     Profiler profiler(m_numMBsToCUDAProfile);
 
+    shared_ptr<MemoryTelemetry> memoryTelemetry;
+    if (m_memoryTelemetry && net->GetDeviceId() >= 0)
+        memoryTelemetry = make_shared<MemoryTelemetry>(net->GetDeviceId());
+
     // resetting this, so profiling is performed for one epoch only
     m_numMBsToCUDAProfile = 0;
 
+    // per-node profile of the first minibatches, also for one epoch only; see ComputationNetwork::EnableNodeProfiling()
+    size_t numMBsToProfileNodes = m_numMBsToProfileNodes;
+    size_t numMBsNodeProfiled = 0;
+    m_numMBsToProfileNodes = 0;
+    auto finishNodeProfile = [&]()
+    {
+        net->GetNodeProfiler()->Print();
+        if (!m_nodeProfileTraceFile.empty())
+        {
+            bool isParallel = m_mpi && m_mpi->NumNodesInUse() > 1;
+            net->GetNodeProfiler()->WriteChromeTrace(isParallel ? m_nodeProfileTraceFile + L".rank" + std::to_wstring(m_mpi->CurrentNodeRank()) : m_nodeProfileTraceFile);
+        }
+        net->EnableNodeProfiling(false);
+        numMBsToProfileNodes = 0;
+    };
+
     bool useDistributedMBReading = useParallelTrain &&
                                    m_enableDistributedMBReading &&
                                    trainSetDataReader->SupportsDistributedMBRead();
@@ -841,6 +1095,19 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     if (numSubminibatchesNeeded > 1)
         smbDispatcher.Init(net, learnableNodes, criterionNodes, evaluationNodes);
 
+    if (m_localReplicas)
+    {
+        if (numSubminibatchesNeeded > 1)
+            InvalidArgument("localDataParallelDevices cannot be combined with sub-minibatches (numSubminibatches, maxSamplesInRAM).");
+        m_localReplicas->StartEpoch();
+    }
+    if (m_hogwildWorkers)
+    {
+        if (numSubminibatchesNeeded > 1)
+            InvalidArgument("hogwildThreads cannot be combined with sub-minibatches (numSubminibatches, maxSamplesInRAM).");
+        m_hogwildWorkers->StartEpoch();
+    }
+
     // The following is a special feature only supported by the Kaldi2Reader for more efficient sequence training.
     // This attemps to compute the error signal for the whole utterance, which will
     // be fed to the neural network as features. Currently it is a workaround
@@ -860,6 +1127,16 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         {
             fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
         }
+
+        if (m_distGradAgg->SupportsOverlappedAggregation())
+        {
+            fprintf(stderr, ", OverlappedGradientAggregation is ENABLED");
+        }
+
+        if (m_useCudaAwareMPI)
+        {
+            fprintf(stderr, ", CUDA-aware MPI is ENABLED");
+        }
     }
 
     if (useDistributedMBReading)
@@ -885,37 +1162,115 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     CriterionAccumulator<ElemType> localEpochCriterion(1, net->GetDeviceId());
     CriterionAccumulator<ElemType> localEpochEvalErrors(epochEvalErrors.size(), net->GetDeviceId());
 
+    // when resuming from a mid-epoch checkpoint, skip the minibatches that are in the model already
+    // The reader delivers the same minibatches as before since it is deterministic given the epoch and minibatch size.
+    // Skipped minibatches are read but not computed. The criteria so far continue from the checkpoint.
+    EpochCriterion resumedEpochCriterion;
+    std::vector<EpochCriterion> resumedEpochEvalErrors(epochEvalErrors.size());
+    if (resumePosition)
+    {
+        LOGPRINTF(stderr, "Skipping %d minibatches (%d samples) that are in the mid-epoch checkpoint.\n", (int) resumePosition->numMinibatches, (int) resumePosition->numSamples);
+        for (size_t k = 0; k < resumePosition->numMinibatches; k++)
+        {
+            if (!trainSetDataReader->GetMinibatch(*inputMatrices))
+                break;
+            trainSetDataReader->DataEnd();
+        }
+        numMBsRun = (int) resumePosition->numMinibatches;
+        totalEpochSamples = resumePosition->numSamples;
+        resumedEpochCriterion = resumePosition->criterion;
+        if (resumePosition->evalErrors.size() == resumedEpochEvalErrors.size())
+            resumedEpochEvalErrors = resumePosition->evalErrors;
+        epochCriterion = resumedEpochCriterion;
+        epochEvalErrors = resumedEpochEvalErrors;
+    }
+
+    // the criteria accumulated on this worker without gradient aggregation, continuing those of a resumed checkpoint
+    auto getLocalEpochCriteria = [&](EpochCriterion& criterion, std::vector<EpochCriterion>& evalErrors)
+    {
+        criterion = resumedEpochCriterion;
+        criterion += localEpochCriterion.GetCriterion(0);
+        for (size_t i = 0; i < evalErrors.size(); i++)
+        {
+            evalErrors[i] = resumedEpochEvalErrors[i];
+            evalErrors[i] += localEpochEvalErrors.GetCriterion(i);
+        }
+    };
+
+    // mid-epoch checkpoint cadence
+    size_t epochSamplesAtLastCheckPoint = totalEpochSamples;
+    auto lastCheckPointTime = std::chrono::steady_clock::now();
+
     // --- MAIN MINIBATCH LOOP
 
     // for differential logging, we keep the previous criterion values around
     EpochCriterion         epochCriterionLastLogged  = epochCriterion;
     vector<EpochCriterion> epochEvalErrorsLastLogged = epochEvalErrors;
 
+    // Benchmark(): the minibatches after the warm-up are timed, in the regular epoch only (not in the trials of the searches)
+    bool benchmarking = m_benchmarkMinibatches > 0 && prefixMsg.empty();
+    if (benchmarking && m_benchmarkSyntheticData && (numSubminibatchesNeeded > 1 || m_localReplicas || m_hogwildWorkers))
+        InvalidArgument("Benchmark: syntheticData cannot be combined with sub-minibatches, localDataParallelDevices or hogwildThreads, which take the minibatch apart.");
+    MinibatchPhaseTimes benchmarkPhaseTimes; // summed over the timed minibatches
+    size_t benchmarkNumSamples = 0;          // of this worker
+    size_t syntheticMBSize = 0;              // of the minibatch that is trained over and over with syntheticData
+    Timer benchmarkTimer;
+
+    // Per-minibatch performance measurements; only enabled when perfTraceLevel > 0 or benchmarking
+    bool measurePhases = m_perfTraceLevel > 0 || benchmarking;
+    Timer fineGrainedPerfMeasurementTimer;
+    MinibatchPhaseTimes phaseTimes;
+    // ends a phase of the minibatch: adds the time since the previous phase ended, optionally after the device has completed the work
+    auto endPhase = [&](double& phaseTime, bool synchronizeDevice)
+    {
+        if (!measurePhases)
+            return;
+        if (synchronizeDevice)
+        {
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
+            mainStreamSyncEvent->SynchronizeEvent();
+        }
+        fineGrainedPerfMeasurementTimer.Stop();
+        phaseTime += fineGrainedPerfMeasurementTimer.ElapsedSeconds();
+        fineGrainedPerfMeasurementTimer.Start();
+    };
+
     bool noMoreSamplesToProcess = false;
     for (;;)
     {
-        // Per-minibatch performance measurements; only enabled when perfTraceLevel > 0
-        Timer fineGrainedPerfMeasurementTimer;
-        double readTime = 0;
-        double computeTime = 0;
-        double parameterUpdateTime = 0;
-        if (m_perfTraceLevel > 0)
+        // named ranges of the phases for NVTX and the host trace, see ProfilerRanges
+        ProfilerRange minibatchRange(L"Minibatch");
+
+        if (benchmarking && numMBsRun == (int) m_benchmarkWarmupMinibatches)
+            benchmarkTimer.Start(); // (the device has completed the warm-up minibatches, see endPhase())
+        if (measurePhases)
+        {
+            phaseTimes = MinibatchPhaseTimes();
             fineGrainedPerfMeasurementTimer.Start();
+        }
 
         // get minibatch
         // TODO: is it guaranteed that the GPU is already completed at this point, is it safe to overwrite the buffers?
         size_t actualMBSize = 0;
-        bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0],
-                                                                                useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize, m_mpi);
+        bool wasDataRead;
+        if (benchmarking && m_benchmarkSyntheticData && numMBsRun > 0)
+        {
+            // the first minibatch is still in the input matrices
+            wasDataRead = true;
+            actualMBSize = syntheticMBSize;
+        }
+        else
+        {
+            ProfilerRange range(L"Read");
+            wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, criterionNodes[0],
+                                                                               useDistributedMBReading, useParallelTrain, *inputMatrices, actualMBSize, m_mpi);
+            syntheticMBSize = wasDataRead ? actualMBSize : 0;
+        }
         if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) // in case of distributed reading, we do a few more loops until all ranks have completed
             break;                                                                // end of epoch
 
-        if (m_perfTraceLevel > 0)
-        {
-            fineGrainedPerfMeasurementTimer.Stop();
-            readTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
-            fineGrainedPerfMeasurementTimer.Start();
-        }
+        endPhase(phaseTimes.read, /*synchronizeDevice=*/false);
+        endPhase(phaseTimes.transfer, /*synchronizeDevice=*/true); // the upload of the input matrices is asynchronous
 
         // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
         // Must not touch them.
@@ -938,6 +1293,33 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
         ComputationNetwork::BumpEvalTimeStamp(labelNodes);
 
+        // with overlapped aggregation, gradients are handed to the aggregator while backprop completes them
+        // This is done for every minibatch, also if this worker has no data, to keep the workers in sync.
+        bool overlapGradientAggregation = useGradientAggregation && m_distGradAgg->SupportsOverlappedAggregation();
+        if (overlapGradientAggregation)
+        {
+            if (gradientsInCompletionOrder.empty())
+            {
+                set<ComputationNodeBasePtr> updatedParameters;
+                for (auto& node : learnableNodes)
+                {
+                    if (node->IsParameterUpdateRequired())
+                        updatedParameters.insert(node);
+                }
+                for (auto& node : net->GetGradientCompletionOrder(criterionNodes[0]))
+                {
+                    if (updatedParameters.find(node) == updatedParameters.end())
+                        continue;
+                    ComputationNodePtr paramNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+                    // gradients must have their final size for planning the buckets
+                    if (paramNode->Gradient().GetNumCols() == 0)
+                        paramNode->Gradient().Resize(paramNode->Value().GetNumRows(), paramNode->Value().GetNumCols());
+                    gradientsInCompletionOrder.push_back(&paramNode->Gradient());
+                }
+            }
+            m_distGradAgg->BeginOverlappedAggregation(gradientsInCompletionOrder);
+        }
+
         if (actualMBSize > 0)
         {
             assert(wasDataRead);
@@ -962,6 +1344,29 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }
 
             // do forward and back propagation
+            bool computeGradients = learnRatePerSample > 0.01 * m_minLearnRate; // only compute gradient when learning rate is large enough
+
+            // With local replicas, the network computes the first part of the minibatch while the replicas compute the others.
+            if (m_localReplicas)
+            {
+                m_localReplicas->SplitMinibatch(*inputMatrices);
+                ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                m_localReplicas->StartComputation(computeGradients);
+            }
+
+            // Likewise the Hogwild workers, which also update the parameters with their gradients as soon as they have them.
+            if (m_hogwildWorkers)
+            {
+                double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+                m_hogwildWorkers->SplitMinibatch(*inputMatrices);
+                ComputationNetwork::BumpEvalTimeStamp(featureNodes);
+                ComputationNetwork::BumpEvalTimeStamp(labelNodes);
+                m_hogwildWorkers->StartComputation(computeGradients, [this, learnRatePerSample, momentumPerSample](const ComputationNodeBasePtr& node, Matrix<ElemType>& smoothedGradient, size_t numSamples)
+                {
+                    UpdateWeights(node, smoothedGradient, learnRatePerSample, momentumPerSample, numSamples, m_L2RegWeight, m_L1RegWeight, m_needAveMultiplier, m_useNesterovMomentum);
+                });
+            }
 
             // We optionally break the minibatch into sub-minibatches.
             // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
@@ -979,22 +1384,41 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // forward prop for evaluate eval nodes
                 // ===========================================================
 
-                // compute eval node first since when gradient is computed the forward function values
-                // may be changed and need to be recomputed when gradient and function value share the same matrix
-                net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
+                {
+                    ProfilerRange range(L"Forward");
 
-                // ===========================================================
-                // forward prop for training criterion
-                // ===========================================================
+                    // compute eval node first since when gradient is computed the forward function values
+                    // may be changed and need to be recomputed when gradient and function value share the same matrix
+                    net->ForwardProp(evaluationNodes); // the bulk of this evaluation is reused in ComputeGradient() below
+
+                    // ===========================================================
+                    // forward prop for training criterion
+                    // ===========================================================
 
-                net->ForwardProp(criterionNodes[0]);
+                    net->ForwardProp(criterionNodes[0]);
+                }
+                endPhase(phaseTimes.forward, /*synchronizeDevice=*/true);
 
                 // ===========================================================
                 // backprop
                 // ===========================================================
 
-                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                if (computeGradients)
+                {
+                    ProfilerRange range(L"Backward");
+
+                    // gradients are final only in the last sub-minibatch
+                    if (overlapGradientAggregation && (ismb + 1 == actualNumSubminibatches))
+                    {
+                        net->Backprop(criterionNodes[0], [this](const ComputationNodeBasePtr& node)
+                        {
+                            m_distGradAgg->OnGradientCompleted(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                        });
+                    }
+                    else
+                        net->Backprop(criterionNodes[0]);
+                }
+                endPhase(phaseTimes.backward, /*synchronizeDevice=*/true);
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1002,17 +1426,23 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             }                                                        // end sub-minibatch loop
             if (actualNumSubminibatches > 1)
                 smbDispatcher.DoneWithCurrentMinibatch();
+
+            // add the gradients and criteria of the replicas to those of the network
+            if (m_localReplicas)
+                m_localReplicas->FinishComputation(computeGradients);
+            if (m_hogwildWorkers)
+                m_hogwildWorkers->FinishComputation();
         } // if (actualMBSize > 0)
 
-        if (m_perfTraceLevel > 0)
+        // parameters whose gradient turned out sparse in this backprop leave the arena; re-collect the gradients to aggregate
+        if (useParameterArena && m_parameterArena->EnsureBound())
         {
-            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
-            mainStreamSyncEvent->SynchronizeEvent();
-            fineGrainedPerfMeasurementTimer.Stop();
-            computeTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
-            fineGrainedPerfMeasurementTimer.Start();
+            learnParamsGradients.clear();
+            useParameterArena = !m_parameterArena->IsEmpty();
         }
 
+        endPhase(phaseTimes.backward, /*synchronizeDevice=*/true); // (the replicas and the sub-minibatch house-keeping)
+
         // for momentum/clipping/regularization/etc., as well as for progress and statistics, we should only count frames that are not gaps
         // #samples according to the default dynamic axis, for use with criterion nodes that do not have an MBLayout
         size_t numSamplesWithLabelOfNetwork = wasDataRead ? net->GetNumSamplesWithLabelOfNetwork(actualMBSize) : 0;
@@ -1037,12 +1467,18 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         else
         {
             // distributed gradient aggregation
+            ProfilerRange range(L"Aggregate");
             if (learnParamsGradients.size() == 0)
             {
                 learnParamsGradients.reserve(learnableNodes.size());
+                // the arena is aggregated as one matrix
+                if (useParameterArena && !overlapGradientAggregation)
+                    learnParamsGradients.push_back(&m_parameterArena->Gradients());
                 for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+                    if (useParameterArena && !overlapGradientAggregation && m_parameterArena->Contains(node))
+                        continue;
                     if (node->IsParameterUpdateRequired())
                     {
                         Matrix<ElemType>* currParamsGradient = &(node->Gradient()); // TODO: we can use shared_ptrs now
@@ -1058,6 +1494,16 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                         learnParamsGradients.push_back(currParamsGradient);
                     }
                 }
+
+                // with a sharded optimizer state, each gradient is only needed by the worker that updates the parameter
+                if (!m_parameterOwners.empty())
+                {
+                    std::vector<int> gradientOwners;
+                    for (int owner : m_parameterOwners)
+                        if (owner >= 0)
+                            gradientOwners.push_back(owner);
+                    m_distGradAgg->SetGradientOwners(gradientOwners);
+                }
             }
 
             // prepare the header
@@ -1067,8 +1513,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             localEpochCriterion.Assign(criterionNodes, 0, numSamplesWithLabelOfNetwork);
             for (size_t i = 0; i < evaluationNodes.size(); i++)
                 localEpochEvalErrors.Assign(evaluationNodes, i, numSamplesWithLabelOfNetwork);
-            m_gradHeader->numSamplesWithLabel = localEpochCriterion.GetCriterion(0).second;
-            m_gradHeader->criterion           = localEpochCriterion.GetCriterion(0).first;
+            let localCriterion = localEpochCriterion.GetCriterion(0);
+            m_gradHeader->numSamplesWithLabel = localCriterion.second;
+            m_gradHeader->criterion           = localCriterion.first;
             for (size_t i = 0; i < evaluationNodes.size(); i++)
                 m_gradHeader->evalErrors[i] = localEpochEvalErrors.GetCriterion(i);
 
@@ -1081,25 +1528,35 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             for (size_t i = 0; i < epochEvalErrors.size(); i++)
                 epochEvalErrors[i] += m_gradHeader->evalErrors[i];
         }
+        endPhase(phaseTimes.aggregate, /*synchronizeDevice=*/true);
 
         // update model parameters
         if ((aggregateNumSamples > 0) && (learnRatePerSample > m_minLearnRate * 0.01))
         {
+            ProfilerRange range(L"Update");
 #if 1       // BUGBUG: We must skip gaps in our momentum, clipping, regularization etc. criteria.
             // This will break test cases. So for now, we will only enable this for per-sample criteria.
             size_t numSamplesInMinibatch = aggregateNumSamples;
             if (criterionNodes[0]->HasMBLayout())
 #endif
             numSamplesInMinibatch = aggregateNumSamplesWithLabel;
+            if (m_hogwildWorkers) // the workers have applied their gradients already
+                numSamplesInMinibatch = m_hogwildWorkers->GetNumSamplesOfNetwork();
 #if 0
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
 #endif
+            if (m_gradientClippingByGlobalNorm)
+                ClipGradientsByGlobalNorm(learnableNodes, numSamplesInMinibatch);
+
             auto smoothedGradientIter = smoothedGradients.begin();
-            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++)
+            size_t parameterIndex = 0;
+            for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, smoothedGradientIter++, parameterIndex++)
             {
                 ComputationNodeBasePtr node = *nodeIter;
-                if (node->IsParameterUpdateRequired())
+                if ((useParameterArena && m_parameterArena->Contains(node)) || (m_optimizerStateOffload && m_optimizerStateOffload->Contains(node)))
+                    continue; // updated below
+                if (node->IsParameterUpdateRequired() && OwnsParameter(parameterIndex))
                 {
                     Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
 #ifdef _DEBUG
@@ -1117,24 +1574,41 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 #endif
                 }
             }
-        }
 
-        if (m_perfTraceLevel > 0)
-        {
-            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(net->GetDeviceId()));
-            mainStreamSyncEvent->SynchronizeEvent();
-            fineGrainedPerfMeasurementTimer.Stop();
-            parameterUpdateTime = fineGrainedPerfMeasurementTimer.ElapsedSeconds();
+            // all parameters in the arena at once
+            if (useParameterArena)
+            {
+                UpdateWeightsS(this, m_parameterArena->Values(), m_parameterArena->Gradients(), m_parameterArena->SmoothedGradients(), learnRatePerSample,
+                               GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences()), numSamplesInMinibatch,
+                               m_L2RegWeight, m_L1RegWeight,
+                               m_needAveMultiplier, m_useNesterovMomentum);
+                m_parameterArena->BumpEvalTimeStamps();
+            }
 
-            PREPENDTS(stderr);
-            fprintf(stderr, "Perf trace: Worker MB size = %d, Read = %.5gs; Compute = %.5gs; Parameter update = %.5gs, Aggregate MB size = %d\n", (int)actualMBSize, readTime, computeTime, parameterUpdateTime, (int)aggregateNumSamples);
+            // the parameters whose smoothed gradients are in host memory are updated there
+            if (m_optimizerStateOffload)
+            {
+                double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
+                m_optimizerStateOffload->Update([&](const ComputationNodeBasePtr& node, Matrix<ElemType>& value, Matrix<ElemType>& gradient, Matrix<ElemType>& smoothedGradient)
+                {
+                    UpdateWeightsS(this, value, gradient, smoothedGradient, learnRatePerSample * node->GetLearningRateMultiplier(), momentumPerSample,
+                                   numSamplesInMinibatch, m_L2RegWeight, m_L1RegWeight, m_needAveMultiplier, m_useNesterovMomentum);
+                });
+            }
+
+            // the other parameters were updated by the workers that own them
+            if (!m_parameterOwners.empty())
+                BroadcastUpdatedParameters(learnableNodes);
+            m_numSamplesSeenByUpdates += numSamplesInMinibatch;
         }
+        endPhase(phaseTimes.update, /*synchronizeDevice=*/true);
 
         // aggregation by model averaging or block momentum 
         if (useModelAggregation)
         {
             if (nSamplesSinceLastModelSync >= blockSizePerWorker)
             {
+                ProfilerRange range(L"Aggregate");
                 bool synced = m_pMASGDHelper->OnArrivingAtSyncPoint(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
                 if (synced)
                 {
@@ -1147,6 +1621,19 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 noMoreSamplesToProcess = !wasDataRead;
             }
         }
+        endPhase(phaseTimes.aggregate, /*synchronizeDevice=*/true);
+
+        if (m_perfTraceLevel > 0)
+        {
+            PREPENDTS(stderr);
+            fprintf(stderr, "Perf trace: Worker MB size = %d, Read = %.5gs; Transfer = %.5gs; Forward = %.5gs; Backward = %.5gs; Aggregate = %.5gs; Parameter update = %.5gs, Aggregate MB size = %d\n",
+                    (int)actualMBSize, phaseTimes.read, phaseTimes.transfer, phaseTimes.forward, phaseTimes.backward, phaseTimes.aggregate, phaseTimes.update, (int)aggregateNumSamples);
+        }
+        if (benchmarking && numMBsRun >= (int) m_benchmarkWarmupMinibatches)
+        {
+            benchmarkPhaseTimes += phaseTimes;
+            benchmarkNumSamples += actualMBSize;
+        }
 
         timer.Stop();
         numMBsRun++;
@@ -1163,9 +1650,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             {
                 // if no aggregation, we directly get the values from the minibatch accumulators
                 timer.Restart();
-                epochCriterion = localEpochCriterion.GetCriterion(0);
-                for (size_t i = 0; i < epochEvalErrors.size(); i++)
-                    epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
+                getLocalEpochCriteria(epochCriterion, epochEvalErrors);
                 timer.Stop();
 
                 // Add the last trailing compute
@@ -1218,6 +1703,13 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (wasProgressPrinted)
                 ProgressTracing::TraceTrainLoss(trainLossSinceLastLogged);
 
+            if (memoryTelemetry)
+            {
+                auto census = memoryTelemetry->Sample(net, learnableNodes, smoothedGradients, *inputMatrices);
+                if (m_traceLevel > 0)
+                    memoryTelemetry->Log(census);
+            }
+
             if (m_traceLevel > 0)
                 fflush(stderr);
 
@@ -1247,10 +1739,57 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
         profiler.NextSample();
+
+        if (numMBsToProfileNodes > 0)
+        {
+            if (!net->IsNodeProfilingEnabled())
+                net->EnableNodeProfiling(true); // after the first minibatch, which warms up allocations and algorithm choices
+            else if (++numMBsNodeProfiled == numMBsToProfileNodes)
+                finishNodeProfile();
+        }
+
+        if (useMidEpochCheckPoints)
+        {
+            double minutesSinceLastCheckPoint = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastCheckPointTime).count() / 60;
+            if ((m_checkpointEverySamples > 0 && totalEpochSamples - epochSamplesAtLastCheckPoint >= m_checkpointEverySamples) ||
+                (m_checkpointEveryMinutes > 0 && minutesSinceLastCheckPoint >= m_checkpointEveryMinutes))
+            {
+                MidEpochPosition position;
+                position.numMinibatches = numMBsRun;
+                position.numSamples = totalEpochSamples;
+                position.criterion = epochCriterion;
+                position.evalErrors = epochEvalErrors;
+                if (!useGradientAggregation) // (otherwise they are current already)
+                    getLocalEpochCriteria(position.criterion, position.evalErrors);
+                saveMidEpochCheckPoint(position);
+                epochSamplesAtLastCheckPoint = totalEpochSamples;
+                lastCheckPointTime = std::chrono::steady_clock::now();
+            }
+        }
+
+        if (benchmarking && numMBsRun == (int) (m_benchmarkWarmupMinibatches + m_benchmarkMinibatches))
+            break;
     }
 
     // --- END MAIN MINIBATCH LOOP
 
+    if (benchmarking)
+    {
+        size_t numTimedMBs = numMBsRun > (int) m_benchmarkWarmupMinibatches ? numMBsRun - m_benchmarkWarmupMinibatches : 0;
+        if (numTimedMBs > 0)
+            benchmarkTimer.Stop();
+        LogBenchmarkResult(benchmarkPhaseTimes, numTimedMBs, benchmarkNumSamples, numTimedMBs > 0 ? benchmarkTimer.ElapsedSeconds() : 0);
+    }
+
+    if (numMBsToProfileNodes > 0 && net->IsNodeProfilingEnabled()) // epoch ended early
+        finishNodeProfile();
+
+    if (memoryTelemetry)
+    {
+        memoryTelemetry->Sample(net, learnableNodes, smoothedGradients, *inputMatrices);
+        memoryTelemetry->LogEpochPeaks(epochNumber);
+    }
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1261,9 +1800,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     // (unless we useGradientAggregation, in which case they are accumulated in the 'out' variables directly)
     if (!useGradientAggregation)
     {
-        epochCriterion = localEpochCriterion.GetCriterion(0);
-        for (size_t i = 0; i < epochEvalErrors.size(); i++)
-            epochEvalErrors[i] = localEpochEvalErrors.GetCriterion(i);
+        getLocalEpochCriteria(epochCriterion, epochEvalErrors);
     }
 
     // in case of model averaging, do one more final aggregation of criteria
@@ -1302,6 +1839,52 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     return totalEpochSamples;
 }
 
+// -----------------------------------------------------------------------
+// LogBenchmarkResult() -- log the throughput and the time per phase of the minibatches timed by Benchmark()
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void SGD<ElemType>::LogBenchmarkResult(const MinibatchPhaseTimes& phaseTimes, size_t numMinibatches, size_t numSamples, double totalTime)
+{
+    auto logResult = [](const string& who, const MinibatchPhaseTimes& times, size_t numMinibatches, size_t numSamples, double totalTime)
+    {
+        if (numMinibatches == 0 || totalTime <= 0)
+        {
+            LOGPRINTF(stderr, "Benchmark%s: No minibatches were timed; the epoch ended during the warm-up.\n", who.c_str());
+            return;
+        }
+        LOGPRINTF(stderr, "Benchmark%s: %d minibatches, %d samples in %.3fs = %.1f samples per second\n",
+                  who.c_str(), (int) numMinibatches, (int) numSamples, totalTime, numSamples / totalTime);
+        // the rest of the time is spent on logging and house-keeping between the minibatches
+        double msPerMinibatch = 1000.0 / numMinibatches;
+        double other = totalTime - (times.read + times.transfer + times.forward + times.backward + times.aggregate + times.update);
+        LOGPRINTF(stderr, "Benchmark%s: ms per minibatch: read = %.3f; transfer = %.3f; forward = %.3f; backward = %.3f; aggregate = %.3f; update = %.3f; other = %.3f\n",
+                  who.c_str(), times.read * msPerMinibatch, times.transfer * msPerMinibatch, times.forward * msPerMinibatch, times.backward * msPerMinibatch,
+                  times.aggregate * msPerMinibatch, times.update * msPerMinibatch, other * msPerMinibatch);
+    };
+
+    if ((m_mpi == nullptr) || (m_mpi->NumNodesInUse() == 1))
+    {
+        logResult("", phaseTimes, numMinibatches, numSamples, totalTime);
+        return;
+    }
+
+    // each worker logs its own result, and the average over the workers, whose samples add up
+    size_t numWorkers = m_mpi->NumNodesInUse();
+    logResult(" (worker " + to_string(m_mpi->CurrentNodeRank() + 1) + " of " + to_string(numWorkers) + ")", phaseTimes, numMinibatches, numSamples, totalTime);
+    vector<double> sums = { phaseTimes.read, phaseTimes.transfer, phaseTimes.forward, phaseTimes.backward, phaseTimes.aggregate, phaseTimes.update,
+                            (double) numMinibatches, (double) numSamples, totalTime };
+    m_mpi->AllReduce(sums);
+    MinibatchPhaseTimes average;
+    average.read      = sums[0] / numWorkers;
+    average.transfer  = sums[1] / numWorkers;
+    average.forward   = sums[2] / numWorkers;
+    average.backward  = sums[3] / numWorkers;
+    average.aggregate = sums[4] / numWorkers;
+    average.update    = sums[5] / numWorkers;
+    logResult(" (all workers)", average, (size_t) (sums[6] / numWorkers + 0.5), (size_t) sums[7], sums[8] / numWorkers);
+}
+
 // -----------------------------------------------------------------------
 // subroutines and helpers follow below
 // -----------------------------------------------------------------------
@@ -1365,17 +1948,36 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         LOGPRINTF(stderr, "\t%ls = %ls()\n", node->NodeName().c_str(), node->OperationName().c_str());
     }
 
+    // reuse the values of an earlier run on the same data
+    // All workers must agree, since they compute together otherwise.
+    bool isParallel = m_mpi && m_mpi->NumNodesInUse() > 1;
+    int numWorkersLoadedCache = LoadPreComputeCache(nodes) ? 1 : 0;
+    if (isParallel)
+        m_mpi->AllReduce(&numWorkersLoadedCache, 1);
+    if (numWorkersLoadedCache == (isParallel ? (int) m_mpi->NumNodesInUse() : 1))
+    {
+        LOGPRINTF(stderr, "Precomputing --> Loaded from cache '%ls'.\n\n", m_preComputeCacheFile.c_str());
+        return true;
+    }
+
     // compute
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
 
+    // In parallel training, each worker accumulates over its share of the data, and the accumulators are summed over the workers at the end.
+    // Readers that cannot read their share themselves are decimated, like in training.
+    bool useParallelPreCompute = isParallel && (GetParallelizationMethod() != ParallelizationMethod::none);
+    bool useDistributedMBReading = useParallelPreCompute && m_enableDistributedMBReading && trainSetDataReader->SupportsDistributedMBRead();
+
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // To support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0);
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, m_epochSize);
+    // Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
+    size_t epochSize = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize;
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), epochSize);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, epochSize);
     net->StartEvaluateMinibatchLoop(nodes);
 
     // initialize
@@ -1385,7 +1987,7 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
     size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, useParallelPreCompute, *inputMatrices, actualMBSizeDummy, m_mpi))
     {
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
@@ -1396,16 +1998,92 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
     }
 
+    // combine the workers' accumulators
+    if (useParallelPreCompute)
+    {
+        for (auto & node : nodes)
+            dynamic_pointer_cast<IPreComputeNode>(node)->AggregateAccumulators([&](vector<double>& buffer) { m_mpi->AllReduce(buffer.data(), buffer.size()); });
+    }
+
     // finalize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
 
+    if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+        SavePreComputeCache(nodes);
+
     fprintf(stderr, "\n");
     LOGPRINTF(stderr, "Precomputing --> Completed.\n\n");
 
     return true;
 }
 
+// The cache of precomputed values holds the nodes as they are saved in a model, together with the key of the data they were computed from.
+template <class ElemType>
+wstring SGD<ElemType>::PreComputeCacheKey() const
+{
+    return m_preComputeCacheKey + (m_useAllDataForPreComputedNode ? L"" : L";epochSize=" + to_wstring(m_epochSize));
+}
+
+template <class ElemType>
+bool SGD<ElemType>::LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes) const
+{
+    if (m_preComputeCacheFile.empty() || m_preComputeCacheKey.empty() || !fexists(m_preComputeCacheFile))
+        return false;
+
+    File fstream(m_preComputeCacheFile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+    wstring key;
+    size_t numNodes;
+    fstream >> key >> numNodes;
+    if (key != PreComputeCacheKey() || numNodes != nodes.size())
+    {
+        LOGPRINTF(stderr, "Precomputing --> Cache '%ls' is for different data or nodes, ignored.\n", m_preComputeCacheFile.c_str());
+        return false;
+    }
+    for (auto & node : nodes)
+    {
+        wstring operationName, nodeName;
+        size_t dim;
+        fstream >> operationName >> nodeName >> dim;
+        if (operationName != node->OperationName() || nodeName != node->NodeName() || dim != node->GetSampleMatrixNumRows())
+        {
+            LOGPRINTF(stderr, "Precomputing --> Cache '%ls' is for different nodes, ignored.\n", m_preComputeCacheFile.c_str());
+            return false;
+        }
+        node->Load(fstream, CURRENT_CNTK_MODEL_VERSION);
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+    return true;
+}
+
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes) const
+{
+    if (m_preComputeCacheFile.empty())
+        return;
+    if (m_preComputeCacheKey.empty())
+    {
+        LOGPRINTF(stderr, "Precomputing --> Not cached, since the reader configuration cannot be identified.\n");
+        return;
+    }
+
+    // write to a temp file first, so that an interrupted run does not leave a broken cache
+    wstring tempFile = m_preComputeCacheFile + L".tmp";
+    {
+        File fstream(tempFile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+        fstream << PreComputeCacheKey() << (size_t) nodes.size();
+        for (auto & node : nodes)
+        {
+            fstream << node->OperationName() << node->NodeName() << node->GetSampleMatrixNumRows();
+            node->Save(fstream);
+        }
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+    }
+    renameOrDie(tempFile, m_preComputeCacheFile);
+}
+
 // return a reasonable initial learning rate based on the initial mbsize
 template <class ElemType>
 double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -1649,6 +2327,10 @@ size_t SGD<ElemType>::AdaptiveMinibatchSizing(ComputationNetworkPtr net,
             maxMinibatchSize = min(maxMinibatchSize, m_prevChosenMinibatchSize * 2);
         }
 
+        // nor beyond what fits into device memory
+        if (m_probedMinibatchSize > 0)
+            maxMinibatchSize = min(maxMinibatchSize, m_probedMinibatchSize);
+
         chosenMinibatchSize = SearchForBestMinibatchSize(net, refNet, refNode, epochNumber,
                                                          numFramesToUseInSearch, trainSetDataReader,
                                                          learnRatePerSample, featureNodes,
@@ -1767,14 +2449,185 @@ size_t SGD<ElemType>::SearchForBestMinibatchSize(ComputationNetworkPtr net,
     return lastTriedTrialMinibatchSize;
 }
 
-// run training over a small subset of an epoch, for purpose of automatic LR and MB-size tuning
+// ProbeMinibatchSizeForMemory() -- choose the largest minibatch size that fits into device memory
+// Trial mini-epochs of a few minibatches each are run with doubling minibatch sizes. Each trial measures the peak device
+// memory in use through the statistics of the caching GPU memory allocator. The probe stops before a size that the linear
+// growth of the peak predicts not to fit, so that it never runs out of memory. The result is interpolated between the
+// largest size that fits and the next one, and rounded down to a multiple of 64. The budget is the free device memory plus
+// what the allocator already holds, less m_memoryProbeHeadroom of it. Parallel workers agree on the size: they use the
+// largest peak and the smallest budget of all workers. Returns 0 if the probe cannot run.
 template <class ElemType>
-void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
-                                                    ComputationNetworkPtr refNet,
-                                                    const ComputationNodeBasePtr& refNode, const int epochNumber,
-                                                    const size_t epochSize, IDataReader* trainSetDataReader,
-                                                    const double learnRatePerSample,
-                                                    const size_t minibatchSize,
+size_t SGD<ElemType>::ProbeMinibatchSizeForMemory(ComputationNetworkPtr net,
+                                                  ComputationNetworkPtr refNet,
+                                                  const ComputationNodeBasePtr& refNode,
+                                                  const int epochNumber,
+                                                  IDataReader* trainSetDataReader,
+                                                  const double learnRatePerSample,
+                                                  const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                                  const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                                  const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                                  const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                                  StreamMinibatchInputs* inputMatrices,
+                                                  const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                                  std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    int deviceId = net->GetDeviceId();
+    if (deviceId < 0 || !TracingGPUMemoryAllocator::IsCachingEnabled() || m_truncated)
+    {
+        LOGPRINTF(stderr, "MemoryProbe: Skipped; it needs a GPU with the caching memory allocator, and does not apply to truncated BPTT.\n");
+        return 0;
+    }
+
+    // the combination of a value over all workers: all values are gathered by an all-reduce, each worker contributing its slot
+    auto combineOverWorkers = [&](size_t value, bool takeMax)
+    {
+        if (m_mpi == nullptr || m_mpi->NumNodesInUse() == 1)
+            return value;
+        vector<size_t> values(m_mpi->NumNodesInUse(), 0);
+        values[m_mpi->CurrentNodeRank()] = value;
+        m_mpi->AllReduce(values);
+        return takeMax ? *max_element(values.begin(), values.end()) : *min_element(values.begin(), values.end());
+    };
+
+    auto stats = TracingGPUMemoryAllocator::GetStatistics(deviceId);
+    size_t availableBytes = GPUWatcher::GetFreeMemoryOnCUDADevice(deviceId) + stats.bytesReserved;
+    size_t budget = combineOverWorkers((size_t) (availableBytes * (1.0 - m_memoryProbeHeadroom)), /*takeMax=*/false);
+    const size_t numBytesPerMB = 1 << 20;
+    LOGPRINTF(stderr, "MemoryProbe: Probing minibatch sizes against a budget of %d MB of device memory.\n", (int) (budget / numBytesPerMB));
+
+    // no subminibatches during the trials: they measure whole minibatches
+    size_t maxSamplesInRAM = m_maxSamplesInRAM;
+    size_t numSubminiBatches = m_numSubminiBatches;
+    m_maxSamplesInRAM = SIZE_MAX;
+    m_numSubminiBatches = 1;
+
+    size_t largestFit = 0, peakOfLargestFit = 0;
+    size_t smallestMisfit = SIZE_MAX;
+    size_t prevTrialSize = 0, prevPeak = 0;
+    double bytesPerSample = 0;
+    for (size_t trialSize = max(RoundToMultipleOf64((size_t) m_mbSize[epochNumber]), (size_t) 64); trialSize <= m_minibatchSizeTuningMax; trialSize *= 2)
+    {
+        // stop short of a size that is predicted not to fit
+        if (bytesPerSample > 0 && peakOfLargestFit + bytesPerSample * (trialSize - largestFit) > budget)
+        {
+            smallestMisfit = trialSize;
+            break;
+        }
+
+        std::vector<EpochCriterion> epochEvalErrors(evaluationNodes.size(), EpochCriterion::Infinity());
+        EpochCriterion epochCriterion(EpochCriterion::Infinity());
+        TracingGPUMemoryAllocator::ResetPeakStatistics(deviceId);
+        Timer timer;
+        timer.Start();
+        TrainOneMiniEpochAndReloadModel(net, refNet, refNode, epochNumber,
+                                        trialSize * m_memoryProbeMinibatches, trainSetDataReader,
+                                        learnRatePerSample, trialSize, featureNodes,
+                                        labelNodes, criterionNodes,
+                                        evaluationNodes, inputMatrices,
+                                        learnableNodes, smoothedGradients,
+                                        /*out*/ epochCriterion, /*out*/ epochEvalErrors,
+                                        "MemoryProbe:");
+        timer.Stop();
+        size_t peak = combineOverWorkers(TracingGPUMemoryAllocator::GetStatistics(deviceId).peakBytesInUse, /*takeMax=*/true);
+        LOGPRINTF(stderr, "MemoryProbe: minibatchSize = %d: peak device memory in use = %d MB, %.1f samples per second\n",
+                  (int) trialSize, (int) (peak / numBytesPerMB), epochCriterion.second / max(timer.ElapsedSeconds(), 1e-6));
+
+        if (peak > budget)
+        {
+            smallestMisfit = trialSize;
+            break;
+        }
+        largestFit = trialSize;
+        peakOfLargestFit = peak;
+        if (prevTrialSize > 0 && peak > prevPeak)
+            bytesPerSample = (double) (peak - prevPeak) / (trialSize - prevTrialSize);
+        prevTrialSize = trialSize;
+        prevPeak = peak;
+
+        // an epoch that is not larger than the trial ends it
+        if (epochCriterion.second < trialSize * m_memoryProbeMinibatches)
+            break;
+    }
+
+    m_maxSamplesInRAM = maxSamplesInRAM;
+    m_numSubminiBatches = numSubminiBatches;
+
+    if (largestFit == 0)
+    {
+        LOGPRINTF(stderr, "MemoryProbe: Even minibatchSize = %d does not fit into the budget; keeping the configured sizes.\n", (int) smallestMisfit);
+        return 0;
+    }
+
+    // between the largest size that fits and the first one that does not, the peak is assumed to grow linearly
+    size_t chosenSize = largestFit;
+    if (smallestMisfit != SIZE_MAX && bytesPerSample > 0)
+    {
+        size_t interpolatedSize = largestFit + (size_t) ((budget - peakOfLargestFit) / bytesPerSample);
+        chosenSize = max(largestFit, min(interpolatedSize, smallestMisfit - 64) / 64 * 64);
+    }
+    LOGPRINTF(stderr, "MemoryProbe: The largest minibatchSize that fits is %d.\n", (int) chosenSize);
+    return chosenSize;
+}
+
+// the state that a trial mini-epoch changes, copied aside in device memory so that the trial can be undone
+// (also used to restart an epoch in elastic training)
+// These are the values of all LearnableParameters (including running statistics that are not learned), the
+// smoothed gradients, and the minibatch counts of BatchNormalization nodes.
+template <class ElemType>
+class TrialSnapshot
+{
+public:
+    TrialSnapshot(const ComputationNetworkPtr& net, const std::list<Matrix<ElemType>>& smoothedGradients)
+    {
+        for (const auto& node : net->GetNodesWithType(OperationNameOf(LearnableParameter)))
+        {
+            auto parameter = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+            if (!parameter)
+                continue;
+            m_parameters.push_back(parameter);
+            m_parameterValues.push_back(parameter->Value().DeepClone());
+        }
+        for (const auto& smoothedGradient : smoothedGradients)
+            m_smoothedGradients.push_back(smoothedGradient.DeepClone());
+        for (const auto& node : net->GetNodesWithType(OperationNameOf(BatchNormalizationNode)))
+        {
+            auto batchNormalization = dynamic_pointer_cast<BatchNormalizationNode<ElemType>>(node);
+            if (batchNormalization)
+                m_batchNormalizations.push_back(make_pair(batchNormalization, batchNormalization->GetNumMinibatchesSeen()));
+        }
+    }
+
+    void Restore(std::list<Matrix<ElemType>>& smoothedGradients) const
+    {
+        for (size_t i = 0; i < m_parameters.size(); i++)
+        {
+            m_parameters[i]->Value().AssignValuesOf(m_parameterValues[i]);
+            m_parameters[i]->BumpEvalTimeStamp();
+        }
+        auto savedIter = m_smoothedGradients.begin();
+        for (auto& smoothedGradient : smoothedGradients)
+            smoothedGradient.AssignValuesOf(*savedIter++);
+        for (const auto& batchNormalization : m_batchNormalizations)
+            batchNormalization.first->SetNumMinibatchesSeen(batchNormalization.second);
+    }
+
+private:
+    std::vector<shared_ptr<ComputationNode<ElemType>>> m_parameters;
+    std::vector<Matrix<ElemType>> m_parameterValues;
+    std::list<Matrix<ElemType>> m_smoothedGradients;
+    std::vector<std::pair<shared_ptr<BatchNormalizationNode<ElemType>>, size_t>> m_batchNormalizations;
+};
+
+// run training over a small subset of an epoch, for purpose of automatic LR and MB-size tuning
+// The model and smoothed gradients are restored afterwards from a copy in device memory, rather than reread from the
+// checkpoint of the previous epoch; the searches start each trial from the state at entry, which is that checkpoint.
+template <class ElemType>
+void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
+                                                    ComputationNetworkPtr refNet,
+                                                    const ComputationNodeBasePtr& refNode, const int epochNumber,
+                                                    const size_t epochSize, IDataReader* trainSetDataReader,
+                                                    const double learnRatePerSample,
+                                                    const size_t minibatchSize,
                                                     const std::vector<ComputationNodeBasePtr>& featureNodes,
                                                     const std::vector<ComputationNodeBasePtr>& labelNodes,
                                                     const std::vector<ComputationNodeBasePtr>& criterionNodes,
@@ -1786,6 +2639,8 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
                                                     /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
                                                     std::string prefixMsg)
 {
+    TrialSnapshot<ElemType> snapshot(net, smoothedGradients);
+
     TrainOneEpoch(net, refNet, refNode, epochNumber, epochSize,
                   trainSetDataReader, learnRatePerSample, minibatchSize, featureNodes,
                   labelNodes, criterionNodes, evaluationNodes,
@@ -1800,19 +2655,7 @@ void SGD<ElemType>::TrainOneMiniEpochAndReloadModel(ComputationNetworkPtr net,
     fprintf(stderr, "learningRatePerSample = %.8g\n", learnRatePerSample);
 
     // go back to where we came from
-    int baseModelEpoch = epochNumber - 1;
-    net->RereadPersistableParameters<ElemType>(GetModelNameForEpoch(baseModelEpoch));
-
-    double dummyLearnRate;
-    double dummyPrevCriterion;
-    size_t dummyTotalTrainingSamplesSeen; // (not used)
-    size_t dummyMinibatchSize;
-    LoadCheckPointInfo(baseModelEpoch,
-                       /*out*/ dummyTotalTrainingSamplesSeen,
-                       /*out*/ dummyLearnRate,
-                       smoothedGradients,
-                       /*out*/ dummyPrevCriterion,
-                       /*out*/ dummyMinibatchSize);
+    snapshot.Restore(smoothedGradients);
 }
 
 // Attemps to compute the error signal for the whole utterance, which will
@@ -1852,17 +2695,39 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int traceLevel)
 {
     if (GetParallelizationMethod() == ParallelizationMethod::dataParallelSGD)
     {
-        if (m_distGradAgg == nullptr)
+        if ((m_distGradAgg == nullptr) && (m_gradientSparsity > 0))
+        {
+            m_distGradAgg = std::make_shared<SparseDistGradAggregator<ElemType>>(m_mpi, m_gradientSparsity, m_syncStatsTrace);
+        }
+        else if ((m_distGradAgg == nullptr) && m_shardOptimizerState)
+        {
+            // reduces each gradient to the worker that owns the parameter
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, m_syncStatsTrace, 0 /*overlapBucketSize*/, m_useCudaAwareMPI,
+                                                                                 8 * sizeof(ElemType), m_zeroThresholdFor1Bit, m_gradientCommunicationFormat, m_initialLossScale);
+        }
+        else if ((m_distGradAgg == nullptr) && (m_gradientCommunicationFormat != Float16Format::none))
+        {
+            // converts the gradients to 16 bits in the host buffers that they are staged through, and sums them in 16 bits
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, m_overlappedGradientAggregationBucketSize, false /*useCudaAwareMPI*/,
+                                                                                 8 * sizeof(ElemType), m_zeroThresholdFor1Bit, m_gradientCommunicationFormat, m_initialLossScale);
+        }
+        else if ((m_distGradAgg == nullptr) && (m_numGradientBits != (8 * sizeof(ElemType))) && (m_overlappedGradientAggregationBucketSize > 0))
+        {
+            // quantizes each bucket as soon as its gradients are computed, and exchanges it while backprop continues
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, false /*useAsyncAggregation*/, m_syncStatsTrace, m_overlappedGradientAggregationBucketSize, false /*useCudaAwareMPI*/,
+                                                                                 m_numGradientBits, m_zeroThresholdFor1Bit);
+        }
+        else if (m_distGradAgg == nullptr)
         {
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
             m_distGradAgg = std::make_shared<AllReduceDistGradAggregator<ElemType>>(m_mpi, m_numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
             if (m_numGradientBits != (8 * sizeof(ElemType)))
             {
-                RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
+                RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support, unless overlapGradientAggregation is enabled!");
             }
 
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, m_syncStatsTrace, m_overlappedGradientAggregationBucketSize, m_useCudaAwareMPI);
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
         }
 
@@ -1882,7 +2747,11 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
     {
         return; // no need to do anything if already initialized. TODO: make it singleton 
     }
-    if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
+    if ((GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD) && m_overlapModelAveraging)
+    {
+        m_pMASGDHelper = make_shared<OverlappedModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
+    }
+    else if (GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD)
     {
         m_pMASGDHelper = make_shared<BasicModelAveragingSGD<ElemType>>(m_mpi, traceLevel, devID);
     }
@@ -1897,6 +2766,10 @@ void SGD<ElemType>::InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE de
                                                                  m_modelAggregationBlockSize);
 #endif 
     }
+    else if (GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD)
+    {
+        m_pMASGDHelper = make_shared<AsyncParameterServerSGD<ElemType>>(m_mpi, traceLevel, devID, m_maxStaleness);
+    }
 }
 // public:
 // UpdateWeightsS - static version of UpdateWeights()
@@ -1927,57 +2800,98 @@ template <class ElemType>
     // make actualMBSize is a valid value
     assert(actualMBSize > 0);
 
-    // clipping gradients to prevent outliers
-    sgd->ClipGradient(gradientValues, actualMBSize);
-
     GradientsUpdateType adpType = sgd->GradUpdateType();
     double noiseStd = sgd->GradientUpdateNoiseStd();
-    Matrix<ElemType> sgdUpdateNoise((DEVICEID_TYPE) functionValues.GetDeviceId());
-    if (noiseStd > 0)
-    {
-        // get the gradient structure since gradient is sparse
-        sgdUpdateNoise.SetValue(gradientValues);
-
-        // reset its value to random
-        sgdUpdateNoise.SetGaussianRandomValue(0, (ElemType) noiseStd);
-    }
 
-    // L2 regularizer
-    if (L2RegWeight > 0)
+    // Adam and LAMB: the second moment estimate decays per sample like the momentum does, which makes the bias corrections 1 / (1 - beta^t)
+    // depend on the number of samples seen by all updates so far, including this one
+    double varianceMomentumPerSample = sgd->m_adamInfo.varianceTimeConstant > 0 ? exp(-1.0 / sgd->m_adamInfo.varianceTimeConstant) : 0.0;
+    double varianceMomentum = MomentumPerMB(varianceMomentumPerSample, actualMBSize);
+    double numSamplesSeen = (double) (sgd->m_numSamplesSeenByUpdates + actualMBSize);
+    auto biasCorrection = [numSamplesSeen](double betaPerSample) { return betaPerSample < 1 ? 1.0 / (1.0 - pow(betaPerSample, numSamplesSeen)) : 1.0; };
+    double momentumCorrection = biasCorrection(momentumPerSample);
+    double varianceCorrection = biasCorrection(varianceMomentumPerSample);
+
+    // Dense elementwise updates read gradient, smoothed gradient and weights once, with clipping by truncation and L2 folded in.
+    bool isElementwiseUpdate = (adpType == GradientsUpdateType::None) || ((adpType == GradientsUpdateType::AdaGrad) && !needAveMultiplier) || (adpType == GradientsUpdateType::Adam);
+    bool isElementwiseClipping = sgd->m_gradientClippingWithTruncation || (sgd->m_clippingThresholdPerSample == std::numeric_limits<double>::infinity()) ||
+                                 sgd->m_gradientClippingByGlobalNorm; // (done already)
+    if (isElementwiseUpdate && isElementwiseClipping && (noiseStd == 0) && (gradientValues.GetMatrixType() == DENSE))
     {
-        // multiply by actualMBSize so that it's invariant to minibatch size since learning rate is per sample
-        Matrix<ElemType>::ScaleAndAdd((ElemType)(L2RegWeight * actualMBSize), functionValues, gradientValues);
-    }
-
-    if (adpType == GradientsUpdateType::None)
-    {
-        smoothedGradient.NormalGrad(gradientValues, functionValues,
-                                    (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
+        // both multiplied by actualMBSize since learning rate is per sample, see ClipGradient() and the L2 regularizer below
+        ElemType clipThreshold = sgd->m_gradientClippingByGlobalNorm ? std::numeric_limits<ElemType>::infinity() : (ElemType)(sgd->m_clippingThresholdPerSample * actualMBSize);
+        ElemType l2RegWeight = (ElemType)(L2RegWeight > 0 ? L2RegWeight * actualMBSize : 0);
+        if (adpType == GradientsUpdateType::None)
+            smoothedGradient.FusedNormalGrad(gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum, clipThreshold, l2RegWeight);
+        else if (adpType == GradientsUpdateType::AdaGrad)
+            smoothedGradient.FusedAdagrad(gradientValues, functionValues, (ElemType) learnRatePerSample, clipThreshold, l2RegWeight);
+        else
+            smoothedGradient.Adam(gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum, (ElemType) varianceMomentum, (ElemType) sgd->m_adamInfo.epsilon,
+                                  (ElemType) momentumCorrection, (ElemType) varianceCorrection, clipThreshold, l2RegWeight, /*layerwiseScaling=*/false);
     }
-    else if (adpType == GradientsUpdateType::AdaGrad ||
-             (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+    else
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
+        // clipping gradients to prevent outliers
+        sgd->ClipGradient(gradientValues, actualMBSize);
 
-        double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
-        Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
-    }
-    else if (adpType == GradientsUpdateType::FSAdaGrad)
-    {
-        smoothedGradient.FSAdagrad(actualMBSize, gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum);
-    }
-    else if (adpType == GradientsUpdateType::RmsProp)
-    {
-        double aveMultiplier = smoothedGradient.RmsProp(gradientValues, (ElemType) sgd->m_rpi.gamma,
-                                                        (ElemType) sgd->m_rpi.inc, (ElemType) sgd->m_rpi.max,
-                                                        (ElemType) sgd->m_rpi.dec, (ElemType) sgd->m_rpi.min, needAveMultiplier);
-        Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
-    }
+        Matrix<ElemType> sgdUpdateNoise((DEVICEID_TYPE) functionValues.GetDeviceId());
+        if (noiseStd > 0)
+        {
+            // get the gradient structure since gradient is sparse
+            sgdUpdateNoise.SetValue(gradientValues);
 
-    if (noiseStd > 0)
-    {
-        Matrix<ElemType>::ScaleAndAdd(1.0, sgdUpdateNoise, functionValues);
+            // reset its value to random
+            sgdUpdateNoise.SetGaussianRandomValue(0, (ElemType) noiseStd);
+        }
+
+        // L2 regularizer
+        if (L2RegWeight > 0)
+        {
+            // multiply by actualMBSize so that it's invariant to minibatch size since learning rate is per sample
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(L2RegWeight * actualMBSize), functionValues, gradientValues);
+        }
+
+        if (adpType == GradientsUpdateType::None)
+        {
+            smoothedGradient.NormalGrad(gradientValues, functionValues,
+                                        (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
+        }
+        else if (adpType == GradientsUpdateType::AdaGrad ||
+                 (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
+                 (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE && gradientValues.GetFormat() != matrixFormatSparseBlockCol))
+        {
+            // rmsprop for sparse is not implemented yet, delegate it with adagrad
+
+            double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
+        }
+        else if (adpType == GradientsUpdateType::FSAdaGrad)
+        {
+            smoothedGradient.FSAdagrad(actualMBSize, gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum);
+        }
+        else if (adpType == GradientsUpdateType::RmsProp)
+        {
+            double aveMultiplier = smoothedGradient.RmsProp(gradientValues, (ElemType) sgd->m_rpi.gamma,
+                                                            (ElemType) sgd->m_rpi.inc, (ElemType) sgd->m_rpi.max,
+                                                            (ElemType) sgd->m_rpi.dec, (ElemType) sgd->m_rpi.min, needAveMultiplier);
+            Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
+        }
+        else if (adpType == GradientsUpdateType::Adam || adpType == GradientsUpdateType::Lamb)
+        {
+            // (clipping and L2 are already applied)
+            smoothedGradient.Adam(gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum, (ElemType) varianceMomentum, (ElemType) sgd->m_adamInfo.epsilon,
+                                  (ElemType) momentumCorrection, (ElemType) varianceCorrection, std::numeric_limits<ElemType>::infinity(), /*l2RegWeight=*/0,
+                                  /*layerwiseScaling=*/adpType == GradientsUpdateType::Lamb);
+        }
+        else if (adpType == GradientsUpdateType::Lars)
+        {
+            smoothedGradient.Lars(gradientValues, functionValues, (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum, sgd->m_adamInfo.trustCoefficient);
+        }
+
+        if (noiseStd > 0)
+        {
+            Matrix<ElemType>::ScaleAndAdd(1.0, sgdUpdateNoise, functionValues);
+        }
     }
 
     // L1 regularizer with proximal gradient descent method
@@ -2019,10 +2933,26 @@ void SGD<ElemType>::UpdateWeights(const ComputationNodeBasePtr& node,
     node->BumpEvalTimeStamp();
 }
 
+// The arena update treats all fused parameters as a single matrix, so this is only possible where the update is elementwise
+// and  the same for all of them: plain or AdaGrad-scaled SGD without a per-matrix multiplier, no per-matrix norm clipping,
+// and the default learning-rate multiplier.
+template <class ElemType>
+bool SGD<ElemType>::CanFuseParameterUpdate(const ComputationNodeBasePtr& node) const
+{
+    bool isElementwiseUpdate = (GradUpdateType() == GradientsUpdateType::None) ||
+                               ((GradUpdateType() == GradientsUpdateType::AdaGrad) && !m_needAveMultiplier);
+    bool isElementwiseClipping = m_gradientClippingWithTruncation || (m_clippingThresholdPerSample == std::numeric_limits<double>::infinity()) ||
+                                 m_gradientClippingByGlobalNorm;
+    auto paramNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+    return isElementwiseUpdate && isElementwiseClipping &&
+           paramNode && node->IsParameterUpdateRequired() && (node->GetLearningRateMultiplier() == 1.0) &&
+           (paramNode->Value().GetMatrixType() == DENSE);
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
-    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity())
+    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity() && !m_gradientClippingByGlobalNorm)
     {
         double maxGradientPerMB = m_clippingThresholdPerSample * actualMBSize;
         if (m_gradientClippingWithTruncation)
@@ -2040,24 +2970,282 @@ void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actual
     }
 }
 
+// clip the norm of all gradients together, before any of them is used for an update
+// The norm is computed and applied on the device, see TensorView::ClipByGlobalNorm().
+template <class ElemType>
+void SGD<ElemType>::ClipGradientsByGlobalNorm(const std::list<ComputationNodeBasePtr>& learnableNodes, const size_t actualMBSize)
+{
+    vector<shared_ptr<Matrix<ElemType>>> gradients;
+    for (const auto& node : learnableNodes)
+    {
+        if (node->IsParameterUpdateRequired())
+            gradients.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->GradientPtrRef());
+    }
+    if (gradients.empty())
+        return;
+
+    if (!m_globalNormWorkspace)
+        m_globalNormWorkspace = make_shared<Matrix<ElemType>>(1, 1, gradients.front()->GetDeviceId());
+    TensorView<ElemType>::ClipByGlobalNorm(gradients, (ElemType)(m_clippingThresholdPerSample * actualMBSize), m_globalNormWorkspace);
+}
+
+// Sharded optimizer state: each parameter that is updated is owned by one worker, which alone receives its aggregated
+// gradient, keeps its smoothed gradient and updates it. Largest parameters first, each goes to the worker with the fewest
+// elements so far; all workers compute the same assignment.
+template <class ElemType>
+void SGD<ElemType>::AssignParameterOwners(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    vector<ComputationNodeBasePtr> nodes(learnableNodes.begin(), learnableNodes.end());
+    vector<size_t> order;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i]->IsParameterUpdateRequired())
+            order.push_back(i);
+    }
+    stable_sort(order.begin(), order.end(), [&nodes](size_t a, size_t b)
+    {
+        return nodes[a]->GetSampleLayout().GetNumElements() > nodes[b]->GetSampleLayout().GetNumElements();
+    });
+
+    vector<size_t> numElementsOfWorker(m_mpi->NumNodesInUse(), 0);
+    m_parameterOwners.assign(nodes.size(), -1);
+    for (size_t i : order)
+    {
+        size_t owner = min_element(numElementsOfWorker.begin(), numElementsOfWorker.end()) - numElementsOfWorker.begin();
+        m_parameterOwners[i] = (int) owner;
+        numElementsOfWorker[owner] += nodes[i]->GetSampleLayout().GetNumElements();
+    }
+    LOGPRINTF(stderr, "SGD: Sharded optimizer state: this worker updates %.0f of the parameters.\n", (double) numElementsOfWorker[m_mpi->CurrentNodeRank()]);
+}
+
+template <class ElemType>
+bool SGD<ElemType>::OwnsParameter(size_t i) const
+{
+    return m_parameterOwners.empty() || (m_parameterOwners[i] < 0) || (m_parameterOwners[i] == (int) m_mpi->CurrentNodeRank());
+}
+
+template <class ElemType>
+bool SGD<ElemType>::IsParameterOwnedByMainNode(size_t i) const
+{
+    return m_parameterOwners.empty() || (m_parameterOwners[i] < 0) || (m_parameterOwners[i] == (int) m_mpi->MainNodeRank());
+}
+
+// after an update, each worker sends the parameters it owns to the other workers
+template <class ElemType>
+void SGD<ElemType>::BroadcastUpdatedParameters(const std::list<ComputationNodeBasePtr>& learnableNodes)
+{
+    size_t i = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+    {
+        if (m_parameterOwners[i] < 0)
+            continue;
+        Matrix<ElemType>& value = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value();
+        m_shardTransferBuffer.resize(value.GetNumElements());
+        if (OwnsParameter(i))
+            value.CopySection(value.GetNumRows(), value.GetNumCols(), m_shardTransferBuffer.data(), value.GetNumRows());
+        m_mpi->Bcast(m_shardTransferBuffer.data(), m_shardTransferBuffer.size(), m_parameterOwners[i]);
+        if (!OwnsParameter(i))
+        {
+            value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), m_shardTransferBuffer.data());
+            (*nodeIter)->BumpEvalTimeStamp();
+        }
+    }
+}
+
+// The checkpoint holds all smoothed gradients. The main node receives those that the other workers own into
+// m_receivedSmoothedGradients, in CPU memory, for SaveCheckPointInfo(). Must be called on all workers.
+template <class ElemType>
+void SGD<ElemType>::ReceiveShardedSmoothedGradients(const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    m_receivedSmoothedGradients.clear();
+    size_t i = 0;
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, i++)
+    {
+        if (IsParameterOwnedByMainNode(i))
+            continue;
+        // the dimensions depend on the optimizer, so they are sent along; MPIWrapper has no point-to-point operations
+        size_t owner = m_parameterOwners[i];
+        size_t dims[2] = { smoothedGradientIter->GetNumRows(), smoothedGradientIter->GetNumCols() };
+        m_mpi->Bcast(dims, 2, owner);
+        m_shardTransferBuffer.resize(dims[0] * dims[1]);
+        if (owner == m_mpi->CurrentNodeRank())
+            smoothedGradientIter->CopySection(dims[0], dims[1], m_shardTransferBuffer.data(), dims[0]);
+        m_mpi->Bcast(m_shardTransferBuffer.data(), m_shardTransferBuffer.size(), owner);
+        if (m_mpi->IsMainNode())
+        {
+            m_receivedSmoothedGradients.push_back(Matrix<ElemType>(CPUDEVICE));
+            m_receivedSmoothedGradients.back().SetValue(dims[0], dims[1], CPUDEVICE, m_shardTransferBuffer.data());
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// distributed startup
+// -----------------------------------------------------------------------
+
+// The values that make up a model: those of the dense parameters and of the precomputed nodes, in the order of the node
+// names, which is the same on all workers.
+template <class ElemType>
+static vector<shared_ptr<ComputationNode<ElemType>>> GetModelValueNodes(const ComputationNetworkPtr& net)
+{
+    vector<shared_ptr<ComputationNode<ElemType>>> nodes;
+    for (const auto& node : net->GetAllNodes()) // (sorted by name)
+    {
+        auto valueNode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        if (!valueNode)
+            continue;
+        bool isParameter = (node->OperationName() == OperationNameOf(LearnableParameter)) && (valueNode->Value().GetMatrixType() == DENSE);
+        if (isParameter || dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node))
+            nodes.push_back(valueNode);
+    }
+    return nodes;
+}
+
+// FNV-1a, continuing 'hash'
+static uint64_t HashBytes(const void* data, size_t numBytes, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < numBytes; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// The main worker sends the values of its model to the other workers, in one packed buffer, rather than one broadcast
+// per parameter. Precomputed nodes that the main worker has computed are marked computed. Returns false, and sends
+// nothing, if the structures of the networks differ. Must be called on all workers.
+template <class ElemType>
+bool SGD<ElemType>::BroadcastInitialModel(const ComputationNetworkPtr& net)
+{
+    auto nodes = GetModelValueNodes<ElemType>(net);
+
+    // the structure: names and dimensions; one mismatch anywhere leaves all models as they are
+    vector<size_t> dims; // [rows, cols] of each node
+    uint64_t structureHash = HashBytes(nullptr, 0);
+    for (const auto& node : nodes)
+    {
+        size_t rows = node->GetSampleLayout().GetNumElements(), cols = 1; // (precomputed values are column vectors)
+        if (node->OperationName() == OperationNameOf(LearnableParameter))
+        {
+            rows = node->Value().GetNumRows();
+            cols = node->Value().GetNumCols();
+        }
+        dims.push_back(rows);
+        dims.push_back(cols);
+        structureHash = HashBytes(node->NodeName().data(), node->NodeName().size() * sizeof(wchar_t), structureHash);
+    }
+    structureHash = HashBytes(dims.data(), dims.size() * sizeof(size_t), structureHash);
+    size_t mainStructureHash = (size_t) structureHash;
+    m_mpi->Bcast(&mainStructureHash, 1, m_mpi->MainNodeRank());
+    int numMismatches = (mainStructureHash != (size_t) structureHash) ? 1 : 0;
+    m_mpi->AllReduce(&numMismatches, 1);
+    if (numMismatches > 0)
+    {
+        LOGPRINTF(stderr, "BroadcastInitialModel: The networks of %d workers differ from the main worker's. Each worker keeps its own model.\n", numMismatches);
+        return false;
+    }
+
+    // which precomputed values the main worker has
+    vector<int> hasValue(nodes.size(), 1);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        auto preComputeNode = dynamic_pointer_cast<IPreComputeNode>(nodes[i]);
+        if (preComputeNode && !preComputeNode->HasComputed())
+            hasValue[i] = 0;
+    }
+    m_mpi->Bcast(hasValue.data(), hasValue.size(), m_mpi->MainNodeRank());
+
+    size_t numElements = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+        numElements += hasValue[i] ? dims[2 * i] * dims[2 * i + 1] : 0;
+    vector<ElemType> buffer(numElements);
+    if (m_mpi->IsMainNode())
+    {
+        ElemType* dst = buffer.data();
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            if (!hasValue[i])
+                continue;
+            nodes[i]->Value().CopySection(dims[2 * i], dims[2 * i + 1], dst, dims[2 * i]);
+            dst += dims[2 * i] * dims[2 * i + 1];
+        }
+    }
+
+    // in chunks, which keep the counts within the range of MPI's and let MPI pipeline its broadcast tree
+    const size_t chunkSize = 1 << 24;
+    for (size_t begin = 0; begin < numElements; begin += chunkSize)
+        m_mpi->Bcast(buffer.data() + begin, min(chunkSize, numElements - begin), m_mpi->MainNodeRank());
+
+    if (!m_mpi->IsMainNode())
+    {
+        ElemType* src = buffer.data();
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            if (!hasValue[i])
+                continue;
+            nodes[i]->Value().SetValue(dims[2 * i], dims[2 * i + 1], nodes[i]->GetDeviceId(), src);
+            nodes[i]->BumpEvalTimeStamp();
+            auto preComputeNode = dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(nodes[i]);
+            if (preComputeNode)
+                preComputeNode->m_hasComputed = true; // (as if loaded from the file)
+            src += dims[2 * i] * dims[2 * i + 1];
+        }
+    }
+    LOGPRINTF(stderr, "BroadcastInitialModel: %s the values of %d nodes (%.0f elements) %s.\n", m_mpi->IsMainNode() ? "Sent" : "Received",
+              (int) nodes.size(), (double) numElements, m_mpi->IsMainNode() ? "to the other workers" : "from the main worker");
+    return true;
+}
+
+// Compares a checksum of the model of each worker with the main worker's. A mismatch after BroadcastInitialModel() is an
+// error; otherwise the workers started from different models on purpose or by accident, which is reported.
+// Must be called on all workers.
+template <class ElemType>
+void SGD<ElemType>::VerifyInitialModel(const ComputationNetworkPtr& net, bool wasBroadcast)
+{
+    uint64_t hash = HashBytes(nullptr, 0);
+    vector<ElemType> values;
+    for (const auto& node : GetModelValueNodes<ElemType>(net))
+    {
+        const auto& value = node->Value();
+        auto preComputeNode = dynamic_pointer_cast<IPreComputeNode>(node);
+        if (preComputeNode && !preComputeNode->HasComputed())
+            continue;
+        values.resize(value.GetNumElements());
+        value.CopySection(value.GetNumRows(), value.GetNumCols(), values.data(), value.GetNumRows());
+        hash = HashBytes(node->NodeName().data(), node->NodeName().size() * sizeof(wchar_t), hash);
+        hash = HashBytes(values.data(), values.size() * sizeof(ElemType), hash);
+    }
+    size_t mainHash = (size_t) hash;
+    m_mpi->Bcast(&mainHash, 1, m_mpi->MainNodeRank());
+    int numMismatches = (mainHash != (size_t) hash) ? 1 : 0;
+    m_mpi->AllReduce(&numMismatches, 1);
+    if (numMismatches == 0)
+        LOGPRINTF(stderr, "VerifyInitialModel: All %d workers start from the same model.\n", (int) m_mpi->NumNodesInUse());
+    else if (wasBroadcast)
+        RuntimeError("VerifyInitialModel: The models of %d workers differ from the main worker's after the broadcast.", numMismatches);
+    else
+        LOGPRINTF(stderr, "VerifyInitialModel: WARNING: The initial models of %d workers differ from the main worker's.\n", numMismatches);
+}
+
 template <class ElemType>
 void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen,
                                        const double learnRatePerSample,
                                        const std::list<Matrix<ElemType>>& smoothedGradients,
                                        const double prevCriterion,
-                                       const size_t minibatchSize)
+                                       const size_t minibatchSize,
+                                       const MidEpochPosition* position)
 {
     // In case of parallel training only the main node should we saving the checkpoint to prevent
     // the parallel training nodes from colliding to write the same file
     if ((m_mpi == nullptr) || m_mpi->IsMainNode())
     {
-        wstring checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
-        // Saving into temporary file and then renaming it to the checkPointFileName
-        // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
-        wstring tempFileName = checkPointFileName + L".tmp";
+        wstring checkPointFileName = position ? GetMidEpochModelName(int(epoch)) + L".ckp" : GetCheckPointFileNameForEpoch(int(epoch));
 
+        auto write = [&](const wstring& fileName)
         {
-            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite | FileOptions::fileOptionsSequential | FileOptions::fileOptionsDirect);
             fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
             fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
@@ -2071,26 +3259,121 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
             fstream << minibatchSize;
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
-
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+            if (position)
             {
-                const Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-                fstream << smoothedGradient;
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BEpochPosition");
+                fstream << position->numMinibatches << position->numSamples;
+                fstream << position->criterion.first << position->criterion.second;
+                fstream << position->evalErrors.size();
+                for (const auto& evalError : position->evalErrors)
+                    fstream << evalError.first << evalError.second;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EEpochPosition");
             }
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+            // with a sharded optimizer state, those of the other workers were received by ReceiveShardedSmoothedGradients()
+            vector<const Matrix<ElemType>*> gradientsToSave;
+            auto receivedIter = m_receivedSmoothedGradients.begin();
+            size_t parameterIndex = 0;
+            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, parameterIndex++)
+                gradientsToSave.push_back(IsParameterOwnedByMainNode(parameterIndex) ? &*smoothedGradientIter : &*receivedIter++);
+
+            if (m_compressCheckpoints)
+            {
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCompressedGradient");
+                WriteCompressedMatrices(fstream, gradientsToSave);
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECompressedGradient");
+            }
+            else
+            {
+                fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+                for (auto smoothedGradient : gradientsToSave)
+                    fstream << *smoothedGradient;
+                fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+            }
 
             fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
             if (m_pMASGDHelper)
                 m_pMASGDHelper->SaveToCheckPoint(fstream);
             // Ensuring that data is written
             fstream.Flush();
+        };
+
+        if (m_checkpointWriter)
+            m_checkpointWriter->Write(checkPointFileName, write);
+        else
+        {
+            // Saving into temporary file and then renaming it to the checkPointFileName
+            // This is a standard trick to avoid havign corrupted checkpoints files if process dies during writing
+            wstring tempFileName = checkPointFileName + L".tmp";
+            write(tempFileName);
+            _wunlink(checkPointFileName.c_str());
+            renameOrDie(tempFileName, checkPointFileName);
         }
+    }
+}
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+template <class ElemType>
+void SGD<ElemType>::SaveCheckPointModel(const ComputationNetworkPtr& net, const wstring& modelName)
+{
+    if (!m_checkpointWriter)
+    {
+        net->Save(modelName);
+        return;
     }
+    // the model is saved to the staging directory; its parameter archive is deleted next to modelName once the model is there
+    m_checkpointWriter->Write(modelName, [&](const wstring& fileName) { net->Save(fileName); });
+    m_checkpointWriter->Delete(ParameterArchive::GetPath(modelName));
+}
+
+template <class ElemType>
+void SGD<ElemType>::DeleteCheckPointFile(const wstring& fileName)
+{
+    if (m_checkpointWriter)
+        m_checkpointWriter->Delete(fileName);
+    else
+        _wunlink(fileName.c_str());
+}
+
+// wait until the main node's checkpoints have reached m_modelPath, before they are read
+template <class ElemType>
+void SGD<ElemType>::WaitForCheckPoints()
+{
+    if (m_checkpointWriter)
+        m_checkpointWriter->WaitAll();
+}
+
+template <class ElemType>
+void SGD<ElemType>::SaveMidEpochCheckPoint(const ComputationNetworkPtr& net, const size_t epoch, const size_t totalSamplesSeen,
+                                           const double learnRatePerSample,
+                                           const std::list<Matrix<ElemType>>& smoothedGradients,
+                                           const double prevCriterion,
+                                           const size_t minibatchSize,
+                                           const MidEpochPosition& position)
+{
+    auto modelName = GetMidEpochModelName(int(epoch));
+    LOGPRINTF(stderr, "SGD: Saving mid-epoch checkpoint '%ls' after %d minibatches (%d samples) of epoch %d\n",
+              modelName.c_str(), (int) position.numMinibatches, (int) position.numSamples, (int) epoch + 1);
+    // the previous checkpoint info is deleted first, so that if we die in between, the new model is not resumed at the previous position
+    DeleteCheckPointFile(modelName + L".ckp");
+    SaveCheckPointModel(net, modelName);
+    SaveCheckPointInfo(epoch, totalSamplesSeen, learnRatePerSample, smoothedGradients, prevCriterion, minibatchSize, &position);
+}
+
+// a mid-epoch checkpoint is only valid if it is newer than the model its epoch started from
+template <class ElemType>
+bool SGD<ElemType>::HasMidEpochCheckPoint(const int epoch)
+{
+    auto modelName = GetMidEpochModelName(epoch);
+    return fexists(modelName) && msra::files::fuptodate(modelName + L".ckp", GetModelNameForEpoch(epoch - 1), /*inputrequired=*/false);
+}
+
+template <class ElemType>
+void SGD<ElemType>::DeleteMidEpochCheckPoint(const int epoch)
+{
+    auto modelName = GetMidEpochModelName(epoch);
+    DeleteCheckPointFile(modelName);
+    DeleteCheckPointFile(ParameterArchive::GetPath(modelName));
+    DeleteCheckPointFile(modelName + L".ckp");
 }
 
 template <class ElemType>
@@ -2127,11 +3410,12 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
                                        /*out*/ double& learnRatePerSample,
                                        std::list<Matrix<ElemType>>& smoothedGradients,
                                        /*out*/ double& prevCriterion,
-                                       /*out*/ size_t& minibatchSize)
+                                       /*out*/ size_t& minibatchSize,
+                                       /*out*/ MidEpochPosition* position)
 {
-    let checkPointFileName = GetCheckPointFileNameForEpoch(int(epochNumber));
+    let checkPointFileName = position ? GetMidEpochModelName(int(epochNumber)) + L".ckp" : GetCheckPointFileNameForEpoch(int(epochNumber));
     File fstream(checkPointFileName,
-                 FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+                 FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead | FileOptions::fileOptionsSequential);
 
     // version info 
     size_t ckpVersion = CNTK_CHECKPOINT_VERSION_1; // if no version info is found -> version 1
@@ -2157,14 +3441,42 @@ void SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
         minibatchSize = m_mbSize[epochNumber];
     }
 
-    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    if (position)
+    {
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BEpochPosition");
+        fstream >> position->numMinibatches >> position->numSamples;
+        fstream >> position->criterion.first >> position->criterion.second;
+        size_t numEvalErrors;
+        fstream >> numEvalErrors;
+        position->evalErrors.resize(numEvalErrors);
+        for (auto& evalError : position->evalErrors)
+            fstream >> evalError.first >> evalError.second;
+        fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EEpochPosition");
+    }
+
+    // compressed regardless of m_compressCheckpoints, if the checkpoint was written so
+    bool isCompressed = (ckpVersion >= CNTK_CHECKPOINT_VERSION_3) && fstream.TryGetMarker(FileMarker::fileMarkerBeginSection, L"BCompressedGradient");
+    if (isCompressed)
+    {
+        vector<Matrix<ElemType>*> gradientsToLoad;
+        for (auto& smoothedGradient : smoothedGradients)
+            gradientsToLoad.push_back(&smoothedGradient);
+        ReadCompressedMatrices(fstream, gradientsToLoad);
+    }
+    else
+        fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+    size_t parameterIndex = 0;
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, parameterIndex++)
     {
         Matrix<ElemType>& smoothedGradient = *smoothedGradientIter;
-        fstream >> smoothedGradient;
+        if (!isCompressed)
+            fstream >> smoothedGradient;
+        // with a sharded optimizer state, the worker that owns the parameter keeps it
+        if (!OwnsParameter(parameterIndex))
+            smoothedGradient = Matrix<ElemType>(smoothedGradient.GetDeviceId());
     }
-    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, isCompressed ? L"ECompressedGradient" : L"EGradient");
 
     fstream.GetMarker(FileMarker::fileMarkerEndSection, L"ECKP");
 
@@ -2182,6 +3494,12 @@ wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetMidEpochModelName(const int epoch)
+{
+    return GetModelNameForEpoch(epoch) + L".partial";
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2263,7 +3581,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             LOGPRINTF(stderr, "###### d%ls######\n", node->NodeName().c_str());
 
             double eOrg = node->Value()(irow, icol);
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
 
@@ -2280,13 +3598,13 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             // TODO: why is this value not used?
             criterionNodes[npos]->Get00Element();
             double eGradErr = node->Gradient()(irow, icol);
-            node->Gradient().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Gradient().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             double ePos = eOrg + EPSILON;
             double eNeg = eOrg - EPSILON;
 
             node->Value()(irow, icol) = (ElemType) ePos;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
             net->ForwardProp(criterionNodes[npos]);
@@ -2295,7 +3613,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
             double mbEvalCriPos = criterionNodes[npos]->Get00Element(); // TODO: make Get00Element() a function of ComputationNodeBase
 
             node->Value()(irow, icol) = (ElemType) eNeg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             node->BumpEvalTimeStamp();
             net->ForwardProp(criterionNodes[npos]);
@@ -2305,7 +3623,7 @@ bool SGD<ElemType>::GradientCheck(ComputationNetworkPtr net,
 
             // back to its original parameter value
             node->Value()(irow, icol) = (ElemType) eOrg;
-            node->Value().TransferToDeviceIfNotThere(net->GetDeviceId(), true);
+            node->Value().TransferToDeviceIfNotThere(node->GetDeviceId(), true);
 
             // check if they are consistent
             double eGradNum = ((mbEvalCriPos - mbEvalCriNeg) / (ePos - eNeg));
@@ -2354,15 +3672,27 @@ static AdaptationRegType ParseAdaptationRegType(const wstring& s)
         InvalidArgument("ParseAdaptationRegType: Invalid Adaptation Regularization Type. Valid values are (none | kl)");
 }
 
+static MemoryProbeTarget ParseMemoryProbeTarget(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"none")) return MemoryProbeTarget::None;
+    else if (EqualCI(s, L"minibatchSize"))           return MemoryProbeTarget::MinibatchSize;
+    else if (EqualCI(s, L"maxSamplesInRAM"))         return MemoryProbeTarget::MaxSamplesInRAM;
+    else
+        InvalidArgument("ParseMemoryProbeTarget: Invalid memory probe target. Valid values are (none | minibatchSize | maxSamplesInRAM)");
+}
+
 static GradientsUpdateType ParseGradUpdateType(const wstring& s)
 {
     if      (EqualCI(s, L"") || EqualCI(s, L"none")) return GradientsUpdateType::None;
     else if (EqualCI(s, L"adagrad"))                 return GradientsUpdateType::AdaGrad;
     else if (EqualCI(s, L"rmsProp"))                 return GradientsUpdateType::RmsProp;
     else if (EqualCI(s, L"fsAdagrad"))               return GradientsUpdateType::FSAdaGrad;
+    else if (EqualCI(s, L"adam"))                    return GradientsUpdateType::Adam;
+    else if (EqualCI(s, L"lamb"))                    return GradientsUpdateType::Lamb;
+    else if (EqualCI(s, L"lars"))                    return GradientsUpdateType::Lars;
     // legacy, deprecated
     else if (EqualCI(s, L"normal") || EqualCI(s, L"simple")) return GradientsUpdateType::None;
-    else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad )");
+    else InvalidArgument("ParseGradUpdateType: Invalid Gradient Updating Type. Valid values are (none | adagrad | rmsProp | fsAdagrad | adam | lamb | lars )");
 }
 
 static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
@@ -2371,7 +3701,17 @@ static ParallelizationMethod ParseParallelizationMethod(const wstring& s)
     else if (EqualCI(s, L"DataParallelSGD"))         return ParallelizationMethod::dataParallelSGD;
     else if (EqualCI(s, L"ModelAveragingSGD"))       return ParallelizationMethod::modelAveragingSGD;
     else if (EqualCI(s, L"BlockMomentumSGD"))        return ParallelizationMethod::blockMomentumSGD;
-    else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | DataParallelSGD | ModelAveragingSGD | BlockMomentumSGD)");
+    else if (EqualCI(s, L"ParameterServerSGD"))      return ParallelizationMethod::parameterServerSGD;
+    else if (EqualCI(s, L"ModelParallelSGD"))        return ParallelizationMethod::modelParallelSGD;
+    else InvalidArgument("ParseParallelizationMethod: Invalid Parallelization Method. Valid values are (none | DataParallelSGD | ModelAveragingSGD | BlockMomentumSGD | ParameterServerSGD | ModelParallelSGD)");
+}
+
+static Float16Format ParseGradientCommunicationFormat(const wstring& s)
+{
+    if      (EqualCI(s, L"") || EqualCI(s, L"none")) return Float16Format::none;
+    else if (EqualCI(s, L"fp16"))                    return Float16Format::float16;
+    else if (EqualCI(s, L"bf16"))                    return Float16Format::bfloat16;
+    else InvalidArgument("ParseGradientCommunicationFormat: Invalid gradient communication format. Valid values are (none | fp16 | bf16)");
 }
 
 static LearningRateSearchAlgorithm ParseLearningRateSearchType(const wstring& s)
@@ -2430,6 +3770,11 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
 
+    m_memoryProbe = ParseMemoryProbeTarget(configSGD(L"memoryProbe", L"none"));
+    m_memoryProbeHeadroom = configSGD(L"memoryProbeHeadroom", 0.1);
+    m_memoryProbeMinibatches = configSGD(L"memoryProbeMinibatches", (size_t) 3);
+    m_memoryTelemetry = configSGD(L"memoryTelemetry", false);
+
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     m_epochSize = configSGD(L"epochSize", (size_t) 0);
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
@@ -2456,9 +3801,18 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t)10);
     m_firstMBsToShowResult = configSGD(L"firstMBsToShowResult", (size_t)0);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t)0);
+    m_numMBsToProfileNodes = configSGD(L"numMBsToProfileNodes", (size_t)0);
+    m_nodeProfileTraceFile = (const wstring&) configSGD(L"nodeProfileTraceFile", L"");
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
+    m_gradientClippingByGlobalNorm = configSGD(L"gradientClippingByGlobalNorm", false);
+    if (m_gradientClippingByGlobalNorm)
+    {
+        if (m_clippingThresholdPerSample == numeric_limits<double>::infinity())
+            InvalidArgument("gradientClippingByGlobalNorm requires clippingThresholdPerSample.");
+        m_gradientClippingWithTruncation = false;
+    }
 
     // sequence-training parameters
     m_hSmoothingWeight = configSGD(L"hSmoothingWeight", 0.95);
@@ -2486,9 +3840,31 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_rpi.max = configSGD(L"rms_wgt_max", 10.0);
     m_rpi.gamma = configSGD(L"rms_gamma", 0.99);
 
+    // Adam, LAMB and LARS parameters
+    m_adamInfo.varianceTimeConstant = configSGD(L"adamVarianceTimeConstant", m_adamInfo.varianceTimeConstant);
+    m_adamInfo.epsilon = configSGD(L"adamEpsilon", m_adamInfo.epsilon);
+    m_adamInfo.trustCoefficient = configSGD(L"larsTrustCoefficient", m_adamInfo.trustCoefficient);
+
     m_needAveMultiplier = configSGD(L"normWithAveMultiplier", true);
     m_L2RegWeight = configSGD(L"L2RegWeight", 0.0);
     m_L1RegWeight = configSGD(L"L1RegWeight", 0.0);
+    m_useGradientArena = configSGD(L"useGradientArena", false);
+    m_offloadOptimizerState = configSGD(L"offloadOptimizerState", false);
+    if (m_offloadOptimizerState && m_useGradientArena)
+        InvalidArgument("offloadOptimizerState cannot be combined with useGradientArena, which keeps the smoothed gradients in its own arena.");
+
+    // single-process multi-GPU data parallelism: the GPUs next to 'deviceId' that get a part of each minibatch
+    if (configSGD.Exists(L"localDataParallelDevices"))
+    {
+        intargvector localDevices = configSGD(L"localDataParallelDevices", ConfigRecordType::Array(intargvector(vector<int>{1})));
+        for (size_t i = 0; i < localDevices.size(); i++)
+            m_localReplicaDevices.push_back((DEVICEID_TYPE) localDevices[i]);
+    }
+
+    // lock-free multi-threaded training on the CPU: the number of threads that train on parts of each minibatch
+    m_hogwildThreads = configSGD(L"hogwildThreads", (size_t) 1);
+    if (m_hogwildThreads == 0)
+        InvalidArgument("hogwildThreads must be at least 1.");
 
     // for backward support. future setup should use gradUpdateType=AdaGrad, instead of
     // useAdagrad=true
@@ -2512,6 +3888,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_preComputeCacheFile = (const wstring&) configSGD(L"preComputeCacheFile", L"");
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -2616,9 +3993,19 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = 32;
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_overlappedGradientAggregationBucketSize = 0;
+    m_useCudaAwareMPI = false;
+    m_gradientSparsity = 0;
+    m_elasticTraining = false;
+    m_shardOptimizerState = false;
+    m_gradientCommunicationFormat = Float16Format::none;
+    m_initialLossScale = 65536;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
+    m_broadcastInitialModel = true;
     m_modelAggregationBlockSize = 0; 
+    m_maxStaleness = 0;
+    m_overlapModelAveraging = false;
 
     if (configSGD.Exists(L"ParallelTrain"))
     {
@@ -2637,6 +4024,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_parallelizationStartEpochNum = configParallelTrain(L"parallelizationStartEpoch", (int)1) - 1; // Epoch numbers internally are 0 based
             m_enableDistributedMBReading = configParallelTrain(L"distributedMBReading", false);
             m_syncStatsTrace = configParallelTrain(L"syncPerfStats", (int)0);
+            m_broadcastInitialModel = configParallelTrain(L"broadcastInitialModel", true);
 
             if (configParallelTrain.Exists(L"DataParallelSGD"))
             {
@@ -2645,10 +4033,66 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 m_numGradientBits = configDataParallelSGD(L"gradientBits", defaultGradientBits);
                 m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
                 m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+                if (m_bufferedAsyncGradientAggregation && m_useGradientArena)
+                    InvalidArgument("useGradientArena cannot be combined with useBufferedAsyncGradientAggregation.");
+                if (configDataParallelSGD(L"overlapGradientAggregation", false))
+                {
+                    if (m_bufferedAsyncGradientAggregation)
+                        InvalidArgument("overlapGradientAggregation cannot be combined with useBufferedAsyncGradientAggregation.");
+                    double bucketSizeInMB = configDataParallelSGD(L"gradientAggregationBucketSizeInMB", 25.0);
+                    if (bucketSizeInMB <= 0)
+                        InvalidArgument("gradientAggregationBucketSizeInMB must be positive.");
+                    m_overlappedGradientAggregationBucketSize = (size_t)(bucketSizeInMB * 1024 * 1024);
+                }
+                if (configDataParallelSGD(L"useCudaAwareMPI", false))
+                {
+                    m_useCudaAwareMPI = MPIWrapper::IsCudaAware(true);
+                    if (!m_useCudaAwareMPI)
+                        fprintf(stderr, "WARNING: useCudaAwareMPI is ignored since the MPI library reports no CUDA support.\n");
+                }
+                m_gradientSparsity = configDataParallelSGD(L"gradientSparsity", 0.0);
+                if (m_gradientSparsity != 0)
+                {
+                    if (!(m_gradientSparsity > 0) || !(m_gradientSparsity < 1))
+                        InvalidArgument("gradientSparsity must be in the range (0, 1), or 0 to exchange dense gradients.");
+                    if (m_bufferedAsyncGradientAggregation || (m_overlappedGradientAggregationBucketSize > 0) || (m_numGradientBits != (8 * sizeofElemType)))
+                        InvalidArgument("gradientSparsity cannot be combined with useBufferedAsyncGradientAggregation, overlapGradientAggregation, or gradientBits.");
+                }
+                // continue with the surviving workers when one is lost
+                m_elasticTraining = configDataParallelSGD(L"elastic", false);
+                if (m_elasticTraining)
+                {
+                    if (!MPIWrapper::SupportsElasticity())
+                        InvalidArgument("elastic training needs an MPI library with the ULFM fault-tolerance extensions.");
+                    if (m_bufferedAsyncGradientAggregation)
+                        InvalidArgument("elastic training cannot be combined with useBufferedAsyncGradientAggregation.");
+                }
                 if ( m_numGradientBits < 1 || m_numGradientBits > (8 * sizeofElemType) )
                 {
                     InvalidArgument("gradientBits must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double!");
                 }
+                // sum the dense gradients as fp16 (with dynamic loss scaling) or bf16 values, at half the communication volume
+                m_gradientCommunicationFormat = ParseGradientCommunicationFormat(configDataParallelSGD(L"gradientCommunicationFormat", L"none"));
+                m_initialLossScale = configDataParallelSGD(L"initialLossScale", 65536.0f);
+                if (m_gradientCommunicationFormat != Float16Format::none)
+                {
+                    if ((m_numGradientBits != (8 * sizeofElemType)) || m_useCudaAwareMPI || (m_gradientSparsity > 0))
+                        InvalidArgument("gradientCommunicationFormat cannot be combined with gradientBits, useCudaAwareMPI, or gradientSparsity.");
+                    if (!(m_initialLossScale > 0))
+                        InvalidArgument("initialLossScale must be positive.");
+                }
+                // each worker updates a part of the parameters, whose gradients are reduced to it, and broadcasts them
+                m_shardOptimizerState = configDataParallelSGD(L"shardOptimizerState", false);
+                if (m_shardOptimizerState)
+                {
+                    if (m_bufferedAsyncGradientAggregation || (m_overlappedGradientAggregationBucketSize > 0) || (m_gradientSparsity > 0) ||
+                        (m_numGradientBits != (8 * sizeofElemType)) || m_elasticTraining)
+                        InvalidArgument("shardOptimizerState cannot be combined with useBufferedAsyncGradientAggregation, overlapGradientAggregation, gradientSparsity, gradientBits, or elastic.");
+                    if (m_useGradientArena || m_gradientClippingByGlobalNorm)
+                        InvalidArgument("shardOptimizerState cannot be combined with useGradientArena or gradientClippingByGlobalNorm, which need all gradients on each worker.");
+                    if (m_parallelizationStartEpochNum != 0)
+                        InvalidArgument("shardOptimizerState requires parallelizationStartEpoch=1.");
+                }
             }
             if (configParallelTrain.Exists(L"ModelAveragingSGD"))
             {
@@ -2690,6 +4134,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                     fprintf(stderr, "WARNING: option syncPeroid in ModelAveragingSGD is going to be deprecated. Please use blockSizePerWorker instead in the future.\n");
                 }
 #endif
+                m_overlapModelAveraging = configMASGD(L"overlapCommunication", false);
             }
             if (configParallelTrain.Exists(L"BlockMomentumSGD"))
             {
@@ -2754,6 +4199,39 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
                 InitializeAndCheckBlockMomentumSGDParameters();
                 
             }
+            if (configParallelTrain.Exists(L"ParameterServerSGD"))
+            {
+                const ConfigRecordType& configPSSGD(configParallelTrain(L"ParameterServerSGD", ConfigRecordType::Record()));
+                m_modelAggregationBlockSize = configPSSGD(L"blockSizePerWorker", (size_t)10000);
+                m_modelAggregationBlockSize *= numMPIWorkers;
+                m_maxStaleness = configPSSGD(L"maxStaleness", (size_t)4);
+            }
+            // pipeline model parallelism, alone (parallelizationMethod=ModelParallelSGD) or within each group of data-parallel workers
+            if (configParallelTrain.Exists(L"ModelParallelSGD") || m_parallelizationMethod == ParallelizationMethod::modelParallelSGD)
+            {
+                const ConfigRecordType& configMPSGD(configParallelTrain(L"ModelParallelSGD", ConfigRecordType::Record()));
+                if (!configMPSGD.Exists(L"stageDevices"))
+                    InvalidArgument("ModelParallelSGD needs the GPUs of the pipeline stages in 'stageDevices'.");
+                intargvector stageDevices = configMPSGD(L"stageDevices", ConfigRecordType::Array(intargvector(vector<int>{0})));
+                if (stageDevices.size() < 2)
+                    InvalidArgument("ModelParallelSGD needs at least two pipeline stages.");
+                // worker k uses its own set of devices: stageDevices + k * numStages
+                for (size_t i = 0; i < stageDevices.size(); i++)
+                    m_pipelineStageDevices.push_back((DEVICEID_TYPE) (stageDevices[i] + pMPI->CurrentNodeRank() * stageDevices.size()));
+                // the minibatch runs through the stages in micro-batches (one after the other), whose gradients are accumulated
+                m_numSubminiBatches = configMPSGD(L"numMicroBatches", m_numSubminiBatches);
+
+                let dataParallelizationMethod = (ParallelizationMethod) ((int) m_parallelizationMethod & 0xff);
+                if (dataParallelizationMethod != ParallelizationMethod::none && dataParallelizationMethod != ParallelizationMethod::dataParallelSGD)
+                    InvalidArgument("ModelParallelSGD can only be combined with DataParallelSGD.");
+                if (dataParallelizationMethod == ParallelizationMethod::none && numMPIWorkers > 1)
+                    InvalidArgument("ModelParallelSGD with several workers needs parallelizationMethod=DataParallelSGD.");
+                if (m_bufferedAsyncGradientAggregation || m_overlappedGradientAggregationBucketSize > 0 || m_useCudaAwareMPI)
+                    InvalidArgument("ModelParallelSGD cannot be combined with useBufferedAsyncGradientAggregation, overlapGradientAggregation, or useCudaAwareMPI.");
+                if (m_useGradientArena || m_gradientClippingByGlobalNorm)
+                    InvalidArgument("ModelParallelSGD cannot be combined with useGradientArena or gradientClippingByGlobalNorm, which keep all gradients on one device.");
+                m_parallelizationMethod = (ParallelizationMethod) ((int) dataParallelizationMethod | (int) ParallelizationMethod::modelParallelSGD);
+            }
         } // if (!pMPI)
     } // if (configSGD.Exists(L"ParallelTrain"))
 }
@@ -10,6 +10,13 @@
 #include "DataReader.h"
 #include "ScriptableObjects.h"
 #include "Criterion.h"
+#include "ParameterArena.h"
+#include "LocalReplicas.h"
+#include "HogwildWorkers.h"
+#include "OptimizerStateOffload.h"
+#include "MemoryTelemetry.h"
+#include "CheckpointWriter.h"
+#include "Float16.h"
 #include <vector>
 #include <string>
 #include <stdexcept>
@@ -24,7 +31,8 @@ using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
 #define CNTK_CHECKPOINT_VERSION_2 2     
-#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_2
+#define CNTK_CHECKPOINT_VERSION_3 3     // smoothed gradients optionally compressed (compressCheckpoints)
+#define CURRENT_CNTK_CHECKPOINT_VERSION CNTK_CHECKPOINT_VERSION_3
 
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -47,11 +55,22 @@ enum class GradientsUpdateType : int
     None,
     AdaGrad,
     RmsProp,
-    FSAdaGrad
+    FSAdaGrad,
+    Adam,
+    Lamb, // Adam with layer-wise adaptive scaling of the step
+    Lars  // momentum SGD with layer-wise adaptive scaling of the learning rate
 };
 
-// modelParallelSGD can be combined with dataParallelSGD/modelAveragingSGD/blockMomentumSGD 
-// but dataParallelSGD/modelAveragingSGD/blockMomentumSGD are mutually exclusive (at least at the moment)
+// what the startup memory probe sets, see SGD::ProbeMinibatchSizeForMemory()
+enum class MemoryProbeTarget : int
+{
+    None,
+    MinibatchSize,  // the minibatch size of all epochs
+    MaxSamplesInRAM // the largest subminibatch; larger minibatches accumulate the gradients of several subminibatches
+};
+
+// modelParallelSGD can be combined with dataParallelSGD/modelAveragingSGD/blockMomentumSGD/parameterServerSGD 
+// but dataParallelSGD/modelAveragingSGD/blockMomentumSGD/parameterServerSGD are mutually exclusive (at least at the moment)
 // we assign the lower 8 bits to the enumerate data parallelization methods 
 // and next 8 bits to model parallelization methods
 enum class ParallelizationMethod : int
@@ -60,7 +79,8 @@ enum class ParallelizationMethod : int
     dataParallelSGD = 1,
     modelAveragingSGD = 2,
     blockMomentumSGD = 3,
-    modelParallelSGD = (1 << 8) // Currently unsupported
+    parameterServerSGD = 4,
+    modelParallelSGD = (1 << 8) // pipeline stages on several GPUs, see ComputationNetwork::PlaceInPipelineStages(); combines with dataParallelSGD only
 };
 
 // configuration parameters associated with RMSProp learning algorithm
@@ -82,6 +102,21 @@ struct RMSPropInfo
     }
 };
 
+// configuration parameters associated with the Adam, LAMB and LARS learning algorithms
+struct AdamInfo
+{
+    double varianceTimeConstant; // in samples, the time constant of the second moment estimate; the first one uses the momentum
+    double epsilon;
+    double trustCoefficient;     // LARS only
+
+    AdamInfo()
+    {
+        varianceTimeConstant = 2 * 3600 * 100;
+        epsilon = 1e-8;
+        trustCoefficient = 0.001;
+    }
+};
+
 struct GradientUpdateInfo
 {
     GradientsUpdateType mType;
@@ -153,12 +188,18 @@ protected:
         return pow(m_momentumParam[epoch], 1.0 / FixUpEffectiveMBSize(m_momentumSpecifiedForMBSize[epoch], numParallelSequences));
     }
 
+    // the data parallelization method (the model parallelization bits are masked, see UseModelParallelSGD())
     ParallelizationMethod GetParallelizationMethod() const
     {
         if (m_mpi == nullptr)
             return ParallelizationMethod::none;
 
-        return m_parallelizationMethod;
+        return (ParallelizationMethod) ((int) m_parallelizationMethod & 0xff);
+    }
+
+    bool UseModelParallelSGD() const
+    {
+        return m_mpi != nullptr && ((int) m_parallelizationMethod & (int) ParallelizationMethod::modelParallelSGD) != 0;
     }
 
     // helper function to initialize and check BlockMomentumSGD related parameters
@@ -186,6 +227,13 @@ protected:
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
 
+    MemoryProbeTarget m_memoryProbe;
+    double m_memoryProbeHeadroom;    // fraction of the device memory the probed minibatch size leaves unused
+    size_t m_memoryProbeMinibatches; // minibatches trained per probed size
+
+    // log the device memory by category with each progress line, and its peaks per epoch (see MemoryTelemetry.h)
+    bool m_memoryTelemetry;
+
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
     size_t m_maxComputedEpochSize;
@@ -195,6 +243,7 @@ protected:
 
     bool m_gradientClippingWithTruncation;
     double m_clippingThresholdPerSample;
+    bool m_gradientClippingByGlobalNorm; // clip the norm of all gradients together instead of each one's
 
     intargvector m_numMiniBatch4LRSearch;
     size_t m_numBestSearchEpoch;
@@ -236,10 +285,13 @@ protected:
 
     GradientUpdateInfo m_gradType;
     RMSPropInfo m_rpi;
+    AdamInfo m_adamInfo;
 
     size_t m_numMBsToShowResult = 0;
     size_t m_firstMBsToShowResult = 0;
     int m_numMBsToCUDAProfile;
+    size_t m_numMBsToProfileNodes;  // per-node time and memory profile, see NodeProfiler
+    std::wstring m_nodeProfileTraceFile; // Chrome trace of that profile; none if empty
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
@@ -247,6 +299,8 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    std::wstring m_preComputeCacheFile; // precomputed values, reused by later runs on the same data; none if empty
+    std::wstring m_preComputeCacheKey;  // identifies the data, see SGD::SetPreComputeCacheKey()
 
     int m_perfTraceLevel;
 
@@ -256,6 +310,7 @@ protected:
     ParallelizationMethod m_parallelizationMethod;
     bool m_enableDistributedMBReading;
     int m_parallelizationStartEpochNum;
+    bool m_broadcastInitialModel; // the main worker loads or creates the model and sends it to the others, see BroadcastInitialModel()
 
     // decide if/how often we measure and show sync performance stats (seconds spend on sync, seconds since last sync etc.) ?
     // 0: No sync perfomance stats
@@ -267,6 +322,13 @@ protected:
     int m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
     bool m_zeroThresholdFor1Bit;
+    size_t m_overlappedGradientAggregationBucketSize; // in bytes; 0 = aggregate after backprop
+    bool m_useCudaAwareMPI;                           // hand GPU gradients to MPI without staging them in host memory
+    double m_gradientSparsity;                        // fraction of the gradient elements exchanged per minibatch; 0 = dense aggregation
+    bool m_elasticTraining;                           // on the loss of a worker, restart the epoch with the surviving ones rather than abort
+    bool m_shardOptimizerState;                       // each worker updates, and keeps the smoothed gradients of, a part of the parameters
+    Float16Format m_gradientCommunicationFormat;      // exchange the dense gradients as fp16 or bf16 values
+    float m_initialLossScale;                         // with fp16: initial factor of the gradients before the conversion
 
     // Parallel training related with MA / BM
     size_t m_modelAggregationBlockSize;
@@ -274,11 +336,28 @@ protected:
     bool   m_useNesterovBlockMomentum;
     double m_blockLearningRate; 
     double m_blockMomentumAsTimeConstant;
+    size_t m_maxStaleness; // ParameterServerSGD: max. number of sync points a worker may be ahead of the slowest one
+    bool m_overlapModelAveraging; // ModelAveragingSGD: average in the background while training continues, see OverlappedModelAveragingSGD
+
+    // Model parallel SGD: the devices of the pipeline stages of this worker
+    std::vector<DEVICEID_TYPE> m_pipelineStageDevices;
 
     bool m_needAveMultiplier;
     double m_L2RegWeight;
     double m_L1RegWeight;
 
+    // keep parameters, gradients and smoothed gradients in one contiguous arena each (see ParameterArena.h)
+    bool m_useGradientArena;
+
+    // keep the smoothed gradients in host memory and update the parameters there (see OptimizerStateOffload.h)
+    bool m_offloadOptimizerState;
+
+    // GPUs of this process that train replicas of the network on parts of each minibatch (see LocalReplicas.h)
+    std::vector<DEVICEID_TYPE> m_localReplicaDevices;
+
+    // threads that train on parts of each minibatch on the CPU, updating the shared parameters without locks (see HogwildWorkers.h); 1 = off
+    size_t m_hogwildThreads;
+
     // sequence training
     double m_hSmoothingWeight;
     double m_frameDropThresh;
@@ -306,6 +385,37 @@ protected:
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
     typedef ClassBasedCrossEntropyWithSoftmaxNode<ElemType>* ClassBasedCrossEntropyWithSoftmaxNodePtr;
 
+    // how far into its epoch a mid-epoch checkpoint was taken
+    struct MidEpochPosition
+    {
+        size_t numMinibatches = 0; // minibatches of the epoch that are in the model; the reader skips these on resume
+        size_t numSamples = 0;     // samples of the epoch that are in the model, over all workers
+        EpochCriterion criterion;  // accumulated so far
+        std::vector<EpochCriterion> evalErrors;
+    };
+
+    // seconds spent per phase of the minibatches, see perfTraceLevel and Benchmark()
+    struct MinibatchPhaseTimes
+    {
+        double read = 0;      // in the reader, until the minibatch is handed to the network
+        double transfer = 0;  // waiting for the upload of the minibatch to the device
+        double forward = 0;
+        double backward = 0;
+        double aggregate = 0; // gradient or model aggregation across workers
+        double update = 0;    // parameter update
+
+        MinibatchPhaseTimes& operator+=(const MinibatchPhaseTimes& other)
+        {
+            read += other.read;
+            transfer += other.transfer;
+            forward += other.forward;
+            backward += other.backward;
+            aggregate += other.aggregate;
+            update += other.update;
+            return *this;
+        }
+    };
+
 public:
     // constructor from old CNTK config. This is a function template that is also used to get the config from Scripting.
     template <class ConfigRecordType>
@@ -314,12 +424,19 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          m_checkpointStagingDir((const wstring&) configSGD(L"checkpointStagingDir", L"")),
+          m_maxPendingCheckpointFiles(configSGD(L"maxPendingCheckpointFiles", (size_t) 2)),
+          m_checkpointEverySamples(configSGD(L"checkpointEverySamples", (size_t) 0)),
+          m_checkpointEveryMinutes(configSGD(L"checkpointEveryMinutes", 0.0)),
+          m_compressCheckpoints(configSGD(L"compressCheckpoints", false)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesCategory(configSGD(L"traceNodeNamesCategory", ConfigRecordType::Array(stringargvector()))),
           m_traceNodeNamesSparse  (configSGD(L"traceNodeNamesSparse",   ConfigRecordType::Array(stringargvector()))),
           m_prevChosenMinibatchSize(0),
+          m_probedMinibatchSize(0),
+          m_numSamplesSeenByUpdates(0),
           m_lastFinishedEpochTrainLoss(0.0),
           m_distGradAgg(nullptr),
           m_gradHeader(nullptr)
@@ -342,6 +459,12 @@ public:
             m_parallelizationMethod = ParallelizationMethod::none;
     }
 
+    // identifies the training data for the cache of precomputed values (config 'preComputeCacheFile'); no caching if empty
+    void SetPreComputeCacheKey(const std::wstring& key)
+    {
+        m_preComputeCacheKey = key;
+    }
+
     void Train(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
                IDataReader* trainSetDataReader,
                IDataReader* validationSetDataReader,
@@ -351,6 +474,14 @@ public:
                IDataReader* validationSetDataReader,
                const DEVICEID_TYPE deviceID, const bool makeMode = true);
 
+    // Trains a new network for numMinibatches minibatches after numWarmupMinibatches, and reports the throughput and
+    // the time spent in each phase of the minibatches. Nothing is validated or saved. With syntheticData, the first
+    // minibatch is trained over and over, which leaves the reader and the upload out of the measurement.
+    // The device is synchronized at the end of each phase, which disables any overlap between them.
+    void Benchmark(function<ComputationNetworkPtr(DEVICEID_TYPE)> createNetworkFn, DEVICEID_TYPE deviceId,
+                   IDataReader* trainSetDataReader,
+                   size_t numMinibatches, size_t numWarmupMinibatches, bool syntheticData);
+
 protected:
 
     const std::vector<ComputationNodeBasePtr>& GetTrainCriterionNodes(ComputationNetworkPtr net);
@@ -371,6 +502,9 @@ protected:
                     const std::vector<ComputationNodeBasePtr>& featureNodes,
                     const std::vector<ComputationNodeBasePtr>& labelNodes,
                     StreamMinibatchInputs* inputMatrices);
+    bool LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes) const;
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes) const;
+    std::wstring PreComputeCacheKey() const;
 
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -440,6 +574,21 @@ protected:
                                       std::list<Matrix<ElemType>>& smoothedGradients,
                                       const size_t minMinibatchSize, const size_t maxMinibatchSize);
 
+    // returns the largest minibatch size whose peak device memory fits, found by training a few minibatches of growing size
+    size_t ProbeMinibatchSizeForMemory(ComputationNetworkPtr net,
+                                       ComputationNetworkPtr refNet,
+                                       const ComputationNodeBasePtr& refNode,
+                                       const int epochNumber,
+                                       IDataReader* trainSetDataReader,
+                                       const double learnRatePerSample,
+                                       const std::vector<ComputationNodeBasePtr>& featureNodes,
+                                       const std::vector<ComputationNodeBasePtr>& labelNodes,
+                                       const std::vector<ComputationNodeBasePtr>& criterionNodes,
+                                       const std::vector<ComputationNodeBasePtr>& evaluationNodes,
+                                       StreamMinibatchInputs* inputMatrices,
+                                       const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                       std::list<Matrix<ElemType>>& smoothedGradients);
+
     // Attemps to compute the error signal for the whole utterance, which will
     // be fed to the neural network as features. Currently it is a workaround
     // for the two-forward-pass sequence and ctc training, which allows
@@ -467,7 +616,11 @@ protected:
                          std::list<Matrix<ElemType>>& smoothedGradients,
                          /*out*/ EpochCriterion& epochCriterion,
                          /*out*/ std::vector<EpochCriterion>& epochEvalErrors,
-                         const std::string& prefixMsg = "");
+                         const std::string& prefixMsg = "",
+                         const MidEpochPosition* resumePosition = nullptr,
+                         const std::function<void(const MidEpochPosition&)>& saveMidEpochCheckPoint = nullptr);
+
+    void LogBenchmarkResult(const MinibatchPhaseTimes& phaseTimes, size_t numMinibatches, size_t numSamples, double totalTime);
 
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
     void InitModelAggregationHandler(int traceLevel, DEVICEID_TYPE devID);
@@ -496,12 +649,40 @@ protected:
                        const bool useNesterovMomentum) const;
 
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
+    void ClipGradientsByGlobalNorm(const std::list<ComputationNodeBasePtr>& learnableNodes, const size_t actualMBSize);
+
+    // sharded optimizer state (DataParallelSGD/shardOptimizerState), see m_parameterOwners
+    void AssignParameterOwners(const std::list<ComputationNodeBasePtr>& learnableNodes);
+    bool OwnsParameter(size_t i) const;
+    bool IsParameterOwnedByMainNode(size_t i) const;
+    void BroadcastUpdatedParameters(const std::list<ComputationNodeBasePtr>& learnableNodes);
+    void ReceiveShardedSmoothedGradients(const std::list<Matrix<ElemType>>& smoothedGradients);
+
+    // distributed startup
+    bool BroadcastInitialModel(const ComputationNetworkPtr& net);
+    void VerifyInitialModel(const ComputationNetworkPtr& net, bool wasBroadcast);
 
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
                             const double prevCriterion,
-                            const size_t minibatchSize);
+                            const size_t minibatchSize,
+                            const MidEpochPosition* position = nullptr);
+
+    // epoch checkpoints go through m_checkpointWriter if there is one
+    void SaveCheckPointModel(const ComputationNetworkPtr& net, const std::wstring& modelName);
+    void DeleteCheckPointFile(const std::wstring& fileName);
+    void WaitForCheckPoints();
+
+    // a mid-epoch checkpoint: the model and checkpoint info, the latter with the position in the epoch
+    void SaveMidEpochCheckPoint(const ComputationNetworkPtr& net, const size_t epoch, const size_t totalSamplesSeen,
+                                const double learnRatePerSample,
+                                const std::list<Matrix<ElemType>>& smoothedGradients,
+                                const double prevCriterion,
+                                const size_t minibatchSize,
+                                const MidEpochPosition& position);
+    bool HasMidEpochCheckPoint(const int epoch);
+    void DeleteMidEpochCheckPoint(const int epoch);
 
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
@@ -514,10 +695,12 @@ protected:
                             /*out*/ double& learnRatePerSample,
                             std::list<Matrix<ElemType>>& smoothedGradients,
                             /*out*/ double& prevCriterion,
-                            /*out*/ size_t& minibatchSize);
+                            /*out*/ size_t& minibatchSize,
+                            /*out*/ MidEpochPosition* position = nullptr);
 
     wstring GetCheckPointFileNameForEpoch(const int epoch);
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
+    wstring GetMidEpochModelName(const int epoch);
 
     // return -1 if nothing exists
     int DetermineStartEpoch(const bool makeMode);
@@ -542,6 +725,11 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    std::wstring m_checkpointStagingDir;  // local directory to write epoch checkpoints to before they are copied to m_modelPath in the background; synchronous if empty
+    size_t m_maxPendingCheckpointFiles;   // checkpoint files that may be in flight before training waits for them
+    size_t m_checkpointEverySamples;      // mid-epoch checkpoint cadence in samples; 0 = none
+    double m_checkpointEveryMinutes;      // mid-epoch checkpoint cadence in wall-clock minutes; 0 = none
+    bool m_compressCheckpoints;           // write the smoothed gradients of checkpoints compressed (see CheckpointCompression.h)
 
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
@@ -552,6 +740,8 @@ protected:
     std::vector<std::wstring> m_traceNodeNamesSparse;
 
     size_t m_prevChosenMinibatchSize;
+    size_t m_probedMinibatchSize; // replaces m_mbSize if m_memoryProbe == MemoryProbeTarget::MinibatchSize; 0 = none
+    size_t m_numSamplesSeenByUpdates; // samples of all parameter updates so far, for the bias correction of Adam and LAMB
     double m_lastFinishedEpochTrainLoss;
 
     std::shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
@@ -559,7 +749,33 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    shared_ptr<ParameterArena<ElemType>> m_parameterArena;
+
+    shared_ptr<LocalReplicas<ElemType>> m_localReplicas; // if m_localReplicaDevices is given
+
+    shared_ptr<HogwildWorkers<ElemType>> m_hogwildWorkers; // if m_hogwildThreads > 1
+
+    shared_ptr<OptimizerStateOffload<ElemType>> m_optimizerStateOffload; // if m_offloadOptimizerState
+
+    shared_ptr<Matrix<ElemType>> m_globalNormWorkspace; // [1 x 1] for ClipGradientsByGlobalNorm()
+
+    // sharded optimizer state: [i] the worker that updates learnableNodes[i] and keeps its smoothed gradient, -1 if it is
+    // not updated; empty if the optimizer state is not sharded
+    std::vector<int> m_parameterOwners;
+    std::vector<ElemType> m_shardTransferBuffer;               // host buffer for the broadcasts
+    std::list<Matrix<ElemType>> m_receivedSmoothedGradients;   // main node: those of the other workers, for SaveCheckPointInfo()
+
+    unique_ptr<CheckpointWriter> m_checkpointWriter; // main node only, if m_checkpointStagingDir is given
+
+    // set by Benchmark(); 0 = regular training
+    size_t m_benchmarkMinibatches = 0;
+    size_t m_benchmarkWarmupMinibatches = 0;
+    bool m_benchmarkSyntheticData = false;
+
 private:
+    // whether the update of this parameter can run as part of one elementwise update over m_parameterArena
+    bool CanFuseParameterUpdate(const ComputationNodeBasePtr& node) const;
+
     void MarkDropoutNodesEvalTimeStampAsOutdated(const ComputationNetworkPtr& net, const ComputationNodeBasePtr& criterionNode);
 
     bool UsingGradientAggregation(size_t epochNumber) const
@@ -569,7 +785,8 @@ private:
     bool UsingModelAggregation(size_t epochNumber) const
     {
         return ((GetParallelizationMethod() == ParallelizationMethod::modelAveragingSGD ||
-                 GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD) &&
+                 GetParallelizationMethod() == ParallelizationMethod::blockMomentumSGD ||
+                 GetParallelizationMethod() == ParallelizationMethod::parameterServerSGD) &&
                 (epochNumber >= m_parallelizationStartEpochNum));
     }
     bool UsingParallelTrain(size_t epochNumber) const
@@ -6,6 +6,7 @@
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
+#include "Float16GradientExchange.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -15,9 +16,31 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace)
-        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0)
+    // If overlapBucketSize > 0, gradients are aggregated while backprop is still running, in buckets of about that many bytes.
+    // If useCudaAwareMPI, GPU gradients are handed to MPI directly instead of being staged through pinned host buffers
+    // (not applicable to overlapped aggregation, which always stages its buckets).
+    // If numGradientBits is less than the precision of ElemType, the buckets of overlapped aggregation are exchanged
+    // quantized to that many bits per value, with the quantization error carried over to the next minibatch.
+    // If float16Format is given, the dense gradients are exchanged as fp16 or bf16 values, see Float16GradientExchange.
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int syncStatsTrace, size_t overlapBucketSize = 0, bool useCudaAwareMPI = false,
+                             size_t numGradientBits = 8 * sizeof(ElemType), bool zeroThresholdFor1Bit = true,
+                             Float16Format float16Format = Float16Format::none, float initialLossScale = 1.0f)
+        : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_currentEpochNumber(-1), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0),
+          m_overlapBucketSize(overlapBucketSize), m_nextBucketToCopy(0), m_nextBucketToReduce(0), m_useCudaAwareMPI(useCudaAwareMPI),
+          m_numGradientBits(numGradientBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit)
     {
+        if (m_useAsyncAggregation && (m_overlapBucketSize > 0))
+            InvalidArgument("SimpleDistGradAggregator: Buffered async aggregation cannot be combined with overlapped aggregation.");
+        if (IsQuantizing() && (m_overlapBucketSize == 0))
+            InvalidArgument("SimpleDistGradAggregator: Quantized gradients are only supported with overlapped aggregation.");
+        if (float16Format != Float16Format::none)
+        {
+            // the conversion is done in the host buffers that the gradients are staged through
+            if (IsQuantizing() || m_useCudaAwareMPI)
+                InvalidArgument("SimpleDistGradAggregator: 16-bit gradients cannot be combined with quantized gradients or CUDA-aware MPI.");
+            m_float16Exchange.reset(new Float16GradientExchange<ElemType>(mpi, float16Format, initialLossScale));
+            fprintf(stderr, "SimpleDistGradAggregator: Exchanging dense gradients as %s values.\n", (float16Format == Float16Format::bfloat16) ? "bf16" : "fp16");
+        }
     }
 
     ~SimpleDistGradAggregator()
@@ -40,6 +63,12 @@ public:
         bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
         m_iterationCount++;
 
+        if (SupportsOverlappedAggregation())
+        {
+            FinishOverlappedAggregation(headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
+
         if (m_useAsyncAggregation)
         {
             // If we are performing async gradient aggregation, let's wait for the pending gradient aggregation to finish
@@ -122,7 +151,341 @@ public:
         }
     }
 
+    bool SupportsOverlappedAggregation() const override
+    {
+        return m_overlapBucketSize > 0;
+    }
+
+    // Buckets are planned once, from the completion order, which is the same on all nodes; they are then
+    // all-reduced strictly in that order, so that all nodes issue the same sequence of collective operations.
+    void BeginOverlappedAggregation(const std::vector<Matrix<ElemType>*>& gradientsInCompletionOrder) override
+    {
+        if (m_buckets.empty())
+            PlanBuckets(gradientsInCompletionOrder);
+        else if (m_bucketOf.size() != gradientsInCompletionOrder.size())
+            LogicError("BeginOverlappedAggregation: The set of gradients changed between minibatches.");
+
+        for (auto& bucket : m_buckets)
+        {
+            bucket.numCompleted = 0;
+            bucket.allReduceRequest = MPI_REQUEST_NULL;
+        }
+        m_nextBucketToCopy = 0;
+        m_nextBucketToReduce = 0;
+    }
+
+    void OnGradientCompleted(Matrix<ElemType>* gradient) override
+    {
+        auto iter = m_bucketOf.find(gradient);
+        if (iter == m_bucketOf.end()) // e.g. a parameter that is not updated
+            return;
+        m_buckets[iter->second].numCompleted++;
+        ProgressOverlappedAggregation();
+    }
+
+    bool SupportsGradientOwners() const override
+    {
+        return !m_useAsyncAggregation && !SupportsOverlappedAggregation();
+    }
+
+    void SetGradientOwners(const std::vector<int>& owners) override
+    {
+        if (!SupportsGradientOwners())
+            LogicError("SetGradientOwners: Not supported with buffered async or overlapped aggregation.");
+        m_gradientOwners = owners;
+    }
+
 private:
+    // a set of gradients that are all-reduced together, through a contiguous CPU buffer
+    struct GradientBucket
+    {
+        std::vector<Matrix<ElemType>*> gradients;
+        std::vector<size_t> offsets; // [i] offset of gradients[i] in buffer
+        size_t numElements;
+        std::shared_ptr<ElemType> buffer;
+        std::shared_ptr<GPUDataTransferer<ElemType>> gpuDataTransferer;
+        size_t numCompleted;
+        MPI_Request allReduceRequest;
+
+        // quantized exchange: each gradient is quantized on the device, and the quantized bucket is all-gathered
+        std::vector<std::shared_ptr<MatrixQuantizerImpl<ElemType>>> quantizers;
+        std::vector<std::shared_ptr<Matrix<ElemType>>> residuals;                 // on the device of the gradient
+        std::vector<std::shared_ptr<QuantizedMatrix<ElemType>>> quantizedGradients; // in CPU memory
+        std::vector<size_t> quantizedOffsets;                                      // [i] byte offset of quantizedGradients[i] in the part of a node
+        size_t quantizedSize;                                                      // bytes per node
+        std::vector<char> quantizedBuffer;                                         // the parts of all nodes, in rank order
+    };
+
+    bool IsQuantizing() const
+    {
+        return m_numGradientBits < (8 * sizeof(ElemType));
+    }
+
+    void PlanBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        if (gradients.empty())
+            return;
+        int deviceId = gradients[0]->GetDeviceId();
+        if ((deviceId != CPUDEVICE) && !m_allocator)
+            m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
+
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            if (gradients[i]->GetMatrixType() != DENSE)
+                RuntimeError("Overlapped aggregation of sparse gradient matrices is currently unsupported!");
+
+            if (m_buckets.empty() || (m_buckets.back().numElements * sizeof(ElemType) >= m_overlapBucketSize))
+            {
+                m_buckets.push_back(GradientBucket());
+                m_buckets.back().numElements = 0;
+            }
+            auto& bucket = m_buckets.back();
+            bucket.gradients.push_back(gradients[i]);
+            bucket.offsets.push_back(bucket.numElements);
+            bucket.numElements += gradients[i]->GetNumElements();
+            m_bucketOf[gradients[i]] = m_buckets.size() - 1;
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            if (deviceId != CPUDEVICE)
+            {
+                bucket.buffer = AllocateIntermediateBuffer(deviceId, bucket.numElements);
+                bucket.gpuDataTransferer.reset(new GPUDataTransferer<ElemType>(deviceId, true /*useConcurrentStreams*/));
+            }
+            else
+                bucket.buffer = std::shared_ptr<ElemType>(new ElemType[bucket.numElements], [](ElemType* p) { delete[] p; });
+
+            bucket.quantizedSize = 0;
+            for (size_t i = 0; (i < bucket.gradients.size()) && IsQuantizing(); i++)
+            {
+                const auto& gradient = *bucket.gradients[i];
+                bucket.quantizers.push_back(std::shared_ptr<MatrixQuantizerImpl<ElemType>>(MatrixQuantizerImpl<ElemType>::Create(gradient.GetDeviceId(), true /*useAsync*/)));
+                bucket.residuals.push_back(std::make_shared<Matrix<ElemType>>(Matrix<ElemType>::Zeros(gradient.GetNumRows(), gradient.GetNumCols(), gradient.GetDeviceId())));
+                bucket.quantizedGradients.push_back(std::make_shared<QuantizedMatrix<ElemType>>(gradient.GetNumRows(), gradient.GetNumCols(), m_numGradientBits, CPUDEVICE, m_allocator.get()));
+                bucket.quantizedOffsets.push_back(bucket.quantizedSize);
+                bucket.quantizedSize += bucket.quantizedGradients.back()->GetSize();
+            }
+            bucket.quantizedBuffer.resize(NumProc() * bucket.quantizedSize);
+        }
+
+        if (IsQuantizing())
+            fprintf(stderr, "Overlapped gradient aggregation: %d gradients in %d buckets, quantized to %d bits.\n", (int)gradients.size(), (int)m_buckets.size(), (int)m_numGradientBits);
+        else
+            fprintf(stderr, "Overlapped gradient aggregation: %d gradients in %d buckets.\n", (int)gradients.size(), (int)m_buckets.size());
+    }
+
+    // start copying all buckets whose gradients are complete, and all-reducing those that have arrived in CPU memory
+    void ProgressOverlappedAggregation()
+    {
+        while ((m_nextBucketToCopy < m_buckets.size()) && (m_buckets[m_nextBucketToCopy].numCompleted == m_buckets[m_nextBucketToCopy].gradients.size()))
+            StartBucketCopy(m_buckets[m_nextBucketToCopy++]);
+
+        while ((m_nextBucketToReduce < m_nextBucketToCopy) && IsBucketCopied(m_buckets[m_nextBucketToReduce]))
+            StartBucketAllReduce(m_buckets[m_nextBucketToReduce++]);
+
+        // give MPI a chance to make progress on the requests in flight
+        for (size_t i = 0; i < m_nextBucketToReduce; i++)
+        {
+            int flag;
+            MPI_Test(&m_buckets[i].allReduceRequest, &flag, MPI_STATUS_IGNORE) || MpiFail("MPI_Test");
+        }
+        if (m_float16Exchange)
+            m_float16Exchange->Test();
+    }
+
+    void StartBucketCopy(GradientBucket& bucket)
+    {
+        if (IsQuantizing())
+        {
+            // quantize on the quantization stream, adding and updating the residual in the same kernel; the result is fetched to the CPU
+            if (bucket.gpuDataTransferer)
+            {
+                std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(bucket.gradients[0]->GetDeviceId()));
+                mainStreamSyncEvent->SynchronizeQuantizationComputeStreamWithEvent<ElemType>();
+            }
+            for (size_t i = 0; i < bucket.gradients.size(); i++)
+                bucket.quantizers[i]->QuantizeAsync(*bucket.gradients[i], *bucket.residuals[i], *bucket.quantizedGradients[i], *bucket.residuals[i], m_zeroThresholdFor1Bit);
+        }
+        else if (bucket.gpuDataTransferer)
+        {
+            // the gradients are computed on the main compute stream, while we copy on the fetch stream
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(bucket.gradients[0]->GetDeviceId()));
+            mainStreamSyncEvent->SynchronizeDataTransferFetchStreamWithEvent<ElemType>();
+            for (size_t i = 0; i < bucket.gradients.size(); i++)
+                bucket.gpuDataTransferer->CopyGPUToCPUAsync(bucket.gradients[i]->Data(), bucket.gradients[i]->GetNumElements(), bucket.buffer.get() + bucket.offsets[i]);
+        }
+        else
+        {
+            for (size_t i = 0; i < bucket.gradients.size(); i++)
+                memcpy(bucket.buffer.get() + bucket.offsets[i], bucket.gradients[i]->Data(), bucket.gradients[i]->GetNumElements() * sizeof(ElemType));
+        }
+    }
+
+    bool IsBucketCopied(const GradientBucket& bucket) const
+    {
+        if (IsQuantizing())
+        {
+            for (const auto& quantizer : bucket.quantizers)
+                if (!quantizer->IsQuantizeAsyncDone())
+                    return false;
+            return true;
+        }
+        return !bucket.gpuDataTransferer || bucket.gpuDataTransferer->IsCopyGPUToCPUAsyncComplete();
+    }
+
+    void WaitForBucketCopy(GradientBucket& bucket)
+    {
+        if (IsQuantizing())
+        {
+            for (const auto& quantizer : bucket.quantizers)
+                quantizer->WaitQuantizeAsyncDone();
+        }
+        else if (bucket.gpuDataTransferer)
+            bucket.gpuDataTransferer->WaitForCopyGPUToCPUAsync();
+    }
+
+    void StartBucketAllReduce(GradientBucket& bucket)
+    {
+        if (m_float16Exchange)
+        {
+            bucket.allReduceRequest = MPI_REQUEST_NULL;
+            m_float16Exchange->Start(&bucket - m_buckets.data(), bucket.buffer.get(), bucket.numElements);
+            return;
+        }
+        if (!IsQuantizing())
+        {
+            m_mpi->AllReduceAsync(bucket.buffer.get(), bucket.numElements, &bucket.allReduceRequest);
+            return;
+        }
+
+        // quantized values cannot be summed by MPI; each node gathers the quantized buckets of all nodes and sums them itself
+        char* myPart = bucket.quantizedBuffer.data() + MyRank() * bucket.quantizedSize;
+        for (size_t i = 0; i < bucket.gradients.size(); i++)
+            memcpy(myPart + bucket.quantizedOffsets[i], bucket.quantizedGradients[i]->Buffer(), bucket.quantizedGradients[i]->GetSize());
+        MPI_Iallgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bucket.quantizedBuffer.data(), (int) bucket.quantizedSize, MPI_CHAR, m_mpi->Communicator(), &bucket.allReduceRequest) || MpiFail("MPI_Iallgather");
+    }
+
+    // sums the gathered quantized gradients of all nodes into the buffer of the bucket, in rank order so that all nodes get the same result
+    void UnquantizeBucket(GradientBucket& bucket)
+    {
+        const size_t ldNbits = ValueQuantizer<ElemType>::ld(m_numGradientBits);
+        for (size_t i = 0; i < bucket.gradients.size(); i++)
+        {
+            long numRows = (long) bucket.gradients[i]->GetNumRows();
+            long numCols = (long) bucket.gradients[i]->GetNumCols();
+            size_t columnSize = QuantizedColumn<ElemType>::QuantizedColumnSize(m_numGradientBits, numRows);
+            ElemType* sum = bucket.buffer.get() + bucket.offsets[i];
+#pragma omp parallel for
+            for (long j = 0; j < numCols; j++)
+            {
+                for (size_t rank = 0; rank < NumProc(); rank++)
+                {
+                    const char* part = bucket.quantizedBuffer.data() + rank * bucket.quantizedSize + bucket.quantizedOffsets[i];
+                    const auto& qcol = *(const QuantizedColumn<ElemType>*) (part + j * columnSize);
+                    ColumnQuantizer<ElemType> q(ldNbits, qcol.lower, qcol.upper);
+                    q.Unquantize(sum, numRows, j, qcol.bits, /*add=*/rank > 0);
+                }
+            }
+        }
+    }
+
+    // all-reduce the buckets that have not been started during backprop, aggregate the headers,
+    // and copy the aggregated gradients back
+    void FinishOverlappedAggregation(DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        if (headerCPU->numSamples == 0)
+        {
+            headerCPU->criterion = 0.0;
+            for (int i = 0; i < headerCPU->numEvalNode; ++i)
+                headerCPU->evalErrors[i] = { 0.0, 0 };
+
+            // If the current node did not process any samples, the gradients should be zero'd
+            for (size_t b = m_nextBucketToCopy; b < m_buckets.size(); b++)
+            {
+                for (auto gradient : m_buckets[b].gradients)
+                    gradient->SetValue(0);
+            }
+        }
+
+        // gradients that were not reported complete (e.g. no backprop on this node) are taken as they are
+        while (m_nextBucketToCopy < m_buckets.size())
+            StartBucketCopy(m_buckets[m_nextBucketToCopy++]);
+        for (; m_nextBucketToReduce < m_buckets.size(); m_nextBucketToReduce++)
+        {
+            auto& bucket = m_buckets[m_nextBucketToReduce];
+            WaitForBucketCopy(bucket);
+            StartBucketAllReduce(bucket);
+        }
+
+        AggregateHeaders(headerCPU, m_bucketOf.size());
+        if (m_float16Exchange)
+            m_float16Exchange->Finish();
+
+        // wait for the all-reduce operations in order and copy back
+        for (auto& bucket : m_buckets)
+        {
+            MPI_Wait(&bucket.allReduceRequest, MPI_STATUS_IGNORE) || MpiFail("MPI_Wait");
+            if (IsQuantizing())
+                UnquantizeBucket(bucket);
+            for (size_t i = 0; i < bucket.gradients.size(); i++)
+            {
+                if (bucket.gpuDataTransferer)
+                    bucket.gpuDataTransferer->CopyCPUToGPUAsync(bucket.buffer.get() + bucket.offsets[i], bucket.gradients[i]->GetNumElements(), bucket.gradients[i]->Data());
+                else
+                    memcpy(bucket.gradients[i]->Data(), bucket.buffer.get() + bucket.offsets[i], bucket.gradients[i]->GetNumElements() * sizeof(ElemType));
+            }
+        }
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket.gpuDataTransferer)
+                bucket.gpuDataTransferer->WaitForCopyCPUToGPUAsync();
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Remaining overlapped gradient aggregation time: %.6g\n", aggregationTimer.ElapsedSeconds());
+        }
+    }
+
+    // aggregate the headers on the main node and send the result back; using the same tags as AggregateGradientsImpl()
+    void AggregateHeaders(DistGradHeader* headerCPU, size_t numGradMatrices)
+    {
+        if (m_mpi->IsMainNode())
+        {
+            std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                MPI_Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, m_mpi->Communicator(), &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int idx = MPI_UNDEFINED;
+                MPI_Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                headerCPU->Aggregate(m_recvHeaders[idx], true);
+            }
+
+            std::vector<MPI_Request> sendAggHeaderRequests(NumProc() - 1);
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int dest = (j >= MyRank()) ? (j + 1) : j;
+                MPI_Isend(headerCPU, headerCPU->Size(), MPI_CHAR, dest, numGradMatrices + 1 + numGradMatrices, m_mpi->Communicator(), &(sendAggHeaderRequests[j])) || MpiFail("MPI_Isend");
+            }
+            MPI_Waitall(sendAggHeaderRequests.size(), sendAggHeaderRequests.data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+        }
+        else
+        {
+            MPI_Send(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, m_mpi->Communicator()) || MpiFail("MPI_Send");
+            MPI_Recv(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices + 1 + numGradMatrices, m_mpi->Communicator(), MPI_STATUS_IGNORE) || MpiFail("MPI_Recv");
+        }
+    }
+
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
         assert(deviceID >= 0);
@@ -143,26 +506,37 @@ private:
         if (m_currentEpochNumber == -1)
         {
             int deviceId = gradients[0]->GetDeviceId();
-            if (deviceId != CPUDEVICE)
+            if ((deviceId != CPUDEVICE) && !m_allocator)
             {
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
 
-            for (size_t i = 0; i < gradients.size(); i++)
+            // with overlapped aggregation, the buckets have their own buffers
+            for (size_t i = 0; (i < gradients.size()) && !SupportsOverlappedAggregation(); i++)
             {
-                // Make sure none of the gradient matrixes are sparse - we currently do not support aggregation of sparse gradient matrices
-                if (gradients[i]->GetMatrixType() != DENSE)
-                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+                // Sparse gradients (of weights multiplied by sparse inputs) are exchanged as their nonzero columns, see AggregateSparseBlockColGradient()
+                if (IsSparseBlockColGradient(*gradients[i]))
+                {
+                    if (m_useAsyncAggregation)
+                        RuntimeError("Buffered async aggregation of sparse gradient matrices is currently unsupported!");
+                    m_gpuDataTransferers.push_back(nullptr);
+                    m_intermediateCPUBuffers.push_back(nullptr);
+                    continue;
+                }
+                else if (gradients[i]->GetMatrixType() != DENSE)
+                    RuntimeError("Gradient aggregation for sparse gradient matrices is only supported in sparse block-column format!");
 
-                if (deviceId != CPUDEVICE)
+                // with ModelParallelSGD, the gradients live on the devices of their pipeline stages
+                int gradientDeviceId = gradients[i]->GetDeviceId();
+                if ((gradientDeviceId != CPUDEVICE) && !m_useCudaAwareMPI)
                 {
-                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(deviceId, m_useAsyncAggregation)));
-                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(deviceId, gradients[i]->GetNumElements()));
+                    m_gpuDataTransferers.push_back(std::unique_ptr<GPUDataTransferer<ElemType>>(new GPUDataTransferer<ElemType>(gradientDeviceId, m_useAsyncAggregation)));
+                    m_intermediateCPUBuffers.push_back(AllocateIntermediateBuffer(gradientDeviceId, gradients[i]->GetNumElements()));
                 }
 
                 if (m_useAsyncAggregation)
                 {
-                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
+                    m_bufferedGradients[gradients[i]].reset(new Matrix<ElemType>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), gradientDeviceId));
                 }
             }
 
@@ -218,6 +592,7 @@ private:
         }
 
         size_t numGradMatrices = gradients.size();
+        bool stageThroughHost = (deviceId >= 0) && !m_useCudaAwareMPI;
 
         if (headerCPU->numSamples == 0)
         {
@@ -238,11 +613,20 @@ private:
             }
         }
 
+        // With CUDA-aware MPI, the all-reduce reads device memory directly, so the gradients must be final on the device
+        if ((deviceId >= 0) && m_useCudaAwareMPI)
+        {
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+            mainStreamSyncEvent->SynchronizeEvent();
+        }
+
         // Initiate transfer of the gradient matrices to the CPU if needed
-        if (deviceId >= 0)
+        if (stageThroughHost)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
+                if (IsSparseBlockColGradient(*gradients[i]))
+                    continue;
                 m_gpuDataTransferers[i]->CopyGPUToCPUAsync(gradients[i]->Data(), gradients[i]->GetNumElements(), m_intermediateCPUBuffers[i].get());
             }
         }
@@ -270,15 +654,32 @@ private:
         std::vector<MPI_Request> allReduceRequests(numGradMatrices);
         for (size_t i = 0; i < numGradMatrices; ++i)
         {
+            if (IsSparseBlockColGradient(*gradients[i]))
+                continue;
             ElemType* reductionBuffer = gradients[i]->Data();
-            if (deviceId >= 0)
+            if (stageThroughHost)
             {
                 m_gpuDataTransferers[i]->WaitForCopyGPUToCPUAsync();
                 reductionBuffer = m_intermediateCPUBuffers[i].get();
             }
 
-            // On Windows this async MPI_Iallreduce call requires MS MPI v7 or higher to be installed
-            MPI_Iallreduce(MPI_IN_PLACE, reductionBuffer, gradients[i]->GetNumElements(), MPIWrapper::GetDataType(reductionBuffer), MPI_SUM, m_mpi->Communicator(), &allReduceRequests[i]) || MpiFail("MPI_Iallreduce");
+            if (m_float16Exchange)
+            {
+                allReduceRequests[i] = MPI_REQUEST_NULL;
+                m_float16Exchange->Start(i, reductionBuffer, gradients[i]->GetNumElements(), m_gradientOwners.empty() ? -1 : m_gradientOwners[i]);
+            }
+            else if (m_gradientOwners.empty() || (m_gradientOwners[i] < 0))
+                m_mpi->AllReduceAsync(reductionBuffer, gradients[i]->GetNumElements(), &allReduceRequests[i]);
+            else
+                m_mpi->ReduceAsync(reductionBuffer, gradients[i]->GetNumElements(), m_gradientOwners[i], &allReduceRequests[i]);
+        }
+
+        // The sparse gradients are exchanged synchronously while the dense all-reduces are in flight; all nodes
+        // issue these collectives in the same order, since they have the same list of gradients
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            if (IsSparseBlockColGradient(*gradients[i]))
+                AggregateSparseBlockColGradient(*gradients[i]);
         }
 
         // On the main node wait for the headers to arrive and aggregate
@@ -322,10 +723,14 @@ private:
         }
 
         // Wait for the allreduce operations to finish and initiate transfer back to the GPU if needed
+        if (m_float16Exchange)
+            m_float16Exchange->Finish();
         for (size_t i = 0; i < numGradMatrices; ++i)
         {
+            if (IsSparseBlockColGradient(*gradients[i]))
+                continue;
             MPI_Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
-            if (deviceId >= 0)
+            if (stageThroughHost && ReceivesAggregatedGradient(i))
             {
                 m_gpuDataTransferers[i]->CopyCPUToGPUAsync(m_intermediateCPUBuffers[i].get(), gradients[i]->GetNumElements(), gradients[i]->Data());
             }
@@ -338,10 +743,12 @@ private:
         }
 
         // Wait for all the transfers to finish
-        if (deviceId >= 0)
+        if (stageThroughHost)
         {
             for (size_t i = 0; i < numGradMatrices; ++i)
             {
+                if (IsSparseBlockColGradient(*gradients[i]) || !ReceivesAggregatedGradient(i))
+                    continue;
                 m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
             }
         }
@@ -364,6 +771,76 @@ private:
         }
     }
 
+    // with gradient owners, the other ranks are left with their own part of a gradient, which they do not use
+    bool ReceivesAggregatedGradient(size_t i) const
+    {
+        return m_gradientOwners.empty() || (m_gradientOwners[i] < 0) || (m_gradientOwners[i] == (int) m_mpi->CurrentNodeRank());
+    }
+
+    static bool IsSparseBlockColGradient(const Matrix<ElemType>& gradient)
+    {
+        return (gradient.GetMatrixType() == SPARSE) && (gradient.GetFormat() == matrixFormatSparseBlockCol);
+    }
+
+    // All-gather the nonzero columns of a sparse block-column gradient and sum them up into their union.
+    // The sum is taken in rank order, so that all nodes end up with the same result.
+    void AggregateSparseBlockColGradient(Matrix<ElemType>& gradient)
+    {
+        size_t numRows = gradient.GetNumRows();
+        size_t numCols = gradient.GetNumCols();
+        if ((numCols > (size_t) INT_MAX) || (numRows * numCols > (size_t) INT_MAX))
+            RuntimeError("Gradient aggregation for sparse gradient matrices with more than %d elements is not supported.", INT_MAX);
+
+        gradient.GetMatrixFromSBCFormat(m_sparseBlockIds, m_sparseSendValues);
+        m_sparseSendIds.assign(m_sparseBlockIds.begin(), m_sparseBlockIds.end());
+
+        int numProc = (int) NumProc();
+        int numToSend = (int) m_sparseSendIds.size();
+        std::vector<int> counts(numProc);
+        MPI_Allgather(&numToSend, 1, MPI_INT, counts.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("AggregateSparseBlockColGradient: MPI_Allgather");
+
+        std::vector<int> displacements(numProc), valueCounts(numProc), valueDisplacements(numProc);
+        int total = 0;
+        for (int p = 0; p < numProc; p++)
+        {
+            displacements[p] = total;
+            valueCounts[p] = counts[p] * (int) numRows;
+            valueDisplacements[p] = total * (int) numRows;
+            total += counts[p];
+        }
+        if (total == 0)
+            return;
+        m_sparseRecvIds.resize(total);
+        m_sparseRecvValues.resize(total * numRows);
+        MPI_Allgatherv(m_sparseSendIds.data(), numToSend, MPI_INT, m_sparseRecvIds.data(), counts.data(), displacements.data(), MPI_INT, m_mpi->Communicator()) || MpiFail("AggregateSparseBlockColGradient: MPI_Allgatherv");
+        MPI_Allgatherv(m_sparseSendValues.data(), numToSend * (int) numRows, MPIWrapper::GetDataType(m_sparseSendValues.data()),
+                       m_sparseRecvValues.data(), valueCounts.data(), valueDisplacements.data(), MPIWrapper::GetDataType(m_sparseRecvValues.data()), m_mpi->Communicator()) || MpiFail("AggregateSparseBlockColGradient: MPI_Allgatherv");
+
+        // map each column to its block in the union; only the entries of the touched columns are reset afterwards
+        if (m_sparseBlockOfColumn.size() < numCols)
+            m_sparseBlockOfColumn.resize(numCols, -1);
+        m_sparseBlockIds.clear();
+        m_sparseSendValues.clear();
+        for (int j = 0; j < total; j++)
+        {
+            int col = m_sparseRecvIds[j];
+            if (m_sparseBlockOfColumn[col] < 0)
+            {
+                m_sparseBlockOfColumn[col] = (int) m_sparseBlockIds.size();
+                m_sparseBlockIds.push_back(col);
+                m_sparseSendValues.resize(m_sparseSendValues.size() + numRows, 0);
+            }
+            ElemType* sum = m_sparseSendValues.data() + m_sparseBlockOfColumn[col] * numRows;
+            const ElemType* value = m_sparseRecvValues.data() + j * numRows;
+            for (size_t r = 0; r < numRows; r++)
+                sum[r] += value[r];
+        }
+        for (size_t col : m_sparseBlockIds)
+            m_sparseBlockOfColumn[col] = -1;
+
+        gradient.SetMatrixFromSBCFormat(m_sparseBlockIds.data(), m_sparseSendValues.data(), m_sparseBlockIds.size(), numRows, numCols);
+    }
+
 private:
     std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
     std::vector<std::shared_ptr<ElemType>> m_intermediateCPUBuffers;
@@ -388,5 +865,33 @@ private:
     size_t m_iterationCount;
 
     int m_currentEpochNumber;
+
+    // Overlapped aggregation: target bucket size in bytes (0 = disabled), buckets in completion order, and progress
+    size_t m_overlapBucketSize;
+    std::vector<GradientBucket> m_buckets;
+    std::unordered_map<Matrix<ElemType>*, size_t> m_bucketOf;
+    size_t m_nextBucketToCopy;
+    size_t m_nextBucketToReduce;
+
+    // pass device pointers to MPI (requires a CUDA-aware MPI build)
+    bool m_useCudaAwareMPI;
+
+    // bits per value of the quantized exchange of overlapped aggregation; 8 * sizeof(ElemType) = not quantized
+    size_t m_numGradientBits;
+    bool m_zeroThresholdFor1Bit;
+
+    // exchanges the dense gradients in 16 bits; null if they are exchanged as ElemType
+    std::unique_ptr<Float16GradientExchange<ElemType>> m_float16Exchange;
+
+    // [i] rank that gradient i is reduced to, or -1 if it is all-reduced; empty if all are all-reduced
+    std::vector<int> m_gradientOwners;
+
+    // buffers of AggregateSparseBlockColGradient(), kept across calls
+    std::vector<size_t> m_sparseBlockIds;
+    std::vector<int> m_sparseSendIds;
+    std::vector<int> m_sparseRecvIds;
+    std::vector<ElemType> m_sparseSendValues;
+    std::vector<ElemType> m_sparseRecvValues;
+    std::vector<int> m_sparseBlockOfColumn;
 };
 } } }
@@ -41,8 +41,6 @@ public:
         m_maxSamplesInRAM(maxSamplesInRAM), 
         m_numSubminiBatches(numSubminiBatches), 
         m_mpi(mpi), 
-        m_distGradAgg(nullptr),
-        m_gradHeader(nullptr),
         m_enableDistributedMBReading(enableDistributedMBReading)
     {
     }
@@ -102,11 +100,13 @@ public:
         // evaluate through minibatches
         size_t totalEpochSamples = 0;
         size_t numMBsRun = 0;
-        size_t numSamplesLastLogged = 0;
+        size_t totalEpochSamplesLastLogged = 0;
         size_t numMBsRunLastLogged = 0; // MBs run before this display
 
         std::vector<EpochCriterion> evalResultsLastLogged(evalResults.size(), EpochCriterion(0));
 
+        // With MPI, each worker evaluates its share of the data: its chunks with distributed reading, otherwise its stride of
+        // each minibatch. The workers do not communicate while evaluating; their results are all-reduced once at the end.
         bool useParallelTrain = (m_mpi != nullptr);
         bool useDistributedMBReading = useParallelTrain && m_enableDistributedMBReading && dataReader->SupportsDistributedMBRead();
         if (useDistributedMBReading)
@@ -116,7 +116,6 @@ public:
 
         m_net->StartEvaluateMinibatchLoop(evalNodes);
 
-        std::vector<Matrix<ElemType>*> learnParamsGradients;
         DataReaderHelpers::SubminibatchDispatcher<ElemType> smbDispatcher;
         size_t numSubminibatchesNeeded = DataReaderHelpers::GetNumSubminibatchesNeeded<ElemType>(dataReader, m_maxSamplesInRAM, m_numSubminiBatches, mbSize);
 
@@ -126,24 +125,17 @@ public:
         if (numSubminibatchesNeeded > 1)
             smbDispatcher.Init(m_net, learnableNodes, criterionNodes, evalNodes);
 
+        // criteria are accumulated on the device and only fetched for logging and at the end
         CriterionAccumulator<ElemType> localEpochEvalErrors(evalNodes.size(), m_net->GetDeviceId());
 
         const size_t numIterationsBeforePrintingProgress = 100;
         size_t numItersSinceLastPrintOfProgress = 0;
-        bool noMoreSamplesToProcess = false;
         for (;;)
         {
             size_t actualMBSize = 0;
             bool wasDataRead = DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*dataReader, m_net, nullptr, useDistributedMBReading, useParallelTrain, inputMatrices, actualMBSize, m_mpi);
-            // in case of distributed reading, we do a few more loops until all ranks have completed
-            // end of epoch
-            if (!wasDataRead && (!useDistributedMBReading || noMoreSamplesToProcess)) 
-                break;
-
-            // Note: If !wasDataRead then the data that GetMinibatchIntoNetwork() was supposed to full in are undefined.
-            // Must not touch them.
             if (!wasDataRead)
-                actualMBSize = 0; // (undefined if !wasDataRead)
+                break; // end of epoch
 
             if (actualMBSize > 0)
         {
@@ -168,71 +160,26 @@ public:
 
             if (actualNumSubminibatches > 1)
                 smbDispatcher.DoneWithCurrentMinibatch();
-            } // if (actualMBSize > 0)
 
             // BUGBUG (Issue #95): Once we have multiple layouts, this must be done on a per-node basis.
-            size_t numSamplesWithLabel = wasDataRead ? m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize) : 0;
-            size_t aggregateNumSamplesWithLabel = numSamplesWithLabel;
-            if (useParallelTrain)
-            {
-                if (m_gradHeader == nullptr)
-                {
-                    m_gradHeader.reset(DistGradHeader::Create(evalNodes.size()), [](DistGradHeader* ptr) {
-                        DistGradHeader::Destroy(ptr);
-                    });
-                    m_distGradAgg = make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, false, m_traceLevel);
-                }
-
-                m_gradHeader->numEvalNode = evalNodes.size();
-                m_gradHeader->numSamples = actualMBSize;
-                m_gradHeader->numSamplesWithLabel = numSamplesWithLabel;
-                m_gradHeader->criterion = 0.0; // (not used here)
-                for (size_t i = 0; i < evalNodes.size(); i++)
-                    m_gradHeader->evalErrors[i] = localEpochEvalErrors.Assign(evalNodes, i, numSamplesWithLabel).GetCriterion(i);
-
-                // TODO: We are reusing the aggregation logic inside SimpleDistGradAggregator, which has a heavy dependency
-                // on the gradient matrix. At some point we should refactor the aggregator class to be able to only calculating
-                // eval results and then remove this hack.
-                if (learnParamsGradients.size() == 0)
-                {
-                    Matrix<ElemType>* matrix = new Matrix<ElemType>((DEVICEID_TYPE)m_net->GetDeviceId());
-                    learnParamsGradients.push_back(matrix);
-                }
-
-                // Using SimpleDistAggregator for eval results only. At some point we should rename the class to be just
-                // IDistAggregator and SimpleDistAggregator.
-                bool samplesProcessed = m_distGradAgg->AggregateGradients(learnParamsGradients, m_gradHeader.get(), 0);
-                noMoreSamplesToProcess = !samplesProcessed;
-
-                aggregateNumSamplesWithLabel = m_gradHeader->numSamplesWithLabel;
-                for (size_t i = 0; i < evalResults.size(); i++)
-                    evalResults[i] += m_gradHeader->evalErrors[i];
-            }
-            else
-            {
-                if (actualMBSize != 0)
-                {
-                for (int i = 0; i < evalNodes.size(); i++)
-                    evalResults[i] += localEpochEvalErrors.Assign(evalNodes, i, numSamplesWithLabel).GetCriterion(i);
-                }
-            }
+            size_t numSamplesWithLabel = m_net->GetNumSamplesWithLabelOfNetwork(actualMBSize);
+            for (size_t i = 0; i < evalNodes.size(); i++)
+                localEpochEvalErrors.Add(evalNodes, i, numSamplesWithLabel);
+            totalEpochSamples += numSamplesWithLabel;
+            } // if (actualMBSize > 0)
 
-            totalEpochSamples += aggregateNumSamplesWithLabel;
             numMBsRun++;
 
-            if (m_traceLevel > 0)
+            // intermediate results are those of this worker
+            if (m_traceLevel > 0 && (numMBsRun <= m_firstMBsToShowResult || (m_numMBsToShowResult && (numMBsRun % m_numMBsToShowResult == 0))))
             {
-                numSamplesLastLogged += aggregateNumSamplesWithLabel;
-
-                if (numMBsRun <= m_firstMBsToShowResult || (m_numMBsToShowResult && (numMBsRun % m_numMBsToShowResult == 0)))
-                {
-                    DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
+                for (size_t i = 0; i < evalResults.size(); i++)
+                    evalResults[i] = localEpochEvalErrors.GetCriterion(i);
+                DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, totalEpochSamples - totalEpochSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
 
-                    for (int i = 0; i < evalResults.size(); i++)
-                        evalResultsLastLogged[i] = evalResults[i];
-                    numSamplesLastLogged = 0;
-                    numMBsRunLastLogged = numMBsRun;
-                }
+                evalResultsLastLogged = evalResults;
+                totalEpochSamplesLastLogged = totalEpochSamples;
+                numMBsRunLastLogged = numMBsRun;
             }
 
             numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
@@ -242,10 +189,31 @@ public:
             dataReader->DataEnd();
         }
 
+        for (size_t i = 0; i < evalResults.size(); i++)
+            evalResults[i] = localEpochEvalErrors.GetCriterion(i);
+
         // show last batch of results
-        if (m_traceLevel > 0 && numSamplesLastLogged > 0)
+        if (m_traceLevel > 0 && totalEpochSamples > totalEpochSamplesLastLogged)
         {
-            DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, numSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
+            DisplayEvalStatistics(numMBsRunLastLogged + 1, numMBsRun, totalEpochSamples - totalEpochSamplesLastLogged, evalNodes, evalResults, evalResultsLastLogged);
+        }
+
+        // aggregate over the workers
+        if (useParallelTrain)
+        {
+            vector<double> numer(evalResults.size() + 1);
+            vector<size_t> denom(evalResults.size() + 1);
+            for (size_t i = 0; i < evalResults.size(); i++)
+            {
+                numer[i] = evalResults[i].first;
+                denom[i] = evalResults[i].second;
+            }
+            denom.back() = totalEpochSamples;
+            m_mpi->AllReduce(numer);
+            m_mpi->AllReduce(denom);
+            for (size_t i = 0; i < evalResults.size(); i++)
+                evalResults[i] = EpochCriterion(numer[i], denom[i]);
+            totalEpochSamples = denom.back();
         }
 
         // final statistics
@@ -281,6 +249,7 @@ protected:
                 if (evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyWithSoftmaxNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(CrossEntropyNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(ClassBasedCrossEntropyWithSoftmaxNode) ||
+                    evalNodes[i]->OperationName() == OperationNameOf(SampledCrossEntropyWithSoftmaxNode) ||
                     evalNodes[i]->OperationName() == OperationNameOf(NoiseContrastiveEstimationNode))
                     fprintf(stderr, "; perplexity = %.8f", std::exp(criterionSinceLastLogged.Average()));
             }
@@ -301,8 +270,6 @@ protected:
     MPIWrapperPtr m_mpi;
     bool m_enableDistributedMBReading;
 
-    std::shared_ptr<IDistGradAggregator<ElemType>> m_distGradAgg;
-    std::shared_ptr<struct DistGradHeader> m_gradHeader;
     int m_traceLevel;
     void operator=(const SimpleEvaluator&); // (not assignable)
 };
@@ -18,11 +18,115 @@
 #include <cstdio>
 #include "ProgressTracing.h"
 #include "ComputationNetworkBuilder.h"
+#include "MPIWrapper.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// runs tasks in order on a background thread, with at most 'maxPendingTasks' of them queued;
+// used to format and write the outputs of a minibatch while the next one is computed
+class OutputWriterThread
+{
+public:
+    OutputWriterThread(size_t maxPendingTasks)
+        : m_maxPendingTasks(max(maxPendingTasks, (size_t) 1)), m_isTerminating(false)
+    {
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    ~OutputWriterThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isTerminating = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+
+    // queue a task; waits while the queue is full, and rethrows an error of an earlier task
+    void Enqueue(const std::function<void()>& task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_tasks.size() < m_maxPendingTasks || m_error; });
+            RethrowError();
+            m_tasks.push_back(task);
+        }
+        m_condition.notify_all();
+    }
+
+    // wait until all tasks have run; rethrows an error of one of them
+    void WaitAll()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_tasks.empty(); });
+        RethrowError();
+    }
+
+private:
+    void Run()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_tasks.empty() || m_isTerminating; });
+                if (m_tasks.empty())
+                    return;
+                task = m_tasks.front();
+            }
+
+            std::exception_ptr error;
+            if (!m_error) // after an error, the remaining tasks are dropped
+            {
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.pop_front();
+                if (error && !m_error)
+                    m_error = error;
+            }
+            m_condition.notify_all();
+        }
+    }
+
+    // (caller must hold m_mutex)
+    void RethrowError()
+    {
+        if (m_error)
+        {
+            auto error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t m_maxPendingTasks;
+    std::deque<std::function<void()>> m_tasks; // the front one is running
+    std::exception_ptr m_error;
+    bool m_isTerminating;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_thread;
+};
 
 template <class ElemType>
 class SimpleOutputWriter
@@ -30,8 +134,10 @@ class SimpleOutputWriter
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
 
 public:
-    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0)
-        : m_net(net), m_verbosity(verbosity)
+    // With 'mpi' and more than one worker, the formatted-text WriteOutput() is distributed: each worker reads a disjoint
+    // part of the data and writes its own shard of each output file, and the main worker writes a manifest of the shards.
+    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0, const MPIWrapperPtr& mpi = nullptr)
+        : m_net(net), m_verbosity(verbosity), m_mpi(mpi)
     {
     }
 
@@ -119,8 +225,10 @@ public:
         dataWriter.SaveData(0, outputMatrices, 1, 1, 0);
     }
 
-    void WriteMinibatch(FILE* f, ComputationNodePtr node, 
-        const WriteFormattingOptions & formattingOptions, char formatChar, std::string valueFormatString, std::vector<std::string>& labelMapping,
+    // copy a minibatch out of the node, and return a task that formats and writes it to 'f'
+    // The copy is taken now, so that the task can run on another thread while the network computes the next minibatch.
+    std::function<void()> CaptureMinibatch(FILE* f, ComputationNodePtr node,
+        const WriteFormattingOptions & formattingOptions, std::string valueFormatString, const std::vector<std::string>& labelMapping,
         size_t numMBsRun, bool gradient)
     {
         const auto sequenceSeparator = formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceSeparator, numMBsRun);
@@ -129,9 +237,25 @@ public:
         const auto elementSeparator =  formattingOptions.Processed(node->NodeName(), formattingOptions.elementSeparator,  numMBsRun);
         const auto sampleSeparator =   formattingOptions.Processed(node->NodeName(), formattingOptions.sampleSeparator,   numMBsRun);
 
-        node->WriteMinibatchWithFormatting(f, FrameRange(), SIZE_MAX, SIZE_MAX, formattingOptions.transpose, formattingOptions.isCategoryLabel, formattingOptions.isSparse, labelMapping,
-            sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator,
-            valueFormatString, gradient);
+        const Matrix<ElemType>& values = gradient ? node->Gradient() : node->Value();
+        shared_ptr<ElemType> data(values.CopyToArray(), [](ElemType* p) { delete[] p; });
+        size_t numRows = values.GetNumRows();
+        TensorShape sampleLayout = node->GetSampleLayout();
+        MBLayoutPtr pMBLayout;
+        if (node->HasMBLayout())
+        {
+            pMBLayout = make_shared<MBLayout>();
+            pMBLayout->CopyFrom(node->GetMBLayout());
+        }
+        bool transpose = formattingOptions.transpose, isCategoryLabel = formattingOptions.isCategoryLabel, isSparse = formattingOptions.isSparse;
+
+        return [=, &labelMapping]()
+        {
+            ComputationNode<ElemType>::WriteMinibatchDataWithFormatting(f, FrameRange(), data.get(), numRows, sampleLayout, pMBLayout,
+                SIZE_MAX, SIZE_MAX, transpose, isCategoryLabel, isSparse, labelMapping,
+                sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator,
+                valueFormatString);
+        };
     }
 
     void InsertNode(std::vector<ComputationNodeBasePtr>& allNodes, ComputationNodeBasePtr parent, ComputationNodeBasePtr newNode)
@@ -150,8 +274,14 @@ public:
     }
 
     // TODO: Remove code dup with above function by creating a fake Writer object and then calling the other function.
+    // The outputs of a minibatch are formatted and written on a background thread while the next minibatch is computed.
     void WriteOutput(IDataReader& dataReader, size_t mbSize, std::wstring outputPath, const std::vector<std::wstring>& outputNodeNames, const WriteFormattingOptions& formattingOptions, size_t numOutputSamples = requestDataSize, bool nodeUnitTest = false)
     {
+        bool useParallelWrite = m_mpi != nullptr && m_mpi->NumNodesInUse() > 1;
+        bool useDistributedMBReading = useParallelWrite && dataReader.SupportsDistributedMBRead();
+        if (useParallelWrite && outputPath == L"-")
+            InvalidArgument("write command: Writing to stdout ('-') is not supported with more than one parallel worker.");
+
         // In case of unit test, make sure backprop works
         ScopedNetworkOperationMode modeGuard(m_net, nodeUnitTest ? NetworkOperationMode::training : NetworkOperationMode::inferring);
 
@@ -204,6 +334,7 @@ public:
             File::LoadLabelFile(formattingOptions.labelMappingFile, labelMapping);
 
         // open output files
+        // In parallel, each worker writes its own shard of each file.
         File::MakeIntermediateDirs(outputPath);
         std::map<ComputationNodeBasePtr, shared_ptr<File>> outputStreams; // TODO: why does unique_ptr not work here? Complains about non-existent default_delete()
         for (auto & onode : allOutputNodes)
@@ -211,12 +342,18 @@ public:
             std::wstring nodeOutputPath = outputPath;
             if (nodeOutputPath != L"-")
                 nodeOutputPath += L"." + onode->NodeName();
+            if (useParallelWrite)
+                nodeOutputPath = ShardPath(nodeOutputPath, m_mpi->CurrentNodeRank());
             auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | fileOptionsText);
             outputStreams[onode] = f;
         }
 
         // evaluate with minibatches
-        dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
+        // Without distributed reading, every worker reads all data, and decimation leaves it its part of each minibatch.
+        if (useDistributedMBReading)
+            dataReader.StartDistributedMinibatchLoop(mbSize, 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), numOutputSamples);
+        else
+            dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
 
         m_net->StartEvaluateMinibatchLoop(outputNodes);
 
@@ -234,7 +371,9 @@ public:
         char formatChar = !formattingOptions.isCategoryLabel ? 'f' : !formattingOptions.labelMappingFile.empty() ? 's' : 'u';
         std::string valueFormatString = "%" + formattingOptions.precisionFormat + formatChar; // format string used in fprintf() for formatting the values
 
-        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr); numMBsRun++)
+        OutputWriterThread writerThread(/*maxPendingTasks=*/2 * allOutputNodes.size());
+
+        for (size_t numMBsRun = 0; DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, useDistributedMBReading, useParallelWrite, inputMatrices, actualMBSize, m_mpi); numMBsRun++)
         {
             ComputationNetwork::BumpEvalTimeStamp(inputNodes);
 
@@ -245,7 +384,7 @@ public:
                 m_net->ForwardProp(onode);
 
                 FILE* file = *outputStreams[onode];
-                WriteMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ false);
+                writerThread.Enqueue(CaptureMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, valueFormatString, labelMapping, numMBsRun, /* gradient */ false));
 
                 if (nodeUnitTest)
                     m_net->Backprop(onode);
@@ -262,7 +401,7 @@ public:
                     }
                     else
                     {
-                        WriteMinibatch(file, node, formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ true);
+                        writerThread.Enqueue(CaptureMinibatch(file, node, formattingOptions, valueFormatString, labelMapping, numMBsRun, /* gradient */ true));
                     }
                 }
             }
@@ -270,7 +409,7 @@ public:
 
             fprintf(stderr, "Minibatch[%lu]: ActualMBSize = %lu\n", numMBsRun, actualMBSize);
             if (outputPath == L"-") // if we mush all nodes together on stdout, add some visual separator
-                fprintf(stdout, "\n");
+                writerThread.Enqueue([]() { fprintf(stdout, "\n"); });
 
             numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
 
@@ -279,6 +418,8 @@ public:
             dataReader.DataEnd();
         } // end loop over minibatches
 
+        writerThread.WaitAll();
+
         for (auto & stream : outputStreams)
         {
             FILE* f = *stream.second;
@@ -290,11 +431,44 @@ public:
         // flush all files (where we can catch errors) so that we can then destruct the handle cleanly without error
         for (auto & iter : outputStreams)
             iter.second->Flush();
+
+        if (useParallelWrite)
+            WriteShardManifest(outputPath, allOutputNodes, totalEpochSamples);
+    }
+
+    // the file name of a worker's shard of an output file
+    static std::wstring ShardPath(const std::wstring& path, size_t rank)
+    {
+        return path + L".shard" + std::to_wstring(rank);
+    }
+
+    // write 'outputPath.manifest', which lists for each output node the shards in the order of the workers, with their sample counts
+    // Together the shards hold all samples, but the data reader determines their order across shards.
+    void WriteShardManifest(const std::wstring& outputPath, const std::vector<ComputationNodeBasePtr>& outputNodes, size_t numSamples)
+    {
+        // gather the sample counts of all workers: each contributes its own slot
+        std::vector<size_t> numSamplesPerShard(m_mpi->NumNodesInUse(), 0);
+        numSamplesPerShard[m_mpi->CurrentNodeRank()] = numSamples;
+        m_mpi->AllReduce(numSamplesPerShard);
+
+        if (m_mpi->IsMainNode())
+        {
+            std::wstring manifestPath = outputPath + L".manifest";
+            File manifest(manifestPath, fileOptionsWrite | fileOptionsText);
+            for (auto& onode : outputNodes)
+            {
+                for (size_t rank = 0; rank < numSamplesPerShard.size(); rank++)
+                    fprintfOrDie(manifest, "%ls\t%ls\t%lu\n", onode->NodeName().c_str(), ShardPath(outputPath + L"." + onode->NodeName(), rank).c_str(), (unsigned long) numSamplesPerShard[rank]);
+            }
+            manifest.Flush();
+            fprintf(stderr, "Written the list of shards to %ls\n", manifestPath.c_str());
+        }
     }
 
 private:
     ComputationNetworkPtr m_net;
     int m_verbosity;
+    MPIWrapperPtr m_mpi;
     void operator=(const SimpleOutputWriter&); // (not assignable)
 };
 
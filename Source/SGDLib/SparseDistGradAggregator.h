@@ -0,0 +1,245 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// SparseDistGradAggregator.h -- gradient aggregation that only exchanges the largest gradient elements
+//
+// Every node adds its gradient to a local residual, sends the top-k elements of the residual by magnitude as
+// (index, value) pairs, and keeps the rest in the residual for later minibatches (error feedback, like the
+// residuals of the 1-bit quantizer). The aggregated gradient is the sum of what all nodes sent.
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include "GPUDataTransferer.h"
+#include "TimerUtility.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+class SparseDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    // 'sparsity' is the fraction of the gradient elements that each node sends per minibatch, in (0, 1)
+    SparseDistGradAggregator(const MPIWrapperPtr& mpi, double sparsity, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_sparsity(sparsity), m_syncStatsTrace(syncStatsTrace), m_iterationCount(0), m_currentEpochNumber(-1), m_numElements(0)
+    {
+        if (!(m_sparsity > 0) || !(m_sparsity < 1))
+            InvalidArgument("SparseDistGradAggregator: The sparsity must be in (0, 1), but is %g.", m_sparsity);
+    }
+
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, int epochNumber) override
+    {
+        ResetCurrentEpoch(gradients, epochNumber);
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        int deviceId = gradients[0]->GetDeviceId();
+        if (showSyncPerfStats)
+        {
+            std::unique_ptr<MatrixComputeStreamEvent> mainStreamSyncEvent(MatrixComputeStreamEvent::Create(deviceId));
+            mainStreamSyncEvent->SynchronizeEvent();
+            aggregationTimer.Start();
+        }
+
+        if (headerCPU->numSamples == 0)
+        {
+            headerCPU->criterion = 0.0;
+            for (int i = 0; i < headerCPU->numEvalNode; ++i)
+                headerCPU->evalErrors[i] = { 0.0, 0 };
+
+            // If the current node did not process any samples, it contributes nothing (but still sends its residual)
+            for (auto gradient : gradients)
+                gradient->SetValue(0);
+        }
+
+        // add the gradients to the residuals and bring the residuals to the CPU
+        for (size_t i = 0; i < gradients.size(); i++)
+            *m_residuals[i] += *gradients[i];
+        CopyToCPU(m_residuals, m_residualBuffer.get());
+
+        // select the local top-k and remove them from the residuals
+        SelectTopK();
+        for (auto index : m_sendIndices)
+            m_residualBuffer.get()[index] = 0;
+        CopyFromCPU(m_residualBuffer.get(), m_residuals);
+
+        size_t numSent = m_sendIndices.size();
+        ExchangeAndAccumulate();
+        CopyFromCPU(m_aggregateBuffer.get(), gradients);
+
+        AggregateHeaders(headerCPU);
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            fprintf(stderr, "Actual sparse gradient aggregation time: %.6g (%d of %d elements sent)\n", aggregationTimer.ElapsedSeconds(), (int) numSent, (int) m_numElements);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    void ResetCurrentEpoch(const std::vector<Matrix<ElemType>*>& gradients, int epochNumber)
+    {
+        if (m_currentEpochNumber == -1)
+        {
+            int deviceId = gradients[0]->GetDeviceId();
+            for (size_t i = 0; i < gradients.size(); i++)
+            {
+                if (gradients[i]->GetMatrixType() != DENSE)
+                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+
+                m_offsets.push_back(m_numElements);
+                m_numElements += gradients[i]->GetNumElements();
+                m_residuals.push_back(std::make_shared<Matrix<ElemType>>(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), deviceId));
+                m_residuals.back()->SetValue(0);
+            }
+            // the indices are sent as MPI_INT
+            if (m_numElements > (size_t) INT_MAX)
+                RuntimeError("SparseDistGradAggregator: Gradients with more than %d elements in total are not supported.", INT_MAX);
+
+            if (deviceId != CPUDEVICE)
+            {
+                m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
+                m_gpuDataTransferer.reset(new GPUDataTransferer<ElemType>(deviceId, false /*useConcurrentStreams*/));
+            }
+            m_residualBuffer = AllocateBuffer(deviceId, m_numElements);
+            m_aggregateBuffer = AllocateBuffer(deviceId, m_numElements);
+            m_order.resize(m_numElements);
+        }
+        else if (m_offsets.size() != gradients.size())
+            LogicError("SparseDistGradAggregator: The set of gradients changed between minibatches.");
+
+        // The residuals are carried over across epochs, like the 1-bit quantization residuals,
+        // so that no gradient contribution is ever lost.
+        m_currentEpochNumber = epochNumber;
+    }
+
+    // pick the max(1, sparsity * N) elements of m_residualBuffer with the largest magnitude, in ascending index order
+    void SelectTopK()
+    {
+        const ElemType* residual = m_residualBuffer.get();
+        size_t k = std::max((size_t) 1, (size_t) (m_sparsity * m_numElements));
+        for (size_t j = 0; j < m_numElements; j++)
+            m_order[j] = (int) j;
+        std::nth_element(m_order.begin(), m_order.begin() + (k - 1), m_order.end(), [residual](int a, int b)
+        {
+            return fabs(residual[a]) > fabs(residual[b]);
+        });
+
+        m_sendIndices.assign(m_order.begin(), m_order.begin() + k);
+        std::sort(m_sendIndices.begin(), m_sendIndices.end());
+        m_sendValues.resize(k);
+        for (size_t j = 0; j < k; j++)
+            m_sendValues[j] = residual[m_sendIndices[j]];
+    }
+
+    // all-gather the (index, value) pairs of all nodes and sum them up into m_aggregateBuffer
+    void ExchangeAndAccumulate()
+    {
+        int numProc = (int) NumProc();
+        int numToSend = (int) m_sendIndices.size();
+        std::vector<int> counts(numProc);
+        MPI_Allgather(&numToSend, 1, MPI_INT, counts.data(), 1, MPI_INT, m_mpi->Communicator()) || MpiFail("SparseDistGradAggregator: MPI_Allgather");
+
+        std::vector<int> displacements(numProc);
+        int total = 0;
+        for (int p = 0; p < numProc; p++)
+        {
+            displacements[p] = total;
+            total += counts[p];
+        }
+        m_recvIndices.resize(total);
+        m_recvValues.resize(total);
+        MPI_Allgatherv(m_sendIndices.data(), numToSend, MPI_INT, m_recvIndices.data(), counts.data(), displacements.data(), MPI_INT, m_mpi->Communicator()) || MpiFail("SparseDistGradAggregator: MPI_Allgatherv");
+        MPI_Allgatherv(m_sendValues.data(), numToSend, MPIWrapper::GetDataType(m_sendValues.data()), m_recvValues.data(), counts.data(), displacements.data(), MPIWrapper::GetDataType(m_recvValues.data()), m_mpi->Communicator()) || MpiFail("SparseDistGradAggregator: MPI_Allgatherv");
+
+        ElemType* aggregate = m_aggregateBuffer.get();
+        memset(aggregate, 0, m_numElements * sizeof(ElemType));
+        for (int j = 0; j < total; j++)
+            aggregate[m_recvIndices[j]] += m_recvValues[j];
+    }
+
+    // the headers are small, so every node simply gathers all of them
+    void AggregateHeaders(DistGradHeader* headerCPU)
+    {
+        size_t headerSize = headerCPU->Size();
+        std::vector<char> allHeaders(headerSize * NumProc());
+        MPI_Allgather(headerCPU, (int) headerSize, MPI_CHAR, allHeaders.data(), (int) headerSize, MPI_CHAR, m_mpi->Communicator()) || MpiFail("SparseDistGradAggregator: MPI_Allgather");
+
+        headerCPU->Clear();
+        for (size_t p = 0; p < NumProc(); p++)
+            headerCPU->Aggregate((DistGradHeader*) (allHeaders.data() + p * headerSize), true);
+    }
+
+    void CopyToCPU(const std::vector<std::shared_ptr<Matrix<ElemType>>>& matrices, ElemType* buffer)
+    {
+        for (size_t i = 0; i < matrices.size(); i++)
+        {
+            if (m_gpuDataTransferer)
+                m_gpuDataTransferer->CopyGPUToCPUAsync(matrices[i]->Data(), matrices[i]->GetNumElements(), buffer + m_offsets[i]);
+            else
+                memcpy(buffer + m_offsets[i], matrices[i]->Data(), matrices[i]->GetNumElements() * sizeof(ElemType));
+        }
+        if (m_gpuDataTransferer)
+            m_gpuDataTransferer->WaitForCopyGPUToCPUAsync();
+    }
+
+    template <class MatrixPtr>
+    void CopyFromCPU(const ElemType* buffer, const std::vector<MatrixPtr>& matrices)
+    {
+        for (size_t i = 0; i < matrices.size(); i++)
+        {
+            if (m_gpuDataTransferer)
+                m_gpuDataTransferer->CopyCPUToGPUAsync(const_cast<ElemType*>(buffer) + m_offsets[i], matrices[i]->GetNumElements(), matrices[i]->Data());
+            else
+                memcpy(matrices[i]->Data(), buffer + m_offsets[i], matrices[i]->GetNumElements() * sizeof(ElemType));
+        }
+        if (m_gpuDataTransferer)
+            m_gpuDataTransferer->WaitForCopyCPUToGPUAsync();
+    }
+
+    std::shared_ptr<ElemType> AllocateBuffer(int deviceId, size_t numElements)
+    {
+        // Use pinned memory for GPU devices for better copy performance
+        if (deviceId != CPUDEVICE)
+            return std::shared_ptr<ElemType>((ElemType*) m_allocator->Malloc(sizeof(ElemType) * numElements), [this](ElemType* p) { m_allocator->Free(p); });
+        else
+            return std::shared_ptr<ElemType>(new ElemType[numElements], [](ElemType* p) { delete[] p; });
+    }
+
+private:
+    double m_sparsity;
+    int m_syncStatsTrace;
+
+    // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
+    size_t m_iterationCount;
+
+    int m_currentEpochNumber;
+
+    // all gradients are handled as one flat vector; m_offsets[i] is where gradient i starts in it
+    std::vector<size_t> m_offsets;
+    size_t m_numElements;
+
+    // the part of the gradients that has not been sent yet, on the gradients' device
+    std::vector<std::shared_ptr<Matrix<ElemType>>> m_residuals;
+
+    std::unique_ptr<CUDAPageLockedMemAllocator> m_allocator;
+    std::unique_ptr<GPUDataTransferer<ElemType>> m_gpuDataTransferer;
+    std::shared_ptr<ElemType> m_residualBuffer;
+    std::shared_ptr<ElemType> m_aggregateBuffer;
+
+    std::vector<int> m_order; // scratch for the top-k selection
+    std::vector<int> m_sendIndices;
+    std::vector<ElemType> m_sendValues;
+    std::vector<int> m_recvIndices;
+    std::vector<ElemType> m_recvValues;
+};
+} } }
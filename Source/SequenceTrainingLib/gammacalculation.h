@@ -8,6 +8,7 @@
 #include "Matrix.h"
 #include "CUDAPageLockedMemAllocator.h"
 
+#include <exception>
 #include <memory>
 #include <vector>
 
@@ -100,7 +101,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
         std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
         validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
@@ -108,6 +108,15 @@ public:
         size_t numrows = loglikelihood.GetNumRows();
         size_t numcols = loglikelihood.GetNumCols();
         Microsoft::MSR::CNTK::Matrix<ElemType> tempmatrix(m_deviceid);
+        Microsoft::MSR::CNTK::Matrix<ElemType> templabels(m_deviceid);
+
+        // With the lattice computation on the GPU, the LLs stay on the device: the lattice code only needs the host copy in pred
+        // for its dimensions, and the numerator score is taken from the labels, which are the one-hot form of uids.
+        // Reference alignment writes the labels from uids, so it uses the host copy, as do sparse labels.
+        bool hostloglls = m_deviceid == CPUDEVICE || !parallellattice.enabled() || doreferencealign || labels.GetMatrixType() != Microsoft::MSR::CNTK::DENSE;
+#if !defined(PARALLEL_SIL) || defined(CPU_VERIFICATION)
+        hostloglls = true; // silence edges or the verification are computed on the CPU
+#endif
 
         // copy loglikelihood to pred
         if (numcols > pred.cols())
@@ -126,131 +135,220 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
-        size_t mapi = 0; // parallel-sequence index for utterance [i]
-        // cal gamma for each utterance
+        // locate each utterance in pred/dengammas and in the minibatch
+        std::vector<utterancestripe> stripes(lattices.size());
         size_t ts = 0;
         for (size_t i = 0; i < lattices.size(); i++)
         {
-            const size_t numframes = lattices[i]->getnumframes();
-
-            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
-            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
-
-            if (samplesInRecurrentStep == 1) // no sequence parallelism
-            {
-                tempmatrix = loglikelihood.ColumnSlice(ts, numframes);
-                // if (m_deviceid == CPUDEVICE)
-                {
-                    CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
-                }
-
-                if (m_deviceid != CPUDEVICE)
-                    parallellattice.setloglls(tempmatrix);
-            }
-            else // multiple parallel sequences
+            auto& stripe = stripes[i];
+            stripe.ts = ts;
+            stripe.numframes = lattices[i]->getnumframes();
+            if (samplesInRecurrentStep > 1) // multiple parallel sequences
             {
-                // get number of frames for the utterance
-                mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                stripe.mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                stripe.tbegin = validframes[stripe.mapi];
 
                 // scan MBLayout for end of utterance
                 size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
-                for (size_t t = validframes[mapi]; t < T; t++)
+                for (size_t t = stripe.tbegin; t < T; t++)
                 {
                     // TODO: Adapt this to new MBLayout, m_sequences would be easier to work off.
-                    if (pMBLayout->IsEnd(mapi, t))
+                    if (pMBLayout->IsEnd(stripe.mapi, t))
                     {
-                        mapframenum = t - validframes[mapi] + 1;
+                        mapframenum = t - stripe.tbegin + 1;
                         break;
                     }
                 }
 
                 // must match the explicit information we get from the reader
-                if (numframes != mapframenum)
-                    LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) numframes, (int) mapframenum);
-                assert(numframes == mapframenum);
-
-                if (numframes > tempmatrix.GetNumCols())
-                    tempmatrix.Resize(numrows, numframes);
+                if (stripe.numframes != mapframenum)
+                    LogicError("gammacalculation: IsEnd() not working, numframes (%d) vs. mapframenum (%d)", (int) stripe.numframes, (int) mapframenum);
+                assert(stripe.numframes == mapframenum);
+                validframes[stripe.mapi] += stripe.numframes; // advance the cursor within the parallel sequence
+            }
+            ts += stripe.numframes;
+        }
 
-                Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
-                tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
+        // cal gamma for each utterance
+        if (parallellattice.enabled())
+        {
+            // The lattice state on the GPU holds one utterance at a time.
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                getutteranceloglls(stripes[i], loglikelihood, labels, samplesInRecurrentStep, hostloglls, tempmatrix, templabels);
+                stripes[i].numavlogp = numeratorlogp(stripes[i], uids, hostloglls, tempmatrix, templabels);
+                stripes[i].denavlogp = forwardbackward(*lattices[i], stripes[i], uids, boundaries, doreferencealign);
+                setutterancegammas(stripes[i], gammafromlattice, labels, uids, samplesInRecurrentStep, doreferencealign, tempmatrix);
+            }
+        }
+        else
+        {
+            // On the host, the utterances only share read-only state and write to separate stripes of pred, dengammas and uids,
+            // so the lattices of the minibatch are processed in parallel.
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                getutteranceloglls(stripes[i], loglikelihood, labels, samplesInRecurrentStep, hostloglls, tempmatrix, templabels);
+                stripes[i].numavlogp = numeratorlogp(stripes[i], uids, hostloglls, tempmatrix, templabels);
+            }
 
-                // if (doreferencealign || m_deviceid == CPUDEVICE)
+            std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < (int) lattices.size(); i++)
+            {
+                try
                 {
-                    CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
+                    stripes[i].denavlogp = forwardbackward(*lattices[i], stripes[i], uids, boundaries, doreferencealign);
                 }
-
-                if (m_deviceid != CPUDEVICE)
+                catch (...)
                 {
-                    parallellattice.setloglls(tempmatrix);
+#pragma omp critical
+                    error = std::current_exception();
                 }
             }
+            if (error)
+                std::rethrow_exception(error);
 
-            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+            for (size_t i = 0; i < lattices.size(); i++)
+                setutterancegammas(stripes[i], gammafromlattice, labels, uids, samplesInRecurrentStep, doreferencealign, tempmatrix);
+        }
 
-            if (doreferencealign)
-            {
-                boundaryframenum = numframes;
-            }
+        for (const auto& stripe : stripes)
+        {
+            objectValue += (ElemType)((stripe.numavlogp - stripe.denavlogp) * stripe.numframes);
+            fprintf(stderr, "dengamma value %f\n", stripe.denavlogp);
+        }
+        functionValues.SetValue(objectValue);
+    }
+
+private:
+    // location of an utterance in pred/dengammas (columns ts..ts+numframes-1) and in the minibatch
+    // (parallel sequence mapi from time step tbegin, if there are multiple parallel sequences), and its scores
+    struct utterancestripe
+    {
+        size_t ts = 0;
+        size_t numframes = 0;
+        size_t mapi = 0;
+        size_t tbegin = 0;
+        double numavlogp = 0;
+        double denavlogp = 0;
+    };
+
+    // Gets the LLs of an utterance into pred (if hostloglls) and tempmatrix, and its labels into templabels otherwise.
+    void getutteranceloglls(const utterancestripe& stripe, const Microsoft::MSR::CNTK::Matrix<ElemType>& loglikelihood,
+                            Microsoft::MSR::CNTK::Matrix<ElemType>& labels, size_t samplesInRecurrentStep, bool hostloglls,
+                            Microsoft::MSR::CNTK::Matrix<ElemType>& tempmatrix, Microsoft::MSR::CNTK::Matrix<ElemType>& templabels)
+    {
+        const size_t numrows = loglikelihood.GetNumRows();
+        const size_t numframes = stripe.numframes;
+        msra::dbn::matrixstripe predstripe(pred, stripe.ts, numframes); // logLLs for this utterance
+
+        if (samplesInRecurrentStep == 1) // no sequence parallelism
+        {
+            tempmatrix = loglikelihood.ColumnSlice(stripe.ts, numframes);
+            if (hostloglls)
+                CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
             else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
+                templabels = labels.ColumnSlice(stripe.ts, numframes);
+        }
+        else // multiple parallel sequences
+        {
+            if (numframes > tempmatrix.GetNumCols())
+                tempmatrix.Resize(numrows, numframes);
+
+            Microsoft::MSR::CNTK::Matrix<ElemType> loglikelihoodForCurrentParallelUtterance = loglikelihood.ColumnSlice(stripe.mapi + (stripe.tbegin * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+            tempmatrix.CopyColumnsStrided(loglikelihoodForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
 
-            double numavlogp = 0;
-            foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+            if (hostloglls)
+                CopyFromCNTKMatrixToSSEMatrix(tempmatrix, numframes, predstripe);
+            else
             {
-                const size_t s = uidsstripe[t];
-                numavlogp += predstripe(s, t) / amf;
+                if (numframes > templabels.GetNumCols())
+                    templabels.Resize(numrows, numframes);
+                Microsoft::MSR::CNTK::Matrix<ElemType> labelsForCurrentParallelUtterance = labels.ColumnSlice(stripe.mapi + (stripe.tbegin * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                templabels.CopyColumnsStrided(labelsForCurrentParallelUtterance, numframes, samplesInRecurrentStep, 1);
             }
-            numavlogp /= numframes;
+        }
 
-            // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
-                                                                   (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
-                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
+        if (m_deviceid != CPUDEVICE)
+            parallellattice.setloglls(tempmatrix);
+    }
 
-            if (samplesInRecurrentStep == 1)
+    // average numerator log LL of an utterance, from the LLs fetched by getutteranceloglls()
+    double numeratorlogp(const utterancestripe& stripe, std::vector<size_t>& uids, bool hostloglls,
+                         const Microsoft::MSR::CNTK::Matrix<ElemType>& tempmatrix, const Microsoft::MSR::CNTK::Matrix<ElemType>& templabels)
+    {
+        double numavlogp = 0;
+        if (hostloglls)
+        {
+            msra::dbn::matrixstripe predstripe(pred, stripe.ts, stripe.numframes);
+            for (size_t t = 0; t < stripe.numframes; t++) // we do not allocate memory for numgamma now
             {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
+                const size_t s = uids[stripe.ts + t];
+                numavlogp += predstripe(s, t) / amf;
             }
+        }
+        else // (only the result is transferred)
+            numavlogp = Microsoft::MSR::CNTK::Matrix<ElemType>::InnerProductOfMatrices(templabels.ColumnSlice(0, stripe.numframes), tempmatrix.ColumnSlice(0, stripe.numframes)) / amf;
+        return numavlogp / stripe.numframes;
+    }
 
-            // copy gamma to tempmatrix
-            if (m_deviceid == CPUDEVICE)
-            {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
-            }
-            else
-                parallellattice.getgamma(tempmatrix);
+    // runs the lattice forward-backward of an utterance into dengammas, returns the average denominator log LL
+    // With reference alignment, this also writes the uids of the utterance.
+    double forwardbackward(const msra::dbn::latticepair& lattice, const utterancestripe& stripe,
+                           std::vector<size_t>& uids, std::vector<size_t>& boundaries, bool doreferencealign)
+    {
+        msra::dbn::matrixstripe predstripe(pred, stripe.ts, stripe.numframes);           // logLLs for this utterance
+        msra::dbn::matrixstripe dengammasstripe(dengammas, stripe.ts, stripe.numframes); // denominator gammas
+        array_ref<size_t> uidsstripe(&uids[stripe.ts], stripe.numframes);
+        array_ref<size_t> boundariesstripe(&boundaries[stripe.ts], doreferencealign ? stripe.numframes : 0);
+
+        // auto_timer dengammatimer;
+        return lattice.second.forwardbackward(parallellattice,
+                                              (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                              (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                              lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
+    }
 
-            // set gamma for multi channel
-            if (samplesInRecurrentStep > 1)
-            {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
-                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
-            }
+    // copies the gammas of an utterance into its columns of gammafromlattice, and its reference alignment into the labels
+    void setutterancegammas(const utterancestripe& stripe, Microsoft::MSR::CNTK::Matrix<ElemType>& gammafromlattice,
+                            Microsoft::MSR::CNTK::Matrix<ElemType>& labels, const std::vector<size_t>& uids,
+                            size_t samplesInRecurrentStep, bool doreferencealign, Microsoft::MSR::CNTK::Matrix<ElemType>& tempmatrix)
+    {
+        const size_t numframes = stripe.numframes;
+        if (samplesInRecurrentStep == 1)
+        {
+            tempmatrix = gammafromlattice.ColumnSlice(stripe.ts, numframes);
+        }
+
+        // copy gamma to tempmatrix
+        if (m_deviceid == CPUDEVICE)
+        {
+            msra::dbn::matrixstripe dengammasstripe(dengammas, stripe.ts, numframes);
+            CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, dengammasstripe.rows(), numframes, tempmatrix, gammafromlattice.GetDeviceId());
+        }
+        else
+            parallellattice.getgamma(tempmatrix);
+
+        // set gamma for multi channel
+        if (samplesInRecurrentStep > 1)
+        {
+            Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(stripe.mapi + (stripe.tbegin * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+            gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
+        }
 
-            if (doreferencealign)
+        if (doreferencealign)
+        {
+            for (size_t nframe = 0; nframe < numframes; nframe++)
             {
-                for (size_t nframe = 0; nframe < numframes; nframe++)
-                {
-                    size_t uid = uidsstripe[nframe];
-                    if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
-                    else
-                        labels(uid, ts + nframe) = 1.0;
-                }
+                size_t uid = uids[stripe.ts + nframe];
+                if (samplesInRecurrentStep > 1)
+                    labels(uid, (nframe + stripe.tbegin) * samplesInRecurrentStep + stripe.mapi) = 1.0;
+                else
+                    labels(uid, stripe.ts + nframe) = 1.0;
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
         }
-        functionValues.SetValue(objectValue);
     }
 
-private:
     // Helper methods for copying between ssematrix objects and CNTK matrices
     void CopyFromCNTKMatrixToSSEMatrix(const Microsoft::MSR::CNTK::Matrix<ElemType>& src, size_t numCols, msra::math::ssematrixbase& dest)
     {
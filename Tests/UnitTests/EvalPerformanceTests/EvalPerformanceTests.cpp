@@ -0,0 +1,372 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// EvalPerformanceTests.cpp : measures the latency and throughput of a model through the evaluation library.
+//
+// The model is evaluated on random inputs for every combination of interface, device, number of threads and batch
+// size given, the way a service would call the library:
+//
+//   EvalPerformanceTests configFile=<config file> [<name>=<value> ...]
+//
+//   precision = "float"            # float or double
+//   modelPath = "model.dnn"        # the model to evaluate
+//   outputNodeName = ""            # the output to evaluate, the first output of the model if empty
+//   interfaces = "extended:basic"  # IEvaluateModelExtended (ForwardPass/ForwardPassBatch) and/or IEvaluateModel (Evaluate)
+//   devices = -1                   # devices to evaluate on, -1 for the CPU
+//   threads = 1                    # numbers of threads calling the library at the same time, each with its own evaluator
+//   batchSizes = 1:8:32            # numbers of requests per call
+//   sequenceLength = 1             # samples per request of the extended interface; the basic one evaluates single samples
+//   iterations = 1000              # calls per thread
+//   warmup = 10                    # calls per thread before the measurement
+//   evalConfig = ""                # passed to Init() of the evaluators, e.g. "numCPUThreads=4 forwardReplay=true"
+//
+// For every combination, one line gives the p50 and p99 latency of a call, the samples/s of all threads together, and
+// the resident memory of the process after the run and its peak so far. Evaluators on the same device as another
+// thread's share their parameters (IEvaluateModelExtended::Clone()); the basic interface loads the model per thread.
+//
+#include "stdafx.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "Basics.h"
+#include "Config.h"
+#include "Eval.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+// Resident memory of the process and its peak, in MB.
+static void GetProcessMemory(double& residentMB, double& peakMB)
+{
+    residentMB = peakMB = 0;
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        residentMB = counters.WorkingSetSize / (1024.0 * 1024.0);
+        peakMB = counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+#else
+    long pages = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f)
+    {
+        if (fscanf(f, "%*ld %ld", &pages) != 1)
+            pages = 0;
+        fclose(f);
+    }
+    residentMB = pages * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        peakMB = usage.ru_maxrss / 1024.0; // in KB
+#endif
+}
+
+static void GetEvalExtended(IEvaluateModelExtended<float>** eval) { GetEvalExtendedF(eval); }
+static void GetEvalExtended(IEvaluateModelExtended<double>** eval) { GetEvalExtendedD(eval); }
+static void GetEval(IEvaluateModel<float>** eval) { GetEvalF(eval); }
+static void GetEval(IEvaluateModel<double>** eval) { GetEvalD(eval); }
+
+// random values for the given number of samples of an input; a single 1 per sample for sparse inputs
+template <class ElemType>
+static ValueBuffer<ElemType, Vector> CreateInput(const VariableLayout& layout, size_t numSamples, mt19937& rng)
+{
+    ValueBuffer<ElemType, Vector> buffer;
+    uniform_real_distribution<double> value(-1, 1);
+    if (layout.m_storageType == VariableLayout::Sparse)
+    {
+        uniform_int_distribution<int> index(0, (int)layout.m_numElements - 1);
+        buffer.m_colIndices.push_back(0);
+        for (size_t t = 0; t < numSamples; t++)
+        {
+            buffer.m_buffer.push_back(1);
+            buffer.m_indices.push_back(index(rng));
+            buffer.m_colIndices.push_back((int)buffer.m_buffer.size());
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < layout.m_numElements * numSamples; i++)
+            buffer.m_buffer.push_back((ElemType)value(rng));
+    }
+    return buffer;
+}
+
+// A thread's evaluator, and its inputs and outputs for one call.
+template <class ElemType>
+class Client
+{
+public:
+    virtual ~Client() {}
+    virtual void Evaluate() = 0;
+};
+
+template <class ElemType>
+class ExtendedClient : public Client<ElemType>
+{
+public:
+    ExtendedClient(IEvaluateModelExtended<ElemType>* eval, size_t batchSize, size_t sequenceLength, mt19937& rng)
+        : m_eval(eval)
+    {
+        auto inputSchema = m_eval->GetInputSchema();
+        auto outputSchema = m_eval->GetOutputSchema();
+        for (size_t r = 0; r < batchSize; r++)
+        {
+            Values<ElemType> inputs;
+            for (const auto& layout : inputSchema)
+                inputs.push_back(CreateInput<ElemType>(layout, sequenceLength, rng));
+            m_inputs.push_back(move(inputs));
+            m_outputs.push_back(outputSchema.template CreateBuffers<ElemType>(vector<size_t>(outputSchema.size(), sequenceLength)));
+        }
+    }
+
+    ~ExtendedClient()
+    {
+        m_eval->Destroy();
+    }
+
+    virtual void Evaluate() override
+    {
+        if (m_inputs.size() == 1)
+            m_eval->ForwardPass(m_inputs[0], m_outputs[0]);
+        else
+            m_eval->ForwardPassBatch(m_inputs, m_outputs);
+    }
+
+private:
+    IEvaluateModelExtended<ElemType>* m_eval;
+    vector<Values<ElemType>> m_inputs;
+    vector<Values<ElemType>> m_outputs;
+};
+
+template <class ElemType>
+class BasicClient : public Client<ElemType>
+{
+public:
+    BasicClient(IEvaluateModel<ElemType>* eval, const wstring& outputName, size_t batchSize, mt19937& rng)
+        : m_eval(eval)
+    {
+        map<wstring, size_t> inputDimensions;
+        map<wstring, size_t> outputDimensions;
+        m_eval->GetNodeDimensions(inputDimensions, nodeInput);
+        m_eval->GetNodeDimensions(outputDimensions, nodeOutput);
+        uniform_real_distribution<double> value(-1, 1);
+        for (const auto& input : inputDimensions)
+        {
+            m_values.push_back(make_shared<vector<ElemType>>(input.second * batchSize));
+            for (auto& v : *m_values.back())
+                v = (ElemType)value(rng);
+            m_inputs[input.first] = m_values.back().get();
+        }
+        m_values.push_back(make_shared<vector<ElemType>>(outputDimensions[outputName] * batchSize));
+        m_outputs[outputName] = m_values.back().get();
+    }
+
+    ~BasicClient()
+    {
+        m_eval->Destroy();
+    }
+
+    virtual void Evaluate() override
+    {
+        m_eval->Evaluate(m_inputs, m_outputs);
+    }
+
+private:
+    IEvaluateModel<ElemType>* m_eval;
+    vector<shared_ptr<vector<ElemType>>> m_values;
+    map<wstring, vector<ElemType>*> m_inputs;
+    map<wstring, vector<ElemType>*> m_outputs;
+};
+
+// Runs the calls of all clients, one thread each, and prints the results of the run.
+template <class ElemType>
+static void Measure(vector<unique_ptr<Client<ElemType>>>& clients, size_t samplesPerCall, size_t iterations, size_t warmup, const char* description)
+{
+    vector<vector<double>> latencies(clients.size());
+    vector<thread> threads;
+    vector<exception_ptr> errors(clients.size());
+    auto start = chrono::steady_clock::now();
+    for (size_t c = 0; c < clients.size(); c++)
+    {
+        threads.push_back(thread([&, c]()
+        {
+            try
+            {
+                for (size_t i = 0; i < warmup; i++)
+                    clients[c]->Evaluate();
+                latencies[c].reserve(iterations);
+                for (size_t i = 0; i < iterations; i++)
+                {
+                    auto callStart = chrono::steady_clock::now();
+                    clients[c]->Evaluate();
+                    latencies[c].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - callStart).count());
+                }
+            }
+            catch (...)
+            {
+                errors[c] = current_exception();
+            }
+        }));
+    }
+    for (auto& t : threads)
+        t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (const auto& error : errors)
+    {
+        if (error)
+            rethrow_exception(error);
+    }
+
+    vector<double> all;
+    for (const auto& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    auto percentile = [&all](double p) { return all.empty() ? 0.0 : all[min(all.size() - 1, (size_t)(p * all.size()))]; };
+
+    // the warm-up calls overlap with the measured calls of other threads, so the elapsed time includes them
+    size_t numCalls = clients.size() * (iterations + warmup);
+    double residentMB, peakMB;
+    GetProcessMemory(residentMB, peakMB);
+    fprintf(stderr, "%s: p50 %.3fms, p99 %.3fms, %.1f samples/s, resident %.1fMB, peak %.1fMB\n",
+            description, percentile(0.5), percentile(0.99), seconds > 0 ? numCalls * samplesPerCall / seconds : 0.0, residentMB, peakMB);
+}
+
+template <class ElemType>
+static void MeasureEval(const ConfigParameters& config)
+{
+    string modelPath = config(L"modelPath");
+    wstring outputName = config(L"outputNodeName", L"");
+    vector<wstring> interfaces = config(L"interfaces", ConfigParameters::Array(stringargvector(vector<wstring>{ L"extended", L"basic" })));
+    intargvector devices = config(L"devices", ConfigParameters::Array(intargvector(vector<int>{ -1 })));
+    intargvector threadCounts = config(L"threads", ConfigParameters::Array(intargvector(vector<int>{ 1 })));
+    intargvector batchSizes = config(L"batchSizes", ConfigParameters::Array(intargvector(vector<int>{ 1, 8, 32 })));
+    size_t sequenceLength = config(L"sequenceLength", (size_t)1);
+    size_t iterations = config(L"iterations", (size_t)1000);
+    size_t warmup = config(L"warmup", (size_t)10);
+    string evalConfig = config(L"evalConfig", "");
+
+    mt19937 rng(0);
+    for (const auto& interfaceName : interfaces)
+    {
+        bool isExtended = (interfaceName == L"extended");
+        if (!isExtended && interfaceName != L"basic")
+            InvalidArgument("Unknown interface '%ls', must be 'extended' or 'basic'.", interfaceName.c_str());
+
+        for (int device : devices)
+        {
+            string networkDescription = "modelPath=\"" + modelPath + "\"\ndeviceId=" + to_string(device) + "\n";
+            for (int numThreads : threadCounts)
+            {
+                for (int batchSize : batchSizes)
+                {
+                    vector<unique_ptr<Client<ElemType>>> clients;
+                    IEvaluateModelExtended<ElemType>* first = nullptr;
+                    for (int c = 0; c < numThreads; c++)
+                    {
+                        if (isExtended)
+                        {
+                            IEvaluateModelExtended<ElemType>* eval;
+                            if (first)
+                                eval = first->Clone();
+                            else
+                            {
+                                GetEvalExtended(&eval);
+                                eval->Init(evalConfig);
+                                eval->CreateNetwork(networkDescription);
+                                first = eval;
+                                if (outputName.empty())
+                                    outputName = eval->GetOutputSchema()[0].m_name;
+                            }
+                            eval->StartForwardEvaluation({ outputName });
+                            clients.push_back(unique_ptr<Client<ElemType>>(new ExtendedClient<ElemType>(eval, batchSize, sequenceLength, rng)));
+                        }
+                        else
+                        {
+                            IEvaluateModel<ElemType>* eval;
+                            GetEval(&eval);
+                            eval->Init(evalConfig);
+                            eval->CreateNetwork(networkDescription);
+                            if (outputName.empty())
+                            {
+                                map<wstring, size_t> outputDimensions;
+                                eval->GetNodeDimensions(outputDimensions, nodeOutput);
+                                outputName = outputDimensions.begin()->first;
+                            }
+                            eval->StartEvaluateMinibatchLoop(outputName);
+                            clients.push_back(unique_ptr<Client<ElemType>>(new BasicClient<ElemType>(eval, outputName, batchSize, rng)));
+                        }
+                    }
+
+                    string description = msra::strfun::strprintf("%ls, device %d, %d threads, batch %d", interfaceName.c_str(), device, numThreads, batchSize);
+                    Measure(clients, batchSize * (isExtended ? sequenceLength : 1), iterations, warmup, description.c_str());
+                }
+            }
+        }
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        ConfigParameters config;
+        const std::string rawConfigString = ConfigParameters::ParseCommandLine(argc, argv, config);
+        config.ResolveVariables(rawConfigString);
+
+        string precision = config(L"precision", "float");
+        if (precision == "float")
+        {
+            MeasureEval<float>(config);
+        }
+        else if (precision == "double")
+        {
+            MeasureEval<double>(config);
+        }
+        else
+        {
+            InvalidArgument("The 'precision' parameter must be 'float' or 'double'.");
+        }
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef __UNIX__
+// UNIX main function converts arguments in UTF-8 encoding and passes to Visual-Studio style wmain() which takes wchar_t strings.
+int main(int argc, char* argv[])
+{
+    vector<wstring> arguments;
+    for (int i = 0; i < argc; ++i)
+    {
+        arguments.push_back(msra::strfun::utf16(argv[i]));
+    }
+
+    vector<wchar_t*> wargv;
+    for (auto& argument : arguments)
+    {
+        wargv.push_back(&argument[0]);
+    }
+    return wmain(argc, wargv.data());
+}
+#endif
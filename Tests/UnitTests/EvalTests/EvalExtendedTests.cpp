@@ -5,8 +5,12 @@
 
 #include "stdafx.h"
 #include "EvalTestHelper.h"
+#include "BatchingEval.h"
+#include "DevicePoolEval.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <algorithm>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -284,5 +288,340 @@ BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalBindBuffersTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    BOOST_REQUIRE_THROW(eval->ForwardPass(), std::exception); // Nothing bound
+
+    std::vector<float> input{ 1, 2, 3, 4 };
+    std::vector<float> output;
+    ValueRefs<float> inputRefs(1);
+    inputRefs[0].m_buffer.InitFrom(input);
+    ValueRefs<float> outputRefs(1);
+    outputRefs[0].m_buffer.InitFrom(output);
+    BOOST_REQUIRE_THROW(eval->BindBuffers(inputRefs, outputRefs), std::exception); // Not enough capacity in output.
+
+    output.reserve(1);
+    outputRefs[0].m_buffer.InitFrom(output);
+    eval->BindBuffers(inputRefs, outputRefs);
+    BOOST_REQUIRE_EQUAL(outputRefs[0].m_buffer.size(), 1);
+    BOOST_CHECK_EQUAL(output.data()[0], 20);
+
+    // The network reads the inputs and writes the outputs in place.
+    for (int i = 1; i <= 3; i++)
+    {
+        std::fill(input.begin(), input.end(), (float)i);
+        eval->ForwardPass();
+        BOOST_CHECK_EQUAL(output.data()[0], 8 * i);
+    }
+
+    // Evaluating other buffers ends the binding.
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 1, 1, 1 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    eval->ForwardPass(inputBuffer, outputBuffer);
+    BOOST_CHECK_EQUAL(outputBuffer[0].m_buffer[0], 8);
+    BOOST_CHECK_EQUAL(output.data()[0], 24);
+    BOOST_REQUIRE_THROW(eval->ForwardPass(), std::exception);
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "o1 = Times(Constant(2, rows=1, cols=2), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // Requests of different lengths are evaluated together, each as its own sequence.
+    std::vector<Values<float>> inputs(3, Values<float>(1));
+    inputs[0][0].m_buffer = { 1, 2 };
+    inputs[1][0].m_buffer = { 1, 1, 2, 2, 3, 3 };
+    inputs[2][0].m_buffer = { 5, 0, 0, 5 };
+    std::vector<Values<float>> outputs;
+    for (size_t r = 0; r < inputs.size(); r++)
+        outputs.push_back(outputLayouts.CreateBuffers<float>({ 3 }));
+
+    eval->ForwardPassBatch(inputs, outputs);
+
+    std::vector<std::vector<float>> expected{ { 6 }, { 4, 8, 12 }, { 10, 10 } };
+    for (size_t r = 0; r < inputs.size(); r++)
+    {
+        auto buf = outputs[r][0].m_buffer;
+        BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[r].begin(), expected[r].end());
+    }
+
+    outputs[1] = outputLayouts.CreateBuffers<float>({ 1 });
+    BOOST_REQUIRE_THROW(eval->ForwardPassBatch(inputs, outputs), std::exception); // Not enough capacity in output.
+
+    // The batching evaluator gives each request its own results.
+    {
+        BatchingEvaluator<float> batching(eval, 2, std::chrono::milliseconds(10));
+        std::vector<std::future<Values<float>>> results;
+        for (const auto& input : inputs)
+            results.push_back(batching.ForwardPass(input));
+
+        for (size_t r = 0; r < inputs.size(); r++)
+        {
+            auto buf = results[r].get()[0].m_buffer;
+            BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected[r].begin(), expected[r].end());
+        }
+
+        Values<float> wrongInput(1);
+        wrongInput[0].m_buffer = { 1, 2, 3 };
+        auto result = batching.ForwardPass(wrongInput);
+        BOOST_REQUIRE_THROW(result.get(), std::exception); // Not a multiple of the input dimension.
+    }
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalStreamsTest)
+{
+    // Running sum over the sequence.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "p1 = PastValue(1, o1, timeStep=1, defaultHiddenActivity=0) \n"
+        "o1 = Plus(i1, p1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    auto forwardPass = [&](const std::vector<size_t>& streamIds, const std::vector<std::vector<float>>& pieces)
+    {
+        std::vector<Values<float>> inputs(pieces.size(), Values<float>(1));
+        std::vector<Values<float>> outputs;
+        for (size_t r = 0; r < pieces.size(); r++)
+        {
+            inputs[r][0].m_buffer = pieces[r];
+            outputs.push_back(outputLayouts.CreateBuffers<float>({ pieces[r].size() }));
+        }
+        eval->ForwardPassStreams(streamIds, inputs, outputs);
+
+        std::vector<std::vector<float>> results;
+        for (const auto& output : outputs)
+            results.push_back(output[0].m_buffer);
+        return results;
+    };
+
+    auto results = forwardPass({ 7, 8 }, { { 1, 2 }, { 10 } });
+    BOOST_CHECK(results == (std::vector<std::vector<float>>{ { 1, 3 }, { 10 } }));
+
+    // Continued streams carry over their sums, a new stream starts from zero.
+    results = forwardPass({ 8, 9, 7 }, { { 20, 30 }, { 5 }, { 3 } });
+    BOOST_CHECK(results == (std::vector<std::vector<float>>{ { 30, 60 }, { 5 }, { 6 } }));
+
+    eval->EndStream(7);
+    results = forwardPass({ 7 }, { { 1 } });
+    BOOST_CHECK(results == (std::vector<std::vector<float>>{ { 1 } }));
+
+    BOOST_REQUIRE_THROW(forwardPass({ 8, 8 }, { { 1 }, { 1 } }), std::exception); // A stream can only be continued once per call.
+
+    // Independent evaluation does not see the streams.
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 4, 4 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 2 });
+    eval->ForwardPass(inputBuffer, outputBuffer);
+    std::vector<float> expected{ 4, 8 };
+    auto buf = outputBuffer[0].m_buffer;
+    BOOST_CHECK_EQUAL_COLLECTIONS(buf.begin(), buf.end(), expected.begin(), expected.end());
+
+    results = forwardPass({ 8 }, { { 1 } });
+    BOOST_CHECK(results == (std::vector<std::vector<float>>{ { 61 } }));
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalCloneTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    IEvaluateModelExtended<float>* clone = eval->Clone();
+    clone->StartForwardEvaluation({ outputLayouts[0].m_name });
+
+    // Both evaluators run at the same time, each on its own inputs.
+    auto forwardPass = [](IEvaluateModelExtended<float>* e, float x, std::vector<float>& result)
+    {
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { x, x, x, x };
+        Values<float> outputBuffer = e->GetOutputSchema().CreateBuffers<float>({ 1 });
+        for (int i = 0; i < 100; i++)
+        {
+            e->ForwardPass(inputBuffer, outputBuffer);
+            result.push_back(outputBuffer[0].m_buffer[0]);
+        }
+    };
+
+    std::vector<float> evalResults;
+    std::vector<float> cloneResults;
+    std::thread evalThread(forwardPass, eval, 1.0f, std::ref(evalResults));
+    std::thread cloneThread(forwardPass, clone, 2.0f, std::ref(cloneResults));
+    evalThread.join();
+    cloneThread.join();
+
+    BOOST_CHECK(std::all_of(evalResults.begin(), evalResults.end(), [](float v) { return v == 8; }));
+    BOOST_CHECK(std::all_of(cloneResults.begin(), cloneResults.end(), [](float v) { return v == 16; }));
+
+    // The clone keeps the shared parameters alive.
+    eval->Destroy();
+    cloneResults.clear();
+    forwardPass(clone, 3.0f, cloneResults);
+    BOOST_CHECK_EQUAL(cloneResults.back(), 24);
+
+    clone->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalOutputPostProcessingTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Plus(i1, Constant(0, rows=4), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 0.1f, 0.7f, 0.2f, 0.0f, 0.5f, 0.1f, 0.3f, 0.9f };
+
+    auto forwardPass = [&](const OutputPostProcessing& postProcessing, size_t numElements)
+    {
+        eval->SetOutputPostProcessing(L"o1", postProcessing);
+        auto schema = eval->GetOutputSchema();
+        BOOST_CHECK_EQUAL(schema[0].m_numElements, numElements);
+        Values<float> outputBuffer = schema.CreateBuffers<float>({ 2 });
+        eval->ForwardPass(inputBuffer, outputBuffer);
+        return std::vector<float>(outputBuffer[0].m_buffer.begin(), outputBuffer[0].m_buffer.end());
+    };
+
+    auto argmax = forwardPass(OutputPostProcessing(OutputPostProcessing::Argmax), 1);
+    std::vector<float> expectedArgmax{ 1, 3 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(argmax.begin(), argmax.end(), expectedArgmax.begin(), expectedArgmax.end());
+
+    auto topK = forwardPass(OutputPostProcessing(OutputPostProcessing::TopK, 2), 4);
+    std::vector<float> expectedTopK{ 1, 2, 0.7f, 0.2f, 3, 0, 0.9f, 0.5f };
+    BOOST_CHECK_EQUAL_COLLECTIONS(topK.begin(), topK.end(), expectedTopK.begin(), expectedTopK.end());
+
+    auto hardmax = forwardPass(OutputPostProcessing(OutputPostProcessing::Hardmax), 4);
+    std::vector<float> expectedHardmax{ 0, 1, 0, 0, 0, 0, 0, 1 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(hardmax.begin(), hardmax.end(), expectedHardmax.begin(), expectedHardmax.end());
+
+    auto none = forwardPass(OutputPostProcessing(), 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS(none.begin(), none.end(), inputBuffer[0].m_buffer.begin(), inputBuffer[0].m_buffer.end());
+
+    BOOST_REQUIRE_THROW(eval->SetOutputPostProcessing(L"o1", OutputPostProcessing(OutputPostProcessing::TopK, 5)), std::exception);
+    BOOST_REQUIRE_THROW(eval->SetOutputPostProcessing(L"i1", OutputPostProcessing(OutputPostProcessing::Argmax)), std::exception);
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalDevicePoolTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    // Two replicas on the CPU, the second one a clone of the first.
+    DevicePoolEvaluator<float> pool(modelDefinition, { L"o1" }, { -1, -1 });
+    BOOST_CHECK(pool.GetDevices() == std::vector<int>({ -1, -1 }));
+    BOOST_CHECK_EQUAL(pool.GetInputSchema()[0].m_numElements, (size_t)4);
+
+    // Calls from several threads run on both replicas.
+    auto forwardPass = [&pool](float x, std::vector<float>& result)
+    {
+        Values<float> inputBuffer(1);
+        inputBuffer[0].m_buffer = { x, x, x, x };
+        Values<float> outputBuffer = pool.GetOutputSchema().CreateBuffers<float>({ 1 });
+        for (int i = 0; i < 100; i++)
+        {
+            pool.ForwardPass(inputBuffer, outputBuffer);
+            result.push_back(outputBuffer[0].m_buffer[0]);
+        }
+    };
+
+    std::vector<float> results1;
+    std::vector<float> results2;
+    std::thread thread1(forwardPass, 1.0f, std::ref(results1));
+    std::thread thread2(forwardPass, 2.0f, std::ref(results2));
+    thread1.join();
+    thread2.join();
+
+    BOOST_CHECK(std::all_of(results1.begin(), results1.end(), [](float v) { return v == 8; }));
+    BOOST_CHECK(std::all_of(results2.begin(), results2.end(), [](float v) { return v == 16; }));
+
+    std::vector<Values<float>> inputs(2, Values<float>(1));
+    inputs[0][0].m_buffer = { 1, 1, 1, 1 };
+    inputs[1][0].m_buffer = { 1, 1, 1, 1, 3, 3, 3, 3 };
+    std::vector<Values<float>> outputs(2, pool.GetOutputSchema().CreateBuffers<float>({ 2 }));
+    pool.ForwardPassBatch(inputs, outputs);
+    BOOST_CHECK_EQUAL(outputs[1][0].m_buffer.size(), (size_t)2);
+    BOOST_CHECK_EQUAL(outputs[1][0].m_buffer[1], 24);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
\ No newline at end of file
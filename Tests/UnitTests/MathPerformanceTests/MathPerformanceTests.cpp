@@ -2,158 +2,656 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
-// MathPerformanceTests.cpp : Defines the entry point for the console application.
+// MathPerformanceTests.cpp : Micro-benchmarks of the Math library kernels.
+//
+// Each benchmark runs its kernel a few times to warm up (allocations, auto-tuning, caches), and then times a number of
+// repetitions, of which it reports the minimum, median, mean and standard deviation, and the throughput at the median.
+// GPU work is synchronized after each repetition by reading back an element of the result, so the times include
+// the kernel launches, as in training. The results can be written as JSON, to compare machines and releases.
+//
+// Usage: MathPerformanceTests [-device cpu|gpu|all] [-gpu <id>] [-type float|double|all] [-warmup <n>] [-repeat <n>]
+//                             [-filter <substring of benchmark names>] [-json <file>] [-label <text>] [-checkTensorOps]
 //
 #include "stdafx.h"
-//#define NOMINMAX
-//#include "Windows.h"
 #include "Matrix.h"
 #include "CPUMatrix.h"
 #include "TensorView.h"
 #include "Sequences.h"
+#include "ConvolutionEngine.h"
+#include "BatchNormalizationEngine.h"
+#include "MatrixQuantizerImpl.h"
+#include "QuantizedMatrix.h"
+#include "CUDAPageLockedMemAllocator.h"
 #include <chrono>
+#include <ctime>
+#include <cmath>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 #include <algorithm>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
 
-template <class ElemType>
-void randomInitializeCPUMatrix(CPUMatrix<ElemType>& M, float min = -10, float max = 10)
+// -----------------------------------------------------------------------
+// benchmark runner
+// -----------------------------------------------------------------------
+
+struct BenchmarkOptions
+{
+    vector<DEVICEID_TYPE> devices;
+    bool runFloat = true;
+    bool runDouble = true;
+    size_t warmup = 2;
+    size_t repetitions = 10;
+    string filter;      // only benchmarks whose names contain it
+    wstring jsonPath;   // if not empty, the results are written there
+    string label;       // e.g. the machine, stored in the JSON output
+    bool checkTensorOps = false;
+};
+
+struct BenchmarkResult
 {
-    foreach_coord (i, j, M)
+    string name;
+    string elementType;
+    DEVICEID_TYPE deviceId;
+    string unit;            // what 'work' counts: "flop" or "byte"
+    double work;            // per repetition
+    vector<double> seconds; // of the repetitions
+    string error;           // why the benchmark could not run, e.g. an engine that is not supported on the device
+
+    double Min() const { return *min_element(seconds.begin(), seconds.end()); }
+    double Max() const { return *max_element(seconds.begin(), seconds.end()); }
+    double Mean() const { double sum = 0; for (auto s : seconds) sum += s; return sum / seconds.size(); }
+    double Median() const
     {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
+        vector<double> sorted(seconds);
+        sort(sorted.begin(), sorted.end());
+        size_t n = sorted.size();
+        return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
     }
+    double StdDev() const
+    {
+        double mean = Mean(), sum = 0;
+        for (auto s : seconds)
+            sum += (s - mean) * (s - mean);
+        return seconds.size() > 1 ? sqrt(sum / (seconds.size() - 1)) : 0;
+    }
+    double Throughput() const { return work / Median(); } // per second
+};
+
+template <class ElemType> const char* ElemTypeName();
+template <> const char* ElemTypeName<float>() { return "float"; }
+template <> const char* ElemTypeName<double>() { return "double"; }
+
+static string DeviceName(DEVICEID_TYPE deviceId)
+{
+    return deviceId == CPUDEVICE ? "cpu" : "gpu" + to_string(deviceId);
 }
 
+// Waits for the kernels that compute the matrix.
 template <class ElemType>
-void randomInitializeMatrix(Matrix<ElemType>& M, float min = -10, float max = 10)
+static void Synchronize(const Matrix<ElemType>& m)
+{
+    if (m.GetDeviceId() != CPUDEVICE)
+        m.Get00Element();
+}
+
+template <class ElemType>
+static void Synchronize(const TensorView<ElemType>& t)
+{
+    Synchronize(t.GetSOB());
+}
+
+class BenchmarkRunner
+{
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions& options)
+        : m_options(options)
+    {
+    }
+
+    // 'setup' creates the operands, and returns the function to time, which must synchronize the device.
+    template <class ElemType>
+    void Run(const string& name, DEVICEID_TYPE deviceId, const char* unit, double work, const function<function<void()>()>& setup)
+    {
+        if (!m_options.filter.empty() && name.find(m_options.filter) == string::npos)
+            return;
+
+        BenchmarkResult result;
+        result.name = name;
+        result.elementType = ElemTypeName<ElemType>();
+        result.deviceId = deviceId;
+        result.unit = unit;
+        result.work = work;
+        try
+        {
+            auto fn = setup();
+            for (size_t i = 0; i < m_options.warmup; i++)
+                fn();
+            for (size_t i = 0; i < m_options.repetitions; i++)
+            {
+                auto start = chrono::high_resolution_clock::now();
+                fn();
+                auto end = chrono::high_resolution_clock::now();
+                result.seconds.push_back(chrono::duration<double>(end - start).count());
+            }
+        }
+        catch (const exception& e)
+        {
+            result.seconds.clear();
+            result.error = e.what();
+        }
+
+        Print(result);
+        m_results.push_back(result);
+    }
+
+    void WriteJson(const wstring& path) const;
+
+private:
+    static void Print(const BenchmarkResult& r)
+    {
+        if (!r.error.empty())
+        {
+            printf("%-48s %-6s %-5s  skipped: %s\n", r.name.c_str(), r.elementType.c_str(), DeviceName(r.deviceId).c_str(), r.error.c_str());
+        }
+        else
+        {
+            printf("%-48s %-6s %-5s  median %10.4f ms  min %10.4f ms  stddev %5.1f%%  %9.2f G%s/s\n",
+                   r.name.c_str(), r.elementType.c_str(), DeviceName(r.deviceId).c_str(), r.Median() * 1e3, r.Min() * 1e3,
+                   100 * r.StdDev() / r.Mean(), r.Throughput() / 1e9, r.unit == "flop" ? "flop" : "B");
+        }
+        fflush(stdout);
+    }
+
+    const BenchmarkOptions& m_options;
+    vector<BenchmarkResult> m_results;
+};
+
+static string JsonString(const string& s)
 {
-    foreach_coord (i, j, M)
+    string result = "\"";
+    for (char c : s)
     {
-        M(i, j) = (1.0 * rand() / RAND_MAX) * max + min;
+        if (c == '"' || c == '\\')
+            (result += '\\') += c;
+        else if (c == '\n')
+            result += "\\n";
+        else if ((unsigned char) c < 0x20)
+            result += ' ';
+        else
+            result += c;
     }
+    return result + "\"";
 }
 
+void BenchmarkRunner::WriteJson(const wstring& path) const
+{
+    ofstream out(msra::strfun::utf8(path));
+    if (!out)
+        RuntimeError("Cannot open '%ls' for writing.", path.c_str());
+    out.precision(9);
+
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    out << "{\n"
+        << "  \"label\": " << JsonString(m_options.label) << ",\n"
+        << "  \"timestamp\": " << JsonString(timestamp) << ",\n"
+        << "  \"hardwareThreads\": " << thread::hardware_concurrency() << ",\n"
+        << "  \"warmup\": " << m_options.warmup << ",\n"
+        << "  \"repetitions\": " << m_options.repetitions << ",\n"
+        << "  \"results\": [";
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        const auto& r = m_results[i];
+        out << (i ? ",\n" : "\n") << "    { \"name\": " << JsonString(r.name)
+            << ", \"elementType\": " << JsonString(r.elementType)
+            << ", \"device\": " << JsonString(DeviceName(r.deviceId))
+            << ", \"unit\": " << JsonString(r.unit)
+            << ", \"work\": " << r.work;
+        if (!r.error.empty())
+        {
+            out << ", \"error\": " << JsonString(r.error) << " }";
+            continue;
+        }
+        out << ", \"minSeconds\": " << r.Min()
+            << ", \"medianSeconds\": " << r.Median()
+            << ", \"meanSeconds\": " << r.Mean()
+            << ", \"stdDevSeconds\": " << r.StdDev()
+            << ", \"maxSeconds\": " << r.Max()
+            << ", \"throughput\": " << r.Throughput()
+            << ", \"seconds\": [";
+        for (size_t k = 0; k < r.seconds.size(); k++)
+            out << (k ? ", " : "") << r.seconds[k];
+        out << "] }";
+    }
+    out << "\n  ]\n}\n";
+    if (!out)
+        RuntimeError("Error writing '%ls'.", path.c_str());
+}
+
+// -----------------------------------------------------------------------
+// benchmarks
+// -----------------------------------------------------------------------
+
 template <class ElemType>
-void MultiplyAndWeightedAddTest(int n, int k, int m)
+static shared_ptr<Matrix<ElemType>> RandomMatrix(size_t rows, size_t cols, DEVICEID_TYPE deviceId, unsigned long seed)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+    return make_shared<Matrix<ElemType>>(Matrix<ElemType>::RandomUniform(rows, cols, deviceId, -1, 1, seed));
 }
 
+// GEMM, C = A * B, with the shapes of fully connected and recurrent layers (m x k times k x n)
 template <class ElemType>
-void AddMultiplyAndInplaceSigmoidTest(int n, int k, int m)
+void GemmBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << k << ") and B(" << k << "," << m << ")" << endl;
-    CPUMatrix<ElemType> A(n, k);
-    randomInitializeCPUMatrix<ElemType>(A);
-    CPUMatrix<ElemType> B(k, m);
-    randomInitializeCPUMatrix<ElemType>(B);
-    CPUMatrix<ElemType> D(n, m);
-    randomInitializeCPUMatrix<ElemType>(D);
-    CPUMatrix<ElemType> C(n, m);
-    auto t_start = clock();
-    C = A * B + D;
-    // C.InplaceSigmoid();
-    auto t_end = clock();
-    std::cout << "CPU Matrix in: " << 1.0 * (t_end - t_start) / CLOCKS_PER_SEC << " seconds" << endl;
-    std::cout << n << " " << k << " " << m << endl;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> AG((size_t) n, (size_t) k);
-    randomInitializeMatrix<ElemType>(AG);
-    Matrix<ElemType> BG((size_t) k, (size_t) m);
-    randomInitializeMatrix<ElemType>(BG);
-    Matrix<ElemType> DG((size_t) n, (size_t) m);
-    randomInitializeMatrix<ElemType>(DG);
-    Matrix<ElemType> CG((size_t) n, (size_t) m);
-    auto t_startG = clock();
-    CG = AG * BG + DG;
-    // CG.InplaceSigmoid();
-    auto t_endG = clock();
-    std::cout << "Matrix in: " << 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC << " seconds" << endl;
+    struct Shape { size_t m, n, k; bool transA, transB; };
+    for (const auto& s : vector<Shape>{
+             { 256, 256, 256, false, false },
+             { 1024, 1024, 1024, false, false },
+             { 2048, 2048, 2048, false, false },
+             { 4096, 64, 1024, false, false },  // LSTM gates of a minibatch of 64
+             { 1024, 64, 4096, true, false },   // and the gradient of its input
+             { 4096, 1024, 64, false, true },   // and the gradient of its weights
+             { 1000, 256, 2048, false, false }, // output layer of an image classifier
+         })
+    {
+        string name = "gemm/" + string(s.transA ? "T" : "N") + (s.transB ? "T" : "N") + "/" +
+                      to_string(s.m) + "x" + to_string(s.n) + "x" + to_string(s.k);
+        runner.Run<ElemType>(name, deviceId, "flop", 2.0 * s.m * s.n * s.k, [=]() -> function<void()>
+        {
+            auto a = s.transA ? RandomMatrix<ElemType>(s.k, s.m, deviceId, 1) : RandomMatrix<ElemType>(s.m, s.k, deviceId, 1);
+            auto b = s.transB ? RandomMatrix<ElemType>(s.n, s.k, deviceId, 2) : RandomMatrix<ElemType>(s.k, s.n, deviceId, 2);
+            auto c = make_shared<Matrix<ElemType>>(s.m, s.n, deviceId);
+            return [=]()
+            {
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, *a, s.transA, *b, s.transB, 0, *c);
+                Synchronize(*c);
+            };
+        });
+    }
 }
 
+// TensorView elementwise, broadcasting and reducing operations; the work is the bytes read and written
 template <class ElemType>
-void SquareMultiplyAndAdd10TimesAvgTest(int n, int count)
+void TensorViewBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
 {
-    cout << "Testing CPUMatrix" << endl;
-    cout << "A(" << n << "x" << n << ") and B(" << n << "," << n << ")" << endl;
+    auto createTensor = [deviceId](const TensorShape& shape, unsigned long seed)
+    {
+        return TensorView<ElemType>(RandomMatrix<ElemType>(shape.GetNumElements(), 1, deviceId, seed), shape);
+    };
+    auto bytes = [](const TensorShape& shape) { return (double) shape.GetNumElements() * sizeof(ElemType); };
+
+    struct BinaryCase { string name; TensorShape a, b, c; };
+    for (const auto& t : vector<BinaryCase>{
+             { "tensor/sum/4096x4096", TensorShape(4096, 4096), TensorShape(4096, 4096), TensorShape(4096, 4096) },
+             { "tensor/biasAdd/1024x256+1024", TensorShape(1024, 256), TensorShape(1024), TensorShape(1024, 256) },
+             { "tensor/biasAdd/28x28x128x32+1x1x128", TensorShape(28, 28, 128, 32), TensorShape(1, 1, 128), TensorShape(28, 28, 128, 32) },
+             { "tensor/elementwiseProduct/4096x4096", TensorShape(4096, 4096), TensorShape(4096, 4096), TensorShape(4096, 4096) },
+         })
+    {
+        bool isProduct = t.name.find("Product") != string::npos;
+        runner.Run<ElemType>(t.name, deviceId, "byte", bytes(t.a) + bytes(t.b) + bytes(t.c), [=]() -> function<void()>
+        {
+            auto a = make_shared<TensorView<ElemType>>(createTensor(t.a, 1));
+            auto b = make_shared<TensorView<ElemType>>(createTensor(t.b, 2));
+            auto c = make_shared<TensorView<ElemType>>(createTensor(t.c, 3));
+            return [=]()
+            {
+                if (isProduct)
+                    c->AssignElementwiseProductOf(*a, *b);
+                else
+                    c->AssignSumOf(*a, *b);
+                Synchronize(*c);
+            };
+        });
+    }
 
-    double cpu_avg = 0;
-    for (int i = 0; i < count; ++i)
+    struct UnaryCase { string name; TensorShape a, c; };
+    for (const auto& t : vector<UnaryCase>{
+             { "tensor/sigmoid/4096x4096", TensorShape(4096, 4096), TensorShape(4096, 4096) },
+             { "tensor/reduceBiasGradient/2048x1024->2048", TensorShape(2048, 1024), TensorShape(2048) },
+             { "tensor/reduceBiasGradient/28x28x128x32->1x1x128", TensorShape(28, 28, 128, 32), TensorShape(1, 1, 128) },
+             { "tensor/reduceColumns/1024x4096->1x4096", TensorShape(1024, 4096), TensorShape(1, 4096) },
+         })
     {
-        CPUMatrix<ElemType> A(n, n);
-        randomInitializeCPUMatrix<ElemType>(A);
-        CPUMatrix<ElemType> B(n, n);
-        randomInitializeCPUMatrix<ElemType>(B);
-        CPUMatrix<ElemType> C(n, n);
-        auto t_start = clock();
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(0.324, A, false, B, false, 0.632, C);
-        auto t_end = clock();
-        double val = 1.0 * (t_end - t_start) / CLOCKS_PER_SEC;
-        if (i == 0)
-        {
-            cpu_avg = val;
-        }
-        else
+        bool isSigmoid = t.name.find("sigmoid") != string::npos;
+        runner.Run<ElemType>(t.name, deviceId, "byte", bytes(t.a) + bytes(t.c), [=]() -> function<void()>
         {
-            cpu_avg = cpu_avg * (i - 1) / i + val / i;
-        }
+            auto a = make_shared<TensorView<ElemType>>(createTensor(t.a, 1));
+            auto c = make_shared<TensorView<ElemType>>(createTensor(t.c, 2));
+            return [=]()
+            {
+                if (isSigmoid)
+                    c->AssignSigmoidOf(*a);
+                else
+                    c->AssignCopyOf(*a);
+                Synchronize(*c);
+            };
+        });
     }
+}
 
-    cout << "Testing Matrix" << endl;
-    double m_avg = 0;
-    for (int i = 0; i < count; ++i)
+// Products of dense matrices with sparse CSC inputs, as of embedding and bag-of-words layers; the work is the
+// floating-point operations on the non-zero elements.
+template <class ElemType>
+void SparseBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const size_t hidden = 512, vocabulary = 32768, batch = 256;
+    const double density = 0.001;
+
+    // uniform in [low, 0.1], truncated at 0: 'density' of the elements are positive
+    auto createSparse = [=]()
+    {
+        ElemType low = (ElemType) (-0.1 * (1 - density) / density);
+        Matrix<ElemType> dense(Matrix<ElemType>::RandomUniform(vocabulary, batch, CPUDEVICE, low, (ElemType) 0.1, 3));
+        dense.AssignTruncateBottomOf(dense, 0);
+        auto sparse = make_shared<Matrix<ElemType>>(dense.DeepClone(), deviceId);
+        sparse->SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+        return sparse;
+    };
+    size_t expectedNnz = (size_t) (density * vocabulary * batch);
+
+    // forward: W * X
+    runner.Run<ElemType>("sparse/denseTimesSparse/512x32768*32768x256", deviceId, "flop", 2.0 * hidden * expectedNnz, [=]() -> function<void()>
     {
-        Matrix<ElemType> AG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(AG);
-        Matrix<ElemType> BG((size_t) n, (size_t) n);
-        randomInitializeMatrix<ElemType>(BG);
-        Matrix<ElemType> CG((size_t) n, (size_t) n);
-        auto t_startG = clock();
-        Matrix<ElemType>::MultiplyAndWeightedAdd(0.324, AG, false, BG, false, 0.632, CG);
-        auto t_endG = clock();
-        double val = 1.0 * (t_endG - t_startG) / CLOCKS_PER_SEC;
-        if (i == 0)
-        {
-            m_avg = val;
+        auto x = createSparse();
+        auto w = RandomMatrix<ElemType>(hidden, vocabulary, deviceId, 1);
+        auto y = make_shared<Matrix<ElemType>>(hidden, batch, deviceId);
+        return [=]()
+        {
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *w, false, *x, false, 0, *y);
+            Synchronize(*y);
+        };
+    });
+
+    // gradient of W: G * X^T, added to a dense gradient
+    runner.Run<ElemType>("sparse/denseTimesSparseT/512x256*256x32768", deviceId, "flop", 2.0 * hidden * expectedNnz, [=]() -> function<void()>
+    {
+        auto x = createSparse();
+        auto g = RandomMatrix<ElemType>(hidden, batch, deviceId, 1);
+        auto w = RandomMatrix<ElemType>(hidden, vocabulary, deviceId, 2);
+        return [=]()
+        {
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *g, false, *x, true, 1, *w);
+            Synchronize(*w);
+        };
+    });
+
+    // gradient of W into a sparse block-column matrix, as done for sparse inputs on GPUs
+    runner.Run<ElemType>("sparse/denseTimesSparseTAsBlockCol/512x256*256x32768", deviceId, "flop", 2.0 * hidden * expectedNnz, [=]() -> function<void()>
+    {
+        auto x = createSparse();
+        auto g = RandomMatrix<ElemType>(hidden, batch, deviceId, 1);
+        auto wGradient = make_shared<Matrix<ElemType>>(hidden, vocabulary, deviceId, MatrixType::SPARSE, matrixFormatSparseBlockCol);
+        return [=]()
+        {
+            Matrix<ElemType>::MultiplyAndWeightedAdd(1, *g, false, *x, true, 0, *wGradient);
+            // a block-column matrix has no element to read back; reading another matrix waits as well
+            Synchronize(*g);
+        };
+    });
+}
+
+// Convolution and pooling, with each of the engines that supports the device; the Legacy engine works in HWC
+// layout, the others in CHW.
+template <class ElemType>
+void ConvolutionBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    using ConvEng = ConvolutionEngine<ElemType>;
+
+    struct ConvCase { string name; size_t width, channels, kernel, maps, stride, batch; };
+    struct EngineKind { string name; ConvolutionEngineKind kind; };
+    const vector<EngineKind> engines{
+        { "reference", ConvolutionEngineKind::Reference },
+        { "cudnn", ConvolutionEngineKind::CuDnn },
+        { "legacy", ConvolutionEngineKind::Legacy },
+        { "gemm", ConvolutionEngineKind::Gemm },
+        { "direct", ConvolutionEngineKind::Direct },
+    };
+
+    for (const auto& engine : engines)
+    {
+        ImageLayoutKind layout = engine.kind == ConvolutionEngineKind::Legacy ? ImageLayoutKind::HWC : ImageLayoutKind::CHW;
+        for (const auto& c : vector<ConvCase>{
+                 { "3x3/28x28x64->64", 28, 64, 3, 64, 1, 16 },
+                 { "1x1/14x14x256->64", 14, 256, 1, 64, 1, 16 },
+                 { "5x5s2/32x32x3->32", 32, 3, 5, 32, 2, 32 },
+             })
+        {
+            auto g = make_shared<ConvolveGeometry>(TensorShape(c.width, c.width, c.channels),
+                                                   TensorShape(c.kernel, c.kernel, c.channels), TensorShape(c.maps), TensorShape(c.stride, c.stride, c.channels),
+                                                   ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+                                                   TensorShape(0), TensorShape(0));
+            double flops = 2.0 * g->OutputShape().GetNumElements() * g->KernelShape().GetNumElements() * c.batch;
+
+            // operands of all passes
+            struct Operands
+            {
+                unique_ptr<ConvEng> engine;
+                shared_ptr<Matrix<ElemType>> in, kernel, out, grad, kernelGrad, workspace;
+            };
+            auto createOperands = [=]()
+            {
+                auto o = make_shared<Operands>();
+                o->engine = ConvEng::Create(g, deviceId, layout, 0, PoolKind::None, engine.kind);
+                size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+                o->in = RandomMatrix<ElemType>(g->InputShape().GetNumElements(), c.batch, deviceId, 1);
+                o->kernel = RandomMatrix<ElemType>(mapCount, g->KernelShape().GetNumElements(), deviceId, 2);
+                o->out = RandomMatrix<ElemType>(g->OutputShape().GetNumElements(), c.batch, deviceId, 3);
+                o->grad = RandomMatrix<ElemType>(g->InputShape().GetNumElements(), c.batch, deviceId, 4);
+                o->kernelGrad = RandomMatrix<ElemType>(mapCount, g->KernelShape().GetNumElements(), deviceId, 5);
+                o->workspace = make_shared<Matrix<ElemType>>(deviceId);
+                return o;
+            };
+
+            string prefix = "conv/" + engine.name + "/" + c.name;
+            runner.Run<ElemType>(prefix + "/forward", deviceId, "flop", flops, [=]() -> function<void()>
+            {
+                auto o = createOperands();
+                return [=]() { o->engine->Forward(*o->in, *o->kernel, *o->out, *o->workspace); Synchronize(*o->out); };
+            });
+            runner.Run<ElemType>(prefix + "/backwardData", deviceId, "flop", flops, [=]() -> function<void()>
+            {
+                auto o = createOperands();
+                return [=]() { o->engine->BackwardData(*o->out, *o->kernel, *o->grad, *o->workspace); Synchronize(*o->grad); };
+            });
+            runner.Run<ElemType>(prefix + "/backwardKernel", deviceId, "flop", flops, [=]() -> function<void()>
+            {
+                auto o = createOperands();
+                return [=]() { o->engine->BackwardKernel(*o->out, *o->in, *o->kernelGrad, false, *o->workspace); Synchronize(*o->kernelGrad); };
+            });
         }
-        else
+
+        // max pooling 3x3, stride 2, as in image classifiers; the work is the bytes of the input and the output
+        auto g = make_shared<ConvolveGeometry>(TensorShape(56, 56, 64), TensorShape(3, 3, 1), TensorShape(1), TensorShape(2, 2, 1),
+                                               ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+                                               TensorShape(0), TensorShape(0));
+        const size_t batch = 16;
+        double bytes = (double) (g->InputShape().GetNumElements() + g->OutputShape().GetNumElements()) * batch * sizeof(ElemType);
+        string prefix = "pool/" + engine.name + "/max3x3s2/56x56x64";
+        runner.Run<ElemType>(prefix + "/forward", deviceId, "byte", bytes, [=]() -> function<void()>
+        {
+            shared_ptr<ConvEng> eng = ConvEng::Create(g, deviceId, layout, 0, PoolKind::Max, engine.kind);
+            auto in = RandomMatrix<ElemType>(g->InputShape().GetNumElements(), batch, deviceId, 1);
+            auto out = RandomMatrix<ElemType>(g->OutputShape().GetNumElements(), batch, deviceId, 2);
+            return [=]() { eng->ForwardPooling(*in, *out); Synchronize(*out); };
+        });
+        runner.Run<ElemType>(prefix + "/backward", deviceId, "byte", bytes, [=]() -> function<void()>
         {
-            m_avg = m_avg * (i - 1) / i + val / i;
+            shared_ptr<ConvEng> eng = ConvEng::Create(g, deviceId, layout, 0, PoolKind::Max, engine.kind);
+            auto in = RandomMatrix<ElemType>(g->InputShape().GetNumElements(), batch, deviceId, 1);
+            auto out = make_shared<Matrix<ElemType>>(g->OutputShape().GetNumElements(), batch, deviceId);
+            auto srcGrad = RandomMatrix<ElemType>(g->OutputShape().GetNumElements(), batch, deviceId, 3);
+            auto grad = RandomMatrix<ElemType>(g->InputShape().GetNumElements(), batch, deviceId, 4);
+            eng->ForwardPooling(*in, *out);
+            return [=]() { eng->BackwardPooling(*out, *srcGrad, *in, *grad); Synchronize(*grad); };
+        });
+    }
+}
+
+// Batch normalization in training, spatial (after a convolution) and not; the work is the bytes of the input and the output
+template <class ElemType>
+void BatchNormalizationBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    using BNEng = BatchNormEngine<ElemType>;
+
+    struct EngineKind { string name; BatchNormEngineKind kind; };
+    struct BNCase { string name; TensorShape shape; size_t batch; bool spatial; };
+    for (const auto& engine : vector<EngineKind>{ { "cntk", BatchNormEngineKind::Cntk }, { "cudnn", BatchNormEngineKind::CuDnn } })
+    {
+        for (const auto& c : vector<BNCase>{
+                 { "spatial/28x28x64x32", TensorShape(28, 28, 64), 32, true },
+                 { "perActivation/1024x256", TensorShape(1024), 256, false },
+             })
+        {
+            size_t rows = c.shape.GetNumElements();
+            size_t statRows = c.spatial ? c.shape[2] : rows;
+            double bytes = 2.0 * rows * c.batch * sizeof(ElemType);
+
+            struct Operands
+            {
+                unique_ptr<BNEng> engine;
+                shared_ptr<Matrix<ElemType>> in, out, srcGrad, grad, scale, bias, runMean, runInvStdDev, saveMean, saveInvStdDev, scaleGrad, biasGrad;
+            };
+            auto createOperands = [=]()
+            {
+                auto o = make_shared<Operands>();
+                o->engine = BNEng::Create(deviceId, c.shape, c.spatial, ImageLayoutKind::CHW, engine.kind);
+                o->in = RandomMatrix<ElemType>(rows, c.batch, deviceId, 1);
+                o->out = make_shared<Matrix<ElemType>>(rows, c.batch, deviceId);
+                o->srcGrad = RandomMatrix<ElemType>(rows, c.batch, deviceId, 2);
+                o->grad = make_shared<Matrix<ElemType>>(rows, c.batch, deviceId);
+                o->scale = RandomMatrix<ElemType>(statRows, 1, deviceId, 3);
+                o->bias = RandomMatrix<ElemType>(statRows, 1, deviceId, 4);
+                o->runMean = make_shared<Matrix<ElemType>>(statRows, 1, deviceId);
+                o->runInvStdDev = make_shared<Matrix<ElemType>>(Matrix<ElemType>::RandomUniform(statRows, 1, deviceId, 1, 2, 5));
+                o->saveMean = make_shared<Matrix<ElemType>>(statRows, 1, deviceId);
+                o->saveInvStdDev = make_shared<Matrix<ElemType>>(statRows, 1, deviceId);
+                o->scaleGrad = make_shared<Matrix<ElemType>>(statRows, 1, deviceId);
+                o->biasGrad = make_shared<Matrix<ElemType>>(statRows, 1, deviceId);
+                return o;
+            };
+            auto forward = [](Operands& o)
+            {
+                o.engine->Forward(*o.in, *o.scale, *o.bias, 0.1, 0, *o.runMean, *o.runInvStdDev, *o.out, 1e-5, *o.saveMean, *o.saveInvStdDev);
+            };
+
+            string prefix = "batchNorm/" + engine.name + "/" + c.name;
+            runner.Run<ElemType>(prefix + "/forward", deviceId, "byte", bytes, [=]() -> function<void()>
+            {
+                auto o = createOperands();
+                return [=]() { forward(*o); Synchronize(*o->out); };
+            });
+            runner.Run<ElemType>(prefix + "/backward", deviceId, "byte", bytes, [=]() -> function<void()>
+            {
+                auto o = createOperands();
+                forward(*o);
+                return [=]()
+                {
+                    o->engine->Backward(*o->in, *o->srcGrad, *o->grad, *o->scale, 0, *o->saveMean, *o->saveInvStdDev, *o->scaleGrad, *o->biasGrad);
+                    Synchronize(*o->grad);
+                };
+            });
         }
     }
+}
+
+// Gradient quantization of data-parallel SGD, with the residual; the work is the bytes of the gradient
+template <class ElemType>
+void QuantizerBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    const size_t rows = 2048, cols = 1024;
+    for (size_t numBits : { 1, 8 })
+    {
+        struct Operands
+        {
+            unique_ptr<MemAllocator> allocator;
+            unique_ptr<MatrixQuantizerImpl<ElemType>> quantizer;
+            unique_ptr<QuantizedMatrix<ElemType>> quantized;
+            shared_ptr<Matrix<ElemType>> in, residual, out;
+        };
+        auto createOperands = [=]()
+        {
+            auto o = make_shared<Operands>();
+            o->allocator.reset(deviceId == CPUDEVICE ? nullptr : new CUDAPageLockedMemAllocator(deviceId));
+            o->quantizer.reset(MatrixQuantizerImpl<ElemType>::Create(deviceId, false /*useAsync*/));
+            o->quantized.reset(new QuantizedMatrix<ElemType>(rows, cols, numBits, CPUDEVICE, o->allocator.get()));
+            o->in = RandomMatrix<ElemType>(rows, cols, deviceId, 1);
+            o->residual = make_shared<Matrix<ElemType>>(rows, cols, deviceId);
+            o->out = make_shared<Matrix<ElemType>>(rows, cols, deviceId);
+            return o;
+        };
+        auto quantize = [](Operands& o)
+        {
+            o.quantizer->QuantizeAsync(*o.in, *o.residual, *o.quantized, *o.residual, false);
+            o.quantizer->WaitQuantizeAsyncDone();
+        };
 
-    cout << "Based on " << count << " runs:" << endl;
-    cout << "Average time for CPUMatrix is: " << cpu_avg << " seconds" << endl;
-    cout << "Average time for Matrix is: " << m_avg << " seconds" << endl;
-    cout << "CPUMatrix/Matrix ratio is: " << cpu_avg / m_avg << " seconds" << endl;
+        string prefix = "quantizer/" + to_string(numBits) + "bit/2048x1024";
+        runner.Run<ElemType>(prefix + "/quantize", deviceId, "byte", (double) rows * cols * sizeof(ElemType), [=]() -> function<void()>
+        {
+            auto o = createOperands();
+            return [=]() { quantize(*o); };
+        });
+        runner.Run<ElemType>(prefix + "/unquantize", deviceId, "byte", (double) rows * cols * sizeof(ElemType), [=]() -> function<void()>
+        {
+            auto o = createOperands();
+            quantize(*o);
+            return [=]()
+            {
+                o->quantizer->UnquantizeAsync(*o->quantized, *o->out, true);
+                o->quantizer->WaitUnquantizeAsyncDone();
+            };
+        });
+    }
+}
+
+// Copies between host and GPU memory (pageable host memory, as for minibatches); the work is the bytes copied
+template <class ElemType>
+void TransferBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    if (deviceId == CPUDEVICE)
+        return;
+
+    const size_t rows = 4096, cols = 4096;
+    double bytes = (double) rows * cols * sizeof(ElemType);
+    runner.Run<ElemType>("transfer/hostToDevice/4096x4096", deviceId, "byte", bytes, [=]() -> function<void()>
+    {
+        auto host = make_shared<vector<ElemType>>(rows * cols, (ElemType) 1);
+        auto m = make_shared<Matrix<ElemType>>(rows, cols, deviceId);
+        return [=]() { m->SetValue(rows, cols, deviceId, host->data()); Synchronize(*m); };
+    });
+    runner.Run<ElemType>("transfer/deviceToHost/4096x4096", deviceId, "byte", bytes, [=]() -> function<void()>
+    {
+        auto m = RandomMatrix<ElemType>(rows, cols, deviceId, 1);
+        auto host = make_shared<unique_ptr<ElemType[]>>(new ElemType[rows * cols]);
+        return [=]()
+        {
+            ElemType* data = host->get();
+            size_t size = rows * cols;
+            m->CopyToArray(data, size);
+            assert(data == host->get());
+        };
+    });
+}
+
+template <class ElemType>
+void RunBenchmarks(BenchmarkRunner& runner, DEVICEID_TYPE deviceId)
+{
+    GemmBenchmarks<ElemType>(runner, deviceId);
+    TensorViewBenchmarks<ElemType>(runner, deviceId);
+    SparseBenchmarks<ElemType>(runner, deviceId);
+    ConvolutionBenchmarks<ElemType>(runner, deviceId);
+    BatchNormalizationBenchmarks<ElemType>(runner, deviceId);
+    QuantizerBenchmarks<ElemType>(runner, deviceId);
+    TransferBenchmarks<ElemType>(runner, deviceId);
 }
 
 // simple test suite for TensorView
@@ -242,7 +740,7 @@ struct TensorTest
         // elementwise sum
         OneTensorTest("elementwise addition", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
         {
-            return BroadcastingTest(TensorShape{ 512, 256 }, TensorShape({ 512, 256 }), deviceId);
+            return BroadcastingTest(TensorShape(512, 256), TensorShape(512, 256), deviceId);
         });
 
         // --- broadcasting
@@ -250,18 +748,18 @@ struct TensorTest
         // simple broadcasting
         OneTensorTest("addition wth simple broadcasting", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
         {
-            return BroadcastingTest(TensorShape{ 3, 2 }, TensorShape({ 3, 1 }), deviceId);
+            return BroadcastingTest(TensorShape(3, 2), TensorShape(3, 1), deviceId);
         });
         // typical bias for convolutional layer
         OneTensorTest("bias addition (broadcasting)", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
         {
-            return BroadcastingTest(TensorShape{ 28, 28, 128, 32 }, TensorShape({ 1, 1, 128 }), deviceId);
+            return BroadcastingTest(TensorShape(28, 28, 128, 32), TensorShape(1, 1, 128), deviceId);
         });
         // BUGBUG: This test is strange--Print() shows different values with depth 128 instead of 64, but IsEqual() does not fail with 1e-3 tolerance.
         //         Something fishy going on. Dimension overflow?
         OneTensorTest("bias addition (broadcasting)", 1e-8, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
         {
-            return BroadcastingTest(TensorShape{ 256, 256, 64, 32 }, TensorShape({ 1, 1, 64 }), deviceId);
+            return BroadcastingTest(TensorShape(256, 256, 64, 32), TensorShape(1, 1, 64), deviceId);
         });
 
         // --- reduction
@@ -269,91 +767,125 @@ struct TensorTest
         // typical bias gradient (reduction) for FF-DNN
         OneTensorTest("bias gradient (reduction)", 1e-4, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
         {
-            return BiasGradientTest(TensorShape{ 2048, 1024 }, TensorShape(2048), deviceId);
+            return BiasGradientTest(TensorShape(2048, 1024), TensorShape(2048), deviceId);
         });
         // typical bias gradient (reduction) for convolutional layer
         OneTensorTest("bias gradient (reduction)", 1e-1, [](DEVICEID_TYPE deviceId) -> TensorView<ElemType>
         {
-            return BiasGradientTest(TensorShape{ 256, 256, 64, 32 }, TensorShape({ 1, 1, 64 }), deviceId);
+            return BiasGradientTest(TensorShape(256, 256, 64, 32), TensorShape(1, 1, 64), deviceId);
         });
     }
 };
 
-template <class ElemType>
-void MandSTest(int count, int devId)
+// -----------------------------------------------------------------------
+// main
+// -----------------------------------------------------------------------
+
+static void PrintUsage()
 {
-    ElemType* arr = new ElemType[count];
-    for (int i = 0; i < count; ++i)
-        arr[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data1 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data1[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data2 = new ElemType[1024 * 4096];
-    for (int i = 0; i < 1024 * 4096; ++i)
-        data2[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    ElemType* data3 = new ElemType[1024];
-    for (int i = 0; i < 1024; ++i)
-        data3[i] = (1.0 * rand()) / RAND_MAX + 1;
-
-    cout << "Testing Matrix" << endl;
-    Matrix<ElemType> A(1024, 4096, data1, true, devId);
-    Matrix<ElemType> B(4096, 1024, data2, true, devId);
-    Matrix<ElemType> V(1024, 1, data3, true, devId);
-    Matrix<ElemType> C(1024, 1024, devId);
-
-    auto t_startG = clock();
-    for (int i = 0; i < count; ++i)
+    fprintf(stderr, "Usage: MathPerformanceTests [-device cpu|gpu|all] [-gpu <id>] [-type float|double|all] [-warmup <n>] [-repeat <n>]\n"
+                    "                            [-filter <substring of benchmark names>] [-json <file>] [-label <text>] [-checkTensorOps]\n");
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    BenchmarkOptions options;
+    wstring devices =
+#ifdef CPUONLY
+        L"cpu";
+#else
+        L"all";
+#endif
+    DEVICEID_TYPE gpuId = 0;
+    wstring types = L"all";
+
+    for (int i = 1; i < argc; i++)
     {
-        // Matrix<ElemType>::MultiplyAndWeightedAdd(arr[i],A,false,B,false,3.2*arr[i],C);
-        C += (A * arr[i]) * (B * (arr[i] * 2.3));
+        wstring arg = argv[i];
+        if (arg == L"-checkTensorOps")
+        {
+            options.checkTensorOps = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+        wstring value = argv[++i];
+        if (arg == L"-device")
+            devices = value;
+        else if (arg == L"-gpu")
+            gpuId = (DEVICEID_TYPE) stoi(value);
+        else if (arg == L"-type")
+            types = value;
+        else if (arg == L"-warmup")
+            options.warmup = (size_t) stoul(value);
+        else if (arg == L"-repeat")
+            options.repetitions = max((size_t) 1, (size_t) stoul(value));
+        else if (arg == L"-filter")
+            options.filter = msra::strfun::utf8(value);
+        else if (arg == L"-json")
+            options.jsonPath = value;
+        else if (arg == L"-label")
+            options.label = msra::strfun::utf8(value);
+        else
+        {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
     }
-    auto t_endG = clock();
-    double valM = 1.0 * (t_endG - t_startG) / (CLOCKS_PER_SEC * count);
-    cout << "Matrix C+=alpha*A*beta*B in: " << valM << " seconds" << endl;
-
-    cout << "Testing CPUMatrix" << endl;
-    CPUMatrix<ElemType> AC(1024, 4096, data1, true);
-    CPUMatrix<ElemType> BC(4096, 1024, data2, true);
-    CPUMatrix<ElemType> VC(1024, 1, data3, true);
-    CPUMatrix<ElemType> CC(1024, 1024);
-
-    auto t_startC = clock();
-    for (int i = 0; i < count; ++i)
+
+    if (devices == L"cpu" || devices == L"all")
+        options.devices.push_back(CPUDEVICE);
+    if (devices == L"gpu" || devices == L"all")
+        options.devices.push_back(gpuId);
+    options.runFloat = types == L"float" || types == L"all";
+    options.runDouble = types == L"double" || types == L"all";
+    if (options.devices.empty() || (!options.runFloat && !options.runDouble))
     {
-        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(arr[i], AC, false, BC, false, 3.2 * arr[i], CC);
-        // CC+=(arr[i]*AC)*((arr[i]*2.3)*BC);
+        PrintUsage();
+        return EXIT_FAILURE;
     }
-    auto t_endC = clock();
-    double valMC = 1.0 * (t_endC - t_startC) / (CLOCKS_PER_SEC * count);
-    cout << "CPUMatrix C+=alpha*A*beta*B in: " << valMC << " seconds" << endl;
-
-    delete[] arr;
-    delete[] data1;
-    delete[] data2;
-    delete[] data3;
-}
-
-int wmain()
-{
-    // MandSTest<float>(100, 2);
 
-    /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
-    SquareMultiplyAndAdd10TimesAvgTest<float>(4096,10);
+    try
+    {
+        if (options.checkTensorOps)
+        {
+            TensorTest<float>();
+            TensorTest<double>();
+        }
 
-    cout<<endl<<"********************Matrix AddMultiplyAndInplaceSigmoid TEST********************"<<endl;    
-    AddMultiplyAndInplaceSigmoidTest<float>(11,10,12);    
-    AddMultiplyAndInplaceSigmoidTest<float>(110,100,120);    
-    AddMultiplyAndInplaceSigmoidTest<float>(1100,1000,1200);    
-    AddMultiplyAndInplaceSigmoidTest<float>(11000,10000,1200);
+        BenchmarkRunner runner(options);
+        for (auto deviceId : options.devices)
+        {
+            if (options.runFloat)
+                RunBenchmarks<float>(runner, deviceId);
+            if (options.runDouble)
+                RunBenchmarks<double>(runner, deviceId);
+        }
 
-    cout<<endl<<"********************Matrix MultiplyAndWeightedAdd TEST********************"<<endl;    
-    MultiplyAndWeightedAddTest<float>(11,10,12);    
-    MultiplyAndWeightedAddTest<float>(110,100,120);    
-    MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
-    MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
+        if (!options.jsonPath.empty())
+            runner.WriteJson(options.jsonPath);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
-    return 0;
+#ifndef _WIN32
+// converts the arguments in UTF-8 encoding for wmain()
+int main(int argc, char* argv[])
+{
+    vector<wstring> args;
+    for (int i = 0; i < argc; i++)
+        args.push_back(msra::strfun::utf16(argv[i]));
+    vector<wchar_t*> wargs;
+    for (auto& arg : args)
+        wargs.push_back(&arg[0]);
+    return wmain(argc, wargs.data());
 }
+#endif
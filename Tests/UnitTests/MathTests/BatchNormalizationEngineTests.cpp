@@ -408,6 +408,86 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     }
 }
 
+// The CPU implementation of the CNTK engine, against that on the GPU, for training and inference.
+BOOST_AUTO_TEST_CASE(BatchNormalizationCpu)
+{
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    int baseDeviceId = 0;
+    for (const auto& cfg : GenerateBNTestConfigs())
+    {
+        const auto& inOutT = std::get<0>(cfg);
+        size_t batchSize = std::get<1>(cfg);
+        bool spatial = std::get<2>(cfg);
+        double expAvg = std::get<3>(cfg);
+        double eps = 1e-5;
+        for (double blendFactor : {0.0, 0.5, 1.0})
+        {
+            auto engCpu = BNEng::Create(deviceId, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Cntk);
+            auto engGpu = BNEng::Create(baseDeviceId, inOutT, spatial, ImageLayoutKind::CHW, BatchNormEngineKind::Cntk);
+
+            size_t crow = inOutT.GetNumElements();
+            size_t ccol = batchSize;
+            size_t crowScaleBias = spatial ? inOutT[2] : inOutT.GetNumElements();
+
+            auto initMat = [&](size_t r, size_t c, SingleMatrix& mB) -> SingleMatrix
+            {
+                vec buf(r * c);
+                std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+                mB.SetValue(r, c, baseDeviceId, buf.data());
+                return SingleMatrix(r, c, buf.data(), deviceId, matrixFlagNormal);
+            };
+
+            SingleMatrix inB(baseDeviceId), scaleB(baseDeviceId), biasB(baseDeviceId), runMeanB(baseDeviceId), runInvStdDevB(baseDeviceId);
+            SingleMatrix in = initMat(crow, ccol, inB);
+            SingleMatrix scale = initMat(crowScaleBias, 1, scaleB);
+            SingleMatrix bias = initMat(crowScaleBias, 1, biasB);
+            SingleMatrix runMean = initMat(crowScaleBias, 1, runMeanB);
+            SingleMatrix runInvStdDev = initMat(crowScaleBias, 1, runInvStdDevB);
+            runInvStdDev.InplaceAbs();
+            runInvStdDevB.InplaceAbs();
+
+            SingleMatrix out(crow, ccol, deviceId), outB(crow, ccol, baseDeviceId);
+            SingleMatrix saveMean(deviceId), saveMeanB(baseDeviceId), saveInvStdDev(deviceId), saveInvStdDevB(baseDeviceId);
+            engCpu->Forward(in, scale, bias, expAvg, blendFactor, runMean, runInvStdDev, out, eps, saveMean, saveInvStdDev);
+            engGpu->Forward(inB, scaleB, biasB, expAvg, blendFactor, runMeanB, runInvStdDevB, outB, eps, saveMeanB, saveInvStdDevB);
+
+            std::stringstream tmsg;
+            tmsg << "inOut tensor: " << (std::string)inOutT
+                 << ", spatial = " << (spatial ? "true" : "false")
+                 << ", expAvg = " << expAvg << ", blendFactor = " << blendFactor;
+            std::string msg = " are not equal, " + tmsg.str();
+
+            float relErr = Err<float>::Rel;
+            float absErr = Err<float>::Abs;
+            std::string emsg;
+
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, relErr * 16, absErr * 20), "out" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(runMean, runMeanB, emsg, relErr, absErr), "runMean" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(runInvStdDev, runInvStdDevB, emsg, relErr * 16, absErr * 16), "runInvStdDev" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(saveMean.IsEmpty() == saveMeanB.IsEmpty(), "saveMean" << msg);
+            if (saveMean.IsEmpty())
+                continue; // inference: the backward pass would use the running statistics
+            BOOST_REQUIRE_MESSAGE(CheckEqual(saveMean, saveMeanB, emsg, relErr, absErr), "saveMean" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(saveInvStdDev, saveInvStdDevB, emsg, relErr * 16, absErr * 16), "saveInvStdDev" << msg << ". " << emsg);
+
+            SingleMatrix dyB(baseDeviceId), dxB(baseDeviceId);
+            SingleMatrix dy = initMat(crow, ccol, dyB);
+            SingleMatrix dx = initMat(crow, ccol, dxB);
+            SingleMatrix dScale(crowScaleBias, 1, deviceId), dScaleB(crowScaleBias, 1, baseDeviceId);
+            SingleMatrix dBias(crowScaleBias, 1, deviceId), dBiasB(crowScaleBias, 1, baseDeviceId);
+            engCpu->Backward(in, dy, dx, scale, blendFactor, saveMean, saveInvStdDev, dScale, dBias);
+            engGpu->Backward(inB, dyB, dxB, scaleB, blendFactor, saveMeanB, saveInvStdDevB, dScaleB, dBiasB);
+
+            BOOST_REQUIRE_MESSAGE(CheckEqual(dx, dxB, emsg, relErr * 16, absErr * 16), "dx" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(dScale, dScaleB, emsg, relErr * 32, absErr * 16), "dScale" << msg << ". " << emsg);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(dBias, dBiasB, emsg, relErr * 32, absErr * 16), "dBias" << msg << ". " << emsg);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Common/Include/BlockCompression.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(BlockCompressionUnitTests)
+
+static std::vector<char> RoundTrip(const std::vector<char>& data, size_t& compressedSize)
+{
+    std::vector<char> compressed(BlockCompression::CompressBound(data.size()));
+    compressedSize = BlockCompression::Compress(data.data(), data.size(), compressed.data());
+    BOOST_REQUIRE_LE(compressedSize, compressed.size());
+
+    std::vector<char> decompressed(data.size());
+    size_t decompressedSize = BlockCompression::Decompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size());
+    BOOST_REQUIRE_EQUAL(decompressedSize, data.size());
+    return decompressed;
+}
+
+BOOST_AUTO_TEST_CASE(BlockCompressionRoundTrip)
+{
+    std::mt19937 rng(7);
+    for (size_t size : { 0, 1, 12, 13, 100, 65536 + 17, 1000000 })
+    {
+        // random bytes do not compress, runs and repeats do
+        std::vector<char> random(size), repetitive(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            random[i] = (char) rng();
+            repetitive[i] = (char) ((i / 300) % 7 + (i % 13 == 0 ? 1 : 0));
+        }
+        size_t compressedSize;
+        BOOST_CHECK(RoundTrip(random, compressedSize) == random);
+        BOOST_CHECK_LE(compressedSize, BlockCompression::CompressBound(size));
+        BOOST_CHECK(RoundTrip(repetitive, compressedSize) == repetitive);
+        if (size >= 100)
+            BOOST_CHECK_LT(compressedSize, size / 4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BlockCompressionShuffledFloats)
+{
+    const size_t n = 100000;
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; i++)
+        values[i] = 0.01f * (float) std::sin(0.001 * i);
+
+    std::vector<char> shuffled(n * sizeof(float));
+    BlockCompression::ShuffleBytes((const char*) values.data(), n, sizeof(float), shuffled.data());
+    size_t compressedSize;
+    BOOST_CHECK(RoundTrip(shuffled, compressedSize) == shuffled);
+    BOOST_CHECK_LT(compressedSize, shuffled.size());
+
+    std::vector<float> unshuffled(n);
+    BlockCompression::UnshuffleBytes(shuffled.data(), n, sizeof(float), (char*) unshuffled.data());
+    BOOST_CHECK(unshuffled == values);
+}
+
+BOOST_AUTO_TEST_CASE(BlockCompressionCorruptData)
+{
+    // a match that refers to bytes before the start of the block
+    const char corrupt[] = { 0x10, 'a', 0x05, 0x00 };
+    std::vector<char> decompressed(100);
+    BOOST_CHECK_THROW(BlockCompression::Decompress(corrupt, sizeof(corrupt), decompressed.data(), decompressed.size()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -4,6 +4,8 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/BlockMultiplier.h"
+#include "../../../Source/Math/QuantizedMultiplier.h"
+#include <random>
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace TEST {
 
@@ -185,5 +187,49 @@ BOOST_AUTO_TEST_CASE(BlockMultiplyTestAllKFourRowsMultiThread)
     TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
 }
 
+BOOST_AUTO_TEST_SUITE_END()
+
+// QuantizedMultiplier: float product through the int16 block multiplier, compared against a double-precision reference
+static void TestQuantizedMultiplier(size_t m, size_t k, size_t n)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> a(m * k), b(k * n), c(m * n);
+    for (auto& x : a)
+        x = dist(rng);
+    for (auto& x : b)
+        x = dist(rng);
+
+    QuantizedMultiplier<float> multiplier;
+    multiplier.SetA(a.data(), m, k);
+    // twice with the same prepared weights
+    for (int i = 0; i < 2; i++)
+    {
+        multiplier.Multiply(b.data(), n, c.data());
+        for (size_t col = 0; col < n; col++)
+        {
+            for (size_t row = 0; row < m; row++)
+            {
+                double expected = 0;
+                for (size_t j = 0; j < k; j++)
+                    expected += (double) a[row + j * m] * b[j + col * k];
+                // the quantization error grows with sqrt(k)
+                BOOST_CHECK_SMALL(c[row + col * m] - expected, 1e-3 * sqrt((double) k));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(QuantizedMultiplierSuite)
+
+BOOST_AUTO_TEST_CASE(QuantizedMultiplierMatchesFloatProduct)
+{
+    if (!QuantizedMultiplier<float>::IsSupported())
+        return;
+    TestQuantizedMultiplier(8, 128, 8);
+    TestQuantizedMultiplier(37, 128 + 64 + 32 + 16 + 8 + 3, 5); // all kernel sizes, odd shapes
+    TestQuantizedMultiplier(256, 1024, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}} //end namespaces
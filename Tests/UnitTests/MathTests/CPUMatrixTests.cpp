@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/CPUVectorKernels.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -898,6 +899,171 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUVectorKernelsAllLevels, RandomSeedFixture)
+{
+    const CPUKernelLevel levels[] = { CPUKernelLevel::Generic, CPUKernelLevel::AVX2, CPUKernelLevel::AVX512 };
+    for (auto level : levels)
+    {
+        const CPUVectorKernels* kernels = CPUVectorKernels::Get(level);
+        if (!kernels) // not supported by this CPU or build
+            continue;
+
+        // lengths around the vector widths, for the tails
+        for (size_t n : { 1, 7, 8, 9, 16, 17, 33, 1000 })
+        {
+            SMatrix a = SMatrix::RandomUniform(n, 1, -20, 20, IncrementCounter());
+            SMatrix b = SMatrix::RandomUniform(n, 1, -1, 1, IncrementCounter());
+            const float* pa = a.Data();
+            const float* pb = b.Data();
+
+            double sum = 0;
+            float maxV = pa[0];
+            for (size_t i = 0; i < n; i++)
+            {
+                sum += pa[i];
+                maxV = std::max(maxV, pa[i]);
+            }
+            double sumOfExp = 0;
+            for (size_t i = 0; i < n; i++)
+                sumOfExp += exp((double) pa[i] - maxV);
+
+            BOOST_CHECK_SMALL(kernels->vectorSum(pa, n) - sum, 1e-5 * 20 * n);
+            BOOST_CHECK_EQUAL(kernels->vectorMax(pa, n), maxV);
+            BOOST_CHECK_EQUAL(kernels->vectorMin(pa, n), *std::min_element(pa, pa + n));
+            BOOST_CHECK_CLOSE(kernels->sumOfExp(pa, maxV, n), sumOfExp, 1e-4 /*percent*/);
+
+            std::vector<float> c(n, 1.0f);
+            kernels->elementwiseProduct(2, pa, pb, 0.5f, c.data(), n);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK_CLOSE(c[i], 2 + 0.5 * pa[i] * pb[i], 1e-4);
+
+            kernels->exp(0, pb, nullptr, 1, c.data(), n);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK_CLOSE(c[i], exp((double) pb[i]), 1e-4);
+
+            kernels->sigmoid(0, pa, nullptr, 1, c.data(), n);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK_CLOSE(c[i], 1 / (1 + exp(-(double) pa[i])), 1e-4);
+
+            kernels->linearRectifier(0, pb, nullptr, 3, c.data(), n);
+            for (size_t i = 0; i < n; i++)
+                BOOST_CHECK_EQUAL(c[i], pb[i] > 0 ? 3 * pb[i] : 0);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixParallelGrainSize, RandomSeedFixture)
+{
+    // the same result with every loop parallelized and with none
+    const size_t defaultGrainSize = SMatrix::GetParallelGrainSize();
+    SMatrix a = SMatrix::RandomUniform(300, 40, -1, 1, IncrementCounter());
+    SMatrix results[2];
+    const size_t grainSizes[] = { 0, SIZE_MAX };
+    for (size_t i = 0; i < 2; i++)
+    {
+        SMatrix::SetParallelGrainSize(grainSizes[i]);
+        BOOST_CHECK_EQUAL(SMatrix::GetParallelGrainSize(), grainSizes[i]);
+        results[i].SetValue(a);
+        results[i].InplaceSigmoid();
+        results[i].AddWithScaleOf(2, a);
+    }
+    SMatrix::SetParallelGrainSize(defaultGrainSize);
+
+    BOOST_CHECK(results[0].IsEqualTo(results[1], 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpBroadcastingAndMaxReduction, RandomSeedFixture)
+{
+    // column-major [m x n] tensors, as the float kernels see them
+    const size_t m = 37, n = 11;
+    SMatrix a = SMatrix::RandomUniform(m, n, -1, 1, IncrementCounter());
+    SMatrix b = SMatrix::RandomUniform(m, 1, -1, 1, IncrementCounter());
+    SMatrix c = SMatrix::RandomUniform(m, n, -1, 1, IncrementCounter());
+    SMatrix c0;
+    c0.SetValue(c);
+
+    // c = 0.5 c + 2 (a .* b), with b broadcast along the columns
+    SmallVector<size_t> opDims(2);
+    opDims[0] = m;
+    opDims[1] = n;
+    array<SmallVector<ptrdiff_t>, 3> strides;
+    for (auto& operandStrides : strides)
+        operandStrides.resize(2);
+    strides[0][0] = 1; strides[0][1] = m;
+    strides[1][0] = 1; strides[1][1] = 0;
+    strides[2][0] = 1; strides[2][1] = m;
+    c.TensorOp(0.5f, a, b, 2.0f, ElementWiseOperator::opElementwiseProduct, ElementWiseOperator::opSum, array<size_t, 3>{ 0, 0, 0 },
+               opDims, strides, SmallVector<size_t>(), array<SmallVector<ptrdiff_t>, 3>());
+    for (size_t j = 0; j < n; j++)
+        for (size_t i = 0; i < m; i++)
+            BOOST_CHECK_CLOSE(c(i, j), 0.5f * c0(i, j) + 2.0f * a(i, j) * b(i, 0), 1e-4);
+
+    // r = max over the rows of a
+    SMatrix r(1, n);
+    SmallVector<size_t> regularDims(1), reducingDims(1);
+    regularDims[0] = n;
+    reducingDims[0] = m;
+    array<SmallVector<ptrdiff_t>, 2> regularStrides, reducingStrides;
+    for (size_t i = 0; i < 2; i++)
+    {
+        regularStrides[i].resize(1);
+        reducingStrides[i].resize(1);
+    }
+    regularStrides[0][0] = m; regularStrides[1][0] = 1;
+    reducingStrides[0][0] = 1; reducingStrides[1][0] = 0;
+    r.TensorOp(0.0f, a, 1.0f, ElementWiseOperator::opCopy, ElementWiseOperator::opMax, array<size_t, 2>{ 0, 0 },
+               regularDims, regularStrides, reducingDims, reducingStrides);
+    for (size_t j = 0; j < n; j++)
+    {
+        float maxV = a(0, j);
+        for (size_t i = 1; i < m; i++)
+            maxV = std::max(maxV, a(i, j));
+        BOOST_CHECK_EQUAL(r(0, j), maxV);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixLogSoftmaxFloatMatchesDouble, RandomSeedFixture)
+{
+    // the float version goes through CPUVectorKernels
+    DMatrix d = DMatrix::RandomUniform(137, 5, -30, 30, IncrementCounter());
+    SMatrix s(d.GetNumRows(), d.GetNumCols());
+    for (size_t i = 0; i < d.GetNumElements(); i++)
+        s.Data()[i] = (float) d.Data()[i];
+
+    d.InplaceLogSoftmax(true);
+    s.InplaceLogSoftmax(true);
+    for (size_t i = 0; i < d.GetNumElements(); i++)
+        BOOST_CHECK_SMALL(s.Data()[i] - d.Data()[i], 1e-4);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixBatchedMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    const size_t m = 5, n = 3, k = 4, batchSize = 7;
+    for (int transposeA = 0; transposeA < 2; transposeA++)
+    {
+        for (int transposeB = 0; transposeB < 2; transposeB++)
+        {
+            // b is a single matrix used for all products
+            SMatrix a = SMatrix::RandomUniform(m * k, batchSize, -1, 1, IncrementCounter());
+            SMatrix b = SMatrix::RandomUniform(k * n, 1, -1, 1, IncrementCounter());
+            SMatrix c = SMatrix::RandomUniform(m * n, batchSize, -1, 1, IncrementCounter());
+            SMatrix c0;
+            c0.SetValue(c);
+            SMatrix::BatchedMultiplyAndWeightedAdd(2.0f, a, transposeA != 0, b, transposeB != 0, 0.5f, c, m, n, k);
+
+            SMatrix bj(transposeB ? n : k, transposeB ? k : n, b.Data());
+            for (size_t j = 0; j < batchSize; j++)
+            {
+                SMatrix aj(transposeA ? k : m, transposeA ? m : k, a.Data() + j * m * k);
+                SMatrix cj(m, n, c0.Data() + j * m * n);
+                SMatrix::MultiplyAndWeightedAdd(2.0f, aj, transposeA != 0, bj, transposeB != 0, 0.5f, cj);
+                for (size_t i = 0; i < m * n; i++)
+                    BOOST_CHECK_CLOSE(c(i, j), cj.Data()[i], 1e-3);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -61,6 +61,125 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixBlockColFSAdagrad, RandomSeedFixture)
+{
+    const size_t m = 4;
+    const size_t n = 6;
+    const size_t blockIds[] = { 4, 1 };
+    const size_t numBlocks = 2;
+
+    DenseMatrix values(m, numBlocks);
+    values.SetUniformRandomValue(-1, 1, IncrementCounter());
+    SparseMatrix sm(MatrixFormat::matrixFormatSparseBlockCol);
+    sm.SetMatrixFromSBCFormat(blockIds, values.Data(), numBlocks, m, n);
+
+    std::vector<size_t> ids;
+    std::vector<double> vals;
+    sm.GetMatrixFromSBCFormat(ids, vals);
+    BOOST_CHECK_EQUAL(ids.size(), numBlocks);
+    BOOST_CHECK_EQUAL(ids[0], blockIds[0]);
+    BOOST_CHECK_EQUAL(ids[1], blockIds[1]);
+    BOOST_CHECK_EQUAL(vals.size(), m * numBlocks);
+    BOOST_CHECK_EQUAL(vals[m + 2], values(2, 1));
+
+    // from a zero state, the untouched columns are left alone by the dense update as well
+    DenseMatrix denseGradient(m, n);
+    denseGradient.SetValue(0);
+    for (size_t j = 0; j < numBlocks; j++)
+        for (size_t i = 0; i < m; i++)
+            denseGradient(i, blockIds[j]) = values(i, j);
+
+    DenseMatrix w1(m, n);
+    w1.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix w2(w1);
+    DenseMatrix smoothed1(m, 2 * n);
+    smoothed1.SetValue(0);
+    DenseMatrix smoothed2(m, 2 * n);
+    smoothed2.SetValue(0);
+
+    for (int iter = 0; iter < 2; iter++)
+    {
+        sm.FSAdagrad(smoothed1, w1, 0.1, 0.9, 0.99, 0.05);
+        smoothed2.FSAdagrad(denseGradient, w2, 0.1, 0.9, 0.99, 0.05);
+    }
+
+    BOOST_CHECK(w1.IsEqualTo(w2, c_epsilonFloatE4));
+    BOOST_CHECK(smoothed1.IsEqualTo(smoothed2, c_epsilonFloatE4));
+}
+
+// fill an empty sparse matrix with random values, about 70% zeros, and return them as a dense matrix
+static DenseMatrix FillSparseTestMatrix(SparseMatrix& sparse, unsigned long seed)
+{
+    const size_t numRows = sparse.GetNumRows();
+    const size_t numCols = sparse.GetNumCols();
+    DenseMatrix dense(numRows, numCols);
+    dense.SetUniformRandomValue(-1, 1, seed);
+    foreach_coord (row, col, dense)
+    {
+        if (fabs(dense(row, col)) < 0.7)
+            dense(row, col) = 0;
+    }
+
+    const bool isCSC = sparse.GetFormat() == MatrixFormat::matrixFormatSparseCSC;
+    for (size_t outer = 0; outer < (isCSC ? numCols : numRows); outer++)
+    {
+        for (size_t inner = 0; inner < (isCSC ? numRows : numCols); inner++)
+        {
+            size_t row = isCSC ? inner : outer;
+            size_t col = isCSC ? outer : inner;
+            if (dense(row, col) != 0)
+                sparse.SetValue(row, col, dense(row, col));
+        }
+    }
+    return dense;
+}
+
+// large enough for the products to run multi-threaded
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    const size_t m = 300;
+    const size_t k = 200;
+    const size_t n = 100;
+    const double alpha = 0.5;
+    const double beta = 2;
+
+    for (int transposeA = 0; transposeA < 2; transposeA++)
+    {
+        for (int transposeB = 0; transposeB < 2; transposeB++)
+        {
+            DenseMatrix c0(m, n);
+            c0.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+            // dense x sparse(CSC)
+            DenseMatrix lhs(transposeA ? k : m, transposeA ? m : k);
+            lhs.SetUniformRandomValue(-1, 1, IncrementCounter());
+            SparseMatrix rhs(MatrixFormat::matrixFormatSparseCSC, transposeB ? n : k, transposeB ? k : n, 0);
+            DenseMatrix rhsDense = FillSparseTestMatrix(rhs, IncrementCounter());
+
+            DenseMatrix expected(c0);
+            DenseMatrix c(c0);
+            DenseMatrix::MultiplyAndWeightedAdd(alpha, lhs, !!transposeA, rhsDense, !!transposeB, beta, expected);
+            SparseMatrix::MultiplyAndWeightedAdd(alpha, lhs, !!transposeA, rhs, !!transposeB, beta, c);
+            BOOST_CHECK(c.IsEqualTo(expected, c_epsilonFloatE4));
+
+            // sparse(CSC and CSR) x dense
+            for (auto format : { MatrixFormat::matrixFormatSparseCSC, MatrixFormat::matrixFormatSparseCSR })
+            {
+                SparseMatrix sparseLhs(format, transposeA ? k : m, transposeA ? m : k, 0);
+                DenseMatrix lhsDense = FillSparseTestMatrix(sparseLhs, IncrementCounter());
+                DenseMatrix denseRhs(transposeB ? n : k, transposeB ? k : n);
+                denseRhs.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+                expected = c0;
+                c = c0;
+                DenseMatrix::MultiplyAndWeightedAdd(alpha, lhsDense, !!transposeA, denseRhs, !!transposeB, beta, expected);
+                SparseMatrix::MultiplyAndWeightedAdd(alpha, sparseLhs, !!transposeA, denseRhs, !!transposeB, beta, c);
+                BOOST_CHECK(c.IsEqualTo(expected, c_epsilonFloatE4));
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -12,6 +12,7 @@
 #include "../../../Source/Math/GPUMatrix.h"
 #include "../../../Source/Math/ConvolutionEngine.h"
 #include "../../../Source/Math/CuDnnFactories.h"
+#include "../../../Source/Math/DirectConvolution.h"
 #include "common.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -580,6 +581,143 @@ BOOST_AUTO_TEST_CASE(MaxUnpooling)
     }
 }
 
+BOOST_AUTO_TEST_CASE(DirectConvolutionEngine)
+{
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<> batchSizeG(1, 8);
+    std::normal_distribution<float> nd;
+
+    // The test configurations, with more maps than a block and padding on one side only.
+    auto geometries = GenerateConvTestConfigs();
+    for (size_t mapCount : {19, 32})
+    {
+        geometries.push_back(std::make_shared<ConvolveGeometry>(TensorShape(16, 11, 4),
+            TensorShape(3, 3, 4), TensorShape(mapCount), TensorShape(2, 1, 4),
+            ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+            TensorShape(1, 0, 0), TensorShape(0, 1, 0)));
+    }
+
+    int deviceId = -1;
+    for (const auto& g : geometries)
+    {
+        if (!DirectConvolution<float>::IsSupported(*g))
+            continue;
+        auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+
+        size_t n = batchSizeG(rng);
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        vec buf(g->InputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+        buf.resize(g->KernelShape().GetNumElements() * mapCount);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+        buf.resize(g->OutputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix srcGrad(g->OutputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+        SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+        SingleMatrix outB(g->OutputShape().GetNumElements(), n, deviceId);
+        out.SetValue(std::numeric_limits<float>::quiet_NaN()); // all overwritten
+        SingleMatrix workspace(deviceId);
+        testEng->Forward(in, kernel, out, workspace);
+        baseEng->Forward(in, kernel, outB, workspace);
+
+        // The backward passes are those of the GEMM engine.
+        SingleMatrix grad(g->InputShape().GetNumElements(), n, deviceId);
+        SingleMatrix gradB(g->InputShape().GetNumElements(), n, deviceId);
+        grad.SetValue(0);
+        gradB.SetValue(0);
+        testEng->BackwardData(srcGrad, kernel, grad, workspace);
+        baseEng->BackwardData(srcGrad, kernel, gradB, workspace);
+
+        std::string msg = " are not equal, Geometry: " + (std::string)(*g) + ", Batch: " + std::to_string(n);
+        std::string emsg;
+        BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out has NaNs" << msg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel * 4, Err<float>::Abs * 9), "out" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradB, emsg, Err<float>::Rel * 16, Err<float>::Abs * 16), "grad" << msg << ". " << emsg);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CompactConvolveMaps)
+{
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    auto intMat = [&](const std::vector<int>& data)
+    {
+        return Matrix<int>(data.size(), 1, const_cast<int*>(data.data()), deviceId, matrixFlagDontOwnBuffer);
+    };
+
+    for (const auto& g : GenerateConvTestConfigs())
+    {
+        std::string msg = "Geometry: " + (std::string)(*g);
+
+        // The computed maps and the runs by key must agree with the tables.
+        const auto& compact = g->Compact();
+        const auto& runs = g->Runs();
+        const auto& keyRuns = g->KeyRuns();
+        for (int row = 0; row < (int)g->MpRowCol().size(); row++)
+        {
+            int col, iwht, key;
+            compact.Map(row, col, iwht, key);
+            BOOST_REQUIRE_MESSAGE(col == g->MpRowCol()[row] && iwht == g->MpRowIwht()[row], "Row " << row << ", " << msg);
+            BOOST_REQUIRE_MESSAGE(0 <= key && key < (int)g->MpKeyRun().size() && g->MpKeyRun()[key] >= 0, "Key of row " << row << ", " << msg);
+
+            int i0 = g->MpRowRun()[row];
+            int k0 = g->MpKeyRun()[key];
+            int length = 2 + 2 * runs[i0 + 1];
+            BOOST_REQUIRE_MESSAGE(std::equal(runs.begin() + i0, runs.begin() + i0 + length, keyRuns.begin() + k0), "Run of row " << row << ", " << msg);
+        }
+
+        // Hence the convolution with either must give the same result.
+        size_t n = 3;
+        size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+        vec buf(g->InputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+        buf.resize(g->KernelShape().GetNumElements() * mapCount);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+        buf.resize(g->OutputShape().GetNumElements() * n);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix srcGrad(g->OutputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+        auto mpRowCol = intMat(g->MpRowCol());
+        auto mpRowIwht = intMat(g->MpRowIwht());
+        auto mpRowRun = intMat(g->MpRowRun());
+        auto runsMat = intMat(runs);
+        auto mpKeyRun = intMat(g->MpKeyRun());
+        auto keyRunsMat = intMat(keyRuns);
+
+        SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+        SingleMatrix outCompact(g->OutputShape().GetNumElements(), n, deviceId);
+        in.ConvolutionForward(kernel, mpRowCol, mpRowIwht, mpRowRun, runsMat, out);
+        in.ConvolutionForward(kernel, compact, mpKeyRun, keyRunsMat, outCompact);
+
+        SingleMatrix grad(g->InputShape().GetNumElements(), n, deviceId);
+        SingleMatrix gradCompact(g->InputShape().GetNumElements(), n, deviceId);
+        grad.SetValue(0);
+        gradCompact.SetValue(0);
+        srcGrad.ConvolutionBackwardData(kernel, mpRowCol, mpRowIwht, mpRowRun, runsMat, grad);
+        srcGrad.ConvolutionBackwardData(kernel, compact, mpKeyRun, keyRunsMat, gradCompact);
+
+        SingleMatrix kernelGrad(mapCount, g->KernelShape().GetNumElements(), deviceId);
+        SingleMatrix kernelGradCompact(mapCount, g->KernelShape().GetNumElements(), deviceId);
+        kernelGrad.SetValue(0);
+        kernelGradCompact.SetValue(0);
+        srcGrad.ConvolutionBackwardKernel(in, mpRowCol, mpRowIwht, mpRowRun, runsMat, kernelGrad);
+        srcGrad.ConvolutionBackwardKernel(in, compact, mpKeyRun, keyRunsMat, kernelGradCompact);
+
+        std::string emsg;
+        BOOST_REQUIRE_MESSAGE(CheckEqual(outCompact, out, emsg, 0.0f, 0.0f), "out are not equal, " << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(gradCompact, grad, emsg, 0.0f, 0.0f), "grad are not equal, " << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGradCompact, kernelGrad, emsg, 0.0f, 0.0f), "kernelGrad are not equal, " << msg << ". " << emsg);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -0,0 +1,87 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Math/Float16.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(Float16UnitTests)
+
+BOOST_AUTO_TEST_CASE(Float16Conversion)
+{
+    // every finite fp16 value converts to float and back unchanged
+    for (uint32_t h = 0; h < 0x10000; h++)
+    {
+        if (IsFloat16Finite(Float16Format::float16, (uint16_t) h))
+            BOOST_REQUIRE_EQUAL(FloatToFloat16(Float16ToFloat((uint16_t) h)), h);
+    }
+
+    BOOST_CHECK_EQUAL(FloatToFloat16(1.0f), 0x3c00);
+    BOOST_CHECK_EQUAL(FloatToFloat16(-2.0f), 0xc000);
+    BOOST_CHECK_EQUAL(FloatToFloat16(65504.0f), 0x7bff);
+    BOOST_CHECK_EQUAL(Float16ToFloat(0x0001), std::ldexp(1.0f, -24)); // smallest subnormal
+
+    // ties round to even
+    BOOST_CHECK_EQUAL(FloatToFloat16(1.0f + std::ldexp(1.0f, -11)), 0x3c00);
+    BOOST_CHECK_EQUAL(FloatToFloat16(1.0f + 3 * std::ldexp(1.0f, -11)), 0x3c02);
+    BOOST_CHECK_EQUAL(FloatToFloat16(std::ldexp(1.0f, -25)), 0x0000);
+    BOOST_CHECK_EQUAL(FloatToFloat16(3 * std::ldexp(1.0f, -25)), 0x0002);
+
+    // out of range and non-finite values
+    BOOST_CHECK_EQUAL(FloatToFloat16(65519.0f), 0x7bff);
+    BOOST_CHECK_EQUAL(FloatToFloat16(65520.0f), 0x7c00);
+    BOOST_CHECK_EQUAL(FloatToFloat16(-1e10f), 0xfc00);
+    BOOST_CHECK(!IsFloat16Finite(Float16Format::float16, FloatToFloat16(std::numeric_limits<float>::quiet_NaN())));
+    BOOST_CHECK(std::isnan(Float16ToFloat(FloatToFloat16(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+BOOST_AUTO_TEST_CASE(BFloat16Conversion)
+{
+    BOOST_CHECK_EQUAL(FloatToBFloat16(1.0f), 0x3f80);
+    BOOST_CHECK_EQUAL(BFloat16ToFloat(0xc040), -3.0f);
+    BOOST_CHECK_EQUAL(FloatToBFloat16(1.0f + std::ldexp(1.0f, -8)), 0x3f80);     // tie to even
+    BOOST_CHECK_EQUAL(FloatToBFloat16(1.0f + 3 * std::ldexp(1.0f, -8)), 0x3f82); // tie to even
+    BOOST_CHECK_EQUAL(FloatToBFloat16(1e30f), FloatToBFloat16(BFloat16ToFloat(FloatToBFloat16(1e30f))));
+    BOOST_CHECK_EQUAL(FloatToBFloat16(std::numeric_limits<float>::max()), 0x7f80); // rounds to Inf
+    BOOST_CHECK(std::isnan(BFloat16ToFloat(FloatToBFloat16(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+BOOST_AUTO_TEST_CASE(Float16EncodeAddDecode)
+{
+    // two scaled buffers summed in 16 bits and unscaled: gradients below the fp16 range survive the scaling
+    const float scale = 1024.0f;
+    std::vector<float> a = { 1e-6f, -0.5f, 3.0f, 0.0f }, b = { 2e-6f, 0.25f, -1.0f, 60.0f };
+    for (auto format : { Float16Format::float16, Float16Format::bfloat16 })
+    {
+        std::vector<uint16_t> encodedA(a.size()), encodedB(b.size());
+        EncodeFloat16(format, a.data(), a.size(), scale, encodedA.data());
+        EncodeFloat16(format, b.data(), b.size(), scale, encodedB.data());
+        AddFloat16(format, encodedA.data(), encodedB.data(), a.size());
+        BOOST_CHECK(AllFloat16Finite(format, encodedB.data(), b.size()));
+
+        std::vector<double> sum(a.size());
+        DecodeFloat16(format, encodedB.data(), sum.size(), scale, sum.data());
+        for (size_t i = 0; i < sum.size(); i++)
+        {
+            double expected = (double) a[i] + b[i];
+            BOOST_CHECK_SMALL(sum[i] - expected, std::fabs(expected) * ((format == Float16Format::bfloat16) ? 1e-2 : 2e-3));
+        }
+    }
+
+    // 60 * 1024 + 60 * 1024 overflows fp16
+    std::vector<float> c = { 60.0f };
+    std::vector<uint16_t> x(1), y(1);
+    EncodeFloat16(Float16Format::float16, c.data(), 1, scale, x.data());
+    EncodeFloat16(Float16Format::float16, c.data(), 1, scale, y.data());
+    AddFloat16(Float16Format::float16, x.data(), y.data(), 1);
+    BOOST_CHECK(!AllFloat16Finite(Float16Format::float16, y.data(), 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
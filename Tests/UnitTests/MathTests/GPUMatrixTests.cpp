@@ -537,6 +537,36 @@ BOOST_FIXTURE_TEST_CASE(GPUMatrixCurandSeedingDouble, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUMatrixCachingAllocatorReusesBuffers, RandomSeedFixture)
+{
+    TracingGPUMemoryAllocator::SetAllocatorKind(GPUMemoryAllocatorKind::Caching);
+    auto restoreAllocator = MakeScopeExit([]
+    {
+        TracingGPUMemoryAllocator::ReleaseCachedMemory(c_deviceIdZero);
+        TracingGPUMemoryAllocator::SetAllocatorKind(GPUMemoryAllocatorKind::Direct);
+    });
+
+    const auto before = TracingGPUMemoryAllocator::GetStatistics(c_deviceIdZero);
+    {
+        GPUMatrix<float> m(256, 100, c_deviceIdZero);
+        m.SetValue(1.0f);
+        // shrinking and growing again within the size class must come from the cache
+        m.Resize(256, 64, /*growOnly=*/false);
+        m.Resize(256, 100, /*growOnly=*/false);
+        m.SetValue(2.0f);
+
+        unique_ptr<float[]> result(m.CopyToArray());
+        BOOST_CHECK_EQUAL(result[0], 2.0f);
+        BOOST_CHECK_EQUAL(result[256 * 100 - 1], 2.0f);
+    }
+    const auto after = TracingGPUMemoryAllocator::GetStatistics(c_deviceIdZero);
+
+    BOOST_CHECK_EQUAL(after.bytesInUse, before.bytesInUse);
+    BOOST_CHECK_GE(after.numCacheHits - before.numCacheHits, 1);
+    BOOST_CHECK_GE(after.peakBytesInUse, 256 * 100 * sizeof(float));
+    BOOST_CHECK_LT(after.numDeviceAllocations - before.numDeviceAllocations, after.numAllocations - before.numAllocations);
+}
+
 #if 0 // Temporarily disabling
 BOOST_FIXTURE_TEST_CASE(GPUMatrixLargeInequality, RandomSeedFixture)
 {
@@ -363,6 +363,39 @@ BOOST_FIXTURE_TEST_CASE(GPUSparseDenseConversions, RandomSeedFixture)
     BOOST_CHECK_EQUAL(8, cpuMatrixB(2, 4));
 }
 
+BOOST_FIXTURE_TEST_CASE(GPUSparseCachedFormatConversions, RandomSeedFixture)
+{
+    GPUSparseMatrix<float> csrMatrix(c_deviceIdZero);
+    csrMatrix.SetMatrixFromCSRFormat(c_i, c_j, c_v, c_size, c_rowCount, c_colCount);
+    const GPUMatrix<float> denseMatrix = csrMatrix.CopyToDenseMatrix();
+
+    const GPUSparseMatrix<float>& cscMatrix = csrMatrix.GetConvertedSparseFormat(matrixFormatSparseCSC);
+    BOOST_CHECK_EQUAL(matrixFormatSparseCSC, cscMatrix.GetFormat());
+    BOOST_CHECK(cscMatrix.IsEqualTo(denseMatrix));
+    BOOST_CHECK_EQUAL(&cscMatrix, &csrMatrix.GetConvertedSparseFormat(matrixFormatSparseCSC)); // cached
+    BOOST_CHECK_EQUAL(&csrMatrix, &csrMatrix.GetConvertedSparseFormat(matrixFormatSparseCSR)); // no conversion
+
+    // and back
+    GPUSparseMatrix<float> cscCopy(cscMatrix);
+    const GPUSparseMatrix<float>& csrCopy = cscCopy.GetConvertedSparseFormat(matrixFormatSparseCSR);
+    BOOST_CHECK_EQUAL(matrixFormatSparseCSR, csrCopy.GetFormat());
+    BOOST_CHECK(csrCopy.IsEqualTo(denseMatrix));
+
+    // a write invalidates the cached conversion
+    GPUSparseMatrix<float>::Scale(2, csrMatrix);
+    const GPUMatrix<float> scaledDenseMatrix = csrMatrix.CopyToDenseMatrix();
+    BOOST_CHECK(csrMatrix.GetConvertedSparseFormat(matrixFormatSparseCSC).IsEqualTo(scaledDenseMatrix));
+    BOOST_CHECK(!csrMatrix.GetConvertedSparseFormat(matrixFormatSparseCSC).IsEqualTo(denseMatrix));
+
+    // sparse CSC x dense multiplies the cached CSR form
+    const GPUMatrix<float> rhs(GPUMatrix<float>::RandomUniform(c_colCount, 3, c_deviceIdZero, -1, 1, IncrementCounter()));
+    GPUMatrix<float> product(c_deviceIdZero);
+    GPUMatrix<float> expected(c_deviceIdZero);
+    GPUSparseMatrix<float>::Multiply(cscCopy, rhs, product);
+    GPUMatrix<float>::Multiply(denseMatrix, rhs, expected);
+    BOOST_CHECK(product.IsEqualTo(expected, c_epsilonFloatE4));
+}
+
 BOOST_FIXTURE_TEST_CASE(GPUSparseTranspose, RandomSeedFixture)
 {
     GPUSparseMatrix<float> sparseMatrix(c_deviceIdZero);
@@ -73,6 +73,54 @@ BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixSparseRead.IsEqualTo(matrixSparseCopy, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(MatrixFileWriteReadBinaryAsync, RandomSeedFixture)
+{
+    Matrix<float> matrix = Matrix<float>::RandomUniform(43, 10, CPUDEVICE, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileName(L"MA.bin");
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsWrite | fileOptionsSequential);
+        file << matrix;
+        // asynchronous writes stay in order with each other and with the synchronous ones
+        for (char c = 0; c < 3; c++)
+            file.WriteAsync(std::vector<char>(100000 + c, c));
+        file << matrix;
+        file.Flush();
+    }
+
+    File file(fileName, fileOptionsBinary | fileOptionsRead);
+    Matrix<float> matrixRead(CPUDEVICE);
+    file >> matrixRead;
+    BOOST_CHECK(matrixRead.IsEqualTo(matrix, c_epsilonFloatE5));
+    for (char c = 0; c < 3; c++)
+    {
+        std::vector<char> block(100000 + c);
+        file.ReadBytes(block.data(), block.size());
+        BOOST_CHECK(block == std::vector<char>(block.size(), c));
+    }
+    file >> matrixRead;
+    BOOST_CHECK(matrixRead.IsEqualTo(matrix, c_epsilonFloatE5));
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixFileWriteReadFloat16, RandomSeedFixture)
+{
+    Matrix<float> matrix = Matrix<float>::RandomUniform(43, 10, CPUDEVICE, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileName(L"MH.bin");
+    File file(fileName, fileOptionsBinary | fileOptionsReadWrite);
+
+    matrix.WriteAsFloat16(file);
+    file.SetPosition(0);
+
+    Matrix<float> matrixRead(CPUDEVICE);
+    file >> matrixRead;
+
+    // fp16 keeps 11 significant bits, i.e. an error of at most 2^-11 relative, or 0.016 at 32
+    BOOST_CHECK_EQUAL(matrixRead.GetNumRows(), 43);
+    BOOST_CHECK_EQUAL(matrixRead.GetNumCols(), 10);
+    BOOST_CHECK(matrixRead.IsEqualTo(matrix, 0.016f));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(GPUMatrixSuite)
@@ -15,6 +15,7 @@
 #include "../../../Source/Math/MatrixQuantizerImpl.h"
 #include "../../../Source/Math/CUDAPageLockedMemAllocator.h"
 #include "../../../Source/Math/ValueQuantizer.h"
+#include "../../../Source/Math/CPUVectorKernels.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -467,6 +468,49 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrix1BitQuantizeDouble, RandomSeedFixture)
     TestQuantization<double>(CPUDEVICE, 100, 50, -0.5f, +0.5f, 2915, 5);
 }
 
+// the vectorized kernels must produce the bit layout of ColumnQuantizer, at every instruction set
+BOOST_FIXTURE_TEST_CASE(CPUQuantizationKernelsAllLevels, RandomSeedFixture)
+{
+    const CPUKernelLevel levels[] = { CPUKernelLevel::Generic, CPUKernelLevel::AVX2, CPUKernelLevel::AVX512 };
+    for (auto level : levels)
+    {
+        const CPUVectorKernels* kernels = CPUVectorKernels::Get(level);
+        if (!kernels) // not supported by this CPU or build
+            continue;
+
+        for (size_t numRows : { 1, 7, 33, 100, 489 })
+        {
+            for (size_t numBits = 1; numBits <= 16; numBits *= 2)
+            {
+                auto in = Matrix<float>::RandomUniform(numRows, 1, CPUDEVICE, -1.0f, 1.0f, IncrementCounter());
+                auto residual = Matrix<float>::RandomUniform(numRows, 1, CPUDEVICE, -0.1f, 0.1f, IncrementCounter());
+                std::vector<float> expectedResidual(residual.Data(), residual.Data() + numRows);
+                std::vector<float> actualResidual = expectedResidual;
+
+                float lower, upper;
+                ColumnQuantizer<float>::ComputeRangeStatColj<false>(in.Data(), residual.Data(), (long) numRows, 0, numBits, lower, upper);
+                ValueQuantizer<float> valQ(ValueQuantizer<float>::ld(numBits), lower, upper);
+                ColumnQuantizer<float> q(ValueQuantizer<float>::ld(numBits), lower, upper);
+                size_t numQWords = q.QWordsPerCol(numRows);
+                std::vector<unsigned int> expected(numQWords), actual(numQWords);
+                q.Quantize<false>(in.Data(), expectedResidual.data(), (long) numRows, 0, expected.data(), expectedResidual.data());
+
+                CPUQuantizationParameters params = { numBits, lower, upper, valQ.QFactor(), valQ.UFactor(), valQ.QuantiMid() };
+                kernels->quantizeColumn(in.Data(), actualResidual.data(), actualResidual.data(), numRows, params, actual.data());
+                BOOST_CHECK(expected == actual);
+                for (size_t i = 0; i < numRows; i++)
+                    BOOST_CHECK_SMALL(actualResidual[i] - expectedResidual[i], c_SinglePrecisionTolerance);
+
+                std::vector<float> expectedValues(numRows, 1.0f), actualValues(numRows, 1.0f);
+                q.Unquantize(expectedValues.data(), (long) numRows, 0, expected.data(), true);
+                kernels->unquantizeColumn(actual.data(), numRows, params, true, actualValues.data());
+                for (size_t i = 0; i < numRows; i++)
+                    BOOST_CHECK_SMALL(actualValues[i] - expectedValues[i], c_SinglePrecisionTolerance);
+            }
+        }
+    }
+}
+
 /*
         Original test cases were using these parameter:
 
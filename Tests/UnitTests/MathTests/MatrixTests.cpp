@@ -1116,6 +1116,111 @@ BOOST_FIXTURE_TEST_CASE(MatrixAssignNumOfDiff, RandomSeedFixture)
         BOOST_CHECK_EQUAL(expectedDiff, actual.Get00Element());
     }
 }
+
+BOOST_FIXTURE_TEST_CASE(MatrixCosDistanceWithNegativeSamples, RandomSeedFixture)
+{
+    const size_t dim = 5, n = 7, shift = 2, negNumber = 3; // (the negative samples wrap around)
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        Matrix<double> a = Matrix<double>::RandomUniform(dim, n, deviceId, -1, 1, IncrementCounter());
+        Matrix<double> b = Matrix<double>::RandomUniform(dim, n, deviceId, -1, 1, IncrementCounter());
+        Matrix<double> weights = Matrix<double>::RandomUniform(negNumber + 1, n, deviceId, -1, 1, IncrementCounter());
+        Matrix<double> invNormA(deviceId), invNormB(deviceId), value(deviceId);
+        value.AssignCosDistanceWithNegativeSamplesOf(a, b, shift, negNumber, invNormA, invNormB);
+
+        // the same with the shifted element and inner products
+        Matrix<double> aCopy(a.DeepClone()), bCopy(b.DeepClone());
+        Matrix<double> expectedInvNormA(deviceId), expectedInvNormB(deviceId), invNormProducts(deviceId), innerProducts(deviceId), expected(deviceId);
+        expectedInvNormA.AssignVectorNorm2Of(aCopy, true);
+        expectedInvNormA.AssignElementInverseOf(expectedInvNormA);
+        expectedInvNormB.AssignVectorNorm2Of(bCopy, true);
+        expectedInvNormB.AssignElementInverseOf(expectedInvNormB);
+        invNormProducts.AssignElementProductOfWithShiftNeg(expectedInvNormA, expectedInvNormB, shift, negNumber);
+        innerProducts.AssignInnerProductOfWithShiftNeg(aCopy, bCopy, true, shift, negNumber);
+        expected.AssignElementProductOf(invNormProducts, innerProducts);
+        BOOST_CHECK(value.IsEqualTo(expected, c_epsilonFloatE5));
+        BOOST_CHECK(invNormA.IsEqualTo(expectedInvNormA, c_epsilonFloatE5));
+
+        // the gradients of sum(weights .* value) against central differences
+        for (size_t inputIndex = 0; inputIndex < 2; inputIndex++)
+        {
+            Matrix<double> gradient = Matrix<double>::Zeros(dim, n, deviceId);
+            Matrix<double>::AddCosDistanceWithNegativeSamplesGradient(inputIndex, a, b, invNormA, invNormB, value, weights, shift, gradient);
+
+            Matrix<double>& input = (inputIndex == 0) ? a : b;
+            const double epsilon = 1e-6;
+            for (size_t j = 0; j < n; j++)
+            {
+                for (size_t i = 0; i < dim; i++)
+                {
+                    double original = input.GetValue(i, j);
+                    double objective[2];
+                    for (int sign = 0; sign < 2; sign++)
+                    {
+                        Matrix<double> invNorm0(deviceId), invNorm1(deviceId), perturbed(deviceId);
+                        input.SetValue(i, j, original + (sign ? epsilon : -epsilon));
+                        perturbed.AssignCosDistanceWithNegativeSamplesOf(a, b, shift, negNumber, invNorm0, invNorm1);
+                        perturbed.ElementMultiplyWith(weights);
+                        objective[sign] = perturbed.SumOfElements();
+                    }
+                    input.SetValue(i, j, original);
+                    BOOST_CHECK_LT(fabs((objective[1] - objective[0]) / (2 * epsilon) - gradient.GetValue(i, j)), c_epsilonFloatE4);
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixKhatriRaoProductGradient, RandomSeedFixture)
+{
+    const size_t rowsA = 37, rowsB = 11, cols = 29;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        Matrix<float> a = Matrix<float>::RandomUniform(rowsA, cols, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> b = Matrix<float>::RandomUniform(rowsB, cols, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> gradient = Matrix<float>::RandomUniform(rowsA * rowsB, cols, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> aGradient = Matrix<float>::RandomUniform(rowsA, cols, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> bGradient = Matrix<float>::RandomUniform(rowsB, cols, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> expectedAGradient(aGradient.DeepClone()), expectedBGradient(bGradient.DeepClone());
+
+        Matrix<float>::AddKhatriRaoProductGradient(gradient, a, b, aGradient, bGradient);
+
+        expectedAGradient.AddColumnReshapeProductOf(gradient, b, false);
+        expectedBGradient.AddColumnReshapeProductOf(gradient, a, true);
+        BOOST_CHECK(aGradient.IsEqualTo(expectedAGradient, c_epsilonFloatE4));
+        BOOST_CHECK(bGradient.IsEqualTo(expectedBGradient, c_epsilonFloatE4));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MatrixDiagTimes, RandomSeedFixture)
+{
+    const size_t rows = 429, cols = 67;
+    for (auto deviceId : {CPUDEVICE, c_deviceIdZero})
+    {
+        Matrix<float> diag = Matrix<float>::RandomUniform(rows, 1, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> a = Matrix<float>::RandomUniform(rows, cols, deviceId, -1, 1, IncrementCounter());
+        Matrix<float> b = Matrix<float>::RandomUniform(rows, cols, deviceId, -1, 1, IncrementCounter());
+
+        // this = diag(d) * a and this += diag(d) * a
+        Matrix<float> m(deviceId), expected(a.DeepClone());
+        m.AssignDiagTimesOf(diag, a);
+        expected.ColumnElementMultiplyWith(diag);
+        BOOST_CHECK(m.IsEqualTo(expected, c_epsilonFloatE5));
+
+        Matrix<float> sum(b.DeepClone());
+        sum.AddDiagTimesOf(diag, a);
+        expected += b;
+        BOOST_CHECK(sum.IsEqualTo(expected, c_epsilonFloatE5));
+
+        // this += the row-wise inner products
+        Matrix<float> innerProducts(diag.DeepClone()), expectedInnerProducts(deviceId);
+        innerProducts.AddRowInnerProductOf(a, b);
+        expectedInnerProducts.AssignInnerProductOf(a, b, false);
+        expectedInnerProducts += diag;
+        BOOST_CHECK(innerProducts.IsEqualTo(expectedInnerProducts, c_epsilonFloatE4));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
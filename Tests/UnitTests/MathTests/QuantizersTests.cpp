@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "../../../Source/Math/Quantizers.h"
 #include "../../../Source/Math/Helpers.h"
+#include "../../../Source/Math/Int8Multiplier.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -47,6 +49,48 @@ BOOST_FIXTURE_TEST_CASE(FloatToShort, RandomSeedFixture)
 
 }
 
+// Int8Multiplier: float product in int8 arithmetic, compared against a double-precision reference of the clipped input
+static void TestInt8Multiplier(size_t m, size_t k, size_t n, bool isRowMajor, float inputRange)
+{
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> a(m * k), b(k * n);
+    for (auto& x : a)
+        x = dist(rng);
+    for (auto& x : b)
+        x = dist(rng);
+    Matrix<float> aMatrix(isRowMajor ? k : m, isRowMajor ? m : k, a.data(), CPUDEVICE);
+    Matrix<float> bMatrix(k, n, b.data(), CPUDEVICE);
+    Matrix<float> cMatrix(m, n, CPUDEVICE);
+
+    Int8Multiplier<float> multiplier;
+    multiplier.SetA(aMatrix, m, k, isRowMajor);
+    multiplier.Multiply(bMatrix, cMatrix, inputRange);
+    for (size_t col = 0; col < n; col++)
+    {
+        for (size_t row = 0; row < m; row++)
+        {
+            double expected = 0;
+            for (size_t j = 0; j < k; j++)
+            {
+                float x = b[j + col * k];
+                if (inputRange > 0)
+                    x = std::max(-inputRange, std::min(inputRange, x));
+                expected += (double) (isRowMajor ? a[row * k + j] : a[row + j * m]) * x;
+            }
+            // the quantization error grows with sqrt(k)
+            BOOST_CHECK_SMALL(cMatrix(row, col) - expected, 1e-2 * sqrt((double) k));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Int8MultiplierMatchesFloatProduct)
+{
+    TestInt8Multiplier(8, 128, 8, /*isRowMajor=*/false, /*inputRange=*/0);
+    TestInt8Multiplier(37, 1000 + 3, 5, /*isRowMajor=*/true, /*inputRange=*/0);
+    TestInt8Multiplier(16, 256, 3, /*isRowMajor=*/false, /*inputRange=*/0.5f); // calibrated range, with clipping
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -85,6 +85,19 @@ BOOST_AUTO_TEST_CASE(BiasGradient2)
     });
 }
 
+BOOST_AUTO_TEST_CASE(NonlinearityOfSum)
+{
+    Test::TensorTest<float> tensorTester;
+
+    // fused ops of ComputationNetwork::FuseElementwiseNodes(), e.g. Sigmoid(W * x + b)
+    for (DEVICEID_TYPE deviceId : { 0, -1 })
+    {
+        tensorTester.NonlinearityOfSumTest(TensorShape{ 256, 64 }, TensorShape(256), opSigmoidOfSum, opSigmoid, deviceId);
+        tensorTester.NonlinearityOfSumTest(TensorShape{ 256, 64 }, TensorShape(256), opTanhOfSum, opTanh, deviceId);
+        tensorTester.NonlinearityOfSumTest(TensorShape{ 256, 64 }, TensorShape(256), opLinearRectifierOfSum, opLinearRectifier, deviceId);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ColumnSliceMultAndAdd)
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
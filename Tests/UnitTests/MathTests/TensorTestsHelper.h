@@ -86,6 +86,20 @@ struct TensorTest
         result.AssignSumOf(input, bias);
         return result;
     }
+
+    // test a nonlinearity fused with a broadcast summation against the summation followed by the nonlinearity
+    void NonlinearityOfSumTest(TensorShape layerShape, TensorShape biasShape, ElementWiseOperator fusedOp, ElementWiseOperator op, DEVICEID_TYPE deviceId)
+    {
+        int randomSeed = 1;
+        let  input = CreateTensor(layerShape, randomSeed++, deviceId);
+        let  bias = CreateTensor(biasShape, randomSeed++, deviceId);
+        auto fused = CreateTensor(layerShape, randomSeed++, deviceId, true);
+        fused.DoBinaryOpOf(0, input, bias, 1, fusedOp, opSum);
+        auto unfused = CreateTensor(layerShape, randomSeed++, deviceId, true);
+        unfused.AssignSumOf(input, bias);
+        unfused.DoUnaryOpOf(0, unfused, 1, op, opSum);
+        BOOST_CHECK(fused.GetSOB().IsEqualTo(unfused.GetSOB(), (ElemType)1e-6));
+    }
 };
 
 template <class ElemType>
@@ -0,0 +1,187 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReaderPerformanceTests.cpp : measures the throughput of a reader in isolation from training.
+//
+// The reader is driven through DataReader the way SGD drives it, but the minibatches are dropped instead of
+// being fed to a network, so that the time measured is the time of the reader only:
+//
+//   ReaderPerformanceTests configFile=<config file> [<name>=<value> ...]
+//
+//   precision = "float"          # float or double
+//   deviceId = -1                # device of the input matrices, -1 for the CPU
+//   minibatchSize = 256          # in samples
+//   epochSize = 0                # in samples, 0 for the whole data set
+//   maxEpochs = 1
+//   inputs = "features:labels"   # names of the inputs to read
+//   sparseInputs = ""            # names of the inputs that are sparse
+//   reader = [ ... ]             # the reader to measure, any reader configuration
+//
+// For each epoch, the samples/s and minibatches/s are printed, and the CPU time of the process over the elapsed time,
+// i.e. the average number of busy threads. Readers on top of ReaderShim are run with stageTimes=true, so that they
+// also print the time spent in each stage of reading (load, deserialize, transform, pack, transfer, wait) and the MB/s
+// transferred to the input matrices.
+//
+#include "stdafx.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#else
+#include <sys/resource.h>
+#endif
+#include "Basics.h"
+#include "Config.h"
+#include "DataReader.h"
+#include "Matrix.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+// User and kernel time of all threads of the process, in seconds.
+static double GetProcessCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0;
+    }
+    auto toSeconds = [](const FILETIME& t) { return (((unsigned long long)t.dwHighDateTime << 32) + t.dwLowDateTime) * 1e-7; };
+    return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+template <class ElemType>
+static void MeasureReader(const ConfigParameters& config)
+{
+    DEVICEID_TYPE deviceId = config(L"deviceId", CPUDEVICE);
+    size_t minibatchSize = config(L"minibatchSize", (size_t)256);
+    size_t epochSize = config(L"epochSize", (size_t)0);
+    size_t maxEpochs = config(L"maxEpochs", (size_t)1);
+    vector<wstring> inputNames = config(L"inputs", ConfigParameters::Array(stringargvector(vector<wstring>{ L"features", L"labels" })));
+    vector<wstring> sparseInputNames = config(L"sparseInputs", ConfigParameters::Array(stringargvector()));
+
+    if (epochSize == 0)
+    {
+        epochSize = requestDataSize;
+    }
+
+    ConfigParameters readerConfig = config(L"reader");
+    if (!readerConfig.Exists(L"precision"))
+    {
+        readerConfig.Insert("precision", config(L"precision", "float"));
+    }
+    if (!readerConfig.Exists(L"stageTimes"))
+    {
+        readerConfig.Insert("stageTimes", "true");
+    }
+
+    DataReader reader(readerConfig);
+
+    // Each input has its own layout, the reader decides which of them are the same.
+    StreamMinibatchInputs inputs;
+    for (const auto& name : inputNames)
+    {
+        auto matrix = make_shared<Matrix<ElemType>>(deviceId);
+        if (find(sparseInputNames.begin(), sparseInputNames.end(), name) != sparseInputNames.end())
+        {
+            matrix->SwitchToMatrixType(MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC, false);
+        }
+        inputs.insert(make_pair(name, StreamMinibatchInputs::Input(matrix, make_shared<MBLayout>(1, 0, name), TensorShape())));
+    }
+
+    for (size_t epoch = 0; epoch < maxEpochs; ++epoch)
+    {
+        auto start = chrono::steady_clock::now();
+        double startCpuSeconds = GetProcessCpuSeconds();
+
+        reader.StartMinibatchLoop(minibatchSize, epoch, epochSize);
+
+        size_t numberOfMinibatches = 0;
+        size_t numberOfSamples = 0;
+        while (reader.GetMinibatch(inputs))
+        {
+            // Inputs of different dynamic axes can have different numbers of samples, the largest one is counted.
+            size_t minibatchSamples = 0;
+            for (const auto& input : inputs)
+            {
+                minibatchSamples = max(minibatchSamples, input.second.pMBLayout->GetActualNumSamples());
+            }
+
+            numberOfSamples += minibatchSamples;
+            numberOfMinibatches++;
+        }
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        double seconds = elapsed.count();
+        double cpuSeconds = GetProcessCpuSeconds() - startCpuSeconds;
+        fprintf(stderr, "Epoch %d: %d minibatches, %d samples in %.3fs: %.1f samples/s, %.1f minibatches/s, %.2f busy threads\n",
+                (int)epoch + 1, (int)numberOfMinibatches, (int)numberOfSamples, seconds,
+                seconds > 0 ? numberOfSamples / seconds : 0.0,
+                seconds > 0 ? numberOfMinibatches / seconds : 0.0,
+                seconds > 0 ? cpuSeconds / seconds : 0.0);
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        ConfigParameters config;
+        const std::string rawConfigString = ConfigParameters::ParseCommandLine(argc, argv, config);
+        config.ResolveVariables(rawConfigString);
+
+        string precision = config(L"precision", "float");
+        if (precision == "float")
+        {
+            MeasureReader<float>(config);
+        }
+        else if (precision == "double")
+        {
+            MeasureReader<double>(config);
+        }
+        else
+        {
+            InvalidArgument("The 'precision' parameter must be 'float' or 'double'.");
+        }
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef __UNIX__
+// UNIX main function converts arguments in UTF-8 encoding and passes to Visual-Studio style wmain() which takes wchar_t strings.
+int main(int argc, char* argv[])
+{
+    vector<wstring> arguments;
+    for (int i = 0; i < argc; ++i)
+    {
+        arguments.push_back(msra::strfun::utf16(argv[i]));
+    }
+
+    vector<wchar_t*> wargv;
+    for (auto& argument : arguments)
+    {
+        wargv.push_back(&argument[0]);
+    }
+    return wmain(argc, wargv.data());
+}
+#endif
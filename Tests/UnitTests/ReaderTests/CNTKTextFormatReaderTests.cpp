@@ -119,6 +119,27 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_MNIST_dense)
         1);
 };
 
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_MNIST_dense_memoryMapped)
+{
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/MNIST_dense.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/MNIST_dense_memoryMapped_Output.txt",
+        "MNIST",
+        "reader",
+        1000, // epoch size
+        1000,  // mb size
+        1,   // num epochs
+        1,
+        1,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"MNIST=[reader=[memoryMapFile=true]]" });
+};
+
 // 1 single sample sequence
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_1x1_1_dense)
 {
@@ -281,6 +302,28 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_50x20_jagged_sequences_dense)
         1);
 };
 
+// same as above, but indexed by the range-based (parallel) indexer
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_50x20_jagged_sequences_dense_parallelIndexing)
+{
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKTextFormatReader/dense.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_dense.txt",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_dense_parallelIndexing_Output.txt",
+        "50x20_jagged_sequences",
+        "reader",
+        508,  // epoch size
+        508,  // mb size 
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"50x20_jagged_sequences=[reader=[numIndexingThreads=4]]" });
+};
+
 // 1 single sample sequence
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_1x1_sparse)
 {
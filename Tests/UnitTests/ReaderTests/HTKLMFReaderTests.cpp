@@ -384,6 +384,64 @@ BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop1)
         1);
 };
 
+BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop1MlfCache)
+{
+    auto test = [this](std::vector<std::wstring> additionalParameters)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/HTKDeserializersSimpleDataLoop1_Config.cntk",
+            testDataPath() + "/Control/HTKMLFReaderSimpleDataLoop1_5_11_Control.txt",
+            testDataPath() + "/Control/HTKMLFReaderSimpleDataLoop1_Output.txt",
+            "Simple_Test",
+            "reader",
+            500,
+            250,
+            2,
+            1,
+            1,
+            0,
+            1,
+            false,
+            false,
+            true,
+            additionalParameters);
+    };
+
+    // The labels must be the same as parsed ones; the first run writes the cache, the second one reads it.
+    boost::filesystem::remove("HTKDeserializersSimpleDataLoop1.mlfcache");
+    test({ L"Simple_Test=[reader=[labels=[mlfCache=HTKDeserializersSimpleDataLoop1.mlfcache]]]" });
+    test({ L"Simple_Test=[reader=[labels=[mlfCache=HTKDeserializersSimpleDataLoop1.mlfcache]]]" });
+};
+
+BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop1FeatureArchive)
+{
+    auto test = [this](std::vector<std::wstring> additionalParameters)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/HTKDeserializersSimpleDataLoop1_Config.cntk",
+            testDataPath() + "/Control/HTKMLFReaderSimpleDataLoop1_5_11_Control.txt",
+            testDataPath() + "/Control/HTKMLFReaderSimpleDataLoop1_Output.txt",
+            "Simple_Test",
+            "reader",
+            500,
+            250,
+            2,
+            1,
+            1,
+            0,
+            1,
+            false,
+            false,
+            true,
+            additionalParameters);
+    };
+
+    // The features must be the same as read from the HTK files; the first run writes the archive, the second one maps it.
+    boost::filesystem::remove("HTKDeserializersSimpleDataLoop1.features");
+    test({ L"Simple_Test=[reader=[features=[featureArchive=HTKDeserializersSimpleDataLoop1.features]]]" });
+    test({ L"Simple_Test=[reader=[features=[featureArchive=HTKDeserializersSimpleDataLoop1.features]]]" });
+};
+
 BOOST_AUTO_TEST_CASE(HTKDeserializersSimpleDataLoop5)
 {
     HelperRunReaderTest<float>(
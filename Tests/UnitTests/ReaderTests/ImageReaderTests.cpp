@@ -36,6 +36,39 @@ BOOST_AUTO_TEST_CASE(ImageReaderSimple)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderSimpleImageCache)
+{
+    auto test = [this](std::vector<std::wstring> additionalParameters)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/ImageReaderSimple_Config.cntk",
+            testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+            testDataPath() + "/Control/ImageReaderSimple_Output.txt",
+            "Simple_Test",
+            "reader",
+            4,
+            4,
+            1,
+            1,
+            0,
+            0,
+            1,
+            false,
+            false,
+            true,
+            additionalParameters);
+    };
+
+    // Unscaled images must be the same as decoded ones; the first run builds the cache, the second one reads it.
+    boost::filesystem::remove("ImageReaderSimple.cache");
+    test({ L"Simple_Test=[reader=[imageCache=ImageReaderSimple.cache;imageCacheSide=0]]" });
+    test({ L"Simple_Test=[reader=[imageCache=ImageReaderSimple.cache;imageCacheSide=0]]" });
+
+    boost::filesystem::remove("ImageReaderSimpleCompressed.cache");
+    test({ L"Simple_Test=[reader=[imageCache=ImageReaderSimpleCompressed.cache;imageCacheSide=0;imageCacheCompressed=true]]" });
+    test({ L"Simple_Test=[reader=[imageCache=ImageReaderSimpleCompressed.cache;imageCacheSide=0;imageCacheCompressed=true]]" });
+}
+
 BOOST_AUTO_TEST_CASE(ImageAndTextReaderSimple)
 {
     HelperRunReaderTest<float>(
@@ -147,6 +180,31 @@ BOOST_AUTO_TEST_CASE(ImageReaderZip)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderZipCachedIndex)
+{
+    // The first run saves the index of the zip file, the second one loads it.
+    for (int i = 0; i < 2; ++i)
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/ImageReaderZip_Config.cntk",
+            testDataPath() + "/Control/ImageReaderZip_Control.txt",
+            testDataPath() + "/Control/ImageReaderZip_Output.txt",
+            "Zip_Test",
+            "reader",
+            4,
+            4,
+            1,
+            1,
+            0,
+            0,
+            1,
+            false,
+            false,
+            true,
+            { L"Zip_Test=[reader=[cacheZipIndex=true]]" });
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderZipMissingFile)
 {
     BOOST_REQUIRE_EXCEPTION(
@@ -184,6 +242,28 @@ BOOST_AUTO_TEST_CASE(ImageReaderMultiView)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderMultiViewUnfused)
+{
+    // The separate transformations must give the same output as the fused one.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderMultiView_Config.cntk",
+        testDataPath() + "/Control/ImageReaderMultiView_Control.txt",
+        testDataPath() + "/Control/ImageReaderMultiView_Output.txt",
+        "MultiView_Test",
+        "reader",
+        10,
+        10,
+        1,
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"MultiView_Test=[reader=[fuseTransforms=false]]" });
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderIntensityTransform)
 {
     HelperRunReaderTest<float>(
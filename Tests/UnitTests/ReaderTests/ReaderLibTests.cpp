@@ -6,9 +6,17 @@
 #include "stdafx.h"
 
 #include "NoRandomizer.h"
+#include "ShuffleBufferRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
+#include "TransformController.h"
 #include "CorpusDescriptor.h"
+#include "BinaryChunkWriter.h"
+#include "BinaryChunkDeserializer.h"
+#include "DataReader.h"
+#include "Bundler.h"
+#include "SequencePacker.h"
+#include "HeapMemoryProvider.h"
 
 #include <numeric>
 #include <random>
@@ -129,9 +137,15 @@ public:
         return chunk;
     }
 
-    virtual bool GetSequenceDescription(const SequenceDescription&, SequenceDescription&) override
+    // The keys of the mock sequences are made of their index.
+    virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override
     {
-        throw logic_error("Not implemented");
+        if (primary.m_key.m_sample >= m_descriptions.size())
+        {
+            return false;
+        }
+        description = m_descriptions[primary.m_key.m_sample];
+        return true;
     }
 
     virtual ChunkDescriptions GetChunkDescriptions() override
@@ -296,6 +310,79 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks2)
     BlockRandomizerOneEpochWithChunks2Test(true);
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithLengthBuckets)
+{
+    vector<float> data(20);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(4, 5, data);
+
+    auto randomizer = make_shared<BlockRandomizer>(0, 10, mockDeserializer, false, BlockRandomizer::DecimationMode::chunk, false, false, 1, 2);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = data.size();
+    epochConfiguration.m_epochIndex = 0;
+    randomizer->StartEpoch(epochConfiguration);
+
+    // Buckets only reorder the sequences, each one is still read once per sweep.
+    vector<float> actual;
+    for (int i = 0; i < data.size() + 1; i++)
+    {
+        Sequences sequences = randomizer->GetNextSequences(1);
+        BOOST_CHECK_EQUAL(sequences.m_data.size(), 1 - (i / data.size()));
+        if (i < data.size())
+        {
+            auto data = reinterpret_cast<DenseSequenceData&>(*sequences.m_data[0][0]);
+            actual.push_back(*((float*)data.m_data));
+        }
+        BOOST_CHECK_EQUAL(sequences.m_endOfEpoch, (data.size() <= i));
+    }
+    sort(actual.begin(), actual.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(),
+        actual.begin(), actual.end());
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochBalancedDecimation)
+{
+    const size_t numWorkers = 3;
+    vector<float> data(20);
+    iota(data.begin(), data.end(), 0.0f);
+
+    // Each worker reads the same minibatches and keeps its part of each; together they read every sequence once.
+    vector<float> actual;
+    for (size_t rank = 0; rank < numWorkers; rank++)
+    {
+        auto mockDeserializer = make_shared<MockDeserializer>(4, 5, data, 2);
+        auto randomizer = make_shared<BlockRandomizer>(0, SIZE_MAX, mockDeserializer, false, BlockRandomizer::DecimationMode::balanced, false);
+
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = numWorkers;
+        epochConfiguration.m_workerRank = rank;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = data.size() * 2;
+        epochConfiguration.m_epochIndex = 0;
+        randomizer->StartEpoch(epochConfiguration);
+
+        for (;;)
+        {
+            // a minibatch of 7 sequences of 2 samples: 3, 2 and 2 sequences to the workers
+            Sequences sequences = randomizer->GetNextSequences(14);
+            if (sequences.m_endOfEpoch)
+                break;
+            if (sequences.m_data.empty())
+                continue;
+            BOOST_CHECK_LE(sequences.m_data[0].size(), 3);
+            for (const auto& sequence : sequences.m_data[0])
+                actual.push_back(*((float*)reinterpret_cast<DenseSequenceData&>(*sequence).m_data));
+        }
+    }
+    sort(actual.begin(), actual.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(),
+        actual.begin(), actual.end());
+}
+
 void BlockRandomizerChaosMonkeyTest(bool prefetch)
 {
     const int sequenceLength = 3;
@@ -356,6 +443,59 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerChaosMonkey)
     BlockRandomizerChaosMonkeyTest(true);
 }
 
+// Reads all epochs from a randomizer, starting it at each epoch as on restart from a checkpoint, if requested.
+vector<vector<float>> ReadAllEpochs(IDataDeserializerPtr deserializer, size_t epochs, size_t epochSize, bool restartEachEpoch)
+{
+    shared_ptr<BlockRandomizer> randomizer;
+    vector<vector<float>> result(epochs);
+    for (size_t epoch = 0; epoch < epochs; ++epoch)
+    {
+        if (restartEachEpoch || !randomizer)
+        {
+            randomizer = make_shared<BlockRandomizer>(0, 15, deserializer, false, BlockRandomizer::DecimationMode::chunk, false);
+        }
+
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = 1;
+        epochConfiguration.m_workerRank = 0;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = epochSize;
+        epochConfiguration.m_epochIndex = epoch;
+        randomizer->StartEpoch(epochConfiguration);
+
+        for (;;)
+        {
+            Sequences sequences = randomizer->GetNextSequences(3);
+            for (const auto& sequence : sequences.m_data.empty() ? vector<SequenceDataPtr>() : sequences.m_data[0])
+            {
+                result[epoch].push_back(*((float*)sequence->m_data));
+            }
+            if (sequences.m_endOfEpoch)
+            {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerRestartAtEpoch)
+{
+    vector<float> data(100);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(20, 5, data);
+
+    // Epochs do not align with chunks or sweeps, the restarted randomizer has to seek into the sweep.
+    auto continuous = ReadAllEpochs(mockDeserializer, 30, 7, false);
+    auto restarted = ReadAllEpochs(mockDeserializer, 30, 7, true);
+    for (size_t epoch = 0; epoch < continuous.size(); ++epoch)
+    {
+        BOOST_CHECK(!continuous[epoch].empty());
+        BOOST_CHECK_EQUAL_COLLECTIONS(continuous[epoch].begin(), continuous[epoch].end(),
+                                      restarted[epoch].begin(), restarted[epoch].end());
+    }
+}
+
 void BlockRandomizerOneEpochLegacyRandomizationTest(bool prefetch)
 {
     vector<float> data(10);
@@ -440,6 +580,423 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+// Returns the values of the data one sequence of a single sample after another.
+class MockStreamingDeserializer : public IStreamingDataDeserializer
+{
+private:
+    vector<float>& m_data;
+    size_t m_position;
+    vector<StreamDescriptionPtr> m_streams;
+
+public:
+    MockStreamingDeserializer(vector<float>& data)
+        : m_data(data),
+          m_position(0)
+    {
+        m_streams.push_back(make_shared<StreamDescription>(StreamDescription{
+            L"input",
+            0,
+            StorageType::dense,
+            ElementType::tfloat,
+            make_shared<TensorShape>(1)
+        }));
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    bool GetNextSequence(vector<SequenceDataPtr>& result) override
+    {
+        if (m_position == m_data.size())
+        {
+            return false;
+        }
+
+        auto data = make_shared<DenseSequenceData>();
+        data->m_data = &m_data[m_position++];
+        data->m_numberOfSamples = 1;
+        data->m_sampleLayout = m_streams[0]->m_sampleLayout;
+        result.push_back(data);
+        return true;
+    }
+};
+
+void ShuffleBufferRandomizerTest(size_t bufferSize)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto randomizer = make_shared<ShuffleBufferRandomizer>(make_shared<MockStreamingDeserializer>(data), bufferSize);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = 4;
+
+    // Two epochs of 4 samples, then the rest of the input.
+    vector<float> actual;
+    for (size_t epoch = 0; epoch < 3; ++epoch)
+    {
+        if (epoch == 2)
+        {
+            epochConfiguration.m_totalEpochSizeInSamples = requestDataSize;
+        }
+        epochConfiguration.m_epochIndex = epoch;
+        randomizer->StartEpoch(epochConfiguration);
+
+        size_t epochSize = epoch < 2 ? 4 : 2;
+        for (size_t i = 0; i < epochSize; i += 2)
+        {
+            Sequences sequences = randomizer->GetNextSequences(2);
+            BOOST_CHECK(!sequences.m_endOfEpoch);
+            BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1u);
+            BOOST_REQUIRE_EQUAL(sequences.m_data[0].size(), 2u);
+            for (const auto& sequence : sequences.m_data[0])
+            {
+                BOOST_CHECK_EQUAL(sequence->m_numberOfSamples, 1u);
+                // A sequence cannot be returned before it has been read into the buffer.
+                float value = *((float*)sequence->m_data);
+                BOOST_CHECK_LE(value, actual.size() + bufferSize);
+                actual.push_back(value);
+            }
+        }
+        BOOST_CHECK(randomizer->GetNextSequences(2).m_endOfEpoch);
+    }
+
+    if (bufferSize == 0)
+    {
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), actual.begin(), actual.end());
+    }
+    else
+    {
+        BOOST_CHECK(!equal(data.begin(), data.end(), actual.begin()));
+        sort(actual.begin(), actual.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), actual.begin(), actual.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ShuffleBufferRandomizerOneEpoch)
+{
+    ShuffleBufferRandomizerTest(0);
+    ShuffleBufferRandomizerTest(5);
+}
+
+BOOST_AUTO_TEST_CASE(NoRandomizerShardedChunks)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // Worker 0 gets chunks 0, 2, 4 in the first sweep, and chunks 1, 3 in the second.
+    vector<vector<float>> expected = { { 0, 1, 4, 5, 8, 9 }, { 2, 3, 6, 7 } };
+    for (size_t rank = 0; rank < 2; ++rank)
+    {
+        auto randomizer = make_shared<NoRandomizer>(mockDeserializer, false, true);
+        for (size_t epoch = 0; epoch < 2; ++epoch)
+        {
+            EpochConfiguration epochConfiguration;
+            epochConfiguration.m_numberOfWorkers = 2;
+            epochConfiguration.m_workerRank = rank;
+            epochConfiguration.m_minibatchSizeInSamples = 0;
+            epochConfiguration.m_totalEpochSizeInSamples = requestDataSize;
+            epochConfiguration.m_epochIndex = epoch;
+            randomizer->StartEpoch(epochConfiguration);
+
+            vector<float> actual;
+            for (;;)
+            {
+                Sequences sequences = randomizer->GetNextSequences(2);
+                if (sequences.m_endOfEpoch)
+                {
+                    break;
+                }
+                BOOST_REQUIRE_EQUAL(sequences.m_data[0].size(), 1u);
+                actual.push_back(*((float*)sequences.m_data[0][0]->m_data));
+            }
+
+            const auto& expectedData = expected[(rank + epoch) % 2];
+            BOOST_CHECK_EQUAL_COLLECTIONS(expectedData.begin(), expectedData.end(),
+                                          actual.begin(), actual.end());
+        }
+    }
+}
+
+void BinaryChunkRoundTripTest(bool memoryMapFile)
+{
+    vector<float> data(12);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(4, 3, data, 2);
+    BinaryChunkWriter::Write(mockDeserializer, L"binaryChunks.tmp");
+
+    ConfigParameters config;
+    config.Insert("file", "binaryChunks.tmp");
+    config.Insert("memoryMapFile", memoryMapFile ? "true" : "false");
+    auto deserializer = make_shared<BinaryChunkDeserializer>(config);
+
+    auto streams = deserializer->GetStreamDescriptions();
+    BOOST_REQUIRE_EQUAL(streams.size(), 1u);
+    BOOST_CHECK(streams[0]->m_name == L"input");
+    BOOST_CHECK_EQUAL(streams[0]->m_sampleLayout->GetNumElements(), 1u);
+
+    auto chunks = deserializer->GetChunkDescriptions();
+    BOOST_REQUIRE_EQUAL(chunks.size(), 4u);
+
+    vector<float> actual;
+    for (const auto& chunk : chunks)
+    {
+        BOOST_CHECK_EQUAL(chunk->m_numberOfSequences, 3u);
+        BOOST_CHECK_EQUAL(chunk->m_numberOfSamples, 6u);
+
+        vector<SequenceDescription> sequences;
+        deserializer->GetSequencesForChunk(chunk->m_id, sequences);
+        auto chunkData = deserializer->GetChunk(chunk->m_id);
+        for (const auto& sequence : sequences)
+        {
+            BOOST_CHECK_EQUAL(sequence.m_numberOfSamples, 2u);
+            vector<SequenceDataPtr> result;
+            chunkData->GetSequence(sequence.m_id, result);
+            BOOST_REQUIRE_EQUAL(result.size(), 1u);
+            BOOST_CHECK_EQUAL(result[0]->m_numberOfSamples, 2u);
+            const float* values = reinterpret_cast<const float*>(result[0]->m_data);
+            BOOST_CHECK_EQUAL(values[0], values[1]);
+            actual.push_back(values[0]);
+        }
+    }
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(),
+                                  actual.begin(), actual.end());
+
+    deserializer.reset();
+    remove("binaryChunks.tmp");
+}
+
+BOOST_AUTO_TEST_CASE(BinaryChunkRoundTrip)
+{
+    BinaryChunkRoundTripTest(false);
+    BinaryChunkRoundTripTest(true);
+}
+
+void BundlerTest(bool parallelChunkLoading)
+{
+    vector<float> data(20);
+    iota(data.begin(), data.end(), 0.0f);
+    vector<float> secondaryData(16);
+    iota(secondaryData.begin(), secondaryData.end(), 100.0f);
+
+    // The secondary deserializer has different chunks and misses the last chunk of the driver.
+    IDataDeserializerPtr driver = make_shared<MockDeserializer>(5, 4, data);
+    IDataDeserializerPtr secondary = make_shared<MockDeserializer>(2, 8, secondaryData);
+
+    ConfigParameters config;
+    config.Insert("parallelChunkLoading", parallelChunkLoading ? "true" : "false");
+    auto bundler = make_shared<Bundler>(config, driver, vector<IDataDeserializerPtr>{ driver, secondary }, true);
+    BOOST_CHECK_EQUAL(bundler->GetStreamDescriptions().size(), 2u);
+
+    auto chunks = bundler->GetChunkDescriptions();
+    BOOST_REQUIRE_EQUAL(chunks.size(), 4u);
+
+    // Every chunk is loaded twice, the second time with the sequences looked up before.
+    vector<float> expected;
+    vector<float> actual;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        expected.insert(expected.end(), data.begin(), data.begin() + secondaryData.size());
+        for (const auto& chunk : chunks)
+        {
+            vector<SequenceDescription> sequences;
+            bundler->GetSequencesForChunk(chunk->m_id, sequences);
+            BOOST_CHECK_EQUAL(sequences.size(), 4u);
+
+            auto chunkData = bundler->GetChunk(chunk->m_id);
+            for (const auto& sequence : sequences)
+            {
+                vector<SequenceDataPtr> result;
+                chunkData->GetSequence(sequence.m_id, result);
+                BOOST_REQUIRE_EQUAL(result.size(), 2u);
+                float first = *reinterpret_cast<const float*>(result[0]->m_data);
+                float second = *reinterpret_cast<const float*>(result[1]->m_data);
+                BOOST_CHECK_EQUAL(first + 100.0f, second);
+                actual.push_back(first);
+            }
+        }
+    }
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  actual.begin(), actual.end());
+}
+
+BOOST_AUTO_TEST_CASE(BundlerOneEpoch)
+{
+    BundlerTest(false);
+    BundlerTest(true);
+}
+
+// Negates the single float value of each sample.
+class MockNegateTransformer : public Transformer
+{
+public:
+    void StartEpoch(const EpochConfiguration&) override {}
+
+    StreamDescription Transform(const StreamDescription& inputStream) override
+    {
+        return inputStream;
+    }
+
+    SequenceDataPtr Transform(SequenceDataPtr inputSequence) override
+    {
+        auto result = make_shared<MockSequenceWithBuffer>();
+        const float* values = reinterpret_cast<const float*>(inputSequence->m_data);
+        for (size_t i = 0; i < inputSequence->m_numberOfSamples; ++i)
+        {
+            result->m_buffer.push_back(-values[i]);
+        }
+        result->m_data = result->m_buffer.data();
+        result->m_numberOfSamples = inputSequence->m_numberOfSamples;
+        result->m_sampleLayout = inputSequence->m_sampleLayout;
+        return result;
+    }
+
+private:
+    struct MockSequenceWithBuffer : DenseSequenceData
+    {
+        vector<float> m_buffer;
+    };
+};
+
+void TransformControllerOneEpochTest(bool multithreadedGetNextSequences)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 1.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // With a multithreaded randomizer, the transformation is applied by the randomizer's worker threads.
+    auto randomizer = make_shared<NoRandomizer>(mockDeserializer, multithreadedGetNextSequences);
+    vector<Transformation> transformations { Transformation{ make_shared<MockNegateTransformer>(), L"input" } };
+    auto controller = make_shared<TransformController>(transformations, randomizer);
+
+    EpochConfiguration epochConfiguration;
+    epochConfiguration.m_numberOfWorkers = 1;
+    epochConfiguration.m_workerRank = 0;
+    epochConfiguration.m_minibatchSizeInSamples = 0;
+    epochConfiguration.m_totalEpochSizeInSamples = data.size();
+    epochConfiguration.m_epochIndex = 0;
+    controller->StartEpoch(epochConfiguration);
+
+    Sequences sequences = controller->GetNextSequences(data.size());
+    BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1u);
+    BOOST_REQUIRE_EQUAL(sequences.m_data[0].size(), data.size());
+
+    vector<float> expected;
+    vector<float> actual;
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        expected.push_back(-data[i]);
+        actual.push_back(*reinterpret_cast<const float*>(sequences.m_data[0][i]->m_data));
+    }
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  actual.begin(), actual.end());
+}
+
+BOOST_AUTO_TEST_CASE(TransformControllerOneEpoch)
+{
+    TransformControllerOneEpochTest(false);
+    TransformControllerOneEpochTest(true);
+}
+
+// Returns the given sparse sequences of one sample each as one minibatch.
+class MockSparseSequenceEnumerator : public SequenceEnumerator
+{
+    vector<StreamDescriptionPtr> m_streams;
+    vector<SequenceDataPtr> m_sequences;
+
+public:
+    MockSparseSequenceEnumerator(const vector<SequenceDataPtr>& sequences)
+        : m_sequences(sequences)
+    {
+        m_streams.push_back(make_shared<StreamDescription>(StreamDescription{
+            L"input",
+            0,
+            StorageType::sparse_csc,
+            ElementType::tfloat,
+            make_shared<TensorShape>(10)
+        }));
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return m_streams;
+    }
+
+    void StartEpoch(const EpochConfiguration&) override
+    {
+    }
+
+    Sequences GetNextSequences(size_t) override
+    {
+        Sequences result;
+        result.m_data.push_back(m_sequences);
+        return result;
+    }
+};
+
+// One-hot sequences are packed without values, unless the minibatch also holds sequences with values.
+BOOST_AUTO_TEST_CASE(SequencePackerImplicitOnes)
+{
+    vector<IndexType> indices0 = { 3 };
+    vector<IndexType> indices1 = { 7 };
+    vector<float> values1 = { 2.0f };
+    auto createSequence = [](vector<IndexType>& indices, vector<float>* values)
+    {
+        auto sequence = make_shared<SparseSequenceData>();
+        sequence->m_numberOfSamples = 1;
+        sequence->m_indices = indices.data();
+        sequence->m_nnzCounts.push_back(1);
+        sequence->m_totalNnzCount = 1;
+        sequence->m_data = values ? values->data() : nullptr;
+        return sequence;
+    };
+
+    for (bool withValues : { false, true })
+    {
+        vector<SequenceDataPtr> sequences = { createSequence(indices0, nullptr), createSequence(indices1, withValues ? &values1 : nullptr) };
+        auto enumerator = make_shared<MockSparseSequenceEnumerator>(sequences);
+        SequencePacker packer(make_shared<HeapMemoryProvider>(), enumerator, enumerator->GetStreamDescriptions());
+
+        EpochConfiguration config;
+        config.m_numberOfWorkers = 1;
+        config.m_workerRank = 0;
+        config.m_minibatchSizeInSamples = 2;
+        config.m_totalEpochSizeInSamples = 2;
+        config.m_epochIndex = 0;
+        packer.StartEpoch(config);
+
+        Minibatch minibatch = packer.ReadMinibatch();
+        BOOST_REQUIRE_EQUAL(minibatch.m_data.size(), 1u);
+        const auto& stream = *minibatch.m_data[0];
+        BOOST_CHECK_EQUAL(stream.m_hasImplicitOnes, !withValues);
+
+        // nnz count, values unless implicit, row indices and column offsets
+        const size_t* data = reinterpret_cast<const size_t*>(stream.m_data);
+        BOOST_REQUIRE_EQUAL(*data, 2u);
+        const float* values = reinterpret_cast<const float*>(data + 1);
+        const IndexType* rows = reinterpret_cast<const IndexType*>(values + (withValues ? 2 : 0));
+        if (withValues)
+        {
+            BOOST_CHECK_EQUAL(values[0], 1.0f);
+            BOOST_CHECK_EQUAL(values[1], 2.0f);
+        }
+        BOOST_CHECK_EQUAL(rows[0], 3);
+        BOOST_CHECK_EQUAL(rows[1], 7);
+        const IndexType* columns = rows + 2;
+        BOOST_CHECK_EQUAL(columns[0], 0);
+        BOOST_CHECK_EQUAL(columns[1], 1);
+        BOOST_CHECK_EQUAL(columns[2], 2);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(DefaultCorpusDescriptor)
 {
     const int seed = 13;
@@ -472,6 +1029,33 @@ BOOST_AUTO_TEST_CASE(CorpusDescriptorFromFile)
     remove("test.tmp");
 }
 
+BOOST_AUTO_TEST_CASE(StringToIdMapIds)
+{
+    // Enough strings for the hash table to grow a few times.
+    const size_t numberOfValues = 10000;
+
+    StringToIdMap registry;
+    for (size_t i = 0; i < numberOfValues; ++i)
+    {
+        BOOST_CHECK_EQUAL(i, registry[std::to_string(i * 7)]);
+    }
+    BOOST_CHECK_EQUAL(numberOfValues, registry.Size());
+    BOOST_CHECK_EQUAL(0, registry[std::string("0")]);
+    BOOST_CHECK_EQUAL(numberOfValues, registry[std::string("")]);
+    BOOST_CHECK_EQUAL(numberOfValues + 1, registry.Size());
+
+    const StringToIdMap& constRegistry = registry;
+    for (size_t i = 0; i < numberOfValues; ++i)
+    {
+        size_t id = SIZE_MAX;
+        BOOST_CHECK(registry.TryGet(std::to_string(i * 7), id));
+        BOOST_CHECK_EQUAL(i, id);
+        BOOST_CHECK_EQUAL(std::to_string(i * 7), constRegistry[i]);
+        BOOST_CHECK(!registry.Contains(std::to_string(i * 7 + 1)));
+    }
+    BOOST_CHECK_EQUAL(std::string(), constRegistry[numberOfValues]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -0,0 +1,278 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Benchmarks.cpp : measures the overhead and throughput of the V2 library on the models of the V2 library tests.
+//
+// The feed-forward, recurrent and ResNet models of FeedForwardTests.cpp, RecurrentFunctionTests.cpp and CifarResNet.cpp
+// are run on random minibatches of a fixed size, through Function::Forward()/Backward() and through Trainer::TrainMinibatch():
+//
+//   v2librarybenchmarks [device=<id>] [models=<name>:<name>...] [iterations=100] [warmup=10]
+//
+//   device = default device       # -1 for the CPU, otherwise the GPU to run on
+//   models = all                  # feedForward, feedForwardTiny, recurrent, recurrentTiny, resNet (GPU only, as in TestCifarResnet())
+//   iterations = 100              # measured calls per model and interface
+//   warmup = 10                   # calls per model and interface before the measurement
+//
+// For every model, one line gives the time of a Forward() and a Backward() call and of a TrainMinibatch() call as seen
+// by the caller, the samples/s of the training, and the peak memory. The *Tiny models have a few dozen parameters, so
+// that their times are the overhead of the library itself (network construction, argument and gradient copies,
+// dispatch); a regression there without one in the full-size models is a framework regression, and one in the full-size
+// models only is a regression of the math kernels. On a GPU the calls return before the kernels are done, so the
+// Forward() and Backward() times are the host overhead, while samples/s is measured up to the completion of the last
+// minibatch. The peak memory is that of the device allocator on a GPU (the caching allocator is enabled for this) and
+// the peak resident memory of the process on the CPU, both since the start of the process; run one model per process
+// to measure the memory of each.
+//
+#ifdef _WIN32
+#define NOMINMAX
+#include "Windows.h"
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+#include "CNTKLibrary.h"
+#include "CommonMatrix.h"
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace CNTK;
+
+// the model builders of the V2 library tests
+FunctionPtr FullyConnectedFeedForwardClassifierNet(Variable input, size_t numOutputClasses, size_t hiddenLayerDim, size_t numHiddenLayers, const DeviceDescriptor& device,
+                                                   const std::function<FunctionPtr(const FunctionPtr&)>& nonLinearity, const std::wstring& outputName);
+template <typename ElementType>
+FunctionPtr LSTMNet(Variable features, size_t cellDim, size_t hiddenDim, size_t numOutputClasses, size_t numLSTMLayers, const DeviceDescriptor& device, const std::wstring& outputName);
+FunctionPtr ResNetClassifier(Variable input, size_t numOutputClasses, const DeviceDescriptor& device, const std::wstring& outputName);
+
+// A classifier with its loss and a minibatch of random inputs and labels on the device.
+struct BenchmarkModel
+{
+    std::wstring m_name;
+    FunctionPtr m_model;
+    Variable m_trainingLoss;
+    Variable m_prediction;
+    std::unordered_map<Variable, ValuePtr> m_minibatch;
+    size_t m_numSamples;
+};
+
+static std::mt19937_64 rng(0);
+
+static std::vector<std::vector<float>> RandomSequences(size_t sampleSize, size_t numSequences, size_t sequenceLength)
+{
+    std::uniform_real_distribution<float> distribution(0, 1);
+    std::vector<std::vector<float>> sequences(numSequences, std::vector<float>(sampleSize * sequenceLength));
+    for (auto& sequence : sequences)
+        for (auto& value : sequence)
+            value = distribution(rng);
+
+    return sequences;
+}
+
+static std::vector<std::vector<size_t>> RandomLabels(size_t numClasses, size_t numSequences, size_t sequenceLength)
+{
+    std::uniform_int_distribution<size_t> distribution(0, numClasses - 1);
+    std::vector<std::vector<size_t>> sequences(numSequences, std::vector<size_t>(sequenceLength));
+    for (auto& sequence : sequences)
+        for (auto& label : sequence)
+            label = distribution(rng);
+
+    return sequences;
+}
+
+static BenchmarkModel CreateBenchmarkModel(const std::wstring& name, Variable features, const FunctionPtr& classifierOutputFunction, size_t numOutputClasses,
+                                           size_t numSequences, size_t sequenceLength, const DeviceDescriptor& device)
+{
+    auto labelsVar = Variable({ numOutputClasses }, DataType::Float, L"labels");
+    auto trainingLossFunction = CrossEntropyWithSoftmax(classifierOutputFunction, labelsVar, L"lossFunction");
+    auto predictionFunction = ClassificationError(classifierOutputFunction, labelsVar, L"classificationError");
+
+    BenchmarkModel model;
+    model.m_name = name;
+    model.m_model = Combine({ trainingLossFunction, predictionFunction, classifierOutputFunction }, name);
+    model.m_trainingLoss = trainingLossFunction;
+    model.m_prediction = predictionFunction;
+    model.m_minibatch[features] = Value::Create(features.Shape(), RandomSequences(features.Shape().TotalSize(), numSequences, sequenceLength), device, true);
+    model.m_minibatch[labelsVar] = Value::Create<float>(numOutputClasses, RandomLabels(numOutputClasses, numSequences, sequenceLength), device, true);
+    model.m_numSamples = numSequences * sequenceLength;
+    return model;
+}
+
+static BenchmarkModel FeedForwardModel(const std::wstring& name, size_t inputDim, size_t hiddenLayerDim, size_t numHiddenLayers, size_t numOutputClasses,
+                                       size_t minibatchSize, const DeviceDescriptor& device)
+{
+    using namespace std::placeholders;
+
+    Variable features({ inputDim }, DataType::Float, L"features");
+    auto classifierOutputFunction = FullyConnectedFeedForwardClassifierNet(features, numOutputClasses, hiddenLayerDim, numHiddenLayers, device, std::bind(Sigmoid, _1, L""), L"classifierOutput");
+    return CreateBenchmarkModel(name, features, classifierOutputFunction, numOutputClasses, minibatchSize, 1, device);
+}
+
+static BenchmarkModel RecurrentModel(const std::wstring& name, size_t inputDim, size_t cellDim, size_t hiddenDim, size_t numLSTMLayers, size_t numOutputClasses,
+                                     size_t numSequences, size_t sequenceLength, const DeviceDescriptor& device)
+{
+    Variable features({ inputDim }, DataType::Float, L"features");
+    auto classifierOutputFunction = LSTMNet<float>(features, cellDim, hiddenDim, numOutputClasses, numLSTMLayers, device, L"classifierOutput");
+    return CreateBenchmarkModel(name, features, classifierOutputFunction, numOutputClasses, numSequences, sequenceLength, device);
+}
+
+static BenchmarkModel ResNetModel(const std::wstring& name, size_t minibatchSize, const DeviceDescriptor& device)
+{
+    Variable images({ 32, 32, 3 }, DataType::Float, L"images");
+    auto classifierOutputFunction = ResNetClassifier(images, 10, device, L"classifierOutput");
+    return CreateBenchmarkModel(name, images, classifierOutputFunction, 10, minibatchSize, 1, device);
+}
+
+// Waits for the last minibatch of a trainer to complete, by copying its loss to the CPU.
+static void WaitForTrainer(const Trainer& trainer)
+{
+    float trainLossValue = 0;
+    auto prevMBTrainingLossValue = trainer.PreviousMinibatchTrainingLossValue()->Data();
+    NDArrayView cpuTrainLossValue(prevMBTrainingLossValue->Shape(), &trainLossValue, 1, DeviceDescriptor::CPUDevice());
+    cpuTrainLossValue.CopyFrom(*prevMBTrainingLossValue);
+}
+
+// Peak memory in MB: of the device allocator on a GPU, of the process on the CPU.
+static double PeakMemoryMB(const DeviceDescriptor& device)
+{
+    using Microsoft::MSR::CNTK::TracingGPUMemoryAllocator;
+    if (device.Type() == DeviceKind::GPU)
+        return TracingGPUMemoryAllocator::GetStatistics(device.Id()).peakBytesInUse / (1024.0 * 1024.0);
+
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss / 1024.0; // in KB
+#endif
+    return 0;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void RunBenchmark(BenchmarkModel& model, const DeviceDescriptor& device, size_t warmup, size_t iterations)
+{
+    // Forward() and Backward(), with the gradients of all parameters as a hand-written training loop would request them;
+    // the gradient values are allocated by the first call and reused by the later ones
+    auto rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(1.0f, model.m_trainingLoss.Shape(), device, true));
+    std::unordered_map<Variable, ValuePtr> parameterGradients;
+    for (const auto& parameter : model.m_model->Parameters())
+        parameterGradients[parameter] = nullptr;
+
+    double forwardMilliseconds = 0;
+    double backwardMilliseconds = 0;
+    for (size_t i = 0; i < warmup + iterations; ++i)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { model.m_prediction, nullptr } };
+        auto start = std::chrono::high_resolution_clock::now();
+        auto backPropState = model.m_model->Forward(model.m_minibatch, outputs, device, { model.m_trainingLoss });
+        double forward = MillisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        model.m_model->Backward(backPropState, { { model.m_trainingLoss, rootGradientValue } }, parameterGradients);
+        double backward = MillisecondsSince(start);
+
+        if (i >= warmup)
+        {
+            forwardMilliseconds += forward;
+            backwardMilliseconds += backward;
+        }
+    }
+
+    // TrainMinibatch(), up to the loss of the last minibatch being available on the CPU
+    Trainer trainer(model.m_model, model.m_trainingLoss, { SGDLearner(model.m_model->Parameters(), 0.0001) });
+    for (size_t i = 0; i < warmup; ++i)
+        trainer.TrainMinibatch(model.m_minibatch, device);
+    WaitForTrainer(trainer);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        trainer.TrainMinibatch(model.m_minibatch, device);
+    WaitForTrainer(trainer);
+    double trainMilliseconds = MillisecondsSince(start);
+
+    printf("%-16ls %6d samples/minibatch: Forward %9.3f ms, Backward %9.3f ms, TrainMinibatch %9.3f ms, %10.1f samples/s, peak memory %8.1f MB\n",
+           model.m_name.c_str(), (int)model.m_numSamples, forwardMilliseconds / iterations, backwardMilliseconds / iterations, trainMilliseconds / iterations,
+           model.m_numSamples * iterations * 1000.0 / trainMilliseconds, PeakMemoryMB(device));
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    DeviceDescriptor device = DeviceDescriptor::DefaultDevice();
+    std::string models = "feedForward:feedForwardTiny:recurrent:recurrentTiny:resNet";
+    size_t iterations = 100;
+    size_t warmup = 10;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        auto separator = argument.find('=');
+        std::string name = argument.substr(0, separator);
+        std::string value = (separator == std::string::npos) ? "" : argument.substr(separator + 1);
+        if (name == "device")
+            device = (std::stoi(value) < 0) ? DeviceDescriptor::CPUDevice() : DeviceDescriptor::GPUDevice(std::stoi(value));
+        else if (name == "models")
+            models = value;
+        else if (name == "iterations")
+            iterations = std::stoul(value);
+        else if (name == "warmup")
+            warmup = std::stoul(value);
+        else
+        {
+            fprintf(stderr, "Usage: %s [device=<id>] [models=<name>:<name>...] [iterations=<n>] [warmup=<n>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (iterations == 0)
+    {
+        fprintf(stderr, "iterations must be at least 1\n");
+        return 1;
+    }
+
+    // the peak memory of a GPU is only tracked by the caching allocator
+    if (device.Type() == DeviceKind::GPU)
+        Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::SetAllocatorKind(Microsoft::MSR::CNTK::GPUMemoryAllocatorKind::Caching);
+
+    // fixed configurations; changing one invalidates the results recorded for it
+    std::vector<std::pair<std::string, std::function<BenchmarkModel()>>> allModels = {
+        { "feedForward",     [&]() { return FeedForwardModel(L"feedForward", 937, 2048, 6, 9304, 256, device); } },
+        { "feedForwardTiny", [&]() { return FeedForwardModel(L"feedForwardTiny", 2, 4, 1, 2, 1, device); } },
+        { "recurrent",       [&]() { return RecurrentModel(L"recurrent", 937, 1024, 512, 3, 9304, 8, 32, device); } },
+        { "recurrentTiny",   [&]() { return RecurrentModel(L"recurrentTiny", 2, 4, 2, 1, 2, 1, 4, device); } },
+        { "resNet",          [&]() { return ResNetModel(L"resNet", 128, device); } },
+    };
+
+    try
+    {
+        for (const auto& model : allModels)
+        {
+            if ((":" + models + ":").find(":" + model.first + ":") == std::string::npos)
+                continue;
+
+            // as TestCifarResnet(), the ResNet model only runs on a GPU
+            if ((model.first == "resNet") && (device.Type() != DeviceKind::GPU))
+                continue;
+
+            auto benchmarkModel = model.second();
+            RunBenchmark(benchmarkModel, device, warmup, iterations);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
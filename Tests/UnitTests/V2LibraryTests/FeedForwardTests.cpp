@@ -236,12 +236,112 @@ void TestTimesAndPlus(size_t inputDim,
     }
 }
 
+// Forward two minibatches before backpropagating through either, as done when accumulating gradients of micro-batches
+template <typename ElementType>
+void TestInterleavedBackPropStates(size_t inputDim, size_t outputDim, size_t numSamples, const DeviceDescriptor& device)
+{
+    Parameter timesParam(MakeSharedObject<NDArrayView>((ElementType)0.5, NDShape({ outputDim, inputDim }), device), L"timesParameters");
+    Variable inputVar({ inputDim }, AsDataType<ElementType>(), L"input");
+    auto timesFunc = Times(timesParam, inputVar);
+
+    NDShape inputShape = inputVar.Shape().AppendShape({ 1, numSamples });
+    NDShape outputShape = timesFunc->Output().Shape().AppendShape({ 1, numSamples });
+
+    const size_t numMinibatches = 2;
+    std::vector<std::vector<ElementType>> inputData(numMinibatches, std::vector<ElementType>(inputShape.TotalSize()));
+    std::vector<BackPropStatePtr> backpropStates;
+    for (size_t k = 0; k < numMinibatches; ++k)
+    {
+        for (size_t i = 0; i < inputData[k].size(); ++i)
+            inputData[k][i] = ((ElementType)rand()) / RAND_MAX;
+
+        ValuePtr inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(inputShape, inputData[k].data(), inputData[k].size(), DeviceDescriptor::CPUDevice(), true));
+        std::unordered_map<Variable, ValuePtr> outputs = { { timesFunc->Output(), nullptr } };
+        backpropStates.push_back(timesFunc->Forward({ { inputVar, inputValue } }, outputs, device, { timesFunc->Output() }));
+    }
+
+    for (size_t k = 0; k < numMinibatches; ++k)
+    {
+        auto rootGradientValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>((ElementType)1, outputShape, device));
+        std::unordered_map<Variable, ValuePtr> paramGradients = { { timesParam, nullptr } };
+        timesFunc->Backward(backpropStates[k], { { timesFunc->Output(), rootGradientValue } }, paramGradients);
+
+        std::vector<ElementType> timesParameterGradientData(timesParam.Shape().TotalSize());
+        NDArrayViewPtr cpuArrayView = MakeSharedObject<NDArrayView>(timesParam.Shape(), timesParameterGradientData.data(), timesParameterGradientData.size(), DeviceDescriptor::CPUDevice(), false);
+        cpuArrayView->CopyFrom(*paramGradients[timesParam]->Data());
+
+        std::vector<ElementType> expectedTimesParamsGradientValues(timesParam.Shape().TotalSize());
+        for (size_t i = 0; i < inputDim; ++i)
+        {
+            ElementType expectedVal = 0;
+            for (size_t j = 0; j < numSamples; ++j)
+                expectedVal += inputData[k][j * inputDim + i];
+
+            for (size_t j = 0; j < outputDim; ++j)
+                expectedTimesParamsGradientValues[i * outputDim + j] = expectedVal;
+        }
+
+        FloatingPointVectorCompare(timesParameterGradientData, expectedTimesParamsGradientValues, "TestInterleavedBackPropStates: Backprop results do not match expected results for Times params gradients");
+    }
+}
+
+// Structurally identical models created one after the other take over the network of their predecessor, with their own parameters
+template <typename ElementType>
+void TestCachedComputationNetworks(size_t inputDim, size_t outputDim, size_t numSamples, const DeviceDescriptor& device)
+{
+    SetComputationNetworkCacheCapacity(1);
+
+    NDShape inputShape = NDShape({ inputDim }).AppendShape({ 1, numSamples });
+    std::vector<ElementType> inputData(inputShape.TotalSize());
+    for (size_t i = 0; i < inputData.size(); ++i)
+        inputData[i] = ((ElementType)rand()) / RAND_MAX;
+
+    const size_t numModels = 3;
+    for (size_t k = 0; k < numModels; ++k)
+    {
+        ElementType timesValue = (ElementType)(k + 1) / 4;
+        ElementType plusValue = (ElementType)k;
+        Parameter timesParam(MakeSharedObject<NDArrayView>(timesValue, NDShape({ outputDim, inputDim }), device), L"timesParameters");
+        Parameter plusParam(MakeSharedObject<NDArrayView>(plusValue, NDShape({ outputDim }), device), L"plusParameters");
+        Variable inputVar({ inputDim }, AsDataType<ElementType>(), L"input");
+        auto plusFunc = Plus(plusParam, Times(timesParam, inputVar));
+
+        ValuePtr inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(inputShape, inputData.data(), inputData.size(), DeviceDescriptor::CPUDevice(), true));
+        std::unordered_map<Variable, ValuePtr> outputs = { { plusFunc->Output(), nullptr } };
+        plusFunc->Forward({ { inputVar, inputValue } }, outputs, device);
+
+        NDShape outputShape = plusFunc->Output().Shape().AppendShape({ 1, numSamples });
+        std::vector<ElementType> outputData(outputShape.TotalSize());
+        NDArrayViewPtr cpuArrayView = MakeSharedObject<NDArrayView>(outputShape, outputData.data(), outputData.size(), DeviceDescriptor::CPUDevice(), false);
+        cpuArrayView->CopyFrom(*outputs[plusFunc->Output()]->Data());
+
+        std::vector<ElementType> expectedOutputData(outputShape.TotalSize());
+        for (size_t j = 0; j < numSamples; ++j)
+        {
+            ElementType expectedVal = plusValue;
+            for (size_t i = 0; i < inputDim; ++i)
+                expectedVal += timesValue * inputData[j * inputDim + i];
+
+            for (size_t i = 0; i < outputDim; ++i)
+                expectedOutputData[j * outputDim + i] = expectedVal;
+        }
+
+        FloatingPointVectorCompare(outputData, expectedOutputData, "TestCachedComputationNetworks: Forward prop results do not match expected results");
+    }
+
+    SetComputationNetworkCacheCapacity(0);
+}
+
 void FeedForwardTests()
 {
     TestTimesAndPlus<double>(4, 2, 5, DeviceDescriptor::CPUDevice(), 3, true, true, true);
+    TestInterleavedBackPropStates<float>(4, 3, 5, DeviceDescriptor::CPUDevice());
+    TestCachedComputationNetworks<float>(4, 3, 5, DeviceDescriptor::CPUDevice());
 #ifndef CPUONLY
     TestTimesAndPlus<float>(145, 32, 2, DeviceDescriptor::GPUDevice(0), 10, true, false, true);
     TestTimesAndPlus<double>(145, 15, 200, DeviceDescriptor::GPUDevice(0), 21, false, false, false);
+    TestInterleavedBackPropStates<double>(37, 8, 16, DeviceDescriptor::GPUDevice(0));
+    TestCachedComputationNetworks<double>(37, 8, 16, DeviceDescriptor::GPUDevice(0));
 
     TestFeedForwardNetworkCreation(DeviceDescriptor::GPUDevice(0), true);
     TestFeedForwardNetworkCreation(DeviceDescriptor::GPUDevice(0), false);
@@ -97,6 +97,69 @@ void TestRMSPropLearner(size_t numParameters, size_t numMinibatches, const Devic
     TestUpdate<ElementType>(learner, shape, numMinibatches, device);
 }
 
+template <typename ElementType>
+void TestAdamLearner(size_t numParameters, size_t numMinibatches, bool layerwiseScaling, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = AdamLearner(parameters, vector<double>{ 0.05, 0.01 }, vector<double>{ 0.9 }, vector<double>{ 0.999 }, 1e-8, layerwiseScaling);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+template <typename ElementType>
+void TestLARSLearner(size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    auto parameters = CreateParameters<ElementType>(shape, numParameters, device);
+    auto learner = LARSLearner(parameters, vector<double>{ 0.5 }, vector<double>{ 0.9 }, 0.01);
+    TestUpdate<ElementType>(learner, shape, numMinibatches, device);
+}
+
+// A learner that updates its parameters together must compute the same values as one that updates them one by one.
+template <typename ElementType>
+void TestFusedMomentumSGDLearner(size_t numParameters, size_t numMinibatches, const DeviceDescriptor& device)
+{
+    NDShape shape = CreateShape(rng() % maxNumAxes + 1, maxDimSize);
+    MomentumsPerSample momentums({ { 1, 1.0 }, { 3, 0.1 }, { 10, 0.01 } }, 2);
+    vector<Parameter> parameters[2];
+    LearnerPtr learners[2];
+    for (size_t fused = 0; fused < 2; fused++)
+    {
+        for (size_t i = 0; i < numParameters; i++)
+            parameters[fused].push_back(Parameter(NDArrayView::RandomUniform<ElementType>(shape, -1.0, 1.0, (unsigned long)i, device), L"parameter_" + to_wstring(i)));
+
+        SetFusedParameterUpdates(fused != 0);
+        learners[fused] = MomentumSGDLearner(unordered_set<Parameter>(parameters[fused].begin(), parameters[fused].end()), vector<double>{ 0.3, 0.2, 0.1 }, momentums);
+    }
+    SetFusedParameterUpdates(false);
+
+    auto seed = (unsigned long)rng();
+    for (size_t k = 0; k < numMinibatches; k++)
+    {
+        for (size_t fused = 0; fused < 2; fused++)
+        {
+            unordered_map<Parameter, NDArrayViewPtr> gradientValues;
+            for (size_t i = 0; i < numParameters; i++)
+                gradientValues[parameters[fused][i]] = NDArrayView::RandomUniform<ElementType>(shape, -1.0, 1.0, seed + (unsigned long)(k * numParameters + i), device);
+
+            learners[fused]->Update(gradientValues, 1);
+        }
+    }
+
+    for (size_t i = 0; i < numParameters; i++)
+    {
+        vector<ElementType> values[2];
+        for (size_t fused = 0; fused < 2; fused++)
+        {
+            values[fused].resize(shape.TotalSize());
+            auto cpuView = MakeSharedObject<NDArrayView>(shape, values[fused].data(), values[fused].size(), DeviceDescriptor::CPUDevice(), false);
+            cpuView->CopyFrom(*parameters[fused][i].Value());
+        }
+
+        FloatingPointVectorCompare(values[1], values[0], "TestFusedMomentumSGDLearner: fused parameter update does not match the update per parameter");
+    }
+}
+
 void TestTrainingParametersSchedule() 
 {
     LearningRatesPerSample schedule1 = 0.5;
@@ -179,7 +242,11 @@ void LearnerTests()
 #endif
     
     TestAdaGradLearner<double>(2, 10, DeviceDescriptor::CPUDevice());
+    TestFusedMomentumSGDLearner<float>(4, 5, DeviceDescriptor::CPUDevice());
     
     TestFSAdaGradLearner<double>(10, 2, DeviceDescriptor::CPUDevice());
     TestRMSPropLearner<float>(3, 3, DeviceDescriptor::CPUDevice());
+    TestAdamLearner<float>(3, 5, /*layerwiseScaling=*/false, DeviceDescriptor::CPUDevice());
+    TestAdamLearner<double>(2, 5, /*layerwiseScaling=*/true, DeviceDescriptor::CPUDevice());
+    TestLARSLearner<float>(3, 4, DeviceDescriptor::CPUDevice());
 }
\ No newline at end of file
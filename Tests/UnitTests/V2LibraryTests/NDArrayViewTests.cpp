@@ -91,6 +91,17 @@ void TestNDArrayView(size_t numAxes, const DeviceDescriptor& device)
     if (first[0] != (second[0] + 1))
         throw std::runtime_error("The clonedView's contents do not match expected");
 
+    // Test asynchronous copy to the CPU
+    auto asyncCopiedView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), viewShape, DeviceDescriptor::CPUDevice());
+    auto asyncCopy = asyncCopiedView->CopyFromAsync(*dataView);
+    asyncCopy.get();
+    const ElementType* asyncCopiedData = asyncCopiedView->template DataBuffer<ElementType>();
+    for (size_t i = 0; i < viewShape.TotalSize(); ++i)
+    {
+        if (asyncCopiedData[i] != data[i])
+            throw std::runtime_error("The contents of the asynchronously copied view do not match expected");
+    }
+
     // Test alias
     auto aliasView = clonedView->Alias(true);
     const ElementType* aliasViewBuffer = aliasView->DataBuffer<ElementType>();
@@ -194,6 +205,93 @@ void TestSparseCSCArrayView(size_t numAxes, const DeviceDescriptor& device)
         throw std::runtime_error("The contents of the dense vector that the sparse NDArrayView is copied into do not match the expected values");
 }
 
+template <typename ElementType>
+void TestNDArrayViewSlicing(const DeviceDescriptor& device)
+{
+    NDShape viewShape({ 4, 3, 2 });
+    std::vector<ElementType> data(viewShape.TotalSize());
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (ElementType)i;
+
+    auto dataView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), viewShape, device);
+    dataView->CopyFrom(*MakeSharedObject<NDArrayView>(viewShape, data));
+
+    auto toCPU = [](const NDArrayViewPtr& view) {
+        auto cpuView = MakeSharedObject<NDArrayView>(AsDataType<ElementType>(), view->Shape(), DeviceDescriptor::CPUDevice());
+        cpuView->CopyFrom(*view);
+        return std::vector<ElementType>(cpuView->template DataBuffer<ElementType>(), cpuView->template DataBuffer<ElementType>() + view->Shape().TotalSize());
+    };
+
+    auto verifyException = [](const std::function<void()>& functionToTest, const char* errorMessage) {
+        bool error = false;
+        try
+        {
+            functionToTest();
+        }
+        catch (const std::exception&)
+        {
+            error = true;
+        }
+
+        if (!error)
+            throw std::runtime_error(errorMessage);
+    };
+
+    // A strided slice reads the elements of the section it covers
+    auto sliceView = dataView->SliceView({ 1, 0, 1 }, NDShape({ 2, 3, 1 }));
+    auto sliceData = toCPU(sliceView);
+    for (size_t j = 0; j < 3; ++j)
+        for (size_t i = 0; i < 2; ++i)
+            if (sliceData[(j * 2) + i] != data[12 + (j * 4) + (i + 1)])
+                throw std::runtime_error("The contents of the slice view do not match expected");
+
+    verifyException([&sliceView]() { sliceView->template DataBuffer<ElementType>(); }, "Was incorrectly able to get the data buffer of a strided view");
+    verifyException([&sliceView]() { sliceView->AsShape(NDShape({ 6 })); }, "Was incorrectly able to reshape a strided view");
+
+    // Writes through the slice show in the view it was sliced from, and nowhere else
+    sliceView->SetValue((ElementType)-1);
+    auto newData = toCPU(dataView);
+    for (size_t k = 0; k < 2; ++k)
+        for (size_t j = 0; j < 3; ++j)
+            for (size_t i = 0; i < 4; ++i)
+            {
+                size_t index = (k * 12) + (j * 4) + i;
+                bool isInSlice = (k == 1) && (i >= 1) && (i < 3);
+                if (newData[index] != (isInSlice ? (ElementType)-1 : data[index]))
+                    throw std::runtime_error("Writing to a slice view did not update the expected elements of the view it was sliced from");
+            }
+
+    sliceView->CopyFrom(*MakeSharedObject<NDArrayView>(NDShape({ 2, 3, 1 }), sliceData));
+    if (toCPU(dataView) != data)
+        throw std::runtime_error("Copying into a slice view did not restore the contents of the view it was sliced from");
+
+    // A slice along the last axis is contiguous, and can be reshaped and used as a plain buffer without copying
+    auto lastAxisSliceView = dataView->SliceView({ 0, 0, 1 }, NDShape({ 4, 3, 1 }))->AsShape(NDShape({ 12 }));
+    if (toCPU(lastAxisSliceView) != std::vector<ElementType>(data.begin() + 12, data.end()))
+        throw std::runtime_error("The contents of the reshaped slice view do not match expected");
+
+    if (device.Type() == DeviceKind::CPU)
+    {
+        if (lastAxisSliceView->template DataBuffer<ElementType>() != dataView->template DataBuffer<ElementType>() + 12)
+            throw std::runtime_error("The reshaped slice view does not share the buffer of the view it was sliced from");
+    }
+
+    // A transposed view swaps the indices of two axes
+    auto transposedView = dataView->TransposedView(0, 2);
+    if (transposedView->Shape() != NDShape({ 2, 3, 4 }))
+        throw std::runtime_error("The shape of the transposed view does not match expected");
+
+    auto transposedData = toCPU(transposedView);
+    for (size_t k = 0; k < 4; ++k)
+        for (size_t j = 0; j < 3; ++j)
+            for (size_t i = 0; i < 2; ++i)
+                if (transposedData[(k * 6) + (j * 2) + i] != data[(i * 12) + (j * 4) + k])
+                    throw std::runtime_error("The contents of the transposed view do not match expected");
+
+    auto readOnlySliceView = dataView->SliceView({ 0, 0, 0 }, NDShape({ 1, 3, 2 }), /*readOnly =*/ true);
+    verifyException([&readOnlySliceView]() { readOnlySliceView->SetValue((ElementType)0); }, "Was incorrectly able to write to a read-only slice view");
+}
+
 void NDArrayViewTests()
 {
     TestNDArrayView<float>(2, DeviceDescriptor::CPUDevice());
@@ -205,4 +303,9 @@ void NDArrayViewTests()
     TestSparseCSCArrayView<double>(4, DeviceDescriptor::GPUDevice(0));
 #endif
     TestSparseCSCArrayView<float>(2, DeviceDescriptor::CPUDevice());
+
+    TestNDArrayViewSlicing<float>(DeviceDescriptor::CPUDevice());
+#ifndef CPUONLY
+    TestNDArrayViewSlicing<double>(DeviceDescriptor::GPUDevice(0));
+#endif
 }
@@ -136,6 +136,9 @@ FunctionPtr LSTMNet(Variable features, size_t cellDim, size_t hiddenDim, size_t
     return Plus(Times(W, ElementTimes(expsW, classifierRoot)), b, outputName);
 }
 
+// also used by the V2 library benchmarks (Benchmarks.cpp)
+template FunctionPtr LSTMNet<float>(Variable, size_t, size_t, size_t, size_t, const DeviceDescriptor&, const std::wstring&);
+
 template <typename ElementType>
 void TestRecurrentNetworkCreation(const DeviceDescriptor& device, bool testSaveAndReLoad)
 {
@@ -6,7 +6,7 @@ using namespace CNTK;
 
 using namespace std::placeholders;
 
-MinibatchSourcePtr CreateTextMinibatchSource(const std::wstring& filePath, size_t featureDim, size_t labelDim, size_t epochSize)
+MinibatchSourcePtr CreateTextMinibatchSource(const std::wstring& filePath, size_t featureDim, size_t labelDim, size_t epochSize, const DistributedTrainerPtr& distributedTrainer = nullptr, size_t prefetchDepth = 0)
 {
     Dictionary featuresStreamConfig;
     featuresStreamConfig[L"dim"] = featureDim;
@@ -29,11 +29,17 @@ MinibatchSourcePtr CreateTextMinibatchSource(const std::wstring& filePath, size_
     Dictionary minibatchSourceConfiguration;
     minibatchSourceConfiguration[L"epochSize"] = epochSize;
     minibatchSourceConfiguration[L"deserializers"] = std::vector<DictionaryValue>({ deserializerConfiguration });
+    minibatchSourceConfiguration[L"prefetchDepth"] = prefetchDepth;
+    if (distributedTrainer)
+    {
+        minibatchSourceConfiguration[L"numWorkers"] = distributedTrainer->NumWorkers();
+        minibatchSourceConfiguration[L"workerRank"] = distributedTrainer->WorkerRank();
+    }
 
     return CreateCompositeMinibatchSource(minibatchSourceConfiguration);
 }
 
-void TrainSimpleFeedForwardClassifer(const DeviceDescriptor& device)
+void TrainSimpleFeedForwardClassifer(const DeviceDescriptor& device, const DistributedTrainerPtr& distributedTrainer = nullptr)
 {
     const size_t inputDim = 2;
     const size_t numOutputClasses = 2;
@@ -71,8 +77,8 @@ void TrainSimpleFeedForwardClassifer(const DeviceDescriptor& device)
     auto oneHiddenLayerClassifier = CNTK::Combine({ trainingLoss, prediction, classifierOutput }, L"classifierModel");
 
     double learningRatePerSample = 0.02;
-    minibatchSource = CreateTextMinibatchSource(L"SimpleDataTrain_cntk_text.txt", (size_t)2, (size_t)2, SIZE_MAX);
-    Trainer trainer(oneHiddenLayerClassifier, trainingLoss, { SGDLearner(oneHiddenLayerClassifier->Parameters(), learningRatePerSample) });
+    minibatchSource = CreateTextMinibatchSource(L"SimpleDataTrain_cntk_text.txt", (size_t)2, (size_t)2, SIZE_MAX, distributedTrainer);
+    Trainer trainer(oneHiddenLayerClassifier, trainingLoss, { SGDLearner(oneHiddenLayerClassifier->Parameters(), learningRatePerSample) }, distributedTrainer);
     std::unordered_map<StreamInfo, std::pair<size_t, size_t>> minibatchSizeLimits = { { *featureStreamInfo, std::make_pair((size_t)0, minibatchSize) }, { *labelStreamInfo, std::make_pair((size_t)0, minibatchSize) } };
     size_t outputFrequencyInMinibatches = 20;
     for (size_t i = 0; i < numMinibatchesToTrain; ++i)
@@ -112,7 +118,7 @@ void TrainMNISTClassifier(const DeviceDescriptor& device)
     const size_t numSweepsToTrainWith = 3;
     const size_t numMinibatchesToTrain = (numSamplesPerSweep * numSweepsToTrainWith) / minibatchSize;
 
-    auto minibatchSource = CreateTextMinibatchSource(L"Train-28x28_cntk_text.txt", (size_t)784, (size_t)10, SIZE_MAX);
+    auto minibatchSource = CreateTextMinibatchSource(L"Train-28x28_cntk_text.txt", (size_t)784, (size_t)10, SIZE_MAX, nullptr, /*prefetchDepth=*/2);
 
     auto streamInfos = minibatchSource->StreamInfos();
     auto featureStreamInfo = std::find_if(streamInfos.begin(), streamInfos.end(), [](const StreamInfo& streamInfo) {
@@ -139,8 +145,59 @@ void TrainMNISTClassifier(const DeviceDescriptor& device)
     }
 }
 
+void TestGradientAccumulation(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 5;
+    const size_t numOutputClasses = 3;
+    const size_t numSamples = 6;
+
+    srand(1);
+    std::vector<float> inputData(inputDim * numSamples);
+    for (size_t i = 0; i < inputData.size(); ++i)
+        inputData[i] = ((float)rand()) / RAND_MAX;
+
+    std::vector<float> labelData(numOutputClasses * numSamples, 0);
+    for (size_t i = 0; i < numSamples; ++i)
+        labelData[(i * numOutputClasses) + (rand() % numOutputClasses)] = 1;
+
+    // The arguments for the 'count' samples starting at sample 'first'
+    auto minibatch = [&](const Variable& input, const Variable& labels, size_t first, size_t count) {
+        auto inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(input.Shape().AppendShape({ 1, count }), inputData.data() + (first * inputDim), count * inputDim, DeviceDescriptor::CPUDevice(), true));
+        auto labelValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(labels.Shape().AppendShape({ 1, count }), labelData.data() + (first * numOutputClasses), count * numOutputClasses, DeviceDescriptor::CPUDevice(), true));
+        return std::unordered_map<Variable, ValuePtr>({ { input, inputValue }, { labels, labelValue } });
+    };
+
+    // Training on a minibatch in parts must update the parameters as training on the whole minibatch does
+    std::vector<float> parameterValues[2];
+    for (size_t accumulate = 0; accumulate < 2; ++accumulate)
+    {
+        Variable input({ inputDim }, DataType::Float, L"features");
+        Variable labels({ numOutputClasses }, DataType::Float, L"labels");
+        auto timesParam = Parameter(NDArrayView::RandomUniform<float>({ numOutputClasses, inputDim }, -0.05, 0.05, 1, device));
+        auto trainingLoss = CNTK::CrossEntropyWithSoftmax(Times(timesParam, input), labels, L"lossFunction");
+
+        Trainer trainer(trainingLoss, trainingLoss, { SGDLearner(trainingLoss->Parameters(), 0.1) });
+        if (accumulate)
+        {
+            trainer.AccumulateMinibatchGradients(minibatch(input, labels, 0, 2), device);
+            trainer.AccumulateMinibatchGradients(minibatch(input, labels, 2, 1), device);
+            trainer.TrainMinibatch(minibatch(input, labels, 3, 3), device);
+        }
+        else
+            trainer.TrainMinibatch(minibatch(input, labels, 0, numSamples), device);
+
+        parameterValues[accumulate].resize(timesParam.Shape().TotalSize());
+        auto cpuView = MakeSharedObject<NDArrayView>(timesParam.Shape(), parameterValues[accumulate].data(), parameterValues[accumulate].size(), DeviceDescriptor::CPUDevice(), false);
+        cpuView->CopyFrom(*timesParam.Value());
+    }
+
+    FloatingPointVectorCompare(parameterValues[1], parameterValues[0], "TestGradientAccumulation: the update with accumulated gradients does not match the update for the whole minibatch");
+}
+
 void TrainerTests()
 {
     TrainSimpleFeedForwardClassifer(DeviceDescriptor::CPUDevice());
+    TrainSimpleFeedForwardClassifer(DeviceDescriptor::CPUDevice(), CreateDataParallelDistributedTrainer());
+    TestGradientAccumulation(DeviceDescriptor::CPUDevice());
     TrainMNISTClassifier(DeviceDescriptor::GPUDevice(0));
 }